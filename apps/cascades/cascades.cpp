@@ -22,21 +22,47 @@
 #include <math.h>
 #include <cstdlib>
 #include <ctime>
+#include <graphlab/util/integer_mix.hpp>
+#include <graphlab/macros_def.hpp>
 
 double infection_chance;
 double recovery_chance;
 
 enum Status {INFECTED, SUSCEPTIBLE, RECOVERED};
 
-// The vertex data is its status (S, I, or R) 
-typedef Status vertex_data_type;
+/*
+ * The vertex data is its status (S, I, or R). The batched modes also keep
+ * one bit per sample of a batch of 64 independent cascades: live holds the
+ * samples in which the vertex is infected and frontier those in which it
+ * was infected in the last round.
+ */
+struct vertex_data_type {
+  Status status;
+  uint64_t live;
+  uint64_t frontier;
+  // the number of Monte Carlo samples in which the vertex got infected
+  size_t hits;
+  // one word per batch of the reverse-reachable sets containing the vertex
+  std::vector<uint64_t> rr;
+
+  vertex_data_type(Status status = SUSCEPTIBLE) :
+    status(status), live(0), frontier(0), hits(0) { }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << status << live << frontier << hits << rr;
+  }
+
+  void load(graphlab::iarchive& iarc) {
+    iarc >> status >> live >> frontier >> hits >> rr;
+  }
+};
 
 // infected_status counts the number of infected neighbors, since
 // the number of infected neighbors determines how likely a susceptible node is
 // to be infected
 struct infected_status: public graphlab::IS_POD_TYPE {
   int value;
-  vertex_data_type status;
+  Status status;
 
   infected_status() {
     value = 0;
@@ -69,7 +95,7 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   // next entry is their status (S, I, or R)
   strm >> label;
 
-  vertex_data_type statusLabel;
+  Status statusLabel;
   if (label == 'S') {
     statusLabel = SUSCEPTIBLE;
   } else if (label == 'I') {
@@ -80,7 +106,7 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
 
   
   // insert this vertex with its label 
-  graph.add_vertex(vid, statusLabel);
+  graph.add_vertex(vid, vertex_data_type(statusLabel));
 
   // while there are elements in the line, continue to read until we fail
   while(1) {
@@ -107,7 +133,7 @@ class cascades:
     gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
       // figure out which data to get from the edge.
       bool isEdgeSource = (vertex.id() == edge.source().id());
-      vertex_data_type neighbor_status = isEdgeSource ? edge.target().data() : edge.source().data();
+      Status neighbor_status = isEdgeSource ? edge.target().data().status : edge.source().data().status;
 
       // create infected_status and add neighbor's status to it. 
 
@@ -119,9 +145,9 @@ class cascades:
     }
 
     void apply(icontext_type& context, vertex_type& vertex, const gather_type& total) {
-      vertex_data_type old_data = vertex.data();
+      Status old_data = vertex.data().status;
 
-      vertex_data_type result = old_data;
+      Status result = old_data;
       double random_value;
 
       // if vertex.data == RECOVERED, don't do anything
@@ -148,7 +174,7 @@ class cascades:
         }
       }
 
-      vertex.data() = result;
+      vertex.data().status = result;
 
       if (result == INFECTED) {
         context.signal(vertex);
@@ -164,7 +190,7 @@ struct cascades_writer{
   std::string save_vertex(graph_type::vertex_type v) {
     std::stringstream strm;
 
-    Status status = v.data();
+    Status status = v.data().status;
     char vertex_data;
     
     // Convert the status back into a char
@@ -182,6 +208,221 @@ struct cascades_writer{
 };
 
 
+/*
+ * Batched independent cascades ---------------------------------------------
+ *
+ * 64 samples of the independent cascade model run together, one per bit of
+ * a word. Whether an edge is live in a sample is a coin drawn by hashing
+ * the edge endpoints, the sample index and the seed, so the coins of every
+ * edge are fixed in advance without storing any random state, and stay the
+ * same when the edge is visited again. As in the program above, edges are
+ * not directed, so the reverse-reachable set of a vertex is the set of
+ * vertices its cascade reaches in the same sample.
+ */
+typedef graph_type::lvid_type lvid_type;
+typedef graph_type::local_vertex_type local_vertex_type;
+typedef graph_type::local_edge_type local_edge_type;
+
+uint32_t rng_seed = 0;
+// the cascade batch being simulated
+size_t current_batch = 0;
+
+inline uint32_t mix_id(graphlab::vertex_id_type vid) {
+  const uint64_t v = vid;
+  return graphlab::integer_mix(uint32_t(v ^ (v >> 32)));
+}
+
+// The uniform hash of a sample of the batch
+inline uint32_t sample_hash(uint32_t a, uint32_t sample) {
+  return graphlab::integer_mix(a ^ graphlab::integer_mix(
+      rng_seed ^ graphlab::integer_mix(uint32_t(current_batch * 64 + sample))));
+}
+
+// Returns the samples of the batch among the candidates in which the edge is live
+uint64_t live_coins(graphlab::vertex_id_type source, graphlab::vertex_id_type target,
+                    uint64_t candidates) {
+  const uint32_t threshold = 
+    infection_chance >= 1.0 ? uint32_t(-1) : uint32_t(infection_chance * 4294967296.0);
+  const uint32_t edge_hash = graphlab::integer_mix(mix_id(source) ^ mix_id(target) * 31);
+  uint64_t ret = 0;
+  while (candidates) {
+    const uint32_t sample = __builtin_ctzll(candidates);
+    candidates &= candidates - 1;
+    if (sample_hash(edge_hash, sample) < threshold) ret |= uint64_t(1) << sample;
+  }
+  return ret;
+}
+
+struct sample_bits {
+  uint64_t bits;
+  sample_bits(uint64_t bits = 0) : bits(bits) { }
+  sample_bits& operator+=(const sample_bits& other) {
+    bits |= other.bits;
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << bits; }
+  void load(graphlab::iarchive& iarc) { iarc >> bits; }
+};
+
+// Collects the samples in which a neighbor in the frontier infects the vertex
+sample_bits gather_infections(lvid_type lvid, graph_type& graph) {
+  local_vertex_type vtx = graph.l_vertex(lvid);
+  const uint64_t live = vtx.data().live;
+  uint64_t ret = 0;
+  foreach(const local_edge_type& e, vtx.in_edges()) {
+    const uint64_t candidates = e.source().data().frontier & ~live & ~ret;
+    if (candidates) 
+      ret |= live_coins(e.source().global_id(), vtx.global_id(), candidates);
+  }
+  foreach(const local_edge_type& e, vtx.out_edges()) {
+    const uint64_t candidates = e.target().data().frontier & ~live & ~ret;
+    if (candidates) 
+      ret |= live_coins(vtx.global_id(), e.target().global_id(), candidates);
+  }
+  return sample_bits(ret);
+}
+
+void apply_infections(lvid_type lvid, const sample_bits& infected, graph_type& graph) {
+  vertex_data_type& data = graph.l_vertex(lvid).data();
+  data.frontier = infected.bits & ~data.live;
+  data.live |= data.frontier;
+}
+
+bool in_frontier(const graph_type::vertex_type& v) {
+  return v.data().frontier != 0;
+}
+
+/*
+ * Runs the batch from the live words until no sample spreads any further. 
+ * Each round runs on all the vertices, so that frontiers are cleared.
+ */
+void simulate_batch(graph_type& graph, 
+                    graphlab::graph_gather_apply<graph_type, sample_bits>& engine) {
+  while (!graph.vertex_set_empty(graph.select(in_frontier))) {
+    engine.exec();
+  }
+}
+
+void set_seed_samples(graph_type::vertex_type& v) {
+  v.data().live = v.data().frontier = (v.data().status == INFECTED) ? uint64_t(-1) : 0;
+}
+
+void count_hits(graph_type::vertex_type& v) {
+  v.data().hits += __builtin_popcountll(v.data().live);
+}
+
+/*
+ * The root of each sample of a batch is the vertex of least hash, which is
+ * a uniformly random vertex.
+ */
+struct sample_roots: public graphlab::IS_POD_TYPE {
+  uint32_t hash[64];
+  graphlab::vertex_id_type vid[64];
+  sample_roots() {
+    for (size_t i = 0; i < 64; ++i) {
+      hash[i] = uint32_t(-1);
+      vid[i] = graphlab::vertex_id_type(-1);
+    }
+  }
+  sample_roots& operator+=(const sample_roots& other) {
+    for (size_t i = 0; i < 64; ++i) {
+      if (other.hash[i] < hash[i] || 
+          (other.hash[i] == hash[i] && other.vid[i] < vid[i])) {
+        hash[i] = other.hash[i];
+        vid[i] = other.vid[i];
+      }
+    }
+    return *this;
+  }
+};
+
+sample_roots root_candidate(const graph_type::vertex_type& v) {
+  sample_roots ret;
+  for (uint32_t i = 0; i < 64; ++i) {
+    ret.hash[i] = sample_hash(mix_id(v.id()), i);
+    ret.vid[i] = v.id();
+  }
+  return ret;
+}
+
+sample_roots current_roots;
+
+void set_root_samples(graph_type::vertex_type& v) {
+  uint64_t bits = 0;
+  for (size_t i = 0; i < 64; ++i) {
+    if (current_roots.vid[i] == v.id()) bits |= uint64_t(1) << i;
+  }
+  v.data().live = v.data().frontier = bits;
+}
+
+void store_rr_sets(graph_type::vertex_type& v) {
+  v.data().rr.push_back(v.data().live);
+}
+
+
+/*
+ * Greedy seed selection: repeatedly picks the vertex which belongs to the
+ * most reverse-reachable sets not yet covered by the seeds chosen so far.
+ */
+std::vector<uint64_t> covered_sets;
+
+struct best_vertex: public graphlab::IS_POD_TYPE {
+  size_t count;
+  graphlab::vertex_id_type vid;
+  best_vertex() : count(0), vid(graphlab::vertex_id_type(-1)) { }
+  best_vertex& operator+=(const best_vertex& other) {
+    if (other.count > count || (other.count == count && other.vid < vid)) {
+      count = other.count;
+      vid = other.vid;
+    }
+    return *this;
+  }
+};
+
+best_vertex uncovered_count(const graph_type::vertex_type& v) {
+  best_vertex ret;
+  ret.vid = v.id();
+  for (size_t i = 0; i < v.data().rr.size(); ++i) {
+    ret.count += __builtin_popcountll(v.data().rr[i] & ~covered_sets[i]);
+  }
+  return ret;
+}
+
+struct rr_words {
+  std::vector<uint64_t> words;
+  rr_words& operator+=(const rr_words& other) {
+    if (words.size() < other.words.size()) words.resize(other.words.size(), 0);
+    for (size_t i = 0; i < other.words.size(); ++i) words[i] |= other.words[i];
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << words; }
+  void load(graphlab::iarchive& iarc) { iarc >> words; }
+};
+
+graphlab::vertex_id_type chosen_seed;
+
+rr_words chosen_sets(const graph_type::vertex_type& v) {
+  rr_words ret;
+  if (v.id() == chosen_seed) ret.words = v.data().rr;
+  return ret;
+}
+
+size_t total_samples = 0;
+
+size_t hits_of(const graph_type::vertex_type& v) {
+  return v.data().hits;
+}
+
+struct influence_writer {
+  std::string save_vertex(graph_type::vertex_type v) {
+    std::stringstream strm;
+    strm << v.id() << "\t" << double(v.data().hits) / total_samples << "\n";
+    return strm.str();
+  }
+  std::string save_edge (graph_type::edge_type e) { return ""; }
+};
+
+
 int main(int argc, char** argv) {
   srand((unsigned) time(0));
   // Initialize control plain using mpi
@@ -196,6 +437,9 @@ int main(int argc, char** argv) {
   double recovery = -1;
   double infection = -1;
   size_t iterations = -1;
+  size_t samples = 0;
+  size_t rr_samples = 0;
+  size_t num_seeds = 10;
 
   clopts.attach_option("graph", graph_dir, "The graph file. Required ");
   clopts.add_positional("graph");
@@ -211,6 +455,20 @@ int main(int argc, char** argv) {
 
   clopts.attach_option("iterations", iterations, "If set, will force the use of synchronous engine overriding any engine option set by the --engine parameter. Runs cascades for a fixed number of iterations. Also overrides the max_iterations option in the engine.");
 
+  clopts.attach_option("samples", samples, 
+                       "If set, estimates the probability that each vertex gets "
+                       "infected from the initially infected vertices with this "
+                       "many independent cascade samples, run 64 at a time. "
+                       "infection chance is the probability that an edge "
+                       "transmits, and recovery chance is not used.");
+  clopts.attach_option("rr_samples", rr_samples,
+                       "If set, generates this many reverse-reachable sets, 64 "
+                       "at a time, and greedily selects the seeds of largest "
+                       "estimated influence in the independent cascade model.");
+  clopts.attach_option("num_seeds", num_seeds, 
+                       "The number of seeds selected with rr_samples.");
+  clopts.attach_option("seed", rng_seed, "The seed of the edge coins.");
+
   if(!clopts.parse(argc, argv)) {
     dc.cout() << "Error in parsing command line arguments." << std::endl;
     return EXIT_FAILURE;
@@ -220,7 +478,8 @@ int main(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
-  if (recovery == -1) {
+  const bool batched = (samples > 0 || rr_samples > 0);
+  if (recovery == -1 && !batched) {
     dc.cout() << "Recovery chance not specified. Cannot continue";
     return EXIT_FAILURE;
   }
@@ -250,6 +509,56 @@ int main(int argc, char** argv) {
 
   dc.cout() << "#vertices: " << graph.num_vertices() << " #edges:" << graph.num_edges() << std::endl;
 
+  if (batched) {
+    graphlab::timer timer;
+    graphlab::graph_gather_apply<graph_type, sample_bits> 
+      engine(graph, gather_infections, apply_infections, clopts);
+    if (samples > 0) {
+      const size_t nbatches = (samples + 63) / 64;
+      total_samples = nbatches * 64;
+      for (current_batch = 0; current_batch < nbatches; ++current_batch) {
+        graph.transform_vertices(set_seed_samples);
+        simulate_batch(graph, engine);
+        graph.transform_vertices(count_hits);
+      }
+      const size_t total_hits = graph.map_reduce_vertices<size_t>(hits_of);
+      dc.cout() << "Expected number of infected vertices: " 
+                << double(total_hits) / total_samples << std::endl;
+    }
+    if (rr_samples > 0) {
+      const size_t nbatches = (rr_samples + 63) / 64;
+      for (current_batch = 0; current_batch < nbatches; ++current_batch) {
+        current_roots = graph.map_reduce_vertices<sample_roots>(root_candidate);
+        graph.transform_vertices(set_root_samples);
+        simulate_batch(graph, engine);
+        graph.transform_vertices(store_rr_sets);
+      }
+      covered_sets.assign(nbatches, 0);
+      size_t covered = 0;
+      for (size_t i = 0; i < num_seeds && i < graph.num_vertices(); ++i) {
+        best_vertex best = graph.map_reduce_vertices<best_vertex>(uncovered_count);
+        if (best.count == 0) break;
+        chosen_seed = best.vid;
+        rr_words sets = graph.map_reduce_vertices<rr_words>(chosen_sets);
+        for (size_t j = 0; j < sets.words.size(); ++j) covered_sets[j] |= sets.words[j];
+        covered += best.count;
+        dc.cout() << "Seed " << i << ": " << best.vid 
+                  << "\testimated influence " 
+                  << double(graph.num_vertices()) * covered / (nbatches * 64) 
+                  << std::endl;
+      }
+    }
+    dc.cout() << "Finished sampling in " << timer.current_time() << " seconds." << std::endl;
+    if (saveprefix != "" && samples > 0) {
+      graph.save(saveprefix, influence_writer(),
+         false,  // do not gzip
+         true,   //save vertices
+         false); // do not save edges 
+    }
+    graphlab::mpi_tools::finalize();
+    return EXIT_SUCCESS;
+  }
+
   graphlab::omni_engine<cascades> engine(dc, graph, execution_type, clopts);
 
   engine.signal_all();
@@ -20,21 +20,68 @@
 
 #include <graphlab.hpp>
 
+// The number of labels kept per vertex by the overlapping variant
+size_t max_labels = 1;
+
+/*
+ * A histogram of labels stored as an array sorted by label, so merging
+ * two histograms is a linear merge instead of tree inserts. Counts may
+ * be negative in a delta, and entries which reach zero are dropped.
+ */
 struct label_counter {
-  std::map<std::string, int> label_count;
+  typedef std::pair<std::string, int> entry_type;
+  std::vector<entry_type> label_count;
 
   label_counter() {
   }
+
+  label_counter(const std::string& label, int count) :
+    label_count(1, entry_type(label, count)) {
+  }
     
   label_counter& operator+=(const label_counter& other) { 
-    for ( std::map<std::string, int>::const_iterator iter = other.label_count.begin();
-              iter != other.label_count.end(); ++iter ) {
-            label_count[iter->first] += iter->second;
+    if (other.label_count.empty()) return *this;
+    if (label_count.empty()) { 
+      label_count = other.label_count;
+      return *this;
     }
-
+    std::vector<entry_type> merged;
+    merged.reserve(label_count.size() + other.label_count.size());
+    std::vector<entry_type>::const_iterator i = label_count.begin();
+    std::vector<entry_type>::const_iterator j = other.label_count.begin();
+    while (i != label_count.end() || j != other.label_count.end()) {
+      if (j == other.label_count.end() || 
+          (i != label_count.end() && i->first < j->first)) {
+        merged.push_back(*i++);
+      } else if (i == label_count.end() || j->first < i->first) {
+        merged.push_back(*j++);
+      } else {
+        if (i->second + j->second != 0) 
+          merged.push_back(entry_type(i->first, i->second + j->second));
+        ++i; ++j;
+      }
+    }
+    label_count.swap(merged);
     return *this; 
   }
 
+  /*
+   * The up to k most frequent labels, most frequent first. Ties go to
+   * the smallest label.
+   */
+  std::vector<std::string> top(size_t k) const {
+    std::vector<std::pair<int, size_t> > order;
+    for (size_t i = 0; i < label_count.size(); ++i) {
+      if (label_count[i].second > 0) 
+        order.push_back(std::make_pair(-label_count[i].second, i));
+    }
+    k = std::min(k, order.size());
+    std::partial_sort(order.begin(), order.begin() + k, order.end());
+    std::vector<std::string> ret;
+    for (size_t i = 0; i < k; ++i) ret.push_back(label_count[order[i].second].first);
+    return ret;
+  }
+
   void save(graphlab::oarchive& oarc) const {
     oarc << label_count;
   }
@@ -44,13 +91,30 @@ struct label_counter {
   }
 };
 
-// The vertex data is its label 
-typedef std::string vertex_data_type;
+/*
+ * The vertex data is its label, and with max_labels > 1 the most
+ * frequent labels of its neighborhood once the labels have converged.
+ */
+struct vertex_data_type {
+  std::string label;
+  std::vector<std::string> memberships;
+
+  vertex_data_type() { }
+  explicit vertex_data_type(const std::string& label) : label(label) { }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << label << memberships;
+  }
+
+  void load(graphlab::iarchive& iarc) {
+    iarc >> label >> memberships;
+  }
+};
 
 typedef label_counter gather_type;
  
 // The graph type is determined by the vertex and edge data types
-typedef graphlab::distributed_graph<std::string, graphlab::empty> graph_type;
+typedef graphlab::distributed_graph<vertex_data_type, graphlab::empty> graph_type;
 
 bool line_parser(graph_type& graph, const std::string& filename, const std::string& textline) {
   std::stringstream strm(textline);
@@ -60,7 +124,7 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   strm >> vid;
   strm >> label;
   // insert this vertex with its label 
-  graph.add_vertex(vid, label);
+  graph.add_vertex(vid, vertex_data_type(label));
   // while there are elements in the line, continue to read until we fail
   while(1){
     graphlab::vertex_id_type other_vid;
@@ -73,12 +137,20 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   return true;
 }
 
+/*
+ * Only the neighbors of a vertex whose label changed are signaled, and
+ * they are sent the change of their histogram as a delta: with the
+ * gather cache on (the default), a signaled vertex reuses its cached
+ * histogram instead of gathering all of its edges again.
+ */
 class labelpropagation :
-  public graphlab::ivertex_program<graph_type, gather_type>,
-  public graphlab::IS_POD_TYPE {
+  public graphlab::ivertex_program<graph_type, gather_type> {
     bool changed;
+    std::string old_label;
 
   public:
+    labelpropagation() : changed(false) { }
+
     edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
       return graphlab::ALL_EDGES;
     }
@@ -86,39 +158,25 @@ class labelpropagation :
     gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
       // figure out which data to get from the edge.
       bool isEdgeSource = (vertex.id() == edge.source().id());
-      std::string neighbor_label = isEdgeSource ? edge.target().data() : edge.source().data();
-
-      // make a label_counter and place the neighbor data in it
-      label_counter counter;
-      counter.label_count[neighbor_label] = 1;
-
+      const std::string& neighbor_label = 
+        isEdgeSource ? edge.target().data().label : edge.source().data().label;
 
       // gather_type is a label counter, so += will add neighbor counts to the
-      // label_count map.
-      return counter;
+      // sorted histogram.
+      return label_counter(neighbor_label, 1);
     }
 
     void apply(icontext_type& context, vertex_type& vertex, const gather_type& total) {
 
-      int maxCount = 0;
-
-      std::string maxLabel = vertex.data();
-
       // Figure out which label of the vertex's neighbors' labels is most common
-      for ( std::map<std::string, int>::const_iterator iter = total.label_count.begin();
-                iter != total.label_count.end(); ++iter ) {
-              if (iter->second > maxCount) {
-                maxCount = iter->second;
-                maxLabel = iter->first;
-              }
-      }
-
+      const std::vector<std::string> maxLabel = total.top(1);
       
       // if maxLabel differs to vertex data, mark vertex as changed and update
       // its data.
-      if ((vertex.data()).compare(maxLabel) != 0) {
+      if (!maxLabel.empty() && vertex.data().label != maxLabel[0]) {
         changed = true;
-        vertex.data() = maxLabel;
+        old_label = vertex.data().label;
+        vertex.data().label = maxLabel[0];
       } else {
         changed = false;
       }
@@ -135,15 +193,60 @@ class labelpropagation :
 
     void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
       bool isEdgeSource = (vertex.id() == edge.source().id());
+      const vertex_type other = isEdgeSource ? edge.target() : edge.source();
+      label_counter delta(old_label, -1);
+      delta += label_counter(vertex.data().label, 1);
+      context.post_delta(other, delta);
+      context.signal(other); 
+    }
+
+    void save(graphlab::oarchive& oarc) const {
+      oarc << changed << old_label;
+    }
+
+    void load(graphlab::iarchive& iarc) {
+      iarc >> changed >> old_label;
+    }
+  };
+
+/*
+ * Keeps the max_labels most frequent labels of the closed neighborhood of
+ * each vertex, for overlapping communities.
+ */
+class top_labels :
+  public graphlab::ivertex_program<graph_type, gather_type>,
+  public graphlab::IS_POD_TYPE {
+  public:
+    edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+      return graphlab::ALL_EDGES;
+    }
+
+    gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+      bool isEdgeSource = (vertex.id() == edge.source().id());
+      return label_counter(isEdgeSource ? edge.target().data().label : 
+                                          edge.source().data().label, 1);
+    }
 
-      context.signal(isEdgeSource ? edge.target() : edge.source()); 
+    void apply(icontext_type& context, vertex_type& vertex, const gather_type& total) {
+      label_counter counts(total);
+      counts += label_counter(vertex.data().label, 1);
+      vertex.data().memberships = counts.top(max_labels);
+    }
+
+    edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+      return graphlab::NO_EDGES;
     }
   };
 
 struct labelpropagation_writer {
   std::string save_vertex(graph_type::vertex_type v) {
     std::stringstream strm;
-    strm << v.id() << "\t" << v.data() << "\n";
+    strm << v.id() << "\t" << v.data().label;
+    for (size_t i = 0; i < v.data().memberships.size(); ++i) {
+      if (v.data().memberships[i] != v.data().label)
+        strm << "\t" << v.data().memberships[i];
+    }
+    strm << "\n";
     return strm.str();
   }
   std::string save_edge (graph_type::edge_type e) { return ""; }
@@ -168,6 +271,14 @@ int main(int argc, char** argv) {
   clopts.attach_option("saveprefix", saveprefix,
                        "If set, will save the resultant pagerank to a "
                        "sequence of files with prefix saveprefix");
+  bool use_cache = true;
+  clopts.attach_option("cache", use_cache,
+                       "If true, vertices keep their label histogram and "
+                       "neighbors only send its changes");
+  clopts.attach_option("max_labels", max_labels,
+                       "If larger than 1, also saves for each vertex up to "
+                       "this many most frequent labels of its neighborhood, "
+                       "for overlapping communities");
 
   if(!clopts.parse(argc, argv)) {
     dc.cout() << "Error in parsing command line arguments." << std::endl;
@@ -187,6 +298,7 @@ int main(int argc, char** argv) {
 
   dc.cout() << "#vertices: " << graph.num_vertices() << " #edges:" << graph.num_edges() << std::endl;
 
+  clopts.get_engine_args().set_option("use_cache", use_cache);
   graphlab::omni_engine<labelpropagation> engine(dc, graph, execution_type, clopts);
 
   engine.signal_all();
@@ -195,6 +307,12 @@ int main(int argc, char** argv) {
   const float runtime = engine.elapsed_seconds();
   dc.cout() << "Finished Running engine in " << runtime << " seconds." << std::endl;
 
+  if (max_labels > 1) {
+    graphlab::omni_engine<top_labels> top_engine(dc, graph, "synchronous", clopts);
+    top_engine.signal_all();
+    top_engine.start();
+  }
+
   if (saveprefix != "") {
     graph.save(saveprefix, labelpropagation_writer(),
        false,  // do not gzip
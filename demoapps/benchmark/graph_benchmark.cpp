@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * Runs a standard matrix of graph algorithms and engines on one graph
+ * and reports comparable numbers for every run, so that builds can be
+ * compared with each other.
+ *
+ * Each run is reported as a tab separated line with the columns of
+ * RESULT_HEADER. edges_per_sec_per_core counts every update as
+ * touching the average number of edges of a vertex, divided by the
+ * wall time and by the total number of cores. bytes_per_edge is the
+ * total number of bytes sent by all the machines divided by the number
+ * of edges, and peak_rss_mb is the largest peak resident set size of
+ * the machines.
+ *
+ * With --baseline, the runs are compared with the runs of the same
+ * algorithm and engine in an earlier results file, and the program
+ * fails if any run is slower than the baseline by more than
+ * --tolerance.
+ */
+
+#include <vector>
+#include <string>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <cmath>
+#include <sys/resource.h>
+
+#include <graphlab.hpp>
+#include <graphlab/engine/warp_graph_mapreduce.hpp>
+#include <graphlab/engine/warp_parfor_all_vertices.hpp>
+#include <graphlab/macros_def.hpp>
+
+// The vertex data is the rank, the component label or the distance
+typedef graphlab::distributed_graph<double, graphlab::empty> graph_type;
+
+const char* RESULT_HEADER = "algorithm\tengine\tvertices\tedges\tmachines\t"
+    "cores\tseconds\tupdates\tedges_per_sec_per_core\tbytes_per_edge\t"
+    "peak_rss_mb";
+
+double TOLERANCE = 1.0E-2;
+graphlab::vertex_id_type SOURCE = 0;
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                           Vertex programs                              */
+/*                                                                        */
+/**************************************************************************/
+
+void init_rank(graph_type::vertex_type& vertex) { vertex.data() = 1; }
+
+void init_label(graph_type::vertex_type& vertex) { vertex.data() = vertex.id(); }
+
+void init_distance(graph_type::vertex_type& vertex) {
+  vertex.data() = std::numeric_limits<double>::max();
+}
+
+class pagerank :
+  public graphlab::ivertex_program<graph_type, double>,
+  public graphlab::IS_POD_TYPE {
+  double last_change;
+public:
+  double gather(icontext_type& context, const vertex_type& vertex,
+                edge_type& edge) const {
+    return 0.85 / edge.source().num_out_edges() * edge.source().data();
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    const double newval = total + 0.15;
+    last_change = std::fabs(newval - vertex.data());
+    vertex.data() = newval;
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return last_change > TOLERANCE ? graphlab::OUT_EDGES : graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    context.signal(edge.target());
+  }
+}; // end of pagerank
+
+
+inline graph_type::vertex_type
+get_other_vertex(const graph_type::edge_type& edge,
+                 const graph_type::vertex_type& vertex) {
+  return vertex.id() == edge.source().id() ? edge.target() : edge.source();
+}
+
+/// A message whose sum is the minimum
+struct min_message : graphlab::IS_POD_TYPE {
+  double value;
+  explicit min_message(double value = std::numeric_limits<double>::max()) :
+      value(value) { }
+  min_message& operator+=(const min_message& other) {
+    value = std::min(value, other.value);
+    return *this;
+  }
+  /// smaller values first, for the priority schedulers
+  double priority() const { return -value; }
+};
+
+/**
+ * Propagates the smallest value over the edges in both directions,
+ * adding step on each edge. With step 0 it computes the connected
+ * components, and with step 1 the unweighted shortest paths.
+ */
+template <int Step>
+class min_propagation :
+  public graphlab::ivertex_program<graph_type, graphlab::empty, min_message>,
+  public graphlab::IS_POD_TYPE {
+  double received;
+  bool changed;
+public:
+  void init(icontext_type& context, const vertex_type& vertex,
+            const min_message& msg) {
+    received = msg.value;
+  }
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const graphlab::empty& empty) {
+    changed = received < vertex.data();
+    if (changed) vertex.data() = received;
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return changed ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = get_other_vertex(edge, vertex);
+    const double value = vertex.data() + Step;
+    if (value < other.data()) context.signal(other, min_message(value));
+  }
+}; // end of min_propagation
+
+typedef min_propagation<0> connected_components;
+typedef min_propagation<1> sssp;
+
+
+double warp_pagerank_map(graph_type::edge_type edge, graph_type::vertex_type other) {
+  return other.data() / other.num_out_edges();
+}
+
+void warp_pagerank(graph_type::vertex_type vertex) {
+  vertex.data() = 0.15 + 0.85 * 
+      graphlab::warp::map_reduce_neighborhood(vertex, graphlab::IN_EDGES,
+                                              warp_pagerank_map);
+}
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                             Measurements                               */
+/*                                                                        */
+/**************************************************************************/
+
+struct bench_result {
+  std::string algorithm, engine;
+  size_t updates;
+  double seconds;
+  size_t bytes_sent;
+};
+
+/// The largest peak resident set size of all the machines in MB
+double peak_rss_mb(graphlab::distributed_control& dc) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  std::vector<double> rss(dc.numprocs());
+  // ru_maxrss is in kilobytes on Linux
+  rss[dc.procid()] = usage.ru_maxrss / 1024.0;
+  dc.all_gather(rss);
+  return *std::max_element(rss.begin(), rss.end());
+}
+
+/// Signals the vertices a vertex program starts from
+template <typename VertexProgram>
+void signal_start(graphlab::iengine<VertexProgram>& engine) {
+  engine.signal_all();
+}
+
+template <>
+void signal_start<sssp>(graphlab::iengine<sssp>& engine) {
+  engine.signal(SOURCE, min_message(0));
+}
+
+template <typename VertexProgram>
+bench_result run_engine(graphlab::distributed_control& dc, graph_type& graph,
+                        const graphlab::command_line_options& clopts,
+                        const std::string& algorithm,
+                        const std::string& engine_type) {
+  graphlab::iengine<VertexProgram>* engine = NULL;
+  if (engine_type == "hybrid") {
+    engine = new graphlab::hybrid_engine<VertexProgram>(dc, graph, clopts);
+  } else {
+    engine = new graphlab::omni_engine<VertexProgram>(dc, graph, engine_type, clopts);
+  }
+  signal_start<VertexProgram>(*engine);
+  dc.full_barrier();
+  const size_t bytes_before = dc.bytes_sent();
+  graphlab::timer ti;
+  engine->start();
+  bench_result result;
+  result.algorithm = algorithm;
+  result.engine = engine_type;
+  result.seconds = ti.current_time();
+  result.updates = engine->num_updates();
+  result.bytes_sent = dc.bytes_sent() - bytes_before;
+  delete engine;
+  return result;
+}
+
+bench_result run_warp_pagerank(graphlab::distributed_control& dc, 
+                               graph_type& graph, size_t iterations) {
+  dc.full_barrier();
+  const size_t bytes_before = dc.bytes_sent();
+  graphlab::timer ti;
+  for (size_t i = 0; i < iterations; ++i) {
+    graphlab::warp::parfor_all_vertices(graph, warp_pagerank);
+  }
+  bench_result result;
+  result.algorithm = "pagerank";
+  result.engine = "warp";
+  result.seconds = ti.current_time();
+  result.updates = graph.num_vertices() * iterations;
+  result.bytes_sent = dc.bytes_sent() - bytes_before;
+  return result;
+}
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                              Reporting                                 */
+/*                                                                        */
+/**************************************************************************/
+
+/// edges_per_sec_per_core of each "algorithm\tengine" of a results file
+std::map<std::string, double> read_baseline(const std::string& fname) {
+  std::map<std::string, double> baseline;
+  std::ifstream fin(fname.c_str());
+  std::string line;
+  while (std::getline(fin, line)) {
+    std::vector<std::string> cols;
+    std::stringstream strm(line);
+    std::string col;
+    while (std::getline(strm, col, '\t')) cols.push_back(col);
+    if (cols.size() < 9 || cols[0] == "algorithm") continue;
+    baseline[cols[0] + "\t" + cols[1]] = atof(cols[8].c_str());
+  }
+  return baseline;
+}
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+
+  // Parse command line options -----------------------------------------------
+  graphlab::command_line_options clopts("Graph benchmark suite.");
+  std::string graph_dir;
+  std::string format = "snap";
+  size_t powerlaw = 1000000;
+  std::string algorithms = "pagerank,cc,sssp";
+  std::string engines = "sync,async,warp";
+  size_t warp_iterations = 10;
+  std::string results_file;
+  std::string baseline_file;
+  double tolerance = 0.1;
+  clopts.attach_option("graph", graph_dir,
+                       "The graph file. A synthetic power-law graph is used "
+                       "if not set.");
+  clopts.attach_option("format", format, "The graph file format");
+  clopts.attach_option("powerlaw", powerlaw,
+                       "The number of vertices of the synthetic graph");
+  clopts.attach_option("algorithms", algorithms,
+                       "Comma separated algorithms: pagerank, cc, sssp");
+  clopts.attach_option("engines", engines,
+                       "Comma separated engines: sync, async, hybrid, warp."
+                       " warp only runs pagerank.");
+  clopts.attach_option("tol", TOLERANCE, "The PageRank tolerance");
+  clopts.attach_option("source", SOURCE, "The source vertex of sssp");
+  clopts.attach_option("warp_iterations", warp_iterations,
+                       "The number of iterations of the warp PageRank");
+  clopts.attach_option("results", results_file,
+                       "Appends the results to this file");
+  clopts.attach_option("baseline", baseline_file,
+                       "A results file of an earlier build to compare with");
+  clopts.attach_option("tolerance", tolerance,
+                       "The slowdown from the baseline reported as a regression");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Build the graph ----------------------------------------------------------
+  graph_type graph(dc, clopts);
+  if (graph_dir.empty()) {
+    dc.cout() << "Loading a synthetic power-law graph with " << powerlaw 
+              << " vertices" << std::endl;
+    graph.load_synthetic_powerlaw(powerlaw);
+  } else {
+    graph.load_format(graph_dir, format);
+  }
+  graph.finalize();
+  dc.cout() << "#vertices: " << graph.num_vertices()
+            << " #edges:" << graph.num_edges() << std::endl;
+
+  std::vector<std::string> algorithm_list = graphlab::strsplit(algorithms, ",");
+  std::vector<std::string> engine_list = graphlab::strsplit(engines, ",");
+  std::vector<bench_result> results;
+  foreach(const std::string& algorithm, algorithm_list) {
+    foreach(const std::string& engine, engine_list) {
+      if (engine == "warp" && algorithm != "pagerank") continue;
+      dc.cout() << "Running " << algorithm << " on the " << engine 
+                << " engine" << std::endl;
+      if (algorithm == "pagerank") {
+        graph.transform_vertices(init_rank);
+        if (engine == "warp") {
+          results.push_back(run_warp_pagerank(dc, graph, warp_iterations));
+        } else {
+          results.push_back(run_engine<pagerank>(dc, graph, clopts, 
+                                                 algorithm, engine));
+        }
+      } else if (algorithm == "cc") {
+        graph.transform_vertices(init_label);
+        results.push_back(run_engine<connected_components>(dc, graph, clopts, 
+                                                           algorithm, engine));
+      } else if (algorithm == "sssp") {
+        graph.transform_vertices(init_distance);
+        results.push_back(run_engine<sssp>(dc, graph, clopts, 
+                                           algorithm, engine));
+      } else {
+        dc.cout() << "Unknown algorithm " << algorithm << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // Report -------------------------------------------------------------------
+  const double rss = peak_rss_mb(dc);
+  size_t nregressions = 0;
+  if (dc.procid() == 0) {
+    const double cores = double(clopts.get_ncpus()) * dc.numprocs();
+    const double edges_per_update = 
+        double(graph.num_edges()) / std::max<size_t>(graph.num_vertices(), 1);
+    std::map<std::string, double> baseline;
+    if (!baseline_file.empty()) baseline = read_baseline(baseline_file);
+    std::ofstream fout;
+    if (!results_file.empty()) {
+      bool exists = std::ifstream(results_file.c_str()).good();
+      fout.open(results_file.c_str(), std::ios::app);
+      if (!exists) fout << RESULT_HEADER << "\n";
+    }
+    std::cout << RESULT_HEADER << "\n";
+    foreach(const bench_result& r, results) {
+      std::stringstream strm;
+      const double edges_per_sec_per_core = 
+          r.updates * edges_per_update / std::max(r.seconds, 1e-9) / cores;
+      strm << r.algorithm << "\t" << r.engine << "\t" 
+           << graph.num_vertices() << "\t" << graph.num_edges() << "\t"
+           << dc.numprocs() << "\t" << cores << "\t" 
+           << r.seconds << "\t" << r.updates << "\t" 
+           << edges_per_sec_per_core << "\t"
+           << double(r.bytes_sent) / std::max<size_t>(graph.num_edges(), 1) << "\t"
+           << rss;
+      std::cout << strm.str() << "\n";
+      if (fout.is_open()) fout << strm.str() << "\n";
+      const std::string key = r.algorithm + "\t" + r.engine;
+      if (baseline.count(key) && 
+          edges_per_sec_per_core < (1 - tolerance) * baseline[key]) {
+        std::cout << "REGRESSION " << r.algorithm << " " << r.engine << ": "
+                  << edges_per_sec_per_core << " edges/sec/core, baseline "
+                  << baseline[key] << "\n";
+        ++nregressions;
+      }
+    }
+    std::cout.flush();
+  }
+  dc.broadcast(nregressions, dc.procid() == 0);
+  graphlab::mpi_tools::finalize();
+  return nregressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
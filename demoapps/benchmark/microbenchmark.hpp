@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * A small microbenchmark framework in the style of Google Benchmark.
+ *
+ * A benchmark is a function taking a microbenchmark::state, which runs
+ * the measured code while state.keep_running() returns true:
+ *
+ * \code
+ * void bm_push_back(graphlab::microbenchmark::state& state) {
+ *   std::vector<size_t> v;
+ *   while (state.keep_running()) v.push_back(state.range());
+ *   state.set_items_processed(state.iterations());
+ * }
+ * MICROBENCHMARK(bm_push_back)->range(8, 4096);
+ * \endcode
+ *
+ * The function is called with more and more iterations until a run
+ * lasts at least the minimum time. Local benchmarks only run on the
+ * first process. Benchmarks marked distributed() run on all the
+ * processes at once: the time of a run lasts until the full barrier
+ * which ends the run, so that it includes the messages still in
+ * flight, and is the time of the slowest process, so that all the
+ * processes agree on the number of iterations. The bytes and items
+ * processed are summed over the processes.
+ */
+
+#ifndef GRAPHLAB_DEMOAPPS_MICROBENCHMARK_HPP
+#define GRAPHLAB_DEMOAPPS_MICROBENCHMARK_HPP
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+  namespace microbenchmark {
+
+    const char* const RESULT_HEADER = "benchmark\targ\tprocesses\titerations\t"
+        "ns_per_iteration\tMB_per_sec\tMitems_per_sec";
+
+    /// The state of one run of a benchmark
+    class state {
+    public:
+      state(size_t max_iterations, size_t arg) :
+        max_iterations(max_iterations), iteration(0), arg(arg),
+        bytes(0), items(0), started(false), seconds(0) { }
+
+      /**
+       * Returns true while there are iterations left. The time is
+       * measured from the first call to the call returning false.
+       */
+      inline bool keep_running() {
+        if (__builtin_expect(!started, 0)) {
+          started = true;
+          ti.start();
+        }
+        if (iteration < max_iterations) {
+          ++iteration;
+          return true;
+        }
+        seconds = ti.current_time();
+        return false;
+      }
+
+      /// The argument of this run. See benchmark::arg()
+      size_t range() const { return arg; }
+
+      /// The number of iterations of this run
+      size_t iterations() const { return max_iterations; }
+
+      void set_bytes_processed(size_t b) { bytes = b; }
+
+      void set_items_processed(size_t i) { items = i; }
+
+      size_t bytes_processed() const { return bytes; }
+
+      size_t items_processed() const { return items; }
+
+      double elapsed_seconds() const { return seconds; }
+
+      /// The time since the first call to keep_running()
+      double seconds_since_start() const { return ti.current_time(); }
+
+    private:
+      size_t max_iterations, iteration, arg;
+      size_t bytes, items;
+      bool started;
+      timer ti;
+      double seconds;
+    }; // end of state
+
+
+    /// A registered benchmark function and its arguments
+    class benchmark {
+    public:
+      typedef void (*function_type)(state&);
+
+      benchmark(const std::string& name, function_type fn) :
+        name(name), fn(fn), is_distributed(false) { }
+
+      /// Adds a run with state.range() equal to a
+      benchmark* arg(size_t a) {
+        args.push_back(a);
+        return this;
+      }
+
+      /// Adds the runs lo, lo * multiplier, ... up to hi, and hi
+      benchmark* range(size_t lo, size_t hi, size_t multiplier = 8) {
+        ASSERT_GT(multiplier, 1);
+        for (size_t a = lo; a < hi; a *= multiplier) args.push_back(a);
+        args.push_back(hi);
+        return this;
+      }
+
+      /// Runs the benchmark on all the processes at once
+      benchmark* distributed() {
+        is_distributed = true;
+        return this;
+      }
+
+      std::string name;
+      function_type fn;
+      std::vector<size_t> args;
+      bool is_distributed;
+    }; // end of benchmark
+
+
+    /// Keeps the compiler from optimizing away the computation of value
+    template <typename T>
+    inline void do_not_optimize(const T& value) {
+      asm volatile("" : : "r"(&value) : "memory");
+    }
+
+
+    inline std::vector<benchmark*>& registry() {
+      static std::vector<benchmark*> benchmarks;
+      return benchmarks;
+    }
+
+    inline benchmark* register_benchmark(const std::string& name,
+                                         benchmark::function_type fn) {
+      registry().push_back(new benchmark(name, fn));
+      return registry().back();
+    }
+
+    /// Runs with more iterations are never more than this
+    const size_t MAX_ITERATIONS = 1000000000;
+
+    struct max_equal {
+      void operator()(double& a, const double& b) const { a = std::max(a, b); }
+    };
+
+    /**
+     * Runs the benchmarks whose name contains filter and prints a
+     * line with the columns of RESULT_HEADER for every argument on the
+     * first process. Must be called on all the processes.
+     */
+    inline void run_benchmarks(distributed_control& dc,
+                               const std::string& filter,
+                               double min_time,
+                               std::ostream& out) {
+      if (dc.procid() == 0) out << RESULT_HEADER << std::endl;
+      for (size_t b = 0; b < registry().size(); ++b) {
+        const benchmark& bm = *registry()[b];
+        if (bm.name.find(filter) == std::string::npos) continue;
+        if (!bm.is_distributed && dc.procid() != 0) continue;
+        std::vector<size_t> args = bm.args;
+        if (args.empty()) args.push_back(0);
+        for (size_t a = 0; a < args.size(); ++a) {
+          size_t iterations = 1;
+          while (true) {
+            state st(iterations, args[a]);
+            bm.fn(st);
+            double seconds = st.elapsed_seconds();
+            size_t bytes = st.bytes_processed(), items = st.items_processed();
+            if (bm.is_distributed) {
+              dc.full_barrier();
+              seconds = st.seconds_since_start();
+              dc.all_reduce2(seconds, max_equal());
+              dc.all_reduce(bytes);
+              dc.all_reduce(items);
+            }
+            if (seconds < min_time && iterations < MAX_ITERATIONS) {
+              // aim 40% past the minimum time, growing by a factor of
+              // 2 to 100
+              const double target = 1.4 * min_time / std::max(seconds, 1.0E-9);
+              iterations = size_t(iterations *
+                                  std::min(100.0, std::max(2.0, target)));
+              iterations = std::min(iterations, MAX_ITERATIONS);
+              continue;
+            }
+            if (dc.procid() == 0) {
+              out << bm.name << "\t" << args[a] << "\t"
+                  << (bm.is_distributed ? dc.numprocs() : 1) << "\t"
+                  << iterations << "\t" << 1.0E9 * seconds / iterations << "\t"
+                  << bytes / seconds / (1024 * 1024) << "\t"
+                  << items / seconds / 1.0E6 << std::endl;
+            }
+            break;
+          }
+        }
+      }
+    } // end of run_benchmarks
+
+  } // end of microbenchmark namespace
+} // end of graphlab namespace
+
+#define MICROBENCHMARK_CONCAT_IMPL(a, b) a##b
+#define MICROBENCHMARK_CONCAT(a, b) MICROBENCHMARK_CONCAT_IMPL(a, b)
+
+/// Registers the function fn as a benchmark named after it
+#define MICROBENCHMARK(fn)                                                \
+  static graphlab::microbenchmark::benchmark*                             \
+  MICROBENCHMARK_CONCAT(microbenchmark_, __LINE__) =                      \
+      graphlab::microbenchmark::register_benchmark(#fn, fn)
+
+#endif
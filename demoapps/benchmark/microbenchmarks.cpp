@@ -0,0 +1,505 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * Microbenchmarks of the serialization, RPC and exchange primitives and
+ * of the hash maps and bitsets, to compare builds without running a
+ * whole toolkit.
+ *
+ * The serialization, data structure and graph traversal benchmarks
+ * run on the first process. The RPC, exchange and collective benchmarks run on all the
+ * processes, so their latency can be compared between process counts
+ * by running on one node with, e.g.,
+ *
+ *   mpiexec -n 4 ./microbenchmarks --filter=all_reduce
+ *
+ * See microbenchmark.hpp for the columns of the output.
+ */
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include <graphlab.hpp>
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/rpc/fiber_buffered_exchange.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/util/cuckoo_map.hpp>
+#include "microbenchmark.hpp"
+#include <graphlab/macros_def.hpp>
+
+using graphlab::microbenchmark::state;
+using graphlab::microbenchmark::do_not_optimize;
+
+/// A multiplier making (i * STRIDE) % n visit the keys out of order
+const size_t STRIDE = 0x9e3779b97f4a7c15ULL;
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                            Serialization                               */
+/*                                                                        */
+/**************************************************************************/
+
+template <typename T>
+void bm_oarchive(state& st, const T& value, size_t bytes, bool compact) {
+  graphlab::oarchive oarc;
+  oarc.compact = compact;
+  while (st.keep_running()) {
+    oarc.reset();
+    oarc << value;
+    do_not_optimize(oarc.off);
+  }
+  st.set_bytes_processed(st.iterations() * bytes);
+  free(oarc.buf);
+}
+
+template <typename T>
+void bm_iarchive(state& st, const T& value, size_t bytes, bool compact) {
+  graphlab::oarchive oarc;
+  oarc.compact = compact;
+  oarc << value;
+  T out;
+  while (st.keep_running()) {
+    graphlab::iarchive iarc(oarc.buf, oarc.off);
+    iarc.compact = compact;
+    iarc >> out;
+    do_not_optimize(out);
+  }
+  st.set_bytes_processed(st.iterations() * bytes);
+  free(oarc.buf);
+}
+
+void oarchive_vector_double(state& st) {
+  bm_oarchive(st, std::vector<double>(st.range(), 1.0),
+              st.range() * sizeof(double), false);
+}
+MICROBENCHMARK(oarchive_vector_double)->range(8, 1 << 20);
+
+void iarchive_vector_double(state& st) {
+  bm_iarchive(st, std::vector<double>(st.range(), 1.0),
+              st.range() * sizeof(double), false);
+}
+MICROBENCHMARK(iarchive_vector_double)->range(8, 1 << 20);
+
+void oarchive_vector_size_t_compact(state& st) {
+  std::vector<size_t> v(st.range());
+  for (size_t i = 0; i < v.size(); ++i) v[i] = i;
+  bm_oarchive(st, v, st.range() * sizeof(size_t), true);
+}
+MICROBENCHMARK(oarchive_vector_size_t_compact)->range(8, 1 << 20);
+
+void iarchive_vector_size_t_compact(state& st) {
+  std::vector<size_t> v(st.range());
+  for (size_t i = 0; i < v.size(); ++i) v[i] = i;
+  bm_iarchive(st, v, st.range() * sizeof(size_t), true);
+}
+MICROBENCHMARK(iarchive_vector_size_t_compact)->range(8, 1 << 20);
+
+void oarchive_string(state& st) {
+  bm_oarchive(st, std::string(st.range(), 'x'), st.range(), false);
+}
+MICROBENCHMARK(oarchive_string)->range(8, 1 << 16);
+
+void iarchive_string(state& st) {
+  bm_iarchive(st, std::string(st.range(), 'x'), st.range(), false);
+}
+MICROBENCHMARK(iarchive_string)->range(8, 1 << 16);
+
+std::map<size_t, size_t> make_map(size_t n) {
+  std::map<size_t, size_t> m;
+  for (size_t i = 0; i < n; ++i) m[i] = i;
+  return m;
+}
+
+void oarchive_map(state& st) {
+  bm_oarchive(st, make_map(st.range()), 2 * st.range() * sizeof(size_t), false);
+}
+MICROBENCHMARK(oarchive_map)->range(8, 1 << 16);
+
+void iarchive_map(state& st) {
+  bm_iarchive(st, make_map(st.range()), 2 * st.range() * sizeof(size_t), false);
+}
+MICROBENCHMARK(iarchive_map)->range(8, 1 << 16);
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                     Hash maps and bitsets                              */
+/*                                                                        */
+/**************************************************************************/
+
+void dense_bitset_set_bit(state& st) {
+  const size_t n = st.range();
+  graphlab::dense_bitset bits(n);
+  size_t i = 0;
+  while (st.keep_running()) bits.set_bit((++i * STRIDE) % n);
+  st.set_items_processed(st.iterations());
+}
+MICROBENCHMARK(dense_bitset_set_bit)->range(1 << 10, 1 << 26);
+
+void dense_bitset_get(state& st) {
+  const size_t n = st.range();
+  graphlab::dense_bitset bits(n);
+  for (size_t i = 0; i < n; i += 3) bits.set_bit_unsync(i);
+  size_t i = 0, count = 0;
+  while (st.keep_running()) count += bits.get((++i * STRIDE) % n);
+  do_not_optimize(count);
+  st.set_items_processed(st.iterations());
+}
+MICROBENCHMARK(dense_bitset_get)->range(1 << 10, 1 << 26);
+
+void dense_bitset_popcount(state& st) {
+  graphlab::dense_bitset bits(st.range());
+  for (size_t i = 0; i < st.range(); i += 3) bits.set_bit_unsync(i);
+  size_t count = 0;
+  while (st.keep_running()) count += bits.popcount();
+  do_not_optimize(count);
+  st.set_bytes_processed(st.iterations() * st.range() / 8);
+}
+MICROBENCHMARK(dense_bitset_popcount)->range(1 << 10, 1 << 26);
+
+/// Each iteration builds a map of st.range() keys
+template <typename Map>
+void bm_map_insert(state& st, const Map& empty) {
+  const size_t n = st.range();
+  while (st.keep_running()) {
+    Map m(empty);
+    for (size_t i = 0; i < n; ++i) {
+      m.insert(std::make_pair(i * STRIDE, i));
+    }
+    do_not_optimize(m);
+  }
+  st.set_items_processed(st.iterations() * n);
+}
+
+/// Each iteration looks up one key in a map of st.range() keys
+template <typename Map>
+void bm_map_find(state& st, Map m) {
+  const size_t n = st.range();
+  for (size_t i = 0; i < n; ++i) m.insert(std::make_pair(i, i));
+  size_t i = 0, found = 0;
+  // half of the keys are missing
+  while (st.keep_running()) found += m.find((++i * STRIDE) % (2 * n)) != m.end();
+  do_not_optimize(found);
+  st.set_items_processed(st.iterations());
+}
+
+typedef graphlab::hopscotch_map<size_t, size_t> hopscotch_map_type;
+typedef graphlab::cuckoo_map<size_t, size_t> cuckoo_map_type;
+
+void hopscotch_map_insert(state& st) { bm_map_insert(st, hopscotch_map_type()); }
+MICROBENCHMARK(hopscotch_map_insert)->range(1 << 6, 1 << 20);
+
+void hopscotch_map_find(state& st) { bm_map_find(st, hopscotch_map_type()); }
+MICROBENCHMARK(hopscotch_map_find)->range(1 << 6, 1 << 20);
+
+void cuckoo_map_insert(state& st) { bm_map_insert(st, cuckoo_map_type(-1)); }
+MICROBENCHMARK(cuckoo_map_insert)->range(1 << 6, 1 << 20);
+
+void cuckoo_map_find(state& st) { bm_map_find(st, cuckoo_map_type(-1)); }
+MICROBENCHMARK(cuckoo_map_find)->range(1 << 6, 1 << 20);
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                           Graph traversal                              */
+/*                                                                        */
+/**************************************************************************/
+
+/// 64 bytes of vertex data of which the gather reads one field
+struct bench_vertex {
+  double value;
+  double unused[7];
+};
+
+typedef graphlab::local_graph<bench_vertex, graphlab::empty> bench_graph_type;
+
+typedef graphlab::dynamic_local_graph<bench_vertex, graphlab::empty>
+    bench_dynamic_graph_type;
+
+/**
+ * Adds degree in edges per vertex from uniformly random sources to a
+ * graph of nverts vertices, so nearly every neighbor access misses the
+ * cache.
+ */
+template <typename Graph>
+void add_low_locality_edges(Graph& graph, size_t nverts, size_t degree) {
+  for (size_t v = 0; v < nverts; ++v) {
+    for (size_t k = 0; k < degree; ++k) {
+      const size_t u = ((v * degree + k) * STRIDE) % nverts;
+      if (u != v) graph.add_edge(u, v);
+    }
+  }
+}
+
+const size_t LOW_LOCALITY_NVERTS = 1 << 20, LOW_LOCALITY_DEGREE = 16;
+
+/// A low locality graph of 2^20 vertices and 16 in edges per vertex
+bench_graph_type& low_locality_graph() {
+  static bench_graph_type* graph = NULL;
+  if (graph == NULL) {
+    graph = new bench_graph_type(LOW_LOCALITY_NVERTS);
+    add_low_locality_edges(*graph, LOW_LOCALITY_NVERTS, LOW_LOCALITY_DEGREE);
+    graph->finalize();
+  }
+  return *graph;
+}
+
+/// The same graph as low_locality_graph() in a dynamic_local_graph
+bench_dynamic_graph_type& low_locality_dynamic_graph() {
+  static bench_dynamic_graph_type* graph = NULL;
+  if (graph == NULL) {
+    graph = new bench_dynamic_graph_type(LOW_LOCALITY_NVERTS);
+    add_low_locality_edges(*graph, LOW_LOCALITY_NVERTS, LOW_LOCALITY_DEGREE);
+    graph->finalize();
+  }
+  return *graph;
+}
+
+/// Sums the data on the in neighbors of every vertex
+template <typename Graph>
+double gather_in_neighbors(Graph& graph) {
+  double total = 0;
+  const size_t nverts = graph.num_vertices();
+  for (graphlab::lvid_type v = 0; v < nverts; ++v) {
+    foreach(const typename Graph::edge_type& e, graph.in_edges(v)) {
+      total += e.source().data().value;
+    }
+  }
+  return total;
+}
+
+/**
+ * Each iteration sums the data on the in neighbors of every vertex,
+ * prefetching the data st.range() edges ahead and the edges of the
+ * next vertices as the synchronous engine does (0 disables
+ * prefetching, see the prefetch_distance engine option).
+ */
+void gather_low_locality(state& st) {
+  bench_graph_type& graph = low_locality_graph();
+  const size_t distance = st.range();
+  const size_t nverts = graph.num_vertices();
+  double total = 0;
+  while (st.keep_running()) {
+    for (graphlab::lvid_type v = 0; v < nverts; ++v) {
+      if (distance > 0) {
+        if (v + 2 < nverts) graph.prefetch_edge_index(v + 2);
+        if (v + 1 < nverts) graph.prefetch_edge_lists(v + 1);
+      }
+      bench_graph_type::neighbor_prefetcher prefetcher(graph, v, true, distance);
+      foreach(const bench_graph_type::edge_type& e, graph.in_edges(v)) {
+        prefetcher.next();
+        total += e.source().data().value;
+      }
+    }
+  }
+  do_not_optimize(total);
+  st.set_items_processed(st.iterations() * graph.num_edges());
+}
+MICROBENCHMARK(gather_low_locality)->arg(0)->arg(4)->arg(8)->arg(16)->arg(32);
+
+/**
+ * Each iteration sums the data on the in neighbors of every vertex of
+ * the low locality graph without prefetching, as the baseline of
+ * gather_dynamic_local_graph.
+ */
+void gather_local_graph(state& st) {
+  bench_graph_type& graph = low_locality_graph();
+  double total = 0;
+  while (st.keep_running()) total += gather_in_neighbors(graph);
+  do_not_optimize(total);
+  st.set_items_processed(st.iterations() * graph.num_edges());
+}
+MICROBENCHMARK(gather_local_graph);
+
+/**
+ * gather_local_graph on a dynamic_local_graph, over the linked blocks
+ * (0) or over the compacted adjacency (1), see set_compact_adjacency().
+ */
+void gather_dynamic_local_graph(state& st) {
+  bench_dynamic_graph_type& graph = low_locality_dynamic_graph();
+  graph.set_compact_adjacency(st.range() == 1);
+  double total = 0;
+  while (st.keep_running()) total += gather_in_neighbors(graph);
+  do_not_optimize(total);
+  st.set_items_processed(st.iterations() * graph.num_edges());
+}
+MICROBENCHMARK(gather_dynamic_local_graph)->arg(0)->arg(1);
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                      RPC, exchanges and collectives                    */
+/*                                                                        */
+/**************************************************************************/
+
+/// The distributed objects of the distributed benchmarks
+struct rpc_fixture {
+  graphlab::dc_dist_object<rpc_fixture> rmi;
+  graphlab::buffered_exchange<std::string> exchange;
+  graphlab::fiber_buffered_exchange<std::string> fiber_exchange;
+
+  rpc_fixture(graphlab::distributed_control& dc) :
+    rmi(dc, this), exchange(dc), fiber_exchange(dc) {
+    rmi.barrier();
+  }
+
+  size_t echo(size_t value) { return value; }
+
+  void receive(const std::string& message) { }
+};
+
+rpc_fixture* fixture = NULL;
+
+/// The process the first process sends to, the last one
+graphlab::procid_t peer() { return fixture->rmi.numprocs() - 1; }
+
+void remote_request_round_trip(state& st) {
+  size_t sum = 0;
+  if (fixture->rmi.procid() == 0) {
+    size_t i = 0;
+    while (st.keep_running()) {
+      sum += fixture->rmi.remote_request(peer(), &rpc_fixture::echo, ++i);
+    }
+    do_not_optimize(sum);
+  } else {
+    while (st.keep_running()) { }
+  }
+  st.set_items_processed(fixture->rmi.procid() == 0 ? st.iterations()
+                                                    : 0);
+}
+MICROBENCHMARK(remote_request_round_trip)->distributed();
+
+/// Every process sends st.range() bytes per iteration to the next
+void remote_call_throughput(state& st) {
+  const std::string message(st.range(), 'x');
+  const graphlab::procid_t target = 
+      (fixture->rmi.procid() + 1) % fixture->rmi.numprocs();
+  while (st.keep_running()) {
+    fixture->rmi.remote_call(target, &rpc_fixture::receive, message);
+  }
+  fixture->rmi.dc().flush();
+  st.set_bytes_processed(st.iterations() * st.range());
+  st.set_items_processed(st.iterations());
+}
+MICROBENCHMARK(remote_call_throughput)->range(8, 1 << 16)->distributed();
+
+/// Every process sends st.range() bytes per iteration, round robin
+void buffered_exchange_throughput(state& st) {
+  const std::string message(st.range(), 'x');
+  const size_t numprocs = fixture->rmi.numprocs();
+  size_t i = fixture->rmi.procid();
+  while (st.keep_running()) fixture->exchange.send(++i % numprocs, message);
+  fixture->exchange.flush();
+  graphlab::procid_t proc;
+  graphlab::buffered_exchange<std::string>::buffer_type buffer;
+  while (fixture->exchange.recv(proc, buffer)) { }
+  st.set_bytes_processed(st.iterations() * st.range());
+  st.set_items_processed(st.iterations());
+}
+MICROBENCHMARK(buffered_exchange_throughput)->range(8, 1 << 16)->distributed();
+
+void fiber_exchange_send(const std::string* message, size_t first, size_t n) {
+  const size_t numprocs = fixture->rmi.numprocs();
+  for (size_t i = first; i < first + n; ++i) {
+    fixture->fiber_exchange.send(i % numprocs, *message);
+  }
+  fixture->fiber_exchange.partial_flush();
+}
+
+/**
+ * Every process sends st.range() bytes per iteration, round robin, from
+ * one fiber per worker
+ */
+void fiber_buffered_exchange_throughput(state& st) {
+  const std::string message(st.range(), 'x');
+  // the state is not thread safe. The timing starts here.
+  size_t n = 0;
+  while (st.keep_running()) ++n;
+  const size_t nworkers = graphlab::fiber_control::get_instance().num_workers();
+  graphlab::fiber_group group;
+  for (size_t w = 0; w < nworkers; ++w) {
+    const size_t first = n * w / nworkers, last = n * (w + 1) / nworkers;
+    group.launch(boost::bind(fiber_exchange_send, &message, 
+                             first + fixture->rmi.procid(), last - first), w);
+  }
+  group.join();
+  fixture->fiber_exchange.flush();
+  graphlab::fiber_buffered_exchange<std::string>::recv_buffer_type buffer;
+  while (fixture->fiber_exchange.recv(buffer, false)) { }
+  st.set_bytes_processed(n * st.range());
+  st.set_items_processed(n);
+}
+MICROBENCHMARK(fiber_buffered_exchange_throughput)->range(8, 1 << 16)->distributed();
+
+void all_reduce_latency(state& st) {
+  size_t sum = 0;
+  while (st.keep_running()) {
+    size_t value = 1;
+    fixture->rmi.all_reduce(value);
+    sum += value;
+  }
+  do_not_optimize(sum);
+  st.set_items_processed(fixture->rmi.procid() == 0 ? st.iterations()
+                                                    : 0);
+}
+MICROBENCHMARK(all_reduce_latency)->distributed();
+
+void barrier_latency(state& st) {
+  while (st.keep_running()) fixture->rmi.barrier();
+  st.set_items_processed(fixture->rmi.procid() == 0 ? st.iterations() : 0);
+}
+MICROBENCHMARK(barrier_latency)->distributed();
+
+void full_barrier_latency(state& st) {
+  while (st.keep_running()) fixture->rmi.full_barrier();
+  st.set_items_processed(fixture->rmi.procid() == 0 ? st.iterations() : 0);
+}
+MICROBENCHMARK(full_barrier_latency)->distributed();
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+
+  graphlab::command_line_options clopts("RPC, serialization and data "
+                                        "structure microbenchmarks.");
+  std::string filter;
+  double min_time = 0.5;
+  clopts.attach_option("filter", filter,
+                       "Only runs the benchmarks whose name contains this");
+  clopts.attach_option("min_time", min_time,
+                       "The minimum time in seconds of a measured run");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  fixture = new rpc_fixture(dc);
+  graphlab::microbenchmark::run_benchmarks(dc, filter, min_time, std::cout);
+  dc.full_barrier();
+  delete fixture;
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+}
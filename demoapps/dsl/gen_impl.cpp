@@ -47,3 +47,10 @@ extern "C" void vertex_reduce(vertex_data_type& a, const vertex_data_type& b) {
     a += b;
 }
 
+// user_program is a gather-only sum, so it is also described as a sum_program
+static vertex_data_type sum_apply(vertex_data_type sum, vertex_data_type prev) {
+    return ALPHA*sum + (1-ALPHA);
+}
+
+extern "C" sum_program user_sum_program = { IN_EDGES, OUT_EDGES, sum_apply, 0.01 };
+
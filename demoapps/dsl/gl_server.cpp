@@ -130,6 +130,61 @@ void server_program(engine_type::context_type& context,
 
 
 
+// The compiled version of a user program described by a sum_program -----------
+sum_program* fused = NULL;
+
+/*
+ * Runs a sum_program on the synchronous engine: the neighbor sum is a 
+ * batch gather over the local edge arrays and the phases the program does
+ * not use are skipped.
+ */
+class fused_sum_program :
+  public ivertex_program<graph_type, vertex_data_type>,
+  public IS_POD_TYPE {
+  bool changed;
+ public:
+  fused_sum_program() : changed(false) { }
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return fused->gather_dir;
+  }
+
+  vertex_data_type gather(icontext_type& context, const vertex_type& vertex,
+                          edge_type& edge) const {
+    return edge.source().id() == vertex.id() ? 
+      edge.target().data() : edge.source().data();
+  }
+
+  bool gather_batch(icontext_type& context, const vertex_type& vertex,
+                    const local_edge_span_type& edges,
+                    vertex_data_type& accum) const {
+    vertex_data_type sum = 0;
+    for (size_t i = 0; i < edges.size(); ++i) sum += edges.neighbor_data(i);
+    accum += sum;
+    return true;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    const vertex_data_type prev = vertex.data();
+    vertex.data() = fused->apply(total, prev);
+    changed = std::fabs(vertex.data() - prev) > fused->signal_tolerance;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return changed ? fused->signal_dir : NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    context.signal(edge.source().id() == vertex.id() ? 
+                   edge.target() : edge.source());
+  }
+};
+
+
 void init_vertex(graph_type::vertex_type& vertex) { vertex.data() = 1; }
 
 int main(int argc, char** argv) {
@@ -157,6 +212,10 @@ int main(int argc, char** argv) {
   clopts.attach_option("saveprefix", saveprefix,
                        "If set, will save the resultant pagerank to a "
                        "sequence of files with prefix saveprefix");
+  bool use_fused = true;
+  clopts.attach_option("fused", use_fused,
+                       "If the user code exports a user_sum_program, run it "
+                       "as a compiled vertex program");
   //set single threaded
   //clopts.set_ncpus(1);
   if(!clopts.parse(argc, argv)) {
@@ -186,6 +245,7 @@ int main(int argc, char** argv) {
   assert(user_program != NULL);
   vertex_reduce = (void (*)(vertex_data_type&,const vertex_data_type&))dlsym(handle, "vertex_reduce");
   assert(vertex_reduce != NULL);
+  if (use_fused) fused = (sum_program*)dlsym(handle, "user_sum_program");
   // edge_reduce = (void (*)(edge_data_type&,const edge_data_type&))dlsym(handle, "edge_reduce");
   // assert(edge_reduce != NULL);
   dc.cout() << "Finished dynamic linking" << std::endl;
@@ -202,6 +262,16 @@ int main(int argc, char** argv) {
   // Initialize the vertex data
   graph.transform_vertices(init_vertex);
 
+  if (fused != NULL) {
+    dc.cout() << "Running the compiled sum program" << std::endl;
+    synchronous_engine<fused_sum_program> engine(dc, graph, clopts);
+    engine.signal_all();
+    engine.start();
+    dlclose(handle);
+    graphlab::mpi_tools::finalize();
+    return EXIT_SUCCESS;
+  }
+
     // Running The Engine -------------------------------------------------------
   engine_type engine(dc, graph, clopts);
 
@@ -81,6 +81,10 @@ int main(int argc, char** argv) {
   std::string saveprefix;
   clopts.attach_option("saveprefix", saveprefix,
                        "Prefix to save the output pagerank in");
+  size_t batch_latency = 0;
+  clopts.attach_option("batch_latency", batch_latency,
+                       "Microseconds to wait to coalesce the neighborhood "
+                       "requests to each machine. 0 disables batching");
 
   if(!clopts.parse(argc, argv)) {
     dc.cout() << "Error in parsing command line arguments." << std::endl;
@@ -94,6 +98,8 @@ int main(int argc, char** argv) {
   // must call finalize before querying the graph
   graph.finalize();
 
+  warp::set_request_batching(batch_latency);
+
   // Initialize the vertex data
   graph.transform_vertices(init_vertex);
 
@@ -115,6 +115,18 @@ int main(int argc, char ** argv) {
       std::cout << "10k reads in " << ti.current_time() << std::endl;
     }
 
+    if (dc.procid() == 0) {
+      std::cout << "Starting batched gets" << std::endl;
+
+      timer ti;
+      std::vector<std::string> keys;
+      for (size_t i = 0;i < NUMSTRINGS; ++i) keys.push_back(data[i].first);
+      ti.start();
+      std::vector<std::pair<bool, std::string> > ret = testdht.get_batch(keys);
+      for (size_t i = 0;i < NUMSTRINGS; ++i) assert(ret[i].first);
+      std::cout << "10k reads in " << ti.current_time() << std::endl;
+    }
+
     testdht.clear();
   }
   dc.barrier();
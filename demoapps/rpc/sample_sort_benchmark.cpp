@@ -0,0 +1,99 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/options/command_line_options.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+#include <graphlab/rpc/sample_sort.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/logger.hpp>
+using namespace graphlab;
+
+/*
+ * Sorts random 64 bit keys with distributed_sort and reports the
+ * throughput and the balance of the result. With --skew a fraction of
+ * the keys is set to the same value to exercise the splitter handling
+ * of repeated keys.
+ */
+int main(int argc, char** argv) {
+  mpi_tools::init(argc, argv);
+  size_t count = 10000000;
+  double skew = 0;
+  size_t nthreads = thread::cpu_count();
+  size_t oversampling = 32;
+  command_line_options clopts("Distributed sort benchmark.");
+  clopts.attach_option("count", count, "Number of keys per machine");
+  clopts.attach_option("skew", skew,
+                       "Fraction of the keys that are all the same value");
+  clopts.attach_option("threads", nthreads, "Number of sorting threads");
+  clopts.attach_option("oversampling", oversampling,
+                       "Number of samples per machine per splitter");
+  if (!clopts.parse(argc, argv)) return EXIT_FAILURE;
+
+  distributed_control dc;
+  srand(dc.procid() + 1);
+  std::vector<uint64_t> keys(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (double(rand()) / RAND_MAX < skew) keys[i] = 42;
+    else keys[i] = (uint64_t(rand()) << 32) | uint64_t(rand());
+  }
+
+  distributed_sort<uint64_t> sorter(dc, sample_sort_impl::identity_key<uint64_t>(),
+                                    nthreads, oversampling);
+  dc.full_barrier();
+  timer ti;
+  ti.start();
+  sorter.sort(keys);
+  dc.full_barrier();
+  const double runtime = ti.current_time();
+
+  // check the order within and across machines
+  for (size_t i = 1; i < keys.size(); ++i) ASSERT_LE(keys[i - 1], keys[i]);
+  std::vector<std::pair<size_t, std::pair<uint64_t, uint64_t> > >
+      ranges(dc.numprocs());
+  ranges[dc.procid()].first = keys.size();
+  if (!keys.empty()) ranges[dc.procid()].second =
+    std::make_pair(keys.front(), keys.back());
+  dc.all_gather(ranges);
+  size_t total = 0, largest = 0;
+  uint64_t last = 0;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    total += ranges[i].first;
+    largest = std::max(largest, ranges[i].first);
+    if (ranges[i].first == 0) continue;
+    ASSERT_LE(last, ranges[i].second.first);
+    last = ranges[i].second.second;
+  }
+  ASSERT_EQ(total, count * dc.numprocs());
+  if (dc.procid() == 0) {
+    std::cout << total << " keys sorted in " << runtime << "s: "
+              << double(total) / runtime / 1e6 << " M keys/s. "
+              << "Imbalance " << double(largest) * dc.numprocs() / total
+              << std::endl;
+  }
+  mpi_tools::finalize();
+}
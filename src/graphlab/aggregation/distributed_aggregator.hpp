@@ -136,6 +136,11 @@ namespace graphlab {
                  thread safe. */
       virtual void add_accumulator(imap_reduce_base* other) = 0;
       
+      /** \brief Sums the accumulator over all machines with a typed
+                 all_reduce. Every machine ends with the same value. */
+      virtual void all_reduce_accumulator(
+                      dc_dist_object<distributed_aggregator>& rmi) = 0;
+
       /** \brief Resets the accumulator */
       virtual void clear_accumulator() = 0;
       
@@ -262,6 +267,11 @@ namespace graphlab {
         lock.unlock();
       }
 
+      void all_reduce_accumulator(
+                      dc_dist_object<distributed_aggregator>& rmi) {
+        rmi.all_reduce(acc);
+      }
+
       void clear_accumulator() {
         acc.clear();
       }
@@ -286,8 +296,29 @@ namespace graphlab {
     };
     
 
-    std::map<std::string, imap_reduce_base*> aggregators;
-    std::map<std::string, float> aggregate_period;
+    /**
+     * The aggregators in registration order. The position of an
+     * aggregator in this list is its id. aggregator_keys and
+     * aggregate_period are indexed the same way, so that the periodic
+     * schedule never has to look anything up by name.
+     */
+    std::vector<imap_reduce_base*> aggregators;
+    std::vector<std::string> aggregator_keys;
+    /// The period in seconds of each aggregator. Negative if not periodic.
+    std::vector<float> aggregate_period;
+    /// Name to id lookup. Only used on calls which take a key.
+    std::map<std::string, size_t> aggregator_ids;
+    /// True for the aggregators requested with aggregate_fused()
+    std::vector<bool> fused;
+
+    /// Ids of the fused vertex and edge aggregators while the engine runs
+    std::vector<size_t> fused_vertex_ids, fused_edge_ids;
+    /**
+     * Per engine thread accumulators of the fused aggregators, indexed by
+     * thread and then by position in fused_vertex_ids (fused_edge_ids).
+     */
+    std::vector<std::vector<imap_reduce_base*> > fused_vertex_acc,
+                                                  fused_edge_acc;
 
     struct async_aggregator_state {
       /// Performs reduction of all local threads. On machine 0, also
@@ -307,7 +338,7 @@ namespace graphlab {
     /* annoyingly the mutable queue is a max heap when I need a min-heap
      * to track the next thing to activate. So we need to keep 
      *  negative priorities... */
-    mutable_queue<std::string, float> schedule;
+    mutable_queue<size_t, float> schedule;
     mutex schedule_lock;
     size_t ncpus;
 
@@ -378,8 +409,19 @@ namespace graphlab {
       }
     }
     
+    /// Stores a new aggregator under key. The key must not be in use.
+    void register_aggregator(const std::string& key, imap_reduce_base* mr) {
+      aggregator_ids[key] = aggregators.size();
+      aggregators.push_back(mr);
+      aggregator_keys.push_back(key);
+      aggregate_period.push_back(-1);
+      fused.push_back(false);
+    }
+
   public:
 
+    /// The id returned by find_aggregator() for keys which do not exist
+    static const size_t INVALID_AGGREGATOR = size_t(-1);
     
     distributed_aggregator(distributed_control& dc, 
                            graph_type& graph, 
@@ -397,18 +439,18 @@ namespace graphlab {
                                VertexMapperType map_function,
                                FinalizerType finalize_function) {
       if (key.length() == 0) return false;
-      if (aggregators.count(key) == 0) {
+      if (aggregator_ids.count(key) == 0) {
 
         if (rmi.procid() == 0) {
           // do a runtime type check
           test_vertex_mapper_type<ReductionType, VertexMapperType>(key);
         }
         
-        aggregators[key] = new map_reduce_type<ReductionType,
+        register_aggregator(key, new map_reduce_type<ReductionType,
                                                VertexMapperType,
                                                typename default_map_types<ReductionType>::edge_map_type,
                                                FinalizerType>(map_function, 
-                                                             finalize_function);
+                                                             finalize_function));
         return true;
       }
       else {
@@ -434,12 +476,12 @@ namespace graphlab {
       //typedef decltype(map_function(*context,graph.vertex(0))) ReductionType;
       typedef decltype(map_function(*context, graph.vertex(0))) ReductionType;
       if (key.length() == 0) return false;
-      if (aggregators.count(key) == 0) {
-        aggregators[key] = new map_reduce_type<ReductionType,
+      if (aggregator_ids.count(key) == 0) {
+        register_aggregator(key, new map_reduce_type<ReductionType,
                                                VertexMapperType,
                                                typename default_map_types<ReductionType>::edge_map_type,
                                                FinalizerType>(map_function, 
-                                                             finalize_function);
+                                                             finalize_function));
         return true;
       }
       else {
@@ -459,17 +501,17 @@ namespace graphlab {
                              EdgeMapperType map_function,
                              FinalizerType finalize_function) {
       if (key.length() == 0) return false;
-      if (aggregators.count(key) == 0) {
+      if (aggregator_ids.count(key) == 0) {
         if (rmi.procid() == 0) {
           // do a runtime type check
           test_edge_mapper_type<ReductionType, EdgeMapperType>(key);
         }
-        aggregators[key] = new map_reduce_type<ReductionType, 
+        register_aggregator(key, new map_reduce_type<ReductionType, 
                                             typename default_map_types<ReductionType>::vertex_map_type,
                                             EdgeMapperType, 
                                             FinalizerType>(map_function, 
                                                            finalize_function, 
-                                                           true);
+                                                           true));
         return true;
       }
       else {
@@ -496,13 +538,13 @@ namespace graphlab {
       // an edge_type is actually hard to get
       typedef decltype(map_function(*context, edge_type(graph.l_vertex(0).in_edges()[0]) )) ReductionType;
       if (key.length() == 0) return false;
-      if (aggregators.count(key) == 0) {
-        aggregators[key] = new map_reduce_type<ReductionType, 
+      if (aggregator_ids.count(key) == 0) {
+        register_aggregator(key, new map_reduce_type<ReductionType, 
                                             typename default_map_types<ReductionType>::vertex_map_type,
                                             EdgeMapperType, 
                                             FinalizerType>(map_function, 
                                                            finalize_function, 
-                                                           true);
+                                                           true));
         return true;
       }
       else {
@@ -512,17 +554,41 @@ namespace graphlab {
     }
 #endif
     
+    /**
+     * Returns the id of the aggregator registered under key, or
+     * INVALID_AGGREGATOR if there is none. Ids are assigned in
+     * registration order, so they agree across machines as long as all
+     * machines register the same aggregators in the same order.
+     */
+    size_t find_aggregator(const std::string& key) const {
+      std::map<std::string, size_t>::const_iterator iter =
+                                                  aggregator_ids.find(key);
+      if (iter == aggregator_ids.end()) return INVALID_AGGREGATOR;
+      else return iter->second;
+    }
+
     /**
      * \copydoc graphlab::iengine::aggregate_now
      */
     bool aggregate_now(const std::string& key) {
       ASSERT_MSG(graph.is_finalized(), "Graph must be finalized");
-      if (aggregators.count(key) == 0) {
+      const size_t id = find_aggregator(key);
+      if (id == INVALID_AGGREGATOR) {
         ASSERT_MSG(false, "Requested aggregator %s not found", key.c_str());
         return false;
       }
-      
-      imap_reduce_base* mr = aggregators[key];
+      return aggregate_now(id);
+    }
+
+    /**
+     * Runs the aggregator with the given id (see find_aggregator()).
+     * The accumulators are combined across machines with an all_reduce
+     * over the concrete reduction type.
+     */
+    bool aggregate_now(size_t id) {
+      ASSERT_MSG(graph.is_finalized(), "Graph must be finalized");
+      ASSERT_LT(id, aggregators.size());
+      imap_reduce_base* mr = aggregators[id];
       mr->clear_accumulator();
       // ok. now we perform reduction on local data in parallel
 #ifdef _OPENMP
@@ -562,29 +628,11 @@ namespace graphlab {
         delete localmr;
       }
       
-      std::vector<any> gathervec(rmi.numprocs());
-      gathervec[rmi.procid()] = mr->get_accumulator();
-      
-      rmi.gather(gathervec, 0);
-      
-      if (rmi.procid() == 0) {
-        // machine 0 aggregates the accumulators
-        // sums them together and broadcasts it
-        for (procid_t i = 1; i < rmi.numprocs(); ++i) {
-          mr->add_accumulator_any(gathervec[i]);
-        }
-        any val = mr->get_accumulator();
-        rmi.broadcast(val, true);
-      }
-      else {
-        // all other machines wait for the broadcast value
-        any val;
-        rmi.broadcast(val, false);
-        mr->set_accumulator_any(val);
-      }
+      // the root combines the accumulators and sends the result back
+      // down so that all machines finalize the same value
+      mr->all_reduce_accumulator(rmi);
       mr->finalize(*context);
       mr->clear_accumulator();
-      gathervec.clear();
       return true;
     }
     
@@ -595,10 +643,40 @@ namespace graphlab {
     bool aggregate_periodic(const std::string& key, float seconds) {
       rmi.barrier();
       if (seconds < 0) return false;
-      if (aggregators.count(key) == 0) return false;
-      else aggregate_period[key] = seconds;
+      const size_t id = find_aggregator(key);
+      if (id == INVALID_AGGREGATOR) return false;
+      aggregate_period[id] = seconds;
+      fused[id] = false;
       return true;
     }
+
+    /**
+     * \copydoc graphlab::iengine::aggregate_fused
+     */
+    bool aggregate_fused(const std::string& key) {
+      rmi.barrier();
+      const size_t id = find_aggregator(key);
+      if (id == INVALID_AGGREGATOR) return false;
+      // engines which cannot fuse run the aggregator on every tick
+      aggregate_period[id] = 0;
+      fused[id] = true;
+      return true;
+    }
+
+    /**
+     * \brief Registers a copy of each aggregator of other whose key is
+     * not registered here, with the same schedule. Used to carry the
+     * aggregators over when the execution moves to another engine.
+     */
+    void copy_aggregators(const distributed_aggregator& other) {
+      for (size_t i = 0; i < other.aggregators.size(); ++i) {
+        if (aggregator_ids.count(other.aggregator_keys[i])) continue;
+        register_aggregator(other.aggregator_keys[i], 
+                            other.aggregators[i]->clone_empty());
+        aggregate_period.back() = other.aggregate_period[i];
+        fused.back() = other.fused[i];
+      }
+    }
     
     /**
      * Performs aggregation on all keys registered with a period.
@@ -606,11 +684,8 @@ namespace graphlab {
      * aggregators are executed before engine execution.
      */
     void aggregate_all_periodic() {
-      typename std::map<std::string, float>::iterator iter =
-        aggregate_period.begin();
-      while (iter != aggregate_period.end()) { 
-        aggregate_now(iter->first);
-        ++iter;
+      for (size_t i = 0; i < aggregators.size(); ++i) {
+        if (aggregate_period[i] >= 0) aggregate_now(i);
       }
     }
     
@@ -623,37 +698,55 @@ namespace graphlab {
      *
      * \param [in] cpus Number of engine threads used. This is only necessary
      *                  if the asynchronous form is used.
+     * \param [in] fused_threads Number of engine threads which will call
+     *                  fused_map_vertex() and fused_map_edge(). If 0, the
+     *                  engine does not fuse and fused aggregators are
+     *                  scheduled like periodic aggregators with period 0.
      */
-    void start(size_t ncpus = 0) {
+    void start(size_t ncpus = 0, size_t fused_threads = 0) {
       rmi.barrier();
       schedule.clear();
       start_time = timer::approx_time_seconds();
-      typename std::map<std::string, float>::iterator iter =
-                                                    aggregate_period.begin();
-      while (iter != aggregate_period.end()) {
+      fused_vertex_ids.clear(); fused_edge_ids.clear();
+      for (size_t id = 0; id < aggregators.size(); ++id) {
+        if (fused_threads > 0 && fused[id]) {
+          if (aggregators[id]->is_vertex_map()) fused_vertex_ids.push_back(id);
+          else fused_edge_ids.push_back(id);
+        }
         // schedule is a max heap. To treat it like a min heap
         // I need to insert negative keys
-        schedule.push(iter->first, -iter->second);
-        ++iter;
+        else if (aggregate_period[id] >= 0) {
+          schedule.push(id, -aggregate_period[id]);
+        }
+      }
+      fused_vertex_acc.resize(fused_threads);
+      fused_edge_acc.resize(fused_threads);
+      for (size_t t = 0; t < fused_threads; ++t) {
+        for (size_t i = 0; i < fused_vertex_ids.size(); ++i) {
+          fused_vertex_acc[t].push_back(
+              aggregators[fused_vertex_ids[i]]->clone_empty());
+        }
+        for (size_t i = 0; i < fused_edge_ids.size(); ++i) {
+          fused_edge_acc[t].push_back(
+              aggregators[fused_edge_ids[i]]->clone_empty());
+        }
       }
       this->ncpus = ncpus;
 
       // now initialize the asyncronous reduction states
       if(ncpus > 0) {
-        iter = aggregate_period.begin();
-        while (iter != aggregate_period.end()) {
-          async_state[iter->first].local_count_down = (int)ncpus;
-          async_state[iter->first].distributed_count_down =
-                                                        (int)rmi.numprocs();
+        for (size_t id = 0; id < aggregators.size(); ++id) {
+          if (aggregate_period[id] < 0) continue;
+          if (fused_threads > 0 && fused[id]) continue;
+          async_aggregator_state& state = async_state[aggregator_keys[id]];
+          state.local_count_down = (int)ncpus;
+          state.distributed_count_down = (int)rmi.numprocs();
           
-          async_state[iter->first].per_thread_aggregation.resize(ncpus);
+          state.per_thread_aggregation.resize(ncpus);
           for (size_t i = 0; i < ncpus; ++i) {
-            async_state[iter->first].per_thread_aggregation[i] =
-                                    aggregators[iter->first]->clone_empty();
+            state.per_thread_aggregation[i] = aggregators[id]->clone_empty();
           }
-          async_state[iter->first].root_reducer =
-                                      aggregators[iter->first]->clone_empty();
-          ++iter;
+          state.root_reducer = aggregators[id]->clone_empty();
         }
       }
     }
@@ -681,7 +774,7 @@ namespace graphlab {
       std::string key;
       bool has_entry = false;
       if (!schedule.empty() && -schedule.top().second <= curtime) {
-        key = schedule.top().first;
+        key = aggregator_keys[schedule.top().first];
         has_entry = true;
         schedule.pop();
       }
@@ -836,7 +929,7 @@ namespace graphlab {
         // when is the next time we start. 
         // time is as an offset to start_time
         float next_time = timer::approx_time_seconds() + 
-                          aggregate_period[key] - start_time;
+                          aggregate_period[find_aggregator(key)] - start_time;
         logstream(LOG_INFO) << rmi.procid() << "Reschedule of " << key
                           << " at " << next_time << std::endl;
         rpc_schedule_key(key, next_time);
@@ -852,36 +945,101 @@ namespace graphlab {
      */
     void rpc_schedule_key(const std::string& key, float next_time) {
       schedule_lock.lock();
-      schedule.push(key, -next_time);
+      schedule.push(find_aggregator(key), -next_time);
       schedule_lock.unlock();
     }
 
     
+    /// True if there are fused vertex aggregators to feed
+    bool has_fused_vertex_aggregators() const {
+      return !fused_vertex_ids.empty();
+    }
+
+    /// True if there are fused edge aggregators to feed
+    bool has_fused_edge_aggregators() const {
+      return !fused_edge_ids.empty();
+    }
+
+    /**
+     * Called by engine thread thread_id on each vertex it applies, while
+     * the vertex is still in cache. Adds the vertex to the thread's
+     * accumulators of all fused vertex aggregators.
+     */
+    void fused_map_vertex(size_t thread_id,
+                          icontext_type& context, vertex_type& vertex) {
+      std::vector<imap_reduce_base*>& acc = fused_vertex_acc[thread_id];
+      for (size_t i = 0; i < acc.size(); ++i) {
+        acc[i]->perform_map_vertex(context, vertex);
+      }
+    }
+
+    /**
+     * Called by engine thread thread_id on each edge it scatters on.
+     * Adds the edge to the thread's accumulators of all fused edge
+     * aggregators.
+     */
+    void fused_map_edge(size_t thread_id,
+                        icontext_type& context, edge_type& edge) {
+      std::vector<imap_reduce_base*>& acc = fused_edge_acc[thread_id];
+      for (size_t i = 0; i < acc.size(); ++i) {
+        acc[i]->perform_map_edge(context, edge);
+      }
+    }
+
+    /**
+     * Combines the per thread accumulators of each fused aggregator,
+     * all_reduces them across machines and finalizes.
+     */
+    void finalize_fused() {
+      for (size_t i = 0; i < fused_vertex_ids.size(); ++i) {
+        imap_reduce_base* mr = aggregators[fused_vertex_ids[i]];
+        for (size_t t = 0; t < fused_vertex_acc.size(); ++t) {
+          mr->add_accumulator(fused_vertex_acc[t][i]);
+          fused_vertex_acc[t][i]->clear_accumulator();
+        }
+        mr->all_reduce_accumulator(rmi);
+        mr->finalize(*context);
+        mr->clear_accumulator();
+      }
+      for (size_t i = 0; i < fused_edge_ids.size(); ++i) {
+        imap_reduce_base* mr = aggregators[fused_edge_ids[i]];
+        for (size_t t = 0; t < fused_edge_acc.size(); ++t) {
+          mr->add_accumulator(fused_edge_acc[t][i]);
+          fused_edge_acc[t][i]->clear_accumulator();
+        }
+        mr->all_reduce_accumulator(rmi);
+        mr->finalize(*context);
+        mr->clear_accumulator();
+      }
+    }
+
     /**
      * If synchronous aggregation is desired, this function is
      * To be called simultaneously by one thread on each machine. 
      * This polls the schedule to see if there
      * is an aggregator which needs to be activated. If there is an aggregator 
      * to be started, this function will perform aggregation.
+     * The fused aggregators are finalized on every call.
      */ 
     void tick_synchronous() {
+      finalize_fused();
       // if timer has exceeded our top key
       float curtime = timer::approx_time_seconds() - start_time;
       rmi.broadcast(curtime, rmi.procid() == 0);
       // note that we do not call approx_time_seconds everytime
       // this ensures that each key will only be run at most once.
       // each time tick_synchronous is called.
-      std::vector<std::pair<std::string, float> > next_schedule;
+      std::vector<std::pair<size_t, float> > next_schedule;
       while(!schedule.empty() && -schedule.top().second <= curtime) {
-        std::string key = schedule.top().first;
-        aggregate_now(key);
+        const size_t id = schedule.top().first;
+        aggregate_now(id);
         schedule.pop();
         // when is the next time we start. 
         // time is as an offset to start_time
         float next_time = (timer::approx_time_seconds() + 
-                           aggregate_period[key] - start_time);
+                           aggregate_period[id] - start_time);
         rmi.broadcast(next_time, rmi.procid() == 0);
-        next_schedule.push_back(std::make_pair(key, -next_time));
+        next_schedule.push_back(std::make_pair(id, -next_time));
       }
 
       for (size_t i = 0;i < next_schedule.size(); ++i) {
@@ -896,13 +1054,8 @@ namespace graphlab {
     void stop() {
       schedule.clear();
       // clear the aggregators
-      {
-        typename std::map<std::string, imap_reduce_base*>::iterator iter =
-                                                          aggregators.begin();
-        while (iter != aggregators.end()) {
-          iter->second->clear_accumulator();
-          ++iter;
-        }
+      for (size_t i = 0; i < aggregators.size(); ++i) {
+        aggregators[i]->clear_accumulator();
       }
       // clear the asynchronous state
       {
@@ -920,16 +1073,24 @@ namespace graphlab {
         }
         async_state.clear();
       }
+      // clear the fused state
+      for (size_t t = 0; t < fused_vertex_acc.size(); ++t) {
+        for (size_t i = 0; i < fused_vertex_acc[t].size(); ++i) {
+          delete fused_vertex_acc[t][i];
+        }
+        for (size_t i = 0; i < fused_edge_acc[t].size(); ++i) {
+          delete fused_edge_acc[t][i];
+        }
+      }
+      fused_vertex_acc.clear(); fused_edge_acc.clear();
+      fused_vertex_ids.clear(); fused_edge_ids.clear();
     }
 
 
     std::set<std::string> get_all_periodic_keys() const {
-      typename std::map<std::string, float>::const_iterator iter =
-                                                    aggregate_period.begin();
       std::set<std::string> ret;
-      while (iter != aggregate_period.end()) {
-        ret.insert(iter->first);
-        ++iter;
+      for (size_t i = 0; i < aggregators.size(); ++i) {
+        if (aggregate_period[i] >= 0) ret.insert(aggregator_keys[i]);
       }
       return ret;
     }
@@ -1087,6 +1248,7 @@ namespace graphlab {
     
     
     ~distributed_aggregator() {
+      for (size_t i = 0; i < aggregators.size(); ++i) delete aggregators[i];
       delete context;
     }
   }; 
@@ -0,0 +1,280 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_ASYNC_CHECKPOINT_HPP
+#define GRAPHLAB_ASYNC_CHECKPOINT_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <boost/bind.hpp>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/util/hybrid_bitset.hpp>
+#include <graphlab/util/stl_util.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief Incremental checkpoints of the mutable state of a graph
+   * computation, written in the background.
+   *
+   * The graph structure never changes while an engine runs, so it is
+   * saved once with save_binary() to [prefix]structure_. Every
+   * checkpoint then only holds the local vertex data, the local edge
+   * data and the pending messages. save() serializes them into an
+   * in-memory copy and hands the copy to a writer thread, so the
+   * computation continues while the file is written. Only one write
+   * is in flight: the next save() first waits for the previous one.
+   *
+   * The checkpoints alternate between two files per machine,
+   * [prefix]ckpt0_[procid].bin and [prefix]ckpt1_[procid].bin, and
+   * each is written to a temporary file and renamed, so a crash
+   * during a write always leaves the previous checkpoint intact.
+   * restore() loads the latest iteration that every machine completed.
+   *
+   * To resume after a failure the graph must be loaded from
+   * [prefix]structure_ with load_binary() on the same number of
+   * machines, so that the local vertex and edge ids are the same.
+   */
+  template <typename GraphType, typename MessageType>
+  class async_checkpoint {
+  public:
+    typedef GraphType graph_type;
+    typedef MessageType message_type;
+
+    async_checkpoint(distributed_control& dc, graph_type& graph,
+                     const std::string& prefix) :
+      rmi(dc, this), graph(graph), prefix(prefix),
+      structure_saved(false), num_saved(0),
+      last_copy_time(0), last_write_time(0), writer(NULL) { }
+
+    ~async_checkpoint() { wait(); }
+
+    /// The prefix the structure is saved to
+    std::string structure_prefix() const { return prefix + "structure_"; }
+
+    /**
+     * Checkpoints the state after the given number of iterations.
+     * Returns once the state has been copied. Must be called on all
+     * machines. MessageArray is any array of message_type indexed by
+     * local vertex id.
+     */
+    template <typename MessageArray>
+    void save(size_t iteration, const MessageArray& messages,
+              const hybrid_bitset<lvid_type>& has_message) {
+      if (!structure_saved) {
+        graph.save_binary(structure_prefix());
+        structure_saved = true;
+      }
+      wait();
+      timer ti; ti.start();
+      oarchive oarc;
+      oarc << uint64_t(iteration)
+           << uint64_t(graph.num_local_vertices())
+           << uint64_t(graph.num_local_edges());
+      typename graph_type::local_graph_type& lgraph = graph.get_local_graph();
+      for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+        oarc << lgraph.vertex_data(lvid);
+      }
+      for (size_t eid = 0; eid < graph.num_local_edges(); ++eid) {
+        oarc << lgraph.edge_data(eid);
+      }
+      std::vector<lvid_type> signaled;
+      foreach(size_t lvid, has_message) signaled.push_back(lvid);
+      oarc << signaled;
+      for (size_t i = 0; i < signaled.size(); ++i) {
+        oarc << messages[signaled[i]];
+      }
+      last_copy_time = ti.current_time();
+      const std::string fname = file_name(num_saved % 2);
+      ++num_saved;
+      writer = new thread();
+      writer->launch(boost::bind(&async_checkpoint::write_file, this,
+                                fname, oarc.buf, oarc.off));
+    }
+
+    /// Waits until the last checkpoint is written
+    void wait() {
+      if (writer == NULL) return;
+      writer->join();
+      delete writer;
+      writer = NULL;
+    }
+
+    /**
+     * Loads the latest checkpoint completed by all machines into the
+     * graph, messages and has_message. Returns false, leaving
+     * everything unchanged, if there is no such checkpoint. Must be
+     * called on all machines.
+     */
+    template <typename MessageArray>
+    bool restore(size_t& iteration, MessageArray& messages,
+                 hybrid_bitset<lvid_type>& has_message) {
+      wait();
+      // the iterations of both slots on every machine, -1 if unusable
+      std::vector<std::vector<int64_t> > iterations(rmi.numprocs());
+      iterations[rmi.procid()].resize(2);
+      for (size_t slot = 0; slot < 2; ++slot) {
+        iterations[rmi.procid()][slot] = read_iteration(file_name(slot));
+      }
+      rmi.all_gather(iterations);
+      // the largest iteration checkpointed everywhere
+      int64_t best = -1;
+      for (size_t slot = 0; slot < 2; ++slot) {
+        const int64_t candidate = iterations[0][slot];
+        if (candidate <= best) continue;
+        bool everywhere = true;
+        for (size_t p = 1; p < iterations.size(); ++p) {
+          everywhere = everywhere && (iterations[p][0] == candidate ||
+                                      iterations[p][1] == candidate);
+        }
+        if (everywhere) best = candidate;
+      }
+      if (best < 0) return false;
+      const size_t slot = (iterations[rmi.procid()][0] == best) ? 0 : 1;
+      const std::string fname = file_name(slot);
+      std::ifstream fin(fname.c_str(), std::ios_base::in | std::ios_base::binary);
+      // skip the magic and the length, checked by read_iteration()
+      fin.seekg(8 + sizeof(uint64_t));
+      iarchive iarc(fin);
+      uint64_t iter, nverts, nedges;
+      iarc >> iter >> nverts >> nedges;
+      typename graph_type::local_graph_type& lgraph = graph.get_local_graph();
+      for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+        iarc >> make_soa_lvalue(lgraph.vertex_data(lvid)).get();
+      }
+      for (size_t eid = 0; eid < graph.num_local_edges(); ++eid) {
+        iarc >> make_soa_lvalue(lgraph.edge_data(eid)).get();
+      }
+      std::vector<lvid_type> signaled;
+      iarc >> signaled;
+      has_message.clear();
+      for (size_t i = 0; i < signaled.size(); ++i) {
+        iarc >> messages[signaled[i]];
+        has_message.set_bit(signaled[i]);
+      }
+      if (!fin.good()) {
+        logstream(LOG_FATAL) << "Error reading checkpoint " << fname << std::endl;
+      }
+      iteration = best;
+      // the next checkpoint must not overwrite the one just restored
+      num_saved = slot + 1;
+      rmi.barrier();
+      return true;
+    }
+
+    /// Removes the checkpoint files of this machine, keeping the structure
+    void remove() {
+      wait();
+      for (size_t slot = 0; slot < 2; ++slot) {
+        std::remove(file_name(slot).c_str());
+      }
+    }
+
+    /// The time in seconds the computation was stopped by the last save()
+    double copy_time() const { return last_copy_time; }
+
+    /// The time in seconds taken by the last background write
+    double write_time() const { return last_write_time; }
+
+  private:
+    dc_dist_object<async_checkpoint> rmi;
+    graph_type& graph;
+    std::string prefix;
+    bool structure_saved;
+    size_t num_saved;
+    double last_copy_time;
+    double last_write_time;
+    /// The thread writing the last checkpoint, if not yet joined
+    thread* writer;
+
+    static const char* magic() { return "GLCKPT01"; }
+
+    std::string file_name(size_t slot) const {
+      return prefix + "ckpt" + tostr(slot) + "_" + tostr(rmi.procid()) + ".bin";
+    }
+
+    /// Writes and frees the buffer. The checkpoint appears atomically.
+    void write_file(std::string fname, char* buf, size_t len) {
+      timer ti; ti.start();
+      const std::string tmpname = fname + ".tmp";
+      std::ofstream fout(tmpname.c_str(), std::ios_base::out |
+                         std::ios_base::binary | std::ios_base::trunc);
+      fout.write(magic(), 8);
+      const uint64_t length = len;
+      fout.write(reinterpret_cast<const char*>(&length), sizeof(length));
+      fout.write(buf, len);
+      fout.close();
+      free(buf);
+      if (fout.fail() || std::rename(tmpname.c_str(), fname.c_str()) != 0) {
+        logstream(LOG_ERROR) << "Error writing checkpoint " << fname << std::endl;
+        std::remove(tmpname.c_str());
+        return;
+      }
+      last_write_time = ti.current_time();
+    }
+
+    /**
+     * Returns the iteration of a complete checkpoint of this graph in
+     * fname, or -1.
+     */
+    int64_t read_iteration(const std::string& fname) const {
+      std::ifstream fin(fname.c_str(), std::ios_base::in | std::ios_base::binary);
+      std::string m(8, '\0');
+      uint64_t length = 0;
+      if (!fin.read(&m[0], 8) || m != magic() ||
+          !fin.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+        return -1;
+      }
+      const std::streampos begin = fin.tellg();
+      fin.seekg(0, std::ios_base::end);
+      if (uint64_t(fin.tellg() - begin) != length) return -1;
+      fin.seekg(begin);
+      iarchive iarc(fin);
+      uint64_t iter, nverts, nedges;
+      iarc >> iter >> nverts >> nedges;
+      if (nverts != graph.num_local_vertices() ||
+          nedges != graph.num_local_edges()) {
+        logstream(LOG_WARNING) << "Checkpoint " << fname
+                               << " does not match the graph" << std::endl;
+        return -1;
+      }
+      return int64_t(iter);
+    }
+  }; // end of async_checkpoint
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+#endif
@@ -27,10 +27,14 @@
 #define GRAPHLAB_ASYNC_CONSISTENT_ENGINE
 
 #include <deque>
+#include <algorithm>
 #include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <graphlab/scheduler/ischeduler.hpp>
 #include <graphlab/scheduler/scheduler_factory.hpp>
+#include <graphlab/engine/schedule_trace.hpp>
+#include <graphlab/engine/update_trace.hpp>
 #include <graphlab/scheduler/get_message_priority.hpp>
 #include <graphlab/vertex_program/ivertex_program.hpp>
 #include <graphlab/vertex_program/icontext.hpp>
@@ -48,7 +52,9 @@
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/parallel/fiber_group.hpp>
 #include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/parallel/fiber_profiler.hpp>
 #include <graphlab/rpc/fiber_async_consensus.hpp>
+#include <graphlab/engine/fiber_population_control.hpp>
 #include <graphlab/aggregation/distributed_aggregator.hpp>
 #include <graphlab/parallel/fiber_remote_request.hpp>
 #include <graphlab/macros_def.hpp>
@@ -200,6 +206,53 @@ namespace graphlab {
    * increases in throughput at a consistency penalty.
    * \li \b nfibers (default: 10000) Number of fibers to use
    * \li \b stacksize (default: 16384) Stacksize of each fiber.
+   * \li \b sched_batch (default: 1) Number of vertices a fiber takes
+   * from the scheduler at a time. Larger values amortize the scheduler
+   * synchronization, at the cost of fewer fibers hiding the latency of
+   * remote locks.
+   * \li \b adaptive_fibers (default: false) Let the engine vary the
+   * number of fibers taking tasks between min_fibers and nfibers, based on
+   * the fraction of fibers blocked inside a task and on the task latency.
+   * Changes are logged.
+   * \li \b min_fibers (default: 100) Lower limit for adaptive_fibers.
+   * \li \b optimistic (default: false) Run without the distributed locks.
+   * Each update gathers against versioned vertex data, checks at apply
+   * that no vertex it read has changed, and gathers again on a conflict.
+   * Only vertex data is versioned. Edge data is protected just as in
+   * factorized mode. Best for low contention workloads such as SGD on
+   * sparse rating graphs. Implies factorized.
+   * \li \b shared_gather (default: false) Gathers take shared (read) locks
+   * on the two vertices of each edge, so that concurrent gathers around a
+   * high degree vertex, on the master and on the mirrors, no longer
+   * serialize. Apply and scatter still take exclusive locks. The gather
+   * must then not modify the edge data.
+   * \li \b schedule_trace (default: none) The file name prefix of a
+   * schedule trace. Each machine records or replays the order in which
+   * its fibers take vertices, and the order of the lock grants, in
+   * [prefix].[procid], so that performance comparisons between two
+   * builds run the same work in the same order. See
+   * graphlab::schedule_trace. The replay needs the same graph, number
+   * of machines and nfibers, and should not use adaptive_fibers.
+   * \li \b schedule_mode (default: record) Whether to record or replay
+   * the schedule_trace.
+   * \li \b update_trace (default: none) The file machine 0 writes the
+   * stages of a sample of the updates to, in the Chrome trace event
+   * format: the wait from the signal to the update, the lock
+   * acquisition, init, gather, apply and scatter on the master, and the
+   * gathers and scatters of the mirrors, which receive the trace id
+   * with the requests. See graphlab::update_trace.
+   * \li \b update_trace_rate (default: 0.001) The probability that a
+   * signal to a master is traced.
+   * \li \b update_trace_spans (default: 1000000) The largest number of
+   * spans recorded by a machine.
+   * \li \b signal_batch (default: 128) Signals from fibers to vertices
+   * mastered by other machines are buffered per worker thread and per
+   * machine, combining the messages to the same vertex with +=. A buffer
+   * is sent in a single call once it holds this many vertices, or
+   * once signal_latency has passed. 0 sends every signal on its own.
+   * Signals are never buffered in the endgame.
+   * \li \b signal_latency (default: 1000) The longest a buffered signal
+   * waits before it is sent, in microseconds.
    */
   template<typename VertexProgram>
   class async_consistent_engine: public iengine<VertexProgram> {
@@ -329,11 +382,35 @@ namespace graphlab {
     distributed_chandy_misra<graph_type>* cmlocks;
 
     /// Per vertex data locks
-    std::vector<simple_spinlock> vertexlocks;
+    /**
+     * Per vertex data locks. Gathers share them if shared_gather is set,
+     * everything else takes them exclusively.
+     */
+    std::vector<spinrwlock> vertexlocks;
 
     /// Total update function completion time
     std::vector<double> total_completion_time;
 
+    /// engine option. The vertices buffered per machine before the
+    /// signals are sent. 0 disables buffering
+    size_t signal_batch;
+    /// engine option. The longest a buffered signal waits in microseconds
+    size_t signal_latency;
+
+    /**
+     * The signals to other machines buffered by the fibers of one
+     * worker thread, combined by vertex.
+     */
+    struct signal_buffer {
+      mutex lock;
+      std::vector<boost::unordered_map<vertex_id_type, message_type> > pending;
+      size_t npending;
+      /// When the buffer was last sent, from timer::usec_of_day()
+      size_t last_flush;
+      signal_buffer() : npending(0), last_flush(0) { }
+    };
+    std::vector<signal_buffer> signal_buffers;
+
     /**
      * \brief This optional vector contains caches of previous gather
      * contributions for each machine.
@@ -366,6 +443,19 @@ namespace graphlab {
     size_t stacksize;
     /// Number of fibers
     size_t nfibers;
+    /// engine option. Vary the number of fibers taking tasks
+    bool adaptive_fibers;
+    /// Lower limit on the number of fibers taking tasks if adaptive_fibers
+    size_t min_fibers;
+    /// Decides which fibers take tasks
+    fiber_population_control population;
+    /// Number of vertices taken from the scheduler at a time
+    size_t sched_batch;
+    /**
+     * The vertices taken from the scheduler and not yet run by each
+     * fiber, in reverse order
+     */
+    std::vector<std::vector<lvid_type> > sched_buffer;
     /// set to true if engine is started
     bool started;
 
@@ -399,6 +489,35 @@ namespace graphlab {
     /// engine option. Sets to true if factorized consistency is used
     bool factorized_consistency;
 
+    /// engine option. Sets to true if gathers only take read locks
+    bool shared_gather;
+
+    /// engine option. Sets to true if gathers are validated optimistically
+    bool optimistic;
+
+    /// engine option. The file name prefix of the schedule trace
+    std::string schedule_trace_prefix;
+    /// Records or replays the schedule if schedule_trace_prefix is set
+    schedule_trace trace;
+
+    /// engine option. The file the update trace is written to
+    std::string update_trace_file;
+    /// engine option. The probability that a signal is traced
+    double update_trace_rate;
+    /// engine option. The largest number of spans kept by a machine
+    size_t update_trace_spans;
+    /// Records the sampled updates if update_trace_file is set
+    update_trace tracer;
+
+    /**
+     * Only used in optimistic mode. Incremented (under vertexlocks) on
+     * every write to the vertex data, including mirror updates.
+     */
+    std::vector<uint32_t> vertex_version;
+
+    /// Number of gathers repeated because a vertex changed underneath them
+    atomic<uint64_t> optimistic_conflicts;
+
     bool endgame_mode;
 
     /// Time when engine is started
@@ -444,15 +563,28 @@ namespace graphlab {
       rmi.barrier();
 
       nfibers = 10000;
+      adaptive_fibers = false;
+      min_fibers = 100;
+      sched_batch = 1;
       stacksize = 16384;
       use_cache = false;
       factorized_consistency = true;
+      optimistic = false;
+      shared_gather = false;
       track_task_time = false;
+      signal_batch = 128;
+      signal_latency = 1000;
+      update_trace_rate = 0.001;
+      update_trace_spans = 1000000;
       timed_termination = (size_t)(-1);
       termination_reason = execution_status::UNSET;
       set_options(opts);
       init();
       total_completion_time.resize(fiber_control::get_instance().num_workers());
+      signal_buffers.resize(fiber_control::get_instance().num_workers());
+      for (size_t i = 0; i < signal_buffers.size(); ++i) {
+        signal_buffers[i].pending.resize(rmi.numprocs());
+      }
       init();
       rmi.barrier();
     }
@@ -484,6 +616,14 @@ namespace graphlab {
           opts.get_engine_args().get_option("factorized", factorized_consistency);
           if (rmi.procid() == 0)
             logstream(LOG_EMPH) << "Engine Option: factorized = " << factorized_consistency << std::endl;
+        } else if (opt == "shared_gather") {
+          opts.get_engine_args().get_option("shared_gather", shared_gather);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: shared_gather = " << shared_gather << std::endl;
+        } else if (opt == "optimistic") {
+          opts.get_engine_args().get_option("optimistic", optimistic);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: optimistic = " << optimistic << std::endl;
         } else if (opt == "nfibers") {
           opts.get_engine_args().get_option("nfibers", nfibers);
           if (rmi.procid() == 0)
@@ -492,10 +632,55 @@ namespace graphlab {
           opts.get_engine_args().get_option("track_task_time", track_task_time);
           if (rmi.procid() == 0)
             logstream(LOG_EMPH) << "Engine Option: track_task_time = " << track_task_time<< std::endl;
-        }else if (opt == "stacksize") {
+        } else if (opt == "sched_batch") {
+          opts.get_engine_args().get_option("sched_batch", sched_batch);
+          if (sched_batch == 0) {
+            logstream(LOG_FATAL) << "sched_batch must be positive" << std::endl;
+          }
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: sched_batch = " << sched_batch << std::endl;
+        } else if (opt == "adaptive_fibers") {
+          opts.get_engine_args().get_option("adaptive_fibers", adaptive_fibers);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: adaptive_fibers = " << adaptive_fibers << std::endl;
+        } else if (opt == "min_fibers") {
+          opts.get_engine_args().get_option("min_fibers", min_fibers);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: min_fibers = " << min_fibers << std::endl;
+        } else if (opt == "stacksize") {
           opts.get_engine_args().get_option("stacksize", stacksize);
           if (rmi.procid() == 0)
             logstream(LOG_EMPH) << "Engine Option: stacksize= " << stacksize << std::endl;
+        } else if (opt == "schedule_trace") {
+          opts.get_engine_args().get_option("schedule_trace", schedule_trace_prefix);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: schedule_trace = " << schedule_trace_prefix << std::endl;
+        } else if (opt == "schedule_mode") {
+          std::string mode;
+          opts.get_engine_args().get_option("schedule_mode", mode);
+          trace.set_mode(schedule_trace::parse_mode(mode));
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: schedule_mode = " << mode << std::endl;
+        } else if (opt == "update_trace") {
+          opts.get_engine_args().get_option("update_trace", update_trace_file);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: update_trace = " << update_trace_file << std::endl;
+        } else if (opt == "update_trace_rate") {
+          opts.get_engine_args().get_option("update_trace_rate", update_trace_rate);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: update_trace_rate = " << update_trace_rate << std::endl;
+        } else if (opt == "update_trace_spans") {
+          opts.get_engine_args().get_option("update_trace_spans", update_trace_spans);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: update_trace_spans = " << update_trace_spans << std::endl;
+        } else if (opt == "signal_batch") {
+          opts.get_engine_args().get_option("signal_batch", signal_batch);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: signal_batch = " << signal_batch << std::endl;
+        } else if (opt == "signal_latency") {
+          opts.get_engine_args().get_option("signal_latency", signal_latency);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: signal_latency = " << signal_latency << std::endl;
         } else if (opt == "use_cache") {
           opts.get_engine_args().get_option("use_cache", use_cache);
           if (rmi.procid() == 0)
@@ -504,6 +689,13 @@ namespace graphlab {
           logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
         }
       }
+      // optimistic execution replaces the distributed locks
+      if (optimistic) factorized_consistency = true;
+      if (schedule_trace_prefix.empty()) {
+        trace.set_mode(schedule_trace::OFF);
+      } else if (!trace.replaying()) {
+        trace.set_mode(schedule_trace::RECORD);
+      }
       opts_copy = opts;
       // set a default scheduler if none
       if (opts_copy.get_scheduler_type() == "") {
@@ -553,6 +745,13 @@ namespace graphlab {
       if (!factorized_consistency) {
         cm_handles.resize(graph.num_local_vertices());
       }
+      if (optimistic) {
+        vertex_version.resize(graph.num_local_vertices(), 0);
+      }
+      if (!update_trace_file.empty()) {
+        tracer.init(rmi.procid(), graph.num_local_vertices(),
+                    update_trace_rate, update_trace_spans);
+      }
       rmi.barrier();
     }
 
@@ -573,6 +772,14 @@ namespace graphlab {
       return programs_executed.value;
     }
 
+    /**
+     * \brief Returns the number of gathers repeated in the last run
+     * because of a conflict. Always 0 unless the optimistic option is set.
+     */
+    size_t num_conflicts() const {
+      return optimistic_conflicts.value;
+    }
+
 
 
 
@@ -603,6 +810,7 @@ namespace graphlab {
                             const message_type& message) {
       if (force_stop) return;
       const lvid_type local_vid = graph.local_vid(vid);
+      trace_signal(local_vid);
       double priority;
       messages.add(local_vid, message, &priority);
       scheduler_ptr->schedule(local_vid, priority);
@@ -619,6 +827,7 @@ namespace graphlab {
     void internal_signal(const vertex_type& vtx,
                          const message_type& message = message_type()) {
       if (force_stop) return;
+      trace_signal(vtx.local_id());
       if (started) {
         const typename graph_type::vertex_record& rec = graph.l_get_vertex_record(vtx.local_id());
         const procid_t owner = rec.owner;
@@ -652,6 +861,12 @@ namespace graphlab {
     } // end of schedule
 
 
+    /// Samples a signal of a local vertex for the update trace
+    inline void trace_signal(lvid_type lvid) {
+      if (tracer.enabled() && graph.l_is_master(lvid)) tracer.signal(lvid);
+    }
+
+
     /**
      * \internal
      * \brief Signals a vertex with an optional message
@@ -666,11 +881,94 @@ namespace graphlab {
         internal_signal(graph.vertex(gvid), message);
       } else {
         procid_t proc = graph.master(gvid);
-        rmi.remote_call(proc, &async_consistent_engine::internal_signal_gvid,
-                             gvid, message);
+        send_signal(proc, gvid, message);
       }
     } 
 
+    /**
+     * \internal
+     * Signals gvid, which has its master (or the machine forwarding to
+     * its master) on proc. From a fiber, the signal is added to the
+     * buffer of the worker thread for proc, and the buffer is sent if it
+     * is full.
+     */
+    void send_signal(procid_t proc, vertex_id_type gvid,
+                     const message_type& message) {
+      if (signal_batch == 0 || endgame_mode || !fiber_control::in_fiber()) {
+        rmi.remote_call(proc, &async_consistent_engine::internal_signal_gvid,
+                        gvid, message);
+        return;
+      }
+      signal_buffer& buf = signal_buffers[fiber_control::get_worker_id()];
+      std::vector<std::pair<vertex_id_type, message_type> > signals;
+      buf.lock.lock();
+      boost::unordered_map<vertex_id_type, message_type>& pending = 
+          buf.pending[proc];
+      typename boost::unordered_map<vertex_id_type, message_type>::iterator 
+          iter = pending.find(gvid);
+      if (iter != pending.end()) {
+        iter->second += message;
+      } else {
+        pending.insert(std::make_pair(gvid, message));
+        ++buf.npending;
+      }
+      if (pending.size() >= signal_batch) {
+        signals.assign(pending.begin(), pending.end());
+        buf.npending -= pending.size();
+        pending.clear();
+      }
+      buf.lock.unlock();
+      if (!signals.empty()) {
+        rmi.remote_call(proc, &async_consistent_engine::rpc_signal_batch,
+                        signals);
+      }
+    }
+
+    /**
+     * \internal
+     * Sends the signals buffered by worker thread wid. If due_only,
+     * only sends them if signal_latency has passed since the last time.
+     */
+    void flush_signals(size_t wid, bool due_only) {
+      signal_buffer& buf = signal_buffers[wid];
+      if (buf.npending == 0) return;
+      const size_t now = timer::usec_of_day();
+      if (due_only && now < buf.last_flush + signal_latency) return;
+      std::vector<std::vector<std::pair<vertex_id_type, message_type> > > 
+          signals(rmi.numprocs());
+      buf.lock.lock();
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        signals[p].assign(buf.pending[p].begin(), buf.pending[p].end());
+        buf.pending[p].clear();
+      }
+      buf.npending = 0;
+      buf.last_flush = now;
+      buf.lock.unlock();
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        if (signals[p].empty()) continue;
+        rmi.remote_call(p, &async_consistent_engine::rpc_signal_batch,
+                        signals[p]);
+      }
+    }
+
+    /// Sends the signals buffered by all the worker threads
+    void flush_all_signals() {
+      for (size_t i = 0; i < signal_buffers.size(); ++i) {
+        flush_signals(i, false);
+      }
+    }
+
+    /**
+     * \internal
+     * Receives the signals buffered by another machine
+     */
+    void rpc_signal_batch(
+        const std::vector<std::pair<vertex_id_type, message_type> >& signals) {
+      for (size_t i = 0; i < signals.size(); ++i) {
+        internal_signal_gvid(signals[i].first, signals[i].second);
+      }
+    }
+
 
     void rpc_internal_stop() {
       force_stop = true;
@@ -703,7 +1001,7 @@ namespace graphlab {
                              const gather_type& delta) {
       if(use_cache) {
         const lvid_type lvid = vertex.local_id();
-        vertexlocks[lvid].lock();
+        vertexlocks[lvid].writelock();
         if( has_cache.get(lvid) ) {
           gather_cache[lvid] += delta;
         } else {
@@ -712,7 +1010,7 @@ namespace graphlab {
           // gather_cache[lvid] = delta;
           // has_cache.set_bit(lvid);
         }
-        vertexlocks[lvid].unlock();
+        vertexlocks[lvid].wrunlock();
       }
     }
 
@@ -727,10 +1025,10 @@ namespace graphlab {
     void internal_clear_gather_cache(const vertex_type& vertex) {
       const lvid_type lvid = vertex.local_id();
       if(use_cache && has_cache.get(lvid)) {
-        vertexlocks[lvid].lock();
+        vertexlocks[lvid].writelock();
         gather_cache[lvid] = gather_type();
         has_cache.clear_bit(lvid);
-        vertexlocks[lvid].unlock();
+        vertexlocks[lvid].wrunlock();
       }
 
     }
@@ -761,11 +1059,8 @@ namespace graphlab {
       // and schedule all of them.
       std::vector<vertex_id_type> vtxs;
       vtxs.reserve(graph.num_local_own_vertices());
-      for(lvid_type lvid = 0;
-          lvid < graph.get_local_graph().num_vertices();
-          ++lvid) {
-        if (graph.l_vertex(lvid).owner() == rmi.procid() &&
-            vset.l_contains(lvid)) {
+      foreach(size_t lvid, vset.get_lvid_bitset(graph)) {
+        if (graph.l_vertex(lvid).owner() == rmi.procid()) {
           vtxs.push_back(lvid);
         }
       }
@@ -773,10 +1068,41 @@ namespace graphlab {
       if(order == "shuffle") {
         graphlab::random::shuffle(vtxs.begin(), vtxs.end());
       }
-      foreach(lvid_type lvid, vtxs) {
-        double priority;
-        messages.add(lvid, message, &priority);
-        scheduler_ptr->schedule(lvid, priority);
+      // hand the vertices to the scheduler a chunk at a time
+      const size_t CHUNK_SIZE = 4096;
+      std::vector<lvid_type> chunk(CHUNK_SIZE);
+      std::vector<double> priorities(CHUNK_SIZE);
+      for (size_t begin = 0; begin < vtxs.size(); begin += CHUNK_SIZE) {
+        const size_t n = std::min(CHUNK_SIZE, vtxs.size() - begin);
+        for (size_t i = 0; i < n; ++i) {
+          chunk[i] = vtxs[begin + i];
+          messages.add(chunk[i], message, &priorities[i]);
+        }
+        scheduler_ptr->schedule_batch(&chunk[0], n, &priorities[0]);
+      }
+      rmi.barrier();
+    }
+
+
+    /**
+     * \brief Signals owned vertices of this machine, each with its own
+     * message, given as pairs of local vertex id and message.
+     *
+     * This is used to continue a computation started by another engine
+     * on the same graph. Must be called on all machines.
+     */
+    void signal_local(const std::vector<std::pair<lvid_type, message_type> >& signals) {
+      const size_t CHUNK_SIZE = 4096;
+      std::vector<lvid_type> chunk(CHUNK_SIZE);
+      std::vector<double> priorities(CHUNK_SIZE);
+      for (size_t begin = 0; begin < signals.size(); begin += CHUNK_SIZE) {
+        const size_t n = std::min(CHUNK_SIZE, signals.size() - begin);
+        for (size_t i = 0; i < n; ++i) {
+          chunk[i] = signals[begin + i].first;
+          ASSERT_TRUE(graph.l_is_master(chunk[i]));
+          messages.add(chunk[i], signals[begin + i].second, &priorities[i]);
+        }
+        scheduler_ptr->schedule_batch(&chunk[0], n, &priorities[0]);
       }
       rmi.barrier();
     }
@@ -790,14 +1116,34 @@ namespace graphlab {
     sched_status::status_enum get_next_sched_task( size_t threadid,
                                                   lvid_type& lvid,
                                                   message_type& msg) {
+      if (trace.replaying()) {
+        while (trace.next_task(threadid, lvid)) {
+          // the signal of a recorded vertex may still be in flight
+          for (size_t wait = 0; ; ++wait) {
+            if (messages.get(lvid, msg)) return sched_status::NEW_TASK;
+            if (wait == schedule_trace::REPLAY_PATIENCE || force_stop) break;
+            fiber_control::yield();
+          }
+          trace.task_skipped();
+        }
+      }
+      std::vector<lvid_type>& buffer = sched_buffer[threadid];
       while (1) {
-        sched_status::status_enum stat = 
-            scheduler_ptr->get_next(threadid % ncpus, lvid);
-        if (stat == sched_status::NEW_TASK) {
-          if (messages.get(lvid, msg)) return stat;
-          else continue;
+        if (buffer.empty()) {
+          buffer.resize(sched_batch);
+          const size_t n =
+              scheduler_ptr->get_next_batch(threadid % ncpus, &buffer[0],
+                                            sched_batch);
+          buffer.resize(n);
+          if (n == 0) return sched_status::EMPTY;
+          std::reverse(buffer.begin(), buffer.end());
+        }
+        lvid = buffer.back();
+        buffer.pop_back();
+        if (messages.get(lvid, msg)) {
+          if (trace.recording()) trace.record_task(threadid, lvid);
+          return sched_status::NEW_TASK;
         }
-        return stat;
       }
     }
 
@@ -822,6 +1168,8 @@ namespace graphlab {
         force_stop = true;
       }
       fiber_control::yield();
+      // buffered signals are not seen by the consensus
+      flush_all_signals();
       logstream(LOG_DEBUG) << rmi.procid() << "-" << threadid << ": " << "Termination Attempt " << std::endl;
       has_sched_msg = false;
       consensus->begin_done_critical_section(threadid);
@@ -864,6 +1212,7 @@ namespace graphlab {
      * of the task and switch the vertex to a gathering state
      */
     void lock_ready(lvid_type lvid) {
+      if (!schedule_trace_prefix.empty()) trace.record_grant(lvid);
       cm_handles[lvid]->lock.lock();
       cm_handles[lvid]->philosopher_ready = true;
       fiber_control::schedule_tid(cm_handles[lvid]->fiber_handle);
@@ -871,6 +1220,28 @@ namespace graphlab {
     }
 
 
+    /// Locks both ends of an edge, in lvid order, for a gather
+    void lock_edge_for_gather(lvid_type a, lvid_type b) {
+      if (shared_gather) {
+        vertexlocks[std::min(a,b)].readlock();
+        if (a != b) vertexlocks[std::max(a,b)].readlock();
+      } else {
+        vertexlocks[std::min(a,b)].writelock();
+        vertexlocks[std::max(a,b)].writelock();
+      }
+    }
+
+    void unlock_edge_for_gather(lvid_type a, lvid_type b) {
+      if (shared_gather) {
+        vertexlocks[a].rdunlock();
+        if (a != b) vertexlocks[b].rdunlock();
+      } else {
+        vertexlocks[a].wrunlock();
+        vertexlocks[b].wrunlock();
+      }
+    }
+
+
     conditional_gather_type perform_gather(vertex_id_type vid,
                                vertex_program_type& vprog_) {
       vertex_program_type vprog = vprog_;
@@ -878,7 +1249,7 @@ namespace graphlab {
       local_vertex_type local_vertex(graph.l_vertex(lvid));
       vertex_type vertex(local_vertex);
       context_type context(*this, graph);
-      edge_dir_type gather_dir = vprog.gather_edges(context, vertex);
+      edge_dir_type gather_dir = resolve_gather_edges(vprog, context, vertex);
       conditional_gather_type accum;
 
       //check against the cache
@@ -891,11 +1262,9 @@ namespace graphlab {
         foreach(local_edge_type local_edge, local_vertex.in_edges()) {
           edge_type edge(local_edge);
           lvid_type a = edge.source().local_id(), b = edge.target().local_id();
-          vertexlocks[std::min(a,b)].lock();
-          vertexlocks[std::max(a,b)].lock();
+          lock_edge_for_gather(a, b);
           accum += vprog.gather(context, vertex, edge);
-          vertexlocks[a].unlock();
-          vertexlocks[b].unlock();
+          unlock_edge_for_gather(a, b);
         }
       } 
       // do out edges
@@ -903,11 +1272,9 @@ namespace graphlab {
         foreach(local_edge_type local_edge, local_vertex.out_edges()) {
           edge_type edge(local_edge);
           lvid_type a = edge.source().local_id(), b = edge.target().local_id();
-          vertexlocks[std::min(a,b)].lock();
-          vertexlocks[std::max(a,b)].lock();
+          lock_edge_for_gather(a, b);
           accum += vprog.gather(context, vertex, edge);
-          vertexlocks[a].unlock();
-          vertexlocks[b].unlock();
+          unlock_edge_for_gather(a, b);
         }
       } 
       if (use_cache) {
@@ -916,33 +1283,99 @@ namespace graphlab {
       return accum;
     }
 
+    /**
+     * \internal
+     * Sums the versions of the vertex and of every neighbor read by the
+     * gather. Versions only increase, so any write between two calls
+     * changes the sum. Versions are read without locks.
+     */
+    uint64_t gather_signature(lvid_type lvid, edge_dir_type gather_dir) {
+      local_vertex_type local_vertex(graph.l_vertex(lvid));
+      uint64_t sig = vertex_version[lvid];
+      if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
+        foreach(local_edge_type local_edge, local_vertex.in_edges()) {
+          sig += vertex_version[local_edge.source().id()];
+        }
+      }
+      if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
+        foreach(local_edge_type local_edge, local_vertex.out_edges()) {
+          sig += vertex_version[local_edge.target().id()];
+        }
+      }
+      return sig;
+    }
+
+    typedef std::pair<conditional_gather_type, uint64_t> versioned_gather_type;
+
+    /// Gathers, returning the signature taken before the gather started
+    versioned_gather_type perform_versioned_gather(vertex_id_type vid,
+                                                   vertex_program_type& vprog_) {
+      vertex_program_type vprog = vprog_;
+      lvid_type lvid = graph.local_vid(vid);
+      vertex_type vertex(graph.l_vertex(lvid));
+      context_type context(*this, graph);
+      uint64_t sig =
+          gather_signature(lvid, resolve_gather_edges(vprog, context, vertex));
+      return versioned_gather_type(perform_gather(vid, vprog), sig);
+    }
+
+    /// perform_gather() requested by the update trace_id
+    conditional_gather_type traced_gather(uint64_t trace_id,
+                                          vertex_id_type vid,
+                                          vertex_program_type& vprog) {
+      const uint64_t begin = update_trace::now();
+      conditional_gather_type accum = perform_gather(vid, vprog);
+      tracer.record(trace_id, update_trace::REMOTE_GATHER, begin, vid);
+      return accum;
+    }
+
+    /// perform_versioned_gather() requested by the update trace_id
+    versioned_gather_type traced_versioned_gather(uint64_t trace_id,
+                                                  vertex_id_type vid,
+                                                  vertex_program_type& vprog) {
+      const uint64_t begin = update_trace::now();
+      versioned_gather_type accum = perform_versioned_gather(vid, vprog);
+      tracer.record(trace_id, update_trace::REMOTE_GATHER, begin, vid);
+      return accum;
+    }
+
+    uint64_t perform_gather_signature(vertex_id_type vid,
+                                      vertex_program_type& vprog_) {
+      vertex_program_type vprog = vprog_;
+      lvid_type lvid = graph.local_vid(vid);
+      vertex_type vertex(graph.l_vertex(lvid));
+      context_type context(*this, graph);
+      return gather_signature(lvid,
+                              resolve_gather_edges(vprog, context, vertex));
+    }
+
 
     void perform_scatter_local(lvid_type lvid,
                                vertex_program_type& vprog) {
       local_vertex_type local_vertex(graph.l_vertex(lvid));
       vertex_type vertex(local_vertex);
       context_type context(*this, graph);
-      edge_dir_type scatter_dir = vprog.scatter_edges(context, vertex);
+      edge_dir_type scatter_dir = resolve_scatter_edges(vprog, context, vertex);
       if(scatter_dir == IN_EDGES || scatter_dir == ALL_EDGES) {
         foreach(local_edge_type local_edge, local_vertex.in_edges()) {
           edge_type edge(local_edge);
           lvid_type a = edge.source().local_id(), b = edge.target().local_id();
-          vertexlocks[std::min(a,b)].lock();
-          vertexlocks[std::max(a,b)].lock();
+          vertexlocks[std::min(a,b)].writelock();
+          vertexlocks[std::max(a,b)].writelock();
           vprog.scatter(context, vertex, edge);
-          vertexlocks[a].unlock();
-          vertexlocks[b].unlock();
+          vertexlocks[a].wrunlock();
+          vertexlocks[b].wrunlock();
         }
       } 
       if(scatter_dir == OUT_EDGES || scatter_dir == ALL_EDGES) {
         foreach(local_edge_type local_edge, local_vertex.out_edges()) {
           edge_type edge(local_edge);
           lvid_type a = edge.source().local_id(), b = edge.target().local_id();
-          vertexlocks[std::min(a,b)].lock();
-          vertexlocks[std::max(a,b)].lock();
+          vertexlocks[std::min(a,b)].writelock();
+          vertexlocks[std::max(a,b)].writelock();
           vprog.scatter(context, vertex, edge);
-          vertexlocks[a].unlock();
-          vertexlocks[b].unlock();
+          vertexlocks[a].wrunlock();
+          vertexlocks[b].wrunlock();
         }
       } 
 
@@ -958,19 +1391,29 @@ namespace graphlab {
                     const vertex_data_type& newdata) {
       vertex_program_type vprog = vprog_;
       lvid_type lvid = graph.local_vid(vid);
-      vertexlocks[lvid].lock();
+      vertexlocks[lvid].writelock();
+      if (optimistic) ++vertex_version[lvid];
       graph.l_vertex(lvid).data() = newdata;
-      vertexlocks[lvid].unlock();
+      vertexlocks[lvid].wrunlock();
       perform_scatter_local(lvid, vprog);
     }
 
+    /// perform_scatter() requested by the update trace_id
+    void traced_scatter(uint64_t trace_id, vertex_id_type vid,
+                        vertex_program_type& vprog,
+                        const vertex_data_type& newdata) {
+      const uint64_t begin = update_trace::now();
+      perform_scatter(vid, vprog, newdata);
+      tracer.record(trace_id, update_trace::REMOTE_SCATTER, begin, vid);
+    }
+
 
     // make sure I am the only person running.
     // if returns false, the message has been dropped into the message array.
     // quit
     bool get_exclusive_access_to_vertex(const lvid_type lvid,
                                         const message_type& msg) {
-      vertexlocks[lvid].lock();
+      vertexlocks[lvid].writelock();
       bool someone_else_running = program_running.set_bit(lvid);
       if (someone_else_running) {
         // bad. someone else is here.
@@ -978,7 +1421,7 @@ namespace graphlab {
         messages.add(lvid, msg);
         hasnext.set_bit(lvid);
       } 
-      vertexlocks[lvid].unlock();
+      vertexlocks[lvid].wrunlock();
       return !someone_else_running;
     }
 
@@ -988,7 +1431,7 @@ namespace graphlab {
     // if returns false, the message has been dropped into the message array.
     // quit
     void release_exclusive_access_to_vertex(const lvid_type lvid) {
-      vertexlocks[lvid].lock();
+      vertexlocks[lvid].writelock();
       // someone left a next message for me
       // reschedule it at high priority
       if (hasnext.get(lvid)) {
@@ -997,7 +1440,7 @@ namespace graphlab {
         hasnext.clear_bit(lvid);
       }
       program_running.clear_bit(lvid);
-      vertexlocks[lvid].unlock();
+      vertexlocks[lvid].wrunlock();
     }
 
 
@@ -1007,6 +1450,70 @@ namespace graphlab {
      * If this function is called with vertex locks acquired, prelocked
      * should be true. Otherwise it should be false.
      */
+    /**
+     * \internal
+     * Gathers on all replicas of lvid without distributed locks, then
+     * recomputes the signatures. Gathers again (after yielding) until no
+     * vertex read by the gather has changed in between. A non zero
+     * trace_id is passed on to the mirrors.
+     */
+    conditional_gather_type optimistic_gather(lvid_type lvid,
+                                              vertex_program_type& vprog,
+                                              uint64_t trace_id) {
+      local_vertex_type local_vertex(graph.l_vertex(lvid));
+      vertex_id_type vid = local_vertex.global_id();
+      while(1) {
+        conditional_gather_type gather_result;
+        uint64_t sig = 0;
+        std::vector<request_future<versioned_gather_type> > gather_futures;
+        foreach(procid_t mirror, local_vertex.mirrors()) {
+          if (trace_id) {
+            gather_futures.push_back(
+                object_fiber_remote_request(rmi,
+                                            mirror,
+                                            &async_consistent_engine::traced_versioned_gather,
+                                            trace_id,
+                                            vid,
+                                            vprog));
+            continue;
+          }
+          gather_futures.push_back(
+              object_fiber_remote_request(rmi,
+                                          mirror,
+                                          &async_consistent_engine::perform_versioned_gather,
+                                          vid,
+                                          vprog));
+        }
+        versioned_gather_type local = perform_versioned_gather(vid, vprog);
+        gather_result += local.first;
+        sig += local.second;
+        for(size_t i = 0;i < gather_futures.size(); ++i) {
+          versioned_gather_type remote = gather_futures[i]();
+          gather_result += remote.first;
+          sig += remote.second;
+        }
+
+        // validate
+        std::vector<request_future<uint64_t> > sig_futures;
+        foreach(procid_t mirror, local_vertex.mirrors()) {
+          sig_futures.push_back(
+              object_fiber_remote_request(rmi,
+                                          mirror,
+                                          &async_consistent_engine::perform_gather_signature,
+                                          vid,
+                                          vprog));
+        }
+        uint64_t newsig = perform_gather_signature(vid, vprog);
+        for(size_t i = 0;i < sig_futures.size(); ++i) {
+          newsig += sig_futures[i]();
+        }
+        if (newsig == sig) return gather_result;
+        optimistic_conflicts.inc();
+        if (use_cache) has_cache.clear_bit(lvid);
+        fiber_control::yield();
+      }
+    }
+
     void eval_sched_task(const lvid_type lvid,
                          const message_type& msg) {
       const typename graph_type::vertex_record& rec = graph.l_get_vertex_record(lvid);
@@ -1020,19 +1527,25 @@ namespace graphlab {
       }
       // if this is another machine's forward it
       if (rec.owner != rmi.procid()) {
-        rmi.remote_call(rec.owner, &engine_type::rpc_signal, vid, msg);
+        send_signal(rec.owner, vid, msg);
         return;
       }
       // I have to run this myself
       
       if (!get_exclusive_access_to_vertex(lvid, msg)) return;
 
+      const uint64_t trace_id = tracer.enabled() ? tracer.begin_update(lvid, vid) : 0;
+      uint64_t update_begin = 0, stage_begin = 0;
+      if (trace_id) update_begin = stage_begin = update_trace::now();
+
+      vertex_fiber_cm_handle cm_handle;
       /**************************************************************************/
       /*                             Acquire Locks                              */
       /**************************************************************************/
       if (!factorized_consistency) {
-        // begin lock acquisition
-        cm_handles[lvid] = new vertex_fiber_cm_handle;
+        // begin lock acquisition. The handle lives on this fiber's stack
+        // until the locks are released below.
+        cm_handles[lvid] = &cm_handle;
         cm_handles[lvid]->philosopher_ready = false;
         cm_handles[lvid]->fiber_handle = fiber_control::get_tid();
         cmlocks->make_philosopher_hungry(lvid);
@@ -1042,6 +1555,9 @@ namespace graphlab {
           cm_handles[lvid]->lock.lock();
         }
         cm_handles[lvid]->lock.unlock();
+        if (trace_id) {
+          stage_begin = tracer.record(trace_id, update_trace::LOCK, stage_begin, vid);
+        }
       }
 
       /**************************************************************************/
@@ -1056,32 +1572,56 @@ namespace graphlab {
       /*                               init phase                               */
       /**************************************************************************/
       vprog.init(context, vertex, msg);
+      if (trace_id) {
+        stage_begin = tracer.record(trace_id, update_trace::INIT, stage_begin, vid);
+      }
 
       /**************************************************************************/
       /*                              Gather Phase                              */
       /**************************************************************************/
       conditional_gather_type gather_result;
-      std::vector<request_future<conditional_gather_type> > gather_futures;
-      foreach(procid_t mirror, local_vertex.mirrors()) {
-        gather_futures.push_back(
-            object_fiber_remote_request(rmi, 
-                                        mirror, 
-                                        &async_consistent_engine::perform_gather, 
-                                        vid,
-                                        vprog));
-      }
-      gather_result += perform_gather(vid, vprog);
+      if (optimistic) {
+        gather_result = optimistic_gather(lvid, vprog, trace_id);
+      } else {
+        std::vector<request_future<conditional_gather_type> > gather_futures;
+        foreach(procid_t mirror, local_vertex.mirrors()) {
+          if (trace_id) {
+            gather_futures.push_back(
+                object_fiber_remote_request(rmi,
+                                            mirror,
+                                            &async_consistent_engine::traced_gather,
+                                            trace_id,
+                                            vid,
+                                            vprog));
+            continue;
+          }
+          gather_futures.push_back(
+              object_fiber_remote_request(rmi, 
+                                          mirror, 
+                                          &async_consistent_engine::perform_gather, 
+                                          vid,
+                                          vprog));
+        }
+        gather_result += perform_gather(vid, vprog);
 
-      for(size_t i = 0;i < gather_futures.size(); ++i) {
-        gather_result += gather_futures[i]();
+        for(size_t i = 0;i < gather_futures.size(); ++i) {
+          gather_result += gather_futures[i]();
+        }
+      }
+      if (trace_id) {
+        stage_begin = tracer.record(trace_id, update_trace::GATHER, stage_begin, vid);
       }
 
      /**************************************************************************/
      /*                              apply phase                               */
      /**************************************************************************/
-     vertexlocks[lvid].lock();
+     vertexlocks[lvid].writelock();
+     if (optimistic) ++vertex_version[lvid];
      vprog.apply(context, vertex, gather_result.value);      
-     vertexlocks[lvid].unlock();
+     vertexlocks[lvid].wrunlock();
+     if (trace_id) {
+       stage_begin = tracer.record(trace_id, update_trace::APPLY, stage_begin, vid);
+     }
 
 
      /**************************************************************************/
@@ -1100,17 +1640,31 @@ namespace graphlab {
 
      std::vector<request_future<void> > scatter_futures;
      foreach(procid_t mirror, local_vertex.mirrors()) {
+       if (trace_id) {
+         scatter_futures.push_back(
+             object_fiber_remote_request(rmi,
+                                         mirror,
+                                         &async_consistent_engine::traced_scatter,
+                                         trace_id,
+                                         vid,
+                                         vprog,
+                                         vertex_data_type(local_vertex.data())));
+         continue;
+       }
        scatter_futures.push_back(
            object_fiber_remote_request(rmi, 
                                        mirror, 
                                        &async_consistent_engine::perform_scatter, 
                                        vid,
                                        vprog,
-                                       local_vertex.data()));
+                                       vertex_data_type(local_vertex.data())));
      }
      perform_scatter_local(lvid, vprog);
      for(size_t i = 0;i < scatter_futures.size(); ++i) 
        scatter_futures[i]();
+     if (trace_id) {
+       tracer.record(trace_id, update_trace::SCATTER, stage_begin, vid);
+     }
 
       /************************************************************************/
       /*                           Release Locks                              */
@@ -1118,7 +1672,6 @@ namespace graphlab {
       // the scatter is used to release the chandy misra
       // here I cleanup
       if (!factorized_consistency) {
-        delete cm_handles[lvid];
         cm_handles[lvid] = NULL;
       }
       release_exclusive_access_to_vertex(lvid);
@@ -1127,16 +1680,31 @@ namespace graphlab {
             task_time->current_time();
         task_time->~timer();
       }
+      if (trace_id) tracer.record(trace_id, update_trace::UPDATE, update_begin, vid);
       programs_executed.inc(); 
     }
 
 
+    /**
+     * \internal
+     * Runs a task, recording its latency for the fiber population control
+     */
+    void run_sched_task(const lvid_type lvid,
+                        const message_type& msg) {
+      unsigned long long begin = population.task_begin();
+      eval_sched_task(lvid, msg);
+      population.task_end(begin);
+    }
+
+
     /**
      * \internal
      * Per thread main loop
      */
     void thread_start(size_t threadid) {
       bool has_sched_msg = false;
+      fiber_control::set_fiber_label("async_consistent_engine::thread_start");
+      size_t park_generation = 0;
       std::vector<std::vector<lvid_type> > internal_lvid;
       lvid_type sched_lvid;
 
@@ -1167,23 +1735,40 @@ namespace graphlab {
           aggregator.tick_asynchronous_compute(wid, key);
         }
 
+        flush_signals(fiber_control::get_worker_id(), true);
+
+        population.tick();
+        if (population.parked(threadid)) {
+          population.park(threadid, park_generation);
+          if (population.parked(threadid)) {
+            // woken up to take part in termination
+            if (try_to_quit(threadid, has_sched_msg, sched_lvid, msg)) break;
+            if (has_sched_msg) run_sched_task(sched_lvid, msg);
+            continue;
+          }
+        }
+
         sched_status::status_enum stat = get_next_sched_task(threadid, sched_lvid, msg);
 
 
         has_sched_msg = stat != sched_status::EMPTY;
         if (stat != sched_status::EMPTY) {
-          eval_sched_task(sched_lvid, msg);
+          run_sched_task(sched_lvid, msg);
           if (endgame_mode) rmi.dc().flush();
         }
-        else if (!try_to_quit(threadid, has_sched_msg, sched_lvid, msg)) {
-          /*
-           * We failed to obtain a task, try to quit
-           */
-          if (has_sched_msg) {
-            eval_sched_task(sched_lvid, msg);
+        else {
+          // parked fibers must join the termination attempt
+          population.wake_all();
+          if (!try_to_quit(threadid, has_sched_msg, sched_lvid, msg)) {
+            /*
+             * We failed to obtain a task, try to quit
+             */
+            if (has_sched_msg) {
+              run_sched_task(sched_lvid, msg);
+            }
+          } else { 
+            break; 
           }
-        } else { 
-          break; 
         }
 
         if (fiber_control::worker_has_priority_fibers_on_queue()) {
@@ -1231,6 +1816,7 @@ namespace graphlab {
       force_stop = false;
       endgame_mode = false;
       programs_executed = 0;
+      optimistic_conflicts = 0;
       launch_timer.start();
 
       termination_reason = execution_status::RUNNING;
@@ -1240,12 +1826,30 @@ namespace graphlab {
       thrgroup.set_stacksize(stacksize);
         
       size_t effncpus = std::min(ncpus, fiber_control::get_instance().num_workers());
+      sched_buffer.clear();
+      sched_buffer.resize(nfibers);
+      if (!schedule_trace_prefix.empty()) {
+        trace.begin(nfibers, schedule_trace_file());
+      }
+      population.init(adaptive_fibers ? min_fibers : nfibers, nfibers, effncpus);
+      if (population.is_adaptive()) {
+        logstream(LOG_INFO) << "Adaptive fibers: starting with "
+                            << population.num_active() << " of " << nfibers
+                            << " fibers" << std::endl;
+      }
+      fiber_profiler::set_phase("async_consistent");
       for (size_t i = 0; i < nfibers ; ++i) {
         thrgroup.launch(boost::bind(&engine_type::thread_start, this, i), 
                         i % effncpus);
       }
       thrgroup.join();
+      fiber_profiler::set_phase(NULL);
       aggregator.stop();
+      if (population.is_adaptive()) {
+        logstream(LOG_INFO) << "Adaptive fibers: finished with "
+                            << population.num_active() << " of " << nfibers
+                            << " fibers" << std::endl;
+      }
       // if termination reason was not changed, then it must be depletion
       if (termination_reason == execution_status::RUNNING) {
         termination_reason = execution_status::TASK_DEPLETION;
@@ -1257,6 +1861,53 @@ namespace graphlab {
 
       rmi.cout() << "Completed Tasks: " << programs_executed.value << std::endl;
 
+      if (!schedule_trace_prefix.empty()) {
+        trace.end(schedule_trace_file());
+        size_t ntasks = trace.num_tasks(), nskipped = trace.num_skipped();
+        size_t ngrants = trace.num_grants(), ninorder = trace.num_grants_in_order();
+        rmi.all_reduce(ntasks);
+        rmi.all_reduce(nskipped);
+        rmi.all_reduce(ngrants);
+        rmi.all_reduce(ninorder);
+        if (trace.recording()) {
+          rmi.cout() << "Schedule Trace: recorded " << ntasks << " tasks and "
+                     << ngrants << " lock grants" << std::endl;
+        } else {
+          rmi.cout() << "Schedule Trace: replayed " << ntasks - nskipped
+                     << " of " << ntasks << " tasks. " << ninorder << " of "
+                     << ngrants << " lock grants before the first divergence"
+                     << std::endl;
+        }
+      }
+
+      if (!update_trace_file.empty()) {
+        std::vector<std::vector<update_trace::span> > machine_spans(rmi.numprocs());
+        machine_spans[rmi.procid()] = tracer.get_spans();
+        size_t ndropped = tracer.num_dropped();
+        rmi.gather(machine_spans, 0);
+        rmi.all_reduce(ndropped);
+        tracer.clear();
+        if (rmi.procid() == 0) {
+          size_t nspans = 0;
+          for (size_t i = 0; i < machine_spans.size(); ++i) {
+            nspans += machine_spans[i].size();
+          }
+          update_trace::write(update_trace_file, machine_spans);
+          rmi.cout() << "Update Trace: wrote " << nspans << " spans to "
+                     << update_trace_file << ", dropped " << ndropped
+                     << std::endl;
+        }
+      }
+
+      if (optimistic) {
+        size_t nconflicts = optimistic_conflicts.value;
+        rmi.all_reduce(nconflicts);
+        optimistic_conflicts.value = nconflicts;
+        rmi.cout() << "Optimistic Conflicts: " << nconflicts << " ("
+                   << double(nconflicts) / std::max<size_t>(ctasks, 1)
+                   << " per task)" << std::endl;
+      }
+
 
       size_t numjoins = messages.num_joins();
       rmi.all_reduce(numjoins);
@@ -1266,6 +1917,10 @@ namespace graphlab {
       rmi.all_reduce(numadds);
       rmi.cout() << "Schedule Adds: " << numadds << std::endl;
 
+      size_t numsteals = fiber_control::get_instance().total_steals();
+      rmi.all_reduce(numsteals);
+      rmi.cout() << "Fiber Steals: " << numsteals << std::endl;
+
       if (track_task_time) {
         double total_task_time = 0;
         for (size_t i = 0;i < total_completion_time.size(); ++i) {
@@ -1285,6 +1940,11 @@ namespace graphlab {
     } // end of start
 
 
+  private:
+    std::string schedule_trace_file() const {
+      return schedule_trace_prefix + "." + tostr(rmi.procid());
+    }
+
   public:
     aggregator_type* get_aggregator() { return &aggregator; }
 
@@ -28,6 +28,7 @@
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/macros_def.hpp>
 namespace graphlab {
@@ -86,6 +87,12 @@ class distributed_chandy_misra {
   };
   std::vector<philosopher> philosopherset;
   atomic<size_t> clean_fork_count;
+  /**
+   * Vertices owned by this machine with no mirrors. All their forks are
+   * local, so the HUNGRY / EATING / STOP broadcasts are empty and are
+   * skipped entirely.
+   */
+  dense_bitset interior;
     
   /*
    * Possible values for the philosopher state
@@ -271,10 +278,12 @@ class distributed_chandy_misra {
         
         if (requestor != rmi.procid()) {
           unsigned char pkey = rmi.dc().set_sequentialization_key(gvid % 254 + 1);
+          bool purgent = rmi.dc().set_urgent_send(true);
           rmi.remote_call(requestor,
                           &dcm_type::rpc_cancellation_accept,
                           gvid,
                           lockid);
+          rmi.dc().set_urgent_send(purgent);
           rmi.dc().set_sequentialization_key(pkey);
         }
         else {
@@ -313,11 +322,13 @@ class distributed_chandy_misra {
     }
     else {
       unsigned char pkey = rmi.dc().set_sequentialization_key(lvertex.global_id() % 254 + 1);
+      bool purgent = rmi.dc().set_urgent_send(true);
       rmi.remote_call(lvertex.owner(),
                     &dcm_type::rpc_cancellation_request,
                     lvertex.global_id(),
                     rmi.procid(), 
                     lockid);
+      rmi.dc().set_urgent_send(purgent);
       rmi.dc().set_sequentialization_key(pkey);
 
     }
@@ -524,10 +535,12 @@ class distributed_chandy_misra {
     }
     else {
       unsigned char pkey = rmi.dc().set_sequentialization_key(lvertex.global_id() % 254 + 1);
+      bool purgent = rmi.dc().set_urgent_send(true);
       if (hors_doeuvre_callback != NULL) hors_doeuvre_callback(p_id);
       rmi.remote_call(lvertex.owner(),
                       &dcm_type::rpc_signal_ready,
                       lvertex.global_id(), philosopherset[p_id].lockid);
+      rmi.dc().set_urgent_send(purgent);
       rmi.dc().set_sequentialization_key(pkey);
     }
   }
@@ -569,12 +582,18 @@ class distributed_chandy_misra {
   
     if(philosopherset[lvid].counter == 0) {
       philosopherset[lvid].lock.unlock();
+      if (interior.get(lvid)) {
+        set_eating(lvid, lockid);
+        return;
+      }
       // broadcast EATING
       local_vertex_type lvertex(graph.l_vertex(lvid));
       unsigned char pkey = rmi.dc().set_sequentialization_key(lvertex.global_id() % 254 + 1);
+      bool purgent = rmi.dc().set_urgent_send(true);
       rmi.remote_call(lvertex.mirrors().begin(), lvertex.mirrors().end(),
                       &dcm_type::rpc_set_eating, lvertex.global_id(), lockid);
       set_eating(lvid, lockid);
+      rmi.dc().set_urgent_send(purgent);
       rmi.dc().set_sequentialization_key(pkey);
     }
     else {
@@ -756,9 +775,25 @@ class distributed_chandy_misra {
     philosopherset.resize(graph.num_local_vertices());
     compute_initial_fork_arrangement();
 
+    interior.resize(graph.num_local_vertices());
+    interior.clear();
+    for (lvid_type v = 0; v < graph.num_local_vertices(); ++v) {
+      local_vertex_type lvertex(graph.l_vertex(v));
+      if (lvertex.owner() == rmi.procid() && lvertex.num_mirrors() == 0) {
+        interior.set_bit_unsync(v);
+      }
+    }
+    logstream(LOG_INFO) << rmi.procid() << ": " << interior.popcount()
+                        << " of " << graph.num_local_vertices()
+                        << " vertices are interior" << std::endl;
     rmi.barrier();
   }
 
+  /// Number of local vertices which lock without any communication
+  size_t num_interior() const {
+    return interior.popcount();
+  }
+
   size_t num_clean_forks() const {
     return clean_fork_count.value;
   }
@@ -784,10 +819,14 @@ class distributed_chandy_misra {
   
     philosopherset[p_id].lock.unlock();
     
-    unsigned char pkey = rmi.dc().set_sequentialization_key(lvertex.global_id() % 254 + 1);
-    rmi.remote_call(lvertex.mirrors().begin(), lvertex.mirrors().end(),
-                    &dcm_type::rpc_make_philosopher_hungry, lvertex.global_id(), newlockid);
-    rmi.dc().set_sequentialization_key(pkey);
+    if (!interior.get(p_id)) {
+      unsigned char pkey = rmi.dc().set_sequentialization_key(lvertex.global_id() % 254 + 1);
+      bool purgent = rmi.dc().set_urgent_send(true);
+      rmi.remote_call(lvertex.mirrors().begin(), lvertex.mirrors().end(),
+                      &dcm_type::rpc_make_philosopher_hungry, lvertex.global_id(), newlockid);
+      rmi.dc().set_urgent_send(purgent);
+      rmi.dc().set_sequentialization_key(pkey);
+    }
     local_philosopher_grabs_forks(p_id);
   }
   
@@ -826,10 +865,14 @@ class distributed_chandy_misra {
 //    ASSERT_EQ(philosopherset[p_id].state, (int)EATING);
     philosopherset[p_id].counter = 0;
     philosopherset[p_id].lock.unlock();
-    unsigned char pkey = rmi.dc().set_sequentialization_key(lvertex.global_id() % 254 + 1);
-    rmi.remote_call(lvertex.mirrors().begin(), lvertex.mirrors().end(),
-                    &dcm_type::rpc_philosopher_stops_eating, lvertex.global_id());
-    rmi.dc().set_sequentialization_key(pkey);
+    if (!interior.get(p_id)) {
+      unsigned char pkey = rmi.dc().set_sequentialization_key(lvertex.global_id() % 254 + 1);
+      bool purgent = rmi.dc().set_urgent_send(true);
+      rmi.remote_call(lvertex.mirrors().begin(), lvertex.mirrors().end(),
+                      &dcm_type::rpc_philosopher_stops_eating, lvertex.global_id());
+      rmi.dc().set_urgent_send(purgent);
+      rmi.dc().set_sequentialization_key(pkey);
+    }
     local_philosopher_stops_eating(p_id);
   }
 
@@ -27,6 +27,7 @@
 #include <graphlab/engine/synchronous_engine.hpp>
 #include <graphlab/engine/async_consistent_engine.hpp>
 #include <graphlab/engine/omni_engine.hpp>
+#include <graphlab/engine/hybrid_engine.hpp>
 
 #include <graphlab/engine/execution_status.hpp>
 
@@ -46,7 +46,10 @@ namespace graphlab {
       FORCED_ABORT,     /**< the engine was stopped by calling force
                                 abort */
       
-      EXCEPTION        /**< the engine was stopped by an exception */
+      EXCEPTION,       /**< the engine was stopped by an exception */
+
+      FRONTIER_HANDOFF /**< the synchronous engine stopped to hand its
+                              sparse frontier to another engine */
     }; // end of enum
     
     // Convenience function.
@@ -58,6 +61,7 @@ namespace graphlab {
         case TIMEOUT: return "timeout";
         case FORCED_ABORT: return "forced abort";
         case EXCEPTION: return "exception";
+        case FRONTIER_HANDOFF: return "frontier handoff";
         default: return "unknown";
       };
     } // end of to_string
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_FIBER_POPULATION_CONTROL_HPP
+#define GRAPHLAB_FIBER_POPULATION_CONTROL_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+
+/**
+ * \internal
+ * Adapts the number of fibers an asynchronous engine runs tasks on.
+ *
+ * All fibers are launched up front (the termination consensus counts
+ * them) but only fibers with an id below num_active() take tasks from
+ * the scheduler. The others are parked: they are descheduled until the
+ * active population grows past them, or until an active fiber runs out
+ * of work and calls wake_all(), at which point they join the
+ * termination attempt.
+ *
+ * Once a second, tick() looks at the fraction of active fibers which are
+ * blocked inside a task (in flight beyond the number of workers), and at
+ * the average task latency. When nearly all active fibers are blocked the
+ * population doubles. When few are, it shrinks towards the number of
+ * tasks in flight predicted by Little's law (throughput * latency), plus
+ * headroom. The population always stays within [min_fibers, max_fibers].
+ */
+class fiber_population_control {
+ private:
+  struct worker_counters {
+    size_t begun;
+    size_t ended;
+    unsigned long long ticks;
+    char padding[64 - 2 * sizeof(size_t) - sizeof(unsigned long long)];
+    worker_counters(): begun(0), ended(0), ticks(0) { }
+  };
+
+  bool adaptive;
+  size_t min_fibers;
+  size_t max_fibers;
+  size_t nworkers;
+  volatile size_t active;
+
+  mutex lock;
+  size_t generation;
+  /// (fiber id, fiber tid) of every parked fiber. Protected by lock.
+  std::vector<std::pair<size_t, size_t> > waiting;
+
+  std::vector<worker_counters> counters;
+  mutex tick_lock;
+  float last_tick;
+  size_t last_ended;
+  unsigned long long last_ticks;
+  double ticks_per_second;
+
+ public:
+  fiber_population_control(): adaptive(false), min_fibers(1), max_fibers(1),
+                              nworkers(1), active(1), generation(0),
+                              last_tick(0), last_ended(0), last_ticks(0),
+                              ticks_per_second(1) { }
+
+  /**
+   * Sets the population limits. Control is adaptive only if
+   * min_fibers < max_fibers; otherwise all max_fibers fibers are active.
+   */
+  void init(size_t min_fibers_, size_t max_fibers_, size_t nworkers_) {
+    max_fibers = std::max<size_t>(max_fibers_, 1);
+    min_fibers = std::min(std::max<size_t>(min_fibers_, 1), max_fibers);
+    nworkers = std::max<size_t>(nworkers_, 1);
+    adaptive = min_fibers < max_fibers;
+    active = adaptive ? min_fibers : max_fibers;
+    generation = 0;
+    waiting.clear();
+    counters.clear();
+    counters.resize(fiber_control::get_instance().num_workers());
+    last_tick = timer::approx_time_seconds();
+    last_ended = 0;
+    last_ticks = 0;
+    if (adaptive) ticks_per_second = estimate_ticks_per_second();
+  }
+
+  bool is_adaptive() const {
+    return adaptive;
+  }
+
+  size_t num_active() const {
+    return active;
+  }
+
+  /// True if the fiber should not take tasks from the scheduler
+  bool parked(size_t fiberid) const {
+    return adaptive && fiberid >= active;
+  }
+
+  /**
+   * Deschedules the calling fiber while it is parked. Returns immediately
+   * if wake_all() was called since seen_generation, which is updated on
+   * return. The caller should then join the termination attempt if it is
+   * still parked.
+   */
+  void park(size_t fiberid, size_t& seen_generation) {
+    lock.lock();
+    while (fiberid >= active && generation == seen_generation) {
+      waiting.push_back(std::make_pair(fiberid, fiber_control::get_tid()));
+      fiber_control::deschedule_self(&lock.m_mut);
+      lock.lock();
+    }
+    seen_generation = generation;
+    lock.unlock();
+  }
+
+  /// Wakes every parked fiber so that it takes part in termination
+  void wake_all() {
+    if (!adaptive) return;
+    lock.lock();
+    ++generation;
+    for (size_t i = 0; i < waiting.size(); ++i) {
+      fiber_control::schedule_tid(waiting[i].second);
+    }
+    waiting.clear();
+    lock.unlock();
+  }
+
+  /// Records the start of a task. Returns a timestamp for task_end()
+  unsigned long long task_begin() {
+    if (!adaptive) return 0;
+    ++counters[fiber_control::get_worker_id()].begun;
+    return rdtsc();
+  }
+
+  void task_end(unsigned long long begin) {
+    if (!adaptive) return;
+    worker_counters& c = counters[fiber_control::get_worker_id()];
+    ++c.ended;
+    c.ticks += rdtsc() - begin;
+  }
+
+  /**
+   * Called regularly by every fiber. At most once a second, one caller
+   * recomputes the active population and logs any change.
+   */
+  void tick() {
+    if (!adaptive) return;
+    float now = timer::approx_time_seconds();
+    if (now - last_tick < 1.0 || !tick_lock.try_lock()) return;
+    if (now - last_tick < 1.0) {
+      tick_lock.unlock();
+      return;
+    }
+    // the per-worker counters are read without synchronization.
+    // They are only used as estimates.
+    size_t begun = 0, ended = 0;
+    unsigned long long ticks = 0;
+    for (size_t i = 0; i < counters.size(); ++i) {
+      begun += counters[i].begun;
+      ended += counters[i].ended;
+      ticks += counters[i].ticks;
+    }
+    double elapsed = now - last_tick;
+    size_t completed = ended - last_ended;
+    double latency = completed == 0 ? 0 :
+        double(ticks - last_ticks) / completed / ticks_per_second;
+    double rate = completed / elapsed;
+    size_t inflight = begun > ended ? begun - ended : 0;
+    size_t blocked = inflight > nworkers ? inflight - nworkers : 0;
+    double blocked_ratio = double(blocked) / active;
+
+    size_t cur = active;
+    size_t next = cur;
+    if (blocked_ratio > 0.9) {
+      next = 2 * cur;
+    } else if (blocked_ratio < 0.5) {
+      next = std::max<size_t>(std::ceil(1.25 * rate * latency) + nworkers,
+                              cur / 2);
+    }
+    next = std::min(std::max(next, min_fibers), max_fibers);
+    if (next != cur) {
+      logstream(LOG_INFO) << "Active fibers: " << cur << " -> " << next
+                          << " (blocked ratio " << blocked_ratio
+                          << ", task latency " << latency * 1000 << " ms, "
+                          << rate << " tasks/s)" << std::endl;
+      lock.lock();
+      active = next;
+      if (next > cur) {
+        // wake the fibers which are no longer parked
+        size_t j = 0;
+        for (size_t i = 0; i < waiting.size(); ++i) {
+          if (waiting[i].first < next) {
+            fiber_control::schedule_tid(waiting[i].second);
+          } else {
+            waiting[j++] = waiting[i];
+          }
+        }
+        waiting.resize(j);
+      }
+      lock.unlock();
+    }
+    last_tick = now;
+    last_ended = ended;
+    last_ticks = ticks;
+    tick_lock.unlock();
+  }
+};
+
+} // namespace graphlab
+
+#endif
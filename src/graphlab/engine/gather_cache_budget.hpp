@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_ENGINE_GATHER_CACHE_BUDGET_HPP
+#define GRAPHLAB_ENGINE_GATHER_CACHE_BUDGET_HPP
+
+#include <limits>
+#include <algorithm>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/serialization/is_pod.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief Decides which vertices of the synchronous engine keep a
+   * gather cache entry when the cache has a memory budget.
+   *
+   * The benefit of caching a vertex is the number of edges a cache hit
+   * saves, which is estimated by its local degree, and every entry
+   * costs the same entry_bytes. Vertices are grouped in buckets of
+   * benefit, by powers of two. An entry is admitted if its benefit is
+   * at least the current threshold and it fits in the budget;
+   * otherwise the rejection is counted in its bucket. Between
+   * super-steps, rebalance() picks the lowest bucket such that all the
+   * cached and rejected vertices from this bucket up fit in the
+   * budget: cached entries below it are to be evicted, and the
+   * threshold probes one bucket lower when the cache has room left.
+   *
+   * admit(), release() and the hit and miss counters may be used
+   * concurrently. configure() and rebalance() may not.
+   */
+  class gather_cache_budget {
+  public:
+    static const size_t NUM_BUCKETS = 64;
+
+    /// The counters of the cache, which can be summed across machines
+    struct stats_type : public IS_POD_TYPE {
+      size_t hits, misses, evictions, entries;
+      stats_type() : hits(0), misses(0), evictions(0), entries(0) { }
+      stats_type& operator+=(const stats_type& other) {
+        hits += other.hits; misses += other.misses;
+        evictions += other.evictions; entries += other.entries;
+        return *this;
+      }
+      /// The fraction of the lookups answered by the cache
+      double hit_rate() const {
+        return hits + misses == 0 ? 0.0 : double(hits) / (hits + misses);
+      }
+    };
+
+    gather_cache_budget() { configure(0, 0); }
+
+    /**
+     * Sets the budget in bytes (0 for unbounded) and the smallest
+     * benefit worth caching, and clears all the entries and counters.
+     */
+    void configure(size_t budget_bytes, size_t min_benefit) {
+      budget = budget_bytes;
+      min_benefit_ = min_benefit;
+      min_bucket = bucket_of(min_benefit);
+      threshold_bucket = min_bucket;
+      entry_bytes = 0;
+      capacity = budget == 0 ? std::numeric_limits<size_t>::max() : 0;
+      entries = 0;
+      reset_counters();
+      for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        cached[i] = 0; rejected[i] = 0;
+      }
+    }
+
+    /// Clears the hit, miss and eviction counters
+    void reset_counters() {
+      hits = 0; misses = 0; evictions = 0;
+    }
+
+    /// Returns true if entry_bytes must be provided to admit()
+    bool needs_entry_bytes() const { return budget > 0 && entry_bytes == 0; }
+
+    /**
+     * Sets the size of an entry from a measured accumulator. Since
+     * the first measure wins, that accumulator should be typical.
+     */
+    void set_entry_bytes(size_t bytes) {
+      lock.lock();
+      if (entry_bytes == 0) {
+        if (bytes == 0) bytes = 1;
+        capacity = budget / bytes;
+        __sync_synchronize();
+        entry_bytes = bytes;
+      }
+      lock.unlock();
+    }
+
+    /// Returns true if a new entry of this benefit is to be cached
+    bool admit(size_t benefit) {
+      const size_t b = bucket_of(benefit);
+      if (b < threshold_bucket || benefit < min_benefit_) return false;
+      if (budget > 0 && entry_bytes == 0) return false;
+      if (entries.inc() > capacity) {
+        entries.dec();
+        rejected[b].inc();
+        return false;
+      }
+      cached[b].inc();
+      return true;
+    }
+
+    /// Accounts for the removal of an entry of this benefit
+    void release(size_t benefit) {
+      entries.dec();
+      cached[bucket_of(benefit)].dec();
+    }
+
+    /// Accounts for the eviction of an entry of this benefit
+    void evict(size_t benefit) {
+      release(benefit);
+      evictions.inc();
+    }
+
+    /**
+     * Recomputes the admission threshold from the entries cached and
+     * rejected since the last call. Returns true if the threshold rose,
+     * in which case the entries for which should_evict() is true must
+     * be evicted.
+     */
+    bool rebalance() {
+      bool any_rejected = false;
+      for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        any_rejected |= (rejected[i].value != 0);
+      }
+      size_t old_threshold = threshold_bucket;
+      if (any_rejected) {
+        size_t total = 0;
+        size_t b = NUM_BUCKETS;
+        while (b > 0) {
+          const size_t wanted = size_t(cached[b - 1]) + size_t(rejected[b - 1]);
+          if (total + wanted > capacity) break;
+          total += wanted;
+          --b;
+        }
+        // even the highest bucket does not fit: keep only it
+        threshold_bucket = std::max(std::min(b, NUM_BUCKETS - 1), min_bucket);
+      } else if (threshold_bucket > min_bucket && entries < capacity) {
+        --threshold_bucket;
+      }
+      for (size_t i = 0; i < NUM_BUCKETS; ++i) rejected[i] = 0;
+      return threshold_bucket > old_threshold;
+    }
+
+    /// Returns true if a cached entry of this benefit is to be evicted
+    bool should_evict(size_t benefit) const {
+      return bucket_of(benefit) < threshold_bucket;
+    }
+
+    /// The bucket of a benefit: the number of bits needed to write it
+    static size_t bucket_of(size_t benefit) {
+      size_t b = 0;
+      while (benefit != 0 && b + 1 < NUM_BUCKETS) { benefit >>= 1; ++b; }
+      return b;
+    }
+
+    size_t num_entries() const { return entries; }
+
+    stats_type stats() const {
+      stats_type ret;
+      ret.hits = hits; ret.misses = misses;
+      ret.evictions = evictions; ret.entries = entries;
+      return ret;
+    }
+    size_t entry_size() const { return entry_bytes; }
+
+    /// Gathers answered from the cache
+    atomic<size_t> hits;
+    /// Gathers recomputed while caching is enabled
+    atomic<size_t> misses;
+    /// Entries removed to make room for vertices of higher benefit
+    atomic<size_t> evictions;
+
+  private:
+    size_t budget;
+    size_t min_benefit_;
+    size_t min_bucket;
+    size_t threshold_bucket;
+    volatile size_t entry_bytes;
+    size_t capacity;
+    simple_spinlock lock;
+    atomic<size_t> entries;
+    atomic<size_t> cached[NUM_BUCKETS];
+    atomic<size_t> rejected[NUM_BUCKETS];
+  }; // end of gather_cache_budget
+
+}; // end of namespace graphlab
+
+#endif
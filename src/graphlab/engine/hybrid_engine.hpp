@@ -0,0 +1,206 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_HYBRID_ENGINE_HPP
+#define GRAPHLAB_HYBRID_ENGINE_HPP
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <graphlab/options/graphlab_options.hpp>
+#include <graphlab/engine/iengine.hpp>
+#include <graphlab/engine/execution_status.hpp>
+#include <graphlab/engine/synchronous_engine.hpp>
+#include <graphlab/engine/async_consistent_engine.hpp>
+
+namespace graphlab {
+
+
+  /**
+   * \ingroup engines
+   *
+   * \brief The hybrid engine runs the bulk synchronous phases of a
+   * computation with the \ref synchronous_engine and its sparse tail
+   * with the \ref async_consistent_engine.
+   *
+   * Computations such as PageRank with a tolerance, SSSP or loopy
+   * belief propagation start with most of the graph active, where
+   * synchronous super-steps are efficient, and end with a long tail of
+   * a few active vertices, where the asynchronous engine and its
+   * schedulers converge much faster. The hybrid engine starts with the
+   * synchronous engine, and once the number of signaled vertices, which
+   * was at least handoff_fraction of the vertices, drops below it, it
+   * moves the remaining messages to an asynchronous engine on the same
+   * graph and runs it to completion. No vertex program lives across
+   * super-steps, so the messages are the whole state of the computation.
+   *
+   * The aggregators registered before start() are copied to the
+   * asynchronous engine at the handoff.
+   *
+   * \li \b handoff_fraction (default: 0.01) The fraction of the vertices
+   * below which the frontier is handed to the asynchronous engine.
+   *
+   * Other engine options are passed to both engines, except the ones
+   * prefixed with "sync." or "async." which are only passed, without
+   * the prefix, to the synchronous or asynchronous engine respectively.
+   * The scheduler options only apply to the asynchronous phase. 
+   *
+   \verbatim
+   %> ./sssp --engine_opts="handoff_fraction=0.05,sync.max_iterations=100"
+   \endverbatim
+   *
+   * \see graphlab::synchronous_engine
+   * \see graphlab::async_consistent_engine
+   */
+  template<typename VertexProgram>
+  class hybrid_engine : public iengine<VertexProgram> {
+  public:
+    typedef iengine<VertexProgram> iengine_type;
+    typedef VertexProgram vertex_program_type;
+    typedef typename vertex_program_type::message_type message_type;
+    typedef typename vertex_program_type::graph_type graph_type;
+    typedef typename graph_type::vertex_id_type vertex_id_type;
+    typedef typename graph_type::lvid_type lvid_type;
+    typedef typename iengine_type::aggregator_type aggregator_type;
+    typedef synchronous_engine<VertexProgram> synchronous_engine_type;
+    typedef async_consistent_engine<VertexProgram> async_consistent_engine_type;
+
+  private:
+    distributed_control& dc;
+    graph_type& graph;
+    graphlab_options async_options;
+    synchronous_engine_type* sync_engine;
+    /// Created at the first handoff
+    async_consistent_engine_type* async_engine;
+    double handoff_fraction;
+    /// The running time of the synchronous engine, set at the handoff
+    float sync_seconds;
+
+    hybrid_engine(const hybrid_engine& other);
+
+    /**
+     * Moves the engine options of opts prefixed with prefix to the
+     * engine options of out, without the prefix, and drops the ones
+     * prefixed with other_prefix.
+     */
+    static graphlab_options split_options(const graphlab_options& opts,
+                                          const std::string& prefix,
+                                          const std::string& other_prefix) {
+      graphlab_options out = opts;
+      options_map& args = out.get_engine_args();
+      args.options.erase("handoff_fraction");
+      std::vector<std::string> keys = args.get_option_keys();
+      for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i].compare(0, prefix.length(), prefix) == 0) {
+          args.options[keys[i].substr(prefix.length())] = args.options[keys[i]];
+          args.options.erase(keys[i]);
+        } else if (keys[i].compare(0, other_prefix.length(), other_prefix) == 0) {
+          args.options.erase(keys[i]);
+        }
+      }
+      return out;
+    }
+
+  public:
+    hybrid_engine(distributed_control& dc, graph_type& graph,
+                  const graphlab_options& opts = graphlab_options()) :
+        dc(dc), graph(graph), 
+        async_options(split_options(opts, "async.", "sync.")),
+        sync_engine(NULL), async_engine(NULL), handoff_fraction(0.01), sync_seconds(0) {
+      opts.get_engine_args().get_option("handoff_fraction", handoff_fraction);
+      if (dc.procid() == 0) {
+        logstream(LOG_EMPH) << "Engine Option: handoff_fraction = " 
+                            << handoff_fraction << std::endl;
+      }
+      sync_engine = new synchronous_engine_type(dc, graph,
+                                                split_options(opts, "sync.", "async."));
+    }
+
+    ~hybrid_engine() {
+      delete async_engine;
+      delete sync_engine;
+    }
+
+    /**
+     * \brief Runs the synchronous engine and, if its frontier became
+     * sparse, continues with the asynchronous engine.
+     */
+    execution_status::status_enum start() {
+      sync_engine->set_handoff_threshold(
+          std::max<size_t>(1, handoff_fraction * graph.num_vertices()));
+      execution_status::status_enum status = sync_engine->start();
+      if (status != execution_status::FRONTIER_HANDOFF) return status;
+      sync_seconds = sync_engine->elapsed_seconds();
+
+      if (async_engine == NULL) {
+        async_engine = new async_consistent_engine_type(dc, graph, async_options);
+        async_engine->get_aggregator()->copy_aggregators(*sync_engine->get_aggregator());
+      }
+      std::vector<std::pair<lvid_type, message_type> > frontier;
+      sync_engine->take_frontier(frontier);
+      async_engine->signal_local(frontier);
+      std::vector<std::pair<lvid_type, message_type> >().swap(frontier);
+      if (dc.procid() == 0) {
+        logstream(LOG_EMPH) << "Continuing with the Asynchronous engine" 
+                            << std::endl;
+      }
+      return async_engine->start();
+    }
+
+    size_t num_updates() const {
+      return sync_engine->num_updates() + 
+          (async_engine == NULL ? 0 : async_engine->num_updates());
+    }
+
+    float elapsed_seconds() const {
+      if (async_engine == NULL) return sync_engine->elapsed_seconds();
+      return sync_seconds + async_engine->elapsed_seconds();
+    }
+
+    /// The number of synchronous super-steps
+    int iteration() const { return sync_engine->iteration(); }
+
+    void signal(vertex_id_type vertex,
+                const message_type& message = message_type()) {
+      sync_engine->signal(vertex, message);
+    }
+
+    void signal_all(const message_type& message = message_type(),
+                    const std::string& order = "shuffle") {
+      sync_engine->signal_all(message, order);
+    }
+
+    void signal_vset(const vertex_set& vset,
+                     const message_type& message = message_type(),
+                     const std::string& order = "shuffle") {
+      sync_engine->signal_vset(vset, message, order);
+    }
+
+    /// The aggregator of the synchronous engine
+    aggregator_type* get_aggregator() { return sync_engine->get_aggregator(); }
+
+  }; // end of hybrid_engine
+
+}; // end of namespace graphlab
+
+#endif
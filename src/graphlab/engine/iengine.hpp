@@ -1176,6 +1176,44 @@ namespace graphlab {
       return aggregator->aggregate_periodic(key, seconds);
     } // end of aggregate_periodic
 
+    /**
+     * \brief Requests that a particular aggregation key be computed
+     * as part of every super-step instead of by a separate pass over
+     * the graph.
+     *
+     * A fused vertex aggregator maps each vertex right after it is
+     * applied, and a fused edge aggregator maps each edge as it is
+     * scattered on (an edge scattered on from both of its endpoints is
+     * mapped twice). The accumulators are reduced and finalized at the
+     * end of each super-step. This fits convergence checks such as the
+     * sum of the changes made by apply, which only concern the vertices
+     * that ran.
+     *
+     * Only the synchronous engine fuses aggregators. Other engines run
+     * a fused aggregator as a periodic aggregator with a period of 0.
+     * Calling aggregate_periodic() on the key undoes the request.
+     *
+     * \code
+     * engine.aggregate_fused("total_change");
+     * \endcode
+     *
+     * \param [in] key Key to fuse. Must be a key
+     *                 previously created by add_vertex_aggregator()
+     *                 or add_edge_aggregator().
+     *
+     * All machines must call simultaneously.
+     * \return Returns true if key is found, and false otherwise.
+     */
+    bool aggregate_fused(const std::string& key) {
+      aggregator_type* aggregator = get_aggregator();
+      if(aggregator == NULL) {
+        logstream(LOG_FATAL) << "Aggregation not supported by this engine!" 
+                             << std::endl;
+        return false; // does not return 
+      }
+      return aggregator->aggregate_fused(key);
+    } // end of aggregate_fused
+
 
 
     /**
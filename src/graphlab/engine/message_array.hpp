@@ -29,8 +29,32 @@
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/scheduler/get_message_priority.hpp>
+#include <graphlab/util/empty.hpp>
 namespace graphlab {
 
+  namespace message_array_impl {
+    /**
+     * \internal
+     * Holds the value of a message box. Empty messages are not stored
+     * so that, thanks to the empty base optimization, a box of
+     * graphlab::empty is only its flag.
+     */
+    template<typename ValueType>
+    struct message_value {
+      ValueType value;
+      inline ValueType& get() { return value; }
+      inline const ValueType& get() const { return value; }
+    };
+
+    template<>
+    struct message_value<empty> {
+      inline empty& get() const {
+        static empty value;
+        return value;
+      }
+    };
+  } // namespace message_array_impl
+
   /**
    * \TODO DOCUMENT THIS CLASS
    */ 
@@ -41,13 +65,13 @@ namespace graphlab {
     typedef ValueType value_type;
 
   private:    
-    struct message_box {
-      value_type value;
+    struct message_box : public message_array_impl::message_value<value_type> {
       bool empty;
 
       message_box() : empty(true) { }
       /** returns false if element is already present */
       inline bool add(const value_type& other, double& priority) {
+        value_type& value = this->get();
         if (empty) {
           value = other;
           empty = false;
@@ -61,7 +85,7 @@ namespace graphlab {
       }
                 
       void clear() {
-        value = value_type();
+        this->get() = value_type();
         empty = true;
       }
       
@@ -123,7 +147,7 @@ namespace graphlab {
       size_t lockidx = get_lock_idx(idx);
       lock_array[lockidx].lock();
       if (!message_vector[idx].empty) {
-        ret_val = message_vector[idx].value;
+        ret_val = message_vector[idx].get();
         message_vector[idx].clear();
         has_val = true;
       }
@@ -142,7 +166,7 @@ namespace graphlab {
       size_t lockidx = get_lock_idx(idx);
       lock_array[lockidx].lock();
       if (!message_vector[idx].empty) {
-        ret_val = message_vector[idx].value;
+        ret_val = message_vector[idx].get();
         has_val = true;
       }
       lock_array[lockidx].unlock();
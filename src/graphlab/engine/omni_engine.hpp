@@ -26,6 +26,10 @@
 
 
 
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
 #include <graphlab/options/graphlab_options.hpp>
 
 #include <graphlab/engine/iengine.hpp>
@@ -71,6 +75,20 @@ namespace graphlab {
    *  (\ref synchronous_engine)
    *  \li "asynchronous" or "async": uses the asynchronous engine
    *  (\ref async_consistent_engine)
+   *  \li "auto": picks one of the above from the graph and the initial
+   *  signals when the engine is first needed, that is at start() or at
+   *  the first call to get_aggregator().
+   *
+   * In "auto" mode the signals are buffered until the engine is created.
+   * The synchronous engine is chosen when at least
+   * AUTO_SYNC_ACTIVE_FRACTION of the vertices are signaled, or when the
+   * replication factor is at least AUTO_SYNC_REPLICATION and at least
+   * AUTO_MIN_ACTIVE_FRACTION of the vertices are signaled, since the
+   * distributed locking of the asynchronous engine costs a round trip to
+   * every mirror. Otherwise the frontier is sparse and the asynchronous
+   * engine is chosen, with the sweep scheduler for moderately sparse
+   * frontiers and the fifo scheduler for very sparse ones, unless a
+   * scheduler was given. The choice and the measurements are logged.
 *
    * \see graphlab::synchronous_engine
    * \see graphlab::async_consistent_engine
@@ -136,6 +154,25 @@ namespace graphlab {
      */
     typedef async_consistent_engine<VertexProgram> async_consistent_engine_type;
 
+    /**
+     * \brief The fraction of signaled vertices from which "auto" uses
+     * the synchronous engine
+     */
+    static const double AUTO_SYNC_ACTIVE_FRACTION;
+
+    /**
+     * \brief The replication factor from which "auto" uses the
+     * synchronous engine for frontiers of at least
+     * AUTO_MIN_ACTIVE_FRACTION of the vertices
+     */
+    static const double AUTO_SYNC_REPLICATION;
+
+    /**
+     * \brief The fraction of signaled vertices below which "auto" always
+     * uses the asynchronous engine with the fifo scheduler
+     */
+    static const double AUTO_MIN_ACTIVE_FRACTION;
+
 
 
   private:
@@ -155,6 +192,101 @@ namespace graphlab {
      */
     omni_engine(const omni_engine& other ) { }
 
+    /**
+     * \brief The arguments of the engine of "auto" mode, which is
+     * only created when first needed.
+     */
+    distributed_control* dc_ptr;
+    graph_type* graph_ptr;
+    graphlab_options auto_options;
+
+    /**
+     * \brief The signals received in "auto" mode before the engine is
+     * created.
+     */
+    std::vector<std::pair<vertex_id_type, message_type> > pending_signals;
+    struct pending_vset {
+      bool all;
+      vertex_set vset;
+      message_type message;
+      std::string order;
+    };
+    std::vector<pending_vset> pending_vsets;
+
+    /**
+     * \brief Returns the engine, choosing and creating the engine of
+     * "auto" mode from the signals received so far if needed.
+     */
+    iengine_type* get_engine() {
+      if (engine_ptr != NULL) return engine_ptr;
+      distributed_control& dc = *dc_ptr;
+      graph_type& graph = *graph_ptr;
+      // count the signaled vertices owned by this machine
+      bool all_active = false;
+      for (size_t i = 0; i < pending_vsets.size(); ++i) {
+        all_active = all_active || pending_vsets[i].all;
+      }
+      size_t nactive = 0;
+      if (all_active) {
+        nactive = graph.num_local_own_vertices();
+      } else {
+        for (size_t i = 0; i < pending_vsets.size(); ++i) {
+          for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+            if (graph.l_is_master(lvid) && 
+                pending_vsets[i].vset.l_contains(lvid)) ++nactive;
+          }
+        }
+        nactive += pending_signals.size();
+      }
+      dc.all_reduce(nactive);
+      const double nverts = std::max<double>(graph.num_vertices(), 1);
+      const double active_fraction = std::min(1.0, nactive / nverts);
+      const double replication = graph.num_replicas() / nverts;
+
+      std::string choice;
+      if (active_fraction >= AUTO_SYNC_ACTIVE_FRACTION) {
+        choice = "Synchronous engine (dense frontier)";
+        engine_ptr = new synchronous_engine_type(dc, graph, auto_options);
+      } else if (replication >= AUTO_SYNC_REPLICATION && 
+                 active_fraction >= AUTO_MIN_ACTIVE_FRACTION) {
+        choice = "Synchronous engine (high replication makes "
+                 "distributed locking expensive)";
+        engine_ptr = new synchronous_engine_type(dc, graph, auto_options);
+      } else {
+        if (auto_options.get_scheduler_type().empty()) {
+          auto_options.set_scheduler_type(
+              active_fraction >= AUTO_MIN_ACTIVE_FRACTION ? "sweep" : "fifo");
+        }
+        choice = "Asynchronous engine with the " + 
+                 auto_options.get_scheduler_type() + 
+                 " scheduler (sparse frontier)";
+        engine_ptr = new async_consistent_engine_type(dc, graph, auto_options);
+      }
+      if (dc.procid() == 0) {
+        logstream(LOG_EMPH) << "Auto engine: active fraction = " 
+                            << active_fraction << ", replication factor = " 
+                            << replication << ". Using the " << choice 
+                            << "." << std::endl;
+      }
+      // replay the signals
+      for (size_t i = 0; i < pending_vsets.size(); ++i) {
+        if (pending_vsets[i].all) {
+          engine_ptr->signal_all(pending_vsets[i].message, 
+                                 pending_vsets[i].order);
+        } else {
+          engine_ptr->signal_vset(pending_vsets[i].vset, 
+                                  pending_vsets[i].message, 
+                                  pending_vsets[i].order);
+        }
+      }
+      for (size_t i = 0; i < pending_signals.size(); ++i) {
+        engine_ptr->signal(pending_signals[i].first, pending_signals[i].second);
+      }
+      std::vector<std::pair<vertex_id_type, message_type> >().swap(pending_signals);
+      std::vector<pending_vset>().swap(pending_vsets);
+      return engine_ptr;
+    }
+
 
   public:
 
@@ -169,15 +301,15 @@ namespace graphlab {
      * transform.
      * \param [in] options the command line options which are used to
      * configure the engine.  Note that the engine option "type" can
-     * be used to select the engine to use (synchronous or
-     * asynchronous).
+     * be used to select the engine to use (synchronous,
+     * asynchronous or auto).
      * \param [in] default_engine_type The user must specify what
      * engine type to use if no command line option is given.
      */
     omni_engine(distributed_control& dc, graph_type& graph,
                 const std::string& default_engine_type,
                 const graphlab_options& options = graphlab_options()) :
-      engine_ptr(NULL) {
+      engine_ptr(NULL), dc_ptr(&dc), graph_ptr(&graph) {
       graphlab_options new_options = options;
       std::string engine_type = default_engine_type;
       options_map& engine_options = new_options.get_engine_args();
@@ -193,6 +325,9 @@ namespace graphlab {
       } else if(engine_type == "async" || engine_type == "asynchronous") {
         logstream(LOG_INFO) << "Using the Asynchronous engine." << std::endl;
         engine_ptr = new async_consistent_engine_type(dc, graph, new_options);
+      } else if(engine_type == "auto") {
+        logstream(LOG_INFO) << "Choosing the engine when it is started." << std::endl;
+        auto_options = new_options;
       } else {
         logstream(LOG_FATAL) << "Invalid engine type: " << engine_type << std::endl;
       }
@@ -208,31 +343,61 @@ namespace graphlab {
       }
     } // end of destructor
 
-    execution_status::status_enum start( ) { return engine_ptr->start(); }
+    execution_status::status_enum start( ) { return get_engine()->start(); }
 
-    size_t num_updates() const { return engine_ptr->num_updates(); }
-    float elapsed_seconds() const { return engine_ptr->elapsed_seconds(); }
-    int iteration() const { return engine_ptr->iteration(); }
+    size_t num_updates() const { 
+      return engine_ptr == NULL ? 0 : engine_ptr->num_updates(); 
+    }
+    float elapsed_seconds() const { 
+      return engine_ptr == NULL ? 0 : engine_ptr->elapsed_seconds(); 
+    }
+    int iteration() const { 
+      return engine_ptr == NULL ? -1 : engine_ptr->iteration(); 
+    }
     void signal(vertex_id_type vertex,
                 const message_type& message = message_type()) {
-      engine_ptr->signal(vertex, message);
+      if (engine_ptr == NULL) {
+        pending_signals.push_back(std::make_pair(vertex, message));
+      } else {
+        engine_ptr->signal(vertex, message);
+      }
     }
     void signal_all(const message_type& message = message_type(),
                     const std::string& order = "shuffle") {
-      engine_ptr->signal_all(message, order);
+      if (engine_ptr == NULL) {
+        pending_vset p;
+        p.all = true; p.message = message; p.order = order;
+        pending_vsets.push_back(p);
+      } else {
+        engine_ptr->signal_all(message, order);
+      }
     }
     void signal_vset(const vertex_set& vset,
                      const message_type& message = message_type(),
                      const std::string& order = "shuffle") {
-      engine_ptr->signal_vset(vset, message, order);
+      if (engine_ptr == NULL) {
+        pending_vset p;
+        p.all = false; p.vset = vset; p.message = message; p.order = order;
+        pending_vsets.push_back(p);
+      } else {
+        engine_ptr->signal_vset(vset, message, order);
+      }
     }
 
 
-    aggregator_type* get_aggregator() { return engine_ptr->get_aggregator(); }
+    aggregator_type* get_aggregator() { return get_engine()->get_aggregator(); }
 
 
   }; // end of omni_engine
 
+  template<typename VertexProgram>
+  const double omni_engine<VertexProgram>::AUTO_SYNC_ACTIVE_FRACTION = 0.1;
+
+  template<typename VertexProgram>
+  const double omni_engine<VertexProgram>::AUTO_SYNC_REPLICATION = 8;
+
+  template<typename VertexProgram>
+  const double omni_engine<VertexProgram>::AUTO_MIN_ACTIVE_FRACTION = 0.01;
 
 
 
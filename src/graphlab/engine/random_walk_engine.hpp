@@ -0,0 +1,502 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_RANDOM_WALK_ENGINE_HPP
+#define GRAPHLAB_RANDOM_WALK_ENGINE_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <boost/function.hpp>
+
+#include <graphlab/options/graphlab_options.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/graph/builtin_parsers.hpp>
+#include <graphlab/util/fast_multinomial.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/logger.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup engines
+   *
+   * \brief Runs many independent random walks on a distributed graph
+   * and streams the visited vertices to disk.
+   *
+   * Unlike the vertex program engines, the unit of work is the walker
+   * and not the vertex: a walker is a small POD record which is
+   * advanced by the machine owning the master of its current vertex.
+   * Walkers which step to a vertex owned by another machine are batched
+   * in a buffered_exchange, so every round moves all the walkers in
+   * flight with one exchange, and walkers which stay on the machine
+   * keep walking within the round.
+   *
+   * Before walking, the adjacency of every vertex is gathered on its
+   * master, and an alias table of the edge weights is built for it, so
+   * a first order step costs O(1) whatever the degree.
+   *
+   * Setting p or q different from 1 gives the second order walks of
+   * node2vec: the next vertex x of a walk going from t to v is drawn
+   * from the alias table of v and accepted with a probability
+   * proportional to 1/p if x == t, to 1 if x is a neighbor of t and to
+   * 1/q otherwise. Since the neighbors of x are on the master of x, the
+   * walker goes to that machine to be accepted or rejected and returns
+   * to v when it is rejected.
+   *
+   * Random walks with restart (personalized PageRank) are obtained by
+   * setting the restart probability: walks then end before each step
+   * with that probability.
+   *
+   * Each machine writes the visits of the walks it advanced to
+   * [prefix]_[procid + 1]_of_[numprocs] as "walk_id \t step \t vertex"
+   * lines, in no particular order. The walk id of the k-th walk from
+   * vertex v is v * walks_per_vertex + k.
+   *
+   * The engine options are:
+   * \li \b walk_length (default 80) The maximum number of vertices of a
+   *     walk, including its source.
+   * \li \b walks_per_vertex (default 10) The number of walks starting
+   *     from every vertex.
+   * \li \b p, \b q (default 1) The node2vec return and in-out parameters.
+   * \li \b restart (default 0) The probability to end a walk before
+   *     each step.
+   * \li \b directed (default false) Walk along out-edges only. Otherwise
+   *     the edges are walked in both directions.
+   *
+   * \tparam Graph The distributed_graph type
+   */
+  template<typename Graph>
+  class random_walk_engine {
+  public:
+    typedef Graph graph_type;
+    typedef typename graph_type::vertex_id_type vertex_id_type;
+    typedef typename graph_type::lvid_type lvid_type;
+    typedef typename graph_type::edge_type edge_type;
+    typedef typename graph_type::local_vertex_type local_vertex_type;
+    typedef typename graph_type::local_edge_type local_edge_type;
+
+    /** Returns the weight of an edge. Edges of weight 0 are not walked. */
+    typedef boost::function<double (const edge_type&)> weight_function_type;
+
+  private:
+    /** An entry of the adjacency of vid, sent to the master of vid */
+    struct adjacency_record : public IS_POD_TYPE {
+      vertex_id_type vid;
+      vertex_id_type nbr;
+      double weight;
+      procid_t nbr_owner;
+      /// nbr is an in-neighbor of vid (directed second order walks)
+      bool incoming;
+      bool operator<(const adjacency_record& other) const {
+        if (vid != other.vid) return vid < other.vid;
+        if (incoming != other.incoming) return incoming < other.incoming;
+        return nbr < other.nbr;
+      }
+    };
+
+    struct neighbor {
+      vertex_id_type vid;
+      procid_t owner;
+    };
+
+    enum walker_state {
+      /// just stepped to current: write the visit, then sample
+      ARRIVE,
+      /// sample again from current after a rejected candidate
+      SAMPLE,
+      /// on the master of candidate to accept or reject it
+      TEST
+    };
+
+    struct walker : public IS_POD_TYPE {
+      uint64_t walk_id;
+      vertex_id_type current;
+      vertex_id_type prev;
+      vertex_id_type candidate;
+      procid_t current_owner;
+      procid_t candidate_owner;
+      uint32_t step;
+      unsigned char state;
+    };
+
+    dc_dist_object<random_walk_engine> rmi;
+    graph_type& graph;
+    size_t ncpus;
+
+    size_t walk_length;
+    size_t walks_per_vertex;
+    double p, q, restart;
+    bool directed;
+    bool second_order;
+    double max_alpha;
+
+    /// the neighbors of lvid are nbrs[offsets[lvid] .. offsets[lvid + 1])
+    std::vector<size_t> offsets;
+    std::vector<neighbor> nbrs;
+    std::vector<double> prob;
+    std::vector<uint32_t> alias;
+    /// sorted in-neighbors, only for directed second order walks
+    std::vector<size_t> in_offsets;
+    std::vector<vertex_id_type> in_nbrs;
+
+    buffered_exchange<walker> walker_exchange;
+
+    std::ofstream fout;
+    mutex fout_lock;
+
+    /// Buffered output is written to the file beyond this size
+    enum { OUTPUT_BUFFER_SIZE = 1 << 20 };
+
+  public:
+    random_walk_engine(distributed_control& dc, graph_type& graph,
+                       const graphlab_options& opts = graphlab_options()) :
+      rmi(dc, this), graph(graph), ncpus(opts.get_ncpus()),
+      walk_length(80), walks_per_vertex(10), p(1), q(1), restart(0),
+      directed(false), walker_exchange(dc, opts.get_ncpus()) {
+      rmi.barrier();
+      std::vector<std::string> keys = opts.get_engine_args().get_option_keys();
+      foreach(std::string opt, keys) {
+        if (opt == "walk_length") {
+          opts.get_engine_args().get_option("walk_length", walk_length);
+        } else if (opt == "walks_per_vertex") {
+          opts.get_engine_args().get_option("walks_per_vertex", walks_per_vertex);
+        } else if (opt == "p") {
+          opts.get_engine_args().get_option("p", p);
+        } else if (opt == "q") {
+          opts.get_engine_args().get_option("q", q);
+        } else if (opt == "restart") {
+          opts.get_engine_args().get_option("restart", restart);
+        } else if (opt == "directed") {
+          opts.get_engine_args().get_option("directed", directed);
+        } else {
+          logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
+        }
+      }
+      if (walk_length == 0) {
+        logstream(LOG_FATAL) << "walk_length must be positive" << std::endl;
+      }
+      if (p <= 0 || q <= 0) {
+        logstream(LOG_FATAL) << "p and q must be positive" << std::endl;
+      }
+      if (restart < 0 || restart >= 1) {
+        logstream(LOG_FATAL) << "restart must be in [0, 1)" << std::endl;
+      }
+      second_order = (p != 1 || q != 1);
+      max_alpha = std::max(1.0, std::max(1.0 / p, 1.0 / q));
+      if (rmi.procid() == 0) {
+        logstream(LOG_EMPH) << "Random walks: walk_length = " << walk_length
+                            << ", walks_per_vertex = " << walks_per_vertex
+                            << ", p = " << p << ", q = " << q
+                            << ", restart = " << restart
+                            << ", directed = " << directed << std::endl;
+      }
+    }
+
+    /**
+     * Gathers the adjacency of every vertex on its master and builds
+     * the alias tables. Without a weight function, all the edges have
+     * weight 1. Must be called on all machines, after graph.finalize()
+     * and before run().
+     */
+    void build_tables(weight_function_type weight = weight_function_type()) {
+      timer ti;
+      buffered_exchange<adjacency_record> exchange(rmi.dc(), ncpus);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (int i = 0; i < (int)graph.num_local_vertices(); ++i) {
+        const size_t tid = thread_id();
+        local_vertex_type v = graph.l_vertex(i);
+        foreach(const local_edge_type& e, v.out_edges()) {
+          const double w = weight.empty() ? 1.0 : weight(edge_type(e));
+          if (w <= 0) continue;
+          local_vertex_type t = e.target();
+          adjacency_record rec;
+          rec.vid = v.global_id(); rec.nbr = t.global_id();
+          rec.nbr_owner = t.owner(); rec.weight = w; rec.incoming = false;
+          exchange.send(v.owner(), rec, tid);
+          if (!directed || second_order) {
+            // the reverse edge, or the in-neighbor of t
+            rec.vid = t.global_id(); rec.nbr = v.global_id();
+            rec.nbr_owner = v.owner(); rec.incoming = directed;
+            exchange.send(t.owner(), rec, tid);
+          }
+        }
+      }
+      exchange.flush();
+
+      std::vector<adjacency_record> records;
+      procid_t sendid;
+      typename buffered_exchange<adjacency_record>::buffer_type buffer;
+      while (exchange.recv(sendid, buffer)) {
+        records.insert(records.end(), buffer.begin(), buffer.end());
+      }
+      exchange.barrier();
+      std::sort(records.begin(), records.end());
+
+      // count, then place the records in sorted order, so the
+      // neighbors of every vertex are sorted by id
+      const size_t nlocal = graph.num_local_vertices();
+      std::vector<lvid_type> lvids(records.size());
+      offsets.assign(nlocal + 1, 0);
+      in_offsets.assign(nlocal + 1, 0);
+      for (size_t i = 0; i < records.size(); ++i) {
+        lvids[i] = graph.local_vid(records[i].vid);
+        ++(records[i].incoming ? in_offsets : offsets)[lvids[i] + 1];
+      }
+      for (size_t i = 0; i < nlocal; ++i) {
+        offsets[i + 1] += offsets[i];
+        in_offsets[i + 1] += in_offsets[i];
+      }
+      nbrs.resize(offsets[nlocal]);
+      in_nbrs.resize(in_offsets[nlocal]);
+      std::vector<double> weights(nbrs.size());
+      std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+      std::vector<size_t> in_pos(in_offsets.begin(), in_offsets.end() - 1);
+      for (size_t i = 0; i < records.size(); ++i) {
+        const adjacency_record& rec = records[i];
+        if (rec.incoming) {
+          in_nbrs[in_pos[lvids[i]]++] = rec.nbr;
+        } else {
+          const size_t j = pos[lvids[i]]++;
+          nbrs[j].vid = rec.nbr;
+          nbrs[j].owner = rec.nbr_owner;
+          weights[j] = rec.weight;
+        }
+      }
+      std::vector<adjacency_record>().swap(records);
+
+      prob.resize(nbrs.size());
+      alias.resize(nbrs.size());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+      for (int i = 0; i < (int)nlocal; ++i) {
+        const size_t begin = offsets[i], n = offsets[i + 1] - begin;
+        if (n > 0) {
+          alias_multinomial::build_table(&weights[begin], n,
+                                         &prob[begin], &alias[begin]);
+        }
+      }
+      rmi.full_barrier();
+      if (rmi.procid() == 0) {
+        logstream(LOG_EMPH) << "Random walk tables built in "
+                            << ti.current_time() << " seconds" << std::endl;
+      }
+    }
+
+    /**
+     * Runs walks_per_vertex walks from every vertex and writes them to
+     * files starting with prefix. Must be called on all machines.
+     * Returns the total number of visits written by all the machines.
+     */
+    size_t run(const std::string& prefix) {
+      if (offsets.size() != graph.num_local_vertices() + 1) {
+        logstream(LOG_FATAL) << "build_tables() must be called before run()"
+                             << std::endl;
+      }
+      timer ti;
+      const std::string fname = prefix + "_" + tostr(rmi.procid() + 1) +
+          "_of_" + tostr(rmi.numprocs());
+      fout.open(fname.c_str());
+      if (!fout.good()) {
+        logstream(LOG_FATAL) << "Unable to open " << fname << std::endl;
+      }
+
+      std::vector<walker> queue;
+      for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+        if (!graph.l_is_master(lvid)) continue;
+        walker w;
+        w.current = w.prev = w.candidate = graph.global_vid(lvid);
+        w.current_owner = w.candidate_owner = rmi.procid();
+        w.step = 0;
+        w.state = ARRIVE;
+        for (size_t k = 0; k < walks_per_vertex; ++k) {
+          w.walk_id = uint64_t(w.current) * walks_per_vertex + k;
+          queue.push_back(w);
+        }
+      }
+
+      std::vector<std::string> outputs(ncpus);
+      std::vector<size_t> visits(ncpus, 0);
+      size_t rounds = 0;
+      while (true) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+        for (int i = 0; i < (int)queue.size(); ++i) {
+          const size_t tid = thread_id();
+          advance(queue[i], tid, outputs[tid], visits[tid]);
+        }
+        walker_exchange.flush();
+
+        queue.clear();
+        procid_t sendid;
+        typename buffered_exchange<walker>::buffer_type buffer;
+        while (walker_exchange.recv(sendid, buffer)) {
+          queue.insert(queue.end(), buffer.begin(), buffer.end());
+        }
+        walker_exchange.barrier();
+        ++rounds;
+        size_t active = queue.size();
+        rmi.all_reduce(active);
+        if (active == 0) break;
+      }
+
+      size_t total_visits = 0;
+      for (size_t i = 0; i < ncpus; ++i) {
+        write_output(outputs[i]);
+        total_visits += visits[i];
+      }
+      fout.close();
+      rmi.all_reduce(total_visits);
+      if (rmi.procid() == 0) {
+        logstream(LOG_EMPH) << "Random walks: " << total_visits << " visits in "
+                            << rounds << " rounds, " << ti.current_time()
+                            << " seconds" << std::endl;
+      }
+      return total_visits;
+    }
+
+  private:
+    /** The exchange buffer of the calling thread */
+    inline size_t thread_id() const {
+#ifdef _OPENMP
+      return omp_get_thread_num() % ncpus;
+#else
+      return 0;
+#endif
+    }
+
+    /** The number of neighbors of lvid */
+    inline size_t degree(lvid_type lvid) const {
+      return offsets[lvid + 1] - offsets[lvid];
+    }
+
+    /** Returns true if vid is a neighbor of the local vertex lvid */
+    bool has_neighbor(lvid_type lvid, vertex_id_type vid) const {
+      if (directed) {
+        // x is an out-neighbor of vid iff vid is an in-neighbor of x
+        return std::binary_search(in_nbrs.begin() + in_offsets[lvid],
+                                  in_nbrs.begin() + in_offsets[lvid + 1], vid);
+      }
+      size_t lo = offsets[lvid], hi = offsets[lvid + 1];
+      while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (nbrs[mid].vid < vid) lo = mid + 1;
+        else hi = mid;
+      }
+      return lo < offsets[lvid + 1] && nbrs[lo].vid == vid;
+    }
+
+    void write_output(std::string& out) {
+      fout_lock.lock();
+      fout.write(out.c_str(), out.size());
+      fout_lock.unlock();
+      out.clear();
+    }
+
+    /**
+     * Advances a walker on this machine until it ends or leaves the
+     * machine.
+     */
+    void advance(walker w, size_t tid, std::string& out, size_t& visits) {
+      random::fast_generator& rng = random::get_fast_source();
+      const procid_t procid = rmi.procid();
+      while (true) {
+        if (w.state == TEST) {
+          const lvid_type lvid = graph.local_vid(w.candidate);
+          double alpha;
+          if (w.candidate == w.prev) alpha = 1.0 / p;
+          else if (has_neighbor(lvid, w.prev)) alpha = 1.0;
+          else alpha = 1.0 / q;
+          if (rng.uniform01() * max_alpha < alpha) {
+            w.prev = w.current;
+            w.current = w.candidate;
+            w.current_owner = w.candidate_owner;
+            ++w.step;
+            w.state = ARRIVE;
+          } else {
+            w.state = SAMPLE;
+            if (w.current_owner != procid) {
+              walker_exchange.send(w.current_owner, w, tid);
+              return;
+            }
+          }
+          continue;
+        }
+
+        const lvid_type lvid = graph.local_vid(w.current);
+        if (w.state == ARRIVE) {
+          builtin_parsers::append_uint(out, w.walk_id);
+          out += '\t';
+          builtin_parsers::append_uint(out, w.step);
+          out += '\t';
+          builtin_parsers::append_uint(out, w.current);
+          out += '\n';
+          ++visits;
+          if (out.size() > OUTPUT_BUFFER_SIZE) write_output(out);
+          if (w.step + 1 >= walk_length || degree(lvid) == 0 ||
+              (restart > 0 && rng.uniform01() < restart)) return;
+        }
+
+        const size_t begin = offsets[lvid];
+        const neighbor& next = nbrs[begin +
+            alias_multinomial::sample_table(&prob[begin], &alias[begin],
+                                            degree(lvid), rng)];
+        procid_t target;
+        if (second_order && w.step > 0) {
+          w.candidate = next.vid;
+          w.candidate_owner = next.owner;
+          w.state = TEST;
+          target = next.owner;
+        } else {
+          w.prev = w.current;
+          w.current = next.vid;
+          w.current_owner = next.owner;
+          ++w.step;
+          w.state = ARRIVE;
+          target = next.owner;
+        }
+        if (target != procid) {
+          walker_exchange.send(target, w, tid);
+          return;
+        }
+      }
+    }
+  }; // end of random_walk_engine
+
+} // end of namespace graphlab
+
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_ENGINE_SCHEDULE_TRACE_HPP
+#define GRAPHLAB_ENGINE_SCHEDULE_TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Records the schedule of an asynchronous engine run on one
+   * machine, and replays it in a later run.
+   *
+   * The schedule is the sequence of vertices each engine fiber takes
+   * from the scheduler, and the order in which the distributed locks
+   * are granted. When replaying, every fiber takes the vertices of its
+   * recorded sequence in order, so that two builds run the same work
+   * in the same order. A recorded vertex which has no message is
+   * waited for a little, since the signal may still be in flight, and
+   * then skipped. Once its sequence is exhausted a fiber falls back to
+   * the scheduler. The lock grant order cannot be imposed, as it is
+   * decided by the lock protocol across machines, so it is only
+   * compared with the recorded one to measure how far the replay
+   * diverged.
+   *
+   * The trace of a machine is a file of zigzag varint deltas between
+   * consecutive vertices, a few bytes per task.
+   */
+  class schedule_trace {
+  public:
+    enum mode_type { OFF, RECORD, REPLAY };
+
+    /// The number of yields a replay waits for a recorded vertex
+    enum { REPLAY_PATIENCE = 16 };
+
+    schedule_trace() : mode(OFF) { }
+
+    /// Parses "record" or "replay"
+    static mode_type parse_mode(const std::string& str) {
+      if (str == "record") return RECORD;
+      else if (str == "replay") return REPLAY;
+      logstream(LOG_FATAL) << "Invalid schedule mode: " << str
+                           << ". Expected record or replay" << std::endl;
+      return OFF;
+    }
+
+    void set_mode(mode_type new_mode) { mode = new_mode; }
+
+    bool recording() const { return mode == RECORD; }
+
+    bool replaying() const { return mode == REPLAY; }
+
+    /**
+     * Starts a run of nworkers fibers. When replaying, reads the trace
+     * recorded in fname, which must have been recorded with as many
+     * fibers.
+     */
+    void begin(size_t nworkers, const std::string& fname) {
+      tasks.clear();
+      tasks.resize(nworkers);
+      positions.assign(nworkers, 0);
+      grants.clear();
+      recorded_grants.clear();
+      skipped = 0;
+      if (mode == REPLAY) {
+        read_file(fname);
+        if (tasks.size() != nworkers) {
+          logstream(LOG_FATAL) << "The schedule trace " << fname << " was "
+                               << "recorded with " << tasks.size()
+                               << " fibers. Replay with nfibers="
+                               << tasks.size() << std::endl;
+        }
+      }
+    }
+
+    /// Records that a worker took lvid. Only called by that worker.
+    inline void record_task(size_t worker, lvid_type lvid) {
+      tasks[worker].push_back(lvid);
+    }
+
+    /**
+     * Sets lvid to the next recorded vertex of a worker. Returns false
+     * once the recorded sequence of the worker is exhausted.
+     */
+    inline bool next_task(size_t worker, lvid_type& lvid) {
+      if (positions[worker] >= tasks[worker].size()) return false;
+      lvid = tasks[worker][positions[worker]++];
+      return true;
+    }
+
+    /// Counts a recorded vertex which had no message when replayed
+    inline void task_skipped() { skipped.inc(); }
+
+    /// Records that the locks of lvid were granted
+    void record_grant(lvid_type lvid) {
+      grant_lock.lock();
+      grants.push_back(lvid);
+      grant_lock.unlock();
+    }
+
+    /// Ends a run. When recording, writes the trace to fname.
+    void end(const std::string& fname) {
+      if (mode == RECORD) write_file(fname);
+    }
+
+    /// The number of recorded tasks
+    size_t num_tasks() const {
+      size_t n = 0;
+      for (size_t i = 0; i < tasks.size(); ++i) n += tasks[i].size();
+      return n;
+    }
+
+    /// The number of recorded tasks skipped by the replay
+    size_t num_skipped() const { return skipped.value; }
+
+    /// The number of lock grants of the replay in the recorded order
+    size_t num_grants_in_order() const {
+      size_t n = 0;
+      while (n < grants.size() && n < recorded_grants.size() &&
+             grants[n] == recorded_grants[n]) ++n;
+      return n;
+    }
+
+    size_t num_grants() const { return grants.size(); }
+
+  private:
+    mode_type mode;
+    /// The sequence of vertices of each worker
+    std::vector<std::vector<lvid_type> > tasks;
+    /// The next vertex of each worker to replay
+    std::vector<size_t> positions;
+    /// The lock grants of this run, and of the recorded run
+    std::vector<lvid_type> grants, recorded_grants;
+    mutex grant_lock;
+    atomic<size_t> skipped;
+
+    static const char* magic() { return "GLSCHED1"; }
+
+    static void write_sequence(oarchive& oarc, const std::vector<lvid_type>& seq) {
+      oarc.write_integer(uint64_t(seq.size()));
+      int64_t prev = 0;
+      for (size_t i = 0; i < seq.size(); ++i) {
+        oarc.write_integer(int64_t(seq[i]) - prev);
+        prev = int64_t(seq[i]);
+      }
+    }
+
+    static void read_sequence(iarchive& iarc, std::vector<lvid_type>& seq) {
+      uint64_t n = 0;
+      iarc.read_integer(n);
+      seq.resize(n);
+      int64_t prev = 0;
+      for (size_t i = 0; i < seq.size(); ++i) {
+        int64_t delta = 0;
+        iarc.read_integer(delta);
+        prev += delta;
+        seq[i] = lvid_type(prev);
+      }
+    }
+
+    void write_file(const std::string& fname) {
+      std::ofstream fout(fname.c_str(), std::ios_base::out |
+                         std::ios_base::binary | std::ios_base::trunc);
+      fout.write(magic(), 8);
+      oarchive oarc(fout);
+      oarc.compact = true;
+      oarc.write_integer(uint64_t(tasks.size()));
+      for (size_t i = 0; i < tasks.size(); ++i) write_sequence(oarc, tasks[i]);
+      write_sequence(oarc, grants);
+      fout.close();
+      if (fout.fail()) {
+        logstream(LOG_ERROR) << "Error writing the schedule trace " 
+                             << fname << std::endl;
+      }
+    }
+
+    void read_file(const std::string& fname) {
+      std::ifstream fin(fname.c_str(), std::ios_base::in | std::ios_base::binary);
+      std::string m(8, '\0');
+      if (!fin.read(&m[0], 8) || m != magic()) {
+        logstream(LOG_FATAL) << "Cannot read the schedule trace " 
+                             << fname << std::endl;
+      }
+      iarchive iarc(fin);
+      iarc.compact = true;
+      uint64_t nworkers = 0;
+      iarc.read_integer(nworkers);
+      tasks.resize(nworkers);
+      for (size_t i = 0; i < tasks.size(); ++i) read_sequence(iarc, tasks[i]);
+      read_sequence(iarc, recorded_grants);
+      positions.assign(tasks.size(), 0);
+    }
+  }; // end of schedule_trace
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_ENGINE_SUPERSTEP_LOG_HPP
+#define GRAPHLAB_ENGINE_SUPERSTEP_LOG_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <graphlab/serialization/is_pod.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/ui/metrics_server.hpp>
+#include <graphlab/ui/openmetrics.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/util/memory_accounting.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief The performance of one super-step of the synchronous engine.
+   *
+   * Times are in seconds. The wall time of a phase includes the barrier
+   * which ends it. The thread times are the busy times of the fastest
+   * and the slowest engine thread in the phase, so their difference is
+   * the load imbalance of the phase. The memory of each subsystem is
+   * its largest size seen at the end of a phase.
+   */
+  struct superstep_record : public IS_POD_TYPE {
+    enum phase_type { EXCHANGE, RECEIVE, GATHER, APPLY, SCATTER, AGGREGATE,
+                      NUM_PHASES };
+    size_t iteration;
+    size_t active_vertices;
+    double wall_time[NUM_PHASES];
+    /// The bytes sent during each phase, excluding headers
+    size_t bytes_sent[NUM_PHASES];
+    double min_thread_time[NUM_PHASES];
+    double max_thread_time[NUM_PHASES];
+    /// The peak bytes of each memory_accounting tag
+    size_t peak_memory[memory_accounting::NUM_TAGS];
+
+    superstep_record() : iteration(0), active_vertices(0) {
+      std::fill(wall_time, wall_time + NUM_PHASES, 0.0);
+      std::fill(bytes_sent, bytes_sent + NUM_PHASES, size_t(0));
+      std::fill(min_thread_time, min_thread_time + NUM_PHASES, 0.0);
+      std::fill(max_thread_time, max_thread_time + NUM_PHASES, 0.0);
+      std::fill(peak_memory, peak_memory + memory_accounting::NUM_TAGS,
+                size_t(0));
+    }
+
+    /// Raises the peaks to a memory_accounting::usage() sample
+    void sample_memory(const std::vector<size_t>& usage) {
+      for (size_t t = 0; t < memory_accounting::NUM_TAGS; ++t) {
+        peak_memory[t] = std::max(peak_memory[t], usage[t]);
+      }
+    }
+
+    static const char* phase_name(size_t phase) {
+      static const char* names[NUM_PHASES] =
+        { "exchange", "receive", "gather", "apply", "scatter", "aggregate" };
+      return names[phase];
+    }
+
+    /**
+     * Merges the record of the same super-step on another machine. The
+     * bytes are summed, the wall times, the slowest threads and the
+     * memory take the maximum and the fastest threads the minimum.
+     */
+    superstep_record& operator+=(const superstep_record& other) {
+      for (size_t p = 0; p < NUM_PHASES; ++p) {
+        wall_time[p] = std::max(wall_time[p], other.wall_time[p]);
+        bytes_sent[p] += other.bytes_sent[p];
+        min_thread_time[p] = std::min(min_thread_time[p],
+                                      other.min_thread_time[p]);
+        max_thread_time[p] = std::max(max_thread_time[p],
+                                      other.max_thread_time[p]);
+      }
+      for (size_t t = 0; t < memory_accounting::NUM_TAGS; ++t) {
+        peak_memory[t] = std::max(peak_memory[t], other.peak_memory[t]);
+      }
+      return *this;
+    }
+  }; // end of superstep_record
+
+
+  /**
+   * \brief The per super-step performance log of a synchronous engine
+   * run.
+   *
+   * Every machine records its own super-steps. At the end of the run
+   * merge() combines the records of all machines. Machine 0 serves the
+   * log on the metrics server as superstep_log.json, with its local
+   * records while the engine runs and the merged ones afterwards.
+   */
+  class superstep_log {
+   public:
+    void clear() { records.clear(); }
+
+    /// Starts the record of a new super-step and returns it
+    superstep_record& begin_superstep(size_t iteration) {
+      records.push_back(superstep_record());
+      records.back().iteration = iteration;
+      return records.back();
+    }
+
+    /// The record of the current super-step
+    superstep_record& current() {
+      ASSERT_FALSE(records.empty());
+      return records.back();
+    }
+
+    const std::vector<superstep_record>& get_records() const {
+      return records;
+    }
+
+    /**
+     * Combines the records of all machines. Must be called on all
+     * machines simultaneously, each having run the same super-steps.
+     */
+    template <typename RMI>
+    void merge(RMI& rmi) {
+      rmi.all_reduce2(records, merge_records);
+    }
+
+    std::string to_csv() const {
+      std::stringstream strm;
+      strm << "iteration,active_vertices";
+      for (size_t p = 0; p < superstep_record::NUM_PHASES; ++p) {
+        const char* name = superstep_record::phase_name(p);
+        strm << "," << name << "_time," << name << "_bytes,"
+             << name << "_min_thread," << name << "_max_thread";
+      }
+      for (size_t t = 0; t < memory_accounting::NUM_TAGS; ++t) {
+        strm << ",memory_" << memory_accounting::tag_name(t);
+      }
+      strm << "\n";
+      for (size_t i = 0; i < records.size(); ++i) {
+        const superstep_record& rec = records[i];
+        strm << rec.iteration << "," << rec.active_vertices;
+        for (size_t p = 0; p < superstep_record::NUM_PHASES; ++p) {
+          strm << "," << rec.wall_time[p] << "," << rec.bytes_sent[p]
+               << "," << rec.min_thread_time[p]
+               << "," << rec.max_thread_time[p];
+        }
+        for (size_t t = 0; t < memory_accounting::NUM_TAGS; ++t) {
+          strm << "," << rec.peak_memory[t];
+        }
+        strm << "\n";
+      }
+      return strm.str();
+    }
+
+    std::string to_json() const {
+      std::stringstream strm;
+      strm << "[";
+      for (size_t i = 0; i < records.size(); ++i) {
+        const superstep_record& rec = records[i];
+        strm << (i == 0 ? "" : ",")
+             << "\n  {\"iteration\": " << rec.iteration
+             << ", \"active_vertices\": " << rec.active_vertices;
+        for (size_t p = 0; p < superstep_record::NUM_PHASES; ++p) {
+          strm << ",\n   \"" << superstep_record::phase_name(p) << "\": "
+               << "{\"time\": " << rec.wall_time[p]
+               << ", \"bytes\": " << rec.bytes_sent[p]
+               << ", \"min_thread\": " << rec.min_thread_time[p]
+               << ", \"max_thread\": " << rec.max_thread_time[p] << "}";
+        }
+        strm << ",\n   \"memory\": {";
+        for (size_t t = 0; t < memory_accounting::NUM_TAGS; ++t) {
+          strm << (t == 0 ? "" : ", ") << "\"" << memory_accounting::tag_name(t)
+               << "\": " << rec.peak_memory[t];
+        }
+        strm << "}}";
+      }
+      strm << "\n]\n";
+      return strm.str();
+    }
+
+    /**
+     * Writes the log to path, as JSON if the path ends with ".json" and
+     * as CSV otherwise. Returns false if the file could not be written.
+     */
+    bool save(const std::string& path) const {
+      const std::string ext = ".json";
+      const bool json = path.length() >= ext.length() &&
+          path.compare(path.length() - ext.length(), ext.length(), ext) == 0;
+      std::ofstream fout(path.c_str());
+      fout << (json ? to_json() : to_csv());
+      return fout.good();
+    }
+
+    /// Makes this the log served by the metrics server and its /metrics page
+    void publish() const {
+      published_log_lock().lock();
+      published_log() = records;
+      static bool registered = false;
+      if (!registered) {
+        add_metric_server_callback("superstep_log.json",
+                                   superstep_log::log_page);
+        add_openmetrics_source("superstep", superstep_log::write_metrics);
+        registered = true;
+      }
+      published_log_lock().unlock();
+    }
+
+   private:
+    std::vector<superstep_record> records;
+
+    static void merge_records(std::vector<superstep_record>& a,
+                              const std::vector<superstep_record>& b) {
+      ASSERT_EQ(a.size(), b.size());
+      for (size_t i = 0; i < a.size(); ++i) a[i] += b[i];
+    }
+
+    static std::vector<superstep_record>& published_log() {
+      static std::vector<superstep_record> log;
+      return log;
+    }
+
+    static mutex& published_log_lock() {
+      static mutex lock;
+      return lock;
+    }
+
+    static std::pair<std::string, std::string>
+    log_page(std::map<std::string, std::string>& varmap) {
+      superstep_log log;
+      published_log_lock().lock();
+      log.records = published_log();
+      published_log_lock().unlock();
+      if (varmap.count("format") && varmap["format"] == "csv") {
+        return std::make_pair(std::string("text/plain"), log.to_csv());
+      }
+      return std::make_pair(std::string("application/json"), log.to_json());
+    }
+
+    /// The latest published super-step, as OpenMetrics gauges
+    static void write_metrics(openmetrics_writer& writer) {
+      published_log_lock().lock();
+      if (published_log().empty()) {
+        published_log_lock().unlock();
+        return;
+      }
+      const superstep_record rec = published_log().back();
+      published_log_lock().unlock();
+      writer.family("graphlab_superstep_iteration", "gauge",
+                    "Iteration of the latest super-step");
+      writer.sample("graphlab_superstep_iteration", rec.iteration);
+      writer.family("graphlab_superstep_active_vertices", "gauge",
+                    "Active vertices in the latest super-step");
+      writer.sample("graphlab_superstep_active_vertices", rec.active_vertices);
+      const char* names[] = { "graphlab_superstep_wall_seconds",
+                              "graphlab_superstep_bytes_sent",
+                              "graphlab_superstep_min_thread_seconds",
+                              "graphlab_superstep_max_thread_seconds" };
+      const char* help[] = { "Wall time of each phase of the latest super-step",
+                             "Bytes sent in each phase of the latest super-step",
+                             "Busy time of the fastest thread in each phase",
+                             "Busy time of the slowest thread in each phase" };
+      for (size_t m = 0; m < 4; ++m) {
+        writer.family(names[m], "gauge", help[m]);
+        for (size_t i = 0; i < superstep_record::NUM_PHASES; ++i) {
+          const double value =
+            m == 0 ? rec.wall_time[i] :
+            m == 1 ? double(rec.bytes_sent[i]) :
+            m == 2 ? rec.min_thread_time[i] : rec.max_thread_time[i];
+          writer.sample(names[m], value, std::string("phase=\"") +
+                        superstep_record::phase_name(i) + "\"");
+        }
+      }
+    }
+  }; // end of superstep_log
+
+} // end of namespace graphlab
+#endif
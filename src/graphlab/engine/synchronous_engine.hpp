@@ -26,7 +26,9 @@
 #define GRAPHLAB_SYNCHRONOUS_ENGINE_HPP
 
 #include <deque>
+#include <map>
 #include <boost/bind.hpp>
+#include <boost/mpl/if.hpp>
 
 #include <graphlab/engine/iengine.hpp>
 
@@ -35,15 +37,31 @@
 #include <graphlab/vertex_program/context.hpp>
 
 #include <graphlab/engine/execution_status.hpp>
+#include <graphlab/engine/async_checkpoint.hpp>
+#include <graphlab/engine/superstep_log.hpp>
+#include <graphlab/engine/vertex_state_array.hpp>
+#include <graphlab/graph/vertex_column.hpp>
+#include <graphlab/engine/gather_cache_budget.hpp>
+#include <graphlab/engine/thread_split_tuner.hpp>
 #include <graphlab/options/graphlab_options.hpp>
 
 
 
 
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
 #include <graphlab/parallel/fiber_barrier.hpp>
+#include <graphlab/parallel/numa_topology.hpp>
+#include <graphlab/parallel/fiber_profiler.hpp>
+#include <graphlab/parallel/sharded_counter.hpp>
+#include <graphlab/parallel/guided_chunk_dispenser.hpp>
+#include <graphlab/parallel/cache_line_pad.hpp>
 #include <graphlab/util/tracepoint.hpp>
+#include <graphlab/util/hybrid_bitset.hpp>
+#include <graphlab/util/generics/conditional_addition_wrapper.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/memory_accounting.hpp>
+#include <graphlab/util/arena.hpp>
 
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
@@ -188,6 +206,20 @@ namespace graphlab {
    * or update (\ref icontext::post_delta) the cache values of
    * neighboring vertices during the scatter phase.
    *
+   * \li \b cache_budget (default: 0) If positive and use_cache is set,
+   * the gather cache of each machine holds at most this many MB.
+   * The vertices of highest degree, whose gathers are the most
+   * expensive to recompute, are cached first and entries of lower
+   * degree are evicted to make room for them.
+   *
+   * \li \b cache_min_degree (default: 0) If use_cache is set, only the
+   * vertices with at least this many local edges are cached.
+   *
+   * \li \b use_arena (default: false) Start a new epoch of the thread
+   * arenas at every super-step, so that gather types and messages
+   * allocated with graphlab::arena_allocator are reclaimed without
+   * calling free. Cannot be combined with use_cache.
+   *
    * \li \b snapshot_interval If set to a positive value, a snapshot
    * is taken every this number of iterations. If set to 0, a snapshot
    * is taken before the first iteration. If set to a negative value,
@@ -199,6 +231,102 @@ namespace graphlab {
    * for the snapshot. The path including folder and file prefix in
    * which the snapshots should be saved.
    *
+   * \li \b checkpoint_interval If set to a positive value, the vertex
+   * data, edge data and pending messages are checkpointed every this
+   * number of iterations. Unlike snapshots, checkpoints are written by
+   * a background thread while the computation continues, and the graph
+   * structure is only saved once. Defaults to 0 (no checkpoints).
+   *
+   * \li \b checkpoint_path The file prefix of the checkpoints. The
+   * structure is saved to [checkpoint_path]structure_. If a complete
+   * checkpoint is found when the engine first starts, the computation
+   * resumes from it. The graph must then be loaded with
+   * load_binary([checkpoint_path]structure_) on the same number of
+   * machines. The checkpoints are removed when start() returns.
+   *
+   * \li \b superstep_log If set, machine 0 writes the performance log
+   * of every super-step to this file when start() returns: the wall
+   * time, the bytes sent and the fastest and slowest thread of each
+   * phase (exchange, receive, gather, apply, scatter, aggregate), and
+   * the number of active vertices. The file is JSON if the name ends
+   * with .json and CSV otherwise. The log is always served by the
+   * metrics server as superstep_log.json (add ?format=csv for CSV).
+   *
+   * \li \b prefetch_distance (default: 8) While gathering and
+   * scattering along the edges of a vertex, the data on the neighbor
+   * this many edges ahead is prefetched, as well as the edges of the
+   * next vertices. Set to 0 to disable prefetching.
+   *
+   * \li \b gather_tile_vertices (default: 0) If positive, the in edge
+   * gathers of dense super-steps are computed over tiles of
+   * gather_tile_vertices sources by gather_tile_vertices targets. Each
+   * thread takes a range of targets and sweeps their in edges one range
+   * of sources at a time, so that the data of the sources and the
+   * accumulators of the targets stay in cache. Pick it so that the data
+   * of that many vertices fits in the L2 cache. The tiled in edges do
+   * not use \ref graphlab::ivertex_program::gather_batch. 0 disables
+   * tiling.
+   *
+   * \li \b edge_centric_gather (default: false) If true, the gathers of
+   * the super-steps in which every vertex is active (e.g. with
+   * sched_allv) stream the local edges in order instead of visiting the
+   * edges of each vertex. Each thread takes ranges of sources, computes
+   * the gathers of their out edges and appends the contributions to the
+   * targets to one buffer per range of targets. Each thread then adds
+   * up the buffers of its own range of targets. Sources and edges are
+   * read sequentially, at the cost of buffering one gather result per
+   * edge gathered by its target. Does not use
+   * \ref graphlab::ivertex_program::gather_batch.
+   *
+   * \li \b rebalance_threshold (default: 0) If positive, every
+   * rebalance_interval iterations the machines compare the compute
+   * time they spent since the last check. If the slowest took more than
+   * rebalance_threshold times the mean (e.g. 1.3), the machines above
+   * the mean move the masters of some of their vertices to replicas on
+   * the machines below the mean. The work of a master is estimated by
+   * its apply and its mirrors. Only the ownership moves, the edges stay
+   * in place, so the graph may not be finalized again afterwards. 0
+   * disables rebalancing.
+   *
+   * \li \b rebalance_interval (default: 10) The number of iterations
+   * between two checks of the compute balance.
+   *
+   * \li \b straggler_threshold (default: 0) If positive, every machine
+   * reports to machine 0 when it finishes a phase. Once half of the
+   * machines are done, machine 0 logs the machines still running
+   * straggler_threshold times the median phase time later (e.g. 2),
+   * with the progress they report back, while the phase is still
+   * running. Phases shorter than 0.1s are not reported. When
+   * rebalance_threshold is also set, a straggler moves the next balance
+   * check to the end of the current iteration. The gathers of a
+   * straggler cannot be taken over by other machines since every edge
+   * is stored on a single machine, so moving masters is the only
+   * redistribution.
+   *
+   * \li \b auto_thread_split (default: false) If true, the busy time of
+   * the RPC handler threads is measured after every iteration, and the
+   * workers of the handlers busy more than 30% of the time are kept
+   * free of compute threads, until they are busy less than 15% of the
+   * time. See graphlab::thread_split_tuner. The split of every machine
+   * and the traffic between the machines are logged at the end.
+   *
+   * \li \b max_handler_workers (default: half of the workers) The
+   * largest number of workers auto_thread_split reserves for the
+   * handlers.
+   *
+   * \li \b sync_tolerance (default: 0) If positive, an apply whose
+   * change to the vertex data is smaller than sync_tolerance, as measured
+   * by \ref graphlab::ivertex_program::vertex_data_distance, is not sent
+   * to the mirrors. The distances of the skipped changes add up, so a
+   * mirror is never further than sync_tolerance away from its master.
+   * For convergent programs such as PageRank, belief propagation or
+   * Jacobi. Applies sending deltas (see delta_sync_interval) are always
+   * sent. 0 synchronizes every apply.
+   *
+   * \li \b sync_staleness (default: 10) With sync_tolerance, the skipped
+   * changes are sent every sync_staleness iterations and when the engine
+   * stops, so the mirrors are exact when start() returns.
+   *
    * \see graphlab::omni_engine
    * \see graphlab::async_consistent_engine
    * \see graphlab::semi_synchronous_engine
@@ -309,6 +437,9 @@ namespace graphlab {
      * \brief Local edge type used by the engine for fast indexing
      */
     typedef typename graph_type::local_edge_type      local_edge_type;
+    typedef typename graph_type::local_edge_span_type local_edge_span_type;
+    typedef typename graph_type::local_neighbor_prefetcher_type
+        local_neighbor_prefetcher_type;
 
     /**
      * \brief Local vertex id type used by the engine for fast indexing
@@ -363,6 +494,17 @@ namespace graphlab {
      */
     size_t max_iterations;
 
+    /**
+     * \brief When non zero, start() stops with
+     * execution_status::FRONTIER_HANDOFF at the first super-step with
+     * fewer signaled vertices than this, once a super-step had at least
+     * this many.
+     */
+    size_t handoff_threshold;
+
+    /// The vertex columns synchronized with the vertex data
+    std::vector<ivertex_column*> attached_columns;
+
 
    /* 
     * \brief When caching is enabled the gather phase is skipped for
@@ -373,6 +515,18 @@ namespace graphlab {
     */
     bool use_cache;
 
+    /// \brief The budget of the gather cache in MB. 0 is unbounded
+    size_t cache_budget_mb;
+
+    /// \brief Vertices with fewer local edges are not cached
+    size_t cache_min_degree;
+
+    /// \brief Reset the thread arenas at every super-step
+    bool use_arena;
+
+    /// \brief Selects the vertices to cache and counts hits and misses
+    gather_cache_budget cache_budget;
+
     /**
      * \brief A snapshot is taken every this number of iterations.
      * If snapshot_interval == 0, a snapshot is only taken before the first
@@ -383,6 +537,27 @@ namespace graphlab {
     /// \brief The target base name the snapshot is saved in.
     std::string snapshot_path;
 
+    /// \brief Checkpoints are taken every this number of iterations if > 0
+    int checkpoint_interval;
+
+    /// \brief The file prefix of the checkpoints
+    std::string checkpoint_path;
+
+    /// \brief The performance log of the super-steps of the last run
+    superstep_log superstep_stats;
+
+    /// \brief If not empty, machine 0 saves superstep_stats here
+    std::string superstep_log_file;
+
+    /// \brief The busy time of each thread in the last phase
+    std::vector<double> phase_thread_time;
+
+    /// \brief Writes the checkpoints. NULL if checkpoints are disabled
+    async_checkpoint<graph_type, message_type>* checkpointer;
+
+    /// \brief Set once start() looked for a checkpoint to resume from
+    bool resume_checked;
+
     /**
      * \brief A counter that tracks the current iteration number since
      * start was last invoked.
@@ -429,21 +604,40 @@ namespace graphlab {
 
 
 
+    /**
+     * \brief True if the vertex program has no state of its own (see
+     * \ref graphlab::is_stateless_vertex_program). A single vertex
+     * program is then shared by all vertices and only the activation
+     * of the mirrors is synchronized.
+     */
+    static const bool stateless_vprog =
+        is_stateless_vertex_program<vertex_program_type>::value;
+
+    /**
+     * \brief The type of the array of vertex programs.
+     */
+    typedef typename boost::mpl::if_c<stateless_vprog,
+        shared_vertex_state<vertex_program_type>,
+        vertex_state_array<vertex_program_type> >::type vertex_program_array_type;
+
     /**
      * \brief The vertex programs associated with each vertex on this
-     * machine.
+     * machine. Only the chunks of the vertices in the current
+     * super-step are allocated.
      */
-    std::vector<vertex_program_type> vertex_programs;
+    vertex_program_array_type vertex_programs;
 
     /**
-     * \brief Vector of messages associated with each vertex.
+     * \brief Vector of messages associated with each vertex. Only the
+     * chunks of the signaled vertices are allocated, and empty messages
+     * take no storage.
      */
-    std::vector<message_type> messages;
+    typename vertex_state_storage<message_type>::type messages;
 
     /**
      * \brief Bit indicating whether a message is present for each vertex.
      */
-    dense_bitset has_message;
+    hybrid_bitset<lvid_type> has_message;
 
 
     /**
@@ -455,7 +649,7 @@ namespace graphlab {
      * once and therefore must be guarded by a vertex locks in
      * \ref graphlab::synchronous_engine::vlocks
      */
-    std::vector<gather_type>  gather_accum;
+    typename vertex_state_storage<gather_type>::type gather_accum;
 
     /**
      * \brief Bit indicating if the gather has accumulator contains any
@@ -475,9 +669,12 @@ namespace graphlab {
      * contributions for each machine.
      *
      * Caching is done locally and therefore a high-degree vertex may
-     * have multiple caches (one per machine).
+     * have multiple caches (one per machine). It is only sized when
+     * use_cache is set, and only the chunks of the vertices which have
+     * gathered are allocated. The chunks are small since only the
+     * vertices admitted by cache_budget are stored.
      */
-    std::vector<gather_type>  gather_cache;
+    typename vertex_state_storage<gather_type, 4>::type gather_cache;
 
     /**
      * \brief A bit indicating if the local gather for that vertex is
@@ -489,37 +686,319 @@ namespace graphlab {
      * \brief A bit (for master vertices) indicating if that vertex is active
      * (received a message on this iteration).
      */
-    dense_bitset active_superstep;
+    hybrid_bitset<lvid_type> active_superstep;
 
     /**
      * \brief  The number of local vertices (masters) that are active on this
-     * iteration.
+     * iteration. Sharded by thread.
      */
-    atomic<size_t> num_active_vertices;
+    sharded_counter<size_t> num_active_vertices;
 
     /**
      * \brief A bit indicating (for all vertices) whether to
      * participate in the current minor-step (gather or scatter).
      */
-    dense_bitset active_minorstep;
+    hybrid_bitset<lvid_type> active_minorstep;
+
+    /**
+     * \brief A counter measuring the number of applys that have been
+     * completed. Sharded by thread.
+     */
+    sharded_counter<size_t> completed_applys;
+
+
+    /**
+     * \brief Hands out the lvids (or sparse list entries) of the current
+     * phase to the threads in guided chunks.
+     */
+    guided_chunk_dispenser lvid_dispenser;
+
+    /**
+     * \brief The chunk each thread is currently working through, as
+     * [first, second).
+     */
+    std::vector<cache_line_pad<std::pair<size_t, size_t> > > thread_chunk;
+
+
+    /**
+     * \brief How active vertices are traversed: "dense" always scans
+     * the bitsets, "sparse" always iterates the frontier lists and
+     * "auto" picks per super-step based on the number of active vertices.
+     */
+    std::string frontier_mode;
+
+    /**
+     * \brief In "auto" frontier mode, the fraction of all vertices below
+     * which a super-step runs in sparse mode.
+     */
+    double sparse_threshold;
+
+    /**
+     * \brief The number of edges ahead of the gather and scatter loops
+     * whose neighbor data is prefetched. 0 disables prefetching.
+     */
+    size_t prefetch_distance;
+
+    /**
+     * \brief The number of sources and targets on each side of the
+     * tiles of the tiled gathers. 0 disables them.
+     */
+    size_t gather_tile_vertices;
+
+    /**
+     * \brief The accumulators computed by the tiled or the edge centric
+     * gathers before the vertices finish their gathers. Only sized if
+     * one of them is enabled.
+     */
+    std::vector<gather_type> local_accum;
+
+    /**
+     * \brief A bit indicating that the vertex was gathered into
+     * local_accum in this super-step: only its in edges for the tiled
+     * gathers, all its edges for the edge centric gathers.
+     */
+    dense_bitset has_local_accum;
+
+    /**
+     * \brief A bit indicating that local_accum holds a value.
+     */
+    dense_bitset local_accum_is_set;
+
+    /**
+     * \brief The next range of targets of the tiled gathers, or of
+     * sources of the edge centric gathers.
+     */
+    atomic<size_t> next_vertex_range;
+
+    /**
+     * \brief If true, super-steps with every vertex active gather edge
+     * centrically.
+     */
+    bool edge_centric_gather;
+
+    /**
+     * \brief True if the current super-step gathers edge centrically.
+     */
+    bool edge_centric_superstep;
+
+    /**
+     * \brief The gather direction of each vertex in an edge centric
+     * gather, NO_EDGES for the inactive vertices and those using their
+     * gather cache.
+     */
+    std::vector<edge_dir_type> streamed_dirs;
+
+    /**
+     * \brief The contributions to the targets of an edge centric
+     * gather, indexed by the thread computing them and then by the
+     * range of targets (one per thread).
+     */
+    std::vector<std::vector<std::vector<std::pair<lvid_type, gather_type> > > >
+        streamed_updates;
+
+    /**
+     * \brief If positive, the masters are rebalanced when the slowest
+     * machine took this many times the mean compute time.
+     */
+    double rebalance_threshold;
+
+    /**
+     * \brief The number of iterations between two balance checks.
+     */
+    size_t rebalance_interval;
+
+    /**
+     * \brief The compute time of this machine at the last balance check.
+     */
+    double last_rebalance_compute_time;
+
+    /**
+     * \brief If positive, the machines taking this many times the median
+     * time of a phase are logged as stragglers.
+     */
+    double straggler_threshold;
+
+    /**
+     * \brief The number of phases run so far, the same on all machines.
+     */
+    size_t phase_sequence;
+
+    /**
+     * \brief The number of threads of the current phase which finished.
+     */
+    atomic<size_t> finished_threads;
+
+    /**
+     * \brief On machine 0, the machines which finished each phase with
+     * their times, by phase sequence. Protected by straggler_lock.
+     */
+    std::map<size_t, std::vector<std::pair<procid_t, double> > > phase_reports;
+    mutex straggler_lock;
+    conditional straggler_cond;
+
+    /**
+     * \brief On machine 0, true if a straggler was seen since the last
+     * balance check.
+     */
+    bool straggler_seen;
+
+    /**
+     * \brief If true, the compute threads are kept off the workers of
+     * the busy RPC handlers.
+     */
+    bool auto_thread_split;
+
+    /**
+     * \brief The largest number of workers reserved for the handlers.
+     */
+    size_t max_handler_workers;
+
+    /**
+     * \brief Chooses the workers of the compute threads if
+     * auto_thread_split is set.
+     */
+    thread_split_tuner split_tuner;
+
+    /**
+     * \brief True if the engine is restricted to the vertices of
+     * subgraph (see set_subgraph()).
+     */
+    bool has_subgraph;
+
+    /**
+     * \brief The local vertices of the subgraph the engine runs on.
+     */
+    dense_bitset subgraph;
+
+    /**
+     * \brief Returns true if the local vertex is in the subgraph the
+     * engine runs on.
+     */
+    inline bool in_subgraph(lvid_type lvid) const {
+      return !has_subgraph || (lvid < subgraph.size() && subgraph.get(lvid));
+    }
+
+    /**
+     * \brief True if the active bitsets track their set bits in a
+     * sparse list (frontier_mode is not "dense").
+     */
+    bool track_frontier;
+
+    /**
+     * \brief True if the current phase iterates the sparse lists of the
+     * active bitsets.
+     */
+    bool sparse_superstep;
+
+    /**
+     * \brief True if the current phase traverses a sparse list.
+     */
+    bool sparse_phase;
+
+    /**
+     * \brief The number of sparse list entries traversed by the current
+     * phase.  Fixed before the phase starts since the list may grow
+     * while the phase is running.
+     */
+    size_t sparse_phase_end;
+
+    /**
+     * \brief With NUMA placement the dense phases split the local
+     * vertices into one range per node, [numa_range[k],
+     * numa_range[k + 1]). The workers of a node claim chunks from their
+     * own range first, through numa_dispenser[k], and then help with
+     * the other ranges. Empty when NUMA placement is disabled.
+     */
+    std::vector<size_t> numa_range;
+    std::vector<guided_chunk_dispenser> numa_dispenser;
+
+    /**
+     * \brief If set, a master runs apply as soon as the gather
+     * contributions of all of its mirrors have arrived instead of
+     * waiting for the gather phase to finish on all machines.
+     */
+    bool pipeline_gather_apply;
+
+    /**
+     * \brief True while the current gather phase applies vertices as
+     * their gathers complete.
+     */
+    bool pipelined_phase;
+
+    /**
+     * \brief For each thread, the masters whose pipelined gather
+     * completed while the local gathers were still running.  They are
+     * applied once every thread finished gathering, since apply writes
+     * vertex data the other gathers may be reading.
+     */
+    std::vector<std::vector<lvid_type> > pipelined_ready;
+
+    /**
+     * \brief For each master participating in a pipelined gather, the
+     * number of gather contributions (local and from mirrors) which
+     * have not yet arrived.  Protected by the vertex locks.
+     */
+    std::vector<uint32_t> pending_gathers;
+
+    /**
+     * \brief The vertices which are to scatter after being applied
+     * during a pipelined gather.  Swapped into active_minorstep once the
+     * gather phase completes.
+     */
+    hybrid_bitset<lvid_type> pipelined_minorstep;
+
+    /**
+     * \brief If positive, mirrors are updated with the vertex deltas
+     * produced by the vertex program except on every
+     * delta_sync_interval'th iteration which synchronizes the full
+     * vertex data.
+     */
+    int delta_sync_interval;
 
     /**
-     * \brief A counter measuring the number of applys that have been completed
+     * \brief True if the applys of the current super-step send deltas
+     * instead of the full vertex data.
      */
-    atomic<size_t> completed_applys;
+    bool delta_superstep;
 
+    /**
+     * \brief If positive, the applies changing the vertex data by less
+     * than this are not sent to the mirrors.
+     */
+    double sync_tolerance;
+
+    /**
+     * \brief The number of iterations between two synchronizations of
+     * the skipped changes.
+     */
+    size_t sync_staleness;
+
+    /**
+     * \brief The sum of the distances of the changes of each master not
+     * sent to its mirrors.
+     */
+    std::vector<double> unsynced_distance;
 
     /**
-     * \brief The shared counter used coordinate operations between
-     * threads.
+     * \brief The masters with changes not sent to their mirrors.
      */
-    atomic<size_t> shared_lvid_counter;
+    hybrid_bitset<lvid_type> unsynced_masters;
 
 
     /**
-     * \brief The pair type used to synchronize vertex programs across machines.
+     * \brief The position of a vertex in the communication plan of the
+     * graph (see \ref graphlab::shared_vertex_index). The exchanges 
+     * between masters and mirrors identify vertices by position rather
+     * than by gvid.
      */
-    typedef std::pair<vertex_id_type, vertex_program_type> vid_prog_pair_type;
+    typedef shared_vertex_index::position_type position_type;
+
+    /**
+     * \brief The pair type used to synchronize vertex programs across
+     * machines. Stateless vertex programs only send the position.
+     */
+    typedef typename boost::mpl::if_c<stateless_vprog, position_type,
+        std::pair<position_type, vertex_program_type> >::type vid_prog_pair_type;
 
     /**
      * \brief The type of the exchange used to synchronize vertex programs
@@ -535,7 +1014,7 @@ namespace graphlab {
     /**
      * \brief The pair type used to synchronize vertex across across machines.
      */
-    typedef std::pair<vertex_id_type, vertex_data_type> vid_vdata_pair_type;
+    typedef std::pair<position_type, vertex_data_type> vid_vdata_pair_type;
 
     /**
      * \brief The type of the exchange used to synchronize vertex data
@@ -548,10 +1027,32 @@ namespace graphlab {
      */
     vdata_exchange_type vdata_exchange;
 
+    /**
+     * \brief The vertex delta type defined by the vertex program (see
+     * \ref graphlab::ivertex_program::vertex_delta_type).
+     */
+    typedef typename VertexProgram::vertex_delta_type vertex_delta_type;
+
+    /**
+     * \brief The pair type used to send vertex deltas to mirrors.
+     */
+    typedef std::pair<position_type, vertex_delta_type> vid_vdelta_pair_type;
+
+    /**
+     * \brief The type of the exchange used to send vertex deltas
+     */
+    typedef fiber_buffered_exchange<vid_vdelta_pair_type> vdelta_exchange_type;
+
+    /**
+     * \brief The distributed exchange used to send the changes to
+     * vertex data as deltas.
+     */
+    vdelta_exchange_type vdelta_exchange;
+
     /**
      * \brief The pair type used to synchronize the results of the gather phase
      */
-    typedef std::pair<vertex_id_type, gather_type> vid_gather_pair_type;
+    typedef std::pair<position_type, gather_type> vid_gather_pair_type;
 
     /**
      * \brief The type of the exchange used to synchronize gather
@@ -565,10 +1066,32 @@ namespace graphlab {
      */
     gather_exchange_type gather_exchange;
 
+    /**
+     * \brief The pair type used to send possibly empty gather
+     * contributions from mirrors when gathers are pipelined.
+     */
+    typedef std::pair<position_type,
+                      conditional_addition_wrapper<gather_type> >
+        vid_partial_gather_pair_type;
+
+    /**
+     * \brief The type of the exchange used to send pipelined gather
+     * contributions
+     */
+    typedef fiber_buffered_exchange<vid_partial_gather_pair_type>
+        partial_gather_exchange_type;
+
+    /**
+     * \brief The distributed exchange used to send pipelined gather
+     * contributions.  Every mirror participating in a gather sends
+     * exactly one contribution so the master knows when it is complete.
+     */
+    partial_gather_exchange_type partial_gather_exchange;
+
     /**
      * \brief The pair type used to synchronize messages
      */
-    typedef std::pair<vertex_id_type, message_type> vid_message_pair_type;
+    typedef std::pair<position_type, message_type> vid_message_pair_type;
 
     /**
      * \brief The type of the exchange used to synchronize messages
@@ -587,10 +1110,35 @@ namespace graphlab {
      */
     aggregator_type aggregator;
 
+    /**
+     * \brief True if apply (scatter) feeds each vertex (edge) to the
+     * fused aggregators (see iengine::aggregate_fused()).
+     */
+    bool fuse_vertex_aggregators, fuse_edge_aggregators;
+
     DECLARE_EVENT(EVENT_APPLIES);
     DECLARE_EVENT(EVENT_GATHERS);
     DECLARE_EVENT(EVENT_SCATTERS);
     DECLARE_EVENT(EVENT_ACTIVE_CPUS);
+
+    DECLARE_TRACER(syncengine_vertex_gather);
+    DECLARE_TRACER(syncengine_vertex_apply);
+
+    /// The memory_accounting sources of the engine state
+    std::vector<size_t> memory_source_ids;
+
+    /// The bytes of the vertex programs and the vertex locks
+    size_t engine_state_bytes() const;
+
+    /// The bytes of the message array
+    size_t message_bytes() const;
+
+    /// The bytes of the gather accumulators and the gather cache
+    size_t gather_bytes() const;
+
+    /// The bytes of the values received by the exchanges but not yet
+    /// processed
+    size_t exchange_bytes();
   public:
 
     /**
@@ -625,6 +1173,13 @@ namespace graphlab {
     synchronous_engine(distributed_control& dc, graph_type& graph,
                        const graphlab_options& opts = graphlab_options());
 
+    ~synchronous_engine() {
+      for (size_t i = 0; i < memory_source_ids.size(); ++i) {
+        memory_accounting::remove_source(memory_source_ids[i]);
+      }
+      delete checkpointer;
+    }
+
 
     /**
      * \brief Start execution of the synchronous engine.
@@ -656,6 +1211,28 @@ namespace graphlab {
                     const message_type& message = message_type(),
                     const std::string& order = "shuffle");
 
+    /**
+     * \brief Restricts the engine to the subgraph induced by vset.
+     *
+     * Until clear_subgraph() is called, only the vertices in vset can
+     * be signaled, and the gathers and scatters only visit the edges
+     * between two vertices of vset. The pending signals of the other
+     * vertices are dropped. The subgraph shares the structure and the
+     * data of the graph, so running on an induced subgraph (e.g. the
+     * remaining k-core) neither copies the graph nor rebuilds the
+     * engine. vset must hold the same bit on masters and mirrors, as
+     * the sets returned by distributed_graph::select() do.
+     *
+     * The batch, tiled and edge centric gathers are not used on a
+     * subgraph. Must not be called while the engine is running.
+     */
+    void set_subgraph(const vertex_set& vset);
+
+    /**
+     * \brief Lets the engine run on the whole graph again.
+     */
+    void clear_subgraph();
+
 
     // documentation inherited from iengine
     float elapsed_seconds() const;
@@ -687,6 +1264,36 @@ namespace graphlab {
      */
     aggregator_type* get_aggregator();
 
+    /**
+     * \brief Makes start() stop once the frontier drops below
+     * nvertices signaled vertices, leaving the messages of the
+     * remaining vertices to be collected with take_frontier().
+     * 0 disables the handoff.
+     */
+    void set_handoff_threshold(size_t nvertices);
+
+    /**
+     * \brief Keeps the mirrors of a vertex column up to date like the
+     * vertex data: after every apply, the value of the vertex in the
+     * column is sent to its mirrors, so the vertex program can keep its
+     * state in the column. Must be called on all machines, before
+     * start(). The column must outlive the engine.
+     *
+     * \see vertex_column
+     */
+    void attach_column(ivertex_column& column);
+
+    /**
+     * \brief Moves the messages of the signaled vertices owned by this
+     * machine into frontier, as pairs of local vertex id and message.
+     *
+     * Used after start() returned execution_status::FRONTIER_HANDOFF to
+     * continue the computation with another engine. No vertex program
+     * outlives a super-step, so the messages are the entire state of
+     * the computation.
+     */
+    void take_frontier(std::vector<std::pair<lvid_type, message_type> >& frontier);
+
     /**
      * \brief Initialize the engine and allocate datastructures for vertex, and lock,
      * clear all the messages.
@@ -726,6 +1333,23 @@ namespace graphlab {
     void internal_signal(const vertex_type& vertex,
                          const message_type& message = message_type());
 
+    /**
+     * \brief Visitor passed to vertex_set::for_each_lvid() which
+     * signals the master vertices of the set.
+     */
+    struct signal_visitor {
+      synchronous_engine* engine;
+      const message_type* message;
+      signal_visitor(synchronous_engine* engine, const message_type* message) :
+          engine(engine), message(message) { }
+      void operator()(size_t lvid) const {
+        if (engine->graph.l_is_master(lvid)) {
+          engine->internal_signal(vertex_type(engine->graph.l_vertex(lvid)),
+                                  *message);
+        }
+      }
+    };
+
     /**
      * \brief Called by the context to signal an arbitrary vertex.
      *
@@ -737,7 +1361,8 @@ namespace graphlab {
 
     /**
      * \brief This function tests if this machine is the master of
-     * gvid and signals if successful.
+     * gvid and signals if successful. A mirror forwards the signal to
+     * the master.
      */
     void internal_signal_rpc(vertex_id_type gvid,
                               const message_type& message = message_type());
@@ -764,13 +1389,82 @@ namespace graphlab {
      */
     void internal_clear_gather_cache(const vertex_type& vertex);
 
+    /**
+     * \brief The benefit of caching the gather of a vertex: its number
+     * of local edges.
+     */
+    size_t cache_benefit(lvid_type lvid) {
+      local_vertex_type local_vertex = graph.l_vertex(lvid);
+      return local_vertex.num_in_edges() + local_vertex.num_out_edges();
+    }
+
+    /**
+     * \brief Caches the local gather of a vertex if cache_budget admits
+     * it.
+     */
+    void store_gather_cache(lvid_type lvid, const gather_type& accum);
+
+    /**
+     * \brief Evicts the cache entries of the vertices whose benefit
+     * became too low for the budget.
+     */
+    void evict_gather_cache();
+
+    /**
+     * \brief Logs the gather cache hit rate of all the machines.
+     */
+    void log_gather_cache_stats();
+
+    /**
+     * \brief The compute time of all the threads of this machine.
+     */
+    double local_compute_time() const;
+
+    /**
+     * \brief Moves masters from the machines whose compute time since
+     * the last check is above the mean to their replicas on the
+     * machines below the mean, if the slowest machine exceeds
+     * rebalance_threshold times the mean. Must be called by all
+     * machines between super-steps.
+     */
+    void rebalance_masters();
+
+    /**
+     * \brief Called by every machine at the end of a phase. Machine 0
+     * waits for the reports of all the machines, logging the ones
+     * running straggler_threshold times the median time.
+     */
+    void report_phase_done(const char* phase, double phase_time);
+
+    /// Records on machine 0 that proc finished the phase sequence
+    void rpc_phase_done(size_t sequence, procid_t proc, double phase_time);
+
+    /// Asks a straggler to send its progress to machine 0
+    void rpc_request_progress(size_t sequence);
+
+    /**
+     * \brief Logs the thread split chosen by every machine and the
+     * heaviest entries of the traffic matrix on machine 0. Must be
+     * called by all machines.
+     */
+    void log_thread_split();
+
+    /// Logs the progress of a straggler on machine 0
+    void rpc_log_progress(size_t sequence, procid_t proc,
+                          size_t nfinished, double handed_out);
+
 
     // Program Steps ==========================================================
 
 
-    void thread_launch_wrapped_event_counter(boost::function<void(void)> fn) {
+    void thread_launch_wrapped_event_counter(boost::function<void(void)> fn,
+                                             size_t thread_id) {
+      fiber_control::set_fiber_label("synchronous_engine worker");
       INCREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
+      timer ti;
       fn();
+      phase_thread_time[thread_id] = ti.current_time();
+      finished_threads.inc();
       DECREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
     }
 
@@ -791,29 +1485,71 @@ namespace graphlab {
      *
      * @tparam the type of the member function.
      * @param [in] member_fun the function to call.
+     * @param [in] phase the phase name reported by the fiber_profiler
+     * @param [in] log_phase the phase of the current super-step record
+     *             to fill, or superstep_record::NUM_PHASES for none
      */
     template<typename MemberFunction>
-    void run_synchronous(MemberFunction member_fun) {
-      shared_lvid_counter = 0;
+    void run_synchronous(MemberFunction member_fun, const char* phase,
+                         size_t log_phase = superstep_record::NUM_PHASES) {
+      timer phase_timer;
+      const size_t bytes_before = rmi.dc().bytes_sent();
+      fiber_profiler::set_phase(phase);
+      const size_t WORD_SIZE = 8 * sizeof(size_t);
+      thread_chunk.assign(ncpus, std::make_pair(size_t(0), size_t(0)));
+      finished_threads = 0;
+      if (sparse_phase) {
+        lvid_dispenser.reset(0, sparse_phase_end, ncpus, 1, WORD_SIZE);
+      } else {
+        lvid_dispenser.reset(0, graph.num_local_vertices(), ncpus,
+                             WORD_SIZE, WORD_SIZE);
+      }
+      numa_range.clear(); numa_dispenser.clear();
+      if (numa_topology::enabled() && numa_topology::get().num_nodes() > 1) {
+        numa_range = numa_topology::get().partition(graph.num_local_vertices(),
+                                                    WORD_SIZE);
+        numa_dispenser.resize(numa_range.size() - 1);
+        const size_t node_cpus = std::max<size_t>(ncpus / numa_dispenser.size(), 1);
+        for (size_t k = 0; k < numa_dispenser.size(); ++k) {
+          numa_dispenser[k].reset(numa_range[k], numa_range[k + 1], node_cpus,
+                                  WORD_SIZE, WORD_SIZE);
+        }
+      }
       if (ncpus <= 1) {
         INCREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
       }
       // launch the initialization threads
       for(size_t i = 0; i < ncpus; ++i) {
         fiber_control::affinity_type affinity;
-        affinity.clear(); affinity.set_bit(i);
+        affinity.clear();
+        affinity.set_bit(auto_thread_split ? split_tuner.compute_worker(i) : i);
         boost::function<void(void)> invoke = boost::bind(member_fun, this, i);
         threads.launch(boost::bind(
               &synchronous_engine::thread_launch_wrapped_event_counter,
               this,
-              invoke), affinity);
+              invoke, i), affinity);
       }
       // Wait for all threads to finish
       threads.join();
+      fiber_profiler::set_phase(NULL);
+      if (straggler_threshold > 0 && rmi.numprocs() > 1) {
+        report_phase_done(phase, phase_timer.current_time());
+      }
+      ++phase_sequence;
       rmi.barrier();
       if (ncpus <= 1) {
         DECREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
       }
+      if (log_phase < superstep_record::NUM_PHASES) {
+        superstep_record& rec = superstep_stats.current();
+        rec.wall_time[log_phase] = phase_timer.current_time();
+        rec.bytes_sent[log_phase] = rmi.dc().bytes_sent() - bytes_before;
+        rec.min_thread_time[log_phase] =
+          *std::min_element(phase_thread_time.begin(), phase_thread_time.end());
+        rec.max_thread_time[log_phase] =
+          *std::max_element(phase_thread_time.begin(), phase_thread_time.end());
+        rec.sample_memory(memory_accounting::usage());
+      }
     } // end of run_synchronous
 
     // /**
@@ -854,6 +1590,38 @@ namespace graphlab {
      */
     void execute_gathers(size_t thread_id);
 
+    /**
+     * \brief Gathers the in edges of the active vertices tile by tile
+     * into local_accum (see the gather_tile_vertices option).
+     */
+    void execute_tiled_gathers(context_type& context);
+
+    /**
+     * \brief Gathers all the edges of every vertex into local_accum by
+     * streaming the local edges (see the edge_centric_gather option).
+     */
+    void execute_streamed_gathers(context_type& context, size_t thread_id);
+
+    /**
+     * \brief Returns the range of targets of an edge centric gather
+     * containing lvid.
+     */
+    inline size_t streamed_range(lvid_type lvid) const {
+      return size_t(lvid) * ncpus / graph.num_local_vertices();
+    }
+
+    /**
+     * \brief Runs the \ref graphlab::ivertex_program::gather_batch
+     * of the vertex program over the local edges in gather_dir.
+     *
+     * @return false if the vertex program does not support batch
+     * gathers, in which case accum is unchanged.
+     */
+    bool batch_gather(context_type& context,
+                      const vertex_program_type& vprog, lvid_type lvid,
+                      edge_dir_type gather_dir, gather_type& accum,
+                      bool& accum_is_set);
+
 
 
 
@@ -866,6 +1634,23 @@ namespace graphlab {
      */
     void execute_applys(size_t thread_id);
 
+    /**
+     * \brief Sends the vertex data of the masters whose changes were
+     * skipped under sync_tolerance to their mirrors.
+     */
+    void sync_unsynced_masters(size_t thread_id);
+
+    /**
+     * \brief Brings every mirror whose master skipped changes under
+     * sync_tolerance back in sync. Must be called by all machines.
+     */
+    void sync_skipped_changes() {
+      sparse_phase = false;
+      run_synchronous( &synchronous_engine::sync_unsynced_masters,
+                       "sync_unsynced_masters" );
+      unsynced_masters.clear();
+    }
+
     /**
      * \brief Execute the \ref graphlab::ivertex_program::scatter function on all
      * vertices that received messages for the edges specified by the
@@ -876,6 +1661,17 @@ namespace graphlab {
      */
     void execute_scatters(size_t thread_id);
 
+    /**
+     * \brief Prefetches the edges of block[j + 1] and the positions of
+     * the edges of block[j + 2], while block[j] gathers or scatters.
+     */
+    inline void prefetch_next_vertices(const std::vector<lvid_type>& block,
+                                       size_t j) const {
+      if (prefetch_distance == 0) return;
+      if (j + 2 < block.size()) graph.l_prefetch_edge_index(block[j + 2]);
+      if (j + 1 < block.size()) graph.l_prefetch_edge_lists(block[j + 1]);
+    }
+
     // Data Synchronization ===================================================
     /**
      * \brief Send the vertex program for the local vertex id to all
@@ -886,6 +1682,49 @@ namespace graphlab {
      */
     void sync_vertex_program(lvid_type lvid, size_t thread_id);
 
+    // Frontier Management ====================================================
+    /**
+     * \brief Claims the next block of active vertices for the calling
+     * thread.
+     *
+     * In sparse mode the block is drawn from the sparse list of the
+     * bitset, otherwise from the next word of the bitset.  Only
+     * vertices whose bit is currently set are returned.
+     *
+     * Blocks are taken from a per-thread chunk, which is refilled from
+     * the shared dispensers only when it runs out.
+     *
+     * @param [in] bits the bitset describing the active vertices
+     * @param [out] block the claimed vertices
+     * @param [in] thread_id the calling thread
+     * @return false once all active vertices have been claimed
+     */
+    bool next_active_block(hybrid_bitset<lvid_type>& bits,
+                           std::vector<lvid_type>& block,
+                           size_t thread_id);
+
+    /**
+     * \brief Claims the next chunk of lvids of the dense bitset,
+     * preferring the NUMA range of the calling worker. Returns false
+     * once all chunks are claimed.
+     */
+    bool next_dense_chunk(size_t& start, size_t& stop);
+
+    /**
+     * \brief Prepares the sparse list of the bitset for the next phase
+     * if it runs in sparse mode.
+     */
+    void begin_phase(hybrid_bitset<lvid_type>& bits) {
+      sparse_phase = sparse_superstep && bits.is_sparse();
+      sparse_phase_end = sparse_phase ? bits.compact_sparse() : 0;
+    }
+
+    /**
+     * \brief Decides if the next phases should run in sparse mode given
+     * the global number of active vertices.
+     */
+    bool use_sparse_frontier(size_t global_active) const;
+
     /**
      * \brief Receive all incoming vertex programs and update the
      * local mirrors.
@@ -896,6 +1735,41 @@ namespace graphlab {
      */
     void recv_vertex_programs();
 
+    /**
+     * \brief Fills the record synchronizing the vertex program lvid
+     * with the mirror at position pos.
+     */
+    void fill_vprog_record(position_type& rec, position_type pos,
+                           lvid_type lvid) const {
+      rec = pos;
+    }
+
+    void fill_vprog_record(std::pair<position_type, vertex_program_type>& rec,
+                           position_type pos, lvid_type lvid) const {
+      rec.first = pos;
+      rec.second = vertex_programs.get(lvid);
+    }
+
+    /**
+     * \brief Returns the position of a vertex program record and copies
+     * the vertex program it holds, if any, to the mirror lvid.
+     */
+    position_type vprog_record_position(const position_type& rec) {
+      return rec;
+    }
+
+    position_type vprog_record_position(
+        const std::pair<position_type, vertex_program_type>& rec) {
+      return rec.first;
+    }
+
+    void store_vprog_record(lvid_type lvid, const position_type& rec) { }
+
+    void store_vprog_record(lvid_type lvid,
+        const std::pair<position_type, vertex_program_type>& rec) {
+      vertex_programs[lvid] = rec.second;
+    }
+
     /**
      * \brief Send the vertex data for the local vertex id to all of
      * its mirrors.
@@ -905,13 +1779,25 @@ namespace graphlab {
      */
     void sync_vertex_data(lvid_type lvid, size_t thread_id);
 
+    /**
+     * \brief Send the change of the vertex data for the local vertex id
+     * to all of its mirrors as a delta, falling back to the full vertex
+     * data if the vertex program does not produce a delta.
+     *
+     * @param [in] lvid the vertex to sync.  This machine must be the master
+     * of that vertex.
+     * @param [in] old_data the vertex data before the apply.
+     */
+    void sync_vertex_delta(lvid_type lvid, const vertex_data_type& old_data,
+                           size_t thread_id);
+
     /**
      * \brief Receive all incoming vertex data and update the local
      * mirrors.
      *
      * This function returns when there are no more incoming vertex
-     * data and should be called after a flush of the vertex data
-     * exchange.
+     * data or deltas and should be called after a flush of the vertex
+     * data and vertex delta exchanges.
      */
     void recv_vertex_data();
 
@@ -934,6 +1820,32 @@ namespace graphlab {
      */
     void recv_gathers();
 
+    /**
+     * \brief Adds a gather contribution to a master participating in a
+     * pipelined gather and runs apply once all contributions arrived.
+     *
+     * @param [in] lvid the master vertex
+     * @param [in] accum the contribution. May be empty.
+     * @param [in] defer_apply if true, a completed vertex is added to
+     *             pipelined_ready instead of being applied
+     */
+    void add_pipelined_gather(context_type& context, lvid_type lvid,
+                              const conditional_addition_wrapper<gather_type>& accum,
+                              size_t thread_id, bool defer_apply);
+
+    /**
+     * \brief Receive the pipelined gather contributions, running apply
+     * on the vertices whose gather completes unless defer_apply is set.
+     */
+    void recv_pipelined_gathers(context_type& context, size_t thread_id,
+                                bool defer_apply);
+
+    /**
+     * \brief Runs apply on a master vertex, synchronizes the result
+     * with the mirrors and schedules the scatter if one is needed.
+     */
+    void apply_vertex(context_type& context, lvid_type lvid, size_t thread_id);
+
     /**
      * \brief Send the accumulated message for the local vertex to its
      * master.
@@ -1006,17 +1918,42 @@ namespace graphlab {
     ncpus(opts.get_ncpus()),
     threads(2*1024*1024 /* 2MB stack per fiber*/),
     thread_barrier(opts.get_ncpus()),
-    max_iterations(-1), snapshot_interval(-1), iteration_counter(0),
+    max_iterations(-1), handoff_threshold(0), snapshot_interval(-1),
+    checkpoint_interval(0), checkpointer(NULL), resume_checked(false),
+    iteration_counter(0),
     timeout(0), sched_allv(false),
+    frontier_mode("dense"), sparse_threshold(0.05), prefetch_distance(8),
+    gather_tile_vertices(0),
+    edge_centric_gather(false), edge_centric_superstep(false),
+    rebalance_threshold(0), rebalance_interval(10),
+    last_rebalance_compute_time(0),
+    straggler_threshold(0), phase_sequence(0), straggler_seen(false),
+    auto_thread_split(false),
+    max_handler_workers(fiber_control::get_instance().num_workers() / 2),
+    has_subgraph(false),
+    track_frontier(false), sparse_superstep(false),
+    sparse_phase(false), sparse_phase_end(0),
+    pipeline_gather_apply(false), pipelined_phase(false),
+    delta_sync_interval(0), delta_superstep(false),
+    sync_tolerance(0), sync_staleness(10),
     vprog_exchange(dc),
     vdata_exchange(dc),
+    vdelta_exchange(dc),
     gather_exchange(dc),
+    partial_gather_exchange(dc),
     message_exchange(dc),
-    aggregator(dc, graph, new context_type(*this, graph)) {
+    aggregator(dc, graph, new context_type(*this, graph)),
+    fuse_vertex_aggregators(false), fuse_edge_aggregators(false) {
     // Process any additional options
     std::vector<std::string> keys = opts.get_engine_args().get_option_keys();
     per_thread_compute_time.resize(opts.get_ncpus());
+    phase_thread_time.resize(opts.get_ncpus());
+    completed_applys.resize(opts.get_ncpus());
+    num_active_vertices.resize(opts.get_ncpus());
     use_cache = false;
+    cache_budget_mb = 0;
+    cache_min_degree = 0;
+    use_arena = false;
     foreach(std::string opt, keys) {
       if (opt == "max_iterations") {
         opts.get_engine_args().get_option("max_iterations", max_iterations);
@@ -1033,6 +1970,21 @@ namespace graphlab {
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: use_cache = "
             << use_cache << std::endl;
+      } else if (opt == "cache_budget") {
+        opts.get_engine_args().get_option("cache_budget", cache_budget_mb);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: cache_budget = "
+            << cache_budget_mb << std::endl;
+      } else if (opt == "cache_min_degree") {
+        opts.get_engine_args().get_option("cache_min_degree", cache_min_degree);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: cache_min_degree = "
+            << cache_min_degree << std::endl;
+      } else if (opt == "use_arena") {
+        opts.get_engine_args().get_option("use_arena", use_arena);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: use_arena = "
+            << use_arena << std::endl;
       } else if (opt == "snapshot_interval") {
         opts.get_engine_args().get_option("snapshot_interval", snapshot_interval);
         if (rmi.procid() == 0)
@@ -1043,25 +1995,170 @@ namespace graphlab {
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: snapshot_path = "
             << snapshot_path << std::endl;
+      } else if (opt == "checkpoint_interval") {
+        opts.get_engine_args().get_option("checkpoint_interval",
+                                          checkpoint_interval);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: checkpoint_interval = "
+            << checkpoint_interval << std::endl;
+      } else if (opt == "checkpoint_path") {
+        opts.get_engine_args().get_option("checkpoint_path", checkpoint_path);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: checkpoint_path = "
+            << checkpoint_path << std::endl;
       } else if (opt == "sched_allv") {
         opts.get_engine_args().get_option("sched_allv", sched_allv);
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: sched_allv = "
             << sched_allv << std::endl;
+      } else if (opt == "frontier_mode") {
+        opts.get_engine_args().get_option("frontier_mode", frontier_mode);
+        if (frontier_mode != "dense" && frontier_mode != "sparse" &&
+            frontier_mode != "auto") {
+          logstream(LOG_FATAL) << "frontier_mode must be one of "
+                               << "dense, sparse or auto" << std::endl;
+        }
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: frontier_mode = "
+            << frontier_mode << std::endl;
+      } else if (opt == "sparse_threshold") {
+        opts.get_engine_args().get_option("sparse_threshold", sparse_threshold);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: sparse_threshold = "
+            << sparse_threshold << std::endl;
+      } else if (opt == "prefetch_distance") {
+        opts.get_engine_args().get_option("prefetch_distance",
+                                          prefetch_distance);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: prefetch_distance = "
+            << prefetch_distance << std::endl;
+      } else if (opt == "gather_tile_vertices") {
+        opts.get_engine_args().get_option("gather_tile_vertices",
+                                          gather_tile_vertices);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: gather_tile_vertices = "
+            << gather_tile_vertices << std::endl;
+      } else if (opt == "edge_centric_gather") {
+        opts.get_engine_args().get_option("edge_centric_gather",
+                                          edge_centric_gather);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: edge_centric_gather = "
+            << edge_centric_gather << std::endl;
+      } else if (opt == "rebalance_threshold") {
+        opts.get_engine_args().get_option("rebalance_threshold",
+                                          rebalance_threshold);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: rebalance_threshold = "
+            << rebalance_threshold << std::endl;
+      } else if (opt == "rebalance_interval") {
+        opts.get_engine_args().get_option("rebalance_interval",
+                                          rebalance_interval);
+        if (rebalance_interval == 0) rebalance_interval = 1;
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: rebalance_interval = "
+            << rebalance_interval << std::endl;
+      } else if (opt == "auto_thread_split") {
+        opts.get_engine_args().get_option("auto_thread_split",
+                                          auto_thread_split);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: auto_thread_split = "
+            << auto_thread_split << std::endl;
+      } else if (opt == "max_handler_workers") {
+        opts.get_engine_args().get_option("max_handler_workers",
+                                          max_handler_workers);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: max_handler_workers = "
+            << max_handler_workers << std::endl;
+      } else if (opt == "straggler_threshold") {
+        opts.get_engine_args().get_option("straggler_threshold",
+                                          straggler_threshold);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: straggler_threshold = "
+            << straggler_threshold << std::endl;
+      } else if (opt == "pipeline_gather_apply") {
+        opts.get_engine_args().get_option("pipeline_gather_apply",
+                                          pipeline_gather_apply);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: pipeline_gather_apply = "
+            << pipeline_gather_apply << std::endl;
+      } else if (opt == "sync_tolerance") {
+        opts.get_engine_args().get_option("sync_tolerance", sync_tolerance);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: sync_tolerance = "
+            << sync_tolerance << std::endl;
+      } else if (opt == "sync_staleness") {
+        opts.get_engine_args().get_option("sync_staleness", sync_staleness);
+        if (sync_staleness == 0) sync_staleness = 1;
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: sync_staleness = "
+            << sync_staleness << std::endl;
+      } else if (opt == "delta_sync_interval") {
+        opts.get_engine_args().get_option("delta_sync_interval",
+                                          delta_sync_interval);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: delta_sync_interval = "
+            << delta_sync_interval << std::endl;
+      } else if (opt == "superstep_log") {
+        opts.get_engine_args().get_option("superstep_log", superstep_log_file);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: superstep_log = "
+            << superstep_log_file << std::endl;
       } else {
         logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
       }
     }
 
+    track_frontier = (frontier_mode != "dense");
+    if (pipeline_gather_apply && sched_allv) {
+      // with sched_allv every vertex gathers without being initialized
+      // so the number of pending gather contributions is unknown
+      if (rmi.procid() == 0)
+        logstream(LOG_WARNING) << "pipeline_gather_apply is ignored when "
+                               << "sched_allv is set" << std::endl;
+      pipeline_gather_apply = false;
+    }
+
+    if (use_arena && use_cache) {
+      // the cached gathers outlive the arenas
+      logstream(LOG_FATAL)
+        << "use_arena cannot be combined with use_cache" << std::endl;
+    }
     if (snapshot_interval >= 0 && snapshot_path.length() == 0) {
       logstream(LOG_FATAL)
         << "Snapshot interval specified, but no snapshot path" << std::endl;
     }
+    if (checkpoint_interval > 0 && checkpoint_path.length() == 0) {
+      logstream(LOG_FATAL)
+        << "Checkpoint interval specified, but no checkpoint path" << std::endl;
+    }
+    if (checkpoint_path.length() > 0) {
+      checkpointer = new async_checkpoint<graph_type, message_type>(
+          dc, graph, checkpoint_path);
+    }
     INITIALIZE_EVENT_LOG(dc);
     ADD_CUMULATIVE_EVENT(EVENT_APPLIES, "Applies", "Calls");
     ADD_CUMULATIVE_EVENT(EVENT_GATHERS , "Gathers", "Calls");
     ADD_CUMULATIVE_EVENT(EVENT_SCATTERS , "Scatters", "Calls");
     ADD_INSTANTANEOUS_EVENT(EVENT_ACTIVE_CPUS, "Active Threads", "Threads");
+    INITIALIZE_TRACER(syncengine_vertex_gather,
+                      "synchronous_engine: time to gather a vertex");
+    INITIALIZE_TRACER(syncengine_vertex_apply,
+                      "synchronous_engine: time to apply a vertex");
+    DISTRIBUTE_TRACER(syncengine_vertex_gather);
+    DISTRIBUTE_TRACER(syncengine_vertex_apply);
+    memory_source_ids.push_back(memory_accounting::add_source(
+        memory_accounting::ENGINE_STATE,
+        boost::bind(&synchronous_engine::engine_state_bytes, this)));
+    memory_source_ids.push_back(memory_accounting::add_source(
+        memory_accounting::MESSAGES,
+        boost::bind(&synchronous_engine::message_bytes, this)));
+    memory_source_ids.push_back(memory_accounting::add_source(
+        memory_accounting::GATHER_CACHE,
+        boost::bind(&synchronous_engine::gather_bytes, this)));
+    memory_source_ids.push_back(memory_accounting::add_source(
+        memory_accounting::RPC_BUFFERS,
+        boost::bind(&synchronous_engine::exchange_bytes, this)));
+    memory_accounting::add_to_event_log();
     graph.finalize();
     init();
   } // end of synchronous engine
@@ -1077,37 +2174,101 @@ namespace graphlab {
     has_message.clear();
     has_gather_accum.clear();
     has_cache.clear();
+    cache_budget.configure(cache_budget_mb * 1024 * 1024, cache_min_degree);
     active_superstep.clear();
     active_minorstep.clear();
+    pipelined_minorstep.clear();
+    sparse_superstep = false;
+    pipelined_phase = false;
+    delta_superstep = false;
   }
 
 
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>:: resize() {
-    memory_info::log_usage("Before Engine Initialization");
+    memory_accounting::log_usage("Before Engine Initialization");
     // Allocate vertex locks and vertex programs
     vlocks.resize(graph.num_local_vertices());
     vertex_programs.resize(graph.num_local_vertices());
     // allocate the edge locks
     //elocks.resize(graph.num_local_edges());
     // Allocate messages and message bitset
-    messages.resize(graph.num_local_vertices(), message_type());
+    messages.resize(graph.num_local_vertices());
     has_message.resize(graph.num_local_vertices());
     // Allocate gather accumulators and accumulator bitset
-    gather_accum.resize(graph.num_local_vertices(), gather_type());
+    gather_accum.resize(graph.num_local_vertices());
     has_gather_accum.resize(graph.num_local_vertices());
 
     // If caching is used then allocate cache data-structures
     if (use_cache) {
-      gather_cache.resize(graph.num_local_vertices(), gather_type());
+      gather_cache.resize(graph.num_local_vertices());
       has_cache.resize(graph.num_local_vertices());
     }
+    if (gather_tile_vertices > 0 || edge_centric_gather) {
+      local_accum.resize(graph.num_local_vertices());
+      has_local_accum.resize(graph.num_local_vertices());
+      has_local_accum.clear();
+      local_accum_is_set.resize(graph.num_local_vertices());
+    }
+    if (edge_centric_gather) {
+      streamed_dirs.resize(graph.num_local_vertices());
+      streamed_updates.resize(ncpus);
+      for (size_t i = 0; i < ncpus; ++i) streamed_updates[i].resize(ncpus);
+    }
     // Allocate bitset to track active vertices on each bitset.
     active_superstep.resize(graph.num_local_vertices());
     active_minorstep.resize(graph.num_local_vertices());
+    // Track the set bits in sparse mode. Every vertex can be listed.
+    const size_t sparse_capacity =
+        track_frontier ? graph.num_local_vertices() : 0;
+    has_message.set_sparse_capacity(sparse_capacity);
+    active_superstep.set_sparse_capacity(sparse_capacity);
+    active_minorstep.set_sparse_capacity(sparse_capacity);
+    if (sync_tolerance > 0) {
+      unsynced_distance.assign(graph.num_local_vertices(), 0);
+      unsynced_masters.resize(graph.num_local_vertices());
+      unsynced_masters.clear();
+    }
+    // Allocate the pending gather counters if gathers are pipelined
+    if (pipeline_gather_apply) {
+      pending_gathers.resize(graph.num_local_vertices(), 0);
+      pipelined_ready.resize(ncpus);
+      pipelined_minorstep.resize(graph.num_local_vertices());
+      pipelined_minorstep.set_sparse_capacity(sparse_capacity);
+    }
 
     // Print memory usage after initialization
-    memory_info::log_usage("After Engine Initialization");
+    memory_accounting::log_usage("After Engine Initialization");
+  }
+
+
+  template<typename VertexProgram>
+  size_t synchronous_engine<VertexProgram>::engine_state_bytes() const {
+    return vertex_programs.allocated_bytes() +
+        vlocks.capacity() * sizeof(simple_spinlock);
+  }
+
+
+  template<typename VertexProgram>
+  size_t synchronous_engine<VertexProgram>::message_bytes() const {
+    return messages.allocated_bytes();
+  }
+
+
+  template<typename VertexProgram>
+  size_t synchronous_engine<VertexProgram>::gather_bytes() const {
+    return gather_accum.allocated_bytes() + gather_cache.allocated_bytes();
+  }
+
+
+  template<typename VertexProgram>
+  size_t synchronous_engine<VertexProgram>::exchange_bytes() {
+    return vprog_exchange.buffered_bytes() +
+        vdata_exchange.buffered_bytes() +
+        vdelta_exchange.buffered_bytes() +
+        gather_exchange.buffered_bytes() +
+        partial_gather_exchange.buffered_bytes() +
+        message_exchange.buffered_bytes();
   }
 
 
@@ -1118,6 +2279,35 @@ namespace graphlab {
   } // end of get_aggregator
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  set_handoff_threshold(size_t nvertices) {
+    handoff_threshold = nvertices;
+  } // end of set_handoff_threshold
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  attach_column(ivertex_column& column) {
+    attached_columns.push_back(&column);
+  } // end of attach_column
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  take_frontier(std::vector<std::pair<lvid_type, message_type> >& frontier) {
+    frontier.clear();
+    // after the message exchange only masters have messages
+    for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      if (has_message.get(lvid)) {
+        frontier.push_back(std::make_pair(lvid, messages[lvid]));
+      }
+    }
+    has_message.clear();
+    messages.release();
+  } // end of take_frontier
+
+
 
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::internal_stop() {
@@ -1162,12 +2352,35 @@ namespace graphlab {
              const message_type& message, const std::string& order) {
     if (vlocks.size() != graph.num_local_vertices())
       resize();
-    for(lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
-      if(graph.l_is_master(lvid) && vset.l_contains(lvid)) {
-        internal_signal(vertex_type(graph.l_vertex(lvid)), message);
+    vset.for_each_lvid(graph, signal_visitor(this, &message));
+  } // end of signal all
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  set_subgraph(const vertex_set& vset) {
+    if (vlocks.size() != graph.num_local_vertices())
+      resize();
+    const hybrid_bitset<lvid_type>& bits = vset.get_lvid_bitset(graph);
+    subgraph.resize(graph.num_local_vertices());
+    subgraph.clear();
+    for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      if (bits.get(lvid)) {
+        subgraph.set_bit_unsync(lvid);
+      } else if (has_message.get(lvid)) {
+        has_message.clear_bit(lvid);
+        messages.reset(lvid);
       }
     }
-  } // end of signal all
+    has_subgraph = true;
+  } // end of set_subgraph
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::clear_subgraph() {
+    has_subgraph = false;
+    subgraph.resize(0);
+  } // end of clear_subgraph
 
 
   template<typename VertexProgram>
@@ -1175,6 +2388,7 @@ namespace graphlab {
   internal_signal(const vertex_type& vertex,
                   const message_type& message) {
     const lvid_type lvid = vertex.local_id();
+    if (!in_subgraph(lvid)) return;
     vlocks[lvid].lock();
     if( has_message.get(lvid) ) {
       messages[lvid] += message;
@@ -1202,6 +2416,9 @@ namespace graphlab {
                       const message_type& message) {
     if (graph.is_master(gvid)) {
       internal_signal(graph.vertex(gvid), message);
+    } else if (graph.master(gvid) != rmi.procid()) {
+      // a mirror of a vertex whose master was moved forwards the signal
+      internal_signal_gvid(gvid, message);
     }
   } // end of internal_signal_rpc
 
@@ -1236,18 +2453,289 @@ namespace graphlab {
     const lvid_type lvid = vertex.local_id();
     if(caching_enabled && has_cache.get(lvid)) {
       vlocks[lvid].lock();
-      gather_cache[lvid] = gather_type();
-      has_cache.clear_bit(lvid);
+      if (has_cache.get(lvid)) {
+        gather_cache.reset(lvid);
+        has_cache.clear_bit(lvid);
+        cache_budget.release(cache_benefit(lvid));
+      }
       vlocks[lvid].unlock();
     }
   } // end of clear_gather_cache
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  store_gather_cache(lvid_type lvid, const gather_type& accum) {
+    if (cache_budget.needs_entry_bytes()) {
+      // Measure the heap memory of the accumulator, such as a matrix,
+      // through its serialized size
+      oarchive oarc;
+      oarc << accum;
+      cache_budget.set_entry_bytes(std::max(oarc.off, sizeof(gather_type)));
+      free(oarc.buf);
+    }
+    if (cache_budget.admit(cache_benefit(lvid))) {
+      gather_cache[lvid] = accum; has_cache.set_bit(lvid);
+    }
+  } // end of store_gather_cache
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::evict_gather_cache() {
+    if (gather_cache.empty() || !cache_budget.rebalance()) return;
+    const size_t WORD_SIZE = 8 * sizeof(size_t);
+    for (size_t start = 0; start < has_cache.size(); start += WORD_SIZE) {
+      size_t word = has_cache.containing_word(start);
+      while (word) {
+        const size_t lvid = start + dense_bitset::pop_first_bit(word);
+        const size_t benefit = cache_benefit(lvid);
+        if (cache_budget.should_evict(benefit)) {
+          gather_cache.reset(lvid);
+          has_cache.clear_bit(lvid);
+          cache_budget.evict(benefit);
+        }
+      }
+    }
+  } // end of evict_gather_cache
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::log_gather_cache_stats() {
+    if (gather_cache.empty()) return;
+    gather_cache_budget::stats_type stats = cache_budget.stats();
+    rmi.all_reduce(stats);
+    if (rmi.procid() == 0) {
+      logstream(LOG_INFO) << "Gather cache: " << stats.hits << " hits, "
+                          << stats.misses << " misses (hit rate "
+                          << 100 * stats.hit_rate() << "%), "
+                          << stats.evictions << " evictions, "
+                          << stats.entries << " entries" << std::endl;
+    }
+  } // end of log_gather_cache_stats
+
+
+  template<typename VertexProgram>
+  double synchronous_engine<VertexProgram>::local_compute_time() const {
+    double total_compute_time = 0;
+    for (size_t i = 0;i < per_thread_compute_time.size(); ++i) {
+      total_compute_time += per_thread_compute_time[i];
+    }
+    return total_compute_time;
+  } // end of local_compute_time
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::rebalance_masters() {
+    const double compute_time = local_compute_time();
+    std::vector<double> times(rmi.numprocs());
+    times[rmi.procid()] = compute_time - last_rebalance_compute_time;
+    last_rebalance_compute_time = compute_time;
+    rmi.all_gather(times);
+    double mean_time = 0, max_time = 0;
+    for (size_t i = 0; i < times.size(); ++i) {
+      mean_time += times[i];
+      max_time = std::max(max_time, times[i]);
+    }
+    mean_time /= times.size();
+    if (mean_time <= 0 || max_time < rebalance_threshold * mean_time) return;
+
+    std::vector<std::pair<lvid_type, procid_t> > moves;
+    const double my_time = times[rmi.procid()];
+    if (my_time > mean_time) {
+      double total_excess = 0;
+      for (size_t i = 0; i < times.size(); ++i) {
+        total_excess += std::max(times[i] - mean_time, 0.0);
+      }
+      // the work of a master: its apply and the messages of its mirrors
+      double master_work = 0;
+      for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+        if (graph.l_is_master(lvid)) {
+          master_work += 1 + graph.l_vertex(lvid).num_mirrors();
+        }
+      }
+      // all the compute time is taken as master work, and the machines
+      // above the mean share the room below it by their excess
+      const double work_per_second = master_work / my_time;
+      double to_move = (my_time - mean_time) * work_per_second;
+      std::vector<double> room(rmi.numprocs(), 0);
+      for (size_t i = 0; i < times.size(); ++i) {
+        if (times[i] < mean_time) {
+          room[i] = (mean_time - times[i]) * work_per_second *
+              (my_time - mean_time) / total_excess;
+        }
+      }
+      for (lvid_type lvid = 0; 
+           lvid < graph.num_local_vertices() && to_move > 0; ++lvid) {
+        if (!graph.l_is_master(lvid)) continue;
+        const local_vertex_type vertex = graph.l_vertex(lvid);
+        const double work = 1 + vertex.num_mirrors();
+        if (work > to_move) continue;
+        procid_t best = rmi.procid();
+        foreach(procid_t proc, vertex.mirrors()) {
+          if (room[proc] >= work && 
+              (best == rmi.procid() || room[proc] > room[best])) {
+            best = proc;
+          }
+        }
+        if (best == rmi.procid()) continue;
+        moves.push_back(std::make_pair(lvid, best));
+        room[best] -= work;
+        to_move -= work;
+      }
+    }
+    size_t nmoved = moves.size();
+    graph.move_masters(moves);
+    rmi.all_reduce(nmoved);
+    if (rmi.procid() == 0) {
+      logstream(LOG_EMPH) << "Moved " << nmoved << " masters: the slowest "
+                          << "machine took " << max_time / mean_time
+                          << " times the mean compute time" << std::endl;
+    }
+  } // end of rebalance_masters
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  report_phase_done(const char* phase, double phase_time) {
+    if (rmi.procid() != 0) {
+      rmi.control_call(0, &synchronous_engine::rpc_phase_done,
+                       phase_sequence, rmi.procid(), phase_time);
+      return;
+    }
+    timer phase_timer;
+    straggler_lock.lock();
+    std::vector<std::pair<procid_t, double> >& reports =
+        phase_reports[phase_sequence];
+    reports.push_back(std::make_pair(rmi.procid(), phase_time));
+    bool logged = false;
+    while (reports.size() < rmi.numprocs()) {
+      if (logged || 2 * reports.size() < rmi.numprocs()) {
+        straggler_cond.wait(straggler_lock);
+        continue;
+      }
+      std::vector<double> times(reports.size());
+      for (size_t i = 0; i < reports.size(); ++i) times[i] = reports[i].second;
+      std::nth_element(times.begin(), times.begin() + times.size() / 2,
+                       times.end());
+      const double median = times[times.size() / 2];
+      const double limit = std::max(straggler_threshold * median, 0.1);
+      const double elapsed = phase_time + phase_timer.current_time();
+      if (elapsed < limit) {
+        straggler_cond.timedwait_ms(straggler_lock,
+                                    size_t((limit - elapsed) * 1000) + 1);
+        continue;
+      }
+      std::vector<bool> done(rmi.numprocs(), false);
+      for (size_t i = 0; i < reports.size(); ++i) done[reports[i].first] = true;
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        if (done[p]) continue;
+        logstream(LOG_WARNING) << "Straggler: machine " << p << " is still in "
+                               << phase << " of iteration " << iteration_counter
+                               << " after " << elapsed << "s, the median is "
+                               << median << "s" << std::endl;
+        rmi.control_call(p, &synchronous_engine::rpc_request_progress,
+                         phase_sequence);
+      }
+      logged = true;
+      straggler_seen = true;
+    }
+    if (!logged) {
+      // the last machines may have finished between two checks
+      std::vector<double> times(reports.size());
+      for (size_t i = 0; i < reports.size(); ++i) times[i] = reports[i].second;
+      std::sort(times.begin(), times.end());
+      const double median = times[times.size() / 2];
+      for (size_t i = 0; i < reports.size(); ++i) {
+        if (reports[i].second < std::max(straggler_threshold * median, 0.1)) {
+          continue;
+        }
+        logstream(LOG_WARNING) << "Straggler: machine " << reports[i].first
+                               << " finished " << phase << " of iteration "
+                               << iteration_counter << " in "
+                               << reports[i].second << "s, the median is "
+                               << median << "s" << std::endl;
+        straggler_seen = true;
+      }
+    }
+    phase_reports.erase(phase_sequence);
+    straggler_lock.unlock();
+  } // end of report_phase_done
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  rpc_phase_done(size_t sequence, procid_t proc, double phase_time) {
+    straggler_lock.lock();
+    phase_reports[sequence].push_back(std::make_pair(proc, phase_time));
+    straggler_cond.signal();
+    straggler_lock.unlock();
+  } // end of rpc_phase_done
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  rpc_request_progress(size_t sequence) {
+    // the phase may have finished since the request was sent
+    const bool running = sequence == phase_sequence;
+    rmi.control_call(0, &synchronous_engine::rpc_log_progress, sequence,
+                     rmi.procid(), running ? finished_threads.value : ncpus,
+                     running ? lvid_dispenser.progress() : 1.0);
+  } // end of rpc_request_progress
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  rpc_log_progress(size_t sequence, procid_t proc,
+                   size_t nfinished, double handed_out) {
+    logstream(LOG_WARNING) << "Straggler: machine " << proc << " has "
+                           << nfinished << " of " << ncpus
+                           << " threads done and has handed out "
+                           << 100 * handed_out << "% of its vertices"
+                           << std::endl;
+  } // end of rpc_log_progress
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::log_thread_split() {
+    std::vector<std::pair<size_t, double> > splits(rmi.numprocs());
+    splits[rmi.procid()] = std::make_pair(split_tuner.num_reserved(),
+                                          split_tuner.handler_cores());
+    rmi.all_gather(splits);
+    std::vector<std::vector<size_t> > traffic(rmi.numprocs());
+    traffic[rmi.procid()] = split_tuner.sent();
+    rmi.gather(traffic, 0);
+    if (rmi.procid() != 0) return;
+    for (procid_t p = 0; p < splits.size(); ++p) {
+      logstream(LOG_EMPH) << "Thread Split: machine " << p << " reserved "
+                          << splits[p].first << " of "
+                          << split_tuner.num_workers() << " workers for the "
+                          << "RPC handlers, which kept " << splits[p].second
+                          << " cores busy" << std::endl;
+    }
+    std::vector<std::pair<size_t, std::pair<procid_t, procid_t> > > entries;
+    for (procid_t src = 0; src < traffic.size(); ++src) {
+      for (procid_t dst = 0; dst < traffic[src].size(); ++dst) {
+        if (traffic[src][dst] > 0) {
+          entries.push_back(std::make_pair(traffic[src][dst],
+                                           std::make_pair(src, dst)));
+        }
+      }
+    }
+    std::sort(entries.rbegin(), entries.rend());
+    for (size_t i = 0; i < std::min<size_t>(entries.size(), 8); ++i) {
+      logstream(LOG_EMPH) << "Traffic: machine " << entries[i].second.first
+                          << " sent " << entries[i].first / (1024.0 * 1024.0)
+                          << " MB to machine " << entries[i].second.second
+                          << std::endl;
+    }
+  } // end of log_thread_split
+
+
 
 
   template<typename VertexProgram>
   size_t synchronous_engine<VertexProgram>::
-  num_updates() const { return completed_applys.value; }
+  num_updates() const { return completed_applys.value(); }
 
   template<typename VertexProgram>
   float synchronous_engine<VertexProgram>::
@@ -1287,14 +2775,33 @@ namespace graphlab {
     //   // Initialize all vertex programs
     //   run_synchronous( &synchronous_engine::initialize_vertex_programs );
     // }
-    aggregator.start();
+    superstep_stats.clear();
+    cache_budget.reset_counters();
+    last_rebalance_compute_time = local_compute_time();
+    if (auto_thread_split) {
+      split_tuner.init(rmi.dc(), fiber_control::get_instance().num_workers(),
+                       max_handler_workers);
+    }
+    aggregator.start(0, ncpus);
+    fuse_vertex_aggregators = aggregator.has_fused_vertex_aggregators();
+    fuse_edge_aggregators = aggregator.has_fused_edge_aggregators();
     rmi.barrier();
 
     if (snapshot_interval == 0) {
       graph.save_binary(snapshot_path);
     }
 
+    if (checkpointer != NULL && !resume_checked) {
+      resume_checked = true;
+      if (checkpointer->restore(iteration_counter, messages, has_message) &&
+          rmi.procid() == 0) {
+        logstream(LOG_EMPH) << "Resuming from the checkpoint of iteration "
+                            << iteration_counter << std::endl;
+      }
+    }
+
     float last_print = -5;
+    bool frontier_was_dense = false;
     if (rmi.procid() == 0) {
       logstream(LOG_EMPH) << "Iteration counter will only output every 5 seconds."
                         << std::endl;
@@ -1309,6 +2816,10 @@ namespace graphlab {
       }
 
       bool print_this_round = (elapsed_seconds() - last_print) >= 5;
+      superstep_stats.begin_superstep(iteration_counter);
+      // The messages of the last super-step are still alive, and are
+      // only reclaimed at the next epoch
+      if (use_arena) reset_thread_arenas();
 
       if(rmi.procid() == 0 && print_this_round) {
         logstream(LOG_EMPH)
@@ -1318,20 +2829,63 @@ namespace graphlab {
       }
       // Reset Active vertices ----------------------------------------------
       // Clear the active super-step and minor-step bits which will
-      // be set upon receiving messages
+      // be set upon receiving messages.  The gather accumulators are
+      // only set on super-step active vertices.
+      if (active_superstep.is_sparse() &&
+          active_superstep.sparse_size() < graph.num_local_vertices() / 64) {
+        const size_t nentries = active_superstep.sparse_size();
+        for (size_t i = 0; i < nentries; ++i) {
+          has_gather_accum.clear_bit(active_superstep.sparse_entry(i));
+        }
+      } else {
+        has_gather_accum.clear();
+      }
       active_superstep.clear(); active_minorstep.clear();
-      has_gather_accum.clear();
+
+      // Mirrors are brought back in sync with the full vertex data
+      // every delta_sync_interval iterations.
+      delta_superstep = delta_sync_interval > 0 &&
+          iteration_counter % delta_sync_interval != 0;
+
+      // Choose between sparse and dense traversal for this super-step
+      // using the number of vertices that were signaled.
+      if (track_frontier) {
+        size_t total_signaled = has_message.is_sparse() ?
+            has_message.sparse_size() : graph.num_local_vertices();
+        rmi.all_reduce(total_signaled);
+        sparse_superstep = use_sparse_frontier(total_signaled);
+      }
       rmi.barrier();
 
       // Exchange Messages --------------------------------------------------
       // Exchange any messages in the local message vectors
       // if (rmi.procid() == 0) std::cout << "Exchange messages..." << std::endl;
-      run_synchronous( &synchronous_engine::exchange_messages );
+      begin_phase(has_message);
+      run_synchronous( &synchronous_engine::exchange_messages, "exchange_messages",
+                       superstep_record::EXCHANGE );
       /**
        * Post conditions:
        *   1) only master vertices have messages
        */
 
+      // Stop and leave the messages to take_frontier() once the frontier
+      // has become sparse
+      if (handoff_threshold > 0) {
+        size_t total_signaled = has_message.popcount();
+        rmi.all_reduce(total_signaled);
+        if (total_signaled >= handoff_threshold) {
+          frontier_was_dense = true;
+        } else if (frontier_was_dense && total_signaled > 0) {
+          if (rmi.procid() == 0) {
+            logstream(LOG_EMPH) << "Handing off a frontier of " << total_signaled
+                                << " vertices after " << iteration_counter 
+                                << " iterations" << std::endl;
+          }
+          termination_reason = execution_status::FRONTIER_HANDOFF;
+          break;
+        }
+      }
+
       // Receive Messages ---------------------------------------------------
       // Receive messages to master vertices and then synchronize
       // vertex programs with mirrors if gather is required
@@ -1339,11 +2893,18 @@ namespace graphlab {
 
       // if (rmi.procid() == 0) std::cout << "Receive messages..." << std::endl;
       num_active_vertices = 0;
-      run_synchronous( &synchronous_engine::receive_messages );
+      begin_phase(has_message);
+      run_synchronous( &synchronous_engine::receive_messages, "receive_messages",
+                       superstep_record::RECEIVE );
       if (sched_allv) {
         active_minorstep.fill();
       }
+      // count the active vertices while the message bits are cleared
+      request_future<size_t> active_vertices_future =
+        rmi.async_all_reduce(size_t(num_active_vertices.value()));
       has_message.clear();
+      // every message has been consumed
+      messages.release();
       /**
        * Post conditions:
        *   1) there are no messages remaining
@@ -1357,11 +2918,15 @@ namespace graphlab {
        */
 
       // Check termination condition  ---------------------------------------
-      size_t total_active_vertices = num_active_vertices;
-      rmi.all_reduce(total_active_vertices);
+      size_t total_active_vertices = active_vertices_future();
+      superstep_stats.current().active_vertices = total_active_vertices;
+      if (track_frontier) {
+        sparse_superstep = use_sparse_frontier(total_active_vertices);
+      }
       if (rmi.procid() == 0 && print_this_round)
         logstream(LOG_EMPH)
-          << "\tActive vertices: " << total_active_vertices << std::endl;
+          << "\tActive vertices: " << total_active_vertices
+          << (sparse_superstep ? " (sparse)" : "") << std::endl;
       if(total_active_vertices == 0 ) {
         termination_reason = execution_status::TASK_DEPLETION;
         break;
@@ -1372,23 +2937,42 @@ namespace graphlab {
       // Execute the gather operation for all vertices that are active
       // in this minor-step (active-minorstep bit set).
       // if (rmi.procid() == 0) std::cout << "Gathering..." << std::endl;
-      run_synchronous( &synchronous_engine::execute_gathers );
+      begin_phase(active_minorstep);
+      pipelined_phase = pipeline_gather_apply;
+      next_vertex_range.value = 0;
+      edge_centric_superstep = edge_centric_gather && !has_subgraph &&
+          total_active_vertices == graph.num_vertices();
+      run_synchronous( &synchronous_engine::execute_gathers, "execute_gathers",
+                       superstep_record::GATHER );
+      pipelined_phase = false;
+      // Make room in the gather cache for the vertices it rejected
+      evict_gather_cache();
       // Clear the minor step bit since only super-step vertices
       // (only master vertices are required to participate in the
       // apply step)
       active_minorstep.clear(); // rmi.barrier();
+      // Vertices applied during a pipelined gather already scheduled
+      // their scatters.
+      if (pipeline_gather_apply) active_minorstep.swap(pipelined_minorstep);
       /**
        * Post conditions:
        *   1) gather_accum for all master vertices contains the
        *      result of all the gathers (even if they are drawn from
        *      cache)
-       *   2) No minor-step bits are set
+       *   2) No minor-step bits are set, unless the gather was
+       *      pipelined in which case the vertices which were applied
+       *      and are to scatter have their minor-step bit set and
+       *      their super-step bit cleared.
        */
 
       // Execute Apply Operations -------------------------------------------
       // Run the apply function on all active vertices
       // if (rmi.procid() == 0) std::cout << "Applying..." << std::endl;
-      run_synchronous( &synchronous_engine::execute_applys );
+      begin_phase(active_superstep);
+      run_synchronous( &synchronous_engine::execute_applys, "execute_applys",
+                       superstep_record::APPLY );
+      // every gather accumulator has been cleared
+      gather_accum.release();
       /**
        * Post conditions:
        *   1) any changes to the vertex data have been synchronized
@@ -1403,7 +2987,11 @@ namespace graphlab {
 
       // Execute Scatter Operations -----------------------------------------
       // Execute each of the scatters on all minor-step active vertices.
-      run_synchronous( &synchronous_engine::execute_scatters );
+      begin_phase(active_minorstep);
+      run_synchronous( &synchronous_engine::execute_scatters, "execute_scatters",
+                       superstep_record::SCATTER );
+      // every vertex program has been cleared after its scatter
+      vertex_programs.release();
       /**
        * Post conditions:
        *   1) NONE
@@ -1411,32 +2999,78 @@ namespace graphlab {
       if(rmi.procid() == 0 && print_this_round)
         logstream(LOG_EMPH) << "\t Running Aggregators" << std::endl;
       // probe the aggregator
-      aggregator.tick_synchronous();
+      {
+        graphlab::timer aggregate_timer;
+        const size_t bytes_before = rmi.dc().bytes_sent();
+        aggregator.tick_synchronous();
+        superstep_record& rec = superstep_stats.current();
+        rec.wall_time[superstep_record::AGGREGATE] =
+          aggregate_timer.current_time();
+        rec.bytes_sent[superstep_record::AGGREGATE] =
+          rmi.dc().bytes_sent() - bytes_before;
+      }
+      if (rmi.procid() == 0) superstep_stats.publish();
 
       ++iteration_counter;
 
+      if (sync_tolerance > 0 && iteration_counter % sync_staleness == 0) {
+        sync_skipped_changes();
+      }
+
+      bool check_balance = rebalance_threshold > 0 &&
+          iteration_counter % rebalance_interval == 0;
+      if (rebalance_threshold > 0 && straggler_threshold > 0 &&
+          rmi.numprocs() > 1) {
+        // only machine 0 knows about the stragglers
+        size_t straggled = straggler_seen;
+        rmi.broadcast(straggled, rmi.procid() == 0);
+        if (straggled) check_balance = true;
+      }
+      if (check_balance) {
+        straggler_seen = false;
+        rebalance_masters();
+      }
+
+      if (auto_thread_split && split_tuner.update(rmi.dc())) {
+        logstream(LOG_INFO) << "Thread Split: " << split_tuner.num_reserved()
+                            << " of " << split_tuner.num_workers()
+                            << " workers reserved for the RPC handlers, "
+                            << "which keep " << split_tuner.handler_cores()
+                            << " cores busy" << std::endl;
+      }
+
       if (snapshot_interval > 0 && iteration_counter % snapshot_interval == 0) {
         graph.save_binary(snapshot_path);
       }
+
+      if (checkpointer != NULL && checkpoint_interval > 0 &&
+          iteration_counter % checkpoint_interval == 0) {
+        checkpointer->save(iteration_counter, messages, has_message);
+        if (rmi.procid() == 0 && print_this_round)
+          logstream(LOG_EMPH) << "\t Checkpoint copied in "
+                              << checkpointer->copy_time() << "s" << std::endl;
+      }
     }
 
+    if (checkpointer != NULL) checkpointer->remove();
+    // leave the mirrors exact
+    if (sync_tolerance > 0) sync_skipped_changes();
+
     if (rmi.procid() == 0) {
       logstream(LOG_EMPH) << iteration_counter
                         << " iterations completed." << std::endl;
     }
     // Final barrier to ensure that all engines terminate at the same time
-    double total_compute_time = 0;
-    for (size_t i = 0;i < per_thread_compute_time.size(); ++i) {
-      total_compute_time += per_thread_compute_time[i];
-    }
     std::vector<double> all_compute_time_vec(rmi.numprocs());
-    all_compute_time_vec[rmi.procid()] = total_compute_time;
+    all_compute_time_vec[rmi.procid()] = local_compute_time();
     rmi.all_gather(all_compute_time_vec);
 
     size_t global_completed = completed_applys;
     rmi.all_reduce(global_completed);
     completed_applys = global_completed;
-    rmi.cout() << "Updates: " << completed_applys.value << "\n";
+    rmi.cout() << "Updates: " << completed_applys.value() << "\n";
+    log_gather_cache_stats();
+    if (auto_thread_split) log_thread_split();
     if (rmi.procid() == 0) {
       logstream(LOG_INFO) << "Compute Balance: ";
       for (size_t i = 0;i < all_compute_time_vec.size(); ++i) {
@@ -1444,6 +3078,15 @@ namespace graphlab {
       }
       logstream(LOG_INFO) << std::endl;
     }
+    superstep_stats.merge(rmi);
+    if (rmi.procid() == 0) {
+      superstep_stats.publish();
+      if (!superstep_log_file.empty() &&
+          !superstep_stats.save(superstep_log_file)) {
+        logstream(LOG_ERROR) << "Unable to write the superstep log to "
+                             << superstep_log_file << std::endl;
+      }
+    }
     rmi.full_barrier();
     // Stop the aggregator
     aggregator.stop();
@@ -1459,28 +3102,16 @@ namespace graphlab {
     context_type context(*this, graph);
     const size_t TRY_RECV_MOD = 100;
     size_t vcount = 0;
-    fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = has_message.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
-      // initialize a word sized bitfield
-      local_bitset.clear();
-      local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
-        if (lvid >= graph.num_local_vertices()) break;
+    std::vector<lvid_type> block;
+    while (next_active_block(has_message, block, thread_id)) {
+      foreach(lvid_type lvid, block) {
         // if the vertex is not local and has a message send the
         // message and clear the bit
         if(!graph.l_is_master(lvid)) {
           sync_message(lvid, thread_id);
           has_message.clear_bit(lvid);
           // clear the message to save memory
-          messages[lvid] = message_type();
+          messages.reset(lvid);
         }
         if(++vcount % TRY_RECV_MOD == 0) recv_messages();
       }
@@ -1502,24 +3133,9 @@ namespace graphlab {
     const size_t TRY_RECV_MOD = 100;
     size_t vcount = 0;
     size_t nactive_inc = 0;
-    fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
-
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = has_message.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
-      // initialize a word sized bitfield
-      local_bitset.clear();
-      local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
-
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
-        if (lvid >= graph.num_local_vertices()) break;
-
+    std::vector<lvid_type> block;
+    while (next_active_block(has_message, block, thread_id)) {
+      foreach(lvid_type lvid, block) {
         // if this is the master of lvid and we have a message
         if(graph.l_is_master(lvid)) {
           // The vertex becomes active for this superstep
@@ -1529,13 +3145,16 @@ namespace graphlab {
           vertex_type vertex = vertex_type(graph.l_vertex(lvid));
           vertex_programs[lvid].init(context, vertex, messages[lvid]);
           // clear the message to save memory
-          messages[lvid] = message_type();
+          messages.reset(lvid);
           if (sched_allv) continue;
           // Determine if the gather should be run
           const vertex_program_type& const_vprog = vertex_programs[lvid];
           const vertex_type const_vertex = vertex;
-          if(const_vprog.gather_edges(context, const_vertex) !=
+          if(resolve_gather_edges(const_vprog, context, const_vertex) !=
               graphlab::NO_EDGES) {
+            // expect one gather contribution from every copy
+            if (pipeline_gather_apply)
+              pending_gathers[lvid] = graph.l_vertex(lvid).num_mirrors() + 1;
             active_minorstep.set_bit(lvid);
             sync_vertex_program(lvid, thread_id);
           }
@@ -1544,7 +3163,7 @@ namespace graphlab {
       }
     }
 
-    num_active_vertices += nactive_inc;
+    num_active_vertices.inc(thread_id, nactive_inc);
     vprog_exchange.partial_flush();
     // Flush the buffer and finish receiving any remaining vertex
     // programs.
@@ -1568,85 +3187,132 @@ namespace graphlab {
     const bool caching_enabled = !gather_cache.empty();
     timer ti;
 
-    fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
-
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
-      // initialize a word sized bitfield
-      local_bitset.clear();
-      local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
-
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
-        if (lvid >= graph.num_local_vertices()) break;
+    const bool streamed = edge_centric_superstep;
+    const bool tiled = !streamed && gather_tile_vertices > 0 &&
+        !sparse_superstep && !has_subgraph;
+    if (streamed) {
+      execute_streamed_gathers(context, thread_id);
+      thread_barrier.wait();
+    } else if (tiled) {
+      execute_tiled_gathers(context);
+      thread_barrier.wait();
+    }
 
+    std::vector<lvid_type> block;
+    while (next_active_block(active_minorstep, block, thread_id)) {
+      for (size_t j = 0; j < block.size(); ++j) {
+        const lvid_type lvid = block[j];
+        prefetch_next_vertices(block, j);
+        BEGIN_TRACEPOINT(syncengine_vertex_gather);
         bool accum_is_set = false;
         gather_type accum = gather_type();
         // if caching is enabled and we have a cache entry then use
         // that as the accum
         if( caching_enabled && has_cache.get(lvid) ) {
-          accum = gather_cache[lvid];
+          accum = gather_cache.get(lvid);
           accum_is_set = true;
+          cache_budget.hits.inc();
         } else {
+          if (caching_enabled) cache_budget.misses.inc();
           // recompute the local contribution to the gather
           const vertex_program_type& vprog = vertex_programs[lvid];
           local_vertex_type local_vertex = graph.l_vertex(lvid);
           const vertex_type vertex(local_vertex);
-          const edge_dir_type gather_dir = vprog.gather_edges(context, vertex);
-          // Loop over in edges
+          edge_dir_type gather_dir = resolve_gather_edges(vprog, context, vertex);
           size_t edges_touched = 0;
-          vprog.pre_local_gather(accum);
-          if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
-            foreach(local_edge_type local_edge, local_vertex.in_edges()) {
-              edge_type edge(local_edge);
-              // elocks[local_edge.id()].lock();
-              if(accum_is_set) { // \todo hint likely
-                accum += vprog.gather(context, vertex, edge);
-              } else {
-                accum = vprog.gather(context, vertex, edge);
-                accum_is_set = true;
+          if ((tiled || streamed) && has_local_accum.get(lvid)) {
+            // the in edges were already gathered tile by tile, or all
+            // the edges by streaming
+            accum_is_set = local_accum_is_set.get(lvid);
+            if (accum_is_set) accum = local_accum[lvid];
+            local_accum[lvid] = gather_type();
+            has_local_accum.clear_bit(lvid);
+            gather_dir = (tiled && gather_dir == ALL_EDGES) ?
+                OUT_EDGES : NO_EDGES;
+          } else {
+            vprog.pre_local_gather(accum);
+          }
+          // Gather one edge at a time unless the vertex program
+          // gathers whole spans of edges
+          if(has_subgraph || !batch_gather(context, vprog, lvid, gather_dir,
+                                           accum, accum_is_set)) {
+            // Loop over in edges
+            if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
+              local_neighbor_prefetcher_type prefetcher =
+                  graph.l_neighbor_prefetcher(lvid, true, prefetch_distance);
+              foreach(local_edge_type local_edge, local_vertex.in_edges()) {
+                prefetcher.next();
+                if (!in_subgraph(local_edge.source().id())) continue;
+                edge_type edge(local_edge);
+                // elocks[local_edge.id()].lock();
+                if(accum_is_set) { // \todo hint likely
+                  accum += vprog.gather(context, vertex, edge);
+                } else {
+                  accum = vprog.gather(context, vertex, edge);
+                  accum_is_set = true;
+                }
+                ++edges_touched;
+                // elocks[local_edge.id()].unlock();
               }
-              ++edges_touched;
-              // elocks[local_edge.id()].unlock();
-            }
-          } // end of if in_edges/all_edges
-            // Loop over out edges
-          if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
-            foreach(local_edge_type local_edge, local_vertex.out_edges()) {
-              edge_type edge(local_edge);
-              // elocks[local_edge.id()].lock();
-              if(accum_is_set) { // \todo hint likely
-                accum += vprog.gather(context, vertex, edge);
-              } else {
-                accum = vprog.gather(context, vertex, edge);
-                accum_is_set = true;
+            } // end of if in_edges/all_edges
+              // Loop over out edges
+            if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
+              local_neighbor_prefetcher_type prefetcher =
+                  graph.l_neighbor_prefetcher(lvid, false, prefetch_distance);
+              foreach(local_edge_type local_edge, local_vertex.out_edges()) {
+                prefetcher.next();
+                if (!in_subgraph(local_edge.target().id())) continue;
+                edge_type edge(local_edge);
+                // elocks[local_edge.id()].lock();
+                if(accum_is_set) { // \todo hint likely
+                  accum += vprog.gather(context, vertex, edge);
+                } else {
+                  accum = vprog.gather(context, vertex, edge);
+                  accum_is_set = true;
+                }
+                // elocks[local_edge.id()].unlock();
+                ++edges_touched;
               }
-              // elocks[local_edge.id()].unlock();
-              ++edges_touched;
-            }
-            INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
-          } // end of if out_edges/all_edges
+              INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
+            } // end of if out_edges/all_edges
+          } // end of per edge gather
           vprog.post_local_gather(accum);
           // If caching is enabled then save the accumulator to the
           // cache for future iterations.  Note that it is possible
           // that the accumulator was never set in which case we are
           // effectively "zeroing out" the cache.
           if(caching_enabled && accum_is_set) {
-            gather_cache[lvid] = accum; has_cache.set_bit(lvid);
+            store_gather_cache(lvid, accum);
           } // end of if caching enabled
         }
+        END_TRACEPOINT(syncengine_vertex_gather);
+        if (pipelined_phase) {
+          const conditional_addition_wrapper<gather_type>
+              partial(accum, accum_is_set);
+          if (graph.l_is_master(lvid)) {
+            add_pipelined_gather(context, lvid, partial, thread_id, true);
+          } else {
+            // Clear the vertex program before sending the contribution
+            // since the master may reply with the scatter program at
+            // any time after.
+            vertex_programs.reset(lvid);
+            partial_gather_exchange.send(graph.l_master(lvid),
+                std::make_pair(graph.get_shared_vertex_index().positions(lvid)[0],
+                               partial));
+          }
+          // applys and received vertex data must wait until the local
+          // gathers are done reading the vertex data
+          if(++vcount % TRY_RECV_MOD == 0) {
+            recv_pipelined_gathers(context, thread_id, true);
+          }
+          continue;
+        }
         // If the accum contains a value for the local gather we put
         // that estimate in the gather exchange.
         if(accum_is_set) sync_gather(lvid, accum, thread_id);
         if(!graph.l_is_master(lvid)) {
           // if this is not the master clear the vertex program
-          vertex_programs[lvid] = vertex_program_type();
+          vertex_programs.reset(lvid);
         }
 
         // try to recv gathers if there are any in the buffer
@@ -1654,6 +3320,36 @@ namespace graphlab {
       }
     } // end of loop over vertices to compute gather accumulators
     per_thread_compute_time[thread_id] += ti.current_time();
+    if (pipelined_phase) {
+      // Once no thread is gathering, apply the vertices whose gather
+      // already completed, while the other contributions are in flight.
+      partial_gather_exchange.partial_flush();
+      thread_barrier.wait();
+      foreach(lvid_type lvid, pipelined_ready[thread_id]) {
+        apply_vertex(context, lvid, thread_id);
+      }
+      pipelined_ready[thread_id].clear();
+      // Finish sending the gather contributions. Receiving them runs
+      // the remaining applys which produce vertex data and programs.
+      thread_barrier.wait();
+      if(thread_id == 0) partial_gather_exchange.flush();
+      thread_barrier.wait();
+      recv_pipelined_gathers(context, thread_id, false);
+      vprog_exchange.partial_flush();
+      vdata_exchange.partial_flush();
+      vdelta_exchange.partial_flush();
+      foreach(ivertex_column* column, attached_columns) column->partial_flush();
+      thread_barrier.wait();
+      if(thread_id == 0) {
+        vprog_exchange.flush(); vdata_exchange.flush();
+        vdelta_exchange.flush();
+        foreach(ivertex_column* column, attached_columns) column->flush();
+      }
+      thread_barrier.wait();
+      recv_vertex_programs();
+      recv_vertex_data();
+      return;
+    }
     gather_exchange.partial_flush();
       // Finish sending and receiving all gather operations
     thread_barrier.wait();
@@ -1663,6 +3359,187 @@ namespace graphlab {
   } // end of execute_gathers
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_tiled_gathers(context_type& context) {
+    const size_t nverts = graph.num_local_vertices();
+    const size_t width = gather_tile_vertices;
+    const bool caching_enabled = !gather_cache.empty();
+    std::vector<lvid_type> targets;
+    std::vector<local_edge_span_type> spans;
+    std::vector<size_t> cursors;
+    size_t edges_touched = 0;
+    for (size_t first = next_vertex_range.inc_ret_last() * width;
+         first < nverts; first = next_vertex_range.inc_ret_last() * width) {
+      const size_t last = std::min(nverts, first + width);
+      targets.clear(); spans.clear();
+      for (lvid_type lvid = first; lvid < last; ++lvid) {
+        if (!active_minorstep.get(lvid)) continue;
+        if (caching_enabled && has_cache.get(lvid)) continue;
+        const vertex_program_type& vprog = vertex_programs[lvid];
+        const vertex_type vertex(graph.l_vertex(lvid));
+        const edge_dir_type gather_dir = resolve_gather_edges(vprog, context, vertex);
+        if (gather_dir != IN_EDGES && gather_dir != ALL_EDGES) continue;
+        targets.push_back(lvid);
+        spans.push_back(graph.l_in_edge_span(lvid));
+        local_accum[lvid] = gather_type();
+        vprog.pre_local_gather(local_accum[lvid]);
+        local_accum_is_set.clear_bit(lvid);
+        has_local_accum.set_bit(lvid);
+      }
+      cursors.assign(targets.size(), 0);
+      // Sweep the ranges of sources. The in edges are sorted by source,
+      // and the last range takes whatever is left.
+      for (size_t source_end = width; !targets.empty(); source_end += width) {
+        const bool last_range = source_end >= nverts;
+        for (size_t i = 0; i < targets.size(); ++i) {
+          const lvid_type lvid = targets[i];
+          const local_edge_span_type& span = spans[i];
+          size_t& c = cursors[i];
+          if (c == span.size()) continue;
+          const vertex_program_type& vprog = vertex_programs[lvid];
+          const vertex_type vertex(graph.l_vertex(lvid));
+          gather_type& accum = local_accum[lvid];
+          for (; c < span.size() &&
+                 (last_range || span.neighbor_lvid(c) < source_end); ++c) {
+            edge_type edge(graph.l_edge(span.neighbor_lvid(c), lvid,
+                                        span.edge_id(c)));
+            if (local_accum_is_set.get(lvid)) {
+              accum += vprog.gather(context, vertex, edge);
+            } else {
+              accum = vprog.gather(context, vertex, edge);
+              local_accum_is_set.set_bit(lvid);
+            }
+            ++edges_touched;
+          }
+        }
+        if (last_range) break;
+      }
+    }
+    INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
+  } // end of execute_tiled_gathers
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_streamed_gathers(context_type& context, const size_t thread_id) {
+    const size_t nverts = graph.num_local_vertices();
+    const bool caching_enabled = !gather_cache.empty();
+    // Start the gathers of this thread's range of targets, the lvids
+    // for which streamed_range() is thread_id
+    const lvid_type range_begin = (thread_id * nverts + ncpus - 1) / ncpus;
+    const lvid_type range_end = ((thread_id + 1) * nverts + ncpus - 1) / ncpus;
+    for (lvid_type lvid = range_begin; lvid < range_end; ++lvid) {
+      if (!active_minorstep.get(lvid) ||
+          (caching_enabled && has_cache.get(lvid))) {
+        streamed_dirs[lvid] = NO_EDGES;
+        continue;
+      }
+      const vertex_program_type& vprog = vertex_programs[lvid];
+      const vertex_type vertex(graph.l_vertex(lvid));
+      streamed_dirs[lvid] = resolve_gather_edges(vprog, context, vertex);
+      local_accum[lvid] = gather_type();
+      vprog.pre_local_gather(local_accum[lvid]);
+      local_accum_is_set.clear_bit(lvid);
+      has_local_accum.set_bit(lvid);
+    }
+    thread_barrier.wait();
+
+    // Stream the out edges of ranges of sources. The gathers along out
+    // edges go straight to the source, which only this thread touches.
+    const size_t SOURCE_RANGE = 1024;
+    std::vector<std::vector<std::pair<lvid_type, gather_type> > >& updates =
+        streamed_updates[thread_id];
+    size_t edges_touched = 0;
+    for (size_t first = next_vertex_range.inc_ret_last() * SOURCE_RANGE;
+         first < nverts;
+         first = next_vertex_range.inc_ret_last() * SOURCE_RANGE) {
+      const size_t last = std::min(nverts, first + SOURCE_RANGE);
+      for (lvid_type source = first; source < last; ++source) {
+        const local_edge_span_type span = graph.l_out_edge_span(source);
+        const bool source_gathers = streamed_dirs[source] == OUT_EDGES ||
+            streamed_dirs[source] == ALL_EDGES;
+        for (size_t i = 0; i < span.size(); ++i) {
+          const lvid_type target = span.neighbor_lvid(i);
+          const bool target_gathers = streamed_dirs[target] == IN_EDGES ||
+              streamed_dirs[target] == ALL_EDGES;
+          if (!source_gathers && !target_gathers) continue;
+          edge_type edge(graph.l_edge(source, target, span.edge_id(i)));
+          if (target_gathers) {
+            const vertex_type vertex(graph.l_vertex(target));
+            updates[streamed_range(target)].push_back(std::make_pair(target,
+                vertex_programs[target].gather(context, vertex, edge)));
+            ++edges_touched;
+          }
+          if (source_gathers) {
+            const vertex_type vertex(graph.l_vertex(source));
+            const gather_type partial =
+                vertex_programs[source].gather(context, vertex, edge);
+            if (local_accum_is_set.get(source)) {
+              local_accum[source] += partial;
+            } else {
+              local_accum[source] = partial;
+              local_accum_is_set.set_bit(source);
+            }
+            ++edges_touched;
+          }
+        }
+      }
+    }
+    INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
+    thread_barrier.wait();
+
+    // Add up the contributions to this thread's range of targets
+    for (size_t t = 0; t < ncpus; ++t) {
+      std::vector<std::pair<lvid_type, gather_type> >& range_updates =
+          streamed_updates[t][thread_id];
+      for (size_t i = 0; i < range_updates.size(); ++i) {
+        const lvid_type target = range_updates[i].first;
+        if (local_accum_is_set.get(target)) {
+          local_accum[target] += range_updates[i].second;
+        } else {
+          local_accum[target] = range_updates[i].second;
+          local_accum_is_set.set_bit(target);
+        }
+      }
+      range_updates.clear();
+    }
+  } // end of execute_streamed_gathers
+
+
+  template<typename VertexProgram>
+  bool synchronous_engine<VertexProgram>::
+  batch_gather(context_type& context, const vertex_program_type& vprog,
+               lvid_type lvid, edge_dir_type gather_dir,
+               gather_type& accum, bool& accum_is_set) {
+    const vertex_type vertex(graph.l_vertex(lvid));
+    size_t edges_touched = 0;
+    for (size_t i = 0; i < 2; ++i) {
+      const bool in = (i == 0);
+      if (in && gather_dir != IN_EDGES && gather_dir != ALL_EDGES) continue;
+      if (!in && gather_dir != OUT_EDGES && gather_dir != ALL_EDGES) continue;
+      const local_edge_span_type edges =
+          in ? graph.l_in_edge_span(lvid) : graph.l_out_edge_span(lvid);
+      if (edges.empty()) continue;
+      gather_type partial = gather_type();
+      if (!vprog.gather_batch(context, vertex, edges, partial)) {
+        // the vertex program either supports batches or it does not
+        ASSERT_EQ(edges_touched, 0);
+        return false;
+      }
+      if (accum_is_set) {
+        accum += partial;
+      } else {
+        accum = partial;
+        accum_is_set = true;
+      }
+      edges_touched += edges.size();
+    }
+    INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
+    return true;
+  } // end of batch_gather
+
+
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   execute_applys(const size_t thread_id) {
@@ -1671,46 +3548,10 @@ namespace graphlab {
     size_t vcount = 0;
     timer ti;
 
-    fixed_dense_bitset<8 * sizeof(size_t)> local_bitset;  // allocate a word size = 64bits
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = active_superstep.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
-      // initialize a word sized bitfield
-      local_bitset.clear();
-      local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
-        if (lvid >= graph.num_local_vertices()) break;
-
-        // Only master vertices can be active in a super-step
-        ASSERT_TRUE(graph.l_is_master(lvid));
-        vertex_type vertex(graph.l_vertex(lvid));
-        // Get the local accumulator.  Note that it is possible that
-        // the gather_accum was not set during the gather.
-        const gather_type& accum = gather_accum[lvid];
-        INCREMENT_EVENT(EVENT_APPLIES, 1);
-        vertex_programs[lvid].apply(context, vertex, accum);
-        // record an apply as a completed task
-        ++completed_applys;
-        // Clear the accumulator to save some memory
-        gather_accum[lvid] = gather_type();
-        // synchronize the changed vertex data with all mirrors
-        sync_vertex_data(lvid, thread_id);
-        // determine if a scatter operation is needed
-        const vertex_program_type& const_vprog = vertex_programs[lvid];
-        const vertex_type const_vertex = vertex;
-        if(const_vprog.scatter_edges(context, const_vertex) !=
-           graphlab::NO_EDGES) {
-          active_minorstep.set_bit(lvid);
-          sync_vertex_program(lvid, thread_id);
-        } else { // we are done so clear the vertex program
-          vertex_programs[lvid] = vertex_program_type();
-        }
+    std::vector<lvid_type> block;
+    while (next_active_block(active_superstep, block, thread_id)) {
+      foreach(lvid_type lvid, block) {
+        apply_vertex(context, lvid, thread_id);
       // try to receive vertex data
         if(++vcount % TRY_RECV_MOD == 0) {
           recv_vertex_programs();
@@ -1722,10 +3563,14 @@ namespace graphlab {
     per_thread_compute_time[thread_id] += ti.current_time();
     vprog_exchange.partial_flush();
     vdata_exchange.partial_flush();
+    vdelta_exchange.partial_flush();
+    foreach(ivertex_column* column, attached_columns) column->partial_flush();
       // Finish sending and receiving all changes due to apply operations
     thread_barrier.wait();
     if(thread_id == 0) { 
       vprog_exchange.flush(); vdata_exchange.flush(); 
+      vdelta_exchange.flush();
+      foreach(ivertex_column* column, attached_columns) column->flush();
     }
     thread_barrier.wait();
     recv_vertex_programs();
@@ -1733,6 +3578,95 @@ namespace graphlab {
   } // end of execute_applys
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  sync_unsynced_masters(const size_t thread_id) {
+    std::vector<lvid_type> block;
+    while (next_active_block(unsynced_masters, block, thread_id)) {
+      foreach(lvid_type lvid, block) {
+        sync_vertex_data(lvid, thread_id);
+        unsynced_distance[lvid] = 0;
+      }
+    }
+    vdata_exchange.partial_flush();
+    thread_barrier.wait();
+    if(thread_id == 0) vdata_exchange.flush();
+    thread_barrier.wait();
+    recv_vertex_data();
+  } // end of sync_unsynced_masters
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  apply_vertex(context_type& context, lvid_type lvid, const size_t thread_id) {
+    // Only master vertices can be active in a super-step
+    ASSERT_TRUE(graph.l_is_master(lvid));
+    vertex_type vertex(graph.l_vertex(lvid));
+    // Get the local accumulator.  Note that it is possible that
+    // the gather_accum was not set during the gather.
+    const gather_type& accum = gather_accum.get(lvid);
+    INCREMENT_EVENT(EVENT_APPLIES, 1);
+    BEGIN_TRACEPOINT(syncengine_vertex_apply);
+    if (delta_superstep && graph.l_vertex(lvid).num_mirrors() > 0) {
+      // keep the old vertex data to compute the delta for the mirrors
+      const vertex_data_type old_data = vertex.data();
+      vertex_programs[lvid].apply(context, vertex, accum);
+      if (sync_tolerance > 0 && unsynced_masters.get(lvid)) {
+        // the mirrors missed earlier changes and do not hold old_data
+        sync_vertex_data(lvid, thread_id);
+        unsynced_masters.clear_bit(lvid);
+      } else {
+        sync_vertex_delta(lvid, old_data, thread_id);
+      }
+      if (sync_tolerance > 0) unsynced_distance[lvid] = 0;
+    } else if (sync_tolerance > 0 && graph.l_vertex(lvid).num_mirrors() > 0) {
+      const vertex_data_type old_data = vertex.data();
+      vertex_programs[lvid].apply(context, vertex, accum);
+      const double distance = unsynced_distance[lvid] + 
+          vertex_programs[lvid].vertex_data_distance(old_data, vertex.data());
+      if (distance < sync_tolerance) {
+        unsynced_distance[lvid] = distance;
+        unsynced_masters.set_bit(lvid);
+      } else {
+        sync_vertex_data(lvid, thread_id);
+        unsynced_distance[lvid] = 0;
+        unsynced_masters.clear_bit(lvid);
+      }
+    } else {
+      vertex_programs[lvid].apply(context, vertex, accum);
+      // synchronize the changed vertex data with all mirrors
+      sync_vertex_data(lvid, thread_id);
+    }
+    if (graph.l_vertex(lvid).num_mirrors() > 0) {
+      foreach(ivertex_column* column, attached_columns) {
+        column->send_to_mirrors(lvid);
+      }
+    }
+    END_TRACEPOINT(syncengine_vertex_apply);
+    if (fuse_vertex_aggregators) {
+      aggregator.fused_map_vertex(thread_id, context, vertex);
+    }
+    // record an apply as a completed task
+    completed_applys.inc(thread_id);
+    // Clear the accumulator to save some memory
+    gather_accum.reset(lvid);
+    has_gather_accum.clear_bit(lvid);
+    // determine if a scatter operation is needed
+    const vertex_program_type& const_vprog = vertex_programs[lvid];
+    const vertex_type const_vertex = vertex;
+    if(resolve_scatter_edges(const_vprog, context, const_vertex) !=
+       graphlab::NO_EDGES) {
+      // active_minorstep still holds the gathering vertices while
+      // the gather is pipelined
+      if (pipelined_phase) pipelined_minorstep.set_bit(lvid);
+      else active_minorstep.set_bit(lvid);
+      sync_vertex_program(lvid, thread_id);
+    } else { // we are done so clear the vertex program
+      vertex_programs.reset(lvid);
+    }
+  } // end of apply_vertex
+
+
 
 
   template<typename VertexProgram>
@@ -1740,50 +3674,53 @@ namespace graphlab {
   execute_scatters(const size_t thread_id) {
     context_type context(*this, graph);
     timer ti;
-    fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // allocate a word size = 64 bits
-    while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
-      // get the bit field from has_message
-      size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
-      if (lvid_bit_block == 0) continue;
-      // initialize a word sized bitfield
-      local_bitset.clear();
-      local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
-        if (lvid >= graph.num_local_vertices()) break;
-
+    std::vector<lvid_type> block;
+    while (next_active_block(active_minorstep, block, thread_id)) {
+      for (size_t j = 0; j < block.size(); ++j) {
+        const lvid_type lvid = block[j];
+        prefetch_next_vertices(block, j);
         const vertex_program_type& vprog = vertex_programs[lvid];
         local_vertex_type local_vertex = graph.l_vertex(lvid);
         const vertex_type vertex(local_vertex);
-        const edge_dir_type scatter_dir = vprog.scatter_edges(context, vertex);
+        const edge_dir_type scatter_dir = resolve_scatter_edges(vprog, context, vertex);
 				size_t edges_touched = 0;
         // Loop over in edges
         if(scatter_dir == IN_EDGES || scatter_dir == ALL_EDGES) {
+          local_neighbor_prefetcher_type prefetcher =
+              graph.l_neighbor_prefetcher(lvid, true, prefetch_distance);
           foreach(local_edge_type local_edge, local_vertex.in_edges()) {
+            prefetcher.next();
+            if (!in_subgraph(local_edge.source().id())) continue;
             edge_type edge(local_edge);
             // elocks[local_edge.id()].lock();
             vprog.scatter(context, vertex, edge);
             // elocks[local_edge.id()].unlock();
+            if (fuse_edge_aggregators) {
+              aggregator.fused_map_edge(thread_id, context, edge);
+            }
           }
 					++edges_touched;
         } // end of if in_edges/all_edges
         // Loop over out edges
         if(scatter_dir == OUT_EDGES || scatter_dir == ALL_EDGES) {
+          local_neighbor_prefetcher_type prefetcher =
+              graph.l_neighbor_prefetcher(lvid, false, prefetch_distance);
           foreach(local_edge_type local_edge, local_vertex.out_edges()) {
+            prefetcher.next();
+            if (!in_subgraph(local_edge.target().id())) continue;
             edge_type edge(local_edge);
             // elocks[local_edge.id()].lock();
             vprog.scatter(context, vertex, edge);
             // elocks[local_edge.id()].unlock();
+            if (fuse_edge_aggregators) {
+              aggregator.fused_map_edge(thread_id, context, edge);
+            }
           }
 					++edges_touched;
         } // end of if out_edges/all_edges
 				INCREMENT_EVENT(EVENT_SCATTERS, edges_touched);
         // Clear the vertex program
-        vertex_programs[lvid] = vertex_program_type();
+        vertex_programs.reset(lvid);
       } // end of if active on this minor step
     } // end of loop over vertices to complete scatter operation
 
@@ -1792,16 +3729,88 @@ namespace graphlab {
 
 
 
+  // Frontier Management ====================================================
+  template<typename VertexProgram>
+  bool synchronous_engine<VertexProgram>::
+  next_active_block(hybrid_bitset<lvid_type>& bits,
+                    std::vector<lvid_type>& block,
+                    const size_t thread_id) {
+    const size_t SPARSE_BLOCK_SIZE = 64;
+    const size_t WORD_SIZE = 8 * sizeof(size_t);
+    size_t& pos = thread_chunk[thread_id].value.first;
+    size_t& stop = thread_chunk[thread_id].value.second;
+    block.clear();
+    if (sparse_phase) {
+      while (block.empty()) {
+        // claim a range of entries from the sparse list
+        if (pos >= stop && !lvid_dispenser.claim(pos, stop)) return false;
+        const size_t end = std::min(pos + SPARSE_BLOCK_SIZE, stop);
+        for (size_t i = pos; i < end; ++i) {
+          const lvid_type lvid = bits.sparse_entry(i);
+          if (bits.get(lvid)) block.push_back(lvid);
+        }
+        pos = end;
+      }
+    } else {
+      while (block.empty()) {
+        // advance a word at a time through the chunk
+        if (pos >= stop && !next_dense_chunk(pos, stop)) return false;
+        lvid_type lvid_block_start = pos;
+        pos += WORD_SIZE;
+        // get the bit field from the bitset
+        size_t lvid_bit_block = bits.containing_word(lvid_block_start);
+        while (lvid_bit_block) {
+          lvid_type lvid = lvid_block_start +
+              dense_bitset::pop_first_bit(lvid_bit_block);
+          if (lvid >= graph.num_local_vertices()) break;
+          block.push_back(lvid);
+        }
+      }
+    }
+    return true;
+  } // end of next_active_block
+
+
+  template<typename VertexProgram>
+  bool synchronous_engine<VertexProgram>::
+  next_dense_chunk(size_t& start, size_t& stop) {
+    if (numa_dispenser.empty()) {
+      return lvid_dispenser.claim(start, stop);
+    }
+    const size_t nnodes = numa_dispenser.size();
+    const size_t workerid = fiber_control::get_worker_id();
+    const size_t home = (workerid == size_t(-1)) ? 0 :
+        fiber_control::get_instance().worker_numa_node(workerid) % nnodes;
+    for (size_t i = 0; i < nnodes; ++i) {
+      const size_t k = (home + i) % nnodes;
+      if (numa_dispenser[k].claim(start, stop)) return true;
+    }
+    return false;
+  } // end of next_dense_chunk
+
+
+  template<typename VertexProgram>
+  bool synchronous_engine<VertexProgram>::
+  use_sparse_frontier(size_t global_active) const {
+    if (!track_frontier || sched_allv) return false;
+    if (frontier_mode == "sparse") return true;
+    return global_active < sparse_threshold * graph.num_vertices();
+  } // end of use_sparse_frontier
+
+
   // Data Synchronization ===================================================
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   sync_vertex_program(lvid_type lvid, const size_t thread_id) {
     ASSERT_TRUE(graph.l_is_master(lvid));
-    const vertex_id_type vid = graph.global_vid(lvid);
+    const position_type* positions = 
+        graph.get_shared_vertex_index().positions(lvid);
     local_vertex_type vertex = graph.l_vertex(lvid);
+    size_t k = 0;
+    vid_prog_pair_type rec;
     foreach(const procid_t& mirror, vertex.mirrors()) {
-      vprog_exchange.send(mirror,
-                          std::make_pair(vid, vertex_programs[lvid]));
+      fill_vprog_record(rec, positions[k++], lvid);
+      vprog_exchange.send(mirror, rec);
     }
   } // end of sync_vertex_program
 
@@ -1810,15 +3819,19 @@ namespace graphlab {
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   recv_vertex_programs() {
+    const shared_vertex_index& plan = graph.get_shared_vertex_index();
     typename vprog_exchange_type::recv_buffer_type recv_buffer;
     while(vprog_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename vprog_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
+        const procid_t proc = recv_buffer[i].proc;
         foreach(const vid_prog_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+          const lvid_type lvid =
+              plan.mirror_lvid(proc, vprog_record_position(pair));
           //      ASSERT_FALSE(graph.l_is_master(lvid));
-          vertex_programs[lvid] = pair.second;
-          active_minorstep.set_bit(lvid);
+          store_vprog_record(lvid, pair);
+          if (pipelined_phase) pipelined_minorstep.set_bit(lvid);
+          else active_minorstep.set_bit(lvid);
         }
       }
     }
@@ -1829,31 +3842,73 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   sync_vertex_data(lvid_type lvid, const size_t thread_id) {
     ASSERT_TRUE(graph.l_is_master(lvid));
-    const vertex_id_type vid = graph.global_vid(lvid);
+    const position_type* positions = 
+        graph.get_shared_vertex_index().positions(lvid);
     local_vertex_type vertex = graph.l_vertex(lvid);
+    size_t k = 0;
     foreach(const procid_t& mirror, vertex.mirrors()) {
-      vdata_exchange.send(mirror, std::make_pair(vid, vertex.data()));
+      vdata_exchange.send(mirror, std::make_pair(positions[k++], vertex.data()));
     }
   } // end of sync_vertex_data
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  sync_vertex_delta(lvid_type lvid, const vertex_data_type& old_data,
+                    const size_t thread_id) {
+    ASSERT_TRUE(graph.l_is_master(lvid));
+    local_vertex_type vertex = graph.l_vertex(lvid);
+    vertex_delta_type delta;
+    if (!vertex_programs[lvid].make_vertex_delta(old_data, vertex.data(),
+                                                 delta)) {
+      sync_vertex_data(lvid, thread_id);
+      return;
+    }
+    const position_type* positions = 
+        graph.get_shared_vertex_index().positions(lvid);
+    size_t k = 0;
+    foreach(const procid_t& mirror, vertex.mirrors()) {
+      vdelta_exchange.send(mirror, std::make_pair(positions[k++], delta));
+    }
+  } // end of sync_vertex_delta
+
+
 
 
 
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   recv_vertex_data() {
+    const shared_vertex_index& plan = graph.get_shared_vertex_index();
     typename vdata_exchange_type::recv_buffer_type recv_buffer;
     while(vdata_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename vdata_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
+        const procid_t proc = recv_buffer[i].proc;
         foreach(const vid_vdata_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+          const lvid_type lvid = plan.mirror_lvid(proc, pair.first);
           ASSERT_FALSE(graph.l_is_master(lvid));
           graph.l_vertex(lvid).data() = pair.second;
         }
       }
     }
+    // deltas must not depend on the state of the vertex program so
+    // any instance can apply them
+    const vertex_program_type vprog = vertex_program_type();
+    typename vdelta_exchange_type::recv_buffer_type delta_buffer;
+    while(vdelta_exchange.recv(delta_buffer)) {
+      for (size_t i = 0;i < delta_buffer.size(); ++i) {
+        typename vdelta_exchange_type::buffer_type& buffer = delta_buffer[i].buffer;
+        const procid_t proc = delta_buffer[i].proc;
+        foreach(const vid_vdelta_pair_type& pair, buffer) {
+          const lvid_type lvid = plan.mirror_lvid(proc, pair.first);
+          ASSERT_FALSE(graph.l_is_master(lvid));
+          vprog.apply_vertex_delta(
+              make_soa_lvalue(graph.l_vertex(lvid).data()).get(), pair.second);
+        }
+      }
+    }
+    foreach(ivertex_column* column, attached_columns) column->receive();
   } // end of recv vertex data
 
 
@@ -1871,20 +3926,23 @@ namespace graphlab {
       vlocks[lvid].unlock();
     } else {
       const procid_t master = graph.l_master(lvid);
-      const vertex_id_type vid = graph.global_vid(lvid);
-      gather_exchange.send(master, std::make_pair(vid, accum));
+      const position_type position = 
+          graph.get_shared_vertex_index().positions(lvid)[0];
+      gather_exchange.send(master, std::make_pair(position, accum));
     }
   } // end of sync_gather
 
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   recv_gathers() {
+    const shared_vertex_index& plan = graph.get_shared_vertex_index();
     typename gather_exchange_type::recv_buffer_type recv_buffer;
     while(gather_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename gather_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
+        const procid_t proc = recv_buffer[i].proc;
         foreach(const vid_gather_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+          const lvid_type lvid = plan.master_lvid(proc, pair.first);
           const gather_type& accum = pair.second;
           ASSERT_TRUE(graph.l_is_master(lvid));
           vlocks[lvid].lock();
@@ -1901,13 +3959,61 @@ namespace graphlab {
   } // end of recv_gather
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  add_pipelined_gather(context_type& context, lvid_type lvid,
+                       const conditional_addition_wrapper<gather_type>& accum,
+                       const size_t thread_id, const bool defer_apply) {
+    ASSERT_TRUE(graph.l_is_master(lvid));
+    vlocks[lvid].lock();
+    if (accum.has_value) {
+      if(has_gather_accum.get(lvid)) {
+        gather_accum[lvid] += accum.value;
+      } else {
+        gather_accum[lvid] = accum.value;
+        has_gather_accum.set_bit(lvid);
+      }
+    }
+    ASSERT_GT(pending_gathers[lvid], 0);
+    const bool complete = (--pending_gathers[lvid] == 0);
+    vlocks[lvid].unlock();
+    if (complete) {
+      // the apply runs now so the apply phase must skip the vertex
+      active_superstep.clear_bit(lvid);
+      if (defer_apply) pipelined_ready[thread_id].push_back(lvid);
+      else apply_vertex(context, lvid, thread_id);
+    }
+  } // end of add_pipelined_gather
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  recv_pipelined_gathers(context_type& context, const size_t thread_id,
+                         const bool defer_apply) {
+    const shared_vertex_index& plan = graph.get_shared_vertex_index();
+    typename partial_gather_exchange_type::recv_buffer_type recv_buffer;
+    while(partial_gather_exchange.recv(recv_buffer)) {
+      for (size_t i = 0;i < recv_buffer.size(); ++i) {
+        typename partial_gather_exchange_type::buffer_type& buffer =
+            recv_buffer[i].buffer;
+        const procid_t proc = recv_buffer[i].proc;
+        foreach(const vid_partial_gather_pair_type& pair, buffer) {
+          add_pipelined_gather(context, plan.master_lvid(proc, pair.first),
+                               pair.second, thread_id, defer_apply);
+        }
+      }
+    }
+  } // end of recv_pipelined_gathers
+
+
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   sync_message(lvid_type lvid, const size_t thread_id) {
     ASSERT_FALSE(graph.l_is_master(lvid));
     const procid_t master = graph.l_master(lvid);
-    const vertex_id_type vid = graph.global_vid(lvid);
-    message_exchange.send(master, std::make_pair(vid, messages[lvid]));
+    const position_type position = 
+        graph.get_shared_vertex_index().positions(lvid)[0];
+    message_exchange.send(master, std::make_pair(position, messages[lvid]));
   } // end of send_message
 
 
@@ -1916,12 +4022,14 @@ namespace graphlab {
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   recv_messages() {
+    const shared_vertex_index& plan = graph.get_shared_vertex_index();
     typename message_exchange_type::recv_buffer_type recv_buffer;
     while(message_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename message_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
+        const procid_t proc = recv_buffer[i].proc;
         foreach(const vid_message_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+          const lvid_type lvid = plan.master_lvid(proc, pair.first);
           ASSERT_TRUE(graph.l_is_master(lvid));
           vlocks[lvid].lock();
           if( has_message.get(lvid) ) {
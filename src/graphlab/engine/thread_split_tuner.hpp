@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_ENGINE_THREAD_SPLIT_TUNER_HPP
+#define GRAPHLAB_ENGINE_THREAD_SPLIT_TUNER_HPP
+
+#include <vector>
+#include <algorithm>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/util/timer.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Splits the fiber workers of a machine between the compute
+   * threads of an engine and the RPC handler threads, from the measured
+   * busy time of the handlers.
+   *
+   * The fibers are cooperative, so a handler sharing its worker with a
+   * compute thread only runs when the compute thread yields. Handler i
+   * runs on worker i. Every update() measures the fraction of the time
+   * each handler was busy since the last one, smoothed over the previous
+   * updates. A handler busy more than RESERVE_PERCENT of the time gets
+   * its worker reserved, and the compute threads are spread over the
+   * other workers. The worker is given back once the handler is busy
+   * less than RELEASE_PERCENT of the time. At most max_reserved workers
+   * are reserved, the busiest handlers first, and at least one is left
+   * to the compute threads.
+   *
+   * The tuner also keeps the bytes this machine sent to every machine,
+   * over the last interval and in total, which are the rows of the
+   * traffic matrix.
+   */
+  class thread_split_tuner {
+  public:
+    enum { RESERVE_PERCENT = 30, RELEASE_PERCENT = 15 };
+
+    thread_split_tuner() : nworkers(1), max_reserved(0), last_time(0) { }
+
+    /// Starts tuning the split of nworkers workers
+    void init(const distributed_control& dc, size_t nworkers_,
+              size_t max_reserved_) {
+      nworkers = std::max<size_t>(nworkers_, 1);
+      max_reserved = std::min(max_reserved_, nworkers - 1);
+      const size_t nhandlers = dc.num_handler_threads();
+      last_busy.resize(nhandlers);
+      for (size_t i = 0; i < nhandlers; ++i) last_busy[i] = dc.handler_busy_usec(i);
+      busy_fraction.assign(nhandlers, 0);
+      reserved.assign(nhandlers, false);
+      last_sent.resize(dc.numprocs());
+      for (procid_t p = 0; p < dc.numprocs(); ++p) last_sent[p] = dc.bytes_sent_to(p);
+      interval_sent.assign(dc.numprocs(), 0);
+      total_sent.assign(dc.numprocs(), 0);
+      last_time = timer::usec_of_day();
+      update_workers();
+    }
+
+    /**
+     * Measures the handlers and the traffic since the last call and
+     * updates the split. Returns true if the split changed.
+     */
+    bool update(const distributed_control& dc) {
+      const size_t now = timer::usec_of_day();
+      const double elapsed = std::max<double>(now - last_time, 1);
+      last_time = now;
+      for (procid_t p = 0; p < last_sent.size(); ++p) {
+        const size_t sent = dc.bytes_sent_to(p);
+        interval_sent[p] = sent - last_sent[p];
+        total_sent[p] += interval_sent[p];
+        last_sent[p] = sent;
+      }
+      for (size_t i = 0; i < last_busy.size(); ++i) {
+        const size_t busy = dc.handler_busy_usec(i);
+        busy_fraction[i] = (busy_fraction[i] + (busy - last_busy[i]) / elapsed) / 2;
+        last_busy[i] = busy;
+      }
+      // the handlers over the reserve bound, and the reserved ones above
+      // the release bound, by decreasing busy fraction
+      std::vector<std::pair<double, size_t> > wanted;
+      for (size_t i = 0; i < last_busy.size(); ++i) {
+        const double bound = (reserved[i] ? RELEASE_PERCENT : RESERVE_PERCENT) / 100.0;
+        if (busy_fraction[i] > bound) wanted.push_back(std::make_pair(busy_fraction[i], i));
+      }
+      std::sort(wanted.rbegin(), wanted.rend());
+      std::vector<bool> next(last_busy.size(), false);
+      std::vector<bool> worker_taken(nworkers, false);
+      size_t nreserved = 0;
+      for (size_t i = 0; i < wanted.size() && nreserved < max_reserved; ++i) {
+        const size_t worker = wanted[i].second % nworkers;
+        next[wanted[i].second] = true;
+        if (!worker_taken[worker]) {
+          worker_taken[worker] = true;
+          ++nreserved;
+        }
+      }
+      if (next == reserved) return false;
+      reserved.swap(next);
+      update_workers();
+      return true;
+    }
+
+    /// The worker compute thread i runs on
+    size_t compute_worker(size_t i) const {
+      return compute_workers[i % compute_workers.size()];
+    }
+
+    /// The number of workers reserved for the handlers
+    size_t num_reserved() const { return nworkers - compute_workers.size(); }
+
+    size_t num_workers() const { return nworkers; }
+
+    /// The smoothed number of cores the handlers keep busy
+    double handler_cores() const {
+      double cores = 0;
+      for (size_t i = 0; i < busy_fraction.size(); ++i) cores += busy_fraction[i];
+      return cores;
+    }
+
+    /// The bytes sent to every machine over the last interval
+    const std::vector<size_t>& last_interval_sent() const { return interval_sent; }
+
+    /// The bytes sent to every machine since init()
+    const std::vector<size_t>& sent() const { return total_sent; }
+
+  private:
+    size_t nworkers;
+    size_t max_reserved;
+    size_t last_time;
+    std::vector<size_t> last_busy;
+    std::vector<double> busy_fraction;
+    std::vector<bool> reserved;
+    std::vector<size_t> last_sent, interval_sent, total_sent;
+    std::vector<size_t> compute_workers;
+
+    void update_workers() {
+      std::vector<bool> taken(nworkers, false);
+      for (size_t i = 0; i < reserved.size(); ++i) {
+        if (reserved[i]) taken[i % nworkers] = true;
+      }
+      compute_workers.clear();
+      for (size_t w = 0; w < nworkers; ++w) {
+        if (!taken[w]) compute_workers.push_back(w);
+      }
+    }
+  }; // end of thread_split_tuner
+
+} // end of namespace graphlab
+
+#endif
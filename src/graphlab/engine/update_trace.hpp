@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_ENGINE_UPDATE_TRACE_HPP
+#define GRAPHLAB_ENGINE_UPDATE_TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/serialization/is_pod.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Records the stages of a sample of the vertex updates of an
+   * asynchronous engine run, on all the machines taking part in them.
+   *
+   * A vertex is sampled when it is signaled on its master, with
+   * probability rate, and its next update gets a trace id. The master
+   * records the time from the signal to the update (SCHEDULE), the
+   * lock acquisition, init, gather, apply and scatter, and the update
+   * as a whole. The trace id travels with the gather and scatter
+   * requests to the mirrors, which record the time they spend in them.
+   *
+   * A span is a stage of one update, timed in microseconds since the
+   * Unix Epoch so that the spans of different machines line up, up to
+   * the skew of their clocks. The spans of all the machines are written
+   * in the Chrome trace event format, which chrome://tracing and
+   * Perfetto read, with one process per machine and one track per
+   * update.
+   */
+  class update_trace {
+  public:
+    enum stage_type { SCHEDULE, LOCK, INIT, GATHER, APPLY, SCATTER, UPDATE,
+                      REMOTE_GATHER, REMOTE_SCATTER, NUM_STAGES };
+
+    struct span : public IS_POD_TYPE {
+      uint64_t trace_id;
+      uint64_t begin;
+      uint64_t end;
+      vertex_id_type vid;
+      uint32_t stage;
+    };
+
+    update_trace() : procid(0), rate(0), max_spans(0), ndropped(0) { }
+
+    /**
+     * Prepares the trace for nvertices local vertices, sampling the
+     * updates with probability rate and keeping at most max_spans spans
+     * on this machine. Must be called before the vertices are signaled.
+     */
+    void init(procid_t procid_, size_t nvertices, double rate_,
+              size_t max_spans_) {
+      procid = procid_;
+      rate = rate_;
+      max_spans = max_spans_;
+      pending.resize(nvertices);
+      pending.clear();
+      signal_time.assign(nvertices, 0);
+      clear();
+    }
+
+    /// Drops the spans recorded so far
+    void clear() {
+      spans.clear();
+      ndropped = 0;
+    }
+
+    bool enabled() const { return rate > 0; }
+
+    static inline uint64_t now() { return timer::usec_of_day(); }
+
+    /// Samples a signal of the master lvid
+    inline void signal(lvid_type lvid) {
+      if (!pending.get(lvid) && random::fast_bernoulli(rate) &&
+          !pending.set_bit(lvid)) {
+        signal_time[lvid] = now();
+      }
+    }
+
+    /**
+     * Called when an update of the master lvid starts. Returns its trace
+     * id, or 0 if it is not sampled.
+     */
+    inline uint64_t begin_update(lvid_type lvid, vertex_id_type vid) {
+      if (!pending.get(lvid) || !pending.clear_bit(lvid)) return 0;
+      // below 2^53 so that the JSON readers keep it exact
+      const uint64_t trace_id = (uint64_t(procid + 1) << 40) | next_id.inc();
+      record(trace_id, SCHEDULE, signal_time[lvid], vid);
+      return trace_id;
+    }
+
+    /**
+     * Records the stage of the update trace_id which started at begin
+     * and ends now. Returns now, the beginning of the next stage.
+     */
+    uint64_t record(uint64_t trace_id, stage_type stage, uint64_t begin,
+                    vertex_id_type vid) {
+      span s;
+      s.trace_id = trace_id;
+      s.begin = begin;
+      s.end = now();
+      s.vid = vid;
+      s.stage = stage;
+      lock.lock();
+      if (spans.size() < max_spans) spans.push_back(s);
+      else ++ndropped;
+      lock.unlock();
+      return s.end;
+    }
+
+    /// The spans recorded on this machine
+    const std::vector<span>& get_spans() const { return spans; }
+
+    /// The number of spans not recorded since max_spans was reached
+    size_t num_dropped() const { return ndropped; }
+
+    static const char* stage_name(size_t stage) {
+      static const char* names[NUM_STAGES] = {
+        "schedule", "lock", "init", "gather", "apply", "scatter", "update",
+        "remote_gather", "remote_scatter" };
+      return stage < NUM_STAGES ? names[stage] : "unknown";
+    }
+
+    /**
+     * Writes the spans of all the machines, by machine, to fname in the
+     * Chrome trace event format.
+     */
+    static void write(const std::string& fname,
+                      const std::vector<std::vector<span> >& machine_spans) {
+      std::ofstream fout(fname.c_str(), std::ios_base::out | std::ios_base::trunc);
+      fout << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+      bool first = true;
+      for (size_t p = 0; p < machine_spans.size(); ++p) {
+        if (!first) fout << ",\n";
+        first = false;
+        fout << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << p
+             << ", \"args\": {\"name\": \"machine " << p << "\"}}";
+        for (size_t i = 0; i < machine_spans[p].size(); ++i) {
+          const span& s = machine_spans[p][i];
+          fout << ",\n{\"name\": \"" << stage_name(s.stage)
+               << "\", \"cat\": \"update\", \"ph\": \"X\", \"pid\": " << p
+               << ", \"tid\": " << s.trace_id
+               << ", \"ts\": " << s.begin
+               << ", \"dur\": " << (s.end > s.begin ? s.end - s.begin : 0)
+               << ", \"args\": {\"vid\": " << s.vid << ", \"trace_id\": \""
+               << std::hex << s.trace_id << std::dec << "\"}}";
+        }
+      }
+      fout << "\n]}\n";
+      fout.close();
+      if (fout.fail()) {
+        logstream(LOG_ERROR) << "Error writing the update trace "
+                             << fname << std::endl;
+      }
+    }
+
+  private:
+    procid_t procid;
+    double rate;
+    size_t max_spans;
+    size_t ndropped;
+    /// The sampled vertices whose update has not started
+    dense_bitset pending;
+    /// The time of the first sampled signal of the pending vertices
+    std::vector<uint64_t> signal_time;
+    atomic<uint64_t> next_id;
+    std::vector<span> spans;
+    mutex lock;
+  }; // end of update_trace
+
+} // end of namespace graphlab
+
+#endif
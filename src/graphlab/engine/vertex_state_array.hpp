@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_VERTEX_STATE_ARRAY_HPP
+#define GRAPHLAB_VERTEX_STATE_ARRAY_HPP
+
+#include <vector>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/util/branch_hints.hpp>
+#include <graphlab/util/empty.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief A per-vertex array of engine state which only allocates
+   * memory for the chunks of vertices actually written.
+   *
+   * The array is divided into chunks of 2^ChunkBits consecutive
+   * entries. A chunk is allocated the first time one of its entries is
+   * accessed with operator[], and reads through get() of an entry of an
+   * unallocated chunk return a default constructed value. release()
+   * frees all the chunks once the engine knows every entry is back to
+   * its default value, so the memory follows the active frontier.
+   *
+   * operator[], get() and reset() may be called concurrently for
+   * different entries. resize() and release() are not thread safe.
+   */
+  template<typename T, size_t ChunkBits = 8>
+  class vertex_state_array {
+  public:
+    typedef T value_type;
+    static const size_t CHUNK_SIZE = size_t(1) << ChunkBits;
+
+    vertex_state_array() : numel(0), default_value() { }
+
+    ~vertex_state_array() { release(); }
+
+    /// Sets the number of entries. All entries become default valued.
+    void resize(size_t n) {
+      release();
+      numel = n;
+      chunks.assign((n + CHUNK_SIZE - 1) / CHUNK_SIZE, (T*)NULL);
+    }
+
+    size_t size() const { return numel; }
+
+    bool empty() const { return numel == 0; }
+
+    /// Returns entry i, allocating its chunk if necessary
+    inline T& operator[](size_t i) {
+      T* chunk = chunks[i >> ChunkBits];
+      if (__unlikely__(chunk == NULL)) chunk = allocate_chunk(i >> ChunkBits);
+      return chunk[i & (CHUNK_SIZE - 1)];
+    }
+
+    /// Returns entry i without allocating its chunk
+    inline const T& get(size_t i) const {
+      const T* chunk = chunks[i >> ChunkBits];
+      return chunk == NULL ? default_value : chunk[i & (CHUNK_SIZE - 1)];
+    }
+
+    inline const T& operator[](size_t i) const { return get(i); }
+
+    /// Resets entry i to the default value without allocating its chunk
+    inline void reset(size_t i) {
+      T* chunk = chunks[i >> ChunkBits];
+      if (chunk != NULL) chunk[i & (CHUNK_SIZE - 1)] = T();
+    }
+
+    /// Frees all the chunks. All entries become default valued.
+    void release() {
+      for (size_t c = 0; c < chunks.size(); ++c) {
+        delete [] chunks[c];
+        chunks[c] = NULL;
+      }
+    }
+
+    /// The bytes of the allocated chunks and of the chunk table
+    size_t allocated_bytes() const {
+      size_t nchunks = 0;
+      for (size_t c = 0; c < chunks.size(); ++c) nchunks += chunks[c] != NULL;
+      return nchunks * CHUNK_SIZE * sizeof(T) + chunks.capacity() * sizeof(T*);
+    }
+
+  private:
+    std::vector<T*> chunks;
+    size_t numel;
+    T default_value;
+
+    T* allocate_chunk(size_t c) {
+      T* chunk = new T[CHUNK_SIZE];
+      // another thread may have allocated the chunk in the meantime
+      if (!atomic_compare_and_swap(chunks[c], (T*)NULL, chunk)) delete [] chunk;
+      return chunks[c];
+    }
+
+    // not copyable
+    vertex_state_array(const vertex_state_array&);
+    vertex_state_array& operator=(const vertex_state_array&);
+  }; // end of vertex_state_array
+
+
+  /**
+   * \internal
+   * \brief The interface of vertex_state_array for state which is the
+   * same for all vertices, such as stateless vertex programs (see
+   * is_stateless_vertex_program): all the entries share a single value
+   * and writes to it are assumed to change nothing.
+   */
+  template<typename T>
+  class shared_vertex_state {
+  public:
+    typedef T value_type;
+
+    shared_vertex_state() : numel(0), value() { }
+
+    void resize(size_t n) { numel = n; }
+
+    size_t size() const { return numel; }
+
+    bool empty() const { return numel == 0; }
+
+    inline T& operator[](size_t i) { return value; }
+
+    inline const T& get(size_t i) const { return value; }
+
+    inline const T& operator[](size_t i) const { return value; }
+
+    inline void reset(size_t i) { }
+
+    void release() { }
+
+    size_t allocated_bytes() const { return sizeof(T); }
+
+  private:
+    size_t numel;
+    T value;
+  }; // end of shared_vertex_state
+
+
+  /**
+   * \internal
+   * \brief Selects the storage of a per-vertex state of type T.
+   *
+   * State of type graphlab::empty takes no per-vertex storage at all
+   * and is kept in a shared_vertex_state.
+   */
+  template<typename T, size_t ChunkBits = 8>
+  struct vertex_state_storage {
+    typedef vertex_state_array<T, ChunkBits> type;
+  };
+
+  template<size_t ChunkBits>
+  struct vertex_state_storage<empty, ChunkBits> {
+    typedef shared_vertex_state<empty> type;
+  };
+
+}; // end of namespace graphlab
+
+#endif
@@ -45,9 +45,12 @@
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/parallel/fiber_group.hpp>
 #include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/parallel/fiber_profiler.hpp>
 #include <graphlab/rpc/fiber_async_consensus.hpp>
+#include <graphlab/engine/fiber_population_control.hpp>
 #include <graphlab/aggregation/distributed_aggregator.hpp>
 #include <graphlab/parallel/fiber_remote_request.hpp>
+#include <graphlab/engine/warp_neighborhood_cache.hpp>
 #include <graphlab/macros_def.hpp>
 
 
@@ -171,6 +174,16 @@ namespace warp {
    * increases in throughput at a consistency penalty.
    * \li \b nfibers (default: 10000) Number of fibers to use
    * \li \b stacksize (default: 16384) Stacksize of each fiber.
+   * \li \b adaptive_fibers (default: false) Let the engine vary the
+   * number of fibers taking tasks between min_fibers and nfibers, based on
+   * the fraction of fibers blocked inside a task and on the task latency.
+   * Changes are logged.
+   * \li \b min_fibers (default: 100) Lower limit for adaptive_fibers.
+   * \li \b neighborhood_cache (default: false) Cache the partial results
+   * of warp::map_reduce_neighborhood() computed by the mirrors, and only
+   * request them again from the machines where the neighborhood changed.
+   * The mappers must not modify the graph. See
+   * warp::set_neighborhood_cache().
    */
   template <typename GraphType, typename MessageType = graphlab::empty>
   class warp_engine {
@@ -473,6 +486,9 @@ namespace warp {
     /// \internal \brief The type of the current engine instantiation
     typedef warp_engine engine_type;
 
+    /// \internal \brief The versions of the neighborhoods of the graph
+    typedef warp_impl::neighborhood_versions<graph_type> versions_type;
+
     
     /// The RPC interface
     dc_dist_object<warp_engine> rmi;
@@ -508,6 +524,12 @@ namespace warp {
     size_t stacksize;
     /// Number of fibers
     size_t nfibers;
+    /// engine option. Vary the number of fibers taking tasks
+    bool adaptive_fibers;
+    /// Lower limit on the number of fibers taking tasks if adaptive_fibers
+    size_t min_fibers;
+    /// Decides which fibers take tasks
+    fiber_population_control population;
     /// set to true if engine is started
     bool started;
     /// A pointer to the distributed consensus object
@@ -586,6 +608,8 @@ namespace warp {
       rmi.barrier();
 
       nfibers = 10000;
+      adaptive_fibers = false;
+      min_fibers = 100;
       stacksize = 16384;
       factorized_consistency = true;
       update_fn = NULL;
@@ -634,10 +658,24 @@ namespace warp {
           opts.get_engine_args().get_option("nfibers", nfibers);
           if (rmi.procid() == 0)
             logstream(LOG_EMPH) << "Engine Option: nfibers = " << nfibers << std::endl;
+        } else if (opt == "adaptive_fibers") {
+          opts.get_engine_args().get_option("adaptive_fibers", adaptive_fibers);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: adaptive_fibers = " << adaptive_fibers << std::endl;
+        } else if (opt == "min_fibers") {
+          opts.get_engine_args().get_option("min_fibers", min_fibers);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: min_fibers = " << min_fibers << std::endl;
         } else if (opt == "stacksize") {
           opts.get_engine_args().get_option("stacksize", stacksize);
           if (rmi.procid() == 0)
             logstream(LOG_EMPH) << "Engine Option: stacksize= " << stacksize << std::endl;
+        } else if (opt == "neighborhood_cache") {
+          bool neighborhood_cache = false;
+          opts.get_engine_args().get_option("neighborhood_cache", neighborhood_cache);
+          set_neighborhood_cache(neighborhood_cache);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: neighborhood_cache = " << neighborhood_cache << std::endl;
         } else {
           logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
         }
@@ -819,7 +857,7 @@ namespace warp {
         internal_signal(graph.vertex(gvid), message);
       } else {
         procid_t proc = graph.master(gvid);
-        rmi.remote_call(proc, &warp_engine::internal_signal,
+        rmi.remote_call(proc, &warp_engine::internal_signal_gvid,
                         gvid, message);
       }
     } 
@@ -972,11 +1010,8 @@ namespace warp {
       // and schedule all of them.
       std::vector<vertex_id_type> vtxs;
       vtxs.reserve(graph.num_local_own_vertices());
-      for(lvid_type lvid = 0;
-          lvid < graph.get_local_graph().num_vertices();
-          ++lvid) {
-        if (graph.l_vertex(lvid).owner() == rmi.procid() &&
-            vset.l_contains(lvid)) {
+      foreach(size_t lvid, vset.get_lvid_bitset(graph)) {
+        if (graph.l_vertex(lvid).owner() == rmi.procid()) {
           vtxs.push_back(lvid);
         }
       }
@@ -1121,10 +1156,12 @@ namespace warp {
                              vertex_data_type& vdata) {
       local_vertex_type lvtx(graph.l_vertex(graph.local_vid(vid)));
       lvtx.data() = vdata;
+      versions_type::get().touched(graph, lvtx.id());
     }
 
     void synchronize_one_vertex(vertex_type vtx) {
       local_vertex_type lvtx(vtx);
+      versions_type::get().touched(graph, lvtx.id());
       foreach(procid_t mirror, lvtx.mirrors()) {
         rmi.remote_call(mirror, &warp_engine::update_vertex_value, vtx.id(), vtx.data());
       }
@@ -1133,6 +1170,7 @@ namespace warp {
 
     void synchronize_one_vertex_wait(vertex_type vtx) {
       local_vertex_type lvtx(vtx);
+      versions_type::get().touched(graph, lvtx.id());
       std::vector<request_future<void> > futures;
       foreach(procid_t mirror, lvtx.mirrors()) {
         futures.push_back(object_fiber_remote_request(rmi, 
@@ -1205,12 +1243,26 @@ namespace warp {
     }
 
 
+    /**
+     * \internal
+     * Runs a task, recording its latency for the fiber population control
+     */
+    void run_sched_task(const lvid_type lvid,
+                        const message_type& msg) {
+      unsigned long long begin = population.task_begin();
+      eval_sched_task(lvid, msg);
+      population.task_end(begin);
+    }
+
+
     /**
      * \internal
      * Per thread main loop
      */
     void thread_start(size_t threadid) {
       bool has_sched_msg = false;
+      fiber_control::set_fiber_label("warp_engine::thread_start");
+      size_t park_generation = 0;
       std::vector<std::vector<lvid_type> > internal_lvid;
       lvid_type sched_lvid;
 
@@ -1241,23 +1293,38 @@ namespace warp {
           aggregator.tick_asynchronous_compute(wid, key);
         }
 
+        population.tick();
+        if (population.parked(threadid)) {
+          population.park(threadid, park_generation);
+          if (population.parked(threadid)) {
+            // woken up to take part in termination
+            if (try_to_quit(threadid, has_sched_msg, sched_lvid, msg)) break;
+            if (has_sched_msg) run_sched_task(sched_lvid, msg);
+            continue;
+          }
+        }
+
         sched_status::status_enum stat = get_next_sched_task(threadid, sched_lvid, msg);
 
 
         has_sched_msg = stat != sched_status::EMPTY;
         if (stat != sched_status::EMPTY) {
-          eval_sched_task(sched_lvid, msg);
+          run_sched_task(sched_lvid, msg);
           if (endgame_mode) rmi.dc().flush();
         }
-        else if (!try_to_quit(threadid, has_sched_msg, sched_lvid, msg)) {
-          /*
-           * We failed to obtain a task, try to quit
-           */
-          if (has_sched_msg) {
-            eval_sched_task(sched_lvid, msg);
+        else {
+          // parked fibers must join the termination attempt
+          population.wake_all();
+          if (!try_to_quit(threadid, has_sched_msg, sched_lvid, msg)) {
+            /*
+             * We failed to obtain a task, try to quit
+             */
+            if (has_sched_msg) {
+              run_sched_task(sched_lvid, msg);
+            }
+          } else { 
+            break; 
           }
-        } else { 
-          break; 
         }
         if (fiber_control::worker_has_priority_fibers_on_queue()) fiber_control::yield();
       }
@@ -1294,6 +1361,8 @@ namespace warp {
 
       started = true;
 
+      // the graph may have been modified since the last run
+      versions_type::get().reset(graph);
       rmi.barrier();
       size_t allocatedmem = memory_info::allocated_bytes();
       rmi.all_reduce(allocatedmem);
@@ -1316,11 +1385,24 @@ namespace warp {
       thrgroup.set_affinity(affinity);
       thrgroup.set_stacksize(stacksize);
 
+      population.init(adaptive_fibers ? min_fibers : nfibers, nfibers, ncpus);
+      if (population.is_adaptive()) {
+        logstream(LOG_INFO) << "Adaptive fibers: starting with "
+                            << population.num_active() << " of " << nfibers
+                            << " fibers" << std::endl;
+      }
+      fiber_profiler::set_phase("warp");
       for (size_t i = 0; i < nfibers ; ++i) {
         thrgroup.launch(boost::bind(&engine_type::thread_start, this, i));
       }
       thrgroup.join();
+      fiber_profiler::set_phase(NULL);
       aggregator.stop();
+      if (population.is_adaptive()) {
+        logstream(LOG_INFO) << "Adaptive fibers: finished with "
+                            << population.num_active() << " of " << nfibers
+                            << " fibers" << std::endl;
+      }
       // if termination reason was not changed, then it must be depletion
       if (termination_reason == execution_status::RUNNING) {
         termination_reason = execution_status::TASK_DEPLETION;
@@ -1341,6 +1423,15 @@ namespace warp {
       rmi.all_reduce(numadds);
       rmi.cout() << "Schedule Adds: " << numadds << std::endl;
 
+      if (versions_type::get().tracks(graph)) {
+        size_t cache_hits = versions_type::get().hits.value;
+        size_t cache_misses = versions_type::get().misses.value;
+        rmi.all_reduce(cache_hits);
+        rmi.all_reduce(cache_misses);
+        rmi.cout() << "Neighborhood Cache Hits: " << cache_hits 
+                   << " Misses: " << cache_misses << std::endl;
+      }
+
 
       ASSERT_TRUE(scheduler_ptr->empty());
       started = false;
@@ -29,6 +29,8 @@
 #include <graphlab/parallel/fiber_group.hpp>
 #include <graphlab/parallel/fiber_control.hpp>
 #include <graphlab/parallel/fiber_remote_request.hpp>
+#include <graphlab/engine/warp_request_batcher.hpp>
+#include <graphlab/engine/warp_neighborhood_cache.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/macros_def.hpp>
@@ -95,6 +97,8 @@ struct broadcast_neighborhood_impl {
         graph.get_lock_manager()[b].unlock();
       }
     } 
+    // the edges and neighbors may have been modified
+    neighborhood_versions<GraphType>::get().touched(graph, lvid, edge_direction);
   }
 
 
@@ -118,6 +122,75 @@ struct broadcast_neighborhood_impl {
         vid);
   }
 
+  /*
+   * A request of basic_local_broadcast_neighborhood_from_remote coalesced
+   * with other requests to the same machine by the request_batcher.
+   */
+  struct batch_entry {
+    std::pair<size_t, size_t> objid;
+    edge_dir_type edge_direction;
+    size_t broadcast_ptr;
+    vertex_id_type vid;
+    vertex_data_type vdata;
+    void save(oarchive& oarc) const {
+      oarc << objid << edge_direction << broadcast_ptr << vid << vdata;
+    }
+    void load(iarchive& iarc) {
+      iarc >> objid >> edge_direction >> broadcast_ptr >> vid >> vdata;
+    }
+  };
+
+  // broadcasts have no result, the reply only signals completion
+  typedef request_batcher<batch_entry, char> batcher_type;
+
+  static std::vector<char> 
+  basic_local_broadcast_entries_from_remote(const std::vector<batch_entry>& entries) {
+    for (size_t i = 0;i < entries.size(); ++i) {
+      vertex_data_type vdata = entries[i].vdata;
+      basic_local_broadcast_neighborhood_from_remote(entries[i].objid,
+                                                     entries[i].edge_direction,
+                                                     entries[i].broadcast_ptr,
+                                                     entries[i].vid,
+                                                     vdata);
+    }
+    return std::vector<char>(entries.size(), 0);
+  }
+
+  static batcher_type& get_batcher() {
+    static batcher_type batcher(basic_local_broadcast_entries_from_remote);
+    return batcher;
+  }
+
+  /*
+   * basic_broadcast_neighborhood through the request_batcher
+   */
+  static void batched_broadcast_neighborhood(context_type& context,
+                                             typename GraphType::vertex_type current,
+                                             const vertex_record& vrecord,
+                                             edge_dir_type edge_direction,
+                                             void(*broadcast_fn)(context_type& context, edge_type edge, vertex_type other)) {
+    batch_entry entry;
+    entry.objid = std::make_pair(context.engine.get_rpc_obj_id(), 
+                                 current.graph_ref.get_rpc_obj_id());
+    entry.edge_direction = edge_direction;
+    entry.broadcast_ptr = reinterpret_cast<size_t>(broadcast_fn);
+    entry.vid = current.id();
+    entry.vdata = current.data();
+    std::vector<typename batcher_type::ticket> tickets(vrecord.num_mirrors());
+    size_t ctr = 0;
+    foreach(procid_t proc, vrecord.mirrors()) {
+      get_batcher().issue(proc, entry, tickets[ctr]);
+      ++ctr;
+    }
+    basic_local_broadcast_neighborhood(context,
+                                       edge_direction, 
+                                       broadcast_fn, 
+                                       current.id());
+    for (size_t i = 0;i < tickets.size(); ++i) {
+      get_batcher().wait(tickets[i]);
+    }
+  }
+
   static void basic_broadcast_neighborhood(context_type& context,
                                            typename GraphType::vertex_type current,
                                               edge_dir_type edge_direction,
@@ -130,6 +203,13 @@ struct broadcast_neighborhood_impl {
 
     // make sure we are running on a master vertex
     ASSERT_EQ(vrecord.owner, distributed_control::get_instance_procid());
+
+    if (request_batch_latency() > 0 && vrecord.num_mirrors() > 0 && 
+        fiber_control::in_fiber()) {
+      batched_broadcast_neighborhood(context, current, vrecord, 
+                                     edge_direction, broadcast_fn);
+      return;
+    }
     
     // create num-mirrors worth of requests
     std::vector<request_future<void > > requests(vrecord.num_mirrors());
@@ -220,6 +300,8 @@ struct broadcast_neighborhood_impl2 {
         graph.get_lock_manager()[b].unlock();
       }
     } 
+    // the edges and neighbors may have been modified
+    neighborhood_versions<GraphType>::get().touched(graph, lvid, edge_direction);
   }
 
 
@@ -25,10 +25,16 @@
 #define GRAPHLAB_WARP_GRAPH_MAP_REDUCE_HPP
 
 #include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
 #include <graphlab/util/generics/conditional_combiner_wrapper.hpp>
 #include <graphlab/parallel/fiber_group.hpp>
 #include <graphlab/parallel/fiber_control.hpp>
 #include <graphlab/parallel/fiber_remote_request.hpp>
+#include <graphlab/engine/warp_request_batcher.hpp>
+#include <graphlab/engine/warp_neighborhood_cache.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/serialization/is_pod.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/macros_def.hpp>
@@ -53,7 +59,7 @@ void default_combiner(T& self, const T& other) {
  * takes an unused argument; merges self with other using operator +=. 
  */
 template <typename T, typename ExtraArgs>
-void extended_default_combiner(T& self, const T& other, const ExtraArgs& unused) {
+void extended_default_combiner(T& self, const T& other, const ExtraArgs unused) {
   self += other;
 }
 
@@ -134,6 +140,73 @@ struct map_reduce_neighborhood_impl {
         vid);
   }
 
+  /*
+   * A request of basic_local_mapper_from_remote coalesced with other
+   * requests to the same machine by the request_batcher.
+   */
+  struct batch_entry: public IS_POD_TYPE {
+    size_t objid;
+    edge_dir_type edge_direction;
+    size_t mapper_ptr;
+    size_t combiner_ptr;
+    vertex_id_type vid;
+  };
+
+  typedef request_batcher<batch_entry, conditional_combiner_wrapper<RetType> > 
+      batcher_type;
+
+  static std::vector<conditional_combiner_wrapper<RetType> > 
+  basic_local_mapper_entries_from_remote(const std::vector<batch_entry>& entries) {
+    std::vector<conditional_combiner_wrapper<RetType> > ret(entries.size());
+    for (size_t i = 0;i < entries.size(); ++i) {
+      ret[i] = basic_local_mapper_from_remote(entries[i].objid,
+                                              entries[i].edge_direction,
+                                              entries[i].mapper_ptr,
+                                              entries[i].combiner_ptr,
+                                              entries[i].vid);
+    }
+    return ret;
+  }
+
+  static batcher_type& get_batcher() {
+    static batcher_type batcher(basic_local_mapper_entries_from_remote);
+    return batcher;
+  }
+
+  /*
+   * basic_map_reduce_neighborhood through the request_batcher
+   */
+  static RetType batched_map_reduce_neighborhood(typename GraphType::vertex_type current,
+                                                 const vertex_record& vrecord,
+                                                 edge_dir_type edge_direction,
+                                                 RetType (*mapper)(edge_type edge,
+                                                                   vertex_type other),
+                                                 void (*combiner)(RetType& self, 
+                                                                  const RetType& other)) {
+    batch_entry entry;
+    entry.objid = current.graph_ref.get_rpc_obj_id();
+    entry.edge_direction = edge_direction;
+    entry.mapper_ptr = reinterpret_cast<size_t>(mapper);
+    entry.combiner_ptr = reinterpret_cast<size_t>(combiner);
+    entry.vid = current.id();
+    std::vector<typename batcher_type::ticket> tickets(vrecord.num_mirrors());
+    size_t ctr = 0;
+    foreach(procid_t proc, vrecord.mirrors()) {
+      get_batcher().issue(proc, entry, tickets[ctr]);
+      ++ctr;
+    }
+    conditional_combiner_wrapper<RetType> accum = basic_local_mapper(current.graph_ref, 
+                                                                     edge_direction, 
+                                                                     mapper, 
+                                                                     combiner,
+                                                                     current.id());
+    accum.set_combiner(combiner);
+    for (size_t i = 0;i < tickets.size(); ++i) {
+      accum += get_batcher().wait(tickets[i]);
+    }
+    return accum.value;
+  }
+
   static RetType basic_map_reduce_neighborhood(typename GraphType::vertex_type current,
                                                edge_dir_type edge_direction,
                                                RetType (*mapper)(edge_type edge,
@@ -148,6 +221,17 @@ struct map_reduce_neighborhood_impl {
 
     // make sure we are running on a master vertex
     ASSERT_EQ(vrecord.owner, distributed_control::get_instance_procid());
+
+    if (vrecord.num_mirrors() > 0 && versions_type::get().tracks(graph)) {
+      return cached_map_reduce_neighborhood(current, vrecord, edge_direction,
+                                            mapper, combiner);
+    }
+
+    if (request_batch_latency() > 0 && vrecord.num_mirrors() > 0 && 
+        fiber_control::in_fiber()) {
+      return batched_map_reduce_neighborhood(current, vrecord, edge_direction,
+                                              mapper, combiner);
+    }
     
     // create num-mirrors worth of requests
     std::vector<request_future<conditional_combiner_wrapper<RetType> > > requests(vrecord.num_mirrors());
@@ -178,6 +262,274 @@ struct map_reduce_neighborhood_impl {
     return accum.value;
   }
 
+/**************************************************************************/
+/*                                                                        */
+/*                Cached MapReduce Neighborhood Implementation            */
+/*                                                                        */
+/**************************************************************************/
+/*
+ * The master keeps the partial result of each mirror along with the
+ * version of the partial neighborhood it was computed at, and only
+ * requests the mirrors whose latest version it heard of is newer.
+ * See warp::set_neighborhood_cache().
+ */
+
+  typedef neighborhood_versions<GraphType> versions_type;
+
+  struct versioned_partial {
+    uint32_t version;
+    conditional_combiner_wrapper<RetType> partial;
+    void save(oarchive& oarc) const {
+      oarc << version << partial;
+    }
+    void load(iarchive& iarc) {
+      iarc >> version >> partial;
+    }
+  };
+
+  struct cache_key {
+    vertex_id_type vid;
+    procid_t proc;
+    edge_dir_type edge_direction;
+    size_t mapper_ptr;
+    size_t combiner_ptr;
+    bool operator==(const cache_key& other) const {
+      return vid == other.vid && proc == other.proc && 
+          edge_direction == other.edge_direction &&
+          mapper_ptr == other.mapper_ptr && combiner_ptr == other.combiner_ptr;
+    }
+  };
+
+  struct cache_key_hash {
+    size_t operator()(const cache_key& key) const {
+      size_t h = boost::hash<vertex_id_type>()(key.vid);
+      boost::hash_combine(h, key.proc);
+      boost::hash_combine(h, (size_t)key.edge_direction);
+      boost::hash_combine(h, key.mapper_ptr);
+      boost::hash_combine(h, key.combiner_ptr);
+      return h;
+    }
+  };
+
+  struct cache_entry {
+    uint32_t version;
+    conditional_combiner_wrapper<RetType> partial;
+  };
+
+  enum { NUM_CACHE_SHARDS = 64 };
+
+  // the cache is split by vertex so that fibers rarely contend 
+  struct cache_shard {
+    simple_spinlock lock;
+    // the epoch of the entries
+    size_t epoch;
+    boost::unordered_map<cache_key, cache_entry, cache_key_hash> entries;
+    cache_shard(): epoch(0) { }
+
+    // drops the entries of earlier epochs. The lock must be held.
+    void clear_stale() {
+      if (epoch != neighborhood_cache_epoch()) {
+        boost::unordered_map<cache_key, cache_entry, cache_key_hash>().swap(entries);
+        epoch = neighborhood_cache_epoch();
+      }
+    }
+  };
+
+  static cache_shard& get_cache_shard(vertex_id_type vid) {
+    static cache_shard shards[NUM_CACHE_SHARDS];
+    return shards[vid % NUM_CACHE_SHARDS];
+  }
+
+  /*
+   * Combines the cached partial result of key into accum if it was 
+   * computed at version known or later.
+   */
+  static bool cache_lookup(const cache_key& key, uint32_t known,
+                           conditional_combiner_wrapper<RetType>& accum) {
+    cache_shard& shard = get_cache_shard(key.vid);
+    bool found = false;
+    shard.lock.lock();
+    shard.clear_stale();
+    typename boost::unordered_map<cache_key, cache_entry, cache_key_hash>::const_iterator
+        iter = shard.entries.find(key);
+    if (iter != shard.entries.end() && 
+        (int32_t)(known - iter->second.version) <= 0) {
+      accum += iter->second.partial;
+      found = true;
+    }
+    shard.lock.unlock();
+    return found;
+  }
+
+  static void cache_store(const cache_key& key, const versioned_partial& remote) {
+    cache_shard& shard = get_cache_shard(key.vid);
+    shard.lock.lock();
+    shard.clear_stale();
+    cache_entry& entry = shard.entries[key];
+    entry.version = remote.version;
+    entry.partial = remote.partial;
+    shard.lock.unlock();
+  }
+
+  static versioned_partial versioned_local_mapper_from_remote(size_t objid,
+                                                              edge_dir_type edge_direction,
+                                                              size_t mapper_ptr,
+                                                              size_t combiner_ptr,
+                                                              vertex_id_type vid) {
+    GraphType& graph = 
+        *reinterpret_cast<GraphType*>(distributed_control::get_instance()->get_registered_object(objid));
+    versioned_partial ret;
+    // read the version first: a change while mapping leaves the result
+    // tagged with an older version, and it will be fetched again
+    ret.version = versions_type::get().local(graph.local_vid(vid));
+    ret.partial = basic_local_mapper_from_remote(objid, edge_direction, 
+                                                 mapper_ptr, combiner_ptr, vid);
+    return ret;
+  }
+
+  static RetType cached_map_reduce_neighborhood(typename GraphType::vertex_type current,
+                                                const vertex_record& vrecord,
+                                                edge_dir_type edge_direction,
+                                                RetType (*mapper)(edge_type edge,
+                                                                  vertex_type other),
+                                                void (*combiner)(RetType& self, 
+                                                                 const RetType& other)) {
+    GraphType& graph = current.graph_ref;
+    size_t objid = graph.get_rpc_obj_id();
+    versions_type& versions = versions_type::get();
+    cache_key key;
+    key.vid = current.id();
+    key.edge_direction = edge_direction;
+    key.mapper_ptr = reinterpret_cast<size_t>(mapper);
+    key.combiner_ptr = reinterpret_cast<size_t>(combiner);
+
+    // combine the valid cached results and request the others
+    conditional_combiner_wrapper<RetType> cached(combiner);
+    std::vector<procid_t> stale;
+    foreach(procid_t proc, vrecord.mirrors()) {
+      key.proc = proc;
+      if (!cache_lookup(key, versions.known(vrecord, current.local_id(), proc), 
+                        cached)) {
+        stale.push_back(proc);
+      }
+    }
+    versions.hits.inc(vrecord.num_mirrors() - stale.size());
+    versions.misses.inc(stale.size());
+    std::vector<request_future<versioned_partial> > requests(stale.size());
+    for (size_t i = 0;i < stale.size(); ++i) {
+      requests[i] = fiber_remote_request(stale[i], 
+                                         map_reduce_neighborhood_impl<RetType, GraphType>::versioned_local_mapper_from_remote,
+                                         objid,
+                                         edge_direction,
+                                         key.mapper_ptr,
+                                         key.combiner_ptr,
+                                         current.id());
+    }
+    // compute the local tasks
+    conditional_combiner_wrapper<RetType> accum = basic_local_mapper(graph, 
+                                                                     edge_direction, 
+                                                                     mapper, 
+                                                                     combiner,
+                                                                     current.id());
+    accum.set_combiner(combiner);
+    accum += cached;
+    for (size_t i = 0;i < requests.size(); ++i) {
+      versioned_partial remote = requests[i]();
+      key.proc = stale[i];
+      cache_store(key, remote);
+      accum += remote.partial;
+    }
+    return accum.value;
+  }
+
+  static std::vector<conditional_combiner_wrapper<RetType> > 
+  basic_local_mapper_batch_from_remote(size_t objid,
+                                       edge_dir_type edge_direction,
+                                       size_t mapper_ptr,
+                                       size_t combiner_ptr,
+                                       const std::vector<vertex_id_type>& vids) {
+    RetType (*mapper)(edge_type edge, vertex_type other) = 
+        reinterpret_cast<RetType(*)(edge_type, vertex_type)>(mapper_ptr);
+    void (*combiner)(RetType&, const RetType&) = 
+        reinterpret_cast<void (*)(RetType&, const RetType&)>(combiner_ptr);
+    GraphType& graph = 
+        *reinterpret_cast<GraphType*>(distributed_control::get_instance()->get_registered_object(objid));
+    std::vector<conditional_combiner_wrapper<RetType> > ret(vids.size());
+    for (size_t i = 0;i < vids.size(); ++i) {
+      ret[i] = basic_local_mapper(graph, edge_direction, mapper, combiner, vids[i]);
+    }
+    return ret;
+  }
+
+  /*
+   * Batched version of basic_map_reduce_neighborhood. The vertices are
+   * grouped by the machines holding their mirrors, and a single request
+   * is issued to each machine covering every vertex it mirrors. The local
+   * parts are computed while the requests are in flight, and the fiber
+   * suspends at most once per remote machine instead of once per vertex.
+   */
+  static void basic_map_reduce_neighborhood_batch(const std::vector<vertex_type>& vertices,
+                                                  edge_dir_type edge_direction,
+                                                  RetType (*mapper)(edge_type edge,
+                                                                    vertex_type other),
+                                                  void (*combiner)(RetType& self, 
+                                                                   const RetType& other),
+                                                  std::vector<RetType>& result) {
+    result.clear();
+    if (vertices.empty()) return;
+    GraphType& graph = vertices[0].graph_ref;
+    size_t objid = graph.get_rpc_obj_id();
+    procid_t procid = distributed_control::get_instance_procid();
+    size_t numprocs = distributed_control::get_instance()->numprocs();
+
+    // for each machine, the vertices it mirrors and their positions in 
+    // the batch
+    std::vector<std::vector<vertex_id_type> > proc_vids(numprocs);
+    std::vector<std::vector<size_t> > proc_positions(numprocs);
+    for (size_t i = 0;i < vertices.size(); ++i) {
+      const vertex_record& vrecord = graph.l_get_vertex_record(vertices[i].local_id());
+      // make sure we are running on a master vertex
+      ASSERT_EQ(vrecord.owner, procid);
+      foreach(procid_t proc, vrecord.mirrors()) {
+        proc_vids[proc].push_back(vertices[i].id());
+        proc_positions[proc].push_back(i);
+      }
+    }
+
+    // issue one request per machine
+    std::vector<request_future<std::vector<conditional_combiner_wrapper<RetType> > > > 
+        requests(numprocs);
+    for (procid_t proc = 0; proc < numprocs; ++proc) {
+      if (proc_vids[proc].empty()) continue;
+      requests[proc] = fiber_remote_request(proc,
+                                            map_reduce_neighborhood_impl<RetType, GraphType>::basic_local_mapper_batch_from_remote,
+                                            objid,
+                                            edge_direction,
+                                            reinterpret_cast<size_t>(mapper),
+                                            reinterpret_cast<size_t>(combiner),
+                                            proc_vids[proc]);
+    }
+    // compute the local tasks
+    std::vector<conditional_combiner_wrapper<RetType> > accum(vertices.size());
+    for (size_t i = 0;i < vertices.size(); ++i) {
+      accum[i] = basic_local_mapper(graph, edge_direction, mapper, combiner, vertices[i].id());
+      accum[i].set_combiner(combiner);
+    }
+    // now, wait for everyone
+    for (procid_t proc = 0; proc < numprocs; ++proc) {
+      if (proc_vids[proc].empty()) continue;
+      std::vector<conditional_combiner_wrapper<RetType> > remote = requests[proc]();
+      ASSERT_EQ(remote.size(), proc_positions[proc].size());
+      for (size_t j = 0;j < remote.size(); ++j) {
+        accum[proc_positions[proc][j]] += remote[j];
+      }
+    }
+    result.resize(vertices.size());
+    for (size_t i = 0;i < vertices.size(); ++i) {
+      result[i] = accum[i].value;
+    }
+  }
+
 };
 
 /**************************************************************************/
@@ -308,6 +660,94 @@ struct map_reduce_neighborhood_impl2 {
     return accum.value;
   }
 
+  static std::vector<conditional_combiner_wrapper<RetType> > 
+  extended_local_mapper_batch_from_remote(size_t objid,
+                                          edge_dir_type edge_direction,
+                                          size_t mapper_ptr,
+                                          size_t combiner_ptr,
+                                          const std::vector<vertex_id_type>& vids,
+                                          const ExtraArg extra) {
+    RetType (*mapper)(edge_type edge, vertex_type other, const ExtraArg) = 
+        reinterpret_cast<RetType(*)(edge_type, vertex_type, const ExtraArg)>(mapper_ptr);
+    void (*combiner)(RetType&, const RetType&, const ExtraArg) = 
+        reinterpret_cast<void (*)(RetType&, const RetType&, const ExtraArg)>(combiner_ptr);
+    GraphType& graph = 
+        *reinterpret_cast<GraphType*>(distributed_control::get_instance()->get_registered_object(objid));
+    std::vector<conditional_combiner_wrapper<RetType> > ret(vids.size());
+    for (size_t i = 0;i < vids.size(); ++i) {
+      ret[i] = extended_local_mapper(graph, edge_direction, mapper, combiner, vids[i], extra);
+    }
+    return ret;
+  }
+
+  /*
+   * Batched version of extended_map_reduce_neighborhood. 
+   * See map_reduce_neighborhood_impl::basic_map_reduce_neighborhood_batch.
+   */
+  static void extended_map_reduce_neighborhood_batch(const std::vector<vertex_type>& vertices,
+                                                     edge_dir_type edge_direction,
+                                                     const ExtraArg extra,
+                                                     RetType (*mapper)(edge_type edge,
+                                                                       vertex_type other,
+                                                                       const ExtraArg extra),
+                                                     void (*combiner)(RetType& self, 
+                                                                      const RetType& other,
+                                                                      const ExtraArg extra),
+                                                     std::vector<RetType>& result) {
+    result.clear();
+    if (vertices.empty()) return;
+    GraphType& graph = vertices[0].graph_ref;
+    size_t objid = graph.get_rpc_obj_id();
+    procid_t procid = distributed_control::get_instance_procid();
+    size_t numprocs = distributed_control::get_instance()->numprocs();
+
+    std::vector<std::vector<vertex_id_type> > proc_vids(numprocs);
+    std::vector<std::vector<size_t> > proc_positions(numprocs);
+    for (size_t i = 0;i < vertices.size(); ++i) {
+      const vertex_record& vrecord = graph.l_get_vertex_record(vertices[i].local_id());
+      // make sure we are running on a master vertex
+      ASSERT_EQ(vrecord.owner, procid);
+      foreach(procid_t proc, vrecord.mirrors()) {
+        proc_vids[proc].push_back(vertices[i].id());
+        proc_positions[proc].push_back(i);
+      }
+    }
+
+    std::vector<request_future<std::vector<conditional_combiner_wrapper<RetType> > > > 
+        requests(numprocs);
+    for (procid_t proc = 0; proc < numprocs; ++proc) {
+      if (proc_vids[proc].empty()) continue;
+      requests[proc] = fiber_remote_request(proc,
+                                            map_reduce_neighborhood_impl2::extended_local_mapper_batch_from_remote,
+                                            objid,
+                                            edge_direction,
+                                            reinterpret_cast<size_t>(mapper),
+                                            reinterpret_cast<size_t>(combiner),
+                                            proc_vids[proc],
+                                            extra);
+    }
+    // compute the local tasks
+    std::vector<conditional_combiner_wrapper<RetType> > accum(vertices.size());
+    for (size_t i = 0;i < vertices.size(); ++i) {
+      accum[i] = extended_local_mapper(graph, edge_direction, mapper, combiner, 
+                                       vertices[i].id(), extra);
+      accum[i].set_combiner(boost::bind(combiner, _1, _2, extra));
+    }
+    // now, wait for everyone
+    for (procid_t proc = 0; proc < numprocs; ++proc) {
+      if (proc_vids[proc].empty()) continue;
+      std::vector<conditional_combiner_wrapper<RetType> > remote = requests[proc]();
+      ASSERT_EQ(remote.size(), proc_positions[proc].size());
+      for (size_t j = 0;j < remote.size(); ++j) {
+        accum[proc_positions[proc][j]] += remote[j];
+      }
+    }
+    result.resize(vertices.size());
+    for (size_t i = 0;i < vertices.size(); ++i) {
+      result[i] = accum[i].value;
+    }
+  }
+
 };
 
 } // namespace warp::warp_impl
@@ -404,6 +844,65 @@ RetType map_reduce_neighborhood(VertexType current,
 
 
 
+/**
+ * \ingroup warp
+ *
+ * Batched overload of warp::map_reduce_neighborhood(). Performs the
+ * neighborhood map-reduce of every vertex in \c vertices, returning the
+ * results in the same order.
+ *
+ * Instead of issuing one round of remote requests per vertex and suspending
+ * the fiber until each of them completes, the vertices are grouped by the
+ * machines holding their mirrors and one request per machine is issued for
+ * the entire batch. The local parts of all the vertices are evaluated while
+ * the requests are in flight, and the calling fiber only resumes once all
+ * the remote results are in. This amortizes the messaging and context
+ * switching costs over the batch, and is most effective when combined with
+ * warp::parfor_all_vertex_batches().
+ *
+ * \code
+ * void pagerank_batch(std::vector<graph_type::vertex_type>& vertices) {
+ *   std::vector<float> sums = warp::map_reduce_neighborhood(vertices,
+ *                                                           IN_EDGES,
+ *                                                           pagerank_map);
+ *   for (size_t i = 0;i < vertices.size(); ++i) {
+ *     vertices[i].data() = 0.15 + 0.85 * sums[i];
+ *   }
+ * }
+ * \endcode
+ *
+ * All the vertices must be owned by the current machine and belong to the
+ * same graph.
+ *
+ * \param vertices The vertices to map reduce the neighborhoods over
+ * \param edge_direction To run over all IN_EDGES, OUT_EDGES or ALL_EDGES
+ * \param mapper The map function that will be executed. Must be a function pointer.
+ * \param combiner The combine function that will be executed. Must be a function pointer.
+ *                 Optional. Defaults to using "+=" on the output of the mapper
+ *
+ * \return The result of the neighborhood map reduce of each vertex.
+ *
+ * \see warp::parfor_all_vertex_batches()
+ */
+template <typename RetType, typename VertexType>
+std::vector<RetType> 
+map_reduce_neighborhood(const std::vector<VertexType>& vertices,
+                        edge_dir_type edge_direction,
+                        RetType (*mapper)(typename VertexType::graph_type::edge_type edge,
+                                          VertexType other),
+                        void (*combiner)(RetType& self, 
+                                         const RetType& other) = warp_impl::default_combiner<RetType>) {
+  std::vector<RetType> result;
+  warp_impl::
+      map_reduce_neighborhood_impl<RetType, 
+                                  typename VertexType::graph_type>::
+                                      basic_map_reduce_neighborhood_batch(vertices, edge_direction, 
+                                                                          mapper, combiner, result);
+  return result;
+}
+
+
+
 /**
  * \ingroup warp
  *
@@ -500,6 +999,51 @@ RetType map_reduce_neighborhood(VertexType current,
 
 
 
+/**
+ * \ingroup warp
+ *
+ * Batched overload of the extended warp::map_reduce_neighborhood() which
+ * passes an additional argument to the mapper and combiner. Performs
+ * the neighborhood map-reduce of every vertex in \c vertices using one
+ * remote request per mirroring machine, returning the results in the same
+ * order as the vertices.
+ *
+ * \param vertices The vertices to map reduce the neighborhoods over
+ * \param edge_direction To run over all IN_EDGES, OUT_EDGES or ALL_EDGES
+ * \param extra An additional argument to be passed to the mapper and combiner
+ * functions.  
+ * \param mapper The map function that will be executed. Must be a
+ * function pointer.
+ * \param combiner The combine function that will be executed. Must be a
+ * function pointer.  Optional. Defaults to using "+=" on the output of the
+ * mapper 
+ *
+ * \return The result of the neighborhood map reduce of each vertex.
+ *
+ * \see warp::parfor_all_vertex_batches()
+ */
+template <typename RetType, typename ExtraArg, typename VertexType>
+std::vector<RetType> 
+map_reduce_neighborhood(const std::vector<VertexType>& vertices,
+                        edge_dir_type edge_direction,
+                        const ExtraArg extra,
+                        RetType (*mapper)(typename VertexType::graph_type::edge_type edge,
+                                          VertexType other,
+                                          const ExtraArg extra),
+                        void (*combiner)(RetType& self, 
+                                         const RetType& other,
+                                         const ExtraArg extra) = warp_impl::extended_default_combiner<RetType, ExtraArg>) {
+  std::vector<RetType> result;
+  warp_impl::
+      map_reduce_neighborhood_impl2<RetType, typename VertexType::graph_type, ExtraArg>::
+                                      extended_map_reduce_neighborhood_batch(vertices, edge_direction, 
+                                                                             extra, mapper, combiner,
+                                                                             result);
+  return result;
+}
+
+
+
 
 } // namespace warp
 
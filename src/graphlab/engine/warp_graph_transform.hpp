@@ -29,6 +29,7 @@
 #include <graphlab/parallel/fiber_group.hpp>
 #include <graphlab/parallel/fiber_control.hpp>
 #include <graphlab/parallel/fiber_remote_request.hpp>
+#include <graphlab/engine/warp_neighborhood_cache.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/macros_def.hpp>
@@ -91,6 +92,8 @@ struct transform_neighborhood_impl {
         graph.get_lock_manager()[b].unlock();
       }
     } 
+    // the edges and neighbors may have been modified
+    neighborhood_versions<GraphType>::get().touched(graph, lvid, edge_direction);
   }
 
 
@@ -204,6 +207,8 @@ struct transform_neighborhood_impl2 {
         graph.get_lock_manager()[b].unlock();
       }
     } 
+    // the edges and neighbors may have been modified
+    neighborhood_versions<GraphType>::get().touched(graph, lvid, edge_direction);
   }
 
 
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_WARP_NEIGHBORHOOD_CACHE_HPP
+#define GRAPHLAB_WARP_NEIGHBORHOOD_CACHE_HPP
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+namespace warp {
+
+namespace warp_impl {
+
+/// Whether warp::map_reduce_neighborhood() caches remote partial results
+inline bool& neighborhood_cache_enabled() {
+  static bool enabled = false;
+  return enabled;
+}
+
+/// Incremented by every reset. Results cached in older epochs are stale.
+inline size_t& neighborhood_cache_epoch() {
+  static size_t epoch = 0;
+  return epoch;
+}
+
+/*
+ * The versions of the partial neighborhoods of the vertices of one graph.
+ *
+ * The partial neighborhood of a vertex on a machine is the part of its
+ * neighborhood made of the edges stored on that machine. Every machine
+ * keeps a version for the partial neighborhood of each of its replicas,
+ * which is bumped whenever the data of the replica or of one of its
+ * neighbors on the machine changes. The new versions of the mirrors are
+ * sent to their masters, batched into one message per master machine for
+ * every change. A master thus knows the latest version of the partial
+ * neighborhood of each of its mirrors, and a remote partial result
+ * computed at that version or later is still valid.
+ *
+ * The versions are tracked for one graph at a time: the last one passed
+ * to reset().
+ */
+template <typename GraphType>
+class neighborhood_versions {
+ public:
+  typedef typename GraphType::local_vertex_type local_vertex_type;
+  typedef typename GraphType::local_edge_type local_edge_type;
+  typedef typename GraphType::vertex_record vertex_record;
+  typedef std::pair<vertex_id_type, uint32_t> notice_type;
+
+  /// The number of remote partial results reused and fetched
+  atomic<size_t> hits, misses;
+
+  static neighborhood_versions& get() {
+    static neighborhood_versions versions;
+    return versions;
+  }
+
+  /// True if the versions of graph are tracked
+  bool tracks(const GraphType& graph) const {
+    return neighborhood_cache_enabled() && graph_ptr == &graph;
+  }
+
+  /**
+   * Starts tracking graph, invalidating every cached result. Must be
+   * called by all machines before a barrier, while no fiber reads or
+   * writes the graph. Does nothing if the cache is disabled.
+   */
+  void reset(GraphType& graph) {
+    if (!neighborhood_cache_enabled()) return;
+    const procid_t procid = distributed_control::get_instance_procid();
+    const size_t nlocal = graph.num_local_vertices();
+    graph_ptr = &graph;
+    local_version.assign(nlocal, 0);
+    // one slot per mirror of every master
+    mirror_offset.resize(nlocal + 1);
+    size_t nslots = 0;
+    for (lvid_type lvid = 0; lvid < nlocal; ++lvid) {
+      mirror_offset[lvid] = nslots;
+      const vertex_record& rec = graph.l_get_vertex_record(lvid);
+      if (rec.owner == procid) nslots += rec.num_mirrors();
+    }
+    mirror_offset[nlocal] = nslots;
+    known_version.assign(nslots, 0);
+    hits = 0;
+    misses = 0;
+    ++neighborhood_cache_epoch();
+  }
+
+  /// The current version of the partial neighborhood of lvid on this machine
+  uint32_t local(lvid_type lvid) const {
+    return local_version[lvid];
+  }
+
+  /**
+   * The latest version this machine has received of the partial
+   * neighborhood on machine proc of the master vertex lvid.
+   */
+  uint32_t known(const vertex_record& rec, lvid_type lvid, procid_t proc) const {
+    return known_version[slot(rec, lvid, proc)];
+  }
+
+  /**
+   * To be called on every machine holding a replica of lvid after the
+   * data of the replica or of its edges in direction edge_direction
+   * changed. Bumps the versions of lvid and its neighbors in that
+   * direction and notifies their masters.
+   */
+  void touched(GraphType& graph, lvid_type lvid,
+               edge_dir_type edge_direction = ALL_EDGES) {
+    if (!tracks(graph)) return;
+    std::vector<std::vector<notice_type> >
+        notices(distributed_control::get_instance()->numprocs());
+    local_vertex_type lvtx(graph.l_vertex(lvid));
+    bump(graph, lvid, notices);
+    if(edge_direction == IN_EDGES || edge_direction == ALL_EDGES) {
+      foreach(local_edge_type local_edge, lvtx.in_edges()) {
+        bump(graph, local_edge.source().id(), notices);
+      }
+    }
+    if(edge_direction == OUT_EDGES || edge_direction == ALL_EDGES) {
+      foreach(local_edge_type local_edge, lvtx.out_edges()) {
+        bump(graph, local_edge.target().id(), notices);
+      }
+    }
+    const procid_t procid = distributed_control::get_instance_procid();
+    for (procid_t proc = 0; proc < notices.size(); ++proc) {
+      if (notices[proc].empty()) continue;
+      distributed_control::get_instance()->remote_call(proc,
+                                                       neighborhood_versions::receive_notices,
+                                                       procid,
+                                                       notices[proc]);
+    }
+  }
+
+ private:
+  const GraphType* graph_ptr;
+  std::vector<uint32_t> local_version;
+  // the slots of the mirrors of master lvid start at mirror_offset[lvid]
+  std::vector<size_t> mirror_offset;
+  std::vector<uint32_t> known_version;
+
+  neighborhood_versions(): graph_ptr(NULL) { }
+
+  size_t slot(const vertex_record& rec, lvid_type lvid, procid_t proc) const {
+    size_t s = mirror_offset[lvid];
+    foreach(procid_t mirror, rec.mirrors()) {
+      if (mirror == proc) break;
+      ++s;
+    }
+    ASSERT_LT(s, mirror_offset[lvid + 1]);
+    return s;
+  }
+
+  void bump(const GraphType& graph, lvid_type lvid,
+            std::vector<std::vector<notice_type> >& notices) {
+    const uint32_t version = __sync_add_and_fetch(&local_version[lvid], 1);
+    const vertex_record& rec = graph.l_get_vertex_record(lvid);
+    if (rec.owner != distributed_control::get_instance_procid()) {
+      notices[rec.owner].push_back(notice_type(rec.gvid, version));
+    }
+  }
+
+  static void receive_notices(procid_t proc,
+                              const std::vector<notice_type>& notices) {
+    neighborhood_versions& versions = get();
+    if (versions.graph_ptr == NULL) return;
+    const GraphType& graph = *versions.graph_ptr;
+    foreach(const notice_type& notice, notices) {
+      const lvid_type lvid = graph.local_vid(notice.first);
+      uint32_t& known =
+          versions.known_version[versions.slot(graph.l_get_vertex_record(lvid),
+                                               lvid, proc)];
+      // notices may be received out of order. Keep the latest.
+      uint32_t old = known;
+      while ((int32_t)(notice.second - old) > 0 &&
+             !atomic_compare_and_swap(known, old, notice.second)) {
+        old = known;
+      }
+    }
+  }
+};
+
+} // namespace warp_impl
+
+
+/**
+ * \ingroup warp
+ *
+ * Enables the caching of the remote partial results of
+ * warp::map_reduce_neighborhood().
+ *
+ * A neighborhood map-reduce normally asks every machine holding a mirror
+ * of the vertex to map its edges there, even if none of the data involved
+ * changed since the last call. With the cache, the master remembers the
+ * partial result of each mirror along with its version, and only asks the
+ * machines whose partial neighborhood changed since. The versions are
+ * bumped when the warp_engine synchronizes a vertex, and by
+ * warp::transform_neighborhood() and warp::broadcast_neighborhood(). The
+ * cache is reset by warp::parfor_all_vertices() and by every start of the
+ * warp_engine, so changes made to the graph in between are picked up. It
+ * is most effective with the warp_engine, which only synchronizes the
+ * vertices whose data changed, whereas warp::parfor_all_vertices()
+ * synchronizes all of them once it completes.
+ *
+ * The cache applies to the overloads of warp::map_reduce_neighborhood()
+ * on a single vertex without an extra argument, which must then not
+ * modify the graph in their mappers. The new versions reach the masters
+ * asynchronously, as the vertex data reaches the mirrors, hence a map-reduce
+ * running concurrently with a change may still use the previous partial
+ * result.
+ *
+ * Disabled by default. Must be set identically on all machines, and must
+ * not be changed while fibers issue requests.
+ */
+inline void set_neighborhood_cache(bool enabled) {
+  warp_impl::neighborhood_cache_enabled() = enabled;
+}
+
+} // namespace warp
+} // namespace graphlab
+#include <graphlab/macros_undef.hpp>
+#endif
@@ -23,10 +23,13 @@
 
 #ifndef GRAPHLAB_WARP_PARFOR_ALL_VERTICES_HPP
 #define GRAPHLAB_WARP_PARFOR_ALL_VERTICES_HPP
+#include <vector>
+#include <algorithm>
 #include <boost/function.hpp>
 #include <graphlab/parallel/fiber_group.hpp>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/graph/vertex_set.hpp>
+#include <graphlab/engine/warp_neighborhood_cache.hpp>
 #include <graphlab/rpc/dc.hpp>
 namespace graphlab {
 namespace warp {
@@ -34,36 +37,114 @@ namespace warp {
 namespace warp_impl {
 
 
+/// The largest number of vertices a fiber of parfor_all_vertices claims at once
+const size_t PARFOR_MAX_CHUNK_SIZE = 64;
+
 /*
  * Actual Parfor implementation.
  * Holds a reference to all the arguments.
- * Each fiber increments the atomic counter and runs the fn on it)
+ * Each fiber claims a chunk of consecutive entries of lvids by
+ * incrementing the atomic counter, and runs the fn on each of them.
  */
 template <typename GraphType>
 struct parfor_all_vertices_impl{
 
   GraphType& graph; 
   boost::function<void(typename GraphType::vertex_type)> fn;
-  vertex_set& vset;
+  const std::vector<lvid_type>& lvids;
+  size_t chunk_size;
   atomic<size_t> ctr;
 
   parfor_all_vertices_impl(GraphType& graph,
                            boost::function<void(typename GraphType::vertex_type)> fn,
-                           vertex_set& vset): graph(graph),fn(fn),vset(vset),ctr(0) { }
+                           const std::vector<lvid_type>& lvids,
+                           size_t chunk_size): 
+      graph(graph),fn(fn),lvids(lvids),chunk_size(chunk_size),ctr(0) { }
 
   void run_fiber() {
     while (1) {
-      size_t lvid = ctr.inc_ret_last();
-      if (lvid >= graph.num_local_vertices() || !vset.l_contains(lvid)) break;
-      typename GraphType::local_vertex_type l_vertex = graph.l_vertex(lvid);
-      if (l_vertex.owned()) {
-        typename GraphType::vertex_type vertex(l_vertex);
+      size_t begin = ctr.inc_ret_last(chunk_size);
+      if (begin >= lvids.size()) break;
+      size_t end = std::min(begin + chunk_size, lvids.size());
+      for (size_t i = begin; i < end; ++i) {
+        typename GraphType::vertex_type vertex(graph.l_vertex(lvids[i]));
         fn(vertex);
       }
     } 
   }
 };
 
+
+/*
+ * Runs fn on the owned vertices of vset which have no mirrors, using
+ * ordinary threads, and returns the other owned vertices of vset in
+ * increasing lvid order. The neighborhood of a vertex without mirrors
+ * is entirely local, so its fn never has to wait for another machine.
+ */
+template <typename GraphType, typename FunctionType>
+std::vector<lvid_type> run_local_vertices(GraphType& graph,
+                                          FunctionType& fn,
+                                          const vertex_set& vset) {
+  const size_t nverts = graph.num_local_vertices();
+  std::vector<lvid_type> remote;
+  for (size_t lvid = 0; lvid < nverts; ++lvid) {
+    if (!vset.l_contains(lvid)) continue;
+    typename GraphType::local_vertex_type l_vertex = graph.l_vertex(lvid);
+    if (l_vertex.owned() && l_vertex.num_mirrors() > 0) remote.push_back(lvid);
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, PARFOR_MAX_CHUNK_SIZE)
+#endif
+  for (size_t lvid = 0; lvid < nverts; ++lvid) {
+    if (!vset.l_contains(lvid)) continue;
+    typename GraphType::local_vertex_type l_vertex = graph.l_vertex(lvid);
+    if (l_vertex.owned() && l_vertex.num_mirrors() == 0) {
+      typename GraphType::vertex_type vertex(l_vertex);
+      fn(vertex);
+    }
+  }
+  return remote;
+}
+
+
+/*
+ * Batched Parfor implementation.
+ * Each fiber claims a block of batch_size local vertex IDs at a time, and
+ * runs the fn on all the owned vertices in the block which are in the set.
+ */
+template <typename GraphType>
+struct parfor_all_vertex_batches_impl{
+
+  GraphType& graph; 
+  boost::function<void(std::vector<typename GraphType::vertex_type>&)> fn;
+  vertex_set& vset;
+  size_t batch_size;
+  atomic<size_t> ctr;
+
+  parfor_all_vertex_batches_impl(GraphType& graph,
+                                 boost::function<void(std::vector<typename GraphType::vertex_type>&)> fn,
+                                 vertex_set& vset,
+                                 size_t batch_size): 
+      graph(graph),fn(fn),vset(vset),batch_size(batch_size),ctr(0) { }
+
+  void run_fiber() {
+    std::vector<typename GraphType::vertex_type> batch;
+    batch.reserve(batch_size);
+    while (1) {
+      size_t begin = ctr.inc_ret_last(batch_size);
+      if (begin >= graph.num_local_vertices()) break;
+      size_t end = std::min(begin + batch_size, (size_t)graph.num_local_vertices());
+      batch.clear();
+      for (size_t lvid = begin; lvid < end; ++lvid) {
+        if (!vset.l_contains(lvid)) continue;
+        typename GraphType::local_vertex_type l_vertex = graph.l_vertex(lvid);
+        if (l_vertex.owned()) batch.push_back(typename GraphType::vertex_type(l_vertex));
+      }
+      if (!batch.empty()) fn(batch);
+    } 
+  }
+};
+
 } // namespace warp_impl
 
 
@@ -93,10 +174,17 @@ struct parfor_all_vertices_impl{
  * parfor_all_vertices(graph, pagerank); 
  * \endcode
  *
+ * Vertices without mirrors have their whole neighborhood on this machine
+ * and are run first by ordinary threads, without the fiber machinery.
+ * The remaining vertices are run by the fibers, each of which handles
+ * chunks of up to 64 consecutive vertices, so that the fibers also sweep
+ * the local graph in order. Only as many fibers as there are such
+ * chunks are launched, up to \c nfibers.
+ *
  * \param graph A reference to the graph object
  * \param fn A function to run on each vertex. Has the prototype void(GraphType::vertex_type). Can be a boost::function
  * \param vset A set of vertices to run on
- * \param nfibers Number of fiber threads to use. Defaults to 10000
+ * \param nfibers Maximum number of fiber threads to use. Defaults to 10000
  * \param stacksize Size of each fiber stack in bytes. Defaults to 16384 bytes
  *
  * \see graphlab::warp::map_reduce_neighborhood()
@@ -108,11 +196,24 @@ void parfor_all_vertices(GraphType& graph,
                          vertex_set vset = GraphType::complete_set(),
                          size_t nfibers = 10000,
                          size_t stacksize = 16384) {
+  ASSERT_GT(nfibers, 0);
+  // the graph may have been modified since the last parfor
+  warp_impl::neighborhood_versions<GraphType>::get().reset(graph);
   distributed_control::get_instance()->barrier();
   bool old_fast_track = distributed_control::get_instance()->set_fast_track_requests(false);
+  std::vector<lvid_type> remote_lvids = 
+      warp_impl::run_local_vertices(graph, fn, vset);
+  // small chunks when there are few vertices, so that the fibers still
+  // have enough requests in flight to hide the latency
+  const size_t chunk_size = 
+      std::max<size_t>(1, std::min(warp_impl::PARFOR_MAX_CHUNK_SIZE,
+                                   remote_lvids.size() / nfibers));
+  nfibers = std::min(nfibers, 
+                     (remote_lvids.size() + chunk_size - 1) / chunk_size);
   fiber_group group;
   group.set_stacksize(stacksize);
-  warp_impl::parfor_all_vertices_impl<GraphType> parfor(graph, fn, vset);
+  warp_impl::parfor_all_vertices_impl<GraphType> parfor(graph, fn, 
+                                                        remote_lvids, chunk_size);
   
   for (size_t i = 0;i < nfibers; ++i) {
     group.launch(boost::bind(&warp_impl::parfor_all_vertices_impl<GraphType>::run_fiber, &parfor));
@@ -123,6 +224,69 @@ void parfor_all_vertices(GraphType& graph,
   graph.synchronize(vset);
 }
 
+
+/**
+ * \ingroup warp
+ *
+ * A batched version of warp::parfor_all_vertices(). Each fiber is handed
+ * a batch of up to \c batch_size vertices at once, allowing the user
+ * function to use the batched overloads of warp::map_reduce_neighborhood()
+ * to gather the neighborhoods of the entire batch with a single round of
+ * remote requests, instead of suspending once for every vertex.
+ *
+ * \code
+ * void pagerank_batch(std::vector<graph_type::vertex_type>& vertices) {
+ *   std::vector<float> sums = warp::map_reduce_neighborhood(vertices,
+ *                                                           IN_EDGES,
+ *                                                           pagerank_map);
+ *   for (size_t i = 0;i < vertices.size(); ++i) {
+ *     vertices[i].data() = 0.15 + 0.85 * sums[i];
+ *   }
+ * }
+ *
+ * ...
+ * parfor_all_vertex_batches(graph, pagerank_batch, 64); 
+ * \endcode
+ *
+ * Since every fiber holds a whole batch, far fewer fibers are needed than
+ * with warp::parfor_all_vertices() to hide the same amount of latency.
+ *
+ * \param graph A reference to the graph object
+ * \param fn A function to run on each batch of vertices. Has the prototype 
+ *           void(std::vector<GraphType::vertex_type>&). Can be a boost::function
+ * \param batch_size The maximum number of vertices in a batch. Defaults to 64
+ * \param vset A set of vertices to run on
+ * \param nfibers Number of fiber threads to use. Defaults to 1000
+ * \param stacksize Size of each fiber stack in bytes. Defaults to 16384 bytes
+ *
+ * \see graphlab::warp::parfor_all_vertices()
+ * \see graphlab::warp::map_reduce_neighborhood()
+ */
+template <typename GraphType, typename FunctionType>
+void parfor_all_vertex_batches(GraphType& graph,
+                               FunctionType fn,
+                               size_t batch_size = 64,
+                               vertex_set vset = GraphType::complete_set(),
+                               size_t nfibers = 1000,
+                               size_t stacksize = 16384) {
+  ASSERT_GT(batch_size, 0);
+  // the graph may have been modified since the last parfor
+  warp_impl::neighborhood_versions<GraphType>::get().reset(graph);
+  distributed_control::get_instance()->barrier();
+  bool old_fast_track = distributed_control::get_instance()->set_fast_track_requests(false);
+  fiber_group group;
+  group.set_stacksize(stacksize);
+  warp_impl::parfor_all_vertex_batches_impl<GraphType> parfor(graph, fn, vset, batch_size);
+  
+  for (size_t i = 0;i < nfibers; ++i) {
+    group.launch(boost::bind(&warp_impl::parfor_all_vertex_batches_impl<GraphType>::run_fiber, &parfor));
+  }
+  group.join();
+  distributed_control::get_instance()->barrier();
+  distributed_control::get_instance()->set_fast_track_requests(old_fast_track);
+  graph.synchronize(vset);
+}
+
 } // namespace warp
 } // namespace graphlab
 #endif
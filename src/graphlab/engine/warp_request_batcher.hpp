@@ -0,0 +1,236 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_WARP_REQUEST_BATCHER_HPP
+#define GRAPHLAB_WARP_REQUEST_BATCHER_HPP
+
+#include <vector>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/parallel/fiber_remote_request.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/rpc/dc.hpp>
+namespace graphlab {
+namespace warp {
+
+namespace warp_impl {
+
+/// The micro-batch latency in microseconds. 0 disables batching.
+inline size_t& request_batch_latency() {
+  static size_t latency = 0;
+  return latency;
+}
+
+/// The number of requests after which a batch is sent immediately
+inline size_t& request_max_batch_size() {
+  static size_t max_batch_size = 256;
+  return max_batch_size;
+}
+
+/*
+ * Coalesces the requests issued by all the fibers of this machine to
+ * the same machine within a short time window into a single remote call.
+ * 
+ * Each Entry describes one request. remote_fn is a function taking a
+ * const std::vector<Entry>& and returning a std::vector<Result> with one
+ * result per entry. The fiber which opens a batch for a machine (the
+ * leader) sends it once the micro-batch latency has elapsed, unless the
+ * batch fills up earlier, in which case the fiber adding the last entry
+ * sends it. The fiber sending a batch waits for the reply and hands each
+ * result to the fiber which issued the request.
+ *
+ * Outside of fibers, or when batching is disabled, every request is sent
+ * on its own.
+ */
+template <typename Entry, typename Result>
+class request_batcher {
+ public:
+  typedef std::vector<Result> (*remote_fn_type)(const std::vector<Entry>&);
+
+  /*
+   * Holds the state of one request until its result is available.
+   */
+  struct ticket {
+    mutex lock;
+    conditional cond;
+    // if wait is in a fiber, the ID of the fiber to wake up
+    size_t waiting_tid;
+    bool ready;
+    Result value;
+    procid_t proc;
+    // the batch this ticket opened, if it is the leader, or 0
+    size_t leader_of;
+    // the future of an unbatched request, or NULL
+    request_future<std::vector<Result> >* unbatched;
+    ticket(): waiting_tid(0), ready(false), proc(0), leader_of(0), 
+              unbatched(NULL) { }
+
+    void set(const Result& result) {
+      lock.lock();
+      value = result;
+      ready = true;
+      if (waiting_tid) fiber_control::schedule_tid(waiting_tid);
+      else cond.signal();
+      lock.unlock();
+    }
+
+    void wait_ready() {
+      lock.lock();
+      if (fiber_control::in_fiber()) {
+        waiting_tid = fiber_control::get_tid();
+        while(!ready) {
+          fiber_control::deschedule_self(&lock.m_mut);
+          lock.lock();
+        }
+      } else {
+        while(!ready) cond.wait(lock);
+      }
+      lock.unlock();
+    }
+  };
+
+  request_batcher(remote_fn_type remote_fn): 
+      remote_fn(remote_fn), 
+      peers(distributed_control::get_instance()->numprocs()) { }
+
+  /// Issues the request e to machine proc. Complete it with wait().
+  void issue(procid_t proc, const Entry& e, ticket& t) {
+    t.proc = proc;
+    if (request_batch_latency() == 0 || !fiber_control::in_fiber()) {
+      t.unbatched = new request_future<std::vector<Result> >(
+          fiber_remote_request(proc, remote_fn, std::vector<Entry>(1, e)));
+      return;
+    }
+    peer& p = peers[proc];
+    batch* to_send = NULL;
+    p.lock.lock();
+    if (p.pending == NULL) {
+      p.pending = new batch;
+      p.pending->deadline = timer::usec_of_day() + request_batch_latency();
+      t.leader_of = ++p.generation;
+    }
+    p.pending->entries.push_back(e);
+    p.pending->tickets.push_back(&t);
+    if (p.pending->entries.size() >= request_max_batch_size()) {
+      to_send = p.pending;
+      p.pending = NULL;
+    }
+    p.lock.unlock();
+    if (to_send) send(proc, to_send);
+  }
+
+  /// Waits for the result of a request issued with issue()
+  Result wait(ticket& t) {
+    if (t.unbatched != NULL) {
+      std::vector<Result> results = (*t.unbatched)();
+      delete t.unbatched;
+      t.unbatched = NULL;
+      ASSERT_EQ(results.size(), 1);
+      return results[0];
+    }
+    if (t.leader_of) {
+      peer& p = peers[t.proc];
+      batch* to_send = NULL;
+      while(to_send == NULL) {
+        p.lock.lock();
+        if (p.generation != t.leader_of || p.pending == NULL) {
+          // the batch filled up and was sent by another fiber
+          p.lock.unlock();
+          break;
+        } else if (timer::usec_of_day() >= p.pending->deadline) {
+          to_send = p.pending;
+          p.pending = NULL;
+        }
+        p.lock.unlock();
+        // let the other fibers add to the batch
+        if (to_send == NULL) fiber_control::yield();
+      }
+      if (to_send) send(t.proc, to_send);
+    }
+    t.wait_ready();
+    return t.value;
+  }
+
+ private:
+  struct batch {
+    std::vector<Entry> entries;
+    std::vector<ticket*> tickets;
+    size_t deadline;
+  };
+
+  struct peer {
+    mutex lock;
+    batch* pending;
+    size_t generation;
+    peer(): pending(NULL), generation(0) { }
+  };
+
+  remote_fn_type remote_fn;
+  std::vector<peer> peers;
+
+  void send(procid_t proc, batch* b) {
+    std::vector<Result> results = 
+        fiber_remote_request(proc, remote_fn, b->entries)();
+    ASSERT_EQ(results.size(), b->tickets.size());
+    for (size_t i = 0;i < results.size(); ++i) {
+      b->tickets[i]->set(results[i]);
+    }
+    delete b;
+  }
+};
+
+} // namespace warp_impl
+
+
+/**
+ * \ingroup warp
+ *
+ * Enables the coalescing of the remote requests of 
+ * warp::map_reduce_neighborhood() and warp::broadcast_neighborhood().
+ *
+ * When enabled, the requests issued by the fibers of this machine to the
+ * same remote machine within \c latency_usec microseconds are sent as a
+ * single message, and answered with a single reply, instead of one
+ * message per mirror per call. A batch is sent early once it holds
+ * \c max_batch_size requests. This trades a small amount of latency per
+ * request for far fewer messages when many fibers gather neighborhoods
+ * concurrently, as in warp::parfor_all_vertices().
+ *
+ * Batching is disabled by default. Setting \c latency_usec to 0 disables
+ * it. Must not be changed while fibers issue requests.
+ *
+ * \param latency_usec The longest time in microseconds a request waits for
+ *                     other requests to the same machine
+ * \param max_batch_size The largest number of requests in a batch
+ */
+inline void set_request_batching(size_t latency_usec, 
+                                 size_t max_batch_size = 256) {
+  ASSERT_GT(max_batch_size, 0);
+  warp_impl::request_batch_latency() = latency_usec;
+  warp_impl::request_max_batch_size() = max_batch_size;
+}
+
+} // namespace warp
+} // namespace graphlab
+#endif
@@ -25,6 +25,7 @@
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 
 #if defined(__cplusplus) && __cplusplus >= 201103L
 // do not include spirit
@@ -179,6 +180,108 @@ namespace graphlab {
     } // end of adj parser
 #endif
 
+    /**
+     * \internal
+     * Reads an unsigned decimal integer from [ptr, end), skipping any
+     * leading whitespace and commas, and advances ptr past it. Returns
+     * false if no digits were found.
+     */
+    template <typename T>
+    inline bool parse_uint(const char*& ptr, const char* end, T& val) {
+      while (ptr != end && (*ptr == ' ' || *ptr == '\t' ||
+                            *ptr == '\r' || *ptr == ',')) ++ptr;
+      if (ptr == end || *ptr < '0' || *ptr > '9') return false;
+      T ret = 0;
+      while (ptr != end && *ptr >= '0' && *ptr <= '9') {
+        ret = ret * 10 + (*ptr - '0');
+        ++ptr;
+      }
+      val = ret;
+      return true;
+    }
+
+    /// Returns true if [ptr, end) holds only whitespace
+    inline bool is_blank(const char* ptr, const char* end) {
+      while (ptr != end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r')) ++ptr;
+      return ptr == end;
+    }
+
+    /**
+     * \brief Span parser version of \ref snap_parser. Lines are
+     * handed over in place as [begin, end) without the newline.
+     */
+    template <typename Graph>
+    bool snap_span_parser(Graph& graph, const std::string& srcfilename,
+                          const char* begin, const char* end) {
+      if (is_blank(begin, end)) return true;
+      else if (*begin == '#') {
+        std::cout << std::string(begin, end) << std::endl;
+        return true;
+      }
+      vertex_id_type source, target;
+      if (!parse_uint(begin, end, source) || !parse_uint(begin, end, target)) {
+        return false;
+      }
+      if(source != target) graph.add_edge(source, target);
+      return true;
+    } // end of snap span parser
+
+    /// \brief Span parser version of \ref tsv_parser.
+    template <typename Graph>
+    bool tsv_span_parser(Graph& graph, const std::string& srcfilename,
+                         const char* begin, const char* end) {
+      if (is_blank(begin, end)) return true;
+      vertex_id_type source, target;
+      if (!parse_uint(begin, end, source) || !parse_uint(begin, end, target)) {
+        return false;
+      }
+      if(source != target) graph.add_edge(source, target);
+      return true;
+    } // end of tsv span parser
+
+    /// \brief Span parser version of \ref csv_parser.
+    template <typename Graph>
+    bool csv_span_parser(Graph& graph, const std::string& srcfilename,
+                         const char* begin, const char* end) {
+      if (memchr(begin, ',', end - begin) == NULL) return true;
+      vertex_id_type source, target;
+      if (!parse_uint(begin, end, source) || !parse_uint(begin, end, target)) {
+        return false;
+      }
+      graph.add_edge(source, target);
+      return true;
+    } // end of csv span parser
+
+    /// \brief Span parser version of \ref adj_parser.
+    template <typename Graph>
+    bool adj_span_parser(Graph& graph, const std::string& srcfilename,
+                         const char* begin, const char* end) {
+      if (is_blank(begin, end)) return true;
+      vertex_id_type source;
+      size_t n;
+      if (!parse_uint(begin, end, source)) return false;
+      if (!parse_uint(begin, end, n)) return true;
+      size_t nadded = 0;
+      vertex_id_type target;
+      while (parse_uint(begin, end, target)) {
+        if (source != target) graph.add_edge(source, target);
+        ++nadded;
+      }
+      return n == nadded;
+    } // end of adj span parser
+
+    /// Appends the decimal representation of val to out
+    template <typename T>
+    inline void append_uint(std::string& out, T val) {
+      char digits[24];
+      size_t n = 0;
+      do {
+        digits[n++] = char('0' + val % 10);
+        val /= 10;
+      } while (val != 0);
+      while (n > 0) out += digits[--n];
+    }
+
     template <typename Graph>
     struct tsv_writer{
       typedef typename Graph::vertex_type vertex_type;
@@ -187,6 +290,14 @@ namespace graphlab {
       std::string save_edge(edge_type e) {
         return tostr(e.source().id()) + "\t" + tostr(e.target().id()) + "\n";
       }
+      // the buffered interface used by distributed_graph::save_buffered()
+      void save_vertex(vertex_type, std::string&) { }
+      void save_edge(edge_type e, std::string& out) {
+        append_uint(out, e.source().id());
+        out += '\t';
+        append_uint(out, e.target().id());
+        out += '\n';
+      }
     };
 
 
@@ -28,6 +28,7 @@
 #endif
 
 #include <cmath>
+#include <unistd.h>
 
 #include <string>
 #include <list>
@@ -50,6 +51,7 @@
 #include <boost/iostreams/filtering_streambuf.hpp>
 
 #include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/filesystem.hpp>
@@ -76,22 +78,37 @@
 #include <graphlab/graph/graph_gather_apply.hpp>
 #include <graphlab/graph/ingress/distributed_ingress_base.hpp>
 #include <graphlab/graph/ingress/distributed_oblivious_ingress.hpp>
+#include <graphlab/graph/ingress/distributed_hdrf_ingress.hpp>
 #include <graphlab/graph/ingress/distributed_random_ingress.hpp>
 #include <graphlab/graph/ingress/distributed_identity_ingress.hpp>
+#include <graphlab/graph/ingress/distributed_source_ingress.hpp>
 
 #include <graphlab/graph/ingress/sharding_constraint.hpp>
 #include <graphlab/graph/ingress/distributed_constrained_random_ingress.hpp>
 
 #include <graphlab/graph/graph_hash.hpp>
+#include <graphlab/graph/synthetic_graph_generators.hpp>
+#include <graphlab/graph/vertex_order.hpp>
+#include <graphlab/graph/graph_snapshot.hpp>
+#include <graphlab/graph/graph_columns.hpp>
+#include <graphlab/graph/partition_report.hpp>
 
 #include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/util/frozen_hash_map.hpp>
+#include <graphlab/util/memory_accounting.hpp>
+#include <graphlab/parallel/numa_topology.hpp>
+#include <graphlab/util/huge_pages.hpp>
+#include <graphlab/util/file_backed_memory.hpp>
+#include <graphlab/parallel/task_runtime.hpp>
 
 #include <graphlab/util/fs_util.hpp>
+#include <graphlab/util/bgzf.hpp>
 #include <graphlab/util/hdfs.hpp>
 
 
 #include <graphlab/graph/builtin_parsers.hpp>
 #include <graphlab/graph/vertex_set.hpp>
+#include <graphlab/graph/shared_vertex_index.hpp>
 
 #include <graphlab/macros_def.hpp>
 namespace tests {
@@ -189,6 +206,23 @@ namespace graphlab {
    *                    read. Improves partitioning quality and will reduce
    *                    runtime memory consumption.
    *
+   * \li \c "hdrf" Runs at roughly the speed of oblivious. Like
+   *                 oblivious, but also tracks the partial degree of
+   *                 every vertex and prefers to replicate high degree
+   *                 vertices. Gives much lower replication on power law
+   *                 graphs.
+   *
+   * \li \c "precomputed" Loads a graph already partitioned into one
+   *                 shard per machine, such as the binedge files written by
+   *                 the precompute_partitions tool. Shard [prefix]_k_of_N
+   *                 is loaded by machine k-1 and its edges stay there, so
+   *                 edges are never exchanged. Requires N machines.
+   *
+   * \li \c "source" Runs at the speed of random. Places every edge on
+   *                 the machine given by the hash of its source, so the
+   *                 out edges of a vertex are never split. Used by the
+   *                 stratified SGD of the collaborative filtering toolkits.
+   *
    * \li \c "grid" Runs at rouphly the same speed of random. Randomly places
    *                edges on machines with a grid constraint.
    *                This obtains quality partition, close to oblivious,
@@ -375,6 +409,13 @@ namespace graphlab {
     typedef boost::function<bool(distributed_graph&, const std::string&,
                                  const std::string&)> line_parser_type;
 
+    /**
+     * \brief The type of a parser which receives each line as a
+     * character range. See load_buffered().
+     */
+    typedef boost::function<bool(distributed_graph&, const std::string&,
+                                 const char*, const char*)> span_parser_type;
+
 
     typedef fixed_dense_bitset<RPC_MAX_N_PROCS> mirror_type;
 
@@ -399,6 +440,7 @@ namespace graphlab {
     // Make friends with Ingress classes
     friend class distributed_random_ingress<VertexData, EdgeData>;
     friend class distributed_identity_ingress<VertexData, EdgeData>;
+    friend class distributed_source_ingress<VertexData, EdgeData>;
     friend class distributed_oblivious_ingress<VertexData, EdgeData>;
     friend class distributed_constrained_random_ingress<VertexData, EdgeData>;
 
@@ -406,6 +448,20 @@ namespace graphlab {
     typedef graphlab::lvid_type lvid_type;
     typedef graphlab::edge_id_type edge_id_type;
 
+    /**
+     * \brief The types returned by data() on the vertices and edges.
+     * These are plain references unless the data is stored as a
+     * structure of arrays (see GRAPHLAB_SOA_TRAITS).
+     */
+    typedef typename local_graph_type::vertex_data_reference
+        vertex_data_reference;
+    typedef typename local_graph_type::vertex_data_const_reference
+        vertex_data_const_reference;
+    typedef typename local_graph_type::edge_data_reference
+        edge_data_reference;
+    typedef typename local_graph_type::edge_data_const_reference
+        edge_data_const_reference;
+
     struct vertex_type;
     typedef bool edge_list_type;
     class edge_type;
@@ -413,6 +469,7 @@ namespace graphlab {
     struct local_vertex_type;
     struct local_edge_list_type;
     class local_edge_type;
+    struct local_edge_span_type;
 
     /**
      * \brief Vertex object which provides access to the vertex data
@@ -447,12 +504,12 @@ namespace graphlab {
       }
 
       /// \brief Returns a constant reference to the data on the vertex
-      const vertex_data_type& data() const {
+      vertex_data_const_reference data() const {
         return graph_ref.get_local_graph().vertex_data(lvid);
       }
 
       /// \brief Returns a mutable reference to the data on the vertex
-      vertex_data_type& data() {
+      vertex_data_reference data() {
         return graph_ref.get_local_graph().vertex_data(lvid);
       }
 
@@ -567,16 +624,76 @@ namespace graphlab {
       /**
        * \brief Returns a constant reference to the data on the edge
        */
-      const edge_data_type& data() const { return edge.data(); }
+      edge_data_const_reference data() const { return edge.data(); }
 
       /**
        * \brief Returns a mutable reference to the data on the edge
        */
-      edge_data_type& data() { return edge.data(); }
+      edge_data_reference data() { return edge.data(); }
 
     }; // end of edge_type
 
 
+    /**
+     * \brief A flat view of a local edge used by map_reduce_csr_edges(),
+     * transform_csr_edges() and map_csr_edges().
+     *
+     * Unlike edge_type, the view points directly into the local vertex
+     * and edge data arrays. The global ids of the endpoints are only
+     * looked up when asked for. A csr_edge_type must not outlive the
+     * call it was passed to.
+     */
+    class csr_edge_type {
+    private:
+      const distributed_graph* graph_ptr;
+      lvid_type src, dst;
+      edge_id_type eid;
+      const vertex_data_type* src_data;
+      const vertex_data_type* dst_data;
+      edge_data_type* edata;
+
+      csr_edge_type(const distributed_graph* graph_ptr,
+                    lvid_type src, lvid_type dst, edge_id_type eid,
+                    const vertex_data_type* src_data,
+                    const vertex_data_type* dst_data,
+                    edge_data_type* edata) :
+        graph_ptr(graph_ptr), src(src), dst(dst), eid(eid),
+        src_data(src_data), dst_data(dst_data), edata(edata) { }
+      friend class distributed_graph;
+    public:
+      /// \brief Returns the global id of the source vertex
+      vertex_id_type source_id() const {
+        return graph_ptr->lvid2record[src].gvid;
+      }
+
+      /// \brief Returns the global id of the target vertex
+      vertex_id_type target_id() const {
+        return graph_ptr->lvid2record[dst].gvid;
+      }
+
+      /// \brief Returns the local id of the source vertex
+      lvid_type l_source() const { return src; }
+
+      /// \brief Returns the local id of the target vertex
+      lvid_type l_target() const { return dst; }
+
+      /// \brief Returns the local id of the edge. See map_csr_edges().
+      edge_id_type l_id() const { return eid; }
+
+      /// \brief Returns the data on the source vertex
+      const vertex_data_type& source_data() const { return *src_data; }
+
+      /// \brief Returns the data on the target vertex
+      const vertex_data_type& target_data() const { return *dst_data; }
+
+      /// \brief Returns a constant reference to the data on the edge
+      const edge_data_type& data() const { return *edata; }
+
+      /// \brief Returns a mutable reference to the data on the edge
+      edge_data_type& data() { return *edata; }
+    }; // end of csr_edge_type
+
+
 
 
 
@@ -588,7 +705,7 @@ namespace graphlab {
      *
      * Value graph options are:
      * \li \c ingress The graph partitioning method to use. May be "random"
-     *                "grid" or "pds". The methods have roughly the same runtime 
+     *                "oblivious", "hdrf", "source", "grid", "pds" or "precomputed". The methods have roughly the same runtime 
      *                complexity, but the increasing partition qaulity. "grid" 
      *                requires number of machine P be able to layout as a n*m = P 
      *                grid with ( |m-n| <= 2). "pds" uses requires P = p^2+p+1 where 
@@ -599,10 +716,89 @@ namespace graphlab {
      *                when there are a large number of machines) at a small
      *                partitioning penalty. Defaults to 0. Set to 1 to
      *                enable.
+     * \li \c hdrf_lambda The weight of the load balance term of the
+     *                hdrf ingress relative to its replication term.
+     *                Defaults to 1.
      * \li \c bufsize The batch size used by the batch ingress method.
      *                Defaults to 50,000. Increasing this number will
      *                decrease partitioning time with a penalty to partitioning
      *                quality.
+     * \li \c low_memory_finalize If set to 1, the local graph is finalized
+     *                with in place permutations which never duplicate an
+     *                edge array. Finalization is slower. Defaults to 0.
+     * \li \c compact_adjacency If set to 1, the dynamic local graph
+     *                (USE_DYNAMIC_LOCAL_GRAPH) also keeps a contiguous copy
+     *                of its adjacency after every finalize, which speeds
+     *                up the edge loops at the cost of memory. Has no
+     *                effect on the static local graph. Defaults to 0.
+     * \li \c load_chunk_mb Uncompressed files and BGZF files (gzip files
+     *                written by bgzip) larger than this many megabytes are
+     *                split into byte ranges which are loaded in parallel
+     *                by all machines and threads. Defaults to 64.
+     * \li \c vertex_order Relabels the local vertices when the graph is
+     *                first finalized to improve memory locality. May be
+     *                "none", "degree" (decreasing degree) or "rcm"
+     *                (reverse Cuthill-McKee). Defaults to "none". On a
+     *                single machine, "none" numbers the local vertices
+     *                by global id when the global ids are 0 to
+     *                num_vertices() - 1, so that the lookups of local
+     *                ids become the identity.
+     * \li \c ingress_memory_mb Once the edges received by a machine
+     *                during ingress take more than this many megabytes,
+     *                they are sorted and spilled to local disk, and the
+     *                spilled runs are merged at finalize. Defaults to 0,
+     *                which never spills.
+     * \li \c spill_dir The local directory for spilled edges. Defaults
+     *                to "/tmp".
+     * \li \c dedup_edges If set to 1, finalize() drops the edges whose
+     *                (source, target) pair was already received by the
+     *                same machine, keeping the first. The number of
+     *                dropped edges is logged and included in the partition
+     *                report. Defaults to 0.
+     * \li \c edge_sample_rate Keeps each input edge with this
+     *                probability, chosen by a hash of its unordered pair
+     *                of vertices, for approximate analytics at a fraction
+     *                of the memory and time. The rate is recorded in the
+     *                partition report (see get_edge_sample_rate()).
+     *                Defaults to 1, which keeps every edge.
+     * \li \c edge_sample_seed Selects which edges edge_sample_rate
+     *                keeps. Defaults to 0.
+     * \li \c incremental_ingress If set to 1, the oblivious and hdrf
+     *                ingress keep their vertex placement tables after
+     *                finalize() so that edges added later with
+     *                load_incremental() are placed next to the existing
+     *                replicas. Requires the dynamic local graph. Defaults
+     *                to 0.
+     * \li \c huge_pages If "transparent", finalize() asks the kernel
+     *                to back the local graph arrays and the vertex
+     *                records with transparent huge pages, reducing the
+     *                TLB misses of random neighbor accesses. The bytes
+     *                on huge pages are logged with the memory usage and
+     *                reported by the metrics server. Defaults to "none".
+     * \li \c out_of_core_dir If set, finalize() moves the edge data and
+     *                the adjacency of the local graph to a file in this
+     *                directory, which should be on an SSD, while the
+     *                vertex data stays in RAM. The kernel pages the edges
+     *                in as the engines stream over them and drops them
+     *                under memory pressure, so machines can hold
+     *                partitions with more edges than fit in RAM. The
+     *                graph is still built in RAM, so ingress should also
+     *                spill (see ingress_memory_mb). Defaults to empty.
+     * \li \c master_selection How finalize() picks the master of a
+     *                vertex among its replicas. "hash" uses the hash of
+     *                the vertex id. "balanced" lets the machine given by
+     *                the hash move the master of the vertices it
+     *                negotiates to the replica which evens out the number
+     *                of masters, their degrees (the apply cost) and their
+     *                mirrors (the synchronization bytes) over the
+     *                machines. Signals to vertices with no local replica
+     *                then take one extra hop through the hash machine.
+     *                Nothing may be added to the graph after the first
+     *                finalize(). Defaults to "hash".
+     * \li \c partition_report If set, machine 0 writes the JSON
+     *                partition quality report of every finalize to this
+     *                file. The report is always logged and served by the
+     *                metrics server as partition_report.json.
      *
      * \param [in] dc Distributed controller to associate with
      * \param [in] opts A graphlab::graphlab_options object specifying engine
@@ -611,7 +807,7 @@ namespace graphlab {
      */
     distributed_graph(distributed_control& dc,
                       const graphlab_options& opts = graphlab_options()) :
-      rpc(dc, this), finalized(false), vid2lvid(),
+      rpc(dc, this), finalized(false), vid2lvid(), identity_vid2lvid(false),
       nverts(0), nedges(0), local_own_nverts(0), nreplicas(0),
       ingress_ptr(NULL), 
 #ifdef _OPENMP
@@ -619,24 +815,73 @@ namespace graphlab {
 #else
       vertex_exchange(dc), 
 #endif
-      vset_exchange(dc), parallel_ingress(true) {
+      vset_exchange(dc), shared_set_exchange(dc), parallel_ingress(true),
+      load_chunk_size(64 * 1024 * 1024), precomputed_ingress(false),
+      vertex_order("none"), numa_memory("none"), huge_pages_mode("none"),
+      ingress_memory_budget(0), spill_dir("/tmp"),
+      incremental_ingress(false), dedup_edges(false), edge_sample_rate(1),
+      edge_sample_seed(0), master_selection("hash"), balanced_masters(false),
+      masters_moved(false) {
+      if (dc.numprocs() > RPC_MAX_N_PROCS) {
+        logstream(LOG_FATAL) << "distributed_graph supports at most "
+                             << RPC_MAX_N_PROCS << " processes. Rebuild with "
+                             << "-DRPC_MAX_N_PROCS=" << dc.numprocs()
+                             << " or more." << std::endl;
+      }
       rpc.barrier();
       set_options(opts);
+      memory_source_id = memory_accounting::add_source(
+          memory_accounting::GRAPH,
+          boost::bind(&distributed_graph::estimate_sizeof, this));
     }
 
     ~distributed_graph() {
+      out_of_core_memory.move_to_memory(false);
+      memory_accounting::remove_source(memory_source_id);
       delete ingress_ptr; ingress_ptr = NULL;
     }
 
+    /**
+     * \internal
+     * \brief Returns the estimated memory footprint of the local part of
+     * the graph: the local graph, the vertex records and the vertex id
+     * map.
+     */
+    size_t estimate_sizeof() const {
+      return local_graph.estimate_sizeof() +
+          lvid2record.capacity() * sizeof(vertex_record) +
+          lvid2owner.capacity() * sizeof(procid_t) +
+          vid2lvid.capacity() *
+          sizeof(typename hopscotch_map_type::value_type) +
+          frozen_vid2lvid.estimate_sizeof();
+    }
+
 
     lock_manager_type& get_lock_manager() {
       return lock_manager;
     }
+
+    /** \internal
+     * \brief Returns the index of the local vertices shared with each
+     * other machine. Empty until the graph is finalized.
+     */
+    const shared_vertex_index& get_shared_vertex_index() const {
+      return shared_index;
+    }
+
+    /** \internal
+     * \brief The exchange used to synchronize vertex sets over the 
+     * shared vertex index
+     */
+    buffered_exchange<shared_set_message>& get_shared_set_exchange() {
+      return shared_set_exchange;
+    }
   private:
     void set_options(const graphlab_options& opts) {
       size_t bufsize = 50000;
       bool usehash = false;
       bool userecent = false;
+      double hdrf_lambda = 1.0;
       std::string ingress_method = "";
       std::vector<std::string> keys = opts.get_graph_args().get_option_keys();
       foreach(std::string opt, keys) {
@@ -650,6 +895,137 @@ namespace graphlab {
           if (!parallel_ingress && rpc.procid() == 0)
             logstream(LOG_EMPH) << "Disable parallel ingress. Graph will be streamed through one node."
               << std::endl;
+        } else if (opt == "load_chunk_mb") {
+          size_t load_chunk_mb = 64;
+          opts.get_graph_args().get_option("load_chunk_mb", load_chunk_mb);
+          if (load_chunk_mb == 0) {
+            logstream(LOG_FATAL) << "load_chunk_mb must be positive" << std::endl;
+          }
+          load_chunk_size = load_chunk_mb * 1024 * 1024;
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: load_chunk_mb = "
+              << load_chunk_mb << std::endl;
+        } else if (opt == "vertex_order") {
+          opts.get_graph_args().get_option("vertex_order", vertex_order);
+          if (vertex_order != "none" && vertex_order != "degree" &&
+              vertex_order != "rcm") {
+            logstream(LOG_FATAL) << "Unknown vertex_order: " << vertex_order
+                                 << std::endl;
+          }
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: vertex_order = "
+              << vertex_order << std::endl;
+        } else if (opt == "numa_memory") {
+          opts.get_graph_args().get_option("numa_memory", numa_memory);
+          if (numa_memory != "none" && numa_memory != "interleave" &&
+              numa_memory != "local") {
+            logstream(LOG_FATAL) << "Unknown numa_memory: " << numa_memory
+                                 << std::endl;
+          }
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: numa_memory = "
+              << numa_memory << std::endl;
+        } else if (opt == "huge_pages") {
+          opts.get_graph_args().get_option("huge_pages", huge_pages_mode);
+          if (huge_pages_mode != "none" && huge_pages_mode != "transparent") {
+            logstream(LOG_FATAL) << "Unknown huge_pages: " << huge_pages_mode
+                                 << std::endl;
+          }
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: huge_pages = "
+              << huge_pages_mode << std::endl;
+        } else if (opt == "hdrf_lambda") {
+          opts.get_graph_args().get_option("hdrf_lambda", hdrf_lambda);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: hdrf_lambda = "
+              << hdrf_lambda << std::endl;
+        } else if (opt == "ingress_memory_mb") {
+          size_t ingress_memory_mb = 0;
+          opts.get_graph_args().get_option("ingress_memory_mb", ingress_memory_mb);
+          ingress_memory_budget = ingress_memory_mb * 1024 * 1024;
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: ingress_memory_mb = "
+              << ingress_memory_mb << std::endl;
+        } else if (opt == "exchange_latency_ms") {
+          size_t latency = DEFAULT_EXCHANGE_TARGET_LATENCY_MS;
+          opts.get_graph_args().get_option("exchange_latency_ms", latency);
+          exchange_flush_policy::global().target_latency_ms = latency;
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: exchange_latency_ms = "
+              << latency << std::endl;
+        } else if (opt == "exchange_min_buffer_kb") {
+          size_t min_buffer_kb = DEFAULT_EXCHANGE_MIN_BUFFER_SIZE / 1024;
+          opts.get_graph_args().get_option("exchange_min_buffer_kb", min_buffer_kb);
+          exchange_flush_policy::global().min_buffer_size = min_buffer_kb * 1024;
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: exchange_min_buffer_kb = "
+              << min_buffer_kb << std::endl;
+        } else if (opt == "spill_dir") {
+          opts.get_graph_args().get_option("spill_dir", spill_dir);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: spill_dir = "
+              << spill_dir << std::endl;
+        } else if (opt == "out_of_core_dir") {
+          opts.get_graph_args().get_option("out_of_core_dir", out_of_core_dir);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: out_of_core_dir = "
+              << out_of_core_dir << std::endl;
+        } else if (opt == "dedup_edges") {
+          opts.get_graph_args().get_option("dedup_edges", dedup_edges);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: dedup_edges = "
+              << dedup_edges << std::endl;
+        } else if (opt == "edge_sample_rate") {
+          opts.get_graph_args().get_option("edge_sample_rate",
+                                           edge_sample_rate);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: edge_sample_rate = "
+              << edge_sample_rate << std::endl;
+        } else if (opt == "edge_sample_seed") {
+          opts.get_graph_args().get_option("edge_sample_seed",
+                                           edge_sample_seed);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: edge_sample_seed = "
+              << edge_sample_seed << std::endl;
+        } else if (opt == "incremental_ingress") {
+          opts.get_graph_args().get_option("incremental_ingress",
+                                           incremental_ingress);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: incremental_ingress = "
+              << incremental_ingress << std::endl;
+        } else if (opt == "master_selection") {
+          opts.get_graph_args().get_option("master_selection",
+                                           master_selection);
+          if (master_selection != "hash" && master_selection != "balanced") {
+            logstream(LOG_FATAL) << "Unknown master_selection "
+                                 << master_selection << std::endl;
+          }
+          balanced_masters = (master_selection == "balanced");
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: master_selection = "
+              << master_selection << std::endl;
+        } else if (opt == "partition_report") {
+          opts.get_graph_args().get_option("partition_report",
+                                           partition_report_file);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: partition_report = "
+              << partition_report_file << std::endl;
+        } else if (opt == "low_memory_finalize") {
+          bool low_memory_finalize = false;
+          opts.get_graph_args().get_option("low_memory_finalize",
+                                           low_memory_finalize);
+          local_graph.set_low_memory_finalize(low_memory_finalize);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: low_memory_finalize = "
+              << low_memory_finalize << std::endl;
+        } else if (opt == "compact_adjacency") {
+          bool compact_adjacency = false;
+          opts.get_graph_args().get_option("compact_adjacency",
+                                           compact_adjacency);
+          local_graph.set_compact_adjacency(compact_adjacency);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: compact_adjacency = "
+              << compact_adjacency << std::endl;
         }
         /**
          * These options below are deprecated.
@@ -673,7 +1049,8 @@ namespace graphlab {
           logstream(LOG_ERROR) << "Unexpected Graph Option: " << opt << std::endl;
         }
     }
-      set_ingress_method(ingress_method, bufsize, usehash, userecent);
+      set_ingress_method(ingress_method, bufsize, usehash, userecent,
+                         hdrf_lambda);
     }
 
   public:
@@ -684,6 +1061,15 @@ namespace graphlab {
     bool is_dynamic() const {
       return local_graph.is_dynamic();
     }
+
+    /**
+     * \internal
+     * Returns true if the ingress should keep its placement state
+     * across finalize() for incremental loading.
+     */
+    bool keeps_ingress_state() const {
+      return incremental_ingress && is_dynamic();
+    }
     
     /**
      * \brief Commits the graph structure. Once a graph is finalized it may
@@ -693,6 +1079,10 @@ namespace graphlab {
      * ownship and completing local data structures. Once a graph is finalized
      * its structure may not be modified. Repeated calls to finalize() do
      * nothing.
+     *
+     * With the dynamic local graph, edges and vertices may be added
+     * after finalize(), and the next finalize() only merges them in.
+     * See load_incremental().
      */
     void finalize() {
 #ifndef USE_DYNAMIC_LOCAL_GRAPH
@@ -700,8 +1090,30 @@ namespace graphlab {
 #endif
       ASSERT_NE(ingress_ptr, NULL);
       logstream(LOG_INFO) << "Distributed graph: enter finalize" << std::endl;
+      // the local vertices may only be relabelled before anything
+      // refers to their lvids
+      const bool first_finalize = (num_local_vertices() == 0);
+      if (masters_moved && !first_finalize) {
+        logstream(LOG_FATAL) << "A graph whose masters were moved cannot "
+                             << "be finalized again" << std::endl;
+      }
+      // vertex sets fall back to exchanging gvids until the index is rebuilt
+      shared_index.clear();
+      // ingress adds vertices to vid2lvid
+      frozen_vid2lvid.clear();
+      identity_vid2lvid = false;
+      // ingress reallocates the edge arrays
+      out_of_core_memory.move_to_memory(true);
       ingress_ptr->finalize();
+      update_masters_moved();
+      if (first_finalize && vertex_order != "none") reorder_local_vertices();
+      else if (first_finalize && rpc.numprocs() == 1) number_vertices_by_gvid();
+      if (numa_memory != "none") place_local_memory();
+      if (!out_of_core_dir.empty()) move_edges_out_of_core();
+      if (huge_pages_mode != "none") advise_huge_pages();
       lock_manager.resize(num_local_vertices());
+      build_frozen_vid2lvid();
+      build_shared_vertex_index();
       rpc.barrier(); 
 
       finalized = true;
@@ -712,6 +1124,71 @@ namespace graphlab {
       return finalized;
     }
 
+    /**
+     * \brief Restricts the edges seen by the engines and by the edge
+     * operations to those with a time stamp in [begin, end).
+     *
+     * The edge data must declare a time stamp with
+     * GRAPHLAB_EDGE_TIMESTAMP, and the graph use the static local
+     * graph. The in and out edges of every vertex are kept sorted by
+     * time, so each window is a pair of binary searches per adjacency
+     * list and the graph is not copied. This makes it possible to run
+     * an engine over a sliding window:
+     * \code
+     * for (double t = t0; t < t1; t += step) {
+     *   graph.set_edge_time_window(t, t + width);
+     *   engine.signal_all();
+     *   engine.start();
+     * }
+     * \endcode
+     * The vertex degrees still count all the edges. Must be called on
+     * all machines with the same window, between engine runs.
+     */
+    void set_edge_time_window(edge_time_type begin, edge_time_type end) {
+      local_graph.set_edge_time_window(begin, end);
+    }
+
+    /// \brief Removes the time window set by set_edge_time_window()
+    void clear_edge_time_window() {
+      local_graph.clear_edge_time_window();
+    }
+
+    /**
+     * \brief Adds the edges and vertices of the files matching path,
+     * in the given format, to an already finalized graph and finalizes
+     * it again. Must be called on all machines simultaneously and
+     * requires the dynamic local graph (USE_DYNAMIC_LOCAL_GRAPH).
+     *
+     * The new edges go through the ingress method of the graph. With
+     * the incremental_ingress graph option, the oblivious and hdrf
+     * methods still know where the existing vertices are replicated. Only the new edges are merged
+     * into the local graphs, and only the new and the touched vertices
+     * are negotiated and synchronized. Existing vertices keep their
+     * local ids and their data, and the engines pick up the new
+     * vertices on their next start(), so a computation can resume
+     * without reloading the graph.
+     *
+     * load_format() or add_edge() followed by finalize() do the same;
+     * this function reports the growth of the graph.
+     */
+    void load_incremental(const std::string& path, const std::string& format) {
+      if (!is_dynamic()) {
+        logstream(LOG_FATAL)
+          << "\n\tIncremental loading requires GraphLab to be built with"
+          << "\n\tthe dynamic local graph (USE_DYNAMIC_LOCAL_GRAPH)."
+          << std::endl;
+      }
+      const size_t old_nverts = num_vertices(), old_nedges = num_edges();
+      load_format(path, format);
+      finalize();
+      if (rpc.procid() == 0) {
+        logstream(LOG_EMPH) << "Incremental load added "
+                            << num_vertices() - old_nverts << " vertices and "
+                            << num_edges() - old_nedges << " edges"
+                            << std::endl;
+      }
+    } // end of load incremental
+
     /** \brief Get the number of vertices */
     size_t num_vertices() const { return nverts; }
 
@@ -847,6 +1324,7 @@ namespace graphlab {
      *
      * Returns true on success. Returns false if it is a self-edge, or if
      * we are trying to create a vertex with ID (vertex_id_type)(-1).
+     * An edge dropped by the edge_sample_rate option counts as a success.
      */
     bool add_edge(vertex_id_type source, vertex_id_type target,
                   const EdgeData& edata = EdgeData()) {
@@ -887,11 +1365,59 @@ namespace graphlab {
         return false;
       }
       ASSERT_NE(ingress_ptr, NULL);
+      if (!ingress_ptr->sample_edge(source, target)) return true;
 
       ingress_ptr->add_edge(source, target, edata);
+      ingress_ptr->spill_if_needed();
       return true;
     }
 
+    /**
+     * \brief Adds n edges in one call.
+     *
+     * Edge i connects source[i] to target[i] and carries edata[i], or
+     * EdgeData() if edata is NULL. The whole block is handed to the
+     * ingress object at once, which is considerably cheaper than n
+     * calls to add_edge(). Edges which add_edge() would reject are
+     * skipped with the same error messages.
+     *
+     * Returns the number of edges added.
+     */
+    size_t add_edge_block(const vertex_id_type* source,
+                          const vertex_id_type* target,
+                          const EdgeData* edata, size_t n) {
+      bool all_valid = true;
+      for (size_t i = 0; i < n && all_valid; ++i) {
+        all_valid = source[i] != vertex_id_type(-1) &&
+                    target[i] != vertex_id_type(-1) && source[i] != target[i];
+      }
+      // let add_edge() report the bad edges and sample the edges
+      if (!all_valid || edge_sample_rate < 1) {
+        size_t nadded = 0;
+        for (size_t i = 0; i < n; ++i) {
+          nadded += add_edge(source[i], target[i],
+                             edata == NULL ? EdgeData() : edata[i]);
+        }
+        return nadded;
+      }
+#ifndef USE_DYNAMIC_LOCAL_GRAPH
+      if(finalized) {
+        logstream(LOG_FATAL)
+          << "\n\tAttempting to add an edge to a finalized graph."
+          << "\n\tEdges cannot be added to a graph after finalization."
+          << std::endl;
+      }
+#else
+      finalized = false;
+#endif
+      ASSERT_NE(ingress_ptr, NULL);
+      if (n > 0) {
+        ingress_ptr->add_edge_block(source, target, edata, n);
+        ingress_ptr->spill_if_needed();
+      }
+      return n;
+    }
+
 
    /**
     * \brief Performs a map-reduce operation on each vertex in the
@@ -979,7 +1505,7 @@ namespace graphlab {
         #pragma omp for
 #endif
         for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-          if (lvid2record[i].owner == rpc.procid() &&
+          if (lvid2owner[i] == rpc.procid() &&
               vset.l_contains((lvid_type)i)) {
             if (!result_set) {
               const vertex_type vtx(l_vertex(i));
@@ -1254,7 +1780,7 @@ namespace graphlab {
         #pragma omp for
 #endif
         for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-          if (lvid2record[i].owner == rpc.procid() &&
+          if (lvid2owner[i] == rpc.procid() &&
               vset.l_contains((lvid_type)i)) {
             const vertex_type vtx(l_vertex(i));
             foldfunction(vtx, result);
@@ -1476,7 +2002,7 @@ namespace graphlab {
       #pragma omp parallel for
 #endif
       for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-        if (lvid2record[i].owner == rpc.procid() &&
+        if (lvid2owner[i] == rpc.procid() &&
             vset.l_contains((lvid_type)i)) {
           vertex_type vtx(l_vertex(i));
           transform_functor(vtx);
@@ -1486,6 +2012,52 @@ namespace graphlab {
       synchronize();
     }
 
+    /**
+     * \brief Performs a transformation on blocks of vertices.
+     *
+     * Like transform_vertices(), but the function is called with a
+     * <code>std::vector<vertex_type>&</code> of at most block_size
+     * vertices at a time, the blocks being transformed in parallel.
+     * This lets dense per-vertex work be done for the whole block at
+     * once, as a matrix product for instance, so that the data shared
+     * by the vertices is read once per block instead of once per
+     * vertex. The mirrors are synchronized after all the blocks are
+     * done. Must be called on all machines simultaneously.
+     */
+    template <typename TransformType>
+    void transform_vertex_blocks(TransformType transform_functor,
+                                 size_t block_size,
+                                 const vertex_set vset = complete_set()) {
+      if(!finalized) {
+        logstream(LOG_FATAL)
+          << "\n\tAttempting to call graph.transform_vertex_blocks(...)"
+          << "\n\tbefore finalizing the graph."
+          << std::endl;
+      }
+      ASSERT_GT(block_size, 0);
+      rpc.barrier();
+      const int nblocks =
+          (int)((local_graph.num_vertices() + block_size - 1) / block_size);
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic)
+#endif
+      for (int b = 0; b < nblocks; ++b) {
+        std::vector<vertex_type> block;
+        block.reserve(block_size);
+        const size_t end = std::min(local_graph.num_vertices(),
+                                    (b + 1) * block_size);
+        for (size_t i = b * block_size; i < end; ++i) {
+          if (lvid2owner[i] == rpc.procid() &&
+              vset.l_contains((lvid_type)i)) {
+            block.push_back(vertex_type(l_vertex(i)));
+          }
+        }
+        if (!block.empty()) transform_functor(block);
+      }
+      rpc.barrier();
+      synchronize();
+    }
+
     /**
      * \brief Performs a transformation operation on each edge in the graph.
      *
@@ -1576,6 +2148,181 @@ namespace graphlab {
       rpc.barrier();
     }
 
+
+    /**
+     * \brief Performs a map-reduce operation on every edge in the graph,
+     * walking the local edges in storage order.
+     *
+     * Has the same result as map_reduce_edges() over all edges, but the
+     * map function is passed a \ref csr_edge_type, which is read straight
+     * out of the CSR arrays, instead of an edge_type. A chunk of
+     * consecutive source vertices has its out edges next to each other in
+     * the edge data array, so each thread reads the edge data
+     * sequentially. Every edge is visited exactly once, on the machine
+     * which stores it. Intended for edge heavy passes such as computing
+     * the training error of a factorization.
+     *
+     * \code
+     * double squared_error(const graph_type::csr_edge_type& edge) {
+     *   const double err = edge.data().obs -
+     *                      edge.source_data().pvec.dot(edge.target_data().pvec);
+     *   return err * err;
+     * }
+     * double sse = graph.map_reduce_csr_edges<double>(squared_error);
+     * \endcode
+     *
+     * Must be called on all machines simultaneously.
+     *
+     * \param mapfunction Takes a const \ref csr_edge_type& and returns a
+     *                    ReductionType which must be summable and
+     *                    \ref sec_serializable.
+     */
+    template <typename ReductionType, typename MapFunctionType>
+    ReductionType map_reduce_csr_edges(MapFunctionType mapfunction) {
+      BOOST_CONCEPT_ASSERT((graphlab::Serializable<ReductionType>));
+      BOOST_CONCEPT_ASSERT((graphlab::OpPlusEq<ReductionType>));
+      if(!finalized) {
+        logstream(LOG_FATAL)
+          << "\n\tAttempting to run graph.map_reduce_csr_edges(...)"
+          << "\n\tbefore calling graph.finalize()."
+          << std::endl;
+      }
+
+      rpc.barrier();
+      edge_data_type* edge_array =
+          local_graph.num_edges() > 0 ? &local_graph.edge_data(0) : NULL;
+      bool global_result_set = false;
+      ReductionType global_result = ReductionType();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+      {
+        bool result_set = false;
+        ReductionType result = ReductionType();
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic, 256)
+#endif
+        for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
+          const typename local_graph_type::edge_span span =
+              local_graph.out_edge_span(i);
+          const vertex_data_type* src_data = &local_graph.vertex_data(i);
+          for (size_t j = 0; j < span.size(); ++j) {
+            const edge_id_type eid = span.edge_id(j);
+            const csr_edge_type edge(this, i, span.neighbor(j), eid, src_data,
+                                     &span.neighbor_data(j), edge_array + eid);
+            if (!result_set) {
+              result = mapfunction(edge);
+              result_set = true;
+            }
+            else {
+              const ReductionType tmp = mapfunction(edge);
+              result += tmp;
+            }
+          }
+        }
+#ifdef _OPENMP
+        #pragma omp critical
+#endif
+        {
+          if (result_set) {
+            if (!global_result_set) {
+              global_result = result;
+              global_result_set = true;
+            }
+            else {
+              global_result += result;
+            }
+          }
+        }
+      }
+
+      conditional_addition_wrapper<ReductionType>
+        wrapper(global_result, global_result_set);
+      rpc.all_reduce(wrapper);
+      return wrapper.value;
+    } // end of map_reduce_csr_edges
+
+
+    /**
+     * \brief Performs a transformation on every edge in the graph,
+     * walking the local edges in storage order.
+     *
+     * The CSR counterpart of transform_edges() over all edges (see
+     * map_reduce_csr_edges()). The transform functor takes a
+     * \ref csr_edge_type& and may modify the edge data through data().
+     * Must be called on all machines simultaneously.
+     */
+    template <typename TransformType>
+    void transform_csr_edges(TransformType transform_functor) {
+      if(!finalized) {
+        logstream(LOG_FATAL)
+          << "\n\tAttempting to call graph.transform_csr_edges(...)"
+          << "\n\tbefore finalizing the graph."
+          << std::endl;
+      }
+      rpc.barrier();
+      edge_data_type* edge_array =
+          local_graph.num_edges() > 0 ? &local_graph.edge_data(0) : NULL;
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic, 256)
+#endif
+      for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
+        const typename local_graph_type::edge_span span =
+            local_graph.out_edge_span(i);
+        const vertex_data_type* src_data = &local_graph.vertex_data(i);
+        for (size_t j = 0; j < span.size(); ++j) {
+          const edge_id_type eid = span.edge_id(j);
+          csr_edge_type edge(this, i, span.neighbor(j), eid, src_data,
+                             &span.neighbor_data(j), edge_array + eid);
+          transform_functor(edge);
+        }
+      }
+      rpc.barrier();
+    } // end of transform_csr_edges
+
+
+    /**
+     * \brief Maps every local edge and stores the results by local edge
+     * id.
+     *
+     * Walks the local edges like map_reduce_csr_edges() and writes
+     * mapfunction(edge) to out[edge.l_id()]. out must already hold
+     * num_local_edges() elements, so the same array can be reused
+     * across passes without any allocation. Purely local: no
+     * communication takes place.
+     *
+     * \param mapfunction Takes a const \ref csr_edge_type& and returns a
+     *                    value convertible to ResultType.
+     * \param out The array of results indexed by local edge id.
+     */
+    template <typename ResultType, typename MapFunctionType>
+    void map_csr_edges(MapFunctionType mapfunction,
+                       std::vector<ResultType>& out) {
+      if(!finalized) {
+        logstream(LOG_FATAL)
+          << "\n\tAttempting to call graph.map_csr_edges(...)"
+          << "\n\tbefore finalizing the graph."
+          << std::endl;
+      }
+      ASSERT_EQ(out.size(), local_graph.num_edges());
+      edge_data_type* edge_array =
+          local_graph.num_edges() > 0 ? &local_graph.edge_data(0) : NULL;
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic, 256)
+#endif
+      for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
+        const typename local_graph_type::edge_span span =
+            local_graph.out_edge_span(i);
+        const vertex_data_type* src_data = &local_graph.vertex_data(i);
+        for (size_t j = 0; j < span.size(); ++j) {
+          const edge_id_type eid = span.edge_id(j);
+          const csr_edge_type edge(this, i, span.neighbor(j), eid, src_data,
+                                   &span.neighbor_data(j), edge_array + eid);
+          out[eid] = mapfunction(edge);
+        }
+      }
+    } // end of map_csr_edges
+
     // disable documentation for parallel_for stuff. These are difficult
     // to use properly by the user
     /// \cond GRAPHLAB_INTERNAL
@@ -1600,7 +2347,7 @@ namespace graphlab {
 #endif
       for (int i = 0; i < (int)accfunction.size(); ++i) {
         for (int j = i;j < (int)local_graph.num_vertices(); j+=numaccfunctions) {
-          if (lvid2record[j].owner == rpc.procid()) {
+          if (lvid2owner[j] == rpc.procid()) {
             accfunction[i](vertex_type(l_vertex(j)));
           }
         }
@@ -1642,6 +2389,7 @@ namespace graphlab {
 
     /** \brief Load the graph from an archive */
     void load(iarchive& arc) {
+      out_of_core_memory.move_to_memory(false);
       // read the vertices
       arc >> nverts
           >> nedges
@@ -1650,7 +2398,10 @@ namespace graphlab {
           >> vid2lvid
           >> lvid2record
           >> local_graph;
+      build_owner_index();
+      build_frozen_vid2lvid();
       finalized = true;
+      build_shared_vertex_index();
       // check the graph condition
     } // end of load
 
@@ -1675,21 +2426,291 @@ namespace graphlab {
 
     /// \endcond
 
-    /// \brief Clears and resets the graph, releasing all memory used.
-    void clear () {
-      foreach (vertex_record& vrec, lvid2record)
-        vrec.clear();
-      lvid2record.clear();
-      vid2lvid.clear();
-      local_graph.clear();
-      finalized=false;
-      nverts = nedges = local_own_nverts = nreplicas = 0;
+    /**
+     * \internal
+     * Writes the local part of the graph as a snapshot. The sections
+     * are the graph counters, the vertex records and then the local
+     * graph arrays. vid2lvid is rebuilt from the vertex records on load.
+     */
+    bool save_snapshot(const std::string& fname) const {
+      snapshot_writer writer(fname);
+      if (!writer.good()) {
+        logstream(LOG_ERROR) << "\n\tError opening file: " << fname << std::endl;
+        return false;
+      }
+      std::vector<uint64_t> counters(4);
+      counters[0] = nverts; counters[1] = nedges;
+      counters[2] = local_own_nverts; counters[3] = nreplicas;
+      writer.write(counters);
+      writer.write(lvid2record);
+      local_graph.save_snapshot(writer);
+      if (!writer.close()) {
+        logstream(LOG_ERROR) << "\n\tError writing file: " << fname << std::endl;
+        return false;
+      }
+      return true;
     }
 
+    /**
+     * \internal
+     * Loads the local part of the graph from a snapshot written by
+     * save_snapshot().
+     */
+    bool load_snapshot(const std::string& fname) {
+      snapshot_reader reader(fname);
+      if (!reader.good()) {
+        logstream(LOG_ERROR) << "\n\tError opening file: " << fname << std::endl;
+        return false;
+      }
+      clear();
+      std::vector<uint64_t> counters;
+      reader.read(counters);
+      ASSERT_EQ(counters.size(), 4);
+      nverts = counters[0]; nedges = counters[1];
+      local_own_nverts = counters[2]; nreplicas = counters[3];
+      reader.read(lvid2record);
+      local_graph.load_snapshot(reader);
+      ASSERT_EQ(lvid2record.size(), local_graph.num_vertices());
+      for (size_t i = 0; i < lvid2record.size(); ++i) {
+        vid2lvid[lvid2record[i].gvid] = i;
+      }
+      build_owner_index();
+      build_frozen_vid2lvid();
+      finalized = true;
+      build_shared_vertex_index();
+      logstream(LOG_INFO) << "Finish loading graph snapshot from " << fname
+                          << std::endl;
+      return true;
+    }
 
-    /** \brief Load a distributed graph from a native binary format
-     * previously saved with save_binary(). This function must be called
-     *  simultaneously on all machines.
+    /**
+     * \internal
+     * Builds the shared vertex index from the vertex records. Needs no
+     * communication.
+     */
+    void build_shared_vertex_index() {
+      shared_index.build(*this);
+      logstream(LOG_INFO) << "Shared vertex index: " << shared_index.size()
+                          << " entries" << std::endl;
+    }
+
+    /**
+     * \internal
+     * Copies the owners of the vertex records into lvid2owner.
+     */
+    void build_owner_index() {
+      lvid2owner.resize(lvid2record.size());
+      for (size_t i = 0; i < lvid2record.size(); ++i) {
+        lvid2owner[i] = lvid2record[i].owner;
+      }
+      update_masters_moved();
+    }
+
+    /**
+     * \internal
+     * Sets masters_moved if a local vertex is not mastered by the
+     * machine given by the hash of its id.
+     */
+    void update_masters_moved() {
+      masters_moved = false;
+      for (size_t i = 0; i < lvid2record.size() && !masters_moved; ++i) {
+        masters_moved = lvid2record[i].owner !=
+          graph_hash::hash_vertex(lvid2record[i].gvid) % rpc.numprocs();
+      }
+    }
+
+    /**
+     * \internal
+     * Makes proc, which must hold a replica, the master of lvid. The old
+     * master becomes a mirror. Only updates the local vertex record.
+     */
+    void set_vertex_owner(lvid_type lvid, procid_t proc) {
+      vertex_record& vrec = lvid2record[lvid];
+      vrec._mirrors.set_bit(vrec.owner);
+      vrec._mirrors.clear_bit(proc);
+      vrec.owner = proc;
+      lvid2owner[lvid] = proc;
+    }
+
+    /**
+     * \internal
+     * \brief Moves the masters of local vertices to some of their
+     * mirrors. Must be called on all machines simultaneously, each
+     * passing (lvid, new master) pairs for vertices it masters.
+     *
+     * The old master sends the new owner and its vertex data to every
+     * replica, so the new master starts from the exact master data.
+     * Only the ownership moves: the edges stay where they are.
+     * Afterwards the shared vertex index is rebuilt, and vertices
+     * without a local replica are resolved through the machine given
+     * by the hash of their id, which keeps a replica.
+     */
+    void move_masters(const std::vector<std::pair<lvid_type, procid_t> >& moves) {
+      buffered_exchange<master_move_record> move_exchange(rpc.dc());
+      for (size_t i = 0; i < moves.size(); ++i) {
+        const lvid_type lvid = moves[i].first;
+        const procid_t proc = moves[i].second;
+        ASSERT_TRUE(l_is_master(lvid));
+        ASSERT_TRUE(lvid2record[lvid]._mirrors.get(proc));
+        const master_move_record rec(lvid2record[lvid].gvid, proc,
+                                     l_vertex(lvid).data());
+        foreach(procid_t mirror, lvid2record[lvid].mirrors()) {
+          move_exchange.send(mirror, rec);
+        }
+        set_vertex_owner(lvid, proc);
+      }
+      move_exchange.flush();
+      typename buffered_exchange<master_move_record>::buffer_type buffer;
+      procid_t sending_proc(-1);
+      while(move_exchange.recv(sending_proc, buffer)) {
+        foreach(const master_move_record& rec, buffer) {
+          const lvid_type lvid = local_vid(rec.gvid);
+          l_vertex(lvid).data() = rec.vdata;
+          set_vertex_owner(lvid, rec.owner);
+        }
+      }
+      local_own_nverts = 0;
+      for (size_t i = 0; i < lvid2owner.size(); ++i) {
+        local_own_nverts += (lvid2owner[i] == rpc.procid());
+      }
+      update_masters_moved();
+      build_shared_vertex_index();
+      rpc.barrier();
+    } // end of move masters
+
+  private:
+    /// The new owner and the vertex data of a vertex sent by move_masters()
+    struct master_move_record {
+      vertex_id_type gvid;
+      procid_t owner;
+      vertex_data_type vdata;
+      master_move_record(vertex_id_type gvid = vertex_id_type(-1),
+                         procid_t owner = procid_t(-1),
+                         const vertex_data_type& vdata = vertex_data_type()) :
+        gvid(gvid), owner(owner), vdata(vdata) { }
+      void load(iarchive& arc) { arc >> gvid >> owner >> vdata; }
+      void save(oarchive& arc) const { arc << gvid << owner << vdata; }
+    };
+
+  public:
+
+    /**
+     * \internal
+     * Builds the read only copy of vid2lvid used by the lookups.
+     */
+    void build_frozen_vid2lvid() {
+      identity_vid2lvid = true;
+      for (typename hopscotch_map_type::const_iterator iter = vid2lvid.begin();
+           iter != vid2lvid.end(); ++iter) {
+        if (iter->first != iter->second) {
+          identity_vid2lvid = false;
+          break;
+        }
+      }
+      if (identity_vid2lvid) frozen_vid2lvid.clear();
+      else frozen_vid2lvid.build(vid2lvid.begin(), vid2lvid.end(), vid2lvid.size());
+    }
+
+    /// \brief Clears and resets the graph, releasing all memory used.
+    void clear () {
+      foreach (vertex_record& vrec, lvid2record)
+        vrec.clear();
+      lvid2record.clear();
+      lvid2owner.clear();
+      vid2lvid.clear();
+      frozen_vid2lvid.clear();
+      identity_vid2lvid = false;
+      out_of_core_memory.move_to_memory(false);
+      local_graph.clear();
+      shared_index.clear();
+      finalized=false;
+      masters_moved = false;
+      nverts = nedges = local_own_nverts = nreplicas = 0;
+    }
+
+    /**
+     * \brief A copy of the vertex data, and optionally of the edge data,
+     * of the local part of the graph. See save_data_checkpoint().
+     */
+    struct data_checkpoint {
+      std::vector<vertex_data_type> vdata;
+      std::vector<edge_data_type> edata;
+      bool has_edge_data;
+      data_checkpoint() : has_edge_data(false) { }
+      void clear() {
+        std::vector<vertex_data_type>().swap(vdata);
+        std::vector<edge_data_type>().swap(edata);
+        has_edge_data = false;
+      }
+    };
+
+    /**
+     * \brief Copies the vertex data, and the edge data if edge_data is
+     * true, to ckpt so that restore_data_checkpoint() can later reset
+     * the graph to its current state.
+     *
+     * This is meant for running several configurations of an algorithm
+     * back to back on one loaded graph, for instance:
+     * \code
+     * graph_type::data_checkpoint initial;
+     * graph.save_data_checkpoint(initial);
+     * for (size_t i = 0; i < lambdas.size(); ++i) {
+     *   graph.restore_data_checkpoint(initial);
+     *   ...
+     *   engine.start();
+     * }
+     * \endcode
+     * The graph must be finalized, and the checkpoint is only valid
+     * until the structure of the graph changes. Each machine copies its
+     * own vertices and edges, without communication.
+     */
+    void save_data_checkpoint(data_checkpoint& ckpt,
+                              bool edge_data = true) const {
+      ASSERT_TRUE(finalized);
+      ckpt.vdata.resize(local_graph.num_vertices());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(ckpt.vdata.size()); ++i) {
+        ckpt.vdata[i] = local_graph.vertex_data(i);
+      }
+      ckpt.has_edge_data = edge_data;
+      ckpt.edata.resize(edge_data ? local_graph.num_edges() : 0);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(ckpt.edata.size()); ++i) {
+        ckpt.edata[i] = local_graph.edge_data(i);
+      }
+    }
+
+    /**
+     * \brief Copies the data saved by save_data_checkpoint() back into
+     * the graph. The edge data is only restored if it was saved.
+     */
+    void restore_data_checkpoint(const data_checkpoint& ckpt) {
+      ASSERT_TRUE(finalized);
+      ASSERT_EQ(ckpt.vdata.size(), local_graph.num_vertices());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(ckpt.vdata.size()); ++i) {
+        local_graph.vertex_data(i) = ckpt.vdata[i];
+      }
+      if (!ckpt.has_edge_data) return;
+      ASSERT_EQ(ckpt.edata.size(), local_graph.num_edges());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(ckpt.edata.size()); ++i) {
+        local_graph.edge_data(i) = ckpt.edata[i];
+      }
+    }
+
+
+    /** \brief Load a distributed graph from a native binary format
+     * previously saved with save_binary(). This function must be called
+     *  simultaneously on all machines.
      *
      * This function loads a sequence of files numbered
      * \li [prefix].0.gz
@@ -1706,6 +2727,10 @@ namespace graphlab {
      * A graph loaded using load_binary() is already finalized and
      * structure modifications are not permitted after loading.
      *
+     * Files written as snapshots (see save_binary()) are detected
+     * automatically. They are memory mapped and their arrays copied
+     * directly into the graph without deserialization.
+     *
      * Return true on success and false on failure if the file cannot be loaded.
      */
     bool load_binary(const std::string& prefix) {
@@ -1713,7 +2738,12 @@ namespace graphlab {
       std::string fname = prefix + tostr(rpc.procid()) + ".bin";
 
       logstream(LOG_INFO) << "Load graph from " << fname << std::endl;
-      if(boost::starts_with(fname, "hdfs://")) {
+      if(!boost::starts_with(fname, "hdfs://") &&
+         snapshot_reader::is_snapshot(fname)) {
+        const bool success = load_snapshot(fname);
+        rpc.full_barrier();
+        return success;
+      } else if(boost::starts_with(fname, "hdfs://")) {
         graphlab::hdfs hdfs;
         graphlab::hdfs::fstream in_file(hdfs, fname);
         boost::iostreams::filtering_stream<boost::iostreams::input> fin;
@@ -1770,6 +2800,13 @@ namespace graphlab {
      * If the graph is not alreasy finalized before save_binary() is called,
      * this function will finalize the graph.
      *
+     * If the vertex and edge data are POD types and the files are not
+     * on HDFS, the graph is written as an uncompressed snapshot instead.
+     * A snapshot stores each array of the graph exactly as it is laid
+     * out in memory, page aligned, so that load_binary() only has to
+     * map and copy it. Snapshots depend on the id types and on the
+     * layout of the vertex and edge data.
+     *
      * Returns true on success, and false if the graph cannot be loaded from
      * the specified file.
      */
@@ -1779,7 +2816,10 @@ namespace graphlab {
       timer savetime;  savetime.start();
       std::string fname = prefix + tostr(rpc.procid()) + ".bin";
       logstream(LOG_INFO) << "Save graph to " << fname << std::endl;
-      if(boost::starts_with(fname, "hdfs://")) {
+      if(!boost::starts_with(fname, "hdfs://") &&
+         gl_is_pod<VertexData>::value && gl_is_pod<EdgeData>::value) {
+        if (!save_snapshot(fname)) return false;
+      } else if(boost::starts_with(fname, "hdfs://")) {
         graphlab::hdfs hdfs;
         graphlab::hdfs::fstream out_file(hdfs, fname, true);
         boost::iostreams::filtering_stream<boost::iostreams::output> fout;
@@ -1829,17 +2869,41 @@ namespace graphlab {
                          bool save_vertex = true,
                          bool save_edge = true,
                          size_t files_per_machine = 4) {
-      typedef boost::function<void(vertex_type)> vertex_function_type;
-      typedef boost::function<void(edge_type)> edge_function_type;
+      string_writer_adapter<Writer> adapter(writer);
+      save_to_posixfs_impl(prefix, adapter, gzip, save_vertex, save_edge,
+                           files_per_machine);
+    } // end of save to posixfs
+
+
+
+    /**
+     * \brief Saves the graph to HDFS using a provided Writer object.
+     * Like \ref save(const std::string& prefix, writer writer, bool gzip, bool save_vertex, bool save_edge, size_t files_per_machine) "save()"
+     * but only saves to HDFS.
+     */
+    template<typename Writer>
+    void save_to_hdfs(const std::string& prefix, Writer writer,
+                      bool gzip = true,
+                      bool save_vertex = true,
+                      bool save_edge = true,
+                      size_t files_per_machine = 4) {
+      string_writer_adapter<Writer> adapter(writer);
+      save_to_hdfs_impl(prefix, adapter, gzip, save_vertex, save_edge,
+                        files_per_machine);
+    } // end of save to hdfs
+
+  private:
+    /// Saves to the local filesystem with a buffered writer
+    template<typename BufferedWriter>
+    void save_to_posixfs_impl(const std::string& prefix, BufferedWriter& writer,
+                              bool gzip, bool save_vertex, bool save_edge,
+                              size_t files_per_machine) {
       typedef std::ofstream base_fstream_type;
-      typedef boost::iostreams::filtering_stream<boost::iostreams::output>
-        boost_fstream_type;
       rpc.full_barrier();
       finalize();
       // figure out the filenames
       std::vector<std::string> graph_files;
       std::vector<base_fstream_type*> outstreams;
-      std::vector<boost_fstream_type*> booststreams;
       graph_files.resize(files_per_machine);
       for(size_t i = 0; i < files_per_machine; ++i) {
         //graph_files[i] = prefix + "_" + tostr(1 + i + rpc.procid() * files_per_machine)
@@ -1847,76 +2911,29 @@ namespace graphlab {
           + "_of_" + tostr(rpc.numprocs() * files_per_machine);
         if (gzip) graph_files[i] += ".gz";
       }
-
-      // create the vector of callbacks
-      std::vector<vertex_function_type> vertex_callbacks(graph_files.size());
-      std::vector<edge_function_type> edge_callbacks(graph_files.size());
-
       for(size_t i = 0; i < graph_files.size(); ++i) {
         logstream(LOG_INFO) << "Saving to file: " << graph_files[i] << std::endl;
-        // open the stream
-        base_fstream_type* out_file =
+        outstreams.push_back(
           new base_fstream_type(graph_files[i].c_str(),
-                                std::ios_base::out | std::ios_base::binary);
-        // attach gzip if the file is gzip
-        boost_fstream_type* fout = new boost_fstream_type;
-        // Using gzip filter
-        if (gzip) fout->push(boost::iostreams::gzip_compressor());
-        fout->push(*out_file);
-
-        outstreams.push_back(out_file);
-        booststreams.push_back(fout);
-        // construct the callback for the parallel for
-        typedef distributed_graph<vertex_data_type, edge_data_type> graph_type;
-        vertex_callbacks[i] =
-          boost::bind(&graph_type::template save_vertex_to_stream<boost_fstream_type, Writer>,
-                      this, _1, boost::ref(*fout), boost::ref(writer));
-        edge_callbacks[i] =
-          boost::bind(&graph_type::template save_edge_to_stream<boost_fstream_type, Writer>,
-                      this, _1, boost::ref(*fout), boost::ref(writer));
+                                std::ios_base::out | std::ios_base::binary));
       }
-
-      if (save_vertex) parallel_for_vertices(vertex_callbacks);
-      if (save_edge) parallel_for_edges(edge_callbacks);
-
+      save_to_streams(outstreams, writer, gzip, save_vertex, save_edge, true);
       // cleanup
-      for(size_t i = 0; i < graph_files.size(); ++i) {
-        booststreams[i]->pop();
-        if (gzip) booststreams[i]->pop();
-        delete booststreams[i];
-        delete outstreams[i];
-      }
-      vertex_callbacks.clear();
-      edge_callbacks.clear();
-      outstreams.clear();
-      booststreams.clear();
+      for(size_t i = 0; i < graph_files.size(); ++i) delete outstreams[i];
       rpc.full_barrier();
-    } // end of save to posixfs
-
-
+    } // end of save to posixfs impl
 
-    /**
-     * \brief Saves the graph to HDFS using a provided Writer object.
-     * Like \ref save(const std::string& prefix, writer writer, bool gzip, bool save_vertex, bool save_edge, size_t files_per_machine) "save()"
-     * but only saves to HDFS.
-     */
-    template<typename Writer>
-    void save_to_hdfs(const std::string& prefix, Writer writer,
-                      bool gzip = true,
-                      bool save_vertex = true,
-                      bool save_edge = true,
-                      size_t files_per_machine = 4) {
-      typedef boost::function<void(vertex_type)> vertex_function_type;
-      typedef boost::function<void(edge_type)> edge_function_type;
+    /// Saves to HDFS with a buffered writer
+    template<typename BufferedWriter>
+    void save_to_hdfs_impl(const std::string& prefix, BufferedWriter& writer,
+                           bool gzip, bool save_vertex, bool save_edge,
+                           size_t files_per_machine) {
       typedef graphlab::hdfs::fstream base_fstream_type;
-      typedef boost::iostreams::filtering_stream<boost::iostreams::output>
-        boost_fstream_type;
       rpc.full_barrier();
       finalize();
       // figure out the filenames
       std::vector<std::string> graph_files;
       std::vector<base_fstream_type*> outstreams;
-      std::vector<boost_fstream_type*> booststreams;
       graph_files.resize(files_per_machine);
       for(size_t i = 0; i < files_per_machine; ++i) {
         graph_files[i] = prefix + "_" + tostr(1 + i + rpc.procid() * files_per_machine)
@@ -1931,52 +2948,155 @@ namespace graphlab {
           << std::endl;
       }
       hdfs& hdfs = hdfs::get_hdfs();
-
-      // create the vector of callbacks
-
-      std::vector<vertex_function_type> vertex_callbacks(graph_files.size());
-      std::vector<edge_function_type> edge_callbacks(graph_files.size());
-
       for(size_t i = 0; i < graph_files.size(); ++i) {
         logstream(LOG_INFO) << "Saving to file: " << graph_files[i] << std::endl;
-        // open the stream
-        base_fstream_type* out_file = new base_fstream_type(hdfs,
-                                                            graph_files[i],
-                                                            true);
-        // attach gzip if the file is gzip
-        boost_fstream_type* fout = new boost_fstream_type;
-        // Using gzip filter
-        if (gzip) fout->push(boost::iostreams::gzip_compressor());
-        fout->push(*out_file);
+        outstreams.push_back(new base_fstream_type(hdfs, graph_files[i], true));
+      }
+      // HDFS writes go through JNI, which must not run on fiber stacks
+      save_to_streams(outstreams, writer, gzip, save_vertex, save_edge, false);
+      // cleanup
+      for(size_t i = 0; i < graph_files.size(); ++i) delete outstreams[i];
+      rpc.full_barrier();
+    } // end of save to hdfs impl
+
+    /**
+     * Writes the owned vertices, then the edges, to the output
+     * streams. The local vertices are cut into chunks of
+     * SAVE_CHUNK_VERTICES which threads format and, with gzip, compress
+     * independently. Every chunk goes to one stream in blocks of about
+     * SAVE_BLOCK_SIZE bytes, each block compressed as a separate gzip
+     * member; gzip readers decompress the concatenated members as one
+     * stream. The number of threads is therefore not bound by the
+     * number of files.
+     *
+     * The chunks are processed by the task runtime workers if
+     * use_task_runtime is set, and by an OpenMP team otherwise.
+     */
+    template<typename Fstream, typename BufferedWriter>
+    void save_to_streams(std::vector<Fstream*>& outstreams,
+                         BufferedWriter& writer,
+                         bool gzip, bool save_vertex, bool save_edge,
+                         bool use_task_runtime) {
+      ASSERT_TRUE(finalized);
+      ASSERT_GE(outstreams.size(), 1);
+      std::vector<mutex> locks(outstreams.size());
+      const size_t nchunks =
+        (local_graph.num_vertices() + SAVE_CHUNK_VERTICES - 1) / SAVE_CHUNK_VERTICES;
+      for (size_t pass = 0; pass < 2; ++pass) {
+        if ((pass == 0 && !save_vertex) || (pass == 1 && !save_edge)) continue;
+        atomic<size_t> next_chunk(0);
+        boost::function<void(size_t)> saver = 
+          boost::bind(&distributed_graph::template save_chunks<Fstream, BufferedWriter>,
+                      this, boost::ref(outstreams), boost::ref(writer), 
+                      boost::ref(locks), gzip, pass, boost::ref(next_chunk), 
+                      nchunks, _1);
+        if (use_task_runtime) {
+          // one task per worker, each claiming chunks until none are left
+          parallel_for(0, task_runtime_num_workers(), saver, 1);
+        } else {
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+          saver(0);
+        }
+      }
+      for (size_t i = 0; i < outstreams.size(); ++i) {
+        outstreams[i]->flush();
+        if (outstreams[i]->fail()) {
+          logstream(LOG_FATAL) << "Error writing the graph" << std::endl;
+        }
+      }
+    } // end of save to streams
 
-        outstreams.push_back(out_file);
-        booststreams.push_back(fout);
-        // construct the callback for the parallel for
-        typedef distributed_graph<vertex_data_type, edge_data_type> graph_type;
-        vertex_callbacks[i] =
-          boost::bind(&graph_type::template save_vertex_to_stream<boost_fstream_type, Writer>,
-                      this, _1, boost::ref(*fout), writer);
-        edge_callbacks[i] =
-          boost::bind(&graph_type::template save_edge_to_stream<boost_fstream_type, Writer>,
-                      this, _1, boost::ref(*fout), writer);
+    /**
+     * Claims chunks from next_chunk and saves the vertices (pass 0) or
+     * the edges (pass 1) of each until all nchunks are claimed. Runs
+     * concurrently. See save_to_streams().
+     */
+    template<typename Fstream, typename BufferedWriter>
+    void save_chunks(std::vector<Fstream*>& outstreams,
+                     BufferedWriter& writer,
+                     std::vector<mutex>& locks,
+                     bool gzip, size_t pass,
+                     atomic<size_t>& next_chunk, size_t nchunks,
+                     size_t unused) {
+      // reused by all the chunks of the thread
+      std::string buffer, compressed;
+      while(1) {
+        const size_t c = next_chunk.inc_ret_last();
+        if (c >= nchunks) break;
+        const size_t out = c % outstreams.size();
+        const size_t end = std::min(local_graph.num_vertices(),
+                                    size_t(c + 1) * SAVE_CHUNK_VERTICES);
+        for (lvid_type j = c * SAVE_CHUNK_VERTICES; j < end; ++j) {
+          if (pass == 0) {
+            if (lvid2owner[j] == rpc.procid()) {
+              writer.save_vertex(vertex_type(l_vertex(j)), buffer);
+            }
+          } else {
+            foreach(const local_edge_type& e, l_vertex(j).in_edges()) {
+              writer.save_edge(edge_type(e), buffer);
+            }
+          }
+          if (buffer.size() >= SAVE_BLOCK_SIZE) {
+            write_save_block(*outstreams[out], locks[out], buffer,
+                             compressed, gzip);
+          }
+        }
+        write_save_block(*outstreams[out], locks[out], buffer,
+                         compressed, gzip);
       }
+    } // end of save chunks
 
-      if (save_vertex) parallel_for_vertices(vertex_callbacks);
-      if (save_edge) parallel_for_edges(edge_callbacks);
+    /**
+     * Compresses buffer into a gzip member if gzip is set and appends
+     * it to out. Clears buffer.
+     */
+    template<typename Fstream>
+    static void write_save_block(Fstream& out, mutex& lock,
+                                 std::string& buffer, std::string& compressed,
+                                 bool gzip) {
+      if (buffer.empty()) return;
+      const std::string* block = &buffer;
+      if (gzip) {
+        compressed.clear();
+        boost::iostreams::filtering_ostream fout;
+        fout.push(boost::iostreams::gzip_compressor());
+        fout.push(boost::iostreams::back_inserter(compressed));
+        fout.write(buffer.c_str(), buffer.size());
+        fout.reset();
+        block = &compressed;
+      }
+      lock.lock();
+      out.write(block->c_str(), block->size());
+      lock.unlock();
+      buffer.clear();
+    } // end of write save block
+
+    /// Appends block to sink and clears it
+    static void write_column_block(icolumn_sink& sink, mutex& lock,
+                                   column_block& block) {
+      if (block.empty()) return;
+      lock.lock();
+      sink.write_block(block);
+      lock.unlock();
+      block.clear();
+    } // end of write column block
+
+    /// Turns a writer returning strings into a buffered writer
+    template<typename Writer>
+    struct string_writer_adapter {
+      Writer& writer;
+      string_writer_adapter(Writer& writer) : writer(writer) { }
+      void save_vertex(vertex_type v, std::string& out) {
+        out += writer.save_vertex(v);
+      }
+      void save_edge(edge_type e, std::string& out) {
+        out += writer.save_edge(e);
+      }
+    };
 
-      // cleanup
-      for(size_t i = 0; i < graph_files.size(); ++i) {
-        booststreams[i]->pop();
-        if (gzip) booststreams[i]->pop();
-        delete booststreams[i];
-        delete outstreams[i];
-      }
-      vertex_callbacks.clear();
-      edge_callbacks.clear();
-      outstreams.clear();
-      booststreams.clear();
-      rpc.full_barrier();
-    } // end of save to hdfs
+  public:
 
 
 
@@ -2038,7 +3158,9 @@ namespace graphlab {
      *
      * To accelerate the saving process, multiple files are be written
      * per machine in parallel. If the gzip option is not set, the ".gz" suffix
-     * is not added.
+     * is not added. All the threads of a machine format and compress
+     * the output whatever the number of files, and a compressed file is
+     * a sequence of gzip members.
      *
      * For instance, if there are 4 machines, running:
      * \code
@@ -2090,6 +3212,176 @@ namespace graphlab {
     } // end of save
 
 
+    /**
+     * \brief Saves the graph like
+     * \ref save(const std::string& prefix, writer writer, bool gzip, bool save_vertex, bool save_edge, size_t files_per_machine) "save()"
+     * with a writer which appends its output to a buffer instead of
+     * returning a string for every vertex and edge. The writer must
+     * implement:
+     * \code
+     * void Writer::save_vertex(graph_type::vertex_type v, std::string& out);
+     * void Writer::save_edge(graph_type::edge_type e, std::string& out);
+     * \endcode
+     * Each thread reuses its buffer, so formatting does not allocate
+     * once the buffer has grown. The writer is shared by all the threads.
+     */
+    template<typename BufferedWriter>
+    void save_buffered(const std::string& prefix, BufferedWriter writer,
+                       bool gzip = true, bool save_vertex = true,
+                       bool save_edge = true, size_t files_per_machine = 4) {
+      if(boost::starts_with(prefix, "hdfs://")) {
+        save_to_hdfs_impl(prefix, writer, gzip, save_vertex, save_edge,
+                          files_per_machine);
+      } else {
+        save_to_posixfs_impl(prefix, writer, gzip, save_vertex, save_edge,
+                             files_per_machine);
+      }
+    } // end of save buffered
+
+
+    /**
+     * \brief Saves typed columns of the vertices and the edges as
+     * columnar files, without formatting any text. This function must
+     * be called on all machines simultaneously.
+     *
+     * The writer lists the columns of each table and fills one row per
+     * vertex or edge:
+     * \code
+     * struct pagerank_columns {
+     *   void vertex_columns(graphlab::column_schema& schema) const {
+     *     schema.add<graphlab::vertex_id_type>("id");
+     *     schema.add<double>("rank");
+     *   }
+     *   void save_vertex(const graph_type::vertex_type& v,
+     *                    graphlab::column_row& row) const {
+     *     row << v.id() << v.data();
+     *   }
+     *   void edge_columns(graphlab::column_schema& schema) const { }
+     *   void save_edge(const graph_type::edge_type& e,
+     *                  graphlab::column_row& row) const { }
+     * };
+     * \endcode
+     * A vertex or edge for which save_vertex() or save_edge() writes
+     * nothing is skipped. The writer is shared by all the threads.
+     *
+     * The tables are written to [prefix].vertices.[i]_of_[n].glc and
+     * [prefix].edges.[i]_of_[n].glc, in the format of
+     * columnar_file_sink, with files_per_machine files of each table
+     * per machine. The files can be read back with
+     * columnar_file_reader. If prefix begins with "hdfs://", the files
+     * are written to HDFS.
+     */
+    template<typename ColumnWriter>
+    void save_columns(const std::string& prefix, ColumnWriter writer,
+                      bool save_vertex = true, bool save_edge = true,
+                      size_t files_per_machine = 4) {
+      rpc.full_barrier();
+      finalize();
+      const bool use_hdfs = boost::starts_with(prefix, "hdfs://");
+      if (use_hdfs && !hdfs::has_hadoop()) {
+        logstream(LOG_FATAL)
+          << "\n\tAttempting to save a graph to HDFS but GraphLab"
+          << "\n\twas built without HDFS."
+          << std::endl;
+      }
+      std::vector<std::ostream*> outstreams;
+      std::vector<icolumn_sink*> sinks[2];
+      for (size_t pass = 0; pass < 2; ++pass) {
+        if ((pass == 0 && !save_vertex) || (pass == 1 && !save_edge)) continue;
+        for (size_t i = 0; i < files_per_machine; ++i) {
+          const std::string fname = prefix + (pass == 0 ? ".vertices." : ".edges.")
+            + tostr(1 + i + rpc.procid() * files_per_machine) + "_of_"
+            + tostr(rpc.numprocs() * files_per_machine) + ".glc";
+          logstream(LOG_INFO) << "Saving to file: " << fname << std::endl;
+          if (use_hdfs) {
+            outstreams.push_back(
+              new graphlab::hdfs::fstream(hdfs::get_hdfs(), fname, true));
+          } else {
+            outstreams.push_back(
+              new std::ofstream(fname.c_str(),
+                                std::ios_base::out | std::ios_base::binary));
+          }
+          if (!outstreams.back()->good()) {
+            logstream(LOG_FATAL) << "\n\tError opening file: " << fname
+                                 << std::endl;
+          }
+          sinks[pass].push_back(new columnar_file_sink(*outstreams.back()));
+        }
+      }
+      save_columns_to_sinks(sinks[0], sinks[1], writer);
+      for (size_t pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < sinks[pass].size(); ++i) delete sinks[pass][i];
+      }
+      for (size_t i = 0; i < outstreams.size(); ++i) delete outstreams[i];
+      rpc.full_barrier();
+    } // end of save columns
+
+    /**
+     * \brief Saves the columns of the local vertices and edges like
+     * save_columns(), to the given sinks instead of files. The owned
+     * vertices go to vertex_sinks and the local edges to edge_sinks,
+     * either of which may be empty. Each sink is opened with the schema
+     * of its table, then receives the blocks of rows built by the
+     * threads, one at a time, and is closed. Does not communicate.
+     */
+    template<typename ColumnWriter>
+    void save_columns_to_sinks(const std::vector<icolumn_sink*>& vertex_sinks,
+                               const std::vector<icolumn_sink*>& edge_sinks,
+                               ColumnWriter& writer) {
+      ASSERT_TRUE(finalized);
+      const size_t nchunks =
+        (local_graph.num_vertices() + SAVE_CHUNK_VERTICES - 1) / SAVE_CHUNK_VERTICES;
+      for (size_t pass = 0; pass < 2; ++pass) {
+        const std::vector<icolumn_sink*>& sinks =
+          pass == 0 ? vertex_sinks : edge_sinks;
+        if (sinks.empty()) continue;
+        column_schema schema;
+        if (pass == 0) writer.vertex_columns(schema);
+        else writer.edge_columns(schema);
+        for (size_t i = 0; i < sinks.size(); ++i) sinks[i]->open(schema);
+        std::vector<mutex> locks(sinks.size());
+        atomic<size_t> next_chunk(0);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+          // reused by all the chunks of the thread
+          column_block block(schema);
+          column_row row(block);
+          while(1) {
+            const size_t c = next_chunk.inc_ret_last();
+            if (c >= nchunks) break;
+            const size_t out = c % sinks.size();
+            const size_t end = std::min(local_graph.num_vertices(),
+                                        size_t(c + 1) * SAVE_CHUNK_VERTICES);
+            for (lvid_type j = c * SAVE_CHUNK_VERTICES; j < end; ++j) {
+              if (pass == 0) {
+                if (lvid2owner[j] == rpc.procid()) {
+                  writer.save_vertex(vertex_type(l_vertex(j)), row);
+                  row.finish();
+                }
+              } else {
+                foreach(const local_edge_type& e, l_vertex(j).in_edges()) {
+                  writer.save_edge(edge_type(e), row);
+                  row.finish();
+                }
+              }
+              if (block.num_rows() >= SAVE_CHUNK_VERTICES) {
+                write_column_block(*sinks[out], locks[out], block);
+              }
+            }
+            write_column_block(*sinks[out], locks[out], block);
+          }
+        }
+        for (size_t i = 0; i < sinks.size(); ++i) {
+          if (!sinks[i]->close()) {
+            logstream(LOG_FATAL) << "Error writing the graph columns" << std::endl;
+          }
+        }
+      }
+    } // end of save columns to sinks
+
+
 
     /**
      * \brief Saves the graph in the specified format. This function should be
@@ -2122,7 +3414,8 @@ namespace graphlab {
      *               If prefix begins with "hdfs://", the output is written to
      *               HDFS.
      * \param format The file format to save in.
-     *               Either "tsv", "snap", "graphjrl" or "bin".
+     *               Either "tsv", "snap", "graphjrl", "bintsv4", "binedge"
+     *               or "bin".
      * \param gzip If gzip compression should be used. If set, all files will be
      *             appended with the .gz suffix. Defaults to true. Ignored
      *             if format == "bin".
@@ -2133,8 +3426,8 @@ namespace graphlab {
     void save_format(const std::string& prefix, const std::string& format,
                         bool gzip = true, size_t files_per_machine = 4) {
       if (format == "snap" || format == "tsv") {
-        save(prefix, builtin_parsers::tsv_writer<distributed_graph>(),
-             gzip, false, true, files_per_machine);
+        save_buffered(prefix, builtin_parsers::tsv_writer<distributed_graph>(),
+                      gzip, false, true, files_per_machine);
       } else if (format == "graphjrl") {
          save(prefix, builtin_parsers::graphjrl_writer<distributed_graph>(),
              gzip, true, true, files_per_machine);
@@ -2142,6 +3435,8 @@ namespace graphlab {
          save_binary(prefix);
       } else if (format == "bintsv4") {
          save_direct(prefix, gzip, &graph_type::save_bintsv4_to_stream);
+      } else if (format == "binedge") {
+         save_direct(prefix, gzip, &graph_type::save_binedge_to_stream);
       } else {
         logstream(LOG_FATAL)
           << "Unrecognized Format \"" << format << "\"!" << std::endl;
@@ -2160,6 +3455,42 @@ namespace graphlab {
      */
     void load_from_posixfs(std::string prefix,
                            line_parser_type line_parser) {
+      load_from_posixfs_impl(prefix, line_parser);
+    } // end of load from posixfs
+
+    /**
+     *  \brief Load a graph from a collection of files in stored on
+     *  the filesystem using a span parser. Like
+     *  \ref load_buffered(const std::string& path, span_parser_type span_parser)
+     *  but only loads from the filesystem.
+     */
+    void load_buffered_from_posixfs(std::string prefix,
+                                    span_parser_type span_parser) {
+      load_from_posixfs_impl(prefix, span_parser);
+    } // end of load buffered from posixfs
+
+  private:
+    /**
+     * A byte range [begin, end) of the file graph_files[file]. The
+     * owner is only used by the HDFS loader.
+     */
+    struct file_range : public IS_POD_TYPE {
+      size_t file, begin, end;
+      procid_t owner;
+      file_range() : file(0), begin(0), end(0), owner(0) { }
+      file_range(size_t file, size_t begin, size_t end, procid_t owner = 0) :
+        file(file), begin(begin), end(end), owner(owner) { }
+    };
+
+    /// See plan_hdfs_ranges()
+    enum { HDFS_LOCALITY_SLACK = 2 };
+
+    /// See save_to_streams()
+    enum { SAVE_CHUNK_VERTICES = 16 * 1024, SAVE_BLOCK_SIZE = 4 * 1024 * 1024 };
+
+    /// Loads files from the filesystem with either kind of parser
+    template <typename Parser>
+    void load_from_posixfs_impl(std::string prefix, Parser& parser) {
       std::string directory_name; std::string original_path(prefix);
       boost::filesystem::path path(prefix);
       std::string search_prefix;
@@ -2181,42 +3512,171 @@ namespace graphlab {
         logstream(LOG_WARNING) << "No files found matching " << original_path << std::endl;
       }
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
+      // Split the uncompressed and the BGZF files into byte ranges of
+      // at most load_chunk_size bytes. Other compressed files cannot be
+      // split and are loaded whole.
+      std::vector<file_range> ranges;
       for(size_t i = 0; i < graph_files.size(); ++i) {
-        if ((parallel_ingress && (i % rpc.numprocs() == rpc.procid()))
-            || (!parallel_ingress && (rpc.procid() == 0))) {
-          logstream(LOG_EMPH) << "Loading graph from file: " << graph_files[i] << std::endl;
-          // is it a gzip file ?
-          const bool gzip = boost::ends_with(graph_files[i], ".gz");
-          // open the stream
+        const bool gzip = boost::ends_with(graph_files[i], ".gz");
+        const size_t fsize = boost::filesystem::file_size(graph_files[i]);
+        bool splittable = !gzip;
+        if (gzip && fsize > load_chunk_size) {
           std::ifstream in_file(graph_files[i].c_str(),
                                 std::ios_base::in | std::ios_base::binary);
-          // attach gzip if the file is gzip
-          boost::iostreams::filtering_stream<boost::iostreams::input> fin;
-          // Using gzip filter
-          if (gzip) fin.push(boost::iostreams::gzip_decompressor());
-          fin.push(in_file);
-          const bool success = load_from_stream(graph_files[i], fin, line_parser);
-          if(!success) {
-            logstream(LOG_FATAL)
-              << "\n\tError parsing file: " << graph_files[i] << std::endl;
+          splittable = bgzf::is_bgzf(in_file, fsize);
+        }
+        if (!splittable || fsize <= load_chunk_size) {
+          ranges.push_back(file_range(i, 0, size_t(-1)));
+        } else {
+          for (size_t begin = 0; begin < fsize; begin += load_chunk_size) {
+            ranges.push_back(file_range(i, begin, std::min(fsize, begin + load_chunk_size)));
           }
-          fin.pop();
-          if (gzip) fin.pop();
         }
       }
+
+      parallel_for(0, ranges.size(),
+                   boost::bind(&distributed_graph::template load_posixfs_range<Parser>,
+                               this, boost::cref(graph_files), boost::cref(ranges),
+                               boost::ref(parser), _1), 1);
       rpc.full_barrier();
-    } // end of load from posixfs
+    } // end of load from posixfs impl
+
+    /// Loads ranges[i] of graph_files. Runs concurrently. See load_from_posixfs_impl()
+    template <typename Parser>
+    void load_posixfs_range(const std::vector<std::string>& graph_files,
+                            const std::vector<file_range>& ranges,
+                            Parser& parser, size_t i) {
+      const std::string& fname = graph_files[ranges[i].file];
+      if ((parallel_ingress && (input_owner(fname, i) == rpc.procid()))
+          || (!parallel_ingress && (rpc.procid() == 0))) {
+        if (ranges[i].begin == 0 && ranges[i].end == size_t(-1)) {
+          logstream(LOG_EMPH) << "Loading graph from file: " << fname << std::endl;
+        } else {
+          logstream(LOG_EMPH) << "Loading graph from file: " << fname
+                              << " bytes [" << ranges[i].begin << ", "
+                              << ranges[i].end << ")" << std::endl;
+        }
+        // is it a gzip file ?
+        const bool gzip = boost::ends_with(fname, ".gz");
+        if (gzip && !(ranges[i].begin == 0 && ranges[i].end == size_t(-1))) {
+          load_bgzf_range(fname, ranges[i], parser);
+          return;
+        }
+        // open the stream
+        std::ifstream in_file(fname.c_str(),
+                              std::ios_base::in | std::ios_base::binary);
+        // Skip to the first line which starts in the range. A line
+        // belongs to the range containing its first byte.
+        size_t line_begin = ranges[i].begin;
+        if (line_begin > 0) {
+          in_file.seekg(line_begin - 1);
+          if (in_file.get() != '\n') {
+            std::string partial_line;
+            std::getline(in_file, partial_line);
+            line_begin += partial_line.size() + 1;
+          }
+        }
+        if (line_begin >= ranges[i].end || !in_file.good()) return;
+        // attach gzip if the file is gzip
+        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+        // Using gzip filter
+        if (gzip) fin.push(boost::iostreams::gzip_decompressor());
+        fin.push(in_file);
+        const size_t max_bytes = ranges[i].end == size_t(-1) ?
+            size_t(-1) : ranges[i].end - line_begin;
+        const bool success = load_from_stream(fname, fin, parser,
+                                              max_bytes);
+        if(!success) {
+          logstream(LOG_FATAL)
+            << "\n\tError parsing file: " << fname << std::endl;
+        }
+        fin.pop();
+        if (gzip) fin.pop();
+      }
+    } // end of load posixfs range
+
+    /**
+     * Loads the byte range of a BGZF file. The range holds the blocks
+     * which start in it, and is decompressed from its first block. The
+     * lines are split between the ranges at the first newline of their
+     * first block: a range skips the text up to it and reads up to the
+     * one of the next range, across the blocks which follow.
+     */
+    template <typename Parser>
+    void load_bgzf_range(const std::string& fname, const file_range& range,
+                         Parser& parser) {
+      const size_t fsize = boost::filesystem::file_size(fname);
+      std::ifstream in_file(fname.c_str(),
+                            std::ios_base::in | std::ios_base::binary);
+      const size_t first = range.begin == 0 ? 0 :
+          bgzf::find_block(in_file, range.begin, fsize);
+      if (first >= range.end) return;
+      // the decompressed size of the blocks starting in the range
+      size_t span = 0;
+      size_t offset = first;
+      while (offset < range.end && offset < fsize) {
+        bgzf::block_info block;
+        if (!bgzf::read_block(in_file, offset, fsize, block)) {
+          logstream(LOG_FATAL) << "Corrupt BGZF block at byte " << offset
+                               << " of " << fname << std::endl;
+        }
+        span += block.uncompressed_size;
+        offset += block.compressed_size;
+      }
+      const bool last_range = offset >= fsize;
+      in_file.clear();
+      in_file.seekg(first);
+      boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+      fin.push(boost::iostreams::gzip_decompressor());
+      fin.push(in_file);
+      size_t skipped = 0;
+      if (first > 0) {
+        std::string partial_line;
+        std::getline(fin, partial_line);
+        skipped = partial_line.size() + 1;
+        // the first newline is past the range, which holds no line
+        if (!fin.good() || (!last_range && skipped > span)) return;
+      }
+      const size_t max_bytes = last_range ? size_t(-1) : span - skipped + 1;
+      const bool success = load_from_stream(fname, fin, parser, max_bytes);
+      if(!success) {
+        logstream(LOG_FATAL)
+          << "\n\tError parsing file: " << fname << std::endl;
+      }
+      fin.pop();
+      fin.pop();
+    } // end of load bgzf range
 
+  public:
     /**
      *  \brief Load a graph from a collection of files in stored on
      *  the HDFS using the user defined line parser. Like
      *  \ref load(const std::string& path, line_parser_type line_parser)
      *  but only loads from HDFS.
+     *
+     *  Uncompressed files are split into their HDFS blocks, and each
+     *  block is preferably loaded by a machine running on one of the
+     *  datanodes which hold it.
      */
     void load_from_hdfs(std::string prefix, line_parser_type line_parser) {
+      load_from_hdfs_impl(prefix, line_parser);
+    } // end of load from hdfs
+
+    /**
+     *  \brief Load a graph from a collection of files in stored on
+     *  the HDFS using a span parser. Like
+     *  \ref load_buffered(const std::string& path, span_parser_type span_parser)
+     *  but only loads from HDFS.
+     */
+    void load_buffered_from_hdfs(std::string prefix,
+                                 span_parser_type span_parser) {
+      load_from_hdfs_impl(prefix, span_parser);
+    } // end of load buffered from hdfs
+
+  private:
+    /// Loads files from HDFS with either kind of parser
+    template <typename Parser>
+    void load_from_hdfs_impl(std::string prefix, Parser& parser) {
       // force a "/" at the end of the path
       // make sure to check that the path is non-empty. (you do not
       // want to make the empty path "" the root path "/" )
@@ -2231,34 +3691,137 @@ namespace graphlab {
       hdfs& hdfs = hdfs::get_hdfs();
       std::vector<std::string> graph_files;
       graph_files = hdfs.list_files(path);
+      // every machine must index the files the same way
+      std::sort(graph_files.begin(), graph_files.end());
       if (graph_files.size() == 0) {
         logstream(LOG_WARNING) << "No files found matching " << prefix << std::endl;
       }
+
+      std::vector<std::string> hostnames(rpc.numprocs());
+      char hostname[1024];
+      if (gethostname(hostname, sizeof(hostname)) == 0) {
+        hostname[sizeof(hostname) - 1] = '\0';
+        hostnames[rpc.procid()] = hostname;
+      }
+      rpc.all_gather(hostnames);
+      std::vector<file_range> ranges;
+      if (rpc.procid() == 0) plan_hdfs_ranges(hdfs, graph_files, hostnames, ranges);
+      rpc.broadcast(ranges, rpc.procid() == 0);
+
+      // Threads read different blocks, of the same file or not, at
+      // the same time.
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic, 1)
 #endif
+      for(ssize_t i = 0; i < ssize_t(ranges.size()); ++i) {
+        if (ranges[i].owner != rpc.procid()) continue;
+        const std::string& fname = graph_files[ranges[i].file];
+        if (ranges[i].begin == 0 && ranges[i].end == size_t(-1)) {
+          logstream(LOG_EMPH) << "Loading graph from file: " << fname << std::endl;
+        } else {
+          logstream(LOG_EMPH) << "Loading graph from file: " << fname
+                              << " bytes [" << ranges[i].begin << ", "
+                              << ranges[i].end << ")" << std::endl;
+        }
+        // is it a gzip file ?
+        const bool gzip = boost::ends_with(fname, ".gz");
+        // open the stream just before the range so that we can tell
+        // whether a line starts at its first byte
+        size_t line_begin = ranges[i].begin;
+        graphlab::hdfs::hdfs_device device(hdfs, fname, false,
+                                           line_begin > 0 ? line_begin - 1 : 0);
+        graphlab::hdfs::fstream in_file(device);
+        if (line_begin > 0 && in_file.get() != '\n') {
+          std::string partial_line;
+          std::getline(in_file, partial_line);
+          line_begin += partial_line.size() + 1;
+        }
+        if (line_begin >= ranges[i].end || !in_file.good()) continue;
+        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+        if(gzip) fin.push(boost::iostreams::gzip_decompressor());
+        fin.push(in_file);
+        const size_t max_bytes = ranges[i].end == size_t(-1) ?
+            size_t(-1) : ranges[i].end - line_begin;
+        const bool success = load_from_stream(fname, fin, parser, max_bytes);
+        if(!success) {
+          logstream(LOG_FATAL)
+            << "\n\tError parsing file: " << fname << std::endl;
+        }
+        fin.pop();
+        if (gzip) fin.pop();
+      }
+      rpc.full_barrier();
+    } // end of load from hdfs impl
+
+    /// Returns true if the two host names are the same up to the domain
+    static bool same_host(const std::string& a, const std::string& b) {
+      return a.substr(0, a.find('.')) == b.substr(0, b.find('.'));
+    }
+
+    /**
+     * Splits the HDFS files into byte ranges of one block each and
+     * picks the machine which loads each range. A block goes to the
+     * least loaded machine running on one of the datanodes holding
+     * it, unless that machine already has HDFS_LOCALITY_SLACK blocks
+     * more than the least loaded machine. Compressed files cannot be
+     * split and are loaded whole.
+     */
+    void plan_hdfs_ranges(hdfs& hdfs, const std::vector<std::string>& graph_files,
+                          const std::vector<std::string>& hostnames,
+                          std::vector<file_range>& ranges) {
+      std::vector<size_t> load(rpc.numprocs(), 0);
+      size_t nlocal = 0, nblocks = 0;
       for(size_t i = 0; i < graph_files.size(); ++i) {
-        if ((parallel_ingress && (i % rpc.numprocs() == rpc.procid())) ||
-            (!parallel_ingress && (rpc.procid() == 0))) {
-          logstream(LOG_EMPH) << "Loading graph from file: " << graph_files[i] << std::endl;
-          // is it a gzip file ?
-          const bool gzip = boost::ends_with(graph_files[i], ".gz");
-          // open the stream
-          graphlab::hdfs::fstream in_file(hdfs, graph_files[i]);
-          boost::iostreams::filtering_stream<boost::iostreams::input> fin;
-          if(gzip) fin.push(boost::iostreams::gzip_decompressor());
-          fin.push(in_file);
-          const bool success = load_from_stream(graph_files[i], fin, line_parser);
-          if(!success) {
-            logstream(LOG_FATAL)
-              << "\n\tError parsing file: " << graph_files[i] << std::endl;
+        const std::string& fname = graph_files[i];
+        if (!parallel_ingress) {
+          ranges.push_back(file_range(i, 0, size_t(-1), 0));
+          continue;
+        }
+        if (precomputed_ingress || boost::ends_with(fname, ".gz")) {
+          ranges.push_back(file_range(i, 0, size_t(-1),
+                                      input_owner(fname, ranges.size())));
+          continue;
+        }
+        size_t block_size = 0;
+        const size_t fsize = hdfs.file_size(fname, block_size);
+        if (block_size == 0) block_size = load_chunk_size;
+        for (size_t begin = 0; begin < fsize; begin += block_size) {
+          const size_t end = std::min(fsize, begin + block_size);
+          const std::vector<std::vector<std::string> > hosts =
+            hdfs.block_hosts(fname, begin, end - begin);
+          const procid_t least_loaded =
+            std::min_element(load.begin(), load.end()) - load.begin();
+          procid_t owner = least_loaded;
+          bool found_local = false;
+          for (procid_t p = 0; p < rpc.numprocs(); ++p) {
+            if (load[p] > load[least_loaded] + HDFS_LOCALITY_SLACK * block_size)
+              continue;
+            if (found_local && load[p] >= load[owner]) continue;
+            bool local = false;
+            if (!hosts.empty()) {
+              foreach(const std::string& host, hosts[0]) {
+                local = local || same_host(host, hostnames[p]);
+              }
+            }
+            if (local) {
+              owner = p;
+              found_local = true;
+            }
           }
-          fin.pop();
-          if (gzip) fin.pop();
+          if (found_local) ++nlocal;
+          load[owner] += end - begin;
+          ++nblocks;
+          ranges.push_back(file_range(i, begin, end, owner));
         }
       }
-      rpc.full_barrier();
-    } // end of load from hdfs
+      if (nblocks > 0) {
+        logstream(LOG_EMPH) << nlocal << " of " << nblocks
+                            << " HDFS blocks are loaded by a machine on one "
+                            << "of their datanodes" << std::endl;
+      }
+    } // end of plan hdfs ranges
+
+  public:
 
 
     /**
@@ -2341,6 +3904,31 @@ namespace graphlab {
       rpc.full_barrier();
     } // end of load
 
+    /**
+     *  \brief Load the graph from a given path using a span parser.
+     *  Like \ref load(std::string prefix, line_parser_type line_parser)
+     *  but the files are read in large blocks and every line is handed
+     *  to the parser in place as a [begin, end) character range, so no
+     *  memory is allocated per line. The parser must not keep the range.
+     *  The throughput of every file is reported in MB/s.
+     *
+     *  \param span_parser A function of the form:
+     *  \code
+     *  bool span_parser(graph_type& graph, const std::string& filename,
+     *                   const char* begin, const char* end);
+     *  \endcode
+     */
+    void load_buffered(std::string prefix, span_parser_type span_parser) {
+      rpc.full_barrier();
+      if (prefix.length() == 0) return;
+      if(boost::starts_with(prefix, "hdfs://")) {
+        load_buffered_from_hdfs(prefix, span_parser);
+      } else {
+        load_buffered_from_posixfs(prefix, span_parser);
+      }
+      rpc.full_barrier();
+    } // end of load buffered
+
     /**
      * \brief Constructs a synthetic power law graph. Must be called on
      * all machines simultaneously.
@@ -2400,7 +3988,102 @@ namespace graphlab {
         }
       }
       rpc.full_barrier();
-    } // end of load random powerlaw
+    } // end of load random powerlaw
+
+
+    /**
+     * \brief Constructs a synthetic Graph500 style R-MAT (Kronecker)
+     * graph with 2^scale vertices and edge_factor * 2^scale edges. Must
+     * be called on all machines simultaneously.
+     *
+     * The edges are drawn in parallel by all the threads of all the
+     * machines, and are handed to the ingress in blocks. The graph only
+     * depends on the parameters and the seed. Self edges are dropped,
+     * and duplicate edges are kept as in Graph500.
+     *
+     * \param scale The log2 of the number of vertices
+     * \param edge_factor The average out-degree. Defaults to 16
+     * \param a,b,c The probabilities of the top left, top right and bottom
+     *              left quadrants. Default to the Graph500 values
+     * \param seed The seed of the generator
+     *
+     * \see graphlab::synthetic_graph::rmat_generator
+     */
+    void load_synthetic_rmat(size_t scale, size_t edge_factor = 16,
+                             double a = 0.57, double b = 0.19, double c = 0.19,
+                             uint64_t seed = 0) {
+      ASSERT_LT(scale, 8 * sizeof(vertex_id_type));
+      const synthetic_graph::rmat_generator generator(scale, a, b, c);
+      load_synthetic(generator, edge_factor * generator.num_vertices(), seed);
+    } // end of load synthetic rmat
+
+
+    /**
+     * \brief Constructs a synthetic Chung-Lu graph of nverts vertices
+     * with a power law degree distribution and average_degree * nverts
+     * edges. Must be called on all machines simultaneously.
+     *
+     * Unlike load_synthetic_powerlaw(), both the in and out degrees
+     * follow the power law, no per vertex table is built, and the edges
+     * are drawn in parallel by all the threads of all the machines. The
+     * graph only depends on the parameters and the seed. Self edges are
+     * dropped.
+     *
+     * \param nverts Number of vertices to generate
+     * \param average_degree The average out-degree
+     * \param alpha The exponent of the power law, which must be above 2.
+     *              Defaults to 2.1
+     * \param seed The seed of the generator
+     *
+     * \see graphlab::synthetic_graph::chung_lu_generator
+     */
+    void load_synthetic_chung_lu(size_t nverts, size_t average_degree, 
+                                 double alpha = 2.1, uint64_t seed = 0) {
+      const synthetic_graph::chung_lu_generator generator(nverts, alpha);
+      load_synthetic(generator, average_degree * nverts, seed);
+    } // end of load synthetic chung lu
+
+
+    /**
+     * \brief Adds nedges edges drawn by generator. Every machine draws
+     * its share of the blocks of synthetic_graph::BLOCK_SIZE edges in
+     * parallel.
+     */
+    template <typename Generator>
+    void load_synthetic(const Generator& generator, size_t nedges, uint64_t seed) {
+      rpc.full_barrier();
+      const size_t nblocks = 
+          (nedges + synthetic_graph::BLOCK_SIZE - 1) / synthetic_graph::BLOCK_SIZE;
+      // this machine draws the blocks procid, procid + numprocs, ...
+      const size_t nlocal = nblocks <= rpc.procid() ? 0 :
+          (nblocks - rpc.procid() + rpc.numprocs() - 1) / rpc.numprocs();
+      parallel_for(0, nlocal,
+                   boost::bind(&distributed_graph::template add_synthetic_block<Generator>,
+                               this, boost::cref(generator), nedges, seed, _1), 1);
+      rpc.full_barrier();
+    } // end of load synthetic
+
+    /// Adds the i-th block of this machine. Runs concurrently. See load_synthetic()
+    template <typename Generator>
+    void add_synthetic_block(const Generator& generator, size_t nedges, 
+                             uint64_t seed, size_t i) {
+      const size_t block = rpc.procid() + i * rpc.numprocs();
+      const size_t begin = block * synthetic_graph::BLOCK_SIZE;
+      const size_t end = std::min(nedges, begin + synthetic_graph::BLOCK_SIZE);
+      random::counter_generator rng(seed, block);
+      std::vector<vertex_id_type> sources, targets;
+      sources.reserve(end - begin);
+      targets.reserve(end - begin);
+      for (size_t e = begin; e < end; ++e) {
+        const std::pair<uint64_t, uint64_t> edge = generator(rng);
+        if (edge.first == edge.second) continue;
+        sources.push_back(edge.first);
+        targets.push_back(edge.second);
+      }
+      if (!sources.empty()) {
+        add_edge_block(&sources[0], &targets[0], NULL, sources.size());
+      }
+    } // end of add synthetic block
 
 
     /**
@@ -2411,23 +4094,26 @@ namespace graphlab {
      */
     void load_format(const std::string& path, const std::string& format) {
       line_parser_type line_parser;
+      span_parser_type span_parser;
       if (format == "snap") {
-        line_parser = builtin_parsers::snap_parser<distributed_graph>;
-        load(path, line_parser);
+        span_parser = builtin_parsers::snap_span_parser<distributed_graph>;
+        load_buffered(path, span_parser);
       } else if (format == "adj") {
-        line_parser = builtin_parsers::adj_parser<distributed_graph>;
-        load(path, line_parser);
+        span_parser = builtin_parsers::adj_span_parser<distributed_graph>;
+        load_buffered(path, span_parser);
       } else if (format == "tsv") {
-        line_parser = builtin_parsers::tsv_parser<distributed_graph>;
-        load(path, line_parser);
+        span_parser = builtin_parsers::tsv_span_parser<distributed_graph>;
+        load_buffered(path, span_parser);
       } else if (format == "csv") {
-        line_parser = builtin_parsers::csv_parser<distributed_graph>;
-        load(path, line_parser);
+        span_parser = builtin_parsers::csv_span_parser<distributed_graph>;
+        load_buffered(path, span_parser);
       } else if (format == "graphjrl") {
         line_parser = builtin_parsers::graphjrl_parser<distributed_graph>;
         load(path, line_parser);
       } else if (format == "bintsv4") {
          load_direct(path,&graph_type::load_bintsv4_from_stream);
+      } else if (format == "binedge") {
+         load_direct(path,&graph_type::load_binedge_from_stream);
       } else if (format == "bin") {
          load_binary(path);
       } else {
@@ -2458,6 +4144,31 @@ namespace graphlab {
      return vertex_set(true);
    }
 
+   /** \internal
+    * \brief Adds the neighbors of each visited lvid to a vertex set.
+    * Used by neighbors().
+    */
+   struct neighbor_visitor {
+     distributed_graph* graph;
+     vertex_set* ret;
+     edge_dir_type edir;
+     neighbor_visitor(distributed_graph* graph, vertex_set* ret,
+                      edge_dir_type edir) :
+         graph(graph), ret(ret), edir(edir) { }
+     void operator()(size_t lvid) const {
+       if (edir == IN_EDGES || edir == ALL_EDGES) {
+         foreach(local_edge_type e, graph->l_vertex(lvid).in_edges()) {
+           ret->set_lvid_unsync(e.source().id());
+         }
+       }
+       if (edir == OUT_EDGES || edir == ALL_EDGES) {
+         foreach(local_edge_type e, graph->l_vertex(lvid).out_edges()) {
+           ret->set_lvid_unsync(e.target().id());
+         }
+       }
+     }
+   };
+
    ///
    vertex_set neighbors(const vertex_set& cur,
                         edge_dir_type edir) {
@@ -2466,18 +4177,7 @@ namespace graphlab {
      vertex_set ret(empty_set());
      ret.make_explicit(*this);
 
-     foreach(size_t lvid, cur.get_lvid_bitset(*this)) {
-       if (edir == IN_EDGES || edir == ALL_EDGES) {
-         foreach(local_edge_type e, l_vertex(lvid).in_edges()) {
-           ret.set_lvid_unsync(e.source().id());
-         }
-       }
-       if (edir == OUT_EDGES || edir == ALL_EDGES) {
-         foreach(local_edge_type e, l_vertex(lvid).out_edges()) {
-           ret.set_lvid_unsync(e.target().id());
-         }
-       }
-     }
+     cur.for_each_lvid(*this, neighbor_visitor(this, &ret, edir));
      ret.synchronize_mirrors_to_master_or(*this, vset_exchange);
      ret.synchronize_master_to_mirrors(*this, vset_exchange);
      return ret;
@@ -2530,7 +4230,7 @@ namespace graphlab {
         #pragma omp for
 #endif
      for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-       if (lvid2record[i].owner == rpc.procid() &&
+       if (lvid2owner[i] == rpc.procid() &&
            vset.l_contains((lvid_type)i)) {
          const vertex_type vtx(l_vertex(i));
          if (select_functor(vtx)) ret.set_lvid(i);
@@ -2559,7 +4259,7 @@ namespace graphlab {
    size_t vertex_set_size(const vertex_set& vset) {
      size_t count = 0;
      for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-        count += (lvid2record[i].owner == rpc.procid() &&
+        count += (lvid2owner[i] == rpc.procid() &&
                   vset.l_contains((lvid_type)i));
      }
      rpc.all_reduce(count);
@@ -2576,7 +4276,8 @@ namespace graphlab {
    bool vertex_set_empty(const vertex_set& vset) {
      if (vset.lazy) return !vset.is_complete_set;
 
-     size_t count = vset.get_lvid_bitset(*this).empty();
+     size_t count = vset.is_compressed ? vset.compressed.empty()
+                                       : vset.get_lvid_bitset(*this).empty();
      rpc.all_reduce(count);
      return count == rpc.numprocs();
    }
@@ -2658,6 +4359,25 @@ namespace graphlab {
      *\brief Get the Total number of vertex replicas in the graph */
     size_t num_replicas() const { return nreplicas; }
 
+    /**
+     * \brief Returns the partition quality statistics computed by the
+     * last call to finalize(): the replication factor, the edge and
+     * vertex balance, the replication of high degree vertices and the
+     * time spent in each ingress phase.
+     */
+    const partition_report& get_partition_report() const {
+      return partition_stats;
+    }
+
+    /**
+     * \brief Returns the fraction of the input edges kept by the
+     * ingress (see the edge_sample_rate option). Estimators computed on
+     * the graph should be corrected by it.
+     */
+    double get_edge_sample_rate() const {
+      return edge_sample_rate;
+    }
+
     /** \internal
      *\brief Get the number of vertices local to this proc */
     size_t num_local_vertices() const { return local_graph.num_vertices(); }
@@ -2675,10 +4395,47 @@ namespace graphlab {
     lvid_type local_vid (const vertex_id_type vid) const {
       // typename boost::unordered_map<vertex_id_type, lvid_type>::
       //   const_iterator iter = vid2lvid.find(vid);
+      if (identity_vid2lvid) return vid;
+      if (!frozen_vid2lvid.empty()) {
+        lvid_type lvid(-1);
+        frozen_vid2lvid.find(vid, lvid);
+        return lvid;
+      }
       typename hopscotch_map_type::const_iterator iter = vid2lvid.find(vid);
       return iter->second;
     } // end of local_vertex_id
 
+    /** \internal
+     * \brief Converts the n global vids gvids[0 .. n) to local vids,
+     * setting lvids[i] to lvid_type(-1) for the vids which have no local
+     * instance. Returns the number of vids found.
+     *
+     * Prefetches ahead of the lookups, so the exchange receive loops
+     * should convert a whole buffer of vids at once.
+     */
+    size_t local_vids(const vertex_id_type* gvids, size_t n,
+                      lvid_type* lvids) const {
+      if (identity_vid2lvid) {
+        size_t found = 0;
+        for (size_t i = 0; i < n; ++i) {
+          const bool local = gvids[i] < lvid2record.size();
+          lvids[i] = local ? lvid_type(gvids[i]) : lvid_type(-1);
+          found += local;
+        }
+        return found;
+      }
+      if (!frozen_vid2lvid.empty()) {
+        return frozen_vid2lvid.find_many(gvids, n, lvids, lvid_type(-1));
+      }
+      size_t found = 0;
+      for (size_t i = 0; i < n; ++i) {
+        typename hopscotch_map_type::const_iterator iter = vid2lvid.find(gvids[i]);
+        lvids[i] = iter != vid2lvid.end() ? iter->second : lvid_type(-1);
+        found += iter != vid2lvid.end();
+      }
+      return found;
+    }
+
     /** \internal
      *\brief Convert a local vid to a global vid */
     vertex_id_type global_vid(const lvid_type lvid) const {
@@ -2692,6 +4449,11 @@ namespace graphlab {
      * of the vertex ID.
      */
     bool contains_vertex(const vertex_id_type vid) const {
+      if (identity_vid2lvid) return vid < lvid2record.size();
+      if (!frozen_vid2lvid.empty()) {
+        lvid_type lvid;
+        return frozen_vid2lvid.find(vid, lvid);
+      }
       return vid2lvid.find(vid) != vid2lvid.end();
     }
     /**
@@ -2738,6 +4500,68 @@ namespace graphlab {
       return local_graph.num_out_edges(lvid);
     }
 
+    /**
+     * \internal
+     * \brief Returns a span over the in edges of a local vertex ID on
+     *        the local graph
+     */
+    local_edge_span_type l_in_edge_span(const lvid_type lvid) {
+      return local_edge_span_type(*this, local_graph.in_edge_span(lvid));
+    }
+
+    /**
+     * \internal
+     * \brief Returns a span over the out edges of a local vertex ID on
+     *        the local graph
+     */
+    local_edge_span_type l_out_edge_span(const lvid_type lvid) {
+      return local_edge_span_type(*this, local_graph.out_edge_span(lvid));
+    }
+
+    /**
+     * \internal
+     * \brief Returns the local edge with the given local id from the
+     *        local vertex source to the local vertex target
+     */
+    local_edge_type l_edge(const lvid_type source, const lvid_type target,
+                           const edge_id_type eid) {
+      return local_edge_type(*this,
+          typename local_graph_type::edge_type(local_graph, source, target, eid));
+    }
+
+    /**
+     * \internal
+     * \brief Prefetches the neighbors of a local vertex ahead of a loop
+     * over its edges. See local_graph::neighbor_prefetcher.
+     */
+    typedef typename local_graph_type::neighbor_prefetcher
+        local_neighbor_prefetcher_type;
+
+    local_neighbor_prefetcher_type
+    l_neighbor_prefetcher(const lvid_type lvid, bool in_edges,
+                          size_t distance) const {
+      return local_neighbor_prefetcher_type(local_graph, lvid, in_edges,
+                                            distance);
+    }
+
+    /**
+     * \internal
+     * \brief Prefetches the positions of the edges of a local vertex.
+     * See local_graph::prefetch_edge_index().
+     */
+    void l_prefetch_edge_index(const lvid_type lvid) const {
+      local_graph.prefetch_edge_index(lvid);
+    }
+
+    /**
+     * \internal
+     * \brief Prefetches the data and the first edges of a local vertex.
+     * See local_graph::prefetch_edge_lists().
+     */
+    void l_prefetch_edge_lists(const lvid_type lvid) const {
+      local_graph.prefetch_edge_lists(lvid);
+    }
+
     procid_t procid() const {
       return rpc.procid();
     }
@@ -2757,11 +4581,8 @@ namespace graphlab {
      * \brief Returns the internal vertex record of a given global vertex ID
      */
     const vertex_record& get_vertex_record(vertex_id_type vid) const {
-      // typename boost::unordered_map<vertex_id_type, lvid_type>::
-      //   const_iterator iter = vid2lvid.find(vid);
-      typename hopscotch_map_type::const_iterator iter = vid2lvid.find(vid);
-      ASSERT_TRUE(iter != vid2lvid.end());
-      return lvid2record[iter->second];
+      ASSERT_TRUE(contains_vertex(vid));
+      return lvid2record[local_vid(vid)];
     }
 
     /** \internal
@@ -2785,31 +4606,63 @@ namespace graphlab {
      *        master vertex on this machine and false otherwise.
      */
     bool is_master(vertex_id_type vid) const {
+      if (masters_moved) {
+        lvid_type lvid(-1);
+        return find_local_vid(vid, lvid) && l_is_master(lvid);
+      }
       const procid_t owning_proc = graph_hash::hash_vertex(vid) % rpc.numprocs();
       return (owning_proc == rpc.procid());
     }
 
-
+    /** \internal
+     * \brief Returns the machine to send the requests for vertex vid to.
+     *
+     * Once masters were moved away from the machines given by the hash
+     * of their ids (see move_masters()), this is only the master if
+     * this machine has a replica of vid. Otherwise it is the machine
+     * given by the hash of vid, which always has a replica and forwards
+     * the requests to the master.
+     */
     procid_t master(vertex_id_type vid) const {
+      if (masters_moved) {
+        lvid_type lvid(-1);
+        if (find_local_vid(vid, lvid)) return l_master(lvid);
+      }
       const procid_t owning_proc = graph_hash::hash_vertex(vid) % rpc.numprocs();
       return owning_proc;
     }
 
+    /** \internal
+     * \brief Sets lvid to the local id of vid and returns true if this
+     * machine has a replica of vid.
+     */
+    bool find_local_vid(vertex_id_type vid, lvid_type& lvid) const {
+      if (identity_vid2lvid) {
+        lvid = vid;
+        return vid < lvid2record.size();
+      }
+      if (!frozen_vid2lvid.empty()) return frozen_vid2lvid.find(vid, lvid);
+      typename hopscotch_map_type::const_iterator iter = vid2lvid.find(vid);
+      if (iter == vid2lvid.end()) return false;
+      lvid = iter->second;
+      return true;
+    }
+
     /** \internal
      * \brief Returns true if the provided local vertex ID is a master vertex.
      *        Returns false otherwise.
      */
     bool l_is_master(lvid_type lvid) const {
-      ASSERT_LT(lvid, lvid2record.size());
-      return lvid2record[lvid].owner == rpc.procid();
+      ASSERT_LT(lvid, lvid2owner.size());
+      return lvid2owner[lvid] == rpc.procid();
     }
 
     /** \internal
      * \brief Returns the master procid for vertex lvid.
      */
     procid_t l_master(lvid_type lvid) const {
-      ASSERT_LT(lvid, lvid2record.size());
-      return lvid2record[lvid].owner;
+      ASSERT_LT(lvid, lvid2owner.size());
+      return lvid2owner[lvid];
     }
 
 
@@ -2835,7 +4688,10 @@ namespace graphlab {
      * This function must be called simultaneously by all machines
      */
     void synchronize(const vertex_set& vset = complete_set()) {
-      typedef std::pair<vertex_id_type, vertex_data_type> pair_type;
+      // the vertices are identified by their position in the shared
+      // vertex index
+      typedef std::pair<shared_vertex_index::position_type, vertex_data_type> pair_type;
+      ASSERT_TRUE(shared_index.is_built());
 
       procid_t sending_proc;
       // Loop over all the local vertex records
@@ -2849,9 +4705,12 @@ namespace graphlab {
         const vertex_record& record = lvid2record[lvid];
         // if this machine is the owner of a record then send the
         // vertex data to all mirrors
-        if(record.owner == rpc.procid() && vset.l_contains(lvid)) {
+        if(lvid2owner[lvid] == rpc.procid() && vset.l_contains(lvid)) {
+          const shared_vertex_index::position_type* positions = 
+            shared_index.positions(lvid);
+          size_t k = 0;
           foreach(size_t proc, record.mirrors()) {
-            const pair_type pair(record.gvid, local_graph.vertex_data(lvid));
+            const pair_type pair(positions[k++], local_graph.vertex_data(lvid));
 #ifdef _OPENMP
             vertex_exchange.send(proc, pair, omp_get_thread_num());
 #else
@@ -2862,7 +4721,8 @@ namespace graphlab {
         // Receive any vertex data and update local mirrors
         while(vertex_exchange.recv(sending_proc, recv_buffer, true)) {
           foreach(const pair_type& pair, recv_buffer)  {
-            vertex(pair.first).data() = pair.second;
+            local_graph.vertex_data(shared_index.mirror_lvid(sending_proc, pair.first))
+              = pair.second;
           }
           recv_buffer.clear();
         }
@@ -2873,7 +4733,8 @@ namespace graphlab {
       vertex_exchange.flush();
       while(vertex_exchange.recv(sending_proc, recv_buffer)) {
         foreach(const pair_type& pair, recv_buffer) {
-          vertex(pair.first).data() = pair.second;
+          local_graph.vertex_data(shared_index.mirror_lvid(sending_proc, pair.first))
+            = pair.second;
         }
         recv_buffer.clear();
       }
@@ -2907,12 +4768,12 @@ namespace graphlab {
       }
 
       /// \brief Returns a reference to the data on the local vertex
-      const vertex_data_type& data() const {
+      vertex_data_const_reference data() const {
         return graph_ref.get_local_graph().vertex_data(lvid);
       }
 
       /// \brief Returns a reference to the data on the local vertex
-      vertex_data_type& data() {
+      vertex_data_reference data() {
         return graph_ref.get_local_graph().vertex_data(lvid);
       }
 
@@ -2957,13 +4818,13 @@ namespace graphlab {
       /** \brief Returns the owner of this local vertex
        */
       procid_t owner() const {
-        return graph_ref.l_get_vertex_record(lvid).owner;
+        return graph_ref.l_master(lvid);
       }
 
       /** \brief Returns the owner of this local vertex
        */
       bool owned() const {
-        return graph_ref.l_get_vertex_record(lvid).owner == graph_ref.procid();
+        return graph_ref.l_is_master(lvid);
       }
 
       /** \brief Returns the number of in_edges of this vertex
@@ -3029,10 +4890,10 @@ namespace graphlab {
 
 
       /// \brief Returns a constant reference to the data on the vertex
-      const edge_data_type& data() const { return e.data(); }
+      edge_data_const_reference data() const { return e.data(); }
 
       /// \brief Returns a reference to the data on the vertex
-      edge_data_type& data() { return e.data(); }
+      edge_data_reference data() { return e.data(); }
 
       /// \brief Returns the internal ID of this edge
       edge_id_type id() const { return e.id(); }
@@ -3113,6 +4974,52 @@ namespace graphlab {
     };
 
 
+    /** \internal
+     * \brief A read only view of the local in or out edges of a vertex
+     * taken directly from the local graph storage.  Used by
+     * l_in_edge_span() and l_out_edge_span() for batch gathers (see
+     * \ref graphlab::ivertex_program::gather_batch).
+     */
+    struct local_edge_span_type {
+      distributed_graph& graph_ref;
+      typename local_graph_type::edge_span span;
+
+      local_edge_span_type(distributed_graph& graph_ref,
+                           typename local_graph_type::edge_span span) :
+                          graph_ref(graph_ref), span(span) { }
+
+      /// \brief Returns the number of edges in the span
+      size_t size() const { return span.size(); }
+
+      /// \brief Returns true if the span contains no edges
+      bool empty() const { return span.empty(); }
+
+      /// \brief Returns true if the span holds out edges
+      bool is_out_edges() const { return span.is_out_edges(); }
+
+      /// \brief Returns the local id of the other end of the i'th edge
+      lvid_type neighbor_lvid(size_t i) const { return span.neighbor(i); }
+
+      /// \brief Returns the local id of the i'th edge
+      edge_id_type edge_id(size_t i) const { return span.edge_id(i); }
+
+      /// \brief Returns the vertex at the other end of the i'th edge
+      vertex_type neighbor(size_t i) const {
+        return vertex_type(graph_ref, span.neighbor(i));
+      }
+
+      /// \brief Returns the data on the other end of the i'th edge
+      const vertex_data_type& neighbor_data(size_t i) const {
+        return span.neighbor_data(i);
+      }
+
+      /// \brief Returns the data on the i'th edge
+      const edge_data_type& edge_data(size_t i) const {
+        return span.edge_data(i);
+      }
+    };
+
+
   private:
 
     // PRIVATE DATA MEMBERS ===================================================>
@@ -3129,12 +5036,19 @@ namespace graphlab {
   private:
     bool finalized;
 
+    /** The memory_accounting source of the local graph */
+    size_t memory_source_id;
+
     /** The local graph data */
     local_graph_type local_graph;
 
     /** The map from global vertex ids to vertex records */
     std::vector<vertex_record>  lvid2record;
 
+    /** The owners of the vertex records, kept apart so that l_is_master()
+        and the loops over the local masters read a dense array */
+    std::vector<procid_t> lvid2owner;
+
     // boost::unordered_map<vertex_id_type, lvid_type> vid2lvid;
     /** The map from global vertex ids back to local vertex ids */
     typedef hopscotch_map<vertex_id_type, lvid_type> hopscotch_map_type;
@@ -3142,6 +5056,14 @@ namespace graphlab {
 
     hopscotch_map_type vid2lvid;
 
+    /** A read only copy of vid2lvid, built by finalize() and used by
+        all the lookups while it is not empty */
+    frozen_hash_map<vertex_id_type, lvid_type> frozen_vid2lvid;
+
+    /** True if every vertex has its global id as local id, in which case
+        the lookups skip vid2lvid and frozen_vid2lvid is empty */
+    bool identity_vid2lvid;
+
 
     /** The global number of vertices and edges */
     size_t nverts, nedges;
@@ -3156,27 +5078,250 @@ namespace graphlab {
     distributed_ingress_base<VertexData, EdgeData>* ingress_ptr;
 
     /** Buffered Exchange used by synchronize() */
-    buffered_exchange<std::pair<vertex_id_type, vertex_data_type> > vertex_exchange;
+    buffered_exchange<std::pair<shared_vertex_index::position_type, vertex_data_type> > vertex_exchange;
 
     /** Buffered Exchange used by vertex sets */
     buffered_exchange<vertex_id_type> vset_exchange;
 
+    /** Buffered Exchange used by vertex sets once the shared vertex index is built */
+    buffered_exchange<shared_set_message> shared_set_exchange;
+
+    /** The local vertices shared with each machine. See shared_vertex_index */
+    shared_vertex_index shared_index;
+
     /** Command option to disable parallel ingress. Used for simulating single node ingress */
     bool parallel_ingress;
 
+    /** Uncompressed files are loaded in byte ranges of this size */
+    size_t load_chunk_size;
+
+    /** Input shards are loaded by the machine they were written by */
+    bool precomputed_ingress;
+
+    /** The relabelling of the local vertices applied by finalize() */
+    std::string vertex_order;
+
+    /** The NUMA placement of the local vertex and edge data */
+    std::string numa_memory;
+
+    /** Whether finalize() backs the graph arrays with huge pages */
+    std::string huge_pages_mode;
+
+    /** finalize() moves the edges to this directory if not empty */
+    std::string out_of_core_dir;
+
+    /** The edge arrays of the local graph moved to out_of_core_dir */
+    file_backed_memory out_of_core_memory;
+
+    /** The partition quality statistics of the last finalize() */
+    partition_report partition_stats;
+
+    /** Machine 0 writes the partition report to this file if not empty */
+    std::string partition_report_file;
+
+    /** Received edges beyond this many bytes are spilled to disk. 0 disables. */
+    size_t ingress_memory_budget;
+
+    /** The local directory for spilled edges */
+    std::string spill_dir;
+
+    /** Whether the ingress keeps its placement state for later batches */
+    bool incremental_ingress;
+
+    /** Whether the ingress drops repeated (source, target) edges */
+    bool dedup_edges;
+
+    /** The fraction of the input edges the ingress keeps */
+    double edge_sample_rate;
+    size_t edge_sample_seed;
+
+    /** How the ingress picks the masters: "hash" or "balanced" */
+    std::string master_selection;
+
+    /** Whether master_selection is "balanced" */
+    bool balanced_masters;
+
+    /**
+     * Whether a local vertex is mastered away from the machine given by
+     * the hash of its id, so that is_master() and master() must read
+     * the vertex records.
+     */
+    bool masters_moved;
+
 
     lock_manager_type lock_manager;
 
+    /**
+     * Places the pages of the local vertex and edge data on the NUMA
+     * nodes according to numa_memory. With "interleave" both arrays are
+     * spread over all the nodes. With "local" the vertices are split as
+     * numa_topology::partition() splits them among the engine workers,
+     * each range on the node of its workers, and the edges, which are
+     * read from both endpoints, are interleaved.
+     */
+    void place_local_memory() {
+      const numa_topology& topo = numa_topology::get();
+      if (topo.num_nodes() < 2) return;
+      const size_t nv = local_graph.num_vertices();
+      const size_t ne = local_graph.num_edges();
+      // one array per field when the data is a structure of arrays
+      std::vector<std::pair<char*, size_t> > varrays, earrays;
+      local_graph.data_arrays(varrays, earrays);
+      bool success = true;
+      for (size_t j = 0; j < earrays.size(); ++j) {
+        success &= numa_topology::interleave(earrays[j].first,
+                                             ne * earrays[j].second);
+      }
+      for (size_t j = 0; j < varrays.size(); ++j) {
+        char* vdata = varrays[j].first;
+        const size_t elem_size = varrays[j].second;
+        if (numa_memory == "interleave") {
+          success &= numa_topology::interleave(vdata, nv * elem_size);
+        } else {
+          std::vector<size_t> range = topo.partition(nv, 64);
+          for (size_t k = 0; k < topo.num_nodes(); ++k) {
+            if (range[k + 1] == range[k]) continue;
+            success &= numa_topology::bind(vdata + range[k] * elem_size,
+                                           (range[k + 1] - range[k]) *
+                                               elem_size, k);
+          }
+        }
+      }
+      if (!success) {
+        logstream(LOG_WARNING) << "Unable to place the graph memory with "
+                               << "numa_memory = " << numa_memory << std::endl;
+      }
+    }
+
+    /**
+     * Backs the arrays of the local graph and the vertex records with
+     * transparent huge pages. Runs after place_local_memory() so that
+     * the huge pages are allocated on the nodes chosen there.
+     */
+    void advise_huge_pages() {
+      if (!huge_pages::available()) {
+        logstream(LOG_WARNING) << "huge_pages is set but transparent huge "
+                               << "pages are disabled by the kernel"
+                               << std::endl;
+        return;
+      }
+      std::vector<std::pair<char*, size_t> > ranges;
+      local_graph.memory_ranges(ranges);
+      if (!lvid2record.empty()) {
+        ranges.push_back(std::make_pair((char*)&lvid2record[0],
+                                        lvid2record.size() *
+                                            sizeof(vertex_record)));
+      }
+      size_t advised = 0, total = 0;
+      for (size_t i = 0; i < ranges.size(); ++i) {
+        advised += huge_pages::advise(ranges[i].first, ranges[i].second);
+        total += ranges[i].second;
+      }
+      const double BYTES_TO_MB = double(1) / double(1024 * 1024);
+      logstream(LOG_INFO) << "Huge pages: " << advised * BYTES_TO_MB
+                          << " MB of " << total * BYTES_TO_MB
+                          << " MB of graph arrays advised, "
+                          << huge_pages::resident_bytes() * BYTES_TO_MB
+                          << " MB of the process on huge pages" << std::endl;
+    }
+
+    /**
+     * Moves the edge data and the adjacency of the local graph to a
+     * file in out_of_core_dir. Runs after place_local_memory() since
+     * the moved pages are no longer placed on NUMA nodes.
+     */
+    void move_edges_out_of_core() {
+      std::vector<std::pair<char*, size_t> > ranges;
+      local_graph.edge_memory_ranges(ranges);
+      std::stringstream fname;
+      fname << out_of_core_dir << "/graphlab_edges_" << rpc.procid()
+            << "_" << getpid() << ".bin";
+      const size_t moved = out_of_core_memory.move_to_file(fname.str(), ranges);
+      const double BYTES_TO_MB = double(1) / double(1024 * 1024);
+      logstream(LOG_INFO) << "Out of core: " << moved * BYTES_TO_MB
+                          << " MB of edges moved to " << out_of_core_dir
+                          << std::endl;
+    }
+
+    /**
+     * Relabels the local vertices using the vertex_order method.  The
+     * local graph, the vertex records and vid2lvid are permuted
+     * together.  Local ids never leave the machine so every machine
+     * may be reordered independently.
+     */
+    void reorder_local_vertices() {
+      timer ti; ti.start();
+      std::vector<lvid_type> new_lvid;
+      if (!graphlab::vertex_order::compute(local_graph, vertex_order,
+                                           new_lvid)) {
+        logstream(LOG_FATAL) << "Unknown vertex_order: " << vertex_order
+                             << std::endl;
+      }
+      permute_local_vertices(new_lvid);
+      logstream(LOG_INFO) << "Reordered local vertices by " << vertex_order
+                          << " in " << ti.current_time() << " secs"
+                          << std::endl;
+    }
+
+    /**
+     * On a single machine, numbers the vertices by global id if the
+     * global ids are 0 to num_vertices() - 1, so that vid2lvid is the
+     * identity.
+     */
+    void number_vertices_by_gvid() {
+      std::vector<lvid_type> new_lvid(lvid2record.size());
+      bool identity = true;
+      for (size_t i = 0; i < lvid2record.size(); ++i) {
+        // the gvids are distinct, so all below the count makes them dense
+        if (lvid2record[i].gvid >= lvid2record.size()) return;
+        new_lvid[i] = lvid2record[i].gvid;
+        identity = identity && new_lvid[i] == i;
+      }
+      if (!identity) permute_local_vertices(new_lvid);
+    }
+
+    /**
+     * Moves the local vertex i to new_lvid[i], in the local graph, the
+     * vertex records and vid2lvid.
+     */
+    void permute_local_vertices(const std::vector<lvid_type>& new_lvid) {
+      local_graph.permute_vertices(new_lvid);
+      std::vector<vertex_record> new_records(lvid2record.size());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(lvid2record.size()); ++i) {
+        new_records[new_lvid[i]] = lvid2record[i];
+      }
+      lvid2record.swap(new_records);
+      for (size_t i = 0; i < lvid2record.size(); ++i) {
+        vid2lvid[lvid2record[i].gvid] = i;
+      }
+      build_owner_index();
+    }
+
     void set_ingress_method(const std::string& method,
-        size_t bufsize = 50000, bool usehash = false, bool userecent = false) {
+        size_t bufsize = 50000, bool usehash = false, bool userecent = false,
+        double hdrf_lambda = 1.0) {
       if(ingress_ptr != NULL) { delete ingress_ptr; ingress_ptr = NULL; }
+      precomputed_ingress = (method == "precomputed");
       if (method == "oblivious") {
         if (rpc.procid() == 0) logstream(LOG_EMPH) << "Use oblivious ingress, usehash: " << usehash
           << ", userecent: " << userecent << std::endl;
         ingress_ptr = new distributed_oblivious_ingress<VertexData, EdgeData>(rpc.dc(), *this, usehash, userecent);
+      } else if (method == "hdrf") {
+        if (rpc.procid() == 0) logstream(LOG_EMPH) << "Use hdrf ingress, lambda: "
+          << hdrf_lambda << std::endl;
+        ingress_ptr = new distributed_hdrf_ingress<VertexData, EdgeData>(rpc.dc(), *this, hdrf_lambda);
+      } else if (method == "precomputed") {
+        if (rpc.procid() == 0) logstream(LOG_EMPH) << "Use precomputed ingress" << std::endl;
+        ingress_ptr = new distributed_identity_ingress<VertexData, EdgeData>(rpc.dc(), *this);
       } else if  (method == "random") {
         if (rpc.procid() == 0)logstream(LOG_EMPH) << "Use random ingress" << std::endl;
         ingress_ptr = new distributed_random_ingress<VertexData, EdgeData>(rpc.dc(), *this); 
+      } else if (method == "source") {
+        if (rpc.procid() == 0)logstream(LOG_EMPH) << "Use source ingress" << std::endl;
+        ingress_ptr = new distributed_source_ingress<VertexData, EdgeData>(rpc.dc(), *this);
       } else if (method == "grid") {
         if (rpc.procid() == 0)logstream(LOG_EMPH) << "Use grid ingress" << std::endl;
         ingress_ptr = new distributed_constrained_random_ingress<VertexData, EdgeData>(rpc.dc(), *this, "grid");
@@ -3207,6 +5352,14 @@ namespace graphlab {
       //   ingress_ptr = new distributed_batch_ingress<VertexData, EdgeData>(rpc.dc(), *this,
       //                                                    bufsize, usehash, userecent);
       // } else 
+      if (ingress_ptr != NULL) {
+        ingress_ptr->set_memory_budget(ingress_memory_budget,
+                                       spill_dir + "/graphlab_spill_");
+        ingress_ptr->set_edge_dedup(dedup_edges);
+        ingress_ptr->set_edge_sampling(edge_sample_rate,
+                                       uint32_t(edge_sample_seed));
+        ingress_ptr->set_balanced_masters(balanced_masters);
+      }
     } // end of set ingress method
 
 
@@ -3214,14 +5367,119 @@ namespace graphlab {
        \internal
        This internal function is used to load a single line from an input stream
      */
+    /**
+     * Returns the machine which loads the i'th input file or byte range.
+     * With the precomputed ingress, a shard named
+     * [prefix]_[k]_of_[N] (optionally ending in .gz) is loaded by
+     * machine k-1, and N must equal the number of machines.
+     */
+    procid_t input_owner(const std::string& fname, size_t i) const {
+      if (!precomputed_ingress) return i % rpc.numprocs();
+      std::string name = fname;
+      if (boost::ends_with(name, ".gz")) name.resize(name.length() - 3);
+      const size_t of_pos = name.rfind("_of_");
+      const size_t k_pos = (of_pos == std::string::npos || of_pos == 0) ?
+          std::string::npos : name.rfind('_', of_pos - 1);
+      size_t k = 0, n = 0;
+      if (k_pos != std::string::npos) {
+        k = strtoul(name.c_str() + k_pos + 1, NULL, 10);
+        n = strtoul(name.c_str() + of_pos + 4, NULL, 10);
+      }
+      if (k == 0 || k > n || n != rpc.numprocs()) {
+        logstream(LOG_FATAL)
+          << "\n\tThe precomputed ingress requires shards named"
+          << "\n\t[prefix]_[k]_of_" << rpc.numprocs() << " but found "
+          << fname << std::endl;
+      }
+      return k - 1;
+    }
+
+    /// The block size used by the span parser version of load_from_stream
+    enum { LOAD_BUFFER_SIZE = 4 * 1024 * 1024 };
+
+    /**
+     * Reads fin in blocks of LOAD_BUFFER_SIZE bytes and passes every
+     * line to the span parser without copying it. Stops at the end of
+     * the stream or once the lines read add up to at least max_bytes
+     * bytes, like the line parser version.
+     */
+    template<typename Fstream>
+    bool load_from_stream(std::string filename, Fstream& fin,
+                          span_parser_type& span_parser,
+                          size_t max_bytes = size_t(-1)) {
+      size_t linecount = 0;
+      size_t bytes_read = 0;
+      timer total_ti, ti; total_ti.start(); ti.start();
+      std::vector<char> buffer(LOAD_BUFFER_SIZE);
+      size_t valid = 0;
+      bool eof = false;
+      while (bytes_read < max_bytes) {
+        if (!eof) {
+          fin.read(&buffer[valid], buffer.size() - valid);
+          const size_t nread = fin.gcount();
+          valid += nread;
+          if (nread == 0 || !fin.good()) eof = true;
+        }
+        const char* ptr = &buffer[0];
+        const char* buffer_end = ptr + valid;
+        while (ptr != buffer_end && bytes_read < max_bytes) {
+          const char* line_end =
+              (const char*)memchr(ptr, '\n', buffer_end - ptr);
+          if (line_end == NULL) {
+            // the last line of the stream may not end in a newline
+            if (!eof) break;
+            line_end = buffer_end;
+          }
+          bytes_read += (line_end - ptr) + 1;
+          if (line_end != ptr && !span_parser(*this, filename, ptr, line_end)) {
+            logstream(LOG_WARNING)
+              << "Error parsing line " << linecount << " in "
+              << filename << ": " << std::endl
+              << "\t\"" << std::string(ptr, line_end) << "\"" << std::endl;
+            return false;
+          }
+          ++linecount;
+          ptr = line_end == buffer_end ? buffer_end : line_end + 1;
+        }
+        if (eof) break;
+        // move the partial line to the front, growing the buffer if a
+        // single line does not fit
+        valid = buffer_end - ptr;
+        memmove(&buffer[0], ptr, valid);
+        if (valid == buffer.size()) buffer.resize(2 * buffer.size());
+        if (ti.current_time() > 5.0) {
+          logstream(LOG_INFO) << linecount << " Lines read, "
+                              << double(bytes_read) / (1024 * 1024) / total_ti.current_time()
+                              << " MB/s" << std::endl;
+          ti.start();
+        }
+      }
+      const double elapsed = total_ti.current_time();
+      logstream(LOG_INFO) << "Parsed " << double(bytes_read) / (1024 * 1024)
+                          << " MB from " << filename << " in " << elapsed
+                          << " secs: "
+                          << (elapsed > 0 ? double(bytes_read) / (1024 * 1024) / elapsed : 0)
+                          << " MB/s" << std::endl;
+      return true;
+    } // end of load from stream
+
+    /**
+     * Reads lines from fin and passes them to the line parser. Stops
+     * at the end of the stream or once the lines read add up to at
+     * least max_bytes bytes, so that the last line read may extend
+     * past max_bytes.
+     */
     template<typename Fstream>
     bool load_from_stream(std::string filename, Fstream& fin,
-                          line_parser_type& line_parser) {
+                          line_parser_type& line_parser,
+                          size_t max_bytes = size_t(-1)) {
       size_t linecount = 0;
+      size_t bytes_read = 0;
       timer ti; ti.start();
-      while(fin.good() && !fin.eof()) {
+      while(fin.good() && !fin.eof() && bytes_read < max_bytes) {
         std::string line;
         std::getline(fin, line);
+        bytes_read += line.size() + 1;
         if(line.empty()) continue;
         if(fin.fail()) break;
         const bool success = line_parser(*this, filename, line);
@@ -3292,6 +5550,184 @@ namespace graphlab {
     }
 
 
+  public:
+    /// The header at the start of every binedge file
+    struct binedge_header {
+      char magic[8];
+      uint32_t version;
+      /// The width of each vertex id: 4 or 8
+      uint32_t id_bytes;
+      /// The size of the edge data of each edge, or 0 if not stored
+      uint32_t edata_bytes;
+      uint32_t reserved;
+      static const char* expected_magic() { return "GLBINEDG"; }
+    };
+
+    /// The number of edges in each block of a binedge file
+    enum { BINEDGE_BLOCK_SIZE = 1024 * 1024 };
+
+  private:
+
+    /**
+     * Writes the graph in the binedge format: a binedge_header followed
+     * by blocks of up to BINEDGE_BLOCK_SIZE edges. Each block is the
+     * edge count as a uint64_t, then the source ids, the target ids and,
+     * if the edge data is POD, the edge data as contiguous arrays.
+     * Vertices without edges are stored with a target of -1.
+     */
+    void save_binedge_to_stream(std::ostream& out) {
+      binedge_header header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, binedge_header::expected_magic(), 8);
+      header.version = 1;
+      header.id_bytes = sizeof(vertex_id_type);
+      header.edata_bytes = gl_is_pod<EdgeData>::value ? sizeof(EdgeData) : 0;
+      out.write(reinterpret_cast<char*>(&header), sizeof(header));
+      std::vector<vertex_id_type> src, dst;
+      std::vector<EdgeData> edata;
+      src.reserve(BINEDGE_BLOCK_SIZE); dst.reserve(BINEDGE_BLOCK_SIZE);
+      for (lvid_type i = 0; i < local_graph.num_vertices(); ++i) {
+        const vertex_id_type gvid = l_vertex(i).global_id();
+        foreach(local_edge_type e, l_vertex(i).out_edges()) {
+          src.push_back(gvid);
+          dst.push_back(e.target().global_id());
+          if (header.edata_bytes) edata.push_back(e.data());
+          if (src.size() == BINEDGE_BLOCK_SIZE) {
+            write_binedge_block(out, header, src, dst, edata);
+          }
+        }
+        if (l_vertex(i).owner() == rpc.procid()) {
+          vertex_type gv = vertex_type(l_vertex(i));
+          // store disconnected vertices if I am the master of the vertex
+          if (gv.num_in_edges() == 0 && gv.num_out_edges() == 0) {
+            src.push_back(gvid);
+            dst.push_back(vertex_id_type(-1));
+            if (header.edata_bytes) edata.push_back(EdgeData());
+            if (src.size() == BINEDGE_BLOCK_SIZE) {
+              write_binedge_block(out, header, src, dst, edata);
+            }
+          }
+        }
+      }
+      if (!src.empty()) write_binedge_block(out, header, src, dst, edata);
+    }
+
+    /// Writes one block of a binedge file and clears the columns
+    void write_binedge_block(std::ostream& out, const binedge_header& header,
+                             std::vector<vertex_id_type>& src,
+                             std::vector<vertex_id_type>& dst,
+                             std::vector<EdgeData>& edata) {
+      uint64_t n = src.size();
+      out.write(reinterpret_cast<char*>(&n), sizeof(n));
+      out.write(reinterpret_cast<char*>(&src[0]), n * sizeof(vertex_id_type));
+      out.write(reinterpret_cast<char*>(&dst[0]), n * sizeof(vertex_id_type));
+      if (header.edata_bytes) {
+        out.write(reinterpret_cast<char*>(&edata[0]), n * sizeof(EdgeData));
+      }
+      src.clear(); dst.clear(); edata.clear();
+    }
+
+    /**
+     * Reads n vertex ids of id_bytes bytes each into ids, converting
+     * them if they differ in width from vertex_id_type.
+     */
+    bool read_binedge_ids(std::istream& in, uint32_t id_bytes, size_t n,
+                          std::vector<char>& raw,
+                          std::vector<vertex_id_type>& ids) {
+      ids.resize(n);
+      if (n == 0) return true;
+      if (id_bytes == sizeof(vertex_id_type)) {
+        in.read(reinterpret_cast<char*>(&ids[0]), n * sizeof(vertex_id_type));
+        return !in.fail();
+      }
+      raw.resize(n * id_bytes);
+      in.read(&raw[0], raw.size());
+      if (in.fail()) return false;
+      for (size_t i = 0; i < n; ++i) {
+        uint64_t id;
+        if (id_bytes == 4) id = reinterpret_cast<const uint32_t*>(&raw[0])[i];
+        else id = reinterpret_cast<const uint64_t*>(&raw[0])[i];
+        // -1 of any width marks a disconnected vertex
+        if (id == uint64_t(-1) || (id_bytes == 4 && id == uint32_t(-1))) {
+          ids[i] = vertex_id_type(-1);
+        } else if (id >= uint64_t(vertex_id_type(-1))) {
+          logstream(LOG_ERROR) << "Vertex id " << id << " does not fit in "
+                               << sizeof(vertex_id_type) << " bytes" << std::endl;
+          return false;
+        } else {
+          ids[i] = vertex_id_type(id);
+        }
+      }
+      return true;
+    }
+
+    /**
+     * Loads a file written by save_binedge_to_stream(). Each block is
+     * read with one read per column and passed to add_edge_block().
+     */
+    bool load_binedge_from_stream(std::istream& in) {
+      binedge_header header;
+      in.read(reinterpret_cast<char*>(&header), sizeof(header));
+      if (in.fail() ||
+          memcmp(header.magic, binedge_header::expected_magic(), 8) != 0) {
+        logstream(LOG_ERROR) << "Not a binedge file" << std::endl;
+        return false;
+      }
+      if (header.id_bytes != 4 && header.id_bytes != 8) {
+        logstream(LOG_ERROR) << "Unsupported vertex id width "
+                             << header.id_bytes << std::endl;
+        return false;
+      }
+      if (header.edata_bytes != 0 && (!gl_is_pod<EdgeData>::value ||
+                                      header.edata_bytes != sizeof(EdgeData))) {
+        logstream(LOG_ERROR) << "The edge data in the file has "
+                             << header.edata_bytes << " bytes but the graph "
+                             << "has " << sizeof(EdgeData) << " byte edge data"
+                             << std::endl;
+        return false;
+      }
+      std::vector<char> raw;
+      std::vector<vertex_id_type> src, dst;
+      std::vector<EdgeData> edata;
+      uint64_t n;
+      while (in.read(reinterpret_cast<char*>(&n), sizeof(n))) {
+        // blocks never exceed BINEDGE_BLOCK_SIZE: a larger count means the
+        // file is corrupt, and must not be allocated
+        if (n > BINEDGE_BLOCK_SIZE) {
+          logstream(LOG_ERROR) << "Corrupt binedge file: block of " << n
+                               << " edges exceeds the block size of "
+                               << int(BINEDGE_BLOCK_SIZE) << std::endl;
+          return false;
+        }
+        if (!read_binedge_ids(in, header.id_bytes, n, raw, src) ||
+            !read_binedge_ids(in, header.id_bytes, n, raw, dst)) return false;
+        if (header.edata_bytes && n > 0) {
+          edata.resize(n);
+          in.read(reinterpret_cast<char*>(&edata[0]), n * sizeof(EdgeData));
+          if (in.fail()) return false;
+        }
+        // pull out the disconnected vertices
+        size_t nedges = 0;
+        for (size_t i = 0; i < n; ++i) {
+          if (dst[i] == vertex_id_type(-1)) {
+            add_vertex(src[i]);
+            continue;
+          }
+          if (nedges != i) {
+            src[nedges] = src[i];
+            dst[nedges] = dst[i];
+            if (header.edata_bytes) edata[nedges] = edata[i];
+          }
+          ++nedges;
+        }
+        if (nedges > 0) {
+          add_edge_block(&src[0], &dst[0],
+                         header.edata_bytes ? &edata[0] : NULL, nedges);
+        }
+      }
+      return true;
+    }
+
     /** \brief Saves a distributed graph using a direct ostream saving function
      *
      * This function saves a sequence of files numbered
@@ -3377,7 +5813,7 @@ namespace graphlab {
         logstream(LOG_WARNING) << "No files found matching " << original_path << std::endl;
       }
       for(size_t i = 0; i < graph_files.size(); ++i) {
-        if (i % rpc.numprocs() == rpc.procid()) {
+        if (input_owner(graph_files[i], i) == rpc.procid()) {
           logstream(LOG_EMPH) << "Loading graph from file: " << graph_files[i] << std::endl;
           // is it a gzip file ?
           const bool gzip = boost::ends_with(graph_files[i], ".gz");
@@ -3427,7 +5863,7 @@ namespace graphlab {
         logstream(LOG_WARNING) << "No files found matching " << prefix << std::endl;
       }
       for(size_t i = 0; i < graph_files.size(); ++i) {
-        if (i % rpc.numprocs() == rpc.procid()) {
+        if (input_owner(graph_files[i], i) == rpc.procid()) {
           logstream(LOG_EMPH) << "Loading graph from file: " << graph_files[i] << std::endl;
           // is it a gzip file ?
           const bool gzip = boost::ends_with(graph_files[i], ".gz");
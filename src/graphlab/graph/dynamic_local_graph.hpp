@@ -48,10 +48,13 @@
 
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/graph/local_edge_buffer.hpp>
+#include <graphlab/graph/edge_timestamp.hpp>
 #include <graphlab/util/random.hpp>
 #include <graphlab/util/generics/shuffle.hpp>
 #include <graphlab/util/generics/counting_sort.hpp>
 #include <graphlab/util/generics/dynamic_csr_storage.hpp>
+#include <graphlab/util/generics/csr_storage.hpp>
+#include <graphlab/util/soa_vector.hpp>
 #include <graphlab/parallel/atomic.hpp>
 
 #include <graphlab/logger/logger.hpp>
@@ -75,6 +78,12 @@ namespace graphlab {
     /** The type of the edge data stored in the local_graph. */
     typedef EdgeData edge_data_type;
 
+    /** The dynamic local graph always stores plain arrays of structs */
+    typedef vertex_data_type& vertex_data_reference;
+    typedef const vertex_data_type& vertex_data_const_reference;
+    typedef edge_data_type& edge_data_reference;
+    typedef const edge_data_type& edge_data_const_reference;
+
     typedef graphlab::vertex_id_type vertex_id_type;
     typedef graphlab::edge_id_type edge_id_type;
 
@@ -98,11 +107,11 @@ namespace graphlab {
 
     // CONSTRUCTORS ============================================================>
     /** Create an empty local_graph. */
-    dynamic_local_graph()  { }
+    dynamic_local_graph() : compact_adjacency(false), compacted(false) { }
 
     /** Create a local_graph with nverts vertices. */
     dynamic_local_graph(size_t nverts) :
-      vertices(nverts)  {}
+      vertices(nverts), compact_adjacency(false), compacted(false) {}
 
     // METHODS =================================================================>
 
@@ -118,6 +127,7 @@ namespace graphlab {
       edges.clear();
       _csc_storage.clear();
       _csr_storage.clear();
+      release_compaction();
       std::vector<VertexData>().swap(vertices);
       std::vector<EdgeData>().swap(edges);
       edge_buffer.clear();
@@ -250,6 +260,42 @@ namespace graphlab {
       return vertices[v];
     } // end of data(v)
 
+    /**
+     * \brief Accepted for compatibility with local_graph. The dynamic
+     * graph never duplicates the edge arrays during finalize and
+     * releases each buffer as soon as it has been consumed.
+     */
+    void set_low_memory_finalize(bool low_memory) { }
+
+    /**
+     * \brief Keeps a contiguous copy of the adjacency for read mostly
+     * phases.
+     *
+     * The linked blocks of the dynamic storage make every edge loop
+     * chase pointers. If compact is set, every finalize() also copies
+     * the in and out edges to contiguous arrays like those of
+     * local_graph, which the edge loops then read instead, at the cost
+     * of a second copy of the adjacency. Adding edges drops the copy
+     * until the next finalize(). Takes effect immediately on a
+     * finalized graph.
+     */
+    void set_compact_adjacency(bool compact) {
+      compact_adjacency = compact;
+      if (compact && !compacted && edge_buffer.size() == 0) compact_edges();
+      else if (!compact) release_compaction();
+    }
+
+    /**
+     * \brief Edge time windows are only supported by local_graph, whose
+     * adjacency lists can be sorted by time.
+     */
+    void set_edge_time_window(edge_time_type begin, edge_time_type end) {
+      logstream(LOG_FATAL) << "Edge time windows are not supported by the "
+                           << "dynamic local graph." << std::endl;
+    }
+
+    void clear_edge_time_window() { }
+
     /**
      * \brief Finalize the local_graph data structure by
      * sorting edges to maximize the efficiency of graphlab.
@@ -264,6 +310,7 @@ namespace graphlab {
 #ifdef DEBUG_GRAPH
       logstream(LOG_DEBUG) << "Graph2 finalize starts." << std::endl;
 #endif
+      if (edge_buffer.size() > 0) release_compaction();
       std::vector<edge_id_type> src_permute;
       std::vector<edge_id_type> dest_permute;
       std::vector<edge_id_type> src_counting_prefix_sum;
@@ -272,27 +319,43 @@ namespace graphlab {
 #ifdef DEBUG_GRAPH
       logstream(LOG_DEBUG) << "Graph2 finalize: Sort by source vertex" << std::endl;
 #endif
-      counting_sort(edge_buffer.source_arr, dest_permute, &src_counting_prefix_sum);
-#ifdef DEBUG_GRAPH
-      logstream(LOG_DEBUG) << "Graph2 finalize: Sort by dest id" << std::endl;
-#endif
-      counting_sort(edge_buffer.target_arr, src_permute, &dest_counting_prefix_sum);
+      // edges which arrive in source order need no permutation
+      const bool presorted =
+          prefix_of_sorted(edge_buffer.source_arr, src_counting_prefix_sum);
+      if (!presorted) {
+        counting_sort(edge_buffer.source_arr, dest_permute, &src_counting_prefix_sum);
+      }
 
       std::vector< std::pair<lvid_type, edge_id_type> >  csr_values;
       std::vector< std::pair<lvid_type, edge_id_type> >  csc_values;
 
-      csr_values.reserve(dest_permute.size());
       edge_id_type begineid = edges.size();
-      for (size_t i = 0; i < dest_permute.size(); ++i) {
-        csr_values.push_back(std::pair<lvid_type, edge_id_type> (edge_buffer.target_arr[dest_permute[i]],
-                                                                 begineid + dest_permute[i]));
+      csr_values.resize(edge_buffer.target_arr.size());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(csr_values.size()); ++i) {
+        const edge_id_type eid = presorted ? edge_id_type(i) : dest_permute[i];
+        csr_values[i] = std::pair<lvid_type, edge_id_type> (edge_buffer.target_arr[eid],
+                                                             begineid + eid);
       }
-      csc_values.reserve(src_permute.size());
+      std::vector<edge_id_type>().swap(dest_permute);
+#ifdef DEBUG_GRAPH
+      logstream(LOG_DEBUG) << "Graph2 finalize: Sort by dest id" << std::endl;
+#endif
+      counting_sort(edge_buffer.target_arr, src_permute, &dest_counting_prefix_sum);
+      std::vector<lvid_type>().swap(edge_buffer.target_arr);
 
-      for (size_t i = 0; i < src_permute.size(); ++i) {
-        csc_values.push_back(std::pair<lvid_type, edge_id_type> (edge_buffer.source_arr[src_permute[i]],
-                                                                 begineid + src_permute[i]));
+      csc_values.resize(src_permute.size());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(src_permute.size()); ++i) {
+        csc_values[i] = std::pair<lvid_type, edge_id_type> (edge_buffer.source_arr[src_permute[i]],
+                                                             begineid + src_permute[i]);
       }
+      std::vector<edge_id_type>().swap(src_permute);
+      std::vector<lvid_type>().swap(edge_buffer.source_arr);
       ASSERT_EQ(csc_values.size(), csr_values.size());
 
       // fast path with first time insertion.
@@ -304,34 +367,17 @@ namespace graphlab {
         _csc_storage.wrap(dest_counting_prefix_sum, csc_values);
       } else {
         // insert edge data
-        edges.reserve(edges.size() + edge_buffer.size());
+        edges.reserve(edges.size() + edge_buffer.data.size());
         edges.insert(edges.end(), edge_buffer.data.begin(), edge_buffer.data.end());
         std::vector<EdgeData>().swap(edge_buffer.data);
         edge_buffer.clear();
-        size_t begin, end;
-        for (size_t i = 0; i < src_counting_prefix_sum.size(); ++i) {
-          begin = src_counting_prefix_sum[i];
-          end = (i==src_counting_prefix_sum.size()-1)
-              ? csr_values.size()
-              : src_counting_prefix_sum[i+1];
-          if (end > begin) {
-            _csr_storage.insert(i, csr_values.begin()+begin, csr_values.begin()+end);
-          }
-        }
-        for (size_t i = 0; i < dest_counting_prefix_sum.size(); ++i) {
-          begin = dest_counting_prefix_sum[i];
-          end = (i==dest_counting_prefix_sum.size()-1)
-              ? csc_values.size()
-              : dest_counting_prefix_sum[i+1];
-          if (end > begin) {
-            _csc_storage.insert(i, csc_values.begin()+begin, csc_values.begin()+end);
-          }
-        }
-        _csr_storage.repack();
-        _csc_storage.repack();
+        // the new edges are sorted by vertex, merge them in one batch
+        _csr_storage.insert_sorted(src_counting_prefix_sum, csr_values);
+        _csc_storage.insert_sorted(dest_counting_prefix_sum, csc_values);
       }
       ASSERT_EQ(_csr_storage.num_values(), _csc_storage.num_values());
       ASSERT_EQ(_csr_storage.num_values(), edges.size());
+      if (compact_adjacency && !compacted) compact_edges();
 
 #ifdef DEBUG_GRAPH
       logstream(LOG_DEBUG) << "End of finalize." << std::endl;
@@ -345,6 +391,45 @@ namespace graphlab {
 #endif
     } // End of finalize
 
+    /**
+     * \brief Relabels the vertices so that vertex v becomes vertex
+     * new_lvid[v].  The vertex data and the edges move with their
+     * vertices and the graph is finalized again.  The edge ids are
+     * reassigned.  new_lvid must be a permutation of the vertex ids.
+     */
+    void permute_vertices(const std::vector<lvid_type>& new_lvid) {
+      ASSERT_EQ(edge_buffer.size(), 0);
+      ASSERT_EQ(new_lvid.size(), num_vertices());
+      // rebuild the edge buffer from the current adjacency
+      edge_buffer.clear();
+      edge_buffer.source_arr.resize(num_edges());
+      edge_buffer.target_arr.resize(num_edges());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (ssize_t i = 0; i < ssize_t(num_vertices()); ++i) {
+        foreach(const edge_type& e, out_edges(i)) {
+          edge_buffer.source_arr[e.id()] = new_lvid[i];
+          edge_buffer.target_arr[e.id()] = new_lvid[e.target().id()];
+        }
+      }
+      edge_buffer.data.swap(edges);
+      std::vector<EdgeData>().swap(edges);
+      // move the vertex data
+      std::vector<VertexData> new_vertices(vertices.size());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(vertices.size()); ++i) {
+        new_vertices[new_lvid[i]] = vertices[i];
+      }
+      vertices.swap(new_vertices);
+      _csr_storage.clear();
+      _csc_storage.clear();
+      release_compaction();
+      finalize();
+    } // End of permute_vertices
+
 
     /** \brief Load the local_graph from an archive */
     void load(iarchive& arc) {
@@ -354,6 +439,7 @@ namespace graphlab {
           >> edges
           >> _csr_storage
           >> _csc_storage;
+      if (compact_adjacency) compact_edges();
     } // end of load
 
     /** \brief Save the local_graph to an archive */
@@ -365,12 +451,56 @@ namespace graphlab {
           << _csc_storage;
     } // end of save
 
+    /**
+     * \brief Writes the vertex data, the edge data and the end points
+     * of every edge to a graph snapshot.  The vertex and edge data
+     * must be trivially copyable.
+     */
+    template <typename SnapshotWriter>
+    void save_snapshot(SnapshotWriter& writer) const {
+      ASSERT_EQ(edge_buffer.size(), 0);
+      std::vector<lvid_type> source_arr(num_edges()), target_arr(num_edges());
+      dynamic_local_graph& g = const_cast<dynamic_local_graph&>(*this);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (ssize_t i = 0; i < ssize_t(num_vertices()); ++i) {
+        foreach(const edge_type& e, g.out_edges(i)) {
+          source_arr[e.id()] = i;
+          target_arr[e.id()] = e.target().id();
+        }
+      }
+      writer.write(vertices);
+      writer.write(edges);
+      writer.write(source_arr);
+      writer.write(target_arr);
+    }
+
+    /**
+     * \brief Reads a dynamic_local_graph written by save_snapshot().
+     * The adjacency is rebuilt by finalize() and the edge ids are
+     * preserved.
+     */
+    template <typename SnapshotReader>
+    void load_snapshot(SnapshotReader& reader) {
+      clear();
+      reader.read(vertices);
+      reader.read(edge_buffer.data);
+      reader.read(edge_buffer.source_arr);
+      reader.read(edge_buffer.target_arr);
+      finalize();
+    }
+
     /** swap two graphs */
     void swap(dynamic_local_graph& other) {
       std::swap(vertices, other.vertices);
       std::swap(edges, other.edges);
       std::swap(_csr_storage, other._csr_storage);
       std::swap(_csc_storage, other._csc_storage);
+      _flat_csr.swap(other._flat_csr);
+      _flat_csc.swap(other._flat_csc);
+      std::swap(compact_adjacency, other.compact_adjacency);
+      std::swap(compacted, other.compacted);
     } // end of swap
 
 
@@ -426,6 +556,7 @@ namespace graphlab {
      * \internal
      * \brief Returns the number of in edges of the vertex with the given id. */
     size_t num_in_edges(const lvid_type v) const {
+      if (compacted) return _flat_csc.end(v) - _flat_csc.begin(v);
       return _csc_storage.begin(v).pdistance_to(_csc_storage.end(v));
     }
 
@@ -433,6 +564,7 @@ namespace graphlab {
      * \internal
      * \brief Returns the number of in edges of the vertex with the given id. */
     size_t num_out_edges(const lvid_type v) const {
+      if (compacted) return _flat_csr.end(v) - _flat_csr.begin(v);
       return _csr_storage.begin(v).pdistance_to(_csr_storage.end(v));
     }
 
@@ -440,6 +572,11 @@ namespace graphlab {
      * \internal
      * \brief Returns a list of in edges of the vertex with the given id. */
     edge_list_type in_edges(lvid_type v) {
+      if (compacted) {
+        return boost::make_iterator_range(
+            edge_iterator(*this, edge_iterator::CSC, _flat_csc.begin(v), v),
+            edge_iterator(*this, edge_iterator::CSC, _flat_csc.end(v), v));
+      }
       edge_iterator begin = edge_iterator(*this, edge_iterator::CSC,
                                           _csc_storage.begin(v), v);
       edge_iterator end = edge_iterator(*this, edge_iterator::CSC,
@@ -451,6 +588,11 @@ namespace graphlab {
      * \internal
      * \brief Returns a list of out edges of the vertex with the given id. */
     edge_list_type out_edges(lvid_type v) {
+      if (compacted) {
+        return boost::make_iterator_range(
+            edge_iterator(*this, edge_iterator::CSR, _flat_csr.begin(v), v),
+            edge_iterator(*this, edge_iterator::CSR, _flat_csr.end(v), v));
+      }
       edge_iterator begin = edge_iterator(*this, edge_iterator::CSR,
                                           _csr_storage.begin(v), v);
       edge_iterator end = edge_iterator(*this, edge_iterator::CSR,
@@ -458,6 +600,135 @@ namespace graphlab {
       return boost::make_iterator_range(begin, end);
     }
 
+    /**
+     * \internal
+     * \brief A read only view of the in or out edges of a vertex.
+     *
+     * Provides the same interface as local_graph::edge_span.  The
+     * edges are accessed through the edge iterators, which only have
+     * constant time random access once the adjacency is compacted.
+     */
+    class edge_span {
+     public:
+      edge_span(const dynamic_local_graph& lgraph_ref,
+                edge_list_type elist, bool out) :
+        lgraph_ref(lgraph_ref), elist(elist), out(out) { }
+
+      /// \brief Returns the number of edges in the span
+      size_t size() const { return elist.size(); }
+
+      /// \brief Returns true if the span contains no edges
+      bool empty() const { return elist.empty(); }
+
+      /// \brief Returns true if the span holds out edges
+      bool is_out_edges() const { return out; }
+
+      /// \brief Returns the local id of the other end of the i'th edge
+      lvid_type neighbor(size_t i) const {
+        const edge_type e = elist[i];
+        return out ? e.target().id() : e.source().id();
+      }
+
+      /// \brief Returns the id of the i'th edge
+      edge_id_type edge_id(size_t i) const { return elist[i].id(); }
+
+      /// \brief Returns the data on the i'th edge
+      const EdgeData& edge_data(size_t i) const {
+        return lgraph_ref.edge_data(edge_id(i));
+      }
+
+      /// \brief Returns the data on the other end of the i'th edge
+      const VertexData& neighbor_data(size_t i) const {
+        return lgraph_ref.vertex_data(neighbor(i));
+      }
+
+     private:
+      const dynamic_local_graph& lgraph_ref;
+      edge_list_type elist;
+      bool out;
+    }; // end of edge_span
+
+    /**
+     * \internal
+     * \brief Returns a span over the in edges of the vertex with the
+     * given id. */
+    edge_span in_edge_span(lvid_type v) {
+      return edge_span(*this, in_edges(v), false);
+    }
+
+    /**
+     * \internal
+     * \brief Returns a span over the out edges of the vertex with the
+     * given id. */
+    edge_span out_edge_span(lvid_type v) {
+      return edge_span(*this, out_edges(v), true);
+    }
+
+    /**
+     * \internal
+     * \brief Provides the interface of
+     * local_graph::prefetch_edge_index(). Only the compacted adjacency
+     * has a flat index to prefetch.
+     */
+    void prefetch_edge_index(lvid_type v) const {
+      if (!compacted) return;
+      _flat_csc.prefetch_key(v);
+      _flat_csr.prefetch_key(v);
+    }
+
+    /**
+     * \internal
+     * \brief Prefetches the data on the vertex with the given id, and
+     * the start of its edges once the adjacency is compacted. See
+     * local_graph::prefetch_edge_lists().
+     */
+    void prefetch_edge_lists(lvid_type v) const {
+      __builtin_prefetch(&vertices[v]);
+      if (!compacted) return;
+      _flat_csc.prefetch_values(v);
+      _flat_csr.prefetch_values(v);
+    }
+
+    /**
+     * \internal
+     * \brief Provides the interface of local_graph::neighbor_prefetcher.
+     * Only prefetches once the adjacency is compacted, since the
+     * dynamic storage is not contiguous.
+     */
+    class neighbor_prefetcher {
+     public:
+      neighbor_prefetcher(const dynamic_local_graph& lgraph_ref, lvid_type v,
+                          bool in, size_t distance) :
+        lgraph_ref(lgraph_ref), in(in), distance(distance), pos(0),
+        nedges(0), entries(NULL) {
+        if (distance == 0 || !lgraph_ref.compacted) return;
+        nedges = in ? lgraph_ref.num_in_edges(v) : lgraph_ref.num_out_edges(v);
+        if (nedges == 0) return;
+        entries = in ? &(*lgraph_ref._flat_csc.begin(v))
+                     : &(*lgraph_ref._flat_csr.begin(v));
+        for (size_t i = 0; i < std::min(distance, nedges); ++i) prefetch(i);
+      }
+
+      /// \brief Advances to the next edge of the loop
+      inline void next() {
+        if (pos + distance < nedges) prefetch(pos + distance);
+        ++pos;
+      }
+
+     private:
+      const dynamic_local_graph& lgraph_ref;
+      bool in;
+      size_t distance;
+      size_t pos;
+      size_t nedges;
+      const std::pair<lvid_type, edge_id_type>* entries;
+
+      inline void prefetch(size_t i) const {
+        __builtin_prefetch(&lgraph_ref.vertices[entries[i].first]);
+        if (in) __builtin_prefetch(&lgraph_ref.edges[entries[i].second]);
+      }
+    }; // end of neighbor_prefetcher
+
     /**
      * \internal
      * \brief Returns edge data of edge_type e
@@ -475,6 +746,45 @@ namespace graphlab {
       return edges[eid];
     }
 
+    /**
+     * \internal
+     * \brief Appends the arrays holding the vertex data and those
+     * holding the edge data as (first element, element size) pairs.
+     */
+    void data_arrays(std::vector<std::pair<char*, size_t> >& vertex_arrays,
+                     std::vector<std::pair<char*, size_t> >& edge_arrays) {
+      storage_arrays(vertices, vertex_arrays);
+      storage_arrays(edges, edge_arrays);
+    }
+
+    /**
+     * \internal
+     * \brief Appends the vertex and edge data arrays as (first byte,
+     * length in bytes) pairs. The dynamic adjacency is made of many
+     * small blocks, which are left out.
+     */
+    void memory_ranges(std::vector<std::pair<char*, size_t> >& out) {
+      if (!vertices.empty()) {
+        out.push_back(std::make_pair((char*)&vertices[0],
+                                     vertices.size() * sizeof(VertexData)));
+      }
+      _flat_csr.memory_ranges(out);
+      _flat_csc.memory_ranges(out);
+      edge_memory_ranges(out);
+    }
+
+    /**
+     * \internal
+     * \brief Appends the edge data array as a (first byte, length in
+     * bytes) pair. The dynamic adjacency is left out.
+     */
+    void edge_memory_ranges(std::vector<std::pair<char*, size_t> >& out) {
+      if (!edges.empty()) {
+        out.push_back(std::make_pair((char*)&edges[0],
+                                     edges.size() * sizeof(EdgeData)));
+      }
+    }
+
     /**
      * \internal
      * \brief Returns the estimated memory footprint of the local_graph. */
@@ -483,6 +793,7 @@ namespace graphlab {
         sizeof(VertexData) * vertices.capacity();
       size_t elist_size = _csr_storage.estimate_sizeof()
           + _csc_storage.estimate_sizeof()
+          + _flat_csr.estimate_sizeof() + _flat_csc.estimate_sizeof()
           + sizeof(edges) + sizeof(EdgeData)*edges.capacity();
       size_t ebuffer_size = edge_buffer.estimate_sizeof();
       return vlist_size + elist_size + ebuffer_size;
@@ -513,6 +824,12 @@ namespace graphlab {
 
     typedef typename csr_type::iterator csr_edge_iterator;
 
+    /** The contiguous copy of the adjacency kept by compact_edges() */
+    typedef csr_storage<std::pair<lvid_type, edge_id_type>, edge_id_type>
+        flat_csr_type;
+
+    typedef typename flat_csr_type::iterator flat_edge_iterator;
+
     // PRIVATE DATA MEMBERS ===================================================>
     //
     /** The vertex data is simply a vector of vertex data */
@@ -523,12 +840,36 @@ namespace graphlab {
     csr_type _csc_storage;
     std::vector<EdgeData> edges;
 
+    /** The contiguous copies of _csr_storage and _csc_storage, valid
+        while compacted is set. See set_compact_adjacency(). */
+    flat_csr_type _flat_csr;
+    flat_csr_type _flat_csc;
+    bool compact_adjacency;
+    bool compacted;
+
     /** The edge data is a vector of edges where each edge stores its
         source, destination, and data. Used for temporary storage. The
         data is transferred into CSR+CSC representation in
         Finalize. This will be cleared after finalized.*/
     local_edge_buffer<VertexData, EdgeData> edge_buffer;
 
+    /** Copies the adjacency to _flat_csr and _flat_csc */
+    void compact_edges() {
+      std::vector<edge_id_type> valueptr_vec;
+      std::vector<std::pair<lvid_type, edge_id_type> > value_vec;
+      _csr_storage.flatten(valueptr_vec, value_vec);
+      _flat_csr.wrap(valueptr_vec, value_vec);
+      _csc_storage.flatten(valueptr_vec, value_vec);
+      _flat_csc.wrap(valueptr_vec, value_vec);
+      compacted = true;
+    }
+
+    void release_compaction() {
+      _flat_csr.clear();
+      _flat_csc.clear();
+      compacted = false;
+    }
+
     /**************************************************************************/
     /*                                                                        */
     /*                            declare friends                             */
@@ -634,31 +975,43 @@ namespace graphlab {
 
            edge_iterator(dynamic_local_graph& lgraph_ref, list_type _type,
                          csr_edge_iterator _iter, lvid_type _vid)
-               : lgraph_ref(lgraph_ref), _type(_type), _iter(_iter), _vid(_vid) {}
+               : lgraph_ref(lgraph_ref), _type(_type), _iter(_iter),
+                 _flat(false), _vid(_vid) {}
+
+           /// Iterates over the compacted adjacency
+           edge_iterator(dynamic_local_graph& lgraph_ref, list_type _type,
+                         flat_edge_iterator _flat_iter, lvid_type _vid)
+               : lgraph_ref(lgraph_ref), _type(_type), _iter(NULL, 0),
+                 _flat_iter(_flat_iter), _flat(true), _vid(_vid) {}
 
          private:
            friend class boost::iterator_core_access;
 
            void increment() {
-             ++_iter;
+             if (_flat) ++_flat_iter;
+             else ++_iter;
            }
            bool equal(const edge_iterator& other) const
            {
              ASSERT_EQ(_type, other._type);
-             return _iter == other._iter;
+             return _flat ? _flat_iter == other._flat_iter
+                          : _iter == other._iter;
            }
            edge_type dereference() const {
              return make_value();
            }
            void advance(int n) {
-             _iter += n;
+             if (_flat) _flat_iter += n;
+             else _iter += n;
            }
            ptrdiff_t distance_to(const edge_iterator& other) const {
-             return (other._iter - _iter);
+             return _flat ? (other._flat_iter - _flat_iter)
+                          : (other._iter - _iter);
            }
          private:
            edge_type make_value() const {
-            typename csr_edge_iterator::reference ref = *_iter;
+            const std::pair<lvid_type, edge_id_type>& ref =
+                _flat ? *_flat_iter : *_iter;
              switch (_type) {
               case CSC: {
                 return edge_type(lgraph_ref, ref.first, _vid, ref.second);
@@ -672,6 +1025,8 @@ namespace graphlab {
            dynamic_local_graph& lgraph_ref;
            const list_type _type;
            csr_edge_iterator _iter;
+           flat_edge_iterator _flat_iter;
+           bool _flat;
            const lvid_type _vid;
         }; // end of edge_iterator
 
@@ -710,7 +1065,7 @@ namespace std {
 //         }
 //
 //         // insert edge data
-//         edges.reserve(edges.size() + edge_buffer.size());
+//         edges.reserve(edges.size() + edge_buffer.data.size());
 //         edges.insert(edges.end(), edge_buffer.data.begin(), edge_buffer.data.end());
 //         std::vector<EdgeData>().swap(edge_buffer.data);
 //
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_EDGE_TIMESTAMP_HPP
+#define GRAPHLAB_GRAPH_EDGE_TIMESTAMP_HPP
+
+namespace graphlab {
+
+  /// The type of the time stamps of the edges
+  typedef double edge_time_type;
+
+  /**
+   * \brief Gives the time stamp of an edge from its data.
+   *
+   * By default edges have no time stamp. GRAPHLAB_EDGE_TIMESTAMP
+   * declares a member of the edge data as its time stamp, after which
+   * the local_graph keeps the in and out edges of every vertex sorted
+   * by time and the adjacency can be restricted to a time window (see
+   * distributed_graph::set_edge_time_window()):
+   * \code
+   * struct interaction {
+   *   double time;
+   *   float weight;
+   * };
+   * GRAPHLAB_EDGE_TIMESTAMP(interaction, time)
+   * \endcode
+   * The macro must be used at global scope.
+   */
+  template <typename EdgeData>
+  struct edge_timestamp {
+    enum { enabled = false };
+    static edge_time_type get(const EdgeData&) { return 0; }
+  };
+
+} // end of namespace graphlab
+
+#define GRAPHLAB_EDGE_TIMESTAMP(EdgeData, member)                       \
+  namespace graphlab {                                                  \
+    template <>                                                         \
+    struct edge_timestamp<EdgeData> {                                   \
+      enum { enabled = true };                                          \
+      static edge_time_type get(const EdgeData& edata) {                \
+        return edge_time_type(edata.member);                            \
+      }                                                                 \
+    };                                                                  \
+  }
+
+#endif
@@ -38,14 +38,33 @@ namespace graphlab {
   typedef uint64_t vertex_id_type;
 #endif
 
+#ifdef USE_LVID32
+  /**
+   * Identifier type of a vertex which is only locally consistent.
+   * Guaranteed to be integral. Limits a machine to 2^32 local vertices.
+   */
+  typedef uint32_t lvid_type;
+#else
   /// Identifier type of a vertex which is only locally consistent. Guaranteed to be integral
   typedef vertex_id_type lvid_type;
+#endif
 
+#ifdef USE_EID32
+  /**
+   * Identifier type of an edge which is only locally
+   * consistent. Guaranteed to be integral and consecutive.
+   * Limits a machine to 2^32 local edges.
+   */
+  typedef uint32_t edge_id_type;
+#else
   /**
    * Identifier type of an edge which is only locally
    * consistent. Guaranteed to be integral and consecutive.
+   * Independent of the vertex id types so that a machine may hold more
+   * than 2^32 edges with 32 bit vertex ids.
    */
-  typedef lvid_type edge_id_type;
+  typedef uint64_t edge_id_type;
+#endif
 
   /**
    * \brief The set of edges that are traversed during gather and scatter
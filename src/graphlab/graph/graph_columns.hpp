@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_GRAPH_COLUMNS_HPP
+#define GRAPHLAB_GRAPH_COLUMNS_HPP
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <ostream>
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * The element types of the columns written by
+   * distributed_graph::save_columns().
+   */
+  enum column_type {
+    COLUMN_BOOL = 0, COLUMN_INT8, COLUMN_UINT8, COLUMN_INT16, COLUMN_UINT16,
+    COLUMN_INT32, COLUMN_UINT32, COLUMN_INT64, COLUMN_UINT64,
+    COLUMN_FLOAT, COLUMN_DOUBLE
+  };
+
+  /// \cond GRAPHLAB_INTERNAL
+  /// Maps an element type to its column_type
+  template <typename T> struct column_type_of;
+#define GRAPHLAB_COLUMN_TYPE_OF(T, CODE) \
+  template <> struct column_type_of<T> { enum { value = CODE }; };
+  GRAPHLAB_COLUMN_TYPE_OF(bool, COLUMN_BOOL)
+  GRAPHLAB_COLUMN_TYPE_OF(int8_t, COLUMN_INT8)
+  GRAPHLAB_COLUMN_TYPE_OF(uint8_t, COLUMN_UINT8)
+  GRAPHLAB_COLUMN_TYPE_OF(int16_t, COLUMN_INT16)
+  GRAPHLAB_COLUMN_TYPE_OF(uint16_t, COLUMN_UINT16)
+  GRAPHLAB_COLUMN_TYPE_OF(int32_t, COLUMN_INT32)
+  GRAPHLAB_COLUMN_TYPE_OF(uint32_t, COLUMN_UINT32)
+  GRAPHLAB_COLUMN_TYPE_OF(int64_t, COLUMN_INT64)
+  GRAPHLAB_COLUMN_TYPE_OF(uint64_t, COLUMN_UINT64)
+  GRAPHLAB_COLUMN_TYPE_OF(float, COLUMN_FLOAT)
+  GRAPHLAB_COLUMN_TYPE_OF(double, COLUMN_DOUBLE)
+#undef GRAPHLAB_COLUMN_TYPE_OF
+  /// \endcond
+
+  /**
+   * The names and element types of the columns of a table.
+   */
+  class column_schema {
+   public:
+    /// Appends a column of elements of type T
+    template <typename T>
+    void add(const std::string& name) {
+      names.push_back(name);
+      types.push_back(column_type(column_type_of<T>::value));
+      elem_sizes.push_back(sizeof(T));
+    }
+
+    /// Appends a column given its element type and size
+    void add(const std::string& name, column_type type, size_t elem_size) {
+      names.push_back(name);
+      types.push_back(type);
+      elem_sizes.push_back(elem_size);
+    }
+
+    size_t num_columns() const { return names.size(); }
+    const std::string& name(size_t i) const { return names[i]; }
+    column_type type(size_t i) const { return types[i]; }
+    size_t elem_size(size_t i) const { return elem_sizes[i]; }
+
+    /// Returns the index of the column named name, or -1
+    size_t find(const std::string& name) const {
+      for (size_t i = 0; i < names.size(); ++i) {
+        if (names[i] == name) return i;
+      }
+      return size_t(-1);
+    }
+
+   private:
+    std::vector<std::string> names;
+    std::vector<column_type> types;
+    std::vector<size_t> elem_sizes;
+  };
+
+  /**
+   * A group of rows of a table held as one byte array per column.
+   * Rows are appended through column_row.
+   */
+  class column_block {
+   public:
+    explicit column_block(const column_schema& schema) :
+      schema(&schema), columns(schema.num_columns()), nrows(0) { }
+
+    const column_schema& get_schema() const { return *schema; }
+    size_t num_rows() const { return nrows; }
+    bool empty() const { return nrows == 0; }
+
+    /// The nrows * elem_size bytes of column i
+    const char* column_data(size_t i) const {
+      return columns[i].empty() ? NULL : &columns[i][0];
+    }
+
+    /// Removes the rows, keeping the memory of the columns
+    void clear() {
+      for (size_t i = 0; i < columns.size(); ++i) columns[i].clear();
+      nrows = 0;
+    }
+
+   private:
+    const column_schema* schema;
+    std::vector<std::vector<char> > columns;
+    size_t nrows;
+    friend class column_row;
+  };
+
+  /**
+   * Appends one row to a column_block, one value per column in the
+   * order of the schema:
+   * \code
+   * row << vertex.id() << vertex.data().rank;
+   * \endcode
+   * Each value must have the type its column was declared with. A row
+   * where nothing is written is skipped.
+   */
+  class column_row {
+   public:
+    explicit column_row(column_block& block) : block(block), col(0) { }
+
+    template <typename T>
+    column_row& operator<<(const T& value) {
+      const column_schema& schema = *block.schema;
+      ASSERT_LT(col, schema.num_columns());
+      if (schema.type(col) != int(column_type_of<T>::value)) {
+        logstream(LOG_FATAL) << "Column " << schema.name(col)
+                             << " written with the wrong type" << std::endl;
+      }
+      std::vector<char>& column = block.columns[col];
+      const size_t pos = column.size();
+      column.resize(pos + sizeof(T));
+      memcpy(&column[pos], &value, sizeof(T));
+      ++col;
+      return *this;
+    }
+
+    /// Completes the row. Fails if only some of the columns were written.
+    void finish() {
+      if (col == 0) return;
+      if (col != block.schema->num_columns()) {
+        logstream(LOG_FATAL) << "A row sets " << col << " of the "
+                             << block.schema->num_columns() << " columns"
+                             << std::endl;
+      }
+      ++block.nrows;
+      col = 0;
+    }
+
+   private:
+    column_block& block;
+    size_t col;
+  };
+
+  /**
+   * The destination of the tables written by
+   * distributed_graph::save_columns_to_sinks(). A sink receives the
+   * schema once, then the blocks of rows, one call at a time, and is
+   * closed once all blocks are written.
+   */
+  class icolumn_sink {
+   public:
+    virtual ~icolumn_sink() { }
+    virtual void open(const column_schema& schema) = 0;
+    virtual void write_block(const column_block& block) = 0;
+    /// Returns false if the output failed
+    virtual bool close() = 0;
+  };
+
+  /**
+   * Writes a table as a columnar file to a stream.
+   *
+   * The file is a sequence of row groups, one per block, each holding
+   * the raw bytes of every column of the block one after the other. A
+   * footer at the end lists the schema and the offset of every column
+   * of every row group, followed by the offset of the footer and the
+   * magic, so that a reader can load any column without the others.
+   * All integers are written as little endian 64 bit values and all
+   * column data in the byte order of the machine.
+   */
+  class columnar_file_sink : public icolumn_sink {
+   public:
+    explicit columnar_file_sink(std::ostream& out) : out(out), pos(0) { }
+
+    static const char* magic() { return "GLCOLUMN"; }
+    enum { CURRENT_VERSION = 1 };
+
+    void open(const column_schema& s) {
+      schema = s;
+      write_bytes(magic(), 8);
+      write_u64(CURRENT_VERSION);
+    }
+
+    void write_block(const column_block& block) {
+      if (block.empty()) return;
+      group_rows.push_back(block.num_rows());
+      for (size_t i = 0; i < schema.num_columns(); ++i) {
+        group_offsets.push_back(pos);
+        write_bytes(block.column_data(i), block.num_rows() * schema.elem_size(i));
+      }
+    }
+
+    bool close() {
+      const uint64_t footer = pos;
+      write_u64(schema.num_columns());
+      for (size_t i = 0; i < schema.num_columns(); ++i) {
+        write_u64(schema.type(i));
+        write_u64(schema.elem_size(i));
+        write_u64(schema.name(i).size());
+        write_bytes(schema.name(i).c_str(), schema.name(i).size());
+      }
+      write_u64(group_rows.size());
+      for (size_t g = 0; g < group_rows.size(); ++g) {
+        write_u64(group_rows[g]);
+        for (size_t i = 0; i < schema.num_columns(); ++i) {
+          write_u64(group_offsets[g * schema.num_columns() + i]);
+        }
+      }
+      write_u64(footer);
+      write_bytes(magic(), 8);
+      out.flush();
+      return !out.fail();
+    }
+
+   private:
+    std::ostream& out;
+    column_schema schema;
+    uint64_t pos;
+    std::vector<uint64_t> group_rows;
+    std::vector<uint64_t> group_offsets;
+
+    void write_bytes(const char* data, size_t n) {
+      if (n > 0) out.write(data, n);
+      pos += n;
+    }
+    void write_u64(uint64_t value) {
+      unsigned char bytes[8];
+      for (size_t i = 0; i < 8; ++i) bytes[i] = (unsigned char)(value >> (8 * i));
+      write_bytes(reinterpret_cast<const char*>(bytes), 8);
+    }
+  };
+
+  /**
+   * Reads the columns of a file written by columnar_file_sink.
+   */
+  class columnar_file_reader {
+   public:
+    explicit columnar_file_reader(const std::string& fname) :
+      in(fname.c_str(), std::ios_base::in | std::ios_base::binary),
+      valid(false), nrows(0) {
+      if (!in.good()) return;
+      in.seekg(0, std::ios_base::end);
+      const uint64_t size = in.tellg();
+      if (size < 32 || !check_magic(size - 8) || !check_magic(0)) {
+        logstream(LOG_ERROR) << fname << " is not a columnar file" << std::endl;
+        return;
+      }
+      in.seekg(size - 16);
+      in.seekg(read_u64());
+      const size_t ncols = read_u64();
+      for (size_t i = 0; i < ncols; ++i) {
+        const column_type type = column_type(read_u64());
+        const size_t elem_size = read_u64();
+        std::string name(read_u64(), ' ');
+        if (!name.empty()) in.read(&name[0], name.size());
+        schema.add(name, type, elem_size);
+      }
+      group_rows.resize(read_u64());
+      group_offsets.resize(group_rows.size() * ncols);
+      for (size_t g = 0; g < group_rows.size(); ++g) {
+        group_rows[g] = read_u64();
+        nrows += group_rows[g];
+        for (size_t i = 0; i < ncols; ++i) {
+          group_offsets[g * ncols + i] = read_u64();
+        }
+      }
+      valid = !in.fail();
+    }
+
+    bool good() const { return valid; }
+    const column_schema& get_schema() const { return schema; }
+    size_t num_rows() const { return nrows; }
+    size_t num_row_groups() const { return group_rows.size(); }
+
+    /**
+     * Reads every row of column i into values. Fails if T is not the
+     * type of the column.
+     */
+    template <typename T>
+    void read_column(size_t i, std::vector<T>& values) {
+      ASSERT_TRUE(valid);
+      ASSERT_LT(i, schema.num_columns());
+      if (schema.type(i) != int(column_type_of<T>::value) ||
+          schema.elem_size(i) != sizeof(T)) {
+        logstream(LOG_FATAL) << "Column " << schema.name(i)
+                             << " read with the wrong type" << std::endl;
+      }
+      values.resize(nrows);
+      size_t row = 0;
+      for (size_t g = 0; g < group_rows.size(); ++g) {
+        in.seekg(group_offsets[g * schema.num_columns() + i]);
+        if (group_rows[g] > 0) {
+          in.read(reinterpret_cast<char*>(&values[row]), group_rows[g] * sizeof(T));
+        }
+        row += group_rows[g];
+      }
+      ASSERT_FALSE(in.fail());
+    }
+
+    template <typename T>
+    void read_column(const std::string& name, std::vector<T>& values) {
+      const size_t i = schema.find(name);
+      if (i == size_t(-1)) {
+        logstream(LOG_FATAL) << "No column named " << name << std::endl;
+      }
+      read_column(i, values);
+    }
+
+   private:
+    std::ifstream in;
+    bool valid;
+    column_schema schema;
+    size_t nrows;
+    std::vector<uint64_t> group_rows;
+    std::vector<uint64_t> group_offsets;
+
+    bool check_magic(uint64_t offset) {
+      char buf[8];
+      in.seekg(offset);
+      in.read(buf, 8);
+      return !in.fail() && memcmp(buf, columnar_file_sink::magic(), 8) == 0;
+    }
+    uint64_t read_u64() {
+      unsigned char bytes[8] = {0};
+      in.read(reinterpret_cast<char*>(bytes), 8);
+      uint64_t value = 0;
+      for (size_t i = 0; i < 8; ++i) value |= uint64_t(bytes[i]) << (8 * i);
+      return value;
+    }
+  };
+
+} // end of namespace graphlab
+
+#endif
@@ -337,6 +337,8 @@ namespace graphlab {
       void graph_gather_apply<Graph,GatherType>::exec(const vertex_set& vset) {
         if (vset.lazy && !vset.is_complete_set)
           return;
+        // the workers read the words of the bitset
+        vset.decompress();
 
         gather_accum.clear();
         // Allocate vertex locks and vertex programs
@@ -384,28 +386,24 @@ namespace graphlab {
     size_t vcount = 0;
     timer ti;
 
-    fixed_dense_bitset<8 * sizeof(size_t)> local_bitset;
     while (1) {
       // increment by a word at a time
       lvid_type lvid_block_start =
                   shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
       if (lvid_block_start >= graph.num_local_vertices()) break;
 
-      local_bitset.clear();
-
+      // get the bit field from has_message
+      size_t lvid_bit_block;
       if (vset.lazy)  {
         ASSERT_TRUE(vset.is_complete_set);
-        local_bitset.fill();
+        lvid_bit_block = size_t(-1);
       } else {
-        // get the bit field from has_message
-        size_t lvid_bit_block = vset.localvset.containing_word(lvid_block_start);
-        if (lvid_bit_block == 0) continue;
-        // initialize a word sized bitfield
-        local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+        lvid_bit_block = vset.localvset.containing_word(lvid_block_start);
       }
 
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
+      while (lvid_bit_block) {
+        lvid_type lvid = lvid_block_start +
+            dense_bitset::pop_first_bit(lvid_bit_block);
         if (lvid >= graph.num_local_vertices()) break;
 
         // std::cout << "proc " << rmi.procid() << " gather on lvid " << lvid << std::endl;
@@ -435,28 +433,24 @@ namespace graphlab {
     size_t vcount = 0;
     timer ti;
 
-    fixed_dense_bitset<8 * sizeof(size_t)> local_bitset;
     while (1) {
       // increment by a word at a time
       lvid_type lvid_block_start =
                   shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
       if (lvid_block_start >= graph.num_local_vertices()) break;
 
-      local_bitset.clear();
-
+      // get the bit field from has_message
+      size_t lvid_bit_block;
       if (vset.lazy)  {
         ASSERT_TRUE(vset.is_complete_set);
-        local_bitset.fill();
+        lvid_bit_block = size_t(-1);
       } else {
-        // get the bit field from has_message
-        size_t lvid_bit_block = vset.localvset.containing_word(lvid_block_start);
-        if (lvid_bit_block == 0) continue;
-        // initialize a word sized bitfield
-        local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+        lvid_bit_block = vset.localvset.containing_word(lvid_block_start);
       }
 
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
+      while (lvid_bit_block) {
+        lvid_type lvid = lvid_block_start +
+            dense_bitset::pop_first_bit(lvid_bit_block);
         if (lvid >= graph.num_local_vertices()) break;
 
         if (graph.l_is_master(lvid)) {
@@ -481,25 +475,23 @@ namespace graphlab {
   template<typename Graph, typename GatherType>
   void graph_gather_apply<Graph,GatherType>::
   execute_applys(const size_t thread_id, const vertex_set& vset) {
-    fixed_dense_bitset<8  * sizeof(size_t)> local_bitset;
     while (1) {
       // increment by a word at a time
       lvid_type lvid_block_start = shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
       if (lvid_block_start >= graph.num_local_vertices()) break;
 
+      // get the bit field from has_message
+      size_t lvid_bit_block;
       if (vset.lazy)  {
         ASSERT_TRUE(vset.is_complete_set);
-        local_bitset.fill();
+        lvid_bit_block = size_t(-1);
       } else {
-        // get the bit field from has_message
-        size_t lvid_bit_block = vset.localvset.containing_word(lvid_block_start);
-        if (lvid_bit_block == 0) continue;
-        // initialize a word sized bitfield
-        local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+        lvid_bit_block = vset.localvset.containing_word(lvid_block_start);
       }
 
-      foreach(size_t lvid_block_offset, local_bitset) {
-        lvid_type lvid = lvid_block_start + lvid_block_offset;
+      while (lvid_bit_block) {
+        lvid_type lvid = lvid_block_start +
+            dense_bitset::pop_first_bit(lvid_bit_block);
         if (lvid >= graph.num_local_vertices()) break;
 
         if (graph.l_is_master(lvid))
@@ -554,11 +546,18 @@ namespace graphlab {
   recv_gathers(const bool try_to_recv) {
     procid_t procid(-1);
     typename gather_exchange_type::buffer_type buffer;
+    std::vector<vertex_id_type> vids;
+    std::vector<lvid_type> lvids;
     while(gather_exchange.recv(procid, buffer, try_to_recv)) {
-      foreach(const vid_gather_pair_type& pair, buffer) {
-        ASSERT_TRUE(graph.vid2lvid.find(pair.first) != graph.vid2lvid.end());
-        const lvid_type lvid = graph.local_vid(pair.first);
-        const gather_type& accum = pair.second;
+      if (buffer.empty()) continue;
+      vids.resize(buffer.size());
+      lvids.resize(buffer.size());
+      for (size_t i = 0; i < buffer.size(); ++i) vids[i] = buffer[i].first;
+      const size_t found = graph.local_vids(&vids[0], vids.size(), &lvids[0]);
+      ASSERT_EQ(found, vids.size());
+      for (size_t i = 0; i < buffer.size(); ++i) {
+        const lvid_type lvid = lvids[i];
+        const gather_type& accum = buffer[i].second;
         vlocks[lvid].lock();
         if( has_gather_accum.get(lvid) ) {
           gather_accum[lvid] += accum;
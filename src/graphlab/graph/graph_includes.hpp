@@ -25,6 +25,8 @@
 
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/graph/vertex_set.hpp>
+#include <graphlab/graph/vertex_column.hpp>
+#include <graphlab/graph/graph_query_service.hpp>
 #endif
 
 
@@ -25,7 +25,8 @@
  * \file graph_ops.hpp
  *
  * This file supports basic graph io operations to simplify reading
- * and writing adjacency structures from files.
+ * and writing adjacency structures from files, and basic kernels over
+ * the adjacency of a distributed graph.
  *
  */
 
@@ -37,9 +38,14 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <queue>
+#include <vector>
+#include <algorithm>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
+#include <graphlab/graph/sorted_intersection.hpp>
+#include <graphlab/graph/graph_gather_apply.hpp>
 
 #include <graphlab/macros_def.hpp>
 namespace graphlab {
@@ -277,6 +283,384 @@ namespace graphlab {
 
 
 
+    /**
+     * \brief The adjacency of the graph oriented by degree rank, as
+     * built by orient_by_degree().
+     *
+     * Vertices are ranked by total degree, ties broken by id, and each
+     * vertex keeps only its neighbors of higher rank. Every undirected
+     * edge is thus kept once, high degree vertices keep short lists,
+     * and each triangle {a, b, c} with a < b < c in rank shows up
+     * exactly once: c is in the lists of both ends of the edge (a, b).
+     *
+     * The lists of all local vertices (masters and mirrors) are sorted
+     * global ids stored back to back in one array, indexed by lvid.
+     */
+    class oriented_adjacency {
+    public:
+      /// The number of local vertices
+      size_t num_vertices() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+      }
+
+      /// The number of oriented neighbors of local vertex lvid
+      size_t size(lvid_type lvid) const {
+        return offsets[lvid + 1] - offsets[lvid];
+      }
+
+      /// The sorted oriented neighbors of local vertex lvid
+      const vertex_id_type* begin(lvid_type lvid) const {
+        return targets.empty() ? NULL : &targets[0] + offsets[lvid];
+      }
+
+      const vertex_id_type* end(lvid_type lvid) const {
+        return begin(lvid) + size(lvid);
+      }
+
+      /// The number of common oriented neighbors of two local vertices
+      size_t intersection_size(lvid_type u, lvid_type v) const {
+        return sorted_intersection_size(begin(u), size(u), begin(v), size(v));
+      }
+
+      /// Replaces the lists by the given sorted ones, clearing them
+      void assign(std::vector<std::vector<vertex_id_type> >& lists) {
+        offsets.resize(lists.size() + 1);
+        offsets[0] = 0;
+        for (size_t i = 0; i < lists.size(); ++i) {
+          offsets[i + 1] = offsets[i] + lists[i].size();
+        }
+        std::vector<vertex_id_type>(offsets.back()).swap(targets);
+        for (size_t i = 0; i < lists.size(); ++i) {
+          std::copy(lists[i].begin(), lists[i].end(),
+                    targets.begin() + offsets[i]);
+          std::vector<vertex_id_type>().swap(lists[i]);
+        }
+      }
+
+      void clear() {
+        std::vector<size_t>().swap(offsets);
+        std::vector<vertex_id_type>().swap(targets);
+      }
+
+    private:
+      std::vector<size_t> offsets;
+      std::vector<vertex_id_type> targets;
+    }; // end of oriented_adjacency
+
+
+    /// True if vertex u (of degree udeg) has a lower rank than v
+    inline bool degree_rank_less(size_t udeg, vertex_id_type u,
+                                 size_t vdeg, vertex_id_type v) {
+      return udeg < vdeg || (udeg == vdeg && u < v);
+    }
+
+
+    namespace orient_impl {
+      /// The gather type of orient_by_degree(): a list of global ids
+      struct vid_list {
+        std::vector<vertex_id_type> vids;
+        vid_list& operator+=(const vid_list& other) {
+          vids.insert(vids.end(), other.vids.begin(), other.vids.end());
+          return *this;
+        }
+        void save(oarchive& oarc) const { oarc << vids; }
+        void load(iarchive& iarc) { iarc >> vids; }
+      };
+
+      // collects the local neighbors of higher rank of lvid
+      template <typename Graph>
+      vid_list gather_higher_ranked(lvid_type lvid, Graph& graph) {
+        typedef typename Graph::local_vertex_type local_vertex_type;
+        typedef typename Graph::local_edge_type   local_edge_type;
+        local_vertex_type vtx = graph.l_vertex(lvid);
+        const vertex_id_type vid = vtx.global_id();
+        const size_t degree =
+            vtx.global_num_in_edges() + vtx.global_num_out_edges();
+        vid_list ret;
+        foreach(const local_edge_type& e, vtx.in_edges()) {
+          const local_vertex_type other = e.source();
+          if (degree_rank_less(degree, vid, other.global_num_in_edges() +
+                               other.global_num_out_edges(), other.global_id())) {
+            ret.vids.push_back(other.global_id());
+          }
+        }
+        foreach(const local_edge_type& e, vtx.out_edges()) {
+          const local_vertex_type other = e.target();
+          if (degree_rank_less(degree, vid, other.global_num_in_edges() +
+                               other.global_num_out_edges(), other.global_id())) {
+            ret.vids.push_back(other.global_id());
+          }
+        }
+        return ret;
+      }
+
+      // stores the merged list of every copy of lvid, sorted
+      template <typename Graph>
+      void store_oriented(lvid_type lvid, const vid_list& accum, Graph& graph,
+                          std::vector<std::vector<vertex_id_type> >* lists) {
+        std::vector<vertex_id_type>& list = (*lists)[lvid];
+        list = accum.vids;
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+      }
+    } // namespace orient_impl
+
+
+    /**
+     * \brief Orients the finalized graph by degree rank and stores
+     * the oriented adjacency of every local vertex.
+     *
+     * Each machine orients its local edges by the global degrees
+     * already known to all copies of their endpoints, so the only
+     * communication is one exchange of the oriented lists from the
+     * mirrors to the masters and back. Afterwards the neighborhoods of
+     * the two ends of every local edge are available locally: for
+     * instance the triangles through each edge are counted with
+     * oriented_adjacency::intersection_size() alone.
+     *
+     * Must be called on all machines at the same time, after
+     * finalize(). Edge directions are ignored.
+     */
+    template <typename VertexType, typename EdgeType>
+    void orient_by_degree(distributed_graph<VertexType, EdgeType>& graph,
+                          oriented_adjacency& adjacency,
+                          const graphlab_options& opts = graphlab_options()) {
+      typedef distributed_graph<VertexType, EdgeType> graph_type;
+      std::vector<std::vector<vertex_id_type> >
+          lists(graph.num_local_vertices());
+      graph_gather_apply<graph_type, orient_impl::vid_list>
+          orient(graph, orient_impl::gather_higher_ranked<graph_type>,
+                 boost::bind(orient_impl::store_oriented<graph_type>,
+                             _1, _2, _3, &lists),
+                 opts);
+      orient.exec();
+      adjacency.assign(lists);
+    } // end of orient_by_degree
+
+
+
+    /**
+     * \brief A dense block of values with k columns, one row per
+     * local vertex (masters and mirrors).
+     *
+     * The k values of a vertex are stored contiguously so a sparse
+     * multiply reads a whole row per edge. Rows are indexed by lvid and
+     * are only meaningful on the machines where the vertex is present;
+     * sparse_multiplier keeps the rows of all copies equal.
+     */
+    class local_block {
+    public:
+      local_block() : ncols(0) { }
+
+      template <typename Graph>
+      local_block(const Graph& graph, size_t ncols) : ncols(0) {
+        resize(graph.num_local_vertices(), ncols);
+      }
+
+      /// Resizes to nrows x ncols, setting every value to 0
+      void resize(size_t nrows, size_t ncols_) {
+        ncols = ncols_;
+        std::vector<double>(nrows * ncols, 0.0).swap(values);
+      }
+
+      size_t num_rows() const { return ncols == 0 ? 0 : values.size() / ncols; }
+      size_t num_cols() const { return ncols; }
+
+      double* row(lvid_type lvid) { return &values[lvid * ncols]; }
+      const double* row(lvid_type lvid) const { return &values[lvid * ncols]; }
+
+      double& operator()(lvid_type lvid, size_t col) {
+        return values[lvid * ncols + col];
+      }
+      double operator()(lvid_type lvid, size_t col) const {
+        return values[lvid * ncols + col];
+      }
+
+      void fill(double value) {
+        std::fill(values.begin(), values.end(), value);
+      }
+
+      void swap(local_block& other) {
+        std::swap(ncols, other.ncols);
+        values.swap(other.values);
+      }
+
+    private:
+      size_t ncols;
+      std::vector<double> values;
+    }; // end of local_block
+
+
+    /// The edge weight of sparse_multiplier when none is given
+    struct unit_weight {
+      template <typename EdgeData>
+      double operator()(const EdgeData& edata) const { return 1.0; }
+    };
+
+
+    namespace multiply_impl {
+      /// The gather type of sparse_multiplier. Empty means zero.
+      struct block_row {
+        std::vector<double> values;
+        block_row& operator+=(const block_row& other) {
+          if (values.empty()) {
+            values = other.values;
+          } else {
+            for (size_t i = 0; i < other.values.size(); ++i) {
+              values[i] += other.values[i];
+            }
+          }
+          return *this;
+        }
+        void save(oarchive& oarc) const { oarc << values; }
+        void load(iarchive& iarc) { iarc >> values; }
+      };
+
+      // row += weight * x, for a row of length k
+      inline void axpy(block_row& row, double weight, const double* x,
+                       size_t k) {
+        if (row.values.empty()) row.values.resize(k, 0.0);
+        double* y = &row.values[0];
+        for (size_t j = 0; j < k; ++j) y[j] += weight * x[j];
+      }
+
+      /// The rows of x, and the sums of products on the transpose
+      template <typename Graph>
+      struct block_map {
+        typedef typename Graph::vertex_type vertex_type;
+        const local_block* x;
+        const local_block* y;
+        block_row operator()(const vertex_type& vertex) const {
+          const size_t kx = x->num_cols(), ky = y->num_cols();
+          const double* xr = x->row(vertex.local_id());
+          const double* yr = y->row(vertex.local_id());
+          block_row ret;
+          ret.values.resize(kx * ky);
+          for (size_t a = 0; a < kx; ++a) {
+            for (size_t b = 0; b < ky; ++b) {
+              ret.values[a * ky + b] = xr[a] * yr[b];
+            }
+          }
+          return ret;
+        }
+      };
+    } // namespace multiply_impl
+
+
+    /**
+     * \brief Multiplies dense blocks of vectors by the sparse adjacency
+     * matrix of the graph.
+     *
+     * With A(u,v) = weight(data of edge u->v), operator()(x, y) computes
+     * \f$ y = A^T x \f$ on IN_EDGES, \f$ y = A x \f$ on OUT_EDGES and
+     * \f$ y = (A + A^T) x \f$ on ALL_EDGES, for all the columns of x at
+     * once. Every copy of a vertex sums the products over its local
+     * edges, reading the k values of the other end contiguously, and the
+     * partial rows are combined in a single exchange from the mirrors to
+     * the master and back. Both x and y must therefore hold the same rows
+     * on all copies, which y does afterwards, so products can be chained.
+     *
+     * The multiplier owns a graph_gather_apply and should be constructed
+     * once and reused. It must be constructed and called on all machines
+     * at the same time, and x and y must be different blocks.
+     *
+     * \code
+     * graph_ops::sparse_multiplier<graph_type> multiply(graph);
+     * graph_ops::local_block x(graph, 4), y(graph, 4);
+     * ...
+     * multiply(x, y);
+     * \endcode
+     */
+    template <typename Graph, typename WeightFunction = unit_weight>
+    class sparse_multiplier {
+    public:
+      typedef Graph graph_type;
+      typedef typename graph_type::local_vertex_type local_vertex_type;
+      typedef typename graph_type::local_edge_type   local_edge_type;
+
+      sparse_multiplier(graph_type& graph, edge_dir_type dir = IN_EDGES,
+                        WeightFunction weight = WeightFunction(),
+                        const graphlab_options& opts = graphlab_options()) :
+          dir(dir), weight(weight), x(NULL), y(NULL),
+          engine(graph,
+                 boost::bind(&sparse_multiplier::gather_row, this, _1, _2),
+                 boost::bind(&sparse_multiplier::store_row, this, _1, _2, _3),
+                 opts) { }
+
+      /// Computes y from x. y is resized to the shape of x.
+      void operator()(const local_block& x_, local_block& y_) {
+        ASSERT_NE(&x_, &y_);
+        if (y_.num_rows() != x_.num_rows() || y_.num_cols() != x_.num_cols()) {
+          y_.resize(x_.num_rows(), x_.num_cols());
+        }
+        x = &x_;
+        y = &y_;
+        engine.exec();
+        x = NULL;
+        y = NULL;
+      }
+
+    private:
+      edge_dir_type dir;
+      WeightFunction weight;
+      const local_block* x;
+      local_block* y;
+      graph_gather_apply<graph_type, multiply_impl::block_row> engine;
+
+      multiply_impl::block_row gather_row(lvid_type lvid, graph_type& graph) {
+        const size_t k = x->num_cols();
+        multiply_impl::block_row ret;
+        local_vertex_type vtx = graph.l_vertex(lvid);
+        if (dir == IN_EDGES || dir == ALL_EDGES) {
+          foreach(const local_edge_type& e, vtx.in_edges()) {
+            multiply_impl::axpy(ret, weight(e.data()), 
+                                x->row(e.source().id()), k);
+          }
+        }
+        if (dir == OUT_EDGES || dir == ALL_EDGES) {
+          foreach(const local_edge_type& e, vtx.out_edges()) {
+            multiply_impl::axpy(ret, weight(e.data()), 
+                                x->row(e.target().id()), k);
+          }
+        }
+        return ret;
+      }
+
+      void store_row(lvid_type lvid, const multiply_impl::block_row& accum,
+                     graph_type& graph) {
+        double* yr = y->row(lvid);
+        if (accum.values.empty()) {
+          std::fill(yr, yr + y->num_cols(), 0.0);
+        } else {
+          std::copy(accum.values.begin(), accum.values.end(), yr);
+        }
+      }
+    }; // end of sparse_multiplier
+
+
+    /**
+     * \brief Computes the kx by ky matrix \f$ X^T Y \f$ of two blocks over
+     * the master vertices, stored row major, on all machines.
+     *
+     * This is a single map_reduce_vertices, so all the inner products
+     * needed to orthogonalize a block cost one pass and one reduction.
+     */
+    template <typename VertexType, typename EdgeType>
+    std::vector<double>
+    inner_products(distributed_graph<VertexType, EdgeType>& graph,
+                   const local_block& x, const local_block& y) {
+      typedef distributed_graph<VertexType, EdgeType> graph_type;
+      multiply_impl::block_map<graph_type> map;
+      map.x = &x;
+      map.y = &y;
+      std::vector<double> ret =
+          graph.template map_reduce_vertices<multiply_impl::block_row>(map).values;
+      ret.resize(x.num_cols() * y.num_cols(), 0.0);
+      return ret;
+    } // end of inner_products
+
+
+
   }; // end of graph ops
 }; // end of namespace graphlab
 #include <graphlab/macros_undef.hpp>
@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_QUERY_SERVICE_HPP
+#define GRAPHLAB_GRAPH_QUERY_SERVICE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/fiber_group.hpp>
+#include <graphlab/parallel/fiber_remote_request.hpp>
+#include <graphlab/ui/metrics_server.hpp>
+#include <graphlab/ui/openmetrics.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Answers k-hop neighborhood queries on a resident distributed
+   * graph.
+   *
+   * The service is constructed by all the machines at the same time,
+   * like the engines, on a finalized graph which may be shared with
+   * running engines: the queries only read the graph structure. A query
+   * runs a breadth first search of at most a given number of hops from
+   * a source vertex. Each hop sends the frontier to every machine,
+   * which returns the neighbors along its local edges, so that a
+   * vertex cut needs no extra round trip through the masters.
+   * Optionally at most fanout neighbors of each vertex are sampled, and
+   * the search stops once max_vertices vertices are found.
+   *
+   * Every query runs in its own fiber, which waits for the replies
+   * with object_fiber_remote_request(), and at most
+   * max_concurrent_queries queries run at once; the others are
+   * rejected. The latencies of the last LATENCY_WINDOW queries are
+   * kept to report percentiles.
+   *
+   * publish() serves the queries on the metrics server:
+   * \li \c khop.json?vid=V&hops=K&fanout=F&max_vertices=N&dir=out|in|all
+   *     runs a query. Only vid is required.
+   * \li \c graph_query_stats.json reports the query counts and latencies,
+   *     which are also added to the /metrics page.
+   */
+  template <typename Graph>
+  class graph_query_service {
+  public:
+    typedef Graph graph_type;
+    typedef typename graph_type::local_vertex_type local_vertex_type;
+    typedef typename graph_type::local_edge_type local_edge_type;
+
+    /// The result of a query
+    struct query_result {
+      /// The vertices found with their distance to the source
+      std::vector<std::pair<vertex_id_type, size_t> > vertices;
+      /// The edges between the vertices found, as (source, target)
+      std::vector<std::pair<vertex_id_type, vertex_id_type> > edges;
+      /// True if the search stopped at max_vertices
+      bool truncated;
+      /// Non empty if the query failed or was rejected
+      std::string error;
+      double latency;
+      query_result() : truncated(false), latency(0) { }
+
+      std::string to_json() const {
+        std::stringstream strm;
+        if (!error.empty()) {
+          strm << "{\"error\": \"" << error << "\"}\n";
+          return strm.str();
+        }
+        strm << "{\n  \"truncated\": " << (truncated ? "true" : "false")
+             << ",\n  \"latency_ms\": " << 1000 * latency
+             << ",\n  \"vertices\": [";
+        for (size_t i = 0; i < vertices.size(); ++i) {
+          strm << (i == 0 ? "" : ", ") << "[" << vertices[i].first << ", "
+               << vertices[i].second << "]";
+        }
+        strm << "],\n  \"edges\": [";
+        for (size_t i = 0; i < edges.size(); ++i) {
+          strm << (i == 0 ? "" : ", ") << "[" << edges[i].first << ", "
+               << edges[i].second << "]";
+        }
+        strm << "]\n}\n";
+        return strm.str();
+      }
+    }; // end of query_result
+
+    enum {
+      DEFAULT_MAX_CONCURRENT_QUERIES = 64,
+      DEFAULT_MAX_HOPS = 3,
+      DEFAULT_MAX_VERTICES = 10000,
+      LATENCY_WINDOW = 1024,
+      QUERY_STACK_SIZE = 64 * 1024
+    };
+
+  private:
+    /// The out and in neighbors of one vertex
+    typedef std::pair<std::vector<vertex_id_type>,
+                      std::vector<vertex_id_type> > adjacency_type;
+
+    dc_dist_object<graph_query_service> rmi;
+    graph_type& graph;
+    size_t max_concurrent_queries;
+    size_t max_hops;
+    size_t max_vertices;
+
+    atomic<size_t> active_queries;
+    atomic<size_t> num_queries;
+    atomic<size_t> rejected_queries;
+    mutex latency_lock;
+    /// The latencies of the last queries, in seconds, used as a ring
+    std::vector<double> latencies;
+    size_t latency_pos;
+
+  public:
+    graph_query_service(distributed_control& dc, graph_type& graph) :
+      rmi(dc, this), graph(graph),
+      max_concurrent_queries(DEFAULT_MAX_CONCURRENT_QUERIES),
+      max_hops(DEFAULT_MAX_HOPS), max_vertices(DEFAULT_MAX_VERTICES),
+      latency_pos(0) {
+      rmi.barrier();
+    }
+
+    /// Stops serving the pages registered by publish()
+    ~graph_query_service() {
+      add_metric_server_callback("khop.json", stopped_page);
+      add_metric_server_callback("graph_query_stats.json", stopped_page);
+      add_openmetrics_source("graph_query", no_metrics);
+    }
+
+    /// Queries beyond this many running at once are rejected
+    void set_max_concurrent_queries(size_t n) { max_concurrent_queries = n; }
+
+    /// The largest number of hops of a query
+    void set_max_hops(size_t n) { max_hops = n; }
+
+    /// The largest number of vertices a query returns
+    void set_max_vertices(size_t n) { max_vertices = n; }
+
+    /**
+     * Returns the vertices within hops hops of source along the edges
+     * in direction dir, and the edges between them. If fanout is not
+     * 0, at most fanout random neighbors of each vertex are followed.
+     * A max_vertices of 0 stands for the limit of the service. May be
+     * called by any thread or fiber of any machine.
+     */
+    query_result khop(vertex_id_type source, size_t hops,
+                      edge_dir_type dir = OUT_EDGES, size_t fanout = 0,
+                      size_t max_vertices = 0) {
+      query_result result;
+      if (!graph.is_finalized()) {
+        result.error = "the graph is not finalized";
+        return result;
+      }
+      if (active_queries.inc() > max_concurrent_queries) {
+        active_queries.dec();
+        rejected_queries.inc();
+        result.error = "too many concurrent queries";
+        return result;
+      }
+      timer ti; ti.start();
+      hops = std::min(hops, max_hops);
+      if (max_vertices == 0 || max_vertices > this->max_vertices) {
+        max_vertices = this->max_vertices;
+      }
+      if (fiber_control::in_fiber()) {
+        run_khop(source, hops, dir, fanout, max_vertices, &result);
+      } else {
+        fiber_group group(QUERY_STACK_SIZE);
+        group.launch(boost::bind(&graph_query_service::run_khop, this,
+                                 source, hops, dir, fanout, max_vertices,
+                                 &result));
+        group.join();
+      }
+      result.latency = ti.current_time();
+      record_latency(result.latency);
+      num_queries.inc();
+      active_queries.dec();
+      return result;
+    }
+
+    /// Returns the q'th quantile of the latencies of the last queries
+    double latency_quantile(double q) {
+      latency_lock.lock();
+      std::vector<double> sorted(latencies);
+      latency_lock.unlock();
+      if (sorted.empty()) return 0;
+      const size_t k = std::min(sorted.size() - 1,
+                                size_t(q * sorted.size()));
+      std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+      return sorted[k];
+    }
+
+    /**
+     * Serves khop.json and graph_query_stats.json on the metrics server
+     * and adds the query metrics to its /metrics page.
+     */
+    void publish() {
+      add_metric_server_callback(
+          "khop.json", boost::bind(&graph_query_service::khop_page, this, _1));
+      add_metric_server_callback(
+          "graph_query_stats.json",
+          boost::bind(&graph_query_service::stats_page, this, _1));
+      add_openmetrics_source(
+          "graph_query",
+          boost::bind(&graph_query_service::write_metrics, this, _1));
+    }
+
+  private:
+    /// Runs a query in a fiber. See khop()
+    void run_khop(vertex_id_type source, size_t hops, edge_dir_type dir,
+                  size_t fanout, size_t max_vertices, query_result* result) {
+      boost::unordered_map<vertex_id_type, size_t> distance;
+      boost::unordered_set<std::pair<vertex_id_type, vertex_id_type> > edges;
+      std::vector<vertex_id_type> frontier(1, source);
+      distance[source] = 0;
+      result->vertices.push_back(std::make_pair(source, size_t(0)));
+      for (size_t hop = 1; hop <= hops && !frontier.empty(); ++hop) {
+        std::vector<adjacency_type> adjacency;
+        gather_adjacency(frontier, dir, fanout, adjacency);
+        std::vector<vertex_id_type> next_frontier;
+        for (size_t i = 0; i < frontier.size(); ++i) {
+          const vertex_id_type vid = frontier[i];
+          sample(adjacency[i].first, fanout);
+          sample(adjacency[i].second, fanout);
+          foreach(vertex_id_type nbr, adjacency[i].first) {
+            edges.insert(std::make_pair(vid, nbr));
+          }
+          foreach(vertex_id_type nbr, adjacency[i].second) {
+            edges.insert(std::make_pair(nbr, vid));
+          }
+          for (size_t side = 0; side < 2; ++side) {
+            const std::vector<vertex_id_type>& nbrs =
+                side == 0 ? adjacency[i].first : adjacency[i].second;
+            foreach(vertex_id_type nbr, nbrs) {
+              if (distance.count(nbr)) continue;
+              if (distance.size() >= max_vertices) {
+                result->truncated = true;
+                break;
+              }
+              distance[nbr] = hop;
+              result->vertices.push_back(std::make_pair(nbr, hop));
+              next_frontier.push_back(nbr);
+            }
+          }
+        }
+        frontier.swap(next_frontier);
+      }
+      typedef std::pair<vertex_id_type, vertex_id_type> edge_pair;
+      foreach(const edge_pair& e, edges) {
+        if (distance.count(e.first) && distance.count(e.second)) {
+          result->edges.push_back(e);
+        }
+      }
+    }
+
+    /**
+     * Collects the neighbors of the vertices from every machine, each
+     * machine sampling at most fanout of its local ones.
+     */
+    void gather_adjacency(const std::vector<vertex_id_type>& vids,
+                          edge_dir_type dir, size_t fanout,
+                          std::vector<adjacency_type>& adjacency) {
+      std::vector<request_future<std::vector<adjacency_type> > >
+          futures(rmi.numprocs());
+      for (procid_t proc = 0; proc < rmi.numprocs(); ++proc) {
+        if (proc == rmi.procid()) continue;
+        futures[proc] = object_fiber_remote_request(
+            rmi, proc, &graph_query_service::local_adjacency, vids,
+            size_t(dir), fanout);
+      }
+      adjacency = local_adjacency(vids, size_t(dir), fanout);
+      for (procid_t proc = 0; proc < rmi.numprocs(); ++proc) {
+        if (proc == rmi.procid()) continue;
+        const std::vector<adjacency_type> remote = futures[proc]();
+        for (size_t i = 0; i < vids.size(); ++i) {
+          adjacency[i].first.insert(adjacency[i].first.end(),
+                                    remote[i].first.begin(),
+                                    remote[i].first.end());
+          adjacency[i].second.insert(adjacency[i].second.end(),
+                                     remote[i].second.begin(),
+                                     remote[i].second.end());
+        }
+      }
+    }
+
+    /// Returns the neighbors of the vertices along the local edges
+    std::vector<adjacency_type>
+    local_adjacency(const std::vector<vertex_id_type>& vids, size_t dir,
+                    size_t fanout) {
+      std::vector<adjacency_type> adjacency(vids.size());
+      for (size_t i = 0; i < vids.size(); ++i) {
+        lvid_type lvid;
+        if (!graph.find_local_vid(vids[i], lvid)) continue;
+        local_vertex_type vertex = graph.l_vertex(lvid);
+        if (dir == OUT_EDGES || dir == ALL_EDGES) {
+          foreach(local_edge_type edge, vertex.out_edges()) {
+            adjacency[i].first.push_back(edge.target().global_id());
+          }
+          sample(adjacency[i].first, fanout);
+        }
+        if (dir == IN_EDGES || dir == ALL_EDGES) {
+          foreach(local_edge_type edge, vertex.in_edges()) {
+            adjacency[i].second.push_back(edge.source().global_id());
+          }
+          sample(adjacency[i].second, fanout);
+        }
+      }
+      return adjacency;
+    }
+
+    /// Keeps fanout random elements of vids, or all if fanout is 0
+    static void sample(std::vector<vertex_id_type>& vids, size_t fanout) {
+      if (fanout == 0 || vids.size() <= fanout) return;
+      for (size_t i = 0; i < fanout; ++i) {
+        std::swap(vids[i], vids[random::fast_uniform<size_t>(i, vids.size() - 1)]);
+      }
+      vids.resize(fanout);
+    }
+
+    void record_latency(double seconds) {
+      latency_lock.lock();
+      if (latencies.size() < LATENCY_WINDOW) {
+        latencies.push_back(seconds);
+      } else {
+        latencies[latency_pos] = seconds;
+        latency_pos = (latency_pos + 1) % LATENCY_WINDOW;
+      }
+      latency_lock.unlock();
+    }
+
+    /// Returns the value of the GET variable name, or def if not set
+    static bool get_variable(std::map<std::string, std::string>& varmap,
+                             const std::string& name, size_t def,
+                             size_t& value) {
+      value = def;
+      if (varmap.count(name) == 0) return true;
+      const std::string& str = varmap[name];
+      char* end = NULL;
+      value = strtoull(str.c_str(), &end, 10);
+      return !str.empty() && *end == '\0';
+    }
+
+    std::pair<std::string, std::string>
+    khop_page(std::map<std::string, std::string>& varmap) {
+      query_result result;
+      size_t vid = 0, hops = 0, fanout = 0, nverts = 0;
+      edge_dir_type dir = OUT_EDGES;
+      if (varmap.count("dir")) {
+        if (varmap["dir"] == "in") dir = IN_EDGES;
+        else if (varmap["dir"] == "all") dir = ALL_EDGES;
+        else if (varmap["dir"] != "out") result.error = "dir must be out, in or all";
+      }
+      if (varmap.count("vid") == 0 ||
+          !get_variable(varmap, "vid", 0, vid) ||
+          !get_variable(varmap, "hops", 1, hops) ||
+          !get_variable(varmap, "fanout", 0, fanout) ||
+          !get_variable(varmap, "max_vertices", 0, nverts)) {
+        result.error = "vid, hops, fanout and max_vertices must be integers "
+                       "and vid is required";
+      }
+      if (result.error.empty()) {
+        result = khop(vertex_id_type(vid), hops, dir, fanout, nverts);
+      }
+      return std::make_pair(std::string("application/json"), result.to_json());
+    }
+
+    std::pair<std::string, std::string>
+    stats_page(std::map<std::string, std::string>& varmap) {
+      std::stringstream strm;
+      strm << "{\n  \"queries\": " << num_queries.value
+           << ",\n  \"rejected\": " << rejected_queries.value
+           << ",\n  \"active\": " << active_queries.value
+           << ",\n  \"p50_ms\": " << 1000 * latency_quantile(0.5)
+           << ",\n  \"p99_ms\": " << 1000 * latency_quantile(0.99)
+           << ",\n  \"max_ms\": " << 1000 * latency_quantile(1.0)
+           << "\n}\n";
+      return std::make_pair(std::string("application/json"), strm.str());
+    }
+
+    void write_metrics(openmetrics_writer& writer) {
+      writer.family("graphlab_graph_queries", "counter",
+                    "k-hop queries answered");
+      writer.sample("graphlab_graph_queries_total", num_queries.value);
+      writer.family("graphlab_graph_queries_rejected", "counter",
+                    "k-hop queries rejected by the concurrency limit");
+      writer.sample("graphlab_graph_queries_rejected_total",
+                    rejected_queries.value);
+      writer.family("graphlab_graph_queries_active", "gauge",
+                    "k-hop queries running");
+      writer.sample("graphlab_graph_queries_active", active_queries.value);
+      writer.family("graphlab_graph_query_latency_seconds", "gauge",
+                    "Latency quantiles of the last k-hop queries");
+      writer.sample("graphlab_graph_query_latency_seconds",
+                    latency_quantile(0.5), "quantile=\"0.5\"");
+      writer.sample("graphlab_graph_query_latency_seconds",
+                    latency_quantile(0.99), "quantile=\"0.99\"");
+    }
+
+    static std::pair<std::string, std::string>
+    stopped_page(std::map<std::string, std::string>& varmap) {
+      return std::make_pair(std::string("application/json"),
+                            std::string("{\"error\": \"the query service "
+                                        "has stopped\"}\n"));
+    }
+
+    static void no_metrics(openmetrics_writer& writer) { }
+  }; // end of graph_query_service
+
+} // end of namespace graphlab
+
+#include <graphlab/macros_undef.hpp>
+#endif
@@ -0,0 +1,227 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_GRAPH_SNAPSHOT_HPP
+#define GRAPHLAB_GRAPH_SNAPSHOT_HPP
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * The header at the start of a graph snapshot file.
+   *
+   * A snapshot is a sequence of sections, each holding the raw bytes of
+   * one array exactly as it is laid out in memory.  Every section
+   * starts on a page boundary so that it can be mapped directly.  The
+   * element size of each section is recorded so that a snapshot
+   * written with different vertex, edge or id types is rejected.
+   */
+  struct snapshot_header {
+    enum { MAX_SECTIONS = 32 };
+    char magic[8];
+    uint64_t version;
+    uint64_t nsections;
+    uint64_t offset[MAX_SECTIONS];
+    uint64_t length[MAX_SECTIONS];
+    uint64_t elem_size[MAX_SECTIONS];
+
+    static const char* expected_magic() { return "GLSNAPSH"; }
+    enum { CURRENT_VERSION = 1 };
+    enum { ALIGNMENT = 4096 };
+  };
+
+  /**
+   * \internal
+   * Writes a snapshot file one array at a time.  The arrays must hold
+   * trivially copyable elements.
+   */
+  class snapshot_writer {
+   public:
+    snapshot_writer(const std::string& fname) :
+      out(fname.c_str(), std::ios_base::out | std::ios_base::binary |
+                         std::ios_base::trunc), pos(0) {
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, snapshot_header::expected_magic(), 8);
+      header.version = snapshot_header::CURRENT_VERSION;
+      // reserve room for the header
+      pad_to(sizeof(snapshot_header));
+    }
+
+    bool good() const { return out.good(); }
+
+    /// Appends the contents of vec as the next section
+    template <typename T>
+    void write(const std::vector<T>& vec) {
+      ASSERT_LT(header.nsections, (uint64_t)snapshot_header::MAX_SECTIONS);
+      align();
+      const size_t i = header.nsections++;
+      header.offset[i] = pos;
+      header.length[i] = vec.size();
+      header.elem_size[i] = sizeof(T);
+      if (!vec.empty()) {
+        out.write(reinterpret_cast<const char*>(&vec[0]), sizeof(T) * vec.size());
+        pos += sizeof(T) * vec.size();
+      }
+    }
+
+    /// Writes the header and closes the file. Returns false on failure.
+    bool close() {
+      out.seekp(0);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.close();
+      return !out.fail();
+    }
+
+   private:
+    std::ofstream out;
+    snapshot_header header;
+    uint64_t pos;
+
+    void align() {
+      const uint64_t rem = pos % snapshot_header::ALIGNMENT;
+      if (rem != 0) pad_to(pos + snapshot_header::ALIGNMENT - rem);
+    }
+    void pad_to(uint64_t target) {
+      static const char zeros[snapshot_header::ALIGNMENT] = {0};
+      while (pos < target) {
+        const uint64_t n = std::min<uint64_t>(target - pos, sizeof(zeros));
+        out.write(zeros, n);
+        pos += n;
+      }
+    }
+  };
+
+  /**
+   * \internal
+   * Maps a snapshot file into memory and reads its sections in order.
+   *
+   * Each section is copied out of the mapping with one memcpy per
+   * thread, so no element is deserialized and nothing is decompressed.
+   * Pages are only faulted in while their section is read, and the
+   * mapping is released when the reader is destroyed.
+   */
+  class snapshot_reader {
+   public:
+    snapshot_reader(const std::string& fname) :
+      fd(-1), base(NULL), size(0), next_section(0), header(NULL) {
+      fd = ::open(fname.c_str(), O_RDONLY);
+      if (fd < 0) return;
+      struct stat st;
+      if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(snapshot_header)) {
+        close_file();
+        return;
+      }
+      size = st.st_size;
+      void* ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr == MAP_FAILED) {
+        close_file();
+        return;
+      }
+      base = reinterpret_cast<const char*>(ptr);
+      header = reinterpret_cast<const snapshot_header*>(base);
+      if (memcmp(header->magic, snapshot_header::expected_magic(), 8) != 0 ||
+          header->version != snapshot_header::CURRENT_VERSION ||
+          header->nsections > snapshot_header::MAX_SECTIONS) {
+        logstream(LOG_ERROR) << fname << " is not a valid graph snapshot"
+                             << std::endl;
+        close_file();
+      }
+    }
+
+    ~snapshot_reader() { close_file(); }
+
+    bool good() const { return base != NULL; }
+
+    /// Returns true if the file starts with the snapshot magic
+    static bool is_snapshot(const std::string& fname) {
+      std::ifstream fin(fname.c_str(), std::ios_base::in | std::ios_base::binary);
+      char magic[8];
+      if (!fin.read(magic, 8)) return false;
+      return memcmp(magic, snapshot_header::expected_magic(), 8) == 0;
+    }
+
+    /**
+     * Reads the next section into vec.  Fails if the section was
+     * written with a different element size.
+     */
+    template <typename T>
+    void read(std::vector<T>& vec) {
+      ASSERT_TRUE(good());
+      ASSERT_LT(next_section, header->nsections);
+      const size_t i = next_section++;
+      if (header->elem_size[i] != sizeof(T)) {
+        logstream(LOG_FATAL) << "Snapshot section " << i << " has elements of "
+                             << header->elem_size[i] << " bytes, expected "
+                             << sizeof(T) << std::endl;
+      }
+      const size_t nbytes = header->length[i] * sizeof(T);
+      ASSERT_LE(header->offset[i] + nbytes, size);
+      std::vector<T>().swap(vec);
+      vec.resize(header->length[i]);
+      if (nbytes == 0) return;
+      const char* src = base + header->offset[i];
+      char* dst = reinterpret_cast<char*>(&vec[0]);
+      madvise(const_cast<char*>(src) - (header->offset[i] % getpagesize()),
+              nbytes + (header->offset[i] % getpagesize()), MADV_SEQUENTIAL);
+      const size_t chunk = 64 * 1024 * 1024;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+      for (ssize_t c = 0; c < ssize_t((nbytes + chunk - 1) / chunk); ++c) {
+        const size_t begin = c * chunk;
+        memcpy(dst + begin, src + begin, std::min(chunk, nbytes - begin));
+      }
+      // the copied pages will not be needed again
+      madvise(const_cast<char*>(src) - (header->offset[i] % getpagesize()),
+              nbytes + (header->offset[i] % getpagesize()), MADV_DONTNEED);
+    }
+
+   private:
+    int fd;
+    const char* base;
+    size_t size;
+    size_t next_section;
+    const snapshot_header* header;
+
+    void close_file() {
+      if (base != NULL) munmap(const_cast<char*>(base), size);
+      if (fd >= 0) ::close(fd);
+      base = NULL; header = NULL; fd = -1;
+    }
+  };
+
+} // end of namespace graphlab
+#endif
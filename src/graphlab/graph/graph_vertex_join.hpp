@@ -25,6 +25,7 @@
 #include <utility>
 #include <boost/unordered_map.hpp>
 #include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/util/concurrent_bloom_filter.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 namespace graphlab {
@@ -166,6 +167,16 @@ namespace graphlab {
  * ## Right Injective Join
  * The right injective join is similar to the left injective join, but
  * with types reversed.
+ *
+ * ## Co-partitioned graphs
+ * Keys emitted by a left and a right vertex owned by the same machine
+ * are matched locally. If every key is matched this way, as when both
+ * graphs were loaded with the same vertex placement and emit their
+ * vertex ids, the join is co-located: preparing it only costs a few
+ * reductions and the joins never send vertex data over the network.
+ * Otherwise, the keys which were not matched locally are filtered with
+ * bloom filters of the unmatched keys of the other graph (a semi-join),
+ * and only the keys which may match on another machine are shuffled.
  */
 template <typename LeftGraph, typename RightGraph> 
 class graph_vertex_join {
@@ -204,11 +215,29 @@ class graph_vertex_join {
 
     injective_join_index left_inj_index, right_inj_index;
 
+    /// Set if every key was matched on the machine owning both vertices
+    bool co_located;
+
+    /// Combines the bloom filters of all machines in all_reduce2()
+    struct filter_union {
+      void operator()(concurrent_bloom_filter& a,
+                      const concurrent_bloom_filter& b) const {
+        a |= b;
+      }
+    };
+
   public:
     graph_vertex_join(distributed_control& dc,
                       left_graph_type& left,
                       right_graph_type& right): 
-        rmi(dc, this), left_graph(left), right_graph(right) { }
+        rmi(dc, this), left_graph(left), right_graph(right),
+        co_located(false) { }
+
+    /**
+     * \brief Returns true if the last prepare_injective_join() matched
+     * every key locally, in which case the joins do not communicate.
+     */
+    bool is_co_located() const { return co_located; }
 
 
     /**
@@ -342,7 +371,7 @@ class graph_vertex_join {
       // clear the data
       idx.vtx_to_key.resize(graph.num_local_vertices());
       idx.key_to_vtx.clear(); 
-      idx.opposing_join_proc.resize(graph.num_local_vertices(), (procid_t)(-1));
+      idx.opposing_join_proc.assign(graph.num_local_vertices(), (procid_t)(-1));
       // loop through vertices, get the key and fill vtx_to_key and key_to_vtx
       for(lvid_type v = 0; v < graph.num_local_vertices(); ++v) {
         typename Graph::local_vertex_type lv = graph.l_vertex(v);
@@ -362,11 +391,82 @@ class graph_vertex_join {
       }
     }
 
+    /**
+     * Matches the keys of the owned vertices of graph with the keys
+     * owned by this machine in the opposing index, and returns the keys
+     * which did not match.
+     */
+    template <typename Graph>
+    std::vector<size_t> match_locally(injective_join_index& idx, Graph& graph,
+                                      const injective_join_index& opposing) {
+      std::vector<size_t> unmatched;
+      for (size_t i = 0; i < idx.vtx_to_key.size(); ++i) {
+        const size_t key = idx.vtx_to_key[i];
+        if (!graph.l_vertex(i).owned() || key == (size_t)(-1)) continue;
+        if (opposing.key_to_vtx.count(key) > 0) {
+          idx.opposing_join_proc[i] = rmi.procid();
+        } else {
+          unmatched.push_back(key);
+        }
+      }
+      return unmatched;
+    }
+
+    /**
+     * Keeps the keys which may be in the opposing_keys of some machine,
+     * using a bloom filter sized for the total number of opposing keys.
+     */
+    void semi_join(std::vector<size_t>& keys,
+                   const std::vector<size_t>& opposing_keys,
+                   size_t total_opposing_keys) {
+      concurrent_bloom_filter filter(total_opposing_keys);
+      for (size_t i = 0; i < opposing_keys.size(); ++i) {
+        filter.insert(opposing_keys[i]);
+      }
+      rmi.all_reduce2(filter, filter_union());
+      size_t nkept = 0;
+      for (size_t i = 0; i < keys.size(); ++i) {
+        if (filter.may_contain(keys[i])) keys[nkept++] = keys[i];
+      }
+      keys.resize(nkept);
+    }
+
     void compute_injective_join() {
+      // keys whose two vertices are owned by this machine join locally
+      std::vector<size_t> left_unmatched = 
+          match_locally(left_inj_index, left_graph, right_inj_index);
+      std::vector<size_t> right_unmatched = 
+          match_locally(right_inj_index, right_graph, left_inj_index);
+      size_t total_left_unmatched = left_unmatched.size();
+      size_t total_right_unmatched = right_unmatched.size();
+      rmi.all_reduce(total_left_unmatched);
+      rmi.all_reduce(total_right_unmatched);
+      co_located = (total_left_unmatched == 0 || total_right_unmatched == 0);
+      if (!co_located) {
+        // drop the keys which match nothing on the other graph. Both ends
+        // of a pair are kept, since a bloom filter has no false negatives.
+        std::vector<size_t> right_candidates = right_unmatched;
+        semi_join(right_candidates, left_unmatched, total_left_unmatched);
+        semi_join(left_unmatched, right_unmatched, total_right_unmatched);
+        right_unmatched.swap(right_candidates);
+        size_t ncandidates = left_unmatched.size() + right_unmatched.size();
+        rmi.all_reduce(ncandidates);
+        co_located = (ncandidates == 0);
+      }
+      if (rmi.procid() == 0) {
+        logstream(LOG_INFO) << "Injective join: " << total_left_unmatched
+                            << " left and " << total_right_unmatched
+                            << " right keys are not owned by the machine of "
+                            << "their match" << (co_located ? 
+                                ", the join is co-located" : "")
+                            << std::endl;
+      }
+      if (co_located) return;
+
       std::vector<std::vector<size_t> > left_keys = 
-          get_procs_with_keys(left_inj_index.vtx_to_key, left_graph);
+          get_procs_with_keys(left_unmatched);
       std::vector<std::vector<size_t> > right_keys = 
-          get_procs_with_keys(right_inj_index.vtx_to_key, right_graph);
+          get_procs_with_keys(right_unmatched);
       // now. for each key on the right, I need to figure out which proc it
       // belongs in. and vice versa. This is actually kind of annoying.
       // but since it is one-to-one, I only need to make a hash map of one side.
@@ -455,17 +555,14 @@ class graph_vertex_join {
 
     // each key is assigned to a controlling machine, who receives
     // the partial list of keys every other machine owns.
-    template <typename Graph>
     std::vector<std::vector<size_t> > 
-        get_procs_with_keys(const std::vector<size_t>& local_key_list, Graph& g) {
+        get_procs_with_keys(const std::vector<size_t>& local_key_list) {
       // this machine will get all keys from each processor where
       // key = procid mod numprocs
       std::vector<std::vector<size_t> > procs_with_keys(rmi.numprocs());
       for (size_t i = 0; i < local_key_list.size(); ++i) {
-        if (g.l_vertex(i).owned() && local_key_list[i] != (size_t)(-1)) {
-          procid_t target_procid = local_key_list[i] % rmi.numprocs();
-          procs_with_keys[target_procid].push_back(local_key_list[i]);
-        }
+        procid_t target_procid = local_key_list[i] % rmi.numprocs();
+        procs_with_keys[target_procid].push_back(local_key_list[i]);
       }
       rmi.all_to_all(procs_with_keys);
       return procs_with_keys;
@@ -494,8 +591,8 @@ class graph_vertex_join {
           }
         }
       }
-      // exchange
-      rmi.all_to_all(source_data);
+      // exchange. A co-located join only has data for this machine.
+      if (!co_located) rmi.all_to_all(source_data);
       // ok. now join against left
 #ifdef _OPENMP
 #pragma omp parallel for
@@ -99,7 +99,8 @@ namespace graphlab {
     } // end of add edge
 
     virtual void finalize() {
-     dht.clear();
+     // keep the placements for the next batch of edges
+     if (!base_type::graph.keeps_ingress_state()) dht.clear();
      distributed_ingress_base<VertexData, EdgeData>::finalize(); 
     }
 
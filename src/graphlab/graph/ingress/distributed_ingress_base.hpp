@@ -26,10 +26,16 @@
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/graph/graph_hash.hpp>
 #include <graphlab/graph/ingress/ingress_edge_decision.hpp>
+#include <graphlab/graph/ingress/edge_spill.hpp>
 #include <graphlab/graph/graph_gather_apply.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/graph/partition_report.hpp>
 #include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/util/concurrent_bloom_filter.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/parallel/task_runtime.hpp>
+#include <unistd.h>
 #include <graphlab/macros_def.hpp>
 namespace graphlab {
 
@@ -82,6 +88,30 @@ namespace graphlab {
     };
     buffered_exchange<edge_buffer_record> edge_exchange;
 
+    /// Received edges written to local disk to bound the ingress memory
+    edge_spill<edge_buffer_record> spilled_edges;
+    /// The number of received edges which triggers a spill. 0 disables spilling.
+    size_t spill_threshold;
+    /// Counts add_edge calls between checks of the received edges
+    atomic<size_t> spill_check_counter;
+    mutex spill_lock;
+    enum { SPILL_CHECK_INTERVAL = 4096 };
+
+    /// Whether finalize drops the repeated (source, target) edges
+    bool dedup_edges;
+    /// Whether finalize moves the masters to balance the machines
+    bool balanced_masters;
+    /// The number of duplicate edges dropped by the last finalize on all machines
+    size_t num_duplicate_edges;
+    /// The fraction of the edges kept by the ingress. See set_edge_sampling()
+    double edge_sample_rate;
+    /// Selects which edges are kept when sampling
+    uint32_t edge_sample_seed;
+
+    /// Times the ingress phases reported in the partition report
+    timer phase_timer;
+    std::vector<std::pair<std::string, double> > phase_times;
+
     /// Detail vertex record for the second pass coordination. 
     struct vertex_negotiator_record {
       mirror_type mirrors;
@@ -114,14 +144,13 @@ namespace graphlab {
   public:
     distributed_ingress_base(distributed_control& dc, graph_type& graph) :
       rpc(dc, this), graph(graph), 
-#ifdef _OPENMP
-      vertex_exchange(dc, omp_get_max_threads()), 
-      edge_exchange(dc, omp_get_max_threads()),
-#else
-      vertex_exchange(dc), edge_exchange(dc),
-#endif
-      edge_decision(dc) {
+      vertex_exchange(dc, task_runtime_num_thread_ids()), 
+      edge_exchange(dc, task_runtime_num_thread_ids()),
+      edge_decision(dc), spill_threshold(0), dedup_edges(false),
+      balanced_masters(false), num_duplicate_edges(0), edge_sample_rate(1),
+      edge_sample_seed(0) {
       rpc.barrier();
+      phase_timer.start();
     } // end of constructor
 
     virtual ~distributed_ingress_base() { }
@@ -132,26 +161,129 @@ namespace graphlab {
       const procid_t owning_proc = 
         edge_decision.edge_to_proc_random(source, target, rpc.numprocs());
       const edge_buffer_record record(source, target, edata);
-#ifdef _OPENMP
-      edge_exchange.send(owning_proc, record, omp_get_thread_num());
-#else
-      edge_exchange.send(owning_proc, record);
-#endif
+      edge_exchange.send(owning_proc, record, task_runtime_thread_id());
     } // end of add edge
 
+    /**
+     * \brief Add n edges to the ingress object. edata may be NULL in
+     * which case the edges get default edge data.
+     */
+    virtual void add_edge_block(const vertex_id_type* source,
+                                const vertex_id_type* target,
+                                const EdgeData* edata, size_t n) {
+      const EdgeData default_edata = EdgeData();
+      for (size_t i = 0; i < n; ++i) {
+        add_edge(source[i], target[i], edata == NULL ? default_edata : edata[i]);
+      }
+    } // end of add edge block
+
 
     /** \brief Add an vertex to the ingress object. */
     virtual void add_vertex(vertex_id_type vid, const VertexData& vdata)  { 
       const procid_t owning_proc = graph_hash::hash_vertex(vid) % rpc.numprocs();
       const vertex_buffer_record record(vid, vdata);
-#ifdef _OPENMP
-      vertex_exchange.send(owning_proc, record, omp_get_thread_num());
-#else
-      vertex_exchange.send(owning_proc, record);
-#endif
+      vertex_exchange.send(owning_proc, record, task_runtime_thread_id());
     } // end of add vertex
 
 
+    /**
+     * \brief Bounds the memory used by received edges.
+     *
+     * Once the edges received by this machine take more than
+     * budget_bytes, they are sorted and written to files named
+     * [spill_prefix][procid]_[pid]_[run] on the local disk. The runs
+     * are merged in source order at finalize. A budget of 0 disables
+     * spilling.
+     */
+    void set_memory_budget(size_t budget_bytes, const std::string& spill_prefix) {
+      // a run is held in memory twice while it is sorted and written
+      spill_threshold = budget_bytes / (2 * sizeof(edge_buffer_record));
+      if (budget_bytes > 0 && spill_threshold == 0) spill_threshold = 1;
+      spilled_edges.set_prefix(spill_prefix + tostr(rpc.procid()) + "_" +
+                               tostr(getpid()) + "_");
+    }
+
+    /**
+     * \brief Spills the received edges if they exceed the memory
+     * budget. Called after edges are added to the graph; the received
+     * edges are only counted every SPILL_CHECK_INTERVAL calls.
+     */
+    inline void spill_if_needed() {
+      if (spill_threshold == 0) return;
+      if (spill_check_counter.inc() % SPILL_CHECK_INTERVAL != 0) return;
+      if (!spill_lock.try_lock()) return;
+      if (edge_exchange.size() >= spill_threshold) spill_received_edges();
+      spill_lock.unlock();
+    }
+
+    /**
+     * \brief Drops the edges whose (source, target) pair was already
+     * received by this machine in the same finalize.
+     *
+     * The received edges are first run through a bloom filter, and only
+     * the edges it flags as possibly repeated are checked exactly, so
+     * the exact check only keeps the keys of the duplicates and of the
+     * few false positives. Spilled edges are merged in (source, target)
+     * order and are deduplicated by comparing consecutive edges. The
+     * first of the repeated edges is kept.
+     */
+    void set_edge_dedup(bool dedup) {
+      dedup_edges = dedup;
+    }
+
+    /**
+     * \brief Lets finalize move the master of each new vertex from the
+     * machine given by the hash of its id to the replica which keeps
+     * the number of masters, their degrees and their mirrors even over
+     * the machines.
+     *
+     * The hash machine negotiates the vertex as before, then compares
+     * its replicas by the loads it already placed on them, each
+     * relative to its mean, and tells the replicas the chosen master.
+     * Since every hash machine balances its own share, the total is
+     * balanced as well. The hash machine keeps a replica, so requests
+     * for a vertex from machines without one go through it.
+     */
+    void set_balanced_masters(bool balanced) {
+      balanced_masters = balanced;
+    }
+
+    /**
+     * \brief Keeps each edge with probability rate, for approximate
+     * analytics on a much smaller graph.
+     *
+     * Whether an edge is kept is decided by a hash of its unordered
+     * pair of vertices and the seed, so the decision does not depend on
+     * the machine or the thread adding the edge, and the two directions
+     * of an undirected edge are kept or dropped together. The rate is
+     * recorded in the partition report, so that the estimators can
+     * scale their results (a triangle is kept with probability rate^3
+     * for instance).
+     */
+    void set_edge_sampling(double rate, uint32_t seed) {
+      if (rate <= 0 || rate > 1) {
+        logstream(LOG_FATAL) << "The edge sample rate must be in (0, 1], "
+                             << "not " << rate << std::endl;
+      }
+      edge_sample_rate = rate;
+      edge_sample_seed = seed;
+    }
+
+    /// \brief Returns the fraction of the edges kept by the ingress
+    double get_edge_sample_rate() const { return edge_sample_rate; }
+
+    /// \brief Returns false if the edge is dropped by set_edge_sampling()
+    inline bool sample_edge(vertex_id_type source,
+                            vertex_id_type target) const {
+      if (edge_sample_rate >= 1) return true;
+      const std::pair<vertex_id_type, vertex_id_type> e =
+          source < target ? std::make_pair(source, target)
+                          : std::make_pair(target, source);
+      const uint32_t h = integer_mix(uint32_t(graph_hash::hash_edge(e)) ^
+                                     integer_mix(edge_sample_seed));
+      return h < edge_sample_rate * 4294967296.0;
+    }
+
     void set_duplicate_vertex_strategy(
         boost::function<void(vertex_data_type&,
                              const vertex_data_type&)> combine_strategy) {
@@ -198,6 +330,8 @@ namespace graphlab {
       if (rpc.procid() == 0) {
         logstream(LOG_EMPH) << "Finalizing Graph..." << std::endl;
       }
+      phase_times.clear();
+      end_phase("load");
 
       typedef typename hopscotch_map<vertex_id_type, lvid_type>::value_type
         vid2lvid_pair_type;
@@ -238,7 +372,8 @@ namespace graphlab {
        * Fast pass for redundant finalization with no graph changes. 
        */
       {
-        size_t changed_size = edge_exchange.size() + vertex_exchange.size();
+        size_t changed_size = edge_exchange.size() + vertex_exchange.size() +
+                              spilled_edges.num_records();
         rpc.all_reduce(changed_size);
         if (changed_size == 0) {
           logstream(LOG_INFO) << "Skipping Graph Finalization because no changes happened..." << std::endl;
@@ -248,6 +383,7 @@ namespace graphlab {
 
       if(rpc.procid() == 0)       
         memory_info::log_usage("Post Flush");
+      end_phase("flush");
 
      
       /**************************************************************************/
@@ -257,43 +393,57 @@ namespace graphlab {
       /**************************************************************************/
       { // Add all the edges to the local graph
         logstream(LOG_INFO) << "Graph Finalize: constructing local graph" << std::endl;
+        if (spilled_edges.num_runs() > 0) {
+          // Spill the rest as well so that all the edges can be merged
+          // by source.
+          while (!edge_exchange.empty()) spill_received_edges();
+          logstream(LOG_INFO) << "Graph Finalize: merging "
+                              << spilled_edges.num_runs() << " spilled runs of "
+                              << spilled_edges.num_records() << " edges"
+                              << std::endl;
+          graph.local_graph.reserve_edge_space(spilled_edges.num_records() + 1);
+          if (lvid_start == 0) {
+            // Number the new vertices in id order. The merged edges then
+            // arrive sorted by source lvid and the local graph skips its
+            // sort by source.
+            std::vector<vertex_id_type> vids;
+            spilled_vid_collector collector(vids);
+            spilled_edges.for_each(collector);
+            collector.compact();
+            for (size_t i = 0; i < vids.size(); ++i) vid2lvid_buffer[vids[i]] = i;
+          }
+          spilled_edge_adder adder(*this, lvid_start, vid2lvid_buffer,
+                                   updated_lvids, dedup_edges);
+          spilled_edges.merge(adder);
+          spilled_edges.clear();
+          num_duplicate_edges = adder.nduplicates;
+        } else {
+          num_duplicate_edges = 0;
+        }
         const size_t nedges = edge_exchange.size()+1;
         graph.local_graph.reserve_edge_space(nedges + 1);      
-        edge_buffer_type edge_buffer;
-        procid_t proc;
-        while(edge_exchange.recv(proc, edge_buffer)) {
-          foreach(const edge_buffer_record& rec, edge_buffer) {
-            // Get the source_vlid;
-            lvid_type source_lvid(-1);
-            if(graph.vid2lvid.find(rec.source) == graph.vid2lvid.end()) {
-              if (vid2lvid_buffer.find(rec.source) == vid2lvid_buffer.end()) {
-                source_lvid = lvid_start + vid2lvid_buffer.size();
-                vid2lvid_buffer[rec.source] = source_lvid;
-              } else {
-                source_lvid = vid2lvid_buffer[rec.source];
-              }
-            } else {
-              source_lvid = graph.vid2lvid[rec.source];
-              updated_lvids.set_bit(source_lvid);
-            }
-            // Get the target_lvid;
-            lvid_type target_lvid(-1);
-            if(graph.vid2lvid.find(rec.target) == graph.vid2lvid.end()) {
-              if (vid2lvid_buffer.find(rec.target) == vid2lvid_buffer.end()) {
-                target_lvid = lvid_start + vid2lvid_buffer.size();
-                vid2lvid_buffer[rec.target] = target_lvid;
-              } else {
-                target_lvid = vid2lvid_buffer[rec.target];
-              }
-            } else {
-              target_lvid = graph.vid2lvid[rec.target];
-              updated_lvids.set_bit(target_lvid);
-            }
-            graph.local_graph.add_edge(source_lvid, target_lvid, rec.edata);
-            // std::cout << "add edge " << rec.source << "\t" << rec.target << std::endl;
-          } // end of loop over add edges
-        } // end for loop over buffers
+        if (dedup_edges) {
+          num_duplicate_edges += add_received_edges_dedup(lvid_start,
+                                                          vid2lvid_buffer,
+                                                          updated_lvids);
+        } else {
+          edge_buffer_type edge_buffer;
+          procid_t proc;
+          while(edge_exchange.recv(proc, edge_buffer)) {
+            foreach(const edge_buffer_record& rec, edge_buffer) {
+              add_received_edge(rec, lvid_start, vid2lvid_buffer, updated_lvids);
+            } // end of loop over add edges
+          } // end for loop over buffers
+        }
         edge_exchange.clear();
+        if (dedup_edges) {
+          rpc.all_reduce(num_duplicate_edges);
+          if (rpc.procid() == 0) {
+            logstream(LOG_EMPH) << "Graph Finalize: removed "
+                                << num_duplicate_edges << " duplicate edges"
+                                << std::endl;
+          }
+        }
 
         ASSERT_EQ(graph.vid2lvid.size()  + vid2lvid_buffer.size(), graph.local_graph.num_vertices());
         if(rpc.procid() == 0)  {
@@ -316,6 +466,7 @@ namespace graphlab {
           // std::cout << graph.local_graph << std::endl;
         }
       }
+      end_phase("construct_local_graph");
 
       /**************************************************************************/
       /*                                                                        */
@@ -340,7 +491,8 @@ namespace graphlab {
               updated_lvids.set_bit(lvid);
             }
             if (vertex_combine_strategy && lvid < graph.num_local_vertices()) {
-              vertex_combine_strategy(graph.l_vertex(lvid).data(), rec.vdata);
+              vertex_combine_strategy(
+                  make_soa_lvalue(graph.l_vertex(lvid).data()).get(), rec.vdata);
             } else {
               graph.local_graph.add_vertex(lvid, rec.vdata);
             }
@@ -362,11 +514,13 @@ namespace graphlab {
         const size_t local_nverts = graph.vid2lvid.size() + vid2lvid_buffer.size();
         graph.lvid2record.reserve(local_nverts);
         graph.lvid2record.resize(local_nverts);
+        graph.lvid2owner.resize(local_nverts);
         graph.local_graph.resize(local_nverts);
         foreach(const vid2lvid_pair_type& pair, vid2lvid_buffer) {
             vertex_record& vrec = graph.lvid2record[pair.second];
             vrec.gvid = pair.first;
             vrec.owner = graph_hash::hash_vertex(pair.first) % rpc.numprocs();
+            graph.lvid2owner[pair.second] = vrec.owner;
         }
         ASSERT_EQ(local_nverts, graph.local_graph.num_vertices());
         ASSERT_EQ(graph.lvid2record.size(), graph.local_graph.num_vertices());
@@ -380,69 +534,40 @@ namespace graphlab {
       /*                                                                        */
       /**************************************************************************/
       {
-#ifdef _OPENMP
-        buffered_exchange<vertex_id_type> vid_buffer(rpc.dc(), omp_get_max_threads());
-#else
-        buffered_exchange<vertex_id_type> vid_buffer(rpc.dc());
-#endif
+        buffered_exchange<vertex_id_type> vid_buffer(rpc.dc(), task_runtime_num_thread_ids());
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
         // send not owned vids to their master
-        for (lvid_type i = lvid_start; i < graph.lvid2record.size(); ++i) {
-          procid_t master = graph.lvid2record[i].owner;
-          if (master != rpc.procid())
-#ifdef _OPENMP
-            vid_buffer.send(master, graph.lvid2record[i].gvid, omp_get_thread_num());
-#else
-            vid_buffer.send(master, graph.lvid2record[i].gvid);
-#endif
-        }
+        parallel_for(lvid_start, graph.lvid2record.size(),
+                     boost::bind(&distributed_ingress_base::send_vid_to_master,
+                                 this, boost::ref(vid_buffer), _1));
         vid_buffer.flush();
         rpc.barrier();
 
         // receive all vids owned by me
         mutex flying_vids_lock;
         boost::unordered_map<vertex_id_type, mirror_type> flying_vids;
-#ifdef _OPENMP
-#pragma omp parallel
-#endif
-        {
-          typename buffered_exchange<vertex_id_type>::buffer_type buffer;
-          procid_t recvid;
-          while(vid_buffer.recv(recvid, buffer)) {
-            foreach(const vertex_id_type vid, buffer) {
-              if (graph.vid2lvid.find(vid) == graph.vid2lvid.end()) {
-                if (vid2lvid_buffer.find(vid) == vid2lvid_buffer.end()) {
-                  flying_vids_lock.lock();
-                  mirror_type& mirrors = flying_vids[vid];
-                  flying_vids_lock.unlock();
-                  mirrors.set_bit(recvid);
-                } else {
-                  lvid_type lvid = vid2lvid_buffer[vid];
-                  graph.lvid2record[lvid]._mirrors.set_bit(recvid);
-                }
-              } else {
-                lvid_type lvid = graph.vid2lvid[vid];
-                graph.lvid2record[lvid]._mirrors.set_bit(recvid);
-                updated_lvids.set_bit(lvid);
-              }
-            }
-          }
-        }
+        // one receiving task per worker
+        parallel_for(0, task_runtime_num_workers(),
+                     boost::bind(&distributed_ingress_base::recv_vids_from_mirrors,
+                                 this, boost::ref(vid_buffer), 
+                                 boost::ref(vid2lvid_buffer),
+                                 boost::ref(flying_vids_lock),
+                                 boost::ref(flying_vids), 
+                                 boost::ref(updated_lvids), _1), 1);
 
         vid_buffer.clear();
         // reallocate spaces for the flying vertices. 
         size_t vsize_old = graph.lvid2record.size();
         size_t vsize_new = vsize_old + flying_vids.size();
         graph.lvid2record.resize(vsize_new);
+        graph.lvid2owner.resize(vsize_new);
         graph.local_graph.resize(vsize_new);
         for (typename boost::unordered_map<vertex_id_type, mirror_type>::iterator it = flying_vids.begin();
              it != flying_vids.end(); ++it) {
           lvid_type lvid = lvid_start + vid2lvid_buffer.size();
           vertex_id_type gvid = it->first; 
           graph.lvid2record[lvid].owner = rpc.procid();
+          graph.lvid2owner[lvid] = rpc.procid();
           graph.lvid2record[lvid].gvid = gvid;
           graph.lvid2record[lvid]._mirrors= it->second;
           vid2lvid_buffer[gvid] = lvid;
@@ -467,6 +592,7 @@ namespace graphlab {
           // vid2lvid_buffer.swap(vid2lvid_map_type(-1));
         }
       }
+      end_phase("vertex_negotiation");
 
 
       /**************************************************************************/
@@ -504,8 +630,16 @@ namespace graphlab {
         if(rpc.procid() == 0)       
           memory_info::log_usage("Finished synchronizing vertex (meta)data");
       }
+      end_phase("vertex_synchronization");
+
+      if (balanced_masters) {
+        select_balanced_masters(lvid_start);
+        end_phase("master_selection");
+      }
 
       exchange_global_info();
+      end_phase("exchange_global_info");
+      build_partition_report();
     } // end of finalize
 
 
@@ -553,7 +687,368 @@ namespace graphlab {
     }
 
 
+    /**
+     * \brief Gathers the partition quality statistics into
+     * graph.partition_stats. Machine 0 logs and publishes the report.
+     */
+    void build_partition_report() {
+      partition_report& report = graph.partition_stats;
+      report = partition_report();
+      report.phase_times = phase_times;
+      report.duplicate_edges = dedup_edges ? num_duplicate_edges : 0;
+      report.edge_sample_rate = edge_sample_rate;
+      report.edges.assign(rpc.numprocs(), 0);
+      report.edges[rpc.procid()] = graph.num_local_edges();
+      rpc.all_gather(report.edges);
+      report.vertices.assign(rpc.numprocs(), 0);
+      report.vertices[rpc.procid()] = graph.num_local_vertices();
+      rpc.all_gather(report.vertices);
+      report.masters.assign(rpc.numprocs(), 0);
+      report.masters[rpc.procid()] = graph.num_local_own_vertices();
+      rpc.all_gather(report.masters);
+
+      // the masters know the replication of their vertices
+      std::vector<size_t> histogram(rpc.numprocs() + 1, 0);
+      size_t num_high_degree = 0, high_degree_replicas = 0;
+      foreach(const vertex_record& record, graph.lvid2record) {
+        if (record.owner != rpc.procid()) continue;
+        const size_t nreplicas = record.num_mirrors() + 1;
+        ++histogram[nreplicas];
+        if (record.num_in_edges + record.num_out_edges >=
+            report.high_degree_threshold) {
+          ++num_high_degree;
+          high_degree_replicas += nreplicas;
+        }
+      }
+      std::vector<std::vector<size_t> > histograms(rpc.numprocs());
+      histograms[rpc.procid()].swap(histogram);
+      rpc.all_gather(histograms);
+      report.replication_histogram.assign(rpc.numprocs() + 1, 0);
+      for (size_t p = 0; p < histograms.size(); ++p) {
+        for (size_t k = 0; k < histograms[p].size(); ++k) {
+          report.replication_histogram[k] += histograms[p][k];
+        }
+      }
+      rpc.all_reduce(num_high_degree);
+      rpc.all_reduce(high_degree_replicas);
+      report.num_high_degree = num_high_degree;
+      report.high_degree_replicas = high_degree_replicas;
+
+      if (rpc.procid() == 0) {
+        logstream(LOG_INFO) << "Partition report: " << report.to_json();
+        report.publish();
+        if (!graph.partition_report_file.empty()) {
+          std::ofstream fout(graph.partition_report_file.c_str());
+          fout << report.to_json();
+          if (!fout.good()) {
+            logstream(LOG_ERROR) << "Unable to write partition report to "
+                                 << graph.partition_report_file << std::endl;
+          }
+        }
+      }
+      phase_timer.start();
+    } // end of build partition report
+
   private:
+    typedef typename graph_type::hopscotch_map_type vid2lvid_map_type;
+
+    /// Records the time since the last phase ended as the phase name
+    void end_phase(const std::string& name) {
+      phase_times.push_back(std::make_pair(name, phase_timer.current_time()));
+      phase_timer.start();
+    }
+
+    /**
+     * \brief Adds a received edge to the local graph, assigning local
+     * ids starting at lvid_start to vertices not yet in the graph.
+     */
+    void add_received_edge(const edge_buffer_record& rec, lvid_type lvid_start,
+                           vid2lvid_map_type& vid2lvid_buffer,
+                           dense_bitset& updated_lvids) {
+      // Get the source_vlid;
+      lvid_type source_lvid(-1);
+      if(graph.vid2lvid.find(rec.source) == graph.vid2lvid.end()) {
+        if (vid2lvid_buffer.find(rec.source) == vid2lvid_buffer.end()) {
+          source_lvid = lvid_start + vid2lvid_buffer.size();
+          vid2lvid_buffer[rec.source] = source_lvid;
+        } else {
+          source_lvid = vid2lvid_buffer[rec.source];
+        }
+      } else {
+        source_lvid = graph.vid2lvid[rec.source];
+        updated_lvids.set_bit(source_lvid);
+      }
+      // Get the target_lvid;
+      lvid_type target_lvid(-1);
+      if(graph.vid2lvid.find(rec.target) == graph.vid2lvid.end()) {
+        if (vid2lvid_buffer.find(rec.target) == vid2lvid_buffer.end()) {
+          target_lvid = lvid_start + vid2lvid_buffer.size();
+          vid2lvid_buffer[rec.target] = target_lvid;
+        } else {
+          target_lvid = vid2lvid_buffer[rec.target];
+        }
+      } else {
+        target_lvid = graph.vid2lvid[rec.target];
+        updated_lvids.set_bit(target_lvid);
+      }
+      graph.local_graph.add_edge(source_lvid, target_lvid, rec.edata);
+    } // end of add received edge
+
+    /**
+     * \brief Adds the received edges to the local graph, dropping the
+     * edges whose (source, target) pair was received before. Returns
+     * the number of dropped edges. See set_edge_dedup().
+     */
+    size_t add_received_edges_dedup(lvid_type lvid_start,
+                                    vid2lvid_map_type& vid2lvid_buffer,
+                                    dense_bitset& updated_lvids) {
+      typedef typename buffered_exchange<edge_buffer_record>::buffer_type
+        edge_buffer_type;
+      typedef std::pair<vertex_id_type, vertex_id_type> vid_pair_type;
+      std::vector<edge_buffer_type> buffers;
+      edge_buffer_type edge_buffer;
+      procid_t proc;
+      size_t nreceived = 0;
+      while(edge_exchange.recv(proc, edge_buffer)) {
+        nreceived += edge_buffer.size();
+        buffers.push_back(edge_buffer_type());
+        buffers.back().swap(edge_buffer);
+      }
+      // The filter flags every repeated edge and a few others. The value
+      // records whether a flagged pair was added to the graph.
+      concurrent_bloom_filter filter(nreceived);
+      boost::unordered_map<vid_pair_type, bool> suspects;
+      foreach(const edge_buffer_type& buffer, buffers) {
+        foreach(const edge_buffer_record& rec, buffer) {
+          if (filter.insert(concurrent_bloom_filter::pair_key(rec.source,
+                                                              rec.target))) {
+            suspects[vid_pair_type(rec.source, rec.target)] = false;
+          }
+        }
+      }
+      size_t nduplicates = 0;
+      for (size_t i = 0; i < buffers.size(); ++i) {
+        foreach(const edge_buffer_record& rec, buffers[i]) {
+          if (!suspects.empty()) {
+            typename boost::unordered_map<vid_pair_type, bool>::iterator it =
+              suspects.find(vid_pair_type(rec.source, rec.target));
+            if (it != suspects.end()) {
+              if (it->second) {
+                ++nduplicates;
+                continue;
+              }
+              it->second = true;
+            }
+          }
+          add_received_edge(rec, lvid_start, vid2lvid_buffer, updated_lvids);
+        }
+        edge_buffer_type().swap(buffers[i]);
+      }
+      logstream(LOG_INFO) << "Dropped " << nduplicates << " duplicate edges "
+                          << "out of " << nreceived << " received, "
+                          << suspects.size() << " checked exactly"
+                          << std::endl;
+      return nduplicates;
+    } // end of add received edges dedup
+
+    /**
+     * \brief Moves the masters of the vertices this machine negotiated
+     * in this finalize to their balanced replicas and applies the moves
+     * of the other machines. See set_balanced_masters().
+     */
+    void select_balanced_masters(lvid_type lvid_start) {
+      typedef std::pair<vertex_id_type, procid_t> owner_pair_type;
+      buffered_exchange<owner_pair_type> owner_exchange(rpc.dc());
+      // the masters, apply cost and mirrors this machine placed on each
+      // machine, and their totals
+      std::vector<double> load(NUM_MASTER_LOADS * rpc.numprocs(), 0);
+      double total[NUM_MASTER_LOADS] = {0, 0, 0};
+      size_t nmoved = 0;
+      for (lvid_type lvid = lvid_start; lvid < graph.lvid2record.size(); ++lvid) {
+        const vertex_record& vrec = graph.lvid2record[lvid];
+        if (vrec.owner != rpc.procid()) continue;
+        const double cost[NUM_MASTER_LOADS] = 
+          { 1.0, double(vrec.num_in_edges + vrec.num_out_edges),
+            double(vrec.num_mirrors()) };
+        for (size_t k = 0; k < NUM_MASTER_LOADS; ++k) total[k] += cost[k];
+        // this machine wins the ties, which saves the move
+        procid_t best = rpc.procid();
+        double best_score = master_score(load, total, cost, best);
+        foreach(procid_t proc, vrec.mirrors()) {
+          const double score = master_score(load, total, cost, proc);
+          if (score < best_score) {
+            best = proc;
+            best_score = score;
+          }
+        }
+        for (size_t k = 0; k < NUM_MASTER_LOADS; ++k) {
+          load[NUM_MASTER_LOADS * best + k] += cost[k];
+        }
+        if (best == rpc.procid()) continue;
+        foreach(procid_t proc, vrec.mirrors()) {
+          owner_exchange.send(proc, owner_pair_type(vrec.gvid, best));
+        }
+        graph.set_vertex_owner(lvid, best);
+        ++nmoved;
+      }
+      owner_exchange.flush();
+      typename buffered_exchange<owner_pair_type>::buffer_type buffer;
+      procid_t sending_proc(-1);
+      while(owner_exchange.recv(sending_proc, buffer)) {
+        foreach(const owner_pair_type& pair, buffer) {
+          graph.set_vertex_owner(graph.vid2lvid[pair.first], pair.second);
+        }
+      }
+      rpc.all_reduce(nmoved);
+      if (rpc.procid() == 0) {
+        logstream(LOG_EMPH) << "Graph Finalize: moved " << nmoved
+                            << " masters to balance the machines" << std::endl;
+      }
+    } // end of select balanced masters
+
+    enum { NUM_MASTER_LOADS = 3 };
+
+    /**
+     * \brief The sum of the loads of proc once it masters a vertex of
+     * the given cost, each relative to the mean load.
+     */
+    double master_score(const std::vector<double>& load, const double* total,
+                        const double* cost, procid_t proc) const {
+      double score = 0;
+      for (size_t k = 0; k < NUM_MASTER_LOADS; ++k) {
+        if (total[k] == 0) continue;
+        score += (load[NUM_MASTER_LOADS * proc + k] + cost[k]) *
+            rpc.numprocs() / total[k];
+      }
+      return score;
+    }
+
+    /**
+     * \brief Master handshake: sends the gvid of the mirror lvid to 
+     * its master.
+     */
+    void send_vid_to_master(buffered_exchange<vertex_id_type>& vid_buffer,
+                            size_t lvid) {
+      procid_t master = graph.lvid2record[lvid].owner;
+      if (master != rpc.procid()) {
+        vid_buffer.send(master, graph.lvid2record[lvid].gvid, 
+                        task_runtime_thread_id());
+      }
+    } // end of send vid to master
+
+    /**
+     * \brief Master handshake: records the machines holding mirrors of 
+     * the vertices owned by this machine. Vertices which have no local 
+     * edges are collected in flying_vids. Runs concurrently.
+     */
+    void recv_vids_from_mirrors(buffered_exchange<vertex_id_type>& vid_buffer,
+                                vid2lvid_map_type& vid2lvid_buffer,
+                                mutex& flying_vids_lock,
+                                boost::unordered_map<vertex_id_type, mirror_type>& flying_vids,
+                                dense_bitset& updated_lvids,
+                                size_t unused) {
+      typename buffered_exchange<vertex_id_type>::buffer_type buffer;
+      procid_t recvid;
+      while(vid_buffer.recv(recvid, buffer)) {
+        foreach(const vertex_id_type vid, buffer) {
+          if (graph.vid2lvid.find(vid) == graph.vid2lvid.end()) {
+            if (vid2lvid_buffer.find(vid) == vid2lvid_buffer.end()) {
+              flying_vids_lock.lock();
+              mirror_type& mirrors = flying_vids[vid];
+              flying_vids_lock.unlock();
+              mirrors.set_bit(recvid);
+            } else {
+              lvid_type lvid = vid2lvid_buffer[vid];
+              graph.lvid2record[lvid]._mirrors.set_bit(recvid);
+            }
+          } else {
+            lvid_type lvid = graph.vid2lvid[vid];
+            graph.lvid2record[lvid]._mirrors.set_bit(recvid);
+            updated_lvids.set_bit(lvid);
+          }
+        }
+      }
+    } // end of recv vids from mirrors
+
+    /**
+     * \brief Writes the received edges to a new spilled run, up to
+     * spill_threshold edges at a time.
+     */
+    void spill_received_edges() {
+      typedef typename buffered_exchange<edge_buffer_record>::buffer_type
+        edge_buffer_type;
+      std::vector<edge_buffer_record> run;
+      edge_buffer_type edge_buffer;
+      procid_t proc;
+      while(run.size() < spill_threshold && edge_exchange.recv(proc, edge_buffer)) {
+        run.insert(run.end(), edge_buffer.begin(), edge_buffer.end());
+        edge_buffer_type().swap(edge_buffer);
+      }
+      const size_t nrecords = run.size();
+      spilled_edges.write_run(run);
+      logstream(LOG_INFO) << "Spilled " << nrecords << " received edges to disk"
+                          << std::endl;
+    } // end of spill received edges
+
+    /// Collects the sorted distinct vertex ids of the spilled edges
+    struct spilled_vid_collector {
+      std::vector<vertex_id_type>& vids;
+      std::vector<vertex_id_type> pending;
+      spilled_vid_collector(std::vector<vertex_id_type>& vids) : vids(vids) { }
+      void operator()(const edge_buffer_record& rec) {
+        pending.push_back(rec.source);
+        pending.push_back(rec.target);
+        if (pending.size() >= (1 << 24)) compact();
+      }
+      void compact() {
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+        std::vector<vertex_id_type> merged;
+        merged.reserve(vids.size() + pending.size());
+        std::set_union(vids.begin(), vids.end(), pending.begin(), pending.end(),
+                       std::back_inserter(merged));
+        vids.swap(merged);
+        pending.clear();
+      }
+    };
+
+    /**
+     * Adds the merged spilled edges to the local graph. If dedup is set,
+     * an edge equal to the previous one in the (source, target) order is
+     * dropped.
+     */
+    struct spilled_edge_adder {
+      distributed_ingress_base& ingress;
+      lvid_type lvid_start;
+      vid2lvid_map_type& vid2lvid_buffer;
+      dense_bitset& updated_lvids;
+      bool dedup;
+      bool has_prev;
+      vertex_id_type prev_source, prev_target;
+      size_t nduplicates;
+      spilled_edge_adder(distributed_ingress_base& ingress, lvid_type lvid_start,
+                         vid2lvid_map_type& vid2lvid_buffer,
+                         dense_bitset& updated_lvids, bool dedup) :
+        ingress(ingress), lvid_start(lvid_start),
+        vid2lvid_buffer(vid2lvid_buffer), updated_lvids(updated_lvids),
+        dedup(dedup), has_prev(false), prev_source(0), prev_target(0),
+        nduplicates(0) { }
+      void operator()(const edge_buffer_record& rec) {
+        if (dedup) {
+          if (has_prev && rec.source == prev_source &&
+              rec.target == prev_target) {
+            ++nduplicates;
+            return;
+          }
+          has_prev = true;
+          prev_source = rec.source;
+          prev_target = rec.target;
+        }
+        ingress.add_received_edge(rec, lvid_start, vid2lvid_buffer,
+                                  updated_lvids);
+      }
+    };
+
     boost::function<void(vertex_data_type&, const vertex_data_type&)> vertex_combine_strategy;
 
     /**
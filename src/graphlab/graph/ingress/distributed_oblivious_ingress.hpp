@@ -32,6 +32,7 @@
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/util/cuckoo_map_pow2.hpp>
+#include <graphlab/util/tracepoint.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/macros_def.hpp>
 namespace graphlab {
@@ -71,12 +72,14 @@ namespace graphlab {
     bool usehash;
     bool userecent;
 
+    DECLARE_TRACER(ob_ingress_compute_assignments);
+
   public:
     distributed_oblivious_ingress(distributed_control& dc, graph_type& graph, bool usehash = false, bool userecent = false) :
       base_type(dc, graph),
       dht(-1),proc_num_edges(dc.numprocs()), usehash(usehash), userecent(userecent) { 
 
-      //INITIALIZE_TRACER(ob_ingress_compute_assignments, "Time spent in compute assignment");
+      INITIALIZE_TRACER(ob_ingress_compute_assignments, "Time spent in compute assignment");
      }
 
     ~distributed_oblivious_ingress() { }
@@ -84,23 +87,22 @@ namespace graphlab {
     /** Add an edge to the ingress object using oblivious greedy assignment. */
     void add_edge(vertex_id_type source, vertex_id_type target,
                   const EdgeData& edata) {
+      BEGIN_TRACEPOINT(ob_ingress_compute_assignments);
       obliv_lock.lock();
       dht[source]; dht[target];
       const procid_t owning_proc = 
         base_type::edge_decision.edge_to_proc_greedy(source, target, dht[source], dht[target], proc_num_edges, usehash, userecent);
       obliv_lock.unlock();
+      END_TRACEPOINT(ob_ingress_compute_assignments);
 
       typedef typename base_type::edge_buffer_record edge_buffer_record;
       edge_buffer_record record(source, target, edata);
-#ifdef _OPENMP
-      base_type::edge_exchange.send(owning_proc, record, omp_get_thread_num());
-#else      
-      base_type::edge_exchange.send(owning_proc, record);
-#endif
+      base_type::edge_exchange.send(owning_proc, record, task_runtime_thread_id());
     } // end of add edge
 
     virtual void finalize() {
-     dht.clear();
+     // keep the placements for the next batch of edges
+     if (!base_type::graph.keeps_ingress_state()) dht.clear();
      distributed_ingress_base<VertexData, EdgeData>::finalize(); 
       
     }
@@ -67,6 +67,24 @@ namespace graphlab {
       const edge_buffer_record record(source, target, edata);
       base_type::edge_exchange.send(owning_proc, record);
     } // end of add edge
+
+    /** Add a block of edges using random assignment. */
+    void add_edge_block(const vertex_id_type* source,
+                        const vertex_id_type* target,
+                        const EdgeData* edata, size_t n) {
+      typedef typename base_type::edge_buffer_record edge_buffer_record;
+      const size_t thread_id = task_runtime_thread_id();
+      const procid_t numprocs = base_type::rpc.numprocs();
+      const EdgeData default_edata = EdgeData();
+      for (size_t i = 0; i < n; ++i) {
+        const procid_t owning_proc =
+          base_type::edge_decision.edge_to_proc_random(source[i], target[i], numprocs);
+        base_type::edge_exchange.send(owning_proc,
+            edge_buffer_record(source[i], target[i],
+                               edata == NULL ? default_edata : edata[i]),
+            thread_id);
+      }
+    } // end of add edge block
   }; // end of distributed_random_ingress
 }; // end of namespace graphlab
 #include <graphlab/macros_undef.hpp>
@@ -0,0 +1,98 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_DISTRIBUTED_SOURCE_INGRESS_HPP
+#define GRAPHLAB_DISTRIBUTED_SOURCE_INGRESS_HPP
+
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/graph/graph_hash.hpp>
+#include <graphlab/graph/ingress/distributed_ingress_base.hpp>
+#include <graphlab/graph/distributed_graph.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+  template<typename VertexData, typename EdgeData>
+  class distributed_graph;
+
+  /**
+   * \brief Ingress object assigning each edge to the machine given by
+   * the hash of its source.
+   *
+   * All the out edges of a vertex land on the same machine, so a vertex
+   * without in edges (a user of a bipartite rating graph) is never
+   * split. This is the row partitioning used by stratified SGD, where
+   * every machine owns a block of rows of the rating matrix.
+   */
+  template<typename VertexData, typename EdgeData>
+  class distributed_source_ingress : 
+    public distributed_ingress_base<VertexData, EdgeData> {
+  public:
+    typedef distributed_graph<VertexData, EdgeData> graph_type;
+    /// The type of the vertex data stored in the graph 
+    typedef VertexData vertex_data_type;
+    /// The type of the edge data stored in the graph 
+    typedef EdgeData   edge_data_type;
+
+
+    typedef distributed_ingress_base<VertexData, EdgeData> base_type;
+   
+  public:
+    distributed_source_ingress(distributed_control& dc, graph_type& graph) :
+    base_type(dc, graph) {
+    } // end of constructor
+
+    ~distributed_source_ingress() { }
+
+    /** Add an edge to the ingress object, on the machine of its source. */
+    void add_edge(vertex_id_type source, vertex_id_type target,
+                  const EdgeData& edata) {
+      typedef typename base_type::edge_buffer_record edge_buffer_record;
+      const procid_t owning_proc = 
+        graph_hash::hash_vertex(source) % base_type::rpc.numprocs();
+      const edge_buffer_record record(source, target, edata);
+      base_type::edge_exchange.send(owning_proc, record);
+    } // end of add edge
+
+    /** Add a block of edges, each on the machine of its source. */
+    void add_edge_block(const vertex_id_type* source,
+                        const vertex_id_type* target,
+                        const EdgeData* edata, size_t n) {
+      typedef typename base_type::edge_buffer_record edge_buffer_record;
+      const size_t thread_id = task_runtime_thread_id();
+      const procid_t numprocs = base_type::rpc.numprocs();
+      const EdgeData default_edata = EdgeData();
+      for (size_t i = 0; i < n; ++i) {
+        const procid_t owning_proc = graph_hash::hash_vertex(source[i]) % numprocs;
+        base_type::edge_exchange.send(owning_proc,
+            edge_buffer_record(source[i], target[i],
+                               edata == NULL ? default_edata : edata[i]),
+            thread_id);
+      }
+    } // end of add edge block
+  }; // end of distributed_source_ingress
+}; // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+
+#endif
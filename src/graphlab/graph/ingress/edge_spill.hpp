@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.  All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ *  use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_EDGE_SPILL_HPP
+#define GRAPHLAB_EDGE_SPILL_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <queue>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/util/stl_util.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief A set of sorted runs of edge records stored in local files.
+   *
+   * Used by the ingress to bound the memory held by received edges.
+   * Each call to write_run() sorts a batch of records by (source,
+   * target) and writes it to a new file.  The runs can then be read
+   * back in any order with for_each(), or as a single stream sorted by
+   * (source, target) with merge().  The files are removed by clear()
+   * and on destruction.
+   *
+   * The Record type must have \c source and \c target vertex id
+   * members and be serializable.
+   */
+  template <typename Record>
+  class edge_spill {
+  public:
+    edge_spill() : nrecords(0) { }
+    ~edge_spill() { clear(); }
+
+    /// Sets the path prefix of the run files
+    void set_prefix(const std::string& file_prefix) { prefix = file_prefix; }
+
+    /// The number of runs written
+    size_t num_runs() const { return files.size(); }
+
+    /// The total number of records in all runs
+    size_t num_records() const { return nrecords; }
+
+    /**
+     * Sorts records, writes them to a new run and releases the memory
+     * of records.
+     */
+    void write_run(std::vector<Record>& records) {
+      if (records.empty()) return;
+      std::sort(records.begin(), records.end(), record_less());
+      const std::string fname = prefix + tostr(files.size());
+      std::ofstream fout(fname.c_str(), std::ios_base::out |
+                         std::ios_base::binary | std::ios_base::trunc);
+      if (!fout.good()) {
+        logstream(LOG_FATAL) << "Unable to open spill file " << fname
+                             << std::endl;
+      }
+      {
+        oarchive oarc(fout);
+        oarc << size_t(records.size());
+        foreach(const Record& rec, records) oarc << rec;
+      }
+      fout.close();
+      if (fout.fail()) {
+        logstream(LOG_FATAL) << "Error writing spill file " << fname
+                             << std::endl;
+      }
+      files.push_back(fname);
+      nrecords += records.size();
+      std::vector<Record>().swap(records);
+    }
+
+    /// Calls f on every record, one run after the other
+    template <typename Function>
+    void for_each(Function& f) const {
+      for (size_t i = 0; i < files.size(); ++i) {
+        run_reader reader(files[i]);
+        Record rec;
+        while (reader.next(rec)) f(rec);
+      }
+    }
+
+    /// Calls f on every record in (source, target) order
+    template <typename Function>
+    void merge(Function& f) const {
+      std::vector<run_reader*> readers(files.size());
+      std::vector<Record> heads(files.size());
+      typedef std::pair<key_type, size_t> entry_type;
+      std::priority_queue<entry_type, std::vector<entry_type>,
+                          std::greater<entry_type> > queue;
+      for (size_t i = 0; i < files.size(); ++i) {
+        readers[i] = new run_reader(files[i]);
+        if (readers[i]->next(heads[i])) queue.push(entry_type(key(heads[i]), i));
+      }
+      while (!queue.empty()) {
+        const size_t i = queue.top().second;
+        queue.pop();
+        f(heads[i]);
+        if (readers[i]->next(heads[i])) queue.push(entry_type(key(heads[i]), i));
+      }
+      for (size_t i = 0; i < readers.size(); ++i) delete readers[i];
+    }
+
+    /// Removes all the run files
+    void clear() {
+      for (size_t i = 0; i < files.size(); ++i) std::remove(files[i].c_str());
+      files.clear();
+      nrecords = 0;
+    }
+
+  private:
+    std::string prefix;
+    std::vector<std::string> files;
+    size_t nrecords;
+
+    typedef std::pair<vertex_id_type, vertex_id_type> key_type;
+
+    static key_type key(const Record& rec) {
+      return std::make_pair(rec.source, rec.target);
+    }
+
+    struct record_less {
+      bool operator()(const Record& a, const Record& b) const {
+        return key(a) < key(b);
+      }
+    };
+
+    /// Reads the records of one run in order
+    class run_reader {
+    public:
+      run_reader(const std::string& fname) :
+        fin(fname.c_str(), std::ios_base::in | std::ios_base::binary),
+        iarc(fin), remaining(0) {
+        if (!fin.good()) {
+          logstream(LOG_FATAL) << "Unable to open spill file " << fname
+                               << std::endl;
+        }
+        iarc >> remaining;
+      }
+      bool next(Record& rec) {
+        if (remaining == 0) return false;
+        iarc >> rec;
+        --remaining;
+        return true;
+      }
+    private:
+      std::ifstream fin;
+      iarchive iarc;
+      size_t remaining;
+    };
+  }; // end of edge_spill
+
+}; // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -174,6 +174,66 @@ namespace graphlab {
         return best_proc;
       };
 
+      /** HDRF (High Degree Replicated First) assign (source, target)
+       *  to a machine using:
+       *  bitset<MAX_MACHINE> src_bins : the presence of source over machines
+       *  bitset<MAX_MACHINE> dst_bins : the presence of target over machines
+       *  size_t src_degree, dst_degree : the partial degrees seen so far,
+       *                                  including this edge
+       *  vector<size_t>      proc_num_edges : the edge counts over machines
+       *  double lambda : the weight of the balance term
+       *
+       *  A machine which already holds a vertex scores
+       *  1 + (1 - d(v) / (d(source) + d(target))), so the edge prefers
+       *  the machines of its lower degree endpoint and the high degree
+       *  vertex is the one which gets replicated.
+       * */
+      procid_t edge_to_proc_hdrf (const vertex_id_type source,
+          const vertex_id_type target,
+          bin_counts_type& src_bins,
+          bin_counts_type& dst_bins,
+          size_t src_degree,
+          size_t dst_degree,
+          std::vector<size_t>& proc_num_edges,
+          double lambda = 1.0) {
+        size_t numprocs = proc_num_edges.size();
+
+        const double epsilon = 1.0;
+        const double degree_sum = double(src_degree + dst_degree);
+        const double src_theta = src_degree / degree_sum;
+        const double dst_theta = dst_degree / degree_sum;
+        size_t minedges = *std::min_element(proc_num_edges.begin(), proc_num_edges.end());
+        size_t maxedges = *std::max_element(proc_num_edges.begin(), proc_num_edges.end());
+
+        std::vector<double> proc_score(numprocs);
+        for (size_t i = 0; i < numprocs; ++i) {
+          double rep = 0;
+          if (src_bins.get(i)) rep += 1 + (1 - src_theta);
+          if (dst_bins.get(i)) rep += 1 + (1 - dst_theta);
+          double bal = lambda * (maxedges - proc_num_edges[i]) /
+                       (epsilon + maxedges - minedges);
+          proc_score[i] = rep + bal;
+        }
+        const double maxscore = *std::max_element(proc_score.begin(), proc_score.end());
+
+        std::vector<procid_t> top_procs;
+        for (size_t i = 0; i < numprocs; ++i)
+          if (std::fabs(proc_score[i] - maxscore) < 1e-5)
+            top_procs.push_back(i);
+
+        // Hash the edge to one of the best procs.
+        typedef std::pair<vertex_id_type, vertex_id_type> edge_pair_type;
+        const edge_pair_type edge_pair(std::min(source, target),
+            std::max(source, target));
+        procid_t best_proc = top_procs[graph_hash::hash_edge(edge_pair) % top_procs.size()];
+
+        ASSERT_LT(best_proc, numprocs);
+        src_bins.set_bit(best_proc);
+        dst_bins.set_bit(best_proc);
+        ++proc_num_edges[best_proc];
+        return best_proc;
+      };
+
   };// end of ingress_edge_decision
 }
 
@@ -47,11 +47,14 @@
 
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/graph/local_edge_buffer.hpp>
+#include <graphlab/graph/edge_timestamp.hpp>
 #include <graphlab/util/random.hpp>
 #include <graphlab/util/generics/shuffle.hpp>
 #include <graphlab/util/generics/counting_sort.hpp>
 #include <graphlab/util/generics/vector_zip.hpp>
 #include <graphlab/util/generics/csr_storage.hpp>
+#include <graphlab/util/generics/compressed_csr_storage.hpp>
+#include <graphlab/util/soa_vector.hpp>
 #include <graphlab/parallel/atomic.hpp>
 
 #include <graphlab/logger/logger.hpp>
@@ -75,6 +78,21 @@ namespace graphlab {
     /** The type of the edge data stored in the local_graph. */
     typedef EdgeData edge_data_type;
 
+    /**
+     * The containers of the vertex and edge data. These are
+     * std::vectors, unless the data type is stored as a structure of
+     * arrays (see GRAPHLAB_SOA_TRAITS). In that case the data is
+     * accessed through proxies which cannot bind to a plain reference.
+     */
+    typedef typename soa_storage<VertexData>::type vertex_storage_type;
+    typedef typename soa_storage<VertexData>::reference vertex_data_reference;
+    typedef typename soa_storage<VertexData>::const_reference
+        vertex_data_const_reference;
+    typedef typename soa_storage<EdgeData>::type edge_storage_type;
+    typedef typename soa_storage<EdgeData>::reference edge_data_reference;
+    typedef typename soa_storage<EdgeData>::const_reference
+        edge_data_const_reference;
+
     typedef graphlab::vertex_id_type vertex_id_type;
     typedef graphlab::edge_id_type edge_id_type;
 
@@ -95,11 +113,11 @@ namespace graphlab {
        vertex_type(local_graph& lgraph_ref, lvid_type vid):lgraph_ref(lgraph_ref),vid(vid) { }
 
        /// \brief Returns a constant reference to the data on the vertex.
-       const vertex_data_type& data() const {
+       vertex_data_const_reference data() const {
          return lgraph_ref.vertex_data(vid);
        }
        /// \brief Returns a reference to the data on the vertex.
-       vertex_data_type& data() {
+       vertex_data_reference data() {
          return lgraph_ref.vertex_data(vid);
        }
        /// \brief Returns the number of in edges of the vertex.
@@ -135,11 +153,11 @@ namespace graphlab {
         lgraph_ref(lgraph_ref), _source(_source), _target(_target), _eid(_eid) { }
 
       /// \brief Returns a constant reference to the data on the edge.
-      const edge_data_type& data() const {
+      edge_data_const_reference data() const {
         return lgraph_ref.edge_data(_eid);
       }
       /// \brief Returns a reference to the data on the edge.
-      edge_data_type& data() {
+      edge_data_reference data() {
         return lgraph_ref.edge_data(_eid);
       }
       /// \brief Returns the source vertex of the edge.
@@ -165,12 +183,14 @@ namespace graphlab {
     // CONSTRUCTORS ============================================================>
     
     /** Create an empty local_graph. */
-    local_graph() : finalized(false) { }
+    local_graph() : finalized(false), low_memory_finalize(false),
+                    has_time_window(false), window_begin(0), window_end(0) { }
 
     /** Create a local_graph with nverts vertices. */
     local_graph(size_t nverts) :
       vertices(nverts),
-      finalized(false) { }
+      finalized(false), low_memory_finalize(false),
+      has_time_window(false), window_begin(0), window_end(0) { }
 
     // METHODS =================================================================>
     
@@ -187,11 +207,63 @@ namespace graphlab {
       edges.clear();
       _csc_storage.clear();
       _csr_storage.clear();
-      std::vector<VertexData>().swap(vertices);
-      std::vector<EdgeData>().swap(edges);
+      std::vector<edge_time_type>().swap(edge_times);
+      vertex_storage_type().swap(vertices);
+      edge_storage_type().swap(edges);
       edge_buffer.clear();
     }
 
+    /**
+     * \brief Selects how finalize() permutes the edges.
+     *
+     * By default every array is permuted out of place in parallel,
+     * which temporarily doubles the largest edge array.  If
+     * low_memory is set the edges are permuted in place instead and no
+     * edge array is ever duplicated, at the cost of a serial
+     * permutation pass.
+     */
+    void set_low_memory_finalize(bool low_memory) {
+      low_memory_finalize = low_memory;
+    }
+
+    /**
+     * \brief Accepted for compatibility with dynamic_local_graph. The
+     * adjacency of the local graph is always contiguous.
+     */
+    void set_compact_adjacency(bool compact) { }
+
+    /**
+     * \brief Restricts in_edges(), out_edges() and the edge spans of
+     * every vertex to the edges with a time stamp in [begin, end).
+     *
+     * The edge data must have a time stamp (see
+     * GRAPHLAB_EDGE_TIMESTAMP). finalize() sorts the in and out edges
+     * of each vertex by time, so the edges in the window are found by a
+     * binary search and nothing is copied.  num_in_edges() and
+     * num_out_edges() still count all the edges.
+     */
+    void set_edge_time_window(edge_time_type begin, edge_time_type end) {
+#ifdef USE_COMPRESSED_ADJACENCY
+      logstream(LOG_FATAL) << "Edge time windows require the edges sorted "
+                           << "by time, which compressed adjacency does not "
+                           << "support." << std::endl;
+#endif
+      if (!edge_timestamp<EdgeData>::enabled) {
+        logstream(LOG_FATAL) << "Edge time windows require an edge time "
+                             << "stamp. See GRAPHLAB_EDGE_TIMESTAMP."
+                             << std::endl;
+      }
+      has_time_window = true;
+      window_begin = begin;
+      window_end = end;
+    }
+
+    /// \brief Lets the adjacency of the vertices cover all the edges again
+    void clear_edge_time_window() { has_time_window = false; }
+
+    /// \brief Returns true if a time window restricts the adjacency
+    bool has_edge_time_window() const { return has_time_window; }
+
     /**
      * \brief Finalize the local_graph data structure by
      * sorting edges to maximize the efficiency of graphlab.  
@@ -213,62 +285,82 @@ namespace graphlab {
 #ifdef DEBUG_GRAPH
       logstream(LOG_DEBUG) << "Graph2 finalize: Sort by source vertex" << std::endl;
 #endif
-      // Sort edges by source;
-      // Begin of counting sort.
-      counting_sort(edge_buffer.source_arr, permute, &src_counting_prefix_sum);
-
-      // Inplace permute of edge_data, edge_src, edge_target array.
+      // Sort edges by source. Edges which arrive in source order, such
+      // as those merged from spilled ingress runs, are already in place.
+      if (!prefix_of_sorted(edge_buffer.source_arr, src_counting_prefix_sum)) {
+        // Begin of counting sort.
+        counting_sort(edge_buffer.source_arr, permute, &src_counting_prefix_sum);
+
+        // Permute edge_data and edge_target array. The sorted source
+        // array follows from the prefix sum.
 #ifdef DEBUG_GRAPH
-      logstream(LOG_DEBUG) << "Graph2 finalize: Inplace permute by source id" << std::endl;
+        logstream(LOG_DEBUG) << "Graph2 finalize: Permute by source id" << std::endl;
 #endif
-      lvid_type swap_src; lvid_type swap_target; EdgeData  swap_data;
-      for (size_t i = 0; i < permute.size(); ++i) {
-        if (i != permute[i]) {
-          // Reserve the ith entry;
-          size_t j = i;
-          swap_data = edge_buffer.data[i];
-          swap_src = edge_buffer.source_arr[i];
-          swap_target = edge_buffer.target_arr[i];
-          // Begin swap cycle:
-          while (j != permute[j]) {
-            size_t next = permute[j];
-            if (next != i) {
-              edge_buffer.data[j] = edge_buffer.data[next];
-              edge_buffer.source_arr[j] = edge_buffer.source_arr[next];
-              edge_buffer.target_arr[j] = edge_buffer.target_arr[next];
-              permute[j] = j;
-              j = next;
-            } else {
-              // end of cycle
-              edge_buffer.data[j] = swap_data;
-              edge_buffer.source_arr[j] = swap_src;
-              edge_buffer.target_arr[j] = swap_target;
-              permute[j] = j;
-              break;
-            }
-          }
+        if (low_memory_finalize) {
+          inplace_permute_by_source(permute);
+        } else {
+          outofplace_shuffle(edge_buffer.data, permute);
+          outofplace_shuffle(edge_buffer.target_arr, permute);
         }
+        fill_sorted_sources(src_counting_prefix_sum);
+      }
+#ifdef USE_COMPRESSED_ADJACENCY
+      // delta encoding requires the out edges sorted by target
+      sort_out_edges_by_target(src_counting_prefix_sum);
+#else
+      if (edge_timestamp<EdgeData>::enabled) {
+        sort_out_edges_by_time(src_counting_prefix_sum);
       }
+#endif
 #ifdef DEBUG_GRAPH
       logstream(LOG_DEBUG) << "Graph2 finalize: Sort by dest id" << std::endl;
 #endif
       counting_sort(edge_buffer.target_arr, permute, &dest_counting_prefix_sum); 
+#ifdef USE_COMPRESSED_ADJACENCY
+      // sorting the in edges by edge id also sorts them by source
+      sort_in_edges_by_id(permute, dest_counting_prefix_sum);
+#else
+      if (edge_timestamp<EdgeData>::enabled) {
+        sort_in_edges_by_time(permute, dest_counting_prefix_sum);
+      }
+#endif
       // Shuffle source array
 #ifdef DEBUG_GRAPH
-      logstream(LOG_DEBUG) << "Graph2 finalize: Outofplace permute by dest id" << std::endl;
+      logstream(LOG_DEBUG) << "Graph2 finalize: Permute sources by dest id" << std::endl;
 #endif
+      if (low_memory_finalize) {
+        // The source of edge e is found in the source prefix sum so
+        // the sorted source array is not needed while building the
+        // permuted one.
+        std::vector<lvid_type>().swap(edge_buffer.source_arr);
+        edge_buffer.source_arr.resize(permute.size());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (ssize_t i = 0; i < ssize_t(permute.size()); ++i) {
+          edge_buffer.source_arr[i] = source_of(src_counting_prefix_sum,
+                                                permute[i]);
+        }
+      } else {
+        outofplace_shuffle(edge_buffer.source_arr, permute);
+      }
 
-      outofplace_shuffle(edge_buffer.source_arr, permute);
-      // Use inplace shuffle to reduce peak memory footprint:
-      // inplace_shuffle(edge_buffer.source_arr, permute);
-      // counting_sort(edge_buffer.target_arr, permute);
-
+#ifdef USE_COMPRESSED_ADJACENCY
+      // encode into compressed csr csc storage. The csr edge ids are
+      // implicit.
+      _csr_storage.build(src_counting_prefix_sum, edge_buffer.target_arr);
+      _csc_storage.build(dest_counting_prefix_sum, edge_buffer.source_arr,
+                         &permute);
+      std::vector<lvid_type>().swap(edge_buffer.source_arr);
+      std::vector<lvid_type>().swap(edge_buffer.target_arr);
+#else
       // warp into csr csc storage.
       _csr_storage.wrap(src_counting_prefix_sum, edge_buffer.target_arr);
       std::vector<std::pair<lvid_type, edge_id_type> > csc_value = vector_zip(edge_buffer.source_arr, permute);
       //ASSERT_EQ(csc_value.size(), edge_buffer.size());
       _csc_storage.wrap(dest_counting_prefix_sum, csc_value); 
-      edges.swap(edge_buffer.data);
+#endif
+      swap_storage(edges, edge_buffer.data);
       ASSERT_EQ(_csr_storage.num_values(), _csc_storage.num_values());
       ASSERT_EQ(_csr_storage.num_values(), edges.size());
 #ifdef DEBGU_GRAPH
@@ -280,6 +372,49 @@ namespace graphlab {
       finalized = true;
     } // End of finalize
 
+    /**
+     * \brief Relabels the vertices so that vertex v becomes vertex
+     * new_lvid[v].  The vertex data and the edges move with their
+     * vertices and the graph is finalized again.  The edge ids are
+     * reassigned.  new_lvid must be a permutation of the vertex ids.
+     */
+    void permute_vertices(const std::vector<lvid_type>& new_lvid) {
+      ASSERT_TRUE(finalized);
+      ASSERT_EQ(new_lvid.size(), num_vertices());
+      // rebuild the edge buffer from all the edges, ignoring the window
+      const bool windowed = has_time_window;
+      has_time_window = false;
+      edge_buffer.clear();
+      edge_buffer.source_arr.resize(num_edges());
+      edge_buffer.target_arr.resize(num_edges());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (ssize_t i = 0; i < ssize_t(num_vertices()); ++i) {
+        foreach(const edge_type& e, out_edges(i)) {
+          edge_buffer.source_arr[e.id()] = new_lvid[i];
+          edge_buffer.target_arr[e.id()] = new_lvid[e.target().id()];
+        }
+      }
+      swap_storage(edges, edge_buffer.data);
+      edge_storage_type().swap(edges);
+      // move the vertex data
+      vertex_storage_type new_vertices;
+      new_vertices.resize(vertices.size());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(vertices.size()); ++i) {
+        new_vertices[new_lvid[i]] = vertices[i];
+      }
+      vertices.swap(new_vertices);
+      _csr_storage.clear();
+      _csc_storage.clear();
+      finalized = false;
+      finalize();
+      has_time_window = windowed;
+    } // End of permute_vertices
+
     /** \brief Get the number of vertices */
     size_t num_vertices() const {
       return vertices.size();
@@ -406,13 +541,13 @@ namespace graphlab {
     }
 
     /** \brief Returns a reference to the data stored on the vertex v. */
-    VertexData& vertex_data(lvid_type v) {
+    vertex_data_reference vertex_data(lvid_type v) {
       ASSERT_LT(v, vertices.size());
       return vertices[v];
     } // end of data(v)
 
     /** \brief Returns a constant reference to the data stored on the vertex v. */
-    const VertexData& vertex_data(lvid_type v) const {
+    vertex_data_const_reference vertex_data(lvid_type v) const {
       ASSERT_LT(v, vertices.size());
       return vertices[v];
     } // end of data(v)
@@ -426,6 +561,7 @@ namespace graphlab {
           >> _csr_storage
           >> _csc_storage
           >> finalized;
+      if (finalized) rebuild_edge_times();
     } // end of load
 
     /** \brief Save the local_graph to an archive */
@@ -438,13 +574,42 @@ namespace graphlab {
           << finalized;
     } // end of save
     
+    /**
+     * \brief Writes the vertex data, the edge data and the CSR/CSC
+     * arrays to a graph snapshot.  The vertex and edge data must be
+     * trivially copyable.
+     */
+    template <typename SnapshotWriter>
+    void save_snapshot(SnapshotWriter& writer) const {
+      ASSERT_TRUE(finalized);
+      save_storage_snapshot(writer, vertices);
+      save_storage_snapshot(writer, edges);
+      _csr_storage.save_snapshot(writer);
+      _csc_storage.save_snapshot(writer);
+    }
+
+    /** \brief Reads a local_graph written by save_snapshot() */
+    template <typename SnapshotReader>
+    void load_snapshot(SnapshotReader& reader) {
+      clear();
+      load_storage_snapshot(reader, vertices);
+      load_storage_snapshot(reader, edges);
+      _csr_storage.load_snapshot(reader);
+      _csc_storage.load_snapshot(reader);
+      ASSERT_EQ(_csr_storage.num_values(), edges.size());
+      ASSERT_EQ(_csc_storage.num_values(), edges.size());
+      rebuild_edge_times();
+      finalized = true;
+    }
+
     /** swap two graphs */
     void swap(local_graph& other) {
       finalized = other.finalized;
-      std::swap(vertices, other.vertices);
-      std::swap(edges, other.edges);
+      vertices.swap(other.vertices);
+      edges.swap(other.edges);
       std::swap(_csr_storage, other._csr_storage);
       std::swap(_csc_storage, other._csc_storage);
+      edge_times.swap(other.edge_times);
       std::swap(finalized, other.finalized);
     } // end of swap
 
@@ -502,7 +667,11 @@ namespace graphlab {
      * \brief Returns the number of in edges of the vertex with the given id. */
     size_t num_in_edges(const lvid_type v) const {
       ASSERT_TRUE(finalized);
+#ifdef USE_COMPRESSED_ADJACENCY
+      return _csc_storage.num_values(v);
+#else
       return (_csc_storage.end(v) - _csc_storage.begin(v));
+#endif
     }
 
     /** 
@@ -510,15 +679,30 @@ namespace graphlab {
      * \brief Returns the number of in edges of the vertex with the given id. */
     size_t num_out_edges(const lvid_type v) const {
       ASSERT_TRUE(finalized);
+#ifdef USE_COMPRESSED_ADJACENCY
+      return _csr_storage.num_values(v);
+#else
       return (_csr_storage.end(v) - _csr_storage.begin(v));
+#endif
     }
 
     /** 
      * \internal
      * \brief Returns a list of in edges of the vertex with the given id. */
     edge_list_type in_edges(lvid_type v) {
-      edge_iterator begin = edge_iterator(*this, _csc_storage.begin(v), v);
-      edge_iterator end = edge_iterator(*this, _csc_storage.end(v), v);
+#ifdef USE_COMPRESSED_ADJACENCY
+      edge_iterator begin = edge_iterator(*this, edge_iterator::CSC,
+                                          _csc_storage.begin(v), v);
+      edge_iterator end = edge_iterator(*this, edge_iterator::CSC,
+                                        _csc_storage.end(v), v);
+#else
+      size_t first, last;
+      in_edge_range(v, first, last);
+      edge_iterator begin =
+          edge_iterator(*this, _csc_storage.begin(0) + first, v);
+      edge_iterator end =
+          edge_iterator(*this, _csc_storage.begin(0) + last, v);
+#endif
       return boost::make_iterator_range(begin, end);
     }
 
@@ -526,12 +710,21 @@ namespace graphlab {
      * \internal
      * \brief Returns a list of out edges of the vertex with the given id. */
     edge_list_type out_edges(lvid_type v) {
+#ifdef USE_COMPRESSED_ADJACENCY
+      edge_iterator begin = edge_iterator(*this, edge_iterator::CSR,
+                                          _csr_storage.begin(v), v);
+      edge_iterator end = edge_iterator(*this, edge_iterator::CSR,
+                                        _csr_storage.end(v), v);
+      return boost::make_iterator_range(begin, end);
+#else
 
-      csr_type::iterator base_begin = _csr_storage.begin(v);
-      csr_type::iterator base_end = _csr_storage.end(v);
+      size_t first, last;
+      out_edge_range(v, first, last);
+      csr_type::iterator base_begin = _csr_storage.begin(0) + first;
+      csr_type::iterator base_end = _csr_storage.begin(0) + last;
 
-      edge_id_type begin_eid = base_begin - _csr_storage.begin(0); 
-      edge_id_type end_eid = base_end - _csr_storage.begin(0); 
+      edge_id_type begin_eid = first;
+      edge_id_type end_eid = last;
 
       boost::counting_iterator<edge_id_type> counter_begin(begin_eid);
       boost::counting_iterator<edge_id_type> counter_end(end_eid);
@@ -545,13 +738,213 @@ namespace graphlab {
               csr_edge_iterator(csr_iterator_tuple(base_end, counter_end)), v);
 
       return boost::make_iterator_range(begin, end);
+#endif
     }
 
+    /**
+     * \internal
+     * \brief A read only view of the in or out edges of a vertex taken
+     * directly from the CSC or CSR arrays.
+     *
+     * Used by batch gathers to avoid constructing an edge_type for
+     * every edge.  The out edges of a vertex have consecutive edge ids
+     * so their edge data is contiguous.  With compressed adjacency the
+     * edges of the vertex are decoded into the span when it is created.
+     */
+    class edge_span {
+     public:
+      edge_span() : nedges(0), out(false), out_targets(NULL),
+                    in_entries(NULL), first_eid(0),
+                    edge_array(NULL), vertex_array(NULL) { }
+
+      /// \brief Returns the number of edges in the span
+      size_t size() const { return nedges; }
+
+      /// \brief Returns true if the span contains no edges
+      bool empty() const { return nedges == 0; }
+
+      /// \brief Returns true if the span holds out edges
+      bool is_out_edges() const { return out; }
+
+      /// \brief Returns the local id of the other end of the i'th edge
+      lvid_type neighbor(size_t i) const {
+#ifdef USE_COMPRESSED_ADJACENCY
+        return decoded[i].first;
+#else
+        return out ? out_targets[i] : in_entries[i].first;
+#endif
+      }
+
+      /// \brief Returns the id of the i'th edge
+      edge_id_type edge_id(size_t i) const {
+#ifdef USE_COMPRESSED_ADJACENCY
+        return decoded[i].second;
+#else
+        return out ? first_eid + i : in_entries[i].second;
+#endif
+      }
+
+      /// \brief Returns the data on the i'th edge
+      edge_data_const_reference edge_data(size_t i) const {
+        return (*edge_array)[edge_id(i)];
+      }
+
+      /// \brief Returns the data on the other end of the i'th edge
+      vertex_data_const_reference neighbor_data(size_t i) const {
+        return (*vertex_array)[neighbor(i)];
+      }
+
+     private:
+      size_t nedges;
+      bool out;
+      const lvid_type* out_targets;
+      const std::pair<lvid_type, edge_id_type>* in_entries;
+      edge_id_type first_eid;
+      const edge_storage_type* edge_array;
+      const vertex_storage_type* vertex_array;
+#ifdef USE_COMPRESSED_ADJACENCY
+      std::vector<std::pair<lvid_type, edge_id_type> > decoded;
+#endif
+      friend class local_graph;
+    }; // end of edge_span
+
+    /**
+     * \internal
+     * \brief Returns a span over the in edges of the vertex with the
+     * given id. */
+    edge_span in_edge_span(lvid_type v) const {
+      ASSERT_TRUE(finalized);
+      edge_span span;
+#ifdef USE_COMPRESSED_ADJACENCY
+      span.nedges = num_in_edges(v);
+#else
+      size_t first, last;
+      in_edge_range(v, first, last);
+      span.nedges = last - first;
+#endif
+      if (span.nedges > 0) {
+#ifdef USE_COMPRESSED_ADJACENCY
+        span.decoded.assign(_csc_storage.begin(v), _csc_storage.end(v));
+#else
+        span.in_entries = &(*(_csc_storage.begin(0) + first));
+#endif
+        span.edge_array = &edges;
+        span.vertex_array = &vertices;
+      }
+      return span;
+    }
+
+    /**
+     * \internal
+     * \brief Returns a span over the out edges of the vertex with the
+     * given id. */
+    edge_span out_edge_span(lvid_type v) const {
+      ASSERT_TRUE(finalized);
+      edge_span span;
+      span.out = true;
+#ifdef USE_COMPRESSED_ADJACENCY
+      span.nedges = num_out_edges(v);
+#else
+      size_t first, last;
+      out_edge_range(v, first, last);
+      span.nedges = last - first;
+#endif
+      if (span.nedges > 0) {
+#ifdef USE_COMPRESSED_ADJACENCY
+        span.decoded.assign(_csr_storage.begin(v), _csr_storage.end(v));
+#else
+        span.out_targets = &(*(_csr_storage.begin(0) + first));
+        span.first_eid = first;
+#endif
+        span.edge_array = &edges;
+        span.vertex_array = &vertices;
+      }
+      return span;
+    }
+
+    /**
+     * \internal
+     * \brief Prefetches the positions of the in and out edges of the
+     * vertex with the given id in the CSC and CSR arrays.
+     */
+    void prefetch_edge_index(lvid_type v) const {
+      _csc_storage.prefetch_key(v);
+      _csr_storage.prefetch_key(v);
+    }
+
+    /**
+     * \internal
+     * \brief Prefetches the data on the vertex with the given id and
+     * the start of its in and out edges.  This reads the positions of
+     * the edges, so a loop over vertices calls prefetch_edge_index()
+     * on the vertex after.
+     */
+    void prefetch_edge_lists(lvid_type v) const {
+      storage_prefetch(vertices, v);
+      _csc_storage.prefetch_values(v);
+      _csr_storage.prefetch_values(v);
+    }
+
+    /**
+     * \internal
+     * \brief Prefetches the neighbors of a vertex ahead of a loop over
+     * its in or out edges.
+     *
+     * The loop calls next() once per edge, in the order of in_edges()
+     * or out_edges().  The data on the neighbor distance edges ahead is
+     * prefetched, and for in edges, which are not in edge id order, the
+     * data on that edge too.  With compressed adjacency the neighbors
+     * are only known once decoded, so nothing is prefetched.
+     */
+    class neighbor_prefetcher {
+     public:
+      neighbor_prefetcher(const local_graph& lgraph_ref, lvid_type v,
+                          bool in, size_t distance) :
+        lgraph_ref(lgraph_ref), in(in), distance(distance), pos(0),
+        nedges(0), out_targets(NULL), in_entries(NULL) {
+#ifndef USE_COMPRESSED_ADJACENCY
+        if (distance == 0) return;
+        size_t first, last;
+        if (in) lgraph_ref.in_edge_range(v, first, last);
+        else lgraph_ref.out_edge_range(v, first, last);
+        nedges = last - first;
+        if (nedges == 0) return;
+        if (in) in_entries = &(*(lgraph_ref._csc_storage.begin(0) + first));
+        else out_targets = &(*(lgraph_ref._csr_storage.begin(0) + first));
+        for (size_t i = 0; i < std::min(distance, nedges); ++i) prefetch(i);
+#endif
+      }
+
+      /// \brief Advances to the next edge of the loop
+      inline void next() {
+        if (pos + distance < nedges) prefetch(pos + distance);
+        ++pos;
+      }
+
+     private:
+      const local_graph& lgraph_ref;
+      bool in;
+      size_t distance;
+      size_t pos;
+      size_t nedges;
+      const lvid_type* out_targets;
+      const std::pair<lvid_type, edge_id_type>* in_entries;
+
+      inline void prefetch(size_t i) const {
+        if (in) {
+          storage_prefetch(lgraph_ref.vertices, in_entries[i].first);
+          storage_prefetch(lgraph_ref.edges, in_entries[i].second);
+        } else {
+          storage_prefetch(lgraph_ref.vertices, out_targets[i]);
+        }
+      }
+    }; // end of neighbor_prefetcher
+
     /** 
      * \internal
      * \brief Returns edge data of edge_type e
      * */
-    EdgeData& edge_data(edge_id_type eid) {
+    edge_data_reference edge_data(edge_id_type eid) {
       ASSERT_LT(eid, num_edges());
       return edges[eid]; 
     }
@@ -559,11 +952,53 @@ namespace graphlab {
      * \internal
      * \brief Returns const edge data of edge_type e
      * */
-    const EdgeData& edge_data(edge_id_type eid) const {
+    edge_data_const_reference edge_data(edge_id_type eid) const {
       ASSERT_LT(eid, num_edges());
       return edges[eid]; 
     }
 
+    /**
+     * \internal
+     * \brief Appends the arrays holding the vertex data and those
+     * holding the edge data as (first element, element size) pairs.
+     */
+    void data_arrays(std::vector<std::pair<char*, size_t> >& vertex_arrays,
+                     std::vector<std::pair<char*, size_t> >& edge_arrays) {
+      storage_arrays(vertices, vertex_arrays);
+      storage_arrays(edges, edge_arrays);
+    }
+
+    /**
+     * \internal
+     * \brief Appends every array of the local_graph as (first byte,
+     * length in bytes) pairs.
+     */
+    void memory_ranges(std::vector<std::pair<char*, size_t> >& out) {
+      std::vector<std::pair<char*, size_t> > varrays, earrays;
+      data_arrays(varrays, earrays);
+      for (size_t i = 0; i < varrays.size(); ++i) {
+        out.push_back(std::make_pair(varrays[i].first,
+                                     varrays[i].second * num_vertices()));
+      }
+      edge_memory_ranges(out);
+    }
+
+    /**
+     * \internal
+     * \brief Appends the arrays holding the edge data and the adjacency
+     * as (first byte, length in bytes) pairs.
+     */
+    void edge_memory_ranges(std::vector<std::pair<char*, size_t> >& out) {
+      std::vector<std::pair<char*, size_t> > varrays, earrays;
+      data_arrays(varrays, earrays);
+      for (size_t i = 0; i < earrays.size(); ++i) {
+        out.push_back(std::make_pair(earrays[i].first,
+                                     earrays[i].second * num_edges()));
+      }
+      _csr_storage.memory_ranges(out);
+      _csc_storage.memory_ranges(out);
+    }
+
     /** 
      * \internal
      * \brief Returns the estimated memory footprint of the local_graph. */
@@ -572,6 +1007,7 @@ namespace graphlab {
         sizeof(VertexData) * vertices.capacity();
       size_t elist_size = _csr_storage.estimate_sizeof() 
           + _csc_storage.estimate_sizeof()
+          + edge_times.capacity() * sizeof(edge_time_type)
           + sizeof(edges) + sizeof(EdgeData)*edges.capacity();
       size_t ebuffer_size = edge_buffer.estimate_sizeof();
       // std::cerr << "local_graph: tmplist size: " << (double)elist_size/(1024*1024)
@@ -603,6 +1039,62 @@ namespace graphlab {
      * \internal
      * CSR/CSC storage types
      */
+#ifdef USE_COMPRESSED_ADJACENCY
+    /**
+     * Both the CSR and the CSC storage iterate (neighbor, edge id)
+     * pairs.  The CSR edge ids are implicit.
+     */
+    typedef compressed_csr_storage<lvid_type, edge_id_type> csr_type;
+    typedef compressed_csr_storage<lvid_type, edge_id_type> csc_type;
+    typedef csr_type::const_iterator adjacency_iterator;
+
+    /**
+     * Iterates over the edges of a vertex decoding the compressed
+     * adjacency on the fly.  Advancing by n decodes the n edges in
+     * between.
+     */
+    class edge_iterator :
+        public boost::iterator_facade <
+        edge_iterator,
+        edge_type,
+        boost::random_access_traversal_tag,
+        edge_type> {
+         public:
+           enum list_type {CSR, CSC};
+           edge_iterator(local_graph& lgraph_ref, list_type _type,
+                         adjacency_iterator iter, lvid_type vid)
+               : lgraph_ref(lgraph_ref), _type(_type), iter(iter), vid(vid) {}
+
+         private:
+           friend class boost::iterator_core_access;
+
+           void increment() { ++iter; }
+           bool equal(const edge_iterator& other) const {
+             ASSERT_EQ(_type, other._type);
+             return iter == other.iter;
+           }
+           edge_type dereference() const {
+             const std::pair<lvid_type, edge_id_type> val = *iter;
+             if (_type == CSC) {
+               return edge_type(lgraph_ref, val.first, vid, val.second);
+             } else {
+               return edge_type(lgraph_ref, vid, val.first, val.second);
+             }
+           }
+           void advance(int n) {
+             ASSERT_GE(n, 0);
+             for (int i = 0; i < n; ++i) ++iter;
+           }
+           ptrdiff_t distance_to(const edge_iterator& other) const {
+             return iter.distance_to(other.iter);
+           }
+         private:
+           local_graph& lgraph_ref;
+           list_type _type;
+           adjacency_iterator iter;
+           lvid_type vid;
+        }; // end of edge_iterator
+#else
     typedef csr_storage<lvid_type, edge_id_type> csr_type;
     typedef csr_storage<std::pair<lvid_type, edge_id_type>, edge_id_type> csc_type; 
 
@@ -696,6 +1188,249 @@ namespace graphlab {
            csr_edge_iterator csr_iter;
            const lvid_type vid;
         }; // end of edge_iterator
+#endif
+
+    /**
+     * \internal
+     * Permutes the edge data and targets in place by walking the
+     * cycles of the permutation.  permute is reset to the identity.
+     */
+    void inplace_permute_by_source(std::vector<edge_id_type>& permute) {
+      lvid_type swap_target; EdgeData swap_data;
+      for (size_t i = 0; i < permute.size(); ++i) {
+        if (i != permute[i]) {
+          // Reserve the ith entry;
+          size_t j = i;
+          swap_data = edge_buffer.data[i];
+          swap_target = edge_buffer.target_arr[i];
+          // Begin swap cycle:
+          while (j != permute[j]) {
+            size_t next = permute[j];
+            if (next != i) {
+              edge_buffer.data[j] = edge_buffer.data[next];
+              edge_buffer.target_arr[j] = edge_buffer.target_arr[next];
+              permute[j] = j;
+              j = next;
+            } else {
+              // end of cycle
+              edge_buffer.data[j] = swap_data;
+              edge_buffer.target_arr[j] = swap_target;
+              permute[j] = j;
+              break;
+            }
+          }
+        }
+      }
+    }
+
+    /**
+     * \internal
+     * Regenerates the source array of edges sorted by source from the
+     * begin index of each source.
+     */
+    void fill_sorted_sources(const std::vector<edge_id_type>& prefix) {
+      const size_t nedges = edge_buffer.source_arr.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (ssize_t i = 0; i < ssize_t(prefix.size()); ++i) {
+        const size_t end = size_t(i) + 1 < prefix.size() ? prefix[i + 1] : nedges;
+        for (size_t j = prefix[i]; j < end; ++j) {
+          edge_buffer.source_arr[j] = lvid_type(i);
+        }
+      }
+    }
+
+    /**
+     * \internal
+     * Returns the source of the edge eid given the begin index of each
+     * source.
+     */
+    static lvid_type source_of(const std::vector<edge_id_type>& prefix,
+                               edge_id_type eid) {
+      return lvid_type(std::upper_bound(prefix.begin(), prefix.end(), eid)
+                       - prefix.begin() - 1);
+    }
+
+#ifndef USE_COMPRESSED_ADJACENCY
+    /**
+     * \internal
+     * Sets [begin, end) to the positions in the CSR array, which are the
+     * edge ids, of the out edges of v in the time window.
+     */
+    void out_edge_range(lvid_type v, size_t& begin, size_t& end) const {
+      begin = _csr_storage.begin(v) - _csr_storage.begin(0);
+      end = _csr_storage.end(v) - _csr_storage.begin(0);
+      if (!has_time_window) return;
+      const std::vector<edge_time_type>::const_iterator times =
+          edge_times.begin();
+      end = std::lower_bound(times + begin, times + end, window_end) - times;
+      begin = std::lower_bound(times + begin, times + end, window_begin)
+          - times;
+    }
+
+    /**
+     * \internal
+     * Sets [begin, end) to the positions in the CSC array of the in
+     * edges of v in the time window.
+     */
+    void in_edge_range(lvid_type v, size_t& begin, size_t& end) const {
+      begin = _csc_storage.begin(v) - _csc_storage.begin(0);
+      end = _csc_storage.end(v) - _csc_storage.begin(0);
+      if (!has_time_window) return;
+      end = first_in_edge_at(begin, end, window_end);
+      begin = first_in_edge_at(begin, end, window_begin);
+    }
+
+    /**
+     * \internal
+     * Returns the first position in [begin, end) of the CSC array whose
+     * edge is not older than time, or end.
+     */
+    size_t first_in_edge_at(size_t begin, size_t end,
+                            edge_time_type time) const {
+      const csc_type::const_iterator entries = _csc_storage.begin(0);
+      while (begin < end) {
+        const size_t mid = begin + (end - begin) / 2;
+        if (edge_times[entries[mid].second] < time) begin = mid + 1;
+        else end = mid;
+      }
+      return begin;
+    }
+
+    /**
+     * \internal
+     * Sorts the out edges of each source by time stamp, permuting the
+     * targets and the edge data along, and fills edge_times. The edge
+     * buffer must be sorted by source.
+     */
+    void sort_out_edges_by_time(const std::vector<edge_id_type>& prefix) {
+      const size_t nedges = edge_buffer.target_arr.size();
+      edge_times.resize(nedges);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (ssize_t i = 0; i < ssize_t(prefix.size()); ++i) {
+        const size_t begin = prefix[i];
+        const size_t end = size_t(i) + 1 < prefix.size() ? prefix[i + 1] : nedges;
+        std::vector<std::pair<edge_time_type, size_t> > order;
+        order.reserve(end - begin);
+        for (size_t j = begin; j < end; ++j) {
+          order.push_back(std::make_pair(
+              edge_timestamp<EdgeData>::get(edge_buffer.data[j]), j));
+        }
+        // the position breaks ties so that the sort is stable
+        std::sort(order.begin(), order.end());
+        std::vector<lvid_type> targets(end - begin);
+        std::vector<EdgeData> data(end - begin);
+        for (size_t j = 0; j < order.size(); ++j) {
+          targets[j] = edge_buffer.target_arr[order[j].second];
+          data[j] = edge_buffer.data[order[j].second];
+          edge_times[begin + j] = order[j].first;
+        }
+        std::copy(targets.begin(), targets.end(),
+                  edge_buffer.target_arr.begin() + begin);
+        std::copy(data.begin(), data.end(), edge_buffer.data.begin() + begin);
+      }
+    }
+
+    /// Orders edge ids by the time stamps of the edges
+    struct earlier_edge {
+      const std::vector<edge_time_type>* times;
+      bool operator()(edge_id_type a, edge_id_type b) const {
+        return (*times)[a] < (*times)[b];
+      }
+    };
+
+    /**
+     * \internal
+     * Sorts the edge ids of the in edges of each target by time stamp.
+     */
+    void sort_in_edges_by_time(std::vector<edge_id_type>& permute,
+                               const std::vector<edge_id_type>& prefix) {
+      const size_t nedges = permute.size();
+      earlier_edge earlier;
+      earlier.times = &edge_times;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (ssize_t i = 0; i < ssize_t(prefix.size()); ++i) {
+        const size_t begin = prefix[i];
+        const size_t end = size_t(i) + 1 < prefix.size() ? prefix[i + 1] : nedges;
+        std::stable_sort(permute.begin() + begin, permute.begin() + end,
+                         earlier);
+      }
+    }
+#endif
+
+    /**
+     * \internal
+     * Recomputes the time stamps of the edges from the edge data.
+     */
+    void rebuild_edge_times() {
+      std::vector<edge_time_type>().swap(edge_times);
+      if (!edge_timestamp<EdgeData>::enabled) return;
+      edge_times.resize(edges.size());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(edges.size()); ++i) {
+        edge_times[i] = edge_timestamp<EdgeData>::get(EdgeData(edges[i]));
+      }
+    }
+
+#ifdef USE_COMPRESSED_ADJACENCY
+    /**
+     * \internal
+     * Sorts the out edges of each source by target, permuting the edge
+     * data along. The edge buffer must be sorted by source.
+     */
+    void sort_out_edges_by_target(const std::vector<edge_id_type>& prefix) {
+      const size_t nedges = edge_buffer.target_arr.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (ssize_t i = 0; i < ssize_t(prefix.size()); ++i) {
+        const size_t begin = prefix[i];
+        const size_t end = size_t(i) + 1 < prefix.size() ? prefix[i + 1] : nedges;
+        if (end - begin < 2) continue;
+        std::vector<std::pair<lvid_type, EdgeData> > segment;
+        segment.reserve(end - begin);
+        for (size_t j = begin; j < end; ++j) {
+          segment.push_back(std::make_pair(edge_buffer.target_arr[j],
+                                           edge_buffer.data[j]));
+        }
+        std::stable_sort(segment.begin(), segment.end(), compare_first);
+        for (size_t j = begin; j < end; ++j) {
+          edge_buffer.target_arr[j] = segment[j - begin].first;
+          edge_buffer.data[j] = segment[j - begin].second;
+        }
+      }
+    }
+
+    static bool compare_first(const std::pair<lvid_type, EdgeData>& a,
+                              const std::pair<lvid_type, EdgeData>& b) {
+      return a.first < b.first;
+    }
+
+    /**
+     * \internal
+     * Sorts the edge ids of the in edges of each target.  Since the edge
+     * ids are assigned in source order this also sorts them by source.
+     */
+    void sort_in_edges_by_id(std::vector<edge_id_type>& permute,
+                             const std::vector<edge_id_type>& prefix) {
+      const size_t nedges = permute.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+      for (ssize_t i = 0; i < ssize_t(prefix.size()); ++i) {
+        const size_t begin = prefix[i];
+        const size_t end = size_t(i) + 1 < prefix.size() ? prefix[i + 1] : nedges;
+        std::sort(permute.begin() + begin, permute.begin() + end);
+      }
+    }
+#endif
 
 
     /**************************************************************************/
@@ -704,12 +1439,12 @@ namespace graphlab {
     /*                                                                        */
     /**************************************************************************/
     /** The vertex data is simply a vector of vertex data */
-    std::vector<VertexData> vertices;
+    vertex_storage_type vertices;
 
     /** Stores the edge data and edge relationships. */
     csr_type _csr_storage;
     csc_type _csc_storage;
-    std::vector<EdgeData> edges;
+    edge_storage_type edges;
 
     /** The edge data is a vector of edges where each edge stores its
         source, destination, and data. Used for temporary storage. The
@@ -722,6 +1457,19 @@ namespace graphlab {
         performance. */
     bool finalized;
 
+    /** Permute the edges in place during finalize */
+    bool low_memory_finalize;
+
+    /** The time stamps of the edges by edge id, if the edge data has
+        one (see edge_timestamp) */
+    std::vector<edge_time_type> edge_times;
+
+    /** The adjacency only covers the edges in [window_begin,
+        window_end) if has_time_window is set */
+    bool has_time_window;
+    edge_time_type window_begin;
+    edge_time_type window_end;
+
 
     /**************************************************************************/
     /*                                                                        */
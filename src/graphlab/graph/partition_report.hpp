@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_GRAPH_PARTITION_REPORT_HPP
+#define GRAPHLAB_GRAPH_PARTITION_REPORT_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <numeric>
+#include <algorithm>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/ui/metrics_server.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Partition quality statistics of a distributed graph.
+   *
+   * Built on every machine at the end of the ingress finalize. All the
+   * per machine arrays are indexed by procid. The report is logged as
+   * JSON by machine 0 and served by the metrics server on
+   * partition_report.json.
+   */
+  struct partition_report {
+    /// The number of edges on each machine
+    std::vector<size_t> edges;
+    /// The number of vertex replicas (masters and mirrors) on each machine
+    std::vector<size_t> vertices;
+    /// The number of masters on each machine
+    std::vector<size_t> masters;
+    /// Entry k is the number of vertices with k replicas
+    std::vector<size_t> replication_histogram;
+    /// Vertices with at least this total degree count as high degree
+    size_t high_degree_threshold;
+    size_t num_high_degree;
+    /// The replicas of all the high degree vertices
+    size_t high_degree_replicas;
+    /// The number of duplicate edges dropped by the ingress
+    size_t duplicate_edges;
+    /// The fraction of the input edges kept by the ingress
+    double edge_sample_rate;
+    /// The time spent in each phase of ingress, in seconds, on machine 0
+    std::vector<std::pair<std::string, double> > phase_times;
+
+    enum { DEFAULT_HIGH_DEGREE_THRESHOLD = 100 };
+
+    partition_report() :
+      high_degree_threshold(DEFAULT_HIGH_DEGREE_THRESHOLD),
+      num_high_degree(0), high_degree_replicas(0), duplicate_edges(0),
+      edge_sample_rate(1) { }
+
+    size_t num_vertices() const { return sum(masters); }
+    size_t num_replicas() const { return sum(vertices); }
+    size_t num_edges() const { return sum(edges); }
+
+    double replication_factor() const {
+      return num_vertices() == 0 ? 0 : double(num_replicas()) / num_vertices();
+    }
+
+    double high_degree_replication_factor() const {
+      return num_high_degree == 0 ? 0 :
+        double(high_degree_replicas) / num_high_degree;
+    }
+
+    /// The ratio of the largest entry of v to its mean
+    static double imbalance(const std::vector<size_t>& v) {
+      if (v.empty() || sum(v) == 0) return 0;
+      return double(*std::max_element(v.begin(), v.end())) * v.size() / sum(v);
+    }
+
+    std::string to_json() const {
+      std::stringstream strm;
+      strm << "{\n"
+           << "  \"nverts\": " << num_vertices() << ",\n"
+           << "  \"nedges\": " << num_edges() << ",\n"
+           << "  \"nreplicas\": " << num_replicas() << ",\n"
+           << "  \"replication_factor\": " << replication_factor() << ",\n"
+           << "  \"edge_imbalance\": " << imbalance(edges) << ",\n"
+           << "  \"vertex_imbalance\": " << imbalance(vertices) << ",\n"
+           << "  \"master_imbalance\": " << imbalance(masters) << ",\n"
+           << "  \"high_degree_threshold\": " << high_degree_threshold << ",\n"
+           << "  \"num_high_degree\": " << num_high_degree << ",\n"
+           << "  \"high_degree_replication_factor\": "
+           << high_degree_replication_factor() << ",\n"
+           << "  \"duplicate_edges\": " << duplicate_edges << ",\n"
+           << "  \"edge_sample_rate\": " << edge_sample_rate << ",\n"
+           << "  \"edges\": " << array_json(edges) << ",\n"
+           << "  \"vertices\": " << array_json(vertices) << ",\n"
+           << "  \"masters\": " << array_json(masters) << ",\n"
+           << "  \"replication_histogram\": "
+           << array_json(replication_histogram) << ",\n"
+           << "  \"phase_times\": {";
+      for (size_t i = 0; i < phase_times.size(); ++i) {
+        strm << (i == 0 ? "" : ",") << "\n    \"" << phase_times[i].first
+             << "\": " << phase_times[i].second;
+      }
+      strm << "\n  }\n}\n";
+      return strm.str();
+    }
+
+    /// Makes this the report served by the metrics server
+    void publish() const {
+      published_report_lock().lock();
+      published_report() = to_json();
+      static bool registered = false;
+      if (!registered) {
+        add_metric_server_callback("partition_report.json",
+                                   partition_report::report_page);
+        registered = true;
+      }
+      published_report_lock().unlock();
+    }
+
+  private:
+    static size_t sum(const std::vector<size_t>& v) {
+      return std::accumulate(v.begin(), v.end(), size_t(0));
+    }
+
+    static std::string array_json(const std::vector<size_t>& v) {
+      std::stringstream strm;
+      strm << "[";
+      for (size_t i = 0; i < v.size(); ++i) strm << (i == 0 ? "" : ", ") << v[i];
+      strm << "]";
+      return strm.str();
+    }
+
+    static std::string& published_report() {
+      static std::string report = "{}\n";
+      return report;
+    }
+
+    static mutex& published_report_lock() {
+      static mutex lock;
+      return lock;
+    }
+
+    static std::pair<std::string, std::string>
+    report_page(std::map<std::string, std::string>& varmap) {
+      published_report_lock().lock();
+      const std::string ret = published_report();
+      published_report_lock().unlock();
+      return std::make_pair(std::string("application/json"), ret);
+    }
+  }; // end of partition_report
+
+} // end of namespace graphlab
+#endif
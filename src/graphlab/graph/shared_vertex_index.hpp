@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_SHARED_VERTEX_INDEX_HPP
+#define GRAPHLAB_GRAPH_SHARED_VERTEX_INDEX_HPP
+
+#include <vector>
+#include <algorithm>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/util/hybrid_bitset.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief A vertex set update sent to one machine by 
+   * vertex_set::synchronize_master_to_mirrors() or 
+   * vertex_set::synchronize_mirrors_to_master_or().
+   *
+   * With BITMAP and RANGES, the message describes positions in the
+   * shared_vertex_index list the sender and the receiver have in common.
+   * With GVIDS, it holds the global ids of the vertices.
+   */
+  struct shared_set_message {
+    enum { BITMAP = 0, RANGES = 1, GVIDS = 2 };
+    unsigned char encoding;
+    /// BITMAP: bit k of the bitmap is position k. 
+    /// RANGES: pairs of (first position, number of positions).
+    std::vector<uint32_t> words;
+    /// GVIDS: the global vertex ids
+    std::vector<vertex_id_type> gvids;
+
+    shared_set_message() : encoding(BITMAP) { }
+
+    void save(oarchive& oarc) const {
+      oarc << encoding;
+      if (encoding == GVIDS) oarc << gvids;
+      else oarc << words;
+    }
+
+    void load(iarchive& iarc) {
+      iarc >> encoding;
+      if (encoding == GVIDS) iarc >> gvids;
+      else iarc >> words;
+    }
+  };
+
+
+  /**
+   * \internal
+   * \brief For every other machine, the local vertices shared with it. 
+   *
+   * <tt>masters(p)</tt> lists the vertices owned by this machine which
+   * have a mirror on machine p, and <tt>mirrors(p)</tt> the mirrors on
+   * this machine of vertices owned by p. Both are sorted by global vertex
+   * id, so <tt>masters(p)</tt> on this machine and <tt>mirrors(q)</tt> on
+   * machine p list the same vertices in the same order and vertex sets 
+   * can be exchanged as bitmaps over the positions of these lists.
+   *
+   * The index doubles as the communication plan of the graph: a 
+   * master sends to each mirror, and a mirror to its master, the position 
+   * of the vertex in their common list instead of its gvid, and the 
+   * receiver finds the lvid with master_lvid() or mirror_lvid() instead of 
+   * a vid2lvid lookup. positions() gives the positions of each local 
+   * vertex.
+   *
+   * Built by distributed_graph::finalize() without communication.
+   */
+  class shared_vertex_index {
+  public:
+    /// The position of a vertex in a masters() or mirrors() list
+    typedef uint32_t position_type;
+
+    shared_vertex_index() : built(false) { }
+
+    /// Builds the index from the vertex records of the graph
+    template <typename DGraphType>
+    void build(const DGraphType& dgraph) {
+      const size_t numprocs = dgraph.numprocs();
+      std::vector<std::vector<std::pair<vertex_id_type, lvid_type> > > 
+          master_gvids(numprocs), mirror_gvids(numprocs);
+      for (lvid_type lvid = 0; lvid < dgraph.num_local_vertices(); ++lvid) {
+        const typename DGraphType::vertex_record& rec = 
+            dgraph.l_get_vertex_record(lvid);
+        if (rec.owner == dgraph.procid()) {
+          foreach(procid_t proc, rec.mirrors()) {
+            master_gvids[proc].push_back(std::make_pair(rec.gvid, lvid));
+          }
+        } else {
+          mirror_gvids[rec.owner].push_back(std::make_pair(rec.gvid, lvid));
+        }
+      }
+      master_lvids.resize(numprocs);
+      mirror_lvids.resize(numprocs);
+      for (size_t p = 0; p < numprocs; ++p) {
+        sorted_lvids(master_gvids[p], master_lvids[p]);
+        sorted_lvids(mirror_gvids[p], mirror_lvids[p]);
+      }
+      // a master has one position per mirror, a mirror one position
+      const size_t nlocal = dgraph.num_local_vertices();
+      position_begin.assign(nlocal + 1, 0);
+      for (lvid_type lvid = 0; lvid < nlocal; ++lvid) {
+        const typename DGraphType::vertex_record& rec = 
+            dgraph.l_get_vertex_record(lvid);
+        position_begin[lvid + 1] = position_begin[lvid] + 
+            (rec.owner == dgraph.procid() ? rec.num_mirrors() : 1);
+      }
+      local_positions.resize(position_begin[nlocal]);
+      // the mirrors are visited in increasing procid, which is the order
+      // of vertex_record::mirrors()
+      std::vector<size_t> next(position_begin.begin(), position_begin.end() - 1);
+      for (size_t p = 0; p < numprocs; ++p) {
+        ASSERT_LT(master_lvids[p].size(), size_t(position_type(-1)));
+        ASSERT_LT(mirror_lvids[p].size(), size_t(position_type(-1)));
+        for (size_t k = 0; k < master_lvids[p].size(); ++k) {
+          local_positions[next[master_lvids[p][k]]++] = k;
+        }
+        for (size_t k = 0; k < mirror_lvids[p].size(); ++k) {
+          local_positions[next[mirror_lvids[p][k]]++] = k;
+        }
+      }
+      built = true;
+    }
+
+    /// Empties the index
+    void clear() {
+      std::vector<std::vector<lvid_type> >().swap(master_lvids);
+      std::vector<std::vector<lvid_type> >().swap(mirror_lvids);
+      std::vector<size_t>().swap(position_begin);
+      std::vector<position_type>().swap(local_positions);
+      built = false;
+    }
+
+    /// True once build() has been called
+    bool is_built() const { return built; }
+
+    /// The master vertices of this machine which have a mirror on proc
+    const std::vector<lvid_type>& masters(procid_t proc) const {
+      return master_lvids[proc];
+    }
+
+    /// The mirrors on this machine of vertices owned by proc
+    const std::vector<lvid_type>& mirrors(procid_t proc) const {
+      return mirror_lvids[proc];
+    }
+
+    /**
+     * The positions of a local vertex. For a master, the position in
+     * masters(p) for each of its mirrors p in the order of
+     * vertex_record::mirrors(). For a mirror, positions(lvid)[0] is its 
+     * position in mirrors(owner).
+     */
+    const position_type* positions(lvid_type lvid) const {
+      return &local_positions[position_begin[lvid]];
+    }
+
+    /// The master vertex at a position of masters(proc)
+    lvid_type master_lvid(procid_t proc, position_type position) const {
+      return master_lvids[proc][position];
+    }
+
+    /// The mirror at a position of mirrors(proc)
+    lvid_type mirror_lvid(procid_t proc, position_type position) const {
+      return mirror_lvids[proc][position];
+    }
+
+    /// The total number of entries in the index
+    size_t size() const {
+      size_t ret = 0;
+      for (size_t p = 0; p < master_lvids.size(); ++p) {
+        ret += master_lvids[p].size() + mirror_lvids[p].size();
+      }
+      return ret;
+    }
+
+    /**
+     * Encodes which of the positions are in set into msg, as a bitmap
+     * or as ranges of consecutive positions, whichever is smaller.
+     * Returns false, leaving msg untouched, if none of them are.
+     */
+    static bool encode(const hybrid_bitset<lvid_type>& set,
+                       const std::vector<lvid_type>& positions,
+                       shared_set_message& msg) {
+      size_t nset = 0, nranges = 0;
+      bool prev = false;
+      for (size_t k = 0; k < positions.size(); ++k) {
+        const bool b = set.get(positions[k]);
+        nset += b;
+        nranges += (b && !prev);
+        prev = b;
+      }
+      if (nset == 0) return false;
+      const size_t bitmap_words = (positions.size() + 31) / 32;
+      msg.words.clear();
+      if (2 * nranges < bitmap_words) {
+        msg.encoding = shared_set_message::RANGES;
+        msg.words.reserve(2 * nranges);
+        size_t k = 0;
+        while (k < positions.size()) {
+          if (!set.get(positions[k])) { ++k; continue; }
+          const size_t first = k;
+          while (k < positions.size() && set.get(positions[k])) ++k;
+          msg.words.push_back(first);
+          msg.words.push_back(k - first);
+        }
+      } else {
+        msg.encoding = shared_set_message::BITMAP;
+        msg.words.resize(bitmap_words, 0);
+        for (size_t k = 0; k < positions.size(); ++k) {
+          if (set.get(positions[k])) msg.words[k / 32] |= (uint32_t(1) << (k % 32));
+        }
+      }
+      return true;
+    }
+
+    /**
+     * Adds the positions described by a BITMAP or RANGES msg to set.
+     */
+    static void decode(const shared_set_message& msg,
+                       const std::vector<lvid_type>& positions,
+                       hybrid_bitset<lvid_type>& set) {
+      if (msg.encoding == shared_set_message::RANGES) {
+        ASSERT_EQ(msg.words.size() % 2, 0);
+        for (size_t i = 0; i < msg.words.size(); i += 2) {
+          const size_t end = size_t(msg.words[i]) + msg.words[i + 1];
+          ASSERT_LE(end, positions.size());
+          for (size_t k = msg.words[i]; k < end; ++k) {
+            set.set_bit_unsync(positions[k]);
+          }
+        }
+      } else {
+        ASSERT_EQ(msg.encoding, (unsigned char)shared_set_message::BITMAP);
+        ASSERT_EQ(msg.words.size(), (positions.size() + 31) / 32);
+        for (size_t w = 0; w < msg.words.size(); ++w) {
+          uint32_t word = msg.words[w];
+          while (word) {
+            const size_t k = 32 * w + __builtin_ctz(word);
+            set.set_bit_unsync(positions[k]);
+            word &= word - 1;
+          }
+        }
+      }
+    }
+
+  private:
+    std::vector<std::vector<lvid_type> > master_lvids;
+    std::vector<std::vector<lvid_type> > mirror_lvids;
+    /// positions(lvid) is local_positions[position_begin[lvid]...]
+    std::vector<size_t> position_begin;
+    std::vector<position_type> local_positions;
+    bool built;
+
+    static void sorted_lvids(std::vector<std::pair<vertex_id_type, lvid_type> >& gvids,
+                             std::vector<lvid_type>& lvids) {
+      std::sort(gvids.begin(), gvids.end());
+      lvids.resize(gvids.size());
+      for (size_t i = 0; i < gvids.size(); ++i) lvids[i] = gvids[i].second;
+      std::vector<std::pair<vertex_id_type, lvid_type> >().swap(gvids);
+    }
+  }; // end of shared_vertex_index
+
+} // namespace graphlab
+
+#include <graphlab/macros_undef.hpp>
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/**
+ * \file sorted_intersection.hpp
+ *
+ * Kernels counting the common elements of two sorted, duplicate free
+ * arrays, such as the sorted adjacency lists used by triangle
+ * counting and clustering coefficients.
+ */
+
+#ifndef GRAPHLAB_GRAPH_SORTED_INTERSECTION_HPP
+#define GRAPHLAB_GRAPH_SORTED_INTERSECTION_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace graphlab {
+
+  namespace graph_ops {
+
+    /**
+     * When the larger array is at least this many times larger than
+     * the smaller one, sorted_intersection_size() gallops through it
+     * rather than merging.
+     */
+    enum { GALLOP_RATIO = 8 };
+
+    /**
+     * Counts the common elements of a[0, na) and b[0, nb) by a
+     * branch free merge, in O(na + nb).
+     */
+    template <typename T>
+    size_t merge_intersection_size(const T* a, size_t na,
+                                   const T* b, size_t nb) {
+      size_t i = 0, j = 0, count = 0;
+      while (i < na && j < nb) {
+        const T x = a[i], y = b[j];
+        count += (x == y);
+        i += (x <= y);
+        j += (y <= x);
+      }
+      return count;
+    } // end of merge_intersection_size
+
+
+#ifdef __SSE2__
+    /**
+     * The merge for 32 bit elements compares blocks of 4 against
+     * blocks of 4 with SSE2: each block of a is compared against the
+     * 4 rotations of the block of b, and the block with the smaller
+     * last element is advanced. The tails are merged by the scalar
+     * kernel.
+     */
+    inline size_t merge_intersection_size(const uint32_t* a, size_t na,
+                                          const uint32_t* b, size_t nb) {
+      size_t i = 0, j = 0, count = 0;
+      while (i + 4 <= na && j + 4 <= nb) {
+        const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+        __m128i eq = _mm_cmpeq_epi32(va, vb);
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va,
+                          _mm_shuffle_epi32(vb, _MM_SHUFFLE(0,3,2,1))));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va,
+                          _mm_shuffle_epi32(vb, _MM_SHUFFLE(1,0,3,2))));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va,
+                          _mm_shuffle_epi32(vb, _MM_SHUFFLE(2,1,0,3))));
+        count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+        const uint32_t amax = a[i + 3], bmax = b[j + 3];
+        i += (amax <= bmax) ? 4 : 0;
+        j += (bmax <= amax) ? 4 : 0;
+      }
+      return count + merge_intersection_size<uint32_t>(a + i, na - i,
+                                                       b + j, nb - j);
+    } // end of merge_intersection_size
+#endif
+
+
+    /**
+     * Counts the common elements of small[0, ns) and large[0, nl) by
+     * looking up every element of small in large with an exponential
+     * search started where the previous one ended, in
+     * O(ns log(nl / ns)).
+     */
+    template <typename T>
+    size_t gallop_intersection_size(const T* small, size_t ns,
+                                    const T* large, size_t nl) {
+      size_t lo = 0, count = 0;
+      for (size_t i = 0; i < ns && lo < nl; ++i) {
+        const T x = small[i];
+        size_t step = 1;
+        while (lo + step < nl && large[lo + step] < x) step *= 2;
+        const T* begin = large + lo + step / 2;
+        const T* end = large + std::min(lo + step + 1, nl);
+        lo = std::lower_bound(begin, end, x) - large;
+        if (lo < nl && large[lo] == x) { ++count; ++lo; }
+      }
+      return count;
+    } // end of gallop_intersection_size
+
+
+    /**
+     * \brief Counts the common elements of two sorted, duplicate free
+     * arrays.
+     *
+     * Gallops through the larger array when the sizes differ by at
+     * least GALLOP_RATIO and merges them otherwise.
+     */
+    template <typename T>
+    size_t sorted_intersection_size(const T* a, size_t na,
+                                    const T* b, size_t nb) {
+      if (na > nb) { std::swap(a, b); std::swap(na, nb); }
+      if (na == 0) return 0;
+      if (nb / na >= size_t(GALLOP_RATIO)) {
+        return gallop_intersection_size(a, na, b, nb);
+      }
+      return merge_intersection_size(a, na, b, nb);
+    } // end of sorted_intersection_size
+
+
+    /// sorted_intersection_size() of two sorted vectors
+    template <typename T>
+    size_t sorted_intersection_size(const std::vector<T>& a,
+                                    const std::vector<T>& b) {
+      if (a.empty() || b.empty()) return 0;
+      return sorted_intersection_size(&a[0], a.size(), &b[0], b.size());
+    } // end of sorted_intersection_size
+
+  } // namespace graph_ops
+
+} // namespace graphlab
+
+#endif
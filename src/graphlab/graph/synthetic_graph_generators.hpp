@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_SYNTHETIC_GRAPH_GENERATORS_HPP
+#define GRAPHLAB_SYNTHETIC_GRAPH_GENERATORS_HPP
+
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <stdint.h>
+#include <graphlab/util/random.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+  namespace synthetic_graph {
+
+    /**
+     * The edges of a synthetic graph are generated in blocks of
+     * BLOCK_SIZE edges. Block b is drawn from
+     * random::counter_generator(seed, b), so the graph only depends on
+     * the seed, and not on the number of machines and threads.
+     */
+    const size_t BLOCK_SIZE = 1 << 16;
+
+    /**
+     * \brief Draws the edges of a Graph500 style R-MAT (Kronecker)
+     * graph with 2^scale vertices.
+     *
+     * Each edge descends scale levels of the adjacency matrix, picking
+     * the top left, top right, bottom left or bottom right quadrant with
+     * probabilities a, b, c and 1 - a - b - c. As in Graph500, the
+     * vertex ids are then scrambled by a fixed bijection, so that the
+     * high degree vertices are not the smallest ids.
+     */
+    class rmat_generator {
+    public:
+      rmat_generator(size_t scale, double a = 0.57, double b = 0.19,
+                     double c = 0.19) :
+        scale(scale), a(a), ab(a + b), abc(a + b + c),
+        mask(scale >= 64 ? ~uint64_t(0) : (uint64_t(1) << scale) - 1) {
+        ASSERT_GT(scale, 0);
+        ASSERT_LE(abc, 1.0);
+      }
+
+      size_t num_vertices() const { return size_t(mask) + 1; }
+
+      template <typename RNG>
+      std::pair<uint64_t, uint64_t> operator()(RNG& rng) const {
+        uint64_t source = 0, target = 0;
+        for (size_t level = 0; level < scale; ++level) {
+          const double r = rng.uniform01();
+          source <<= 1; target <<= 1;
+          if (r < a) { }
+          else if (r < ab) target |= 1;
+          else if (r < abc) source |= 1;
+          else { source |= 1; target |= 1; }
+        }
+        return std::make_pair(scramble(source), scramble(target));
+      }
+
+      /// A bijection of [0, 2^scale)
+      uint64_t scramble(uint64_t v) const {
+        const size_t shift = scale / 2 + 1;
+        v = (v * 0x9e3779b97f4a7c15ULL) & mask;
+        v ^= v >> shift;
+        v = (v * 0xbf58476d1ce4e5b9ULL) & mask;
+        v ^= v >> shift;
+        return v;
+      }
+
+    private:
+      size_t scale;
+      double a, ab, abc;
+      uint64_t mask;
+    };
+
+
+    /**
+     * \brief Draws the edges of a Chung-Lu graph with nverts vertices
+     * and a power law degree distribution of exponent alpha.
+     *
+     * The expected degree of vertex i is proportional to
+     * \f$(i+1)^{-1/(\alpha-1)}\f$, which gives degrees distributed as
+     * \f$P(d) \propto d^{-\alpha}\f$. Both ends of every edge are drawn
+     * from the normalized weights, by inverting the integral of the
+     * weights, so unlike load_synthetic_powerlaw() no per vertex table is
+     * needed. Vertex 0 has the highest degree.
+     */
+    class chung_lu_generator {
+    public:
+      chung_lu_generator(size_t nverts, double alpha = 2.1) :
+        nverts(nverts), gamma(1.0 - 1.0 / (alpha - 1.0)),
+        top(std::pow(double(nverts) + 1.0, gamma) - 1.0) {
+        ASSERT_GT(nverts, 0);
+        // the weights are only integrable for alpha > 2
+        ASSERT_GT(alpha, 2.0);
+      }
+
+      size_t num_vertices() const { return nverts; }
+
+      /// The vertex at quantile u in [0, 1) of the weights
+      uint64_t vertex(double u) const {
+        const double x = std::pow(1.0 + u * top, 1.0 / gamma) - 1.0;
+        return std::min<uint64_t>(uint64_t(x), nverts - 1);
+      }
+
+      template <typename RNG>
+      std::pair<uint64_t, uint64_t> operator()(RNG& rng) const {
+        const uint64_t source = vertex(rng.uniform01());
+        return std::make_pair(source, vertex(rng.uniform01()));
+      }
+
+    private:
+      size_t nverts;
+      double gamma, top;
+    };
+
+  } // end of synthetic_graph namespace
+} // end of graphlab namespace
+#endif
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_VERTEX_COLUMN_HPP
+#define GRAPHLAB_GRAPH_VERTEX_COLUMN_HPP
+
+#include <vector>
+#include <utility>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/graph/shared_vertex_index.hpp>
+#include <graphlab/graph/vertex_set.hpp>
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/rpc/fiber_buffered_exchange.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief The interface through which an engine keeps the mirrors of
+   * an attached vertex column up to date.
+   *
+   * \see vertex_column synchronous_engine::attach_column
+   */
+  class ivertex_column {
+  public:
+    virtual ~ivertex_column() { }
+
+    /// Sends the value of the master lvid to its mirrors. Called in fibers.
+    virtual void send_to_mirrors(lvid_type lvid) = 0;
+
+    /// Flushes the send buffers of the current worker. Called in fibers.
+    virtual void partial_flush() = 0;
+
+    /// Flushes all the send buffers. Called by one thread on every machine.
+    virtual void flush() = 0;
+
+    /// Writes the values received into the mirrors. Called in fibers.
+    virtual void receive() = 0;
+  }; // end of ivertex_column
+
+
+  /**
+   * \brief A value of type T for every vertex of a finalized graph,
+   * stored beside the graph instead of in its vertex data.
+   *
+   * Several analytics can then share the structure of one graph, each
+   * keeping its state in its own columns, which are created and freed
+   * without touching the graph. Like the vertex data, the value of a
+   * vertex is owned by its master, and synchronize() copies the master
+   * values to the mirrors. A synchronous_engine to which the column is
+   * attached does this after every apply, so that a vertex program can
+   * keep its state in the column and read the neighbor values in the
+   * gather:
+   *
+   * \code
+   * vertex_column<graph_type, double>* rank;
+   *
+   * class pagerank : public ivertex_program<graph_type, double> {
+   *   double gather(icontext_type& context, const vertex_type& vertex,
+   *                 edge_type& edge) const {
+   *     return (*rank)[edge.source()] / edge.source().num_out_edges();
+   *   }
+   *   void apply(icontext_type& context, vertex_type& vertex,
+   *              const double& total) {
+   *     (*rank)[vertex] = 0.15 + 0.85 * total;
+   *   }
+   *   ...
+   * };
+   *
+   * rank = new vertex_column<graph_type, double>(graph, 1.0);
+   * synchronous_engine<pagerank> engine(dc, graph, clopts);
+   * engine.attach_column(*rank);
+   * \endcode
+   *
+   * The constructor must be called by all machines in the same order,
+   * after the graph is finalized, and the graph must not be modified
+   * while the column exists.
+   */
+  template <typename Graph, typename T>
+  class vertex_column : public ivertex_column {
+  public:
+    typedef Graph graph_type;
+    typedef T value_type;
+    typedef typename graph_type::vertex_type vertex_type;
+    typedef typename graph_type::local_vertex_type local_vertex_type;
+    typedef shared_vertex_index::position_type position_type;
+
+    vertex_column(graph_type& graph, const T& initial = T()) :
+      graph(graph), values(graph.num_local_vertices(), initial),
+#ifdef _OPENMP
+      exchange(graph.dc(), omp_get_max_threads()),
+#else
+      exchange(graph.dc()),
+#endif
+      fiber_exchange(graph.dc()) {
+      ASSERT_TRUE(graph.get_shared_vertex_index().is_built());
+    }
+
+    /// The value of a vertex. Must be a vertex of this machine.
+    T& operator[](const vertex_type& vertex) {
+      return values[vertex.local_id()];
+    }
+
+    const T& operator[](const vertex_type& vertex) const {
+      return values[vertex.local_id()];
+    }
+
+    T& local(lvid_type lvid) { return values[lvid]; }
+
+    const T& local(lvid_type lvid) const { return values[lvid]; }
+
+    /// Sets the value of every replica of every vertex
+    void fill(const T& value) { values.assign(values.size(), value); }
+
+    /**
+     * Sets the value of every master in vset to transform(vertex), then
+     * synchronizes the mirrors. Must be called by all machines.
+     */
+    template <typename TransformType>
+    void transform(TransformType transform,
+                   const vertex_set& vset = graph_type::complete_set()) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (int i = 0; i < (int)values.size(); ++i) {
+        const lvid_type lvid = i;
+        if (graph.l_is_master(lvid) && vset.l_contains(lvid)) {
+          values[lvid] = transform(vertex_type(graph.l_vertex(lvid)));
+        }
+      }
+      synchronize(vset);
+    }
+
+    /**
+     * Copies the values of the masters in vset to their mirrors. Must be
+     * called by all machines, outside of fibers.
+     */
+    void synchronize(const vertex_set& vset = graph_type::complete_set()) {
+      const shared_vertex_index& plan = graph.get_shared_vertex_index();
+      procid_t sending_proc;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (int i = 0; i < (int)values.size(); ++i) {
+        const lvid_type lvid = i;
+        if (!graph.l_is_master(lvid) || !vset.l_contains(lvid)) continue;
+        const position_type* positions = plan.positions(lvid);
+        size_t k = 0;
+        foreach(procid_t mirror, graph.l_vertex(lvid).mirrors()) {
+#ifdef _OPENMP
+          exchange.send(mirror, pair_type(positions[k++], values[lvid]),
+                        omp_get_thread_num());
+#else
+          exchange.send(mirror, pair_type(positions[k++], values[lvid]));
+#endif
+        }
+      }
+      exchange.flush();
+      typename buffered_exchange<pair_type>::buffer_type buffer;
+      while (exchange.recv(sending_proc, buffer)) {
+        foreach(const pair_type& pair, buffer) {
+          values[plan.mirror_lvid(sending_proc, pair.first)] = pair.second;
+        }
+      }
+    }
+
+    void send_to_mirrors(lvid_type lvid) {
+      const position_type* positions =
+          graph.get_shared_vertex_index().positions(lvid);
+      size_t k = 0;
+      foreach(procid_t mirror, graph.l_vertex(lvid).mirrors()) {
+        fiber_exchange.send(mirror, pair_type(positions[k++], values[lvid]));
+      }
+    }
+
+    void partial_flush() { fiber_exchange.partial_flush(); }
+
+    void flush() { fiber_exchange.flush(); }
+
+    void receive() {
+      const shared_vertex_index& plan = graph.get_shared_vertex_index();
+      typename fiber_buffered_exchange<pair_type>::recv_buffer_type recv_buffer;
+      while (fiber_exchange.recv(recv_buffer)) {
+        for (size_t i = 0; i < recv_buffer.size(); ++i) {
+          const procid_t proc = recv_buffer[i].proc;
+          foreach(const pair_type& pair, recv_buffer[i].buffer) {
+            values[plan.mirror_lvid(proc, pair.first)] = pair.second;
+          }
+        }
+      }
+    }
+
+    /// The number of values, one per local vertex
+    size_t size() const { return values.size(); }
+
+    /// The memory used by the values in bytes
+    size_t estimate_sizeof() const { return values.capacity() * sizeof(T); }
+
+  private:
+    typedef std::pair<position_type, T> pair_type;
+
+    graph_type& graph;
+    std::vector<T> values;
+    /// Used by synchronize()
+    buffered_exchange<pair_type> exchange;
+    /// Used by the engines through the ivertex_column interface
+    fiber_buffered_exchange<pair_type> fiber_exchange;
+  }; // end of vertex_column
+
+} // end of namespace graphlab
+
+#include <graphlab/macros_undef.hpp>
+
+#endif
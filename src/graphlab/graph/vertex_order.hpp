@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_GRAPH_VERTEX_ORDER_HPP
+#define GRAPHLAB_GRAPH_VERTEX_ORDER_HPP
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \internal
+   * Relabellings of the vertices of a local graph which place vertices
+   * that are accessed together close in memory.  Each function fills
+   * new_lvid such that vertex v should become vertex new_lvid[v].  The
+   * result is meant for local_graph::permute_vertices().
+   */
+  namespace vertex_order {
+
+    /// Returns the total degree of every vertex of the local graph.
+    template <typename Graph>
+    void total_degrees(const Graph& g, std::vector<size_t>& degree) {
+      degree.resize(g.num_vertices());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(g.num_vertices()); ++i) {
+        degree[i] = g.num_in_edges(i) + g.num_out_edges(i);
+      }
+    }
+
+    /// Converts a list of vertices in their new order to new_lvid.
+    inline void order_to_labels(const std::vector<lvid_type>& order,
+                                std::vector<lvid_type>& new_lvid) {
+      new_lvid.resize(order.size());
+      for (size_t i = 0; i < order.size(); ++i) new_lvid[order[i]] = i;
+    }
+
+    struct degree_greater {
+      const std::vector<size_t>& degree;
+      degree_greater(const std::vector<size_t>& degree) : degree(degree) { }
+      bool operator()(lvid_type a, lvid_type b) const {
+        return degree[a] > degree[b];
+      }
+    };
+
+    struct degree_less {
+      const std::vector<size_t>& degree;
+      degree_less(const std::vector<size_t>& degree) : degree(degree) { }
+      bool operator()(lvid_type a, lvid_type b) const {
+        return degree[a] < degree[b];
+      }
+    };
+
+    /**
+     * Orders the vertices by decreasing total degree so that the high
+     * degree vertices, which are the targets of most edges, share
+     * cache lines.  Ties keep their current order.
+     */
+    template <typename Graph>
+    void degree_sort(const Graph& g, std::vector<lvid_type>& new_lvid) {
+      std::vector<size_t> degree;
+      total_degrees(g, degree);
+      std::vector<lvid_type> order(g.num_vertices());
+      for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+      std::stable_sort(order.begin(), order.end(), degree_greater(degree));
+      order_to_labels(order, new_lvid);
+    }
+
+    /**
+     * Reverse Cuthill-McKee ordering of the local graph with the edge
+     * directions ignored.  Each connected component is traversed
+     * breadth first from its lowest degree vertex, visiting the
+     * neighbors of a vertex in increasing degree.  Neighbors end up
+     * with nearby ids.
+     */
+    template <typename Graph>
+    void reverse_cuthill_mckee(Graph& g, std::vector<lvid_type>& new_lvid) {
+      typedef typename Graph::edge_type edge_type;
+      const size_t nverts = g.num_vertices();
+      std::vector<size_t> degree;
+      total_degrees(g, degree);
+      std::vector<lvid_type> starts(nverts);
+      for (size_t i = 0; i < nverts; ++i) starts[i] = i;
+      std::stable_sort(starts.begin(), starts.end(), degree_less(degree));
+
+      dense_bitset visited(nverts);
+      visited.clear();
+      std::vector<lvid_type> order;
+      order.reserve(nverts);
+      for (size_t s = 0; s < nverts; ++s) {
+        if (visited.get(starts[s])) continue;
+        visited.set_bit_unsync(starts[s]);
+        size_t head = order.size();
+        order.push_back(starts[s]);
+        while (head < order.size()) {
+          const lvid_type v = order[head++];
+          const size_t first = order.size();
+          foreach(const edge_type& e, g.in_edges(v)) {
+            const lvid_type u = e.source().id();
+            if (!visited.set_bit_unsync(u)) order.push_back(u);
+          }
+          foreach(const edge_type& e, g.out_edges(v)) {
+            const lvid_type u = e.target().id();
+            if (!visited.set_bit_unsync(u)) order.push_back(u);
+          }
+          std::stable_sort(order.begin() + first, order.end(),
+                           degree_less(degree));
+        }
+      }
+      ASSERT_EQ(order.size(), nverts);
+      std::reverse(order.begin(), order.end());
+      order_to_labels(order, new_lvid);
+    }
+
+    /**
+     * Computes the ordering named by method: "degree" or "rcm".
+     * Returns false if the method is not known.
+     */
+    template <typename Graph>
+    bool compute(Graph& g, const std::string& method,
+                 std::vector<lvid_type>& new_lvid) {
+      if (method == "degree") {
+        degree_sort(g, new_lvid);
+      } else if (method == "rcm") {
+        reverse_cuthill_mckee(g, new_lvid);
+      } else {
+        return false;
+      }
+      return true;
+    }
+
+  } // end of namespace vertex_order
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -26,8 +26,11 @@
 #define GRAPHLAB_GRAPH_VERTEX_SET_HPP
 
 #include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/hybrid_bitset.hpp>
+#include <graphlab/util/roaring_bitset.hpp>
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/graph/shared_vertex_index.hpp>
 #include <graphlab/macros_def.hpp>
 
 namespace graphlab {
@@ -67,17 +70,41 @@ namespace graphlab {
  * The size of the vertex set can only be queried through the graph using
  * \ref distributed_graph::vertex_set_size();
  *
+ * Once synchronized, a set holding fewer than one in
+ * \ref COMPRESSED_FRACTION_INV of the local vertices is stored as a
+ * compressed bitmap (see \ref roaring_bitset), so that algorithms keeping
+ * many small sets alive do not pay one bit per vertex for each of them.
+ * Set operations between compressed sets work on the compressed
+ * bitmaps directly. The representation is otherwise invisible.
+ *
  */
 class vertex_set {
   public:
+    /**
+     * The sorted lvid list of an explicit set holds up to
+     * num_local_vertices / SPARSE_FRACTION_INV entries.
+     */
+    static const size_t SPARSE_FRACTION_INV = 64;
+
+    /**
+     * A synchronized set is compressed if it holds fewer than
+     * num_local_vertices / COMPRESSED_FRACTION_INV vertices. The
+     * compressed bitmap uses about 2 bytes per vertex in the set.
+     */
+    static const size_t COMPRESSED_FRACTION_INV = 32;
+
     /**
      * Used only if \ref lazy is false.
      * If \ref lazy is false, this must be the same size as the graph's
      * graphlab::distributed_graph::num_local_vertices().
      * The invariant is that the bit value of each mirror vertex must be the
      * same value as the bit value on their corresponding master vertices.
+     *
+     * While only a small fraction of the vertices are in the set, the
+     * bitset also keeps a sorted list of the contained lvids so that
+     * traversals cost O(|set|) rather than O(num_local_vertices).
      */
-    mutable dense_bitset localvset;
+    mutable hybrid_bitset<lvid_type> localvset;
 
     /**
      * Used only if \ref lazy is set.
@@ -92,14 +119,29 @@ class vertex_set {
      */
     mutable bool lazy;
 
+    /**
+     * Used only if \ref lazy is false.
+     * If set, the set is held by \ref compressed and localvset is empty.
+     */
+    mutable bool is_compressed;
+
+    /// The vertices of the set if \ref is_compressed is set
+    mutable roaring_bitset compressed;
+
+    /// The size of localvset before it was compressed
+    mutable size_t compressed_nbits;
+
 
     /**
      * \internal
      * \brief Returns a const reference to the underlying bitset.
      */
     template <typename DGraphType>
-    const dense_bitset& get_lvid_bitset(const DGraphType& dgraph) const {
+    const hybrid_bitset<lvid_type>& get_lvid_bitset(const DGraphType& dgraph) const {
       if (lazy) make_explicit(dgraph);
+      decompress();
+      // sort the sparse list so that traversals are in lvid order
+      if (localvset.is_sparse()) localvset.compact_sparse();
       return localvset;
     }
 
@@ -113,6 +155,7 @@ class vertex_set {
      */
     inline void set_lvid_unsync(lvid_type lvid) {
       ASSERT_FALSE(lazy);
+      ASSERT_FALSE(is_compressed);
       localvset.set_bit_unsync(lvid);
     }
 
@@ -126,18 +169,22 @@ class vertex_set {
      */
     inline void set_lvid(lvid_type lvid) {
       ASSERT_FALSE(lazy);
+      ASSERT_FALSE(is_compressed);
       localvset.set_bit(lvid);
     }
 
     /**
      * \internal
      * Makes the internal representation explicit by clearing the lazy flag
-     * and filling the bitset.
+     * and filling the bitset. A compressed set is expanded back into the
+     * bitset.
      */
     template <typename DGraphType>
     void make_explicit(const DGraphType& dgraph) const {
       if (lazy) {
         localvset.resize(dgraph.num_local_vertices());
+        localvset.set_sparse_capacity(
+            dgraph.num_local_vertices() / SPARSE_FRACTION_INV);
         if (is_complete_set) {
           localvset.fill();
         }
@@ -146,6 +193,115 @@ class vertex_set {
         }
         lazy = false;
       }
+      decompress();
+    }
+
+    /**
+     * \internal
+     * Expands a compressed set back into localvset. Not thread safe.
+     */
+    void decompress() const {
+      if (!is_compressed) return;
+      localvset.resize(compressed_nbits);
+      localvset.set_sparse_capacity(compressed_nbits / SPARSE_FRACTION_INV);
+      localvset.clear();
+      compressed.for_each(bitset_inserter(&localvset));
+      compressed.clear();
+      is_compressed = false;
+    }
+
+    /**
+     * \internal
+     * Compresses an explicit set holding fewer than one in
+     * COMPRESSED_FRACTION_INV local vertices, and expands a compressed
+     * set which grew above that. Not thread safe.
+     */
+    void choose_representation() const {
+      if (lazy) return;
+      if (is_compressed) {
+        if (compressed.size() * COMPRESSED_FRACTION_INV >= compressed_nbits) {
+          decompress();
+        }
+        return;
+      }
+      const size_t nbits = localvset.size();
+      // the compressed bitmap holds 32 bit lvids
+      if (nbits == 0 || nbits - 1 > size_t(uint32_t(-1))) return;
+      if (localvset.popcount() * COMPRESSED_FRACTION_INV >= nbits) return;
+      compressed.clear();
+      localvset.for_each_set_bit(compressed_inserter(&compressed));
+      hybrid_bitset<lvid_type>().swap(localvset);
+      compressed_nbits = nbits;
+      is_compressed = true;
+    }
+
+    /**
+     * \internal
+     * Calls fn(lvid) for every local vertex in the set in increasing
+     * order without changing the representation of the set.
+     */
+    template <typename DGraphType, typename Fn>
+    Fn for_each_lvid(const DGraphType& dgraph, Fn fn) const {
+      if (lazy) {
+        if (is_complete_set) {
+          for (size_t i = 0; i < dgraph.num_local_vertices(); ++i) fn(i);
+        }
+        return fn;
+      }
+      if (is_compressed) return compressed.for_each(fn);
+      if (localvset.is_sparse()) localvset.compact_sparse();
+      return localvset.for_each_set_bit(fn);
+    }
+
+    /// Visitor adding lvids to a compressed bitmap
+    struct compressed_inserter {
+      roaring_bitset* out;
+      compressed_inserter(roaring_bitset* out) : out(out) { }
+      void operator()(size_t lvid) const { out->add(uint32_t(lvid)); }
+    };
+
+    /**
+     * Visitor adding to a compressed bitmap the lvids whose bit in a
+     * bitset equals keep_if
+     */
+    struct filtered_inserter {
+      roaring_bitset* out;
+      const hybrid_bitset<lvid_type>* filter;
+      bool keep_if;
+      filtered_inserter(roaring_bitset* out,
+                        const hybrid_bitset<lvid_type>* filter, bool keep_if) :
+          out(out), filter(filter), keep_if(keep_if) { }
+      void operator()(size_t lvid) const {
+        if (filter->get(lvid) == keep_if) out->add(uint32_t(lvid));
+      }
+    };
+
+    /// Visitor setting the bits of lvids in a bitset
+    struct bitset_inserter {
+      hybrid_bitset<lvid_type>* out;
+      bitset_inserter(hybrid_bitset<lvid_type>* out) : out(out) { }
+      void operator()(size_t lvid) const { out->set_bit_unsync(lvid); }
+    };
+
+    /// Visitor clearing the bits of lvids in a bitset
+    struct bitset_eraser {
+      hybrid_bitset<lvid_type>* out;
+      bitset_eraser(hybrid_bitset<lvid_type>* out) : out(out) { }
+      void operator()(size_t lvid) const { out->clear_bit_unsync(lvid); }
+    };
+
+    /**
+     * \internal
+     * Replaces the contents by the lvids of the compressed set c, out of
+     * a bitset of nbits bits
+     */
+    void assign_compressed(roaring_bitset& c, size_t nbits) {
+      compressed.swap(c);
+      c.clear();
+      hybrid_bitset<lvid_type>().swap(localvset);
+      compressed_nbits = nbits;
+      is_compressed = true;
+      lazy = false;
     }
 
     /**
@@ -160,6 +316,13 @@ class vertex_set {
         make_explicit(dgraph);
         return;
       }
+      decompress();
+      if (dgraph.get_shared_vertex_index().is_built()) {
+        synchronize_shared(dgraph, true);
+        choose_representation();
+        return;
+      }
+      if (localvset.is_sparse()) localvset.compact_sparse();
       foreach(size_t lvid, localvset) {
         typename DGraphType::local_vertex_type lvtx = dgraph.l_vertex(lvid);
         if (lvtx.owned()) {
@@ -176,15 +339,21 @@ class vertex_set {
       exchange.flush();
 
       typename buffered_exchange<vertex_id_type>::buffer_type recv_buffer;
+      std::vector<lvid_type> recv_lvids;
       procid_t sending_proc;
 
       while(exchange.recv(sending_proc, recv_buffer)) {
-        foreach(vertex_id_type gvid, recv_buffer) {
-          localvset.set_bit_unsync(dgraph.vertex(gvid).local_id());
+        if (!recv_buffer.empty()) {
+          recv_lvids.resize(recv_buffer.size());
+          dgraph.local_vids(&recv_buffer[0], recv_buffer.size(), &recv_lvids[0]);
+          foreach(lvid_type lvid, recv_lvids) {
+            localvset.set_bit_unsync(lvid);
+          }
         }
         recv_buffer.clear();
       }
       exchange.barrier();
+      choose_representation();
     }
 
 
@@ -199,6 +368,12 @@ class vertex_set {
         make_explicit(dgraph);
         return;
       }
+      decompress();
+      if (dgraph.get_shared_vertex_index().is_built()) {
+        synchronize_shared(dgraph, false);
+        return;
+      }
+      if (localvset.is_sparse()) localvset.compact_sparse();
       foreach(size_t lvid, localvset) {
         typename DGraphType::local_vertex_type lvtx = dgraph.l_vertex(lvid);
         if (!lvtx.owned()) {
@@ -210,11 +385,95 @@ class vertex_set {
       exchange.flush();
 
       typename buffered_exchange<vertex_id_type>::buffer_type recv_buffer;
+      std::vector<lvid_type> recv_lvids;
       procid_t sending_proc;
 
       while(exchange.recv(sending_proc, recv_buffer)) {
-        foreach(vertex_id_type gvid, recv_buffer) {
-          localvset.set_bit_unsync(dgraph.vertex(gvid).local_id());
+        if (!recv_buffer.empty()) {
+          recv_lvids.resize(recv_buffer.size());
+          dgraph.local_vids(&recv_buffer[0], recv_buffer.size(), &recv_lvids[0]);
+          foreach(lvid_type lvid, recv_lvids) {
+            localvset.set_bit_unsync(lvid);
+          }
+        }
+        recv_buffer.clear();
+      }
+      exchange.barrier();
+    }
+
+    /**
+     * \internal
+     * synchronize_master_to_mirrors() (if master_to_mirrors is set) or 
+     * synchronize_mirrors_to_master_or() using the shared vertex index of
+     * the graph. Sparse sets send the gvids of their vertices. Dense sets
+     * send, to each machine, the positions in the shared vertex list
+     * which are in the set, as a bitmap or as ranges of positions.
+     */
+    template <typename DGraphType>
+    void synchronize_shared(DGraphType& dgraph, bool master_to_mirrors) {
+      const shared_vertex_index& index = dgraph.get_shared_vertex_index();
+      buffered_exchange<shared_set_message>& exchange = 
+          dgraph.get_shared_set_exchange();
+      const procid_t numprocs = dgraph.numprocs();
+      const procid_t procid = dgraph.procid();
+      if (localvset.is_sparse()) {
+        localvset.compact_sparse();
+        std::vector<shared_set_message> messages(numprocs);
+        foreach(size_t lvid, localvset) {
+          typename DGraphType::local_vertex_type lvtx = dgraph.l_vertex(lvid);
+          if (master_to_mirrors) {
+            if (lvtx.owned()) {
+              vertex_id_type gvid = lvtx.global_id();
+              foreach(size_t proc, lvtx.mirrors()) {
+                messages[proc].gvids.push_back(gvid);
+              }
+            } else {
+              localvset.clear_bit_unsync(lvid);
+            }
+          } else if (!lvtx.owned()) {
+            messages[lvtx.owner()].gvids.push_back(lvtx.global_id());
+          }
+        }
+        for (procid_t p = 0; p < numprocs; ++p) {
+          if (messages[p].gvids.empty()) continue;
+          messages[p].encoding = shared_set_message::GVIDS;
+          exchange.send(p, messages[p]);
+        }
+      } else {
+        if (master_to_mirrors) {
+          // the mirrors take the values of their masters
+          for (procid_t p = 0; p < numprocs; ++p) {
+            if (p == procid) continue;
+            foreach(lvid_type lvid, index.mirrors(p)) {
+              localvset.clear_bit_unsync(lvid);
+            }
+          }
+        }
+        shared_set_message message;
+        for (procid_t p = 0; p < numprocs; ++p) {
+          if (p == procid) continue;
+          const std::vector<lvid_type>& positions = 
+              master_to_mirrors ? index.masters(p) : index.mirrors(p);
+          if (shared_vertex_index::encode(localvset, positions, message)) {
+            exchange.send(p, message);
+          }
+        }
+      }
+      exchange.flush();
+      typename buffered_exchange<shared_set_message>::buffer_type recv_buffer;
+      procid_t sending_proc;
+      while(exchange.recv(sending_proc, recv_buffer)) {
+        foreach(const shared_set_message& message, recv_buffer) {
+          if (message.encoding == shared_set_message::GVIDS) {
+            foreach(vertex_id_type gvid, message.gvids) {
+              localvset.set_bit_unsync(dgraph.vertex(gvid).local_id());
+            }
+          } else {
+            shared_vertex_index::decode(message, 
+                master_to_mirrors ? index.mirrors(sending_proc) 
+                                  : index.masters(sending_proc),
+                localvset);
+          }
         }
         recv_buffer.clear();
       }
@@ -226,35 +485,69 @@ class vertex_set {
 
   public:
     /// default constructor which constructs an empty set.
-    vertex_set():is_complete_set(false), lazy(true){}
+    vertex_set():is_complete_set(false), lazy(true), is_compressed(false),
+                 compressed_nbits(0) {}
 
 
     /** Constructs a completely empty, or a completely full vertex set
      * \param complete If set to true, creates a set of all vertices.
      *                 If set to false, creates an empty set.
      */
-    explicit vertex_set(bool complete):is_complete_set(complete),lazy(true){}
+    explicit vertex_set(bool complete):is_complete_set(complete),lazy(true),
+                                       is_compressed(false),
+                                       compressed_nbits(0) {}
 
     /// copy constructor
     inline vertex_set(const vertex_set& other):
         localvset(other.localvset),
         is_complete_set(other.is_complete_set),
-        lazy(other.lazy) {}
+        lazy(other.lazy),
+        is_compressed(other.is_compressed),
+        compressed(other.compressed),
+        compressed_nbits(other.compressed_nbits) {}
 
     /// copyable
     inline vertex_set& operator=(const vertex_set& other) {
       localvset = other.localvset;
       is_complete_set = other.is_complete_set;
       lazy = other.lazy;
+      is_compressed = other.is_compressed;
+      compressed = other.compressed;
+      compressed_nbits = other.compressed_nbits;
       return *this;
     }
 
+    /// Serializes the set. A compressed set stays compressed.
+    void save(oarchive& oarc) const {
+      oarc << is_complete_set << lazy << is_compressed;
+      if (lazy) return;
+      if (is_compressed) oarc << compressed_nbits << compressed;
+      else oarc << localvset.dense();
+    }
+
+    /// Deserializes the set
+    void load(iarchive& iarc) {
+      iarc >> is_complete_set >> lazy >> is_compressed;
+      compressed.clear();
+      hybrid_bitset<lvid_type>().swap(localvset);
+      if (lazy) return;
+      if (is_compressed) {
+        iarc >> compressed_nbits >> compressed;
+      } else {
+        dense_bitset bits;
+        iarc >> bits;
+        localvset = bits;
+        localvset.set_sparse_capacity(bits.size() / SPARSE_FRACTION_INV);
+      }
+    }
+
     /**
      * \internal
      * Queries if a local vertex ID is contained within the vertex set
      */
     inline bool l_contains(lvid_type lvid) const {
       if (lazy) return is_complete_set;
+      if (is_compressed) return compressed.contains(uint32_t(lvid));
       if (lvid < localvset.size()) {
         return localvset.get(lvid);
       }
@@ -337,8 +630,21 @@ class vertex_set {
         if (other.is_complete_set) /* no op */;
         else (*this) = vertex_set(false);
       }
+      else if (is_compressed && other.is_compressed) {
+        compressed &= other.compressed;
+      }
+      else if (is_compressed || other.is_compressed) {
+        // the intersection is at most as large as the compressed side
+        const vertex_set& small = is_compressed ? *this : other;
+        const vertex_set& large = is_compressed ? other : *this;
+        roaring_bitset result;
+        small.compressed.for_each(
+            filtered_inserter(&result, &large.localvset, true));
+        assign_compressed(result, small.compressed_nbits);
+      }
       else {
         localvset &= other.localvset;
+        choose_representation();
       }
       return *this;
     }
@@ -362,8 +668,18 @@ class vertex_set {
         if (other.is_complete_set) (*this) = vertex_set(true);
         else /* no op */;
       }
+      else if (is_compressed && other.is_compressed) {
+        compressed |= other.compressed;
+        choose_representation();
+      }
       else {
-        localvset |= other.localvset;
+        decompress();
+        if (other.is_compressed) {
+          other.compressed.for_each(bitset_inserter(&localvset));
+        } else {
+          localvset |= other.localvset;
+        }
+        choose_representation();
       }
       return *this;
     }
@@ -392,8 +708,21 @@ class vertex_set {
         if (other.is_complete_set) (*this) = vertex_set(false);
         else /* no op */;
       }
+      else if (is_compressed && other.is_compressed) {
+        compressed -= other.compressed;
+      }
+      else if (is_compressed) {
+        roaring_bitset result;
+        compressed.for_each(filtered_inserter(&result, &other.localvset, false));
+        assign_compressed(result, compressed_nbits);
+      }
       else {
-        localvset -= other.localvset;
+        if (other.is_compressed) {
+          other.compressed.for_each(bitset_eraser(&localvset));
+        } else {
+          localvset -= other.localvset;
+        }
+        choose_representation();
       }
       return *this;
     }
@@ -425,7 +754,9 @@ class vertex_set {
         is_complete_set = !is_complete_set;
       }
       else {
+        decompress();
         localvset.invert();
+        choose_representation();
       }
     }
 
@@ -71,7 +71,7 @@ extern "C" {
     }
     
     // store env for this thread
-    thread::get_local(proxy_updater::core::ENV_ID) = env;
+    proxy_updater::core::set_jni_env(env);
     
     // allocate and configure core
     proxy_updater::core *jni_core = new proxy_updater::core(env, obj);
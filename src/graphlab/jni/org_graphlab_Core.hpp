@@ -124,6 +124,7 @@ namespace graphlab {
         assert(res >= 0);
         thread::get_local(ENV_ID) = NULL;
       }
+      cached_env() = NULL;
       
     }
     
@@ -156,11 +157,14 @@ namespace graphlab {
      * thread has not been attached to the JVM yet. In that case, this 
      * function will attach the current thread to the JVM and save the
      * associated JNI environment to the thread-local storage.
+     * The environment is also kept in a __thread pointer, so that the
+     * calls made for every update do not search the thread-local store.
      * @return JNI environment associated with the current thread.
      */
     static JNIEnv *get_jni_env (){
     
-      JNIEnv *jenv = NULL;
+      JNIEnv *jenv = cached_env();
+      if (NULL != jenv) return jenv;
     
       // if current thread is not already on the JVM, attach it    
       if (!thread::contains(ENV_ID)) {
@@ -175,10 +179,30 @@ namespace graphlab {
       }
       
       // return the environment associated with the current thread
-      return thread::get_local(ENV_ID).as<JNIEnv *>();
+      jenv = thread::get_local(ENV_ID).as<JNIEnv *>();
+      cached_env() = jenv;
+      return jenv;
       
     }
     
+    /**
+     * Saves the JNI environment of a thread which is already attached to
+     * the JVM, such as the thread of a native method call.
+     * @param[in] env   JNI environment of the current thread
+     */
+    static void set_jni_env (JNIEnv *env){
+      thread::get_local(ENV_ID) = env;
+      cached_env() = env;
+    }
+    
+  private:
+  
+    /** The JNI environment of the current thread, or NULL if not known yet */
+    static JNIEnv *&cached_env (){
+      static __thread JNIEnv *env = NULL;
+      return env;
+    }
+    
   };
 
 }
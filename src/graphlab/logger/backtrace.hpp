@@ -24,7 +24,11 @@
 #ifndef GRAPHLAB_BACKTRACE_HPP
 #define GRAPHLAB_BACKTRACE_HPP
 
+#include <string>
+
 extern void __set_back_trace_file_number(int number);
+/// Demangles a symbol as returned by backtrace_symbols()
+extern std::string demangle(const char* symbol);
 extern void __print_back_trace();
 
 #endif
@@ -28,6 +28,8 @@
 #include <fstream>
 #include <iostream>
 #include <pthread.h>
+#include <sys/time.h>
+#include <algorithm>
 #include <graphlab/logger/backtrace.hpp>
 
 file_logger& global_logger() {
@@ -41,7 +43,7 @@ file_logger& global_logger() {
 void streambuffdestructor(void* v){
   logger_impl::streambuff_tls_entry* t =
     reinterpret_cast<logger_impl::streambuff_tls_entry*>(v);
-  delete t;
+  global_logger().release_entry(t);
 }
 
 const char* messages[] = {  "DEBUG:    ",
@@ -57,11 +59,20 @@ file_logger::file_logger() {
   log_file = "";
   log_to_console = true;
   log_level = LOG_EMPH;
+  async = false;
+  writer_running = false;
+  stop_writer = false;
+  dropped = 0;
   pthread_mutex_init(&mut, NULL);
+  pthread_mutex_init(&entries_lock, NULL);
+  pthread_cond_init(&writer_cond, NULL);
   pthread_key_create(&streambuffkey, streambuffdestructor);
+  const char* async_env = getenv("GRAPHLAB_LOG_ASYNC");
+  if (async_env != NULL && strcmp(async_env, "1") == 0) set_log_async(true);
 }
 
 file_logger::~file_logger() {
+  set_log_async(false);
   if (fout.good()) {
     fout.flush();
     fout.close();
@@ -70,6 +81,153 @@ file_logger::~file_logger() {
   pthread_mutex_destroy(&mut);
 }
 
+
+void file_logger::set_log_async(bool new_async) {
+  pthread_mutex_lock(&entries_lock);
+  const bool start = new_async && !writer_running;
+  const bool stop = !new_async && writer_running;
+  if (start) {
+    stop_writer = false;
+    writer_running =
+        pthread_create(&writer, NULL, writer_main, this) == 0;
+  }
+  if (stop) stop_writer = true;
+  async = new_async && writer_running;
+  pthread_mutex_unlock(&entries_lock);
+  if (stop) {
+    pthread_cond_signal(&writer_cond);
+    pthread_join(writer, NULL);
+    writer_running = false;
+    flush();
+  }
+}
+
+
+void* file_logger::writer_main(void* arg) {
+  file_logger* l = reinterpret_cast<file_logger*>(arg);
+  const long WRITE_INTERVAL_US = 50 * 1000;
+  pthread_mutex_lock(&l->entries_lock);
+  while (!l->stop_writer) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    const long usec = now.tv_usec + WRITE_INTERVAL_US;
+    struct timespec deadline;
+    deadline.tv_sec = now.tv_sec + usec / 1000000;
+    deadline.tv_nsec = (usec % 1000000) * 1000;
+    pthread_cond_timedwait(&l->writer_cond, &l->entries_lock, &deadline);
+    pthread_mutex_unlock(&l->entries_lock);
+    l->flush();
+    pthread_mutex_lock(&l->entries_lock);
+  }
+  pthread_mutex_unlock(&l->entries_lock);
+  return NULL;
+}
+
+
+void file_logger::flush() {
+  std::vector<logger_impl::log_record> records;
+  // mut keeps the messages taken by concurrent flushes in order
+  pthread_mutex_lock(&mut);
+  pthread_mutex_lock(&entries_lock);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    logger_impl::streambuff_tls_entry* entry = entries[i];
+    pthread_mutex_lock(&entry->pending_lock);
+    if (records.empty()) {
+      records.swap(entry->pending);
+    } else {
+      records.insert(records.end(), entry->pending.begin(),
+                     entry->pending.end());
+      entry->pending.clear();
+    }
+    entry->pending_bytes = 0;
+    pthread_mutex_unlock(&entry->pending_lock);
+  }
+  pthread_mutex_unlock(&entries_lock);
+  for (size_t i = 0; i < records.size(); ++i) write_record(records[i]);
+  const size_t ndropped = __sync_lock_test_and_set(&dropped, 0);
+  if (ndropped > 0) {
+    char str[128];
+    const int len = snprintf(str, sizeof(str), "%slogger: %lu messages "
+                             "dropped, the logging threads were ahead of "
+                             "the output\n", messages[LOG_WARNING],
+                             (unsigned long)ndropped);
+    write_unlocked(LOG_WARNING, str, len);
+  }
+  if (!records.empty() || ndropped > 0) {
+    if (fout.good()) fout.flush();
+  }
+  pthread_mutex_unlock(&mut);
+}
+
+
+logger_impl::streambuff_tls_entry* file_logger::get_entry() {
+  logger_impl::streambuff_tls_entry* streambufentry =
+        reinterpret_cast<logger_impl::streambuff_tls_entry*>(
+                              pthread_getspecific(streambuffkey));
+  // create the key if it doesn't exist
+  if (streambufentry == NULL) {
+    streambufentry = new logger_impl::streambuff_tls_entry;
+    pthread_setspecific(streambuffkey, streambufentry);
+    pthread_mutex_lock(&entries_lock);
+    entries.push_back(streambufentry);
+    pthread_mutex_unlock(&entries_lock);
+  }
+  return streambufentry;
+}
+
+
+void file_logger::release_entry(logger_impl::streambuff_tls_entry* entry) {
+  pthread_mutex_lock(&mut);
+  pthread_mutex_lock(&entries_lock);
+  entries.erase(std::remove(entries.begin(), entries.end(), entry),
+                entries.end());
+  pthread_mutex_unlock(&entries_lock);
+  // nobody else can see the entry any more
+  for (size_t i = 0; i < entry->pending.size(); ++i) {
+    write_record(entry->pending[i]);
+  }
+  pthread_mutex_unlock(&mut);
+  delete entry;
+}
+
+
+void file_logger::enqueue(logger_impl::streambuff_tls_entry* entry,
+                          int loglevel, const char* file,
+                          const char* function, int line,
+                          const char* buf, size_t len) {
+  pthread_mutex_lock(&entry->pending_lock);
+  if (entry->pending_bytes + len > MAX_PENDING_BYTES) {
+    __sync_fetch_and_add(&dropped, 1);
+  } else {
+    entry->pending.push_back(logger_impl::log_record());
+    logger_impl::log_record& record = entry->pending.back();
+    record.loglevel = loglevel;
+    record.file = file;
+    record.function = function;
+    record.line = line;
+    record.text.assign(buf, len);
+    entry->pending_bytes += len;
+  }
+  const bool wake = entry->pending_bytes > MAX_PENDING_BYTES / 2;
+  pthread_mutex_unlock(&entry->pending_lock);
+  if (wake) pthread_cond_signal(&writer_cond);
+}
+
+
+void file_logger::write_record(const logger_impl::log_record& record) {
+  if (record.file != NULL) {
+    const char* file = ((strrchr(record.file, '/') ? : record.file - 1) + 1);
+    char str[1024];
+    int len = snprintf(str, sizeof(str), "%s%s(%s:%d): ",
+                       messages[record.loglevel], file, record.function,
+                       record.line);
+    len = std::min<int>(len, sizeof(str) - 1);
+    write_unlocked(record.loglevel, str, len);
+  }
+  write_unlocked(record.loglevel, record.text.c_str(),
+                 (int)record.text.length());
+}
+
 bool file_logger::set_log_file(std::string file) {
   // close the file if it is open
   if (fout.good()) {
@@ -140,8 +298,15 @@ void file_logger::_log(int lineloglevel,const char* file,const char* function,
 
     byteswritten += vsnprintf(str + byteswritten,1024 - byteswritten,fmt,ap);
 
+    // vsnprintf returns the untruncated length
+    byteswritten = std::min(byteswritten, 1022);
     str[byteswritten] = '\n';
     str[byteswritten+1] = 0;
+    if (async && lineloglevel < LOG_ERROR) {
+      enqueue(get_entry(), lineloglevel, NULL, NULL, 0, str, byteswritten + 1);
+      return;
+    }
+    if (async) flush();
     // write the output
     if (fout.good()) {
       pthread_mutex_lock(&mut);
@@ -177,6 +342,14 @@ void file_logger::_logbuf(int lineloglevel,const char* file,const char* function
                           int line,const char* buf, int len) {
   // if the logger level fits
   if (lineloglevel >= log_level){
+    if (async && lineloglevel < LOG_ERROR) {
+      // the writer formats the header
+      std::string text(buf, len);
+      text += '\n';
+      enqueue(get_entry(), lineloglevel, file, function, line,
+              text.c_str(), text.length());
+      return;
+    }
     // get just the filename. this line found on a forum on line.
     // claims to be from google.
     file = ((strrchr(file, '/') ? : file- 1) + 1);
@@ -202,14 +375,23 @@ void file_logger::_logbuf(int lineloglevel,const char* file,const char* function
 }
 
 void file_logger::_lograw(int lineloglevel, const char* buf, int len) {
+  if (async && lineloglevel < LOG_ERROR) {
+    enqueue(get_entry(), lineloglevel, NULL, NULL, 0, buf, len);
+    return;
+  }
+  // write the buffered messages first
+  if (async) flush();
+  pthread_mutex_lock(&mut);
+  write_unlocked(lineloglevel, buf, len);
+  pthread_mutex_unlock(&mut);
+}
+
+void file_logger::write_unlocked(int lineloglevel, const char* buf, int len) {
   if (fout.good()) {
-    pthread_mutex_lock(&mut);
     fout.write(buf,len);
-    pthread_mutex_unlock(&mut);
   }
   if (log_to_console) {
 #ifdef COLOROUTPUT
-    pthread_mutex_lock(&mut);
     if (lineloglevel == LOG_FATAL) {
       textcolor(stderr, BRIGHT, RED);
     }
@@ -228,8 +410,6 @@ void file_logger::_lograw(int lineloglevel, const char* buf, int len) {
 #endif
     std::cerr.write(buf,len);
 #ifdef COLOROUTPUT
-
-    pthread_mutex_unlock(&mut);
     reset_color(stderr);
 #endif
   }
@@ -238,14 +418,7 @@ void file_logger::_lograw(int lineloglevel, const char* buf, int len) {
 file_logger& file_logger::start_stream(int lineloglevel,const char* file,
                                        const char* function, int line, bool do_start) {
   // get the stream buffer
-  logger_impl::streambuff_tls_entry* streambufentry =
-        reinterpret_cast<logger_impl::streambuff_tls_entry*>(
-                              pthread_getspecific(streambuffkey));
-  // create the key if it doesn't exist
-  if (streambufentry == NULL) {
-    streambufentry = new logger_impl::streambuff_tls_entry;
-    pthread_setspecific(streambuffkey, streambufentry);
-  }
+  logger_impl::streambuff_tls_entry* streambufentry = get_entry();
   std::stringstream& streambuffer = streambufentry->streambuffer;
   bool& streamactive = streambufentry->streamactive;
 
@@ -257,14 +430,20 @@ file_logger& file_logger::start_stream(int lineloglevel,const char* file,
       return *this;
     }
 
-    file = ((strrchr(file, '/') ? : file- 1) + 1);
-
     if (streambuffer.str().length() == 0) {
-      streambuffer << messages[lineloglevel] << file
-                   << "(" << function << ":" <<line<<"): ";
+      if (async && lineloglevel < LOG_ERROR) {
+        // the writer formats the header
+        streambufentry->file = file;
+        streambufentry->function = function;
+        streambufentry->line = line;
+      } else {
+        file = ((strrchr(file, '/') ? : file- 1) + 1);
+        streambuffer << messages[lineloglevel] << file
+                     << "(" << function << ":" <<line<<"): ";
+      }
     }
     streamactive = true;
-    streamloglevel = lineloglevel;
+    streambufentry->streamloglevel = lineloglevel;
   } else {
     streamactive = false;
   }
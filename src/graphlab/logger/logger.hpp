@@ -42,6 +42,8 @@
 #define GRAPHLAB_LOG_LOG_HPP
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <vector>
 #include <cstdlib>
 #include <cassert>
 #include <cstring>
@@ -170,9 +172,35 @@
 #endif
 
 namespace logger_impl {
+/// A message waiting for the background writer of an asynchronous logger
+struct log_record {
+  int loglevel;
+  /// the header is formatted by the writer, unless file is NULL
+  const char* file;
+  const char* function;
+  int line;
+  std::string text;
+};
+
 struct streambuff_tls_entry {
   std::stringstream streambuffer;
   bool streamactive;
+  int streamloglevel;
+  /// the origin of the current stream when its header is formatted lazily
+  const char* file;
+  const char* function;
+  int line;
+  /// the messages of this thread not yet taken by the background writer
+  std::vector<log_record> pending;
+  size_t pending_bytes;
+  pthread_mutex_t pending_lock;
+
+  streambuff_tls_entry() : streamactive(false), streamloglevel(LOG_INFO),
+                           file(NULL), function(NULL), line(0),
+                           pending_bytes(0) {
+    pthread_mutex_init(&pending_lock, NULL);
+  }
+  ~streambuff_tls_entry() { pthread_mutex_destroy(&pending_lock); }
 };
 }
 
@@ -182,9 +210,21 @@ extern void __print_back_trace();
 /**
   logging class.
   This writes to a file, and/or the system console.
+
+  In asynchronous mode (see set_log_async()) the messages below LOG_ERROR
+  are appended to a buffer of the calling thread and written by a
+  background thread, so logging threads never wait on each other or on
+  the output. The header of streamed messages is also formatted by the
+  background thread. Messages keep their order within a thread, but the
+  messages of different threads may be written in a different order
+  than they were logged. Errors and fatal errors first write all the
+  buffered messages and are then written immediately.
 */
 class file_logger{
  public:
+  /** In asynchronous mode, the bytes a thread may have waiting for the
+      background writer. Further messages are dropped and counted. */
+  static const size_t MAX_PENDING_BYTES = 1024 * 1024;
   /** Default constructor. By default, log_to_console is on,
       there is no logger file, and logger level is set to LOG_EMPH
   */
@@ -220,6 +260,20 @@ class file_logger{
     return log_level;
   }
 
+  /** If async is true, messages are written by a background thread
+      (see file_logger). Also enabled by setting the environment
+      variable GRAPHLAB_LOG_ASYNC to 1. Turning it off writes all the
+      buffered messages. */
+  void set_log_async(bool async);
+
+  /// Returns true if messages are written by a background thread
+  bool get_log_async() const {
+    return async;
+  }
+
+  /// Writes all the messages buffered for the background writer
+  void flush();
+
   file_logger& start_stream(int lineloglevel,const char* file,const char* function, int line, bool do_start = true);
 
   template <typename T>
@@ -267,7 +321,7 @@ class file_logger{
         if (endltype(f) == endltype(std::endl)) {
           streambuffer << "\n";
           stream_flush();
-          if(streamloglevel == LOG_FATAL) {
+          if(streambufentry->streamloglevel == LOG_FATAL) {
             __print_back_trace();
             GRAPHLAB_LOGGER_FAIL_METHOD("LOG_FATAL encountered");
           }
@@ -313,24 +367,77 @@ class file_logger{
       std::stringstream& streambuffer = streambufentry->streambuffer;
 
       streambuffer.flush();
-      _lograw(streamloglevel,
-              streambuffer.str().c_str(),
-              (int)(streambuffer.str().length()));
+      const std::string& str = streambuffer.str();
+      if (async && streambufentry->streamloglevel < LOG_ERROR) {
+        enqueue(streambufentry, streambufentry->streamloglevel,
+                streambufentry->file, streambufentry->function,
+                streambufentry->line, str.c_str(), str.length());
+      } else if (streambufentry->file != NULL) {
+        // the stream started in asynchronous mode
+        if (async) flush();
+        logger_impl::log_record record;
+        record.loglevel = streambufentry->streamloglevel;
+        record.file = streambufentry->file;
+        record.function = streambufentry->function;
+        record.line = streambufentry->line;
+        record.text = str;
+        pthread_mutex_lock(&mut);
+        write_record(record);
+        pthread_mutex_unlock(&mut);
+      } else {
+        _lograw(streambufentry->streamloglevel, str.c_str(),
+                (int)(str.length()));
+      }
+      streambufentry->file = NULL;
       streambuffer.str("");
     }
   }
+
+  /** \internal Called when a thread exits: writes its buffered messages
+      and releases its stream buffer. */
+  void release_entry(logger_impl::streambuff_tls_entry* entry);
+
  private:
   std::ofstream fout;
   std::string log_file;
 
   pthread_key_t streambuffkey;
 
-  int streamloglevel;
+  /// serializes the writes to the file and the console
   pthread_mutex_t mut;
 
   bool log_to_console;
   int log_level;
 
+  // Asynchronous mode ---------------------------------------------------
+  volatile bool async;
+  bool writer_running;
+  volatile bool stop_writer;
+  pthread_t writer;
+  pthread_cond_t writer_cond;
+  /// protects entries
+  pthread_mutex_t entries_lock;
+  /// the stream buffers of all the threads
+  std::vector<logger_impl::streambuff_tls_entry*> entries;
+  /// the messages dropped since the last flush
+  size_t dropped;
+
+  /// Returns the stream buffer of the calling thread, creating it if needed
+  logger_impl::streambuff_tls_entry* get_entry();
+
+  /// Appends a message to the buffer of entry
+  void enqueue(logger_impl::streambuff_tls_entry* entry, int loglevel,
+               const char* file, const char* function, int line,
+               const char* buf, size_t len);
+
+  /// Writes a buffered message. mut must be held.
+  void write_record(const logger_impl::log_record& record);
+
+  /// Writes buf to the file and the console. mut must be held.
+  void write_unlocked(int loglevel, const char* buf, int len);
+
+  static void* writer_main(void* logger);
+
 };
 
 
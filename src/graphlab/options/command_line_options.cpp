@@ -21,6 +21,8 @@
  */
 #include <graphlab/options/command_line_options.hpp>
 #include <graphlab/scheduler/scheduler_list.hpp>
+#include <graphlab/parallel/numa_topology.hpp>
+#include <graphlab/parallel/fiber_profiler.hpp>
 
 
 namespace boost {  
@@ -74,6 +76,8 @@ static const char* graph_help_string =
     namespace boost_po = boost::program_options;
     
     size_t ncpus(get_ncpus());
+    bool numa(numa_topology::enabled());
+    std::string fiber_profile;
     std::string engine_opts_string;
     std::string schedulertype(get_scheduler_type());
     std::string scheduler_opts_string = "";
@@ -86,6 +90,16 @@ static const char* graph_help_string =
         boost_po::value<size_t>(&(ncpus))->
         default_value(ncpus),
         "Number of cpus to use per machine. Defaults to (#cores - 2)")
+        ("numa",
+        boost_po::value<bool>(&(numa))->
+        default_value(numa)->implicit_value(true),
+        "Pin the worker threads to the cores socket by socket and give each "
+        "NUMA node its own range of vertices. See the numa_memory graph option.")
+        ("fiber_profile",
+        boost_po::value<std::string>(&(fiber_profile))->
+        default_value(fiber_profile),
+        "Sample the fibers and write the profile at exit to "
+        "[prefix].[pid].folded (for flamegraph.pl) and [prefix].[pid].txt")
         ("scheduler",
           boost_po::value<std::string>(&(schedulertype))->
           default_value(schedulertype),
@@ -169,6 +183,8 @@ static const char* graph_help_string =
       return false;
     } 
     set_ncpus(ncpus);
+    numa_topology::set_enabled(numa);
+    if (!fiber_profile.empty()) fiber_profiler::start(fiber_profile);
 
     set_scheduler_type(schedulertype);
 
@@ -21,9 +21,17 @@
  */
 
 
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
 #include <boost/bind.hpp>
 #include <graphlab/util/random.hpp>
 #include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/parallel/numa_topology.hpp>
+#include <graphlab/parallel/fiber_profiler.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/memory_accounting.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/macros_def.hpp>
@@ -47,7 +55,9 @@ fiber_control::fiber_control(size_t nworkers,
     :nworkers(nworkers),
     affinity_base(affinity_base),
     stop_workers(false),
-    flsdeleter(NULL) {
+    work_stealing(true),
+    flsdeleter(NULL),
+    max_pooled_fibers(FIBER_POOL_SIZE) {
   // initialize the thread local storage keys
   if (!tls_created) {
     pthread_key_create(&tlskey, fiber_control::tls_deleter);
@@ -69,9 +79,13 @@ fiber_control::fiber_control(size_t nworkers,
     workers.launch(boost::bind(&fiber_control::worker_init, this, i), 
                    affinity_base + i);
   }
+  memory_source_id = memory_accounting::add_source(
+      memory_accounting::FIBER_STACKS,
+      boost::bind(&fiber_control::total_stack_bytes, this));
 }
 
 fiber_control::~fiber_control() {
+  memory_accounting::remove_source(memory_source_id);
   join();
   stop_workers = true;
   for (size_t i = 0;i < nworkers; ++i) {
@@ -83,12 +97,65 @@ fiber_control::~fiber_control() {
   }
   workers.join();
 
-
+  std::map<size_t, std::vector<fiber*> >::iterator iter = fiber_pool.begin();
+  for (; iter != fiber_pool.end(); ++iter) {
+    for (size_t i = 0; i < iter->second.size(); ++i) free_fiber(iter->second[i]);
+  }
+  fiber_pool.clear();
 
   pthread_key_delete(tlskey);
 }
 
 
+fiber_control::fiber* fiber_control::allocate_fiber(size_t stacksize) {
+  const size_t pagesize = getpagesize();
+  stacksize = (stacksize + pagesize - 1) / pagesize * pagesize;
+  fiber_pool_lock.lock();
+  std::vector<fiber*>& pool = fiber_pool[stacksize];
+  if (!pool.empty()) {
+    fiber* fib = pool.back();
+    pool.pop_back();
+    fiber_pool_lock.unlock();
+    return fib;
+  }
+  fiber_pool_lock.unlock();
+  // the stack is preceded by a guard page
+  char* base = (char*)mmap(NULL, stacksize + pagesize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED) {
+    logstream(LOG_FATAL) << "Unable to allocate a fiber stack of " << stacksize
+                         << " bytes: " << strerror(errno) << std::endl;
+  }
+  if (mprotect(base, pagesize, PROT_NONE) != 0) {
+    logstream(LOG_FATAL) << "Unable to protect the fiber stack guard page: "
+                         << strerror(errno) << std::endl;
+  }
+  mapped_stack_bytes.inc(stacksize + pagesize);
+  fiber* fib = new fiber;
+  fib->stack = base + pagesize;
+  fib->stacksize = stacksize;
+  return fib;
+}
+
+void fiber_control::release_fiber(fiber* fib) {
+  fiber_pool_lock.lock();
+  std::vector<fiber*>& pool = fiber_pool[fib->stacksize];
+  if (pool.size() < max_pooled_fibers) {
+    pool.push_back(fib);
+    fib = NULL;
+  }
+  fiber_pool_lock.unlock();
+  if (fib != NULL) free_fiber(fib);
+}
+
+void fiber_control::free_fiber(fiber* fib) {
+  const size_t pagesize = getpagesize();
+  munmap((char*)fib->stack - pagesize, fib->stacksize + pagesize);
+  mapped_stack_bytes.dec(fib->stacksize + pagesize);
+  delete fib;
+}
+
+
 void fiber_control::tls_deleter(void* f) {
   fiber_control::tls* t = (fiber_control::tls*)(f);
   delete t;
@@ -122,6 +189,8 @@ void fiber_control::active_queue_insert_tail(size_t workerid, fiber_control::fib
       schedule[workerid].active_lock.lock();
       schedule[workerid].active_cond.signal();
       schedule[workerid].active_lock.unlock();
+    } else {
+      wake_idle_worker(value);
     }
   }
 }
@@ -136,6 +205,22 @@ void fiber_control::active_queue_insert_head(size_t workerid, fiber_control::fib
       schedule[workerid].active_lock.lock();
       schedule[workerid].active_cond.signal();
       schedule[workerid].active_lock.unlock();
+    } else {
+      wake_idle_worker(value);
+    }
+  }
+}
+
+void fiber_control::wake_idle_worker(fiber_control::fiber* value) {
+  if (!work_stealing || idle_workers.value == 0) return;
+  const size_t start = wake_counter.inc();
+  for (size_t i = 0; i < nworkers; ++i) {
+    const size_t w = (start + i) % nworkers;
+    if (schedule[w].waiting && value->affinity.get(w)) {
+      schedule[w].active_lock.lock();
+      schedule[w].active_cond.signal();
+      schedule[w].active_lock.unlock();
+      return;
     }
   }
 }
@@ -166,16 +251,57 @@ fiber_control::fiber* fiber_control::try_pop_queue(inplace_lf_queue2<fiber>& lfq
 fiber_control::fiber* fiber_control::active_queue_remove(size_t workerid) {
   fiber_control::fiber* ret = NULL;
   thread_schedule& curts = schedule[workerid];
+  curts.queue_lock.lock();
   ret = try_pop_queue(*curts.priority_queue, curts.popped_priority_queue);
   if (ret == NULL) {
     ret = try_pop_queue(*curts.affinity_queue , curts.popped_affinity_queue);
   }
+  curts.queue_lock.unlock();
+  if (ret == NULL && work_stealing && nworkers > 1) {
+    ret = steal_fiber(workerid);
+  }
   if (ret) {
     // printf("%ld: Running %ld\n", get_worker_id(), ret->id);
   }
   return ret;
 }
 
+fiber_control::fiber* fiber_control::try_steal_queue(size_t workerid,
+                                                     inplace_lf_queue2<fiber>& lfqueue,
+                                                     fiber*& popped_queue) {
+  if (popped_queue == NULL) popped_queue = lfqueue.dequeue_all();
+  // only the head is considered, so that the order of the queue is kept
+  if (popped_queue == NULL || !popped_queue->affinity.get(workerid)) return NULL;
+  return try_pop_queue(lfqueue, popped_queue);
+}
+
+fiber_control::fiber* fiber_control::steal_fiber(size_t workerid) {
+  const size_t start = graphlab::random::fast_uniform<size_t>(0, nworkers - 1);
+  for (size_t i = 0; i < nworkers; ++i) {
+    const size_t victim = (start + i) % nworkers;
+    if (victim == workerid) continue;
+    thread_schedule& ts = schedule[victim];
+    // skip empty workers without touching their lock
+    if (ts.popped_priority_queue == NULL && ts.priority_queue->empty() &&
+        ts.popped_affinity_queue == NULL && ts.affinity_queue->empty()) {
+      continue;
+    }
+    if (!ts.queue_lock.try_lock()) continue;
+    fiber* ret = try_steal_queue(workerid, *ts.priority_queue,
+                                 ts.popped_priority_queue);
+    if (ret == NULL) {
+      ret = try_steal_queue(workerid, *ts.affinity_queue,
+                            ts.popped_affinity_queue);
+    }
+    ts.queue_lock.unlock();
+    if (ret != NULL) {
+      schedule[workerid].steals.inc();
+      return ret;
+    }
+  }
+  return NULL;
+}
+
 void fiber_control::exit() {
   distributed_control* dc = distributed_control::get_instance();
   if (dc) dc->flush();
@@ -210,6 +336,7 @@ void fiber_control::worker_init(size_t workerid) {
   t->garbage = NULL;
   t->workerid = workerid;
   t->parent = this;
+  fiber_profiler::register_worker(workerid);
 
   schedule[workerid].waiting = true;
   schedule[workerid].active_lock.lock();
@@ -233,16 +360,20 @@ void fiber_control::worker_init(size_t workerid) {
       schedule[workerid].active_lock.lock();
     } else {
       // if there is no fiber. wait.
-      schedule[workerid].active_cond.wait(schedule[workerid].active_lock);
+      idle_workers.inc();
+      if (work_stealing) {
+        // work queued on a busy worker may not wake us up
+        schedule[workerid].active_cond.timedwait_ms(schedule[workerid].active_lock,
+                                                    10);
+      } else {
+        schedule[workerid].active_cond.wait(schedule[workerid].active_lock);
+      }
+      idle_workers.dec();
     }
   }
   schedule[workerid].active_lock.unlock();
 }
 
-struct trampoline_args {
-  boost::function<void(void)> fn;
-};
-
 // the trampoline to call the user function. This function never returns
 void fiber_control::trampoline(intptr_t _args) {
   // we may have launched to here by switching in from another fiber.
@@ -251,12 +382,14 @@ void fiber_control::trampoline(intptr_t _args) {
   if (t->prev_fiber) t->parent->reschedule_fiber(t->workerid, t->prev_fiber);
   t->prev_fiber = NULL;
 
-  trampoline_args* args = reinterpret_cast<trampoline_args*>(_args);
+  fiber* fib = reinterpret_cast<fiber*>(_args);
+  if (fiber_profiler::active()) profile_switch_in(fib);
   try {
-    args->fn();
+    fib->fn();
   } catch (...) {
   }
-  delete args;
+  // exit() does not return, so release what the function holds now
+  fib->fn = boost::function<void(void)>();
   fiber_control::exit();
 }
 
@@ -269,11 +402,11 @@ size_t fiber_control::launch(boost::function<void(void)> fn,
   // make sure there is always a worker I can work on
   ASSERT_LT(b, nworkers);
 
-  // allocate a stack
-  fiber* fib = new fiber;
+  // get a fiber and a stack from the pool
+  fiber* fib = allocate_fiber(stacksize);
   fib->parent = this;
-  fib->stack = malloc(stacksize);
   fib->id = fiber_id_counter.inc();
+  fib->affinity_array.clear();
   foreach(size_t b, affinity) {
     if (b < nworkers) fib->affinity_array.push_back((unsigned char)b);
     else break;
@@ -287,13 +420,16 @@ size_t fiber_control::launch(boost::function<void(void)> fn,
   fib->terminate = false;
   fib->descheduled = false;
   fib->scheduleable = true;
+  fib->priority = false;
+  fib->label = NULL;
+  fib->run_begin = 0;
+  fib->wait_begin = 0;
   // construct the initial context
-  trampoline_args* args = new trampoline_args;
-  args->fn = fn;
-  fib->initial_trampoline_args = (intptr_t)(args);
+  fib->fn = fn;
+  fib->initial_trampoline_args = (intptr_t)(fib);
   // stack grows downwards.
-  fib->context = boost::context::make_fcontext((char*)fib->stack + stacksize,
-                                               stacksize,
+  fib->context = boost::context::make_fcontext((char*)fib->stack + fib->stacksize,
+                                               fib->stacksize,
                                                trampoline);
   fibers_active.inc();
 
@@ -339,6 +475,7 @@ void fiber_control::yield_to(fiber* next_fib) {
     t->prev_fiber = t->cur_fiber;
     t->cur_fiber = next_fib;
     if (t->prev_fiber != NULL) {
+      if (fiber_profiler::active()) profile_switch_out(t->prev_fiber);
       // context switch to fib outside the lock
       boost::context::jump_fcontext(t->prev_fiber->context,
                                     t->cur_fiber->context,
@@ -362,6 +499,7 @@ void fiber_control::yield_to(fiber* next_fib) {
       // (as identifibed by cur_fiber = NULL)
       t->prev_fiber = t->cur_fiber;
       t->cur_fiber = NULL;
+      if (fiber_profiler::active()) profile_switch_out(t->prev_fiber);
       boost::context::jump_fcontext(t->prev_fiber->context,
                                     &t->base_context,
                                     0);
@@ -373,6 +511,7 @@ void fiber_control::yield_to(fiber* next_fib) {
   }
   // reread the tls pointer because we may have woken up in a different thread
   t = get_tls_ptr();
+  if (fiber_profiler::active()) profile_switch_in(t->cur_fiber);
   // reschedule the previous fiber
   if (t->prev_fiber) reschedule_fiber(t->workerid, t->prev_fiber);
   t->prev_fiber = NULL;
@@ -403,12 +542,12 @@ void fiber_control::reschedule_fiber(size_t workerid, fiber* fib) {
     fib->lock.unlock();
   } else if (fib->terminate) {
     fib->lock.unlock();
-    // previous fiber is dead. destroy it
-    free(fib->stack);
+    // previous fiber is dead. return it to the pool
     //VALGRIND_STACK_DEREGISTER(fib->stack);
     // delete the fiber local storage if any
     if (fib->fls && flsdeleter) flsdeleter(fib->fls);
-    delete fib;
+    fib->fls = NULL;
+    release_fiber(fib);
     // if we are out of threads, signal the join
     if (fibers_active.dec() == 0) {
       join_lock.lock();
@@ -433,6 +572,36 @@ void fiber_control::yield() {
 }
 
 
+void fiber_control::profile_switch_out(fiber* fib) {
+  const unsigned long long now = rdtsc();
+  const bool waiting = fib->descheduled;
+  if (waiting) fib->wait_begin = now;
+  fiber_profiler::switch_out(fib->label,
+                             fib->run_begin == 0 ? 0 : now - fib->run_begin,
+                             waiting);
+}
+
+void fiber_control::profile_switch_in(fiber* fib) {
+  if (fib == NULL) {
+    fiber_profiler::switch_in(NULL, 0);
+    return;
+  }
+  const unsigned long long now = rdtsc();
+  fib->run_begin = now;
+  unsigned long long wait_ticks = 0;
+  if (fib->wait_begin != 0) {
+    wait_ticks = now - fib->wait_begin;
+    fib->wait_begin = 0;
+  }
+  fiber_profiler::switch_in(fib->label, wait_ticks);
+}
+
+void fiber_control::set_fiber_label(const char* label) {
+  fiber* fib = get_active_fiber();
+  if (fib != NULL) fib->label = label;
+  if (fiber_profiler::active()) fiber_profiler::switch_in(label, 0);
+}
+
 void fiber_control::fast_yield() {
   yield();
 }
@@ -486,6 +655,13 @@ bool fiber_control::worker_has_fibers_on_queue() {
           !parentgroup->schedule[workerid].affinity_queue->empty();
 }
 
+size_t fiber_control::worker_numa_node(size_t workerid) {
+  if (!numa_topology::enabled()) return 0;
+  const numa_topology& topology = numa_topology::get();
+  return topology.node_of_cpu(
+      topology.placement_cpu((affinity_base + workerid) % thread::cpu_count()));
+}
+
 size_t fiber_control::get_worker_id() {
   fiber_control::tls* tls = get_tls_ptr();
   if (tls != NULL) return tls->workerid;
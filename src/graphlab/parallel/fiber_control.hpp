@@ -26,6 +26,8 @@
 
 #include <stdint.h>
 #include <cstdlib>
+#include <map>
+#include <vector>
 #include <boost/context/all.hpp>
 #include <boost/function.hpp>
 #include <boost/lockfree/queue.hpp>
@@ -33,10 +35,23 @@
 #include <graphlab/util/inplace_lf_queue2.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/atomic.hpp>
+/**
+ * The default number of terminated fibers of each stack size which
+ * fiber_control keeps, with their stacks, to be reused by launch().
+ */
+#ifndef FIBER_POOL_SIZE
+#define FIBER_POOL_SIZE 65536
+#endif
+
 namespace graphlab {
 
 /**
  * The master controller for the user mode threading system
+ *
+ * Fiber stacks are mapped with mmap() with an inaccessible guard page
+ * below them, so a stack overrun faults instead of corrupting the
+ * memory next to the stack. Terminated fibers and their stacks are
+ * pooled and reused by later launches.
  */
 class fiber_control {
  public:
@@ -48,13 +63,15 @@ class fiber_control {
     simple_spinlock lock;
     fiber_control* parent;
     boost::context::fcontext_t* context;
-    void* stack;
+    void* stack;        // the lowest address of the stack, above the guard page
+    size_t stacksize;   // the usable size of the stack
     size_t id;
     affinity_type affinity;
     std::vector<unsigned char> affinity_array;
     void* fls; // fiber local storage
     fiber* next;
     intptr_t initial_trampoline_args;
+    boost::function<void (void)> fn; // the function the fiber runs
     pthread_mutex_t* deschedule_lock; // if descheduled is set, we will
                                       // atomically deschedule and unlock
                                       // this mutex
@@ -73,6 +90,10 @@ class fiber_control {
                       // lock must be acquired for this to be modified.
     bool priority;  // flag. If set, rescheduling this fiber
                     // will cause it to be placed at the head of the queue
+    const char* label; // name reported by the fiber_profiler. May be NULL
+    unsigned long long run_begin; // profiling: when the fiber was switched in
+    unsigned long long wait_begin; // profiling: when it was descheduled. 0
+                                   // if it was not
   };
 
 
@@ -86,6 +107,12 @@ class fiber_control {
   conditional join_cond;
 
   bool stop_workers;
+  /// If set, workers with empty queues take fibers from other workers
+  bool work_stealing;
+  /// The number of workers waiting for work
+  atomic<size_t> idle_workers;
+  /// Where the next search for an idle worker starts
+  atomic<size_t> wake_counter;
 
   // The scheduler is a simple queue. One for each worker
   struct thread_schedule {
@@ -94,6 +121,11 @@ class fiber_control {
     conditional active_cond;
     volatile bool waiting;
     size_t nwaiting;
+    // protects the consumer side of both queues, shared by the worker
+    // and the workers stealing from it
+    simple_spinlock queue_lock;
+    // the number of fibers this worker stole from the others
+    atomic<size_t> steals;
     // a queue of fibers to evaluate before those in the thread_queue
     inplace_lf_queue2<fiber>* affinity_queue;
     fiber* popped_affinity_queue;
@@ -111,6 +143,14 @@ class fiber_control {
   void active_queue_insert_tail(size_t workerid, fiber* value);
   void active_queue_insert_tail(fiber* value);
   fiber* active_queue_remove(size_t workerid);
+  /// Takes a fiber which may run on workerid from another worker
+  fiber* steal_fiber(size_t workerid);
+  /// Takes the head of a queue of another worker if it may run on workerid
+  fiber* try_steal_queue(size_t workerid,
+                         inplace_lf_queue2<fiber>& lfqueue,
+                         fiber*& popped_queue);
+  /// Wakes up an idle worker which can steal the fiber
+  void wake_idle_worker(fiber* value);
 
   // a thread local storage for the worker to point to a fiber
   static bool tls_created;
@@ -140,10 +180,33 @@ class fiber_control {
 
   void reschedule_fiber(size_t workerid, fiber* pfib);
   void yield_to(fiber* next_fib);
+  /// fiber_profiler bookkeeping for a fiber which stops running
+  static void profile_switch_out(fiber* fib);
+  /// fiber_profiler bookkeeping for a fiber (or NULL) which starts running
+  static void profile_switch_in(fiber* fib);
   static void trampoline(intptr_t _args);
 
   void (*flsdeleter)(void*);
 
+  /**
+   * Terminated fibers kept with their stacks for reuse, by stack size.
+   * A fiber is only freed when the pool of its size is full.
+   */
+  std::map<size_t, std::vector<fiber*> > fiber_pool;
+  simple_spinlock fiber_pool_lock;
+  size_t max_pooled_fibers;
+
+  /// Gets a fiber with a stack of at least stacksize bytes
+  fiber* allocate_fiber(size_t stacksize);
+  /// The bytes of all the stacks mapped by allocate_fiber, with guard pages
+  atomic<size_t> mapped_stack_bytes;
+  /// The id of the memory_accounting source of the stacks
+  size_t memory_source_id;
+  /// Returns a terminated fiber to the pool
+  void release_fiber(fiber* fib);
+  /// Unmaps the stack and deletes the fiber
+  void free_fiber(fiber* fib);
+
   size_t pick_fiber_worker(fiber* fib);
 
   // delete copy constructor
@@ -158,6 +221,7 @@ class fiber_control {
 
   /** the basic launch function
    * Returns a fiber ID. IDs are not sequential.
+   * The stack size is rounded up to a multiple of the page size.
    * \note The ID is really a pointer to a fiber_control::fiber object.
    */
   size_t launch(boost::function<void (void)> fn, 
@@ -178,6 +242,55 @@ class fiber_control {
     return nworkers;
   }
 
+  /**
+   * Sets the number of terminated fibers of each stack size kept for
+   * reuse. Defaults to FIBER_POOL_SIZE. Setting it to 0 frees the
+   * stacks on termination.
+   */
+  void set_max_pooled_fibers(size_t n) {
+    max_pooled_fibers = n;
+  }
+
+  /**
+   * Enables or disables work stealing. With work stealing, a worker
+   * whose queues are empty takes a fiber from the queues of another
+   * worker, as long as the affinity of the fiber contains the worker.
+   * Enabled by default.
+   */
+  void set_work_stealing(bool enabled) {
+    work_stealing = enabled;
+  }
+
+  /**
+   * Returns the number of fibers the worker stole from other workers
+   */
+  size_t num_steals(size_t workerid) {
+    return schedule[workerid].steals.value;
+  }
+
+  /**
+   * Returns the bytes of all the fiber stacks currently mapped,
+   * including those of the pooled fibers.
+   */
+  size_t total_stack_bytes() const {
+    return mapped_stack_bytes.value;
+  }
+
+  /**
+   * Returns the number of fibers stolen by all workers
+   */
+  size_t total_steals() {
+    size_t ret = 0;
+    for (size_t i = 0; i < nworkers; ++i) ret += schedule[i].steals.value;
+    return ret;
+  }
+
+  /**
+   * Returns the NUMA node of the CPU the worker is pinned to. Always 0
+   * unless NUMA placement is enabled (see numa_topology).
+   */
+  size_t worker_numa_node(size_t workerid);
+
   /**
    * Returns the number of threads that have yet to join
    */
@@ -225,6 +338,12 @@ class fiber_control {
    */
   static void yield();
 
+  /**
+   * Names the calling fiber in the fiber_profiler output. The string
+   * must outlive the profile (a literal).
+   */
+  static void set_fiber_label(const char* label);
+
 
   /**
    * Yields to another fiber of the same affinity.
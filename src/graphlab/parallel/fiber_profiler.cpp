@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <signal.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <cxxabi.h>
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/fiber_profiler.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+
+volatile bool fiber_profiler::profiling = false;
+
+namespace {
+  const size_t MAX_WORKERS = 1024;
+  const size_t MAX_DEPTH = 32;
+  // frames of the signal handler itself
+  const size_t SKIP_FRAMES = 2;
+  // per worker sample ring, drained every 100ms
+  const size_t RING_SIZE = 1024;
+
+  struct sample {
+    const char* phase;
+    const char* label;
+    int depth;
+    void* pcs[MAX_DEPTH];
+  };
+
+  struct fiber_stats {
+    unsigned long long run_ticks;
+    size_t switches;
+    size_t waits;
+    unsigned long long wait_ticks;
+    fiber_stats(): run_ticks(0), switches(0), waits(0), wait_ticks(0) { }
+  };
+
+  typedef std::pair<const char*, const char*> phase_label;
+
+  struct worker_profile {
+    std::vector<sample> ring;
+    // written by the signal handler
+    volatile size_t head;
+    // written by the drain thread
+    volatile size_t tail;
+    volatile size_t dropped;
+    std::map<phase_label, fiber_stats> stats;
+    worker_profile(): ring(RING_SIZE), head(0), tail(0), dropped(0) { }
+  };
+
+  __thread size_t tls_workerid = (size_t)(-1);
+  // the label of the fiber running on this worker, read by the handler
+  __thread const char* volatile tls_label = NULL;
+
+  worker_profile* volatile workers[MAX_WORKERS];
+  simple_spinlock workers_lock;
+  const char* volatile current_phase = NULL;
+  std::string profile_prefix;
+  double ticks_per_second = 1;
+  bool exit_handler_registered = false;
+
+  // samples keyed by [phase, label, outermost pc, ..., innermost pc]
+  std::map<std::vector<void*>, size_t> folded;
+  size_t samples_outside_workers = 0;
+  mutex folded_lock;
+  thread drain_thread;
+
+  worker_profile* get_worker_profile() {
+    const size_t w = tls_workerid;
+    if (w >= MAX_WORKERS) return NULL;
+    if (workers[w] == NULL) {
+      workers_lock.lock();
+      if (workers[w] == NULL) workers[w] = new worker_profile;
+      workers_lock.unlock();
+    }
+    return workers[w];
+  }
+
+  void sigprof_handler(int) {
+    const size_t w = tls_workerid;
+    worker_profile* p = (w < MAX_WORKERS) ? workers[w] : NULL;
+    if (p == NULL) {
+      __sync_fetch_and_add(&samples_outside_workers, 1);
+      return;
+    }
+    if (p->head - p->tail >= RING_SIZE) {
+      ++p->dropped;
+      return;
+    }
+    sample& s = p->ring[p->head % RING_SIZE];
+    s.phase = current_phase;
+    s.label = tls_label;
+    s.depth = backtrace(s.pcs, MAX_DEPTH);
+    __sync_synchronize();
+    ++p->head;
+  }
+
+  void drain_samples() {
+    folded_lock.lock();
+    for (size_t w = 0; w < MAX_WORKERS; ++w) {
+      worker_profile* p = workers[w];
+      if (p == NULL) continue;
+      const size_t head = p->head;
+      __sync_synchronize();
+      for (size_t i = p->tail; i < head; ++i) {
+        const sample& s = p->ring[i % RING_SIZE];
+        std::vector<void*> key;
+        key.push_back((void*)s.phase);
+        key.push_back((void*)s.label);
+        for (int j = s.depth - 1; j >= (int)SKIP_FRAMES; --j) {
+          key.push_back(s.pcs[j]);
+        }
+        ++folded[key];
+      }
+      __sync_synchronize();
+      p->tail = head;
+    }
+    folded_lock.unlock();
+  }
+
+  void drain_loop() {
+    while (fiber_profiler::active()) {
+      timer::sleep_ms(100);
+      drain_samples();
+    }
+  }
+
+  std::string symbol_name(void* pc, std::map<void*, std::string>& cache) {
+    std::map<void*, std::string>::const_iterator iter = cache.find(pc);
+    if (iter != cache.end()) return iter->second;
+    std::string name;
+    Dl_info info;
+    // pc is a return address. Look up the call instruction.
+    const bool found = dladdr((char*)pc - 1, &info);
+    if (found && info.dli_sname != NULL) {
+      int status = 0;
+      char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+      name = (status == 0 && demangled != NULL) ? demangled : info.dli_sname;
+      free(demangled);
+    } else if (found && info.dli_fname != NULL) {
+      // no symbol: name the frame by its library
+      const char* base = strrchr(info.dli_fname, '/');
+      name = std::string("[") + (base ? base + 1 : info.dli_fname) + "]";
+    } else {
+      std::stringstream strm;
+      strm << pc;
+      name = strm.str();
+    }
+    // ';' separates the frames of a folded stack
+    std::replace(name.begin(), name.end(), ';', ':');
+    cache[pc] = name;
+    return name;
+  }
+
+  const char* name_or(const char* name, const char* def) {
+    return name == NULL ? def : name;
+  }
+
+  void dump_at_exit() {
+    fiber_profiler::stop();
+    fiber_profiler::dump();
+  }
+} // anonymous namespace
+
+
+void fiber_profiler::start(const std::string& prefix, size_t hz) {
+  if (profiling) return;
+  ASSERT_GT(hz, 0);
+  profile_prefix = prefix;
+  ticks_per_second = estimate_ticks_per_second();
+  // the first call of backtrace may allocate. Do it outside the handler
+  void* pcs[MAX_DEPTH];
+  backtrace(pcs, MAX_DEPTH);
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sigprof_handler;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, NULL);
+
+  profiling = true;
+  drain_thread.launch(drain_loop);
+
+  struct itimerval interval;
+  interval.it_interval.tv_sec = 0;
+  interval.it_interval.tv_usec = std::max<size_t>(1000000 / hz, 1);
+  interval.it_value = interval.it_interval;
+  setitimer(ITIMER_PROF, &interval, NULL);
+
+  if (!prefix.empty() && !exit_handler_registered) {
+    exit_handler_registered = true;
+    atexit(dump_at_exit);
+  }
+  logstream(LOG_INFO) << "Fiber profiler sampling at " << hz << " Hz" << std::endl;
+}
+
+
+void fiber_profiler::stop() {
+  if (!profiling) return;
+  struct itimerval interval;
+  memset(&interval, 0, sizeof(interval));
+  setitimer(ITIMER_PROF, &interval, NULL);
+  profiling = false;
+  drain_thread.join();
+  drain_samples();
+}
+
+
+void fiber_profiler::set_phase(const char* phase) {
+  current_phase = phase;
+}
+
+
+void fiber_profiler::register_worker(size_t workerid) {
+  tls_workerid = workerid;
+}
+
+
+void fiber_profiler::switch_out(const char* label,
+                                unsigned long long run_ticks,
+                                bool waiting) {
+  worker_profile* p = get_worker_profile();
+  if (p == NULL) return;
+  fiber_stats& s = p->stats[phase_label(current_phase, label)];
+  s.run_ticks += run_ticks;
+  ++s.switches;
+  if (waiting) ++s.waits;
+}
+
+
+void fiber_profiler::switch_in(const char* label,
+                               unsigned long long wait_ticks) {
+  tls_label = label;
+  worker_profile* p = get_worker_profile();
+  if (p == NULL || wait_ticks == 0) return;
+  p->stats[phase_label(current_phase, label)].wait_ticks += wait_ticks;
+}
+
+
+void fiber_profiler::write_folded(std::ostream& out) {
+  std::map<void*, std::string> symbols;
+  // different pcs in the same functions fold into one stack
+  std::map<std::string, size_t> stacks;
+  folded_lock.lock();
+  std::map<std::vector<void*>, size_t>::const_iterator iter = folded.begin();
+  for (; iter != folded.end(); ++iter) {
+    const std::vector<void*>& key = iter->first;
+    std::string stack = std::string(name_or((const char*)key[0], "no_phase"))
+        + ";" + name_or((const char*)key[1], "scheduler");
+    for (size_t i = 2; i < key.size(); ++i) {
+      stack += ";" + symbol_name(key[i], symbols);
+    }
+    stacks[stack] += iter->second;
+  }
+  folded_lock.unlock();
+  std::map<std::string, size_t>::const_iterator siter = stacks.begin();
+  for (; siter != stacks.end(); ++siter) {
+    out << siter->first << " " << siter->second << "\n";
+  }
+}
+
+
+void fiber_profiler::write_summary(std::ostream& out) {
+  // merge the workers
+  std::map<phase_label, fiber_stats> total;
+  std::map<phase_label, size_t> samples;
+  size_t dropped = 0;
+  for (size_t w = 0; w < MAX_WORKERS; ++w) {
+    worker_profile* p = workers[w];
+    if (p == NULL) continue;
+    dropped += p->dropped;
+    std::map<phase_label, fiber_stats>::const_iterator iter = p->stats.begin();
+    for (; iter != p->stats.end(); ++iter) {
+      fiber_stats& s = total[iter->first];
+      s.run_ticks += iter->second.run_ticks;
+      s.switches += iter->second.switches;
+      s.waits += iter->second.waits;
+      s.wait_ticks += iter->second.wait_ticks;
+    }
+  }
+  folded_lock.lock();
+  std::map<std::vector<void*>, size_t>::const_iterator fiter = folded.begin();
+  for (; fiter != folded.end(); ++fiter) {
+    samples[phase_label((const char*)fiter->first[0],
+                        (const char*)fiter->first[1])] += fiter->second;
+  }
+  folded_lock.unlock();
+
+  out << std::left << std::setw(24) << "phase" << std::setw(48) << "fiber"
+      << std::right << std::setw(12) << "run(s)" << std::setw(12) << "switches"
+      << std::setw(12) << "waits" << std::setw(14) << "mean wait(us)"
+      << std::setw(10) << "samples" << "\n";
+  std::map<phase_label, fiber_stats>::const_iterator iter = total.begin();
+  for (; iter != total.end(); ++iter) {
+    const fiber_stats& s = iter->second;
+    const double mean_wait = s.waits == 0 ? 0 :
+        s.wait_ticks / ticks_per_second / s.waits * 1E6;
+    out << std::left << std::setw(24) << name_or(iter->first.first, "no_phase")
+        << std::setw(48) << name_or(iter->first.second, "fiber")
+        << std::right << std::setw(12) << s.run_ticks / ticks_per_second
+        << std::setw(12) << s.switches << std::setw(12) << s.waits
+        << std::setw(14) << mean_wait
+        << std::setw(10) << samples[iter->first] << "\n";
+  }
+  out << "Samples dropped: " << dropped
+      << ", outside fiber workers: " << samples_outside_workers << "\n";
+}
+
+
+void fiber_profiler::dump() {
+  if (profile_prefix.empty()) return;
+  std::stringstream strm;
+  strm << profile_prefix << "." << getpid();
+  std::ofstream folded_file((strm.str() + ".folded").c_str());
+  write_folded(folded_file);
+  std::ofstream summary_file((strm.str() + ".txt").c_str());
+  write_summary(summary_file);
+  logstream(LOG_INFO) << "Fiber profile written to " << strm.str()
+                      << ".folded and " << strm.str() << ".txt" << std::endl;
+}
+
+} // namespace graphlab
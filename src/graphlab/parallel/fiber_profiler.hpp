@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_FIBER_PROFILER_HPP
+#define GRAPHLAB_FIBER_PROFILER_HPP
+
+#include <string>
+#include <iostream>
+
+namespace graphlab {
+
+/**
+ * \ingroup threading
+ * A sampling profiler which understands fibers.
+ *
+ * External profilers unwind through the boost::context stack switches
+ * of fiber_control badly. Instead, when started (start(), or the
+ * --fiber_profile command line option), a SIGPROF timer samples the
+ * stack of whichever fiber is running on the interrupted worker, and the
+ * fiber scheduler records for every fiber the time it ran, the number of
+ * context switches, and the time it spent descheduled.
+ *
+ * Everything is aggregated per engine phase (set_phase(), set by the
+ * engines) and per fiber label (fiber_control::set_fiber_label()).
+ * write_folded() writes the samples as folded stacks
+ * (phase;label;outer;...;inner count) for flamegraph.pl, and
+ * write_summary() a table of the scheduler statistics.
+ */
+class fiber_profiler {
+ public:
+  /**
+   * Starts profiling at hz samples per second of CPU time. If prefix
+   * is not empty, the profile is written at exit to prefix.PID.folded
+   * and prefix.PID.txt.
+   */
+  static void start(const std::string& prefix = "", size_t hz = 97);
+
+  /// Stops sampling. The collected profile is kept.
+  static void stop();
+
+  /// True while profiling
+  static bool active() { return profiling; }
+
+  /**
+   * Sets the engine phase the samples are attributed to. The string
+   * must outlive the profile (a literal). NULL clears the phase.
+   */
+  static void set_phase(const char* phase);
+
+  /// Writes the samples as folded stacks
+  static void write_folded(std::ostream& out);
+
+  /// Writes the per phase and fiber label scheduler statistics
+  static void write_summary(std::ostream& out);
+
+  /// Writes both files for the prefix passed to start()
+  static void dump();
+
+  /// \internal Called by each fiber_control worker thread when it starts
+  static void register_worker(size_t workerid);
+
+  /**
+   * \internal Called by fiber_control when a fiber stops running after
+   * running for run_ticks. waiting is set if it was descheduled.
+   */
+  static void switch_out(const char* label,
+                         unsigned long long run_ticks,
+                         bool waiting);
+
+  /**
+   * \internal Called by fiber_control when a fiber (NULL for the worker's
+   * own context) starts running. wait_ticks is the time it was
+   * descheduled, or 0.
+   */
+  static void switch_in(const char* label, unsigned long long wait_ticks);
+
+ private:
+  static volatile bool profiling;
+};
+
+} // namespace graphlab
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_GUIDED_CHUNK_DISPENSER_HPP
+#define GRAPHLAB_GUIDED_CHUNK_DISPENSER_HPP
+
+#include <algorithm>
+#include <graphlab/parallel/atomic_ops.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Hands out the range [begin, end) to a group of threads in chunks
+   * whose size shrinks as the range is used up (guided scheduling).
+   *
+   * Each claim takes remaining / (2 * nthreads) entries, but at least
+   * min_chunk, rounded up to a multiple of granularity. Early chunks are
+   * large, which keeps the number of atomic operations on the shared
+   * cursor low, while the small final chunks keep the threads balanced.
+   * The cursor sits on its own cache line.
+   */
+  class guided_chunk_dispenser {
+   public:
+    guided_chunk_dispenser() : cursor(0), begin(0), end(0), nthreads(1),
+                               granularity(1), min_chunk(1) { }
+
+    /**
+     * Starts handing out [begin_, end_). begin_ should be a multiple of
+     * granularity so that every chunk but the last is aligned. Must not
+     * run concurrently with claim().
+     */
+    void reset(size_t begin_, size_t end_, size_t nthreads_,
+               size_t granularity_ = 1, size_t min_chunk_ = 1) {
+      cursor = begin_;
+      begin = begin_;
+      end = std::max(begin_, end_);
+      nthreads = std::max<size_t>(nthreads_, 1);
+      granularity = std::max<size_t>(granularity_, 1);
+      min_chunk = std::max(min_chunk_, granularity);
+    }
+
+    /**
+     * Claims the next chunk as [start, stop). Returns false once the
+     * whole range has been handed out.
+     */
+    bool claim(size_t& start, size_t& stop) {
+      size_t cur = cursor;
+      while (cur < end) {
+        size_t chunk = std::max((end - cur) / (2 * nthreads), min_chunk);
+        chunk = (chunk + granularity - 1) / granularity * granularity;
+        const size_t next = std::min(cur + chunk, end);
+        if (atomic_compare_and_swap(cursor, cur, next)) {
+          start = cur;
+          stop = next;
+          return true;
+        }
+        cur = cursor;
+      }
+      return false;
+    }
+
+    /// True if the whole range has been handed out
+    bool exhausted() const { return cursor >= end; }
+
+    /// The fraction of the range handed out, 1 for an empty range
+    double progress() const {
+      if (end == begin) return 1;
+      return double(std::min(size_t(cursor), end) - begin) / (end - begin);
+    }
+
+   private:
+    char pad0[64];
+    volatile size_t cursor;
+    char pad1[64 - sizeof(size_t)];
+    size_t begin;
+    size_t end;
+    size_t nthreads;
+    size_t granularity;
+    size_t min_chunk;
+  }; // end of guided_chunk_dispenser
+
+}; // end of namespace graphlab
+
+#endif
@@ -0,0 +1,166 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <algorithm>
+#include <graphlab/parallel/numa_topology.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/stl_util.hpp>
+#include <graphlab/logger/logger.hpp>
+
+// the memory policies of linux/mempolicy.h
+#define GL_MPOL_BIND 2
+#define GL_MPOL_INTERLEAVE 3
+#define GL_MPOL_MF_MOVE (1 << 1)
+
+namespace graphlab {
+
+namespace {
+  bool numa_enabled = false;
+
+  /// Parses a list such as "0-5,12-17"
+  std::vector<size_t> parse_cpulist(const std::string& list) {
+    std::vector<size_t> ret;
+    size_t pos = 0;
+    while (pos < list.length()) {
+      size_t end = list.find(',', pos);
+      if (end == std::string::npos) end = list.length();
+      const std::string range = list.substr(pos, end - pos);
+      unsigned long a, b;
+      if (sscanf(range.c_str(), "%lu-%lu", &a, &b) == 2) {
+        for (unsigned long c = a; c <= b; ++c) ret.push_back(c);
+      } else if (sscanf(range.c_str(), "%lu", &a) == 1) {
+        ret.push_back(a);
+      }
+      pos = end + 1;
+    }
+    return ret;
+  }
+
+  bool set_policy(void* ptr, size_t len, int mode,
+                  const std::vector<unsigned long>& nodemask) {
+#if defined(__linux__) && defined(SYS_mbind)
+    // only whole pages can be placed
+    const size_t pagesize = getpagesize();
+    const size_t begin = ((size_t)ptr + pagesize - 1) / pagesize * pagesize;
+    const size_t end = ((size_t)ptr + len) / pagesize * pagesize;
+    if (end <= begin) return true;
+    return syscall(SYS_mbind, begin, end - begin, mode, &nodemask[0],
+                   nodemask.size() * 8 * sizeof(unsigned long) + 1,
+                   GL_MPOL_MF_MOVE) == 0;
+#else
+    return false;
+#endif
+  }
+
+  std::vector<unsigned long> node_mask(size_t nnodes) {
+    return std::vector<unsigned long>(nnodes / (8 * sizeof(unsigned long)) + 1, 0);
+  }
+} // namespace
+
+
+numa_topology::numa_topology() {
+  for (size_t node = 0; ; ++node) {
+    std::ifstream fin(("/sys/devices/system/node/node" + tostr(node) +
+                       "/cpulist").c_str());
+    if (!fin.good()) break;
+    std::string list;
+    std::getline(fin, list);
+    node_cpus.push_back(parse_cpulist(list));
+  }
+  if (node_cpus.empty()) {
+    node_cpus.resize(1);
+    for (size_t i = 0; i < thread::cpu_count(); ++i) node_cpus[0].push_back(i);
+  }
+  for (size_t node = 0; node < node_cpus.size(); ++node) {
+    cpu_order.insert(cpu_order.end(), node_cpus[node].begin(),
+                     node_cpus[node].end());
+  }
+  if (cpu_order.empty()) cpu_order.push_back(0);
+}
+
+const numa_topology& numa_topology::get() {
+  static numa_topology topology;
+  return topology;
+}
+
+void numa_topology::set_enabled(bool enabled) {
+  numa_enabled = enabled;
+  if (enabled) {
+    logstream(LOG_INFO) << "NUMA placement over " << get().num_nodes()
+                        << " nodes" << std::endl;
+  }
+}
+
+bool numa_topology::enabled() {
+  return numa_enabled;
+}
+
+size_t numa_topology::node_of_cpu(size_t cpu) const {
+  for (size_t node = 0; node < node_cpus.size(); ++node) {
+    if (std::find(node_cpus[node].begin(), node_cpus[node].end(), cpu) !=
+        node_cpus[node].end()) {
+      return node;
+    }
+  }
+  return 0;
+}
+
+size_t numa_topology::placement_cpu(size_t i) const {
+  return cpu_order[i % cpu_order.size()];
+}
+
+std::vector<size_t> numa_topology::partition(size_t n, size_t alignment) const {
+  std::vector<size_t> ret(num_nodes() + 1, n);
+  ret[0] = 0;
+  size_t cpus_before = 0;
+  for (size_t node = 1; node < num_nodes(); ++node) {
+    cpus_before += node_cpus[node - 1].size();
+    const size_t b = n * cpus_before / cpu_order.size();
+    ret[node] = std::min(n, (b + alignment - 1) / alignment * alignment);
+  }
+  return ret;
+}
+
+bool numa_topology::interleave(void* ptr, size_t len) {
+  const size_t nnodes = get().num_nodes();
+  std::vector<unsigned long> mask = node_mask(nnodes);
+  for (size_t node = 0; node < nnodes; ++node) {
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+  }
+  return set_policy(ptr, len, GL_MPOL_INTERLEAVE, mask);
+}
+
+bool numa_topology::bind(void* ptr, size_t len, size_t node) {
+  std::vector<unsigned long> mask = node_mask(get().num_nodes());
+  mask[node / (8 * sizeof(unsigned long))] |=
+      1UL << (node % (8 * sizeof(unsigned long)));
+  return set_policy(ptr, len, GL_MPOL_BIND, mask);
+}
+
+} // namespace graphlab
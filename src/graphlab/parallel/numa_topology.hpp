@@ -0,0 +1,94 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_NUMA_TOPOLOGY_HPP
+#define GRAPHLAB_NUMA_TOPOLOGY_HPP
+
+#include <vector>
+#include <cstddef>
+
+namespace graphlab {
+
+/**
+ * \ingroup threading
+ * The NUMA nodes of the machine and the CPUs on each of them, read
+ * from /sys/devices/system/node. Machines without NUMA information are
+ * seen as one node holding every CPU.
+ *
+ * When NUMA placement is enabled (set_enabled(), or the --numa command
+ * line option), threads launched on a CPU id are pinned by the order of
+ * placement_cpu(): all the CPUs of node 0 first, then those of node 1
+ * and so on. Consecutive workers therefore share a socket, and
+ * partition() splits index ranges so that the workers of each node
+ * process the elements whose memory bind() placed on that node.
+ */
+class numa_topology {
+ public:
+  /// The topology of this machine
+  static const numa_topology& get();
+
+  /// Enables the NUMA aware placement of threads and memory
+  static void set_enabled(bool enabled);
+
+  /// True if NUMA placement is enabled
+  static bool enabled();
+
+  /// The number of NUMA nodes
+  size_t num_nodes() const { return node_cpus.size(); }
+
+  /// The CPUs of a node
+  const std::vector<size_t>& cpus(size_t node) const { return node_cpus[node]; }
+
+  /// The node of a CPU
+  size_t node_of_cpu(size_t cpu) const;
+
+  /// The CPU the i-th thread is pinned to: i is taken modulo the number of CPUs
+  size_t placement_cpu(size_t i) const;
+
+  /**
+   * Splits [0, n) into num_nodes() contiguous ranges proportional to the
+   * number of CPUs of each node, with boundaries on multiples of
+   * alignment. Range k is [ret[k], ret[k + 1]).
+   */
+  std::vector<size_t> partition(size_t n, size_t alignment) const;
+
+  /**
+   * Interleaves the pages of [ptr, ptr + len) over all the nodes,
+   * moving those already allocated. Returns false on failure.
+   */
+  static bool interleave(void* ptr, size_t len);
+
+  /**
+   * Places the pages of [ptr, ptr + len) on a node, moving those
+   * already allocated. Returns false on failure.
+   */
+  static bool bind(void* ptr, size_t len, size_t node);
+
+ private:
+  numa_topology();
+  std::vector<std::vector<size_t> > node_cpus;
+  /// all the CPUs ordered by node
+  std::vector<size_t> cpu_order;
+};
+
+} // namespace graphlab
+#endif
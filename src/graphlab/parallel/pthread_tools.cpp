@@ -22,6 +22,7 @@
 
 
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/numa_topology.hpp>
 #include <boost/bind.hpp>
 #include <graphlab/macros_def.hpp>
 
@@ -247,6 +248,9 @@ namespace graphlab {
       }
       if (cpu_count() > 0) {
         cpu_id = cpu_id % cpu_count();
+        if (numa_topology::enabled()) {
+          cpu_id = numa_topology::get().placement_cpu(cpu_id);
+        }
       }
       else {
         // unknown CPU count
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_SHARDED_COUNTER_HPP
+#define GRAPHLAB_SHARDED_COUNTER_HPP
+
+#include <vector>
+#include <graphlab/parallel/cache_line_pad.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A counter split into one cache line padded shard per thread.
+   *
+   * Each shard must only be incremented by a single thread, so inc()
+   * needs no atomic operation and threads never share a cache line.
+   * value() sums the shards and is only exact once the writers are done
+   * (for instance after a thread barrier).
+   */
+  template <typename T = size_t>
+  class sharded_counter {
+   public:
+    explicit sharded_counter(size_t nshards = 1) : shards(nshards, T()) { }
+
+    /// Sets the number of shards. All shards are reset to zero.
+    void resize(size_t nshards) {
+      shards.clear();
+      shards.resize(nshards, T());
+    }
+
+    size_t num_shards() const { return shards.size(); }
+
+    /// Adds delta to the shard owned by the calling thread
+    void inc(size_t shard, const T& delta = T(1)) {
+      shards[shard].value += delta;
+    }
+
+    /// Returns the sum of all shards
+    T value() const {
+      T ret = T();
+      for (size_t i = 0; i < shards.size(); ++i) ret += shards[i].value;
+      return ret;
+    }
+
+    /// Resets the counter to the value v, stored in the first shard
+    sharded_counter& operator=(const T& v) {
+      for (size_t i = 0; i < shards.size(); ++i) shards[i].value = T();
+      if (!shards.empty()) shards[0].value = v;
+      return *this;
+    }
+
+    operator T() const { return value(); }
+
+   private:
+    std::vector<cache_line_pad<T> > shards;
+  }; // end of sharded_counter
+
+}; // end of namespace graphlab
+
+#endif
@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_TASK_RUNTIME_HPP
+#define GRAPHLAB_TASK_RUNTIME_HPP
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/parallel/fiber_conditional.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace graphlab {
+
+/**
+ * \ingroup util
+ * \file task_runtime.hpp
+ *
+ * A small task parallel runtime which runs on the worker threads of the 
+ * fiber_control singleton, so that parallel loops outside of the engines
+ * share the same threads as the engines instead of starting an OpenMP
+ * team on top of them.
+ *
+ * \li launch_task() runs a function asynchronously and returns a 
+ *     task_future which can be waited on.
+ * \li parallel_for() runs a function over a range of indices, handing out
+ *     blocks of grain_size indices at a time.
+ * \li parallel_reduce() is parallel_for() with a per worker accumulator
+ *     which are combined at the end.
+ *
+ * Tasks run on fiber stacks of task_runtime_stacksize() bytes. Waiting
+ * for a task from inside a fiber deschedules the fiber rather than 
+ * blocking the worker; from a regular thread the thread blocks. When
+ * called from inside a fiber, parallel_for() and parallel_reduce() 
+ * also run part of the loop on the calling fiber.
+ */
+
+namespace task_runtime_impl {
+
+/**
+ * The stack size of fibers launched by the task runtime
+ */
+inline size_t& stacksize_ref() {
+  static size_t stacksize = 1024 * 1024;
+  return stacksize;
+}
+
+/**
+ * Counts outstanding tasks. wait() returns when all tasks have called
+ * finish(). Works from both fibers and regular threads.
+ */
+struct task_counter {
+  mutex lock;
+  fiber_conditional cond;
+  size_t remaining;
+  task_counter(size_t n): remaining(n) { }
+  void finish() {
+    lock.lock();
+    --remaining;
+    if (remaining == 0) cond.broadcast();
+    lock.unlock();
+  }
+  void wait() {
+    lock.lock();
+    while (remaining > 0) cond.wait(lock);
+    lock.unlock();
+  }
+};
+
+/**
+ * Shared state between a task and its future
+ */
+template <typename T>
+struct future_state {
+  task_counter done;
+  T value;
+  future_state(): done(1), value() { }
+  void run(const boost::function<T(void)>& fn) {
+    value = fn();
+    done.finish();
+  }
+};
+
+template <>
+struct future_state<void> {
+  task_counter done;
+  future_state(): done(1) { }
+  void run(const boost::function<void(void)>& fn) {
+    fn();
+    done.finish();
+  }
+};
+
+/**
+ * Runs ntasks copies of body.run() on the fiber_control workers and 
+ * waits for all of them. If the caller is a fiber, the caller runs one
+ * of the copies itself.
+ */
+template <typename Body>
+void run_on_workers(Body& body, size_t ntasks) {
+  fiber_control& fc = fiber_control::get_instance();
+  const size_t nworkers = fc.num_workers();
+  const bool caller_participates = fiber_control::in_fiber();
+  const size_t nlaunch = caller_participates ? ntasks - 1 : ntasks;
+  task_counter counter(nlaunch);
+  // spread the tasks across the workers, starting from the one after
+  // the caller.
+  size_t worker = caller_participates ? fiber_control::get_worker_id() + 1 : 0;
+  for (size_t i = 0; i < nlaunch; ++i) {
+    fiber_control::affinity_type affinity;
+    affinity.set_bit((worker + i) % nworkers);
+    fc.launch(boost::bind(&Body::run_task, &body, &counter),
+              stacksize_ref(), affinity);
+  }
+  if (caller_participates) body.run();
+  counter.wait();
+}
+
+/**
+ * Number of tasks and grain size to use for a parallel_for over n
+ * elements.
+ */
+inline void plan_loop(size_t n, size_t& grain_size, size_t& ntasks) {
+  const size_t nworkers = fiber_control::get_instance().num_workers();
+  // by default, 8 blocks per worker to even out the load
+  if (grain_size == 0) grain_size = std::max<size_t>(1, n / (8 * nworkers));
+  ntasks = std::min(nworkers, (n + grain_size - 1) / grain_size);
+}
+
+template <typename FunctionType>
+struct parallel_for_body {
+  const FunctionType& fn;
+  atomic<size_t> next;
+  size_t end;
+  size_t grain_size;
+  parallel_for_body(const FunctionType& fn, size_t begin, size_t end,
+                    size_t grain_size)
+      : fn(fn), next(begin), end(end), grain_size(grain_size) { }
+
+  void run() {
+    while (1) {
+      size_t block_begin = next.inc_ret_last(grain_size);
+      if (block_begin >= end) break;
+      size_t block_end = std::min(block_begin + grain_size, end);
+      for (size_t i = block_begin; i < block_end; ++i) fn(i);
+    }
+  }
+  void run_task(task_counter* counter) {
+    run();
+    counter->finish();
+  }
+};
+
+template <typename T, typename FunctionType, typename CombinerType>
+struct parallel_reduce_body {
+  const FunctionType& fn;
+  const CombinerType& combiner;
+  const T& identity;
+  atomic<size_t> next;
+  size_t end;
+  size_t grain_size;
+  mutex lock;
+  T result;
+  parallel_reduce_body(const FunctionType& fn, const CombinerType& combiner,
+                       const T& identity, size_t begin, size_t end,
+                       size_t grain_size)
+      : fn(fn), combiner(combiner), identity(identity), next(begin), 
+        end(end), grain_size(grain_size), result(identity) { }
+
+  void run() {
+    T accum = identity;
+    while (1) {
+      size_t block_begin = next.inc_ret_last(grain_size);
+      if (block_begin >= end) break;
+      size_t block_end = std::min(block_begin + grain_size, end);
+      for (size_t i = block_begin; i < block_end; ++i) fn(i, accum);
+    }
+    lock.lock();
+    combiner(result, accum);
+    lock.unlock();
+  }
+  void run_task(task_counter* counter) {
+    run();
+    counter->finish();
+  }
+};
+
+} // namespace task_runtime_impl
+
+
+/**
+ * \ingroup util
+ * The result of a task launched with launch_task(). Copies of a future
+ * refer to the same task.
+ */
+template <typename T>
+class task_future {
+ public:
+  task_future() { }
+  explicit task_future(boost::shared_ptr<task_runtime_impl::future_state<T> > state)
+      : state(state) { }
+
+  /// Waits for the task to complete.
+  void wait() const {
+    state->done.wait();
+  }
+
+  /// Waits for the task to complete and returns its result.
+  T& get() const {
+    wait();
+    return state->value;
+  }
+
+  /// Returns true if the task has completed.
+  bool ready() const {
+    state->done.lock.lock();
+    bool ret = (state->done.remaining == 0);
+    state->done.lock.unlock();
+    return ret;
+  }
+
+ private:
+  boost::shared_ptr<task_runtime_impl::future_state<T> > state;
+};
+
+template <>
+class task_future<void> {
+ public:
+  task_future() { }
+  explicit task_future(boost::shared_ptr<task_runtime_impl::future_state<void> > state)
+      : state(state) { }
+
+  void wait() const {
+    state->done.wait();
+  }
+
+  void get() const {
+    wait();
+  }
+
+  bool ready() const {
+    state->done.lock.lock();
+    bool ret = (state->done.remaining == 0);
+    state->done.lock.unlock();
+    return ret;
+  }
+
+ private:
+  boost::shared_ptr<task_runtime_impl::future_state<void> > state;
+};
+
+
+/**
+ * \ingroup util
+ * Runs fn asynchronously on the fiber_control workers. 
+ *
+ * \code
+ * task_future<size_t> f = launch_task<size_t>(boost::bind(count_lines, fname));
+ * ...
+ * size_t nlines = f.get();
+ * \endcode
+ */
+template <typename T>
+task_future<T> launch_task(const boost::function<T(void)>& fn) {
+  boost::shared_ptr<task_runtime_impl::future_state<T> > 
+      state(new task_runtime_impl::future_state<T>);
+  fiber_control::get_instance().launch(
+      boost::bind(&task_runtime_impl::future_state<T>::run, state, fn),
+      task_runtime_impl::stacksize_ref());
+  return task_future<T>(state);
+}
+
+inline task_future<void> launch_task(const boost::function<void(void)>& fn) {
+  return launch_task<void>(fn);
+}
+
+
+/**
+ * \ingroup util
+ * Calls fn(i) for every i in [begin, end) in parallel on the fiber_control
+ * workers, and returns when all calls have completed. Workers claim 
+ * blocks of grain_size consecutive indices at a time. If grain_size is 0, 
+ * it is picked so that every worker gets about 8 blocks.
+ *
+ * fn is called concurrently and must be safe for that.
+ */
+template <typename FunctionType>
+void parallel_for(size_t begin, size_t end, const FunctionType& fn,
+                  size_t grain_size = 0) {
+  if (begin >= end) return;
+  size_t ntasks;
+  task_runtime_impl::plan_loop(end - begin, grain_size, ntasks);
+  if (ntasks <= 1) {
+    for (size_t i = begin; i < end; ++i) fn(i);
+    return;
+  }
+  task_runtime_impl::parallel_for_body<FunctionType> body(fn, begin, end, 
+                                                          grain_size);
+  task_runtime_impl::run_on_workers(body, ntasks);
+}
+
+
+/**
+ * \ingroup util
+ * Parallel reduction over [begin, end). Each worker starts from a copy of
+ * identity, and calls fn(i, accum) for each index it claims. The 
+ * accumulators of the workers are then merged into a copy of identity
+ * with combiner(result, accum), in an unspecified order.
+ *
+ * \code
+ * void add_degree(size_t i, size_t& accum) { accum += degree[i]; }
+ * void sum(size_t& a, const size_t& b) { a += b; }
+ * size_t total = parallel_reduce(0, n, size_t(0), add_degree, sum);
+ * \endcode
+ */
+template <typename T, typename FunctionType, typename CombinerType>
+T parallel_reduce(size_t begin, size_t end, const T& identity,
+                  const FunctionType& fn, const CombinerType& combiner,
+                  size_t grain_size = 0) {
+  if (begin >= end) return identity;
+  size_t ntasks;
+  task_runtime_impl::plan_loop(end - begin, grain_size, ntasks);
+  if (ntasks <= 1) {
+    T accum = identity;
+    for (size_t i = begin; i < end; ++i) fn(i, accum);
+    T result = identity;
+    combiner(result, accum);
+    return result;
+  }
+  task_runtime_impl::parallel_reduce_body<T, FunctionType, CombinerType> 
+      body(fn, combiner, identity, begin, end, grain_size);
+  task_runtime_impl::run_on_workers(body, ntasks);
+  return body.result;
+}
+
+
+/**
+ * \ingroup util
+ * Sets the stack size of fibers launched by the task runtime. Defaults
+ * to 1MB. Only affects tasks launched afterwards.
+ */
+inline void set_task_runtime_stacksize(size_t stacksize) {
+  task_runtime_impl::stacksize_ref() = stacksize;
+}
+
+/// Returns the stack size of fibers launched by the task runtime.
+inline size_t task_runtime_stacksize() {
+  return task_runtime_impl::stacksize_ref();
+}
+
+/// Returns the number of worker threads used by the task runtime.
+inline size_t task_runtime_num_workers() {
+  return fiber_control::get_instance().num_workers();
+}
+
+/**
+ * Returns the number of distinct values task_runtime_thread_id() can
+ * return; the number of per thread slots code which runs in both the task
+ * runtime and in OpenMP regions should allocate.
+ */
+inline size_t task_runtime_num_thread_ids() {
+  size_t ret = task_runtime_num_workers();
+#ifdef _OPENMP
+  ret = std::max<size_t>(ret, omp_get_max_threads());
+#endif
+  return ret;
+}
+
+/**
+ * Returns an ID for the calling thread in [0, task_runtime_num_thread_ids()): 
+ * the worker ID inside the task runtime, or the OpenMP thread number 
+ * otherwise. Two concurrent threads may share an ID, so it should only be 
+ * used to spread contention, for instance to pick a buffered_exchange 
+ * buffer.
+ */
+inline size_t task_runtime_thread_id() {
+  size_t ret = 0;
+  if (fiber_control::in_fiber()) {
+    ret = fiber_control::get_worker_id();
+  } else {
+#ifdef _OPENMP
+    ret = omp_get_thread_num();
+#endif
+  }
+  return ret % task_runtime_num_thread_ids();
+}
+
+} // namespace graphlab
+#endif
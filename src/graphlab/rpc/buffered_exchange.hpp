@@ -28,6 +28,7 @@
 #include <graphlab/parallel/fiber_control.hpp>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/rpc/exchange_flush_policy.hpp>
 #include <graphlab/util/mpi_tools.hpp>
 
 
@@ -62,6 +63,9 @@ namespace graphlab {
    *
    * \note The buffered exchange sends data in the background, so recv can be
    * called even before the flush calls.
+   * \note On a single machine the values are not serialized: each thread
+   * appends them to a vector which is moved to the receive buffers when
+   * full, and flush() does not wait on the other machines.
    *
    * \see graphlab::fiber_buffered_exchange
    */
@@ -95,6 +99,14 @@ namespace graphlab {
     std::vector< mutex >  send_locks;
     const size_t num_threads;
     const size_t max_buffer_size;
+    /// whether the values are serialized with compact archives
+    const bool compact;
+    /// when to send each send buffer
+    dc_impl::exchange_flow_control flow;
+    /// true on a single machine, where the send buffers are local_buffers
+    const bool local;
+    /// the values sent by each thread, on a single machine
+    std::vector<buffer_type> local_buffers;
 
 
     // typedef boost::function<void (const T& tref)> handler_type;
@@ -110,20 +122,30 @@ namespace graphlab {
      *                  need to match the total number of threads used during 
      *                  the exchange process, but there are performance / contention
      *                  advantages if this matches.
-     * \ref max_buffer_size The size of the per thread and per target send buffer.
+     * \ref max_buffer_size The largest size of the per thread and per target
+     *                      send buffer. Smaller buffers may be sent
+     *                      depending on the exchange_flush_policy.
+     * \ref compact Whether to serialize using compact archives. Must be
+     *              the same on all machines.
      */
     buffered_exchange(distributed_control& dc,
                       const size_t num_threads = 1,
-                      const size_t max_buffer_size = DEFAULT_BUFFERED_EXCHANGE_SIZE) :
+                      const size_t max_buffer_size = DEFAULT_BUFFERED_EXCHANGE_SIZE,
+                      const bool compact = DEFAULT_BUFFERED_EXCHANGE_COMPACT) :
       rpc(dc, this),
       send_buffers(num_threads *  dc.numprocs()),
       send_locks(num_threads *  dc.numprocs()),
       num_threads(num_threads),
-      max_buffer_size(max_buffer_size) {
-       //
-       for (size_t i = 0;i < send_buffers.size(); ++i) {
+      max_buffer_size(max_buffer_size), compact(compact),
+      flow(max_buffer_size), local(dc.numprocs() == 1) {
+       flow.resize(send_buffers.size());
+       if (local) local_buffers.resize(num_threads);
+       for (size_t i = 0;i < send_buffers.size() && !local; ++i) {
          // initialize the split call
          send_buffers[i].oarc = rpc.split_call_begin(&buffered_exchange::rpc_recv);
+         // room for a full buffer
+         send_buffers[i].oarc->reserve(max_buffer_size);
+         send_buffers[i].oarc->compact = compact;
          send_buffers[i].numinserts = 0;
          // begin by writing the src proc.
          (*(send_buffers[i].oarc)) << rpc.procid();
@@ -134,7 +156,7 @@ namespace graphlab {
 
     ~buffered_exchange() {
       // clear the send buffers
-      for (size_t i = 0;i < send_buffers.size(); ++i) {
+      for (size_t i = 0;i < send_buffers.size() && !local; ++i) {
         rpc.split_call_cancel(send_buffers[i].oarc);
       }
     }
@@ -154,11 +176,19 @@ namespace graphlab {
       const size_t index = thread_id * rpc.numprocs() + proc;
       ASSERT_LT(index, send_locks.size());
       send_locks[index].lock();
+      if (local) {
+        local_buffers[thread_id].push_back(value);
+        if (local_buffers[thread_id].size() * sizeof(T) >= max_buffer_size) {
+          move_local_buffer(thread_id);
+        }
+        send_locks[index].unlock();
+        return;
+      }
 
       (*(send_buffers[index].oarc)) << value;
-      ++send_buffers[index].numinserts;
+      if (++send_buffers[index].numinserts == 1) flow.first_insert(index);
 
-      if(send_buffers[index].oarc->off >= max_buffer_size) {
+      if(flow.should_flush(index, send_buffers[index].oarc->off)) {
         oarchive* prevarc = swap_buffer(index);
         send_locks[index].unlock();
         // complete the send
@@ -172,6 +202,12 @@ namespace graphlab {
      * Flushes the send buffer owned owned by thread_id.
      */
     void partial_flush(size_t thread_id) {
+      if (local) {
+        send_locks[thread_id].lock();
+        move_local_buffer(thread_id);
+        send_locks[thread_id].unlock();
+        return;
+      }
       for(procid_t proc = 0; proc < rpc.numprocs(); ++proc) {
         const size_t index = thread_id * rpc.numprocs() + proc;
         ASSERT_LT(proc, rpc.numprocs());
@@ -191,6 +227,14 @@ namespace graphlab {
      * Will not return until all machines call flush.
      */
     void flush() {
+      if (local) {
+        for (size_t i = 0; i < local_buffers.size(); ++i) {
+          send_locks[i].lock();
+          move_local_buffer(i);
+          send_locks[i].unlock();
+        }
+        return;
+      }
       for(size_t i = 0; i < send_buffers.size(); ++i) {
         const procid_t proc = i % rpc.numprocs();
         ASSERT_LT(proc, rpc.numprocs());
@@ -274,10 +318,18 @@ namespace graphlab {
     void clear() { }
 
     void barrier() { rpc.barrier(); }
+
+    /// The number of send buffers sent
+    size_t num_flushes() const { return flow.num_flushes(); }
+
+    /// The average number of bytes in the send buffers sent
+    double average_batch_size() const { return flow.average_batch_size(); }
+
   private:
     void rpc_recv(size_t len, wild_pointer w) {
       buffer_type tmp;
       iarchive iarc(reinterpret_cast<const char*>(w.ptr), len);
+      iarc.compact = compact;
       // first desrialize the source process
       procid_t src_proc; iarc >> src_proc;
       ASSERT_LT(src_proc, rpc.numprocs());
@@ -302,10 +354,26 @@ namespace graphlab {
     } // end of rpc rcv
 
 
+    /// Moves the values sent by thread_id to the receive buffers
+    void move_local_buffer(size_t thread_id) {
+      if (local_buffers[thread_id].empty()) return;
+      flow.sent(thread_id, local_buffers[thread_id].size() * sizeof(T));
+      recv_lock.lock();
+      recv_buffers.push_back(buffer_record());
+      buffer_record& rec = recv_buffers.back();
+      rec.proc = 0;
+      rec.buffer.swap(local_buffers[thread_id]);
+      recv_lock.unlock();
+    }
+
     // create a new buffer for send_buffer[index], returning the old buffer
     oarchive* swap_buffer(size_t index) {
       oarchive* swaparc = rpc.split_call_begin(&buffered_exchange::rpc_recv);
+      swaparc->reserve(max_buffer_size);
+      // the rpc header before this point is never compact
+      swaparc->compact = compact;
       std::swap(send_buffers[index].oarc, swaparc);
+      flow.sent(index, swaparc->off);
       // write the length at the end of the buffere are returning
       (*swaparc).write(reinterpret_cast<char*>(&send_buffers[index].numinserts), sizeof(size_t));
 
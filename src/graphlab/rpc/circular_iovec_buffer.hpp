@@ -35,12 +35,14 @@ namespace dc_impl {
  * A circular buffer which maintains a parallel sequence of iovecs.
  * One sequence is basic iovecs
  * The other sequence is used for storing the original unomidifed pointers
- * This is minimally checked. length must be a power of 2
+ * This is minimally checked. length must be a power of 2.
+ * The buffer starts small and doubles when full, so that idle
+ * connections to many machines stay cheap.
  */
 struct circular_iovec_buffer {
-  inline circular_iovec_buffer(size_t len = 4096) {
-    v.resize(4096);
-    parallel_v.resize(4096);
+  inline circular_iovec_buffer(size_t len = 16) {
+    v.resize(len);
+    parallel_v.resize(len);
     head = 0;
     tail = 0;
     numel = 0;
@@ -121,6 +123,18 @@ struct circular_iovec_buffer {
   }
 
 
+  /**
+   * Moves all the entries to the end of other, leaving this buffer
+   * empty. other takes over freeing the pointers.
+   */
+  inline void move_to(circular_iovec_buffer& other) {
+    while(numel > 0) {
+      other.write(parallel_v[head], v[head]);
+      head = (head + 1) & (v.size() - 1);
+      --numel;
+    }
+  }
+
   /**
    * Erases a single iovec from the head and free the pointer
    */
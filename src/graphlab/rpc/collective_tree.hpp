@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_RPC_COLLECTIVE_TREE_HPP
+#define GRAPHLAB_RPC_COLLECTIVE_TREE_HPP
+
+#include <map>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ * \ingroup rpc
+ * \internal
+ *
+ * Computes the position of a machine in the tree used by the barriers
+ * and the tree collectives of dc_dist_object.
+ *
+ * The machines sharing a host are grouped under the lowest numbered
+ * machine of the host, the host leader, which is then the parent of all
+ * of them. The host leaders, in increasing order, form a heap with the
+ * given branch factor. Messages between the machines of a host never
+ * leave it, and only one message per host crosses the network in each
+ * direction. Machine 0 is always the root, and its parent is itself.
+ *
+ * \param hosts The host of every machine
+ * \param me The machine to compute the tree position of
+ * \param branch_factor The maximum number of host leaders under a leader
+ * \param parent Returns the parent of me
+ * \param children Returns the children of me in increasing order
+ */
+inline void build_collective_tree(const std::vector<std::string>& hosts,
+                                  procid_t me, size_t branch_factor,
+                                  procid_t& parent,
+                                  std::vector<procid_t>& children) {
+  ASSERT_LT(me, hosts.size());
+  std::map<std::string, procid_t> host_leader;
+  std::vector<procid_t> leaders;
+  for (size_t i = 0; i < hosts.size(); ++i) {
+    if (host_leader.insert(std::make_pair(hosts[i], procid_t(i))).second) {
+      leaders.push_back(procid_t(i));
+    }
+  }
+  children.clear();
+  const procid_t myleader = host_leader[hosts[me]];
+  if (myleader != me) {
+    parent = myleader;
+    return;
+  }
+  // the other machines on my host
+  for (size_t i = me + 1; i < hosts.size(); ++i) {
+    if (hosts[i] == hosts[me]) children.push_back(procid_t(i));
+  }
+  // my position in the heap of host leaders
+  const size_t pos = std::lower_bound(leaders.begin(), leaders.end(), me)
+                     - leaders.begin();
+  parent = pos == 0 ? me : leaders[(pos - 1) / branch_factor];
+  const size_t childbase = pos * branch_factor + 1;
+  for (size_t i = childbase;
+       i < leaders.size() && i < childbase + branch_factor; ++i) {
+    children.push_back(leaders[i]);
+  }
+}
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
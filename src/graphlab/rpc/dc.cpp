@@ -32,6 +32,7 @@
 #include <map>
 #include <sstream>
 
+#include <limits>
 #include <boost/unordered_map.hpp>
 #include <boost/bind.hpp>
 //#include <graphlab/logger/assertions.hpp>
@@ -39,14 +40,21 @@
 #include <graphlab/util/stl_util.hpp>
 #include <graphlab/util/net_util.hpp>
 #include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/branch_hints.hpp>
 
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_tcp_comm.hpp>
+#ifdef HAS_IBVERBS
+#include <graphlab/rpc/dc_ibv_comm.hpp>
+#endif
 //#include <graphlab/rpc/dc_sctp_comm.hpp>
 #include <graphlab/rpc/dc_buffered_stream_send2.hpp>
 #include <graphlab/rpc/dc_stream_receive.hpp>
 #include <graphlab/rpc/request_reply_handler.hpp>
 #include <graphlab/rpc/dc_services.hpp>
+#include <graphlab/rpc/rpc_profiler.hpp>
+#include <graphlab/ui/metrics_server.hpp>
 
 #include <graphlab/rpc/dc_init_from_env.hpp>
 #include <graphlab/rpc/dc_init_from_mpi.hpp>
@@ -58,6 +66,8 @@ namespace graphlab {
 namespace dc_impl {
 
 
+void (*comm_failure_handler)(procid_t) = NULL;
+
 bool thrlocal_sequentialization_key_initialized = false;
 pthread_key_t thrlocal_sequentialization_key;
 
@@ -107,6 +117,13 @@ unsigned char distributed_control::new_sequentialization_key() {
   return (unsigned char)oldval;
 }
 
+bool distributed_control::set_urgent_send(bool urgent) {
+  dc_impl::thread_local_buffer* p = dc_impl::get_thread_local_send_buffer();
+  const bool prev = p->urgent;
+  p->urgent = urgent;
+  return prev;
+}
+
 unsigned char distributed_control::get_sequentialization_key() {
   size_t oldval = reinterpret_cast<size_t>(pthread_getspecific(dc_impl::thrlocal_sequentialization_key));
   assert(oldval < 256);
@@ -116,12 +133,16 @@ unsigned char distributed_control::get_sequentialization_key() {
 
 distributed_control::distributed_control() {
   dc_init_param initparam;
+  timer ti; ti.start();
   if (init_param_from_env(initparam)) {
-    logstream(LOG_INFO) << "Distributed Control Initialized from Environment" << std::endl;
+    logstream(LOG_INFO) << "Distributed Control Initialized from Environment in "
+                        << ti.current_time() << "s" << std::endl;
   } else if (init_param_from_zookeeper(initparam)) {
-      logstream(LOG_INFO) << "Distributed Control Initialized from Zookeeper" << std::endl;
+      logstream(LOG_INFO) << "Distributed Control Initialized from Zookeeper in "
+                          << ti.current_time() << "s" << std::endl;
   } else if (mpi_tools::initialized() && init_param_from_mpi(initparam)) {
-      logstream(LOG_INFO) << "Distributed Control Initialized from MPI" << std::endl;
+      logstream(LOG_INFO) << "Distributed Control Initialized from MPI in "
+                          << ti.current_time() << "s" << std::endl;
   }
   else {
     logstream(LOG_INFO) << "Shared Memory Execution" << std::endl;
@@ -162,6 +183,7 @@ distributed_control::~distributed_control() {
   // detach the instance
   last_dc = NULL;
   last_dc_procid = 0;
+  zookeeper_recovery_shutdown();
   distributed_services->full_barrier();
   logstream(LOG_INFO) << "Shutting down distributed control " << std::endl;
   FREE_CALLBACK_EVENT(EVENT_NETWORK_BYTES);
@@ -198,14 +220,32 @@ distributed_control::~distributed_control() {
   logstream(LOG_INFO) << "Bytes Sent: " << bytessent << std::endl;
   logstream(LOG_INFO) << "Calls Sent: " << calls_sent() << std::endl;
   logstream(LOG_INFO) << "Network Sent: " << network_bytes_sent() << std::endl;
+  logstream(LOG_INFO) << "Network Sent Before Compression: "
+                      << network_bytes_uncompressed() << std::endl;
   logstream(LOG_INFO) << "Bytes Received: " << bytesreceived << std::endl;
   logstream(LOG_INFO) << "Calls Received: " << calls_received() << std::endl;
+  if (profiler) {
+    logstream(LOG_INFO) << "RPC profile of the calls received:\n"
+                        << profiler->to_string() << std::endl;
+    delete profiler;
+    profiler = NULL;
+  }
 
   delete comm;
 
 }
 
 
+static std::pair<std::string, std::string>
+rpc_profile_page(std::map<std::string, std::string>& varmap) {
+  distributed_control* dc = distributed_control::get_instance();
+  std::string ret = "[]\n";
+  if (dc != NULL && dc->get_rpc_profiler() != NULL) {
+    ret = dc->get_rpc_profiler()->to_json();
+  }
+  return std::make_pair(std::string("application/json"), ret);
+}
+
 void distributed_control::exec_function_call(procid_t source,
                                             unsigned char packet_type_mask,
                                             const char* data,
@@ -217,7 +257,14 @@ void distributed_control::exec_function_call(procid_t source,
   arc >> f;
   // a regular funcion call
   dc_impl::dispatch_type dispatch = (dc_impl::dispatch_type)f;
-  dispatch(*this, source, packet_type_mask, data + arc.off, len - arc.off);
+  if (__unlikely__(profiler != NULL)) {
+    timer ti;
+    ti.start();
+    dispatch(*this, source, packet_type_mask, data + arc.off, len - arc.off);
+    profiler->record(f, len, size_t(ti.current_time() * 1e6));
+  } else {
+    dispatch(*this, source, packet_type_mask, data + arc.off, len - arc.off);
+  }
   if ((packet_type_mask & CONTROL_PACKET) == 0) inc_calls_received(source);
   END_TRACEPOINT(dc_call_dispatch);
 }
@@ -241,12 +288,14 @@ unsigned char distributed_control::get_block_sequentialization_key(fcallqueue_en
   return seq_key;
 }
 
-void distributed_control::deferred_function_call_chunk(char* buf, size_t len, procid_t src) {
+void distributed_control::deferred_function_call_chunk(char* buf, size_t len, procid_t src,
+                                   dc_impl::shared_receive_buffer* shared_buffer) {
   BEGIN_TRACEPOINT(dc_receive_queuing);
   fcallqueue_entry* fc = new fcallqueue_entry;
   fc->chunk_src = buf;
   fc->chunk_len = len;
   fc->chunk_ref_counter = NULL;
+  fc->shared_buffer = shared_buffer;
   fc->is_chunk = true;
   fc->source = src;
   fcallqueue_length.inc();
@@ -294,7 +343,7 @@ void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
     if (fcallblock.chunk_ref_counter != NULL) {
       if (fcallblock.chunk_ref_counter->dec(fcallblock.calls.size()) == 0) {
         delete fcallblock.chunk_ref_counter;
-        free(fcallblock.chunk_src);
+        release_chunk(fcallblock.chunk_src, fcallblock.shared_buffer);
       }
     }
   }
@@ -321,7 +370,7 @@ void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
       data += sizeof(dc_impl::packet_hdr) + hdr.len;
       remaininglen -= sizeof(dc_impl::packet_hdr) + hdr.len;
     }
-    free(fcallblock.chunk_src);
+    release_chunk(fcallblock.chunk_src, fcallblock.shared_buffer);
   }
 #else
   else {
@@ -334,6 +383,7 @@ void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
 
     immediate_queue.chunk_src = fcallblock.chunk_src;
     immediate_queue.chunk_ref_counter = refctr;
+    immediate_queue.shared_buffer = fcallblock.shared_buffer;
     immediate_queue.chunk_len = 0;
     immediate_queue.source = fcallblock.source;
     immediate_queue.is_chunk = false;
@@ -342,6 +392,7 @@ void distributed_control::process_fcall_block(fcallqueue_entry &fcallblock) {
       queuebufs[i] = new fcallqueue_entry;
       queuebufs[i]->chunk_src = fcallblock.chunk_src;
       queuebufs[i]->chunk_ref_counter = refctr;
+      queuebufs[i]->shared_buffer = fcallblock.shared_buffer;
       queuebufs[i]->chunk_len = 0;
       queuebufs[i]->source = fcallblock.source;
       queuebufs[i]->is_chunk = false;
@@ -431,7 +482,7 @@ void distributed_control::handle_incoming_calls(size_t threadid,
   for (size_t i = threadid;i < fcallqueue.size(); i += total_threadid) {
     if (fcallqueue[i].empty_unsafe() == false) {
       std::deque<fcallqueue_entry*> q;
-      fcallqueue[i].swap(q);
+      fcallqueue[i].dequeue_all(q);
       while (!q.empty()) {
         fcallqueue_entry* entry;
         entry = q.front();
@@ -451,7 +502,9 @@ void distributed_control::fcallhandler_loop(size_t id) {
   while(fcallqueue[id].is_alive()) {
     fcallqueue[id].wait_for_data();
     std::deque<fcallqueue_entry*> q;
-    fcallqueue[id].swap(q);
+    fcallqueue[id].dequeue_all(q);
+    if (q.empty()) continue;
+    const size_t begin = timer::usec_of_day();
     while (!q.empty()) {
       fcallqueue_entry* entry;
       entry = q.front();
@@ -460,6 +513,7 @@ void distributed_control::fcallhandler_loop(size_t id) {
       process_fcall_block(*entry);
       delete entry;
     }
+    fcall_handler_busy_usec[id].inc(timer::usec_of_day() - begin);
     //  std::cerr << "Handler " << id << " died." << std::endl;
   }
   fcall_handler_active[id].dec();
@@ -489,14 +543,15 @@ void distributed_control::init(const std::vector<std::string> &machines,
             procid_t curmachineid,
             size_t numhandlerthreads,
             dc_comm_type commtype) {
+  timer ti; ti.start();
 
   if (numhandlerthreads == RPC_DEFAULT_NUMHANDLERTHREADS) {
     // autoconfigure
     if (thread::cpu_count() > 2) numhandlerthreads = thread::cpu_count() - 2;
     else numhandlerthreads = 2;
   }
-  ASSERT_MSG(machines.size() <= RPC_MAX_N_PROCS,
-             "Number of processes exceeded hard limit of %d", RPC_MAX_N_PROCS);
+  ASSERT_MSG(machines.size() < size_t(std::numeric_limits<procid_t>::max()),
+             "Number of processes exceeded the range of procid_t");
 
   // initialize thread local storage
   if (dc_impl::thrlocal_sequentialization_key_initialized == false) {
@@ -523,24 +578,54 @@ void distributed_control::init(const std::vector<std::string> &machines,
   global_bytes_received.resize(machines.size());
   fcallqueue.resize(numhandlerthreads);
 
+  // the host of each machine, used to group the collectives by host
+  machine_hosts.resize(machines.size());
+  for (size_t i = 0; i < machines.size(); ++i) {
+    machine_hosts[i] = machines[i].substr(0, machines[i].rfind(':'));
+  }
+
   // options
   set_fast_track_requests(true);
 
   // parse the initstring
   std::map<std::string,std::string> options = parse_options(initstring);
 
+  profiler = NULL;
+  if (options.count("rpc_profile") &&
+      (options["rpc_profile"] == "1" || options["rpc_profile"] == "true")) {
+    profiler = new dc_impl::rpc_profiler;
+    add_metric_server_callback("rpc_profile.json", rpc_profile_page);
+  }
+
+  if (options.count("comm")) {
+    if (options["comm"] == "tcp") commtype = TCP_COMM;
+    else if (options["comm"] == "ibv") commtype = IBV_COMM;
+    else logstream(LOG_FATAL) << "Unknown comm " << options["comm"] << std::endl;
+  }
   if (commtype == TCP_COMM) {
     comm = new dc_impl::dc_tcp_comm();
+#ifdef HAS_IBVERBS
+  } else if (commtype == IBV_COMM) {
+    comm = new dc_impl::dc_ibv_comm();
+#endif
   } else {
     ASSERT_MSG(false, "Unexpected value for comm type");
   }
+  // the tcp comm needs a receiver for each of its sockets to a machine
+  const size_t nstripes = (commtype == TCP_COMM) ?
+    dc_impl::dc_tcp_comm::sockets_per_peer(options) : 1;
+  for (size_t s = 0; s < nstripes; ++s) {
+    for (procid_t i = 0; i < machines.size(); ++i) {
+      receivers.push_back(new dc_impl::dc_stream_receive(this, i));
+    }
+  }
   for (procid_t i = 0; i < machines.size(); ++i) {
-    receivers.push_back(new dc_impl::dc_stream_receive(this, i));
     senders.push_back(new dc_impl::dc_buffered_stream_send2(this, comm, i));
   }
   // create the handler threads
   // store the threads in the threadgroup
   fcall_handler_active.resize(numhandlerthreads);
+  fcall_handler_busy_usec.resize(numhandlerthreads);
   fcall_handler_blockers.resize(numhandlerthreads);
   fcallhandlers.set_stacksize(256*1024); // 256K
   for (size_t i = 0;i < numhandlerthreads; ++i) {
@@ -566,8 +651,10 @@ void distributed_control::init(const std::vector<std::string> &machines,
   if (mpi_tools::initialized()) MPI_Barrier(MPI_COMM_WORLD);
 #endif
 
+  const double threads_time = ti.current_time();
   comm->init(machines, options, curmachineid,
               receivers, senders);
+  const double comm_time = ti.current_time() - threads_time;
   logstream(LOG_INFO) << "TCP Communication layer constructed." << std::endl;
   if (localprocid == 0) {
     logstream(LOG_EMPH) << "Cluster of " << machines.size() << " instances created." << std::endl;
@@ -604,7 +691,14 @@ void distributed_control::init(const std::vector<std::string> &machines,
   // set the static variable for the get_instance_procid() function
   last_dc_procid = localprocid;
 
+  const double barrier_start = ti.current_time();
   barrier();
+  if (localprocid == 0) {
+    logstream(LOG_EMPH) << "Startup: " << threads_time << "s handler threads, "
+                        << comm_time << "s connections, "
+                        << ti.current_time() - barrier_start
+                        << "s first barrier" << std::endl;
+  }
   // initialize the empty stream
   nullstrm.open(boost::iostreams::null_sink());
 
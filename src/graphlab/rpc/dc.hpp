@@ -30,7 +30,7 @@
 #include <graphlab/parallel/fiber_group.hpp>
 #include <graphlab/parallel/fiber_conditional.hpp>
 #include <graphlab/util/resizing_array_sink.hpp>
-#include <graphlab/util/fiber_blocking_queue.hpp>
+#include <graphlab/util/fiber_ring_queue.hpp>
 #include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
 
@@ -85,7 +85,29 @@ struct dc_init_param{
   /** Additional construction options of the form
     "key1=value1,key2=value2".
 
-    There are no available options at this time.
+    \li \b comm=tcp|ibv Overrides the communication method. ibv needs a
+                       build with InfiniBand verbs (HAS_IBVERBS). The
+                       ib_device, ib_port and ib_gid_index options select
+                       the device, port and GID it uses.
+    \li \b sockets_per_peer=NUMBER Opens this many TCP sockets to every
+                       machine and stripes the flushes over them. Needs
+                       RPC_BLOCK_STRIPING (the default).
+    \li \b compress=1 Compresses large flushes on the wire with zlib
+                       at its fastest level. Blocks which do not
+                       compress well are sent as is. Every machine must
+                       be given the same value.
+    \li \b compress_threshold=NUMBER Only flushes of at least this many bytes
+                       are compressed. Defaults to
+                       \ref WIRE_COMPRESSION_THRESHOLD.
+    \li \b shm=0 Turns off the shared memory rings the TCP comm uses
+                       for machines with the same address (processes on
+                       the same host). Every machine must be given the
+                       same value. Defaults to \ref RPC_USE_SHM_TRANSPORT.
+    \li \b rpc_profile=1 Counts the calls, bytes and handler times of
+                       every remote function received. The profile is
+                       served on rpc_profile.json by the metrics server
+                       and logged when the distributed_control is
+                       destroyed.
 
     Internal options which should not be used
     \li \b __socket__=NUMBER Forces TCP comm to use this socket number for its
@@ -107,8 +129,8 @@ struct dc_init_param{
    * \param numhandlerthreads Optional Argument. The number of handler
    *                          threads to create. Defaults to
    *                          \ref RPC_DEFAULT_NUMHANDLERTHREADS
-   * \param commtype The Communication type. The only accepted value now is
-   *                 TCP_COMM
+   * \param commtype The Communication type. TCP_COMM, or IBV_COMM if built
+   *                 with InfiniBand verbs
    */
   dc_init_param(size_t numhandlerthreads = RPC_DEFAULT_NUMHANDLERTHREADS,
                 dc_comm_type commtype = RPC_DEFAULT_COMMTYPE):
@@ -125,6 +147,7 @@ class dc_services;
 namespace dc_impl {
   class dc_buffered_stream_send2;
   class dc_stream_receive;
+  class rpc_profiler;
 }
 
 /**
@@ -223,6 +246,9 @@ class distributed_control{
   /// a pointer to the communications subsystem
   dc_impl::dc_comm_base* comm;
 
+  /// the profile of the calls received. NULL unless rpc_profile is set
+  dc_impl::rpc_profiler* profiler;
+
   /// senders and receivers to all machines
   std::vector<dc_impl::dc_receive*> receivers;
   std::vector<dc_impl::dc_send*> senders;
@@ -231,17 +257,21 @@ class distributed_control{
   fiber_group fcallhandlers;
   std::vector<atomic<size_t> > fcall_handler_active;
   dense_bitset fcall_handler_blockers;
+  /// The time each handler thread spent running calls, in microseconds
+  std::vector<atomic<size_t> > fcall_handler_busy_usec;
 
   struct fcallqueue_entry {
     std::vector<function_call_block> calls;
     char* chunk_src;
     size_t chunk_len;
     atomic<size_t>* chunk_ref_counter;
+    /// if not NULL, chunk_src points into this buffer instead of owning it
+    dc_impl::shared_receive_buffer* shared_buffer;
     procid_t source;
     bool is_chunk;
   };
   /// a queue of functions to be executed
-  std::vector<fiber_blocking_queue<fcallqueue_entry*> > fcallqueue;
+  std::vector<fiber_ring_queue<fcallqueue_entry*> > fcallqueue;
   // number of blocks waiting to be deserialized + the number of
   // incomplete function calls
   atomic<size_t> fcallqueue_length;
@@ -260,6 +290,9 @@ class distributed_control{
   /// Number of machines
   procid_t localnumprocs;
 
+  /// The host (the address without the port) of each machine
+  std::vector<std::string> machine_hosts;
+
   std::vector<atomic<size_t> > global_calls_sent;
   std::vector<atomic<size_t> > global_calls_received;
 
@@ -425,6 +458,27 @@ class distributed_control{
    */
   static unsigned char get_sequentialization_key();
 
+  /**
+  \brief Sets whether the calls of this thread go on the urgent send
+  lane, returning the previous value.
+
+  Urgent calls are handed to the network before, and may overtake, the
+  regular calls made earlier by the same thread. They are sent without
+  waiting for the send buffers to fill. Control calls are always
+  urgent. Use this for small latency critical messages such as lock
+  grants; calls which must stay ordered with each other should be made
+  with the same setting.
+
+  \code
+  bool prev = distributed_control::set_urgent_send(true);
+  // ... latency critical calls
+  distributed_control::set_urgent_send(prev);
+  \endcode
+
+  The setting is <b>thread-local</b>.
+  */
+  static bool set_urgent_send(bool urgent);
+
 
 
 
@@ -758,9 +812,19 @@ class distributed_control{
   /**
    * \internal
    * Receive a collection of serialized function calls.
-   * This function will take ownership of the pointer
+   * This function will take ownership of the pointer. If shared_buffer
+   * is not NULL, buf points into it and the function takes one reference
+   * to it instead. The calls are deserialized in place.
    */
-  void deferred_function_call_chunk(char* buf, size_t len, procid_t src);
+  void deferred_function_call_chunk(char* buf, size_t len, procid_t src,
+                                    dc_impl::shared_receive_buffer* shared_buffer = NULL);
+
+  /// Releases the memory of a chunk once all its calls are complete
+  static void release_chunk(char* chunk_src,
+                            dc_impl::shared_receive_buffer* shared_buffer) {
+    if (shared_buffer != NULL) shared_buffer->release();
+    else free(chunk_src);
+  }
 
 
   /**
@@ -922,6 +986,21 @@ class distributed_control{
     return comm->network_bytes_sent();
   }
 
+  /** \brief Returns the profile of the calls received by this machine,
+   * or NULL if the rpc_profile init option is not set.
+   */
+  inline const dc_impl::rpc_profiler* get_rpc_profiler() const {
+    return profiler;
+  }
+
+  /** \brief Returns the total number of bytes handed to the network
+   * before wire compression. The compression ratio is this divided by
+   * network_bytes_sent().
+   */
+  inline size_t network_bytes_uncompressed() const {
+    return comm->network_bytes_uncompressed();
+  }
+
   /** \brief Returns the total number of megabytes sent including all headers
    * and other control overhead. Also see network_bytes_sent()
    */
@@ -942,6 +1021,38 @@ class distributed_control{
     return ret;
   }
 
+  /// \brief Returns the number of RPC calls sent to machine p
+  inline size_t calls_sent_to(procid_t p) const {
+    return global_calls_sent[p].value;
+  }
+
+  /// \brief Returns the number of RPC calls received from machine p
+  inline size_t calls_received_from(procid_t p) const {
+    return global_calls_received[p].value;
+  }
+
+  /** \brief Returns the number of bytes sent to machine p, excluding
+   * headers and other control overhead.
+   */
+  inline size_t bytes_sent_to(procid_t p) const {
+    return senders[p]->bytes_sent();
+  }
+
+  /** \brief Returns the number of bytes received from machine p,
+   * excluding headers and other control overhead.
+   */
+  inline size_t bytes_received_from(procid_t p) const {
+    return global_bytes_received[p].value;
+  }
+
+  /** \brief Returns the time the handler thread i spent running calls,
+   * in microseconds. Handler i runs the calls of the machines p with
+   * p % num_handler_threads() == i, on fiber worker i.
+   */
+  inline size_t handler_busy_usec(size_t i) const {
+    return fcall_handler_busy_usec[i].value;
+  }
+
   /// \cond GRAPHLAB_INTERNAL
 
   /// \internal
@@ -86,9 +86,29 @@ namespace dc_impl {
 
   size_t dc_buffered_stream_send2::get_outgoing_data(circular_iovec_buffer& outdata) {
     lock.lock();
+    size_t sendlen = extract_lane(thread_local_buffer::URGENT_LANE, outdata);
+    // hold back the bulk data while the comm is backed up so that the
+    // next urgent messages do not queue behind it
+    if (outdata.size() < SEND_LANE_BULK_BACKLOG) {
+      sendlen += extract_lane(thread_local_buffer::BULK_LANE, outdata);
+    }
+    for (size_t i = 0;i < additional_flush_buffers.size(); ++i) {
+      iovec sendvec;
+      sendvec.iov_base = additional_flush_buffers[i].first;
+      sendvec.iov_len = additional_flush_buffers[i].second;
+      sendlen += sendvec.iov_len;
+      outdata.write(sendvec);
+    }
+    additional_flush_buffers.clear();
+    lock.unlock();
+    return sendlen;
+  }
+
+  size_t dc_buffered_stream_send2::extract_lane(size_t lane,
+                                                circular_iovec_buffer& outdata) {
     size_t sendlen = 0;
     for (size_t i = 0;i < send_buffers.size(); ++i) {
-      std::pair<buffer_elem*, buffer_elem*> bufs = send_buffers[i]->extract(target);
+      std::pair<buffer_elem*, buffer_elem*> bufs = send_buffers[i]->extract(target, lane);
       if (bufs.first != NULL) {
         while(bufs.first != bufs.second) {
           buffer_elem* prev = bufs.first;
@@ -107,14 +127,6 @@ namespace dc_impl {
         }
       }
     }
-    for (size_t i = 0;i < additional_flush_buffers.size(); ++i) {
-      iovec sendvec;
-      sendvec.iov_base = additional_flush_buffers[i].first;
-      sendvec.iov_len = additional_flush_buffers[i].second;
-      sendlen += sendvec.iov_len;
-      outdata.write(sendvec);
-    }
-    lock.unlock();
     return sendlen;
   }
 } // namespace dc_impl
@@ -52,6 +52,9 @@ Sender for the dc class.
   queue with one call per queue entry.
   A seperate thread is used to transmit queue entries. Rudimentary
   write combining is used to decrease transmission overhead.
+  The urgent lane of the thread local buffers is always handed out
+  before the bulk lane, and the bulk lane is held back while the comm
+  has SEND_LANE_BULK_BACKLOG blocks queued.
   This is typically the best performing sender.
 
   This can be enabled by passing "buffered_queued_send=yes"
@@ -101,6 +104,9 @@ class dc_buffered_stream_send2: public dc_send{
 
   std::vector<std::pair<char*, size_t> > additional_flush_buffers;
   mutex lock;
+
+  /// moves the data of one lane of all the send buffers into outdata
+  size_t extract_lane(size_t lane, circular_iovec_buffer& outdata);
 };
 
 
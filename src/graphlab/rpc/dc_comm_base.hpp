@@ -34,6 +34,16 @@
 namespace graphlab {
 namespace dc_impl {  
 
+/**
+ * \ingroup rpc
+ * \internal
+ * If set, the comms call this with the id of a machine when the
+ * connection to it fails, before giving up on the job. A handler which
+ * recovers from the failure (see init_param_from_zookeeper()) does not
+ * return.
+ */
+extern void (*comm_failure_handler)(procid_t);
+
   
 /**
  * \ingroup rpc
@@ -87,6 +97,7 @@ class dc_comm_base {
   
   virtual size_t network_bytes_sent() const = 0;
   virtual size_t network_bytes_received() const = 0;
+  virtual size_t network_bytes_uncompressed() const = 0;
   virtual size_t send_queue_length() const = 0;
 
 };
@@ -30,14 +30,62 @@
   \def RPC_DEFAULT_COMMTYPE
   \brief default communication method
  */
+#ifndef RPC_DEFAULT_COMMTYPE
 #define RPC_DEFAULT_COMMTYPE TCP_COMM
+#endif
 
 /**
   \ingroup rpc
   \def RPC_MAX_N_PROCS
-  \brief Maximum number of processes supported
+  \brief Maximum number of processes a distributed graph supports.
+
+  This is the width of the per vertex mirror bitsets, so it costs
+  RPC_MAX_N_PROCS / 8 bytes per vertex replica. The RPC layer itself only
+  sizes its per machine state at runtime and is limited by procid_t.
+  Build with -DRPC_MAX_N_PROCS=N to run graphs on more processes.
  */
+#ifndef RPC_MAX_N_PROCS
 #define RPC_MAX_N_PROCS 128
+#endif
+
+/**
+ * \ingroup RPC
+ * \def RPC_DEFAULT_SOCKETS_PER_PEER
+ * The number of TCP sockets opened to each machine unless the
+ * "sockets_per_peer" init option is given. More sockets give each
+ * connection its own congestion window and receive thread, which is
+ * needed to fill fast NICs.
+ */
+#ifndef RPC_DEFAULT_SOCKETS_PER_PEER
+#define RPC_DEFAULT_SOCKETS_PER_PEER 1
+#endif
+
+/**
+  \ingroup rpc
+  \def RPC_MAX_SOCKETS_PER_PEER
+  \brief Maximum number of TCP sockets to each machine
+ */
+#define RPC_MAX_SOCKETS_PER_PEER 8
+
+/**
+  \ingroup rpc
+  \def RPC_CONNECT_THREADS
+  \brief The number of machines a machine connects to at once during
+  startup
+ */
+#ifndef RPC_CONNECT_THREADS
+#define RPC_CONNECT_THREADS 32
+#endif
+
+/**
+  \ingroup rpc
+  \def RPC_CONNECT_TIMEOUT
+  \brief The seconds a machine keeps retrying to connect to a machine
+  which is not listening yet. The retries back off from 10ms to 1s.
+ */
+#ifndef RPC_CONNECT_TIMEOUT
+#define RPC_CONNECT_TIMEOUT 60
+#endif
 
 /**
  * \ingroup RPC
@@ -46,6 +94,17 @@
  */
 #define RECEIVE_BUFFER_SIZE 131072
 
+/**
+ * \ingroup RPC
+ * \def RECEIVE_BUFFER_MIN_FREE
+ * Received messages are deserialized in place from the receive buffer,
+ * and new data is appended to the same buffer. A new buffer is started
+ * when less than this many bytes are free.
+ */
+#ifndef RECEIVE_BUFFER_MIN_FREE
+#define RECEIVE_BUFFER_MIN_FREE 8192
+#endif
+
 /**************************************************************************/
 /*                                                                        */
 /*                      Send Buffer Behavior Control                      */
@@ -72,6 +131,47 @@
 #define SEND_POLL_TIMEOUT 10000
 
 
+/**
+ * \ingroup rpc
+ * \def RPC_USE_SHM_TRANSPORT
+ * If true, the TCP comm streams the data to machines on the same host
+ * (with the same address) through shared memory rings instead of
+ * loopback sockets. Can be changed with the "shm" init option.
+ */
+#ifndef RPC_USE_SHM_TRANSPORT
+#define RPC_USE_SHM_TRANSPORT true
+#endif
+
+/**
+ * \ingroup rpc
+ * \def RPC_SHM_RING_SIZE
+ * The size in bytes of the shared memory ring from one process to
+ * another on the same host.
+ */
+#ifndef RPC_SHM_RING_SIZE
+#define RPC_SHM_RING_SIZE (4 * 1024 * 1024)
+#endif
+
+/**
+ * \ingroup rpc
+ * \def RPC_SHM_IDLE_SLEEP
+ * The shared memory receive thread sleeps for this many microseconds
+ * between polls once RPC_SHM_SPIN_POLLS polls found no data.
+ */
+#ifndef RPC_SHM_IDLE_SLEEP
+#define RPC_SHM_IDLE_SLEEP 50
+#endif
+
+/**
+ * \ingroup rpc
+ * \def RPC_SHM_SPIN_POLLS
+ * The number of empty polls of the shared memory rings before the
+ * receive thread starts sleeping.
+ */
+#ifndef RPC_SHM_SPIN_POLLS
+#define RPC_SHM_SPIN_POLLS 1000
+#endif
+
 /**
  * \ingroup rpc
  * \def INITIAL_BUFFER_SIZE
@@ -87,6 +187,19 @@
  */
 #define FULL_BUFFER_SIZE_LIMIT 63000
 
+/**
+ * \ingroup RPC
+ * \def SEND_LANE_BULK_BACKLOG
+ * The senders keep bulk data in the thread local buffers while the
+ * comm layer has more than this many blocks queued to a machine, so
+ * that urgent lane messages (control calls and sends marked with
+ * distributed_control::set_urgent_send()) only wait behind a
+ * bounded amount of bulk data.
+ */
+#ifndef SEND_LANE_BULK_BACKLOG
+#define SEND_LANE_BULK_BACKLOG 8
+#endif
+
 /**
  * \ingroup RPC
  * \def NUM_FULL_BUFFER_LIMIT 
@@ -94,6 +207,51 @@
  */
 #define NUM_FULL_BUFFER_LIMIT 32 
 
+/**
+ * \ingroup RPC
+ * \def WIRE_COMPRESSION_THRESHOLD
+ * When wire compression is turned on (the "compress" init option),
+ * flushes of at least this many bytes are compressed before they are
+ * sent. Smaller flushes are latency bound and are sent as is.
+ */
+#define WIRE_COMPRESSION_THRESHOLD 65536
+
+/**
+ * \ingroup RPC
+ * \def WIRE_COMPRESSION_MIN_SAVING
+ * A compressed block is only sent if it is at least this many percent
+ * smaller than the original.
+ */
+#define WIRE_COMPRESSION_MIN_SAVING 10
+
+/**
+ * \ingroup RPC
+ * \def WIRE_COMPRESSION_BACKOFF
+ * After a block fails to compress well, this many of the following
+ * large blocks to the same machine are sent without trying.
+ */
+#define WIRE_COMPRESSION_BACKOFF 16
+
+/**
+ * \ingroup RPC
+ * \def IBV_NUM_SLOTS
+ * The number of registered send and receive buffers of each InfiniBand
+ * queue pair (see dc_ibv_comm).
+ */
+#ifndef IBV_NUM_SLOTS
+#define IBV_NUM_SLOTS 64
+#endif
+
+/**
+ * \ingroup RPC
+ * \def IBV_SLOT_SIZE
+ * The size in bytes of each registered InfiniBand buffer. This is the
+ * largest message posted to the hardware.
+ */
+#ifndef IBV_SLOT_SIZE
+#define IBV_SLOT_SIZE 65536
+#endif
+
 /**************************************************************************/
 /*                                                                        */
 /*                          RPC Handling Control                          */
@@ -145,5 +303,48 @@
  */
 #define DEFAULT_BUFFERED_EXCHANGE_SIZE FULL_BUFFER_SIZE_LIMIT
 
+/**
+ * \ingroup RPC
+ * \def DEFAULT_EXCHANGE_TARGET_LATENCY_MS
+ * The default time in milliseconds a buffered exchange send buffer may
+ * hold data before it is sent. Also sets the adaptive buffer size
+ * limits (see exchange_flush_policy). 0 disables the adaptation.
+ */
+#ifndef DEFAULT_EXCHANGE_TARGET_LATENCY_MS
+#define DEFAULT_EXCHANGE_TARGET_LATENCY_MS 100
+#endif
+
+/**
+ * \ingroup RPC
+ * \def DEFAULT_EXCHANGE_MIN_BUFFER_SIZE
+ * The default smallest adaptive size limit of a buffered exchange send
+ * buffer.
+ */
+#ifndef DEFAULT_EXCHANGE_MIN_BUFFER_SIZE
+#define DEFAULT_EXCHANGE_MIN_BUFFER_SIZE 4096
+#endif
+
+/**
+ * \ingroup RPC
+ * \def DEFAULT_BUFFERED_EXCHANGE_COMPACT
+ * If true, the buffered exchanges serialize their values with compact
+ * archives, writing integers and container lengths as varints (see
+ * oarchive::compact). Vertex ids and counts are mostly small, so this
+ * shrinks most ingress and engine exchanges.
+ */
+#ifndef DEFAULT_BUFFERED_EXCHANGE_COMPACT
+#define DEFAULT_BUFFERED_EXCHANGE_COMPACT true
+#endif
+
+/**
+ * \ingroup RPC
+ * \def ASYNC_COLLECTIVE_STACK_SIZE
+ * The stack size of the fibers which run the asynchronous collectives
+ * of dc_dist_object (async_barrier(), async_all_reduce() ...)
+ */
+#ifndef ASYNC_COLLECTIVE_STACK_SIZE
+#define ASYNC_COLLECTIVE_STACK_SIZE 65536
+#endif
+
 
 #endif
@@ -28,10 +28,15 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <map>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/parallel/fiber_conditional.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_dist_object_base.hpp>
+#include <graphlab/rpc/collective_tree.hpp>
+#include <graphlab/rpc/request_future.hpp>
+#include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/parallel/fiber_remote_request.hpp>
 #include <graphlab/rpc/object_request_issue.hpp>
 #include <graphlab/rpc/object_call_issue.hpp>
 #include <graphlab/rpc/object_broadcast_issue.hpp>
@@ -39,6 +44,7 @@
 #include <graphlab/rpc/mem_function_arg_types_def.hpp>
 #include <graphlab/util/charstream.hpp>
 #include <boost/preprocessor.hpp>
+#include <boost/bind.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/rpc/request_reply_handler.hpp>
 #include <graphlab/macros_def.hpp>
@@ -127,6 +133,7 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
 
 
   DECLARE_TRACER(distobj_remote_call_time);
+  DECLARE_TRACER(distobj_remote_request_time);
 
 
  public:
@@ -209,6 +216,7 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
     recv_froms.resize(dc_.numprocs());
     //------ Initialize the gatherer ------
     gather_receive.resize(dc_.numprocs());
+    collective_seq = 0;
 
 
     //------- Initialize the Barrier ----------
@@ -217,23 +225,16 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
     barrier_release = -1;
 
 
-    // compute my children
-    childbase = size_t(dc_.procid()) * BARRIER_BRANCH_FACTOR + 1;
-    if (childbase >= dc_.numprocs()) {
-      numchild = 0;
-    }
-    else {
-      size_t maxchild = std::min<size_t>(dc_.numprocs(),
-                                         childbase + BARRIER_BRANCH_FACTOR);
-      numchild = (procid_t)(maxchild - childbase);
-    }
-
-    parent =  (procid_t)((dc_.procid() - 1) / BARRIER_BRANCH_FACTOR)   ;
+    // compute my parent and children
+    dc_impl::build_collective_tree(dc_.machine_hosts, dc_.procid(),
+                                   BARRIER_BRANCH_FACTOR, parent, children);
+    numchild = (procid_t)children.size();
 
     //-------- Initialize all gather --------------
     ab_child_barrier_counter.value = 0;
     ab_barrier_sense = 1;
     ab_barrier_release = -1;
+    ab_children_data.resize(numchild);
 
 
     //-------- Initialize the full barrier ---------
@@ -249,6 +250,9 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
     std::string name = typeid(T).name();
     INITIALIZE_TRACER(distobj_remote_call_time,
                       std::string("dc_dist_object ") + name + ": remote_call time");
+    INITIALIZE_TRACER(distobj_remote_request_time,
+                      std::string("dc_dist_object ") + name +
+                      ": remote_request round trip time");
   }
 
   /// \brief The number of function calls received by this object
@@ -475,7 +479,10 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
     BOOST_PP_TUPLE_ELEM(2,0,ARGS) (procid_t target, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
     ASSERT_LT(target, dc_.senders.size()); \
     request_future<__GLRPC_FRESULT> reply;      \
+    BEGIN_TRACEPOINT(distobj_remote_request_time); \
     custom_remote_request(target, reply.get_handle(),BOOST_PP_TUPLE_ELEM(2,1,ARGS), remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENI ,_) ); \
+    reply.wait(); \
+    END_TRACEPOINT(distobj_remote_request_time); \
     return reply(); \
   }
 
@@ -994,7 +1001,7 @@ private:
   /// condition variable and mutex protecting the barrier variables
   fiber_conditional ab_barrier_cond;
   mutex ab_barrier_mut;
-  std::string ab_children_data[BARRIER_BRANCH_FACTOR];
+  std::vector<std::string> ab_children_data;
   std::string ab_alldata;
 
   /**
@@ -1002,10 +1009,10 @@ private:
   */
   void __ab_child_to_parent_barrier_trigger(procid_t source, std::string collect) {
     ab_barrier_mut.lock();
-    // assert childbase <= source <= childbase + BARRIER_BRANCH_FACTOR
-    ASSERT_GE(source, childbase);
-    ASSERT_LT(source, childbase + BARRIER_BRANCH_FACTOR);
-    ab_children_data[source - childbase] = collect;
+    const size_t child = std::find(children.begin(), children.end(), source)
+                         - children.begin();
+    ASSERT_LT(child, children.size());
+    ab_children_data[child] = collect;
     ab_child_barrier_counter.inc(ab_barrier_sense);
     ab_barrier_cond.signal();
     ab_barrier_mut.unlock();
@@ -1024,14 +1031,14 @@ private:
     ab_alldata = allstrings;
     for (procid_t i = 0;i < numchild; ++i) {
       if (use_control_calls) {
-        internal_control_call((procid_t)(childbase + i),
+        internal_control_call(children[i],
                               &dc_dist_object<T>::__ab_parent_to_child_barrier_release,
                               releaseval,
                               ab_alldata,
                               use_control_calls);
       }
       else {
-        internal_call((procid_t)(childbase + i),
+        internal_call(children[i],
                       &dc_dist_object<T>::__ab_parent_to_child_barrier_release,
                       releaseval,
                       ab_alldata,
@@ -1071,7 +1078,7 @@ private:
           // collect all my children data
           charstream strstrm(128);
           oarchive oarc2(strstrm);
-          oarc2 << std::string(strm->c_str(), strm->size());
+          oarc2 << procid() << std::string(strm->c_str(), strm->size());
           for (procid_t i = 0;i < numchild; ++i) {
             strstrm.write(ab_children_data[i].c_str(), ab_children_data[i].length());
           }
@@ -1102,15 +1109,15 @@ private:
       // build the downward data
       charstream strstrm(128);
       oarchive oarc2(strstrm);
-      oarc2 << std::string(strm->c_str(), strm->size());
+      oarc2 << procid() << std::string(strm->c_str(), strm->size());
       for (procid_t i = 0;i < numchild; ++i) {
         strstrm.write(ab_children_data[i].c_str(), ab_children_data[i].length());
       }
       strstrm.flush();
       ab_alldata = std::string(strstrm->c_str(), strstrm->size());
       for (procid_t i = 0;i < numchild; ++i) {
-        logger(LOG_DEBUG, "Sending AB release to %d", childbase + i);
-        internal_control_call((procid_t)(childbase + i),
+        logger(LOG_DEBUG, "Sending AB release to %d", children[i]);
+        internal_control_call(children[i],
                              &dc_dist_object<T>::__ab_parent_to_child_barrier_release,
                              ab_barrier_val,
                              ab_alldata,
@@ -1130,52 +1137,18 @@ private:
     ab_barrier_mut.unlock();
 
     logger(LOG_DEBUG, "barrier phase 2 complete");
-    // now the data is a DFS search of a heap
-    // I need to unpack it
-    size_t heappos = 0;
+    // now the data is a sequence of (procid, serialized value) pairs
     std::stringstream istrm(local_ab_alldata);
     iarchive iarc(istrm);
 
     for (size_t i = 0;i < numprocs(); ++i) {
+      procid_t source;
       std::string s;
-      iarc >> s;
+      iarc >> source >> s;
 
       std::stringstream strm2(s);
       iarchive iarc2(strm2);
-      iarc2 >> data[heappos];
-
-      if (i + 1 == numprocs()) break;
-      // advance heappos
-      // leftbranch
-      bool lefttraverseblock = false;
-      while (1) {
-        // can we continue going deaper down the left?
-        size_t leftbranch = heappos * BARRIER_BRANCH_FACTOR + 1;
-        if (lefttraverseblock == false && leftbranch < numprocs()) {
-          heappos = leftbranch;
-          break;
-        }
-        // ok. can't go down the left
-        bool this_is_a_right_branch = (((heappos - 1) % BARRIER_BRANCH_FACTOR) == BARRIER_BRANCH_FACTOR - 1);
-        // if we are a left branch, go to sibling
-        if (this_is_a_right_branch == false) {
-          size_t sibling = heappos + 1;
-          if (sibling < numprocs()) {
-            heappos = sibling;
-            break;
-          }
-        }
-
-        // we have finished this subtree, go back up to parent
-        // and block the depth traversal on the next round
-        // unless heappos is 0
-
-        heappos = (heappos - 1) / BARRIER_BRANCH_FACTOR;
-        lefttraverseblock = true;
-        continue;
-        // go to sibling
-      }
-
+      iarc2 >> data[source];
     }
   }
 
@@ -1250,7 +1223,7 @@ private:
       ostrm.flush();
       ab_alldata = std::string(ostrm->c_str(), ostrm->size());
       for (procid_t i = 0;i < numchild; ++i) {
-        internal_control_call((procid_t)(childbase + i),
+        internal_control_call(children[i],
                              &dc_dist_object<T>::__ab_parent_to_child_barrier_release,
                              ab_barrier_val,
                              ab_alldata,
@@ -1296,6 +1269,56 @@ private:
     all_reduce2(data, default_plus_equal<U>(), control);
   }
 
+  /**
+   * \brief An all_reduce by recursive doubling for large values.
+   *
+   * Has the same effect as all_reduce2(), but instead of sending every
+   * value up and the result down the tree, pairs of machines exchange
+   * and combine their partial results in log2(numprocs()) rounds. No
+   * machine ever sends or combines more than one value per round, which
+   * avoids the bottleneck at the top of the tree when the values are
+   * large. For small values, all_reduce2() has lower latency.
+   * plusequal is applied so that the lower numbered machine is always on
+   * the left, hence every machine ends with exactly the same value.
+   */
+  template <typename U, typename PlusEqual>
+  void all_reduce_doubling(U& data, PlusEqual plusequal, bool control = false) {
+    if (numprocs() == 1) return;
+    const size_t seq = collective_seq++;
+    // the largest power of 2 not larger than numprocs
+    size_t p2 = 1;
+    while (2 * p2 <= numprocs()) p2 *= 2;
+    // machines beyond p2 fold their value into a partner below p2
+    // and receive the result at the end
+    if (procid() >= p2) {
+      const procid_t partner = (procid_t)(procid() - p2);
+      collective_send_value(partner, seq, data, control);
+      collective_receive_value(partner, seq, data);
+      return;
+    }
+    const bool has_extra = procid() + p2 < numprocs();
+    if (has_extra) {
+      U tmp;
+      collective_receive_value((procid_t)(procid() + p2), seq, tmp);
+      plusequal(data, tmp);
+    }
+    for (size_t mask = 1; mask < p2; mask *= 2) {
+      const procid_t partner = (procid_t)(procid() ^ mask);
+      collective_send_value(partner, seq, data, control);
+      U tmp;
+      collective_receive_value(partner, seq, tmp);
+      if (partner < procid()) {
+        plusequal(tmp, data);
+        data = tmp;
+      } else {
+        plusequal(data, tmp);
+      }
+    }
+    if (has_extra) {
+      collective_send_value((procid_t)(procid() + p2), seq, data, control);
+    }
+  }
+
 ////////////////////////////////////////////////////////////////////////////
 
 
@@ -1303,45 +1326,284 @@ private:
                       Implementation of All Scatter
  *****************************************************************************/
 
-  template <typename U>
-  void all_to_all(std::vector<U>& data, bool control = false) {
-    ASSERT_EQ(data.size(), numprocs());
-    for (size_t i = 0;i < data.size(); ++i) {
+  /**
+   * \brief An all to all exchange which serializes directly into the send
+   * buffers.
+   *
+   * write(i, oarc) is called once for every machine i other than this
+   * one to serialize the message to machine i into oarc. When all the
+   * messages have arrived, read(i, iarc) is called once for every machine
+   * i other than this one with an iarchive over the message received from
+   * machine i. The iarchive points into an internal buffer which is only
+   * valid during the call. All machines must call this function.
+   */
+  template <typename Serializer, typename Deserializer>
+  void all_to_all_archives(Serializer& write, Deserializer& read,
+                           bool control = false) {
+    const size_t seq = collective_seq++;
+    for (procid_t i = 0;i < numprocs(); ++i) {
       if (i != procid()) {
-        std::stringstream strm( std::ios::out | std::ios::binary );
-        oarchive oarc(strm);
-        oarc << data[i];
-        strm.flush();
-        if (control == false) {
-          internal_call(i,
-                        &dc_dist_object<T>::set_gather_receive,
-                        procid(),
-                        strm.str(),
-                        gatherid.value);
-        }
-        else {
-          internal_control_call(i,
-                                &dc_dist_object<T>::set_gather_receive,
-                                procid(),
-                                strm.str(),
-                                gatherid.value);
-        }
+        oarchive* oarc = collective_begin(seq);
+        write(i, *oarc);
+        collective_end(i, oarc, control);
       }
     }
-    full_barrier();
-    for (size_t i = 0; i < data.size(); ++i) {
+    std::vector<char> buf;
+    for (procid_t i = 0;i < numprocs(); ++i) {
       if (i != procid()) {
-        std::stringstream strm(gather_receive[i],
-                               std::ios::in | std::ios::binary);
-        assert(strm.good());
-        iarchive iarc(strm);
-        iarc >> data[i];
+        collective_wait(i, seq, buf);
+        iarchive iarc(buf.empty() ? NULL : &buf[0], buf.size());
+        read(i, iarc);
       }
     }
-    gatherid.inc();
+  }
+
+  /**
+   * \brief Exchanges entry i of data with machine i.
+   *
+   * data must have numprocs() entries. On return, data[i] holds the entry
+   * which machine i had at position procid(). All machines must call this
+   * function.
+   */
+  template <typename U>
+  void all_to_all(std::vector<U>& data, bool control = false) {
+    ASSERT_EQ(data.size(), numprocs());
+    vector_writer<U> write(data);
+    vector_reader<U> read(data);
+    all_to_all_archives(write, read, control);
     barrier();
   }
 
+  /**
+   * \brief An all_gather which serializes the local value only once and
+   * deserializes the received values directly from the receive buffers.
+   *
+   * Has the same effect as all_gather(), but uses a single round of
+   * direct messages instead of a reduction tree, trading numprocs()
+   * messages per machine for the removal of all intermediate copies.
+   * Vectors of POD types are copied with a single memcpy on each side.
+   * Best suited to small and medium numbers of machines.
+   */
+  template <typename U>
+  void all_gather_direct(std::vector<U>& data, bool control = false) {
+    ASSERT_EQ(data.size(), numprocs());
+    if (numprocs() == 1) return;
+    oarchive local;
+    local << data[procid()];
+    repeat_writer write(local);
+    vector_reader<U> read(data);
+    all_to_all_archives(write, read, control);
+    free(local.buf);
+  }
+
+ private:
+  /**
+   * The number of direct message collectives started by this object.
+   * All machines start them in the same order, so the value identifies
+   * the collective a message belongs to.
+   */
+  size_t collective_seq;
+  /// Received collective messages indexed by (source, collective_seq)
+  std::map<std::pair<procid_t, size_t>, std::vector<char> > collective_inbox;
+  fiber_conditional collective_cond;
+  mutex collective_mut;
+
+  oarchive* collective_begin(size_t seq) {
+    oarchive* oarc = dc_impl::object_split_call<dc_dist_object<T>,
+        void (dc_dist_object<T>::*)(size_t, wild_pointer)>::
+        split_call_begin(this, control_obj_id,
+                         &dc_dist_object<T>::collective_receive);
+    (*oarc) << procid() << seq;
+    return oarc;
+  }
+
+  void collective_end(procid_t target, oarchive* oarc, bool control) {
+    if (control == false) inc_calls_sent(target);
+    dc_impl::object_split_call<dc_dist_object<T>,
+        void (dc_dist_object<T>::*)(size_t, wild_pointer)>::
+        split_call_end(this, oarc, dc_.senders[target], target,
+                       control ? (STANDARD_CALL | CONTROL_PACKET)
+                               : STANDARD_CALL);
+  }
+
+  /// Waits for the message of collective seq from source and moves it to buf
+  void collective_wait(procid_t source, size_t seq, std::vector<char>& buf) {
+    const std::pair<procid_t, size_t> key(source, seq);
+    collective_mut.lock();
+    typename std::map<std::pair<procid_t, size_t>,
+                      std::vector<char> >::iterator iter;
+    while ((iter = collective_inbox.find(key)) == collective_inbox.end()) {
+      collective_cond.wait(collective_mut);
+    }
+    buf.swap(iter->second);
+    collective_inbox.erase(iter);
+    collective_mut.unlock();
+  }
+
+  void collective_receive(size_t len, wild_pointer w) {
+    const char* ptr = reinterpret_cast<const char*>(w.ptr);
+    iarchive iarc(ptr, len);
+    procid_t source;
+    size_t seq;
+    iarc >> source >> seq;
+    ASSERT_LT(source, numprocs());
+    std::vector<char> buf(ptr + iarc.off, ptr + len);
+    collective_mut.lock();
+    collective_inbox[std::make_pair(source, seq)].swap(buf);
+    collective_cond.signal();
+    collective_mut.unlock();
+  }
+
+  template <typename U>
+  void collective_send_value(procid_t target, size_t seq, const U& data,
+                             bool control) {
+    oarchive* oarc = collective_begin(seq);
+    (*oarc) << data;
+    collective_end(target, oarc, control);
+  }
+
+  template <typename U>
+  void collective_receive_value(procid_t source, size_t seq, U& data) {
+    std::vector<char> buf;
+    collective_wait(source, seq, buf);
+    iarchive iarc(buf.empty() ? NULL : &buf[0], buf.size());
+    iarc >> data;
+  }
+
+  /// Serializes entry i of a vector for all_to_all()
+  template <typename U>
+  struct vector_writer {
+    std::vector<U>& data;
+    vector_writer(std::vector<U>& data): data(data) { }
+    void operator()(procid_t i, oarchive& oarc) { oarc << data[i]; }
+  };
+
+  /// Deserializes entry i of a vector for all_to_all() and all_gather_direct()
+  template <typename U>
+  struct vector_reader {
+    std::vector<U>& data;
+    vector_reader(std::vector<U>& data): data(data) { }
+    void operator()(procid_t i, iarchive& iarc) { iarc >> data[i]; }
+  };
+
+  /// Writes the same serialized bytes to every machine for all_gather_direct()
+  struct repeat_writer {
+    const oarchive& src;
+    repeat_writer(const oarchive& src): src(src) { }
+    void operator()(procid_t i, oarchive& oarc) { oarc.write(src.buf, src.off); }
+  };
+
+ public:
+
+/*****************************************************************************
+                      Implementation of Asynchronous Collectives
+ *****************************************************************************/
+
+  /**
+   * \brief A barrier which returns immediately.
+   *
+   * The barrier runs in a fiber, and is complete when the returned
+   * future is ready. Waiting on the future from within a fiber
+   * deschedules the fiber instead of blocking the worker thread.
+   *
+   * Like all the async_ collectives, the future must be waited on before
+   * any other collective of this object is started, and before the
+   * future is destroyed.
+   */
+  request_future<void> async_barrier() {
+    fiber_reply_container* reply = new fiber_reply_container;
+    fiber_control::get_instance().launch(
+        boost::bind(&dc_dist_object<T>::async_barrier_fiber, this, reply),
+        ASYNC_COLLECTIVE_STACK_SIZE);
+    return request_future<void>(reply);
+  }
+
+  /**
+   * \brief An all_reduce which returns immediately.
+   *
+   * Returns a future for the sum of data over all machines.
+   * See async_barrier() for the restrictions on the future.
+   */
+  template <typename U>
+  request_future<U> async_all_reduce(const U& data, bool control = false) {
+    fiber_reply_container* reply = new fiber_reply_container;
+    fiber_control::get_instance().launch(
+        boost::bind(&dc_dist_object<T>::template async_all_reduce_fiber<U>,
+                    this, data, reply, control),
+        ASYNC_COLLECTIVE_STACK_SIZE);
+    return request_future<U>(reply);
+  }
+
+  /**
+   * \brief An all_gather which returns immediately.
+   *
+   * Returns a future for data with every entry filled by the machine of
+   * that index. See async_barrier() for the restrictions on the future.
+   */
+  template <typename U>
+  request_future<std::vector<U> >
+  async_all_gather(const std::vector<U>& data, bool control = false) {
+    fiber_reply_container* reply = new fiber_reply_container;
+    fiber_control::get_instance().launch(
+        boost::bind(&dc_dist_object<T>::template async_all_gather_fiber<U>,
+                    this, data, reply, control),
+        ASYNC_COLLECTIVE_STACK_SIZE);
+    return request_future<std::vector<U> >(reply);
+  }
+
+  /**
+   * \brief A broadcast which returns immediately.
+   *
+   * Returns a future for the data of the originator. See async_barrier()
+   * for the restrictions on the future.
+   */
+  template <typename U>
+  request_future<U> async_broadcast(const U& data, bool originator,
+                                    bool control = false) {
+    fiber_reply_container* reply = new fiber_reply_container;
+    fiber_control::get_instance().launch(
+        boost::bind(&dc_dist_object<T>::template async_broadcast_fiber<U>,
+                    this, data, originator, reply, control),
+        ASYNC_COLLECTIVE_STACK_SIZE);
+    return request_future<U>(reply);
+  }
+
+ private:
+  /// Serializes value into the reply of an async collective
+  template <typename U>
+  void async_collective_reply(fiber_reply_container* reply, const U& value) {
+    oarchive oarc;
+    oarc << value;
+    reply->receive(procid(), dc_impl::blob(oarc.buf, oarc.off));
+  }
+
+  void async_barrier_fiber(fiber_reply_container* reply) {
+    barrier();
+    reply->receive(procid(), dc_impl::blob());
+  }
+
+  template <typename U>
+  void async_all_reduce_fiber(U data, fiber_reply_container* reply,
+                              bool control) {
+    all_reduce(data, control);
+    async_collective_reply(reply, data);
+  }
+
+  template <typename U>
+  void async_all_gather_fiber(std::vector<U> data,
+                              fiber_reply_container* reply, bool control) {
+    all_gather(data, control);
+    async_collective_reply(reply, data);
+  }
+
+  template <typename U>
+  void async_broadcast_fiber(U data, bool originator,
+                             fiber_reply_container* reply, bool control) {
+    broadcast(data, originator, control);
+    async_collective_reply(reply, data);
+  }
+
+ public:
 
 /*****************************************************************************
                       Implementation of Barrier
@@ -1364,7 +1626,7 @@ private:
   fiber_conditional barrier_cond;
   mutex barrier_mut;
   procid_t parent;  /// parent node
-  size_t childbase; /// id of my first child
+  std::vector<procid_t> children; /// my children, see build_collective_tree()
   procid_t numchild;  /// number of children
 
 
@@ -1375,9 +1637,8 @@ private:
   */
   void __child_to_parent_barrier_trigger(procid_t source) {
     barrier_mut.lock();
-    // assert childbase <= source <= childbase + BARRIER_BRANCH_FACTOR
-    ASSERT_GE(source, childbase);
-    ASSERT_LT(source, childbase + BARRIER_BRANCH_FACTOR);
+    ASSERT_TRUE(std::find(children.begin(), children.end(), source)
+                != children.end());
     child_barrier_counter.inc(barrier_sense);
     barrier_cond.signal();
     barrier_mut.unlock();
@@ -1392,7 +1653,7 @@ private:
     // get my largest child
     logger(LOG_DEBUG, "Barrier Release %d", releaseval);
     for (procid_t i = 0;i < numchild; ++i) {
-      internal_control_call((procid_t)(childbase + i),
+      internal_control_call(children[i],
                             &dc_dist_object<T>::__parent_to_child_barrier_release,
                             releaseval);
 
@@ -1436,7 +1697,7 @@ private:
       barrier_release = barrier_val;
 
       for (procid_t i = 0;i < numchild; ++i) {
-        internal_control_call((procid_t)(childbase + i),
+        internal_control_call(children[i],
                              &dc_dist_object<T>::__parent_to_child_barrier_release,
                              barrier_val);
 
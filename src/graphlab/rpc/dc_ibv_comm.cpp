@@ -0,0 +1,534 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifdef HAS_IBVERBS
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cstdlib>
+#include <cstring>
+
+#include <limits>
+#include <vector>
+#include <string>
+#include <map>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/rpc/dc_ibv_comm.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+  namespace dc_impl {
+
+    namespace {
+      /// writes all of len bytes to a blocking socket
+      void write_all(int fd, const void* buf, size_t len) {
+        const char* c = (const char*)buf;
+        while (len > 0) {
+          ssize_t ret = ::send(fd, c, len, 0);
+          if (ret <= 0) {
+            logstream(LOG_FATAL) << "send error: " << strerror(errno) << std::endl;
+          }
+          c += ret;
+          len -= ret;
+        }
+      }
+
+      /// reads all of len bytes from a blocking socket
+      void read_all(int fd, void* buf, size_t len) {
+        char* c = (char*)buf;
+        while (len > 0) {
+          ssize_t ret = ::recv(fd, c, len, 0);
+          if (ret <= 0) {
+            logstream(LOG_FATAL) << "receive error: " << strerror(errno) << std::endl;
+          }
+          c += ret;
+          len -= ret;
+        }
+      }
+    }
+
+    void dc_ibv_comm::init(const std::vector<std::string> &machines,
+                           const std::map<std::string,std::string> &initopts,
+                           procid_t curmachineid,
+                           std::vector<dc_receive*> receiver_,
+                           std::vector<dc_send*> sender_) {
+      curid = curmachineid;
+      ASSERT_LT(machines.size(), std::numeric_limits<procid_t>::max());
+      nprocs = (procid_t)(machines.size());
+      receiver = receiver_;
+      sender = sender_;
+      network_bytessent = 0;
+      network_bytesreceived = 0;
+      buffered_len = 0;
+      send_requested = false;
+      done = false;
+
+      open_device(initopts);
+      conn.resize(nprocs);
+      for (procid_t i = 0; i < nprocs; ++i) create_connection(i);
+
+      std::vector<qp_address> remote(nprocs);
+      exchange_addresses(machines, initopts, remote);
+      is_closed = false;
+
+      sendthread.launch(boost::bind(&dc_ibv_comm::send_loop, this));
+      recvthread.launch(boost::bind(&dc_ibv_comm::receive_loop, this));
+      logstream(LOG_INFO) << "InfiniBand comm of proc " << curid
+                          << " connected to " << nprocs << " machines" << std::endl;
+    }
+
+
+    void dc_ibv_comm::open_device(const std::map<std::string,std::string> &initopts) {
+      std::map<std::string, std::string>::const_iterator iter;
+      iter = initopts.find("ib_port");
+      if (iter != initopts.end()) ib_port = boost::lexical_cast<int>(iter->second);
+      iter = initopts.find("ib_gid_index");
+      if (iter != initopts.end()) gid_index = boost::lexical_cast<int>(iter->second);
+      std::string devname;
+      iter = initopts.find("ib_device");
+      if (iter != initopts.end()) devname = iter->second;
+
+      int numdevices = 0;
+      struct ibv_device** devices = ibv_get_device_list(&numdevices);
+      if (devices == NULL || numdevices == 0) {
+        logstream(LOG_FATAL) << "No InfiniBand devices found" << std::endl;
+      }
+      struct ibv_device* device = NULL;
+      for (int i = 0; i < numdevices; ++i) {
+        if (devname.empty() || devname == ibv_get_device_name(devices[i])) {
+          device = devices[i];
+          break;
+        }
+      }
+      if (device == NULL) {
+        logstream(LOG_FATAL) << "InfiniBand device " << devname
+                             << " not found" << std::endl;
+      }
+      logstream(LOG_INFO) << "Using InfiniBand device "
+                          << ibv_get_device_name(device) << std::endl;
+      context = ibv_open_device(device);
+      ibv_free_device_list(devices);
+      if (context == NULL) {
+        logstream(LOG_FATAL) << "Unable to open InfiniBand device" << std::endl;
+      }
+      if (ibv_query_port(context, ib_port, &port_attr) != 0) {
+        logstream(LOG_FATAL) << "Unable to query InfiniBand port "
+                             << ib_port << std::endl;
+      }
+      pd = ibv_alloc_pd(context);
+      recv_channel = ibv_create_comp_channel(context);
+      const int cqsize = nprocs * IBV_NUM_SLOTS;
+      send_cq = ibv_create_cq(context, cqsize, NULL, NULL, 0);
+      recv_cq = ibv_create_cq(context, cqsize, NULL, recv_channel, 0);
+      if (pd == NULL || recv_channel == NULL || send_cq == NULL || recv_cq == NULL) {
+        logstream(LOG_FATAL) << "Unable to allocate InfiniBand resources" << std::endl;
+      }
+      // the receive thread polls the channel with a timeout
+      int flags = fcntl(recv_channel->fd, F_GETFL);
+      fcntl(recv_channel->fd, F_SETFL, flags | O_NONBLOCK);
+    }
+
+
+    void dc_ibv_comm::create_connection(procid_t target) {
+      connection& c = conn[target];
+      const size_t buflen = IBV_NUM_SLOTS * IBV_SLOT_SIZE;
+      c.sendbuf = (char*)malloc(buflen);
+      c.recvbuf = (char*)malloc(buflen);
+      c.sendmr = ibv_reg_mr(pd, c.sendbuf, buflen, IBV_ACCESS_LOCAL_WRITE);
+      c.recvmr = ibv_reg_mr(pd, c.recvbuf, buflen, IBV_ACCESS_LOCAL_WRITE);
+      if (c.sendmr == NULL || c.recvmr == NULL) {
+        logstream(LOG_FATAL) << "Unable to register InfiniBand buffers" << std::endl;
+      }
+
+      struct ibv_qp_init_attr init_attr;
+      memset(&init_attr, 0, sizeof(init_attr));
+      init_attr.send_cq = send_cq;
+      init_attr.recv_cq = recv_cq;
+      init_attr.qp_type = IBV_QPT_RC;
+      init_attr.cap.max_send_wr = IBV_NUM_SLOTS;
+      init_attr.cap.max_recv_wr = IBV_NUM_SLOTS;
+      init_attr.cap.max_send_sge = 1;
+      init_attr.cap.max_recv_sge = 1;
+      c.qp = ibv_create_qp(pd, &init_attr);
+      if (c.qp == NULL) {
+        logstream(LOG_FATAL) << "Unable to create queue pair" << std::endl;
+      }
+
+      struct ibv_qp_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.qp_state = IBV_QPS_INIT;
+      attr.pkey_index = 0;
+      attr.port_num = ib_port;
+      attr.qp_access_flags = 0;
+      if (ibv_modify_qp(c.qp, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX |
+                        IBV_QP_PORT | IBV_QP_ACCESS_FLAGS) != 0) {
+        logstream(LOG_FATAL) << "Unable to initialize queue pair" << std::endl;
+      }
+      // receives must be posted before the remote can send
+      for (size_t i = 0; i < IBV_NUM_SLOTS; ++i) {
+        post_receive(target, i);
+        c.free_slots.push_back(i);
+      }
+
+      memset(&c.local, 0, sizeof(c.local));
+      c.local.id = curid;
+      c.local.lid = port_attr.lid;
+      c.local.qpn = c.qp->qp_num;
+      c.local.psn = lrand48() & 0xffffff;
+      if (gid_index >= 0 &&
+          ibv_query_gid(context, ib_port, gid_index, &c.local.gid) != 0) {
+        logstream(LOG_FATAL) << "Unable to read GID " << gid_index << std::endl;
+      }
+    }
+
+
+    void dc_ibv_comm::connect_qp(procid_t target, const qp_address& remote) {
+      connection& c = conn[target];
+      struct ibv_qp_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.qp_state = IBV_QPS_RTR;
+      attr.path_mtu = port_attr.active_mtu;
+      attr.dest_qp_num = remote.qpn;
+      attr.rq_psn = remote.psn;
+      attr.max_dest_rd_atomic = 1;
+      attr.min_rnr_timer = 12;
+      attr.ah_attr.dlid = remote.lid;
+      attr.ah_attr.port_num = ib_port;
+      if (gid_index >= 0) {
+        attr.ah_attr.is_global = 1;
+        attr.ah_attr.grh.hop_limit = 1;
+        attr.ah_attr.grh.dgid = remote.gid;
+        attr.ah_attr.grh.sgid_index = gid_index;
+      }
+      if (ibv_modify_qp(c.qp, &attr, IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU |
+                        IBV_QP_DEST_QPN | IBV_QP_RQ_PSN |
+                        IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER) != 0) {
+        logstream(LOG_FATAL) << "Unable to connect queue pair to "
+                             << target << std::endl;
+      }
+      memset(&attr, 0, sizeof(attr));
+      attr.qp_state = IBV_QPS_RTS;
+      attr.timeout = 14;
+      attr.retry_cnt = 7;
+      // retry forever if the remote has no receive posted
+      attr.rnr_retry = 7;
+      attr.sq_psn = c.local.psn;
+      attr.max_rd_atomic = 1;
+      if (ibv_modify_qp(c.qp, &attr, IBV_QP_STATE | IBV_QP_TIMEOUT |
+                        IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN |
+                        IBV_QP_MAX_QP_RD_ATOMIC) != 0) {
+        logstream(LOG_FATAL) << "Unable to activate queue pair to "
+                             << target << std::endl;
+      }
+    }
+
+
+    void dc_ibv_comm::exchange_addresses(const std::vector<std::string> &machines,
+                                         const std::map<std::string,std::string> &initopts,
+                                         std::vector<qp_address>& remote) {
+      std::vector<sockaddr_in> addrs(nprocs);
+      for (size_t i = 0;i < nprocs; ++i) {
+        size_t pos = machines[i].find(":");
+        ASSERT_NE(pos, std::string::npos);
+        std::string address = machines[i].substr(0, pos);
+        size_t port = boost::lexical_cast<size_t>(machines[i].substr(pos+1));
+        ASSERT_LT(port, 65536);
+        struct hostent* ent = gethostbyname(address.c_str());
+        ASSERT_TRUE(ent != NULL);
+        ASSERT_EQ(ent->h_length, 4);
+        memset(&addrs[i], 0, sizeof(sockaddr_in));
+        addrs[i].sin_family = AF_INET;
+        addrs[i].sin_port = htons(port);
+        addrs[i].sin_addr = *reinterpret_cast<struct in_addr*>(ent->h_addr_list[0]);
+      }
+
+      int listensock;
+      std::map<std::string, std::string>::const_iterator iter =
+        initopts.find("__sockhandle__");
+      if (iter != initopts.end()) {
+        listensock = atoi(iter->second.c_str());
+      } else {
+        listensock = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in my_addr = addrs[curid];
+        my_addr.sin_addr.s_addr = INADDR_ANY;
+        if (bind(listensock, (sockaddr*)&my_addr, sizeof(my_addr)) < 0) {
+          logstream(LOG_FATAL) << "bind: " << strerror(errno) << std::endl;
+        }
+      }
+      ASSERT_EQ(0, listen(listensock, 128));
+
+      // a machine connects to itself through the loopback
+      connect_qp(curid, conn[curid].local);
+      remote[curid] = conn[curid].local;
+
+      // Machines with lower ids connect to machines with higher ids.
+      // Every machine first serves all the lower ids, so the waits only
+      // ever point up and cannot deadlock.
+      for (procid_t i = 0; i < curid; ++i) {
+        int sock = accept(listensock, NULL, NULL);
+        if (sock < 0) {
+          logstream(LOG_FATAL) << "accept: " << strerror(errno) << std::endl;
+        }
+        qp_address addr;
+        read_all(sock, &addr, sizeof(addr));
+        ASSERT_LT(addr.id, curid);
+        remote[addr.id] = addr;
+        connect_qp(addr.id, addr);
+        write_all(sock, &conn[addr.id].local, sizeof(qp_address));
+        // wait until the other end is ready to receive too
+        char ready;
+        read_all(sock, &ready, 1);
+        ::close(sock);
+      }
+      for (procid_t i = curid + 1; i < nprocs; ++i) {
+        int sock = -1;
+        // retry 10 times at 1 second intervals
+        for (size_t j = 0;j < 10; ++j) {
+          sock = socket(AF_INET, SOCK_STREAM, 0);
+          if (::connect(sock, (sockaddr*)&addrs[i], sizeof(sockaddr_in)) == 0) break;
+          logstream(LOG_INFO) << "connect " << curid << " to " << i << ": "
+                              << strerror(errno) << ". Retrying...\n";
+          ::close(sock);
+          sock = -1;
+          timer::sleep(1);
+        }
+        if (sock < 0) {
+          logstream(LOG_FATAL) << "Failed to reach machine " << i << std::endl;
+        }
+        write_all(sock, &conn[i].local, sizeof(qp_address));
+        read_all(sock, &remote[i], sizeof(qp_address));
+        ASSERT_EQ(remote[i].id, i);
+        connect_qp(i, remote[i]);
+        char ready = 1;
+        write_all(sock, &ready, 1);
+        ::close(sock);
+      }
+      ::close(listensock);
+    }
+
+
+    void dc_ibv_comm::post_receive(procid_t target, size_t slot) {
+      connection& c = conn[target];
+      struct ibv_sge sge;
+      sge.addr = (uintptr_t)(c.recvbuf + slot * IBV_SLOT_SIZE);
+      sge.length = IBV_SLOT_SIZE;
+      sge.lkey = c.recvmr->lkey;
+      struct ibv_recv_wr wr;
+      memset(&wr, 0, sizeof(wr));
+      wr.wr_id = target * IBV_NUM_SLOTS + slot;
+      wr.sg_list = &sge;
+      wr.num_sge = 1;
+      struct ibv_recv_wr* bad_wr;
+      if (ibv_post_recv(c.qp, &wr, &bad_wr) != 0) {
+        logstream(LOG_FATAL) << "Unable to post receive" << std::endl;
+      }
+    }
+
+
+    void dc_ibv_comm::post_sends(procid_t target) {
+      connection& c = conn[target];
+      circular_iovec_buffer& outvec = c.outvec;
+      while (!outvec.empty() && !c.free_slots.empty()) {
+        const size_t slot = c.free_slots.back();
+        c.free_slots.pop_back();
+        char* buf = c.sendbuf + slot * IBV_SLOT_SIZE;
+        // pack as much of the pending data as fits into the slot
+        size_t len = 0;
+        while (!outvec.empty() && len < IBV_SLOT_SIZE) {
+          const iovec& vec = outvec.parallel_v[outvec.head];
+          if (vec.iov_len == 0) {
+            outvec.erase_from_head_and_free();
+            continue;
+          }
+          const size_t n = std::min<size_t>(vec.iov_len, IBV_SLOT_SIZE - len);
+          memcpy(buf + len, vec.iov_base, n);
+          len += n;
+          outvec.sent(n);
+        }
+        if (len == 0) {
+          c.free_slots.push_back(slot);
+          break;
+        }
+        struct ibv_sge sge;
+        sge.addr = (uintptr_t)buf;
+        sge.length = len;
+        sge.lkey = c.sendmr->lkey;
+        struct ibv_send_wr wr;
+        memset(&wr, 0, sizeof(wr));
+        wr.wr_id = target * IBV_NUM_SLOTS + slot;
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+        wr.opcode = IBV_WR_SEND;
+        wr.send_flags = IBV_SEND_SIGNALED;
+        struct ibv_send_wr* bad_wr;
+        if (ibv_post_send(c.qp, &wr, &bad_wr) != 0) {
+          logstream(LOG_FATAL) << "Unable to post send to " << target << std::endl;
+        }
+        network_bytessent.inc(len);
+      }
+    }
+
+
+    void dc_ibv_comm::poll_send_completions() {
+      struct ibv_wc wc[32];
+      int n;
+      while ((n = ibv_poll_cq(send_cq, 32, wc)) > 0) {
+        for (int i = 0; i < n; ++i) {
+          if (wc[i].status != IBV_WC_SUCCESS) {
+            logstream(LOG_FATAL) << "InfiniBand send failed: "
+                                 << ibv_wc_status_str(wc[i].status) << std::endl;
+          }
+          conn[wc[i].wr_id / IBV_NUM_SLOTS].free_slots.push_back(
+              wc[i].wr_id % IBV_NUM_SLOTS);
+        }
+      }
+    }
+
+
+    void dc_ibv_comm::trigger_send_timeout(procid_t target, bool urgent) {
+      send_lock.lock();
+      send_requested = true;
+      send_cond.signal();
+      send_lock.unlock();
+    }
+
+
+    void dc_ibv_comm::send_loop() {
+      logstream(LOG_INFO) << "Send loop Started" << std::endl;
+      while (1) {
+        send_lock.lock();
+        if (!send_requested && !done) {
+          send_cond.timedwait_ns(send_lock, SEND_POLL_TIMEOUT * 1000);
+        }
+        send_requested = false;
+        const bool quit = done;
+        send_lock.unlock();
+
+        poll_send_completions();
+        bool pending = false;
+        for (procid_t i = 0; i < nprocs; ++i) {
+          buffered_len.inc(sender[i]->get_outgoing_data(conn[i].outvec));
+          post_sends(i);
+          pending = pending || !conn[i].outvec.empty() ||
+                    conn[i].free_slots.size() < IBV_NUM_SLOTS;
+        }
+        if (pending) {
+          // out of slots or still in flight. come back without waiting
+          if (quit) continue;
+          send_lock.lock();
+          send_requested = true;
+          send_lock.unlock();
+        } else if (quit) {
+          break;
+        }
+      }
+      logstream(LOG_INFO) << "Send loop Stopped" << std::endl;
+    }
+
+
+    void dc_ibv_comm::receive_loop() {
+      logstream(LOG_INFO) << "Receive loop Started" << std::endl;
+      ibv_req_notify_cq(recv_cq, 0);
+      while (!done) {
+        struct pollfd pfd;
+        pfd.fd = recv_channel->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        struct ibv_cq* ev_cq;
+        void* ev_ctx;
+        if (ibv_get_cq_event(recv_channel, &ev_cq, &ev_ctx) != 0) continue;
+        ibv_ack_cq_events(ev_cq, 1);
+        // rearm before draining so that no completion is missed
+        ibv_req_notify_cq(recv_cq, 0);
+        struct ibv_wc wc[32];
+        int n;
+        while ((n = ibv_poll_cq(recv_cq, 32, wc)) > 0) {
+          for (int i = 0; i < n; ++i) {
+            if (wc[i].status != IBV_WC_SUCCESS) {
+              logstream(LOG_FATAL) << "InfiniBand receive failed: "
+                                   << ibv_wc_status_str(wc[i].status) << std::endl;
+            }
+            const procid_t source = wc[i].wr_id / IBV_NUM_SLOTS;
+            const size_t slot = wc[i].wr_id % IBV_NUM_SLOTS;
+            network_bytesreceived.inc(wc[i].byte_len);
+            // copy the slot into the stream receiver
+            const char* data = conn[source].recvbuf + slot * IBV_SLOT_SIZE;
+            size_t len = wc[i].byte_len;
+            size_t buflength;
+            char* c = receiver[source]->get_buffer(buflength);
+            while (len > 0) {
+              size_t ncopy = std::min(len, buflength);
+              memcpy(c, data, ncopy);
+              data += ncopy;
+              len -= ncopy;
+              c = receiver[source]->advance_buffer(c, ncopy, buflength);
+            }
+            post_receive(source, slot);
+          }
+        }
+      }
+      logstream(LOG_INFO) << "Receive loop Stopped" << std::endl;
+    }
+
+
+    void dc_ibv_comm::close() {
+      if (is_closed) return;
+      send_lock.lock();
+      done = true;
+      send_cond.signal();
+      send_lock.unlock();
+      sendthread.join();
+      recvthread.join();
+      for (size_t i = 0; i < conn.size(); ++i) {
+        ibv_destroy_qp(conn[i].qp);
+        ibv_dereg_mr(conn[i].sendmr);
+        ibv_dereg_mr(conn[i].recvmr);
+        free(conn[i].sendbuf);
+        free(conn[i].recvbuf);
+      }
+      conn.clear();
+      ibv_destroy_cq(send_cq);
+      ibv_destroy_cq(recv_cq);
+      ibv_destroy_comp_channel(recv_channel);
+      ibv_dealloc_pd(pd);
+      ibv_close_device(context);
+      is_closed = true;
+    }
+
+  } // namespace dc_impl
+} // namespace graphlab
+
+#include <graphlab/macros_undef.hpp>
+
+#endif
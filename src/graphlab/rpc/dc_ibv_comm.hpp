@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef DC_IBV_COMM_HPP
+#define DC_IBV_COMM_HPP
+
+#include <infiniband/verbs.h>
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_comm_base.hpp>
+#include <graphlab/rpc/dc_compile_parameters.hpp>
+#include <graphlab/rpc/circular_iovec_buffer.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ \ingroup rpc
+ \internal
+InfiniBand verbs implementation of the communications subsystem.
+
+Every pair of machines (including a machine and itself) is connected by
+a reliable connected queue pair. Each queue pair has a ring of
+IBV_NUM_SLOTS registered send buffers and as many posted receive
+buffers of IBV_SLOT_SIZE bytes each. The send thread copies the data of
+the senders into free send slots and posts them as SEND work requests.
+The receive thread copies every completed receive slot into the stream
+receiver and reposts it. Reliable connections deliver the slots in
+order, so the byte stream seen by the receivers is the same as over
+TCP. If the remote has no receive posted, the hardware retries
+(receiver not ready), which bounds the data in flight.
+
+The queue pair addresses are exchanged over TCP using the addresses in
+the machines list.
+*/
+class dc_ibv_comm:public dc_comm_base {
+ public:
+
+  inline dc_ibv_comm() {
+    is_closed = true;
+    ib_port = 1;
+    gid_index = -1;
+  }
+
+  size_t capabilities() const {
+    return COMM_STREAM;
+  }
+
+  /**
+   this fuction should pause until all communication has been set up
+   and returns the number of systems in the network.
+
+   machines: a vector of strings where each string is of the form [IP]:[portnumber]
+             The address is only used to exchange the queue pair addresses.
+   initopts: "ib_device" selects the InfiniBand device by name (the first
+             device by default), "ib_port" the port number (default 1) and
+             "ib_gid_index" the GID used for routing (needed on RoCE).
+   curmachineid: The ID of the current machine.
+  */
+  void init(const std::vector<std::string> &machines,
+            const std::map<std::string,std::string> &initopts,
+            procid_t curmachineid,
+            std::vector<dc_receive*> receiver,
+            std::vector<dc_send*> senders);
+
+  /** shuts down all queue pairs and cleans up */
+  void close();
+
+  ~dc_ibv_comm() {
+    close();
+  }
+
+  inline procid_t numprocs() const {
+    return nprocs;
+  }
+
+  inline procid_t procid() const {
+    return curid;
+  }
+
+  inline size_t network_bytes_sent() const {
+    return network_bytessent.value;
+  }
+
+  inline size_t network_bytes_received() const {
+    return network_bytesreceived.value;
+  }
+
+  inline size_t network_bytes_uncompressed() const {
+    return buffered_len.value;
+  }
+
+  inline size_t send_queue_length() const {
+    size_t a = network_bytessent.value;
+    size_t b = buffered_len.value;
+    return b - a;
+  }
+
+  void trigger_send_timeout(procid_t target, bool urgent);
+
+ private:
+  /// The address of one end of a queue pair
+  struct qp_address {
+    procid_t id;
+    uint16_t lid;
+    uint32_t qpn;
+    uint32_t psn;
+    union ibv_gid gid;
+  };
+
+  /// All the state of the connection to one machine
+  struct connection {
+    struct ibv_qp* qp;
+    char* sendbuf;
+    char* recvbuf;
+    struct ibv_mr* sendmr;
+    struct ibv_mr* recvmr;
+    std::vector<size_t> free_slots;  /// send slots which can be filled
+    circular_iovec_buffer outvec;  /// data taken from the sender, not yet posted
+    qp_address local;
+  };
+
+  procid_t curid;
+  procid_t nprocs;
+  bool is_closed;
+  int ib_port;
+  int gid_index;
+
+  std::vector<dc_receive*> receiver;
+  std::vector<dc_send*> sender;
+  std::vector<connection> conn;
+
+  struct ibv_context* context;
+  struct ibv_pd* pd;
+  struct ibv_comp_channel* recv_channel;
+  struct ibv_cq* send_cq;
+  struct ibv_cq* recv_cq;
+  struct ibv_port_attr port_attr;
+
+  atomic<size_t> network_bytessent;
+  atomic<size_t> network_bytesreceived;
+  atomic<size_t> buffered_len;
+
+  /// set when a send is requested. Protected by send_lock
+  bool send_requested;
+  volatile bool done;
+  mutex send_lock;
+  conditional send_cond;
+  thread sendthread;
+  thread recvthread;
+
+  void open_device(const std::map<std::string,std::string> &initopts);
+  void create_connection(procid_t target);
+  /// exchanges the queue pair addresses with all machines over TCP
+  void exchange_addresses(const std::vector<std::string> &machines,
+                          const std::map<std::string,std::string> &initopts,
+                          std::vector<qp_address>& remote);
+  void connect_qp(procid_t target, const qp_address& remote);
+  void post_receive(procid_t target, size_t slot);
+
+  void send_loop();
+  void receive_loop();
+  /// moves as much outgoing data of target as possible into send slots
+  void post_sends(procid_t target);
+  /// reclaims the send slots of completed sends
+  void poll_send_completions();
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
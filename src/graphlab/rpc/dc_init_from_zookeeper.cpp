@@ -23,12 +23,19 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <fstream>
+#include <csignal>
+#include <unistd.h>
 #include <boost/bind.hpp>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/zookeeper/server_list.hpp>
+#include <graphlab/zookeeper/elastic_membership.hpp>
+#include <graphlab/rpc/dc_comm_base.hpp>
 #include <graphlab/util/stl_util.hpp>
 #include <graphlab/util/net_util.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
@@ -52,6 +59,113 @@ void zk_callback(zookeeper::server_list* slist,
 }
 
 
+namespace {
+  /// The membership of this process when recovery is enabled
+  zookeeper::elastic_membership* membership = NULL;
+  mutex restart_lock;
+  conditional restart_cond;
+  bool restart_requested = false;
+  thread* restart_thread = NULL;
+
+  /// Restarts this process in place once a failure is reported
+  void restart_loop() {
+    restart_lock.lock();
+    while (!restart_requested) restart_cond.wait(restart_lock);
+    zookeeper::elastic_membership* m = membership;
+    membership = NULL;
+    restart_lock.unlock();
+    // the job is shutting down
+    if (m == NULL) return;
+    const size_t rank = m->rank();
+    const size_t generation = m->generation();
+    // release the rank right away rather than on the session timeout
+    delete m;
+    setenv("ZK_RANK", tostr(rank).c_str(), 1);
+    setenv("ZK_GENERATION", tostr(generation + 1).c_str(), 1);
+    // the arguments this process was started with
+    std::ifstream fin("/proc/self/cmdline");
+    std::string cmdline((std::istreambuf_iterator<char>(fin)),
+                        std::istreambuf_iterator<char>());
+    std::vector<char*> argv;
+    for (size_t i = 0; i < cmdline.length(); i += strlen(&cmdline[i]) + 1) {
+      argv.push_back(&cmdline[i]);
+    }
+    argv.push_back(NULL);
+    logstream(LOG_EMPH) << "Restarting as rank " << rank << " of generation "
+                        << generation + 1 << std::endl;
+    execv("/proc/self/exe", &argv[0]);
+    logstream(LOG_FATAL) << "Unable to restart: " << strerror(errno) << std::endl;
+  }
+
+  void request_restart(size_t lost_rank) {
+    logstream(LOG_ERROR) << "Lost machine " << lost_rank
+                         << ". Restarting the job" << std::endl;
+    restart_lock.lock();
+    restart_requested = true;
+    restart_cond.signal();
+    restart_lock.unlock();
+  }
+
+  /// Called by the comm on a broken connection. Waits for the restart
+  void comm_failed(procid_t machine) {
+    request_restart(machine);
+    while(1) sleep(1);
+  }
+
+  bool init_elastic(const std::vector<std::string>& zk_hosts_list,
+                    const std::string& jobname, size_t numnodes,
+                    dc_init_param& param) {
+    std::pair<size_t, int> port_and_sock = get_free_tcp_port();
+    size_t port = port_and_sock.first;
+    int sock = port_and_sock.second;
+    std::string ipaddr = get_local_ip_as_str(true) + ":" + tostr(port);
+    logstream(LOG_INFO) << "Will Listen on: " << ipaddr << std::endl;
+
+    char* zk_rank = getenv("ZK_RANK");
+    char* zk_generation = getenv("ZK_GENERATION");
+    membership = new zookeeper::elastic_membership(zk_hosts_list,
+                                                   jobname + "/ranks",
+                                                   ipaddr, numnodes);
+    membership->join(zk_rank ? atoi(zk_rank) : size_t(-1),
+                     zk_generation ? atoi(zk_generation) : 0);
+    logstream(LOG_EMPH) << "Joined generation " << membership->generation()
+                        << " as rank " << membership->rank() << std::endl;
+
+    // a dead peer must surface as a send error, not a signal
+    signal(SIGPIPE, SIG_IGN);
+    restart_thread = new thread();
+    restart_thread->launch(restart_loop);
+    membership->set_failure_callback(request_restart);
+    dc_impl::comm_failure_handler = comm_failed;
+
+    param.machines = membership->machines();
+    param.curmachineid = membership->rank();
+    param.numhandlerthreads = RPC_DEFAULT_NUMHANDLERTHREADS;
+    param.commtype = RPC_DEFAULT_COMMTYPE;
+    param.initstring = param.initstring + std::string(" __sockhandle__=") + tostr(sock) + " ";
+    return true;
+  }
+} // namespace
+
+
+void zookeeper_recovery_shutdown() {
+  if (restart_thread == NULL) return;
+  dc_impl::comm_failure_handler = NULL;
+  // wake up the restart thread without a restart
+  restart_lock.lock();
+  zookeeper::elastic_membership* m = membership;
+  membership = NULL;
+  restart_requested = true;
+  restart_cond.signal();
+  restart_lock.unlock();
+  if (m != NULL) m->set_failure_callback(NULL);
+  restart_thread->join();
+  delete restart_thread;
+  restart_thread = NULL;
+  delete m;
+}
+
+
 bool init_param_from_zookeeper(dc_init_param& param) {
   char* zk_hosts = getenv("ZK_SERVERS");
   char* zk_jobname = getenv("ZK_JOBNAME");
@@ -65,6 +179,12 @@ bool init_param_from_zookeeper(dc_init_param& param) {
   // number of nodes to wait for
   size_t numnodes = atoi(zk_numnodes);
   ASSERT_GE(numnodes, 1);
+  char* zk_recovery = getenv("ZK_RECOVERY");
+  if (zk_recovery != NULL && atoi(zk_recovery) != 0) {
+    logstream(LOG_EMPH) << "Using Zookeeper for Initialization with recovery. "
+                        << "Waiting for " << numnodes << " to join" << std::endl;
+    return init_elastic(zk_hosts_list, zk_jobname, numnodes, param);
+  }
   logstream(LOG_EMPH) << "Using Zookeeper for Initialization. Waiting for "
                       << numnodes << " to join" << std::endl;
 
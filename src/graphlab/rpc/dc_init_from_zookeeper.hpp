@@ -36,8 +36,28 @@ namespace graphlab {
    *             i.e. no other job with the same name must run at the same time
    * ZK_NUMNODES: The number of processes to wait for
    *
+   * If ZK_RECOVERY=1 is also set, the processes keep their zookeeper
+   * sessions for the whole job and every process gets a stable rank
+   * (see zookeeper::elastic_membership). When a process dies, the
+   * others notice the loss of its session or the broken connection and
+   * restart themselves in place with the same rank and arguments. A
+   * replacement process started with the same environment takes the
+   * rank which was lost. Combined with the engine checkpoints
+   * (checkpoint_path), each rank then reloads its own partition and
+   * the job resumes from the last checkpoint. The ZK_RANK and
+   * ZK_GENERATION variables are set by the restart.
+   *
    */
   bool init_param_from_zookeeper(dc_init_param& param);
+
+  /**
+   * \ingroup rpc
+   * \internal
+   * Stops the failure detection of ZK_RECOVERY and releases the rank.
+   * Called when the distributed control shuts down, so that the end of
+   * the job is not taken for a failure.
+   */
+  void zookeeper_recovery_shutdown();
 }
 
 #endif // GRAPHLAB_DC_INIT_FROM_ZOOKEEPER_HPP
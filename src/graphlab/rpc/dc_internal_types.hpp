@@ -28,6 +28,7 @@
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/util/resizing_array_sink.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
 namespace graphlab {
 class distributed_control;
@@ -133,6 +134,26 @@ struct terminator_token {
 
 
 
+/**
+ * \internal
+ * \ingroup rpc
+ * A receive buffer shared by the receiver, which keeps appending to it,
+ * and the chunks of it which were handed to the function call handlers.
+ * Every holder owns one reference; the buffer is freed with the last.
+ */
+struct shared_receive_buffer {
+  char* base;
+  atomic<size_t> refcount;
+  explicit shared_receive_buffer(char* base): base(base), refcount(1) { }
+  void add_ref() { refcount.inc(); }
+  void release() {
+    if (refcount.dec() == 0) {
+      free(base);
+      delete this;
+    }
+  }
+};
+
 /**
  * Used to maintain a linked list of buffers.
  */
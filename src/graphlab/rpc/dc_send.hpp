@@ -83,8 +83,8 @@ class dc_send{
 
   /**
    * Returns length if there is data, 0 otherwise. This function
-   * must be reentrant, but it is guaranteed that only one thread will
-   * call this function at anytime.
+   * must be thread safe. With several sockets to a machine, the sockets
+   * may call it concurrently and each gets a share of the flushes.
    */
   virtual size_t get_outgoing_data(circular_iovec_buffer& outdata) = 0;
 
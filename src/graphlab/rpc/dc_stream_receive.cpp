@@ -35,56 +35,77 @@ namespace dc_impl {
 
 
 char* dc_stream_receive::get_buffer(size_t& retbuflength) {
+  if (writebuffer == NULL) new_buffer(RECEIVE_BUFFER_SIZE);
   retbuflength = write_buffer_len - write_buffer_written;
   return writebuffer + write_buffer_written;
 }
 
 
+void dc_stream_receive::new_buffer(size_t len) {
+  writebuffer = (char*)malloc(len);
+  write_buffer_len = len;
+  write_buffer_written = 0;
+  write_buffer_dispatched = 0;
+  shared = new shared_receive_buffer(writebuffer);
+}
+
+
 char* dc_stream_receive::advance_buffer(char* c, size_t wrotelength, 
                             size_t& retbuflength) {
-  // find the last complete message we have read
   write_buffer_written += wrotelength;
-  if (write_buffer_written >= sizeof(packet_hdr)) {
-    size_t offset = 0;
-    packet_hdr* hdr = reinterpret_cast<packet_hdr*>(writebuffer);
-    // keep pushing the header until I reach a point where there is insufficient
-    // room to read a header, or the message is not large enough
-    while(offset + sizeof(packet_hdr) <= write_buffer_written &&
-          offset + hdr->len + sizeof(packet_hdr) <= write_buffer_written) {
-      offset += hdr->len + sizeof(packet_hdr);
-      hdr = reinterpret_cast<packet_hdr*>(writebuffer + offset);
-    }
-
-    if (offset > 0) {
-      // ok. everything before the offset is good
-      // since we are going to give this buffer away, we need to prepare a new buffer
-
-      // allocate whatever it is going to take to hold next message
-      // have we read the incomplete message's header?
-      size_t incomplete_message_len = 0;
-      if (offset + sizeof(packet_hdr) <= write_buffer_written) incomplete_message_len = hdr->len;
+  // find the end of the last complete message
+  size_t offset = write_buffer_dispatched;
+  while(offset + sizeof(packet_hdr) <= write_buffer_written) {
+    packet_hdr* hdr = reinterpret_cast<packet_hdr*>(writebuffer + offset);
+    if (offset + hdr->len + sizeof(packet_hdr) > write_buffer_written) break;
+    offset += hdr->len + sizeof(packet_hdr);
+  }
 
-      size_t new_buflen = std::max<size_t>(sizeof(packet_hdr) + incomplete_message_len, RECEIVE_BUFFER_SIZE);
-      char* new_writebuffer = (char*)malloc(new_buflen);
+  if (offset > write_buffer_dispatched) {
+    // hand the complete messages to the dc. They are deserialized in place
+    // and the buffer is kept alive by the reference taken here.
+    shared->add_ref();
+    dc->deferred_function_call_chunk(writebuffer + write_buffer_dispatched,
+                                     offset - write_buffer_dispatched,
+                                     associated_proc, shared);
+    write_buffer_dispatched = offset;
+  }
 
-      if (write_buffer_len - offset > 0) {
-        // copy over to the new buffer everything we will not use
-        memcpy(new_writebuffer, writebuffer + offset, write_buffer_written - offset);
+  // make sure the next message fits after the incomplete one
+  const size_t incomplete_len = write_buffer_written - write_buffer_dispatched;
+  size_t needed_len = sizeof(packet_hdr);
+  if (incomplete_len >= sizeof(packet_hdr)) {
+    needed_len += reinterpret_cast<packet_hdr*>(writebuffer + 
+                                                write_buffer_dispatched)->len;
+  }
+  const size_t free_len = write_buffer_len - write_buffer_written;
+  // a new buffer is needed if the next message does not fit, or if
+  // the space left is too small for efficient reads
+  if (write_buffer_dispatched + needed_len > write_buffer_len ||
+      (free_len < RECEIVE_BUFFER_MIN_FREE && incomplete_len < sizeof(packet_hdr))) {
+    if (shared->refcount.value == 1) {
+      // all the handed out messages are complete. Reuse the buffer.
+      if (write_buffer_dispatched > 0) {
+        memmove(writebuffer, writebuffer + write_buffer_dispatched, incomplete_len);
+        write_buffer_written = incomplete_len;
+        write_buffer_dispatched = 0;
+      }
+      if (needed_len > write_buffer_len) {
+        writebuffer = (char*)realloc(writebuffer, needed_len);
+        shared->base = writebuffer;
+        write_buffer_len = needed_len;
       }
-      // if we reach here, we have an available block
-      // give away the buffer to dc
-      dc->deferred_function_call_chunk(writebuffer, offset, associated_proc);
-      writebuffer = new_writebuffer;
-      write_buffer_written -= offset;
-      write_buffer_len = new_buflen;
     } else {
-      // nothing ready yet
-      // do we have enough room though?
-      if (hdr->len + sizeof(packet_hdr) > write_buffer_len) {
-        size_t newlen = hdr->len + sizeof(packet_hdr);
-        writebuffer = (char*)realloc(writebuffer, newlen);
-        write_buffer_len = newlen;
+      // only the incomplete message is copied to the new buffer
+      char* oldbuffer = writebuffer;
+      shared_receive_buffer* oldshared = shared;
+      const size_t oldstart = write_buffer_dispatched;
+      new_buffer(std::max<size_t>(needed_len, RECEIVE_BUFFER_SIZE));
+      if (incomplete_len > 0) {
+        memcpy(writebuffer, oldbuffer + oldstart, incomplete_len);
       }
+      write_buffer_written = incomplete_len;
+      oldshared->release();
     }
   }
   return get_buffer(retbuflength);
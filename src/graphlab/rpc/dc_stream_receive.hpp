@@ -51,17 +51,28 @@ class dc_stream_receive: public dc_receive{
  public:
   
   dc_stream_receive(distributed_control* dc, procid_t associated_proc): 
-                  writebuffer(NULL), write_buffer_written(0), dc(dc), 
+                  writebuffer(NULL), write_buffer_written(0),
+                  write_buffer_dispatched(0), shared(NULL), dc(dc),
                   associated_proc(associated_proc) { 
-    writebuffer = (char*)malloc(RECEIVE_BUFFER_SIZE);
-    write_buffer_len = RECEIVE_BUFFER_SIZE;
+    // allocated on the first receive so that machines which never
+    // send to this one cost nothing
+    write_buffer_len = 0;
   }
 
  private:
 
+  /**
+   * The receive buffer. Complete messages are handed to the dc in place,
+   * and new data is appended after them until the buffer is full.
+   * Only the incomplete message at the end is then copied to a new buffer.
+   */
   char* writebuffer;
   size_t write_buffer_written;
   size_t write_buffer_len;
+  /// the bytes at the start of writebuffer already handed to the dc
+  size_t write_buffer_dispatched;
+  /// the reference count of writebuffer
+  shared_receive_buffer* shared;
   
   /// pointer to the owner
   distributed_control* dc;
@@ -72,6 +83,9 @@ class dc_stream_receive: public dc_receive{
 
   
   char* get_buffer(size_t& retbuflength);
+
+  /// starts a new receive buffer of len bytes
+  void new_buffer(size_t len);
   
 
   char* advance_buffer(char* c, size_t wrotelength, 
@@ -31,15 +31,19 @@
 #include <netinet/tcp.h>
 #include <ifaddrs.h>
 #include <poll.h>
+#include <sched.h>
 
 #include <limits>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <map>
 
+#include <zlib.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/bind.hpp>
 #include <graphlab/logger/logger.hpp>
+#include <graphlab/util/timer.hpp>
 #include <graphlab/rpc/dc_tcp_comm.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/get_current_process_hash.cpp>
@@ -70,16 +74,20 @@ namespace graphlab {
       nprocs = (procid_t)(machines.size());
       receiver = receiver_;
       sender = sender_;
+      nstripes = sockets_per_peer(initopts);
+      next_stripe.resize(nprocs, 0);
+      ASSERT_EQ(receiver.size(), nprocs * nstripes);
 
       // insert machines into the address map
       all_addrs.resize(nprocs);
       portnums.resize(nprocs);
-      assert(triggered_timeouts.size() >= nprocs);
+      triggered_timeouts.resize(nprocs * nstripes);
       triggered_timeouts.clear();
       // fill all the socks
-      sock.resize(nprocs);
-      for (size_t i = 0;i < nprocs; ++i) {
-        sock[i].id = i;
+      sock.resize(nprocs * nstripes);
+      for (size_t i = 0;i < sock.size(); ++i) {
+        sock[i].id = i % nprocs;
+        sock[i].stripe = i / nprocs;
         sock[i].owner = this;
         sock[i].outsock = -1;
         sock[i].insock = -1;
@@ -93,11 +101,16 @@ namespace graphlab {
         sock[i].data.msg_flags = 0;
         sock[i].data.msg_iovlen = 0;
         sock[i].data.msg_iov = NULL;
+        sock[i].skip_compression = 0;
+        sock[i].inframe_len = 0;
       }
 
+      timer ti; ti.start();
       program_md5 = get_current_process_hash();
       ASSERT_EQ(program_md5.length(), 32);
-      // parse the machines list, and extract the relevant address information
+      // parse the machines list, and extract the relevant address information.
+      // Many processes share a host, so each host is only resolved once.
+      std::map<std::string, uint32_t> resolved;
       for (size_t i = 0;i < machines.size(); ++i) {
         // extract the port number
         size_t pos = machines[i].find(":");
@@ -105,9 +118,20 @@ namespace graphlab {
         std::string address = machines[i].substr(0, pos);
         size_t port = boost::lexical_cast<size_t>(machines[i].substr(pos+1));
 
-        struct hostent* ent = gethostbyname(address.c_str());
-        ASSERT_EQ(ent->h_length, 4);
-        uint32_t addr = *reinterpret_cast<uint32_t*>(ent->h_addr_list[0]);
+        std::map<std::string, uint32_t>::const_iterator known =
+            resolved.find(address);
+        uint32_t addr = 0;
+        if (known != resolved.end()) {
+          addr = known->second;
+        } else {
+          struct hostent* ent = gethostbyname(address.c_str());
+          if (ent == NULL) {
+            logstream(LOG_FATAL) << "Cannot resolve " << address << std::endl;
+          }
+          ASSERT_EQ(ent->h_length, 4);
+          addr = *reinterpret_cast<uint32_t*>(ent->h_addr_list[0]);
+          resolved[address] = addr;
+        }
 
         all_addrs[i] = addr;
         ASSERT_LT(port, 65536);
@@ -115,6 +139,51 @@ namespace graphlab {
       }
       network_bytessent = 0;
       buffered_len = 0;
+      raw_len = 0;
+      compressed_blocks = 0;
+      bypassed_blocks = 0;
+      std::map<std::string, std::string>::const_iterator compress_iter =
+        initopts.find("compress");
+      if (compress_iter != initopts.end()) {
+        compress = compress_iter->second == "1" ||
+                   compress_iter->second == "true";
+      }
+      compress_iter = initopts.find("compress_threshold");
+      if (compress_iter != initopts.end()) {
+        compress_threshold =
+          boost::lexical_cast<size_t>(compress_iter->second);
+      }
+      if (nstripes > 1) {
+        logstream(LOG_INFO) << "Using " << nstripes
+                            << " sockets to each machine" << std::endl;
+      }
+      if (compress) {
+        logstream(LOG_INFO) << "Wire compression on for flushes of at least "
+                            << compress_threshold << " bytes" << std::endl;
+      }
+      // processes on the same host talk through shared memory. The rings
+      // this machine receives from exist before anyone connects to it
+      bool use_shm = RPC_USE_SHM_TRANSPORT;
+      compress_iter = initopts.find("shm");
+      if (compress_iter != initopts.end()) {
+        use_shm = compress_iter->second == "1" ||
+                  compress_iter->second == "true";
+      }
+      shm.clear();
+      shm_done = false;
+      shm_requested = false;
+      if (use_shm) {
+        shm.resize(nprocs, NULL);
+        size_t nlocal = 0;
+        for (procid_t i = 0;i < nprocs; ++i) {
+          if (all_addrs[i] != all_addrs[curid]) continue;
+          shm[i] = new shm_peer;
+          shm[i]->in.create(shm_name(i, curid), RPC_SHM_RING_SIZE);
+          ++nlocal;
+        }
+        logstream(LOG_INFO) << "Using shared memory for " << nlocal
+                            << " machines on this host" << std::endl;
+      }
       // if sock handle is set
       std::map<std::string, std::string>::const_iterator iter =
         initopts.find("__sockhandle__");
@@ -123,6 +192,8 @@ namespace graphlab {
       } else {
         open_listening();
       }
+      const double setup_time = ti.current_time();
+      double connect_time = 0;
       // to improve the "synchronous" nature of the connection setup,
       // the last machine will do this in reverse order.
       // To wait for all machines to connect to it, before it
@@ -132,12 +203,13 @@ namespace graphlab {
         // not the last machine.
         // Connect to everyone, EXCEPT the last machine
         // and wait for all incoming connections
-        for(procid_t i = 0;i < nprocs - 1; ++i) connect(i);
+        connect_all(0, nprocs - 1);
+        connect_time = ti.current_time() - setup_time;
 
-        // wait for p - 1 incoming connections
+        // wait for the incoming connections of p - 1 machines
         insock_lock.lock();
         while(1) {
-          if (num_in_connected() == sock.size() - 1) break;
+          if (num_in_connected() == sock.size() - nstripes) break;
           insock_cond.wait(insock_lock);
         }
         insock_lock.unlock();
@@ -158,6 +230,7 @@ namespace graphlab {
         // wait for all incoming connections before connecting to everyone
         // connect to myself
         connect(nprocs - 1);
+        connect_time = ti.current_time() - setup_time;
         insock_lock.lock();
         while(1) {
           if (num_in_connected() == sock.size()) break;
@@ -168,14 +241,32 @@ namespace graphlab {
         // all established a connection to each other
         // connect to everyone. This is essentially equivalent to the
         // barrier release message
-        for(size_t i = 0;i < nprocs; ++i) connect(i);
+        const double connect_start = ti.current_time();
+        connect_all(0, nprocs);
+        connect_time += ti.current_time() - connect_start;
+      }
+      logstream(LOG_INFO) << "TCP setup of proc " << curid << ": "
+                          << setup_time << "s resolving and listening, "
+                          << connect_time << "s connecting, "
+                          << ti.current_time() - setup_time - connect_time
+                          << "s waiting for the other machines" << std::endl;
+      // everyone is connected, so every ring has been created
+      for (procid_t i = 0;i < shm.size(); ++i) {
+        if (shm[i]) shm[i]->out.open(shm_name(curid, i));
       }
       // everyone is connected.
       // Construct the eventbase
       construct_events();
       // we reserve the last 2 cores for communication
-      inthreads.launch(boost::bind(&dc_tcp_comm::receive_loop, this, inevbase), thread::cpu_count() - 2);
+      inthreads.launch(boost::bind(&dc_tcp_comm::receive_loop, this, inevbase[0]), thread::cpu_count() - 2);
+      for (size_t i = 1;i < nstripes; ++i) {
+        inthreads.launch(boost::bind(&dc_tcp_comm::receive_loop, this, inevbase[i]));
+      }
       outthreads.launch(boost::bind(&dc_tcp_comm::send_loop, this, outevbase), thread::cpu_count() - 1);
+      if (!shm.empty()) {
+        shm_sendthread.launch(boost::bind(&dc_tcp_comm::shm_send_loop, this));
+        shm_recvthread.launch(boost::bind(&dc_tcp_comm::shm_receive_loop, this));
+      }
       is_closed = false;
     }
 
@@ -196,13 +287,17 @@ namespace graphlab {
       send_triggered_event = event_new(outevbase, -1, EV_TIMEOUT | EV_PERSIST, on_send_event, &(send_triggered_timeout));
       assert(send_triggered_event != NULL);
 
-      inevbase = event_base_new();
-      if (!inevbase) logstream(LOG_FATAL) << "Unable to construct libevent base" << std::endl;
+      // each stripe is received by its own thread
+      inevbase.resize(nstripes);
+      for (size_t i = 0;i < nstripes; ++i) {
+        inevbase[i] = event_base_new();
+        if (!inevbase[i]) logstream(LOG_FATAL) << "Unable to construct libevent base" << std::endl;
+      }
 
 
       //register all event objects
       for (size_t i = 0;i < sock.size(); ++i) {
-        sock[i].inevent = event_new(inevbase, sock[i].insock, EV_READ | EV_PERSIST | EV_ET,
+        sock[i].inevent = event_new(inevbase[sock[i].stripe], sock[i].insock, EV_READ | EV_PERSIST | EV_ET,
                                      on_receive_event, &(sock[i]));
         if (sock[i].inevent == NULL) {
           logstream(LOG_FATAL) << "Unable to register socket read event" << std::endl;
@@ -228,22 +323,66 @@ namespace graphlab {
       return connected;
     }
 
+    size_t dc_tcp_comm::sockets_per_peer(const std::map<std::string,std::string> &initopts) {
+      size_t n = RPC_DEFAULT_SOCKETS_PER_PEER;
+      std::map<std::string, std::string>::const_iterator iter =
+        initopts.find("sockets_per_peer");
+      if (iter != initopts.end()) n = boost::lexical_cast<size_t>(iter->second);
+      n = std::max<size_t>(1, std::min<size_t>(n, RPC_MAX_SOCKETS_PER_PEER));
+#ifndef RPC_BLOCK_STRIPING
+      if (n > 1) {
+        logstream(LOG_WARNING) << "sockets_per_peer requires RPC_BLOCK_STRIPING. "
+                               << "Using 1 socket per machine" << std::endl;
+        n = 1;
+      }
+#endif
+      return n;
+    }
+
     void dc_tcp_comm::trigger_send_timeout(procid_t target, bool urgent) {
+      if (is_shm_peer(target)) {
+        shm_lock.lock();
+        shm_requested = true;
+        shm_cond.signal();
+        shm_lock.unlock();
+        return;
+      }
+      size_t idx = target;
+      if (nstripes > 1) {
+        // Hand the flush to the next socket which is not blocked. Each
+        // flush holds only complete messages, so the stream of every
+        // socket stays well formed.
+        size_t start = next_stripe[target]++;
+        for (size_t i = 0;i < nstripes; ++i) {
+          size_t candidate = sock_index(target, (start + i) % nstripes);
+          if (sock[candidate].wouldblock == false) {
+            idx = candidate;
+            break;
+          }
+        }
+      }
       if (!urgent) {
-        if (sock[target].wouldblock == false &&
-            triggered_timeouts.get(target) == false) {
-          triggered_timeouts.set_bit(target);
+        if (sock[idx].wouldblock == false &&
+            triggered_timeouts.get(idx) == false) {
+          triggered_timeouts.set_bit(idx);
           event_active(send_triggered_event, EV_TIMEOUT, 1);
         }
       }
       else {
-        process_sock(&(sock[target]));
+        process_sock(&(sock[idx]));
       }
     }
 
 
     void dc_tcp_comm::close() {
       if (is_closed) return;
+      close_shm();
+      if (compress) {
+        logstream(LOG_INFO) << "Wire compression: " << raw_len.value
+                            << " bytes as " << buffered_len.value << ", "
+                            << compressed_blocks.value << " blocks compressed, "
+                            << bypassed_blocks.value << " bypassed" << std::endl;
+      }
       logstream(LOG_INFO) << "Closing listening socket" << std::endl;
       // close the listening socket
       if (listensock > 0) {
@@ -273,13 +412,18 @@ namespace graphlab {
         }
       }
 
-      // clear the inevent loop
-      event_base_loopbreak(inevbase);
+      // clear the inevent loops
+      for (size_t i = 0;i < inevbase.size(); ++i) {
+        event_base_loopbreak(inevbase[i]);
+      }
       inthreads.join();
       for (size_t i = 0;i < sock.size(); ++i) {
         event_free(sock[i].inevent);
       }
-      event_base_free(inevbase);
+      for (size_t i = 0;i < inevbase.size(); ++i) {
+        event_base_free(inevbase[i]);
+      }
+      inevbase.clear();
 
 
       logstream(LOG_INFO) << "Closing incoming sockets" << std::endl;
@@ -308,6 +452,7 @@ namespace graphlab {
             return false;
           }
           else {
+            if (comm_failure_handler) comm_failure_handler(sockinfo.id);
             logstream(LOG_FATAL) << "send error: " << strerror(errno) << std::endl;
             return false;
           }
@@ -368,7 +513,7 @@ namespace graphlab {
 
 
     void dc_tcp_comm::new_socket(int newsock, sockaddr_in* otheraddr,
-                                 procid_t id) {
+                                 procid_t id, size_t stripe) {
       // figure out the address of the incoming connection
       uint32_t addr = *reinterpret_cast<uint32_t*>(&(otheraddr->sin_addr));
       // locate the incoming address in the list
@@ -376,9 +521,10 @@ namespace graphlab {
                           << inet_ntoa(otheraddr->sin_addr) << std::endl;
       ASSERT_LT(id, all_addrs.size());
       ASSERT_EQ(all_addrs[id], addr);
+      ASSERT_LT(stripe, nstripes);
       insock_lock.lock();
-      ASSERT_EQ(sock[id].insock, -1);
-      sock[id].insock = newsock;
+      ASSERT_EQ(sock[sock_index(id, stripe)].insock, -1);
+      sock[sock_index(id, stripe)].insock = newsock;
       insock_cond.signal();
       insock_lock.unlock();
       logstream(LOG_INFO) << "Proc " << procid() << " accepted connection "
@@ -416,9 +562,9 @@ namespace graphlab {
     } // end of open_listening
 
     void dc_tcp_comm::connect(size_t target) {
-      if (sock[target].outsock != -1) {
-        return;
-      } else {
+      for (size_t stripe = 0;stripe < nstripes; ++stripe) {
+        const size_t idx = sock_index(target, stripe);
+        if (sock[idx].outsock != -1) continue;
         int newsock = socket(AF_INET, SOCK_STREAM, 0);
         set_tcp_no_delay(newsock);
         sockaddr_in serv_addr;
@@ -433,14 +579,20 @@ namespace graphlab {
                             << curid << " -> " << target
                             << " on port " << portnums[target] << "\n";
         logger(LOG_INFO, "Destination IP = %s", inet_ntoa(serv_addr.sin_addr));
-        // retry 10 times at 1 second intervals
+        // the target may not be listening yet: retry with exponential
+        // backoff for up to RPC_CONNECT_TIMEOUT seconds
         bool success = false;
-        for (size_t i = 0;i < 10; ++i) {
+        timer ti; ti.start();
+        size_t backoff_ms = 10;
+        while (true) {
           if (::connect(newsock, (sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+            if (ti.current_time() > RPC_CONNECT_TIMEOUT) break;
             logstream(LOG_INFO)
               << "connect " << curid << " to " << target << ": "
-              << strerror(errno) << ". Retrying...\n";
-            timer::sleep(1);
+              << strerror(errno) << ". Retrying in " << backoff_ms
+              << "ms...\n";
+            timer::sleep_ms(backoff_ms);
+            backoff_ms = std::min<size_t>(2 * backoff_ms, 1000);
             // posix says that
             /* If connect() fails, the state of the socket is unspecified.
                Conforming applications should close the file descriptor and
@@ -452,6 +604,7 @@ namespace graphlab {
             // send the initial message
             initial_message msg; 
             msg.id = curid;
+            msg.stripe = stripe;
             memcpy(msg.md5, program_md5.c_str(), 32);
             sendtosock(newsock, reinterpret_cast<char*>(&msg), sizeof(initial_message));
             set_non_blocking(newsock);
@@ -463,12 +616,36 @@ namespace graphlab {
           logstream(LOG_FATAL) << "Failed to establish connection" << std::endl;
         }
         // remember the socket
-        sock[target].outsock = newsock;
-        logstream(LOG_INFO) << "connection from " << curid << " to " << target
-                            << " established." << std::endl;
+        sock[idx].outsock = newsock;
+        logstream(LOG_INFO) << "connection " << stripe << " from " << curid
+                            << " to " << target << " established." << std::endl;
       }
     } // end of connect
 
+    void dc_tcp_comm::connect_all(size_t begin, size_t end) {
+      // most of the time goes to round trips and to waiting for the
+      // machines which are not listening yet, so connect to many at once
+      const size_t nthreads =
+          std::min<size_t>(end - begin, RPC_CONNECT_THREADS);
+      if (nthreads <= 1) {
+        for (size_t i = begin; i < end; ++i) connect(i);
+        return;
+      }
+      atomic<size_t> next(begin);
+      thread_group group;
+      for (size_t i = 0; i < nthreads; ++i) {
+        group.launch(boost::bind(&dc_tcp_comm::connect_worker, this,
+                                 &next, end));
+      }
+      group.join();
+    } // end of connect_all
+
+    void dc_tcp_comm::connect_worker(atomic<size_t>* next, size_t end) {
+      for (size_t i = next->inc_ret_last(); i < end; i = next->inc_ret_last()) {
+        connect(i);
+      }
+    } // end of connect_worker
+
 
 
 
@@ -536,7 +713,8 @@ namespace graphlab {
             }
             // register the new socket
             set_non_blocking(newsock);
-            new_socket(newsock, &their_addr, remote_message.id);
+            new_socket(newsock, &their_addr, remote_message.id,
+                       remote_message.stripe);
             ++numsocks_connected;
           }
         }
@@ -554,8 +732,13 @@ namespace graphlab {
       dc_tcp_comm::socket_info* sockinfo = (dc_tcp_comm::socket_info*)(arg);
       dc_tcp_comm* comm = sockinfo->owner;
       if (ev & EV_READ) {
+        if (comm->compress) {
+          comm->receive_frames(*sockinfo, fd);
+          return;
+        }
         // get a direct pointer to my receiver
-        dc_receive* receiver = comm->receiver[sockinfo->id];
+        dc_receive* receiver =
+          comm->receiver[comm->sock_index(sockinfo->id, sockinfo->stripe)];
 
         size_t buflength;
         char *c = receiver->get_buffer(buflength);
@@ -564,6 +747,7 @@ namespace graphlab {
           if (msglen < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) break;
             else {
+              if (comm_failure_handler) comm_failure_handler(sockinfo->id);
               logstream(LOG_FATAL) << "receive error: " << strerror(errno) << std::endl;
               break;
             }
@@ -584,6 +768,93 @@ namespace graphlab {
       }
     }
 
+    std::string dc_tcp_comm::shm_name(procid_t src, procid_t dest) const {
+      // the listening port tells apart the processes on a host
+      return "/graphlab-" + program_md5.substr(0, 8) + "-" +
+        boost::lexical_cast<std::string>(portnums[dest]) + "-" +
+        boost::lexical_cast<std::string>(src);
+    }
+
+    void dc_tcp_comm::shm_send_loop() {
+      logstream(LOG_INFO) << "Shared memory send loop Started" << std::endl;
+      while (1) {
+        shm_lock.lock();
+        if (!shm_requested && !shm_done) {
+          shm_cond.timedwait_ns(shm_lock, SEND_POLL_TIMEOUT * 1000);
+        }
+        shm_requested = false;
+        const bool quit = shm_done;
+        shm_lock.unlock();
+
+        bool pending = false;
+        for (procid_t i = 0;i < shm.size(); ++i) {
+          if (shm[i] == NULL) continue;
+          shm_peer& peer = *shm[i];
+          size_t len = sender[i]->get_outgoing_data(peer.outvec);
+          raw_len.inc(len);
+          buffered_len.inc(len);
+          while (!peer.outvec.empty()) {
+            const iovec& vec = peer.outvec.parallel_v[peer.outvec.head];
+            const size_t veclen = vec.iov_len;
+            size_t written = peer.out.write((const char*)vec.iov_base, veclen);
+            network_bytessent.inc(written);
+            peer.outvec.sent(written);
+            // the ring is full
+            if (written < veclen) break;
+          }
+          pending = pending || !peer.outvec.empty();
+        }
+        if (quit) break;
+        if (pending) {
+          // the rings are full. come back without waiting
+          sched_yield();
+          shm_lock.lock();
+          shm_requested = true;
+          shm_lock.unlock();
+        }
+      }
+      logstream(LOG_INFO) << "Shared memory send loop Stopped" << std::endl;
+    }
+
+    void dc_tcp_comm::shm_receive_loop() {
+      logstream(LOG_INFO) << "Shared memory receive loop Started" << std::endl;
+      size_t idle_polls = 0;
+      while (!shm_done) {
+        bool received = false;
+        for (procid_t i = 0;i < shm.size(); ++i) {
+          if (shm[i] == NULL) continue;
+          size_t len;
+          const char* c = shm[i]->in.peek(len);
+          if (len == 0) continue;
+          network_bytesreceived.inc(len);
+          // the receiver of the first socket to machine i
+          deliver(receiver[i], c, len);
+          shm[i]->in.consume(len);
+          received = true;
+        }
+        if (received) idle_polls = 0;
+        else if (++idle_polls > RPC_SHM_SPIN_POLLS) usleep(RPC_SHM_IDLE_SLEEP);
+      }
+      logstream(LOG_INFO) << "Shared memory receive loop Stopped" << std::endl;
+    }
+
+    void dc_tcp_comm::close_shm() {
+      if (shm.empty()) return;
+      shm_lock.lock();
+      shm_done = true;
+      shm_cond.signal();
+      shm_lock.unlock();
+      shm_sendthread.join();
+      shm_recvthread.join();
+      for (size_t i = 0;i < shm.size(); ++i) {
+        if (shm[i]) {
+          while (!shm[i]->outvec.empty()) shm[i]->outvec.erase_from_head_and_free();
+          delete shm[i];
+        }
+      }
+      shm.clear();
+    }
+
     void dc_tcp_comm::receive_loop(struct event_base* ev) {
       logstream(LOG_INFO) << "Receive loop Started" << std::endl;
       int ret = event_base_dispatch(ev);
@@ -597,19 +868,163 @@ namespace graphlab {
 
 
     void dc_tcp_comm::check_for_new_data(dc_tcp_comm::socket_info& sockinfo) {
-      buffered_len.inc(sender[sockinfo.id]->get_outgoing_data(sockinfo.outvec));
+      if (!compress) {
+        size_t len = sender[sockinfo.id]->get_outgoing_data(sockinfo.outvec);
+        raw_len.inc(len);
+        buffered_len.inc(len);
+        return;
+      }
+      size_t len = sender[sockinfo.id]->get_outgoing_data(sockinfo.stagevec);
+      if (sockinfo.stagevec.empty()) return;
+      raw_len.inc(len);
+      buffered_len.inc(frame_outgoing_data(sockinfo, len));
+    }
+
+
+    size_t dc_tcp_comm::frame_outgoing_data(socket_info& sockinfo, size_t len) {
+      iovec hdrvec;
+      hdrvec.iov_len = sizeof(frame_header);
+      if (len < compress_threshold || sockinfo.skip_compression > 0) {
+        if (len >= compress_threshold) {
+          --sockinfo.skip_compression;
+          bypassed_blocks.inc();
+        }
+        frame_header* hdr = (frame_header*)malloc(sizeof(frame_header));
+        hdr->rawlen = len;
+        hdr->wirelen = len;
+        hdrvec.iov_base = hdr;
+        sockinfo.outvec.write(hdrvec);
+        sockinfo.stagevec.move_to(sockinfo.outvec);
+        return sizeof(frame_header) + len;
+      }
+      // gather the block so that it can be compressed in one call
+      char* raw = (char*)malloc(len);
+      size_t rawpos = 0;
+      circular_iovec_buffer& stage = sockinfo.stagevec;
+      while(!stage.empty()) {
+        const iovec& vec = stage.parallel_v[stage.head];
+        memcpy(raw + rawpos, vec.iov_base, vec.iov_len);
+        rawpos += vec.iov_len;
+        stage.erase_from_head_and_free();
+      }
+      ASSERT_EQ(rawpos, len);
+
+      uLongf wirelen = compressBound(len);
+      char* frame = (char*)malloc(sizeof(frame_header) + wirelen);
+      int ret = compress2((Bytef*)(frame + sizeof(frame_header)), &wirelen,
+                          (const Bytef*)raw, len, Z_BEST_SPEED);
+      frame_header* hdr = (frame_header*)frame;
+      hdr->rawlen = len;
+      if (ret == Z_OK &&
+          wirelen * 100 <= len * (100 - WIRE_COMPRESSION_MIN_SAVING)) {
+        free(raw);
+        hdr->wirelen = wirelen;
+        hdrvec.iov_base = frame;
+        hdrvec.iov_len = sizeof(frame_header) + wirelen;
+        sockinfo.outvec.write(hdrvec);
+        compressed_blocks.inc();
+        return hdrvec.iov_len;
+      }
+      // not worth it. send as is and stop trying for a while
+      hdr->wirelen = len;
+      hdrvec.iov_base = frame;
+      sockinfo.outvec.write(hdrvec);
+      iovec rawvec;
+      rawvec.iov_base = raw;
+      rawvec.iov_len = len;
+      sockinfo.outvec.write(rawvec);
+      sockinfo.skip_compression = WIRE_COMPRESSION_BACKOFF;
+      bypassed_blocks.inc();
+      return sizeof(frame_header) + len;
+    }
+
+
+    void dc_tcp_comm::deliver(dc_receive* receiver,
+                              const char* data, size_t len) {
+      size_t buflength;
+      char* c = receiver->get_buffer(buflength);
+      while(len > 0) {
+        size_t n = std::min(len, buflength);
+        memcpy(c, data, n);
+        data += n;
+        len -= n;
+        c = receiver->advance_buffer(c, n, buflength);
+      }
+    }
+
+
+    void dc_tcp_comm::receive_frames(socket_info& sockinfo, int fd) {
+      dc_receive* receiver =
+        this->receiver[sock_index(sockinfo.id, sockinfo.stripe)];
+      std::vector<char>& buf = sockinfo.inframe;
+      if (buf.size() < RECEIVE_BUFFER_SIZE) buf.resize(RECEIVE_BUFFER_SIZE);
+      while(1) {
+        ssize_t msglen = recv(fd, &(buf[sockinfo.inframe_len]),
+                              buf.size() - sockinfo.inframe_len, 0);
+        if (msglen < 0) {
+          if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+          else {
+            if (comm_failure_handler) comm_failure_handler(sockinfo.id);
+            logstream(LOG_FATAL) << "receive error: " << strerror(errno) << std::endl;
+            break;
+          }
+        }
+        else if (msglen == 0) {
+          // socket closed
+          break;
+        }
+        network_bytesreceived.inc(msglen);
+        sockinfo.inframe_len += msglen;
+        // pass on all the complete frames
+        size_t offset = 0;
+        while(offset + sizeof(frame_header) <= sockinfo.inframe_len) {
+          frame_header hdr;
+          memcpy(&hdr, &(buf[offset]), sizeof(frame_header));
+          size_t framelen = sizeof(frame_header) + hdr.wirelen;
+          if (offset + framelen > sockinfo.inframe_len) break;
+          const char* payload = &(buf[offset + sizeof(frame_header)]);
+          if (hdr.wirelen == hdr.rawlen) {
+            deliver(receiver, payload, hdr.rawlen);
+          } else {
+            sockinfo.decompressed.resize(hdr.rawlen);
+            uLongf rawlen = hdr.rawlen;
+            int ret = uncompress((Bytef*)&(sockinfo.decompressed[0]), &rawlen,
+                                 (const Bytef*)payload, hdr.wirelen);
+            if (ret != Z_OK || rawlen != hdr.rawlen) {
+              logstream(LOG_FATAL) << "Corrupt compressed frame from "
+                                   << sockinfo.id << std::endl;
+            }
+            deliver(receiver, &(sockinfo.decompressed[0]), hdr.rawlen);
+          }
+          offset += framelen;
+        }
+        if (offset > 0) {
+          memmove(&(buf[0]), &(buf[offset]), sockinfo.inframe_len - offset);
+          sockinfo.inframe_len -= offset;
+        }
+        // make room for the whole of the incomplete frame
+        if (sockinfo.inframe_len >= sizeof(frame_header)) {
+          frame_header hdr;
+          memcpy(&hdr, &(buf[0]), sizeof(frame_header));
+          size_t framelen = sizeof(frame_header) + hdr.wirelen;
+          if (framelen > buf.size()) buf.resize(framelen);
+        }
+      }
     }
 
 
     inline void process_sock(dc_tcp_comm::socket_info* sockinfo) {
+      // the shared memory threads own the data to this machine
+      if (sockinfo->owner->is_shm_peer(sockinfo->id)) return;
       if (sockinfo->m.try_lock()) {
         dc_tcp_comm* comm = sockinfo->owner;
         // get a direct pointer to my receiver
-        if (sockinfo->wouldblock == false) {
+        // the senders hand out a bounded backlog at a time, keep
+        // asking until the socket blocks or there is nothing left
+        while (sockinfo->wouldblock == false) {
           comm->check_for_new_data(*sockinfo);
-          if (!sockinfo->outvec.empty()) {
-            comm->send_till_block(*sockinfo);
-          }
+          if (sockinfo->outvec.empty()) break;
+          comm->send_till_block(*sockinfo);
         }
         sockinfo->m.unlock();
       }
@@ -35,9 +35,11 @@
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_comm_base.hpp>
+#include <graphlab/rpc/dc_compile_parameters.hpp>
 #include <graphlab/rpc/circular_iovec_buffer.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/rpc/shm_ring.hpp>
 
 #ifndef __APPLE__
 // prefix mangling if not Mac
@@ -57,6 +59,15 @@ void on_send_event(int fd, short ev, void* arg);
 TCP implementation of the communications subsystem.
 Provides a single object interface to sending/receiving data streams to
 a collection of machines.
+
+Machines with the same address as this machine (including itself) are
+processes on the same host. Unless the "shm" option is 0, their data
+goes through a shared memory ring in each direction instead of the
+sockets, which are only used to set up the connection. Each process
+creates the rings it receives from before connecting, and opens the
+rings it sends to once every machine is connected. One thread copies
+the outgoing data into the rings and one thread polls the incoming
+rings.
 */
 class dc_tcp_comm:public dc_comm_base {
  public:
@@ -65,6 +76,8 @@ class dc_tcp_comm:public dc_comm_base {
 
   inline dc_tcp_comm() {
     is_closed = true;
+    compress = false;
+    compress_threshold = WIRE_COMPRESSION_THRESHOLD;
     INITIALIZE_TRACER(tcp_send_call, "dc_tcp_comm: send syscall");
   }
 
@@ -80,7 +93,11 @@ class dc_tcp_comm:public dc_comm_base {
    attached receiver
 
    machines: a vector of strings where each string is of the form [IP]:[portnumber]
-   initopts: unused
+   initopts: "compress" turns on wire compression (see below) and
+             "compress_threshold" sets the smallest flush it is tried on.
+             "sockets_per_peer" opens that many sockets to every machine
+             (see sockets_per_peer()).
+             All machines must use the same options.
    curmachineid: The ID of the current machine. machines[curmachineid] will be
                  the listening address of this machine
 
@@ -100,6 +117,24 @@ class dc_tcp_comm:public dc_comm_base {
     close();
   }
 
+  /**
+   * Returns the number of sockets to open to each machine given the
+   * init options. Flushes to a machine are striped over its sockets,
+   * and every socket has its own receiver and receive thread, so the
+   * dc must create sockets_per_peer() * numprocs() receivers, the
+   * receiver of socket s from machine i at index s * numprocs() + i.
+   *
+   * Blocks from different sockets are processed in any order, so this
+   * is only allowed with RPC_BLOCK_STRIPING, where blocks from one
+   * socket are already processed in any order. Otherwise it is 1.
+   */
+  static size_t sockets_per_peer(const std::map<std::string,std::string> &initopts);
+
+  /// Whether the data to target goes through shared memory
+  inline bool is_shm_peer(size_t target) const {
+    return !shm.empty() && shm[target] != NULL;
+  }
+
   inline bool channel_active(size_t target) const {
     return (sock[target].outsock != -1);
   }
@@ -140,6 +175,28 @@ class dc_tcp_comm:public dc_comm_base {
     return b - a;
   }
 
+  /**
+   * Returns the total number of bytes handed to the sockets before
+   * wire compression. Equal to the queued network bytes when
+   * compression is off.
+   */
+  inline size_t network_bytes_uncompressed() const {
+    return raw_len.value;
+  }
+
+  /// Returns the number of flushed blocks which were sent compressed
+  inline size_t num_compressed_blocks() const {
+    return compressed_blocks.value;
+  }
+
+  /**
+   * Returns the number of blocks above the compression threshold which
+   * were sent uncompressed because they did not compress well
+   */
+  inline size_t num_bypassed_blocks() const {
+    return bypassed_blocks.value;
+  }
+
   /**
    Sends the string of length len to the target machine dest.
    Only valid after call to init();
@@ -156,7 +213,8 @@ class dc_tcp_comm:public dc_comm_base {
   void set_non_blocking(int fd);
 
   /// called when listener receives an incoming socket request
-  void new_socket(int newsock, sockaddr_in* otheraddr, procid_t remotemachineid);
+  void new_socket(int newsock, sockaddr_in* otheraddr, procid_t remotemachineid,
+                  size_t stripe);
 
 
   /// The number of incoming connections established
@@ -168,15 +226,31 @@ class dc_tcp_comm:public dc_comm_base {
   void open_listening(int sockhandle = 0);
 
 
-  /// constructs a connection to the target machine
+  /// constructs all the connections to the target machine
   void connect(size_t target);
 
+  /**
+   * constructs the connections to the machines [begin, end), to up to
+   * RPC_CONNECT_THREADS of them at once
+   */
+  void connect_all(size_t begin, size_t end);
+
+  /// connects to the machines taken from next until end is reached
+  void connect_worker(atomic<size_t>* next, size_t end);
+
+  /// index in sock of the given socket to the target machine
+  inline size_t sock_index(size_t target, size_t stripe) const {
+    return stripe * nprocs + target;
+  }
+
   /// wrapper around the standard send. but loops till the buffer is all sent
   int sendtosock(int sockfd, const char* buf, size_t len);
 
 
   procid_t curid;   /// if od the current processor
   procid_t nprocs;  /// number of processors
+  size_t nstripes;  /// number of sockets to each machine
+  std::vector<size_t> next_stripe;  /// stripe of the next flush to each machine
   bool is_closed;   /// whether this socket is closed
 
   std::string program_md5;  /// MD5 hash of current program
@@ -190,10 +264,17 @@ class dc_tcp_comm:public dc_comm_base {
   std::vector<dc_receive*> receiver;
   std::vector<dc_send*> sender;
   atomic<size_t> buffered_len;
+  atomic<size_t> raw_len;
+
+  bool compress;  /// whether wire compression is on
+  size_t compress_threshold;  /// smallest block which is compressed
+  atomic<size_t> compressed_blocks;
+  atomic<size_t> bypassed_blocks;
 
 
   struct initial_message {
     procid_t id;
+    uint32_t stripe;
     char md5[32];
   };
 
@@ -202,6 +283,7 @@ class dc_tcp_comm:public dc_comm_base {
   /// Passed to the receive handler
   struct socket_info{
     size_t id;    /// which machine this is connected to
+    size_t stripe;  /// which of the sockets to that machine this is
     dc_tcp_comm* owner; /// this object
     int outsock;  /// FD of the outgoing socket
     int insock;   /// FD of the incoming socket
@@ -210,10 +292,26 @@ class dc_tcp_comm:public dc_comm_base {
     bool wouldblock;
     mutex m;
 
-    circular_iovec_buffer outvec;  /// outgoing data
+    circular_iovec_buffer outvec;  /// outgoing data. Grows as needed
     struct msghdr data;
+
+    /// Wire compression state
+    circular_iovec_buffer stagevec; /// outgoing data not yet framed
+    size_t skip_compression;  /// number of large blocks left to send raw
+    std::vector<char> inframe;  /// partially received frames
+    size_t inframe_len;  /// number of bytes in inframe
+    std::vector<char> decompressed;
   };
 
+  /**
+   * When compression is on, every flush is sent as a frame which starts
+   * with this header. The payload is compressed if and only if wirelen
+   * is different from rawlen.
+   */
+  struct frame_header {
+    uint64_t rawlen;
+    uint64_t wirelen;
+  };
   mutex insock_lock; /// locks the insock field in socket_info
   conditional insock_cond; /// triggered when the insock field in socket_info changes
 
@@ -233,6 +331,13 @@ class dc_tcp_comm:public dc_comm_base {
   void send_all(socket_info& sockinfo);
   bool send_till_block(socket_info& sockinfo);
   void check_for_new_data(socket_info& sockinfo);
+
+  /// Frames the data in sockinfo.stagevec and moves it to sockinfo.outvec
+  size_t frame_outgoing_data(socket_info& sockinfo, size_t len);
+  /// Receives frames from the socket and passes them to the receiver
+  void receive_frames(socket_info& sockinfo, int fd);
+  /// Copies len bytes into the receive buffers of receiver
+  static void deliver(dc_receive* receiver, const char* data, size_t len);
   void construct_events();
 
 
@@ -247,7 +352,7 @@ class dc_tcp_comm:public dc_comm_base {
 
   friend void process_sock(socket_info* sockinfo);
   friend void on_receive_event(int fd, short ev, void* arg);
-  struct event_base* inevbase;
+  std::vector<struct event_base*> inevbase;  /// one per stripe
 
 
   ////////////       Sending Sockets      //////////////////////
@@ -260,7 +365,26 @@ class dc_tcp_comm:public dc_comm_base {
   timeout_event send_triggered_timeout;
   timeout_event send_all_timeout;
 
-  fixed_dense_bitset<256> triggered_timeouts;
+  dense_bitset triggered_timeouts;  /// one bit per socket
+  ////////////       Shared Memory Rings     //////////////////////
+  struct shm_peer {
+    shm_ring in;    /// written by the peer
+    shm_ring out;   /// read by the peer
+    circular_iovec_buffer outvec;  /// taken from the sender, not yet in out
+  };
+  std::vector<shm_peer*> shm;  /// one per machine, NULL for remote machines
+  volatile bool shm_done;
+  bool shm_requested;  /// protected by shm_lock
+  mutex shm_lock;
+  conditional shm_cond;
+  thread shm_sendthread;
+  thread shm_recvthread;
+  /// The name of the ring from machine src to machine dest
+  std::string shm_name(procid_t src, procid_t dest) const;
+  void shm_send_loop();
+  void shm_receive_loop();
+  void close_shm();
+
   ////////////       Listening Sockets     //////////////////////
   int listensock;
   thread listenthread;
@@ -17,27 +17,38 @@ extern pthread_key_t thrlocal_sequentialization_key;
 
 /**
  * \internal
- * Obtains the thread local send buffer for a given target
+ * Obtains the thread local buffer of the current thread
  */
-inline oarchive* get_thread_local_buffer(procid_t target) {
+inline thread_local_buffer* get_thread_local_send_buffer() {
   void* ptr = pthread_getspecific(thrlocal_send_buffer_key);
   thread_local_buffer* p = (thread_local_buffer*)(ptr);
   if (p == NULL) {
     p = new thread_local_buffer;
     pthread_setspecific(thrlocal_send_buffer_key, (void*)p);
   }
-  return p->acquire(target);
+  return p;
 }
 
 /**
  * \internal
- * Releases the thread local send buffer for the given target
+ * Obtains the thread local send buffer for a message with packet flags
+ * flags to a given target
+ */
+inline oarchive* get_thread_local_buffer(procid_t target,
+                                         unsigned char flags) {
+  return get_thread_local_send_buffer()->acquire(target, flags);
+}
+
+/**
+ * \internal
+ * Releases the thread local send buffer for the given target. flags
+ * must be the same as in the matching get_thread_local_buffer().
  */
 inline void release_thread_local_buffer(procid_t target, 
-                                        bool do_not_count_bytes_sent) {
+                                        unsigned char flags) {
   void* ptr = pthread_getspecific(thrlocal_send_buffer_key);
   thread_local_buffer* p = (thread_local_buffer*)(ptr);
-  p->release(target, do_not_count_bytes_sent);
+  p->release(target, flags);
 }
 
 /**
@@ -47,10 +58,8 @@ inline void release_thread_local_buffer(procid_t target,
 inline void write_thread_local_buffer(procid_t target, 
                                       char* c,
                                       size_t len,
-                                      bool do_not_count_bytes_sent) {
-  void* ptr = pthread_getspecific(thrlocal_send_buffer_key);
-  thread_local_buffer* p = (thread_local_buffer*)(ptr);
-  p->write(target, c, len, do_not_count_bytes_sent);
+                                      unsigned char flags) {
+  get_thread_local_send_buffer()->write(target, c, len, flags);
 }
 
 
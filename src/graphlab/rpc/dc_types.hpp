@@ -36,7 +36,8 @@ namespace graphlab {
    */
   enum dc_comm_type {
     TCP_COMM,   ///< TCP/IP
-    SCTP_COMM   ///< SCTP (limited support)
+    SCTP_COMM,  ///< SCTP (limited support)
+    IBV_COMM    ///< InfiniBand verbs. Requires a build with HAS_IBVERBS
   };
 
 
@@ -26,6 +26,8 @@
 
 #include <boost/functional/hash.hpp>
 #include <boost/unordered_map.hpp>
+#include <vector>
+#include <algorithm>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 
@@ -34,23 +36,36 @@ namespace graphlab {
   /**
    * \ingroup rpc
    * Implements a very rudimentary distributed key value store.
+   *
+   * The local entries are split over a number of shards, each with its
+   * own lock, so that the RPC handler threads do not serialize on a
+   * single lock. get_batch() and set_batch() send a single call to each
+   * machine for a whole set of keys.
    */
   template <typename KeyType, typename ValueType>
   class dht { 
 
   public:
     typedef boost::unordered_map<size_t, ValueType> storage_type;
-  
+
+    /// The default number of shards of the local storage
+    enum { DEFAULT_NUM_SHARDS = 64 };
 
   private:
+    /// One lock striped part of the local storage
+    struct shard {
+      mutex lock;
+      storage_type storage;
+    };
+
     mutable dc_dist_object< dht > rpc;
   
     boost::hash<KeyType> hasher;
-    mutex lock;
-    storage_type storage;
+    std::vector<shard> shards;
 
   public:
-    dht(distributed_control &dc) : rpc(dc, this) { }
+    dht(distributed_control &dc, size_t nshards = DEFAULT_NUM_SHARDS) :
+      rpc(dc, this), shards(std::max<size_t>(nshards, 1)) { }
     
     /**
      * Get the owner of the key
@@ -69,21 +84,14 @@ namespace graphlab {
 
       const size_t hashvalue = hasher(key);
       const size_t owningmachine = hashvalue % rpc.numprocs();
-      std::pair<bool, ValueType> retval;
       // if it is me, we can return it
       if (owningmachine == rpc.dc().procid()) {
-
-        lock.lock();
-        typename storage_type::const_iterator iter = storage.find(hashvalue);
-        retval.first = iter != storage.end();
-        if (retval.first) retval.second = iter->second;
-        lock.unlock();
+        return get_local(hashvalue);
       } else {
-        retval = rpc.remote_request(owningmachine, 
-                                         &dht<KeyType,ValueType>::get, 
-                                         key);
+        return rpc.remote_request(owningmachine, 
+                                  &dht<KeyType,ValueType>::get, 
+                                  key);
       }
-      return retval;
     }
  
     /**
@@ -96,25 +104,55 @@ namespace graphlab {
 
       const size_t hashvalue = hasher(key);
       const size_t owningmachine = hashvalue % rpc.numprocs();
-      std::pair<bool, ValueType> retval;
       // if it is me, we can return it
       if (owningmachine == rpc.dc().procid()) {
-
-        lock.lock();
-        typename storage_type::const_iterator iter = storage.find(hashvalue);
-        retval.first = iter != storage.end();
-        if (retval.first) retval.second = iter->second;
-        lock.unlock();
-        return retval;
+        return get_local(hashvalue);
       } else {
         return rpc.future_remote_request(owningmachine, 
                                            &dht<KeyType,ValueType>::get, 
                                            key);
       }
     }
-  
-
 
+    /**
+     * gets the values associated with a set of keys, sending a single
+     * request to each machine owning some of the keys. Entry i of the
+     * result is the return value of get(keys[i]).
+     */
+    std::vector<std::pair<bool, ValueType> >
+    get_batch(const std::vector<KeyType>& keys) const {
+      std::vector<std::pair<bool, ValueType> > ret(keys.size());
+      // the keys owned by each machine and their positions in keys
+      std::vector<std::vector<KeyType> > owned_keys(rpc.numprocs());
+      std::vector<std::vector<size_t> > positions(rpc.numprocs());
+      for (size_t i = 0; i < keys.size(); ++i) {
+        const procid_t owningmachine = owner(keys[i]);
+        owned_keys[owningmachine].push_back(keys[i]);
+        positions[owningmachine].push_back(i);
+      }
+      // issue all the remote requests before reading the local values
+      typedef request_future<std::vector<std::pair<bool, ValueType> > >
+          batch_future_type;
+      std::vector<batch_future_type> futures(rpc.numprocs());
+      for (procid_t p = 0; p < rpc.numprocs(); ++p) {
+        if (p != rpc.procid() && !owned_keys[p].empty()) {
+          futures[p] = rpc.future_remote_request(p,
+                              &dht<KeyType,ValueType>::get_owned_batch,
+                              owned_keys[p]);
+        }
+      }
+      for (procid_t p = 0; p < rpc.numprocs(); ++p) {
+        if (owned_keys[p].empty()) continue;
+        std::vector<std::pair<bool, ValueType> > values;
+        if (p == rpc.procid()) values = get_owned_batch(owned_keys[p]);
+        else values.swap(futures[p]());
+        ASSERT_EQ(values.size(), positions[p].size());
+        for (size_t i = 0; i < values.size(); ++i) {
+          ret[positions[p][i]] = values[i];
+        }
+      }
+      return ret;
+    }
 
     /**
      * Sets the newval to be the value associated with the key
@@ -126,15 +164,34 @@ namespace graphlab {
  
       // if it is me, set it
       if (owningmachine == rpc.dc().procid()) {
-        lock.lock();
-        storage[hashvalue] = newval;
-        lock.unlock();
+        set_local(hashvalue, newval);
       } else {
         rpc.remote_call(owningmachine, 
                              &dht<KeyType,ValueType>::set, 
                              key, newval);
       }
     }
+
+    /**
+     * Sets a set of (key, value) pairs, sending a single call to each
+     * machine owning some of the keys.
+     */
+    void set_batch(const std::vector<std::pair<KeyType, ValueType> >& entries) {
+      std::vector<std::vector<std::pair<KeyType, ValueType> > >
+          owned_entries(rpc.numprocs());
+      for (size_t i = 0; i < entries.size(); ++i) {
+        owned_entries[owner(entries[i].first)].push_back(entries[i]);
+      }
+      for (procid_t p = 0; p < rpc.numprocs(); ++p) {
+        if (owned_entries[p].empty()) continue;
+        if (p == rpc.procid()) {
+          set_owned_batch(owned_entries[p]);
+        } else {
+          rpc.remote_call(p, &dht<KeyType,ValueType>::set_owned_batch,
+                          owned_entries[p]);
+        }
+      }
+    }
   
     void print_stats() const {
       std::cerr << rpc.calls_sent() << " calls sent\n";
@@ -146,9 +203,56 @@ namespace graphlab {
     */
     void clear() {
       rpc.barrier();
-      storage.clear();
+      for (size_t i = 0; i < shards.size(); ++i) shards[i].storage.clear();
+    }
+
+  private:
+    /**
+     * The owner of a key is hashvalue % numprocs, so the shard uses the
+     * remaining bits of the hash to stay balanced.
+     */
+    const shard& shard_of(size_t hashvalue) const {
+      return shards[(hashvalue / rpc.numprocs()) % shards.size()];
+    }
+
+    shard& shard_of(size_t hashvalue) {
+      return shards[(hashvalue / rpc.numprocs()) % shards.size()];
+    }
+
+    std::pair<bool, ValueType> get_local(size_t hashvalue) const {
+      const shard& s = shard_of(hashvalue);
+      std::pair<bool, ValueType> retval;
+      s.lock.lock();
+      typename storage_type::const_iterator iter = s.storage.find(hashvalue);
+      retval.first = iter != s.storage.end();
+      if (retval.first) retval.second = iter->second;
+      s.lock.unlock();
+      return retval;
+    }
+
+    void set_local(size_t hashvalue, const ValueType& newval) {
+      shard& s = shard_of(hashvalue);
+      s.lock.lock();
+      s.storage[hashvalue] = newval;
+      s.lock.unlock();
     }
 
+    /// gets the values of keys which are all owned by this machine
+    std::vector<std::pair<bool, ValueType> >
+    get_owned_batch(const std::vector<KeyType>& keys) const {
+      std::vector<std::pair<bool, ValueType> > ret(keys.size());
+      for (size_t i = 0; i < keys.size(); ++i) {
+        ret[i] = get_local(hasher(keys[i]));
+      }
+      return ret;
+    }
+
+    /// sets entries whose keys are all owned by this machine
+    void set_owned_batch(const std::vector<std::pair<KeyType, ValueType> >& entries) {
+      for (size_t i = 0; i < entries.size(); ++i) {
+        set_local(hasher(entries[i].first), entries[i].second);
+      }
+    }
   };
 
 };
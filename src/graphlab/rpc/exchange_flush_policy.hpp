@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_EXCHANGE_FLUSH_POLICY_HPP
+#define GRAPHLAB_EXCHANGE_FLUSH_POLICY_HPP
+
+#include <vector>
+#include <algorithm>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/rpc/dc_compile_parameters.hpp>
+#include <graphlab/util/timer.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup rpc
+   *
+   * The process wide flush policy of the buffered exchanges. Each
+   * exchange copies the policy when it is constructed, so it should be
+   * set before the exchanges are created (the graph sets it from the
+   * exchange_latency_ms and exchange_min_buffer_kb graph options).
+   *
+   * A send buffer is sent once it is older than target_latency_ms, or
+   * once it is larger than its adaptive size limit. The limit is
+   * the rate at which data is produced for the buffer target times the
+   * target latency, clamped between min_buffer_size and the
+   * max_buffer_size of the exchange: busy targets get large batches and
+   * a trickle of sends is not held back for long. A target latency of 0
+   * disables the adaptation and the buffers are only sent when they
+   * reach max_buffer_size, or are flushed.
+   */
+  struct exchange_flush_policy {
+    size_t target_latency_ms;
+    size_t min_buffer_size;
+
+    exchange_flush_policy() :
+      target_latency_ms(DEFAULT_EXCHANGE_TARGET_LATENCY_MS),
+      min_buffer_size(DEFAULT_EXCHANGE_MIN_BUFFER_SIZE) { }
+
+    /// The policy used by newly constructed exchanges
+    static exchange_flush_policy& global() {
+      static exchange_flush_policy policy;
+      return policy;
+    }
+  };
+
+  namespace dc_impl {
+
+    /**
+     * \internal
+     * The adaptive flush state of one send buffer of an exchange, and
+     * the achieved batch size counters. Must be protected by the lock
+     * of the send buffer, except for the counters.
+     */
+    class exchange_flow_control {
+    public:
+      exchange_flow_control(size_t max_buffer_size) :
+        policy(exchange_flush_policy::global()),
+        max_buffer_size(max_buffer_size) {
+        if (policy.min_buffer_size > max_buffer_size) {
+          policy.min_buffer_size = max_buffer_size;
+        }
+      }
+
+      /// Allocates the state of nbuffers send buffers
+      void resize(size_t nbuffers) {
+        state.resize(nbuffers);
+        for (size_t i = 0; i < nbuffers; ++i) {
+          state[i].limit = max_buffer_size;
+          state[i].first_insert = 0;
+          state[i].window_start = timer::approx_time_millis();
+          state[i].window_bytes = 0;
+        }
+      }
+
+      /// Called after the value is written to an empty buffer
+      inline void first_insert(size_t index) {
+        if (policy.target_latency_ms) {
+          state[index].first_insert = timer::approx_time_millis();
+        }
+      }
+
+      /// Whether a buffer holding buffer_size bytes should be sent
+      inline bool should_flush(size_t index, size_t buffer_size) const {
+        if (buffer_size >= state[index].limit) return true;
+        return policy.target_latency_ms &&
+          timer::approx_time_millis() - state[index].first_insert >=
+          policy.target_latency_ms;
+      }
+
+      /// Called when a buffer of buffer_size bytes is sent
+      void sent(size_t index, size_t buffer_size) {
+        flushes.inc();
+        bytes.inc(buffer_size);
+        if (policy.target_latency_ms == 0) return;
+        buffer_state& s = state[index];
+        s.window_bytes += buffer_size;
+        const size_t now = timer::approx_time_millis();
+        const size_t elapsed = now - s.window_start;
+        // the approximate clock only ticks every 100ms, measure the
+        // rate over at least one target latency
+        if (elapsed >= policy.target_latency_ms && elapsed > 0) {
+          const size_t target_bytes =
+            s.window_bytes * policy.target_latency_ms / elapsed;
+          s.limit = std::max(policy.min_buffer_size,
+                             std::min(max_buffer_size, target_bytes));
+          s.window_start = now;
+          s.window_bytes = 0;
+        }
+      }
+
+      /// The number of buffers sent
+      size_t num_flushes() const { return flushes.value; }
+
+      /// The number of bytes sent
+      size_t bytes_flushed() const { return bytes.value; }
+
+      /// The average number of bytes per buffer sent
+      double average_batch_size() const {
+        const size_t n = flushes.value;
+        return n == 0 ? 0 : double(bytes.value) / n;
+      }
+
+    private:
+      struct buffer_state {
+        /// the adaptive size limit
+        size_t limit;
+        /// the time of the first insert into the buffer
+        size_t first_insert;
+        /// the start of the current rate measurement
+        size_t window_start;
+        /// the bytes sent since window_start
+        size_t window_bytes;
+      };
+
+      exchange_flush_policy policy;
+      const size_t max_buffer_size;
+      std::vector<buffer_state> state;
+      atomic<size_t> flushes;
+      atomic<size_t> bytes;
+    };
+
+  } // namespace dc_impl
+} // namespace graphlab
+#endif
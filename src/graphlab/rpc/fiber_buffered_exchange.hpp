@@ -28,6 +28,7 @@
 #include <graphlab/parallel/fiber_control.hpp>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/rpc/exchange_flush_policy.hpp>
 #include <graphlab/util/mpi_tools.hpp>
 
 
@@ -81,6 +82,9 @@ namespace graphlab {
    * \note The last single threaded receive is not necessary if worker-affinity
    * is set correctly so that every worker is active in the parallel receiving
    * block.
+   * \note On a single machine the values are not serialized: each worker
+   * appends them to a vector which is moved to its own receive buffers
+   * when full, and flush() does not wait on the other machines.
    *
    * \see graphlab::buffered_exchange
    */
@@ -113,6 +117,26 @@ namespace graphlab {
 
     std::vector<std::vector<send_record> > send_buffers;
     const size_t max_buffer_size;
+    /// whether the values are serialized with compact archives
+    const bool compact;
+    /// when to send each send buffer
+    dc_impl::exchange_flow_control flow;
+    /// true on a single machine, where the send buffers are local_buffers
+    const bool local;
+    /// the values sent by each worker, on a single machine
+    std::vector<buffer_type> local_buffers;
+
+    /// Moves the values sent by worker wid to its receive buffers
+    void move_local_buffer(size_t wid) {
+      if (local_buffers[wid].empty()) return;
+      flow.sent(wid, local_buffers[wid].size() * sizeof(T));
+      lock.lock();
+      recv_buffers[wid].push_back(buffer_record());
+      buffer_record& rec = recv_buffers[wid].back();
+      rec.proc = 0;
+      rec.buffer.swap(local_buffers[wid]);
+      lock.unlock();
+    }
 
 
     /**
@@ -122,6 +146,7 @@ namespace graphlab {
       if(send_buffers[wid][proc].oarc) {
         // write the length at the end of the buffere are returning
         send_buffers[wid][proc].oarc->write(reinterpret_cast<char*>(&send_buffers[wid][proc].numinserts), sizeof(size_t));
+        flow.sent(wid * rpc.numprocs() + proc, send_buffers[wid][proc].oarc->off);
         rpc.split_call_end(proc, send_buffers[wid][proc].oarc);
 //         logstream(LOG_DEBUG) << rpc.procid() << ": Sending exchange of length " 
 //                              << send_buffers[wid][proc].oarc->off << " to " 
@@ -136,13 +161,21 @@ namespace graphlab {
      * Constructs a buffered exchange object.
      *
      * \ref dc The master distributed_control object
-     * \ref max_buffer_size The size of the per thread and per target send buffer.
+     * \ref max_buffer_size The largest size of the per thread and per target
+     *                      send buffer. Smaller buffers may be sent
+     *                      depending on the exchange_flush_policy.
+     * \ref compact Whether to serialize using compact archives. Must be
+     *              the same on all machines.
      */
     fiber_buffered_exchange(distributed_control& dc,
-                      const size_t max_buffer_size = DEFAULT_BUFFERED_EXCHANGE_SIZE) :
+                      const size_t max_buffer_size = DEFAULT_BUFFERED_EXCHANGE_SIZE,
+                      const bool compact = DEFAULT_BUFFERED_EXCHANGE_COMPACT) :
       rpc(dc, this),
-      max_buffer_size(max_buffer_size) {
+      max_buffer_size(max_buffer_size), compact(compact),
+      flow(max_buffer_size), local(dc.numprocs() == 1) {
        send_buffers.resize(fiber_control::get_instance().num_workers());
+       if (local) local_buffers.resize(send_buffers.size());
+       flow.resize(send_buffers.size() * dc.numprocs());
        recv_buffers.resize(fiber_control::get_instance().num_workers());
        for (size_t i = 0;i < send_buffers.size(); ++i) {
          send_buffers[i].resize(dc.numprocs());
@@ -175,18 +208,27 @@ namespace graphlab {
      */
     void send(const procid_t proc, const T& value) {
       size_t wid = fiber_control::get_worker_id();
+      if (local) {
+        local_buffers[wid].push_back(value);
+        if (local_buffers[wid].size() * sizeof(T) >= max_buffer_size) {
+          move_local_buffer(wid);
+        }
+        return;
+      }
       if (send_buffers[wid][proc].oarc == NULL) {
         send_buffers[wid][proc].oarc = rpc.split_call_begin(&fiber_buffered_exchange::rpc_recv);
+        // the rpc header before this point is never compact
+        send_buffers[wid][proc].oarc->compact = compact;
         // write a header
         (*send_buffers[wid][proc].oarc) << rpc.procid();
         send_buffers[wid][proc].numinserts = 0;
       }
 
       (*(send_buffers[wid][proc].oarc)) << value;
-      ++send_buffers[wid][proc].numinserts;
-
+      const size_t index = wid * rpc.numprocs() + proc;
+      if (++send_buffers[wid][proc].numinserts == 1) flow.first_insert(index);
 
-      if(send_buffers[wid][proc].oarc->off >= max_buffer_size) {
+      if(flow.should_flush(index, send_buffers[wid][proc].oarc->off)) {
         flush_buffer(wid, proc);
       }
     } // end of send
@@ -196,6 +238,10 @@ namespace graphlab {
      * current fiber.
      */
     void partial_flush() {
+      if (local) {
+        move_local_buffer(fiber_control::get_worker_id());
+        return;
+      }
       for(procid_t proc = 0; proc < rpc.numprocs(); ++proc) {
         flush_buffer(fiber_control::get_worker_id(), proc);
       }
@@ -206,6 +252,10 @@ namespace graphlab {
      * Will not return until all machines call flush.
      */
     void flush() {
+      if (local) {
+        for (size_t i = 0; i < local_buffers.size(); ++i) move_local_buffer(i);
+        return;
+      }
       for(size_t i = 0; i < send_buffers.size(); ++i) {
         for (size_t j = 0;j < send_buffers[i].size(); ++j) {
           flush_buffer(i,j);
@@ -280,13 +330,38 @@ namespace graphlab {
       return true;
     }
 
+    /**
+     * Returns the bytes held by the received values not yet taken with
+     * recv(). The send buffers are not counted since they are owned by
+     * the worker threads.
+     */
+    size_t buffered_bytes() {
+      size_t bytes = 0;
+      lock.lock();
+      for (size_t i = 0;i < recv_buffers.size(); ++i) {
+        for (size_t j = 0;j < recv_buffers[i].size(); ++j) {
+          bytes += recv_buffers[i][j].buffer.capacity() * sizeof(T);
+        }
+      }
+      lock.unlock();
+      return bytes;
+    } // end of buffered_bytes
+
     void clear() { }
 
     void barrier() { rpc.barrier(); }
+
+    /// The number of send buffers sent
+    size_t num_flushes() const { return flow.num_flushes(); }
+
+    /// The average number of bytes in the send buffers sent
+    double average_batch_size() const { return flow.average_batch_size(); }
+
   private:
     void rpc_recv(size_t len, wild_pointer w) {
       buffer_type tmp;
       iarchive iarc(reinterpret_cast<const char*>(w.ptr), len);
+      iarc.compact = compact;
       // first desrialize the source process
       procid_t src_proc; iarc >> src_proc;
 //       logstream(LOG_DEBUG) << rpc.procid() << ": Receiving exchange of length "
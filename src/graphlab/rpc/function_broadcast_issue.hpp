@@ -73,9 +73,9 @@ class remote_broadcast_issue1 {
       *(reinterpret_cast < uint32_t * >(arc.buf + len)) = arc.off - beginoff;
       Iterator iter = target_begin;
       while (iter != target_end) {
-        oarchive *buf = get_thread_local_buffer (*iter);
+        oarchive *buf = get_thread_local_buffer (*iter, flags);
         buf->write (arc.buf, arc.off);
-        release_thread_local_buffer (*iter, flags & CONTROL_PACKET);
+        release_thread_local_buffer (*iter, flags);
         ++iter;
       }
       free (arc.buf);
@@ -113,9 +113,9 @@ class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
     *(reinterpret_cast<uint32_t*>(arc.buf + len)) = arc.off - beginoff; \
     Iterator iter = target_begin; \
     while(iter != target_end) { \
-      oarchive* buf = get_thread_local_buffer(*iter);  \
+      oarchive* buf = get_thread_local_buffer(*iter, flags);  \
       buf->write(arc.buf, arc.off);  \
-      release_thread_local_buffer(*iter, flags & CONTROL_PACKET); \
+      release_thread_local_buffer(*iter, flags); \
       ++iter;    \
     } \
     free(arc.buf); \
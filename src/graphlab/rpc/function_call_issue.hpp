@@ -95,7 +95,7 @@ class remote_call_issue1 {
  public:
   static void exec (dc_send * sender, unsigned char flags, procid_t target,
                   F remote_function, const T0 & i0) {
-    oarchive *ptr = get_thread_local_buffer (target);
+    oarchive *ptr = get_thread_local_buffer (target, flags);
     oarchive & arc = *ptr;
     if (reinterpret_cast < size_t > (remote_function) == reinterpret_cast <
 	size_t > (request_reply_handler)) {
@@ -112,7 +112,7 @@ class remote_call_issue1 {
     arc << reinterpret_cast < size_t > (remote_function);
     arc << i0;
     *(reinterpret_cast < uint32_t * >(arc.buf + len)) = arc.off - beginoff;
-    release_thread_local_buffer (target, flags & CONTROL_PACKET);
+    release_thread_local_buffer (target, flags);
   }
 };
 \endcode
@@ -160,7 +160,7 @@ template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
   public: \
   static void exec(dc_send* sender, unsigned char flags, procid_t target, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
-    oarchive* ptr = get_thread_local_buffer(target);  \
+    oarchive* ptr = get_thread_local_buffer(target, flags);  \
     oarchive& arc = *ptr;                         \
     size_t len = dc_send::write_packet_header(arc, _get_procid(), flags, _get_sequentialization_key()); \
     uint32_t beginoff = arc.off; \
@@ -169,7 +169,7 @@ class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
     arc << reinterpret_cast<size_t>(remote_function); \
     BOOST_PP_REPEAT(N, GENARC, _)                \
     *(reinterpret_cast<uint32_t*>(arc.buf + len)) = arc.off - beginoff; \
-    release_thread_local_buffer(target, flags & CONTROL_PACKET); \
+    release_thread_local_buffer(target, flags); \
     if (flags & FLUSH_PACKET) pull_flush_soon_thread_local_buffer(target); \
   }\
 };
@@ -77,9 +77,9 @@ class object_broadcast_issue1 {
     *(reinterpret_cast < uint32_t * >(arc.buf + len)) = curlen;
     Iterator iter = target_begin;
     while (iter != target_end) {
-      oarchive *buf = get_thread_local_buffer (*iter);
+      oarchive *buf = get_thread_local_buffer (*iter, flags);
       buf->write (arc.buf, arc.off);
-      release_thread_local_buffer (*iter, flags & CONTROL_PACKET);
+      release_thread_local_buffer (*iter, flags);
       if ((flags & CONTROL_PACKET) == 0) {
         rmi->inc_bytes_sent ((*iter), curlen);
       }
@@ -118,9 +118,9 @@ class  BOOST_PP_CAT(BOOST_PP_TUPLE_ELEM(2,0,FNAME_AND_CALL), N) { \
     *(reinterpret_cast<uint32_t*>(arc.buf + len)) = curlen; \
     Iterator iter = target_begin;                                       \
     while(iter != target_end) { \
-      oarchive* buf = get_thread_local_buffer(*iter);  \
+      oarchive* buf = get_thread_local_buffer(*iter, flags);  \
       buf->write(arc.buf, arc.off);  \
-      release_thread_local_buffer(*iter, flags & CONTROL_PACKET); \
+      release_thread_local_buffer(*iter, flags); \
       if ((flags & CONTROL_PACKET) == 0) {                                 \
         rmi->inc_bytes_sent((*iter), curlen); \
       } \
@@ -56,7 +56,7 @@ class object_call_issue1 {
   static void exec (dc_dist_object_base * rmi, dc_send * sender,
                     unsigned char flags, procid_t target, size_t objid,
                     F remote_function, const T0 & i0) {
-    oarchive *ptr = get_thread_local_buffer (target);
+    oarchive *ptr = get_thread_local_buffer (target, flags);
     oarchive & arc = *ptr;
     size_t len =
       dc_send::write_packet_header (arc, _get_procid (), flags,
@@ -71,7 +71,7 @@ class object_call_issue1 {
     arc << i0;
     uint32_t curlen = arc.off - beginoff;
     *(reinterpret_cast < uint32_t * >(arc.buf + len)) = curlen;
-    release_thread_local_buffer (target, flags & CONTROL_PACKET);
+    release_thread_local_buffer (target, flags);
     if ((flags & CONTROL_PACKET) == 0) {
       rmi->inc_bytes_sent (target, curlen);
     }
@@ -95,7 +95,7 @@ template<typename T, typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typ
 class  BOOST_PP_CAT(BOOST_PP_TUPLE_ELEM(2,0,FNAME_AND_CALL), N) { \
   public: \
   static void exec(dc_dist_object_base* rmi, dc_send* sender, unsigned char flags, procid_t target, size_t objid, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
-    oarchive* ptr = get_thread_local_buffer(target);  \
+    oarchive* ptr = get_thread_local_buffer(target, flags);  \
     oarchive& arc = *ptr;                         \
     size_t len = dc_send::write_packet_header(arc, _get_procid(), flags, _get_sequentialization_key()); \
     uint32_t beginoff = arc.off; \
@@ -106,7 +106,7 @@ class  BOOST_PP_CAT(BOOST_PP_TUPLE_ELEM(2,0,FNAME_AND_CALL), N) { \
     BOOST_PP_REPEAT(N, GENARC, _)                \
     uint32_t curlen = arc.off - beginoff;   \
     *(reinterpret_cast<uint32_t*>(arc.buf + len)) = curlen; \
-    release_thread_local_buffer(target, flags & CONTROL_PACKET); \
+    release_thread_local_buffer(target, flags); \
     if ((flags & CONTROL_PACKET) == 0) {                      \
       rmi->inc_bytes_sent(target, curlen);           \
     } \
@@ -173,7 +173,7 @@ class object_split_call {
     hdr->packet_type_mask = flags;
     hdr->sequentialization_key = _get_sequentialization_key();
     size_t len = hdr->len;
-    write_thread_local_buffer(target, oarc->buf, oarc->off, flags & CONTROL_PACKET);
+    write_thread_local_buffer(target, oarc->buf, oarc->off, flags);
     if ((flags & CONTROL_PACKET) == 0) {
       rmi->inc_bytes_sent(target, len);
     }
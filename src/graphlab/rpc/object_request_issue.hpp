@@ -67,7 +67,7 @@ class object_request_issue1 {
                     size_t request_handle, unsigned char flags,
                     procid_t target, size_t objid, F remote_function,
                     const T0 & i0) {
-    oarchive *ptr = get_thread_local_buffer (target);
+    oarchive *ptr = get_thread_local_buffer (target, flags);
     oarchive & arc = *ptr;
     size_t len =
       dc_send::write_packet_header (arc, _get_procid (), flags,
@@ -83,7 +83,7 @@ class object_request_issue1 {
     arc << i0;
     uint32_t curlen = arc.off - beginoff;
     *(reinterpret_cast < uint32_t * >(arc.buf + len)) = curlen;
-    release_thread_local_buffer (target, flags & CONTROL_PACKET);
+    release_thread_local_buffer (target, flags);
     if ((flags & CONTROL_PACKET) == 0)
       rmi->inc_bytes_sent (target, curlen);
     pull_flush_thread_local_buffer (target);
@@ -98,7 +98,7 @@ template<typename T,typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, type
 class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
   public: \
   static void exec(dc_dist_object_base* rmi, dc_send* sender, size_t request_handle, unsigned char flags, procid_t target,size_t objid, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
-    oarchive* ptr = get_thread_local_buffer(target);  \
+    oarchive* ptr = get_thread_local_buffer(target, flags);  \
     oarchive& arc = *ptr;                         \
     size_t len = dc_send::write_packet_header(arc, _get_procid(), flags, _get_sequentialization_key()); \
     uint32_t beginoff = arc.off; \
@@ -110,7 +110,7 @@ class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
     BOOST_PP_REPEAT(N, GENARC, _)                \
     uint32_t curlen = arc.off - beginoff;   \
     *(reinterpret_cast<uint32_t*>(arc.buf + len)) = curlen; \
-    release_thread_local_buffer(target, flags & CONTROL_PACKET); \
+    release_thread_local_buffer(target, flags); \
     if ((flags & CONTROL_PACKET) == 0)                       \
       rmi->inc_bytes_sent(target, curlen);           \
     if (flags & FLUSH_PACKET) pull_flush_soon_thread_local_buffer(target); \
@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_RPC_REQUEST_BATCH_HPP
+#define GRAPHLAB_RPC_REQUEST_BATCH_HPP
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <boost/type_traits/function_traits.hpp>
+#include <boost/type_traits/remove_const.hpp>
+#include <boost/type_traits/remove_reference.hpp>
+#include <graphlab/util/generics/remove_member_pointer.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/rpc/request_future.hpp>
+#include <graphlab/rpc/function_ret_type.hpp>
+#include <graphlab/parallel/fiber_remote_request.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+namespace dc_impl {
+/// \internal Calls a member function, promoting a void result to size_t
+template <typename RetType>
+struct batch_invoke {
+  template <typename T, typename F, typename A>
+  static RetType call(T* obj, F fn, const A& arg) { return (obj->*fn)(arg); }
+};
+
+template <>
+struct batch_invoke<void> {
+  template <typename T, typename F, typename A>
+  static size_t call(T* obj, F fn, const A& arg) { (obj->*fn)(arg); return 0; }
+};
+} // namespace dc_impl
+
+/**
+ * \ingroup rpc
+ * \brief Issues many requests to a member function of a distributed
+ * object with a single round trip per machine.
+ *
+ * Requests are queued with add() and sent with flush(), which sends one
+ * message to each machine holding any of the queued requests. The
+ * target machine evaluates all of its requests and returns the results
+ * in a single reply. The result of the request returned by add() is
+ * then read with operator(), which waits for the reply if necessary.
+ * If called within a fiber, the wait deschedules the fiber.
+ *
+ * The function must be a member function of T taking a single argument.
+ * Requests with several arguments can pass a struct or a std::pair.
+ *
+ * \code
+ * request_batch<my_object, int (my_object::*)(const key_type&)>
+ *     batch(rmi, &my_object::lookup);
+ * for (size_t i = 0; i < keys.size(); ++i) {
+ *   batch.add(owner(keys[i]), keys[i]);
+ * }
+ * batch.flush();
+ * for (size_t i = 0; i < keys.size(); ++i) values[i] = batch(i);
+ * \endcode
+ */
+template <typename T, typename F>
+class request_batch {
+ public:
+  typedef typename boost::remove_member_pointer<F>::type function_type;
+  typedef typename boost::remove_const<typename boost::remove_reference<
+      typename boost::function_traits<function_type>::arg1_type>::type>::type
+      argument_type;
+  typedef typename boost::remove_const<typename boost::remove_reference<
+      typename boost::function_traits<function_type>::result_type>::type>::type
+      function_result_type;
+  /// The result type of a request. void is promoted to size_t
+  typedef typename dc_impl::function_ret_type<function_result_type>::type
+      result_type;
+
+  request_batch(dc_dist_object<T>& rmi, F fn):
+      rmi(rmi), fn(fn), args(rmi.numprocs()), replies(rmi.numprocs()),
+      flushed(false) { }
+
+  /**
+   * Queues a request of fn(arg) on machine target. Returns the id of the
+   * request, which is passed to operator() to read the result.
+   */
+  size_t add(procid_t target, const argument_type& arg) {
+    ASSERT_FALSE(flushed);
+    ASSERT_LT(target, rmi.numprocs());
+    requests.push_back(std::make_pair(target, args[target].size()));
+    args[target].push_back(arg);
+    return requests.size() - 1;
+  }
+
+  /// The number of requests queued
+  size_t size() const { return requests.size(); }
+
+  /// Sends all the queued requests. Can only be called once.
+  void flush() {
+    ASSERT_FALSE(flushed);
+    flushed = true;
+    const std::string fnbytes(reinterpret_cast<const char*>(&fn), sizeof(F));
+    for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+      if (args[p].empty()) continue;
+      replies[p] = request_future<std::vector<result_type> >(
+          new fiber_reply_container);
+      rmi.dc().custom_remote_request(p, replies[p].get_handle(),
+                                     STANDARD_CALL,
+                                     &request_batch<T, F>::execute,
+                                     rmi.get_obj_id(), fnbytes, args[p]);
+      std::vector<argument_type>().swap(args[p]);
+    }
+  }
+
+  /// Returns true if the result of request i can be read without blocking
+  bool is_ready(size_t i) {
+    ASSERT_TRUE(flushed);
+    return replies[requests[i].first].is_ready();
+  }
+
+  /// Waits for the result of request i and returns it
+  result_type& operator()(size_t i) {
+    ASSERT_TRUE(flushed);
+    ASSERT_LT(i, requests.size());
+    std::vector<result_type>& result = replies[requests[i].first]();
+    return result[requests[i].second];
+  }
+
+ private:
+  dc_dist_object<T>& rmi;
+  F fn;
+  /// (target, position in the reply of the target) of each request
+  std::vector<std::pair<procid_t, size_t> > requests;
+  /// The queued arguments to each machine
+  std::vector<std::vector<argument_type> > args;
+  std::vector<request_future<std::vector<result_type> > > replies;
+  bool flushed;
+
+  /// Evaluates a batch of requests on the target machine
+  static std::vector<result_type> execute(size_t objid, std::string fnbytes,
+                                          std::vector<argument_type> args) {
+    distributed_control* dc = distributed_control::get_instance();
+    T* obj = reinterpret_cast<T*>(dc->get_registered_object(objid));
+    F fn;
+    ASSERT_EQ(fnbytes.size(), sizeof(F));
+    memcpy(reinterpret_cast<char*>(&fn), fnbytes.c_str(), sizeof(F));
+    std::vector<result_type> ret(args.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+      ret[i] = dc_impl::batch_invoke<function_result_type>::call(obj, fn,
+                                                                 args[i]);
+    }
+    return ret;
+  }
+};
+
+} // namespace graphlab
+#endif
@@ -95,7 +95,7 @@ class remote_request_issue1 {
   static void exec (dc_send * sender, size_t request_handle,
                     unsigned char flags, procid_t target, F remote_function,
                     const T0 & i0) {
-    oarchive *ptr = get_thread_local_buffer (target);
+    oarchive *ptr = get_thread_local_buffer (target, flags);
     oarchive & arc = *ptr;
     size_t len =
       dc_send::write_packet_header (arc, _get_procid (), flags,
@@ -109,7 +109,7 @@ class remote_request_issue1 {
     arc << request_handle;
     arc << i0;
     *(reinterpret_cast < uint32_t * >(arc.buf + len)) = arc.off - beginoff;
-    release_thread_local_buffer (target, flags & CONTROL_PACKET);
+    release_thread_local_buffer (target, flags);
     pull_flush_thread_local_buffer (target);
   }
 };
@@ -144,7 +144,7 @@ template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
   public: \
   static void exec(dc_send* sender, size_t request_handle, unsigned char flags, procid_t target, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
-    oarchive* ptr = get_thread_local_buffer(target);  \
+    oarchive* ptr = get_thread_local_buffer(target, flags);  \
     oarchive& arc = *ptr;                         \
     size_t len = dc_send::write_packet_header(arc, _get_procid(), flags, _get_sequentialization_key()); \
     uint32_t beginoff = arc.off; \
@@ -154,7 +154,7 @@ class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
     arc << request_handle; \
     BOOST_PP_REPEAT(N, GENARC, _)                \
     *(reinterpret_cast<uint32_t*>(arc.buf + len)) = arc.off - beginoff; \
-    release_thread_local_buffer(target, flags & CONTROL_PACKET); \
+    release_thread_local_buffer(target, flags); \
     if (flags & FLUSH_PACKET) pull_flush_soon_thread_local_buffer(target); \
   }\
 };
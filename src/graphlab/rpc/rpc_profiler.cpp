@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <execinfo.h>
+#include <cstdlib>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <graphlab/util/stl_util.hpp>
+#include <graphlab/logger/backtrace.hpp>
+#include <graphlab/rpc/rpc_profiler.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+namespace {
+  struct more_bytes {
+    bool operator()(const std::pair<size_t, rpc_profiler::entry*>& a,
+                    const std::pair<size_t, rpc_profiler::entry*>& b) const {
+      return a.second->bytes.value > b.second->bytes.value;
+    }
+  };
+
+  std::string json_escape(const std::string& s) {
+    std::string ret;
+    for (size_t i = 0; i < s.length(); ++i) {
+      if (s[i] == '"' || s[i] == '\\') ret += '\\';
+      ret += s[i];
+    }
+    return ret;
+  }
+}
+
+rpc_profiler::~rpc_profiler() {
+  for (map_type::iterator iter = entries.begin(); iter != entries.end(); ++iter) {
+    delete iter->second;
+  }
+}
+
+std::vector<std::pair<size_t, rpc_profiler::entry*> >
+rpc_profiler::sorted_entries() const {
+  lock.readlock();
+  std::vector<std::pair<size_t, entry*> > ret(entries.begin(), entries.end());
+  lock.rdunlock();
+  std::sort(ret.begin(), ret.end(), more_bytes());
+  return ret;
+}
+
+std::string rpc_profiler::function_name(size_t dispatch) {
+  void* ptr = reinterpret_cast<void*>(dispatch);
+  char** symbols = backtrace_symbols(&ptr, 1);
+  std::string ret;
+  if (symbols != NULL) {
+    ret = demangle(symbols[0]);
+    free(symbols);
+  } else {
+    std::stringstream strm;
+    strm << ptr;
+    ret = strm.str();
+  }
+  return ret;
+}
+
+std::string rpc_profiler::to_json() const {
+  std::vector<std::pair<size_t, entry*> > sorted = sorted_entries();
+  std::stringstream strm;
+  strm << "[";
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    const entry& e = *sorted[i].second;
+    strm << (i == 0 ? "" : ",") << "\n  {\"function\": \""
+         << json_escape(function_name(sorted[i].first)) << "\", "
+         << "\"calls\": " << e.calls.value << ", "
+         << "\"bytes\": " << e.bytes.value << ", "
+         << "\"total_usec\": " << e.total_usec.value << ", "
+         << "\"usec_histogram\": [";
+    for (size_t j = 0; j < NUM_BUCKETS; ++j) {
+      strm << (j == 0 ? "" : ", ") << e.histogram[j].value;
+    }
+    strm << "]}";
+  }
+  strm << "\n]\n";
+  return strm.str();
+}
+
+std::string rpc_profiler::to_string() const {
+  std::vector<std::pair<size_t, entry*> > sorted = sorted_entries();
+  std::stringstream strm;
+  strm << std::setw(12) << "calls" << std::setw(14) << "bytes"
+       << std::setw(12) << "avg usec" << std::setw(12) << "max usec"
+       << "  function\n";
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    const entry& e = *sorted[i].second;
+    size_t max_bucket = 0;
+    for (size_t j = 0; j < NUM_BUCKETS; ++j) {
+      if (e.histogram[j].value) max_bucket = j;
+    }
+    strm << std::setw(12) << e.calls.value << std::setw(14) << e.bytes.value
+         << std::setw(12) << (e.calls.value ? e.total_usec.value / e.calls.value : 0)
+         << std::setw(12) << "<" + tostr(size_t(1) << max_bucket)
+         << "  " << function_name(sorted[i].first) << "\n";
+  }
+  return strm.str();
+}
+
+} // namespace dc_impl
+} // namespace graphlab
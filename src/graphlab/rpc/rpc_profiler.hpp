@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_RPC_PROFILER_HPP
+#define GRAPHLAB_RPC_PROFILER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ \ingroup rpc
+ \internal
+ Counts the calls received, their serialized bytes and a histogram of
+ their handler execution times, for every dispatch function. Every
+ remote function (or member function and object type) has its own
+ dispatch function, so this tells apart the sources of the traffic.
+
+ Enabled with the "rpc_profile=1" dc init option. The profile of each
+ machine is served on rpc_profile.json by the metrics server and logged
+ when the distributed_control is destroyed.
+ */
+class rpc_profiler {
+ public:
+  /// The histogram bucket i counts the calls taking less than 2^i us
+  enum { NUM_BUCKETS = 24 };
+
+  struct entry {
+    atomic<size_t> calls;
+    atomic<size_t> bytes;
+    atomic<size_t> total_usec;
+    atomic<size_t> histogram[NUM_BUCKETS];
+  };
+
+  /// Records a call of dispatch with len bytes, which took usec us
+  inline void record(size_t dispatch, size_t len, size_t usec) {
+    entry* e = find(dispatch);
+    e->calls.inc();
+    e->bytes.inc(len);
+    e->total_usec.inc(usec);
+    size_t bucket = 0;
+    while (bucket + 1 < NUM_BUCKETS && (size_t(1) << bucket) <= usec) ++bucket;
+    e->histogram[bucket].inc();
+  }
+
+  /// The profile as a JSON array sorted by bytes
+  std::string to_json() const;
+
+  /// The profile as a table sorted by bytes
+  std::string to_string() const;
+
+  ~rpc_profiler();
+
+ private:
+  typedef std::map<size_t, entry*> map_type;
+  map_type entries;
+  rwlock lock;
+
+  inline entry* find(size_t dispatch) {
+    lock.readlock();
+    map_type::const_iterator iter = entries.find(dispatch);
+    entry* e = (iter == entries.end()) ? NULL : iter->second;
+    lock.rdunlock();
+    if (e == NULL) {
+      lock.writelock();
+      entry*& slot = entries[dispatch];
+      if (slot == NULL) slot = new entry;
+      e = slot;
+      lock.wrunlock();
+    }
+    return e;
+  }
+
+  /// The entries sorted by decreasing bytes
+  std::vector<std::pair<size_t, entry*> > sorted_entries() const;
+
+  /// The demangled name of the dispatch function at address dispatch
+  static std::string function_name(size_t dispatch);
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
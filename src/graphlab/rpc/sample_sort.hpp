@@ -24,11 +24,16 @@
 #ifndef GRAPHLAB_RPC_SAMPLE_SORT_HPP
 #define GRAPHLAB_RPC_SAMPLE_SORT_HPP
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <vector>
 #include <algorithm>
 #include <utility>
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/logger/assertions.hpp>
 namespace graphlab {
 
@@ -40,84 +45,260 @@ namespace sample_sort_impl {
       return k1.first < k2.first;
     }
   };
-}
 
-template <typename Key, typename Value>
-class sample_sort {
- private:
-  dc_dist_object<sample_sort<Key, Value> > rmi;
+  /// Sorts values by the values themselves
+  template <typename T>
+  struct identity_key {
+    typedef T key_type;
+    const T& operator()(const T& t) const { return t; }
+  };
 
-  typedef buffered_exchange<std::pair<Key, Value> > key_exchange_type;
+  /// Sorts pairs by their first element
+  template <typename Key, typename Value>
+  struct pair_first_key {
+    typedef Key key_type;
+    const Key& operator()(const std::pair<Key, Value>& t) const {
+      return t.first;
+    }
+  };
 
-  key_exchange_type key_exchange;
-  std::vector<std::pair<Key, Value> > key_values;
+  template <typename T, typename KeyExtractor>
+  struct key_less {
+    KeyExtractor key;
+    key_less(const KeyExtractor& key): key(key) { }
+    bool operator()(const T& a, const T& b) const { return key(a) < key(b); }
+  };
+
+  /// Orders weighted samples by key
+  template <typename Key>
+  struct sample_less {
+    bool operator()(const std::pair<Key, double>& a,
+                    const std::pair<Key, double>& b) const {
+      return a.first < b.first;
+    }
+  };
+
+  /**
+   * Sorts v with up to nthreads threads: blocks of the array are
+   * sorted in parallel and then merged pairwise in parallel rounds.
+   */
+  template <typename T, typename Less>
+  void parallel_sort(std::vector<T>& v, Less less, size_t nthreads) {
+    const size_t min_block = 4096;
+    const size_t nblocks = std::max<size_t>(1,
+        std::min(nthreads, v.size() / min_block));
+    std::vector<size_t> bounds(nblocks + 1);
+    for (size_t i = 0; i <= nblocks; ++i) bounds[i] = v.size() * i / nblocks;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nblocks)
+#endif
+    for (ssize_t i = 0; i < ssize_t(nblocks); ++i) {
+      std::sort(v.begin() + bounds[i], v.begin() + bounds[i + 1], less);
+    }
+    for (size_t width = 1; width < nblocks; width *= 2) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nblocks)
+#endif
+      for (ssize_t i = 0; i < ssize_t(nblocks); i += 2 * width) {
+        if (size_t(i) + width >= nblocks) continue;
+        const size_t end = std::min(size_t(i) + 2 * width, nblocks);
+        std::inplace_merge(v.begin() + bounds[i],
+                           v.begin() + bounds[i + width],
+                           v.begin() + bounds[end], less);
+      }
+    }
+  }
+}
+
+/**
+ * \ingroup rpc
+ * \brief A distributed sort of the values held by all machines.
+ *
+ * Every machine calls sort() with its values. On return each machine
+ * holds a contiguous range of the globally sorted values, machine 0
+ * the smallest. Values are ordered by the key returned by the
+ * KeyExtractor, which must define key_type and return the key of a
+ * value from a const operator(). The keys must be serializable and
+ * comparable with operator<.
+ *
+ * The sort runs in three steps.
+ * \li Each machine sorts its values with multiple threads and takes
+ *     oversampling * numprocs() regularly spaced keys as samples,
+ *     weighted by its number of values.
+ * \li The samples are gathered everywhere and the weighted quantiles
+ *     become the numprocs() - 1 splitters. Values equal to splitters
+ *     are spread over all the machines whose range is just that value,
+ *     so many repeated keys do not all land on one machine.
+ * \li The values are streamed to their machines through a
+ *     buffered_exchange by multiple threads and the received values
+ *     are sorted again.
+ *
+ * \code
+ * struct score_key {
+ *   typedef double key_type;
+ *   double operator()(const std::pair<vertex_id_type, double>& p) const {
+ *     return -p.second;
+ *   }
+ * };
+ * distributed_sort<std::pair<vertex_id_type, double>, score_key> sorter(dc);
+ * sorter.sort(scores); // scores now holds a range of the highest scores first
+ * \endcode
+ */
+template <typename T,
+          typename KeyExtractor = sample_sort_impl::identity_key<T> >
+class distributed_sort {
  public:
-  sample_sort(distributed_control& dc): rmi(dc, this), key_exchange(dc) { }
+  typedef typename KeyExtractor::key_type key_type;
 
-  template <typename KeyIterator, typename ValueIterator>
-  void sort(KeyIterator kstart, KeyIterator kend,
-            ValueIterator vstart, ValueIterator vend) {
+  enum { DEFAULT_OVERSAMPLING = 32 };
+
+  /**
+   * \param dc The distributed control object
+   * \param key The key extractor
+   * \param nthreads The number of threads used for the local sorts and
+   *                 the exchange. Defaults to the number of cores.
+   * \param oversampling The number of samples per machine per splitter.
+   *                     More samples balance skewed keys better.
+   */
+  distributed_sort(distributed_control& dc,
+                   const KeyExtractor& key = KeyExtractor(),
+                   size_t nthreads = thread::cpu_count(),
+                   size_t oversampling = DEFAULT_OVERSAMPLING) :
+    rmi(dc, this), key(key), nthreads(std::max<size_t>(1, nthreads)),
+    oversampling(std::max<size_t>(1, oversampling)),
+    exchange(dc, std::max<size_t>(1, nthreads)) { }
+
+  /**
+   * Sorts the values of all machines in place: values is replaced with
+   * the range of the sorted values held by this machine. Must be called
+   * by all machines.
+   */
+  void sort(std::vector<T>& values) {
+    sample_sort_impl::key_less<T, KeyExtractor> less(key);
+    sample_sort_impl::parallel_sort(values, less, nthreads);
+    if (rmi.numprocs() == 1) return;
+    std::vector<key_type> splitters = find_splitters(values);
+    shuffle(values, splitters);
+    sample_sort_impl::parallel_sort(values, less, nthreads);
     rmi.barrier();
+  }
 
-    size_t num_entries = std::distance(kstart, kend);
-    ASSERT_EQ(num_entries, std::distance(vstart, vend));
+ private:
+  dc_dist_object<distributed_sort> rmi;
+  KeyExtractor key;
+  size_t nthreads;
+  size_t oversampling;
+  buffered_exchange<T> exchange;
 
-    // we will sample k * p entries
-    std::vector<std::vector<Key> > sampled_keys(rmi.numprocs());
-    for (size_t i = 0;i < 100 * rmi.numprocs(); ++i) {
-      size_t idx = (rand() % num_entries); 
-      sampled_keys[rmi.procid()].push_back(*(kstart + idx));
+  /// The numprocs() - 1 splitters given the locally sorted values
+  std::vector<key_type> find_splitters(const std::vector<T>& values) {
+    typedef std::pair<key_type, double> sample_type;
+    const size_t nsamples = std::min(values.size(),
+                                     oversampling * rmi.numprocs());
+    std::vector<std::vector<sample_type> > samples(rmi.numprocs());
+    // each sample stands for the same share of the local values
+    for (size_t i = 0; i < nsamples; ++i) {
+      const size_t idx = (2 * i + 1) * values.size() / (2 * nsamples);
+      samples[rmi.procid()].push_back(
+          sample_type(key(values[idx]), double(values.size()) / nsamples));
     }
-
-    rmi.all_gather(sampled_keys);
-    // collapse into a single array and sort
-    std::vector<Key> all_sampled_keys;
-    for (size_t i = 0;i < sampled_keys.size(); ++i) {
-      std::copy(sampled_keys[i].begin(), sampled_keys[i].end(),
-                std::inserter(all_sampled_keys, all_sampled_keys.end()));
+    rmi.all_gather_direct(samples);
+    std::vector<sample_type> all_samples;
+    double total_weight = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      for (size_t j = 0; j < samples[i].size(); ++j) {
+        all_samples.push_back(samples[i][j]);
+        total_weight += samples[i][j].second;
+      }
+    }
+    std::sort(all_samples.begin(), all_samples.end(),
+              sample_sort_impl::sample_less<key_type>());
+    // splitter j is the weighted quantile j / numprocs()
+    std::vector<key_type> splitters(rmi.numprocs() - 1);
+    double cumulative = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < all_samples.size() && next < splitters.size(); ++i) {
+      cumulative += all_samples[i].second;
+      while (next < splitters.size() &&
+             cumulative >= total_weight * (next + 1) / rmi.numprocs()) {
+        splitters[next++] = all_samples[i].first;
+      }
     }
-    // sort the sampled keys and extract the ranges
-    std::sort(all_sampled_keys.begin(), all_sampled_keys.end());
-    std::vector<Key> ranges(rmi.numprocs());
-    ranges[0] = Key();
-    for(size_t i = 1; i < rmi.numprocs(); ++i) {
-      ranges[i] = all_sampled_keys[sampled_keys[0].size() * i];
+    // no samples at all: everything goes to the last machine
+    for (; next < splitters.size(); ++next) {
+      splitters[next] = all_samples.empty() ? key_type() : all_samples.back().first;
     }
+    return splitters;
+  }
 
-    // begin shuffle 
-    KeyIterator kiter = kstart;
-    ValueIterator viter = vstart;
-    if (rmi.numprocs() < 8) {
-      while(kiter != kend) {
-        procid_t target_machine = 0;
-        while (target_machine < rmi.numprocs() - 1  && 
-               ranges[target_machine + 1] < *kiter) ++target_machine;
-        key_exchange.send(target_machine, std::make_pair(*kiter, *viter));
-        ++kiter; ++viter;
-      }
-    } 
-    else {
-      while(kiter != kend) {
-        procid_t target_machine = 
-          std::upper_bound(ranges.begin(), ranges.end(), *kiter) 
-          - ranges.begin() - 1;
-        key_exchange.send(target_machine, std::make_pair(*kiter, *viter));
-        ++kiter; ++viter;
+  /**
+   * Sends every value to its machine and replaces values with the
+   * received values. Machine t receives the keys in
+   * (splitters[t-1], splitters[t]].
+   */
+  void shuffle(std::vector<T>& values, const std::vector<key_type>& splitters) {
+    const size_t nblocks = std::min(nthreads, std::max<size_t>(1, values.size()));
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nblocks)
+#endif
+    for (ssize_t b = 0; b < ssize_t(nblocks); ++b) {
+      const size_t begin = values.size() * b / nblocks;
+      const size_t end = values.size() * (b + 1) / nblocks;
+      size_t round_robin = b;
+      for (size_t i = begin; i < end; ++i) {
+        const key_type& k = key(values[i]);
+        size_t lo = std::lower_bound(splitters.begin(), splitters.end(), k)
+          - splitters.begin();
+        size_t target = lo;
+        if (lo < splitters.size() && !(k < splitters[lo])) {
+          // k is a splitter. Any machine whose range ends with k will do
+          const size_t hi = std::upper_bound(splitters.begin() + lo,
+                                             splitters.end(), k)
+            - splitters.begin();
+          target = lo + (round_robin++ % (hi - lo));
+        }
+        exchange.send(procid_t(target), values[i], b);
       }
+      exchange.partial_flush(b);
     }
-    key_exchange.flush();
- 
-    // read from key exchange 
+    std::vector<T>().swap(values);
+    exchange.flush();
     procid_t recvid;
-    typename key_exchange_type::buffer_type buffer;
-    while(key_exchange.recv(recvid, buffer)) {
-      std::copy(buffer.begin(), buffer.end(), 
-          std::inserter(key_values, key_values.end()));
+    typename buffered_exchange<T>::buffer_type buffer;
+    while(exchange.recv(recvid, buffer)) {
+      values.insert(values.end(), buffer.begin(), buffer.end());
     }
-    std::sort(key_values.begin(), key_values.end(), 
-        sample_sort_impl::pair_key_comparator<Key,Value>());
+  }
+};
 
-    rmi.barrier();
+/**
+ * \ingroup rpc
+ * Sorts (key, value) pairs given as separate key and value sequences.
+ * A thin wrapper around distributed_sort.
+ */
+template <typename Key, typename Value>
+class sample_sort {
+ private:
+  typedef distributed_sort<std::pair<Key, Value>,
+                           sample_sort_impl::pair_first_key<Key, Value> >
+      sort_type;
+  sort_type sorter;
+  std::vector<std::pair<Key, Value> > key_values;
+ public:
+  sample_sort(distributed_control& dc): sorter(dc) { }
+
+  template <typename KeyIterator, typename ValueIterator>
+  void sort(KeyIterator kstart, KeyIterator kend,
+            ValueIterator vstart, ValueIterator vend) {
+    size_t num_entries = std::distance(kstart, kend);
+    ASSERT_EQ(num_entries, std::distance(vstart, vend));
+    key_values.clear();
+    key_values.reserve(num_entries);
+    while(kstart != kend) {
+      key_values.push_back(std::make_pair(*kstart, *vstart));
+      ++kstart; ++vstart;
+    }
+    sorter.sort(key_values);
   }
 
   std::vector<std::pair<Key, Value> >& result() {
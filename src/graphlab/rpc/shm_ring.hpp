@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_RPC_SHM_RING_HPP
+#define GRAPHLAB_RPC_SHM_RING_HPP
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ \ingroup rpc
+ \internal
+ A single producer, single consumer byte ring in a named POSIX shared
+ memory segment. Used to stream data between two processes on the same
+ host. The consumer creates the ring and the producer opens it by name.
+ The head and tail only ever grow, and are in separate cache lines.
+ */
+class shm_ring {
+ public:
+  shm_ring() : hdr(NULL), data(NULL), maplen(0) { }
+
+  ~shm_ring() { close(); }
+
+  /**
+   * Creates a ring with room for capacity bytes, rounded up to a power
+   * of 2, replacing any stale segment of the same name.
+   */
+  void create(const std::string& name, size_t capacity) {
+    size_t cap = 4096;
+    while (cap < capacity) cap *= 2;
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      logstream(LOG_FATAL) << "Unable to create shared memory segment "
+                           << name << ": " << strerror(errno) << std::endl;
+    }
+    maplen = sizeof(header) + cap;
+    if (ftruncate(fd, maplen) != 0) {
+      logstream(LOG_FATAL) << "Unable to size shared memory segment "
+                           << name << ": " << strerror(errno) << std::endl;
+    }
+    map(fd, name);
+    hdr->head = 0;
+    hdr->tail = 0;
+    hdr->capacity = cap;
+  }
+
+  /// Opens a ring created by create() and removes its name
+  void open(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+      logstream(LOG_FATAL) << "Unable to open shared memory segment "
+                           << name << ": " << strerror(errno) << std::endl;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) <= sizeof(header)) {
+      logstream(LOG_FATAL) << "Bad shared memory segment " << name << std::endl;
+    }
+    maplen = st.st_size;
+    map(fd, name);
+    // both ends are mapped, the name is no longer needed
+    shm_unlink(name.c_str());
+  }
+
+  void close() {
+    if (hdr != NULL) munmap(hdr, maplen);
+    hdr = NULL;
+    data = NULL;
+  }
+
+  inline bool is_open() const { return hdr != NULL; }
+
+  /// The number of bytes which can be written without blocking
+  inline size_t free_space() const {
+    return hdr->capacity - (hdr->head - hdr->tail);
+  }
+
+  /// The number of bytes waiting to be read
+  inline size_t readable() const {
+    return hdr->head - hdr->tail;
+  }
+
+  /**
+   * Producer only. Writes as much of the len bytes in c as fits,
+   * returning the number of bytes written.
+   */
+  size_t write(const char* c, size_t len) {
+    const uint64_t head = hdr->head;
+    len = std::min(len, free_space());
+    const size_t pos = head & (hdr->capacity - 1);
+    const size_t first = std::min(len, size_t(hdr->capacity - pos));
+    memcpy(data + pos, c, first);
+    memcpy(data, c + first, len - first);
+    __sync_synchronize();
+    hdr->head = head + len;
+    return len;
+  }
+
+  /**
+   * Consumer only. Returns the longest contiguous run of readable
+   * bytes, which stays valid until consume().
+   */
+  inline const char* peek(size_t& len) const {
+    const uint64_t tail = hdr->tail;
+    const size_t pos = tail & (hdr->capacity - 1);
+    len = std::min(size_t(hdr->head - tail), size_t(hdr->capacity - pos));
+    __sync_synchronize();
+    return data + pos;
+  }
+
+  /// Consumer only. Releases the first len readable bytes
+  inline void consume(size_t len) {
+    __sync_synchronize();
+    hdr->tail = hdr->tail + len;
+  }
+
+ private:
+  struct header {
+    volatile uint64_t head;
+    char pad0[56];
+    volatile uint64_t tail;
+    char pad1[56];
+    uint64_t capacity;
+    char pad2[56];
+  };
+
+  header* hdr;
+  char* data;
+  size_t maplen;
+
+  void map(int fd, const std::string& name) {
+    void* ptr = mmap(NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+      logstream(LOG_FATAL) << "Unable to map shared memory segment "
+                           << name << ": " << strerror(errno) << std::endl;
+    }
+    hdr = reinterpret_cast<header*>(ptr);
+    data = reinterpret_cast<char*>(ptr) + sizeof(header);
+  }
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -0,0 +1,245 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_SSP_DHT_HPP
+#define GRAPHLAB_SSP_DHT_HPP
+
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup rpc
+   * \brief A write-back caching DHT with bounded staleness.
+   *
+   * Every key is owned by the machine hash(key) % numprocs. Reads of
+   * keys owned by other machines are served from a local cache as long
+   * as the cached value is at most staleness clocks old.  Otherwise the
+   * value is fetched again from the owner. Writes are deltas. They are
+   * applied to the cached value at once, accumulated per key, and sent
+   * to the owners in bulk through a buffered_exchange when clock() is
+   * called.
+   *
+   * clock() must be called by all machines together. When it returns,
+   * the deltas of all machines from before the call have been applied
+   * by the owners. A read therefore sees all the local deltas, and all
+   * the deltas of other machines up to staleness clocks old. With
+   * staleness 0 every clock refetches the values read.
+   *
+   * DeltaType() must be the identity of value_type += delta_type.
+   */
+  template<typename KeyType, typename ValueType,
+           typename DeltaType = ValueType>
+  class ssp_dht {
+  public:
+    typedef KeyType   key_type;
+    typedef ValueType value_type;
+    typedef DeltaType delta_type;
+
+  private:
+    struct cache_entry {
+      /// the value of the owner when fetched plus all the local deltas
+      value_type value;
+      /// the local deltas not yet sent to the owner
+      delta_type delta;
+      /// the clock at which the value was fetched
+      size_t clock;
+      bool fetched;
+      bool dirty;
+      cache_entry() : value(), delta(), clock(0),
+                      fetched(false), dirty(false) { }
+    };
+
+    typedef boost::unordered_map<key_type, value_type> data_map_type;
+    typedef boost::unordered_map<key_type, cache_entry> cache_map_type;
+    typedef std::pair<key_type, delta_type> delta_record;
+    typedef buffered_exchange<delta_record> exchange_type;
+
+    //! The remote procedure call manager
+    mutable dc_dist_object<ssp_dht> rpc;
+
+    //! Carries the deltas to their owners
+    exchange_type delta_exchange;
+
+    //! The data owned by this machine
+    data_map_type data_map;
+    mutex data_lock;
+
+    //! The cached values of keys owned by other machines
+    cache_map_type cache;
+    mutex cache_lock;
+
+    //! The maximum age in clocks of a cached value
+    size_t max_staleness;
+
+    //! The number of completed clocks
+    size_t current_clock;
+
+    boost::hash<key_type> hash_function;
+
+    mutable atomic<size_t> hits;
+    mutable atomic<size_t> misses;
+
+  public:
+
+    ssp_dht(distributed_control& dc, size_t staleness = 0) :
+      rpc(dc, this), delta_exchange(dc),
+      max_staleness(staleness), current_clock(0) {
+      rpc.barrier();
+    }
+
+    ~ssp_dht() { rpc.full_barrier(); }
+
+    /// Sets the maximum age in clocks of the cached values
+    void set_staleness(size_t staleness) { max_staleness = staleness; }
+    size_t staleness() const { return max_staleness; }
+
+    /// The number of calls to clock()
+    size_t clock_value() const { return current_clock; }
+
+    size_t cache_hits() const { return hits.value; }
+    size_t cache_misses() const { return misses.value; }
+
+    size_t owning_cpu(const key_type& key) const {
+      return hash_function(key) % rpc.numprocs();
+    }
+
+    bool is_local(const key_type& key) const {
+      return owning_cpu(key) == rpc.procid();
+    }
+
+    /// Reads the value of key, which is at most staleness clocks old
+    value_type get(const key_type& key) {
+      if (is_local(key)) return get_master(key);
+      cache_lock.lock();
+      {
+        const cache_entry& entry = cache[key];
+        if (entry.fetched && current_clock - entry.clock <= max_staleness) {
+          ++hits;
+          const value_type ret_value = entry.value;
+          cache_lock.unlock();
+          return ret_value;
+        }
+      }
+      ++misses;
+      cache_lock.unlock();
+      const value_type master =
+        rpc.remote_request(owning_cpu(key), &ssp_dht::get_master, key);
+      cache_lock.lock();
+      cache_entry& entry = cache[key];
+      entry.value = master;
+      entry.value += entry.delta;
+      entry.clock = current_clock;
+      entry.fetched = true;
+      const value_type ret_value = entry.value;
+      cache_lock.unlock();
+      return ret_value;
+    }
+
+    /// Adds delta to the value of key
+    void apply_delta(const key_type& key, const delta_type& delta) {
+      if (is_local(key)) {
+        data_lock.lock();
+        data_map[key] += delta;
+        data_lock.unlock();
+      } else {
+        cache_lock.lock();
+        cache_entry& entry = cache[key];
+        if (entry.fetched) entry.value += delta;
+        entry.delta += delta;
+        entry.dirty = true;
+        cache_lock.unlock();
+      }
+    }
+
+    /**
+     * Sends all the buffered deltas to their owners and advances the
+     * clock. Must be called by all machines simultaneously, and not
+     * concurrently with get() or apply_delta().
+     */
+    void clock() {
+      typedef typename cache_map_type::value_type pair_type;
+      cache_lock.lock();
+      foreach(pair_type& pair, cache) {
+        cache_entry& entry = pair.second;
+        if (entry.dirty) {
+          delta_exchange.send(owning_cpu(pair.first),
+                              delta_record(pair.first, entry.delta));
+          entry.delta = delta_type();
+          entry.dirty = false;
+        }
+      }
+      cache_lock.unlock();
+      delta_exchange.flush();
+      procid_t proc;
+      typename exchange_type::buffer_type buffer;
+      while (delta_exchange.recv(proc, buffer)) {
+        data_lock.lock();
+        foreach(const delta_record& rec, buffer) data_map[rec.first] += rec.second;
+        data_lock.unlock();
+      }
+      // all deltas must be applied before anyone fetches again
+      rpc.barrier();
+      ++current_clock;
+    }
+
+    /**
+     * Drops all the cached values. Deltas not yet sent by clock() are
+     * lost.
+     */
+    void clear_cache() {
+      cache_lock.lock();
+      cache.clear();
+      cache_lock.unlock();
+    }
+
+    /// Reads the value of a key owned by this machine
+    value_type get_master(const key_type& key) {
+      ASSERT_TRUE(is_local(key));
+      data_lock.lock();
+      const value_type ret_value = data_map[key];
+      data_lock.unlock();
+      return ret_value;
+    }
+
+    size_t local_size() const {
+      data_lock.lock();
+      const size_t result = data_map.size();
+      data_lock.unlock();
+      return result;
+    }
+  }; // end of ssp_dht
+
+}; // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -8,15 +8,16 @@ thread_local_buffer::thread_local_buffer() {
   dc = distributed_control::get_instance();
   size_t nprocs = dc->numprocs(); 
 
-  outbuf.resize(nprocs); 
+  outbuf.resize(nprocs * NUM_SEND_LANES); 
   for (size_t i = 0;i < outbuf.size(); ++i) {
     outbuf[i] = new inplace_lf_queue2<buffer_elem>;
   }
-  current_archive.resize(nprocs); 
+  current_archive.resize(nprocs * NUM_SEND_LANES); 
 
-  archive_locks.resize(nprocs);
+  archive_locks.resize(nprocs * NUM_SEND_LANES);
 
   bytes_sent.resize(nprocs, 0);
+  urgent = false;
   dc->register_send_buffer(this);
   procid = dc->procid();
 }
@@ -46,11 +47,13 @@ void thread_local_buffer::inc_calls_sent(procid_t target) {
 
 void thread_local_buffer::push_flush() {
   for (size_t i = 0; i < outbuf.size(); ++i) {
-    std::pair<buffer_elem*, buffer_elem*> bufs = extract(i);
+    const procid_t target = i % bytes_sent.size();
+    std::pair<buffer_elem*, buffer_elem*> bufs =
+        extract(target, i / bytes_sent.size());
     if (bufs.first != NULL) {
       while(bufs.first != bufs.second) {
         buffer_elem* prev = bufs.first;
-        dc->write_to_buffer(i, bufs.first->buf, bufs.second->len);
+        dc->write_to_buffer(target, bufs.first->buf, bufs.second->len);
         buffer_elem** next = &bufs.first->next;
         volatile buffer_elem** n = (volatile buffer_elem**)(next);
         while(__unlikely__((*n) == NULL)) {
@@ -59,7 +62,7 @@ void thread_local_buffer::push_flush() {
         bufs.first = (buffer_elem*)(*n);
         delete prev;
       }
-      dc->flush_soon(i);
+      dc->flush_soon(target);
     }
   }
 }
@@ -83,99 +86,110 @@ void thread_local_buffer::pull_flush_soon(procid_t p) {
   dc->flush_soon(p);
 }
 
-oarchive* thread_local_buffer::acquire(procid_t target) {
-  archive_locks[target].lock();
+oarchive* thread_local_buffer::acquire(procid_t target, unsigned char flags) {
+  const size_t s = slot(target, lane(flags));
+  archive_locks[s].lock();
   // need a new archive, or existing one at risk of being resized
-  if (current_archive[target].buf == NULL) {
-    current_archive[target].buf = (char*)malloc(INITIAL_BUFFER_SIZE);
-    current_archive[target].off = 0;
-    current_archive[target].len = INITIAL_BUFFER_SIZE;
+  if (current_archive[s].buf == NULL) {
+    current_archive[s].buf = (char*)malloc(INITIAL_BUFFER_SIZE);
+    current_archive[s].off = 0;
+    current_archive[s].len = INITIAL_BUFFER_SIZE;
   }
-  prev_acquire_archive_size = current_archive[target].off;
-  return &current_archive[target];
+  prev_acquire_archive_size = current_archive[s].off;
+  return &current_archive[s];
 }
 
 
-void thread_local_buffer::add_to_queue(procid_t target, char* ptr, size_t len) {
+void thread_local_buffer::add_to_queue(procid_t target, size_t s,
+                                       char* ptr, size_t len) {
   buffer_elem* elem = new buffer_elem;
   ASSERT_NE(ptr, NULL);
   elem->buf = ptr;
   elem->len = len;
   elem->next = NULL;
-  outbuf[target]->enqueue(elem);
-  if (outbuf[target]->approx_size() > NUM_FULL_BUFFER_LIMIT) {
+  outbuf[s]->enqueue(elem);
+  if (outbuf[s]->approx_size() > NUM_FULL_BUFFER_LIMIT) {
     pull_flush_soon(target);
   }
 }
 
-void thread_local_buffer::release(procid_t target, bool do_not_count_bytes_sent) {
-  if (!do_not_count_bytes_sent) {
-    bytes_sent[target] += current_archive[target].off - prev_acquire_archive_size - sizeof(packet_hdr);
+void thread_local_buffer::release(procid_t target, unsigned char flags) {
+  const size_t l = lane(flags);
+  const size_t s = slot(target, l);
+  if ((flags & CONTROL_PACKET) == 0) {
+    bytes_sent[target] += current_archive[s].off - prev_acquire_archive_size - sizeof(packet_hdr);
     inc_calls_sent(target);
   }
 
-  if (current_archive[target].off >= FULL_BUFFER_SIZE_LIMIT) {
+  if (current_archive[s].off >= FULL_BUFFER_SIZE_LIMIT) {
     // shift the buffer into outbuf
-    char* ptr = current_archive[target].buf;
-    size_t len = current_archive[target].off;
-    current_archive[target].buf = NULL; 
-    current_archive[target].off = 0;
-    archive_locks[target].unlock();
+    char* ptr = current_archive[s].buf;
+    size_t len = current_archive[s].off;
+    current_archive[s].buf = NULL; 
+    current_archive[s].off = 0;
+    archive_locks[s].unlock();
 
-    add_to_queue(target, ptr, len);
+    add_to_queue(target, s, ptr, len);
 
   } else {
-    archive_locks[target].unlock();
+    archive_locks[s].unlock();
   }
+  // urgent messages do not wait for the send timeout
+  if (l == URGENT_LANE) pull_flush(target);
 }
 
 
 void thread_local_buffer::write(procid_t target, char* c, size_t len, 
-                                bool do_not_count_bytes_sent) {
-  if (!do_not_count_bytes_sent) {
+                                unsigned char flags) {
+  const size_t l = lane(flags);
+  const size_t s = slot(target, l);
+  if ((flags & CONTROL_PACKET) == 0) {
     bytes_sent[target] += len;
     inc_calls_sent(target);
   }
   // make sure that messsages sent before this write are sent before this write
-  if (current_archive[target].off) {
-    archive_locks[target].lock();
+  if (current_archive[s].off) {
+    archive_locks[s].lock();
 
-    if (current_archive[target].off) {
-      add_to_queue(target, current_archive[target].buf, current_archive[target].off);
+    if (current_archive[s].off) {
+      add_to_queue(target, s, current_archive[s].buf, current_archive[s].off);
     }
-    current_archive[target].buf = NULL; 
-    current_archive[target].off = 0;
-    archive_locks[target].unlock();
+    current_archive[s].buf = NULL; 
+    current_archive[s].off = 0;
+    archive_locks[s].unlock();
   }
-  add_to_queue(target, c, len);
+  add_to_queue(target, s, c, len);
+  if (l == URGENT_LANE) pull_flush(target);
 }
 
 
-std::pair<buffer_elem*, buffer_elem*> thread_local_buffer::extract(procid_t target) {
-  if (current_archive[target].off > 0 ) {
-    if (archive_locks[target].try_lock()) {
-      char* ptr = current_archive[target].buf;
-      size_t len = current_archive[target].off;
+std::pair<buffer_elem*, buffer_elem*>
+thread_local_buffer::extract(procid_t target, size_t lane) {
+  const size_t s = slot(target, lane);
+  if (current_archive[s].off > 0 ) {
+    if (archive_locks[s].try_lock()) {
+      char* ptr = current_archive[s].buf;
+      size_t len = current_archive[s].off;
       if (len > 0) {
-        current_archive[target].buf = NULL;
-        current_archive[target].off = 0;
+        current_archive[s].buf = NULL;
+        current_archive[s].off = 0;
       }
-      archive_locks[target].unlock();
+      archive_locks[s].unlock();
       if (len > 0) {
         buffer_elem* elem = new buffer_elem;
         ASSERT_NE(ptr, NULL);
         elem->buf = ptr;
         elem->len = len;
         elem->next = NULL;
-        outbuf[target]->enqueue(elem);
+        outbuf[s]->enqueue(elem);
       }
     } 
   } 
   std::pair<buffer_elem*, buffer_elem*> ret;
-  ret.first = outbuf[target]->dequeue_all();
+  ret.first = outbuf[s]->dequeue_all();
   if (ret.first != NULL) {
     ASSERT_NE(ret.first->buf, NULL);
-    ret.second = outbuf[target]->end_of_dequeue_list();
+    ret.second = outbuf[s]->end_of_dequeue_list();
     return ret;
   } else {
     return std::pair<buffer_elem*, buffer_elem*>(NULL, NULL);
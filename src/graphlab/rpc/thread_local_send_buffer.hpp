@@ -3,6 +3,7 @@
 #include <graphlab/serialization/oarchive.hpp>
 #include <graphlab/rpc/dc_compile_parameters.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_packet_mask.hpp>
 #include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/util/inplace_lf_queue2.hpp>
 namespace graphlab {
@@ -11,37 +12,63 @@ class distributed_control;
 
 namespace dc_impl {
 
+/**
+ * \internal
+ * The send buffers of one thread. There are NUM_SEND_LANES lanes of
+ * buffers to each target. Messages on the urgent lane are handed to
+ * the sender before the bulk lane and may overtake bulk messages sent
+ * earlier. Control packets, and all messages of a thread with urgent
+ * set, go on the urgent lane.
+ */
 struct thread_local_buffer {
+  enum { URGENT_LANE = 0, BULK_LANE = 1, NUM_SEND_LANES = 2 };
+
+  /// indexed by slot()
   std::vector<inplace_lf_queue2<buffer_elem>* > outbuf;
+  /// indexed by target
   std::vector<size_t> bytes_sent;
 
 
+  /// indexed by slot()
   std::vector<mutex> archive_locks;
   std::vector<oarchive> current_archive;
   size_t prev_acquire_archive_size;
 
   procid_t procid;
   distributed_control* dc;
+  /// whether every message of this thread goes on the urgent lane
+  bool urgent;
 
   thread_local_buffer();
   ~thread_local_buffer();
 
+  /// The lane of a message with packet flags flags
+  inline size_t lane(unsigned char flags) const {
+    return (urgent || (flags & CONTROL_PACKET)) ? URGENT_LANE : BULK_LANE;
+  }
+
+  /// The index of the buffer of a lane to target
+  inline size_t slot(procid_t target, size_t lane) const {
+    return lane * bytes_sent.size() + target;
+  }
+
   /**
    * Must be called from within the thread owning this buffer.
-   * Acquires a buffer to write to
+   * Acquires a buffer to write a message with packet flags flags to
    */
-  oarchive* acquire(procid_t target);
+  oarchive* acquire(procid_t target, unsigned char flags);
 
   inline size_t get_bytes_sent(procid_t target) {
     return bytes_sent[target];
   }
   /**
    * Must be called from within the thread owning this buffer.
-   * Releases a buffer previously acquired with acquire
+   * Releases a buffer previously acquired with acquire. The bytes
+   * of control packets are not counted.
    */
-  void release(procid_t target, bool do_not_count_bytes_sent);
+  void release(procid_t target, unsigned char flags);
 
-  void write(procid_t target, char* c, size_t len, bool do_not_count_bytes_sent);
+  void write(procid_t target, char* c, size_t len, unsigned char flags);
 
   /**
    * Must be called from within the thread owning this buffer.
@@ -82,16 +109,16 @@ struct thread_local_buffer {
   void pull_flush_soon(procid_t p);
 
   /**
-   * Extracts the buffer going to a given target.
+   * Extracts the buffer of a lane going to a given target.
    * The first element of the pair points to the head of the linked list
    * The linked list ends when the pointer becomes the second element of 
    * the pair.
    */
-  std::pair<buffer_elem*, buffer_elem*> extract(procid_t target);
+  std::pair<buffer_elem*, buffer_elem*> extract(procid_t target, size_t lane);
 
   void inc_calls_sent(procid_t target);
 
-  void add_to_queue(procid_t target, char* ptr, size_t len);
+  void add_to_queue(procid_t target, size_t s, char* ptr, size_t len);
 };
 }
 }
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cmath>
+#include <limits>
+#include <graphlab/scheduler/delta_bucket_scheduler.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+// the bucket of an unscheduled vertex
+static const int64_t NO_BUCKET = std::numeric_limits<int64_t>::max();
+// buckets are clamped to +-MAX_BUCKET so that cur + nbuckets cannot overflow
+static const int64_t MAX_BUCKET = int64_t(1) << 60;
+
+void delta_bucket_scheduler::set_options(const graphlab_options& opts) {
+  ncpus = opts.get_ncpus();
+  std::vector<std::string> keys = opts.get_scheduler_args().get_option_keys();
+  foreach(std::string opt, keys) {
+    if (opt == "delta") {
+      opts.get_scheduler_args().get_option("delta", delta);
+      if (!(delta > 0)) {
+        logstream(LOG_FATAL) << "delta must be positive" << std::endl;
+      }
+    } else if (opt == "buckets") {
+      opts.get_scheduler_args().get_option("buckets", nbuckets);
+      if (nbuckets == 0) {
+        logstream(LOG_FATAL) << "buckets must be positive" << std::endl;
+      }
+    }  else {
+      logstream(LOG_FATAL) << "Unexpected Scheduler Option: " << opt << std::endl;
+    }
+  }
+}
+
+// Initializes the internal datastructures
+void delta_bucket_scheduler::initialize_data_structures() {
+  nlanes = std::max(ncpus, size_t(1));
+  lanes = new lane[nbuckets * nlanes];
+  slot_count.resize(nbuckets, atomic<size_t>(0));
+  vertex_is_scheduled.resize(num_vertices);
+  vertex_bucket.resize(num_vertices, NO_BUCKET);
+}
+
+delta_bucket_scheduler::delta_bucket_scheduler(size_t num_vertices,
+                                               const graphlab_options& opts):
+    lanes(NULL), current_bucket(0), nbuckets(1024), delta(1.0),
+    num_vertices(num_vertices) {
+  ASSERT_GE(opts.get_ncpus(), 1);
+  set_options(opts);
+  initialize_data_structures();
+}
+
+delta_bucket_scheduler::~delta_bucket_scheduler() {
+  delete [] lanes;
+}
+
+
+void delta_bucket_scheduler::set_num_vertices(const lvid_type numv) {
+  num_vertices = numv;
+  vertex_is_scheduled.resize(numv);
+  vertex_bucket.resize(numv, NO_BUCKET);
+}
+
+
+int64_t delta_bucket_scheduler::bucket_of(double priority) const {
+  const double b = std::floor(-priority / delta);
+  if (!(b > -MAX_BUCKET)) return -MAX_BUCKET;
+  if (b > MAX_BUCKET) return MAX_BUCKET;
+  return int64_t(b);
+}
+
+
+size_t delta_bucket_scheduler::slot_of(int64_t bucket) const {
+  const int64_t n = int64_t(nbuckets);
+  return size_t(((bucket % n) + n) % n);
+}
+
+
+bool delta_bucket_scheduler::lower_bucket(const lvid_type vid,
+                                          int64_t bucket) {
+  volatile int64_t& vbucket = vertex_bucket[vid];
+  while (true) {
+    const int64_t cur = vbucket;
+    if (cur <= bucket) return false;
+    if (atomic_compare_and_swap(vbucket, cur, bucket)) return true;
+  }
+}
+
+
+void delta_bucket_scheduler::push_entry(const entry_type& entry) {
+  const int64_t cur = current_bucket;
+  if (entry.first >= cur + int64_t(nbuckets)) {
+    overflow_count.inc();
+    overflow.lock.lock();
+    overflow.entries.push_back(entry);
+    overflow.lock.unlock();
+  } else {
+    // buckets already passed are run with the current one
+    const size_t slot = slot_of(std::max(entry.first, cur));
+    size_t l = 0;
+    if (nlanes > 1) l = random::fast_uniform(size_t(0), nlanes - 1);
+    lane& ln = lanes[slot * nlanes + l];
+    // counted before the push so that get_next() never misses it
+    slot_count[slot].inc();
+    ln.lock.lock();
+    ln.entries.push_back(entry);
+    ln.lock.unlock();
+  }
+}
+
+
+void delta_bucket_scheduler::schedule(const lvid_type vid, double priority) {
+  if (vid >= num_vertices) return;
+  const int64_t bucket = bucket_of(priority);
+  vertex_is_scheduled.set_bit(vid);
+  // only the schedule which lowered the bucket pushes an entry
+  if (!lower_bucket(vid, bucket)) return;
+  num_entries.inc();
+  push_entry(entry_type(bucket, vid));
+}
+
+
+void delta_bucket_scheduler::advance(int64_t cur) {
+  advance_lock.lock();
+  if (current_bucket != cur || slot_count[slot_of(cur)].value > 0) {
+    advance_lock.unlock();
+    return;
+  }
+  for (size_t d = 1; d < nbuckets; ++d) {
+    if (slot_count[slot_of(cur + d)].value > 0) {
+      current_bucket = cur + d;
+      advance_lock.unlock();
+      return;
+    }
+  }
+  if (overflow_count.value == 0) {
+    advance_lock.unlock();
+    return;
+  }
+  // the ring is empty: jump to the lowest overflow bucket and move the
+  // entries which are now in range to the ring
+  std::vector<entry_type> moved;
+  overflow.lock.lock();
+  int64_t next = NO_BUCKET;
+  for (size_t i = 0; i < overflow.entries.size(); ++i) {
+    next = std::min(next, overflow.entries[i].first);
+  }
+  if (next != NO_BUCKET) {
+    current_bucket = std::max(next, cur + 1);
+    size_t kept = 0;
+    for (size_t i = 0; i < overflow.entries.size(); ++i) {
+      if (overflow.entries[i].first < current_bucket + int64_t(nbuckets)) {
+        moved.push_back(overflow.entries[i]);
+      } else {
+        overflow.entries[kept++] = overflow.entries[i];
+      }
+    }
+    overflow.entries.resize(kept);
+  }
+  overflow.lock.unlock();
+  for (size_t i = 0; i < moved.size(); ++i) {
+    push_entry(moved[i]);
+    overflow_count.dec();
+  }
+  advance_lock.unlock();
+}
+
+
+/** Get the next element in the queue */
+sched_status::status_enum
+delta_bucket_scheduler::get_next(const size_t cpuid, lvid_type& ret_vid) {
+  std::vector<entry_type> deferred;
+  while (num_entries.value > 0) {
+    const int64_t cur = current_bucket;
+    const size_t slot = slot_of(cur);
+    // take from the lanes of the current bucket, beginning with mine
+    for (size_t i = 0; i < nlanes && slot_count[slot].value > 0; ++i) {
+      lane& ln = lanes[slot * nlanes + (cpuid + i) % nlanes];
+      if (ln.entries.empty()) continue;
+      bool good = false;
+      ln.lock.lock();
+      while (!ln.entries.empty()) {
+        const entry_type e = ln.entries.back();
+        ln.entries.pop_back();
+        slot_count[slot].dec();
+        const lvid_type vid = e.second;
+        if (vid >= num_vertices || !vertex_is_scheduled.get(vid) ||
+            e.first > vertex_bucket[vid]) {
+          // superseded by an entry in a lower bucket
+          num_entries.dec();
+          continue;
+        }
+        if (e.first > cur) {
+          // a later bucket sharing the slot
+          deferred.push_back(e);
+          continue;
+        }
+        num_entries.dec();
+        // a schedule racing with the clear below lowers the bucket from
+        // NO_BUCKET and so pushes a new entry
+        vertex_bucket[vid] = NO_BUCKET;
+        if (vertex_is_scheduled.clear_bit(vid)) {
+          ret_vid = vid;
+          good = true;
+          break;
+        }
+      }
+      ln.lock.unlock();
+      for (size_t j = 0; j < deferred.size(); ++j) push_entry(deferred[j]);
+      deferred.clear();
+      if (good) return sched_status::NEW_TASK;
+    }
+    advance(cur);
+  }
+  return sched_status::EMPTY;
+} // end of get_next
+
+
+bool delta_bucket_scheduler::empty() {
+  return num_entries.value == 0;
+}
+
+} // end of namespace graphlab
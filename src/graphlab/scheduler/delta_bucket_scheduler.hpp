@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_DELTA_BUCKET_SCHEDULER_HPP
+#define GRAPHLAB_DELTA_BUCKET_SCHEDULER_HPP
+
+#include <vector>
+#include <utility>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+
+#include <graphlab/scheduler/ischeduler.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+
+#include <graphlab/options/graphlab_options.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup group_schedulers
+   *
+   * A delta-stepping bucket scheduler (Meyer and Sanders, 2003). A
+   * vertex scheduled with priority p is placed in bucket
+   * floor(-p / delta) and the buckets are processed in increasing
+   * order, the vertices of a bucket in no particular order. Since the
+   * priority of a message is maximized, a shortest path program whose
+   * messages have priority -distance processes the vertices a band of
+   * width delta of distances at a time.
+   *
+   * The nearest "buckets" buckets are kept in a ring, each split in one
+   * lane per thread, and the farther ones in a single overflow list, so
+   * schedule() is a constant time push. Scheduling a vertex into a
+   * lower bucket pushes a new entry and the superseded entry is
+   * discarded when it is reached.
+   */
+  class delta_bucket_scheduler : public ischeduler {
+  public:
+    /// a bucket and a vertex
+    typedef std::pair<int64_t, lvid_type> entry_type;
+
+  private:
+    struct lane {
+      simple_spinlock lock;
+      std::vector<entry_type> entries;
+      char padding[64];
+    };
+
+    // a bitset denoting if a vertex is scheduled
+    dense_bitset vertex_is_scheduled;
+    // the lowest bucket of each scheduled vertex
+    std::vector<int64_t> vertex_bucket;
+
+    // the ring of buckets. Lane l of ring slot s is lanes[s * nlanes + l]
+    lane* lanes;
+    std::vector<atomic<size_t> > slot_count;
+    // the entries at least nbuckets beyond the current bucket
+    lane overflow;
+    atomic<size_t> overflow_count;
+    // the number of entries, including superseded ones
+    atomic<size_t> num_entries;
+
+    volatile int64_t current_bucket;
+    simple_spinlock advance_lock;
+
+    // the number of CPUs
+    size_t ncpus;
+    size_t nlanes;
+    // the number of buckets in the ring
+    size_t nbuckets;
+    // the width of a bucket
+    double delta;
+    // the number of vertices in the graph
+    size_t num_vertices;
+
+    void set_options(const graphlab_options& opts);
+
+    // Initializes the internal datastructures
+    void initialize_data_structures();
+
+    /// the bucket of a priority
+    int64_t bucket_of(double priority) const;
+
+    /// the ring slot of a bucket
+    size_t slot_of(int64_t bucket) const;
+
+    /// Lowers the bucket of a vertex. Returns true if it was lowered.
+    bool lower_bucket(const lvid_type vid, int64_t bucket);
+
+    /// Adds an entry to the ring or to the overflow list
+    void push_entry(const entry_type& entry);
+
+    /**
+     * Moves the current bucket to the next non-empty one. "cur" is the
+     * current bucket seen by the caller.
+     */
+    void advance(int64_t cur);
+
+    delta_bucket_scheduler(const delta_bucket_scheduler&);
+    delta_bucket_scheduler& operator=(const delta_bucket_scheduler&);
+
+  public:
+
+    delta_bucket_scheduler(size_t num_vertices, const graphlab_options& opts);
+
+    ~delta_bucket_scheduler();
+
+    void set_num_vertices(const lvid_type numv);
+
+    void schedule(const lvid_type vid, double priority = 1);
+
+    /** Get the next element in the queue */
+    sched_status::status_enum get_next(const size_t cpuid,
+                                       lvid_type& ret_vid);
+
+    bool empty();
+
+    static void print_options_help(std::ostream& out) {
+      out << "\t delta = [double, the width of a bucket of -priority. "
+          << "Default = 1].\n"
+          << "buckets = [number of buckets addressed directly, "
+          << "Default = 1024]\n";
+    }
+  };
+
+} // end of namespace graphlab
+
+#endif
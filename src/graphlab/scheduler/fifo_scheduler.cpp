@@ -43,6 +43,10 @@ void fifo_scheduler::initialize_data_structures() {
   current_queue.resize(ncpus, 0);
   size_t nqueues = std::max(multi * current_queue.size(), size_t(1));
   queues.resize(nqueues);
+  rings.resize(nqueues);
+  for (size_t i = 0; i < nqueues; ++i) {
+    rings[i] = new mpmc_ring<lvid_type>(RING_CAPACITY);
+  }
   locks.resize(nqueues);
   vertex_is_scheduled.resize(num_vertices);
 }
@@ -55,38 +59,79 @@ fifo_scheduler::fifo_scheduler(size_t num_vertices,
   initialize_data_structures();
 }
 
+fifo_scheduler::~fifo_scheduler() {
+  for (size_t i = 0; i < rings.size(); ++i) delete rings[i];
+}
+
 
 void fifo_scheduler::set_num_vertices(const lvid_type numv) {
   num_vertices = numv;
   vertex_is_scheduled.resize(numv);
 }
 
+size_t fifo_scheduler::choose_queue() {
+  /* "Randomize" the task queue task is put in. Note that we do
+     not care if this counter is corrupted in race conditions
+     Find first queue that is not locked and put task there (or
+     after iteration limit) Choose two random queues and use the
+     one which has smaller size */
+  // M.D. Mitzenmacher The Power of Two Choices in Randomized
+  // Load Balancing (1991)
+  // http://www.eecs.harvard.edu/~michaelm/postscripts/mythesis.
+  size_t idx = 0;
+  if(queues.size() > 1) {
+    const uint32_t prod = 
+        random::fast_uniform(uint32_t(0), 
+                             uint32_t(queues.size() * queues.size() - 1));
+    const uint32_t r1 = prod / queues.size();
+    const uint32_t r2 = prod % queues.size();
+    idx = (queue_size(r1) < queue_size(r2)) ? r1 : r2;
+  }
+  return idx;
+}
+
 void fifo_scheduler::schedule(const lvid_type vid, double priority) {
   if (vid < num_vertices && !vertex_is_scheduled.set_bit(vid)) {
-    /* "Randomize" the task queue task is put in. Note that we do
-       not care if this counter is corrupted in race conditions
-       Find first queue that is not locked and put task there (or
-       after iteration limit) Choose two random queues and use the
-       one which has smaller size */
-    // M.D. Mitzenmacher The Power of Two Choices in Randomized
-    // Load Balancing (1991)
-    // http://www.eecs.harvard.edu/~michaelm/postscripts/mythesis.
-    size_t idx = 0;
-    if(queues.size() > 1) {
-      const uint32_t prod = 
-          random::fast_uniform(uint32_t(0), 
-                               uint32_t(queues.size() * queues.size() - 1));
-      const uint32_t r1 = prod / queues.size();
-      const uint32_t r2 = prod % queues.size();
-      idx = (queues[r1].size() < queues[r2].size()) ? r1 : r2;  
+    const size_t idx = choose_queue();
+    if (!rings[idx]->try_push(vid)) {
+      locks[idx].lock(); queues[idx].push_back(vid); locks[idx].unlock();
+    }
+  }
+}
+
+void fifo_scheduler::schedule_batch(const lvid_type* vids, size_t n,
+                                    const double* priorities) {
+  // the new tasks are put in a queue a chunk at a time
+  const size_t CHUNK_SIZE = 256;
+  lvid_type chunk[CHUNK_SIZE];
+  size_t nchunk = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (vids[i] < num_vertices && !vertex_is_scheduled.set_bit(vids[i])) {
+      chunk[nchunk++] = vids[i];
+    }
+    if (nchunk == CHUNK_SIZE || (i + 1 == n && nchunk > 0)) {
+      const size_t idx = choose_queue();
+      size_t pushed = 0;
+      while (pushed < nchunk && rings[idx]->try_push(chunk[pushed])) ++pushed;
+      if (pushed < nchunk) {
+        locks[idx].lock();
+        queues[idx].insert(queues[idx].end(), chunk + pushed, chunk + nchunk);
+        locks[idx].unlock();
+      }
+      nchunk = 0;
     }
-    locks[idx].lock(); queues[idx].push_back(vid); locks[idx].unlock();
   }
 }
 
 /** Get the next element in the queue */
 sched_status::status_enum fifo_scheduler::get_next(const size_t cpuid,
                                                    lvid_type& ret_vid) {
+  return get_next_batch(cpuid, &ret_vid, 1) ? sched_status::NEW_TASK
+                                            : sched_status::EMPTY;
+} // end of get_next_task
+
+size_t fifo_scheduler::get_next_batch(const size_t cpuid, lvid_type* ret_vids,
+                                      size_t max) {
   /* Check all of my queues for a task */
   // begin scanning from the machine's current queue
   size_t initial_idx = (current_queue[cpuid] % multi) + cpuid * multi;
@@ -96,31 +141,36 @@ sched_status::status_enum fifo_scheduler::get_next(const size_t cpuid,
     // queues owned by this machine
     current_queue[cpuid] += (i < multi);
 
-    // pick up the lock
-    bool good = false;
-    locks[idx].lock();
-    while(!queues[idx].empty()) {
-      // not empty, pop and verify
-      ret_vid = queues[idx].front();
-      queues[idx].pop_front();
-      if (ret_vid < num_vertices) {
-        good = vertex_is_scheduled.clear_bit(ret_vid);
-        if (good) break;
+    size_t n = 0;
+    lvid_type vid;
+    while(n < max && rings[idx]->try_pop(vid)) {
+      if (vid < num_vertices && vertex_is_scheduled.clear_bit(vid)) {
+        ret_vids[n++] = vid;
       }
     }
-    locks[idx].unlock();
-    // managed to retrieve a task
-    if(good) {
-      return sched_status::NEW_TASK;
+    // only pick up the lock if tasks overflowed the ring
+    if (n < max && !queues[idx].empty()) {
+      locks[idx].lock();
+      while(n < max && !queues[idx].empty()) {
+        // not empty, pop and verify
+        vid = queues[idx].front();
+        queues[idx].pop_front();
+        if (vid < num_vertices && vertex_is_scheduled.clear_bit(vid)) {
+          ret_vids[n++] = vid;
+        }
+      }
+      locks[idx].unlock();
     }
+    // managed to retrieve tasks
+    if(n > 0) return n;
   }
-  return sched_status::EMPTY;     
-} // end of get_next_task
+  return 0;
+} // end of get_next_batch
 
 
 bool fifo_scheduler::empty() {
   for (size_t i = 0;i < queues.size(); ++i) {
-    if (!queues[i].empty()) return false;
+    if (!rings[i]->empty() || !queues[i].empty()) return false;
   }
   return true;
 }
@@ -34,6 +34,7 @@
 #include <graphlab/util/random.hpp>
 #include <graphlab/scheduler/ischeduler.hpp>
 #include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/mpmc_ring.hpp>
 
 #include <graphlab/options/graphlab_options.hpp>
 
@@ -59,7 +60,10 @@ namespace graphlab {
 
     // a bitset denoting if a vertex is scheduled
     dense_bitset vertex_is_scheduled;
-    // a collection of FIFO queues
+    // a collection of FIFO queues. Tasks are put in the lock free
+    // ring of a queue, and in its locked overflow queue when the ring
+    // is full.
+    std::vector<mpmc_ring<lvid_type>*> rings;
     std::vector<queue_type> queues;
     // a parallel datastructure to queues containing all the locks
     std::vector<padded_simple_spinlock>   locks;
@@ -74,6 +78,9 @@ namespace graphlab {
     size_t multi;
     // the number of vertices in the graph
     size_t num_vertices;
+
+    // The capacity of the ring of each queue
+    enum { RING_CAPACITY = 4096 };
     
     
   
@@ -81,20 +88,35 @@ namespace graphlab {
 
     // Initializes the internal datastructures
     void initialize_data_structures();
+
+    // Picks the queue new tasks are put in
+    size_t choose_queue();
+
+    // The approximate number of tasks in a queue
+    size_t queue_size(size_t idx) const {
+      return rings[idx]->approx_size() + queues[idx].size();
+    }
   public:
 
     fifo_scheduler(size_t num_vertices,
                    const graphlab_options& opts);
 
+    ~fifo_scheduler();
+
 
     void set_num_vertices(const lvid_type numv);
 
     void schedule(const lvid_type vid, double priority = 1 /* ignored */ );
 
+    void schedule_batch(const lvid_type* vids, size_t n,
+                        const double* priorities = NULL /* ignored */);
+
     /** Get the next element in the queue */
     sched_status::status_enum get_next(const size_t cpuid,
                                        lvid_type& ret_vid);
 
+    size_t get_next_batch(const size_t cpuid, lvid_type* ret_vids, size_t max);
+
 
     bool empty();
 
@@ -86,6 +86,18 @@ namespace graphlab {
      */
     virtual void schedule(const lvid_type vid, double priority = 1) = 0;
 
+    /**
+     * Adds the vertices vids[0 .. n-1] to the schedule. The priority of
+     * vids[i] is priorities[i], or 1 if priorities is NULL.
+     * Schedulers override this to take their locks once per batch.
+     */
+    virtual void schedule_batch(const lvid_type* vids, size_t n,
+                                const double* priorities = NULL) {
+      for (size_t i = 0; i < n; ++i) {
+        schedule(vids[i], priorities == NULL ? 1.0 : priorities[i]);
+      }
+    }
+
 
     /**
      * This function is called by the engine to ask for the next
@@ -98,6 +110,19 @@ namespace graphlab {
     virtual sched_status::status_enum
     get_next(const size_t cpuid, lvid_type& ret_vid) = 0;
 
+    /**
+     * Pops up to max vertices into ret_vids and returns how many were
+     * popped. Returns 0 only if get_next() would return EMPTY.
+     */
+    virtual size_t get_next_batch(const size_t cpuid, lvid_type* ret_vids,
+                                  size_t max) {
+      size_t n = 0;
+      while (n < max && get_next(cpuid, ret_vids[n]) == sched_status::NEW_TASK) {
+        ++n;
+      }
+      return n;
+    }
+
     /// returns true if the scheduler is empty. Need not be consistent.
     virtual bool empty() = 0;
 
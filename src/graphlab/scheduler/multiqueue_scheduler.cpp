@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <limits>
+#include <graphlab/scheduler/multiqueue_scheduler.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+static const double NO_PRIORITY = -std::numeric_limits<double>::infinity();
+
+multiqueue_scheduler::subqueue::subqueue(): pending(NULL), top(NO_PRIORITY) { }
+
+void multiqueue_scheduler::set_options(const graphlab_options& opts) {
+  ncpus = opts.get_ncpus();
+  std::vector<std::string> keys = opts.get_scheduler_args().get_option_keys();
+  foreach(std::string opt, keys) {
+    if (opt == "multi") {
+      opts.get_scheduler_args().get_option("multi", multi);
+    } else if (opt == "min_priority") {
+      opts.get_scheduler_args().get_option("min_priority", min_priority);
+    }  else {
+      logstream(LOG_FATAL) << "Unexpected Scheduler Option: " << opt << std::endl;
+    }
+  }
+}
+
+// Initializes the internal datastructures
+void multiqueue_scheduler::initialize_data_structures() {
+  nqueues = std::max(multi * ncpus, size_t(1));
+  queues = new subqueue[nqueues];
+  vertex_is_scheduled.resize(num_vertices);
+  vertex_priority.resize(num_vertices, NO_PRIORITY);
+}
+
+multiqueue_scheduler::multiqueue_scheduler(size_t num_vertices,
+                                           const graphlab_options& opts):
+    queues(NULL), nqueues(0), multi(2),
+    min_priority(-std::numeric_limits<double>::max()),
+    num_vertices(num_vertices) {
+  ASSERT_GE(opts.get_ncpus(), 1);
+  set_options(opts);
+  initialize_data_structures();
+}
+
+multiqueue_scheduler::~multiqueue_scheduler() {
+  for (size_t i = 0; i < nqueues; ++i) {
+    pending_entry* list = queues[i].pending;
+    while (list != NULL) {
+      pending_entry* next = list->next;
+      delete list;
+      list = next;
+    }
+  }
+  delete [] queues;
+}
+
+
+void multiqueue_scheduler::set_num_vertices(const lvid_type numv) {
+  num_vertices = numv;
+  vertex_is_scheduled.resize(numv);
+  vertex_priority.resize(numv, NO_PRIORITY);
+}
+
+
+bool multiqueue_scheduler::raise_priority(const lvid_type vid,
+                                          double priority) {
+  volatile double& vpriority = vertex_priority[vid];
+  while (true) {
+    const double cur = vpriority;
+    if (cur >= priority) return false;
+    if (atomic_compare_and_swap(vpriority, cur, priority)) {
+      return true;
+    }
+  }
+}
+
+
+void multiqueue_scheduler::push_pending(subqueue& q, const entry_type& entry) {
+  pending_entry* node = new pending_entry;
+  node->entry = entry;
+  do {
+    node->next = q.pending;
+  } while (!atomic_compare_and_swap(q.pending, node->next, node));
+  // raise the estimate of the best priority of the queue
+  while (true) {
+    const double cur = q.top;
+    if (cur >= entry.first) break;
+    if (atomic_compare_and_swap(q.top, cur, entry.first)) break;
+  }
+}
+
+
+void multiqueue_scheduler::schedule(const lvid_type vid, double priority) {
+  if (vid >= num_vertices) return;
+  vertex_is_scheduled.set_bit(vid);
+  // only the schedule which raised the priority pushes an entry. The
+  // entries with a lower priority are discarded when they reach the
+  // top of their heap.
+  if (!raise_priority(vid, priority)) return;
+  size_t idx = 0;
+  if (nqueues > 1) {
+    idx = random::fast_uniform(size_t(0), nqueues - 1);
+  }
+  push_pending(queues[idx], entry_type(priority, vid));
+}
+
+
+bool multiqueue_scheduler::prune_locked(subqueue& q) {
+  // the stack is taken as a whole so the pushers never see a node
+  // being removed
+  pending_entry* list = __sync_lock_test_and_set(&q.pending,
+                                                 (pending_entry*)NULL);
+  while (list != NULL) {
+    q.heap.push(list->entry);
+    pending_entry* next = list->next;
+    delete list;
+    list = next;
+  }
+  while (!q.heap.empty()) {
+    const entry_type& e = q.heap.top();
+    if (e.first < min_priority) break;
+    const lvid_type vid = e.second;
+    if (vid < num_vertices && vertex_is_scheduled.get(vid) &&
+        e.first >= vertex_priority[vid]) {
+      return true;
+    }
+    q.heap.pop();
+  }
+  q.top = q.heap.empty() ? NO_PRIORITY : q.heap.top().first;
+  return false;
+}
+
+
+bool multiqueue_scheduler::pop_locked(subqueue& q, lvid_type& ret_vid) {
+  bool good = false;
+  while (prune_locked(q)) {
+    const lvid_type vid = q.heap.top().second;
+    q.heap.pop();
+    // a schedule racing with the clear below raises the priority from
+    // NO_PRIORITY and so pushes a new entry
+    vertex_priority[vid] = NO_PRIORITY;
+    if (vertex_is_scheduled.clear_bit(vid)) {
+      ret_vid = vid;
+      good = true;
+      break;
+    }
+  }
+  q.top = q.heap.empty() ? NO_PRIORITY : q.heap.top().first;
+  return good;
+}
+
+
+/** Get the next element in the queue */
+sched_status::status_enum multiqueue_scheduler::get_next(const size_t cpuid,
+                                                         lvid_type& ret_vid) {
+  // pop from the better of two random queues, skipping those held
+  // by other threads
+  if (nqueues > 1) {
+    for (size_t attempt = 0; attempt < 2; ++attempt) {
+      const size_t r1 = random::fast_uniform(size_t(0), nqueues - 1);
+      const size_t r2 = random::fast_uniform(size_t(0), nqueues - 1);
+      subqueue& q = (queues[r1].top >= queues[r2].top) ? queues[r1]
+                                                       : queues[r2];
+      if (q.pending == NULL && q.top < min_priority) continue;
+      if (!q.lock.try_lock()) continue;
+      const bool good = pop_locked(q, ret_vid);
+      q.lock.unlock();
+      if (good) return sched_status::NEW_TASK;
+    }
+  }
+  // scan all the queues, beginning with those of this thread
+  const size_t initial_idx = cpuid * multi;
+  for (size_t i = 0; i < nqueues; ++i) {
+    subqueue& q = queues[(initial_idx + i) % nqueues];
+    if (q.pending == NULL && q.top < min_priority) continue;
+    q.lock.lock();
+    const bool good = pop_locked(q, ret_vid);
+    q.lock.unlock();
+    if (good) return sched_status::NEW_TASK;
+  }
+  return sched_status::EMPTY;
+} // end of get_next
+
+
+bool multiqueue_scheduler::empty() {
+  for (size_t i = 0; i < nqueues; ++i) {
+    queues[i].lock.lock();
+    const bool has_task = prune_locked(queues[i]);
+    queues[i].lock.unlock();
+    if (has_task) return false;
+  }
+  return true;
+}
+
+} // end of namespace graphlab
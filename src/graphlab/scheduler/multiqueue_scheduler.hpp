@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_MULTIQUEUE_SCHEDULER_HPP
+#define GRAPHLAB_MULTIQUEUE_SCHEDULER_HPP
+
+#include <vector>
+#include <queue>
+#include <utility>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+
+#include <graphlab/scheduler/ischeduler.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+
+#include <graphlab/options/graphlab_options.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup group_schedulers
+   *
+   * A relaxed concurrent priority scheduler in the style of the
+   * MultiQueue of Rihani, Sanders and Dementiev (2015). There are
+   * "multi" binary heaps per thread. get_next() looks at the best
+   * priority of two random heaps and pops from the better one, so the
+   * returned vertex is among the highest priority vertices with high
+   * probability while threads rarely touch the same heap.
+   *
+   * schedule() never takes a lock. The best priority of each scheduled
+   * vertex is raised with a compare and swap and, if it was raised, an
+   * entry is pushed on the lock free insertion stack of a random heap.
+   * The stack is moved into the heap by the next get_next() holding
+   * the heap. Entries superseded by a higher priority are discarded on
+   * pop, which makes raising the priority of a scheduled vertex
+   * (decrease-key for a max-priority queue) a single push.
+   */
+  class multiqueue_scheduler : public ischeduler {
+  public:
+    typedef std::pair<double, lvid_type> entry_type;
+
+  private:
+    /// an entry on an insertion stack
+    struct pending_entry {
+      entry_type entry;
+      pending_entry* next;
+    };
+
+    struct subqueue {
+      simple_spinlock lock;
+      /// the entries already moved to the heap. Protected by lock.
+      std::priority_queue<entry_type> heap;
+      /// the lock free insertion stack
+      pending_entry* volatile pending;
+      /// an estimate of the best priority in the heap and the stack
+      volatile double top;
+      char padding[64];
+      subqueue();
+    };
+
+    // a bitset denoting if a vertex is scheduled
+    dense_bitset vertex_is_scheduled;
+    // the best priority of each scheduled vertex
+    std::vector<double> vertex_priority;
+    subqueue* queues;
+    size_t nqueues;
+
+    // the number of CPUs
+    size_t ncpus;
+    // The queue to CPU ratio
+    size_t multi;
+    double min_priority;
+    // the number of vertices in the graph
+    size_t num_vertices;
+
+    void set_options(const graphlab_options& opts);
+
+    // Initializes the internal datastructures
+    void initialize_data_structures();
+
+    /// Raises the priority of a vertex. Returns true if it was raised.
+    bool raise_priority(const lvid_type vid, double priority);
+
+    /// Pushes an entry on the insertion stack of a queue
+    void push_pending(subqueue& q, const entry_type& entry);
+
+    /**
+     * Moves the insertion stack to the heap and discards superseded
+     * entries from the top. Returns true if the top entry is a vertex
+     * to return. Must be called with the lock of the queue held.
+     */
+    bool prune_locked(subqueue& q);
+
+    /**
+     * Pops the best valid vertex. Must be called with the lock of the
+     * queue held.
+     */
+    bool pop_locked(subqueue& q, lvid_type& ret_vid);
+
+    multiqueue_scheduler(const multiqueue_scheduler&);
+    multiqueue_scheduler& operator=(const multiqueue_scheduler&);
+
+  public:
+
+    multiqueue_scheduler(size_t num_vertices, const graphlab_options& opts);
+
+    ~multiqueue_scheduler();
+
+    void set_num_vertices(const lvid_type numv);
+
+    void schedule(const lvid_type vid, double priority = 1);
+
+    /** Get the next element in the queue */
+    sched_status::status_enum get_next(const size_t cpuid,
+                                       lvid_type& ret_vid);
+
+    bool empty();
+
+    static void print_options_help(std::ostream& out) {
+      out << "\t multi = [number of queues per thread. Default = 2].\n"
+          << "min_priority = [double, minimum priority required to receive \n"
+          << "\t a message, default = -inf]\n";
+    }
+  };
+
+} // end of namespace graphlab
+
+#endif
@@ -86,56 +86,83 @@ void queued_fifo_scheduler::schedule(const lvid_type vid, double priority) {
   } 
 } // end of schedule
 
+void queued_fifo_scheduler::schedule_batch(const lvid_type* vids, size_t n,
+                                           const double* priorities) {
+  // the whole batch goes through one in queue
+  const size_t cpuid= 
+      random::fast_uniform(size_t(0), 
+                           in_queues.size() - 1);
+  in_queue_locks[cpuid].lock();
+  queue_type& queue = in_queues[cpuid];
+  for (size_t i = 0; i < n; ++i) {
+    if (vids[i] < num_vertices && !vertex_is_scheduled.set_bit(vids[i])) {
+      queue.push_back(vids[i]);
+      if(queue.size() > sub_queue_size) {
+        master_lock.lock();
+        queue_type emptyq;
+        master_queue.push_back(emptyq);
+        master_queue.back().swap(queue);
+        master_lock.unlock();
+      }
+    }
+  }
+  in_queue_locks[cpuid].unlock();
+} // end of schedule_batch
+
+void queued_fifo_scheduler::refill_out_queue(const size_t cpuid) {
+  queue_type& myqueue = out_queues[cpuid];
+  // try to get a queue from the master
+  master_lock.lock();
+  // if master queue is empty... 
+  if (!master_queue.empty()) {
+    myqueue.swap(master_queue.front());
+    master_queue.pop_front();
+    master_lock.unlock();
+  }
+  else {
+    master_lock.unlock();
+    //try to steal from the inqueues
+    for (size_t i = 0; i < in_queues.size(); ++i) {
+      size_t idx = (i + multi * cpuid) % in_queues.size();
+      if (!in_queues[idx].empty()) {
+        in_queue_locks[idx].lock();
+        // double check
+        if(!in_queues[idx].empty()) {
+          myqueue.swap(in_queues[idx]);
+        }
+        in_queue_locks[idx].unlock();
+        if (!myqueue.empty()) break;
+      } 
+    }
+  }
+} // end of refill_out_queue
+
 /** Get the next element in the queue */
 sched_status::status_enum queued_fifo_scheduler::get_next(const size_t cpuid,
                                                           lvid_type& ret_vid) {
+  return get_next_batch(cpuid, &ret_vid, 1) ? sched_status::NEW_TASK
+                                            : sched_status::EMPTY;
+} // end of get_next_task
+
+size_t queued_fifo_scheduler::get_next_batch(const size_t cpuid,
+                                             lvid_type* ret_vids,
+                                             size_t max) {
   queue_type& myqueue = out_queues[cpuid];
-  // if the local queue is empty try to get a queue from the master
+  size_t n = 0;
   out_queue_locks[cpuid].lock();
-  if(myqueue.empty()) {
-    master_lock.lock();
-    // if master queue is empty... 
-    if (!master_queue.empty()) {
-      myqueue.swap(master_queue.front());
-      master_queue.pop_front();
-      master_lock.unlock();
-    }
-    else {
-      master_lock.unlock();
-      //try to steal from the inqueues
-      for (size_t i = 0; i < in_queues.size(); ++i) {
-        size_t idx = (i + multi * cpuid) % in_queues.size();
-        if (!in_queues[idx].empty()) {
-          in_queue_locks[idx].lock();
-          // double check
-          if(!in_queues[idx].empty()) {
-            myqueue.swap(in_queues[idx]);
-          }
-          in_queue_locks[idx].unlock();
-          if (!myqueue.empty()) break;
-        } 
-      }
-    }
-  }
-  // end of get next
-  bool good = false;
-  while(!myqueue.empty()) {
+  while(n < max) {
+    if (myqueue.empty()) refill_out_queue(cpuid);
+    if (myqueue.empty()) break;
     // not empty, pop and verify
-    ret_vid = myqueue.front();
+    const lvid_type vid = myqueue.front();
     myqueue.pop_front();
-    if (ret_vid < num_vertices) {
-      good = vertex_is_scheduled.clear_bit(ret_vid);
-      if (good) break;
+    if (vid < num_vertices && vertex_is_scheduled.clear_bit(vid)) {
+      ret_vids[n++] = vid;
     }
   }
   out_queue_locks[cpuid].unlock();
-
-  if(good) {
-    return sched_status::NEW_TASK;
-  } else {
-    return sched_status::EMPTY;
-  }
-} // end of get_next_task
+  return n;
+} // end of get_next_batch
 
 
 bool queued_fifo_scheduler::empty() {
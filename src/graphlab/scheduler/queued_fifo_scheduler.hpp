@@ -74,6 +74,9 @@ namespace graphlab {
     void set_options(const graphlab_options& opts);
     
     void initialize_data_structures();
+
+    // Refills the empty out queue of a cpu. Called with its lock held.
+    void refill_out_queue(const size_t cpuid);
   public:
 
     queued_fifo_scheduler(size_t num_vertices,
@@ -82,11 +85,16 @@ namespace graphlab {
     void set_num_vertices(const lvid_type numv);
 
     void schedule(const lvid_type vid, double priority = 1 /* ignored */);
+
+    void schedule_batch(const lvid_type* vids, size_t n,
+                        const double* priorities = NULL /* ignored */);
     
     /** Get the next element in the queue */
     sched_status::status_enum get_next(const size_t cpuid,
                                        lvid_type& ret_vid);
 
+    size_t get_next_batch(const size_t cpuid, lvid_type* ret_vids, size_t max);
+
 
     bool empty();
 
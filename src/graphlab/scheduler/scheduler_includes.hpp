@@ -25,6 +25,8 @@
 #include <graphlab/scheduler/fifo_scheduler.hpp>
 #include <graphlab/scheduler/get_message_priority.hpp>
 #include <graphlab/scheduler/ischeduler.hpp>
+#include <graphlab/scheduler/multiqueue_scheduler.hpp>
+#include <graphlab/scheduler/delta_bucket_scheduler.hpp>
  #include <graphlab/scheduler/priority_scheduler.hpp>
 #include <graphlab/scheduler/queued_fifo_scheduler.hpp>
 #include <graphlab/scheduler/scheduler_factory.hpp>
@@ -43,12 +43,22 @@
     "This scheduler maintains a shared FIFO queue of FIFO queues. "     \
     "Each thread maintains its own smaller in and out queues. When a "  \
     "threads out queue is too large (greater than \"queuesize\") then " \
-    "the thread puts its out queue at the end of the master queue."))   
+    "the thread puts its out queue at the end of the master queue."))   \
+  (("multiqueue", multiqueue_scheduler,                                 \
+    "Relaxed concurrent priority queue. Vertices are scheduled without "\
+    "locking and each thread pops the best of two random queues, so "   \
+    "vertices run in approximate priority order with good parallelism."))\
+  (("delta_bucket", delta_bucket_scheduler,                             \
+    "Delta-stepping bucket queue. Vertices are grouped in buckets of "  \
+    "width \"delta\" of -priority and processed bucket by bucket. "     \
+    "Suited to shortest path style programs."))
 
 #include <graphlab/scheduler/fifo_scheduler.hpp>
 #include <graphlab/scheduler/sweep_scheduler.hpp>
 #include <graphlab/scheduler/priority_scheduler.hpp>
 #include <graphlab/scheduler/queued_fifo_scheduler.hpp>
+#include <graphlab/scheduler/multiqueue_scheduler.hpp>
+#include <graphlab/scheduler/delta_bucket_scheduler.hpp>
 
 
 namespace graphlab {
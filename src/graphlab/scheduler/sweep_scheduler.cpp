@@ -31,7 +31,11 @@ void sweep_scheduler::set_options(const graphlab_options& opts) {
   foreach(std::string opt, keys) {
     if (opt == "order") {
       opts.get_scheduler_args().get_option("order", ordering);
-      ASSERT_TRUE(ordering == "random" || ordering == "ascending");
+      ASSERT_TRUE(ordering == "random" || ordering == "ascending" ||
+                  ordering == "blocked");
+    } else if (opt == "block_size") {
+      opts.get_scheduler_args().get_option("block_size", block_size);
+      ASSERT_GT(block_size, 0);
     } else if (opt == "strict") {
       opts.get_scheduler_args().get_option("strict", strict_round_robin);
     } else if (opt == "max_iterations") {
@@ -54,7 +58,8 @@ sweep_scheduler::sweep_scheduler(size_t num_vertices,
     num_vertices(num_vertices),
     strict_round_robin(true),
     max_iterations(std::numeric_limits<size_t>::max()),
-    vertex_is_scheduled(num_vertices) {
+    vertex_is_scheduled(num_vertices),
+    blocked(false), block_size(4096), nblocks(0) {
   // initialize defaults
   ASSERT_GE(opts.get_ncpus(), 1);
   ordering = "random";
@@ -64,6 +69,13 @@ sweep_scheduler::sweep_scheduler(size_t num_vertices,
     randomizer = 1;
   } else if(ordering == "random") {
     randomizer = 1500450271;
+  } else if(ordering == "blocked") {
+    randomizer = 1;
+    blocked = true;
+    // blocks are whole words of the bitset
+    block_size = (block_size + 63) / 64 * 64;
+    ASSERT_MSG(max_iterations == std::numeric_limits<size_t>::max(),
+               "sweep_scheduler: \"max_iterations\" requires order != blocked");
   }
 
   if(strict_round_robin) {
@@ -82,21 +94,104 @@ sweep_scheduler::sweep_scheduler(size_t num_vertices,
     for(size_t i = 0; i < cpu2index.size(); ++i) cpu2index[i] = i;
   }
   vertex_is_scheduled.resize(num_vertices);
+  if (blocked) initialize_blocks();
 } // end of constructor
 
 
 void sweep_scheduler::set_num_vertices(const lvid_type numv) {
   num_vertices = numv;
   vertex_is_scheduled.resize(numv);
+  if (blocked) initialize_blocks();
+}
+
+
+void sweep_scheduler::initialize_blocks() {
+  nblocks = (num_vertices + block_size - 1) / block_size;
+  cursors.resize(ncpus);
+  for (size_t i = 0; i < ncpus; ++i) {
+    cursors[i].home_begin = i * nblocks / ncpus;
+    cursors[i].home_end = (i + 1) * nblocks / ncpus;
+    cursors[i].block = cursors[i].home_begin;
+    cursors[i].pos = cursors[i].block * block_size;
+  }
+}
+
+
+bool sweep_scheduler::claim_in_range(size_t& begin, size_t end,
+                                     lvid_type& ret_vid) {
+  end = std::min(end, num_vertices);
+  while (begin < end) {
+    // the remaining bits of the word containing begin
+    const size_t bitpos = begin % (8 * sizeof(size_t));
+    size_t word = vertex_is_scheduled.containing_word(begin) >> bitpos;
+    if (word == 0) {
+      begin += 8 * sizeof(size_t) - bitpos;
+      continue;
+    }
+    begin += __builtin_ctzl(word);
+    if (begin >= end) break;
+    const lvid_type vid = begin++;
+    if (vertex_is_scheduled.clear_bit(vid)) {
+      ret_vid = vid;
+      return true;
+    }
+  }
+  return false;
 }
 
+
+sched_status::status_enum
+sweep_scheduler::get_next_blocked(const size_t cpuid, lvid_type& ret_vid) {
+  block_cursor& c = cursors[cpuid];
+  // continue the current block
+  if (c.block < nblocks &&
+      claim_in_range(c.pos, (c.block + 1) * block_size, ret_vid)) {
+    return sched_status::NEW_TASK;
+  }
+  // the following blocks of my range, ending with the current one ...
+  const size_t nhome = c.home_end - c.home_begin;
+  const size_t rel = (c.block >= c.home_begin && c.block < c.home_end) ?
+      c.block - c.home_begin : nhome - 1;
+  for (size_t k = 0; k < nblocks; ++k) {
+    size_t b;
+    if (k < nhome) b = c.home_begin + (rel + 1 + k) % nhome;
+    // ... then the ranges of the next cpus, a block at a time
+    else b = (c.home_end + (k - nhome)) % nblocks;
+    size_t pos = b * block_size;
+    if (claim_in_range(pos, (b + 1) * block_size, ret_vid)) {
+      c.block = b;
+      c.pos = pos;
+      return sched_status::NEW_TASK;
+    }
+  }
+  return sched_status::EMPTY;
+} // end of get_next_blocked
+
 void sweep_scheduler::schedule(const lvid_type vid, double priority) {      
   if (vid < num_vertices) vertex_is_scheduled.set_bit(vid);
 } 
 
+void sweep_scheduler::schedule_batch(const lvid_type* vids, size_t n,
+                                     const double* priorities) {
+  for (size_t i = 0; i < n; ++i) {
+    if (vids[i] < num_vertices) vertex_is_scheduled.set_bit(vids[i]);
+  }
+}
+
+size_t sweep_scheduler::get_next_batch(const size_t cpuid, lvid_type* ret_vids,
+                                       size_t max) {
+  size_t n = 0;
+  while (n < max &&
+         sweep_scheduler::get_next(cpuid, ret_vids[n]) == sched_status::NEW_TASK) {
+    ++n;
+  }
+  return n;
+}
+
 
 sched_status::status_enum sweep_scheduler::get_next(const size_t cpuid,
                                                     lvid_type& ret_vid) {         
+  if (blocked) return get_next_blocked(cpuid, ret_vid);
   const size_t max_fails = (num_vertices/ncpus) + 1;
   // Check to see if max iterations have been achieved 
   if(strict_round_robin && (rr_index / num_vertices) >= max_iterations) 
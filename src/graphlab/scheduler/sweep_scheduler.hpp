@@ -38,6 +38,15 @@
 namespace graphlab {
 
    /** \ingroup group_schedulers
+    *
+    * Sweeps over the vertices, running the scheduled ones. With
+    * order=blocked the lvids are split into blocks of "block_size"
+    * consecutive vertices and each cpu sweeps a contiguous range of
+    * blocks, one block at a time, so that the vertices it runs in
+    * succession are close in the local graph. When its own blocks are
+    * idle a cpu moves on to the blocks of the next cpus. Consecutive
+    * lvids are neighbors when the graph was loaded with the
+    * vertex_order=rcm (or degree) graph option.
     */
   class sweep_scheduler: public ischeduler {
   private:
@@ -55,8 +64,33 @@ namespace graphlab {
     dense_bitset vertex_is_scheduled;
     std::string                             ordering;
 
+    /// The block a cpu is sweeping with order=blocked
+    struct block_cursor {
+      size_t block;
+      size_t pos;
+      // the blocks [home_begin, home_end) are swept first
+      size_t home_begin, home_end;
+      char padding[64];
+    };
+    bool blocked;
+    size_t block_size;
+    size_t nblocks;
+    std::vector<block_cursor> cursors;
+
     void set_options(const graphlab_options& opts);
 
+    // Splits the vertices into blocks and assigns them to the cpus
+    void initialize_blocks();
+
+    /**
+     * Claims the first scheduled vertex in [begin, end) of a block.
+     * On success begin is moved past it.
+     */
+    bool claim_in_range(size_t& begin, size_t end, lvid_type& ret_vid);
+
+    sched_status::status_enum get_next_blocked(const size_t cpuid,
+                                               lvid_type& ret_vid);
+
   public:
     sweep_scheduler(size_t num_vertices,
                     const graphlab_options& opts);
@@ -65,13 +99,19 @@ namespace graphlab {
 
     void schedule(const lvid_type vid, double priority = 1 /* ignored */) ; 
 
+    void schedule_batch(const lvid_type* vids, size_t n,
+                        const double* priorities = NULL /* ignored */);
 
     
     sched_status::status_enum get_next(const size_t cpuid, lvid_type& ret_vid);
+
+    size_t get_next_batch(const size_t cpuid, lvid_type* ret_vids, size_t max);
     
     
     static void print_options_help(std::ostream &out) {
-      out << "order = [string: {random, ascending} default=random]\n"
+      out << "order = [string: {random, ascending, blocked} default=random]\n"
+          << "block_size = [integer, vertices per block with order=blocked, "
+          << "default=4096]\n"
           << "strict = [bool, use strict round robin schedule, default=true]\n"
           << "max_iterations = [integer, maximum number of iterations "
           << " (requires strict=true) \n"
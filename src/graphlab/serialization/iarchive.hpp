@@ -31,9 +31,13 @@
 #define GRAPHLAB_IARCHIVE_HPP
 
 #include <iostream>
+#include <stdint.h>
+#include <boost/type_traits/is_signed.hpp>
+#include <boost/type_traits/is_integral.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/serialization/is_pod.hpp>
 #include <graphlab/serialization/has_load.hpp>
+#include <graphlab/util/branch_hints.hpp>
 namespace graphlab {
 
   /**
@@ -80,6 +84,8 @@ namespace graphlab {
     const char* buf;
     size_t off;
     size_t len;
+    /// Must match the oarchive::compact of the archive which wrote the data
+    bool compact;
 
     /// Directly reads a single character from the input stream
     inline char read_char() {
@@ -101,12 +107,32 @@ namespace graphlab {
       if (buf) {
         memcpy(c, buf + off, l);
         off += l;
-      } else {
-        in->read(c, l);
+      } else if (__unlikely__(in->rdbuf()->sgetn(c, l) != std::streamsize(l))) {
+        // read straight from the stream buffer, like oarchive
+        in->setstate(std::ios_base::eofbit | std::ios_base::failbit);
       }
     }
 
 
+    /// Reads an integer written by oarchive::write_integer()
+    template <typename T>
+    inline void read_integer(T& t) {
+      if (__likely__(!compact)) {
+        read(reinterpret_cast<char*>(&t), sizeof(T));
+        return;
+      }
+      uint64_t v = 0;
+      size_t shift = 0;
+      unsigned char c;
+      do {
+        c = (unsigned char)read_char();
+        v |= uint64_t(c & 0x7f) << shift;
+        shift += 7;
+      } while ((c & 0x80) && shift < 70);
+      t = boost::is_signed<T>::value ?
+          T(int64_t(v >> 1) ^ -int64_t(v & 1)) : T(v);
+    }
+
     /// Returns true if the underlying stream is in a failure state
     inline bool fail() {
       return in == NULL ? off > len : in->fail();
@@ -119,10 +145,10 @@ namespace graphlab {
      * assiciated input stream.
      */
     inline iarchive(std::istream& instream)
-      : in(&instream), buf(NULL), off(0), len(0) { }
+      : in(&instream), buf(NULL), off(0), len(0), compact(false) { }
 
     inline iarchive(const char* buf, size_t len)
-      : in(NULL), buf(buf), off(0), len(len) { }
+      : in(NULL), buf(buf), off(0), len(len), compact(false) { }
 
     ~iarchive() {}
   };
@@ -155,6 +181,11 @@ namespace graphlab {
       iarc->read(c, len);
     }
 
+    template <typename T>
+    inline void read_integer(T& t) {
+      iarc->read_integer(t);
+    }
+
     /// Returns true if the underlying stream is in a failure state
     inline bool fail() {
       return iarc->fail();
@@ -212,12 +243,28 @@ namespace graphlab {
       }
     };
 
+    /// Reads a POD, going through read_integer() for integers
+    template <typename InArcType, typename T, bool IsInteger>
+    struct pod_deserialize_impl {
+      inline static void exec(InArcType& iarc, T &t) {
+        iarc.read(reinterpret_cast<char*>(&t),
+                  sizeof(T));
+      }
+    };
+
+    template <typename InArcType, typename T>
+    struct pod_deserialize_impl<InArcType, T, true> {
+      inline static void exec(InArcType& iarc, T &t) {
+        iarc.read_integer(t);
+      }
+    };
+
     // catch if type is a POD
     template <typename InArcType, typename T>
     struct deserialize_impl<InArcType, T, true>{
       inline static void exec(InArcType& iarc, T &t) {
-        iarc.read(reinterpret_cast<char*>(&t),
-                  sizeof(T));
+        pod_deserialize_impl<InArcType, T,
+          (boost::is_integral<T>::value && sizeof(T) > 1)>::exec(iarc, t);
       }
     };
 
@@ -32,6 +32,9 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
+#include <boost/type_traits/is_signed.hpp>
+#include <boost/type_traits/is_integral.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/serialization/is_pod.hpp>
 #include <graphlab/serialization/has_save.hpp>
@@ -80,6 +83,11 @@ namespace graphlab {
    * and input, it is necessary to flush the stream before all bytes written to
    * the stringstream are available for input.
    *
+   * If \ref compact is set, integers (including all container
+   * lengths) are written as varints, which takes 1 byte instead of 8
+   * for a small size_t. The archive reading the data must then be
+   * compact as well. Arrays of PODs are still copied as is.
+   *
    * To use this class, include
    * graphlab/serialization/serialization_includes.hpp
    */
@@ -89,12 +97,14 @@ namespace graphlab {
     char* buf;
     size_t off;
     size_t len;
+    /// If set, integers are written as varints. See write_integer().
+    bool compact;
     /// constructor. Takes a generic std::ostream object
     inline oarchive(std::ostream& outstream)
-      : out(&outstream),buf(NULL),off(0),len(0) {}
+      : out(&outstream),buf(NULL),off(0),len(0),compact(false) {}
 
     inline oarchive(void)
-      : out(NULL),buf(NULL),off(0),len(0) {}
+      : out(NULL),buf(NULL),off(0),len(0),compact(false) {}
 
     inline void expand_buf(size_t s) {
         if (__unlikely__(off + s > len)) {
@@ -102,6 +112,25 @@ namespace graphlab {
           buf = (char*)realloc(buf, len);
         }
      }
+    /**
+     * Makes room for at least s more bytes in the buffer so that the
+     * next writes do not reallocate. Does nothing when writing to a
+     * stream.
+     */
+    inline void reserve(size_t s) {
+      if (out == NULL && off + s > len) {
+        len = off + s;
+        buf = (char*)realloc(buf, len);
+      }
+    }
+
+    /**
+     * Discards everything written to the buffer but keeps the buffer
+     * allocated, so that one archive can serialize many messages
+     * without reallocating. The buffer is still released with free().
+     */
+    inline void reset() { off = 0; }
+
     /** Directly writes "s" bytes from the memory location
      * pointed to by "c" into the stream.
      */
@@ -111,7 +140,7 @@ namespace graphlab {
         memcpy(buf + off, c, s);
         off += s;
       } else {
-        out->write(c, s);
+        stream_write(c, s);
       }
     }
     template <typename T>
@@ -122,7 +151,41 @@ namespace graphlab {
         off += sizeof(T);
       }
       else {
-        out->write(reinterpret_cast<const char*>(&t), sizeof(T));
+        stream_write(reinterpret_cast<const char*>(&t), sizeof(T));
+      }
+    }
+
+    /**
+     * Writes an integer with direct_assign(), or in compact mode as a
+     * varint of 7 bits per byte, low bits first. Signed integers are
+     * zigzag encoded so that small negative values stay short.
+     */
+    template <typename T>
+    inline void write_integer(const T& t) {
+      if (__likely__(!compact)) {
+        direct_assign(t);
+        return;
+      }
+      const int64_t s = int64_t(t);
+      uint64_t v = boost::is_signed<T>::value ?
+          (uint64_t(s) << 1) ^ uint64_t(s >> 63) : uint64_t(t);
+      char bytes[10];
+      size_t n = 0;
+      while (v >= 0x80) {
+        bytes[n++] = char(v | 0x80);
+        v >>= 7;
+      }
+      bytes[n++] = char(v);
+      write(bytes, n);
+    }
+
+    /**
+     * Writes straight to the stream buffer, skipping the sentry that
+     * std::ostream::write() builds on every call.
+     */
+    inline void stream_write(const char* c, std::streamsize s) {
+      if (__unlikely__(out->rdbuf()->sputn(c, s) != s)) {
+        out->setstate(std::ios_base::badbit);
       }
     }
 
@@ -177,6 +240,15 @@ namespace graphlab {
       oarc->direct_assign(t);
     }
 
+    inline void reserve(size_t s) {
+      oarc->reserve(s);
+    }
+
+    template <typename T>
+    inline void write_integer(const T& t) {
+      oarc->write_integer(t);
+    }
+
     inline bool fail() {
       return oarc->fail();
     }
@@ -221,12 +293,28 @@ namespace graphlab {
       }
     };
 
+    /// Writes a POD, going through write_integer() for integers
+    template <typename OutArcType, typename T, bool IsInteger>
+    struct pod_serialize_impl {
+      inline static void exec(OutArcType& oarc, const T& t) {
+        oarc.direct_assign(t);
+        //oarc.write(reinterpret_cast<const char*>(&t), sizeof(T));
+      }
+    };
+
+    template <typename OutArcType, typename T>
+    struct pod_serialize_impl<OutArcType, T, true> {
+      inline static void exec(OutArcType& oarc, const T& t) {
+        oarc.write_integer(t);
+      }
+    };
+
     /** Catch if type is a POD */
     template <typename OutArcType, typename T>
     struct serialize_impl<OutArcType, T, true> {
       inline static void exec(OutArcType& oarc, const T& t) {
-        oarc.direct_assign(t);
-        //oarc.write(reinterpret_cast<const char*>(&t), sizeof(T));
+        pod_serialize_impl<OutArcType, T,
+          (boost::is_integral<T>::value && sizeof(T) > 1)>::exec(oarc, t);
       }
     };
 
@@ -24,6 +24,7 @@
 #ifndef GRAPHLAB_SERIALIZE_VECTOR_HPP
 #define GRAPHLAB_SERIALIZE_VECTOR_HPP
 #include <vector>
+#include <string>
 #include <graphlab/serialization/iarchive.hpp>
 #include <graphlab/serialization/oarchive.hpp>
 #include <graphlab/serialization/iterator.hpp>
@@ -31,6 +32,32 @@
 
 namespace graphlab {
   namespace archive_detail {
+    /**
+     * A lower bound on the number of bytes taken by the serialization
+     * of t, used to size the archive buffer once before serializing a
+     * vector. Only PODs, strings and vectors of those are counted.
+     */
+    template <typename T>
+    inline size_t serialized_size_hint(const T&) {
+      return gl_is_pod_or_scaler<T>::value ? sizeof(T) : 0;
+    }
+
+    inline size_t serialized_size_hint(const std::string& s) {
+      return sizeof(size_t) + s.length();
+    }
+
+    template <typename T, typename Alloc>
+    inline size_t serialized_size_hint(const std::vector<T, Alloc>& vec) {
+      if (gl_is_pod_or_scaler<T>::value) {
+        return sizeof(size_t) + sizeof(T) * vec.size();
+      }
+      size_t ret = sizeof(size_t);
+      for (size_t i = 0; i < vec.size(); ++i) {
+        ret += serialized_size_hint(vec[i]);
+      }
+      return ret;
+    }
+
     /**
      * We re-dispatch vectors because based on the contained type,
      * it is actually possible to serialize them like a POD
@@ -58,10 +85,17 @@ namespace graphlab {
       };
     };
     
-    /// If contained type is not a POD use the standard serializer
+    /**
+     * If contained type is not a POD use the standard serializer.
+     * Nested PODs, e.g. in a vector of vectors, are still written with
+     * one memcpy each, into a buffer sized up front.
+     */
     template <typename OutArcType, typename ValueType>
     struct vector_serialize_impl<OutArcType, ValueType, false > {
-      static void exec(OutArcType& oarc, const std::vector<ValueType>& vec) {
+      template <typename Alloc>
+      static void exec(OutArcType& oarc,
+                       const std::vector<ValueType, Alloc>& vec) {
+        oarc.reserve(sizeof(size_t) + serialized_size_hint(vec));
         oarc << size_t(vec.size());
         serialize_iterator(oarc,vec.begin(), vec.end());
       }
@@ -70,27 +104,37 @@ namespace graphlab {
     /// Fast vector serialization if contained type is a POD
     template <typename OutArcType, typename ValueType>
     struct vector_serialize_impl<OutArcType, ValueType, true > {
-      static void exec(OutArcType& oarc, const std::vector<ValueType>& vec) {
+      template <typename Alloc>
+      static void exec(OutArcType& oarc,
+                       const std::vector<ValueType, Alloc>& vec) {
         oarc << size_t(vec.size());
         serialize(oarc, &(vec[0]),sizeof(ValueType)*vec.size());
       }
     };
 
-    /// If contained type is not a POD use the standard deserializer
+    /**
+     * If contained type is not a POD use the standard deserializer.
+     * The elements are read in place rather than copied in.
+     */
     template <typename InArcType, typename ValueType>
     struct vector_deserialize_impl<InArcType, ValueType, false > {
-      static void exec(InArcType& iarc, std::vector<ValueType>& vec){
+      template <typename Alloc>
+      static void exec(InArcType& iarc, std::vector<ValueType, Alloc>& vec){
         size_t len;
         iarc >> len;
-        vec.clear(); vec.reserve(len);
-        deserialize_iterator<InArcType, ValueType>(iarc, std::inserter(vec, vec.end()));
+        vec.clear(); vec.resize(len);
+        size_t count = 0;
+        iarc >> count;
+        ASSERT_EQ(count, len);
+        for (size_t i = 0; i < len; ++i) iarc >> vec[i];
       }
     };
 
     /// Fast vector deserialization if contained type is a POD
     template <typename InArcType, typename ValueType>
     struct vector_deserialize_impl<InArcType, ValueType, true > {
-      static void exec(InArcType& iarc, std::vector<ValueType>& vec){
+      template <typename Alloc>
+      static void exec(InArcType& iarc, std::vector<ValueType, Alloc>& vec){
         size_t len;
         iarc >> len;
         vec.clear(); vec.resize(len);
@@ -101,19 +145,20 @@ namespace graphlab {
     
     
     /**
-       Serializes a vector */
-    template <typename OutArcType, typename ValueType>
-    struct serialize_impl<OutArcType, std::vector<ValueType>, false > {
-      static void exec(OutArcType& oarc, const std::vector<ValueType>& vec) {
+       Serializes a vector, with any allocator */
+    template <typename OutArcType, typename ValueType, typename Alloc>
+    struct serialize_impl<OutArcType, std::vector<ValueType, Alloc>, false > {
+      static void exec(OutArcType& oarc,
+                       const std::vector<ValueType, Alloc>& vec) {
         vector_serialize_impl<OutArcType, ValueType, 
           gl_is_pod_or_scaler<ValueType>::value >::exec(oarc, vec);
       }
     };
     /**
        deserializes a vector */
-    template <typename InArcType, typename ValueType>
-    struct deserialize_impl<InArcType, std::vector<ValueType>, false > {
-      static void exec(InArcType& iarc, std::vector<ValueType>& vec){
+    template <typename InArcType, typename ValueType, typename Alloc>
+    struct deserialize_impl<InArcType, std::vector<ValueType, Alloc>, false > {
+      static void exec(InArcType& iarc, std::vector<ValueType, Alloc>& vec){
         vector_deserialize_impl<InArcType, ValueType, 
           gl_is_pod_or_scaler<ValueType>::value >::exec(iarc, vec);
       }
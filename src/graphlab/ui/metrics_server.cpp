@@ -34,6 +34,7 @@
 
 #include <graphlab/ui/mongoose/mongoose.h>
 #include <graphlab/ui/metrics_server.hpp>
+#include <graphlab/ui/openmetrics.hpp>
 
 #include <graphlab/macros_def.hpp>
 
@@ -192,6 +193,7 @@ static void fill_builtin_callbacks() {
   callbacks()["echo"] = echo;
   callbacks()[""] = index_page;
   callbacks()["index.html"] = index_page;
+  callbacks()["metrics"] = openmetrics_page;
 }
 
 
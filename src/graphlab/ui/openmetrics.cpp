@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <string>
+#include <sstream>
+#include <map>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/distributed_event_log.hpp>
+#include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/huge_pages.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/ui/openmetrics.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+void openmetrics_writer::family(const std::string& name, const char* type,
+                                const std::string& help) {
+  strm << "# TYPE " << name << " " << type << "\n"
+       << "# HELP " << name << " " << help << "\n";
+}
+
+void openmetrics_writer::sample(const std::string& name, double value,
+                                const std::string& labels) {
+  strm << name;
+  if (!labels.empty()) strm << "{" << labels << "}";
+  strm << " " << value << "\n";
+}
+
+std::string openmetrics_writer::str() const {
+  return strm.str() + "# EOF\n";
+}
+
+std::string openmetrics_writer::sanitize(const std::string& name) {
+  std::string ret(name);
+  for (size_t i = 0; i < ret.length(); ++i) {
+    const char c = ret[i];
+    if (c >= 'A' && c <= 'Z') ret[i] = c - 'A' + 'a';
+    else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))) ret[i] = '_';
+  }
+  return ret;
+}
+
+
+static mutex& sources_lock() {
+  static mutex lock;
+  return lock;
+}
+
+static std::map<std::string, openmetrics_source_type>& sources() {
+  static std::map<std::string, openmetrics_source_type> src;
+  return src;
+}
+
+void add_openmetrics_source(const std::string& name,
+                            openmetrics_source_type source) {
+  sources_lock().lock();
+  sources()[name] = source;
+  sources_lock().unlock();
+}
+
+
+static std::string machine_label(size_t p) {
+  std::stringstream strm;
+  strm << "machine=\"" << p << "\"";
+  return strm.str();
+}
+
+static std::string peer_label(size_t p) {
+  std::stringstream strm;
+  strm << "peer=\"" << p << "\"";
+  return strm.str();
+}
+
+/*
+ * The latest value of every event log on every machine, as collected
+ * by the periodic tick of the event log on machine 0.
+ */
+static void write_event_log(openmetrics_writer& writer) {
+  distributed_event_logger& evlog = get_event_log();
+  log_group** logs = evlog.get_logs_ptr();
+  fixed_dense_bitset<MAX_LOG_SIZE>& has_log_entry = evlog.get_logs_bitset();
+  foreach(size_t log, has_log_entry) {
+    logs[log]->lock.lock();
+    const bool cumulative = logs[log]->logtype == log_type::CUMULATIVE;
+    const std::string name =
+      "graphlab_event_" + openmetrics_writer::sanitize(logs[log]->name);
+    const std::string sample_name = cumulative ? name + "_total" : name;
+    writer.family(name, cumulative ? "counter" : "gauge",
+                  logs[log]->name + " (" + logs[log]->units + ")");
+    for (size_t p = 0; p < logs[log]->machine.size(); ++p) {
+      if (logs[log]->machine[p].empty()) continue;
+      writer.sample(sample_name, logs[log]->machine[p].back().value,
+                    machine_label(p));
+    }
+    logs[log]->lock.unlock();
+  }
+}
+
+static void write_rpc(openmetrics_writer& writer) {
+  distributed_control* dc = distributed_control::get_instance();
+  if (dc == NULL) return;
+  writer.family("graphlab_rpc_calls_sent", "counter",
+                "RPC calls sent to each peer");
+  for (procid_t p = 0; p < dc->numprocs(); ++p) {
+    writer.sample("graphlab_rpc_calls_sent_total", dc->calls_sent_to(p),
+                  peer_label(p));
+  }
+  writer.family("graphlab_rpc_calls_received", "counter",
+                "RPC calls received from each peer");
+  for (procid_t p = 0; p < dc->numprocs(); ++p) {
+    writer.sample("graphlab_rpc_calls_received_total",
+                  dc->calls_received_from(p), peer_label(p));
+  }
+  writer.family("graphlab_rpc_bytes_sent", "counter",
+                "RPC bytes sent to each peer excluding headers");
+  for (procid_t p = 0; p < dc->numprocs(); ++p) {
+    writer.sample("graphlab_rpc_bytes_sent_total", dc->bytes_sent_to(p),
+                  peer_label(p));
+  }
+  writer.family("graphlab_rpc_bytes_received", "counter",
+                "RPC bytes received from each peer excluding headers");
+  for (procid_t p = 0; p < dc->numprocs(); ++p) {
+    writer.sample("graphlab_rpc_bytes_received_total",
+                  dc->bytes_received_from(p), peer_label(p));
+  }
+  writer.family("graphlab_network_bytes_sent", "counter",
+                "Bytes sent including headers and control overhead");
+  writer.sample("graphlab_network_bytes_sent_total", dc->network_bytes_sent());
+}
+
+static void write_memory(openmetrics_writer& writer) {
+  writer.family("graphlab_huge_page_bytes", "gauge",
+                "Bytes on transparent huge pages");
+  writer.sample("graphlab_huge_page_bytes", huge_pages::resident_bytes());
+  if (!memory_info::available()) return;
+  writer.family("graphlab_heap_bytes", "gauge", "Size of the heap");
+  writer.sample("graphlab_heap_bytes", memory_info::heap_bytes());
+  writer.family("graphlab_allocated_bytes", "gauge", "Allocated bytes");
+  writer.sample("graphlab_allocated_bytes", memory_info::allocated_bytes());
+}
+
+static void write_fibers(openmetrics_writer& writer) {
+  // do not create the fiber scheduler just to report on it
+  if (!fiber_control::instance_created) return;
+  fiber_control& fc = fiber_control::get_instance();
+  writer.family("graphlab_fiber_workers", "gauge", "Fiber worker threads");
+  writer.sample("graphlab_fiber_workers", fc.num_workers());
+  writer.family("graphlab_fibers_active", "gauge",
+                "Fibers which have not yet joined");
+  writer.sample("graphlab_fibers_active", fc.num_threads());
+  writer.family("graphlab_fibers_created", "counter", "Fibers ever created");
+  writer.sample("graphlab_fibers_created_total", fc.total_threads_created());
+  writer.family("graphlab_fiber_steals", "counter",
+                "Fibers stolen by idle workers");
+  writer.sample("graphlab_fiber_steals_total", fc.total_steals());
+}
+
+
+std::pair<std::string, std::string>
+openmetrics_page(std::map<std::string, std::string>& varmap) {
+  static mutex snapshot_lock;
+  static std::string snapshot;
+  static double snapshot_time = -1;
+  const std::string content_type =
+    "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+  snapshot_lock.lock();
+  const double now = timer::approx_time_seconds();
+  if (snapshot_time < 0 || now - snapshot_time >= OPENMETRICS_SNAPSHOT_INTERVAL) {
+    openmetrics_writer writer;
+    write_event_log(writer);
+    write_rpc(writer);
+    write_memory(writer);
+    write_fibers(writer);
+    sources_lock().lock();
+    std::map<std::string, openmetrics_source_type>::iterator iter =
+                                                        sources().begin();
+    while (iter != sources().end()) {
+      iter->second(writer);
+      ++iter;
+    }
+    sources_lock().unlock();
+    snapshot = writer.str();
+    snapshot_time = now;
+  }
+  const std::string ret = snapshot;
+  snapshot_lock.unlock();
+  return std::make_pair(content_type, ret);
+}
+
+} // namespace graphlab
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_OPENMETRICS_HPP
+#define GRAPHLAB_OPENMETRICS_HPP
+#include <string>
+#include <sstream>
+#include <utility>
+#include <map>
+#include <boost/function.hpp>
+
+namespace graphlab {
+
+/**
+  \ingroup httpserver
+  \brief Accumulates metric families in the OpenMetrics text format.
+
+  Each family is started with family() and followed by its samples:
+  \code
+  writer.family("graphlab_heap_bytes", "gauge", "Size of the heap");
+  writer.sample("graphlab_heap_bytes", heap);
+  writer.family("graphlab_rpc_calls", "counter", "RPC calls sent");
+  writer.sample("graphlab_rpc_calls_total", calls, "peer=\"1\"");
+  \endcode
+  Counter samples carry the _total suffix, as the format requires.
+ */
+class openmetrics_writer {
+ public:
+  /// Starts a metric family. type is "counter" or "gauge".
+  void family(const std::string& name, const char* type,
+              const std::string& help);
+
+  /// Adds a sample. labels is empty or a list like <code>a="1",b="2"</code>
+  void sample(const std::string& name, double value,
+              const std::string& labels = "");
+
+  /// Returns the text, terminated by the "# EOF" line
+  std::string str() const;
+
+  /**
+   * Turns an arbitrary string into a valid metric name component:
+   * lower case, with every character outside [a-z0-9_] replaced by '_'.
+   */
+  static std::string sanitize(const std::string& name);
+
+ private:
+  std::stringstream strm;
+};
+
+
+/**
+  \ingroup httpserver
+  The callback type used for add_openmetrics_source().
+ */
+typedef boost::function<void(openmetrics_writer&)> openmetrics_source_type;
+
+
+/**
+  \ingroup httpserver
+  \brief Adds a source of metrics to the /metrics page.
+
+  The source is called on every scrape which is not served from the
+  snapshot (see openmetrics_page()) and writes its families into the
+  writer. Sources must only read state which is already available
+  locally: they must not communicate or block. Adding a source with a
+  name already in use replaces it.
+ */
+void add_openmetrics_source(const std::string& name,
+                            openmetrics_source_type source);
+
+
+/**
+  \ingroup httpserver
+  \brief The handler of the /metrics page of the metrics server.
+
+  Exposes in the OpenMetrics text format the counters of the
+  distributed event log of every machine, the RPC calls and bytes
+  exchanged between machine 0 and each peer, the memory usage and the
+  fiber scheduler state of machine 0, followed by the families of all
+  the sources added with add_openmetrics_source().
+
+  Only data which has already been collected is read, without any
+  communication, and the rendered page is reused for scrapes arriving
+  within OPENMETRICS_SNAPSHOT_INTERVAL seconds of each other, so
+  scraping does not perturb a running job.
+ */
+std::pair<std::string, std::string>
+openmetrics_page(std::map<std::string, std::string>& varmap);
+
+/// Scrapes within this many seconds of the last one reuse its result
+const double OPENMETRICS_SNAPSHOT_INTERVAL = 1.0;
+
+} // graphlab
+#endif // GRAPHLAB_OPENMETRICS_HPP
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include <pthread.h>
+#include <graphlab/util/arena.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  arena::arena(size_t block_size) :
+    block_size(block_size), reserved(0), used_before(0), top(0), end(0) { }
+
+  arena::~arena() {
+    for (size_t i = 0; i < blocks.size(); ++i) free(blocks[i].data);
+  }
+
+  void* arena::grow(size_t bytes) {
+    if (!blocks.empty()) {
+      used_before += top - (uintptr_t)blocks.back().data;
+    }
+    // the blocks at least double the reserved memory
+    block b;
+    b.size = std::max(bytes, std::max(block_size, reserved));
+    b.data = (char*)malloc(b.size);
+    ASSERT_TRUE(b.data != NULL);
+    blocks.push_back(b);
+    reserved += b.size;
+    top = (uintptr_t)b.data;
+    end = top + b.size;
+    return b.data;
+  }
+
+  void arena::reset() {
+    if (blocks.size() > 1) {
+      // one block holding everything used in the last round
+      for (size_t i = 0; i < blocks.size(); ++i) free(blocks[i].data);
+      blocks.clear();
+      const size_t size = reserved;
+      reserved = 0;
+      grow(size);
+    }
+    used_before = 0;
+    if (!blocks.empty()) top = (uintptr_t)blocks.back().data;
+  }
+
+  size_t arena::used_bytes() const {
+    if (blocks.empty()) return 0;
+    return used_before + (top - (uintptr_t)blocks.back().data);
+  }
+
+
+  namespace {
+    atomic<size_t> arena_epoch;
+
+    /**
+     * The two arenas of a thread, used in alternate epochs, with the
+     * epoch of their last reset. Memory allocated in an epoch is thus
+     * only reused two epochs later.
+     */
+    struct tls_arena {
+      arena a[2];
+      size_t epoch[2];
+      tls_arena() { epoch[0] = epoch[1] = arena_epoch.value; }
+    };
+
+    void destroy_tls_arena(void* ptr) {
+      delete reinterpret_cast<tls_arena*>(ptr);
+    }
+
+    struct tls_arena_key_creator {
+      pthread_key_t key;
+      tls_arena_key_creator() : key(0) {
+        pthread_key_create(&key, destroy_tls_arena);
+      }
+    };
+
+    pthread_key_t get_arena_key() {
+      static const tls_arena_key_creator creator;
+      return creator.key;
+    }
+    // create the key before main, as for the random sources
+    pthread_key_t __unused_init_arena_key__(get_arena_key());
+  }
+
+
+  arena& thread_arena() {
+    tls_arena* tls = reinterpret_cast<tls_arena*>
+      (pthread_getspecific(get_arena_key()));
+    if (tls == NULL) {
+      tls = new tls_arena();
+      pthread_setspecific(get_arena_key(), tls);
+    }
+    const size_t epoch = arena_epoch.value;
+    const size_t i = epoch & 1;
+    if (tls->epoch[i] != epoch) {
+      tls->a[i].reset();
+      tls->epoch[i] = epoch;
+    }
+    return tls->a[i];
+  }
+
+  void reset_thread_arenas() {
+    arena_epoch.inc();
+  }
+
+} // end of namespace graphlab
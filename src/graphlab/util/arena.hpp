@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_ARENA_HPP
+#define GRAPHLAB_UTIL_ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * \brief A bump allocator which frees all its allocations at once.
+   *
+   * Memory is carved out of large blocks, deallocation does nothing
+   * and reset() makes all the memory available again. When a reset
+   * arena used several blocks, they are replaced by one block of their
+   * total size, so an arena serving the same allocations every round
+   * stops calling malloc after the first round.
+   *
+   * An arena is not thread safe. thread_arena() returns the arena of
+   * the calling thread.
+   */
+  class arena {
+  public:
+    enum { DEFAULT_BLOCK_SIZE = 64 * 1024, DEFAULT_ALIGNMENT = 16 };
+
+    explicit arena(size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    ~arena();
+
+    /// Returns bytes of memory aligned on align, a power of 2
+    inline void* allocate(size_t bytes, size_t align = DEFAULT_ALIGNMENT) {
+      uintptr_t ptr = (top + (align - 1)) & ~uintptr_t(align - 1);
+      if (ptr + bytes > end) ptr = (uintptr_t)grow(bytes + align - 1);
+      ptr = (ptr + (align - 1)) & ~uintptr_t(align - 1);
+      top = ptr + bytes;
+      return (void*)ptr;
+    }
+
+    /// Makes all the memory of the arena available again
+    void reset();
+
+    /// The number of bytes held by the arena
+    size_t reserved_bytes() const { return reserved; }
+
+    /// The number of bytes allocated since the last reset
+    size_t used_bytes() const;
+
+  private:
+    struct block {
+      char* data;
+      size_t size;
+    };
+    std::vector<block> blocks;
+    size_t block_size;
+    size_t reserved;
+    // the bytes used by the blocks before the current one
+    size_t used_before;
+    uintptr_t top, end;
+
+    /// Starts a new block of at least bytes bytes and returns its start
+    void* grow(size_t bytes);
+
+    // not copyable
+    arena(const arena&);
+    arena& operator=(const arena&);
+  }; // end of arena
+
+
+  /**
+   * Returns the arena of the calling thread. Every thread has two
+   * arenas, used in alternate epochs, and the arena of the current
+   * epoch is reset before being returned if it was last used in an
+   * older epoch.
+   */
+  arena& thread_arena();
+
+  /**
+   * Starts a new epoch of the thread arenas, and can be called from any
+   * thread. The objects allocated from the thread arenas remain valid
+   * until the epoch after the next one starts. The synchronous engine
+   * starts an epoch at every super-step when the use_arena engine
+   * option is set.
+   */
+  void reset_thread_arenas();
+
+
+  /**
+   * \ingroup util
+   * \brief An STL allocator drawing from the arena of the calling thread.
+   *
+   * The allocator is stateless and all the instances are equal: a
+   * container may grow on a thread other than the one which created
+   * it. Deallocation does nothing, and the memory is reclaimed two
+   * epochs later (see reset_thread_arenas()). Containers using it must
+   * therefore be destroyed before then, and must not be assigned to
+   * after that, since they may reuse their old capacity.
+   *
+   * With the synchronous engine and the use_arena option, gather types
+   * and messages built from arena containers (see arena_vector) take no
+   * malloc once the arenas are large enough. The engine destroys both
+   * every super-step. Arena containers must not be stored in the vertex
+   * data or in the vertex program, and the gather cache (use_cache)
+   * cannot be used.
+   */
+  template <typename T>
+  class arena_allocator {
+  public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind { typedef arena_allocator<U> other; };
+
+    arena_allocator() { }
+    template <typename U>
+    arena_allocator(const arena_allocator<U>&) { }
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    pointer allocate(size_type n, const void* = 0) {
+      const size_t align = __alignof__(T) > (size_t)arena::DEFAULT_ALIGNMENT ?
+          __alignof__(T) : (size_t)arena::DEFAULT_ALIGNMENT;
+      return (pointer)thread_arena().allocate(n * sizeof(T), align);
+    }
+
+    void deallocate(pointer, size_type) { }
+
+    size_type max_size() const { return size_t(-1) / sizeof(T); }
+
+    void construct(pointer p, const T& val) { new ((void*)p) T(val); }
+    void destroy(pointer p) { p->~T(); }
+
+    bool operator==(const arena_allocator&) const { return true; }
+    bool operator!=(const arena_allocator&) const { return false; }
+  }; // end of arena_allocator
+
+
+  /// The type of a vector allocated from the thread arenas
+  template <typename T>
+  struct arena_vector {
+    typedef std::vector<T, arena_allocator<T> > type;
+  };
+
+  /// A string allocated from the thread arenas
+  typedef std::basic_string<char, std::char_traits<char>,
+                            arena_allocator<char> > arena_string;
+
+} // end of namespace graphlab
+
+#endif
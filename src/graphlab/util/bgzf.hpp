@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_BGZF_HPP
+#define GRAPHLAB_UTIL_BGZF_HPP
+
+#include <istream>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util_internal
+   * Reads the block structure of BGZF files, the blocked gzip files
+   * written by bgzip.
+   *
+   * A BGZF file is a sequence of gzip members of at most 64KB each,
+   * whose headers hold the size of the member in a "BC" extra field.
+   * The members can therefore be located without decompressing the
+   * file, and any of them can be decompressed on its own, so that
+   * ranges of one large file may be loaded in parallel.
+   */
+  namespace bgzf {
+
+    /// The largest size of a block, compressed or not
+    enum { MAX_BLOCK_SIZE = 64 * 1024 };
+
+    /// A block of a BGZF file
+    struct block_info {
+      size_t offset;            ///< position of the block in the file
+      size_t compressed_size;   ///< size of the block in the file
+      size_t uncompressed_size; ///< size of the block once decompressed
+      block_info() : offset(0), compressed_size(0), uncompressed_size(0) { }
+    };
+
+    /// Reads a little endian integer of nbytes bytes
+    inline size_t read_le(const unsigned char* p, size_t nbytes) {
+      size_t ret = 0;
+      for (size_t i = 0; i < nbytes; ++i) ret |= size_t(p[i]) << (8 * i);
+      return ret;
+    }
+
+    /**
+     * Parses the header of the block at offset in the file of size
+     * fsize. Returns false if there is no BGZF block at offset.
+     */
+    inline bool read_block(std::istream& in, size_t offset, size_t fsize,
+                           block_info& block) {
+      // the fixed header, an extra field of at least one subfield, and
+      // the trailer
+      if (offset + 26 > fsize) return false;
+      unsigned char header[12];
+      in.clear();
+      in.seekg(offset);
+      if (!in.read((char*)header, sizeof(header))) return false;
+      // gzip magic, deflate, FEXTRA
+      if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 ||
+          (header[3] & 4) == 0) return false;
+      const size_t xlen = read_le(header + 10, 2);
+      if (xlen < 6 || xlen > MAX_BLOCK_SIZE) return false;
+      std::vector<unsigned char> extra(xlen);
+      if (!in.read((char*)&extra[0], xlen)) return false;
+      size_t bsize = 0;
+      for (size_t i = 0; i + 4 <= xlen; ) {
+        const size_t slen = read_le(&extra[i + 2], 2);
+        if (extra[i] == 'B' && extra[i + 1] == 'C' && slen == 2 &&
+            i + 6 <= xlen) {
+          bsize = read_le(&extra[i + 4], 2) + 1;
+          break;
+        }
+        i += 4 + slen;
+      }
+      if (bsize < 12 + xlen + 8 || offset + bsize > fsize) return false;
+      // the uncompressed size ends the trailer
+      unsigned char isize[4];
+      in.seekg(offset + bsize - 4);
+      if (!in.read((char*)isize, sizeof(isize))) return false;
+      block.offset = offset;
+      block.compressed_size = bsize;
+      block.uncompressed_size = read_le(isize, 4);
+      return block.uncompressed_size <= MAX_BLOCK_SIZE;
+    }
+
+    /// Returns true if the file of size fsize starts with a BGZF block
+    inline bool is_bgzf(std::istream& in, size_t fsize) {
+      block_info block;
+      return read_block(in, 0, fsize, block);
+    }
+
+    /**
+     * Returns the position of the first block at or after begin, or
+     * fsize if there is none. A candidate block counts only if the
+     * next block or the end of the file follows it, so that compressed
+     * data which happens to look like a header is skipped.
+     */
+    inline size_t find_block(std::istream& in, size_t begin, size_t fsize) {
+      std::vector<char> buffer(2 * MAX_BLOCK_SIZE);
+      // a block starts within MAX_BLOCK_SIZE bytes of any position
+      const size_t window_end = std::min(fsize, begin + MAX_BLOCK_SIZE);
+      for (size_t base = begin; base < window_end;
+           base += buffer.size() - 4) {
+        in.clear();
+        in.seekg(base);
+        in.read(&buffer[0], std::min(buffer.size(), fsize - base));
+        const size_t nread = in.gcount();
+        for (size_t i = 0; i + 4 <= nread && base + i < window_end; ++i) {
+          if (buffer[i] != char(0x1f) || buffer[i + 1] != char(0x8b) ||
+              buffer[i + 2] != 8 || (buffer[i + 3] & 4) == 0) continue;
+          block_info block, next;
+          if (!read_block(in, base + i, fsize, block)) continue;
+          const size_t next_offset = block.offset + block.compressed_size;
+          if (next_offset == fsize ||
+              read_block(in, next_offset, fsize, next)) {
+            return block.offset;
+          }
+        }
+        if (nread < 4) break;
+      }
+      return fsize;
+    }
+
+  } // end of namespace bgzf
+
+} // end of namespace graphlab
+
+#endif
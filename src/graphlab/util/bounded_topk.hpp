@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_BOUNDED_TOPK_HPP
+#define GRAPHLAB_BOUNDED_TOPK_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/serialization/vector.hpp>
+
+namespace graphlab {
+
+  /**  \ingroup util
+   * \brief Keeps the k largest of the values inserted, for the order
+   * given by Compare.
+   *
+   * The values are kept in a heap whose root is the smallest of them,
+   * so an insertion which does not make it into the top k is a single
+   * comparison. operator+= merges two of them, which makes it a
+   * reduction type for map_reduce_vertices() and the aggregators: each
+   * thread and each machine only ever holds k values. For instance,
+   * the 10 vertices of largest rank are
+   * \code
+   * typedef graphlab::bounded_topk<std::pair<double, vertex_id_type> > topk_type;
+   * topk_type top(const graph_type::vertex_type& v) {
+   *   return topk_type(10, std::make_pair(v.data().rank, v.id()));
+   * }
+   * ...
+   * std::vector<std::pair<double, vertex_id_type> > best =
+   *     graph.map_reduce_vertices<topk_type>(top).sorted();
+   * \endcode
+   * A default constructed instance keeps nothing and takes the k of the
+   * first one added to it.
+   */
+  template <typename T, typename Compare = std::less<T> >
+  class bounded_topk {
+  public:
+    typedef T value_type;
+
+    explicit bounded_topk(size_t k = 0) : k(k) { }
+
+    /// Keeps the k largest values, starting with value
+    bounded_topk(size_t k, const T& value) : k(k) { insert(value); }
+
+    void insert(const T& value) {
+      if (heap.size() < k) {
+        heap.push_back(value);
+        std::push_heap(heap.begin(), heap.end(), reversed());
+      } else if (k > 0 && Compare()(heap.front(), value)) {
+        std::pop_heap(heap.begin(), heap.end(), reversed());
+        heap.back() = value;
+        std::push_heap(heap.begin(), heap.end(), reversed());
+      }
+    }
+
+    bounded_topk& operator+=(const bounded_topk& other) {
+      if (other.k > k) k = other.k;
+      for (size_t i = 0; i < other.heap.size(); ++i) insert(other.heap[i]);
+      return *this;
+    }
+
+    /// The number of values kept, at most k
+    size_t size() const { return heap.size(); }
+
+    bool empty() const { return heap.empty(); }
+
+    /// The largest number of values kept
+    size_t capacity() const { return k; }
+
+    /// The smallest of the values kept. The top k must not be empty.
+    const T& smallest() const { return heap.front(); }
+
+    /// Returns the values kept, the largest first
+    std::vector<T> sorted() const {
+      std::vector<T> values(heap);
+      std::sort(values.begin(), values.end(), reversed());
+      return values;
+    }
+
+    void clear() { heap.clear(); }
+
+    void save(oarchive& oarc) const { oarc << k << heap; }
+
+    void load(iarchive& iarc) { iarc >> k >> heap; }
+
+  private:
+    /// Makes the heap a min heap
+    struct reversed {
+      bool operator()(const T& a, const T& b) const { return Compare()(b, a); }
+    };
+
+    size_t k;
+    std::vector<T> heap;
+  }; // end of bounded_topk
+
+} // end of namespace graphlab
+
+#endif
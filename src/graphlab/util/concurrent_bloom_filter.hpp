@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_CONCURRENT_BLOOM_FILTER_HPP
+#define GRAPHLAB_CONCURRENT_BLOOM_FILTER_HPP
+
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include <graphlab/util/dense_bitset.hpp>
+
+namespace graphlab {
+
+  /**  \ingroup util
+   * \brief A bloom filter over 64 bit keys which may be filled by many
+   * threads at once.
+   *
+   * The bits are set with the atomic dense_bitset::set_bit(), so
+   * insert() is thread safe and reports whether the key may have been
+   * inserted before: it returns false only if one of the probed bits
+   * was clear, in which case the key was certainly new. The probes are
+   * derived by double hashing from one 64 bit mix of the key. Two
+   * threads inserting the same key at the same time may both be told
+   * that it is new.
+   */
+  class concurrent_bloom_filter {
+  public:
+    /// Constructs an empty filter which must be resized before use
+    concurrent_bloom_filter() : nprobes(1) { }
+
+    /**
+     * Constructs a filter sized for nkeys keys with bits_per_key bits
+     * per key, using the number of probes which minimizes the false
+     * positive rate (about 1% for 10 bits per key).
+     */
+    concurrent_bloom_filter(size_t nkeys, size_t bits_per_key = 10) {
+      resize(nkeys, bits_per_key);
+    }
+
+    /// Resizes and clears the filter. See the constructor.
+    void resize(size_t nkeys, size_t bits_per_key = 10) {
+      bits.resize(std::max<size_t>(64, nkeys * bits_per_key));
+      bits.clear();
+      nprobes = std::max<size_t>(1, size_t(bits_per_key * std::log(2.0) + 0.5));
+    }
+
+    /// Clears all the keys
+    void clear() { bits.clear(); }
+
+    /**
+     * Inserts key. Returns true if the key may already have been in the
+     * filter, false if it certainly was not. Thread safe.
+     */
+    inline bool insert(uint64_t key) {
+      const uint64_t h = mix(key);
+      uint64_t probe = h;
+      const uint64_t step = (h >> 32) | 1;
+      bool present = true;
+      for (size_t i = 0; i < nprobes; ++i) {
+        present &= bits.set_bit(probe % bits.size());
+        probe += step;
+      }
+      return present;
+    }
+
+    /// Returns true if key may be in the filter, false if it is not
+    inline bool may_contain(uint64_t key) const {
+      const uint64_t h = mix(key);
+      uint64_t probe = h;
+      const uint64_t step = (h >> 32) | 1;
+      for (size_t i = 0; i < nprobes; ++i) {
+        if (!bits.get(probe % bits.size())) return false;
+        probe += step;
+      }
+      return true;
+    }
+
+    /// The number of probes per key
+    size_t num_probes() const { return nprobes; }
+
+    /// The number of bits of the filter
+    size_t size() const { return bits.size(); }
+
+    /**
+     * Adds the keys of the filter other, which must have the same size
+     * and number of probes
+     */
+    concurrent_bloom_filter& operator|=(const concurrent_bloom_filter& other) {
+      ASSERT_EQ(nprobes, other.nprobes);
+      bits |= other.bits;
+      return *this;
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << nprobes << bits;
+    }
+
+    void load(iarchive& iarc) {
+      iarc >> nprobes >> bits;
+    }
+
+    /// Combines two 64 bit values into a key, e.g. the ends of an edge
+    static inline uint64_t pair_key(uint64_t a, uint64_t b) {
+      return mix(a) ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+    }
+
+  private:
+    dense_bitset bits;
+    size_t nprobes;
+
+    /// The finalizer of MurmurHash3
+    static inline uint64_t mix(uint64_t h) {
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+  };
+
+} // end of namespace graphlab
+
+#endif
@@ -27,10 +27,15 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cstddef>
 #include <stdint.h>
+#include <algorithm>
 #include <graphlab/logger/logger.hpp>
 #include <graphlab/parallel/atomic_ops.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace graphlab {
   
@@ -97,6 +102,13 @@ namespace graphlab {
     inline void clear() {
       for (size_t i = 0; i < arrlen; ++i) array[i] = 0;
     }
+
+    /// Exchanges the contents of this bitset with the bitset db
+    inline void swap(dense_bitset& db) {
+      std::swap(array, db.array);
+      std::swap(len, db.len);
+      std::swap(arrlen, db.arrlen);
+    }
     
     inline bool empty() const {
       for (size_t i = 0; i < arrlen; ++i) if (array[i]) return false;
@@ -109,6 +121,33 @@ namespace graphlab {
       fix_trailing_bits();
     }
 
+    /// Sets the bits in [begin, end) to 0. Not thread safe.
+    void clear(size_t begin, size_t end) {
+      apply_range(begin, end, false);
+    }
+
+    /// Sets the bits in [begin, end) to 1. Not thread safe.
+    void fill(size_t begin, size_t end) {
+      apply_range(begin, end, true);
+    }
+
+    /// Sets all bits to 0 using all the openmp threads
+    void parallel_clear() {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ptrdiff_t i = 0; i < ptrdiff_t(arrlen); ++i) array[i] = 0;
+    }
+
+    /// Sets all bits to 1 using all the openmp threads
+    void parallel_fill() {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ptrdiff_t i = 0; i < ptrdiff_t(arrlen); ++i) array[i] = (size_t) - 1;
+      fix_trailing_bits();
+    }
+
     /// Prefetches the word containing the bit b
     inline void prefetch(size_t b) const{
       __builtin_prefetch(&(array[b / (8 * sizeof(size_t))]));
@@ -392,12 +431,85 @@ namespace graphlab {
       return ret;
     }
 
+    /// Returns the number of set bits in [begin, end)
+    size_t popcount(size_t begin, size_t end) const {
+      end = std::min(end, len);
+      if (begin >= end) return 0;
+      size_t first_word, first_bit, last_word, last_bit;
+      bit_to_pos(begin, first_word, first_bit);
+      bit_to_pos(end - 1, last_word, last_bit);
+      size_t ret = 0;
+      for (size_t i = first_word; i <= last_word; ++i) {
+        ret += __builtin_popcountl(array[i] &
+                                   range_mask(i, first_word, first_bit,
+                                              last_word, last_bit));
+      }
+      return ret;
+    }
+
+    /// Returns the number of set bits using all the openmp threads
+    size_t parallel_popcount() const {
+      size_t ret = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:ret)
+#endif
+      for (ptrdiff_t i = 0; i < ptrdiff_t(arrlen); ++i) {
+        ret += __builtin_popcountl(array[i]);
+      }
+      return ret;
+    }
+
+    /**
+     * Calls fn(b) for every set bit b in increasing order, and returns
+     * fn. Each word is read once and its bits are extracted with ctz,
+     * so this is cheaper than the iterators. fn may clear or set bits of
+     * the word being visited without affecting the traversal of that
+     * word.
+     */
+    template <typename Fn>
+    Fn for_each_set_bit(Fn fn) const {
+      return for_each_set_bit(0, len, fn);
+    }
+
+    /// Calls fn(b) for every set bit b in [begin, end) in increasing order
+    template <typename Fn>
+    Fn for_each_set_bit(size_t begin, size_t end, Fn fn) const {
+      end = std::min(end, len);
+      if (begin >= end) return fn;
+      size_t first_word, first_bit, last_word, last_bit;
+      bit_to_pos(begin, first_word, first_bit);
+      bit_to_pos(end - 1, last_word, last_bit);
+      for (size_t i = first_word; i <= last_word; ++i) {
+        size_t word = array[i] & range_mask(i, first_word, first_bit,
+                                            last_word, last_bit);
+        const size_t base = i * (8 * sizeof(size_t));
+        while (word) fn(base + pop_first_bit(word));
+      }
+      return fn;
+    }
+
+    /**
+     * Clears the lowest set bit of the nonzero word and returns its
+     * position. Used to walk the bits of a word returned by
+     * containing_word():
+     * \code
+     *   size_t word = bits.containing_word(b);
+     *   while (word) {
+     *     size_t offset = dense_bitset::pop_first_bit(word);
+     *     ...
+     *   }
+     * \endcode
+     */
+    static inline size_t pop_first_bit(size_t& word) {
+      const size_t b = (size_t)__builtin_ctzl(word);
+      word &= word - 1;
+      return b;
+    }
+
     dense_bitset operator&(const dense_bitset& other) const {
       ASSERT_EQ(size(), other.size());
       dense_bitset ret(size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        ret.array[i] = array[i] & other.array[i];
-      }
+      and_words(ret.array, array, other.array, arrlen);
       return ret;
     }
 
@@ -405,44 +517,34 @@ namespace graphlab {
     dense_bitset operator|(const dense_bitset& other) const {
       ASSERT_EQ(size(), other.size());
       dense_bitset ret(size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        ret.array[i] = array[i] | other.array[i];
-      }
+      or_words(ret.array, array, other.array, arrlen);
       return ret;
     }
 
     dense_bitset operator-(const dense_bitset& other) const {
       ASSERT_EQ(size(), other.size());
       dense_bitset ret(size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        ret.array[i] = array[i] - (array[i] & other.array[i]);
-      }
+      andnot_words(ret.array, array, other.array, arrlen);
       return ret;
     }
 
 
     dense_bitset& operator&=(const dense_bitset& other) {
       ASSERT_EQ(size(), other.size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        array[i] &= other.array[i];
-      }
+      and_words(array, array, other.array, arrlen);
       return *this;
     }
 
 
     dense_bitset& operator|=(const dense_bitset& other) {
       ASSERT_EQ(size(), other.size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        array[i] |= other.array[i];
-      }
+      or_words(array, array, other.array, arrlen);
       return *this;
     }
 
     dense_bitset& operator-=(const dense_bitset& other) {
       ASSERT_EQ(size(), other.size());
-      for (size_t i = 0; i < arrlen; ++i) {
-        array[i] = array[i] - (array[i] & other.array[i]);
-      }
+      andnot_words(array, array, other.array, arrlen);
       return *this;
     }
 
@@ -483,6 +585,77 @@ namespace graphlab {
       array[arrlen - 1] &= ((size_t(1) << lastbits) - 1);
     }
 
+    /**
+     * The mask of the bits of word i which lie between the bit
+     * first_bit of first_word and the bit last_bit of last_word
+     */
+    static inline size_t range_mask(size_t i,
+                                    size_t first_word, size_t first_bit,
+                                    size_t last_word, size_t last_bit) {
+      size_t mask = size_t(-1);
+      if (i == first_word) mask &= size_t(-1) << first_bit;
+      if (i == last_word) mask &= size_t(-1) >> (8 * sizeof(size_t) - 1 - last_bit);
+      return mask;
+    }
+
+    void apply_range(size_t begin, size_t end, bool value) {
+      end = std::min(end, len);
+      if (begin >= end) return;
+      size_t first_word, first_bit, last_word, last_bit;
+      bit_to_pos(begin, first_word, first_bit);
+      bit_to_pos(end - 1, last_word, last_bit);
+      for (size_t i = first_word; i <= last_word; ++i) {
+        const size_t mask = range_mask(i, first_word, first_bit,
+                                       last_word, last_bit);
+        if (value) array[i] |= mask;
+        else array[i] &= ~mask;
+      }
+    }
+
+    /*
+     * dst[i] = a[i] op b[i] for i in [0, n). dst may be a. Two words at
+     * a time with SSE2 when available.
+     */
+    static void and_words(size_t* dst, const size_t* a, const size_t* b,
+                          size_t n) {
+      size_t i = 0;
+#ifdef __SSE2__
+      for (; i + 2 <= n; i += 2) {
+        _mm_storeu_si128((__m128i*)(dst + i),
+                         _mm_and_si128(_mm_loadu_si128((const __m128i*)(a + i)),
+                                       _mm_loadu_si128((const __m128i*)(b + i))));
+      }
+#endif
+      for (; i < n; ++i) dst[i] = a[i] & b[i];
+    }
+
+    static void or_words(size_t* dst, const size_t* a, const size_t* b,
+                         size_t n) {
+      size_t i = 0;
+#ifdef __SSE2__
+      for (; i + 2 <= n; i += 2) {
+        _mm_storeu_si128((__m128i*)(dst + i),
+                         _mm_or_si128(_mm_loadu_si128((const __m128i*)(a + i)),
+                                      _mm_loadu_si128((const __m128i*)(b + i))));
+      }
+#endif
+      for (; i < n; ++i) dst[i] = a[i] | b[i];
+    }
+
+    static void andnot_words(size_t* dst, const size_t* a, const size_t* b,
+                             size_t n) {
+      size_t i = 0;
+#ifdef __SSE2__
+      for (; i + 2 <= n; i += 2) {
+        // _mm_andnot_si128(x, y) computes ~x & y
+        _mm_storeu_si128((__m128i*)(dst + i),
+                         _mm_andnot_si128(_mm_loadu_si128((const __m128i*)(b + i)),
+                                          _mm_loadu_si128((const __m128i*)(a + i))));
+      }
+#endif
+      for (; i < n; ++i) dst[i] = a[i] & ~b[i];
+    }
+
     size_t* array;
     size_t len;
     size_t arrlen;
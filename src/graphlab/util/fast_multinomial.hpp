@@ -37,6 +37,7 @@
 #include <graphlab/parallel/atomic.hpp>
 
 #include <graphlab/util/generics/float_selector.hpp>
+#include <graphlab/util/random.hpp>
 
 
 #include <graphlab/macros_def.hpp>
@@ -422,6 +423,184 @@ namespace graphlab {
       num_support.value = 0;
     }
   }; // end of fast_multinomial
+
+
+  /**
+   * \ingroup util_internal
+   * \brief A fixed multinomial which is sampled in O(1) time with
+   * Walker's alias method.
+   *
+   * build() fills in O(K) time, with Vose's construction, a table of K
+   * slots. Slot i keeps i with probability prob[i] and returns alias[i]
+   * otherwise, so a sample picks a slot uniformly and flips one biased
+   * coin. The sum and the scaling of the weights run in parallel.
+   *
+   * The table is read only once built, so that any number of threads can
+   * sample from it, each with its own generator.
+   */
+  class alias_multinomial {
+  public:
+    alias_multinomial() : total(0) { }
+
+    template<typename Double>
+    explicit alias_multinomial(const std::vector<Double>& weights) : total(0) {
+      build(weights);
+    }
+
+    /** Rebuilds the table from non negative weights with a positive sum */
+    template<typename Double>
+    void build(const std::vector<Double>& weights) {
+      const size_t num_asg = weights.size();
+      ASSERT_GT(num_asg, 0);
+      double sum = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:sum)
+#endif
+      for (ssize_t i = 0; i < ssize_t(num_asg); ++i) {
+        ASSERT_GE(weights[i], 0);
+        sum += weights[i];
+      }
+      ASSERT_GT(sum, 0);
+      total = sum;
+      prob.resize(num_asg);
+      alias.resize(num_asg);
+      const double scale = double(num_asg) / sum;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(num_asg); ++i) {
+        prob[i] = weights[i] * scale;
+      }
+      pair_slots(&prob[0], &alias[0], num_asg);
+    }
+
+    /**
+     * Fills prob[0 .. n) and alias[0 .. n) with the table of weights[0 ..
+     * n), which must have a positive sum. This is for storing many small
+     * tables, e.g. one per vertex, in flat arrays.
+     */
+    template<typename Double>
+    static void build_table(const Double* weights, size_t n,
+                            double* prob, uint32_t* alias) {
+      double sum = 0;
+      for (size_t i = 0; i < n; ++i) sum += weights[i];
+      ASSERT_GT(sum, 0);
+      const double scale = double(n) / sum;
+      for (size_t i = 0; i < n; ++i) prob[i] = weights[i] * scale;
+      pair_slots(prob, alias, n);
+    }
+
+    /** Draws from a table filled by build_table() */
+    template<typename RNG>
+    static inline size_t sample_table(const double* prob, const uint32_t* alias,
+                                      size_t n, RNG& rng) {
+      const size_t slot = rng.bounded(n);
+      return rng.uniform01() < prob[slot] ? slot : alias[slot];
+    }
+
+    /** Draws an assignment using the given random::fast_generator */
+    template<typename RNG>
+    inline size_t sample(RNG& rng) const {
+      return sample_table(&prob[0], &alias[0], prob.size(), rng);
+    }
+
+    /** Draws an assignment using the generator of this thread */
+    inline size_t sample() const {
+      return sample(random::get_fast_source());
+    }
+
+    /** The number of assignments */
+    size_t size() const { return prob.size(); }
+
+    bool empty() const { return prob.empty(); }
+
+    /** The sum of the weights the table was built from */
+    double total_weight() const { return total; }
+
+  private:
+    std::vector<double> prob;
+    std::vector<uint32_t> alias;
+    double total;
+
+    /** Pairs every slot below the mean with one above it */
+    static void pair_slots(double* prob, uint32_t* alias, size_t n) {
+      std::vector<uint32_t> small, large;
+      for (size_t i = 0; i < n; ++i) {
+        alias[i] = uint32_t(i);
+        if (prob[i] < 1) small.push_back(uint32_t(i));
+        else large.push_back(uint32_t(i));
+      }
+      while (!small.empty() && !large.empty()) {
+        const uint32_t s = small.back(); small.pop_back();
+        const uint32_t l = large.back();
+        alias[s] = l;
+        prob[l] = (prob[l] + prob[s]) - 1;
+        if (prob[l] < 1) {
+          large.pop_back();
+          small.push_back(l);
+        }
+      }
+      // whatever is left is 1 up to the rounding errors
+      foreach(uint32_t l, large) prob[l] = 1;
+      foreach(uint32_t s, small) prob[s] = 1;
+    }
+  }; // end of alias_multinomial
+
+
+  /**
+   * \ingroup util_internal
+   * \brief Samples from the sum of a fixed dense distribution and a
+   * small sparse set of weights which changes between samples.
+   *
+   * This is the form of many samplers, e.g. the word-topic term of
+   * collapsed LDA plus the few topics of a document. The dense part is
+   * an alias_multinomial shared by all the samplers. A sample costs O(1)
+   * when it falls in the dense part, and is linear in the number of
+   * sparse entries otherwise.
+   */
+  class sparse_dense_multinomial {
+  public:
+    explicit sparse_dense_multinomial(const alias_multinomial& dense) :
+      dense(&dense), sparse_total(0) { }
+
+    /** Removes all the sparse weights */
+    void clear_sparse() {
+      sparse.clear();
+      sparse_total = 0;
+    }
+
+    /** Adds weight to assignment asg on top of the dense distribution */
+    void add_sparse(size_t asg, double weight) {
+      ASSERT_LT(asg, dense->size());
+      ASSERT_GE(weight, 0);
+      sparse.push_back(std::make_pair(asg, weight));
+      sparse_total += weight;
+    }
+
+    /** Draws an assignment using the given random::fast_generator */
+    template<typename RNG>
+    size_t sample(RNG& rng) const {
+      double rnd = rng.uniform01() * (sparse_total + dense->total_weight());
+      if (rnd < sparse_total) {
+        for (size_t i = 0; i + 1 < sparse.size(); ++i) {
+          if (rnd < sparse[i].second) return sparse[i].first;
+          rnd -= sparse[i].second;
+        }
+        return sparse.back().first;
+      }
+      return dense->sample(rng);
+    }
+
+    /** Draws an assignment using the generator of this thread */
+    size_t sample() const {
+      return sample(random::get_fast_source());
+    }
+
+  private:
+    const alias_multinomial* dense;
+    std::vector<std::pair<size_t, double> > sparse;
+    double sparse_total;
+  }; // end of sparse_dense_multinomial
   
 } // end of namespace
 
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_FIBER_RING_QUEUE_HPP
+#define GRAPHLAB_FIBER_RING_QUEUE_HPP
+
+#include <deque>
+#include <queue>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/util/mpmc_ring.hpp>
+
+namespace graphlab {
+
+   /**
+    * \ingroup util
+    * \brief A queue with the blocking interface of the
+    * \ref fiber_blocking_queue used by batch consumers, in which the
+    * producers do not lock.
+    *
+    * Values are pushed into an mpmc_ring. When the ring is full, they
+    * go to a locked overflow queue until a consumer empties it, which
+    * keeps the values of each producer in order. Producers only take the
+    * lock to wake a sleeping consumer or when the ring overflows.
+    *
+    * Consumers take all the values at once with dequeue_all(), and may
+    * wait for data with wait_for_data(), which must be called from a
+    * fiber.
+    */
+  template<typename T>
+  class fiber_ring_queue {
+  public:
+    typedef std::deque<T> queue_type;
+
+    enum { DEFAULT_CAPACITY = 4096 };
+
+    explicit fiber_ring_queue(size_t capacity = DEFAULT_CAPACITY) :
+      ring(new mpmc_ring<T>(capacity)), has_overflow(false),
+      m_alive(true), sleeping(0) { }
+
+    /// Copies are empty queues of the same capacity
+    fiber_ring_queue(const fiber_ring_queue& other) :
+      ring(new mpmc_ring<T>(other.ring->capacity())), has_overflow(false),
+      m_alive(true), sleeping(0) { }
+
+    ~fiber_ring_queue() {
+      m_alive = false;
+      broadcast();
+      delete ring;
+    }
+
+    //! Add an element to the queue
+    inline void enqueue(const T& elem, bool wake_consumer = true) {
+      if (has_overflow || !ring->try_push(elem)) {
+        m_mutex.lock();
+        overflow.push_back(elem);
+        has_overflow = true;
+        if (wake_consumer && sleeping) wake_a_fiber();
+        m_mutex.unlock();
+        return;
+      }
+      // the push must be visible before sleeping is read. See
+      // wait_for_data()
+      __sync_synchronize();
+      if (wake_consumer && sleeping) {
+        m_mutex.lock();
+        wake_a_fiber();
+        m_mutex.unlock();
+      }
+    }
+
+    /**
+     * Appends all the values of the queue to q. The values pushed by a
+     * producer are appended in order.
+     */
+    void dequeue_all(queue_type& q) {
+      T elem;
+      while (ring->try_pop(elem)) q.push_back(elem);
+      if (has_overflow) {
+        m_mutex.lock();
+        // the values pushed into the ring before the overflow
+        while (ring->try_pop(elem)) q.push_back(elem);
+        q.insert(q.end(), overflow.begin(), overflow.end());
+        overflow.clear();
+        has_overflow = false;
+        m_mutex.unlock();
+      }
+    }
+
+    bool empty_unsafe() const {
+      return ring->empty() && !has_overflow;
+    }
+
+    bool is_alive() const {
+      return m_alive;
+    }
+
+    /**
+     * Blocks until the queue has data or stop_blocking() is called.
+     * Returns true if the queue has data.
+     */
+    inline bool wait_for_data() {
+      m_mutex.lock();
+      while(empty_unsafe() && m_alive) {
+        sleeping++;
+        // producers pushing from now on see sleeping, and those which
+        // pushed before are seen here
+        __sync_synchronize();
+        if (!empty_unsafe()) {
+          sleeping--;
+          break;
+        }
+        fiber_sleep();
+        sleeping--;
+      }
+      const bool success = !empty_unsafe();
+      m_mutex.unlock();
+      return success;
+    }
+
+    //! get the approximate number of values in the queue
+    inline size_t size() const {
+      return ring->approx_size() + overflow.size();
+    }
+
+    /** Wakes up all the waiting fibers. Once this function is called,
+        wait_for_data() returns immediately. */
+    inline void stop_blocking() {
+      m_mutex.lock();
+      m_alive = false;
+      wake_all_fibers();
+      m_mutex.unlock();
+    }
+
+    /// Resumes the blocking of wait_for_data()
+    inline void start_blocking() {
+      m_mutex.lock();
+      m_alive = true;
+      m_mutex.unlock();
+    }
+
+    /// Wakes up all the waiting fibers, which go back to sleep if the
+    /// queue is still empty
+    void broadcast() {
+      m_mutex.lock();
+      wake_all_fibers();
+      m_mutex.unlock();
+    }
+
+  private:
+    mpmc_ring<T>* ring;
+    queue_type overflow;
+    volatile bool has_overflow;
+    volatile bool m_alive;
+    mutex m_mutex;
+    std::queue<size_t> fiber_queue;
+    volatile uint16_t sleeping;
+
+    void wake_a_fiber() {
+      if (!fiber_queue.empty()) {
+        size_t fiber_id = fiber_queue.front();
+        fiber_queue.pop();
+        fiber_control::schedule_tid(fiber_id);
+      }
+    }
+
+    void wake_all_fibers() {
+      while(!fiber_queue.empty()) {
+        size_t fiber_id = fiber_queue.front();
+        fiber_queue.pop();
+        fiber_control::schedule_tid(fiber_id);
+      }
+    }
+
+    void fiber_sleep() {
+      fiber_queue.push(fiber_control::get_tid());
+      fiber_control::deschedule_self(&m_mutex.m_mut);
+      m_mutex.lock();
+    }
+
+    fiber_ring_queue& operator=(const fiber_ring_queue&);
+  }; // end of fiber_ring_queue class
+
+} // end of namespace graphlab
+
+#endif
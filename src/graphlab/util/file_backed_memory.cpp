@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <graphlab/util/file_backed_memory.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+
+  size_t file_backed_memory::
+  move_to_file(const std::string& fname,
+               const std::vector<std::pair<char*, size_t> >& ranges) {
+    const size_t page = getpagesize();
+    const int fd = ::open(fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+      logstream(LOG_ERROR) << "Cannot create " << fname << ": "
+                           << strerror(errno) << std::endl;
+      return 0;
+    }
+    // write the whole pages of every range at page aligned offsets
+    std::vector<std::pair<char*, size_t> > pages;
+    std::vector<off_t> offsets;
+    off_t offset = 0;
+    bool success = true;
+    for (size_t i = 0; i < ranges.size() && success; ++i) {
+      const size_t begin = ((size_t)ranges[i].first + page - 1) / page * page;
+      const size_t end = ((size_t)ranges[i].first + ranges[i].second) /
+          page * page;
+      if (end <= begin) continue;
+      for (size_t written = 0; written < end - begin; ) {
+        const ssize_t n = pwrite(fd, (char*)begin + written,
+                                 end - begin - written, offset + written);
+        if (n <= 0) { success = false; break; }
+        written += n;
+      }
+      pages.push_back(std::make_pair((char*)begin, end - begin));
+      offsets.push_back(offset);
+      offset += end - begin;
+    }
+    success = success && fdatasync(fd) == 0;
+    size_t moved = 0;
+    for (size_t i = 0; i < pages.size() && success; ++i) {
+      void* ptr = mmap(pages[i].first, pages[i].second,
+                       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                       fd, offsets[i]);
+      if (ptr == MAP_FAILED) { success = false; break; }
+      mapped.push_back(pages[i]);
+      moved += pages[i].second;
+    }
+    if (!success) {
+      logstream(LOG_ERROR) << "Cannot move " << offset << " bytes to "
+                           << fname << ": " << strerror(errno) << std::endl;
+    }
+    // the clean pages are on disk, so release them now rather than
+    // under memory pressure
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    unlink(fname.c_str());
+    ::close(fd);
+    return moved;
+  } // end of move_to_file
+
+
+  void file_backed_memory::move_to_memory(bool keep_contents) {
+    const size_t CHUNK = 64 * 1024 * 1024;
+    std::vector<char> buffer;
+    for (size_t i = 0; i < mapped.size(); ++i) {
+      for (size_t begin = 0; begin < mapped[i].second; begin += CHUNK) {
+        char* ptr = mapped[i].first + begin;
+        const size_t len = std::min(CHUNK, mapped[i].second - begin);
+        if (keep_contents) buffer.assign(ptr, ptr + len);
+        void* res = mmap(ptr, len, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        if (res == MAP_FAILED) {
+          logstream(LOG_FATAL) << "Cannot move file backed memory back to "
+                               << "RAM: " << strerror(errno) << std::endl;
+        }
+        if (keep_contents) memcpy(ptr, &buffer[0], len);
+      }
+    }
+    mapped.clear();
+  } // end of move_to_memory
+
+
+  size_t file_backed_memory::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < mapped.size(); ++i) total += mapped[i].second;
+    return total;
+  } // end of size
+
+} // end of namespace graphlab
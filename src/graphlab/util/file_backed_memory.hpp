@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_FILE_BACKED_MEMORY_HPP
+#define GRAPHLAB_UTIL_FILE_BACKED_MEMORY_HPP
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * \brief Moves large arrays which are already allocated out of RAM
+   * and into a file, e.g. on an SSD.
+   *
+   * The whole pages of each array are written to the file, which is
+   * then mapped over them in place, so the arrays keep their addresses
+   * and their contents. The kernel pages them back in as they are read
+   * (with readahead for sequential scans) and writes them out under
+   * memory pressure. The file is deleted as soon as it is mapped, so
+   * its space is reclaimed when the process exits.
+   *
+   * The arrays must stay allocated until move_to_memory() is called:
+   * an owner which frees or reallocates them must move them back
+   * first. The destructor does so without keeping the contents.
+   */
+  class file_backed_memory {
+   public:
+    file_backed_memory() { }
+
+    ~file_backed_memory() { move_to_memory(false); }
+
+    /**
+     * Moves the page aligned part of every (first byte, length in
+     * bytes) range to the file fname. Returns the number of bytes
+     * moved, which is 0 if the file could not be written.
+     */
+    size_t move_to_file(const std::string& fname,
+                        const std::vector<std::pair<char*, size_t> >& ranges);
+
+    /**
+     * Backs the moved pages with RAM again. The contents are copied
+     * back if keep_contents is set and are otherwise zeroed.
+     */
+    void move_to_memory(bool keep_contents);
+
+    /// The number of bytes currently backed by the file
+    size_t size() const;
+
+   private:
+    /// the mapped (first page, length) ranges
+    std::vector<std::pair<char*, size_t> > mapped;
+
+    file_backed_memory(const file_backed_memory&);
+    file_backed_memory& operator=(const file_backed_memory&);
+  }; // end of file_backed_memory
+
+} // end of namespace graphlab
+
+#endif
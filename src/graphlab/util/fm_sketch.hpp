@@ -0,0 +1,111 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_FM_SKETCH_HPP
+#define GRAPHLAB_FM_SKETCH_HPP
+
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include <graphlab/serialization/is_pod.hpp>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace graphlab {
+
+  /**  \ingroup util
+   * \brief A Flajolet-Martin sketch of NumMasks bitmasks, each packed
+   * in one 64 bit word.
+   *
+   * Each element sets in every mask the bit of position r with
+   * probability 2^-(r+1), and the number of distinct elements is
+   * estimated from the mean position of the lowest bit not set. The
+   * union of two sets is the bitwise OR of their sketches, so
+   * neighborhood functions (and the diameter and closeness estimates
+   * built on them) are computed by ORing the sketches of neighbors.
+   *
+   * The sketch is a POD: it is copied and serialized as one block.
+   */
+  template <size_t NumMasks>
+  class fm_sketch : public IS_POD_TYPE {
+  public:
+    enum { NUM_MASKS = NumMasks };
+
+    /// The correction factor of the Flajolet-Martin estimate
+    static double phi() { return 0.77351; }
+
+    fm_sketch() { clear(); }
+
+    void clear() { std::fill(masks, masks + NumMasks, uint64_t(0)); }
+
+    /// Sets bit (at most 63) of mask
+    void set(size_t mask, size_t bit) {
+      masks[mask] |= uint64_t(1) << std::min<size_t>(bit, 63);
+    }
+
+    /// The raw bits of mask
+    uint64_t mask(size_t mask) const { return masks[mask]; }
+
+    /// The position of the lowest bit not set in mask
+    size_t lowest_zero(size_t mask) const {
+      const uint64_t inv = ~masks[mask];
+      return inv == 0 ? 64 : __builtin_ctzll(inv);
+    }
+
+    /// The estimated number of distinct elements
+    double estimate() const {
+      double sum = 0;
+      for (size_t i = 0; i < NumMasks; ++i) sum += lowest_zero(i);
+      return std::pow(2.0, sum / NumMasks) / phi();
+    }
+
+    /// Merges the other sketch into this one (set union)
+    fm_sketch& operator|=(const fm_sketch& other) {
+      size_t i = 0;
+#ifdef __SSE2__
+      for (; i + 2 <= NumMasks; i += 2) {
+        __m128i* dst = (__m128i*)(masks + i);
+        const __m128i src = _mm_loadu_si128((const __m128i*)(other.masks + i));
+        _mm_storeu_si128(dst, _mm_or_si128(_mm_loadu_si128(dst), src));
+      }
+#endif
+      for (; i < NumMasks; ++i) masks[i] |= other.masks[i];
+      return *this;
+    }
+
+    bool operator==(const fm_sketch& other) const {
+      return std::equal(masks, masks + NumMasks, other.masks);
+    }
+
+    bool operator!=(const fm_sketch& other) const {
+      return !(*this == other);
+    }
+
+  private:
+    uint64_t masks[NumMasks];
+  }; // end of fm_sketch
+
+} // namespace graphlab
+
+#endif
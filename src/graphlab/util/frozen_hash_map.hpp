@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_FROZEN_HASH_MAP_HPP
+#define GRAPHLAB_UTIL_FROZEN_HASH_MAP_HPP
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * \brief A read only hash map from integer keys, built once from a
+   * sequence of pairs and optimized for lookups.
+   *
+   * The slots are split in groups of GROUP_SIZE. Every slot has a one
+   * byte tag holding 7 bits of the hash of its key, or EMPTY_TAG. A
+   * lookup compares the tags of a whole group at once (with SSE2 when
+   * available) and only reads the keys whose tag matches. Keys which do
+   * not fit in their home group go to the next groups. Since nothing is
+   * ever erased, a group with an empty slot ends the search.
+   *
+   * find_many() looks up an array of keys, prefetching the groups of
+   * the keys PREFETCH_DISTANCE positions ahead, so that the cache misses
+   * of consecutive lookups overlap.
+   */
+  template <typename Key, typename Value>
+  class frozen_hash_map {
+  public:
+    typedef std::pair<Key, Value> value_type;
+    enum { GROUP_SIZE = 16, PREFETCH_DISTANCE = 8, EMPTY_TAG = 0x80 };
+
+    frozen_hash_map() : group_mask(0), nelements(0) { }
+
+    /**
+     * Replaces the contents with the pairs in [begin, end), which must
+     * have distinct keys.
+     */
+    template <typename Iterator>
+    void build(Iterator begin, Iterator end, size_t n) {
+      // at most 7/8 of the slots are used
+      size_t ngroups = 1;
+      while (ngroups * GROUP_SIZE * 7 < n * 8) ngroups *= 2;
+      group_mask = ngroups - 1;
+      tags.assign(ngroups * GROUP_SIZE, (unsigned char)EMPTY_TAG);
+      slots.resize(ngroups * GROUP_SIZE);
+      nelements = 0;
+      for (; begin != end; ++begin) {
+        const uint64_t h = hash(begin->first);
+        size_t group = home_group(h);
+        while (true) {
+          unsigned char* gtags = &tags[group * GROUP_SIZE];
+          unsigned char* free_tag =
+              (unsigned char*)std::memchr(gtags, EMPTY_TAG, GROUP_SIZE);
+          if (free_tag != NULL) {
+            *free_tag = tag_of(h);
+            slots[group * GROUP_SIZE + (free_tag - gtags)] =
+                value_type(begin->first, begin->second);
+            break;
+          }
+          group = (group + 1) & group_mask;
+        }
+        ++nelements;
+      }
+    }
+
+    /// Sets value to the value of key and returns true if key is present
+    inline bool find(const Key& key, Value& value) const {
+      if (nelements == 0) return false;
+      const uint64_t h = hash(key);
+      const unsigned char tag = tag_of(h);
+      size_t group = home_group(h);
+      while (true) {
+        const unsigned char* gtags = &tags[group * GROUP_SIZE];
+        const value_type* gslots = &slots[group * GROUP_SIZE];
+        unsigned int empty_mask;
+        for (unsigned int m = match(gtags, tag, empty_mask); m != 0; m &= m - 1) {
+          const value_type& slot = gslots[__builtin_ctz(m)];
+          if (slot.first == key) {
+            value = slot.second;
+            return true;
+          }
+        }
+        if (empty_mask != 0) return false;
+        group = (group + 1) & group_mask;
+      }
+    }
+
+    /**
+     * Looks up keys[0 .. n), setting values[i] to the value of keys[i]
+     * or to missing. Returns the number of keys found.
+     */
+    size_t find_many(const Key* keys, size_t n, Value* values,
+                     const Value& missing) const {
+      size_t found = 0;
+      for (size_t i = 0; i < n; ++i) {
+        if (i + PREFETCH_DISTANCE < n && nelements > 0) {
+          const size_t group = home_group(hash(keys[i + PREFETCH_DISTANCE]));
+          __builtin_prefetch(&tags[group * GROUP_SIZE]);
+          __builtin_prefetch(&slots[group * GROUP_SIZE]);
+        }
+        if (find(keys[i], values[i])) ++found;
+        else values[i] = missing;
+      }
+      return found;
+    }
+
+    size_t size() const { return nelements; }
+
+    bool empty() const { return nelements == 0; }
+
+    void clear() {
+      std::vector<unsigned char>().swap(tags);
+      std::vector<value_type>().swap(slots);
+      group_mask = 0;
+      nelements = 0;
+    }
+
+    /// The memory used by the map in bytes
+    size_t estimate_sizeof() const {
+      return tags.capacity() + slots.capacity() * sizeof(value_type);
+    }
+
+  private:
+    std::vector<unsigned char> tags;
+    std::vector<value_type> slots;
+    size_t group_mask;
+    size_t nelements;
+
+    /// The finalizer of MurmurHash3: gvids are often dense integers
+    static inline uint64_t hash(const Key& key) {
+      uint64_t h = (uint64_t)key;
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+
+    static inline unsigned char tag_of(uint64_t h) {
+      return (unsigned char)(h & 0x7F);
+    }
+
+    inline size_t home_group(uint64_t h) const {
+      return (size_t)(h >> 7) & group_mask;
+    }
+
+    /**
+     * Returns the slots of the group whose tag is tag as a bit mask, and
+     * sets empty_mask to the mask of the empty slots.
+     */
+    static inline unsigned int match(const unsigned char* gtags,
+                                     unsigned char tag,
+                                     unsigned int& empty_mask) {
+#ifdef __SSE2__
+      const __m128i group = _mm_loadu_si128((const __m128i*)gtags);
+      // the empty tag is the only one with the high bit set
+      empty_mask = _mm_movemask_epi8(group);
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+      unsigned int m = 0;
+      empty_mask = 0;
+      for (unsigned int i = 0; i < GROUP_SIZE; ++i) {
+        m |= (unsigned int)(gtags[i] == tag) << i;
+        empty_mask |= (unsigned int)(gtags[i] == EMPTY_TAG) << i;
+      }
+      return m;
+#endif
+    }
+  }; // end of frozen_hash_map
+
+} // end of namespace graphlab
+
+#endif
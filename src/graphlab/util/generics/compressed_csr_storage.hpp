@@ -0,0 +1,308 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_COMPRESSED_CSR_STORAGE
+#define GRAPHLAB_COMPRESSED_CSR_STORAGE
+
+#include <vector>
+#include <utility>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+namespace graphlab {
+  /**
+   * A compressed key-values data structure in Compressed Sparse Row
+   * format.  Each key is associated with a list of (value, id) pairs
+   * in which both the values and the ids are non-decreasing.  The lists
+   * are stored as delta + varint encoded byte streams and decoded on
+   * the fly by the iterators.
+   *
+   * If the ids are implicit (see build()), the id of each pair is its
+   * position in the concatenation of all lists and is not stored.
+   *
+   * Iterators are forward only.  The number of values of a key is
+   * available in constant time through num_values(id).
+   */
+  template <typename valuetype, typename sizetype=size_t>
+  class compressed_csr_storage {
+   public:
+     typedef std::pair<valuetype, sizetype> value_type;
+
+     class const_iterator :
+       public boost::iterator_facade<const_iterator, value_type,
+                                     boost::forward_traversal_tag,
+                                     value_type> {
+      public:
+       const_iterator() : ptr(NULL), pos(0), end_pos(0), implicit_ids(true) { }
+
+       const_iterator(const unsigned char* ptr, sizetype pos,
+                      sizetype end_pos, bool implicit_ids) :
+         ptr(ptr), pos(pos), end_pos(end_pos), implicit_ids(implicit_ids) {
+         cur.first = 0; cur.second = 0;
+         if (pos < end_pos) decode();
+       }
+
+       /// Returns the number of elements between this and other
+       ptrdiff_t distance_to(const const_iterator& other) const {
+         return ptrdiff_t(other.pos) - ptrdiff_t(pos);
+       }
+
+      private:
+       friend class boost::iterator_core_access;
+
+       void increment() {
+         ++pos;
+         if (pos < end_pos) decode();
+       }
+       bool equal(const const_iterator& other) const {
+         return pos == other.pos;
+       }
+       value_type dereference() const { return cur; }
+
+       // the deltas are relative to the previously decoded pair
+       void decode() {
+         cur.first += valuetype(read_varint(ptr));
+         if (implicit_ids) cur.second = pos;
+         else cur.second += sizetype(read_varint(ptr));
+       }
+
+       const unsigned char* ptr;
+       sizetype pos;
+       sizetype end_pos;
+       bool implicit_ids;
+       value_type cur;
+     }; // end of const_iterator
+
+     typedef const_iterator iterator;
+
+   public:
+     compressed_csr_storage() : implicit_ids(true) { }
+
+     /**
+      * Builds the storage from the begin index of each key in values,
+      * as produced by counting_sort().  The values, and the ids if
+      * given, must be non-decreasing within each key.  If ids is NULL
+      * the id of each value is its index in values.
+      */
+     void build(const std::vector<sizetype>& prefix,
+                const std::vector<valuetype>& values,
+                const std::vector<sizetype>* ids = NULL) {
+       clear();
+       implicit_ids = (ids == NULL);
+       if (ids != NULL) ASSERT_EQ(ids->size(), values.size());
+       const size_t nkeys = prefix.size();
+       value_ptrs.resize(nkeys + 1);
+       for (size_t i = 0; i < nkeys; ++i) value_ptrs[i] = prefix[i];
+       value_ptrs[nkeys] = values.size();
+       // measure the encoded length of each key
+       std::vector<sizetype> nbytes(nkeys + 1, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+       for (ssize_t i = 0; i < ssize_t(nkeys); ++i) {
+         nbytes[i + 1] = encode_key(i, values, ids, NULL);
+       }
+       for (size_t i = 1; i <= nkeys; ++i) nbytes[i] += nbytes[i - 1];
+       bytes.resize(nbytes[nkeys]);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+       for (ssize_t i = 0; i < ssize_t(nkeys); ++i) {
+         encode_key(i, values, ids, bytes.empty() ? NULL : &bytes[nbytes[i]]);
+       }
+       byte_ptrs.swap(nbytes);
+     }
+
+     /// Number of keys in the storage.
+     inline size_t num_keys() const {
+       return value_ptrs.empty() ? 0 : value_ptrs.size() - 1;
+     }
+
+     /// Number of values in the storage.
+     inline size_t num_values() const {
+       return value_ptrs.empty() ? 0 : value_ptrs.back();
+     }
+
+     /// Number of values with key == id
+     inline size_t num_values(size_t id) const {
+       return id < num_keys() ? value_ptrs[id + 1] - value_ptrs[id] : 0;
+     }
+
+     /// Return iterator to the begining value with key == id
+     inline const_iterator begin(size_t id) const {
+       if (id >= num_keys()) return const_iterator();
+       return const_iterator(byte_array() + byte_ptrs[id], value_ptrs[id],
+                             value_ptrs[id + 1], implicit_ids);
+     }
+
+     /// Return iterator to the ending+1 value with key == id
+     inline const_iterator end(size_t id) const {
+       if (id >= num_keys()) return const_iterator();
+       return const_iterator(NULL, value_ptrs[id + 1], value_ptrs[id + 1],
+                             implicit_ids);
+     }
+
+     /// Prefetches the position of the values with key == id
+     inline void prefetch_key(size_t id) const {
+       if (id < num_keys()) {
+         __builtin_prefetch(&value_ptrs[id]);
+         __builtin_prefetch(&byte_ptrs[id]);
+       }
+     }
+
+     /// Prefetches the encoding of the first values with key == id
+     inline void prefetch_values(size_t id) const {
+       if (id < num_keys() && byte_ptrs[id] < bytes.size()) {
+         __builtin_prefetch(byte_array() + byte_ptrs[id]);
+       }
+     }
+
+     /// Appends the arrays as (first byte, length in bytes) pairs
+     void memory_ranges(std::vector<std::pair<char*, size_t> >& out) {
+       if (!value_ptrs.empty()) {
+         out.push_back(std::make_pair((char*)&value_ptrs[0],
+                                      value_ptrs.size() * sizeof(sizetype)));
+         out.push_back(std::make_pair((char*)&byte_ptrs[0],
+                                      byte_ptrs.size() * sizeof(sizetype)));
+       }
+       if (!bytes.empty()) out.push_back(std::make_pair((char*)&bytes[0],
+                                                        bytes.size()));
+     }
+
+     void swap(compressed_csr_storage& other) {
+       value_ptrs.swap(other.value_ptrs);
+       byte_ptrs.swap(other.byte_ptrs);
+       bytes.swap(other.bytes);
+       std::swap(implicit_ids, other.implicit_ids);
+     }
+
+     void clear() {
+       std::vector<sizetype>().swap(value_ptrs);
+       std::vector<sizetype>().swap(byte_ptrs);
+       std::vector<unsigned char>().swap(bytes);
+     }
+
+     void load(iarchive& iarc) {
+       clear();
+       iarc >> implicit_ids
+            >> value_ptrs
+            >> byte_ptrs
+            >> bytes;
+     }
+     void save(oarchive& oarc) const {
+       oarc << implicit_ids
+            << value_ptrs
+            << byte_ptrs
+            << bytes;
+     }
+
+     /// Writes the raw arrays to a graph snapshot
+     template <typename SnapshotWriter>
+     void save_snapshot(SnapshotWriter& writer) const {
+       writer.write(std::vector<uint64_t>(1, implicit_ids));
+       writer.write(value_ptrs);
+       writer.write(byte_ptrs);
+       writer.write(bytes);
+     }
+
+     /// Reads the raw arrays from a graph snapshot
+     template <typename SnapshotReader>
+     void load_snapshot(SnapshotReader& reader) {
+       std::vector<uint64_t> flags;
+       reader.read(flags);
+       ASSERT_EQ(flags.size(), 1);
+       implicit_ids = flags[0];
+       reader.read(value_ptrs);
+       reader.read(byte_ptrs);
+       reader.read(bytes);
+     }
+
+     size_t estimate_sizeof() const {
+       return sizeof(value_ptrs) + sizeof(byte_ptrs) + sizeof(bytes) +
+         sizeof(sizetype) * (value_ptrs.capacity() + byte_ptrs.capacity()) +
+         bytes.capacity();
+     }
+
+   private:
+     /** The begin index of the values of each key followed by the total
+         number of values */
+     std::vector<sizetype> value_ptrs;
+     /** The begin offset of the encoded values of each key followed by
+         the total number of bytes */
+     std::vector<sizetype> byte_ptrs;
+     std::vector<unsigned char> bytes;
+     bool implicit_ids;
+
+     const unsigned char* byte_array() const {
+       return bytes.empty() ? NULL : &bytes[0];
+     }
+
+     /**
+      * Encodes the values of key i into out, returning the number of
+      * bytes used.  Only measures the length if out is NULL.
+      */
+     size_t encode_key(size_t i, const std::vector<valuetype>& values,
+                       const std::vector<sizetype>* ids,
+                       unsigned char* out) const {
+       size_t len = 0;
+       valuetype prev_value = 0;
+       sizetype prev_id = 0;
+       for (size_t j = value_ptrs[i]; j < value_ptrs[i + 1]; ++j) {
+         ASSERT_GE(values[j], prev_value);
+         len += write_varint(values[j] - prev_value, out ? out + len : NULL);
+         prev_value = values[j];
+         if (ids != NULL) {
+           const sizetype id = (*ids)[j];
+           ASSERT_GE(id, prev_id);
+           len += write_varint(id - prev_id, out ? out + len : NULL);
+           prev_id = id;
+         }
+       }
+       return len;
+     }
+
+     static size_t write_varint(uint64_t val, unsigned char* out) {
+       size_t len = 1;
+       while (val >= 0x80) {
+         if (out) *(out++) = (unsigned char)(val | 0x80);
+         val >>= 7;
+         ++len;
+       }
+       if (out) *out = (unsigned char)val;
+       return len;
+     }
+
+     static uint64_t read_varint(const unsigned char*& ptr) {
+       uint64_t val = 0;
+       size_t shift = 0;
+       while (*ptr & 0x80) {
+         val |= uint64_t(*(ptr++) & 0x7f) << shift;
+         shift += 7;
+       }
+       val |= uint64_t(*(ptr++)) << shift;
+       return val;
+     }
+  }; // end of class
+} // end of graphlab
+#endif
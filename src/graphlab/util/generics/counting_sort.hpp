@@ -27,9 +27,77 @@
 #endif
 
 #include <vector>
+#include <algorithm>
 #include <graphlab/parallel/atomic.hpp>
 
 namespace graphlab {
+    /**
+     *  Replace each entry of counts with the sum of the entries up to
+     *  and including it.  The array is split into one block per thread:
+     *  each thread sums its block, the block totals are scanned, and
+     *  each thread then offsets its block.
+     */
+    template <typename sizetype>
+    void parallel_prefix_sum(std::vector< atomic<sizetype> >& counts) {
+      const size_t n = counts.size();
+      if (n == 0) return;
+#ifdef _OPENMP
+      std::vector<sizetype> block_sums(omp_get_max_threads() + 1, 0);
+#pragma omp parallel
+      {
+        const size_t nblocks = omp_get_num_threads();
+        const size_t b = omp_get_thread_num();
+        const size_t block_size = (n + nblocks - 1) / nblocks;
+        const size_t begin = std::min(n, b * block_size);
+        const size_t end = std::min(n, begin + block_size);
+        for (size_t i = begin + 1; i < end; ++i) {
+          counts[i].value += counts[i-1].value;
+        }
+        if (begin < end) block_sums[b + 1] = counts[end - 1].value;
+#pragma omp barrier
+#pragma omp single
+        for (size_t i = 1; i <= nblocks; ++i) block_sums[i] += block_sums[i-1];
+        // implicit barrier at the end of single
+        const sizetype offset = block_sums[b];
+        for (size_t i = begin; i < end; ++i) counts[i].value += offset;
+      }
+#else
+      for (size_t i = 1; i < n; ++i) counts[i].value += counts[i-1].value;
+#endif
+    }
+
+    /**
+     *  If value_vec is sorted in ascending order, fills prefix_array
+     *  with the begin index of each value, as counting_sort() would,
+     *  and returns true. Returns false and leaves prefix_array alone
+     *  otherwise.
+     **/
+    template <typename valuetype, typename sizetype>
+    bool prefix_of_sorted(const std::vector<valuetype>& value_vec,
+                          std::vector<sizetype>& prefix_array) {
+      if(value_vec.size() == 0) return false;
+      bool sorted = true;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(&&:sorted)
+#endif
+      for (ssize_t i = 1; i < ssize_t(value_vec.size()); ++i) {
+        sorted = sorted && (value_vec[i-1] <= value_vec[i]);
+      }
+      if (!sorted) return false;
+      prefix_array.resize(size_t(value_vec.back()) + 1);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t i = 0; i < ssize_t(value_vec.size()); ++i) {
+        // i begins every value in (value_vec[i-1], value_vec[i]]
+        const size_t first = (i == 0) ? 0 : size_t(value_vec[i-1]) + 1;
+        for (size_t v = first; v <= size_t(value_vec[i]); ++v) {
+          prefix_array[v] = i;
+        }
+      }
+      return true;
+    }
+
     /**
      *  Count the value_vec.
      *  Generate permute_index for value_vec in ascending order and 
@@ -41,7 +109,21 @@ namespace graphlab {
                        std::vector<sizetype>* prefix_array = NULL) {
       if(value_vec.size() == 0) return;
 
-      valuetype maxval = *std::max_element(value_vec.begin(), value_vec.end());
+      valuetype maxval = 0;
+#ifdef _OPENMP
+#pragma omp parallel
+      {
+        valuetype local_max = 0;
+#pragma omp for nowait
+        for (ssize_t i = 0; i < ssize_t(value_vec.size()); ++i) {
+          local_max = std::max(local_max, value_vec[i]);
+        }
+#pragma omp critical
+        maxval = std::max(maxval, local_max);
+      }
+#else
+      maxval = *std::max_element(value_vec.begin(), value_vec.end());
+#endif
       std::vector< atomic<size_t> > counter_array(maxval+1);
       permute_index.resize(value_vec.size(), 0);
       permute_index.assign(value_vec.size(), 0);
@@ -53,9 +135,7 @@ namespace graphlab {
         counter_array[val].inc();
       }
 
-      for (size_t i = 1; i < counter_array.size(); ++i) {
-        counter_array[i] += counter_array[i-1];
-      }
+      parallel_prefix_sum(counter_array);
 
 #ifdef _OPENMP
 #pragma omp parallel for
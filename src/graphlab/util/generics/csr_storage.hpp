@@ -142,6 +142,30 @@ namespace graphlab {
        return (id+1) < num_keys() ? values.begin()+value_ptrs[id+1] : values.end();
      }
 
+     /// Prefetches the position of the values with key == id
+     inline void prefetch_key(size_t id) const {
+       if (id < num_keys()) __builtin_prefetch(&value_ptrs[id]);
+     }
+
+     /// Prefetches the first values with key == id
+     inline void prefetch_values(size_t id) const {
+       if (id < num_keys() && value_ptrs[id] < values.size()) {
+         __builtin_prefetch(&values[value_ptrs[id]]);
+       }
+     }
+
+     /// Appends the arrays as (first byte, length in bytes) pairs
+     void memory_ranges(std::vector<std::pair<char*, size_t> >& out) {
+       if (!value_ptrs.empty()) {
+         out.push_back(std::make_pair((char*)&value_ptrs[0],
+                                      value_ptrs.size() * sizeof(sizetype)));
+       }
+       if (!values.empty()) {
+         out.push_back(std::make_pair((char*)&values[0],
+                                      values.size() * sizeof(valuetype)));
+       }
+     }
+
      /// printout the csr storage
      void print(std::ostream& out) {
        for (size_t i = 0; i < num_keys(); ++i)  {
@@ -183,6 +207,20 @@ namespace graphlab {
        return sizeof(value_ptrs) + sizeof(values) + sizeof(sizetype)*value_ptrs.capacity() + sizeof(valuetype) * values.capacity();
      }
 
+     /// Writes the raw arrays to a graph snapshot
+     template <typename SnapshotWriter>
+     void save_snapshot(SnapshotWriter& writer) const {
+       writer.write(value_ptrs);
+       writer.write(values);
+     }
+
+     /// Reads the raw arrays from a graph snapshot
+     template <typename SnapshotReader>
+     void load_snapshot(SnapshotReader& reader) {
+       reader.read(value_ptrs);
+       reader.read(values);
+     }
+
    private:
      std::vector<sizetype> value_ptrs;
      std::vector<valuetype> values;
@@ -54,6 +54,9 @@ namespace graphlab {
      typedef typename block_linked_list_t::blocktype blocktype;
      typedef valuetype value_type;
 
+     /// Batches of at least 1/MERGE_RATIO of the values are merged
+     enum { MERGE_RATIO = 16 };
+
    public:
      dynamic_csr_storage() { }
 
@@ -162,6 +165,69 @@ namespace graphlab {
        }
      }
 
+     /**
+      * Insert a batch of values sorted by key, in the format of wrap():
+      * the values of key i are new_values[prefix[i] .. prefix[i+1]).
+      *
+      * Small batches are inserted key by key, which shifts the rest of
+      * the block on every key. Batches of at least 1/MERGE_RATIO of the
+      * stored values are instead merged with the stored values of every
+      * key in one pass which rebuilds fully packed blocks.
+      */
+     void insert_sorted(const std::vector<sizetype>& prefix,
+                        const std::vector<valuetype>& new_values) {
+       if (new_values.empty()) return;
+       if (new_values.size() * MERGE_RATIO < num_values()) {
+         for (size_t i = 0; i < prefix.size(); ++i) {
+           const size_t first = prefix[i];
+           const size_t last = (i + 1 == prefix.size()) ? new_values.size()
+                                                        : prefix[i + 1];
+           if (last > first) {
+             insert(i, new_values.begin() + first, new_values.begin() + last);
+           }
+         }
+         repack();
+         return;
+       }
+       const size_t nkeys = std::max(num_keys(), prefix.size());
+       std::vector<sizetype> merged_ptrs(nkeys);
+       std::vector<valuetype> merged;
+       merged.reserve(num_values() + new_values.size());
+       for (size_t i = 0; i < nkeys; ++i) {
+         merged_ptrs[i] = merged.size();
+         for (iterator it = begin(i); it != end(i); ++it) merged.push_back(*it);
+         if (i < prefix.size()) {
+           const size_t last = (i + 1 == prefix.size()) ? new_values.size()
+                                                        : prefix[i + 1];
+           merged.insert(merged.end(), new_values.begin() + prefix[i],
+                         new_values.begin() + last);
+         }
+       }
+       // wrap() expects the last key to have values
+       while (!merged_ptrs.empty() && merged_ptrs.back() == merged.size()) {
+         merged_ptrs.pop_back();
+       }
+       clear();
+       wrap(merged_ptrs, merged);
+     }
+
+     /**
+      * Copy the values to contiguous arrays in the format of wrap(),
+      * e.g. to build a csr_storage for read mostly phases.
+      */
+     void flatten(std::vector<sizetype>& valueptr_vec,
+                  std::vector<valuetype>& value_vec) const {
+       valueptr_vec.resize(num_keys());
+       value_vec.clear();
+       value_vec.reserve(num_values());
+       for (size_t i = 0; i < num_keys(); ++i) {
+         valueptr_vec[i] = value_vec.size();
+         for (const_iterator it = begin(i); it != end(i); ++it) {
+           value_vec.push_back(*it);
+         }
+       }
+     }
+
      /// Repack the values in parallel
      void repack() {
        // values.print(std::cerr);
@@ -31,6 +31,7 @@ extern "C" {
 #endif
 
 #include <vector>
+#include <string>
 #include <boost/iostreams/stream.hpp>
 
 
@@ -45,6 +46,10 @@ namespace graphlab {
     /** the primary filesystem object */
     hdfsFS filesystem;
   public:
+    /** The read-ahead buffer of every file opened for reading. HDFS
+        serves large sequential reads much faster than small ones. */
+    enum { READ_BUFFER_SIZE = 8 * 1024 * 1024 };
+
     /** hdfs file source is used to construct boost iostreams */
     class hdfs_device {
     public: // boost iostream concepts
@@ -60,17 +65,25 @@ namespace graphlab {
      
     public:
       hdfs_device() : filesystem(NULL), file(NULL) { }
+      /**
+       * Opens filename for writing, or for reading starting at byte
+       * offset.
+       */
       hdfs_device(const hdfs& hdfs_fs, const std::string& filename,
-                  const bool write = false) :
+                  const bool write = false, const size_t offset = 0) :
         filesystem(hdfs_fs.filesystem) {
         ASSERT_TRUE(filesystem != NULL);
         // open the file
         const int flags = write? O_WRONLY : O_RDONLY;
-        const int buffer_size = 0; // use default
+        const int buffer_size = write ? 0 : READ_BUFFER_SIZE;
         const short replication = 0; // use default
         const tSize block_size = 0; // use default;
         file = hdfsOpenFile(filesystem, filename.c_str(), flags, buffer_size,
                             replication, block_size);
+        if (file != NULL && offset > 0) {
+          const int seek_error = hdfsSeek(filesystem, file, offset);
+          ASSERT_EQ(seek_error, 0);
+        }
       }
       //      ~hdfs_device() { if(file != NULL) close(); }
 
@@ -85,11 +98,15 @@ namespace graphlab {
         file = NULL;
       }
 
-      /** the optimal buffer size is 0. */
-      inline std::streamsize optimal_buffer_size() const { return 0; }
+      /** reads are buffered READ_BUFFER_SIZE bytes at a time */
+      inline std::streamsize optimal_buffer_size() const {
+        return READ_BUFFER_SIZE;
+      }
 
       std::streamsize read(char* strm_ptr, std::streamsize n) {
-        return hdfsRead(filesystem, file, strm_ptr, n);
+        const tSize ret = hdfsRead(filesystem, file, strm_ptr, n);
+        // boost iostreams expects -1 at the end of the file
+        return ret == 0 ? -1 : ret;
       } // end of read
       std::streamsize write(const char* strm_ptr, std::streamsize n) {
          return hdfsWrite(filesystem, file, strm_ptr, n);
@@ -129,6 +146,38 @@ namespace graphlab {
       return files;
     } // end of list_files
 
+    /**
+     * Returns the size of the file and sets block_size to its HDFS
+     * block size.
+     */
+    inline size_t file_size(const std::string& path, size_t& block_size) {
+      hdfsFileInfo* info = hdfsGetPathInfo(filesystem, path.c_str());
+      ASSERT_TRUE(info != NULL);
+      const size_t size = info->mSize;
+      block_size = info->mBlockSize;
+      hdfsFreeFileInfo(info, 1);
+      return size;
+    } // end of file_size
+
+    /**
+     * Returns the names of the datanodes holding each block of the
+     * byte range [begin, begin + length) of the file.
+     */
+    inline std::vector<std::vector<std::string> >
+    block_hosts(const std::string& path, size_t begin, size_t length) {
+      std::vector<std::vector<std::string> > ret;
+      char*** hosts = hdfsGetHosts(filesystem, path.c_str(), begin, length);
+      if (hosts == NULL) return ret;
+      for (size_t i = 0; hosts[i] != NULL; ++i) {
+        ret.push_back(std::vector<std::string>());
+        for (size_t j = 0; hosts[i][j] != NULL; ++j) {
+          ret.back().push_back(hosts[i][j]);
+        }
+      }
+      hdfsFreeHosts(hosts);
+      return ret;
+    } // end of block_hosts
+
     inline static bool has_hadoop() { return true; }
     
     static hdfs& get_hdfs();
@@ -139,6 +188,8 @@ namespace graphlab {
 
   class hdfs {
   public:
+    enum { READ_BUFFER_SIZE = 8 * 1024 * 1024 };
+
     /** hdfs file source is used to construct boost iostreams */
     class hdfs_device {
     public: // boost iostream concepts
@@ -146,7 +197,7 @@ namespace graphlab {
       typedef boost::iostreams::bidirectional_device_tag    category;
     public:
       hdfs_device(const hdfs& hdfs_fs, const std::string& filename,
-                  const bool write = false) { 
+                  const bool write = false, const size_t offset = 0) { 
         logstream(LOG_FATAL) << "Libhdfs is not installed on this system." 
                              << std::endl;
       }
@@ -186,6 +237,19 @@ namespace graphlab {
       return std::vector<std::string>();;
     } // end of list_files
 
+    inline size_t file_size(const std::string& path, size_t& block_size) {
+      logstream(LOG_FATAL) << "Libhdfs is not installed on this system." 
+                           << std::endl;
+      return 0;
+    } // end of file_size
+
+    inline std::vector<std::vector<std::string> >
+    block_hosts(const std::string& path, size_t begin, size_t length) {
+      logstream(LOG_FATAL) << "Libhdfs is not installed on this system." 
+                           << std::endl;
+      return std::vector<std::vector<std::string> >();
+    } // end of block_hosts
+
     // No hadoop available
     inline static bool has_hadoop() { return false; }
     
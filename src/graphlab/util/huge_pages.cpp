@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <sys/mman.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <graphlab/util/huge_pages.hpp>
+
+// MADV_COLLAPSE from linux/mman.h, missing from older headers
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
+namespace graphlab {
+  namespace huge_pages {
+
+    bool available() {
+      std::ifstream fin("/sys/kernel/mm/transparent_hugepage/enabled");
+      std::string line;
+      if (!std::getline(fin, line)) return false;
+      // the selected mode is in brackets, e.g. "always [madvise] never"
+      return line.find("[never]") == std::string::npos;
+    } // end of available
+
+
+    size_t advise(void* ptr, size_t len) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+      const size_t begin = ((size_t)ptr + HUGE_PAGE_SIZE - 1) /
+          HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+      const size_t end = ((size_t)ptr + len) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+      if (end <= begin) return 0;
+      if (madvise((void*)begin, end - begin, MADV_HUGEPAGE) != 0) return 0;
+      // best effort: fails with EINVAL before Linux 6.1, and with EAGAIN
+      // when no huge page could be allocated
+      madvise((void*)begin, end - begin, MADV_COLLAPSE);
+      return end - begin;
+#else
+      return 0;
+#endif
+    } // end of advise
+
+
+    size_t resident_bytes() {
+      std::ifstream fin("/proc/self/smaps_rollup");
+      std::string line;
+      while (std::getline(fin, line)) {
+        if (line.compare(0, 14, "AnonHugePages:") == 0) {
+          std::stringstream strm(line.substr(14));
+          size_t kb = 0;
+          strm >> kb;
+          return kb * 1024;
+        }
+      }
+      return 0;
+    } // end of resident bytes
+
+  } // end of namespace huge_pages
+} // end of namespace graphlab
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_HUGE_PAGES_HPP
+#define GRAPHLAB_UTIL_HUGE_PAGES_HPP
+
+#include <cstddef>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * \brief Backs large arrays which are already allocated with
+   * transparent huge pages, reducing the TLB misses of random accesses.
+   *
+   * Only the part of an array covering whole huge pages can be backed.
+   * Arrays are given to advise() once they stop growing, e.g. when the
+   * graph is finalized.
+   */
+  namespace huge_pages {
+
+    /// The size of a transparent huge page
+    const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /**
+     * True if the kernel backs memory with transparent huge pages when
+     * asked to, i.e. /sys/kernel/mm/transparent_hugepage/enabled is
+     * "always" or "madvise".
+     */
+    bool available();
+
+    /**
+     * Asks the kernel to back the huge page aligned part of
+     * [ptr, ptr + len) with transparent huge pages. The pages already
+     * touched are collapsed immediately on kernels supporting
+     * MADV_COLLAPSE (Linux 6.1), and in the background by khugepaged
+     * otherwise. Returns the number of bytes advised, which is 0 on
+     * failure or when the range holds no aligned huge page.
+     */
+    size_t advise(void* ptr, size_t len);
+
+    /**
+     * The bytes of this process backed by transparent huge pages, read
+     * from /proc/self/smaps_rollup. Returns 0 when unknown.
+     */
+    size_t resident_bytes();
+
+  } // end of namespace huge_pages
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,399 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_HYBRID_BITSET_HPP
+#define GRAPHLAB_HYBRID_BITSET_HPP
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/parallel/atomic.hpp>
+
+namespace graphlab {
+
+  /**  \ingroup util
+   * \brief A dense bitset which additionally keeps an explicit list of
+   * the set bits while only a few bits are set.
+   *
+   * The hybrid bitset behaves like a \ref dense_bitset but every bit
+   * which transitions from 0 to 1 through set_bit() is also appended to
+   * a list of at most sparse_capacity() entries.  As long as the list
+   * has not overflowed the bitset is "sparse" and the set bits can be
+   * traversed in O(number of set bits) instead of O(size / 64).  Once
+   * more than sparse_capacity() bits are set the list is abandoned and
+   * the bitset behaves exactly like a dense_bitset until the next
+   * clear().
+   *
+   * Bits cleared through clear_bit() are not removed from the list;
+   * compact_sparse() sorts the list and drops such stale entries.
+   * Traversals of the list must therefore always test the bit.
+   *
+   * set_bit() and clear_bit() are thread safe.  All the other
+   * mutating operations are not.
+   *
+   * \tparam IndexType The integer type stored in the sparse list.
+   */
+  template <typename IndexType = size_t>
+  class hybrid_bitset {
+  public:
+    typedef IndexType index_type;
+
+    /// Constructs an empty bitset which never tracks set bits
+    hybrid_bitset() : count(0), capacity(0), sorted(true) { }
+
+    /**
+     * Constructs a bitset of n bits, all cleared, which tracks up to
+     * sparse_capacity set bits.
+     */
+    hybrid_bitset(size_t n, size_t sparse_capacity) :
+        count(0), capacity(0), sorted(true) {
+      resize(n);
+      clear();
+      set_sparse_capacity(sparse_capacity);
+    }
+
+    /// Make a copy of the bitset hb
+    hybrid_bitset(const hybrid_bitset& hb) :
+        count(0), capacity(0), sorted(true) {
+      *this = hb;
+    }
+
+    /// Make a copy of the bitset hb
+    hybrid_bitset& operator=(const hybrid_bitset& hb) {
+      bits = hb.bits;
+      list = hb.list;
+      count = size_t(hb.count.value);
+      capacity = hb.capacity;
+      sorted = hb.sorted;
+      return *this;
+    }
+
+    /// Exchanges the contents of this bitset with the bitset hb
+    void swap(hybrid_bitset& hb) {
+      bits.swap(hb.bits);
+      list.swap(hb.list);
+      const size_t tmp_count = count.value;
+      count = size_t(hb.count.value);
+      hb.count = tmp_count;
+      std::swap(capacity, hb.capacity);
+      std::swap(sorted, hb.sorted);
+    }
+
+    /// Replace the contents with the dense bitset db
+    hybrid_bitset& operator=(const dense_bitset& db) {
+      bits = db;
+      rebuild_sparse();
+      return *this;
+    }
+
+    /**
+     * Resizes the bitset to hold n bits. Existing bits are not changed
+     * and new bits are cleared.
+     */
+    void resize(size_t n) {
+      const bool shrinking = n < bits.size();
+      bits.resize(n);
+      if (shrinking && is_sparse()) compact_sparse();
+    }
+
+    /**
+     * Sets the maximum number of set bits tracked in the sparse list.
+     * A capacity of 0 disables tracking.  The list is rebuilt from the
+     * current contents of the bitset.
+     */
+    void set_sparse_capacity(size_t sparse_capacity) {
+      capacity = sparse_capacity;
+      list.resize(capacity);
+      rebuild_sparse();
+    }
+
+    /// Returns the maximum number of entries of the sparse list
+    size_t sparse_capacity() const { return capacity; }
+
+    /// Sets all bits to 0.  Only the listed bits are touched if sparse.
+    void clear() {
+      if (capacity > 0 && is_sparse() && count.value < num_words()) {
+        for (size_t i = 0; i < count.value; ++i) bits.clear_bit_unsync(list[i]);
+      } else {
+        bits.clear();
+      }
+      count = 0;
+      sorted = true;
+    }
+
+    /// Sets all bits to 1.  The bitset becomes dense.
+    void fill() {
+      bits.fill();
+      mark_dense();
+    }
+
+    /// Returns true if no bits are set
+    bool empty() const {
+      if (capacity > 0 && is_sparse()) {
+        for (size_t i = 0; i < count.value; ++i) {
+          if (bits.get(list[i])) return false;
+        }
+        return true;
+      }
+      return bits.empty();
+    }
+
+    /// Returns the value of the bit b
+    inline bool get(size_t b) const { return bits.get(b); }
+
+    /// Prefetches the word containing the bit b
+    inline void prefetch(size_t b) const { bits.prefetch(b); }
+
+    /// Atomically sets the bit b returning the old value
+    inline bool set_bit(size_t b) {
+      const bool ret = bits.set_bit(b);
+      if (!ret) append(b);
+      return ret;
+    }
+
+    /**
+     * Sets the bit b returning the old value.  Unlike set_bit(), this
+     * is unsafe if accessed by multiple threads.
+     */
+    inline bool set_bit_unsync(size_t b) {
+      const bool ret = bits.set_bit_unsync(b);
+      if (!ret && capacity > 0 && count.value <= capacity) {
+        if (count.value < capacity) list[count.value] = index_type(b);
+        ++count.value;
+        sorted = false;
+      }
+      return ret;
+    }
+
+    /// Atomically clears the bit b returning the old value
+    inline bool clear_bit(size_t b) { return bits.clear_bit(b); }
+
+    /// Clears the bit b returning the old value. Not thread safe.
+    inline bool clear_bit_unsync(size_t b) { return bits.clear_bit_unsync(b); }
+
+    /// Returns the value of the word containing the bit b
+    inline size_t containing_word(size_t b) { return bits.containing_word(b); }
+
+    ///  Returns the number of bits in this bitset
+    inline size_t size() const { return bits.size(); }
+
+    /// Returns the number of set bits
+    size_t popcount() const {
+      if (capacity > 0 && is_sparse()) {
+        size_t ret = 0;
+        for (size_t i = 0; i < count.value; ++i) ret += bits.get(list[i]);
+        // the list may contain duplicates if not compacted
+        if (sorted) return ret;
+      }
+      return bits.popcount();
+    }
+
+    /// Returns true if the sparse list describes all the set bits
+    inline bool is_sparse() const {
+      return capacity > 0 && count.value <= capacity;
+    }
+
+    /**
+     * Returns the number of entries in the sparse list.  Entries may
+     * refer to bits which have since been cleared.
+     */
+    inline size_t sparse_size() const {
+      return std::min<size_t>(size_t(count.value), capacity);
+    }
+
+    /// Returns the i'th entry of the sparse list
+    inline index_type sparse_entry(size_t i) const { return list[i]; }
+
+    /**
+     * Sorts the sparse list and removes duplicate entries and entries
+     * whose bit is no longer set. Returns the number of entries left.
+     * Not thread safe.
+     */
+    size_t compact_sparse() {
+      if (!is_sparse()) return 0;
+      size_t nentries = count.value;
+      if (!sorted) std::sort(list.begin(), list.begin() + nentries);
+      size_t out = 0;
+      for (size_t i = 0; i < nentries; ++i) {
+        if (list[i] < bits.size() && bits.get(list[i]) &&
+            (out == 0 || list[out - 1] != list[i])) {
+          list[out++] = list[i];
+        }
+      }
+      count = out;
+      sorted = true;
+      return out;
+    }
+
+    /**
+     * Regenerates the sparse list from the bitset.  The bitset becomes
+     * dense if more than sparse_capacity() bits are set.
+     */
+    void rebuild_sparse() {
+      count = 0;
+      sorted = true;
+      if (capacity == 0) return;
+      for (size_t w = 0; w < num_words(); ++w) {
+        size_t word = bits.containing_word(w * 8 * sizeof(size_t));
+        while (word) {
+          if (count.value == capacity) {
+            mark_dense();
+            return;
+          }
+          const size_t b = w * 8 * sizeof(size_t) +
+              dense_bitset::pop_first_bit(word);
+          list[count.value++] = index_type(b);
+        }
+      }
+    }
+
+    /// Returns the underlying dense bitset
+    const dense_bitset& dense() const { return bits; }
+
+    hybrid_bitset& operator&=(const hybrid_bitset& other) {
+      bits &= other.bits;
+      if (is_sparse()) compact_sparse();
+      return *this;
+    }
+
+    hybrid_bitset& operator|=(const hybrid_bitset& other) {
+      bits |= other.bits;
+      rebuild_sparse();
+      return *this;
+    }
+
+    hybrid_bitset& operator-=(const hybrid_bitset& other) {
+      bits -= other.bits;
+      if (is_sparse()) compact_sparse();
+      return *this;
+    }
+
+    void invert() {
+      bits.invert();
+      rebuild_sparse();
+    }
+
+    /**
+     * Calls fn(b) for every set bit b in increasing order, and returns
+     * fn. Walks the sparse list when it is sorted and the bitset is
+     * sparse, and the words of the dense bitset otherwise.
+     */
+    template <typename Fn>
+    Fn for_each_set_bit(Fn fn) const {
+      if (is_sparse() && sorted) {
+        const size_t nentries = sparse_size();
+        for (size_t i = 0; i < nentries; ++i) {
+          if (bits.get(list[i])) fn(size_t(list[i]));
+        }
+        return fn;
+      }
+      return bits.for_each_set_bit(fn);
+    }
+
+    /**
+     * Iterates over the positions of the set bits in increasing order.
+     * Walks the sparse list when it is sorted and the bitset is sparse,
+     * and the dense bitset otherwise.
+     */
+    struct bit_pos_iterator {
+      typedef std::input_iterator_tag iterator_category;
+      typedef size_t value_type;
+      typedef size_t difference_type;
+      typedef const size_t reference;
+      typedef const size_t* pointer;
+      const hybrid_bitset* hb;
+      size_t idx;
+      dense_bitset::bit_pos_iterator dense_iter;
+      bool use_list;
+      bit_pos_iterator() : hb(NULL), idx(-1), use_list(false) { }
+      bit_pos_iterator(const hybrid_bitset* hb, size_t idx, bool use_list,
+                       dense_bitset::bit_pos_iterator dense_iter) :
+        hb(hb), idx(idx), dense_iter(dense_iter), use_list(use_list) {
+        if (use_list) skip_cleared();
+      }
+      void skip_cleared() {
+        while(idx < hb->sparse_size() && !hb->get(hb->list[idx])) ++idx;
+        if (idx >= hb->sparse_size()) idx = size_t(-1);
+      }
+      size_t operator*() const {
+        return use_list ? size_t(hb->list[idx]) : *dense_iter;
+      }
+      bit_pos_iterator& operator++() {
+        if (use_list) { ++idx; skip_cleared(); }
+        else ++dense_iter;
+        return *this;
+      }
+      bit_pos_iterator operator++(int) {
+        bit_pos_iterator prev = *this;
+        ++(*this);
+        return prev;
+      }
+      bool operator==(const bit_pos_iterator& other) const {
+        return use_list ? idx == other.idx : dense_iter == other.dense_iter;
+      }
+      bool operator!=(const bit_pos_iterator& other) const {
+        return !(*this == other);
+      }
+    };
+
+    typedef bit_pos_iterator iterator;
+    typedef bit_pos_iterator const_iterator;
+
+    bit_pos_iterator begin() const {
+      const bool use_list = is_sparse() && sorted;
+      return bit_pos_iterator(this, 0, use_list,
+                              use_list ? bits.end() : bits.begin());
+    }
+
+    bit_pos_iterator end() const {
+      return bit_pos_iterator(this, size_t(-1), is_sparse() && sorted,
+                              bits.end());
+    }
+
+  private:
+    dense_bitset bits;
+    std::vector<index_type> list;
+    atomic<size_t> count;
+    size_t capacity;
+    bool sorted;
+
+    inline size_t num_words() const {
+      return (bits.size() + 8 * sizeof(size_t) - 1) / (8 * sizeof(size_t));
+    }
+
+    inline void append(size_t b) {
+      if (capacity == 0 || count.value > capacity) return;
+      const size_t idx = count.inc_ret_last();
+      if (idx < capacity) list[idx] = index_type(b);
+      sorted = false;
+    }
+
+    inline void mark_dense() {
+      count = capacity + 1;
+      sorted = false;
+    }
+  };
+
+} // namespace graphlab
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <map>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/rpc/distributed_event_log.hpp>
+#include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/memory_accounting.hpp>
+#include <graphlab/util/huge_pages.hpp>
+
+namespace graphlab {
+  namespace memory_accounting {
+
+    namespace {
+      struct source_record {
+        tag_type tag;
+        source_type source;
+      };
+
+      mutex& source_lock() {
+        static mutex lock;
+        return lock;
+      }
+
+      std::map<size_t, source_record>& sources() {
+        static std::map<size_t, source_record> src;
+        return src;
+      }
+
+      double usage_mb(size_t tag) {
+        const double BYTES_TO_MB = double(1) / double(1024 * 1024);
+        return usage()[tag] * BYTES_TO_MB;
+      }
+
+      double huge_pages_mb() {
+        const double BYTES_TO_MB = double(1) / double(1024 * 1024);
+        return huge_pages::resident_bytes() * BYTES_TO_MB;
+      }
+    }
+
+
+    const char* tag_name(size_t tag) {
+      static const char* names[NUM_TAGS] =
+        { "graph", "engine_state", "messages", "gather_cache",
+          "rpc_buffers", "fiber_stacks" };
+      ASSERT_LT(tag, NUM_TAGS);
+      return names[tag];
+    } // end of tag name
+
+
+
+    size_t add_source(tag_type tag, source_type source) {
+      static size_t next_id = 0;
+      source_record record;
+      record.tag = tag;
+      record.source = source;
+      source_lock().lock();
+      const size_t id = next_id++;
+      sources()[id] = record;
+      source_lock().unlock();
+      return id;
+    } // end of add source
+
+
+
+    void remove_source(size_t id) {
+      source_lock().lock();
+      sources().erase(id);
+      source_lock().unlock();
+    } // end of remove source
+
+
+
+    std::vector<size_t> usage() {
+      std::vector<size_t> ret(NUM_TAGS, 0);
+      source_lock().lock();
+      std::map<size_t, source_record>::const_iterator iter = sources().begin();
+      for (; iter != sources().end(); ++iter) {
+        ret[iter->second.tag] += iter->second.source();
+      }
+      source_lock().unlock();
+      return ret;
+    } // end of usage
+
+
+
+    void log_usage(const std::string& label) {
+      memory_info::log_usage(label);
+      const double BYTES_TO_MB = double(1) / double(1024 * 1024);
+      const std::vector<size_t> bytes = usage();
+      std::stringstream strm;
+      strm << "Memory Accounting: " << label;
+      for (size_t i = 0; i < NUM_TAGS; ++i) {
+        strm << "\n\t " << tag_name(i) << ": "
+             << (bytes[i] * BYTES_TO_MB) << " MB";
+      }
+      strm << "\n\t on huge pages: " << huge_pages_mb() << " MB";
+      logstream(LOG_INFO) << strm.str() << std::endl;
+    } // end of log usage
+
+
+
+    void add_to_event_log() {
+      static bool added = false;
+      if (added) return;
+      for (size_t i = 0; i < NUM_TAGS; ++i) {
+        get_event_log().create_callback_entry(
+            std::string("Memory: ") + tag_name(i), "MB",
+            boost::bind(usage_mb, i), log_type::INSTANTANEOUS);
+      }
+      get_event_log().create_callback_entry(
+          "Memory: huge_pages", "MB", huge_pages_mb, log_type::INSTANTANEOUS);
+      added = true;
+    } // end of add to event log
+  } // end of namespace memory_accounting
+} // end of namespace graphlab
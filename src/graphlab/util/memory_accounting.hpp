@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_MEMORY_ACCOUNTING_HPP
+#define GRAPHLAB_MEMORY_ACCOUNTING_HPP
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+
+namespace graphlab {
+  /**
+   * \internal \brief Attributes the memory of a machine to the
+   * subsystems holding it.
+   *
+   * Every major container registers a source: a function returning
+   * its current size in bytes under one of the tags below. Sources
+   * are only called when a breakdown is requested, so the accounting
+   * costs nothing while the program runs. The sizes are shallow
+   * estimates (capacity times element size) and do not include memory
+   * owned indirectly by non-POD elements.
+   */
+  namespace memory_accounting {
+
+    enum tag_type {
+      GRAPH,          ///< local graph structure, edge and vertex data
+      ENGINE_STATE,   ///< vertex programs and per-vertex engine state
+      MESSAGES,       ///< the message arrays of the engines
+      GATHER_CACHE,   ///< gather accumulators and caches
+      RPC_BUFFERS,    ///< buffered exchange send and receive buffers
+      FIBER_STACKS,   ///< mapped fiber stacks, including pooled ones
+      NUM_TAGS
+    };
+
+    typedef boost::function<size_t(void)> source_type;
+
+    /// The name of a tag, like "gather_cache"
+    const char* tag_name(size_t tag);
+
+    /**
+     * \internal
+     *
+     * \brief Adds a source of memory under a tag. Returns an id to
+     * pass to remove_source() before the source goes out of scope.
+     */
+    size_t add_source(tag_type tag, source_type source);
+
+    /// \internal \brief Removes a source added with add_source()
+    void remove_source(size_t id);
+
+    /**
+     * \internal
+     *
+     * \brief Returns the bytes held under each tag, indexed by tag.
+     */
+    std::vector<size_t> usage();
+
+    /**
+     * \internal
+     *
+     * \brief Log the bytes held under each tag, prefixed by the
+     * string argument, after the summary of memory_info::log_usage().
+     * Also logs how much of the process is on transparent huge pages.
+     *
+     * @param [in] label the string to print before the memory usage summary.
+     */
+    void log_usage(const std::string& label = "");
+
+    /**
+     * \internal
+     *
+     * \brief Adds the megabytes held under each tag as instantaneous
+     * entries of the distributed event log, so that the metrics server
+     * shows them for every machine. Must be called by all machines
+     * simultaneously; only the first call has an effect.
+     */
+    void add_to_event_log();
+  } // end of namespace memory_accounting
+};
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_MPMC_RING_HPP
+#define GRAPHLAB_UTIL_MPMC_RING_HPP
+
+#include <vector>
+#include <stdint.h>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * \brief A bounded lock free multiple producer, multiple consumer
+   * queue (D. Vyukov's bounded MPMC queue).
+   *
+   * Every cell of the ring holds a sequence number telling whether it
+   * is ready to be written at a given enqueue position or read at a
+   * given dequeue position. A producer claims a position with one
+   * compare and swap on the enqueue position, writes the value and then
+   * publishes it by advancing the sequence of the cell, and consumers
+   * do the same on the dequeue position. Producers and consumers only
+   * share the cells they hand over, and the two positions are in
+   * separate cache lines.
+   *
+   * try_push() fails when the ring is full and try_pop() when it is
+   * empty. Neither blocks. The values are popped in the order of the
+   * claimed positions, so the values pushed by one thread are popped in
+   * the order they were pushed.
+   *
+   * As elsewhere in GraphLab, the memory ordering relies on x86 not
+   * reordering stores with other stores, or loads with other loads.
+   */
+  template <typename T>
+  class mpmc_ring {
+  public:
+    typedef T value_type;
+
+    /// Creates a ring of capacity values, rounded up to a power of 2
+    explicit mpmc_ring(size_t capacity = 1024) {
+      size_t cap = 2;
+      while (cap < capacity) cap *= 2;
+      mask = cap - 1;
+      cells.resize(cap);
+      for (size_t i = 0; i < cap; ++i) cells[i].seq = i;
+      enqueue_pos = 0;
+      dequeue_pos = 0;
+    }
+
+    /// Pushes value, or returns false if the ring is full
+    inline bool try_push(const T& value) {
+      cell* c;
+      size_t pos = enqueue_pos;
+      while (true) {
+        c = &cells[pos & mask];
+        const size_t seq = c->seq;
+        const intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+          if (__sync_bool_compare_and_swap(&enqueue_pos, pos, pos + 1)) break;
+          pos = enqueue_pos;
+        } else if (dif < 0) {
+          // the cell of the previous round was not popped yet
+          return false;
+        } else {
+          pos = enqueue_pos;
+        }
+      }
+      c->value = value;
+      asm volatile ("" : : : "memory");
+      c->seq = pos + 1;
+      return true;
+    }
+
+    /// Pops the oldest value, or returns false if the ring is empty
+    inline bool try_pop(T& value) {
+      cell* c;
+      size_t pos = dequeue_pos;
+      while (true) {
+        c = &cells[pos & mask];
+        const size_t seq = c->seq;
+        const intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+          if (__sync_bool_compare_and_swap(&dequeue_pos, pos, pos + 1)) break;
+          pos = dequeue_pos;
+        } else if (dif < 0) {
+          // nothing was published in the cell yet
+          return false;
+        } else {
+          pos = dequeue_pos;
+        }
+      }
+      asm volatile ("" : : : "memory");
+      value = c->value;
+      asm volatile ("" : : : "memory");
+      c->seq = pos + mask + 1;
+      return true;
+    }
+
+    /// True if nothing was pushed and not popped. Only approximate
+    /// while other threads push or pop.
+    inline bool empty() const {
+      return cells[dequeue_pos & mask].seq != dequeue_pos + 1;
+    }
+
+    /// The number of values in the ring. Only approximate while other
+    /// threads push or pop.
+    inline size_t approx_size() const {
+      const size_t d = dequeue_pos;
+      const size_t e = enqueue_pos;
+      return e > d ? e - d : 0;
+    }
+
+    inline size_t capacity() const { return mask + 1; }
+
+  private:
+    struct cell {
+      volatile size_t seq;
+      T value;
+      cell() : seq(0), value() { }
+    };
+
+    char pad0[64];
+    std::vector<cell> cells;
+    size_t mask;
+    char pad1[64];
+    volatile size_t enqueue_pos;
+    char pad2[64];
+    volatile size_t dequeue_pos;
+    char pad3[64];
+
+    // not copyable
+    mpmc_ring(const mpmc_ring&);
+    mpmc_ring& operator=(const mpmc_ring&);
+  }; // end of mpmc_ring
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_QUANTILE_SKETCH_HPP
+#define GRAPHLAB_QUANTILE_SKETCH_HPP
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <graphlab/util/random.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/serialization/vector.hpp>
+
+namespace graphlab {
+
+  /**  \ingroup util
+   * \brief Estimates the quantiles of a stream of values in bounded
+   * memory (the KLL sketch of Karnin, Lang and Liberty).
+   *
+   * The values are kept in levels, a value in level h standing for 2^h
+   * of the values inserted. When a level is over its capacity it is
+   * sorted and every other value, starting at a random one of the
+   * first two, moves to the next level. The capacities shrink by 2/3
+   * from the top level down, so the sketch holds about 3k values and
+   * the rank of any value is estimated within about 1.7 / k of the
+   * number of values, with high probability.
+   *
+   * operator+= merges two sketches level by level, which makes it a
+   * reduction type for map_reduce_vertices() and the aggregators:
+   * \code
+   * graphlab::quantile_sketch<double> degree(const graph_type::vertex_type& v) {
+   *   return graphlab::quantile_sketch<double>(256, v.num_out_edges());
+   * }
+   * ...
+   * const double median =
+   *     graph.map_reduce_vertices<quantile_sketch<double> >(degree).quantile(0.5);
+   * \endcode
+   * A default constructed sketch is empty and takes the k of the
+   * first one added to it.
+   */
+  template <typename T = double>
+  class quantile_sketch {
+  public:
+    typedef T value_type;
+
+    enum { DEFAULT_K = 200 };
+
+    explicit quantile_sketch(size_t k = DEFAULT_K) : k(k), n(0) { }
+
+    /// A sketch of the single value
+    quantile_sketch(size_t k, const T& value) : k(k), n(0) { insert(value); }
+
+    void insert(const T& value) {
+      if (levels.empty()) levels.resize(1);
+      levels[0].push_back(value);
+      ++n;
+      compress();
+    }
+
+    quantile_sketch& operator+=(const quantile_sketch& other) {
+      if (other.n == 0) return *this;
+      if (n == 0) return *this = other;
+      k = std::max(k, other.k);
+      if (levels.size() < other.levels.size()) levels.resize(other.levels.size());
+      for (size_t h = 0; h < other.levels.size(); ++h) {
+        levels[h].insert(levels[h].end(), other.levels[h].begin(),
+                         other.levels[h].end());
+      }
+      n += other.n;
+      compress();
+      return *this;
+    }
+
+    /// The number of values inserted
+    size_t count() const { return n; }
+
+    bool empty() const { return n == 0; }
+
+    /**
+     * Returns an estimate of the q'th quantile, for q in [0, 1]: the
+     * smallest value whose estimated rank is at least q. The sketch
+     * must not be empty.
+     */
+    T quantile(double q) const {
+      std::vector<std::pair<T, size_t> > items;
+      weighted_items(items);
+      const double target = q * n;
+      size_t rank = 0;
+      for (size_t i = 0; i < items.size(); ++i) {
+        rank += items[i].second;
+        if (rank >= target) return items[i].first;
+      }
+      return items.back().first;
+    }
+
+    /// Returns an estimate of the fraction of the values at most value
+    double rank(const T& value) const {
+      if (n == 0) return 0;
+      size_t below = 0;
+      for (size_t h = 0; h < levels.size(); ++h) {
+        for (size_t i = 0; i < levels[h].size(); ++i) {
+          if (!(value < levels[h][i])) below += size_t(1) << h;
+        }
+      }
+      return double(below) / n;
+    }
+
+    /// The number of values held, about 3k at most
+    size_t num_retained() const {
+      size_t total = 0;
+      for (size_t h = 0; h < levels.size(); ++h) total += levels[h].size();
+      return total;
+    }
+
+    void clear() { levels.clear(); n = 0; }
+
+    void save(oarchive& oarc) const { oarc << k << n << levels; }
+
+    void load(iarchive& iarc) { iarc >> k >> n >> levels; }
+
+  private:
+    size_t k;
+    size_t n;
+    std::vector<std::vector<T> > levels;
+
+    /// The capacity of level h
+    size_t capacity(size_t h) const {
+      const double depth = double(levels.size() - 1 - h);
+      return std::max<size_t>(2, size_t(std::ceil(k * std::pow(2.0 / 3, depth))));
+    }
+
+    /// Compacts the lowest full levels until every level fits
+    void compress() {
+      for (size_t h = 0; h < levels.size(); ++h) {
+        if (levels[h].size() < capacity(h)) continue;
+        if (h + 1 == levels.size()) levels.resize(levels.size() + 1);
+        std::vector<T>& level = levels[h];
+        std::sort(level.begin(), level.end());
+        // an odd value out stays in the level
+        const size_t npairs = level.size() / 2;
+        const size_t offset = random::fast_bernoulli() ? 1 : 0;
+        for (size_t i = 0; i < npairs; ++i) {
+          levels[h + 1].push_back(level[2 * i + offset]);
+        }
+        if (level.size() % 2 == 1) {
+          level[0] = level.back();
+          level.resize(1);
+        } else {
+          level.clear();
+        }
+        // the capacities of the lower levels shrank if a level was added
+        h = size_t(-1);
+      }
+    }
+
+    /// The values held with their weights, sorted by value
+    void weighted_items(std::vector<std::pair<T, size_t> >& items) const {
+      for (size_t h = 0; h < levels.size(); ++h) {
+        for (size_t i = 0; i < levels[h].size(); ++i) {
+          items.push_back(std::make_pair(levels[h][i], size_t(1) << h));
+        }
+      }
+      std::sort(items.begin(), items.end());
+    }
+  }; // end of quantile_sketch
+
+} // end of namespace graphlab
+
+#endif
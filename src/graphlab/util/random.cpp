@@ -281,6 +281,7 @@ namespace graphlab {
       discrete_rng.seed(nondet_rnd());
       // std::cout << "initializing fast discrete rng" << std::endl;
       fast_discrete_rng.seed(nondet_rnd());
+      fast_rng.seed(nondet_rnd());
       mut.unlock();
     }
 
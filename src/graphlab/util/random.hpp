@@ -35,6 +35,7 @@
 #include <boost/random.hpp>
 #include <graphlab/util/timer.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/assertions.hpp>
 
 namespace graphlab {
 
@@ -43,6 +44,10 @@ namespace graphlab {
    * A collection of thread safe random number routines.  Each thread
    * is assigned its own generator however assigning a seed affects
    * all current and future generators.
+   *
+   * The functions of the namespace draw from the fast_generator of the
+   * generator of the calling thread, without any locking. The seeding
+   * functions must therefore not run concurrently with sampling.
    */
   namespace random {        
 
@@ -69,6 +74,14 @@ namespace graphlab {
                                      const IntType& min, const IntType& max) {
           return distribution_type(min, max)(discrete_rng);
         }
+        template<typename FastRNG>
+        static inline IntType sample_fast(FastRNG& rng, 
+                                          const IntType& min, const IntType& max) {
+          // modular arithmetic also covers the signed types
+          const uint64_t span = uint64_t(max) - uint64_t(min);
+          return IntType(uint64_t(min) + 
+                         (span == ~uint64_t(0) ? rng() : rng.bounded(span + 1)));
+        }
       };
       template<>
       struct uniform<double> {
@@ -79,6 +92,11 @@ namespace graphlab {
                                     const double& min, const double& max) {
           return distribution_type(min, max)(real_rng);
         }
+        template<typename FastRNG>
+        static inline double sample_fast(FastRNG& rng, 
+                                         const double& min, const double& max) {
+          return min + (max - min) * rng.uniform01();
+        }
       };
       template<>
       struct uniform<float> {
@@ -89,9 +107,211 @@ namespace graphlab {
                                   const float& min, const float& max) {
           return distribution_type(min, max)(real_rng);
         }
+        template<typename FastRNG>
+        static inline float sample_fast(FastRNG& rng, 
+                                        const float& min, const float& max) {
+          const float u = float(rng() >> 40) * (1.0f / 16777216.0f);
+          return min + (max - min) * u;
+        }
       };
     }; // end of namespace distributions
 
+    /**
+     * The SplitMix64 finalizer, a bijective mix of the bits of x.
+     */
+    inline uint64_t mix64(uint64_t x) {
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ULL;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebULL;
+      x ^= x >> 31;
+      return x;
+    }
+
+    /// The increment of the SplitMix64 sequence
+    const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+    /// Maps 64 random bits to a double in [0, 1)
+    inline double bits_to_double(uint64_t bits) {
+      return double(bits >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /**
+     * The operations shared by the fast generators. Derived provides
+     * operator()() returning 64 random bits.
+     */
+    template<typename Derived>
+    class fast_generator_base {
+    public:
+      typedef uint64_t result_type;
+      BOOST_STATIC_CONSTANT(result_type, min_value = 0);
+      BOOST_STATIC_CONSTANT(result_type, max_value = ~uint64_t(0));
+      static result_type min BOOST_PREVENT_MACRO_SUBSTITUTION () { return min_value; }
+      static result_type max BOOST_PREVENT_MACRO_SUBSTITUTION () { return max_value; }
+
+      //! A uniform double in [0, 1)
+      inline double uniform01() { return bits_to_double(derived()()); }
+
+      //! A uniform integer in [0, n), n > 0, without modulo bias
+      inline uint64_t bounded(const uint64_t n) {
+        __uint128_t m = (__uint128_t)derived()() * n;
+        uint64_t low = uint64_t(m);
+        if (low < n) {
+          const uint64_t threshold = (0 - n) % n;
+          while (low < threshold) {
+            m = (__uint128_t)derived()() * n;
+            low = uint64_t(m);
+          }
+        }
+        return uint64_t(m >> 64);
+      }
+
+      /**
+       * Generate a random number in the uniform real with range [min,
+       * max) or [min, max] if the number type is discrete.
+       */
+      template<typename NumType>
+      inline NumType uniform(const NumType min, const NumType max) {
+        return distributions::uniform<NumType>::sample_fast(derived(), min, max);
+      }
+
+      inline bool bernoulli(const double p = double(0.5)) {
+        return uniform01() < p;
+      }
+
+      /**
+       * Draw a random number from a multinomial
+       */
+      template<typename Double>
+      size_t multinomial(const std::vector<Double>& prb) {
+        ASSERT_GT(prb.size(),0);
+        if (prb.size() == 1) { return 0; }
+        Double sum(0);
+        for(size_t i = 0; i < prb.size(); ++i) {
+          ASSERT_GE(prb[i], 0); // Each entry must be P[i] >= 0
+          sum += prb[i];
+        }
+        ASSERT_GT(sum, 0); // Normalizer must be positive
+        // scale the draw instead of normalizing every entry
+        const Double rnd(Double(uniform01()) * sum);
+        size_t ind = 0;
+        for(Double cumsum(prb[ind]);
+            rnd >= cumsum && (ind+1) < prb.size();
+            cumsum += prb[++ind]);
+        return ind;
+      }
+
+      /**
+       * Generate a draw from a multinomial using a CDF.
+       */
+      template<typename Double>
+      inline size_t multinomial_cdf(const std::vector<Double>& cdf) {
+        return std::upper_bound(cdf.begin(), cdf.end(),
+                                Double(uniform01())) - cdf.begin();
+      }
+
+      /**
+       * Shuffle a range using the begin and end iterators (Fisher-Yates)
+       */
+      template<typename Iterator>
+      void shuffle(Iterator begin, Iterator end) {
+        for (std::ptrdiff_t i = (end - begin) - 1; i > 0; --i) {
+          std::iter_swap(begin + i, begin + std::ptrdiff_t(bounded(i + 1)));
+        }
+      }
+
+    private:
+      inline Derived& derived() { return *static_cast<Derived*>(this); }
+    };
+
+    /**
+     * A small and fast xoshiro256** generator. It is not thread safe,
+     * which is why it needs no lock: every thread has its own as
+     * part of its generator, and the random:: functions draw from it.
+     */
+    class fast_generator : public fast_generator_base<fast_generator> {
+    public:
+      fast_generator() { seed(0); }
+
+      //! Seed the generator based on a number
+      void seed(const uint64_t number) {
+        // expand the seed with SplitMix64, which never gives four zeros
+        uint64_t x = number;
+        for (size_t i = 0; i < 4; ++i) {
+          x += GOLDEN_GAMMA;
+          state[i] = mix64(x);
+        }
+      }
+
+      //! 64 random bits
+      inline result_type operator()() {
+        const uint64_t result = rotl(state[1] * 5, 7) * 9;
+        const uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+      }
+
+      /**
+       * Fills out[0 .. n) with uniform doubles in [0, 1). Only one number
+       * is drawn from the generator: the values are counter based draws
+       * keyed by it, so the loop has no dependency and vectorizes.
+       */
+      void fill_uniform(double* out, const size_t n) {
+        const uint64_t key = (*this)();
+        for (size_t i = 0; i < n; ++i) {
+          out[i] = bits_to_double(mix64(key + (i + 1) * GOLDEN_GAMMA));
+        }
+      }
+
+    private:
+      static inline uint64_t rotl(const uint64_t x, const int k) {
+        return (x << k) | (x >> (64 - k));
+      }
+      uint64_t state[4];
+    };
+
+    /**
+     * A counter based generator: its sequence is a function of the key
+     * (seed, stream, substream) only, so that parallel samplers keyed by
+     * e.g. (seed, vertex id, iteration) make the same draws whatever the
+     * scheduling and the partitioning of the graph.
+     * \code
+     * random::counter_generator rng(seed, vertex.id(), context.iteration());
+     * size_t topic = rng.multinomial(prb);
+     * \endcode
+     */
+    class counter_generator : public fast_generator_base<counter_generator> {
+    public:
+      counter_generator(const uint64_t seed, const uint64_t stream,
+                        const uint64_t substream = 0) :
+        key(mix64(mix64(mix64(seed) ^ stream) + substream)), counter(0) { }
+
+      //! 64 random bits
+      inline result_type operator()() {
+        return mix64(key + (++counter) * GOLDEN_GAMMA);
+      }
+
+      //! Fills out[0 .. n) with the next n uniform doubles in [0, 1)
+      void fill_uniform(double* out, const size_t n) {
+        const uint64_t start = key + counter * GOLDEN_GAMMA;
+        for (size_t i = 0; i < n; ++i) {
+          out[i] = bits_to_double(mix64(start + (i + 1) * GOLDEN_GAMMA));
+        }
+        counter += n;
+      }
+
+    private:
+      uint64_t key;
+      uint64_t counter;
+    };
+
+
+
     /**
      * The generator class is the base underlying type used to
      * generate random numbers.  User threads should use the functions
@@ -114,6 +334,7 @@ namespace graphlab {
         real_rng.seed();
         discrete_rng.seed();
         fast_discrete_rng.seed();
+        fast_rng.seed(0);
         mut.unlock();
       }
 
@@ -132,6 +353,7 @@ namespace graphlab {
         fast_discrete_rng.seed(number);
         real_rng.seed(fast_discrete_rng);
         discrete_rng.seed(fast_discrete_rng);
+        fast_rng.seed(number);
         mut.unlock();
       }
       
@@ -141,8 +363,15 @@ namespace graphlab {
         real_rng.seed(other.real_rng);
         discrete_rng.seed(other.discrete_rng);
         fast_discrete_rng.seed(other.fast_discrete_rng());
+        fast_rng.seed(other.fast_rng());
         mut.unlock();
       } 
+
+      /**
+       * The lock free generator of this generator. It must only be used
+       * by one thread at a time.
+       */
+      inline fast_generator& fast_source() { return fast_rng; }
    
       /**
        * Generate a random number in the uniform real with range [min,
@@ -307,6 +536,8 @@ namespace graphlab {
       discrete_rng_type discrete_rng;
       //! The fast discrete random number generator
       fast_discrete_rng_type fast_discrete_rng;
+      //! The lock free generator used by the random:: functions
+      fast_generator fast_rng;
       //! lock used to access local members
       mutex mut;      
     }; // end of class generator
@@ -356,6 +587,14 @@ namespace graphlab {
      */
     generator& get_source();
 
+    /**
+     * \ingroup random
+     * Get the lock free generator of the local generator
+     */
+    inline fast_generator& get_fast_source() {
+      return get_source().fast_source();
+    }
+
     /**
      * \ingroup random
      * Generate a random number in the uniform real with range [min,
@@ -364,7 +603,7 @@ namespace graphlab {
     template<typename NumType>
     inline NumType uniform(const NumType min, const NumType max) { 
       if (min == max) return min;
-      return get_source().uniform<NumType>(min, max);
+      return get_fast_source().uniform<NumType>(min, max);
     } // end of uniform
     
     /**
@@ -375,14 +614,23 @@ namespace graphlab {
     template<typename NumType>
     inline NumType fast_uniform(const NumType min, const NumType max) { 
       if (min == max) return min;
-      return get_source().fast_uniform<NumType>(min, max);
+      return get_fast_source().uniform<NumType>(min, max);
     } // end of fast_uniform
     
     /**
      * \ingroup random
      * Generate a random number between 0 and 1
      */
-    inline double rand01() { return uniform<double>(0, 1); }
+    inline double rand01() { return get_fast_source().uniform01(); }
+
+    /**
+     * \ingroup random
+     * Fill out[0 .. n) with random numbers between 0 and 1. This is
+     * faster than n calls to rand01() for large n.
+     */
+    inline void fill_uniform(double* out, const size_t n) {
+      get_fast_source().fill_uniform(out, n);
+    }
 
     /**
      * \ingroup random
@@ -396,7 +644,8 @@ namespace graphlab {
      * Generate a random number from a gamma distribution.
      */
     inline double gamma(const double alpha = double(1)) {
-      return get_source().gamma(alpha);
+      boost::gamma_distribution<double> gamma_dist(alpha);
+      return gamma_dist(get_fast_source());
     }
 
 
@@ -408,7 +657,8 @@ namespace graphlab {
      */
     inline double gaussian(const double mean = double(0), 
                            const double stdev = double(1)) {
-      return get_source().gaussian(mean, stdev);
+      boost::normal_distribution<double> normal_dist(mean, stdev);
+      return normal_dist(get_fast_source());
     }
 
     /**
@@ -418,7 +668,7 @@ namespace graphlab {
      */
     inline double normal(const double mean = double(0), 
                          const double stdev = double(1)) {
-      return get_source().normal(mean, stdev);
+      return gaussian(mean, stdev);
     }
 
     /**
@@ -426,7 +676,7 @@ namespace graphlab {
      * Draw a sample from a bernoulli distribution
      */
     inline bool bernoulli(const double p = double(0.5)) {
-      return get_source().bernoulli(p);
+      return get_fast_source().bernoulli(p);
     }
 
     /**
@@ -434,7 +684,7 @@ namespace graphlab {
      * Draw a sample form a bernoulli distribution using the faster generator
      */
     inline bool fast_bernoulli(const double p = double(0.5)) {
-      return get_source().fast_bernoulli(p);
+      return get_fast_source().bernoulli(p);
     }
 
     /**
@@ -444,7 +694,7 @@ namespace graphlab {
      */
     template<typename Double>
     inline size_t multinomial(const std::vector<Double>& prb) {
-      return get_source().multinomial(prb);
+      return get_fast_source().multinomial(prb);
     }
 
 
@@ -454,7 +704,7 @@ namespace graphlab {
      */
     template<typename Double>
     inline size_t multinomial_cdf(const std::vector<Double>& cdf) {
-      return get_source().multinomial_cdf(cdf);
+      return get_fast_source().multinomial_cdf(cdf);
     }
 
 
@@ -465,7 +715,10 @@ namespace graphlab {
      */ 
     template<typename T>
     inline std::vector<T> permutation(const size_t nelems) { 
-      return get_source().permutation<T>(nelems); 
+      std::vector<T> perm(nelems);
+      for(T i = 0; i < nelems; ++i) perm[i] = i;
+      get_fast_source().shuffle(perm.begin(), perm.end());
+      return perm;
     }
 
 
@@ -475,7 +728,7 @@ namespace graphlab {
      */ 
     template<typename T>
     inline void shuffle(std::vector<T>& vec) { 
-      get_source().shuffle(vec); 
+      get_fast_source().shuffle(vec.begin(), vec.end()); 
     }
    
     /** 
@@ -484,7 +737,7 @@ namespace graphlab {
      */ 
     template<typename Iterator>
     inline void shuffle(Iterator begin, Iterator end) {
-      get_source().shuffle(begin, end);
+      get_fast_source().shuffle(begin, end);
     }
 
     /**
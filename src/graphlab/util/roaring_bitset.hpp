@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_ROARING_BITSET_HPP
+#define GRAPHLAB_ROARING_BITSET_HPP
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <stdint.h>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+namespace graphlab {
+
+  /**  \ingroup util
+   * \brief A compressed set of 32 bit integers in the style of Roaring
+   * bitmaps.
+   *
+   * The integers are split by their high 16 bits into chunks of 65536
+   * values. Each non empty chunk is stored in a container holding the
+   * low 16 bits of its values, either as a sorted array while it has at
+   * most ARRAY_MAX_SIZE values, or as a bitmap of 65536 bits otherwise.
+   * The memory used is therefore about 2 bytes per value for sparse
+   * sets and at most 1 bit per value of the range for dense ones.
+   *
+   * Union, intersection and difference work container by container,
+   * merging arrays, probing arrays against bitmaps or combining bitmap
+   * words, and pick the representation of each resulting container
+   * from its cardinality.
+   *
+   * Values must be inserted through add(). Inserting in increasing
+   * order appends to the containers and takes constant time. The set
+   * is not thread safe.
+   */
+  class roaring_bitset {
+  public:
+    enum {
+      ARRAY_MAX_SIZE = 4096,
+      BITMAP_WORDS = 65536 / 64
+    };
+
+    roaring_bitset() : card(0) { }
+
+    /// Inserts x. Returns true if x was not in the set.
+    bool add(uint32_t x) {
+      const uint16_t key = uint16_t(x >> 16);
+      const uint16_t low = uint16_t(x & 0xFFFF);
+      size_t i;
+      if (!keys.empty() && keys.back() == key) {
+        i = keys.size() - 1;
+      } else {
+        i = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+        if (i == keys.size() || keys[i] != key) {
+          keys.insert(keys.begin() + i, key);
+          containers.insert(containers.begin() + i, container());
+        }
+      }
+      if (!containers[i].add(low)) return false;
+      ++card;
+      return true;
+    }
+
+    /// Returns true if x is in the set
+    bool contains(uint32_t x) const {
+      const uint16_t key = uint16_t(x >> 16);
+      std::vector<uint16_t>::const_iterator k =
+          std::lower_bound(keys.begin(), keys.end(), key);
+      if (k == keys.end() || *k != key) return false;
+      return containers[k - keys.begin()].contains(uint16_t(x & 0xFFFF));
+    }
+
+    /// Returns the number of values in the set
+    inline size_t size() const { return card; }
+
+    /// Returns true if the set is empty
+    inline bool empty() const { return card == 0; }
+
+    /// Removes all the values and frees the containers
+    void clear() {
+      std::vector<uint16_t>().swap(keys);
+      std::vector<container>().swap(containers);
+      card = 0;
+    }
+
+    /// Exchanges the contents of this set with the set other
+    void swap(roaring_bitset& other) {
+      keys.swap(other.keys);
+      containers.swap(other.containers);
+      std::swap(card, other.card);
+    }
+
+    /// Returns the number of bytes used by the containers
+    size_t estimate_sizeof() const {
+      size_t ret = sizeof(roaring_bitset) + keys.capacity() * sizeof(uint16_t)
+                   + containers.capacity() * sizeof(container);
+      for (size_t i = 0; i < containers.size(); ++i) {
+        ret += containers[i].array.capacity() * sizeof(uint16_t) +
+               containers[i].bitmap.capacity() * sizeof(uint64_t);
+      }
+      return ret;
+    }
+
+    /**
+     * Calls fn(x) for every value x in increasing order, and returns
+     * fn. Bitmap containers are walked a word at a time.
+     */
+    template <typename Fn>
+    Fn for_each(Fn fn) const {
+      for (size_t i = 0; i < keys.size(); ++i) {
+        const size_t base = size_t(keys[i]) << 16;
+        const container& c = containers[i];
+        if (c.is_bitmap()) {
+          for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+            uint64_t word = c.bitmap[w];
+            while (word) {
+              fn(base + w * 64 + size_t(__builtin_ctzll(word)));
+              word &= word - 1;
+            }
+          }
+        } else {
+          for (size_t j = 0; j < c.array.size(); ++j) fn(base + c.array[j]);
+        }
+      }
+      return fn;
+    }
+
+    bool operator==(const roaring_bitset& other) const {
+      if (card != other.card || keys != other.keys) return false;
+      for (size_t i = 0; i < containers.size(); ++i) {
+        if (!(containers[i] == other.containers[i])) return false;
+      }
+      return true;
+    }
+
+    bool operator!=(const roaring_bitset& other) const {
+      return !(*this == other);
+    }
+
+    roaring_bitset& operator|=(const roaring_bitset& other) {
+      roaring_bitset ret;
+      size_t i = 0, j = 0;
+      while (i < keys.size() || j < other.keys.size()) {
+        if (j == other.keys.size() ||
+            (i < keys.size() && keys[i] < other.keys[j])) {
+          ret.append(keys[i], containers[i]);
+          ++i;
+        } else if (i == keys.size() || other.keys[j] < keys[i]) {
+          ret.append(other.keys[j], other.containers[j]);
+          ++j;
+        } else {
+          container c;
+          container::combine_or(containers[i], other.containers[j], c);
+          ret.append(keys[i], c);
+          ++i; ++j;
+        }
+      }
+      swap(ret);
+      return *this;
+    }
+
+    roaring_bitset& operator&=(const roaring_bitset& other) {
+      roaring_bitset ret;
+      size_t i = 0, j = 0;
+      while (i < keys.size() && j < other.keys.size()) {
+        if (keys[i] < other.keys[j]) ++i;
+        else if (other.keys[j] < keys[i]) ++j;
+        else {
+          container c;
+          container::combine_and(containers[i], other.containers[j], c);
+          ret.append(keys[i], c);
+          ++i; ++j;
+        }
+      }
+      swap(ret);
+      return *this;
+    }
+
+    roaring_bitset& operator-=(const roaring_bitset& other) {
+      roaring_bitset ret;
+      size_t i = 0, j = 0;
+      while (i < keys.size()) {
+        while (j < other.keys.size() && other.keys[j] < keys[i]) ++j;
+        if (j < other.keys.size() && other.keys[j] == keys[i]) {
+          container c;
+          container::combine_andnot(containers[i], other.containers[j], c);
+          ret.append(keys[i], c);
+        } else {
+          ret.append(keys[i], containers[i]);
+        }
+        ++i;
+      }
+      swap(ret);
+      return *this;
+    }
+
+    roaring_bitset operator|(const roaring_bitset& other) const {
+      roaring_bitset ret(*this);
+      ret |= other;
+      return ret;
+    }
+
+    roaring_bitset operator&(const roaring_bitset& other) const {
+      roaring_bitset ret(*this);
+      ret &= other;
+      return ret;
+    }
+
+    roaring_bitset operator-(const roaring_bitset& other) const {
+      roaring_bitset ret(*this);
+      ret -= other;
+      return ret;
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << card << keys << containers;
+    }
+
+    void load(iarchive& iarc) {
+      iarc >> card >> keys >> containers;
+    }
+
+  private:
+    /// The low 16 bits of the values of one chunk
+    struct container {
+      /// the sorted values, if the container is an array
+      std::vector<uint16_t> array;
+      /// BITMAP_WORDS words, if the container is a bitmap
+      std::vector<uint64_t> bitmap;
+      /// the number of values
+      size_t card;
+
+      container() : card(0) { }
+
+      inline bool is_bitmap() const { return !bitmap.empty(); }
+
+      inline bool contains(uint16_t low) const {
+        if (is_bitmap()) return (bitmap[low >> 6] >> (low & 63)) & 1;
+        return std::binary_search(array.begin(), array.end(), low);
+      }
+
+      bool add(uint16_t low) {
+        if (is_bitmap()) {
+          const uint64_t mask = uint64_t(1) << (low & 63);
+          if (bitmap[low >> 6] & mask) return false;
+          bitmap[low >> 6] |= mask;
+        } else if (array.empty() || array.back() < low) {
+          array.push_back(low);
+        } else {
+          std::vector<uint16_t>::iterator pos =
+              std::lower_bound(array.begin(), array.end(), low);
+          if (*pos == low) return false;
+          array.insert(pos, low);
+        }
+        ++card;
+        if (!is_bitmap() && card > ARRAY_MAX_SIZE) to_bitmap();
+        return true;
+      }
+
+      void to_bitmap() {
+        bitmap.assign(BITMAP_WORDS, 0);
+        for (size_t i = 0; i < array.size(); ++i) {
+          bitmap[array[i] >> 6] |= uint64_t(1) << (array[i] & 63);
+        }
+        std::vector<uint16_t>().swap(array);
+      }
+
+      void to_array() {
+        array.clear();
+        array.reserve(card);
+        for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+          uint64_t word = bitmap[w];
+          while (word) {
+            array.push_back(uint16_t(w * 64 + __builtin_ctzll(word)));
+            word &= word - 1;
+          }
+        }
+        std::vector<uint64_t>().swap(bitmap);
+      }
+
+      /// Recounts a bitmap and turns it into an array if small enough
+      void bitmap_done() {
+        card = 0;
+        for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+          card += __builtin_popcountll(bitmap[w]);
+        }
+        if (card <= ARRAY_MAX_SIZE) to_array();
+      }
+
+      static void combine_or(const container& a, const container& b,
+                             container& out) {
+        if (!a.is_bitmap() && !b.is_bitmap()) {
+          out.array.reserve(a.array.size() + b.array.size());
+          std::set_union(a.array.begin(), a.array.end(),
+                         b.array.begin(), b.array.end(),
+                         std::back_inserter(out.array));
+          out.card = out.array.size();
+          if (out.card > ARRAY_MAX_SIZE) out.to_bitmap();
+          return;
+        }
+        const container& bm = a.is_bitmap() ? a : b;
+        const container& other = a.is_bitmap() ? b : a;
+        out.bitmap = bm.bitmap;
+        if (other.is_bitmap()) {
+          for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+            out.bitmap[w] |= other.bitmap[w];
+          }
+        } else {
+          for (size_t i = 0; i < other.array.size(); ++i) {
+            const uint16_t v = other.array[i];
+            out.bitmap[v >> 6] |= uint64_t(1) << (v & 63);
+          }
+        }
+        out.bitmap_done();
+      }
+
+      static void combine_and(const container& a, const container& b,
+                              container& out) {
+        if (a.is_bitmap() && b.is_bitmap()) {
+          out.bitmap.resize(BITMAP_WORDS);
+          for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+            out.bitmap[w] = a.bitmap[w] & b.bitmap[w];
+          }
+          out.bitmap_done();
+        } else if (!a.is_bitmap() && !b.is_bitmap()) {
+          std::set_intersection(a.array.begin(), a.array.end(),
+                                b.array.begin(), b.array.end(),
+                                std::back_inserter(out.array));
+          out.card = out.array.size();
+        } else {
+          // probe the values of the array in the bitmap
+          const container& bm = a.is_bitmap() ? a : b;
+          const container& arr = a.is_bitmap() ? b : a;
+          for (size_t i = 0; i < arr.array.size(); ++i) {
+            if (bm.contains(arr.array[i])) out.array.push_back(arr.array[i]);
+          }
+          out.card = out.array.size();
+        }
+      }
+
+      static void combine_andnot(const container& a, const container& b,
+                                 container& out) {
+        if (a.is_bitmap()) {
+          out.bitmap = a.bitmap;
+          if (b.is_bitmap()) {
+            for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+              out.bitmap[w] &= ~b.bitmap[w];
+            }
+          } else {
+            for (size_t i = 0; i < b.array.size(); ++i) {
+              const uint16_t v = b.array[i];
+              out.bitmap[v >> 6] &= ~(uint64_t(1) << (v & 63));
+            }
+          }
+          out.bitmap_done();
+        } else if (b.is_bitmap()) {
+          for (size_t i = 0; i < a.array.size(); ++i) {
+            if (!b.contains(a.array[i])) out.array.push_back(a.array[i]);
+          }
+          out.card = out.array.size();
+        } else {
+          std::set_difference(a.array.begin(), a.array.end(),
+                              b.array.begin(), b.array.end(),
+                              std::back_inserter(out.array));
+          out.card = out.array.size();
+        }
+      }
+
+      bool operator==(const container& other) const {
+        return card == other.card && array == other.array &&
+               bitmap == other.bitmap;
+      }
+
+      void save(oarchive& oarc) const {
+        oarc << card << array << bitmap;
+      }
+
+      void load(iarchive& iarc) {
+        iarc >> card >> array >> bitmap;
+      }
+    };
+
+    /// Appends the container c of the chunk key unless it is empty
+    void append(uint16_t key, const container& c) {
+      if (c.card == 0) return;
+      keys.push_back(key);
+      containers.push_back(c);
+      card += c.card;
+    }
+
+    /// the sorted high 16 bits of the chunks
+    std::vector<uint16_t> keys;
+    /// the container of each chunk in keys
+    std::vector<container> containers;
+    /// the number of values in the set
+    size_t card;
+  };
+
+} // namespace graphlab
+#endif
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_SOA_VECTOR_HPP
+#define GRAPHLAB_UTIL_SOA_VECTOR_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/preprocessor/seq/for_each_i.hpp>
+#include <boost/preprocessor/seq/elem.hpp>
+#include <boost/preprocessor/tuple/elem.hpp>
+#include <boost/preprocessor/punctuation/comma_if.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * \brief One element of a column of a soa_vector. Wrapping the field
+   * gives every column, including bool ones, addressable elements.
+   */
+  template <typename T>
+  struct soa_cell {
+    T value;
+  };
+
+  /**
+   * \ingroup util
+   * \brief Lists the fields of a type stored as a structure of arrays.
+   *
+   * The default does not store T as a structure of arrays. The
+   * specializations are written by GRAPHLAB_SOA_TRAITS.
+   */
+  template <typename T>
+  struct soa_traits {
+    enum { enabled = false };
+  };
+
+  /**
+   * \ingroup util
+   * \brief A vector of T holding every field of T in a separate array.
+   *
+   * T must be a default constructible aggregate whose fields are all
+   * listed by GRAPHLAB_SOA_TRAITS. Elements are accessed through
+   * proxies: operator[] returns a \ref soa_traits::reference "reference"
+   * with one reference member per field, so <code>v[i].field</code>
+   * reads and writes the field in its own array, and a loop over one
+   * field only touches that array. The proxies convert to T and can be
+   * assigned a T, but do not bind to a T&.
+   *
+   * \code
+   * struct dist_node { double dist; bool visited; };
+   * GRAPHLAB_SOA_TRAITS(dist_node, ((double, dist))((bool, visited)))
+   *
+   * graphlab::soa_vector<dist_node> v(10);
+   * v[3].dist = 1.5;
+   * dist_node n = v[3];
+   * \endcode
+   */
+  template <typename T>
+  class soa_vector {
+   public:
+    typedef T value_type;
+    typedef typename soa_traits<T>::columns columns_type;
+    typedef typename soa_traits<T>::reference reference;
+    typedef typename soa_traits<T>::const_reference const_reference;
+
+    soa_vector() : nelems(0) { }
+
+    explicit soa_vector(size_t n) : nelems(0) { resize(n); }
+
+    size_t size() const { return nelems; }
+
+    bool empty() const { return nelems == 0; }
+
+    size_t capacity() const { return cols.capacity(); }
+
+    void resize(size_t n) {
+      cols.resize(n);
+      nelems = n;
+    }
+
+    void reserve(size_t n) { cols.reserve(n); }
+
+    void clear() { resize(0); }
+
+    void swap(soa_vector& other) {
+      cols.swap(other.cols);
+      std::swap(nelems, other.nelems);
+    }
+
+    void push_back(const T& value) {
+      resize(nelems + 1);
+      (*this)[nelems - 1] = value;
+    }
+
+    reference operator[](size_t i) { return reference(cols, i); }
+
+    const_reference operator[](size_t i) const {
+      return const_reference(cols, i);
+    }
+
+    /// The arrays of the fields, as members named after the fields
+    columns_type& columns() { return cols; }
+
+    const columns_type& columns() const { return cols; }
+
+    /// Replaces the contents with the elements of vec
+    void assign(const std::vector<T>& vec) {
+      resize(vec.size());
+      for (size_t i = 0; i < vec.size(); ++i) (*this)[i] = vec[i];
+    }
+
+    /// Replaces the contents of vec with the elements
+    void copy_to(std::vector<T>& vec) const {
+      vec.resize(nelems);
+      for (size_t i = 0; i < nelems; ++i) vec[i] = (*this)[i];
+    }
+
+    /// The memory used by the arrays in bytes
+    size_t estimate_sizeof() const { return cols.estimate_sizeof(); }
+
+    void save(oarchive& arc) const {
+      arc << nelems;
+      cols.save(arc);
+    }
+
+    void load(iarchive& arc) {
+      size_t n;
+      arc >> n;
+      resize(n);
+      cols.load(arc);
+    }
+
+    /// Writes every array as a section of a graph snapshot
+    template <typename SnapshotWriter>
+    void save_snapshot(SnapshotWriter& writer) const {
+      cols.save_snapshot(writer);
+    }
+
+    template <typename SnapshotReader>
+    void load_snapshot(SnapshotReader& reader) {
+      cols.load_snapshot(reader);
+      nelems = cols.size();
+    }
+
+   private:
+    columns_type cols;
+    size_t nelems;
+  }; // end of soa_vector
+
+
+  /**
+   * \ingroup util
+   * \brief Selects the container of T: a std::vector, or a soa_vector
+   * when soa_traits<T> is specialized.
+   */
+  template <typename T, bool SoA = soa_traits<T>::enabled>
+  struct soa_storage {
+    typedef std::vector<T> type;
+    typedef T& reference;
+    typedef const T& const_reference;
+  };
+
+  template <typename T>
+  struct soa_storage<T, true> {
+    typedef soa_vector<T> type;
+    typedef typename soa_vector<T>::reference reference;
+    typedef typename soa_vector<T>::const_reference const_reference;
+  };
+
+  /**
+   * \ingroup util
+   * \brief Gives a T& to code which needs one, from a reference
+   * returned by a container selected by soa_storage. Built by
+   * make_soa_lvalue(): for a T& the element itself is used, and for a
+   * soa_vector proxy the element is copied and written back when the
+   * soa_lvalue is destroyed, e.g. at the end of the expression in
+   * <code>f(make_soa_lvalue(v[i]).get())</code>.
+   */
+  template <typename Reference>
+  class soa_lvalue {
+   public:
+    typedef typename Reference::value_type value_type;
+    explicit soa_lvalue(const Reference& ref) : ref(ref), value(ref) { }
+    ~soa_lvalue() { ref = value; }
+    value_type& get() const { return value; }
+   private:
+    Reference ref;
+    mutable value_type value;
+  };
+
+  template <typename T>
+  class soa_lvalue<T&> {
+   public:
+    explicit soa_lvalue(T& value) : ptr(&value) { }
+    T& get() const { return *ptr; }
+   private:
+    T* ptr;
+  };
+
+  template <typename T>
+  soa_lvalue<T&> make_soa_lvalue(T& value) {
+    return soa_lvalue<T&>(value);
+  }
+
+  template <typename Reference>
+  soa_lvalue<Reference> make_soa_lvalue(const Reference& ref) {
+    return soa_lvalue<Reference>(ref);
+  }
+
+  /**
+   * \ingroup util
+   * Exchanges the contents of a container selected by soa_storage with
+   * those of a std::vector.
+   */
+  template <typename T>
+  void swap_storage(std::vector<T>& storage, std::vector<T>& vec) {
+    storage.swap(vec);
+  }
+
+  template <typename T>
+  void swap_storage(soa_vector<T>& storage, std::vector<T>& vec) {
+    std::vector<T> old;
+    storage.copy_to(old);
+    storage.assign(vec);
+    vec.swap(old);
+  }
+
+  /**
+   * \ingroup util
+   * Appends the arrays of a container selected by soa_storage to out as
+   * (address of the first element, size of an element) pairs.
+   */
+  template <typename T>
+  void storage_arrays(std::vector<T>& storage,
+                      std::vector<std::pair<char*, size_t> >& out) {
+    if (!storage.empty()) {
+      out.push_back(std::make_pair((char*)&storage[0], sizeof(T)));
+    }
+  }
+
+  template <typename T>
+  void storage_arrays(soa_vector<T>& storage,
+                      std::vector<std::pair<char*, size_t> >& out) {
+    if (!storage.empty()) storage.columns().arrays(out);
+  }
+
+  /// Prefetches element i of a container selected by soa_storage
+  template <typename T>
+  inline void storage_prefetch(const std::vector<T>& storage, size_t i) {
+    __builtin_prefetch(&storage[i]);
+  }
+
+  template <typename T>
+  inline void storage_prefetch(const soa_vector<T>& storage, size_t i) {
+    storage.columns().prefetch(i);
+  }
+
+  /// Writes a container selected by soa_storage to a graph snapshot
+  template <typename SnapshotWriter, typename T>
+  void save_storage_snapshot(SnapshotWriter& writer,
+                             const std::vector<T>& storage) {
+    writer.write(storage);
+  }
+
+  template <typename SnapshotWriter, typename T>
+  void save_storage_snapshot(SnapshotWriter& writer,
+                             const soa_vector<T>& storage) {
+    storage.save_snapshot(writer);
+  }
+
+  /// Reads a container written by save_storage_snapshot()
+  template <typename SnapshotReader, typename T>
+  void load_storage_snapshot(SnapshotReader& reader,
+                             std::vector<T>& storage) {
+    reader.read(storage);
+  }
+
+  template <typename SnapshotReader, typename T>
+  void load_storage_snapshot(SnapshotReader& reader,
+                             soa_vector<T>& storage) {
+    storage.load_snapshot(reader);
+  }
+
+} // end of namespace graphlab
+
+
+/// \cond GRAPHLAB_INTERNAL
+#define GRAPHLAB_SOA_TYPE(field) BOOST_PP_TUPLE_ELEM(2, 0, field)
+#define GRAPHLAB_SOA_NAME(field) BOOST_PP_TUPLE_ELEM(2, 1, field)
+#define GRAPHLAB_SOA_COLUMN(r, data, field)                             \
+  std::vector< ::graphlab::soa_cell< GRAPHLAB_SOA_TYPE(field) > >       \
+      GRAPHLAB_SOA_NAME(field);
+#define GRAPHLAB_SOA_CALL(r, call, field) GRAPHLAB_SOA_NAME(field).call;
+#define GRAPHLAB_SOA_PASS(r, fn, field) fn(GRAPHLAB_SOA_NAME(field));
+#define GRAPHLAB_SOA_SWAP(r, other, field)                              \
+  GRAPHLAB_SOA_NAME(field).swap(other.GRAPHLAB_SOA_NAME(field));
+#define GRAPHLAB_SOA_BYTES(r, data, field)                              \
+  + GRAPHLAB_SOA_NAME(field).capacity() *                               \
+    sizeof(::graphlab::soa_cell< GRAPHLAB_SOA_TYPE(field) >)
+#define GRAPHLAB_SOA_ARRAY(r, out, field)                               \
+  out.push_back(std::make_pair((char*)&GRAPHLAB_SOA_NAME(field)[0],     \
+      sizeof(::graphlab::soa_cell< GRAPHLAB_SOA_TYPE(field) >)));
+#define GRAPHLAB_SOA_PREFETCH(r, idx, field)                            \
+  __builtin_prefetch(&GRAPHLAB_SOA_NAME(field)[idx]);
+#define GRAPHLAB_SOA_SAVE(r, arc, field)                                \
+  for (size_t i = 0; i < GRAPHLAB_SOA_NAME(field).size(); ++i)          \
+    arc << GRAPHLAB_SOA_NAME(field)[i].value;
+#define GRAPHLAB_SOA_LOAD(r, arc, field)                                \
+  for (size_t i = 0; i < GRAPHLAB_SOA_NAME(field).size(); ++i)          \
+    arc >> GRAPHLAB_SOA_NAME(field)[i].value;
+#define GRAPHLAB_SOA_REF(r, data, field)                                \
+  GRAPHLAB_SOA_TYPE(field)& GRAPHLAB_SOA_NAME(field);
+#define GRAPHLAB_SOA_CONST_REF(r, data, field)                          \
+  const GRAPHLAB_SOA_TYPE(field)& GRAPHLAB_SOA_NAME(field);
+#define GRAPHLAB_SOA_INIT_FROM_COLUMNS(r, data, i, field)               \
+  BOOST_PP_COMMA_IF(i)                                                  \
+  GRAPHLAB_SOA_NAME(field)(cols.GRAPHLAB_SOA_NAME(field)[idx].value)
+#define GRAPHLAB_SOA_INIT_FROM(r, src, i, field)                        \
+  BOOST_PP_COMMA_IF(i) GRAPHLAB_SOA_NAME(field)(src.GRAPHLAB_SOA_NAME(field))
+#define GRAPHLAB_SOA_COPY(r, dst_src, field)                            \
+  BOOST_PP_TUPLE_ELEM(2, 0, dst_src).GRAPHLAB_SOA_NAME(field) =         \
+      BOOST_PP_TUPLE_ELEM(2, 1, dst_src).GRAPHLAB_SOA_NAME(field);
+/// \endcond
+
+/**
+ * \ingroup util
+ * \brief Stores TYPE as a structure of arrays in containers selected by
+ * graphlab::soa_storage, such as the vertex and edge data of the
+ * local_graph.
+ *
+ * FIELDS lists every field of TYPE as a sequence of (type, name)
+ * pairs, e.g. <code>((double, dist))((bool, visited))</code>. Fields
+ * which are not listed are not stored. Must be used outside of any
+ * namespace, with TYPE fully qualified.
+ */
+#define GRAPHLAB_SOA_TRAITS(TYPE, FIELDS)                               \
+  namespace graphlab {                                                  \
+  template <>                                                           \
+  struct soa_traits< TYPE > {                                           \
+    enum { enabled = true };                                            \
+    typedef TYPE value_type;                                            \
+    struct columns {                                                    \
+      BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_COLUMN, _, FIELDS)             \
+      size_t size() const {                                             \
+        return GRAPHLAB_SOA_NAME(BOOST_PP_SEQ_ELEM(0, FIELDS)).size();  \
+      }                                                                 \
+      size_t capacity() const {                                         \
+        return GRAPHLAB_SOA_NAME(BOOST_PP_SEQ_ELEM(0, FIELDS)).capacity(); \
+      }                                                                 \
+      void resize(size_t n) {                                           \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_CALL, resize(n), FIELDS)     \
+      }                                                                 \
+      void reserve(size_t n) {                                          \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_CALL, reserve(n), FIELDS)    \
+      }                                                                 \
+      void swap(columns& other) {                                       \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_SWAP, other, FIELDS)         \
+      }                                                                 \
+      size_t estimate_sizeof() const {                                  \
+        return 0 BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_BYTES, _, FIELDS);  \
+      }                                                                 \
+      void prefetch(size_t idx) const {                                 \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_PREFETCH, idx, FIELDS)       \
+      }                                                                 \
+      void arrays(std::vector<std::pair<char*, size_t> >& out) {        \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_ARRAY, out, FIELDS)          \
+      }                                                                 \
+      void save(::graphlab::oarchive& arc) const {                      \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_SAVE, arc, FIELDS)           \
+      }                                                                 \
+      void load(::graphlab::iarchive& arc) {                            \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_LOAD, arc, FIELDS)           \
+      }                                                                 \
+      template <typename SnapshotWriter>                                \
+      void save_snapshot(SnapshotWriter& writer) const {                \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_PASS, writer.write, FIELDS)  \
+      }                                                                 \
+      template <typename SnapshotReader>                                \
+      void load_snapshot(SnapshotReader& reader) {                      \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_PASS, reader.read, FIELDS)   \
+      }                                                                 \
+    };                                                                  \
+    struct reference {                                                  \
+      typedef TYPE value_type;                                          \
+      BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_REF, _, FIELDS)                \
+      reference(columns& cols, size_t idx) :                            \
+        BOOST_PP_SEQ_FOR_EACH_I(GRAPHLAB_SOA_INIT_FROM_COLUMNS, _, FIELDS) { } \
+      operator value_type() const {                                     \
+        value_type value;                                               \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_COPY, (value, (*this)), FIELDS) \
+        return value;                                                   \
+      }                                                                 \
+      const reference& operator=(const value_type& value) const {       \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_COPY, ((*this), value), FIELDS) \
+        return *this;                                                   \
+      }                                                                 \
+      const reference& operator=(const reference& other) const {        \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_COPY, ((*this), other), FIELDS) \
+        return *this;                                                   \
+      }                                                                 \
+      template <typename OArchive>                                      \
+      void save(OArchive& arc) const {                                  \
+        arc << value_type(*this);                                       \
+      }                                                                 \
+    };                                                                  \
+    struct const_reference {                                            \
+      BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_CONST_REF, _, FIELDS)          \
+      const_reference(const columns& cols, size_t idx) :                \
+        BOOST_PP_SEQ_FOR_EACH_I(GRAPHLAB_SOA_INIT_FROM_COLUMNS, _, FIELDS) { } \
+      const_reference(const reference& ref) :                           \
+        BOOST_PP_SEQ_FOR_EACH_I(GRAPHLAB_SOA_INIT_FROM, ref, FIELDS) { } \
+      operator value_type() const {                                     \
+        value_type value;                                               \
+        BOOST_PP_SEQ_FOR_EACH(GRAPHLAB_SOA_COPY, (value, (*this)), FIELDS) \
+        return value;                                                   \
+      }                                                                 \
+      template <typename OArchive>                                      \
+      void save(OArchive& arc) const {                                  \
+        arc << value_type(*this);                                       \
+      }                                                                 \
+    };                                                                  \
+  };                                                                    \
+  }
+
+#endif
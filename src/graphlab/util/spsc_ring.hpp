@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_SPSC_RING_HPP
+#define GRAPHLAB_UTIL_SPSC_RING_HPP
+
+#include <vector>
+#include <stdint.h>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * \brief A bounded lock free queue between exactly one producer
+   * thread and one consumer thread.
+   *
+   * The head and tail only ever grow. Each side keeps a private copy of
+   * the position of the other side and only reads the shared one when
+   * its copy says the ring is full (or empty), so in the steady state
+   * the two threads only exchange the cache lines of the values.
+   * Neither try_push() nor try_pop() blocks, and no atomic instruction
+   * is used. As in shm_ring, the memory ordering relies on x86 not
+   * reordering stores with other stores, or loads with other loads.
+   */
+  template <typename T>
+  class spsc_ring {
+  public:
+    typedef T value_type;
+
+    /// Creates a ring of capacity values, rounded up to a power of 2
+    explicit spsc_ring(size_t capacity = 1024) {
+      size_t cap = 2;
+      while (cap < capacity) cap *= 2;
+      mask = cap - 1;
+      buffer.resize(cap);
+      tail = 0; head_cache = 0;
+      head = 0; tail_cache = 0;
+    }
+
+    /// Pushes value, or returns false if the ring is full. Producer only.
+    inline bool try_push(const T& value) {
+      const size_t t = tail;
+      if (t - head_cache > mask) {
+        head_cache = head;
+        if (t - head_cache > mask) return false;
+      }
+      buffer[t & mask] = value;
+      asm volatile ("" : : : "memory");
+      tail = t + 1;
+      return true;
+    }
+
+    /// Pops the oldest value, or returns false if the ring is empty.
+    /// Consumer only.
+    inline bool try_pop(T& value) {
+      const size_t h = head;
+      if (h == tail_cache) {
+        tail_cache = tail;
+        if (h == tail_cache) return false;
+      }
+      asm volatile ("" : : : "memory");
+      value = buffer[h & mask];
+      asm volatile ("" : : : "memory");
+      head = h + 1;
+      return true;
+    }
+
+    /// The number of values in the ring, exact on either side
+    inline size_t approx_size() const { return tail - head; }
+
+    inline bool empty() const { return tail == head; }
+
+    inline size_t capacity() const { return mask + 1; }
+
+  private:
+    std::vector<T> buffer;
+    size_t mask;
+    char pad0[64];
+    // written by the producer
+    volatile size_t tail;
+    size_t head_cache;
+    char pad1[64];
+    // written by the consumer
+    volatile size_t head;
+    size_t tail_cache;
+    char pad2[64];
+
+    // not copyable
+    spsc_ring(const spsc_ring&);
+    spsc_ring& operator=(const spsc_ring&);
+  }; // end of spsc_ring
+
+} // end of namespace graphlab
+
+#endif
@@ -27,6 +27,8 @@
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/rpc/distributed_event_log.hpp>
 
 
 namespace graphlab {
@@ -67,5 +69,150 @@ trace_count::~trace_count() {
 #endif
 }
 
+
+
+
+unsigned long long trace_histogram_snapshot::percentile(double p) const {
+  if (count == 0) return 0;
+  // the rank of the event, counting from 1
+  unsigned long long rank = (unsigned long long)(p * count + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > count) rank = count;
+  unsigned long long seen = 0;
+  for (size_t i = 0; i < TRACE_HISTOGRAM_BUCKETS; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return std::max(minimum, std::min(maximum, bucket_upper_bound(i)));
+    }
+  }
+  return maximum;
+}
+
+void trace_histogram_snapshot::print(std::ostream& out,
+                                     unsigned long long tpersec) const {
+  const double scale = tpersec == 0 ? 1.0 : (double)tpersec / 1000;
+  const char* units = tpersec == 0 ? " ticks \n" : " ms \n";
+  out << "Events:\t" << count << "\n";
+  out << "Total:\t" << (double)total / scale << units;
+  if (count > 0) {
+    out << "Mean:\t" << mean() / scale << units;
+    out << "Min:\t" << (double)minimum / scale << units;
+    out << "p50:\t" << (double)percentile(0.5) / scale << units;
+    out << "p90:\t" << (double)percentile(0.9) / scale << units;
+    out << "p99:\t" << (double)percentile(0.99) / scale << units;
+    out << "p99.9:\t" << (double)percentile(0.999) / scale << units;
+    out << "Max:\t" << (double)maximum / scale << units;
+  }
+}
+
+
+trace_histogram::trace_histogram(std::string name,
+                                 std::string description,
+                                 bool print_on_destruct):
+    name(name), description(description),
+    print_on_destruct(print_on_destruct), in_event_log(false) {
+  init_key();
+}
+
+trace_histogram::trace_histogram(const trace_histogram& other):
+    name(other.name), description(other.description),
+    print_on_destruct(other.print_on_destruct), in_event_log(false) {
+  init_key();
+}
+
+trace_histogram& trace_histogram::operator=(const trace_histogram& other) {
+  name = other.name;
+  description = other.description;
+  print_on_destruct = other.print_on_destruct;
+  return *this;
+}
+
+void trace_histogram::init_key() {
+  int error = pthread_key_create(&key, trace_histogram::retire_local);
+  ASSERT_TRUE(!error);
+}
+
+trace_histogram::thread_local_type* trace_histogram::create_local() {
+  thread_local_type* entry = new thread_local_type;
+  entry->owner = this;
+  pthread_setspecific(key, entry);
+  lock.lock();
+  thread_local_hist.push_back(entry);
+  lock.unlock();
+  return entry;
+}
+
+void trace_histogram::retire_local(void* ptr) {
+  thread_local_type* entry = static_cast<thread_local_type*>(ptr);
+  trace_histogram* owner = entry->owner;
+  owner->lock.lock();
+  owner->retired += entry->hist;
+  for (size_t i = 0; i < owner->thread_local_hist.size(); ++i) {
+    if (owner->thread_local_hist[i] == entry) {
+      owner->thread_local_hist[i] = owner->thread_local_hist.back();
+      owner->thread_local_hist.pop_back();
+      break;
+    }
+  }
+  owner->lock.unlock();
+  delete entry;
+}
+
+trace_histogram_snapshot trace_histogram::snapshot() const {
+  lock.lock();
+  trace_histogram_snapshot ret = retired;
+  for (size_t i = 0; i < thread_local_hist.size(); ++i) {
+    ret += thread_local_hist[i]->hist;
+  }
+  lock.unlock();
+  return ret;
+}
+
+double trace_histogram::percentile_ms(double p) const {
+  const trace_histogram_snapshot s = snapshot();
+  const double value = p >= 1.0 ? (double)s.maximum : (double)s.percentile(p);
+  return value * 1000 / estimate_ticks_per_second();
+}
+
+void trace_histogram::add_to_event_log() {
+  if (in_event_log) return;
+  const double p[3] = {0.5, 0.99, 1.0};
+  const char* suffix[3] = {" p50", " p99", " max"};
+  for (size_t i = 0; i < 3; ++i) {
+    event_log_entries[i] = get_event_log().create_callback_entry(
+        name + suffix[i], "ms",
+        boost::bind(&trace_histogram::percentile_ms, this, p[i]),
+        log_type::INSTANTANEOUS);
+  }
+  in_event_log = true;
+}
+
+void trace_histogram::print(std::ostream& out,
+                            unsigned long long tpersec) const {
+  out << name << ": " << description << "\n";
+  snapshot().print(out, tpersec);
+}
+
+trace_histogram::~trace_histogram() {
+#ifdef USE_TRACEPOINT
+  if (print_on_destruct) {
+    printlock.lock();
+    print(std::cout, estimate_ticks_per_second());
+    std::cout.flush();
+    printlock.unlock();
+  }
+#endif
+  if (in_event_log) {
+    for (size_t i = 0; i < 3; ++i) {
+      get_event_log().free_callback_entry(event_log_entries[i]);
+    }
+  }
+  // threads which exit from now on must not retire into this tracer
+  pthread_key_delete(key);
+  for (size_t i = 0; i < thread_local_hist.size(); ++i) {
+    delete thread_local_hist[i];
+  }
+}
+
 } // namespace graphlab
 
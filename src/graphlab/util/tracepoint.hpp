@@ -23,13 +23,19 @@
 
 #ifndef GRAPHLAB_UTIL_TRACEPOINT_HPP
 #define GRAPHLAB_UTIL_TRACEPOINT_HPP
+#include <pthread.h>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <limits>
+#include <algorithm>
 #include <graphlab/util/timer.hpp>
 #include <graphlab/util/branch_hints.hpp>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/parallel/mutex.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
 
 namespace graphlab{
 
@@ -116,14 +122,232 @@ struct trace_count{
   void print(std::ostream& out, unsigned long long tpersec = 0) const;
 };
 
+
+
+/**
+ * The number of linear sub-buckets in each power of two of a
+ * trace_histogram_snapshot. Values are recorded with a relative
+ * error of at most 1 / TRACE_HISTOGRAM_SUB_BUCKETS.
+ */
+const size_t TRACE_HISTOGRAM_SUB_BUCKETS = 16;
+const size_t TRACE_HISTOGRAM_SUB_BITS = 4;
+const size_t TRACE_HISTOGRAM_BUCKETS =
+    TRACE_HISTOGRAM_SUB_BUCKETS * (64 - TRACE_HISTOGRAM_SUB_BITS + 1);
+
+
+/**
+ * A histogram of event times with log-linear buckets, in the style of
+ * HDR histograms: values below TRACE_HISTOGRAM_SUB_BUCKETS have a
+ * bucket each, and every further power of two is split into
+ * TRACE_HISTOGRAM_SUB_BUCKETS equal buckets. It is not thread safe;
+ * the trace_histogram keeps one per thread and merges them on demand.
+ */
+struct trace_histogram_snapshot {
+  std::vector<unsigned long long> counts;
+  unsigned long long count;
+  unsigned long long total;
+  unsigned long long minimum;
+  unsigned long long maximum;
+
+  trace_histogram_snapshot() { clear(); }
+
+  void clear() {
+    counts.assign(TRACE_HISTOGRAM_BUCKETS, 0);
+    count = 0;
+    total = 0;
+    minimum = std::numeric_limits<unsigned long long>::max();
+    maximum = 0;
+  }
+
+  /// The bucket holding the value val
+  static inline size_t bucket_of(unsigned long long val) {
+    if (val < TRACE_HISTOGRAM_SUB_BUCKETS) return val;
+    const size_t msb = 63 - __builtin_clzll(val);
+    const size_t shift = msb - TRACE_HISTOGRAM_SUB_BITS;
+    return TRACE_HISTOGRAM_SUB_BUCKETS * (shift + 1) +
+        ((val >> shift) & (TRACE_HISTOGRAM_SUB_BUCKETS - 1));
+  }
+
+  /// The largest value held by bucket b
+  static unsigned long long bucket_upper_bound(size_t b) {
+    if (b < TRACE_HISTOGRAM_SUB_BUCKETS) return b;
+    const size_t shift = b / TRACE_HISTOGRAM_SUB_BUCKETS - 1;
+    const unsigned long long sub = b % TRACE_HISTOGRAM_SUB_BUCKETS;
+    const unsigned long long lower =
+        (TRACE_HISTOGRAM_SUB_BUCKETS + sub) << shift;
+    return lower + ((1ULL << shift) - 1);
+  }
+
+  /// Adds an event time
+  inline void incorporate(unsigned long long val) __attribute__((always_inline)) {
+    ++counts[bucket_of(val)];
+    ++count;
+    total += val;
+    if (val < minimum) minimum = val;
+    if (val > maximum) maximum = val;
+  }
+
+  /// Merges a second histogram into this one
+  trace_histogram_snapshot& operator+=(const trace_histogram_snapshot& other) {
+    for (size_t i = 0; i < TRACE_HISTOGRAM_BUCKETS; ++i) {
+      counts[i] += other.counts[i];
+    }
+    count += other.count;
+    total += other.total;
+    minimum = std::min(minimum, other.minimum);
+    maximum = std::max(maximum, other.maximum);
+    return *this;
+  }
+
+  /**
+   * The value below which a fraction p (in [0, 1]) of the events lie,
+   * rounded up to the end of its bucket and clamped to the maximum.
+   * Returns 0 if there are no events.
+   */
+  unsigned long long percentile(double p) const;
+
+  double mean() const {
+    return count == 0 ? 0.0 : (double)total / count;
+  }
+
+  /**
+   * Prints the counts and the common percentiles, in ticks or, if
+   * tpersec is not 0, in milliseconds.
+   */
+  void print(std::ostream& out, unsigned long long tpersec = 0) const;
+
+  void save(oarchive& oarc) const {
+    oarc << counts << count << total << minimum << maximum;
+  }
+
+  void load(iarchive& iarc) {
+    iarc >> counts >> count >> total >> minimum >> maximum;
+  }
+};
+
+
+/**
+ * A tracer which keeps the full distribution of its event times so
+ * that tail latencies can be read off, not only the mean. Every thread
+ * records into a private trace_histogram_snapshot, so incorporate()
+ * takes no lock and issues no atomic instruction; the per-thread
+ * histograms are only merged when snapshot() is called. The counts of
+ * a thread which exits are folded into the tracer. Each tracer holds a
+ * pthread key, so at most PTHREAD_KEYS_MAX of them can exist at once.
+ *
+ * The tracer can also publish its median, 99th percentile and maximum
+ * through the distributed event log, and cluster_snapshot() merges the
+ * histograms of all machines.
+ */
+class trace_histogram {
+ public:
+  std::string name;
+  std::string description;
+  bool print_on_destruct;
+
+  trace_histogram(std::string name = "",
+                  std::string description = "",
+                  bool print_on_destruct = true);
+
+  /// Copies only the name and description, not the events
+  trace_histogram(const trace_histogram& other);
+
+  trace_histogram& operator=(const trace_histogram& other);
+
+  /**
+   * Destructor. Will print to cout if initialize() is called
+   * with "true" as the 3rd argument
+   */
+  ~trace_histogram();
+
+  /**
+   * Initializes the tracer with a name, a description
+   * and whether to print on destruction
+   */
+  void initialize(std::string n, std::string desc, bool print_out = true) {
+    name = n;
+    description = desc;
+    print_on_destruct = print_out;
+  }
+
+  /**
+   * Adds an event time to the trace
+   */
+  inline void incorporate(unsigned long long val) __attribute__((always_inline)) {
+    void* v = pthread_getspecific(key);
+    if (__unlikely__(v == NULL)) v = create_local();
+    static_cast<thread_local_type*>(v)->hist.incorporate(val);
+  }
+
+  /**
+   * Adds the total of an accumulating tracer as a single event
+   */
+  inline void incorporate(const trace_count& val) {
+    if (val.count.value > 0) incorporate(val.total.value);
+  }
+
+  /**
+   * Merges the per-thread histograms. Events recorded concurrently
+   * with the call may or may not be included.
+   */
+  trace_histogram_snapshot snapshot() const;
+
+  /**
+   * Merges the histograms of all machines. Must be called by all
+   * machines simultaneously with a distributed object of the same type.
+   */
+  template <typename RMIType>
+  trace_histogram_snapshot cluster_snapshot(RMIType& rmi) const {
+    trace_histogram_snapshot ret = snapshot();
+    rmi.all_reduce(ret);
+    return ret;
+  }
+
+  /**
+   * Adds the median, the 99th percentile and the maximum of the local
+   * events, in milliseconds, as instantaneous entries of the
+   * distributed event log, so the event log collects them from every
+   * machine. Like the creation of any event log entry, this must be
+   * called by all machines simultaneously, and only the first call
+   * has an effect.
+   */
+  void add_to_event_log();
+
+  /**
+   * Prints the tracer counts
+   */
+  void print(std::ostream& out, unsigned long long tpersec = 0) const;
+
+ private:
+  struct thread_local_type {
+    trace_histogram* owner;
+    trace_histogram_snapshot hist;
+  };
+
+  pthread_key_t key;
+  mutable mutex lock;
+  /// The histograms of the live threads
+  std::vector<thread_local_type*> thread_local_hist;
+  /// The events of the threads which have exited
+  trace_histogram_snapshot retired;
+
+  bool in_event_log;
+  size_t event_log_entries[3];
+
+  void init_key();
+  thread_local_type* create_local();
+  double percentile_ms(double p) const;
+  static void retire_local(void* ptr);
+};
+
 } // namespace
 
 /**
  * DECLARE_TRACER(name)
  * creates a tracing object with a given name. This creates a variable
- * called "name" which is of type trace_count. and is equivalent to:
+ * called "name" which is of type trace_histogram. and is equivalent to:
  *
- * graphlab::trace_count name;
+ * graphlab::trace_histogram name;
  * 
  * The primary reason to use this macro instead of just writing
  * the code above directly, is that the macro is ignored and compiles
@@ -141,6 +365,11 @@ struct trace_count{
  * This initializes the tracer "name" with a description, and
  * configures the tracer to NOT print when the tracer "name" is destroyed.
  *
+ * DISTRIBUTE_TRACER(name)
+ * The object with name "name" created by DECLARE_TRACER must be in scope.
+ * Publishes the tail latencies of the tracer through the distributed
+ * event log. Must be called by all machines simultaneously.
+ *
  * BEGIN_TRACEPOINT(name)
  * END_TRACEPOINT(name)
  * The object with name "name" created by DECLARE_TRACER must be in scope.
@@ -161,10 +390,11 @@ Example Usage:
 
 
 #ifdef USE_TRACEPOINT
-#define DECLARE_TRACER(name) graphlab::trace_count name;
+#define DECLARE_TRACER(name) graphlab::trace_histogram name;
 
 #define INITIALIZE_TRACER(name, description) name.initialize(#name, description);
 #define INITIALIZE_TRACER_NO_PRINT(name, description) name.initialize(#name, description, false);
+#define DISTRIBUTE_TRACER(name) name.add_to_event_log();
 
 #define BEGIN_TRACEPOINT(name) unsigned long long __ ## name ## _trace_ = rdtsc();
 #define END_TRACEPOINT(name) name.incorporate(rdtsc() - __ ## name ## _trace_);
@@ -184,6 +414,7 @@ Example Usage:
 #define DECLARE_TRACER(name)
 #define INITIALIZE_TRACER(name, description)
 #define INITIALIZE_TRACER_NO_PRINT(name, description) 
+#define DISTRIBUTE_TRACER(name)
 
 #define BEGIN_TRACEPOINT(name) 
 #define END_TRACEPOINT(name) 
@@ -26,6 +26,7 @@
 #ifndef GRAPHLAB_IVERTEX_PROGRAM_HPP
 #define GRAPHLAB_IVERTEX_PROGRAM_HPP
 
+#include <limits>
 
 #include <graphlab/vertex_program/icontext.hpp>
 #include <graphlab/util/empty.hpp>
@@ -438,6 +439,19 @@ namespace graphlab {
     BOOST_CONCEPT_ASSERT((graphlab::OpPlusEq<MessageType>));
     /// \endcond
 
+    /**
+     * \brief The type used to send changes of the vertex data to the
+     * mirrors (see \ref make_vertex_delta).
+     *
+     * By default the delta is the vertex data itself.  A vertex program
+     * which changes only a small part of a large vertex data can
+     * define its own serializable, default constructible
+     * vertex_delta_type together with make_vertex_delta and
+     * apply_vertex_delta.  Deltas are only used by the synchronous
+     * engine when the \c delta_sync_interval engine option is set.
+     */
+    typedef typename Graph::vertex_data_type vertex_delta_type;
+
 
     // Graph specific type members ============================================
     /**
@@ -473,6 +487,14 @@ namespace graphlab {
      */
     typedef typename graph_type::edge_type edge_type;
 
+    /**
+     * \brief A read only view of the local in or out edges of a
+     * vertex passed to \ref gather_batch.
+     *
+     * See \ref distributed_graph::local_edge_span_type for details.
+     */
+    typedef typename graph_type::local_edge_span_type local_edge_span_type;
+
     /**
      * \brief The type used to define the direction of edges used in
      * gather and scatter.
@@ -621,6 +643,33 @@ namespace graphlab {
       return gather_type();
     };
 
+    /**
+     * \brief Optionally computes the gather over all the local edges of
+     * one direction at once.
+     *
+     * The synchronous engine calls gather_batch with the local in edges
+     * and then with the local out edges (as selected by gather_edges)
+     * instead of calling gather once per edge.  The edges are read
+     * directly from the local graph storage which, for arithmetic
+     * gather types, allows a tight reduction loop the compiler can
+     * vectorize.  Empty spans are skipped.
+     *
+     * Unlike gather, the edge data is read only.  The engine resolves
+     * this function statically: a vertex program opts in by defining
+     * a function of the same name and signature.
+     *
+     * \param [out] accum the sum of the gathers over the edges
+     *
+     * \return false if the vertex program does not implement batch
+     * gathers in which case gather is called for every edge.  The
+     * default implementation returns false.
+     */
+    bool gather_batch(icontext_type& context, const vertex_type& vertex,
+                      const local_edge_span_type& edges,
+                      gather_type& accum) const {
+      return false;
+    }
+
 
     /**
      * \brief The apply function is called once the gather phase has
@@ -764,7 +813,133 @@ namespace graphlab {
     virtual void post_local_gather(gather_type&) const {
     }
 
+
+    /**
+     * \brief Computes the change made to the vertex data by apply.
+     *
+     * Called on the master after apply with the vertex data before
+     * and after the apply.  Returns false if the full vertex data
+     * should be sent to the mirrors instead.  The synchronous engine
+     * resolves this function statically: a vertex program overrides it
+     * by defining a function of the same name taking its own
+     * vertex_delta_type.
+     *
+     * The default implementation returns false.
+     */
+    bool make_vertex_delta(const vertex_data_type& old_data,
+                           const vertex_data_type& new_data,
+                           vertex_delta_type& delta) const {
+      return false;
+    }
+
+    /**
+     * \brief Applies a delta produced by make_vertex_delta to the
+     * vertex data of a mirror.
+     *
+     * The mirror holds the vertex data as of the last synchronization
+     * so this must not depend on the state of the vertex program.
+     */
+    void apply_vertex_delta(vertex_data_type& data,
+                            const vertex_delta_type& delta) const {
+      data = delta;
+    }
+
+    /**
+     * \brief Measures the change made to the vertex data by apply.
+     *
+     * Called on the master after apply when the \c sync_tolerance
+     * option of the synchronous engine is set.  Changes whose distances
+     * add up to less than the tolerance are not sent to the mirrors.
+     * The engine resolves this function statically like
+     * make_vertex_delta.
+     *
+     * The default implementation returns infinity, so that every change
+     * is sent.
+     */
+    double vertex_data_distance(const vertex_data_type& old_data,
+                                const vertex_data_type& new_data) const {
+      return std::numeric_limits<double>::infinity();
+    }
+
   };  // end of ivertex_program
+
+
+  /**
+   * \brief is_stateless_vertex_program<VertexProgram>::value is true if
+   * the vertex program declares no data members of its own, so that
+   * every instance behaves like a default constructed one.
+   *
+   * Engines need not store nor synchronize the vertex programs of such
+   * types. The detection compares the size of the vertex program with
+   * the size of its ivertex_program interface; it may be specialized
+   * to override it for a given type.
+   */
+  template<typename VertexProgram>
+  struct is_stateless_vertex_program {
+    typedef ivertex_program<typename VertexProgram::graph_type,
+                            typename VertexProgram::gather_type,
+                            typename VertexProgram::message_type> base_type;
+    static const bool value = sizeof(VertexProgram) == sizeof(base_type);
+  };
+
+
+  /**
+   * \brief static_edge_directions<VertexProgram> declares the edges a
+   * vertex program always gathers and scatters on.
+   *
+   * By default the directions are dynamic and the engines call
+   * gather_edges and scatter_edges for every vertex. A vertex program
+   * whose gather_edges or scatter_edges always returns the same
+   * direction may specialize this trait, so that the engines use the
+   * constant instead and the compiler drops the edge loops the program
+   * never runs:
+   *
+   * \code
+   * namespace graphlab {
+   *   template<> struct static_edge_directions<pagerank> {
+   *     static const bool gather_is_static = true;
+   *     static const edge_dir_type gather = IN_EDGES;
+   *     static const bool scatter_is_static = true;
+   *     static const edge_dir_type scatter = OUT_EDGES;
+   *   };
+   * }
+   * \endcode
+   */
+  template<typename VertexProgram>
+  struct static_edge_directions {
+    static const bool gather_is_static = false;
+    static const edge_dir_type gather = ALL_EDGES;
+    static const bool scatter_is_static = false;
+    static const edge_dir_type scatter = ALL_EDGES;
+  };
+
+  /**
+   * Returns the gather direction of vprog on vertex, resolved at compile
+   * time when static_edge_directions declares it.
+   */
+  template<typename VertexProgram>
+  inline edge_dir_type
+  resolve_gather_edges(const VertexProgram& vprog,
+                       typename VertexProgram::icontext_type& context,
+                       const typename VertexProgram::vertex_type& vertex) {
+    typedef static_edge_directions<VertexProgram> directions;
+    return directions::gather_is_static ?
+        directions::gather : vprog.gather_edges(context, vertex);
+  }
+
+  /**
+   * Returns the scatter direction of vprog on vertex, resolved at
+   * compile time when static_edge_directions declares it.
+   */
+  template<typename VertexProgram>
+  inline edge_dir_type
+  resolve_scatter_edges(const VertexProgram& vprog,
+                        typename VertexProgram::icontext_type& context,
+                        const typename VertexProgram::vertex_type& vertex) {
+    typedef static_edge_directions<VertexProgram> directions;
+    return directions::scatter_is_static ?
+        directions::scatter : vprog.scatter_edges(context, vertex);
+  }
  
 }; //end of namespace graphlab
 #include <graphlab/macros_undef.hpp>
@@ -2,4 +2,6 @@
 #include <graphlab/engine/warp_graph_broadcast.hpp>
 #include <graphlab/engine/warp_graph_mapreduce.hpp>
 #include <graphlab/engine/warp_graph_transform.hpp>
+#include <graphlab/engine/warp_neighborhood_cache.hpp>
 #include <graphlab/engine/warp_parfor_all_vertices.hpp>
+#include <graphlab/engine/warp_request_batcher.hpp>
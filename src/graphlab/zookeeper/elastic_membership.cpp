@@ -0,0 +1,165 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <graphlab/zookeeper/elastic_membership.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab{
+namespace zookeeper {
+
+elastic_membership::elastic_membership(std::vector<std::string> zkhosts,
+                                       std::string prefix,
+                                       std::string _serveridentifier,
+                                       size_t numnodes) :
+    serveridentifier(_serveridentifier), numnodes(numnodes),
+    myrank(-1), mygeneration(0),
+    changed(false), joined(false), failed(false) {
+  kv = new key_value(zkhosts, prefix, serveridentifier);
+  kv->add_callback(boost::bind(&elastic_membership::key_changed, this,
+                               _1, _2, _3, _4));
+}
+
+elastic_membership::~elastic_membership() {
+  set_failure_callback(NULL);
+  // closing the session deletes the keys owned by this process
+  delete kv;
+}
+
+std::string elastic_membership::make_key(size_t generation, size_t rank) {
+  char buf[64];
+  sprintf(buf, "g%lu_r%lu", (unsigned long)generation, (unsigned long)rank);
+  return buf;
+}
+
+bool elastic_membership::parse_key(const std::string& key,
+                                   size_t& generation, size_t& rank) {
+  unsigned long g, r;
+  if (sscanf(key.c_str(), "g%lu_r%lu", &g, &r) != 2) return false;
+  generation = g; rank = r;
+  return true;
+}
+
+size_t elastic_membership::claim(size_t generation, size_t preferred_rank) {
+  if (preferred_rank < numnodes &&
+      kv->insert(make_key(generation, preferred_rank), serveridentifier)) {
+    return preferred_rank;
+  }
+  for (size_t i = 0; i < numnodes; ++i) {
+    if (kv->insert(make_key(generation, i), serveridentifier)) return i;
+  }
+  return size_t(-1);
+}
+
+void elastic_membership::join(size_t preferred_rank, size_t min_generation) {
+  size_t generation = min_generation;
+  size_t rank = size_t(-1);
+  while(1) {
+    // move to the latest generation
+    std::vector<std::string> keys = kv->get_all_keys();
+    size_t latest = generation;
+    std::vector<bool> claimed(numnodes, false);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      size_t g, r;
+      if (!parse_key(keys[i], g, r)) continue;
+      latest = std::max(latest, g);
+      if (g == generation && r < numnodes) claimed[r] = true;
+    }
+    if (latest > generation) {
+      if (rank != size_t(-1)) kv->erase(make_key(generation, rank));
+      logstream(LOG_INFO) << "Moving to generation " << latest << std::endl;
+      generation = latest;
+      rank = size_t(-1);
+      continue;
+    }
+    if (rank == size_t(-1)) {
+      rank = claim(generation, preferred_rank);
+      if (rank != size_t(-1)) {
+        logstream(LOG_INFO) << "Claimed rank " << rank << " of generation "
+                            << generation << std::endl;
+        claimed[rank] = true;
+      }
+    }
+    if (rank != size_t(-1) &&
+        std::count(claimed.begin(), claimed.end(), true) == int(numnodes)) {
+      break;
+    }
+    // wait for the keys to change
+    lock.lock();
+    if (!changed) cond.timedwait(lock, 1);
+    changed = false;
+    lock.unlock();
+  }
+  // read the addresses. The values are written right after the keys
+  std::vector<std::string> result(numnodes);
+  for (size_t i = 0; i < numnodes; ++i) {
+    std::pair<bool, std::string> value = kv->get(make_key(generation, i));
+    while (!value.first || value.second.empty()) {
+      timer::sleep_ms(10);
+      value = kv->get(make_key(generation, i));
+    }
+    result[i] = value.second;
+  }
+  lock.lock();
+  myrank = rank;
+  mygeneration = generation;
+  addresses = result;
+  joined = true;
+  lock.unlock();
+}
+
+void elastic_membership::set_failure_callback(failure_callback_type fn) {
+  lock.lock();
+  on_failure = fn;
+  lock.unlock();
+}
+
+void elastic_membership::key_changed(key_value* unused,
+                                     const std::vector<std::string>& newkeys,
+                                     const std::vector<std::string>& deletedkeys,
+                                     const std::vector<std::string>& modifiedkeys) {
+  size_t lost_rank = size_t(-1);
+  failure_callback_type fn;
+  lock.lock();
+  changed = true;
+  cond.signal();
+  if (joined && !failed && on_failure != NULL) {
+    for (size_t i = 0; i < deletedkeys.size(); ++i) {
+      size_t g, r;
+      if (parse_key(deletedkeys[i], g, r) && g == mygeneration && r != myrank) {
+        lost_rank = r;
+        failed = true;
+        fn = on_failure;
+        break;
+      }
+    }
+  }
+  lock.unlock();
+  if (lost_rank != size_t(-1)) fn(lost_rank);
+}
+
+} // namespace zookeeper
+} // namespace graphlab
@@ -0,0 +1,121 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_ZOOKEEPER_ELASTIC_MEMBERSHIP_HPP
+#define GRAPHLAB_ZOOKEEPER_ELASTIC_MEMBERSHIP_HPP
+
+#include <vector>
+#include <string>
+#include <boost/function.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/zookeeper/key_value.hpp>
+
+namespace graphlab{
+namespace zookeeper {
+
+/**
+ *  Stable ranks and failure detection for a job of a fixed number of
+ *  processes.
+ *
+ *  Every process claims a rank by owning the key "g[generation]_r[rank]"
+ *  of a key_value store, with its address as the value. The keys are
+ *  owned by the zookeeper session, so the key of a process disappears
+ *  when it dies. Once all the ranks of a generation are claimed, the
+ *  members know the address of every rank and a failure is detected
+ *  when a key of their generation is deleted.
+ *
+ *  After a failure the surviving processes join the next generation,
+ *  asking for the rank they had, and the replacement processes take
+ *  the ranks which are left. A process which is waiting to join always
+ *  moves to the latest generation it sees, so replacements started
+ *  before or after the survivors restart end up in the same generation.
+ */
+class elastic_membership {
+ public:
+  typedef boost::function<void(size_t lost_rank)> failure_callback_type;
+
+  ///  Connects to zookeeper. The keys are created in the prefix "prefix".
+  ///  The current process is identified by its address "serveridentifier".
+  elastic_membership(std::vector<std::string> zkhosts,
+                     std::string prefix,
+                     std::string serveridentifier,
+                     size_t numnodes);
+
+  /// Leaves the job, releasing the rank
+  ~elastic_membership();
+
+  /**
+   * Blocks until all the ranks of a generation, at least
+   * min_generation, are claimed. The preferred rank is claimed if it is
+   * free. Use size_t(-1) to take any free rank.
+   */
+  void join(size_t preferred_rank, size_t min_generation);
+
+  /// The rank of this process. Only valid after join()
+  size_t rank() const { return myrank; }
+
+  /// The generation joined. Only valid after join()
+  size_t generation() const { return mygeneration; }
+
+  /// The address of every rank. Only valid after join()
+  const std::vector<std::string>& machines() const { return addresses; }
+
+  /**
+   * Sets the function called when a member of the joined generation
+   * is lost. It is called at most once, possibly in a zookeeper thread,
+   * and must not destroy this object. Calling this function with a
+   * NULL argument disables the failure detection.
+   */
+  void set_failure_callback(failure_callback_type fn);
+
+ private:
+  key_value* kv;
+  std::string serveridentifier;
+  size_t numnodes;
+  size_t myrank;
+  size_t mygeneration;
+  std::vector<std::string> addresses;
+
+  mutex lock;
+  conditional cond;
+  bool changed;
+  bool joined;
+  bool failed;
+  failure_callback_type on_failure;
+
+  static std::string make_key(size_t generation, size_t rank);
+  static bool parse_key(const std::string& key, size_t& generation,
+                        size_t& rank);
+
+  /// Tries to claim a rank of the generation. Returns size_t(-1) on failure
+  size_t claim(size_t generation, size_t preferred_rank);
+
+  void key_changed(key_value* unused,
+                   const std::vector<std::string>& newkeys,
+                   const std::vector<std::string>& deletedkeys,
+                   const std::vector<std::string>& modifiedkeys);
+};
+
+} // namespace zookeeper
+} // namespace graphlab
+#endif
@@ -269,6 +269,19 @@ std::pair<bool, std::string> key_value::get(const std::string& key) {
 }
 
 
+std::vector<std::string> key_value::get_all_keys() {
+  std::vector<std::string> ret;
+  datalock.lock();
+  std::map<std::string, lazy_value>::const_iterator iter = data.begin();
+  while (iter != data.end()) {
+    ret.push_back(iter->first);
+    ++iter;
+  }
+  datalock.unlock();
+  return ret;
+}
+
+
 void key_value::fill_data_locked(const std::vector<std::string>& keys,
                                  const std::vector<std::string>& masterkeys,
                                  std::vector<std::string>& out_newkeys,
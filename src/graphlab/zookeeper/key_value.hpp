@@ -95,6 +95,9 @@ class key_value {
   /// Gets a value of a key. First element of the pair is if the key was found
   std::pair<bool, std::string> get(const std::string& key);
 
+  /// Gets the names of all the keys currently in the key value store
+  std::vector<std::string> get_all_keys();
+
 
   typedef boost::function<void(key_value*,
                                const std::vector<std::string>& out_newkeys,
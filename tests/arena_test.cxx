@@ -0,0 +1,97 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <string>
+
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/util/arena.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+using namespace graphlab;
+
+class test_arena : public CxxTest::TestSuite {
+public:
+
+  void test_alignment_and_reuse() {
+    arena a(1024);
+    for (size_t i = 1; i < 200; ++i) {
+      void* ptr = a.allocate(i, 64);
+      ASSERT_EQ((uintptr_t)ptr % 64, 0);
+      memset(ptr, 0xAB, i);
+    }
+    const size_t used = a.used_bytes();
+    ASSERT_GE(used, 199 * 200 / 2);
+    ASSERT_GE(a.reserved_bytes(), used);
+    a.reset();
+    ASSERT_EQ(a.used_bytes(), 0);
+    // the blocks were merged, so the same allocations fit in one block
+    const size_t reserved = a.reserved_bytes();
+    for (size_t i = 1; i < 200; ++i) a.allocate(i, 64);
+    ASSERT_EQ(a.reserved_bytes(), reserved);
+    // larger than a block
+    char* big = (char*)a.allocate(1 << 20);
+    big[(1 << 20) - 1] = 1;
+  }
+
+  void test_thread_arena_epochs() {
+    arena& first = thread_arena();
+    typedef arena_vector<int>::type vector_type;
+    vector_type* v = new vector_type;
+    for (int i = 0; i < 1000; ++i) v->push_back(i);
+    ASSERT_GT(first.used_bytes(), 1000 * sizeof(int));
+    // objects of the last epoch are still valid
+    reset_thread_arenas();
+    arena& second = thread_arena();
+    ASSERT_NE(&first, &second);
+    arena_string s("some temporary string, longer than a short string");
+    for (int i = 0; i < 1000; ++i) ASSERT_EQ((*v)[i], i);
+    delete v;
+    reset_thread_arenas();
+    ASSERT_EQ(&thread_arena(), &first);
+    ASSERT_EQ(first.used_bytes(), 0);
+    ASSERT_GT(second.used_bytes(), 0);
+  }
+
+  void test_serialization() {
+    arena_vector<double>::type v;
+    for (size_t i = 0; i < 100; ++i) v.push_back(i * 0.5);
+    std::vector<arena_vector<int>::type> vv(3);
+    vv[1].push_back(7);
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << v << vv;
+    strm.flush();
+    iarchive iarc(strm);
+    std::vector<double> w;
+    std::vector<arena_vector<int>::type> ww;
+    iarc >> w >> ww;
+    ASSERT_EQ(w.size(), 100);
+    for (size_t i = 0; i < 100; ++i) ASSERT_EQ(w[i], i * 0.5);
+    ASSERT_EQ(ww.size(), 3);
+    ASSERT_EQ(ww[1].size(), 1);
+    ASSERT_EQ(ww[1][0], 7);
+  }
+};
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/bounded_topk.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <algorithm>
+#include <functional>
+#include <sstream>
+using namespace graphlab;
+
+
+class BoundedTopkTestSuite : public CxxTest::TestSuite {
+public:
+  void test_insert(void) {
+    bounded_topk<int> top(3);
+    TS_ASSERT(top.empty());
+    for (int i = 0; i < 100; ++i) top.insert((i * 37) % 100);
+    std::vector<int> values = top.sorted();
+    TS_ASSERT_EQUALS(values.size(), 3);
+    TS_ASSERT_EQUALS(values[0], 99);
+    TS_ASSERT_EQUALS(values[1], 98);
+    TS_ASSERT_EQUALS(values[2], 97);
+    TS_ASSERT_EQUALS(top.smallest(), 97);
+    bounded_topk<int, std::greater<int> > bottom(2);
+    for (int i = 0; i < 100; ++i) bottom.insert((i * 37) % 100);
+    TS_ASSERT_EQUALS(bottom.sorted()[0], 0);
+    TS_ASSERT_EQUALS(bottom.sorted()[1], 1);
+  }
+
+  void test_merge(void) {
+    // a reduction: the default constructed total takes the k of the parts
+    std::vector<int> all;
+    bounded_topk<int> total;
+    for (size_t part = 0; part < 10; ++part) {
+      bounded_topk<int> top(5);
+      for (size_t i = 0; i < 50; ++i) {
+        const int value = random::fast_uniform<int>(0, 1000000);
+        all.push_back(value);
+        top.insert(value);
+      }
+      total += top;
+    }
+    std::sort(all.begin(), all.end(), std::greater<int>());
+    all.resize(5);
+    TS_ASSERT_EQUALS(total.capacity(), 5);
+    TS_ASSERT(total.sorted() == all);
+  }
+
+  void test_serialize(void) {
+    bounded_topk<double> top(4);
+    for (size_t i = 0; i < 10; ++i) top.insert(i);
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << top;
+    strm.flush();
+    iarchive iarc(strm);
+    bounded_topk<double> loaded;
+    iarc >> loaded;
+    TS_ASSERT_EQUALS(loaded.capacity(), 4);
+    TS_ASSERT(loaded.sorted() == top.sorted());
+  }
+};
@@ -0,0 +1,91 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#include <vector>
+#include <string>
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/rpc/collective_tree.hpp>
+
+using graphlab::procid_t;
+
+class collective_tree_test : public CxxTest::TestSuite {
+ public:
+  // checks that the parent and children relations agree, and that every
+  // machine is reachable from machine 0
+  void check_tree(const std::vector<std::string>& hosts, size_t branch) {
+    std::vector<procid_t> parents(hosts.size());
+    std::vector<std::vector<procid_t> > children(hosts.size());
+    for (size_t i = 0; i < hosts.size(); ++i) {
+      graphlab::dc_impl::build_collective_tree(hosts, procid_t(i), branch,
+                                               parents[i], children[i]);
+    }
+    TS_ASSERT_EQUALS(parents[0], 0);
+    size_t reached = 1;
+    std::vector<procid_t> stack(1, 0);
+    while (!stack.empty()) {
+      procid_t p = stack.back(); stack.pop_back();
+      for (size_t j = 0; j < children[p].size(); ++j) {
+        TS_ASSERT_EQUALS(parents[children[p][j]], p);
+        stack.push_back(children[p][j]);
+        ++reached;
+      }
+    }
+    TS_ASSERT_EQUALS(reached, hosts.size());
+  }
+
+  void test_distinct_hosts() {
+    // one machine per host gives the plain heap
+    std::vector<std::string> hosts;
+    for (size_t i = 0; i < 10; ++i) hosts.push_back(std::string(1, 'a' + i));
+    procid_t parent;
+    std::vector<procid_t> children;
+    graphlab::dc_impl::build_collective_tree(hosts, 1, 3, parent, children);
+    TS_ASSERT_EQUALS(parent, 0);
+    TS_ASSERT_EQUALS(children.size(), 3);
+    TS_ASSERT_EQUALS(children[0], 4);
+    TS_ASSERT_EQUALS(children[2], 6);
+    graphlab::dc_impl::build_collective_tree(hosts, 9, 3, parent, children);
+    TS_ASSERT_EQUALS(parent, 2);
+    TS_ASSERT(children.empty());
+    check_tree(hosts, 3);
+  }
+
+  void test_shared_hosts() {
+    // machines interleaved over three hosts
+    std::vector<std::string> hosts;
+    for (size_t i = 0; i < 12; ++i) hosts.push_back(std::string(1, 'a' + i % 3));
+    procid_t parent;
+    std::vector<procid_t> children;
+    graphlab::dc_impl::build_collective_tree(hosts, 0, 2, parent, children);
+    TS_ASSERT_EQUALS(parent, 0);
+    // 3, 6, 9 on the same host, then the leaders 1 and 2
+    TS_ASSERT_EQUALS(children.size(), 5);
+    TS_ASSERT_EQUALS(children[0], 3);
+    TS_ASSERT_EQUALS(children[3], 1);
+    TS_ASSERT_EQUALS(children[4], 2);
+    graphlab::dc_impl::build_collective_tree(hosts, 7, 2, parent, children);
+    TS_ASSERT_EQUALS(parent, 1);
+    TS_ASSERT(children.empty());
+    check_tree(hosts, 2);
+    check_tree(std::vector<std::string>(5, "localhost"), 128);
+  }
+};
@@ -0,0 +1,124 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#include <iostream>
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/util/generics/compressed_csr_storage.hpp>
+#include <graphlab/util/generics/counting_sort.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+class compressed_csr_storage_test : public CxxTest::TestSuite {  
+ public:
+  typedef uint32_t valuetype;
+  typedef size_t sizetype;
+  typedef graphlab::compressed_csr_storage<valuetype, sizetype> storage_type;
+
+  // keys 0..4, with values sorted within each key
+  void build_input(std::vector<sizetype>& prefix,
+                   std::vector<valuetype>& values,
+                   std::vector<sizetype>& ids) {
+    sizetype prefix_arr[] = {0, 3, 3, 5, 6};
+    valuetype value_arr[] = {1, 2, 400000, 7, 7, 0, 3, 300, 1u << 31};
+    sizetype id_arr[] = {4, 8, 100, 0, 1, 2, 3, 5, 1000000};
+    prefix.assign(prefix_arr, prefix_arr + 5);
+    values.assign(value_arr, value_arr + 9);
+    ids.assign(id_arr, id_arr + 9);
+  }
+
+  void check(const storage_type& storage,
+             const std::vector<sizetype>& prefix,
+             const std::vector<valuetype>& values,
+             const std::vector<sizetype>* ids) {
+    TS_ASSERT_EQUALS(storage.num_keys(), prefix.size());
+    TS_ASSERT_EQUALS(storage.num_values(), values.size());
+    for (size_t i = 0; i < prefix.size(); ++i) {
+      size_t end = i + 1 < prefix.size() ? prefix[i + 1] : values.size();
+      TS_ASSERT_EQUALS(storage.num_values(i), end - prefix[i]);
+      TS_ASSERT_EQUALS(storage.begin(i).distance_to(storage.end(i)),
+                       ptrdiff_t(end - prefix[i]));
+      size_t j = prefix[i];
+      for (storage_type::const_iterator it = storage.begin(i);
+           it != storage.end(i); ++it, ++j) {
+        TS_ASSERT_EQUALS((*it).first, values[j]);
+        TS_ASSERT_EQUALS((*it).second, ids ? (*ids)[j] : j);
+      }
+      TS_ASSERT_EQUALS(j, end);
+    }
+    TS_ASSERT_EQUALS(storage.num_values(prefix.size()), 0);
+    TS_ASSERT(storage.begin(prefix.size()) == storage.end(prefix.size()));
+  }
+
+  void test_implicit_ids() {
+    std::vector<sizetype> prefix, ids;
+    std::vector<valuetype> values;
+    build_input(prefix, values, ids);
+    storage_type storage;
+    storage.build(prefix, values);
+    check(storage, prefix, values, NULL);
+    printf("+ Pass test: compressed_csr_storage implicit ids :)\n\n");
+  }
+
+  void test_explicit_ids() {
+    std::vector<sizetype> prefix, ids;
+    std::vector<valuetype> values;
+    build_input(prefix, values, ids);
+    storage_type storage;
+    storage.build(prefix, values, &ids);
+    check(storage, prefix, values, &ids);
+    printf("+ Pass test: compressed_csr_storage explicit ids :)\n\n");
+  }
+
+  void test_serialize() {
+    std::vector<sizetype> prefix, ids;
+    std::vector<valuetype> values;
+    build_input(prefix, values, ids);
+    storage_type storage;
+    storage.build(prefix, values, &ids);
+
+    std::stringstream strm;
+    graphlab::oarchive oarc(strm);
+    oarc << storage;
+    strm.flush();
+    graphlab::iarchive iarc(strm);
+    storage_type storage2;
+    iarc >> storage2;
+    check(storage2, prefix, values, &ids);
+    printf("+ Pass test: compressed_csr_storage serialize :)\n\n");
+  }
+
+  void test_counting_sort_input() {
+    std::vector<size_t> keys(1000);
+    for (size_t i = 0; i < keys.size(); ++i) keys[i] = (i * 7919) % 37;
+    std::vector<sizetype> permute, prefix;
+    graphlab::counting_sort(keys, permute, &prefix);
+    std::vector<valuetype> values(keys.size());
+    for (size_t i = 0; i < prefix.size(); ++i) {
+      size_t end = i + 1 < prefix.size() ? prefix[i + 1] : keys.size();
+      for (size_t j = prefix[i]; j < end; ++j) values[j] = j * 3;
+    }
+    storage_type storage;
+    storage.build(prefix, values);
+    check(storage, prefix, values, NULL);
+    printf("+ Pass test: compressed_csr_storage from counting_sort :)\n\n");
+  }
+};
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/concurrent_bloom_filter.hpp>
+using namespace graphlab;
+
+class ConcurrentBloomFilterTestSuite : public CxxTest::TestSuite {
+public:
+  void test_insert(void) {
+    const size_t n = 100000;
+    concurrent_bloom_filter filter(n);
+    TS_ASSERT_EQUALS(filter.num_probes(), 7);
+    size_t false_positives = 0;
+    for (size_t i = 0; i < n; ++i) {
+      false_positives += filter.insert(concurrent_bloom_filter::pair_key(i, i + 1));
+    }
+    // about 1% with 10 bits per key
+    TS_ASSERT(false_positives < n / 50);
+    // every inserted key is reported, and the order of the ends matters
+    size_t reversed = 0;
+    for (size_t i = 0; i < n; ++i) {
+      TS_ASSERT(filter.may_contain(concurrent_bloom_filter::pair_key(i, i + 1)));
+      TS_ASSERT(filter.insert(concurrent_bloom_filter::pair_key(i, i + 1)));
+      reversed += filter.may_contain(concurrent_bloom_filter::pair_key(i + 1, i));
+    }
+    TS_ASSERT(reversed < n / 20);
+    filter.clear();
+    TS_ASSERT(!filter.may_contain(concurrent_bloom_filter::pair_key(0, 1)));
+  }
+};
@@ -21,6 +21,7 @@
  */
 
 
+#include <vector>
 #include <cxxtest/TestSuite.h>
 #include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/macros_def.hpp>
@@ -158,5 +159,63 @@ public:
   }
 
 
+  struct collect_bits {
+    std::vector<size_t>* out;
+    collect_bits(std::vector<size_t>* out) : out(out) { }
+    void operator()(size_t b) const { out->push_back(b); }
+  };
+
+  void test_word_parallel(void) {
+    dense_bitset a(300), b(300);
+    for (size_t i = 0; i < 300; i += 3) a.set_bit(i);
+    for (size_t i = 0; i < 300; i += 5) b.set_bit(i);
+
+    // the visitor agrees with the iterators, also on a range
+    std::vector<size_t> visited, expected;
+    a.for_each_set_bit(collect_bits(&visited));
+    foreach(size_t i, a) expected.push_back(i);
+    TS_ASSERT(visited == expected);
+    visited.clear();
+    a.for_each_set_bit(61, 190, collect_bits(&visited));
+    expected.clear();
+    for (size_t i = 63; i < 190; i += 3) expected.push_back(i);
+    TS_ASSERT(visited == expected);
+    TS_ASSERT_EQUALS(a.popcount(61, 190), expected.size());
+    TS_ASSERT_EQUALS(a.popcount(10, 10), 0);
+    TS_ASSERT_EQUALS(a.parallel_popcount(), a.popcount());
+
+    size_t word = a.containing_word(0);
+    size_t n = 0;
+    while (word) {
+      TS_ASSERT_EQUALS(dense_bitset::pop_first_bit(word), 3 * n);
+      ++n;
+    }
+    TS_ASSERT_EQUALS(n, 22);
+
+    // bulk operations
+    dense_bitset band = a & b, bor = a | b, bdiff = a - b;
+    for (size_t i = 0; i < 300; ++i) {
+      TS_ASSERT_EQUALS(band.get(i), i % 15 == 0);
+      TS_ASSERT_EQUALS(bor.get(i), i % 3 == 0 || i % 5 == 0);
+      TS_ASSERT_EQUALS(bdiff.get(i), i % 3 == 0 && i % 5 != 0);
+    }
+    dense_bitset c = a;
+    c -= b;
+    for (size_t i = 0; i < 300; ++i) TS_ASSERT_EQUALS(c.get(i), bdiff.get(i));
+
+    // range fill and clear
+    c.clear();
+    c.fill(70, 250);
+    TS_ASSERT_EQUALS(c.popcount(), 180);
+    c.clear(64, 128);
+    TS_ASSERT_EQUALS(c.popcount(), 122);
+    TS_ASSERT(!c.get(127) && c.get(128) && c.get(249) && !c.get(250));
+    c.fill(0, 1000);
+    TS_ASSERT_EQUALS(c.popcount(), 300);
+    c.parallel_clear();
+    TS_ASSERT(c.empty());
+    c.parallel_fill();
+    TS_ASSERT_EQUALS(c.popcount(), 300);
+  }
 };
 
@@ -0,0 +1,103 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#include <iostream>
+#include <algorithm>
+#include <unistd.h>
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/graph/ingress/edge_spill.hpp>
+#include <graphlab/util/generics/counting_sort.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+struct test_record {
+  graphlab::vertex_id_type source, target;
+  double edata;
+  test_record(graphlab::vertex_id_type source = 0,
+              graphlab::vertex_id_type target = 0, double edata = 0) :
+    source(source), target(target), edata(edata) { }
+  void load(graphlab::iarchive& arc) { arc >> source >> target >> edata; }
+  void save(graphlab::oarchive& arc) const { arc << source << target << edata; }
+};
+
+struct record_collector {
+  std::vector<test_record> records;
+  void operator()(const test_record& rec) { records.push_back(rec); }
+};
+
+class edge_spill_test : public CxxTest::TestSuite {  
+ public:
+  void test_merge() {
+    graphlab::edge_spill<test_record> spill;
+    spill.set_prefix("edge_spill_test_" + graphlab::tostr(getpid()) + "_");
+    std::vector<test_record> expected;
+    for (size_t run = 0; run < 4; ++run) {
+      std::vector<test_record> records;
+      for (size_t i = 0; i < 100; ++i) {
+        const graphlab::vertex_id_type src = (i * 37 + run * 11) % 50;
+        const graphlab::vertex_id_type dst = run * 100 + i;
+        records.push_back(test_record(src, dst, src + 0.5));
+        expected.push_back(records.back());
+      }
+      spill.write_run(records);
+      TS_ASSERT(records.empty());
+    }
+    TS_ASSERT_EQUALS(spill.num_runs(), 4);
+    TS_ASSERT_EQUALS(spill.num_records(), 400);
+
+    record_collector all;
+    spill.for_each(all);
+    TS_ASSERT_EQUALS(all.records.size(), 400);
+
+    record_collector merged;
+    spill.merge(merged);
+    TS_ASSERT_EQUALS(merged.records.size(), 400);
+    for (size_t i = 1; i < merged.records.size(); ++i) {
+      const test_record& a = merged.records[i - 1];
+      const test_record& b = merged.records[i];
+      TS_ASSERT(a.source < b.source ||
+                (a.source == b.source && a.target < b.target));
+    }
+    for (size_t i = 0; i < merged.records.size(); ++i) {
+      TS_ASSERT_EQUALS(merged.records[i].edata,
+                       merged.records[i].source + 0.5);
+    }
+    spill.clear();
+    TS_ASSERT_EQUALS(spill.num_runs(), 0);
+  }
+
+  void test_prefix_of_sorted() {
+    std::vector<size_t> prefix;
+    size_t unsorted_arr[] = {0, 2, 1};
+    std::vector<size_t> unsorted(unsorted_arr, unsorted_arr + 3);
+    TS_ASSERT(!graphlab::prefix_of_sorted(unsorted, prefix));
+
+    size_t sorted_arr[] = {0, 0, 2, 2, 2, 5};
+    std::vector<size_t> sorted(sorted_arr, sorted_arr + 6);
+    std::vector<size_t> permute, expected;
+    graphlab::counting_sort(sorted, permute, &expected);
+    TS_ASSERT(graphlab::prefix_of_sorted(sorted, prefix));
+    TS_ASSERT_EQUALS(prefix.size(), expected.size());
+    for (size_t i = 0; i < prefix.size(); ++i) {
+      TS_ASSERT_EQUALS(prefix[i], expected[i]);
+    }
+  }
+};
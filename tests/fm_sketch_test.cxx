@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/fm_sketch.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <sstream>
+using namespace graphlab;
+
+
+class FMSketchTestSuite : public CxxTest::TestSuite {
+public:
+  typedef fm_sketch<64> sketch_type;
+
+  // inserts an element with a geometric bit in every mask
+  void insert(sketch_type& sketch) {
+    for (size_t i = 0; i < sketch_type::NUM_MASKS; ++i) {
+      size_t bit = 0;
+      while (random::fast_uniform<double>(0, 1) < 0.5) ++bit;
+      sketch.set(i, bit);
+    }
+  }
+
+  void test_bits(void) {
+    fm_sketch<3> sketch;
+    TS_ASSERT_EQUALS(sketch.lowest_zero(0), 0);
+    sketch.set(0, 0);
+    sketch.set(0, 1);
+    sketch.set(0, 3);
+    sketch.set(2, 100);
+    TS_ASSERT_EQUALS(sketch.mask(0), 11);
+    TS_ASSERT_EQUALS(sketch.lowest_zero(0), 2);
+    TS_ASSERT_EQUALS(sketch.mask(2), uint64_t(1) << 63);
+    fm_sketch<3> other;
+    other.set(0, 2);
+    other.set(1, 0);
+    sketch |= other;
+    TS_ASSERT_EQUALS(sketch.lowest_zero(0), 4);
+    TS_ASSERT_EQUALS(sketch.lowest_zero(1), 1);
+    TS_ASSERT_EQUALS(sketch.mask(2), uint64_t(1) << 63);
+  }
+
+  void test_estimate(void) {
+    random::seed(10);
+    sketch_type a, b;
+    for (size_t i = 0; i < 5000; ++i) insert(a);
+    for (size_t i = 0; i < 5000; ++i) insert(b);
+    TS_ASSERT_DELTA(a.estimate(), 5000, 1500);
+    a |= b;
+    TS_ASSERT_DELTA(a.estimate(), 10000, 3000);
+  }
+
+  void test_serialize(void) {
+    random::seed(10);
+    sketch_type a, b;
+    for (size_t i = 0; i < 100; ++i) insert(a);
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << a;
+    iarchive iarc(strm);
+    iarc >> b;
+    TS_ASSERT(a == b);
+  }
+};
@@ -0,0 +1,77 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <map>
+#include <cstdlib>
+
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/util/frozen_hash_map.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+using namespace graphlab;
+
+class test_frozen_hash_map : public CxxTest::TestSuite {
+public:
+
+  void test_find() {
+    typedef frozen_hash_map<uint32_t, uint32_t> map_type;
+    for (size_t n = 0; n < 2000; n = n * 2 + 1) {
+      std::map<uint32_t, uint32_t> stdmap;
+      while (stdmap.size() < n) stdmap[rand()] = rand();
+      map_type map;
+      map.build(stdmap.begin(), stdmap.end(), stdmap.size());
+      ASSERT_EQ(map.size(), n);
+      typedef std::map<uint32_t, uint32_t>::const_iterator iterator;
+      for (iterator it = stdmap.begin(); it != stdmap.end(); ++it) {
+        uint32_t value = 0;
+        ASSERT_TRUE(map.find(it->first, value));
+        ASSERT_EQ(value, it->second);
+      }
+      for (size_t i = 0; i < 1000; ++i) {
+        uint32_t key = rand(), value;
+        ASSERT_EQ(map.find(key, value), stdmap.count(key) > 0);
+      }
+    }
+  }
+
+  void test_dense_keys() {
+    // consecutive keys, as the gvids of most graphs
+    std::vector<std::pair<uint64_t, uint32_t> > pairs;
+    for (uint32_t i = 0; i < 100000; ++i) pairs.push_back(std::make_pair(i, i * 3));
+    frozen_hash_map<uint64_t, uint32_t> map;
+    map.build(pairs.begin(), pairs.end(), pairs.size());
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 200000; i += 2) keys.push_back(i);
+    std::vector<uint32_t> values(keys.size());
+    const size_t found = map.find_many(&keys[0], keys.size(), &values[0], uint32_t(-1));
+    ASSERT_EQ(found, 50000);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      ASSERT_EQ(values[i], keys[i] < 100000 ? uint32_t(keys[i] * 3) : uint32_t(-1));
+    }
+    map.clear();
+    uint32_t value;
+    ASSERT_FALSE(map.find(0, value));
+  }
+};
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cxxtest/TestSuite.h>
+#include <graphlab/engine/gather_cache_budget.hpp>
+using namespace graphlab;
+
+
+class GatherCacheBudgetTestSuite : public CxxTest::TestSuite {
+public:
+  void test_unbounded(void) {
+    gather_cache_budget budget;
+    budget.configure(0, 5);
+    TS_ASSERT(!budget.needs_entry_bytes());
+    TS_ASSERT(!budget.admit(4));
+    TS_ASSERT(budget.admit(5));
+    TS_ASSERT(budget.admit(1000));
+    TS_ASSERT_EQUALS(budget.num_entries(), 2);
+    TS_ASSERT(!budget.rebalance());
+    budget.release(5);
+    TS_ASSERT_EQUALS(budget.num_entries(), 1);
+  }
+
+  void test_eviction(void) {
+    gather_cache_budget budget;
+    budget.configure(80, 0);
+    TS_ASSERT(budget.needs_entry_bytes());
+    TS_ASSERT(!budget.admit(1));
+    budget.set_entry_bytes(8);
+    for (size_t i = 0; i < 10; ++i) TS_ASSERT(budget.admit(1));
+    // the cache is full: higher benefits are rejected too
+    for (size_t i = 0; i < 5; ++i) TS_ASSERT(!budget.admit(100));
+    // the rejected vertices are worth more than the cached ones
+    TS_ASSERT(budget.rebalance());
+    TS_ASSERT(budget.should_evict(1));
+    TS_ASSERT(!budget.should_evict(100));
+    for (size_t i = 0; i < 10; ++i) budget.evict(1);
+    for (size_t i = 0; i < 5; ++i) TS_ASSERT(budget.admit(100));
+    TS_ASSERT(!budget.admit(1));
+    TS_ASSERT_EQUALS(budget.stats().evictions, 10);
+    // with room left the threshold is lowered again
+    TS_ASSERT(!budget.rebalance());
+    TS_ASSERT(budget.admit(1));
+    TS_ASSERT_EQUALS(budget.num_entries(), 6);
+  }
+
+  void test_stats(void) {
+    gather_cache_budget budget;
+    budget.hits.inc(); budget.hits.inc(); budget.hits.inc();
+    budget.misses.inc();
+    gather_cache_budget::stats_type stats = budget.stats();
+    stats += budget.stats();
+    TS_ASSERT_EQUALS(stats.hits, 6);
+    TS_ASSERT_EQUALS(stats.hit_rate(), 0.75);
+    budget.reset_counters();
+    TS_ASSERT_EQUALS(budget.stats().hits, 0);
+  }
+};
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/graph/graph_columns.hpp>
+
+using namespace graphlab;
+
+/**
+ * Unit test for graphlab/graph/graph_columns.hpp
+ */
+class graph_columns_test : public CxxTest::TestSuite {
+public:
+
+  void test_roundtrip() {
+    column_schema schema;
+    schema.add<uint32_t>("id");
+    schema.add<double>("rank");
+    schema.add<bool>("active");
+    const std::string fname = "graph_columns_test.glc";
+    std::ofstream out(fname.c_str(), std::ios_base::out | std::ios_base::binary);
+    columnar_file_sink sink(out);
+    sink.open(schema);
+    column_block block(schema);
+    column_row row(block);
+    // three row groups of different sizes, and a skipped row
+    for (uint32_t i = 0; i < 1000; ++i) {
+      if (i == 500) { row.finish(); continue; }
+      row << i << i * 0.5 << (i % 3 == 0);
+      row.finish();
+      if (i == 99 || i == 700) {
+        sink.write_block(block);
+        block.clear();
+      }
+    }
+    sink.write_block(block);
+    TS_ASSERT(sink.close());
+    out.close();
+
+    columnar_file_reader reader(fname);
+    TS_ASSERT(reader.good());
+    TS_ASSERT_EQUALS(reader.num_rows(), 999);
+    TS_ASSERT_EQUALS(reader.num_row_groups(), 3);
+    TS_ASSERT_EQUALS(reader.get_schema().num_columns(), 3);
+    TS_ASSERT_EQUALS(reader.get_schema().name(1), "rank");
+    TS_ASSERT_EQUALS(reader.get_schema().type(2), COLUMN_BOOL);
+    std::vector<uint32_t> ids;
+    std::vector<double> ranks;
+    reader.read_column("id", ids);
+    reader.read_column(1, ranks);
+    TS_ASSERT_EQUALS(ids.size(), 999);
+    for (size_t i = 0; i < ids.size(); ++i) {
+      const uint32_t id = i < 500 ? i : i + 1;
+      TS_ASSERT_EQUALS(ids[i], id);
+      TS_ASSERT_EQUALS(ranks[i], id * 0.5);
+    }
+    remove(fname.c_str());
+  }
+
+  void test_empty_table() {
+    column_schema schema;
+    schema.add<int64_t>("id");
+    std::stringstream strm;
+    columnar_file_sink sink(strm);
+    sink.open(schema);
+    TS_ASSERT(sink.close());
+    const std::string fname = "graph_columns_empty.glc";
+    std::ofstream out(fname.c_str(), std::ios_base::out | std::ios_base::binary);
+    out << strm.str();
+    out.close();
+    columnar_file_reader reader(fname);
+    TS_ASSERT(reader.good());
+    TS_ASSERT_EQUALS(reader.num_rows(), 0);
+    std::vector<int64_t> ids(3);
+    reader.read_column("id", ids);
+    TS_ASSERT(ids.empty());
+    remove(fname.c_str());
+  }
+};
@@ -0,0 +1,128 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/hybrid_bitset.hpp>
+#include <graphlab/graph/shared_vertex_index.hpp>
+#include <graphlab/macros_def.hpp>
+using namespace graphlab;
+
+class HybridBitsetTestSuite : public CxxTest::TestSuite {
+public:
+  void test_sparse_tracking(void) {
+    hybrid_bitset<uint32_t> h(1000, 16);
+    size_t probelocations[7] = {0, 10, 12, 50, 66, 810, 999};
+    // set out of order to exercise the sort
+    for (size_t i = 0;i < 7; ++i) {
+      h.set_bit(probelocations[6 - i]);
+    }
+    // setting a bit twice only lists it once
+    h.set_bit(50);
+    TS_ASSERT(h.is_sparse());
+    TS_ASSERT_EQUALS(h.sparse_size(), 7);
+    TS_ASSERT_EQUALS(h.compact_sparse(), 7);
+    for (size_t i = 0;i < 7; ++i) {
+      TS_ASSERT_EQUALS(h.sparse_entry(i), probelocations[i]);
+    }
+    size_t ctr = 0;
+    size_t iter;
+    foreach(iter, h) {
+      TS_ASSERT(ctr < 7);
+      TS_ASSERT_EQUALS(iter, probelocations[ctr]);
+      ++ctr;
+    }
+    TS_ASSERT_EQUALS(ctr, 7);
+    // cleared bits are skipped and then dropped by compaction
+    h.clear_bit(12);
+    TS_ASSERT_EQUALS(h.popcount(), 6);
+    TS_ASSERT_EQUALS(h.compact_sparse(), 6);
+    h.clear();
+    TS_ASSERT(h.empty());
+    TS_ASSERT(h.is_sparse());
+    TS_ASSERT_EQUALS(h.dense().popcount(), 0);
+  }
+
+  void test_dense_fallback(void) {
+    hybrid_bitset<uint32_t> h(1000, 16);
+    for (size_t i = 0;i < 100; ++i) h.set_bit(i * 10);
+    TS_ASSERT(!h.is_sparse());
+    TS_ASSERT_EQUALS(h.popcount(), 100);
+    size_t ctr = 0;
+    size_t iter;
+    foreach(iter, h) {
+      TS_ASSERT_EQUALS(iter, ctr * 10);
+      ++ctr;
+    }
+    TS_ASSERT_EQUALS(ctr, 100);
+    // clearing restores sparse tracking
+    h.clear();
+    TS_ASSERT(h.is_sparse());
+    TS_ASSERT(h.empty());
+    h.set_bit(5);
+    TS_ASSERT_EQUALS(h.popcount(), 1);
+    // rebuilding from a dense bitset
+    dense_bitset d(1000);
+    d.clear();
+    d.set_bit(3); d.set_bit(700);
+    h = d;
+    TS_ASSERT(h.is_sparse());
+    TS_ASSERT_EQUALS(h.sparse_size(), 2);
+    TS_ASSERT_EQUALS(h.sparse_entry(1), 700);
+    h.invert();
+    TS_ASSERT(!h.is_sparse());
+    TS_ASSERT_EQUALS(h.popcount(), 998);
+  }
+
+  void test_shared_set_encoding(void) {
+    // the shared positions map to every third local vertex
+    std::vector<lvid_type> positions;
+    for (lvid_type i = 0; i < 3000; i += 3) positions.push_back(i);
+    hybrid_bitset<lvid_type> h(3000, 16);
+    shared_set_message msg;
+    TS_ASSERT(!shared_vertex_index::encode(h, positions, msg));
+    // a few long runs are sent as ranges
+    for (size_t k = 100; k < 400; ++k) h.set_bit(positions[k]);
+    for (size_t k = 990; k < 1000; ++k) h.set_bit(positions[k]);
+    h.set_bit(1);  // not a shared position
+    TS_ASSERT(shared_vertex_index::encode(h, positions, msg));
+    TS_ASSERT_EQUALS(msg.encoding, (unsigned char)shared_set_message::RANGES);
+    TS_ASSERT_EQUALS(msg.words.size(), 4);
+    hybrid_bitset<lvid_type> r(3000, 16);
+    shared_vertex_index::decode(msg, positions, r);
+    TS_ASSERT_EQUALS(r.popcount(), 310);
+    for (size_t k = 0; k < positions.size(); ++k) {
+      TS_ASSERT_EQUALS(r.get(positions[k]), h.get(positions[k]));
+    }
+    // scattered positions are sent as a bitmap
+    for (size_t k = 0; k < positions.size(); k += 2) h.set_bit(positions[k]);
+    TS_ASSERT(shared_vertex_index::encode(h, positions, msg));
+    TS_ASSERT_EQUALS(msg.encoding, (unsigned char)shared_set_message::BITMAP);
+    TS_ASSERT_EQUALS(msg.words.size(), (positions.size() + 31) / 32);
+    r.clear();
+    shared_vertex_index::decode(msg, positions, r);
+    for (size_t k = 0; k < positions.size(); ++k) {
+      TS_ASSERT_EQUALS(r.get(positions[k]), h.get(positions[k]));
+    }
+    TS_ASSERT(!r.get(1));
+  }
+};
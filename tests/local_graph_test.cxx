@@ -28,9 +28,18 @@
 // includes the entire graphlab framework
 #include <graphlab/graph/local_graph.hpp>
 #include <graphlab/graph/dynamic_local_graph.hpp>
+#include <graphlab/graph/vertex_order.hpp>
+#include <graphlab/graph/graph_snapshot.hpp>
 #include <graphlab/util/random.hpp>
 #include <graphlab/macros_def.hpp>
 
+struct timed_edge_data {
+  double time;
+  int from;
+  timed_edge_data(double time = 0, int from = 0) : time(time), from(from) { }
+};
+GRAPHLAB_EDGE_TIMESTAMP(timed_edge_data, time)
+
 /**
  * Unit test for graphlab::local_graph.hpp
  */
@@ -78,6 +87,17 @@ public:
       std::cout << "\n+ Pass test: dynamic graph add edge. :) \n";
   }
 
+  void test_low_memory_finalize() {
+    graphlab::local_graph<vertex_data, edge_data> g;
+    g.set_low_memory_finalize(true);
+    test_add_edge_impl(g, 100);
+    test_add_edge_impl(g, 10000);
+    test_add_edge_impl(g, 100000);
+    g.clear();
+    test_sparse_graph_impl(g);
+    std::cout << "\n+ Pass test: graph low memory finalize. :) \n";
+  }
+
   void test_dynamic_add_edge() {
     graphlab::dynamic_local_graph<vertex_data, edge_data> g2;
     test_add_edge_impl(g2, 100, true); // add edge dynamically
@@ -131,7 +151,199 @@ public:
     std::cout << "\n+ Pass test: grid dynamic graph test. :) \n";
   }
 
+  void test_edge_span() {
+    graphlab::local_graph<vertex_data, edge_data> g;
+    test_edge_span_impl(g, 1000);
+    std::cout << "\n+ Pass test: graph edge span. :) \n";
+
+    graphlab::dynamic_local_graph<vertex_data, edge_data> g2;
+    test_edge_span_impl(g2, 1000);
+    std::cout << "\n+ Pass test: dynamic graph edge span. :) \n";
+  }
+
+  void test_permute_vertices() {
+    graphlab::local_graph<vertex_data, edge_data> g;
+    test_permute_vertices_impl(g, "degree");
+    test_permute_vertices_impl(g, "rcm");
+    std::cout << "\n+ Pass test: graph permute vertices. :) \n";
+
+    graphlab::dynamic_local_graph<vertex_data, edge_data> g2;
+    test_permute_vertices_impl(g2, "degree");
+    test_permute_vertices_impl(g2, "rcm");
+    std::cout << "\n+ Pass test: dynamic graph permute vertices. :) \n";
+  }
+
+  void test_snapshot() {
+    graphlab::local_graph<vertex_data, edge_data> g, g_loaded;
+    test_snapshot_impl(g, g_loaded);
+    std::cout << "\n+ Pass test: graph snapshot. :) \n";
+
+    graphlab::dynamic_local_graph<vertex_data, edge_data> g2, g2_loaded;
+    test_snapshot_impl(g2, g2_loaded);
+    std::cout << "\n+ Pass test: dynamic graph snapshot. :) \n";
+  }
+
+  void test_edge_time_window() {
+#ifndef USE_COMPRESSED_ADJACENCY
+    graphlab::local_graph<vertex_data, timed_edge_data> g;
+    test_edge_time_window_impl(g, 500);
+    std::cout << "\n+ Pass test: graph edge time window. :) \n";
+#endif
+  }
+
 private: 
+  /**
+   * Checks that the in and out edges of every vertex are the edges in
+   * the time window, in time order, for several windows.
+   */
+  template<typename Graph>
+  void test_edge_time_window_impl(Graph& g, size_t nverts) {
+    typedef typename Graph::edge_type edge_type;
+    srand(0);
+    for (size_t i = 0; i < nverts; ++i) g.add_vertex(i, vertex_data(i));
+    for (size_t i = 0; i < 8 * nverts; ++i) {
+      size_t src = rand() % nverts;
+      size_t dst = rand() % nverts;
+      if (src != dst) g.add_edge(src, dst, timed_edge_data(rand() % 100, src));
+    }
+    g.finalize();
+    for (double begin = 0; begin < 100; begin += 30) {
+      const double end = begin + 40;
+      std::vector<size_t> in_count(nverts), out_count(nverts);
+      for (size_t v = 0; v < nverts; ++v) {
+        foreach(edge_type e, g.out_edges(v)) {
+          const double t = e.data().time;
+          if (t >= begin && t < end) ++out_count[v];
+        }
+        foreach(edge_type e, g.in_edges(v)) {
+          const double t = e.data().time;
+          if (t >= begin && t < end) ++in_count[v];
+        }
+      }
+      g.set_edge_time_window(begin, end);
+      for (size_t v = 0; v < nverts; ++v) {
+        double last = begin;
+        size_t count = 0;
+        foreach(edge_type e, g.out_edges(v)) {
+          ASSERT_GE(e.data().time, last);
+          ASSERT_LT(e.data().time, end);
+          ASSERT_EQ(e.data().from, (int)v);
+          last = e.data().time;
+          ++count;
+        }
+        ASSERT_EQ(count, out_count[v]);
+        ASSERT_EQ(g.out_edge_span(v).size(), count);
+        last = begin;
+        count = 0;
+        foreach(edge_type e, g.in_edges(v)) {
+          ASSERT_GE(e.data().time, last);
+          ASSERT_LT(e.data().time, end);
+          ASSERT_EQ(e.target().id(), v);
+          last = e.data().time;
+          ++count;
+        }
+        ASSERT_EQ(count, in_count[v]);
+        ASSERT_EQ(g.in_edge_span(v).size(), count);
+      }
+      g.clear_edge_time_window();
+    }
+  }
+
+  /**
+   * Writes a random graph to a snapshot and compares the graph read
+   * back with the original.
+   */
+  template<typename Graph>
+  void test_snapshot_impl(Graph& g, Graph& g_loaded) {
+    typedef typename Graph::edge_type edge_type;
+    const size_t nverts = 1000;
+    srand(0);
+    for (size_t i = 0; i < nverts; ++i) g.add_vertex(i, vertex_data(i));
+    for (size_t i = 0; i < 4 * nverts; ++i) {
+      size_t src = rand() % nverts;
+      size_t dst = rand() % nverts;
+      if (src != dst) g.add_edge(src, dst, edge_data(src, dst));
+    }
+    g.finalize();
+    const std::string fname = "local_graph_test_snapshot.bin";
+    graphlab::snapshot_writer writer(fname);
+    TS_ASSERT(writer.good());
+    g.save_snapshot(writer);
+    TS_ASSERT(writer.close());
+    TS_ASSERT(graphlab::snapshot_reader::is_snapshot(fname));
+    {
+      graphlab::snapshot_reader reader(fname);
+      TS_ASSERT(reader.good());
+      g_loaded.load_snapshot(reader);
+    }
+    unlink(fname.c_str());
+
+    ASSERT_EQ(g_loaded.num_vertices(), g.num_vertices());
+    ASSERT_EQ(g_loaded.num_edges(), g.num_edges());
+    for (size_t i = 0; i < nverts; ++i) {
+      ASSERT_EQ(g_loaded.vertex_data(i).value, g.vertex_data(i).value);
+      ASSERT_EQ(g_loaded.num_in_edges(i), g.num_in_edges(i));
+      ASSERT_EQ(g_loaded.num_out_edges(i), g.num_out_edges(i));
+      foreach(const edge_type& e, g_loaded.out_edges(i)) {
+        ASSERT_EQ(e.data().from, e.source().id());
+        ASSERT_EQ(e.data().to, e.target().id());
+        ASSERT_EQ(g.edge_data(e.id()).to, e.data().to);
+      }
+      foreach(const edge_type& e, g_loaded.in_edges(i)) {
+        ASSERT_EQ(e.data().from, e.source().id());
+        ASSERT_EQ(e.data().to, e.target().id());
+      }
+    }
+  }
+
+  /**
+   * Relabels a random graph and checks that every vertex kept its
+   * data and its edges. The vertex data holds the original id.
+   */
+  template<typename Graph>
+  void test_permute_vertices_impl(Graph& g, const std::string& method) {
+    typedef typename Graph::edge_type edge_type;
+    const size_t nverts = 1000;
+    srand(0);
+    g.clear();
+    for (size_t i = 0; i < nverts; ++i) g.add_vertex(i, vertex_data(i));
+    boost::unordered_set<std::pair<int, int> > all_edges;
+    for (size_t i = 0; i < 4 * nverts; ++i) {
+      int src = rand() % nverts;
+      int dst = rand() % nverts;
+      if (src == dst || all_edges.count(std::make_pair(src, dst))) continue;
+      all_edges.insert(std::make_pair(src, dst));
+      g.add_edge(src, dst, edge_data(src, dst));
+    }
+    g.finalize();
+    std::vector<graphlab::lvid_type> new_lvid;
+    TS_ASSERT(graphlab::vertex_order::compute(g, method, new_lvid));
+    TS_ASSERT(!graphlab::vertex_order::compute(g, "unknown", new_lvid));
+    std::vector<size_t> seen(nverts, 0);
+    for (size_t i = 0; i < nverts; ++i) ++seen[new_lvid[i]];
+    for (size_t i = 0; i < nverts; ++i) TS_ASSERT_EQUALS(seen[i], 1);
+
+    g.permute_vertices(new_lvid);
+    ASSERT_EQ(g.num_vertices(), nverts);
+    ASSERT_EQ(g.num_edges(), all_edges.size());
+    for (size_t i = 0; i < nverts; ++i) {
+      ASSERT_EQ(g.vertex(new_lvid[i]).data().value, i);
+    }
+    size_t nedges = 0;
+    for (size_t i = 0; i < nverts; ++i) {
+      foreach(const edge_type& e, g.out_edges(i)) {
+        ASSERT_EQ(e.data().from, g.vertex_data(e.source().id()).value);
+        ASSERT_EQ(e.data().to, g.vertex_data(e.target().id()).value);
+        ++nedges;
+      }
+      foreach(const edge_type& e, g.in_edges(i)) {
+        ASSERT_EQ(e.data().from, g.vertex_data(e.source().id()).value);
+        ASSERT_EQ(e.data().to, g.vertex_data(e.target().id()).value);
+      }
+    }
+    ASSERT_EQ(nedges, all_edges.size());
+  }
+
   template<typename Graph>
   void test_add_vertex_impl(Graph& g, size_t nverts) {
     g.clear();
@@ -273,6 +485,47 @@ template<typename Graph>
   }
 
   
+  /**
+   * Compare the edge spans of every vertex against its edge lists.
+   */
+  template<typename Graph>
+  void test_edge_span_impl(Graph& g, size_t nverts) {
+    typedef typename Graph::edge_type edge_type;
+    typedef typename Graph::edge_span edge_span;
+    srand(0);
+    for (size_t i = 0; i < nverts; ++i) g.add_vertex(i, vertex_data(i));
+    for (size_t i = 0; i < 4 * nverts; ++i) {
+      size_t src = rand() % nverts;
+      size_t dst = rand() % nverts;
+      if (src != dst) g.add_edge(src, dst, edge_data(src, dst));
+    }
+    g.finalize();
+    for (size_t v = 0; v < nverts; ++v) {
+      const edge_span in_span = g.in_edge_span(v);
+      ASSERT_FALSE(in_span.is_out_edges());
+      ASSERT_EQ(in_span.size(), g.num_in_edges(v));
+      size_t i = 0;
+      foreach(edge_type e, g.in_edges(v)) {
+        ASSERT_EQ(in_span.neighbor(i), e.source().id());
+        ASSERT_EQ(in_span.edge_id(i), e.id());
+        ASSERT_EQ(in_span.edge_data(i).from, (int)e.source().id());
+        ASSERT_EQ(in_span.neighbor_data(i).value, e.source().id());
+        ++i;
+      }
+      const edge_span out_span = g.out_edge_span(v);
+      ASSERT_TRUE(out_span.is_out_edges());
+      ASSERT_EQ(out_span.size(), g.num_out_edges(v));
+      i = 0;
+      foreach(edge_type e, g.out_edges(v)) {
+        ASSERT_EQ(out_span.neighbor(i), e.target().id());
+        ASSERT_EQ(out_span.edge_id(i), e.id());
+        ASSERT_EQ(out_span.edge_data(i).to, (int)e.target().id());
+        ASSERT_EQ(out_span.neighbor_data(i).value, e.target().id());
+        ++i;
+      }
+    }
+  }
+
   template<typename Graph>
   void test_edge_case_impl(Graph& g) {
     // TODO: 
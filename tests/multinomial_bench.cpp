@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/**
+ * Compares the time per sample of alias_multinomial, fast_multinomial
+ * and random::multinomial on random distributions of several sizes,
+ * and checks the alias tables against the distributions.
+ */
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <graphlab.hpp>
+#include <graphlab/util/fast_multinomial.hpp>
+
+using namespace graphlab;
+
+const size_t NUM_SAMPLES = 1000000;
+
+int main(int argc, char** argv) {
+  random::seed(1234);
+  std::cout << "K\talias (ns)\tfast_multinomial (ns)\trandom::multinomial (ns)"
+            << std::endl;
+  for (size_t num_asg = 10; num_asg <= 100000; num_asg *= 10) {
+    std::vector<double> weights(num_asg);
+    for (size_t i = 0; i < num_asg; ++i) weights[i] = random::gamma(1);
+
+    alias_multinomial alias(weights);
+    fast_multinomial tree(num_asg, 1);
+    for (size_t i = 0; i < num_asg; ++i) tree.set(i, weights[i]);
+
+    random::fast_generator& rng = random::get_fast_source();
+    std::vector<size_t> counts(num_asg, 0);
+    timer ti; ti.start();
+    for (size_t i = 0; i < NUM_SAMPLES; ++i) ++counts[alias.sample(rng)];
+    const double alias_time = ti.current_time();
+
+    ti.start();
+    size_t asg = 0, checksum = 0;
+    for (size_t i = 0; i < NUM_SAMPLES; ++i) {
+      tree.sample(asg, 0);
+      checksum += asg;
+    }
+    const double tree_time = ti.current_time();
+
+    // the linear scan is much slower: time fewer samples
+    const size_t num_linear = std::max<size_t>(1000, NUM_SAMPLES / num_asg);
+    ti.start();
+    for (size_t i = 0; i < num_linear; ++i) checksum += random::multinomial(weights);
+    const double linear_time = ti.current_time();
+
+    std::cout << num_asg << "\t"
+              << 1e9 * alias_time / NUM_SAMPLES << "\t"
+              << 1e9 * tree_time / NUM_SAMPLES << "\t"
+              << 1e9 * linear_time / num_linear
+              << "\t(" << checksum % 10 << ")" << std::endl;
+
+    // the total variation distance of the alias samples should be small
+    double sum = 0, tv = 0;
+    for (size_t i = 0; i < num_asg; ++i) sum += weights[i];
+    for (size_t i = 0; i < num_asg; ++i) {
+      tv += std::fabs(double(counts[i]) / NUM_SAMPLES - weights[i] / sum);
+    }
+    tv /= 2;
+    if (num_asg <= 1000) ASSERT_LT(tv, 0.02);
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/quantile_sketch.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <cmath>
+#include <sstream>
+using namespace graphlab;
+
+
+class QuantileSketchTestSuite : public CxxTest::TestSuite {
+public:
+  void test_small(void) {
+    // below the capacity of a level the sketch is exact
+    quantile_sketch<int> sketch;
+    for (int i = 1; i <= 100; ++i) sketch.insert(101 - i);
+    TS_ASSERT_EQUALS(sketch.count(), 100);
+    TS_ASSERT_EQUALS(sketch.quantile(0), 1);
+    TS_ASSERT_EQUALS(sketch.quantile(0.5), 50);
+    TS_ASSERT_EQUALS(sketch.quantile(1), 100);
+    TS_ASSERT_EQUALS(sketch.rank(25), 0.25);
+  }
+
+  void test_accuracy(void) {
+    // merge sketches of parts of a permutation of [0, n)
+    const size_t n = 1000000;
+    quantile_sketch<double> total;
+    quantile_sketch<double> part;
+    for (size_t i = 0; i < n; ++i) {
+      part.insert(double((i * 7919) % n));
+      if ((i + 1) % 10000 == 0) {
+        total += part;
+        part.clear();
+      }
+    }
+    TS_ASSERT_EQUALS(total.count(), n);
+    TS_ASSERT_LESS_THAN(total.num_retained(), 1000);
+    for (double q = 0.01; q < 1; q += 0.01) {
+      TS_ASSERT_LESS_THAN(std::fabs(total.quantile(q) / n - q), 0.02);
+    }
+  }
+
+  void test_serialize(void) {
+    quantile_sketch<double> sketch(64);
+    for (size_t i = 0; i < 10000; ++i) sketch.insert(random::fast_uniform<double>(0, 1));
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << sketch;
+    strm.flush();
+    iarchive iarc(strm);
+    quantile_sketch<double> loaded;
+    iarc >> loaded;
+    TS_ASSERT_EQUALS(loaded.count(), sketch.count());
+    TS_ASSERT_EQUALS(loaded.quantile(0.3), sketch.quantile(0.3));
+  }
+};
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/**
+ * Measures the throughput of the queues of graphlab/util with several
+ * numbers of producer and consumer threads. Every producer pushes
+ * NUM_ITEMS values and the consumers pop until all the values are
+ * popped, checking their sum. Consumers yield when the queue is empty
+ * and producers of the bounded rings yield while the ring is full. lock_free_pool is not a queue: its threads
+ * allocate and free elements instead.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sched.h>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/blocking_queue.hpp>
+#include <graphlab/util/fiber_blocking_queue.hpp>
+#include <graphlab/util/inplace_lf_queue.hpp>
+#include <graphlab/util/inplace_lf_queue2.hpp>
+#include <graphlab/util/lock_free_pool.hpp>
+#include <graphlab/util/mpmc_ring.hpp>
+#include <graphlab/util/spsc_ring.hpp>
+#include <graphlab/util/fiber_ring_queue.hpp>
+
+using namespace graphlab;
+
+const size_t NUM_ITEMS = 1000000;
+
+struct node {
+  node* next;
+  size_t value;
+  node() : next(NULL), value(0) { }
+};
+
+/*
+ * Every adapter pushes one value with push(), spinning while the queue
+ * is full, and pop() pops one or more values, adding them to sum and
+ * returning their number.
+ */
+
+struct blocking_queue_adapter {
+  static const bool multi_consumer = true;
+  blocking_queue<size_t> q;
+  void push(size_t producer, size_t v) { q.enqueue(v); }
+  size_t pop(size_t& sum) {
+    std::pair<size_t, bool> r = q.try_dequeue();
+    if (r.second) sum += r.first;
+    return r.second;
+  }
+};
+
+struct fiber_blocking_queue_adapter {
+  static const bool multi_consumer = true;
+  fiber_blocking_queue<size_t> q;
+  // no fiber is waiting
+  void push(size_t producer, size_t v) { q.enqueue(v, false); }
+  size_t pop(size_t& sum) {
+    std::pair<size_t, bool> r = q.try_dequeue();
+    if (r.second) sum += r.first;
+    return r.second;
+  }
+};
+
+struct fiber_ring_queue_adapter {
+  static const bool multi_consumer = true;
+  fiber_ring_queue<size_t> q;
+  void push(size_t producer, size_t v) { q.enqueue(v, false); }
+  size_t pop(size_t& sum) {
+    std::deque<size_t> values;
+    q.dequeue_all(values);
+    for (size_t i = 0; i < values.size(); ++i) sum += values[i];
+    return values.size();
+  }
+};
+
+struct mpmc_ring_adapter {
+  static const bool multi_consumer = true;
+  mpmc_ring<size_t> q;
+  mpmc_ring_adapter() : q(4096) { }
+  void push(size_t producer, size_t v) { while (!q.try_push(v)) sched_yield(); }
+  size_t pop(size_t& sum) {
+    size_t v;
+    if (!q.try_pop(v)) return 0;
+    sum += v;
+    return 1;
+  }
+};
+
+struct spsc_ring_adapter {
+  static const bool multi_consumer = false;
+  spsc_ring<size_t> q;
+  spsc_ring_adapter() : q(4096) { }
+  void push(size_t producer, size_t v) {
+    while (!q.try_push(v)) sched_yield();
+  }
+  size_t pop(size_t& sum) {
+    size_t v;
+    if (!q.try_pop(v)) return 0;
+    sum += v;
+    return 1;
+  }
+};
+
+/// The intrusive queues push preallocated nodes, one array per producer
+struct intrusive_nodes {
+  std::vector<std::vector<node> > nodes;
+  void allocate(size_t nproducers) {
+    nodes.assign(nproducers, std::vector<node>(NUM_ITEMS));
+  }
+};
+
+struct inplace_lf_queue_adapter : public intrusive_nodes {
+  static const bool multi_consumer = false;
+  inplace_lf_queue q;
+  void push(size_t producer, size_t v) {
+    node* n = &nodes[producer][v / nodes.size()];
+    n->value = v;
+    q.enqueue(reinterpret_cast<char*>(n));
+  }
+  size_t pop(size_t& sum) {
+    char* c = q.dequeue_all();
+    size_t count = 0;
+    while (c != NULL && !q.end_of_dequeue_list(c)) {
+      sum += reinterpret_cast<node*>(c)->value;
+      ++count;
+      // the next pointer is set right after the node is enqueued
+      char* next;
+      while ((next = *(char* volatile*)inplace_lf_queue::get_next_ptr(c)) == NULL) {
+        cpu_relax();
+      }
+      c = next;
+    }
+    return count;
+  }
+};
+
+struct inplace_lf_queue2_adapter : public intrusive_nodes {
+  static const bool multi_consumer = false;
+  inplace_lf_queue2<node> q;
+  void push(size_t producer, size_t v) {
+    node* n = &nodes[producer][v / nodes.size()];
+    n->value = v;
+    q.enqueue(n);
+  }
+  size_t pop(size_t& sum) {
+    node* n = q.dequeue_all();
+    size_t count = 0;
+    while (n != NULL && !q.end_of_dequeue_list(n)) {
+      sum += n->value;
+      ++count;
+      node* next;
+      while ((next = *(node* volatile*)&n->next) == NULL) cpu_relax();
+      n = next;
+    }
+    return count;
+  }
+};
+
+template <typename Adapter>
+struct run_state {
+  Adapter queue;
+  size_t nproducers;
+  atomic<size_t> popped;
+  atomic<size_t> sum;
+};
+
+template <typename Adapter>
+void producer(run_state<Adapter>* state, size_t id) {
+  // producer id pushes the values congruent to id
+  for (size_t i = 0; i < NUM_ITEMS; ++i) {
+    state->queue.push(id, i * state->nproducers + id);
+  }
+}
+
+template <typename Adapter>
+void consumer(run_state<Adapter>* state) {
+  const size_t total = NUM_ITEMS * state->nproducers;
+  size_t local_sum = 0;
+  while (state->popped.value < total) {
+    const size_t n = state->queue.pop(local_sum);
+    if (n > 0) state->popped.inc(n);
+    else sched_yield();
+  }
+  state->sum.inc(local_sum);
+}
+
+template <typename Adapter>
+void init_nodes(Adapter& adapter, size_t nproducers) { }
+
+void init_nodes(inplace_lf_queue_adapter& adapter, size_t nproducers) {
+  adapter.allocate(nproducers);
+}
+
+void init_nodes(inplace_lf_queue2_adapter& adapter, size_t nproducers) {
+  adapter.allocate(nproducers);
+}
+
+template <typename Adapter>
+void bench(const std::string& name, size_t nproducers, size_t nconsumers) {
+  if (nconsumers > 1 && !Adapter::multi_consumer) return;
+  run_state<Adapter>* state = new run_state<Adapter>();
+  state->nproducers = nproducers;
+  init_nodes(state->queue, nproducers);
+  thread_group group;
+  timer ti; ti.start();
+  for (size_t i = 0; i < nconsumers; ++i) {
+    group.launch(boost::bind(consumer<Adapter>, state));
+  }
+  for (size_t i = 0; i < nproducers; ++i) {
+    group.launch(boost::bind(producer<Adapter>, state, i));
+  }
+  group.join();
+  const double t = ti.current_time();
+  const size_t total = NUM_ITEMS * nproducers;
+  const bool correct = state->sum.value == total * (total - 1) / 2;
+  std::cout << name << "\t" << nproducers << "\t" << nconsumers << "\t"
+            << total / t / 1e6 << (correct ? "" : "\tWRONG SUM") << std::endl;
+  delete state;
+}
+
+void pool_worker(lock_free_pool<node>* pool) {
+  for (size_t i = 0; i < NUM_ITEMS; ++i) {
+    node* n = pool->alloc();
+    n->value = i;
+    pool->free(n);
+  }
+}
+
+void bench_pool(size_t nthreads) {
+  lock_free_pool<node> pool(1024);
+  thread_group group;
+  timer ti; ti.start();
+  for (size_t i = 0; i < nthreads; ++i) {
+    group.launch(boost::bind(pool_worker, &pool));
+  }
+  group.join();
+  std::cout << "lock_free_pool (alloc+free)\t" << nthreads << "\t" << nthreads
+            << "\t" << NUM_ITEMS * nthreads / ti.current_time() / 1e6
+            << std::endl;
+}
+
+int main(int argc, char** argv) {
+  const size_t nthreads = std::max<size_t>(thread::cpu_count() / 2, 2);
+  size_t configs[][2] = { {1, 1}, {nthreads, 1}, {1, nthreads},
+                          {nthreads, nthreads} };
+  std::cout << "queue\tproducers\tconsumers\tMops/s" << std::endl;
+  for (size_t c = 0; c < 4; ++c) {
+    const size_t np = configs[c][0], nc = configs[c][1];
+    bench<blocking_queue_adapter>("blocking_queue", np, nc);
+    bench<fiber_blocking_queue_adapter>("fiber_blocking_queue", np, nc);
+    bench<fiber_ring_queue_adapter>("fiber_ring_queue", np, nc);
+    bench<inplace_lf_queue_adapter>("inplace_lf_queue", np, nc);
+    bench<inplace_lf_queue2_adapter>("inplace_lf_queue2", np, nc);
+    bench<mpmc_ring_adapter>("mpmc_ring", np, nc);
+    if (np == 1) bench<spsc_ring_adapter>("spsc_ring", np, nc);
+  }
+  bench_pool(1);
+  bench_pool(nthreads);
+  return 0;
+}
@@ -138,6 +138,22 @@ class RandomTestSuite: public CxxTest::TestSuite {
 
 
 
+  void test_counter_generator() {
+    namespace random = graphlab::random;
+    // the same key gives the same stream, drawn one by one or in bulk
+    random::counter_generator gen1(42, 7, 3), gen2(42, 7, 3), gen3(42, 7, 4);
+    std::vector<double> values(100);
+    gen1.fill_uniform(&values[0], values.size());
+    size_t same_as_other_key = 0;
+    for(size_t i = 0; i < values.size(); ++i) {
+      TS_ASSERT(values[i] >= 0 && values[i] < 1);
+      TS_ASSERT_EQUALS(values[i], gen2.uniform01());
+      same_as_other_key += (values[i] == gen3.uniform01());
+    }
+    TS_ASSERT_EQUALS(same_as_other_key, 0);
+    TS_ASSERT_EQUALS(gen1.uniform<int>(0, 1000), gen2.uniform<int>(0, 1000));
+  }
+
   void test_shuffle() {
     namespace random = graphlab::random;
     random::nondet_seed();
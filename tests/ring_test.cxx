@@ -0,0 +1,119 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <sched.h>
+#include <boost/bind.hpp>
+
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/util/mpmc_ring.hpp>
+#include <graphlab/util/spsc_ring.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+using namespace graphlab;
+
+const size_t ITEMS_PER_PRODUCER = 100000;
+
+void ring_producer(mpmc_ring<size_t>* ring, size_t id, size_t nproducers) {
+  for (size_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+    while (!ring->try_push(i * nproducers + id)) sched_yield();
+  }
+}
+
+void ring_consumer(mpmc_ring<size_t>* ring, size_t nproducers,
+                   atomic<size_t>* popped,
+                   std::vector<atomic<size_t> >* counts) {
+  size_t v;
+  while (popped->value < ITEMS_PER_PRODUCER * nproducers) {
+    if (ring->try_pop(v)) {
+      popped->inc();
+      (*counts)[v].inc();
+    } else {
+      sched_yield();
+    }
+  }
+}
+
+class test_rings : public CxxTest::TestSuite {
+public:
+
+  void test_mpmc_sequential() {
+    mpmc_ring<int> ring(5);
+    ASSERT_EQ(ring.capacity(), 8);
+    ASSERT_TRUE(ring.empty());
+    int v;
+    ASSERT_FALSE(ring.try_pop(v));
+    for (int round = 0; round < 3; ++round) {
+      for (int i = 0; i < 8; ++i) ASSERT_TRUE(ring.try_push(i));
+      ASSERT_FALSE(ring.try_push(8));
+      ASSERT_EQ(ring.approx_size(), 8);
+      for (int i = 0; i < 8; ++i) {
+        ASSERT_TRUE(ring.try_pop(v));
+        ASSERT_EQ(v, i);
+      }
+      ASSERT_FALSE(ring.try_pop(v));
+      ASSERT_TRUE(ring.empty());
+    }
+  }
+
+  void test_spsc_sequential() {
+    spsc_ring<int> ring(4);
+    int v;
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_TRUE(ring.try_push(i));
+      if (i % 3 == 2) {
+        ASSERT_TRUE(ring.try_pop(v));
+        ASSERT_TRUE(ring.try_pop(v));
+        ASSERT_TRUE(ring.try_pop(v));
+        ASSERT_EQ(v, i);
+        ASSERT_TRUE(ring.empty());
+      }
+    }
+    ASSERT_TRUE(ring.try_pop(v));
+    ASSERT_EQ(v, 99);
+    for (int i = 0; i < 4; ++i) ASSERT_TRUE(ring.try_push(i));
+    ASSERT_FALSE(ring.try_push(4));
+  }
+
+  void test_mpmc_threads() {
+    const size_t nproducers = 4, nconsumers = 4;
+    mpmc_ring<size_t> ring(64);
+    atomic<size_t> popped;
+    std::vector<atomic<size_t> > counts(ITEMS_PER_PRODUCER * nproducers);
+    thread_group group;
+    for (size_t i = 0; i < nconsumers; ++i) {
+      group.launch(boost::bind(ring_consumer, &ring, nproducers,
+                               &popped, &counts));
+    }
+    for (size_t i = 0; i < nproducers; ++i) {
+      group.launch(boost::bind(ring_producer, &ring, i, nproducers));
+    }
+    group.join();
+    // every value is popped exactly once
+    for (size_t i = 0; i < counts.size(); ++i) ASSERT_EQ(counts[i].value, 1);
+    ASSERT_TRUE(ring.empty());
+  }
+};
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <set>
+#include <vector>
+#include <sstream>
+#include <cxxtest/TestSuite.h>
+#include <graphlab/util/roaring_bitset.hpp>
+#include <graphlab/graph/vertex_set.hpp>
+#include <graphlab/macros_def.hpp>
+using namespace graphlab;
+
+struct collect_values {
+  std::vector<size_t>* out;
+  collect_values(std::vector<size_t>* out) : out(out) { }
+  void operator()(size_t x) const { out->push_back(x); }
+};
+
+// the only graph member used to make a vertex set explicit
+struct fake_graph {
+  size_t n;
+  fake_graph(size_t n) : n(n) { }
+  size_t num_local_vertices() const { return n; }
+};
+
+class RoaringBitsetTestSuite : public CxxTest::TestSuite {
+public:
+  static std::vector<size_t> values(const roaring_bitset& r) {
+    std::vector<size_t> ret;
+    r.for_each(collect_values(&ret));
+    return ret;
+  }
+
+  // a sparse chunk, a dense chunk and a chunk far away
+  static void fill(roaring_bitset& r, std::set<size_t>& ref, size_t step,
+                   size_t offset) {
+    for (size_t i = offset; i < 300000; i += step) {
+      if (i < 65536 && i % 100 != 0) continue;
+      TS_ASSERT_EQUALS(r.add(uint32_t(i)), ref.insert(i).second);
+    }
+    r.add(4000000000u);
+    ref.insert(4000000000u);
+  }
+
+  void test_add_contains(void) {
+    roaring_bitset r;
+    std::set<size_t> ref;
+    fill(r, ref, 3, 0);
+    // out of order and repeated insertions
+    TS_ASSERT(r.add(65537 * 7 + 1));
+    ref.insert(65537 * 7 + 1);
+    TS_ASSERT(!r.add(300));
+    TS_ASSERT_EQUALS(r.size(), ref.size());
+    std::vector<size_t> expected(ref.begin(), ref.end());
+    TS_ASSERT(values(r) == expected);
+    for (size_t i = 0; i < 300000; ++i) {
+      TS_ASSERT_EQUALS(r.contains(uint32_t(i)), ref.count(i) > 0);
+    }
+    TS_ASSERT(r.contains(4000000000u));
+    TS_ASSERT(r.estimate_sizeof() < 300000 / 8);
+  }
+
+  void test_set_operations(void) {
+    roaring_bitset a, b;
+    std::set<size_t> ra, rb;
+    fill(a, ra, 3, 0);
+    fill(b, rb, 5, 1);
+    std::vector<size_t> expected;
+    std::set_union(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                   std::back_inserter(expected));
+    TS_ASSERT(values(a | b) == expected);
+    TS_ASSERT_EQUALS((a | b).size(), expected.size());
+    expected.clear();
+    std::set_intersection(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                          std::back_inserter(expected));
+    TS_ASSERT(values(a & b) == expected);
+    TS_ASSERT_EQUALS((a & b).size(), expected.size());
+    expected.clear();
+    std::set_difference(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                        std::back_inserter(expected));
+    TS_ASSERT(values(a - b) == expected);
+    TS_ASSERT_EQUALS((a - b).size(), expected.size());
+    TS_ASSERT((a - a).empty());
+
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << a;
+    strm.flush();
+    iarchive iarc(strm);
+    roaring_bitset c;
+    iarc >> c;
+    TS_ASSERT(c == a);
+    TS_ASSERT(c != b);
+  }
+
+  void test_vertex_set_compression(void) {
+    fake_graph graph(100000);
+    vertex_set sparse(false), dense(false);
+    sparse.make_explicit(graph);
+    dense.make_explicit(graph);
+    for (size_t i = 0; i < 100000; i += 1000) sparse.set_lvid_unsync(i);
+    for (size_t i = 0; i < 100000; i += 2) dense.set_lvid_unsync(i);
+    sparse.choose_representation();
+    dense.choose_representation();
+    TS_ASSERT(sparse.is_compressed);
+    TS_ASSERT(!dense.is_compressed);
+    TS_ASSERT(sparse.l_contains(5000) && !sparse.l_contains(5001));
+
+    vertex_set both = sparse & dense;
+    TS_ASSERT(both.is_compressed);
+    vertex_set either = sparse | dense;
+    TS_ASSERT(!either.is_compressed);
+    vertex_set diff = dense - sparse;
+    vertex_set sdiff = sparse - dense;
+    vertex_set inv = ~sparse;
+    for (size_t i = 0; i < 100000; ++i) {
+      const bool s = i % 1000 == 0, d = i % 2 == 0;
+      TS_ASSERT_EQUALS(both.l_contains(i), s && d);
+      TS_ASSERT_EQUALS(either.l_contains(i), s || d);
+      TS_ASSERT_EQUALS(diff.l_contains(i), d && !s);
+      TS_ASSERT_EQUALS(sdiff.l_contains(i), s && !d);
+      TS_ASSERT_EQUALS(inv.l_contains(i), !s);
+    }
+
+    // traversals, expansion and serialization preserve the set
+    std::vector<size_t> visited;
+    sparse.for_each_lvid(graph, collect_values(&visited));
+    TS_ASSERT_EQUALS(visited.size(), 100);
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << sparse;
+    strm.flush();
+    iarchive iarc(strm);
+    vertex_set loaded;
+    iarc >> loaded;
+    TS_ASSERT(loaded.is_compressed);
+    sparse.decompress();
+    TS_ASSERT_EQUALS(sparse.localvset.popcount(), 100);
+    for (size_t i = 0; i < 100000; ++i) {
+      TS_ASSERT_EQUALS(loaded.l_contains(i), sparse.l_contains(i));
+    }
+  }
+};
@@ -0,0 +1,52 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#include <string>
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/rpc/rpc_profiler.hpp>
+
+using graphlab::dc_impl::rpc_profiler;
+
+void profiled_function() { }
+
+class rpc_profiler_test : public CxxTest::TestSuite {
+ public:
+  void test_record() {
+    rpc_profiler profiler;
+    profiler.record(reinterpret_cast<size_t>(&profiled_function), 100, 0);
+    profiler.record(reinterpret_cast<size_t>(&profiled_function), 50, 5);
+    profiler.record(1, 10, 1 << 30);
+    std::string json = profiler.to_json();
+    // the entries are sorted by bytes
+    TS_ASSERT(json.find("\"calls\": 2, \"bytes\": 150, \"total_usec\": 5, "
+                        "\"usec_histogram\": [1, 0, 0, 1, 0") != std::string::npos);
+    TS_ASSERT(json.find("\"bytes\": 150") < json.find("\"bytes\": 10,"));
+    // times beyond the histogram go in the last bucket
+    TS_ASSERT(json.find(", 1]}\n]") != std::string::npos);
+    TS_ASSERT(profiler.to_string().find("150") != std::string::npos);
+  }
+
+  void test_empty() {
+    rpc_profiler profiler;
+    TS_ASSERT_EQUALS(profiler.to_json(), "[\n]\n");
+  }
+};
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cstdio>
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/engine/schedule_trace.hpp>
+
+using namespace graphlab;
+
+/**
+ * Unit test for graphlab/engine/schedule_trace.hpp
+ */
+class schedule_trace_test : public CxxTest::TestSuite {
+public:
+
+  void test_record_and_replay() {
+    const std::string fname = "schedule_trace_test.bin";
+    schedule_trace recorder;
+    recorder.set_mode(schedule_trace::RECORD);
+    recorder.begin(3, fname);
+    lvid_type seq0[] = {5, 3, 1000000, 2, 2};
+    for (size_t i = 0; i < 5; ++i) recorder.record_task(0, seq0[i]);
+    recorder.record_task(2, 7);
+    recorder.record_grant(3);
+    recorder.record_grant(9);
+    recorder.end(fname);
+    TS_ASSERT_EQUALS(recorder.num_tasks(), 6);
+
+    schedule_trace replayer;
+    replayer.set_mode(schedule_trace::REPLAY);
+    replayer.begin(3, fname);
+    TS_ASSERT_EQUALS(replayer.num_tasks(), 6);
+    lvid_type lvid;
+    for (size_t i = 0; i < 5; ++i) {
+      TS_ASSERT(replayer.next_task(0, lvid));
+      TS_ASSERT_EQUALS(lvid, seq0[i]);
+    }
+    TS_ASSERT(!replayer.next_task(0, lvid));
+    TS_ASSERT(!replayer.next_task(1, lvid));
+    TS_ASSERT(replayer.next_task(2, lvid));
+    TS_ASSERT_EQUALS(lvid, 7);
+    replayer.task_skipped();
+    TS_ASSERT_EQUALS(replayer.num_skipped(), 1);
+
+    replayer.record_grant(3);
+    replayer.record_grant(4);
+    TS_ASSERT_EQUALS(replayer.num_grants_in_order(), 1);
+    std::remove(fname.c_str());
+  }
+};
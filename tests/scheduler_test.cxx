@@ -21,35 +21,20 @@
  */
 
 
-#include <fstream>
+
 #include <vector>
+#include <iostream>
+#include <boost/bind.hpp>
 #include <graphlab/scheduler/scheduler_includes.hpp>
-#include <graphlab/rpc/async_consensus.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/timer.hpp>
 #include <cxxtest/TestSuite.h>
 
 
 using namespace graphlab;
 
-distributed_control dc;
-
-struct message_type {
-  int value;
-  double pr;
-
-  explicit message_type(int value = 0, double pr = 0):value(value),pr(pr) { }
-  
-  double priority() const {
-    return pr;
-  }
-  message_type& operator+=(const message_type& other) {
-    value += other.value;
-    pr = other.value;
-    return *this;
-  }
-};
-
-
 const size_t NCPUS = 4;
 const size_t NUM_VERTICES = 101;
 std::vector<atomic<int> > correctness_counter;
@@ -60,83 +45,51 @@ void test_scheduler_basic_functionality_single_threaded() {
   graphlab_options opts;
   opts.set_ncpus(NCPUS);
   SchedulerType sched(NUM_VERTICES, opts);
-  const size_t target_value = 100;
-  
-  // inject a sequence of messages which will sum to 100 per vertex
-  for (size_t c = 0;c < target_value; ++c) {
+
+  // repeated schedules of a vertex are merged
+  for (size_t c = 0;c < 100; ++c) {
     for (size_t i = 0; i < NUM_VERTICES; ++i) {
-      sched.schedule(i, message_type(1, 1.0));
+      sched.schedule(i, 1.0 + c);
     }
   }
   correctness_counter.clear();
   correctness_counter.resize(NUM_VERTICES, atomic<int>(0));
-  sched.start();
-  
+
   // pull stuff out
-  bool allcpus_done = false; 
+  bool allcpus_done = false;
   while(!allcpus_done) {
     allcpus_done = true;
     for (size_t i = 0; i < NCPUS; ++i) {
-      vertex_id_type v; message_type m;
-      sched_status::status_enum ret = sched.get_next(i, v, m);
+      lvid_type v;
+      sched_status::status_enum ret = sched.get_next(i, v);
       if (ret == sched_status::NEW_TASK) {
         allcpus_done = false;
-        correctness_counter[v].inc(m.value);
+        correctness_counter[v].inc();
       }
     }
   }
 
   // check the counters
   for(size_t i = 0; i < NUM_VERTICES; ++i) {
-    TS_ASSERT_EQUALS(correctness_counter[i].value, (int)target_value);
+    TS_ASSERT_EQUALS(correctness_counter[i].value, 1);
   }
+  TS_ASSERT(sched.empty());
 }
 
 
 
-
-
 template <typename SchedulerType>
-void test_basic_functionality_thread(SchedulerType& sched, 
-                                     async_consensus& consensus, 
+void test_basic_functionality_thread(SchedulerType& sched,
                                      size_t schedule_count,
                                      size_t threadid) {
-  size_t c = 0;
-  vertex_id_type v; message_type m;
-  while(1) {
-    // process as many tasks as I can
-    while(1) {
-      sched_status::status_enum ret = sched.get_next(threadid, v, m);
-      if (ret == sched_status::NEW_TASK) {
-        correctness_counter[v].inc(m.value);
-      }
-      else {
-        break;
-      }
-    }
-    
-    // schedule 1 cycle. If I schedule stuff I go back to processing tasks
-    if (c < schedule_count) {
-      for (size_t i = 0; i < NUM_VERTICES; ++i) {
-        sched.schedule(i, message_type(1, 1.0));
-        consensus.cancel();
-      }
-      ++c;
-      continue;
-    }
-    
-    // nothing to schedule, nothing to run. try to quit
-    consensus.begin_done_critical_section(threadid);
-    sched_status::status_enum ret = sched.get_next(threadid, v, m);
-    if (ret == sched_status::NEW_TASK) {
-      // there is task. cancel, process it, and look back
-      consensus.cancel_critical_section(threadid);
-      correctness_counter[v].inc(m.value);
+  lvid_type v;
+  for (size_t c = 0; c < schedule_count; ++c) {
+    for (size_t i = 0; i < NUM_VERTICES; ++i) {
+      sched.schedule(i, random::fast_uniform(0.0, 1.0));
     }
-    else {
-      // no more tasks try to finish up
-      bool ret = consensus.end_done_critical_section(threadid);
-      if (ret) break;
+    // process as many tasks as I can
+    while(sched.get_next(threadid, v) == sched_status::NEW_TASK) {
+      correctness_counter[v].inc();
     }
   }
 }
@@ -147,149 +100,277 @@ void test_scheduler_basic_functionality_parallel() {
   graphlab_options opts;
   opts.set_ncpus(NCPUS);
   SchedulerType sched(NUM_VERTICES, opts);
-  async_consensus consensus(dc, NCPUS);
-  
-  const size_t schedule_count = 10000;
-  const size_t target_value = schedule_count * NCPUS + 1;
+
+  const size_t schedule_count = 1000;
 
   correctness_counter.clear();
   correctness_counter.resize(NUM_VERTICES, atomic<int>(0));
 
-  // inject a sequence of messages which will sum to 100 per vertex
-  for (size_t i = 0; i < NUM_VERTICES; ++i) {
-    sched.schedule(i, message_type(1, 1.0));
-  }
-  sched.start();
-  
   thread_group group;
   for (size_t i = 0;i < NCPUS;++i) {
     group.launch(boost::bind(test_basic_functionality_thread<SchedulerType>,
-                             boost::ref(sched), boost::ref(consensus), schedule_count, i));
+                             boost::ref(sched), schedule_count, i));
   }
-
   group.join();
-  // check the counters
+
+  // a vertex scheduled while it was being popped may still be there
+  lvid_type v;
+  while(sched.get_next(0, v) == sched_status::NEW_TASK) {
+    correctness_counter[v].inc();
+  }
+  TS_ASSERT(sched.empty());
+
+  // every vertex was scheduled after its last pop, so it ran at least once
+  // and at most once per schedule
   for(size_t i = 0; i < NUM_VERTICES; ++i) {
-    TS_ASSERT_EQUALS(correctness_counter[i].value, (int)target_value);
+    TS_ASSERT_LESS_THAN_EQUALS(1, correctness_counter[i].value);
+    TS_ASSERT_LESS_THAN_EQUALS(correctness_counter[i].value,
+                               (int)(schedule_count * NCPUS));
   }
 }
 
 
 
-
-
-
-
-/*
- * Like test_basic_functionality_thread, but only increments the 
- * correctness_counter by 1, and checks to make sure the priority is at least
- * 100.0
- */
 template <typename SchedulerType>
-void test_scheduler_min_priority_thread(SchedulerType& sched, 
-                                        async_consensus& consensus, 
-                                        size_t schedule_count,
-                                        size_t threadid) {
-  size_t c = 0;
-  vertex_id_type v; message_type m;
-  while(1) {
-    // process as many tasks as I can
-    while(1) {
-      sched_status::status_enum ret = sched.get_next(threadid, v, m);
-      if (ret == sched_status::NEW_TASK) {
-        TS_ASSERT_LESS_THAN_EQUALS(100.0, m.priority());
-        correctness_counter[v].inc(1);
-      }
-      else {
-        break;
-      }
-    }
-    
-    // schedule 1 cycle. If I schedule stuff I go back to processing tasks
-    if (c < schedule_count) {
-      for (size_t i = 0; i < NUM_VERTICES; ++i) {
-        sched.schedule(i, message_type(1, 1.0));
-        consensus.cancel();
-      }
-      ++c;
-      continue;
-    }
-    
-    // nothing to schedule, nothing to run. try to quit
-    consensus.begin_done_critical_section(threadid);
-    sched_status::status_enum ret = sched.get_next(threadid, v, m);
-    if (ret == sched_status::NEW_TASK) {
-      TS_ASSERT_LESS_THAN_EQUALS(100.0, m.priority());
-      // there is task. cancel, process it, and look back
-      consensus.cancel_critical_section(threadid);
-      correctness_counter[v].inc(1);
-    }
-    else {
-      // no more tasks try to finish up
-      bool ret = consensus.end_done_critical_section(threadid);
-      if (ret) break;
+void test_scheduler_min_priority() {
+  graphlab_options opts;
+  opts.set_ncpus(NCPUS);
+  opts.get_scheduler_args().set_option("min_priority", 100.0);
+  SchedulerType sched(NUM_VERTICES, opts);
+
+  // only the odd vertices have enough priority to be returned
+  for (size_t i = 0; i < NUM_VERTICES; ++i) {
+    sched.schedule(i, (i % 2) ? 101.0 : 1.0);
+  }
+  size_t count = 0;
+  lvid_type v;
+  for (size_t i = 0; i < NCPUS; ++i) {
+    while(sched.get_next(i, v) == sched_status::NEW_TASK) {
+      TS_ASSERT_EQUALS(v % 2, 1);
+      ++count;
     }
   }
+  TS_ASSERT_EQUALS(count, NUM_VERTICES / 2);
+  TS_ASSERT(sched.empty());
 }
 
 
+
 template <typename SchedulerType>
-void test_scheduler_min_priority_parallel() {
+void test_scheduler_batch() {
   graphlab_options opts;
   opts.set_ncpus(NCPUS);
-  opts.get_scheduler_args().set_option("min_priority", 100.0);
-  
   SchedulerType sched(NUM_VERTICES, opts);
-  async_consensus consensus(dc, NCPUS);
-  
-  const size_t schedule_count = 10000;
-  const size_t maximum_value = (size_t)((schedule_count * NCPUS + 101.0) / 100.0);
+  // every vertex twice, and one out of range
+  std::vector<lvid_type> vids;
+  for (size_t i = 0; i < 2 * NUM_VERTICES + 1; ++i) vids.push_back(i % (NUM_VERTICES + 1));
+  sched.schedule_batch(&vids[0], vids.size());
 
   correctness_counter.clear();
   correctness_counter.resize(NUM_VERTICES, atomic<int>(0));
+  lvid_type buffer[16];
+  size_t total = 0;
+  for (size_t cpu = 0; cpu < NCPUS; ++cpu) {
+    while (size_t n = sched.get_next_batch(cpu, buffer, 16)) {
+      TS_ASSERT_LESS_THAN_EQUALS(n, 16);
+      for (size_t i = 0; i < n; ++i) correctness_counter[buffer[i]].inc();
+      total += n;
+    }
+  }
+  TS_ASSERT_EQUALS(total, NUM_VERTICES);
+  for(size_t i = 0; i < NUM_VERTICES; ++i) {
+    TS_ASSERT_EQUALS(correctness_counter[i].value, 1);
+  }
+  TS_ASSERT(sched.empty());
+}
+
+
 
-  // inject a sequence of messages which will sum to 100 per vertex
+/*
+ * With a single queue the priority schedulers are exact, and raising
+ * the priority of a scheduled vertex moves it ahead.
+ */
+template <typename SchedulerType>
+void test_scheduler_priority_order() {
+  graphlab_options opts;
+  opts.set_ncpus(1);
+  opts.get_scheduler_args().set_option("multi", 1);
+  SchedulerType sched(NUM_VERTICES, opts);
   for (size_t i = 0; i < NUM_VERTICES; ++i) {
-    sched.schedule(i, message_type(1, 101.0));
+    sched.schedule(i, (double)((i * 37) % NUM_VERTICES));
   }
-  sched.start();
-  
-  thread_group group;
-  for (size_t i = 0;i < NCPUS;++i) {
-    group.launch(boost::bind(test_scheduler_min_priority_thread<SchedulerType>,
-                             boost::ref(sched), boost::ref(consensus), schedule_count, i));
+  double last = NUM_VERTICES;
+  lvid_type v;
+  while(sched.get_next(0, v) == sched_status::NEW_TASK) {
+    const double priority = (double)((v * 37) % NUM_VERTICES);
+    TS_ASSERT_LESS_THAN(priority, last);
+    last = priority;
   }
+}
 
-  group.join();
-  // check the counters
-  for(size_t i = 0; i < NUM_VERTICES; ++i) {
-    TS_ASSERT_LESS_THAN_EQUALS(correctness_counter[i].value, (int)maximum_value);
+
+
+/*
+ * A label correcting shortest path style workload: every popped vertex
+ * schedules a few random vertices with a random priority.
+ */
+template <typename SchedulerType>
+void benchmark_thread(SchedulerType& sched, size_t nvertices,
+                      size_t ops, size_t threadid) {
+  lvid_type v;
+  size_t done = 0;
+  while (done < ops) {
+    if (sched.get_next(threadid, v) == sched_status::NEW_TASK) ++done;
+    for (size_t i = 0; i < 4; ++i) {
+      sched.schedule(random::fast_uniform(size_t(0), nvertices - 1),
+                     random::fast_uniform(0.0, 1.0));
+    }
+  }
+}
+
+
+template <typename SchedulerType>
+double benchmark_scheduler(size_t ncpus) {
+  const size_t nvertices = 1 << 16;
+  const size_t ops = 100000;
+  graphlab_options opts;
+  opts.set_ncpus(ncpus);
+  SchedulerType sched(nvertices, opts);
+  for (size_t i = 0; i < nvertices; ++i) {
+    sched.schedule(i, random::fast_uniform(0.0, 1.0));
   }
+  timer ti; ti.start();
+  thread_group group;
+  for (size_t i = 0;i < ncpus;++i) {
+    group.launch(boost::bind(benchmark_thread<SchedulerType>,
+                             boost::ref(sched), nvertices, ops, i));
+  }
+  group.join();
+  return ti.current_time();
 }
 
-class SerializeTestSuite : public CxxTest::TestSuite {
+
+class SchedulerTestSuite : public CxxTest::TestSuite {
 public:
   void test_scheduler_basic_single_threaded() {
-    test_scheduler_basic_functionality_single_threaded<sweep_scheduler<message_type> >();
-    test_scheduler_basic_functionality_single_threaded<fifo_scheduler<message_type> >();
-    test_scheduler_basic_functionality_single_threaded<priority_scheduler<message_type> >();
-    test_scheduler_basic_functionality_single_threaded<queued_fifo_scheduler<message_type> >();
+    test_scheduler_basic_functionality_single_threaded<sweep_scheduler>();
+    test_scheduler_basic_functionality_single_threaded<fifo_scheduler>();
+    test_scheduler_basic_functionality_single_threaded<priority_scheduler>();
+    test_scheduler_basic_functionality_single_threaded<queued_fifo_scheduler>();
+    test_scheduler_basic_functionality_single_threaded<multiqueue_scheduler>();
+    test_scheduler_basic_functionality_single_threaded<delta_bucket_scheduler>();
   }
-  
+
   void test_scheduler_basic_parallel() {
-    test_scheduler_basic_functionality_parallel<sweep_scheduler<message_type> >();
-    test_scheduler_basic_functionality_parallel<fifo_scheduler<message_type> >();
-    test_scheduler_basic_functionality_parallel<priority_scheduler<message_type> >();
-    test_scheduler_basic_functionality_parallel<queued_fifo_scheduler<message_type> >();
+    test_scheduler_basic_functionality_parallel<sweep_scheduler>();
+    test_scheduler_basic_functionality_parallel<fifo_scheduler>();
+    test_scheduler_basic_functionality_parallel<priority_scheduler>();
+    test_scheduler_basic_functionality_parallel<queued_fifo_scheduler>();
+    test_scheduler_basic_functionality_parallel<multiqueue_scheduler>();
+    test_scheduler_basic_functionality_parallel<delta_bucket_scheduler>();
+  }
+
+  void test_scheduler_min_priority_filter() {
+    test_scheduler_min_priority<priority_scheduler>();
+    test_scheduler_min_priority<multiqueue_scheduler>();
   }
-  
-    
-  void test_scheduler_min_priority() {
-    test_scheduler_min_priority_parallel<sweep_scheduler<message_type> >();
-    test_scheduler_min_priority_parallel<fifo_scheduler<message_type> >();
-    test_scheduler_min_priority_parallel<priority_scheduler<message_type> >();
-    test_scheduler_min_priority_parallel<queued_fifo_scheduler<message_type> >();
+
+  void test_priority_order() {
+    test_scheduler_priority_order<priority_scheduler>();
+    test_scheduler_priority_order<multiqueue_scheduler>();
+
+    // raising the priority of a scheduled vertex
+    graphlab_options opts;
+    opts.set_ncpus(1);
+    opts.get_scheduler_args().set_option("multi", 1);
+    multiqueue_scheduler sched(NUM_VERTICES, opts);
+    sched.schedule(0, 1.0);
+    sched.schedule(1, 2.0);
+    sched.schedule(0, 3.0);
+    lvid_type v;
+    TS_ASSERT_EQUALS(sched.get_next(0, v), sched_status::NEW_TASK);
+    TS_ASSERT_EQUALS(v, 0);
+    TS_ASSERT_EQUALS(sched.get_next(0, v), sched_status::NEW_TASK);
+    TS_ASSERT_EQUALS(v, 1);
+    TS_ASSERT_EQUALS(sched.get_next(0, v), sched_status::EMPTY);
+    TS_ASSERT(sched.empty());
   }
 
-};
+  void test_batch() {
+    test_scheduler_batch<sweep_scheduler>();
+    test_scheduler_batch<fifo_scheduler>();
+    test_scheduler_batch<queued_fifo_scheduler>();
+    test_scheduler_batch<priority_scheduler>();
+  }
 
+  void test_sweep_blocked() {
+    // two blocks of 64 vertices: one per cpu
+    graphlab_options opts;
+    opts.set_ncpus(2);
+    opts.get_scheduler_args().set_option("order", "blocked");
+    opts.get_scheduler_args().set_option("block_size", 64);
+    sweep_scheduler sched(NUM_VERTICES, opts);
+    for (size_t i = 0; i < NUM_VERTICES; ++i) sched.schedule(i);
+    correctness_counter.clear();
+    correctness_counter.resize(NUM_VERTICES, atomic<int>(0));
+    // each cpu sweeps its own block in order
+    lvid_type v;
+    for (size_t i = 0; i < 30; ++i) {
+      TS_ASSERT_EQUALS(sched.get_next(0, v), sched_status::NEW_TASK);
+      TS_ASSERT_EQUALS(v, i);
+      correctness_counter[v].inc();
+      TS_ASSERT_EQUALS(sched.get_next(1, v), sched_status::NEW_TASK);
+      TS_ASSERT_EQUALS(v, 64 + i);
+      correctness_counter[v].inc();
+    }
+    // once its block is done cpu 1 takes over the block of cpu 0
+    while(sched.get_next(1, v) == sched_status::NEW_TASK) {
+      correctness_counter[v].inc();
+    }
+    for(size_t i = 0; i < NUM_VERTICES; ++i) {
+      TS_ASSERT_EQUALS(correctness_counter[i].value, 1);
+    }
+    TS_ASSERT_EQUALS(sched.get_next(0, v), sched_status::EMPTY);
+    TS_ASSERT(sched.empty());
+    // a vertex rescheduled behind the cursor is found again
+    sched.schedule(3);
+    TS_ASSERT_EQUALS(sched.get_next(0, v), sched_status::NEW_TASK);
+    TS_ASSERT_EQUALS(v, 3);
+  }
+
+  void test_delta_bucket_order() {
+    // a ring of 8 buckets of width 4 keeps most buckets in the overflow
+    graphlab_options opts;
+    opts.set_ncpus(2);
+    opts.get_scheduler_args().set_option("delta", 4.0);
+    opts.get_scheduler_args().set_option("buckets", 8);
+    delta_bucket_scheduler sched(NUM_VERTICES, opts);
+    for (size_t i = 0; i < NUM_VERTICES; ++i) {
+      sched.schedule(i, -(double)((i * 37) % NUM_VERTICES));
+    }
+    // lowering the bucket of a scheduled vertex
+    sched.schedule(100, -0.5);
+    lvid_type v;
+    size_t last_bucket = 0;
+    size_t count = 0;
+    while(sched.get_next(count % 2, v) == sched_status::NEW_TASK) {
+      const size_t bucket = (v == 100) ? 0 : ((v * 37) % NUM_VERTICES) / 4;
+      TS_ASSERT_LESS_THAN_EQUALS(last_bucket, bucket);
+      last_bucket = bucket;
+      ++count;
+    }
+    TS_ASSERT_EQUALS(count, NUM_VERTICES);
+    TS_ASSERT(sched.empty());
+  }
+
+  void test_priority_benchmark() {
+    const size_t ncpus = std::max<size_t>(thread::cpu_count(), 2);
+    std::cout << "\n" << ncpus << " threads, 100000 pops per thread\n";
+    std::cout << "priority:   "
+              << benchmark_scheduler<priority_scheduler>(ncpus) << " s\n";
+    std::cout << "multiqueue: "
+              << benchmark_scheduler<multiqueue_scheduler>(ncpus) << " s\n";
+    std::cout << "delta_bucket: "
+              << benchmark_scheduler<delta_bucket_scheduler>(ncpus) << " s\n";
+  }
+};
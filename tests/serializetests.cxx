@@ -26,6 +26,7 @@
 #include <map>
 #include <string>
 #include <cstring>
+#include <sstream>
 
 #include <cxxtest/TestSuite.h>
 
@@ -414,5 +415,67 @@ public:
         TS_ASSERT_EQUALS(p1[i].x, p2[i].x);
     }
   }
+
+  void test_nested_vectors() {
+    std::vector<std::vector<int> > v(100);
+    std::vector<std::vector<std::string> > s(10);
+    for (size_t i = 0;i < v.size(); ++i) {
+      for (size_t j = 0;j < i; ++j) v[i].push_back(j);
+    }
+    for (size_t i = 0;i < s.size(); ++i) s[i].resize(i, std::string(i, 'a'));
+    // to a stream
+    std::stringstream strm;
+    oarchive a(strm);
+    a << v << s;
+    strm.flush();
+    std::vector<std::vector<int> > v2;
+    std::vector<std::vector<std::string> > s2;
+    iarchive b(strm);
+    b >> v2 >> s2;
+    TS_ASSERT(v == v2);
+    TS_ASSERT(s == s2);
+    // to a reused buffer
+    oarchive c;
+    for (size_t k = 0;k < 3; ++k) {
+      c.reset();
+      c << v << s;
+      iarchive d(c.buf, c.off);
+      d >> v2 >> s2;
+      TS_ASSERT(v == v2);
+      TS_ASSERT(s == s2);
+    }
+    const size_t len = c.len;
+    c.reset();
+    c << v << s;
+    TS_ASSERT_EQUALS(c.len, len);
+    free(c.buf);
+  }
+
+  void test_compact_archive() {
+    std::vector<std::string> s(3, "abc");
+    std::vector<std::vector<size_t> > v(5, std::vector<size_t>(3, 7));
+    const int negative = -5;
+    const uint64_t large = uint64_t(-1);
+    oarchive a, b;
+    b.compact = true;
+    a << size_t(1) << negative << large << s << v;
+    b << size_t(1) << negative << large << s << v;
+    // a small size_t takes one byte instead of eight
+    TS_ASSERT_LESS_THAN(b.off, a.off);
+    iarchive c(b.buf, b.off);
+    c.compact = true;
+    size_t one; int neg; uint64_t lg;
+    std::vector<std::string> s2;
+    std::vector<std::vector<size_t> > v2;
+    c >> one >> neg >> lg >> s2 >> v2;
+    TS_ASSERT_EQUALS(one, 1);
+    TS_ASSERT_EQUALS(neg, -5);
+    TS_ASSERT_EQUALS(lg, large);
+    TS_ASSERT(s == s2);
+    TS_ASSERT(v == v2);
+    TS_ASSERT_EQUALS(c.off, b.off);
+    free(a.buf);
+    free(b.buf);
+  }
 };
 
@@ -0,0 +1,82 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <cxxtest/TestSuite.h>
+#include <boost/lexical_cast.hpp>
+
+#include <graphlab/rpc/shm_ring.hpp>
+
+using graphlab::dc_impl::shm_ring;
+
+class shm_ring_test : public CxxTest::TestSuite {
+ public:
+  std::string ring_name() {
+    return "/graphlab-shm-ring-test-" + boost::lexical_cast<std::string>(getpid());
+  }
+
+  // reads everything readable from the ring, in at most two runs
+  std::string drain(shm_ring& ring) {
+    std::string ret;
+    size_t len;
+    const char* c;
+    while ((c = ring.peek(len)), len > 0) {
+      ret.append(c, len);
+      ring.consume(len);
+    }
+    return ret;
+  }
+
+  void test_write_read() {
+    shm_ring consumer, producer;
+    consumer.create(ring_name(), 4096);
+    producer.open(ring_name());
+    TS_ASSERT_EQUALS(consumer.readable(), 0);
+    TS_ASSERT_EQUALS(producer.free_space(), 4096);
+    TS_ASSERT_EQUALS(producer.write("hello", 5), 5);
+    TS_ASSERT_EQUALS(consumer.readable(), 5);
+    TS_ASSERT_EQUALS(drain(consumer), "hello");
+    TS_ASSERT_EQUALS(producer.free_space(), 4096);
+  }
+
+  void test_full_and_wraparound() {
+    shm_ring consumer, producer;
+    consumer.create(ring_name(), 4096);
+    producer.open(ring_name());
+    std::string data(6000, ' ');
+    for (size_t i = 0; i < data.size(); ++i) data[i] = char('a' + i % 26);
+    TS_ASSERT_EQUALS(producer.write(data.c_str(), 1000), 1000);
+    std::string got = drain(consumer);
+    // only a full ring is written, wrapping around its end
+    TS_ASSERT_EQUALS(producer.write(data.c_str() + 1000, 5000), 4096);
+    TS_ASSERT_EQUALS(producer.free_space(), 0);
+    TS_ASSERT_EQUALS(producer.write(data.c_str() + 5096, 1), 0);
+    size_t len;
+    consumer.peek(len);
+    TS_ASSERT_EQUALS(len, 4096 - 1000);
+    got += drain(consumer);
+    TS_ASSERT_EQUALS(producer.write(data.c_str() + 5096, 904), 904);
+    got += drain(consumer);
+    TS_ASSERT_EQUALS(got, data);
+  }
+};
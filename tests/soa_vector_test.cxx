@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <sstream>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/util/soa_vector.hpp>
+#include <graphlab/graph/local_graph.hpp>
+#include <graphlab/macros_def.hpp>
+
+struct soa_node {
+  double dist;
+  bool visited;
+  int parent;
+};
+
+struct soa_edge {
+  float weight;
+};
+
+GRAPHLAB_SOA_TRAITS(soa_node, ((double, dist))((bool, visited))((int, parent)))
+GRAPHLAB_SOA_TRAITS(soa_edge, ((float, weight)))
+
+using namespace graphlab;
+
+/**
+ * Unit test for graphlab/util/soa_vector.hpp
+ */
+class soa_vector_test : public CxxTest::TestSuite {
+public:
+
+  void test_fields_are_separate_arrays() {
+    soa_vector<soa_node> v(100);
+    for (size_t i = 0; i < v.size(); ++i) {
+      v[i].dist = i * 0.5;
+      v[i].visited = (i % 3 == 0);
+      v[i].parent = -int(i);
+    }
+    const soa_vector<soa_node>& cv = v;
+    for (size_t i = 0; i < v.size(); ++i) {
+      TS_ASSERT_EQUALS(cv[i].dist, i * 0.5);
+      TS_ASSERT_EQUALS(cv[i].visited, (i % 3 == 0));
+      TS_ASSERT_EQUALS(cv[i].parent, -int(i));
+    }
+    // the dist field is one dense array
+    TS_ASSERT_EQUALS(&v.columns().dist[1].value - &v.columns().dist[0].value, 1);
+    TS_ASSERT_EQUALS(sizeof(v.columns().visited[0]), sizeof(bool));
+  }
+
+  void test_proxies_convert_and_assign() {
+    soa_vector<soa_node> v;
+    soa_node n;
+    n.dist = 2.5; n.visited = true; n.parent = 7;
+    v.push_back(n);
+    v.push_back(n);
+    v[1].dist = 1.0;
+    const soa_node copy = v[1];
+    TS_ASSERT_EQUALS(copy.dist, 1.0);
+    TS_ASSERT_EQUALS(copy.parent, 7);
+    v[0] = v[1];
+    TS_ASSERT_EQUALS(v[0].dist, 1.0);
+    TS_ASSERT_EQUALS(v[0].parent, 7);
+    make_soa_lvalue(v[0]).get().parent = 3;
+    TS_ASSERT_EQUALS(v[0].parent, 3);
+  }
+
+  void test_swap_storage_and_serialization() {
+    std::vector<soa_node> vec(10);
+    for (size_t i = 0; i < vec.size(); ++i) {
+      vec[i].dist = i; vec[i].visited = false; vec[i].parent = i + 1;
+    }
+    soa_vector<soa_node> v;
+    swap_storage(v, vec);
+    TS_ASSERT_EQUALS(v.size(), 10);
+    TS_ASSERT(vec.empty());
+    TS_ASSERT_EQUALS(v[4].parent, 5);
+
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << v;
+    strm.flush();
+    iarchive iarc(strm);
+    soa_vector<soa_node> w;
+    iarc >> w;
+    TS_ASSERT_EQUALS(w.size(), v.size());
+    for (size_t i = 0; i < w.size(); ++i) {
+      TS_ASSERT_EQUALS(w[i].dist, v[i].dist);
+      TS_ASSERT_EQUALS(w[i].parent, v[i].parent);
+    }
+  }
+
+  void test_local_graph_with_soa_data() {
+    typedef local_graph<soa_node, soa_edge> graph_type;
+    TS_ASSERT((boost::is_same<graph_type::vertex_storage_type,
+                              soa_vector<soa_node> >::value));
+    graph_type g;
+    const size_t n = 20;
+    for (size_t i = 0; i < n; ++i) {
+      soa_node node;
+      node.dist = i; node.visited = false; node.parent = 0;
+      g.add_vertex(i, node);
+    }
+    for (size_t i = 0; i + 1 < n; ++i) {
+      soa_edge e;
+      e.weight = float(i);
+      g.add_edge(i, i + 1, e);
+    }
+    g.finalize();
+    TS_ASSERT_EQUALS(g.num_edges(), n - 1);
+    for (size_t i = 0; i < n; ++i) {
+      graph_type::vertex_type v = g.vertex(i);
+      v.data().visited = true;
+      foreach(graph_type::edge_type e, v.out_edges()) {
+        TS_ASSERT_EQUALS(e.data().weight, float(i));
+        TS_ASSERT_EQUALS(e.target().data().dist, double(i + 1));
+      }
+      const graph_type::edge_span span = g.in_edge_span(i);
+      for (size_t j = 0; j < span.size(); ++j) {
+        TS_ASSERT_EQUALS(span.neighbor_data(j).dist, double(i - 1));
+        TS_ASSERT_EQUALS(span.edge_data(j).weight, float(i - 1));
+      }
+    }
+    for (size_t i = 0; i < n; ++i) TS_ASSERT(g.vertex_data(i).visited);
+
+    // reversing the vertices moves their data and edges
+    std::vector<lvid_type> new_lvid(n);
+    for (size_t i = 0; i < n; ++i) new_lvid[i] = n - 1 - i;
+    g.permute_vertices(new_lvid);
+    for (size_t i = 0; i < n; ++i) {
+      TS_ASSERT_EQUALS(g.vertex_data(i).dist, double(n - 1 - i));
+      foreach(graph_type::edge_type e, g.in_edges(i)) {
+        TS_ASSERT_EQUALS(e.data().weight, float(n - 2 - i));
+      }
+    }
+  }
+};
+
+#include <graphlab/macros_undef.hpp>
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cxxtest/TestSuite.h>
+#include <graphlab/graph/sorted_intersection.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/timer.hpp>
+using namespace graphlab;
+
+
+class SortedIntersectionTestSuite : public CxxTest::TestSuite {
+public:
+
+  // n distinct sorted ids drawn from [0, range)
+  std::vector<uint32_t> make_set(size_t n, size_t range) {
+    std::vector<uint32_t> ret;
+    for (size_t i = 0; i < n; ++i) {
+      ret.push_back(random::fast_uniform<uint32_t>(0, range - 1));
+    }
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    return ret;
+  }
+
+  size_t reference_size(const std::vector<uint32_t>& a,
+                        const std::vector<uint32_t>& b) {
+    std::vector<uint32_t> out;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                          std::back_inserter(out));
+    return out.size();
+  }
+
+  void test_kernels(void) {
+    random::seed(10);
+    const size_t sizes[] = {0, 1, 3, 4, 5, 17, 64, 200, 5000};
+    for (size_t x = 0; x < 9; ++x) {
+      for (size_t y = 0; y < 9; ++y) {
+        std::vector<uint32_t> a = make_set(sizes[x], 2 * sizes[y] + 8);
+        std::vector<uint32_t> b = make_set(sizes[y], 2 * sizes[y] + 8);
+        const size_t expected = reference_size(a, b);
+        const uint32_t* pa = a.empty() ? NULL : &a[0];
+        const uint32_t* pb = b.empty() ? NULL : &b[0];
+        TS_ASSERT_EQUALS(graph_ops::sorted_intersection_size(a, b), expected);
+        TS_ASSERT_EQUALS(graph_ops::merge_intersection_size(pa, a.size(),
+                                                          pb, b.size()),
+                         expected);
+        TS_ASSERT_EQUALS(graph_ops::merge_intersection_size<uint32_t>(
+                             pa, a.size(), pb, b.size()), expected);
+        TS_ASSERT_EQUALS(graph_ops::gallop_intersection_size(pa, a.size(),
+                                                           pb, b.size()),
+                         expected);
+      }
+    }
+    // identical and disjoint sets
+    std::vector<uint32_t> a, b;
+    for (uint32_t i = 0; i < 1000; ++i) { a.push_back(2 * i); b.push_back(2 * i + 1); }
+    TS_ASSERT_EQUALS(graph_ops::sorted_intersection_size(a, a), a.size());
+    TS_ASSERT_EQUALS(graph_ops::sorted_intersection_size(a, b), 0);
+  }
+
+  void test_benchmark(void) {
+    random::seed(10);
+    const size_t ratios[] = {1, 4, 32, 256};
+    for (size_t r = 0; r < 4; ++r) {
+      const size_t nlarge = 16384, nsmall = nlarge / ratios[r];
+      std::vector<uint32_t> large = make_set(nlarge, 4 * nlarge);
+      std::vector<uint32_t> small = make_set(nsmall, 4 * nlarge);
+      const size_t repeats = 200;
+      std::vector<uint32_t> scratch(small.size());
+      size_t checksum = 0;
+      timer ti;
+      ti.start();
+      for (size_t i = 0; i < repeats; ++i) {
+        // drop i % 4 elements so the calls can not be hoisted
+        checksum += std::set_intersection(small.begin() + i % 4, small.end(),
+                                          large.begin(), large.end(),
+                                          scratch.begin()) - scratch.begin();
+      }
+      const double tref = ti.current_time();
+      ti.start();
+      for (size_t i = 0; i < repeats; ++i) {
+        checksum -= graph_ops::sorted_intersection_size(&small[i % 4],
+                                                        small.size() - i % 4,
+                                                        &large[0], large.size());
+      }
+      const double tsorted = ti.current_time();
+      TS_ASSERT_EQUALS(checksum, 0);
+      std::cout << "\n" << small.size() << " x " << large.size()
+                << ": std::set_intersection " << tref
+                << "s, sorted_intersection_size " << tsorted << "s";
+    }
+    std::cout << std::endl;
+  }
+};
@@ -337,6 +337,13 @@ int main(int argc, char** argv) {
   test_messages(dc, clopts, graph);
   test_count_aggregators(dc, clopts, graph);
 
+  std::cout << "Rerunning the gathers with pipelined applys" << std::endl;
+  clopts.engine_args.set_option("pipeline_gather_apply", true);
+  test_in_neighbors(dc, clopts, graph);
+  test_out_neighbors(dc, clopts, graph);
+  test_all_neighbors(dc, clopts, graph);
+  test_messages(dc, clopts, graph);
+
   graphlab::mpi_tools::finalize();
 } // end of main
 
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <set>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/graph/synthetic_graph_generators.hpp>
+#include <graphlab/util/random.hpp>
+
+using namespace graphlab;
+
+/**
+ * Unit test for graphlab/graph/synthetic_graph_generators.hpp
+ */
+class synthetic_graph_generators_test : public CxxTest::TestSuite {
+public:
+
+  void test_rmat_scramble_is_bijection() {
+    synthetic_graph::rmat_generator rmat(10);
+    std::set<uint64_t> images;
+    for (uint64_t v = 0; v < rmat.num_vertices(); ++v) {
+      const uint64_t w = rmat.scramble(v);
+      TS_ASSERT_LESS_THAN(w, rmat.num_vertices());
+      images.insert(w);
+    }
+    TS_ASSERT_EQUALS(images.size(), rmat.num_vertices());
+  }
+
+  void test_rmat_is_reproducible() {
+    synthetic_graph::rmat_generator rmat(12);
+    random::counter_generator rng1(7, 3), rng2(7, 3);
+    for (size_t i = 0; i < 1000; ++i) {
+      const std::pair<uint64_t, uint64_t> e1 = rmat(rng1), e2 = rmat(rng2);
+      TS_ASSERT_EQUALS(e1, e2);
+      TS_ASSERT_LESS_THAN(e1.first, rmat.num_vertices());
+      TS_ASSERT_LESS_THAN(e1.second, rmat.num_vertices());
+    }
+  }
+
+  void test_chung_lu_is_skewed() {
+    const size_t nverts = 10000;
+    synthetic_graph::chung_lu_generator chung_lu(nverts);
+    random::counter_generator rng(1, 0);
+    std::vector<size_t> degree(nverts, 0);
+    for (size_t i = 0; i < 100000; ++i) {
+      const std::pair<uint64_t, uint64_t> e = chung_lu(rng);
+      TS_ASSERT_LESS_THAN(e.first, nverts);
+      TS_ASSERT_LESS_THAN(e.second, nverts);
+      ++degree[e.first]; ++degree[e.second];
+    }
+    // the first vertices have most of the edges
+    size_t head = 0;
+    for (size_t i = 0; i < nverts / 100; ++i) head += degree[i];
+    TS_ASSERT_LESS_THAN(degree[nverts - 1], degree[0]);
+    TS_ASSERT_LESS_THAN(200000 / 4, head);
+    TS_ASSERT_EQUALS(chung_lu.vertex(0.0), 0);
+  }
+};
@@ -26,6 +26,9 @@
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/thread_pool.hpp>
 #include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/sharded_counter.hpp>
+#include <graphlab/parallel/guided_chunk_dispenser.hpp>
+#include <graphlab/parallel/task_runtime.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/util/timer.hpp>
 #include <boost/bind.hpp>
@@ -152,7 +155,86 @@ void test_pool_exception_forwarding(){
 }
 
 
+guided_chunk_dispenser dispenser;
+std::vector<size_t> claimed;
+sharded_counter<size_t> nchunks(4);
 
+void claim_chunks(size_t threadid) {
+  size_t start, stop;
+  while(dispenser.claim(start, stop)) {
+    nchunks.inc(threadid);
+    for (size_t i = start; i < stop; ++i) {
+      __sync_fetch_and_add(&claimed[i], 1);
+    }
+  }
+}
+
+void test_guided_dispenser() {
+  const size_t n = 100000 + 17;
+  claimed.assign(n, 0);
+  nchunks = 0;
+  dispenser.reset(0, n, 4, 64, 64);
+  thread_group group;
+  for (size_t i = 0; i < 4; ++i) {
+    group.launch(boost::bind(claim_chunks, i));
+  }
+  group.join();
+  TS_ASSERT(dispenser.exhausted());
+  // every entry is handed out exactly once
+  for (size_t i = 0; i < n; ++i) TS_ASSERT_EQUALS(claimed[i], (size_t)1);
+  // guided chunks: far fewer claims than fixed 64 entry blocks
+  TS_ASSERT_LESS_THAN(nchunks.value(), n / 64 / 4);
+
+  // chunks stay aligned to the granularity
+  size_t start, stop;
+  dispenser.reset(128, 1000, 1, 64, 64);
+  while(dispenser.claim(start, stop)) {
+    TS_ASSERT_EQUALS(start % 64, (size_t)0);
+    TS_ASSERT(stop % 64 == 0 || stop == 1000);
+  }
+}
+
+void mark_claimed(size_t i) {
+  __sync_fetch_and_add(&claimed[i], 1);
+}
+
+void sum_index(size_t i, size_t& accum) {
+  accum += i;
+}
+
+void sum_combine(size_t& a, const size_t& b) {
+  a += b;
+}
+
+size_t nested_sum(size_t n) {
+  // runs inside a fiber, so the caller takes part in the loop
+  return parallel_reduce(0, n, size_t(0), sum_index, sum_combine, 7);
+}
+
+void test_task_runtime_loops() {
+  const size_t n = 100000 + 17;
+  claimed.assign(n, 0);
+  parallel_for(0, n, mark_claimed);
+  for (size_t i = 0; i < n; ++i) TS_ASSERT_EQUALS(claimed[i], (size_t)1);
+  claimed.assign(n, 0);
+  parallel_for(10, n, mark_claimed, 1000);
+  for (size_t i = 0; i < n; ++i) TS_ASSERT_EQUALS(claimed[i], (size_t)(i >= 10));
+
+  TS_ASSERT_EQUALS(parallel_reduce(0, n, size_t(0), sum_index, sum_combine),
+                   n * (n - 1) / 2);
+  TS_ASSERT_EQUALS(parallel_reduce(5, 5, size_t(3), sum_index, sum_combine),
+                   (size_t)3);
+
+  std::vector<task_future<size_t> > futures;
+  for (size_t i = 0; i < 8; ++i) {
+    futures.push_back(launch_task<size_t>(boost::bind(nested_sum, 1000 * i)));
+  }
+  for (size_t i = 0; i < futures.size(); ++i) {
+    size_t m = 1000 * i;
+    TS_ASSERT_EQUALS(futures[i].get(), m == 0 ? 0 : m * (m - 1) / 2);
+    TS_ASSERT(futures[i].ready());
+  }
+}
 
 
 
@@ -170,4 +252,12 @@ public:
     test_pool_exception_forwarding();
   }
 
+  void test_guided_chunk_dispenser(void) {
+    test_guided_dispenser();
+  }
+
+  void test_task_runtime(void) {
+    test_task_runtime_loops();
+  }
+
 };
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include <boost/bind.hpp>
+#include <graphlab/util/tracepoint.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/macros_def.hpp>
+using namespace graphlab;
+
+void record_values(trace_histogram* tracer, size_t offset) {
+  for (size_t i = 1; i <= 1000; ++i) tracer->incorporate(i + offset);
+}
+
+class TraceHistogramTestSuite : public CxxTest::TestSuite {
+public:
+  void test_buckets(void) {
+    // every value is held by its bucket, within the bucket resolution
+    for (unsigned long long v = 0; v < 100000; v = v * 3 / 2 + 1) {
+      size_t b = trace_histogram_snapshot::bucket_of(v);
+      unsigned long long upper = trace_histogram_snapshot::bucket_upper_bound(b);
+      TS_ASSERT_LESS_THAN(b, TRACE_HISTOGRAM_BUCKETS);
+      TS_ASSERT_LESS_THAN_EQUALS(v, upper);
+      TS_ASSERT_LESS_THAN_EQUALS(upper - v, v / TRACE_HISTOGRAM_SUB_BUCKETS);
+      if (b > 0) {
+        TS_ASSERT_LESS_THAN(trace_histogram_snapshot::bucket_upper_bound(b - 1), v);
+      }
+    }
+    TS_ASSERT_EQUALS(trace_histogram_snapshot::bucket_of(~0ULL),
+                     TRACE_HISTOGRAM_BUCKETS - 1);
+  }
+
+  void test_percentiles(void) {
+    trace_histogram_snapshot s;
+    TS_ASSERT_EQUALS(s.percentile(0.5), 0ULL);
+    for (size_t i = 1; i <= 1000; ++i) s.incorporate(i);
+    TS_ASSERT_EQUALS(s.count, 1000ULL);
+    TS_ASSERT_EQUALS(s.minimum, 1ULL);
+    TS_ASSERT_EQUALS(s.maximum, 1000ULL);
+    TS_ASSERT_DELTA(s.mean(), 500.5, 1e-9);
+    TS_ASSERT_EQUALS(s.percentile(0), 1ULL);
+    TS_ASSERT_EQUALS(s.percentile(1), 1000ULL);
+    TS_ASSERT_DELTA((double)s.percentile(0.5), 500, 500.0 / 16);
+    TS_ASSERT_DELTA((double)s.percentile(0.99), 990, 990.0 / 16);
+  }
+
+  void test_threads(void) {
+    trace_histogram tracer("test", "", false);
+    thread_group group;
+    for (size_t i = 0; i < 4; ++i) {
+      group.launch(boost::bind(record_values, &tracer, 1000 * i));
+    }
+    group.join();
+    record_values(&tracer, 4000);
+    trace_histogram_snapshot s = tracer.snapshot();
+    TS_ASSERT_EQUALS(s.count, 5000ULL);
+    TS_ASSERT_EQUALS(s.minimum, 1ULL);
+    TS_ASSERT_EQUALS(s.maximum, 5000ULL);
+    TS_ASSERT_DELTA((double)s.percentile(0.5), 2500, 2500.0 / 16);
+  }
+};
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cxxtest/TestSuite.h>
+#include <graphlab/engine/vertex_state_array.hpp>
+using namespace graphlab;
+
+class VertexStateArrayTestSuite : public CxxTest::TestSuite {
+public:
+  void test_lazy_chunks(void) {
+    vertex_state_array<double, 4> arr;
+    arr.resize(100);
+    TS_ASSERT_EQUALS(arr.size(), 100);
+    TS_ASSERT_EQUALS(arr.allocated_bytes(), 7 * sizeof(double*));
+    // reads and resets do not allocate
+    TS_ASSERT_EQUALS(arr.get(50), 0.0);
+    arr.reset(50);
+    TS_ASSERT_EQUALS(arr.allocated_bytes(), 7 * sizeof(double*));
+    // a write allocates only its chunk
+    arr[50] = 2.0;
+    arr[51] += 1.0;
+    TS_ASSERT_EQUALS(arr.get(50), 2.0);
+    TS_ASSERT_EQUALS(arr.get(51), 1.0);
+    TS_ASSERT_EQUALS(arr.get(49), 0.0);
+    TS_ASSERT_EQUALS(arr.allocated_bytes(),
+                     16 * sizeof(double) + 7 * sizeof(double*));
+    arr.reset(50);
+    TS_ASSERT_EQUALS(arr.get(50), 0.0);
+    TS_ASSERT_EQUALS(arr.get(51), 1.0);
+    // release frees every chunk
+    arr.release();
+    TS_ASSERT_EQUALS(arr.get(51), 0.0);
+    TS_ASSERT_EQUALS(arr.allocated_bytes(), 7 * sizeof(double*));
+    arr[99] = 3.0;
+    TS_ASSERT_EQUALS(arr.get(99), 3.0);
+    arr.resize(10);
+    TS_ASSERT_EQUALS(arr.get(9), 0.0);
+  }
+
+  void test_empty_state(void) {
+    vertex_state_storage<empty>::type arr;
+    arr.resize(1000);
+    TS_ASSERT_EQUALS(arr.size(), 1000);
+    TS_ASSERT(!arr.empty());
+    arr[10] += empty();
+    arr.reset(10);
+    arr.release();
+    TS_ASSERT_EQUALS(arr.allocated_bytes(), sizeof(empty));
+  }
+};
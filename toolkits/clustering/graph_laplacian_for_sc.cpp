@@ -31,6 +31,8 @@
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/spirit/include/phoenix_stl.hpp>
 
+#include <Eigen/Dense>
+
 #include <graphlab.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
 
@@ -44,15 +46,19 @@ size_t number_of_nearest_neighbors= 20;
 struct vertex_data {
   std::vector<float> x;
   float D_ii;
-  vertex_data():x(), D_ii(0.0) {};
+  //the rows of the eigensolver blocks, and the assigned cluster
+  std::vector<double> blocks;
+  size_t cluster;
+  vertex_data():x(), D_ii(0.0), cluster(0) {};
   explicit vertex_data(const std::vector<float>& x_in) :
-      x(x_in), D_ii(0.0) {}
+      x(x_in), D_ii(0.0), cluster(0) {}
 
   void save(graphlab::oarchive& oarc) const {
     oarc << x.size();
     for(size_t i=0;i<x.size();++i)
       oarc << x[i];
     oarc << D_ii;
+    oarc << blocks << cluster;
   }
 
   void load(graphlab::iarchive& iarc) {
@@ -64,6 +70,7 @@ struct vertex_data {
       x.push_back(temp);
     }
     iarc >> D_ii;
+    iarc >> blocks >> cluster;
   }
 };
 
@@ -351,6 +358,352 @@ public:
   }
 };
 
+/*
+ * In-process eigen decomposition and k-means (--clusters).
+ *
+ * Instead of writing the Laplacian and calling the svd,
+ * eigen_vector_normalization and kmeans programs, the top eigenvectors
+ * of M = I + D^-1/2 A D^-1/2 are computed on the graph by LOBPCG
+ * (Knyazev, 2001), and the normalized rows are clustered by k-means on
+ * the same graph.
+ *
+ * Each vertex holds its rows of the blocks X (the Ritz vectors), R (the
+ * residuals) and P (the previous directions) followed by their products
+ * with M, each of num_clusters columns. One iteration multiplies R by M
+ * in a single engine run, and reduces the Gram matrices S^T S and
+ * S^T M S of S = [X R P] in a single map_reduce_vertices. The
+ * Rayleigh-Ritz problem on S is then solved on every machine.
+ */
+size_t num_clusters = 0;
+double eigen_tolerance = 1e-4;
+size_t eigen_max_iterations = 200;
+size_t kmeans_max_iterations = 100;
+
+enum { BLOCK_X, BLOCK_R, BLOCK_P, BLOCK_MX, BLOCK_MR, BLOCK_MP, NUM_BLOCKS };
+
+inline double& block_entry(vertex_data& vdata, size_t block, size_t col) {
+  return vdata.blocks[block * num_clusters + col];
+}
+inline double block_entry(const vertex_data& vdata, size_t block, size_t col) {
+  return vdata.blocks[block * num_clusters + col];
+}
+
+//a sum of vectors of the same length. Empty is zero.
+struct vector_sum {
+  std::vector<double> values;
+  vector_sum() { }
+  explicit vector_sum(size_t n) : values(n, 0.0) { }
+  vector_sum& operator+=(const vector_sum& other) {
+    if (values.empty()) {
+      values = other.values;
+    } else {
+      for (size_t i = 0; i < other.values.size(); ++i)
+        values[i] += other.values[i];
+    }
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const {
+    oarc << values;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> values;
+  }
+};
+
+//the blocks multiplied by block_spmv
+size_t spmv_source = BLOCK_X;
+size_t spmv_target = BLOCK_MX;
+
+//multiply the source block by M = I + D^-1/2 A D^-1/2 into the target block
+class block_spmv: public graphlab::ivertex_program<graph_type,
+    vector_sum>, public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  vector_sum gather(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+    const vertex_data& other = edge.source().id() == vertex.id() ?
+        edge.target().data() : edge.source().data();
+    vector_sum ret(num_clusters);
+    for (size_t j = 0; j < num_clusters; ++j)
+      ret.values[j] = edge.data().A_ij * block_entry(other, spmv_source, j);
+    return ret;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+      const gather_type& total) {
+    for (size_t j = 0; j < num_clusters; ++j) {
+      block_entry(vertex.data(), spmv_target, j) =
+          block_entry(vertex.data(), spmv_source, j) +
+          (total.values.empty() ? 0.0 : total.values[j]);
+    }
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+      return graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+  }
+};
+
+void initialize_blocks(graph_type::vertex_type& v) {
+  v.data().blocks.assign(NUM_BLOCKS * num_clusters, 0.0);
+  for (size_t j = 0; j < num_clusters; ++j)
+    block_entry(v.data(), BLOCK_X, j) = graphlab::random::gaussian();
+}
+
+//S^T S and S^T M S, stored row major in one vector
+vector_sum gram_matrices(const graph_type::vertex_type& v) {
+  const size_t n = 3 * num_clusters;
+  const double* s = &v.data().blocks[0];
+  const double* ms = s + n;
+  vector_sum ret(2 * n * n);
+  for (size_t a = 0; a < n; ++a) {
+    for (size_t b = 0; b < n; ++b) {
+      ret.values[a * n + b] = s[a] * s[b];
+      ret.values[n * n + a * n + b] = s[a] * ms[b];
+    }
+  }
+  return ret;
+}
+
+//the Ritz vectors in the basis of S, and their Ritz values
+Eigen::MatrixXd ritz_coefficients;
+Eigen::VectorXd ritz_values;
+
+/*
+ * Solves S^T M S c = theta S^T S c for the largest theta. The
+ * directions of S which are (nearly) linearly dependent are dropped first,
+ * which also drops R and P while they are zero.
+ */
+void rayleigh_ritz(const vector_sum& gram) {
+  const size_t n = 3 * num_clusters;
+  Eigen::MatrixXd sts(n, n), stms(n, n);
+  for (size_t a = 0; a < n; ++a) {
+    for (size_t b = 0; b < n; ++b) {
+      sts(a, b) = gram.values[a * n + b];
+      stms(a, b) = gram.values[n * n + a * n + b];
+    }
+  }
+  stms = 0.5 * (stms + stms.transpose());
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> basis(sts);
+  const double max_eigenvalue = basis.eigenvalues().maxCoeff();
+  std::vector<size_t> kept;
+  for (size_t i = 0; i < n; ++i) {
+    if (basis.eigenvalues()(i) > 1e-10 * max_eigenvalue) kept.push_back(i);
+  }
+  if (kept.size() < num_clusters) {
+    logstream(LOG_FATAL) << "The Laplacian has rank lower than the number "
+                         << "of clusters" << std::endl;
+  }
+  Eigen::MatrixXd orth(n, kept.size());
+  for (size_t i = 0; i < kept.size(); ++i) {
+    orth.col(i) = basis.eigenvectors().col(kept[i]) /
+        std::sqrt(basis.eigenvalues()(kept[i]));
+  }
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd>
+      reduced(orth.transpose() * stms * orth);
+  // the eigenvalues are sorted in increasing order
+  ritz_coefficients.resize(n, num_clusters);
+  ritz_values.resize(num_clusters);
+  for (size_t j = 0; j < num_clusters; ++j) {
+    const size_t col = kept.size() - 1 - j;
+    ritz_coefficients.col(j) = orth * reduced.eigenvectors().col(col);
+    ritz_values(j) = reduced.eigenvalues()(col);
+  }
+}
+
+//X = S C, P = [R P] C_RP, and the same for MS. Then R = MX - X theta.
+void update_blocks(graph_type::vertex_type& v) {
+  const size_t k = num_clusters;
+  const size_t n = 3 * k;
+  std::vector<double>& blocks = v.data().blocks;
+  std::vector<double> updated(blocks.size(), 0.0);
+  for (size_t j = 0; j < k; ++j) {
+    for (size_t a = 0; a < n; ++a) {
+      const double c = ritz_coefficients(a, j);
+      if (a < k) {
+        updated[BLOCK_X * k + j] += c * blocks[a];
+        updated[BLOCK_MX * k + j] += c * blocks[n + a];
+      } else {
+        updated[BLOCK_P * k + j] += c * blocks[a];
+        updated[BLOCK_MP * k + j] += c * blocks[n + a];
+      }
+    }
+    updated[BLOCK_X * k + j] += updated[BLOCK_P * k + j];
+    updated[BLOCK_MX * k + j] += updated[BLOCK_MP * k + j];
+    updated[BLOCK_R * k + j] = updated[BLOCK_MX * k + j] -
+        ritz_values(j) * updated[BLOCK_X * k + j];
+  }
+  blocks.swap(updated);
+}
+
+vector_sum residual_norms(const graph_type::vertex_type& v) {
+  vector_sum ret(num_clusters);
+  for (size_t j = 0; j < num_clusters; ++j) {
+    const double r = block_entry(v.data(), BLOCK_R, j);
+    ret.values[j] = r * r;
+  }
+  return ret;
+}
+
+//returns the number of iterations
+size_t compute_eigen_vectors(graphlab::distributed_control& dc,
+    graph_type& graph, graphlab::command_line_options& clopts) {
+  graph.transform_vertices(initialize_blocks);
+  graphlab::omni_engine<block_spmv> engine(dc, graph, "sync", clopts);
+  spmv_source = BLOCK_X;
+  spmv_target = BLOCK_MX;
+  engine.signal_all();
+  engine.start();
+  spmv_source = BLOCK_R;
+  spmv_target = BLOCK_MR;
+  size_t iter = 0;
+  while (iter < eigen_max_iterations) {
+    rayleigh_ritz(graph.map_reduce_vertices<vector_sum>(gram_matrices));
+    graph.transform_vertices(update_blocks);
+    ++iter;
+    const std::vector<double> norms =
+        graph.map_reduce_vertices<vector_sum>(residual_norms).values;
+    const double max_norm = sqrt(*std::max_element(norms.begin(), norms.end()));
+    dc.cout() << "LOBPCG iteration " << iter << ": largest eigenvalue "
+        << ritz_values(0) << ", max residual " << max_norm << "\n";
+    if (max_norm < eigen_tolerance) break;
+    engine.signal_all();
+    engine.start();
+  }
+  return iter;
+}
+
+//normalize the rows of the eigen vectors to unit length
+void normalize_rows(graph_type::vertex_type& v) {
+  double sum = 0.0;
+  for (size_t j = 0; j < num_clusters; ++j)
+    sum += block_entry(v.data(), BLOCK_X, j) * block_entry(v.data(), BLOCK_X, j);
+  if (sum <= 0.0) return;
+  sum = sqrt(sum);
+  for (size_t j = 0; j < num_clusters; ++j)
+    block_entry(v.data(), BLOCK_X, j) /= sum;
+}
+
+//k-means on the normalized rows. The centers are stored row major.
+std::vector<double> centers;
+size_t num_centers = 0;
+
+size_t nearest_center(const vertex_data& vdata, double& distance) {
+  size_t best = 0;
+  distance = std::numeric_limits<double>::max();
+  for (size_t c = 0; c < num_centers; ++c) {
+    double d = 0.0;
+    for (size_t j = 0; j < num_clusters; ++j) {
+      const double diff = block_entry(vdata, BLOCK_X, j) -
+          centers[c * num_clusters + j];
+      d += diff * diff;
+    }
+    if (d < distance) {
+      distance = d;
+      best = c;
+    }
+  }
+  return best;
+}
+
+//k-means++ seeding: a point drawn with probability proportional to its
+//squared distance to the nearest center, by the largest u^(1/d^2).
+struct weighted_choice {
+  double key;
+  std::vector<double> point;
+  weighted_choice(): key(-std::numeric_limits<double>::max()) { }
+  weighted_choice& operator+=(const weighted_choice& other) {
+    if (other.key > key) *this = other;
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const {
+    oarc << key << point;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> key >> point;
+  }
+};
+
+weighted_choice choose_center(const graph_type::vertex_type& v) {
+  weighted_choice ret;
+  double distance = 1.0;
+  if (num_centers > 0) nearest_center(v.data(), distance);
+  if (distance <= 0.0) return ret;
+  ret.key = log(graphlab::random::rand01()) / distance;
+  ret.point.assign(v.data().blocks.begin() + BLOCK_X * num_clusters,
+                   v.data().blocks.begin() + (BLOCK_X + 1) * num_clusters);
+  return ret;
+}
+
+//the sums and counts of the points of each cluster, and the number of
+//points changing cluster
+vector_sum cluster_sums(const graph_type::vertex_type& v) {
+  vector_sum ret(num_centers * (num_clusters + 1) + 1);
+  double distance = 0.0;
+  const size_t c = nearest_center(v.data(), distance);
+  for (size_t j = 0; j < num_clusters; ++j)
+    ret.values[c * num_clusters + j] = block_entry(v.data(), BLOCK_X, j);
+  ret.values[num_centers * num_clusters + c] = 1.0;
+  ret.values.back() = (c != v.data().cluster);
+  return ret;
+}
+
+void assign_cluster(graph_type::vertex_type& v) {
+  double distance = 0.0;
+  v.data().cluster = nearest_center(v.data(), distance);
+}
+
+//returns the number of iterations
+size_t run_kmeans(graphlab::distributed_control& dc, graph_type& graph) {
+  centers.clear();
+  num_centers = 0;
+  graph.transform_vertices(normalize_rows);
+  for (size_t c = 0; c < num_clusters; ++c) {
+    const weighted_choice choice =
+        graph.map_reduce_vertices<weighted_choice>(choose_center);
+    // fewer distinct points than clusters
+    if (choice.point.empty()) break;
+    centers.insert(centers.end(), choice.point.begin(), choice.point.end());
+    ++num_centers;
+  }
+  size_t iter = 0;
+  while (iter < kmeans_max_iterations) {
+    const std::vector<double> sums =
+        graph.map_reduce_vertices<vector_sum>(cluster_sums).values;
+    graph.transform_vertices(assign_cluster);
+    ++iter;
+    const size_t changed = sums.back();
+    if (changed == 0) break;
+    for (size_t c = 0; c < num_centers; ++c) {
+      const double count = sums[num_centers * num_clusters + c];
+      if (count == 0.0) continue;
+      for (size_t j = 0; j < num_clusters; ++j)
+        centers[c * num_clusters + j] = sums[c * num_clusters + j] / count;
+    }
+    dc.cout() << "kmeans iteration " << iter << ": " << changed
+        << " points changed cluster\n";
+  }
+  return iter;
+}
+
+class cluster_writer {
+public:
+  std::string save_vertex(graph_type::vertex_type v) {
+    std::stringstream strm;
+    strm << v.id() << "\t" << v.data().cluster + 1 << "\n";
+    return strm.str();
+  }
+  std::string save_edge(graph_type::edge_type e) {
+    return "";
+  }
+};
+
 int main(int argc, char** argv) {
   std::cout << "construct graph Laplacian for spectral clustering.\n\n";
 
@@ -368,6 +721,16 @@ int main(int argc, char** argv) {
   clopts.attach_option("t-nearest", number_of_nearest_neighbors,
                       "Number of nearest neighbors (=t). Will use only the t-nearest similarities "
                       "for each datapoint. If set at 0, will use all similarities.");
+  clopts.attach_option("clusters", num_clusters,
+                       "If set, computes the eigen vectors and the k-means clustering "
+                       "with this number of clusters in process, and writes the "
+                       "result to [data].result instead of the graph Laplacian.");
+  clopts.attach_option("eigen-tol", eigen_tolerance,
+                       "With clusters, the residual norm at which LOBPCG stops.");
+  clopts.attach_option("eigen-max-iter", eigen_max_iterations,
+                       "With clusters, the maximum number of LOBPCG iterations.");
+  clopts.attach_option("kmeans-max-iter", kmeans_max_iterations,
+                       "With clusters, the maximum number of k-means iterations.");
   if(!clopts.parse(argc, argv)) return EXIT_FAILURE;
   if (datafile == "") {
     std::cout << "--data is not optional\n";
@@ -428,6 +791,26 @@ int main(int argc, char** argv) {
   time(&end);
 
   dc.cout() << "graph calculation time is " << (end - start) << " sec\n";
+
+  if (num_clusters > 0) {
+    if (num_clusters > data_num) {
+      dc.cout() << "--clusters must not exceed the number of data points\n";
+      return EXIT_FAILURE;
+    }
+    time(&start);
+    const size_t eigen_iterations = compute_eigen_vectors(dc, graph, clopts);
+    time(&end);
+    dc.cout() << "eigen decomposition time is " << (end - start) << " sec ("
+        << eigen_iterations << " iterations)\n";
+    time(&start);
+    const size_t kmeans_iterations = run_kmeans(dc, graph);
+    time(&end);
+    dc.cout() << "kmeans time is " << (end - start) << " sec ("
+        << kmeans_iterations << " iterations)\n";
+    graph.save(datafile + ".result", cluster_writer(), false, true, false, 1);
+    graphlab::mpi_tools::finalize();
+    return EXIT_SUCCESS;
+  }
   dc.cout() << "writing...\n";
 
   //write results
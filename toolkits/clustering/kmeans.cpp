@@ -54,6 +54,52 @@
 
 size_t NUM_CLUSTERS = 0;
 bool IS_SPARSE = false;
+// the mini-batch size, or 0 for the standard k-means
+size_t MINIBATCH = 0;
+// the probability of each point to be in a mini-batch
+double MINIBATCH_FRACTION = 1.0;
+
+// a sparse vector, as parallel arrays of feature ids and values
+// sorted by feature id
+struct sparse_vector {
+  std::vector<size_t> ids;
+  std::vector<double> values;
+
+  size_t size() const { return ids.size(); }
+
+  void clear() {
+    ids.clear();
+    values.clear();
+  }
+
+  // a map is already sorted by feature id
+  void assign(const std::map<size_t, double>& m) {
+    clear();
+    ids.reserve(m.size());
+    values.reserve(m.size());
+    for(std::map<size_t, double>::const_iterator iter = m.begin();
+        iter != m.end(); ++iter){
+      ids.push_back(iter->first);
+      values.push_back(iter->second);
+    }
+  }
+
+  std::map<size_t, double> to_map() const {
+    std::map<size_t, double> ret;
+    for (size_t i = 0;i < ids.size(); ++i) {
+      ret.insert(ret.end(), std::make_pair(ids[i], values[i]));
+    }
+    return ret;
+  }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << ids << values;
+  }
+
+  void load(graphlab::iarchive& iarc) {
+    iarc >> ids >> values;
+  }
+};
 
 struct cluster {
   cluster(): count(0), changed(false) { }
@@ -78,16 +124,20 @@ size_t KMEANS_INITIALIZATION;
 
 struct vertex_data{
   std::vector<double> point;
-  std::map<size_t, double> point_sparse;
+  sparse_vector point_sparse;
+  // the squared norm of the point
+  double norm;
   size_t best_cluster;
   double best_distance;
   bool changed;
 
   void save(graphlab::oarchive& oarc) const {
-    oarc << point << best_cluster << best_distance << changed << point_sparse;
+    oarc << point << best_cluster << best_distance << changed << point_sparse
+         << norm;
   }
   void load(graphlab::iarchive& iarc) {
-    iarc >> point >> best_cluster >> best_distance >> changed >> point_sparse;
+    iarc >> point >> best_cluster >> best_distance >> changed >> point_sparse
+         >> norm;
   }
 };
 
@@ -110,70 +160,40 @@ struct edge_data {
   }
 };
 
-// helper function to compute distance between points
-double sqr_distance(const std::vector<double>& a,
-                    const std::vector<double>& b) {
-  ASSERT_EQ(a.size(), b.size());
+// helper function to compute the squared norm of a vector
+double sqr_norm(const std::vector<double>& a) {
   double total = 0;
   for (size_t i = 0;i < a.size(); ++i) {
-    double d = a[i] - b[i];
-    total += d * d;
+    total += a[i] * a[i];
   }
   return total;
 }
 
-double sqr_distance(const std::map<size_t, double>& a,
-                    const std::map<size_t, double>& b) {
-  double total = 0.0;
-  for(std::map<size_t, double>::const_iterator iter = a.begin();
-      iter != a.end(); ++iter){
-    size_t id = (*iter).first;
-    double val = (*iter).second;
-    if(b.find(id) != b.end()){
-      double d = val - b.at(id);
-      total += d*d;
-    }else{
-      total += val * val;
-    }
-  }
-  for(std::map<size_t, double>::const_iterator iter = b.begin();
-      iter != b.end(); ++iter){
-    double val = (*iter).second;
-    if(a.find((*iter).first) == a.end()){
-      total += val * val;
-    }
+// helper function to compute the dot product of two arrays, with
+// four independent sums so that the loop vectorizes
+double dot_product(const double* a, const double* b, size_t n) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i = 0;
+  for (;i + 4 <= n; i += 4) {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
   }
+  for (;i < n; ++i) s0 += a[i] * b[i];
+  return (s0 + s1) + (s2 + s3);
+}
 
+// helper function to compute the dot product of two sparse vectors
+double dot_product(const sparse_vector& a, const sparse_vector& b) {
+  double total = 0;
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (a.ids[i] == b.ids[j]) total += a.values[i++] * b.values[j++];
+    else if (a.ids[i] < b.ids[j]) ++i;
+    else ++j;
+  }
   return total;
-
-////   cosine distance is better for sparse datapoints?
-//    double ip = 0.0;
-//    double lenA = 0.0;
-//    double lenB = 0.0;
-//    for(std::map<size_t, double>::const_iterator iter = a.begin();
-//        iter != a.end(); ++iter){
-//      size_t id = (*iter).first;
-//      double val = (*iter).second;
-//      if(b.find(id) != b.end()){
-//        ip += val * b.at(id);
-//      }
-//      lenA += val*val;
-//    }
-//
-//    if(ip == 0.0 || lenA == 0.0)
-//      return 1.0;
-//
-//    for(std::map<size_t, double>::const_iterator iter = b.begin();
-//        iter != b.end(); ++iter){
-//      double val = (*iter).second;
-//      lenB += val * val;
-//    }
-//
-//    if(lenB == 1.0)
-//      return 1.0;
-//
-//    return 1.0 - ip/(sqrt(lenA)*sqrt(lenB));
-
 }
 
 
@@ -224,6 +244,56 @@ std::map<size_t, double>& scale_vector(std::map<size_t, double>& a, double d) {
 }
 
 
+/*
+ * The cluster centers laid out for the distance computations: the
+ * dense centers as the rows of one DIMENSION wide matrix, the sparse
+ * ones as sorted sparse vectors, and the squared norms of both. The
+ * squared distance is then |x|^2 + |c|^2 - 2 x.c, where only the dot
+ * product depends on both the point and the center.
+ * Rebuilt by update_center_cache() whenever CLUSTERS change.
+ */
+size_t DIMENSION = 0;
+std::vector<double> CENTER_MATRIX;
+std::vector<sparse_vector> CENTER_SPARSE;
+std::vector<double> CENTER_NORMS;
+
+void update_center_cache() {
+  CENTER_NORMS.assign(NUM_CLUSTERS, 0);
+  if (IS_SPARSE) {
+    CENTER_SPARSE.resize(NUM_CLUSTERS);
+    for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
+      CENTER_SPARSE[i].assign(CLUSTERS[i].center_sparse);
+      CENTER_NORMS[i] = sqr_norm(CENTER_SPARSE[i].values);
+    }
+  }
+  else {
+    CENTER_MATRIX.assign(NUM_CLUSTERS * DIMENSION, 0);
+    for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
+      if (CLUSTERS[i].center.size() != DIMENSION) continue;
+      std::copy(CLUSTERS[i].center.begin(), CLUSTERS[i].center.end(),
+                CENTER_MATRIX.begin() + i * DIMENSION);
+      CENTER_NORMS[i] = sqr_norm(CLUSTERS[i].center);
+    }
+  }
+}
+
+// whether the cluster has a center: lost clusters do not
+bool has_center(size_t i) {
+  return CLUSTERS[i].center.size() > 0 || CLUSTERS[i].center_sparse.size() > 0;
+}
+
+// the squared distance between a point and the center of cluster i
+double center_sqr_distance(const vertex_data& v, size_t i) {
+  double xc = 0;
+  if (IS_SPARSE) xc = dot_product(v.point_sparse, CENTER_SPARSE[i]);
+  else if (DIMENSION > 0) {
+    xc = dot_product(&v.point[0], &CENTER_MATRIX[i * DIMENSION], DIMENSION);
+  }
+  // the cancellation may leave a tiny negative value
+  return std::max(0.0, v.norm + CENTER_NORMS[i] - 2 * xc);
+}
+
+
 typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
 
 graphlab::atomic<graphlab::vertex_id_type> NEXT_VID;
@@ -250,6 +320,7 @@ bool vertex_loader(graph_type& graph, const std::string& fname,
   vtx.best_cluster = (size_t)(-1);
   vtx.best_distance = std::numeric_limits<double>::infinity();
   vtx.changed = false;
+  vtx.norm = sqr_norm(vtx.point) + sqr_norm(vtx.point_sparse.values);
   graph.add_vertex(NEXT_VID.inc_ret_last(1), vtx);
   return true;
 }
@@ -260,6 +331,7 @@ bool vertex_loader_sparse(graph_type& graph, const std::string& fname,
   if (line.empty()) return true;
 
   vertex_data vtx;
+  std::map<size_t, double> features;
   boost::char_separator<char> sep(" ");
   boost::tokenizer< boost::char_separator<char> > tokens(line, sep);
   BOOST_FOREACH (const std::string& t, tokens) {
@@ -267,12 +339,14 @@ bool vertex_loader_sparse(graph_type& graph, const std::string& fname,
     if(pos > 0){
       size_t id = (size_t)std::atoi(t.substr(0, pos).c_str());
       double val = std::atof(t.substr(pos+1, t.length() - pos -1).c_str());
-      vtx.point_sparse.insert(std::make_pair(id, val));
+      features.insert(std::make_pair(id, val));
     }
   }
+  vtx.point_sparse.assign(features);
   vtx.best_cluster = (size_t)(-1);
   vtx.best_distance = std::numeric_limits<double>::infinity();
   vtx.changed = false;
+  vtx.norm = sqr_norm(vtx.point) + sqr_norm(vtx.point_sparse.values);
   graph.add_vertex(NEXT_VID.inc_ret_last(1), vtx);
   return true;
 }
@@ -301,6 +375,7 @@ bool vertex_loader_with_id(graph_type& graph, const std::string& fname,
   vtx.best_cluster = (size_t)(-1);
   vtx.best_distance = std::numeric_limits<double>::infinity();
   vtx.changed = false;
+  vtx.norm = sqr_norm(vtx.point) + sqr_norm(vtx.point_sparse.values);
   graph.add_vertex(id, vtx);
   return true;
 }
@@ -311,6 +386,7 @@ bool vertex_loader_with_id_sparse(graph_type& graph, const std::string& fname,
   if (line.empty()) return true;
 
   vertex_data vtx;
+  std::map<size_t, double> features;
   size_t id = 0;
   boost::char_separator<char> sep(" ");
   boost::tokenizer<boost::char_separator<char> > tokens(line, sep);
@@ -324,13 +400,15 @@ bool vertex_loader_with_id_sparse(graph_type& graph, const std::string& fname,
       if(pos > 0){
         size_t id = (size_t)std::atoi(t.substr(0, pos).c_str());
         double val = std::atof(t.substr(pos+1, t.length() - pos -1).c_str());
-        vtx.point_sparse.insert(std::make_pair(id, val));
+        features.insert(std::make_pair(id, val));
       }
     }
   }
+  vtx.point_sparse.assign(features);
   vtx.best_cluster = (size_t)(-1);
   vtx.best_distance = std::numeric_limits<double>::infinity();
   vtx.changed = false;
+  vtx.norm = sqr_norm(vtx.point) + sqr_norm(vtx.point_sparse.values);
   graph.add_vertex(id, vtx);
   return true;
 }
@@ -400,17 +478,7 @@ struct min_point_size_reducer: public graphlab::IS_POD_TYPE {
  * is smaller that its previous cluster assignment
  */
 void kmeans_pp_initialization(graph_type::vertex_type& v) {
-  double d = sqr_distance(v.data().point,
-                          CLUSTERS[KMEANS_INITIALIZATION].center);
-  if (v.data().best_distance > d) {
-    v.data().best_distance = d;
-    v.data().best_cluster = KMEANS_INITIALIZATION;
-  }
-}
-
-void kmeans_pp_initialization_sparse(graph_type::vertex_type& v) {
-  double d = sqr_distance(v.data().point_sparse,
-                          CLUSTERS[KMEANS_INITIALIZATION].center_sparse);
+  double d = center_sqr_distance(v.data(), KMEANS_INITIALIZATION);
   if (v.data().best_distance > d) {
     v.data().best_distance = d;
     v.data().best_cluster = KMEANS_INITIALIZATION;
@@ -467,11 +535,11 @@ struct random_sample_reducer {
 };
 
 struct random_sample_reducer_sparse{
-  std::map<size_t, double> vtx;
+  sparse_vector vtx;
   double weight;
 
   random_sample_reducer_sparse():weight(0) { }
-  random_sample_reducer_sparse(const std::map<size_t, double>& vtx,
+  random_sample_reducer_sparse(const sparse_vector& vtx,
                         double weight):vtx(vtx),weight(weight) { }
 
   static random_sample_reducer_sparse get_weight(const graph_type::vertex_type& v) {
@@ -511,30 +579,42 @@ struct random_sample_reducer_sparse{
 };
 
 
+// the squared distances of a point to the centers, one at a time
+struct direct_distance {
+  const vertex_data& vdata;
+  double operator()(size_t i) const { return center_sqr_distance(vdata, i); }
+};
+
+// the squared distances of a point to the centers from the dot products
+// of the point with the centers
+struct dot_product_distance {
+  const vertex_data& vdata;
+  const double* xc;
+  double operator()(size_t i) const {
+    return std::max(0.0, vdata.norm + CENTER_NORMS[i] - 2 * xc[i]);
+  }
+};
+
 /*
- * This transform vertices call is used during the 
- * actual k-means iteration. It computes distance to 
- * all "changed" clusters and reassigns itself if necessary
+ * Computes the distance of a point to all "changed" clusters and
+ * reassigns it if necessary.
  */
-void kmeans_iteration(graph_type::vertex_type& v) {
+template <typename Distance>
+void reassign_point(vertex_data& vdata, const Distance& distance) {
   // if current vertex's cluster was modified, we invalidate the distance.
   // and we need to recompute to all existing clusters
   // otherwise, we just need to recompute to changed cluster centers.
-  size_t prev_asg = v.data().best_cluster;
-  if (CLUSTERS[v.data().best_cluster].changed) {
+  size_t prev_asg = vdata.best_cluster;
+  if (CLUSTERS[vdata.best_cluster].changed) {
     // invalidate. recompute to all
-    v.data().best_cluster = (size_t)(-1);
-    v.data().best_distance = std::numeric_limits<double>::infinity();
+    vdata.best_cluster = (size_t)(-1);
+    vdata.best_distance = std::numeric_limits<double>::infinity();
     for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
-      if (CLUSTERS[i].center.size() > 0 || CLUSTERS[i].center_sparse.size() > 0) {
-        double d = 0.0;
-        if(IS_SPARSE == true)
-          d = sqr_distance(v.data().point_sparse, CLUSTERS[i].center_sparse);
-        else
-          d = sqr_distance(v.data().point, CLUSTERS[i].center);
-        if (d < v.data().best_distance) {
-          v.data().best_distance = d;
-          v.data().best_cluster = i;
+      if (has_center(i)) {
+        double d = distance(i);
+        if (d < vdata.best_distance) {
+          vdata.best_distance = d;
+          vdata.best_cluster = i;
         }
       }
     }
@@ -542,21 +622,60 @@ void kmeans_iteration(graph_type::vertex_type& v) {
   else {
     // just compute distance to what has changed
     for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
-      if (CLUSTERS[i].changed &&
-          (CLUSTERS[i].center.size() > 0 || CLUSTERS[i].center_sparse.size() > 0)) {
-        double d = 0.0;
-        if(IS_SPARSE == true)
-          d = sqr_distance(v.data().point_sparse, CLUSTERS[i].center_sparse);
-        else
-          d= sqr_distance(v.data().point, CLUSTERS[i].center);
-        if (d < v.data().best_distance) {
-          v.data().best_distance = d;
-          v.data().best_cluster = i;
+      if (CLUSTERS[i].changed && has_center(i)) {
+        double d = distance(i);
+        if (d < vdata.best_distance) {
+          vdata.best_distance = d;
+          vdata.best_cluster = i;
         }
       }
     }
   }
-  v.data().changed = (prev_asg != v.data().best_cluster);
+  vdata.changed = (prev_asg != vdata.best_cluster);
+}
+
+/*
+ * This transform vertices call is used during the 
+ * actual k-means iteration. It computes distance to 
+ * all "changed" clusters and reassigns itself if necessary
+ */
+void kmeans_iteration(graph_type::vertex_type& v) {
+  const direct_distance distance = {v.data()};
+  reassign_point(v.data(), distance);
+}
+
+// The number of points whose distances are computed together
+const size_t KMEANS_BLOCK_SIZE = 64;
+
+/*
+ * kmeans_iteration() for a block of points. The dot products of the
+ * dense points with the centers are computed as a matrix product, center
+ * by center, so that each center is read once per block rather than once
+ * per point.
+ */
+void kmeans_iteration_block(std::vector<graph_type::vertex_type>& block) {
+  if (IS_SPARSE || DIMENSION == 0) {
+    for (size_t j = 0; j < block.size(); ++j) kmeans_iteration(block[j]);
+    return;
+  }
+  bool all_centers = false;
+  for (size_t j = 0; j < block.size(); ++j) {
+    all_centers = all_centers || CLUSTERS[block[j].data().best_cluster].changed;
+  }
+  std::vector<double> xc(block.size() * NUM_CLUSTERS, 0);
+  for (size_t i = 0; i < NUM_CLUSTERS; ++i) {
+    if (!has_center(i) || !(all_centers || CLUSTERS[i].changed)) continue;
+    const double* center = &CENTER_MATRIX[i * DIMENSION];
+    for (size_t j = 0; j < block.size(); ++j) {
+      xc[j * NUM_CLUSTERS + i] =
+          dot_product(&block[j].data().point[0], center, DIMENSION);
+    }
+  }
+  for (size_t j = 0; j < block.size(); ++j) {
+    const dot_product_distance distance = {block[j].data(),
+                                           &xc[j * NUM_CLUSTERS]};
+    reassign_point(block[j].data(), distance);
+  }
 }
 
 //gathered information
@@ -622,12 +741,8 @@ public:
     vertex.data().best_cluster = (size_t) (-1);
     vertex.data().best_distance = std::numeric_limits<double>::infinity();
     for (size_t i = 0; i < NUM_CLUSTERS; ++i) {
-      if (CLUSTERS[i].center.size() > 0 || CLUSTERS[i].center_sparse.size() > 0) {
-        double d = 0.0;
-        if(IS_SPARSE == true)
-          d = sqr_distance(vertex.data().point_sparse, CLUSTERS[i].center_sparse);
-        else
-          d = sqr_distance(vertex.data().point, CLUSTERS[i].center);
+      if (has_center(i)) {
+        double d = center_sqr_distance(vertex.data(), i);
         //consider neighbors
         const std::map<size_t, double>& cw_map = total.cw_map;
         for (std::map<size_t, double>::const_iterator iter = cw_map.begin();
@@ -679,7 +794,7 @@ struct cluster_center_reducer {
     ASSERT_NE(v.data().best_cluster, (size_t)(-1));
 
     if(IS_SPARSE == true)
-      cc.new_clusters[v.data().best_cluster].center_sparse = v.data().point_sparse;
+      cc.new_clusters[v.data().best_cluster].center_sparse = v.data().point_sparse.to_map();
     else
       cc.new_clusters[v.data().best_cluster].center = v.data().point;
     cc.new_clusters[v.data().best_cluster].count = 1;
@@ -688,6 +803,33 @@ struct cluster_center_reducer {
     return cc;
   }
 
+  /*
+   * Each point is in the mini-batch with probability MINIBATCH_FRACTION,
+   * and then contributes to the center nearest to it.
+   */
+  static cluster_center_reducer get_minibatch_center(const graph_type::vertex_type& v) {
+    cluster_center_reducer cc;
+    if (!graphlab::random::bernoulli(MINIBATCH_FRACTION)) return cc;
+    size_t best_cluster = (size_t)(-1);
+    double best_distance = std::numeric_limits<double>::infinity();
+    for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
+      if (!has_center(i)) continue;
+      double d = center_sqr_distance(v.data(), i);
+      if (d < best_distance) {
+        best_distance = d;
+        best_cluster = i;
+      }
+    }
+    if (best_cluster == (size_t)(-1)) return cc;
+    if(IS_SPARSE == true)
+      cc.new_clusters[best_cluster].center_sparse = v.data().point_sparse.to_map();
+    else
+      cc.new_clusters[best_cluster].center = v.data().point;
+    cc.new_clusters[best_cluster].count = 1;
+    cc.cost = best_distance;
+    return cc;
+  }
+
   cluster_center_reducer& operator+=(const cluster_center_reducer& other) {
     for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
       if (new_clusters[i].count == 0) new_clusters[i] = other.new_clusters[i];
@@ -731,9 +873,9 @@ struct vertex_writer {
 struct vertex_writer_sparse {
   std::string save_vertex(graph_type::vertex_type v) {
     std::stringstream strm;
-    for(std::map<size_t, double>::iterator iter = v.data().point_sparse.begin();
-        iter != v.data().point_sparse.end();++iter){
-      strm << (*iter).first << ":" << (*iter).second << " ";
+    const sparse_vector& point = v.data().point_sparse;
+    for (size_t i = 0;i < point.size(); ++i) {
+      strm << point.ids[i] << ":" << point.values[i] << " ";
     }
     strm << v.data().best_cluster << "\n";
     strm.flush();
@@ -803,6 +945,11 @@ int main(int argc, char** argv) {
                        "[reward]. This mode must be used with --id option.");
   clopts.attach_option("max-iteration", MAX_ITERATION,
                        "The max number of iterations");
+  clopts.attach_option("minibatch", MINIBATCH,
+                       "If set, will run mini-batch k-means, updating the "
+                       "centers from about this many randomly sampled points "
+                       "per iteration, for --max-iteration iterations "
+                       "(default 100).");
 
   if(!clopts.parse(argc, argv)) return EXIT_FAILURE;
   if (datafile == "") {
@@ -818,6 +965,10 @@ int main(int argc, char** argv) {
       std::cout << "--id is not optional when you use edge data\n";
       return EXIT_FAILURE;
     }
+    if(MINIBATCH > 0){
+      std::cout << "--minibatch cannot be used with edge data\n";
+      return EXIT_FAILURE;
+    }
   }
 
   graphlab::mpi_tools::init(argc, argv);
@@ -865,6 +1016,7 @@ int main(int argc, char** argv) {
       return EXIT_FAILURE;
     }
     // allocate clusters
+    DIMENSION = max_p_size;
     for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
       CLUSTERS[i].center.resize(max_p_size);
     }
@@ -879,23 +1031,63 @@ int main(int argc, char** argv) {
     if(IS_SPARSE == true){
       random_sample_reducer_sparse rs = graph.map_reduce_vertices<random_sample_reducer_sparse>
                                         (random_sample_reducer_sparse::get_weight);
-      CLUSTERS[KMEANS_INITIALIZATION].center_sparse = rs.vtx;
-      graph.transform_vertices(kmeans_pp_initialization_sparse);
+      CLUSTERS[KMEANS_INITIALIZATION].center_sparse = rs.vtx.to_map();
     }else{
       random_sample_reducer rs = graph.map_reduce_vertices<random_sample_reducer>
                                         (random_sample_reducer::get_weight);
       CLUSTERS[KMEANS_INITIALIZATION].center = rs.vtx;
-      graph.transform_vertices(kmeans_pp_initialization);
     }
+    update_center_cache();
+    graph.transform_vertices(kmeans_pp_initialization);
   }
 
   // "reset" all clusters
   for (size_t i = 0; i < NUM_CLUSTERS; ++i) CLUSTERS[i].changed = true;
   // perform Kmeans iteration
 
-  dc.cout() << "Running Kmeans...\n";
   bool clusters_changed = true;
   size_t iteration_count = 0;
+  if (MINIBATCH > 0) {
+    dc.cout() << "Running mini-batch Kmeans...\n";
+    MINIBATCH_FRACTION = std::min(1.0, double(MINIBATCH) / graph.num_vertices());
+    const size_t num_batches = MAX_ITERATION > 0 ? MAX_ITERATION : 100;
+    for (size_t batch = 0; batch < num_batches; ++batch) {
+      cluster_center_reducer cc = graph.map_reduce_vertices<cluster_center_reducer>
+                                      (cluster_center_reducer::get_minibatch_center);
+      size_t batch_size = 0;
+      // move each center towards the mean of its batch points, with a
+      // rate of 1 / (number of points it has been given so far)
+      for (size_t i = 0;i < NUM_CLUSTERS; ++i) {
+        const size_t n = cc.new_clusters[i].count;
+        if (n == 0) continue;
+        batch_size += n;
+        CLUSTERS[i].count += n;
+        const double eta = 1.0 / CLUSTERS[i].count;
+        if(IS_SPARSE){
+          scale_vector(CLUSTERS[i].center_sparse, 1.0 - eta * n);
+          plus_equal_vector(CLUSTERS[i].center_sparse,
+                            scale_vector(cc.new_clusters[i].center_sparse, eta));
+        }else{
+          scale_vector(CLUSTERS[i].center, 1.0 - eta * n);
+          plus_equal_vector(CLUSTERS[i].center,
+                            scale_vector(cc.new_clusters[i].center, eta));
+        }
+      }
+      update_center_cache();
+      dc.cout() << "Mini-batch " << batch + 1 << ": " << batch_size
+                << " points, batch cost: " << cc.cost << std::endl;
+    }
+    // a final pass assigns every point to its nearest center
+    for (size_t i = 0; i < NUM_CLUSTERS; ++i) CLUSTERS[i].changed = true;
+    graph.transform_vertex_blocks(kmeans_iteration_block, KMEANS_BLOCK_SIZE);
+    cluster_center_reducer cc = graph.map_reduce_vertices<cluster_center_reducer>
+                                    (cluster_center_reducer::get_center);
+    dc.cout() << "Mini-batch Kmeans total cost: " << cc.cost << std::endl;
+    clusters_changed = false;
+  }
+  else {
+    dc.cout() << "Running Kmeans...\n";
+  }
   while(clusters_changed) {
 		if(MAX_ITERATION > 0 && iteration_count >= MAX_ITERATION)
 			break;
@@ -939,6 +1131,7 @@ int main(int argc, char** argv) {
       }
     }
     clusters_changed = iteration_count == 0 || cc.num_changed > 0;
+    update_center_cache();
 
     if(edgedata_file.size() > 0){
       clopts.engine_args.set_option("factorized", true);
@@ -946,7 +1139,7 @@ int main(int argc, char** argv) {
       engine.signal_all();
       engine.start();
     }else{
-      graph.transform_vertices(kmeans_iteration);
+      graph.transform_vertex_blocks(kmeans_iteration_block, KMEANS_BLOCK_SIZE);
     }
 
     ++iteration_count;
@@ -296,6 +296,7 @@ int main(int argc, char** argv) {
   float epsilon = 0.0;
   size_t pre_kmeans_clusters = 0;
   size_t sv = 0;
+  bool in_process = false;
   //parse command line
   graphlab::command_line_options clopts(
           "Spectral clustering. The input data file is provided by the "
@@ -329,6 +330,10 @@ int main(int argc, char** argv) {
           "For example, --mpi-args=\"-n [N machines] --hostfile [host file]\"");
   clopts.attach_option("sv", sv,
           "Number of vectors in each iteration in the Lanczos svd.");
+  clopts.attach_option("in-process", in_process,
+          "If set, the eigen decomposition and kmeans are computed by "
+          "graph_laplacian_for_sc on the graph Laplacian in memory, without "
+          "calling svd, eigen_vector_normalization and kmeans.");
   if (!clopts.parse(argc, argv))
     return EXIT_FAILURE;
   if (datafile == "") {
@@ -352,6 +357,7 @@ int main(int argc, char** argv) {
   remove_opts.push_back("--t-nearest");
   remove_opts.push_back("--pre-kmeans-clusters");
   remove_opts.push_back("--sv");
+  remove_opts.push_back("--in-process");
   std::string other_args = get_arg_str_without(argc, argv, remove_opts);
 
   //preprocess by kmeans for fast clustering
@@ -372,50 +378,63 @@ int main(int argc, char** argv) {
 
   //construct graph laplacian
   time(&mid);
+  std::string laplacian_args = other_args;
+  if (in_process) {
+    std::stringstream strm;
+    strm << " --clusters=" << num_clusters << " " << other_args;
+    laplacian_args = strm.str();
+  }
   if (call_graph_laplacian_construction(mpi_args, datafile, sigma, epsilon,
-      num_nearests, other_args) == false) {
+      num_nearests, laplacian_args) == false) {
     return EXIT_FAILURE;
   }
   time(&end);
-  times.push_back(std::pair<std::string, time_t>("graph laplacian",(end - mid)));
-
-  //eigen value decomposition
-  //read number of data
-  size_t num_data = 0;
-  const std::string datanum_filename = datafile + ".datanum";
-  std::ifstream ifs(datanum_filename.c_str());
-  if (!ifs) {
-    std::cout << "can't read number of data." << std::endl;
-    return EXIT_FAILURE;
-  }
-  ifs >> num_data;
-  //determine the sv of Lanczos method
-  if(sv == 0){
-    sv = get_lanczos_rank(num_clusters, num_data);
-  }else{
-    if(sv < num_clusters)
-      sv = num_clusters;
-  }
-  time(&mid);
-  if (call_svd(mpi_args, datafile, svd_dir, num_clusters, sv, num_data,
-      other_args) == false) {
-    return EXIT_FAILURE;
-  }
-  if (call_eigen_vector_normalization(mpi_args, datafile, graph_analytics_dir,
-      num_clusters, sv, num_data, other_args) == false) {
-    return EXIT_FAILURE;
+  if (in_process) {
+    times.push_back(std::pair<std::string, time_t>(
+        "graph laplacian, eigen decomposition and kmeans",(end - mid)));
+  } else {
+    times.push_back(std::pair<std::string, time_t>("graph laplacian",(end - mid)));
   }
-  time(&end);
-  times.push_back(std::pair<std::string, time_t>("eigen decomposition",(end - mid)));
 
-  //run kmeans
-  time(&mid);
-  if (call_kmeans(mpi_args, datafile, kmeans_dir, num_clusters, other_args)
-      == false) {
-    return EXIT_FAILURE;
+  if (in_process == false) {
+    //eigen value decomposition
+    //read number of data
+    size_t num_data = 0;
+    const std::string datanum_filename = datafile + ".datanum";
+    std::ifstream ifs(datanum_filename.c_str());
+    if (!ifs) {
+      std::cout << "can't read number of data." << std::endl;
+      return EXIT_FAILURE;
+    }
+    ifs >> num_data;
+    //determine the sv of Lanczos method
+    if(sv == 0){
+      sv = get_lanczos_rank(num_clusters, num_data);
+    }else{
+      if(sv < num_clusters)
+        sv = num_clusters;
+    }
+    time(&mid);
+    if (call_svd(mpi_args, datafile, svd_dir, num_clusters, sv, num_data,
+        other_args) == false) {
+      return EXIT_FAILURE;
+    }
+    if (call_eigen_vector_normalization(mpi_args, datafile, graph_analytics_dir,
+        num_clusters, sv, num_data, other_args) == false) {
+      return EXIT_FAILURE;
+    }
+    time(&end);
+    times.push_back(std::pair<std::string, time_t>("eigen decomposition",(end - mid)));
+
+    //run kmeans
+    time(&mid);
+    if (call_kmeans(mpi_args, datafile, kmeans_dir, num_clusters, other_args)
+        == false) {
+      return EXIT_FAILURE;
+    }
+    time(&end);
+    times.push_back(std::pair<std::string, time_t>("kmeans",(end - mid)));
   }
-  time(&end);
-  times.push_back(std::pair<std::string, time_t>("kmeans",(end - mid)));
 
   //recover cluster membership if preprocess with kmeans was done
   if(pre_kmeans_clusters > 0){
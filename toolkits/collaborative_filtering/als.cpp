@@ -40,6 +40,7 @@
 
 // This file defines the serialization code for the eigen types.
 #include "eigen_serialization.hpp"
+#include "gram_block.hpp"
 
 #include <graphlab.hpp>
 #include <graphlab/util/stl_util.hpp>
@@ -52,6 +53,20 @@ const int SAFE_NEG_OFFSET = 2; //add 2 to negative node id
 
 
 
+#ifdef ALS_FIXED_D
+/**
+ * \brief When the number of latent values is known at compile time
+ * (for instance with -DALS_FIXED_D=20) fixed size eigen types are
+ * used, so that the vertex data and the gathers need no heap
+ * allocation. The D option must then be ALS_FIXED_D.
+ */
+typedef Eigen::Matrix<double, ALS_FIXED_D, 1, Eigen::DontAlign> vec_type;
+typedef Eigen::Matrix<double, ALS_FIXED_D, ALS_FIXED_D, Eigen::DontAlign>
+    mat_type;
+/** \brief The upper triangle of a mat_type packed row by row */
+typedef Eigen::Matrix<double, ALS_FIXED_D * (ALS_FIXED_D + 1) / 2, 1,
+                      Eigen::DontAlign> packed_mat_type;
+#else
 /**
  * \brief We use the eigen library's vector type to represent
  * mathematical vectors.
@@ -64,6 +79,11 @@ typedef Eigen::VectorXd vec_type;
  */
 typedef Eigen::MatrixXd mat_type;
 
+/** \brief The upper triangle of a mat_type packed row by row */
+typedef Eigen::VectorXd packed_mat_type;
+#endif
+
+
 
 
 
@@ -100,16 +120,22 @@ struct vertex_data {
   void randomize() { factor.resize(NLATENT); factor.setRandom(); }
   /** \brief Save the vertex data to a binary archive */
   void save(graphlab::oarchive& arc) const { 
-    arc << nupdates << residual << factor;        
+    arc << nupdates << residual;
+    save_vector(arc, factor);
   }
   /** \brief Load the vertex data from a binary archive */
   void load(graphlab::iarchive& arc) { 
-    arc >> nupdates >> residual >> factor;
+    arc >> nupdates >> residual;
+    load_vector(arc, factor);
   }
 }; // end of vertex data
 
 
+#ifdef ALS_FIXED_D
+size_t vertex_data::NLATENT = ALS_FIXED_D;
+#else
 size_t vertex_data::NLATENT = 20;
+#endif
 
 /**
  * \brief The edge data stores the entry in the matrix.
@@ -147,6 +173,7 @@ struct edge_data : public graphlab::IS_POD_TYPE {
 typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
 
 #include "implicit.hpp"
+#include "topk.hpp"
 
 stats_info count_edges(const graph_type::edge_type & edge){
   stats_info ret;
@@ -191,54 +218,84 @@ get_other_vertex(graph_type::edge_type& edge,
  * added. The gather type represents that tuple and provides the
  * necessary gather_type::operator+= operation.
  *
+ * Since XtX is symmetric only its upper triangle is stored, packed,
+ * which halves the size of the gathers in memory and on the wire.
  */
 class gather_type {
 public:
   /**
-   * \brief Stores the current sum of nbr.factor.transpose() *
-   * nbr.factor
+   * \brief Stores the upper triangle of the current sum of
+   * nbr.factor.transpose() * nbr.factor, packed row by row
    */
-  mat_type XtX;
+  packed_mat_type XtX;
 
   /**
    * \brief Stores the current sum of nbr.factor * edge.obs
    */
   vec_type Xy;
 
+  /** \brief True until a neighbor is added */
+  bool empty;
+
   /** \brief basic default constructor */
-  gather_type() { }
+  gather_type() : empty(true) { }
 
   /**
    * \brief This constructor computes XtX and Xy and stores the result
    * in XtX and Xy
    */
   gather_type(const vec_type& X, const double y) :
-    XtX(X.size(), X.size()), Xy(X.size()) {
-    XtX.triangularView<Eigen::Upper>() = X * X.transpose();
+    XtX(X.size() * (X.size() + 1) / 2), Xy(X.size()), empty(false) {
+    size_t k = 0;
+    for(int i = 0; i < X.size(); ++i)
+      for(int j = i; j < X.size(); ++j) XtX[k++] = X[i] * X[j];
     Xy = X * y;
   } // end of constructor for gather type
 
+  /**
+   * \brief Packs the sums accumulated by a gather_batch
+   */
+  explicit gather_type(const gram_block& block) :
+    XtX(block.sum_Xy().size() * (block.sum_Xy().size() + 1) / 2),
+    Xy(block.sum_Xy()), empty(false) {
+    const Eigen::MatrixXd& upper = block.upper_XtX();
+    size_t k = 0;
+    for(int i = 0; i < upper.rows(); ++i)
+      for(int j = i; j < upper.cols(); ++j) XtX[k++] = upper(i, j);
+  } // end of constructor from a gram_block
+
+  /** \brief Fills the upper triangle of mat with XtX */
+  void unpack_XtX(mat_type& mat) const {
+    const int d = Xy.size();
+    mat.resize(d, d);
+    size_t k = 0;
+    for(int i = 0; i < d; ++i)
+      for(int j = i; j < d; ++j) mat(i, j) = XtX[k++];
+  } // end of unpack_XtX
+
   /** \brief Save the values to a binary archive */
-  void save(graphlab::oarchive& arc) const { arc << XtX << Xy; }
+  void save(graphlab::oarchive& arc) const {
+    arc << empty;
+    if(!empty) { save_vector(arc, XtX); save_vector(arc, Xy); }
+  }
 
   /** \brief Read the values from a binary archive */
-  void load(graphlab::iarchive& arc) { arc >> XtX >> Xy; }  
+  void load(graphlab::iarchive& arc) {
+    arc >> empty;
+    if(!empty) { load_vector(arc, XtX); load_vector(arc, Xy); }
+  }
 
   /** 
    * \brief Computes XtX += other.XtX and Xy += other.Xy updating this
    * tuples value
    */
   gather_type& operator+=(const gather_type& other) {
-    if(other.Xy.size() == 0) {
-      ASSERT_EQ(other.XtX.rows(), 0);
-      ASSERT_EQ(other.XtX.cols(), 0);
-    } else {
-      if(Xy.size() == 0) {
-        ASSERT_EQ(XtX.rows(), 0); 
-        ASSERT_EQ(XtX.cols(), 0);
-        XtX = other.XtX; Xy = other.Xy;
+    if(!other.empty) {
+      if(empty) {
+        XtX = other.XtX; Xy = other.Xy; empty = false;
       } else {
-        XtX.triangularView<Eigen::Upper>() += other.XtX;  
+        ASSERT_EQ(XtX.size(), other.XtX.size());
+        XtX += other.XtX;
         Xy += other.Xy;
       }
     }
@@ -306,6 +363,24 @@ public:
     } else return gather_type();
   } // end of gather function
 
+  /**
+   * Gathers all the TRAIN edges of one direction with blocked rank-k
+   * updates (see gram_block) instead of one rank-1 update per edge.
+   */
+  bool gather_batch(icontext_type& context, const vertex_type& vertex,
+                    const local_edge_span_type& edges,
+                    gather_type& accum) const {
+    gram_block block(vertex.data().factor.size());
+    for(size_t i = 0; i < edges.size(); ++i) {
+      const edge_data& edata = edges.edge_data(i);
+      if(edata.role == edge_data::TRAIN)
+        block.add(edges.neighbor_data(i).factor, edata.obs);
+    }
+    block.flush();
+    if(!block.empty()) accum = gather_type(block);
+    return true;
+  } // end of gather_batch
+
   /** apply collects the sum of XtX and Xy */
   void apply(icontext_type& context, vertex_type& vertex,
              const gather_type& sum) {
@@ -313,9 +388,10 @@ public:
     vertex_data& vdata = vertex.data(); 
     // Determine the number of neighbors.  Each vertex has only in or
     // out edges depending on which side of the graph it is located
-    if(sum.Xy.size() == 0) { vdata.residual = 0; ++vdata.nupdates; return; }
-    mat_type XtX = sum.XtX;
-    vec_type Xy = sum.Xy;
+    if(sum.empty) { vdata.residual = 0; ++vdata.nupdates; return; }
+    mat_type XtX;
+    sum.unpack_XtX(XtX);
+    const vec_type& Xy = sum.Xy;
     // Add regularization
     double regularization = LAMBDA;
     if (REGNORMAL)
@@ -323,8 +399,13 @@ public:
     for(int i = 0; i < XtX.rows(); ++i) 
       XtX(i,i) += regularization; 
     // Solve the least squares problem using eigen ----------------------------
+    // With regularization XtX is positive definite and a Cholesky
+    // factorization, which does not pivot, is enough. Fall back to the
+    // pivoting LDLT when it is only semi definite.
     const vec_type old_factor = vdata.factor;
-    vdata.factor = XtX.selfadjointView<Eigen::Upper>().ldlt().solve(Xy);
+    const Eigen::LLT<mat_type, Eigen::Upper> llt(XtX);
+    if (llt.info() == Eigen::Success) vdata.factor = llt.solve(Xy);
+    else vdata.factor = XtX.selfadjointView<Eigen::Upper>().ldlt().solve(Xy);
     // Compute the residual change in the factor factor -----------------------
     vdata.residual = (vdata.factor - old_factor).cwiseAbs().sum() / XtX.rows();
     ++vdata.nupdates;
@@ -371,6 +452,11 @@ public:
 
 
 
+/** \brief The latent vector of a vertex, for the top-K recommendations */
+struct topk_factor {
+  Eigen::VectorXd operator()(const vertex_data& vdata) const { return vdata.factor; }
+};
+
 /**
  * \brief The graph loader function is a line parser used for
  * distributed graph construction.
@@ -553,6 +639,32 @@ struct linear_model_saver_V {
   }
 }; 
 
+/*
+ * Writes the linear model of the users (U) or of the items (V) with
+ * graph.save_columns(), as an id column then one column per factor,
+ * without formatting any text.
+ */
+struct linear_model_column_writer {
+  typedef graph_type::vertex_type vertex_type;
+  typedef graph_type::edge_type   edge_type;
+  bool users;
+  linear_model_column_writer(bool users = true) : users(users) { }
+  void vertex_columns(graphlab::column_schema& schema) const {
+    schema.add<graphlab::vertex_id_type>("id");
+    for (uint i=0; i< vertex_data::NLATENT; i++)
+      schema.add<double>("factor" + boost::lexical_cast<std::string>(i));
+  }
+  void save_vertex(const vertex_type& vertex, graphlab::column_row& row) const {
+    if ((vertex.num_out_edges() > 0) != users) return;
+    if (users) row << vertex.id();
+    else row << graphlab::vertex_id_type(-vertex.id()-SAFE_NEG_OFFSET);
+    for (uint i=0; i< vertex_data::NLATENT; i++)
+      row << double(vertex.data().factor[i]);
+  }
+  void edge_columns(graphlab::column_schema& schema) const { }
+  void save_edge(const edge_type& edge, graphlab::column_row& row) const { }
+};
+
 
 
 /**
@@ -577,6 +689,8 @@ int main(int argc, char** argv) {
   std::string predictions;
   size_t interval = 10;
   std::string exec_type = "synchronous";
+  std::string lambda_sweep;
+  bool columnar_model = false;
   clopts.attach_option("matrix", input_dir,
                        "The directory containing the matrix file");
   clopts.add_positional("matrix");
@@ -586,6 +700,11 @@ int main(int argc, char** argv) {
                        "The maxumum number of udpates allowed for a vertex");
   clopts.attach_option("lambda", als_vertex_program::LAMBDA, 
                        "ALS regularization weight"); 
+  clopts.attach_option("lambda_sweep", lambda_sweep,
+                       "A comma separated list of regularization weights. "
+                       "ALS is run once for each, from the same initial "
+                       "factors, without reloading the graph, before the "
+                       "final run with --lambda.");
   clopts.attach_option("tol", als_vertex_program::TOLERANCE,
                        "residual termination threshold");
   clopts.attach_option("maxval", als_vertex_program::MAXVAL, "max allowed value");
@@ -594,18 +713,28 @@ int main(int argc, char** argv) {
                        "The time in seconds between error reports");
   clopts.attach_option("predictions", predictions,
                        "The prefix (folder and filename) to save predictions.");
+  clopts.attach_option("columnar_model", columnar_model,
+                       "If set, the linear model is saved as columnar files "
+                       "instead of text.");
   clopts.attach_option("engine", exec_type, 
                        "The engine type synchronous or asynchronous");
   clopts.attach_option("regnormal", als_vertex_program::REGNORMAL, 
                        "regularization type. 1 = weighted according to neighbors num. 0 = no weighting - just lambda");
   
   parse_implicit_command_line(clopts);
+  parse_topk_command_line(clopts);
   
   if(!clopts.parse(argc, argv) || input_dir == "") {
     std::cout << "Error in parsing command line arguments." << std::endl;
     clopts.print_description();
     return EXIT_FAILURE;
   }
+#ifdef ALS_FIXED_D
+  if(vertex_data::NLATENT != ALS_FIXED_D) {
+    std::cout << "This als is built for D=" << ALS_FIXED_D << std::endl;
+    return EXIT_FAILURE;
+  }
+#endif
 
 
   ///! Initialize control plain using mpi
@@ -664,11 +793,36 @@ int main(int argc, char** argv) {
   ASSERT_TRUE(success);
   
 
-  // Signal all vertices on the vertices on the left (liberals) 
-  engine.map_reduce_vertices<graphlab::empty>(als_vertex_program::signal_left);
   info = graph.map_reduce_edges<stats_info>(count_edges);
   dc.cout()<<"Training edges: " << info.training_edges << " validation edges: " << info.validation_edges << std::endl;
 
+  // Run ALS for each weight of the sweep, from the initial factors ----------
+  const std::vector<std::string> lambdas =
+    graphlab::strsplit(lambda_sweep, ",", true);
+  if (!lambdas.empty()) {
+    const double lambda = als_vertex_program::LAMBDA;
+    graph_type::data_checkpoint initial;
+    graph.save_data_checkpoint(initial, false);
+    for (size_t i = 0; i < lambdas.size(); ++i) {
+      graph.restore_data_checkpoint(initial);
+      als_vertex_program::LAMBDA = atof(lambdas[i].c_str());
+      dc.cout() << "Running ALS with lambda = " << als_vertex_program::LAMBDA
+                << std::endl;
+      timer.start();
+      engine.map_reduce_vertices<graphlab::empty>(als_vertex_program::signal_left);
+      engine.start();
+      dc.cout() << "Runtime (seconds): " << timer.current_time()
+                << " Updates executed: " << engine.num_updates() << std::endl;
+      dc.cout() << "Final error: " << std::endl;
+      engine.aggregate_now("error");
+    }
+    graph.restore_data_checkpoint(initial);
+    als_vertex_program::LAMBDA = lambda;
+  }
+
+  // Signal all vertices on the vertices on the left (liberals) 
+  engine.map_reduce_vertices<graphlab::empty>(als_vertex_program::signal_left);
+
   // Run ALS ---------------------------------------------------------
   dc.cout() << "Running ALS" << std::endl;
   timer.start();
@@ -698,13 +852,22 @@ int main(int argc, char** argv) {
                gzip_output, false, 
                true, threads_per_machine);
     //save the linear model
-    graph.save(predictions + ".U", linear_model_saver_U(),
-		gzip_output, true, false, threads_per_machine);
-    graph.save(predictions + ".V", linear_model_saver_V(),
-		gzip_output, true, false, threads_per_machine);
+    if (columnar_model) {
+      graph.save_columns(predictions + ".U", linear_model_column_writer(true),
+                         true, false, threads_per_machine);
+      graph.save_columns(predictions + ".V", linear_model_column_writer(false),
+                         true, false, threads_per_machine);
+    } else {
+      graph.save(predictions + ".U", linear_model_saver_U(),
+		  gzip_output, true, false, threads_per_machine);
+      graph.save(predictions + ".V", linear_model_saver_V(),
+		  gzip_output, true, false, threads_per_machine);
+    }
   
   }
              
+  save_topk_recommendations(graph, topk_factor(), SAFE_NEG_OFFSET, clopts);
+
 
 
   graphlab::mpi_tools::finalize();
@@ -81,6 +81,16 @@ struct vertex_data {
   void load(graphlab::iarchive& arc) { 
     arc >> nupdates >> pvec >> bias;
   }
+  /** \brief The parameters averaged across the copies by Hogwild:
+   *  [pvec; bias] */
+  void get_params(vec_type& params) const { 
+    params.resize(pvec.size() + 1);
+    params << pvec, bias;
+  }
+  void set_params(const vec_type& params) { 
+    pvec = params.head(pvec.size());
+    bias = params[pvec.size()];
+  }
 }; // end of vertex data
 
 
@@ -120,6 +130,7 @@ struct edge_data : public graphlab::IS_POD_TYPE {
 typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
 
 #include "implicit.hpp"
+#include "hogwild.hpp"
 
 double extract_l2_error(const graph_type::edge_type & edge);
 
@@ -540,6 +551,32 @@ bool biassgd_vertex_program::debug = false;
 double biassgd_vertex_program::GLOBAL_MEAN = 0;
 size_t biassgd_vertex_program::NUM_TRAINING_EDGES = 0;
 
+
+/**
+ * \brief The step of the vertex program applied to one training edge
+ * by the Hogwild path: both ends move in place.
+ */
+struct biassgd_edge_update : public hogwild_edge_update {
+  bool train(const edge_data& edge) const { 
+    return edge.role == edge_data::TRAIN; 
+  }
+  void operator()(vertex_data& user, vertex_data& item, 
+                  const edge_data& edge) const {
+    double pred = biassgd_vertex_program::GLOBAL_MEAN + 
+      user.bias + item.bias + user.pvec.dot(item.pvec);
+    pred = std::min(pred, biassgd_vertex_program::MAXVAL);
+    pred = std::max(pred, biassgd_vertex_program::MINVAL);
+    const double err = pred - edge.obs;
+    const double gamma = biassgd_vertex_program::GAMMA;
+    const double lambda = biassgd_vertex_program::LAMBDA;
+    user.bias -= gamma*(err + lambda*user.bias);
+    item.bias -= gamma*(err + lambda*item.bias);
+    const vec_type user_pvec = user.pvec;
+    user.pvec -= gamma*(err*item.pvec + lambda*user.pvec);
+    item.pvec -= gamma*(err*user_pvec + lambda*item.pvec);
+  }
+}; // end of biassgd_edge_update
+
 /**
  * \brief The engine type used by the ALS matrix factorization
  * algorithm.
@@ -601,6 +638,7 @@ int main(int argc, char** argv) {
                        "The prefix (folder and filename) to save predictions.");
 
   parse_implicit_command_line(clopts);
+  parse_hogwild_command_line(clopts);
 
   if(!clopts.parse(argc, argv) || input_dir == "") {
     std::cout << "Error in parsing command line arguments." << std::endl;
@@ -676,16 +714,22 @@ dc.cout() << "Finalizing graph." << std::endl;
   dc.cout() << "Time   Training    Validation" <<std::endl;
   dc.cout() << "       RMSE        RMSE " <<std::endl;
   timer.start();
-  engine.start();  
+  size_t num_updates = 0;
+  if (HOGWILD_EPOCHS > 0) {
+    num_updates = run_hogwild_sgd(graph, biassgd_edge_update(), engine, iter, clopts);
+  } else {
+    engine.start();  
+    num_updates = engine.num_updates();
+  }
 
   const double runtime = timer.current_time();
   dc.cout() << "----------------------------------------------------------"
             << std::endl
             << "Final Runtime (seconds):   " << runtime 
             << std::endl
-            << "Updates executed: " << engine.num_updates() << std::endl
+            << "Updates executed: " << num_updates << std::endl
             << "Update Rate (updates/second): " 
-            << engine.num_updates() / runtime << std::endl;
+            << num_updates / runtime << std::endl;
 
   // Compute the final training error -----------------------------------------
   dc.cout() << "Final error: " << std::endl;
@@ -0,0 +1,153 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+#ifndef BINARY_RATINGS_HPP
+#define BINARY_RATINGS_HPP
+
+/**
+ * \file binary_ratings.hpp
+ *
+ * A compact binary rating format: a 16 byte header followed by one 10
+ * byte record per rating,
+ * \code
+ * uint32_t user; uint32_t item; uint16_t code;
+ * \endcode
+ * in the byte order of the machine which wrote it. The rating is
+ * header.minval + code * header.step, and the code NO_RATING marks a
+ * rating to predict. Integer ratings with up to 65535 levels are stored
+ * exactly, and the files are read without any parsing. Files are
+ * written by the quantize_ratings tool, and the role of the ratings
+ * comes from the file name as for text input: *.validate.bin and
+ * *.predict.bin hold validation and prediction ratings.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <graphlab.hpp>
+
+struct binary_rating_header {
+  char magic[4];
+  float minval;
+  float step;
+  uint32_t reserved;
+};
+
+enum { BINARY_RATING_RECORD_SIZE = 10 };
+const uint16_t NO_RATING = uint16_t(-1);
+const char BINARY_RATING_MAGIC[4] = { 'G', 'L', 'R', 'B' };
+
+/** \brief Returns a header quantizing [minval, maxval] into 65535 codes */
+inline binary_rating_header make_binary_rating_header(float minval, float maxval) {
+  binary_rating_header header;
+  memcpy(header.magic, BINARY_RATING_MAGIC, sizeof(header.magic));
+  header.minval = minval;
+  header.step = (maxval > minval) ? (maxval - minval) / (NO_RATING - 1) : 1;
+  header.reserved = 0;
+  return header;
+}
+
+/** \brief Returns the code of a rating, clamped to the header range */
+inline uint16_t quantize_rating(const binary_rating_header& header, float obs) {
+  const double code = floor((obs - header.minval) / header.step + 0.5);
+  return uint16_t(std::min<double>(std::max<double>(code, 0), NO_RATING - 1));
+}
+
+/** \brief Returns the rating of a code */
+inline float dequantize_rating(const binary_rating_header& header, uint16_t code) {
+  return header.minval + code * header.step;
+}
+
+/** \brief Writes one rating record */
+inline void write_binary_rating(FILE* out, uint32_t user, uint32_t item, uint16_t code) {
+  char record[BINARY_RATING_RECORD_SIZE];
+  memcpy(record, &user, 4);
+  memcpy(record + 4, &item, 4);
+  memcpy(record + 8, &code, 2);
+  fwrite(record, BINARY_RATING_RECORD_SIZE, 1, out);
+}
+
+
+/**
+ * \brief Loads the binary rating files starting with prefix (a
+ * directory or a path prefix) into the graph, with the toolkit
+ * convention of the items stored as the vertices
+ * -(item + item_offset). Machine k loads every numprocs-th file
+ * starting with the k-th. All machines must call this function.
+ */
+template <typename EdgeData, typename Graph>
+void load_binary_ratings(Graph& graph, const std::string& prefix,
+                         graphlab::vertex_id_type item_offset) {
+  std::string directory_name, search_prefix;
+  const boost::filesystem::path path(prefix);
+  if (boost::filesystem::is_directory(path)) {
+    directory_name = path.native();
+  } else {
+    directory_name = path.parent_path().native();
+    search_prefix = path.filename().native();
+    if (directory_name.empty()) directory_name = ".";
+  }
+  std::vector<std::string> files;
+  graphlab::fs_util::list_files_with_prefix(directory_name, search_prefix, files);
+  graphlab::distributed_control& dc = graph.dc();
+  size_t nfiles = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!boost::ends_with(files[i], ".bin")) continue;
+    if (nfiles++ % dc.numprocs() != dc.procid()) continue;
+    const std::string name = files[i].substr(0, files[i].size() - 4);
+    typename EdgeData::data_role_type role = EdgeData::TRAIN;
+    if (boost::ends_with(name, ".validate")) role = EdgeData::VALIDATE;
+    else if (boost::ends_with(name, ".predict")) role = EdgeData::PREDICT;
+
+    logstream(LOG_EMPH) << "Loading binary ratings from file: " << files[i] << std::endl;
+    FILE* in = fopen(files[i].c_str(), "rb");
+    binary_rating_header header;
+    if (in == NULL || fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, BINARY_RATING_MAGIC, sizeof(header.magic)) != 0) {
+      logstream(LOG_FATAL) << "Not a binary rating file: " << files[i] << std::endl;
+    }
+    std::vector<char> buffer(BINARY_RATING_RECORD_SIZE * 65536);
+    size_t nrecords = 0;
+    while ((nrecords = fread(&buffer[0], BINARY_RATING_RECORD_SIZE,
+                             65536, in)) > 0) {
+      for (size_t j = 0; j < nrecords; ++j) {
+        const char* record = &buffer[j * BINARY_RATING_RECORD_SIZE];
+        uint32_t user, item; uint16_t code;
+        memcpy(&user, record, 4);
+        memcpy(&item, record + 4, 4);
+        memcpy(&code, record + 8, 2);
+        const float obs = code == NO_RATING ? 0 : dequantize_rating(header, code);
+        graph.add_edge(user, -(graphlab::vertex_id_type(item + item_offset)),
+                       EdgeData(obs, role));
+      }
+    }
+    fclose(in);
+  }
+  if (nfiles == 0) {
+    logstream(LOG_WARNING) << "No binary rating files found matching " << prefix << std::endl;
+  }
+  dc.full_barrier();
+} // end of load_binary_ratings
+
+#endif
@@ -84,8 +84,27 @@ BEGIN_OUT_OF_PLACE_LOAD(arc, Eigen::MatrixXd, mat) {
 } END_OUT_OF_PLACE_LOAD()
 
 
+/**
+ * \brief Saves a vector in the format of the Eigen::VectorXd
+ * serialization (for vectors of doubles), whether its size is fixed
+ * or not.
+ */
+template <typename VecType>
+void save_vector(graphlab::oarchive& arc, const VecType& vec) {
+  typedef typename VecType::Scalar scalar_type;
+  const Eigen::VectorXd::Index size = vec.size();
+  arc << size;
+  graphlab::serialize(arc, vec.data(), size * sizeof(scalar_type));
+} // end of save_vector
 
-
-
+/** \brief Loads a vector saved by save_vector */
+template <typename VecType>
+void load_vector(graphlab::iarchive& arc, VecType& vec) {
+  typedef typename VecType::Scalar scalar_type;
+  Eigen::VectorXd::Index size = 0;
+  arc >> size;
+  vec.resize(size);
+  graphlab::deserialize(arc, vec.data(), size * sizeof(scalar_type));
+} // end of load_vector
 
 #endif
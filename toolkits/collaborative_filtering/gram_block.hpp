@@ -0,0 +1,93 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+#ifndef GRAM_BLOCK_HPP
+#define GRAM_BLOCK_HPP
+
+#include <cmath>
+#include <Eigen/Dense>
+
+
+/**
+ * \brief Accumulates XtX and Xy of the ALS updates a block of
+ * neighbors at a time.
+ *
+ * Adding the neighbors one rank-1 update at a time streams the whole
+ * d x d matrix through the cache for every edge. Instead the factors
+ * are copied into the columns of a d x BLOCK_SIZE matrix X, and every
+ * full block is folded with a single symmetric rank-k update
+ * (XtX += X * X') and a matrix-vector product (Xy += X * y), which
+ * Eigen runs as blocked, vectorized kernels. Only the upper triangle
+ * of XtX is computed.
+ *
+ * A weighted observation is added by scaling its column and its
+ * observation by the square root of the weight.
+ */
+class gram_block {
+public:
+  /// The number of neighbors folded at once
+  enum { BLOCK_SIZE = 64 };
+
+  explicit gram_block(int d) :
+    X(d, BLOCK_SIZE), y(BLOCK_SIZE), XtX(Eigen::MatrixXd::Zero(d, d)),
+    Xy(Eigen::VectorXd::Zero(d)), nblock(0), nadded(0) { }
+
+  /// Adds the neighbor factor with observation obs
+  template <typename VecType>
+  void add(const VecType& factor, double obs, double weight = 1) {
+    if(weight == 1) {
+      X.col(nblock) = factor;
+      y[nblock] = obs;
+    } else {
+      const double scale = std::sqrt(weight);
+      X.col(nblock) = factor * scale;
+      y[nblock] = obs * scale;
+    }
+    ++nadded;
+    if(++nblock == BLOCK_SIZE) flush();
+  } // end of add
+
+  /// Folds the pending neighbors into XtX and Xy
+  void flush() {
+    if(nblock == 0) return;
+    XtX.selfadjointView<Eigen::Upper>().rankUpdate(X.leftCols(nblock));
+    Xy.noalias() += X.leftCols(nblock) * y.head(nblock);
+    nblock = 0;
+  } // end of flush
+
+  /// Returns true if no neighbor was added
+  bool empty() const { return nadded == 0; }
+
+  /// The upper triangle of the sum of the outer products. Call flush first.
+  const Eigen::MatrixXd& upper_XtX() const { return XtX; }
+
+  /// The sum of the factors times the observations. Call flush first.
+  const Eigen::VectorXd& sum_Xy() const { return Xy; }
+
+private:
+  Eigen::MatrixXd X;
+  Eigen::VectorXd y;
+  Eigen::MatrixXd XtX;
+  Eigen::VectorXd Xy;
+  int nblock;
+  size_t nadded;
+}; // end of gram_block
+
+#endif
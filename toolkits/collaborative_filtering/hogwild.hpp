@@ -0,0 +1,401 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+#ifndef HOGWILD_HPP
+#define HOGWILD_HPP
+
+/**
+ * \file hogwild.hpp
+ *
+ * A Hogwild SGD path shared by sgd, biassgd and svdpp: instead of
+ * running the SGD as a vertex program, each machine sweeps its local
+ * training edges in a shuffled, cache blocked order and updates the
+ * factors of both ends in place, from all its threads and without
+ * locks. The copies of a vertex on different machines drift apart and
+ * are averaged every HOGWILD_SYNC_INTERVAL epochs.
+ *
+ * The vertex data must provide the parameters to average as one vector:
+ * \code
+ * void get_params(vec_type& params) const;
+ * void set_params(const vec_type& params);
+ * \endcode
+ * and the edge update must be a functor with
+ * \code
+ * bool train(const edge_data& edge) const;
+ * void operator()(vertex_data& user, vertex_data& item,
+ *                 const edge_data& edge) const;
+ * void start_epoch(graph_type& graph,
+ *                  const graphlab::graphlab_options& opts) const;
+ * \endcode
+ * where start_epoch() refreshes any state derived from the factors
+ * before each epoch; hogwild_edge_update provides an empty one.
+ *
+ * With HOGWILD_STRATIFIED the machines instead follow the stratified
+ * (DSGD) schedule: the items are dealt into one block per machine and
+ * each epoch is made of one sub-epoch per machine. In a sub-epoch every
+ * machine only trains the ratings of the item block it holds, then
+ * passes the factors of that block to the previous machine, so no item
+ * is updated by two machines at once. Loading the graph with the
+ * "source" ingress keeps every user on a single machine as well.
+ */
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <graphlab.hpp>
+#include "eigen_serialization.hpp"
+
+/// The number of Hogwild epochs, 0 to run the vertex program instead
+size_t HOGWILD_EPOCHS = 0;
+/// The number of epochs between two averagings of the vertex copies
+size_t HOGWILD_SYNC_INTERVAL = 1;
+/// The number of local vertices per side of an edge block
+size_t HOGWILD_BLOCK_SIZE = 1024;
+/// Whether to rotate item blocks between the machines (DSGD)
+bool HOGWILD_STRATIFIED = false;
+
+void parse_hogwild_command_line(graphlab::command_line_options & clopts){
+  clopts.attach_option("hogwild", HOGWILD_EPOCHS,
+                       "If set, run this many epochs of lock free (Hogwild) SGD "
+                       "over the local edges instead of the vertex program");
+  clopts.attach_option("sync_interval", HOGWILD_SYNC_INTERVAL,
+                       "Hogwild: epochs between averagings of the vertex copies");
+  clopts.attach_option("block_size", HOGWILD_BLOCK_SIZE,
+                       "Hogwild: local vertices per side of a cache block of edges");
+  clopts.attach_option("dsgd", HOGWILD_STRATIFIED,
+                       "Hogwild: rotate blocks of items between the machines "
+                       "(stratified SGD); best with --graph_opts=\"ingress=source\"");
+}
+
+
+/// A base for the edge updates without state to refresh between epochs
+struct hogwild_edge_update {
+  template <typename Graph>
+  void start_epoch(Graph& graph, const graphlab::graphlab_options& opts) const { }
+};
+
+
+template <typename Graph>
+class hogwild_sgd {
+public:
+  typedef Graph graph_type;
+  typedef typename graph_type::vertex_data_type vertex_data_type;
+  typedef typename graph_type::edge_data_type   edge_data_type;
+  typedef typename graph_type::local_edge_type  local_edge_type;
+  typedef graphlab::lvid_type                   lvid_type;
+
+  /**
+   * Collects the local training edges, sorted by block: an edge
+   * (user, item) belongs to block (user / block_size, item /
+   * block_size), so the factors touched by a block stay in cache.
+   * Only the edges whose item hashes to the given stratum out of
+   * num_strata are kept.
+   */
+  template <typename EdgeUpdate>
+  hogwild_sgd(graph_type& graph, const EdgeUpdate& update,
+              size_t block_size, size_t stratum = 0,
+              size_t num_strata = 1) : graph(graph) {
+    if (block_size == 0) block_size = 1;
+    for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      foreach(local_edge_type e, graph.l_vertex(lvid).out_edges()) {
+        if (!update.train(e.data())) continue;
+        if (num_strata > 1 && stratum_of(graph.global_vid(e.target().id()),
+                                         num_strata) != stratum) continue;
+        const local_edge edge = { e.source().id(), e.target().id(), &e.data() };
+        edges.push_back(edge);
+      }
+    }
+    std::sort(edges.begin(), edges.end(), block_less(block_size));
+    for (size_t i = 0; i < edges.size(); ++i) {
+      if (i == 0 || block_less(block_size)(edges[i - 1], edges[i])) {
+        block_starts.push_back(i);
+      }
+    }
+    block_starts.push_back(edges.size());
+    block_order.resize(block_starts.size() - 1);
+    for (size_t i = 0; i < block_order.size(); ++i) block_order[i] = i;
+  } // end of constructor
+
+  /// The number of local training edges
+  size_t num_edges() const { return edges.size(); }
+
+  /// The stratum of an item
+  static size_t stratum_of(graphlab::vertex_id_type vid, size_t num_strata) {
+    return graphlab::graph_hash::hash_vertex(vid) % num_strata;
+  }
+
+  /**
+   * Runs one epoch: the blocks are visited in a random order by all
+   * the threads, and the edges in each block in a random order.
+   */
+  template <typename EdgeUpdate>
+  void run_epoch(const EdgeUpdate& update) {
+    graphlab::random::shuffle(block_order);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int b = 0; b < (int)block_order.size(); ++b) {
+      const size_t begin = block_starts[block_order[b]];
+      const size_t end = block_starts[block_order[b] + 1];
+      graphlab::random::shuffle(edges.begin() + begin, edges.begin() + end);
+      for (size_t i = begin; i < end; ++i) {
+        update(graph.l_vertex(edges[i].user).data(),
+               graph.l_vertex(edges[i].item).data(), *edges[i].data);
+      }
+    }
+  } // end of run_epoch
+
+  /**
+   * Replaces the parameters of every copy of each vertex by the
+   * average of all copies, weighted by their local degrees: the copies
+   * without local edges have not moved and do not count.
+   */
+  void synchronize_mirrors(const graphlab::graphlab_options& opts) {
+    if (graph.dc().numprocs() == 1) return;
+    graphlab::graph_gather_apply<graph_type, param_sum>
+        sync(graph, gather_params, apply_params, opts);
+    sync.exec();
+  } // end of synchronize_mirrors
+
+private:
+  struct local_edge {
+    lvid_type user, item;
+    const edge_data_type* data;
+  };
+
+  struct block_less {
+    size_t block_size;
+    explicit block_less(size_t block_size) : block_size(block_size) { }
+    bool operator()(const local_edge& a, const local_edge& b) const {
+      const size_t au = a.user / block_size, bu = b.user / block_size;
+      return au < bu || (au == bu && a.item / block_size < b.item / block_size);
+    }
+  };
+
+  struct param_sum {
+    Eigen::VectorXd sum;
+    double weight;
+    param_sum() : weight(0) { }
+    param_sum& operator+=(const param_sum& other) {
+      if (other.weight == 0) return *this;
+      if (weight == 0) *this = other;
+      else {
+        sum += other.sum;
+        weight += other.weight;
+      }
+      return *this;
+    }
+    void save(graphlab::oarchive& oarc) const { oarc << sum << weight; }
+    void load(graphlab::iarchive& iarc) { iarc >> sum >> weight; }
+  };
+
+  static param_sum gather_params(lvid_type lvid, graph_type& graph) {
+    typename graph_type::local_vertex_type vtx = graph.l_vertex(lvid);
+    param_sum ret;
+    ret.weight = vtx.num_in_edges() + vtx.num_out_edges();
+    if (ret.weight > 0) {
+      vtx.data().get_params(ret.sum);
+      ret.sum *= ret.weight;
+    }
+    return ret;
+  }
+
+  static void apply_params(lvid_type lvid, const param_sum& total,
+                           graph_type& graph) {
+    if (total.weight > 0) {
+      graph.l_vertex(lvid).data().set_params(total.sum / total.weight);
+    }
+  }
+
+  graph_type& graph;
+  std::vector<local_edge> edges;
+  std::vector<size_t> block_starts;
+  std::vector<size_t> block_order;
+}; // end of hogwild_sgd
+
+
+/**
+ * The stratified (DSGD) schedule: holds one hogwild_sgd per item block
+ * and the factors of the item block this machine currently trains.
+ */
+template <typename Graph>
+class stratified_sgd {
+public:
+  typedef Graph graph_type;
+  typedef hogwild_sgd<graph_type> hogwild_type;
+  typedef typename graph_type::vertex_type vertex_type;
+  typedef graphlab::lvid_type              lvid_type;
+  typedef graphlab::vertex_id_type         vertex_id_type;
+  typedef std::pair<vertex_id_type, Eigen::VectorXd> factor_type;
+  typedef std::vector<factor_type> block_type;
+
+  /**
+   * Splits the local training edges by item block, and deals the
+   * factors of each item to the machine which trains its block first.
+   */
+  template <typename EdgeUpdate>
+  stratified_sgd(graph_type& graph, const EdgeUpdate& update,
+                 size_t block_size) :
+    rmi(graph.dc(), this), graph(graph), num_strata(graph.dc().numprocs()) {
+    for (size_t i = 0; i < num_strata; ++i) {
+      strata.push_back(new hogwild_type(graph, update, block_size, i, num_strata));
+    }
+    rmi.barrier();
+    std::vector<block_type> outgoing(num_strata);
+    for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      if (!graph.l_is_master(lvid) ||
+          vertex_type(graph.l_vertex(lvid)).num_in_edges() == 0) continue;
+      const vertex_id_type vid = graph.global_vid(lvid);
+      block_type& out = outgoing[hogwild_type::stratum_of(vid, num_strata)];
+      out.push_back(factor_type(vid, Eigen::VectorXd()));
+      graph.l_vertex(lvid).data().get_params(out.back().second);
+    }
+    for (graphlab::procid_t p = 0; p < num_strata; ++p) {
+      rmi.remote_call(p, &stratified_sgd::receive_block, outgoing[p]);
+    }
+    rmi.full_barrier();
+    block.swap(incoming);
+  } // end of constructor
+
+  ~stratified_sgd() {
+    for (size_t i = 0; i < strata.size(); ++i) delete strata[i];
+  }
+
+  /// The number of local training edges
+  size_t num_edges() const {
+    size_t ret = 0;
+    for (size_t i = 0; i < strata.size(); ++i) ret += strata[i]->num_edges();
+    return ret;
+  }
+
+  /**
+   * Runs one epoch: one sub-epoch per machine, each training the held
+   * item block and passing it on, followed by a broadcast of the item
+   * blocks and an averaging of the copies of the users.
+   */
+  template <typename EdgeUpdate>
+  void run_epoch(const EdgeUpdate& update,
+                 const graphlab::graphlab_options& opts) {
+    const graphlab::procid_t procid = rmi.procid();
+    for (size_t sub = 0; sub < num_strata; ++sub) {
+      store_factors(block);
+      strata[(procid + sub) % num_strata]->run_epoch(update);
+      load_factors(block);
+      rmi.remote_call((procid + num_strata - 1) % num_strata,
+                      &stratified_sgd::receive_block, block);
+      block.clear();
+      rmi.full_barrier();
+      block.swap(incoming);
+    }
+    // every block is back on its first machine: publish it to all copies
+    for (graphlab::procid_t p = 0; p < num_strata; ++p) {
+      if (p != procid) rmi.remote_call(p, &stratified_sgd::receive_block, block);
+    }
+    rmi.full_barrier();
+    store_factors(block);
+    store_factors(incoming);
+    incoming.clear();
+    strata[0]->synchronize_mirrors(opts);
+  } // end of run_epoch
+
+  void receive_block(const block_type& factors) {
+    lock.lock();
+    incoming.insert(incoming.end(), factors.begin(), factors.end());
+    lock.unlock();
+  }
+
+private:
+  /// Writes the factors into the local copies of their vertices
+  void store_factors(const block_type& factors) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < (int)factors.size(); ++i) {
+      if (graph.contains_vertex(factors[i].first)) {
+        graph.l_vertex(graph.local_vid(factors[i].first)).data().set_params(factors[i].second);
+      }
+    }
+  }
+
+  /// Reads the factors back from the local copies of their vertices
+  void load_factors(block_type& factors) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < (int)factors.size(); ++i) {
+      if (graph.contains_vertex(factors[i].first)) {
+        graph.l_vertex(graph.local_vid(factors[i].first)).data().get_params(factors[i].second);
+      }
+    }
+  }
+
+  graphlab::dc_dist_object<stratified_sgd> rmi;
+  graph_type& graph;
+  const size_t num_strata;
+  std::vector<hogwild_type*> strata;
+  block_type block;
+  block_type incoming;
+  graphlab::mutex lock;
+}; // end of stratified_sgd
+
+
+/**
+ * Runs HOGWILD_EPOCHS epochs of Hogwild SGD, averaging the vertex
+ * copies every HOGWILD_SYNC_INTERVAL epochs and after the last one,
+ * or with the stratified schedule if HOGWILD_STRATIFIED is set.
+ * The "error" aggregator of the engine reports the error after each
+ * epoch; its finalizer only prints on odd calls, hence the reset of
+ * the iteration counter. Returns the number of edge updates.
+ */
+template <typename Graph, typename EdgeUpdate, typename Engine>
+size_t run_hogwild_sgd(Graph& graph, const EdgeUpdate& update,
+                       Engine& engine, int& iteration,
+                       const graphlab::graphlab_options& opts) {
+  size_t num_updates = 0;
+  if (HOGWILD_STRATIFIED) {
+    stratified_sgd<Graph> dsgd(graph, update, HOGWILD_BLOCK_SIZE);
+    for (size_t epoch = 0; epoch < HOGWILD_EPOCHS; ++epoch) {
+      update.start_epoch(graph, opts);
+      dsgd.run_epoch(update, opts);
+      num_updates += dsgd.num_edges();
+      iteration = 0;
+      engine.aggregate_now("error");
+    }
+    graph.dc().all_reduce(num_updates);
+    return num_updates;
+  }
+  hogwild_sgd<Graph> hogwild(graph, update, HOGWILD_BLOCK_SIZE);
+  const size_t interval = std::max<size_t>(HOGWILD_SYNC_INTERVAL, 1);
+  for (size_t epoch = 0; epoch < HOGWILD_EPOCHS; ++epoch) {
+    update.start_epoch(graph, opts);
+    hogwild.run_epoch(update);
+    num_updates += hogwild.num_edges();
+    if ((epoch + 1) % interval == 0 || epoch + 1 == HOGWILD_EPOCHS) {
+      hogwild.synchronize_mirrors(opts);
+    }
+    iteration = 0;
+    engine.aggregate_now("error");
+  }
+  graph.dc().all_reduce(num_updates);
+  return num_updates;
+} // end of run_hogwild_sgd
+
+#endif
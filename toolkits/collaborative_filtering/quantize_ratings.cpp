@@ -0,0 +1,88 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+/**
+ * \file
+ *
+ * \brief Converts a text rating file ("user item rating" lines, or
+ * "user item" lines for a *.predict file) into the binary format of
+ * binary_ratings.hpp.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <graphlab.hpp>
+#include "binary_ratings.hpp"
+
+#include <graphlab/macros_def.hpp>
+
+
+int main(int argc, char** argv) {
+  global_logger().set_log_level(LOG_INFO);
+  global_logger().set_log_to_console(true);
+
+  const std::string description = 
+    "Converts a text rating file into the quantized binary rating format";
+  graphlab::command_line_options clopts(description, false);
+  std::string fname;
+  double minval = 1, maxval = 5;
+  clopts.attach_option("input", fname,
+                       "The text rating file, written to <file>.bin");
+  clopts.add_positional("input");
+  clopts.attach_option("minval", minval, "min allowed rating");
+  clopts.attach_option("maxval", maxval, "max allowed rating");
+  if(!clopts.parse(argc, argv) || fname.empty()) {
+    std::cout << "Error in parsing command line arguments." << std::endl;
+    clopts.print_description();
+    return EXIT_FAILURE;
+  }
+
+  const bool predict = boost::ends_with(fname, ".predict");
+  const binary_rating_header header = make_binary_rating_header(minval, maxval);
+  std::ifstream in(fname.c_str());
+  if (!in.good()) 
+    logstream(LOG_FATAL) << "Failed to open " << fname << std::endl;
+  const std::string outname = fname + ".bin";
+  FILE* out = fopen(outname.c_str(), "wb");
+  if (out == NULL) 
+    logstream(LOG_FATAL) << "Failed to create " << outname << std::endl;
+  fwrite(&header, sizeof(header), 1, out);
+  size_t nratings = 0, nclamped = 0;
+  std::string line;
+  while(std::getline(in, line)) {
+    if (line.empty() || line[0] == '%' || line[0] == '#') continue;
+    std::stringstream strm(line);
+    uint32_t user = 0, item = 0; 
+    float obs = 0;
+    if (!(strm >> user >> item) || (!predict && !(strm >> obs))) {
+      logstream(LOG_WARNING) << "Failed to read input line: " << line 
+                             << " in file: " << fname << std::endl;
+      continue;
+    }
+    if (!predict && (obs < minval || obs > maxval)) ++nclamped;
+    write_binary_rating(out, user, item, 
+                        predict ? NO_RATING : quantize_rating(header, obs));
+    ++nratings;
+  }
+  fclose(out);
+  logstream(LOG_EMPH) << "Wrote " << nratings << " ratings to " << outname
+                      << ", " << nclamped << " out of range ratings clamped" << std::endl;
+  return EXIT_SUCCESS;
+} // end of main
@@ -35,8 +35,21 @@
 #include <graphlab/macros_def.hpp>
 
 
+#ifdef SGD_FIXED_D
+/**
+ * \brief When the number of latent values is known at compile time
+ * (for instance with -DSGD_FIXED_D=32) the latent vectors are fixed
+ * size vectors of floats stored inline in the vertex data: half the
+ * memory of the heap allocated doubles, and no allocation in the
+ * gathers and messages. The D option must then be SGD_FIXED_D.
+ */
+typedef Eigen::Matrix<float, SGD_FIXED_D, 1, Eigen::DontAlign> vec_type;
+#else
 typedef Eigen::VectorXd vec_type;
+#endif
 typedef Eigen::MatrixXd mat_type;
+/** \brief The scalar type of the latent vectors */
+typedef vec_type::Scalar real_type;
 
 //when using negative node id range, we are not allowed to use
 //0 and 1 so we add 2.
@@ -79,12 +92,17 @@ struct vertex_data {
 	void randomize() { pvec.resize(NLATENT); pvec.setRandom(); }
 	/** \brief Save the vertex data to a binary archive */
 	void save(graphlab::oarchive& arc) const { 
-		arc << nupdates << pvec;
+		arc << nupdates;
+		save_vector(arc, pvec);
 	}
 	/** \brief Load the vertex data from a binary archive */
 	void load(graphlab::iarchive& arc) { 
-		arc >> nupdates >> pvec;
+		arc >> nupdates;
+		load_vector(arc, pvec);
 	}
+	/** \brief The parameters averaged across the copies by Hogwild */
+	void get_params(Eigen::VectorXd& params) const { params = pvec.cast<double>(); }
+	void set_params(const Eigen::VectorXd& params) { pvec = params.cast<real_type>(); }
 }; // end of vertex data
 
 
@@ -124,16 +142,19 @@ struct edge_data : public graphlab::IS_POD_TYPE {
 typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
 
 #include "implicit.hpp"
+#include "topk.hpp"
+#include "hogwild.hpp"
+#include "binary_ratings.hpp"
 
-stats_info count_edges(const graph_type::edge_type & edge){
+stats_info count_edges(const graph_type::csr_edge_type & edge){
 	stats_info ret;
 
 	if (edge.data().role == edge_data::TRAIN)
 		ret.training_edges = 1;
 	else if (edge.data().role == edge_data::VALIDATE)
 		ret.validation_edges = 1;
-	ret.max_user = (size_t)edge.source().id();
-	ret.max_item = (-edge.target().id()-SAFE_NEG_OFFSET);
+	ret.max_user = (size_t)edge.source_id();
+	ret.max_item = (-edge.target_id()-SAFE_NEG_OFFSET);
 	return ret;
 }
 
@@ -169,31 +190,39 @@ class gather_type {
 		 * \brief Stores the current sum of nbr.pvec * edge.obs
 		 */
 		vec_type pvec;
+		/** \brief True when no vector has been added yet */
+		bool empty;
 		/** \brief basic default constructor */
-		gather_type() { }
+		gather_type() : empty(true) { }
 
 		/**
 		 * \brief This constructor computes XtX and Xy and stores the result
 		 * in XtX and Xy
 		 */
-		gather_type(const vec_type& X) {
+		gather_type(const vec_type& X) : empty(false) {
 			pvec = X;
 		} // end of constructor for gather type
 
 		/** \brief Save the values to a binary archive */
-		void save(graphlab::oarchive& arc) const { arc << pvec; }
+		void save(graphlab::oarchive& arc) const { 
+			arc << empty;
+			if (!empty) save_vector(arc, pvec);
+		}
 
 		/** \brief Read the values from a binary archive */
-		void load(graphlab::iarchive& arc) { arc >> pvec; }  
+		void load(graphlab::iarchive& arc) { 
+			arc >> empty;
+			if (!empty) load_vector(arc, pvec);
+		}  
 
 		/** 
 		 */
 		gather_type& operator+=(const gather_type& other) {
-			if (pvec.size() == 0){
-				pvec = other.pvec;
+			if (empty){
+				*this = other;
 				return *this;
 			}
-			else if (other.pvec.size() == 0)
+			else if (other.empty)
 				return *this;
 			pvec += other.pvec;
 			return *this;
@@ -201,7 +230,7 @@ class gather_type {
 
 }; // end of gather type
 
-typedef vec_type message_type;
+typedef gather_type message_type;
 
 bool isuser_node(const graph_type::vertex_type& vertex){
 	return isuser(vertex.id());
@@ -223,7 +252,7 @@ class sgd_vertex_program :
 			static double STEP_DEC;
 			static bool debug;
 			static size_t MAX_UPDATES;
-			vec_type pmsg;
+			message_type pmsg;
 
 			void save(graphlab::oarchive& arc) const { 
 				arc << pmsg;
@@ -244,6 +273,7 @@ class sgd_vertex_program :
 					edge_type& edge) const {
 
 				vec_type delta, other_delta;
+				const real_type gamma = GAMMA, lambda = LAMBDA;
 				//this is user node
 				if (vertex.num_in_edges() == 0){
 					vertex_type my_vertex(vertex);
@@ -264,9 +294,9 @@ class sgd_vertex_program :
 					//for training edges, update the linear model
 					if (edge.data().role == edge_data::TRAIN){
 						//compute the change in gradient for this user node
-						delta = GAMMA*(err*other_vertex.data().pvec - LAMBDA*vertex.data().pvec);
+						delta = gamma*(err*other_vertex.data().pvec - lambda*vertex.data().pvec);
 						//compute the change in gradient for this item node
-						other_delta = GAMMA*(err*vertex.data().pvec - LAMBDA*other_vertex.data().pvec);
+						other_delta = gamma*(err*vertex.data().pvec - lambda*other_vertex.data().pvec);
 
 						//heuristic: update the current gradient with the change (this change is discarded when this function exists)
 						//my_vertex.data().pvec += delta;
@@ -275,10 +305,11 @@ class sgd_vertex_program :
 							std::cout<<"new val:" << (int)edge.source().id() << ":" << (int)edge.target().id() << " U " << my_vertex.data().pvec.transpose() << " V " << other_vertex.data().pvec.transpose() << std::endl;
 						//send the delta gradient for the item node to be updated in the next iteration
 						if(std::fabs(err) > TOLERANCE && other_vertex.data().nupdates < MAX_UPDATES) 
-							context.signal(other_vertex, other_delta);
+							context.signal(other_vertex, message_type(other_delta));
+						return gather_type(delta);
 					}
 				} 
-				return gather_type(delta);
+				return gather_type();
 			} // end of gather function
 
 			void init(icontext_type& context,
@@ -296,13 +327,13 @@ class sgd_vertex_program :
 
 				vertex_data& vdata = vertex.data(); 
 				//this is a user node, update the gradient using the comulative sum of gradient updates computed in gather
-				if (sum.pvec.size() > 0){
+				if (!sum.empty){
 					vdata.pvec += sum.pvec; 
 					assert(vertex.num_in_edges() == 0);
 				}
 				//if this is an item node, update the gradient using the received sum from the init() function
-				else if (pmsg.size() > 0){
-					vdata.pvec += pmsg;
+				else if (!pmsg.empty){
+					vdata.pvec += pmsg.pvec;
 					assert(vertex.num_out_edges() == 0); 
 				}
 				++vdata.nupdates;
@@ -322,7 +353,7 @@ class sgd_vertex_program :
 					const vertex_type other_vertex = get_other_vertex(edge, vertex);
 					// Reschedule neighbors ------------------------------------------------
 					if(other_vertex.data().nupdates < MAX_UPDATES) 
-						context.signal(other_vertex, vec_type::Zero(vertex_data::NLATENT));
+						context.signal(other_vertex, message_type(vec_type::Zero(vertex_data::NLATENT)));
 				}
 			} // end of scatter function
 
@@ -332,7 +363,7 @@ class sgd_vertex_program :
 			 */
 			static graphlab::empty signal_left(icontext_type& context,
 					vertex_type& vertex) {
-				if(vertex.num_out_edges() > 0) context.signal(vertex, vec_type::Zero(vertex_data::NLATENT));
+				if(vertex.num_out_edges() > 0) context.signal(vertex, message_type(vec_type::Zero(vertex_data::NLATENT)));
 				return graphlab::empty();
 			} // end of signal_left 
 
@@ -465,6 +496,11 @@ struct linear_model_saver_V {
 
 
 
+/** \brief The latent vector of a vertex, for the top-K recommendations */
+struct topk_factor {
+	Eigen::VectorXd operator()(const vertex_data& vdata) const { return vdata.pvec.cast<double>(); }
+};
+
 /**
  * \brief The graph loader function is a line parser used for
  * distributed graph construction.
@@ -509,7 +545,11 @@ inline bool graph_loader(graph_type& graph,
 
 
 
+#ifdef SGD_FIXED_D
+size_t vertex_data::NLATENT = SGD_FIXED_D;
+#else
 size_t vertex_data::NLATENT = 20;
+#endif
 double sgd_vertex_program::TOLERANCE = 1e-3;
 double sgd_vertex_program::LAMBDA = 0.001;
 double sgd_vertex_program::GAMMA = 0.001;
@@ -520,6 +560,29 @@ double sgd_vertex_program::STEP_DEC = 0.9;
 bool sgd_vertex_program::debug = false;
 
 
+/**
+ * \brief The SGD step of the vertex program applied to one training
+ * edge by the Hogwild path: both ends move in place.
+ */
+struct sgd_edge_update : public hogwild_edge_update {
+	bool train(const edge_data& edge) const { 
+		return edge.role == edge_data::TRAIN; 
+	}
+	void operator()(vertex_data& user, vertex_data& item, 
+			const edge_data& edge) const {
+		double pred = user.pvec.dot(item.pvec);
+		pred = std::min(pred, sgd_vertex_program::MAXVAL);
+		pred = std::max(pred, sgd_vertex_program::MINVAL);
+		const real_type err = edge.obs - pred;
+		const real_type gamma = sgd_vertex_program::GAMMA;
+		const real_type lambda = sgd_vertex_program::LAMBDA;
+		const vec_type user_pvec = user.pvec;
+		user.pvec += gamma*(err*item.pvec - lambda*user.pvec);
+		item.pvec += gamma*(err*user_pvec - lambda*item.pvec);
+	}
+}; // end of sgd_edge_update
+
+
 /**
  * \brief The engine type used by the SGD matrix factorization
  * algorithm.
@@ -541,7 +604,9 @@ int main(int argc, char** argv) {
 	std::string input_dir;
 	std::string predictions;
 	size_t interval = 0;
+	bool binary = false;
 	std::string exec_type = "synchronous";
+	std::string gamma_sweep;
 	clopts.attach_option("matrix", input_dir,
 			"The directory containing the matrix file");
 	clopts.add_positional("matrix");
@@ -555,6 +620,10 @@ int main(int argc, char** argv) {
 			"SGD regularization weight"); 
 	clopts.attach_option("gamma", sgd_vertex_program::GAMMA, 
 			"SGD step size"); 
+	clopts.attach_option("gamma_sweep", gamma_sweep,
+			"A comma separated list of step sizes. SGD is run once for each, "
+			"from the same initial factors, without reloading the graph, "
+			"before the final run with --gamma.");
 	clopts.attach_option("debug", sgd_vertex_program::debug, 
 			"debug - additional verbose info"); 
 	clopts.attach_option("tol", sgd_vertex_program::TOLERANCE,
@@ -566,14 +635,24 @@ int main(int argc, char** argv) {
 			"The time in seconds between error reports");
 	clopts.attach_option("predictions", predictions,
 			"The prefix (folder and filename) to save predictions.");
+	clopts.attach_option("binary", binary,
+			"Load the *.bin rating files written by quantize_ratings");
 
 	parse_implicit_command_line(clopts);
+	parse_topk_command_line(clopts);
+	parse_hogwild_command_line(clopts);
 
 	if(!clopts.parse(argc, argv) || input_dir == "") {
 		std::cout << "Error in parsing command line arguments." << std::endl;
 		clopts.print_description();
 		return EXIT_FAILURE;
 	}
+#ifdef SGD_FIXED_D
+	if(vertex_data::NLATENT != SGD_FIXED_D) {
+		std::cout << "This sgd is built for D=" << SGD_FIXED_D << std::endl;
+		return EXIT_FAILURE;
+	}
+#endif
 	debug = sgd_vertex_program::debug;
 	//  omp_set_num_threads(clopts.get_ncpus());
 	///! Initialize control plain using mpi
@@ -583,7 +662,10 @@ int main(int argc, char** argv) {
 	dc.cout() << "Loading graph." << std::endl;
 	graphlab::timer timer; 
 	graph_type graph(dc, clopts);  
-	graph.load(input_dir, graph_loader); 
+	if (binary)
+		load_binary_ratings<edge_data>(graph, input_dir, SAFE_NEG_OFFSET);
+	else
+		graph.load(input_dir, graph_loader); 
 	dc.cout() << "Loading graph. Finished in " 
 		<< timer.current_time() << std::endl;
 
@@ -631,10 +713,44 @@ int main(int argc, char** argv) {
 	ASSERT_TRUE(success);
 
 
+	info = graph.map_reduce_csr_edges<stats_info>(count_edges);
+	dc.cout()<<"Training edges: " << info.training_edges << " validation edges: " << info.validation_edges << std::endl;
+
+	// Run SGD for each step size of the sweep, from the initial factors
+	const std::vector<std::string> gammas =
+		graphlab::strsplit(gamma_sweep, ",", true);
+	if (!gammas.empty()) {
+		const double gamma = sgd_vertex_program::GAMMA;
+		graph_type::data_checkpoint initial;
+		graph.save_data_checkpoint(initial, false);
+		for (size_t i = 0; i < gammas.size(); ++i) {
+			graph.restore_data_checkpoint(initial);
+			// the step size decays during a run
+			sgd_vertex_program::GAMMA = atof(gammas[i].c_str());
+			iter = 0;
+			dc.cout() << "Running SGD with gamma = " << sgd_vertex_program::GAMMA
+				<< std::endl;
+			timer.start();
+			size_t sweep_updates = 0;
+			engine.map_reduce_vertices<graphlab::empty>(sgd_vertex_program::signal_left);
+			if (HOGWILD_EPOCHS > 0) {
+				sweep_updates = run_hogwild_sgd(graph, sgd_edge_update(), engine, iter, clopts);
+			} else {
+				engine.start();
+				sweep_updates = engine.num_updates();
+			}
+			dc.cout() << "Runtime (seconds): " << timer.current_time()
+				<< " Updates executed: " << sweep_updates << std::endl;
+			dc.cout() << "Final error: " << std::endl;
+			engine.aggregate_now("error");
+		}
+		graph.restore_data_checkpoint(initial);
+		sgd_vertex_program::GAMMA = gamma;
+		iter = 0;
+	}
+
 	// Signal all vertices on the vertices on the left (libersgd) 
 	engine.map_reduce_vertices<graphlab::empty>(sgd_vertex_program::signal_left);
-	info = graph.map_reduce_edges<stats_info>(count_edges);
-	dc.cout()<<"Training edges: " << info.training_edges << " validation edges: " << info.validation_edges << std::endl;
 
 
 	// Run the PageRank ---------------------------------------------------------
@@ -644,16 +760,22 @@ int main(int argc, char** argv) {
 	dc.cout() << "Time   Training    Validation" <<std::endl;
 	dc.cout() << "       RMSE        RMSE " <<std::endl;
 	timer.start();
-	engine.start();  
+	size_t num_updates = 0;
+	if (HOGWILD_EPOCHS > 0) {
+		num_updates = run_hogwild_sgd(graph, sgd_edge_update(), engine, iter, clopts);
+	} else {
+		engine.start();  
+		num_updates = engine.num_updates();
+	}
 
 	const double runtime = timer.current_time();
 	dc.cout() << "----------------------------------------------------------"
 		<< std::endl
 		<< "Final Runtime (seconds):   " << runtime 
 						    << std::endl
-								<< "Updates executed: " << engine.num_updates() << std::endl
+								<< "Updates executed: " << num_updates << std::endl
 											      << "Update Rate (updates/second): " 
-												      << engine.num_updates() / runtime << std::endl;
+												      << num_updates / runtime << std::endl;
 
 	// Compute the final training error -----------------------------------------
 	dc.cout() << "Final error: " << std::endl;
@@ -678,6 +800,8 @@ int main(int argc, char** argv) {
 
 	}
 
+	save_topk_recommendations(graph, topk_factor(), SAFE_NEG_OFFSET, clopts);
+
 
 
 	graphlab::mpi_tools::finalize();
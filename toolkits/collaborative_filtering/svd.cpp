@@ -33,6 +33,8 @@
 #include "eigen_serialization.hpp"
 #include <graphlab/util/stl_util.hpp>
 #include <graphlab.hpp>
+#include <graphlab/graph/graph_ops.hpp>
+#include <graphlab/util/integer_mix.hpp>
 
 
 
@@ -75,6 +77,7 @@ DECLARE_TRACER(svd_swork);
 DECLARE_TRACER(svd_vectors);
 
 void start_engine();
+void save_output();
 
 struct vertex_data {
   /** \brief The number of times this vertex has been updated. */
@@ -542,6 +545,12 @@ void lanczos(bipartite_graph_descriptor & info, timer & mytimer, vec & errest,
   }
   END_TRACEPOINT(svd_error2);
 
+  sigma.conservativeResize(nconv);
+  singular_values = sigma;
+  save_output();
+}
+
+void save_output(){
   if (save_vectors){
     if (nconv == 0)
       logstream(LOG_FATAL)<<"No converged vectors. Aborting the save operation" << std::endl;
@@ -561,8 +570,6 @@ void lanczos(bipartite_graph_descriptor & info, timer & mytimer, vec & errest,
     END_TRACEPOINT(svd_vectors);
   }
 
-  sigma.conservativeResize(nconv);
-  singular_values = sigma;
   if(!predictions.empty()) {
     std::cout << "Saving predictions" << std::endl;
     const bool gzip_output = false;
@@ -578,6 +585,242 @@ void lanczos(bipartite_graph_descriptor & info, timer & mytimer, vec & errest,
  
 }
 
+/**
+ * Block Lanczos (--block_size > 1)
+ *
+ * Golub-Kahan bidiagonalization with blocks of b vectors: every graph
+ * pass multiplies a whole block by A or A^T with graph_ops::sparse_multiplier,
+ * and the full reorthogonalization of a block against all previous ones
+ * is one graph_ops::inner_products, which reduces the coefficients of all
+ * previous vectors at once. The basis vectors are kept in local blocks
+ * instead of the vertex data: the U vectors on the rows, the V vectors on
+ * the columns.
+ *
+ * Restarts are thick: the leading Ritz vectors, rounded up to whole
+ * blocks, are kept along with the last V block, so the projected matrix
+ * starts with their singular values on the diagonal.
+ */
+int block_size = 1;
+
+typedef graphlab::graph_ops::local_block local_block;
+
+struct matrix_entry {
+  double operator()(const edge_data& edata) const {
+    return edata.role == edge_data::PREDICT ? 0 : edata.obs;
+  }
+};
+typedef graphlab::graph_ops::sparse_multiplier<graph_type, matrix_entry> block_multiplier;
+
+//copy ncols columns of src starting at src_col to dst starting at dst_col
+void copy_cols(const local_block& src, int src_col, local_block& dst, int dst_col, int ncols){
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int lvid = 0; lvid < (int)src.num_rows(); lvid++)
+    memcpy(dst.row(lvid) + dst_col, src.row(lvid) + src_col, ncols*sizeof(double));
+}
+
+//y = y - basis(:, 0:m) * coef, where coef is m x b
+void subtract_projection(local_block& y, const local_block& basis, const mat& coef){
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int lvid = 0; lvid < (int)y.num_rows(); lvid++){
+    double * yr = y.row(lvid);
+    const double * br = basis.row(lvid);
+    for (int i = 0; i < coef.rows(); i++){
+      if (br[i] == 0) continue;
+      for (int j = 0; j < coef.cols(); j++)
+        yr[j] -= br[i] * coef(i,j);
+    }
+  }
+}
+
+//y = y * m, where m is b x b
+void right_multiply(local_block& y, const mat& m){
+  vec tmp(m.cols());
+#ifdef _OPENMP
+#pragma omp parallel for firstprivate(tmp)
+#endif
+  for (int lvid = 0; lvid < (int)y.num_rows(); lvid++){
+    double * yr = y.row(lvid);
+    tmp.setZero();
+    for (int i = 0; i < m.rows(); i++)
+      for (int j = 0; j < m.cols(); j++)
+        tmp[j] += yr[i] * m(i,j);
+    memcpy(yr, &tmp[0], m.cols()*sizeof(double));
+  }
+}
+
+mat inner_products(const local_block& x, const local_block& y){
+  std::vector<double> ret = graphlab::graph_ops::inner_products(*pgraph, x, y);
+  mat m(x.num_cols(), y.num_cols());
+  for (int i = 0; i < m.rows(); i++)
+    for (int j = 0; j < m.cols(); j++)
+      m(i,j) = ret[i*m.cols()+j];
+  return m;
+}
+
+/**
+ * Orthogonalizes y against the first m columns of basis twice, and
+ * returns the coefficients of the projection (m x b).
+ */
+mat reorthogonalize(local_block& y, const local_block& basis, int m){
+  mat coef = zeros(m, y.num_cols());
+  if (m == 0)
+    return coef;
+  for (int rep = 0; rep < 2; rep++){
+    mat h = inner_products(basis, y).topRows(m);
+    subtract_projection(y, basis, h);
+    coef += h;
+  }
+  return coef;
+}
+
+/**
+ * Orthonormalizes the columns of y in place by the eigendecomposition
+ * of its Gram matrix, twice, and returns r with y_old = y_new * r.
+ * Columns in the (numerical) null space are set to zero.
+ */
+mat orthonormalize(local_block& y){
+  const int b = y.num_cols();
+  mat r = eye(b);
+  for (int rep = 0; rep < 2; rep++){
+    Eigen::SelfAdjointEigenSolver<mat> es(inner_products(y, y));
+    const double maxval = es.eigenvalues().maxCoeff();
+    mat scale = zeros(b, b);
+    mat rr = zeros(b, b);
+    for (int i = 0; i < b; i++){
+      const double lambda = es.eigenvalues()[i];
+      if (maxval > 0 && lambda > 1e-24 * maxval){
+        scale.col(i) = es.eigenvectors().col(i) / std::sqrt(lambda);
+        rr.row(i) = std::sqrt(lambda) * es.eigenvectors().col(i).transpose();
+      }
+    }
+    right_multiply(y, scale);
+    r = rr * r;
+  }
+  return r;
+}
+
+//pseudo random start vectors, identical on all copies of a vertex
+void init_block(local_block& v){
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int lvid = 0; lvid < (int)v.num_rows(); lvid++){
+    const graphlab::vertex_id_type vid = pgraph->l_vertex(lvid).global_id();
+    for (int j = 0; j < (int)v.num_cols(); j++)
+      v(lvid, j) = (vid < (uint)rows) ? 0 :
+        graphlab::integer_mix(vid * v.num_cols() + j) / 4294967296.0 - 0.5;
+  }
+}
+
+//the first ncols columns of basis * coef, stored in the vertex data
+void store_ritz_vectors(const local_block& basis, const mat& coef, bool row_nodes){
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int lvid = 0; lvid < (int)basis.num_rows(); lvid++){
+    graph_type::local_vertex_type vertex = pgraph->l_vertex(lvid);
+    if ((vertex.global_id() < (uint)rows) != row_nodes)
+      continue;
+    vec & pvec = vertex.data().pvec;
+    pvec = zeros(coef.cols());
+    const double * br = basis.row(lvid);
+    for (int i = 0; i < coef.rows(); i++)
+      for (int j = 0; j < coef.cols(); j++)
+        pvec[j] += br[i] * coef(i,j);
+  }
+}
+
+void block_lanczos(timer & mytimer, vec & errest){
+  const int b = block_size;
+  const int steps = (nv + b - 1) / b;
+  const int m = steps * b;
+  block_multiplier multiply(*pgraph, graphlab::ALL_EDGES);
+  local_block U(*pgraph, m), V(*pgraph, m + b);
+  local_block x(*pgraph, b), y(*pgraph, b);
+  logstream(LOG_INFO)<<"Allocated a total of: " << ((double)(2*m + 3*b) * pgraph->num_local_vertices() * sizeof(double)/ 1e6) << " MB for storing blocks." << std::endl;
+
+  init_block(x);
+  orthonormalize(x);
+  copy_cols(x, 0, V, 0, b);
+
+  vec sigma;
+  mat P, Q;
+  errest = zeros(m);
+  int its = 1;
+  int kept = 0;
+  nconv = 0;
+  while(true){
+    logstream(LOG_EMPH)<<"Starting iteration: " << its << " at time: " << mytimer.current_time() << std::endl;
+    mat T = zeros(m, m);
+    for (int i = 0; i < kept; i++)
+      T(i,i) = sigma[i];
+    mat S;
+    for (int j = kept / b; j < steps; j++){
+      //U_j = A V_j, orthogonalized against U_0..U_j-1
+      copy_cols(V, j*b, x, 0, b);
+      multiply(x, y);
+      T.block(0, j*b, j*b, b) = reorthogonalize(y, U, j*b);
+      T.block(j*b, j*b, b, b) = orthonormalize(y);
+      copy_cols(y, 0, U, j*b, b);
+      //V_j+1 = A^T U_j, orthogonalized against V_0..V_j
+      multiply(y, x);
+      reorthogonalize(x, V, (j+1)*b);
+      S = orthonormalize(x);
+      copy_cols(x, 0, V, (j+1)*b, b);
+    }
+
+    //A^T U P = V Q sigma + V_s S P(last block rows) 
+    Eigen::JacobiSVD<mat> svdT(T, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    sigma = svdT.singularValues();
+    P = svdT.matrixU();
+    Q = svdT.matrixV();
+    int converged = 0;
+    for (int i = 0; i < m; i++){
+      errest[i] = (S * P.block(m-b, i, b, 1)).norm();
+      if (sigma[i] > tol)
+        errest[i] /= sigma[i];
+      if (errest[i] < tol && converged == i) 
+        converged++;
+    }
+    nconv = std::min(converged, nsv);
+    if (nconv >= nsv || its >= max_iter)
+      break;
+
+    //restart from the leading Ritz vectors and the last V block
+    kept = std::min(b * ((nsv + b - 1) / b), m - b);
+    copy_cols(V, m, x, 0, b);
+    if (kept > 0){
+      right_multiply(U, P.leftCols(kept));
+      right_multiply(V, Q.leftCols(kept));
+    }
+    else {
+      //a single block per iteration: restart from the leading right Ritz vectors
+      right_multiply(V, Q.leftCols(b));
+      copy_cols(V, 0, x, 0, b);
+      orthonormalize(x);
+    }
+    copy_cols(x, 0, V, kept, b);
+    its++;
+  }
+
+  printf(" Number of computed signular values %d",nconv);
+  printf("\n");
+  for (int i=0; i < nconv; i++)
+    printf("Singular value %d \t%13.6g\tError estimate: %13.6g\n", i, sigma(i), errest(i));
+
+  //the basis U has m columns and V m+b: V's extra block is not part of the Ritz vectors
+  store_ritz_vectors(U, P.leftCols(nconv), true);
+  local_block V_s(*pgraph, m);
+  copy_cols(V, 0, V_s, 0, m);
+  store_ritz_vectors(V_s, Q.leftCols(nconv), false);
+  singular_values = sigma.head(nconv);
+  errest.conservativeResize(nconv);
+}
+
 void start_engine(){
   vertex_set nodes = pgraph->select(selected_node);
   pengine->signal_vset(nodes);
@@ -635,6 +878,7 @@ int main(int argc, char** argv) {
   clopts.attach_option("predictions", predictions, "predictions file prefix");
   clopts.attach_option("binary", binary, "If true, all edges are weighted as one");
   clopts.attach_option("input_file_offset", input_file_offset, "input file node id offset (default 0)");
+  clopts.attach_option("block_size", block_size, "If larger than 1, runs block Lanczos with this many vectors per block (nv is rounded up to a multiple)");
   if(!clopts.parse(argc, argv) || input_dir == "") {
     std::cout << "Error in parsing command line arguments." << std::endl;
     clopts.print_description();
@@ -740,28 +984,38 @@ int main(int argc, char** argv) {
   dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
   timer.start();
 
-  init_lanczos(&graph, info);
-  init_math(&graph, info, ortho_repeats, update_function);
-  if (vecfile.size() > 0){
-    std::cout << "Load inital vector from file" << vecfile << std::endl;
-    FILE * file = fopen((vecfile).c_str(), "r");
-    if (file == NULL)
-      logstream(LOG_FATAL)<<"Failed to open initial vector"<< std::endl;
-    vec input = vec::Zero(rows);
-    double val = 0;
-    for (int i=0; i< rows; i++){
-      int rc = fscanf(file, "%lg\n", &val);
-      if (rc != 1)
-        logstream(LOG_FATAL)<<"Failed to read initial vector (on line: "<< i << " ) " << std::endl;
-      input[i] = val;
-    }
-    fclose(file);
-    DistVec v0(info, 0, false, "v0");
-    v0 = input;
-  }  
-
   vec errest;
-  lanczos( info, timer, errest, vecfile);
+  if (block_size > 1){
+    if (vecfile.size() > 0)
+      logstream(LOG_WARNING)<<"The initial vector is ignored by block Lanczos" << std::endl;
+    if (info.is_square())
+      logstream(LOG_FATAL)<<"Block Lanczos does not support square matrices" << std::endl;
+    block_lanczos(timer, errest);
+    save_output();
+  }
+  else {
+    init_lanczos(&graph, info);
+    init_math(&graph, info, ortho_repeats, update_function);
+    if (vecfile.size() > 0){
+      std::cout << "Load inital vector from file" << vecfile << std::endl;
+      FILE * file = fopen((vecfile).c_str(), "r");
+      if (file == NULL)
+        logstream(LOG_FATAL)<<"Failed to open initial vector"<< std::endl;
+      vec input = vec::Zero(rows);
+      double val = 0;
+      for (int i=0; i< rows; i++){
+        int rc = fscanf(file, "%lg\n", &val);
+        if (rc != 1)
+          logstream(LOG_FATAL)<<"Failed to read initial vector (on line: "<< i << " ) " << std::endl;
+        input[i] = val;
+      }
+      fclose(file);
+      DistVec v0(info, 0, false, "v0");
+      v0 = input;
+    }  
+
+    lanczos( info, timer, errest, vecfile);
+  }
 
   if (graphlab::mpi_tools::rank()==0)
     write_output_vector(predictions + ".singular_values", singular_values, false, "%GraphLab SVD Solver library. This file contains the singular values.");
@@ -77,11 +77,14 @@ struct vertex_data {
   vec_type pvec;
   vec_type weight;
   double bias;
+  /** \brief 1/sqrt(#ratings) of a user, cached by the Hogwild path
+   *  and not saved */
+  double norm;
   /** 
    * \brief Simple default constructor which randomizes the vertex
    *  data 
    */
-  vertex_data() : nupdates(0) { randomize(); } 
+  vertex_data() : nupdates(0), norm(0) { randomize(); } 
   /** \brief Randomizes the latent pvec */
   void randomize() { pvec.resize(NLATENT); pvec.setRandom(); weight.resize(NLATENT); weight.setRandom(); }
   /** \brief Save the vertex data to a binary archive */
@@ -92,6 +95,17 @@ struct vertex_data {
   void load(graphlab::iarchive& arc) { 
     arc >> nupdates >> pvec >> weight >> bias;
   }
+  /** \brief The parameters averaged across the copies by Hogwild:
+   *  [pvec; weight; bias] */
+  void get_params(vec_type& params) const { 
+    params.resize(pvec.size() + weight.size() + 1);
+    params << pvec, weight, bias;
+  }
+  void set_params(const vec_type& params) { 
+    pvec = params.head(pvec.size());
+    weight = params.segment(pvec.size(), weight.size());
+    bias = params[pvec.size() + weight.size()];
+  }
 }; // end of vertex data
 
 
@@ -131,6 +145,7 @@ struct edge_data : public graphlab::IS_POD_TYPE {
 typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
 
 #include "implicit.hpp"
+#include "hogwild.hpp"
 
 double extract_l2_error(const graph_type::edge_type & edge);
 
@@ -631,6 +646,59 @@ bool svdpp_vertex_program::debug = false;
 double svdpp_vertex_program::GLOBAL_MEAN = 0;
 size_t svdpp_vertex_program::NUM_TRAINING_EDGES = 0;
 
+
+/**
+ * \brief The PHASE2 step of the vertex program applied to one training
+ * edge by the Hogwild path: both ends move in place. The PHASE1 sum of
+ * the item weights of each user is recomputed before every epoch.
+ */
+struct svdpp_edge_update {
+  bool train(const edge_data& edge) const { 
+    return edge.role == edge_data::TRAIN; 
+  }
+  void operator()(vertex_data& user, vertex_data& item, 
+                  const edge_data& edge) const {
+    double pred = svdpp_vertex_program::GLOBAL_MEAN + 
+      user.bias + item.bias + user.pvec.dot(item.pvec + item.weight);
+    pred = std::min(pred, svdpp_vertex_program::MAXVAL);
+    pred = std::max(pred, svdpp_vertex_program::MINVAL);
+    const double err = edge.obs - pred;
+    const vec_type usrFctr = user.pvec;
+    user.bias += usrBiasStep*(err - usrBiasReg*user.bias);
+    item.bias += itmBiasStep*(err - itmBiasReg*item.bias);
+    user.pvec += usrFctrStep*(err*(item.pvec - usrFctrReg*usrFctr));
+    item.weight += itmFctr2Step*(err*user.norm*item.pvec - itmFctr2Reg*item.weight);
+    item.pvec += itmFctrStep*(err*(usrFctr + user.weight) - itmFctrReg*item.pvec);
+  }
+
+  static gather_type gather_item_weights(graphlab::lvid_type lvid, graph_type& graph) {
+    graph_type::local_vertex_type vtx = graph.l_vertex(lvid);
+    if (vtx.num_out_edges() == 0) 
+      return gather_type();
+    gather_type ret(vec_type::Zero(vertex_data::NLATENT), 
+                    vec_type::Zero(vertex_data::NLATENT), 0);
+    foreach(graph_type::local_edge_type edge, vtx.out_edges())
+      ret.weight += edge.target().data().weight;
+    return ret;
+  }
+
+  static void apply_user_weight(graphlab::lvid_type lvid, const gather_type& sum, 
+                                graph_type& graph) {
+    const graph_type::vertex_type vertex(graph.l_vertex(lvid));
+    if (vertex.num_out_edges() == 0) 
+      return;
+    vertex_data& vdata = graph.l_vertex(lvid).data();
+    vdata.norm = 1.0/sqrt(vertex.num_out_edges());
+    vdata.weight = sum.weight * vdata.norm;
+  }
+
+  void start_epoch(graph_type& graph, const graphlab::graphlab_options& opts) const {
+    graphlab::graph_gather_apply<graph_type, gather_type> 
+      sync(graph, gather_item_weights, apply_user_weight, opts);
+    sync.exec();
+  }
+}; // end of svdpp_edge_update
+
 /**
  * \brief The engine type used by the ALS matrix factorization
  * algorithm.
@@ -641,13 +709,13 @@ size_t svdpp_vertex_program::NUM_TRAINING_EDGES = 0;
  */
 typedef graphlab::omni_engine<svdpp_vertex_program> engine_type;
 
-  double calc_global_mean(const graph_type::edge_type & edge){
+  double calc_global_mean(const graph_type::csr_edge_type & edge){
     if (edge.data().role == edge_data::TRAIN)
       return edge.data().obs;
     else return 0;
   }
 
-  size_t count_edges(const graph_type::edge_type & edge){
+  size_t count_edges(const graph_type::csr_edge_type & edge){
     if (edge.data().role == edge_data::TRAIN)
       return 1;
     else return 0;
@@ -702,6 +770,7 @@ int main(int argc, char** argv) {
   clopts.attach_option("output", output_dir, "Output results");
 
   parse_implicit_command_line(clopts);
+  parse_hogwild_command_line(clopts);
 
   if(!clopts.parse(argc, argv) || input_dir == "") {
     std::cout << "Error in parsing command line arguments." << std::endl;
@@ -763,8 +832,8 @@ int main(int argc, char** argv) {
   ASSERT_TRUE(success);
 
 
-  svdpp_vertex_program::GLOBAL_MEAN = graph.map_reduce_edges<double>(calc_global_mean);
-  svdpp_vertex_program::NUM_TRAINING_EDGES = graph.map_reduce_edges<size_t>(count_edges);
+  svdpp_vertex_program::GLOBAL_MEAN = graph.map_reduce_csr_edges<double>(calc_global_mean);
+  svdpp_vertex_program::NUM_TRAINING_EDGES = graph.map_reduce_csr_edges<size_t>(count_edges);
   svdpp_vertex_program::GLOBAL_MEAN /= svdpp_vertex_program::NUM_TRAINING_EDGES;
   dc.cout() << "Global mean is: " <<svdpp_vertex_program::GLOBAL_MEAN << std::endl;
 
@@ -779,16 +848,22 @@ int main(int argc, char** argv) {
   dc.cout() << "Time   Training    Validation" <<std::endl;
   dc.cout() << "       RMSE        RMSE " <<std::endl;
   timer.start();
-  engine.start();  
+  size_t num_updates = 0;
+  if (HOGWILD_EPOCHS > 0) {
+    num_updates = run_hogwild_sgd(graph, svdpp_edge_update(), engine, iter, clopts);
+  } else {
+    engine.start();  
+    num_updates = engine.num_updates();
+  }
 
   const double runtime = timer.current_time();
   dc.cout() << "----------------------------------------------------------"
     << std::endl
     << "Final Runtime (seconds):   " << runtime 
                                         << std::endl
-                                        << "Updates executed: " << engine.num_updates() << std::endl
+                                        << "Updates executed: " << num_updates << std::endl
                                         << "Update Rate (updates/second): " 
-                                          << engine.num_updates() / runtime << std::endl;
+                                          << num_updates / runtime << std::endl;
 
   // Compute the final training error -----------------------------------------
   dc.cout() << "Final error: " << std::endl;
@@ -0,0 +1,286 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+#ifndef TOPK_HPP
+#define TOPK_HPP
+
+/**
+ * \file topk.hpp
+ *
+ * Batch top-K recommendation from a trained factor model: for every
+ * user, the K items with the highest predicted rating among the items
+ * the user has not rated (the items of PREDICT edges stay candidates).
+ *
+ * The item factors are replicated on every machine as one dense
+ * matrix, and each machine scores the users it owns (the masters) in
+ * blocks, with one matrix product per block of users and block of
+ * items, keeping a bounded heap per user. Each machine writes
+ * [prefix]_[k]_of_[N] with lines
+ * \code
+ * user item1:score1 item2:score2 ... itemK:scoreK
+ * \endcode
+ * sorted by decreasing score.
+ */
+
+#include <vector>
+#include <queue>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <Eigen/Dense>
+#include <graphlab.hpp>
+#include "eigen_serialization.hpp"
+
+/// The number of items to recommend to each user, 0 for none
+size_t TOPK = 0;
+/// The prefix of the files of recommendations
+std::string TOPK_OUTPUT;
+
+void parse_topk_command_line(graphlab::command_line_options & clopts){
+  clopts.attach_option("topk", TOPK,
+                       "If set, recommend this many unrated items to every user "
+                       "after training");
+  clopts.attach_option("topk_output", TOPK_OUTPUT,
+                       "The prefix (folder and filename) of the top-K recommendations");
+}
+
+
+/**
+ * Computes and saves the top-K recommendations. FactorFn maps the
+ * vertex data to its factor as an Eigen::VectorXd, and item ids are
+ * printed as -vid - item_offset, the toolkit convention for items.
+ * All machines must call run().
+ */
+template <typename Graph, typename FactorFn>
+class topk_recommender {
+public:
+  typedef Graph graph_type;
+  typedef typename graph_type::vertex_type       vertex_type;
+  typedef typename graph_type::local_vertex_type local_vertex_type;
+  typedef typename graph_type::local_edge_type   local_edge_type;
+  typedef typename graph_type::edge_data_type    edge_data_type;
+  typedef graphlab::vertex_id_type               vertex_id_type;
+  typedef graphlab::lvid_type                    lvid_type;
+  typedef Eigen::MatrixXf matrix_type;
+
+  /// Users and items scored by one matrix product
+  enum { USER_BLOCK = 256, ITEM_BLOCK = 4096 };
+
+  topk_recommender(graph_type& graph, FactorFn factor_fn,
+                   vertex_id_type item_offset) :
+    graph(graph), factor_fn(factor_fn), item_offset(item_offset) { }
+
+  void run(size_t k, const std::string& prefix,
+           const graphlab::graphlab_options& opts) {
+    graphlab::timer timer;
+    gather_items();
+    gather_rated(opts);
+    std::vector<lvid_type> users;
+    for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      if (graph.l_is_master(lvid) && 
+          vertex_type(graph.l_vertex(lvid)).num_out_edges() > 0) {
+        users.push_back(lvid);
+      }
+    }
+    graphlab::distributed_control& dc = graph.dc();
+    const std::string fname = prefix + "_" + graphlab::tostr(dc.procid() + 1) +
+      "_of_" + graphlab::tostr(dc.numprocs());
+    std::ofstream out(fname.c_str());
+    if (!out.good()) 
+      logstream(LOG_FATAL) << "Failed to create " << fname << std::endl;
+    const size_t nblocks = (users.size() + USER_BLOCK - 1) / USER_BLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int b = 0; b < (int)nblocks; ++b) {
+      const size_t begin = b * USER_BLOCK;
+      const size_t end = std::min<size_t>(users.size(), begin + USER_BLOCK);
+      const std::string lines = recommend_block(users, begin, end, k);
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      out << lines;
+    }
+    out.close();
+    dc.cout() << "Top-" << k << " recommendations saved to " << prefix 
+              << " in " << timer.current_time() << " seconds" << std::endl;
+    dc.full_barrier();
+  } // end of run
+
+private:
+  typedef std::pair<float, size_t> scored_item;
+  typedef std::priority_queue<scored_item, std::vector<scored_item>,
+                              std::greater<scored_item> > min_heap;
+
+  /// Replicates the item factors (rows of items) and their ids on every machine
+  void gather_items() {
+    typedef std::vector<std::pair<vertex_id_type, Eigen::VectorXd> > factor_list;
+    graphlab::distributed_control& dc = graph.dc();
+    std::vector<factor_list> all(dc.numprocs());
+    for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      if (graph.l_is_master(lvid) &&
+          vertex_type(graph.l_vertex(lvid)).num_in_edges() > 0) {
+        all[dc.procid()].push_back(std::make_pair(graph.global_vid(lvid),
+              factor_fn(graph.l_vertex(lvid).data())));
+      }
+    }
+    dc.all_gather(all);
+    size_t nitems = 0, dim = 0;
+    for (size_t p = 0; p < all.size(); ++p) {
+      nitems += all[p].size();
+      if (!all[p].empty()) dim = all[p][0].second.size();
+    }
+    items.resize(nitems, dim);
+    item_ids.clear();
+    for (size_t p = 0; p < all.size(); ++p) {
+      for (size_t i = 0; i < all[p].size(); ++i) {
+        items.row(item_ids.size()) = all[p][i].second.cast<float>().transpose();
+        item_ids.push_back(all[p][i].first);
+      }
+    }
+    // the rated items of a user are looked up by index
+    std::vector<std::pair<vertex_id_type, size_t> > order(nitems);
+    for (size_t i = 0; i < nitems; ++i) order[i] = std::make_pair(item_ids[i], i);
+    std::sort(order.begin(), order.end());
+    sorted_item_ids.resize(nitems);
+    sorted_item_index.resize(nitems);
+    for (size_t i = 0; i < nitems; ++i) {
+      sorted_item_ids[i] = order[i].first;
+      sorted_item_index[i] = order[i].second;
+    }
+  } // end of gather_items
+
+  struct item_list {
+    std::vector<vertex_id_type> ids;
+    item_list& operator+=(const item_list& other) {
+      ids.insert(ids.end(), other.ids.begin(), other.ids.end());
+      return *this;
+    }
+    void save(graphlab::oarchive& oarc) const { oarc << ids; }
+    void load(graphlab::iarchive& iarc) { iarc >> ids; }
+  };
+
+  static item_list gather_rated_items(lvid_type lvid, graph_type& graph) {
+    item_list ret;
+    foreach(local_edge_type edge, graph.l_vertex(lvid).out_edges()) {
+      if (edge.data().role != edge_data_type::PREDICT) {
+        ret.ids.push_back(graph.global_vid(edge.target().id()));
+      }
+    }
+    return ret;
+  }
+
+  void store_rated_items(lvid_type lvid, const item_list& rated, graph_type& graph) {
+    if (!graph.l_is_master(lvid)) return;
+    std::vector<size_t>& index = rated_items[lvid];
+    index.clear();
+    for (size_t i = 0; i < rated.ids.size(); ++i) {
+      typename std::vector<vertex_id_type>::const_iterator it = 
+        std::lower_bound(sorted_item_ids.begin(), sorted_item_ids.end(), rated.ids[i]);
+      if (it != sorted_item_ids.end() && *it == rated.ids[i]) {
+        index.push_back(sorted_item_index[it - sorted_item_ids.begin()]);
+      }
+    }
+    std::sort(index.begin(), index.end());
+  }
+
+  /// Collects on the master of every user the rows of the items it rated
+  void gather_rated(const graphlab::graphlab_options& opts) {
+    rated_items.clear();
+    rated_items.resize(graph.num_local_vertices());
+    graphlab::graph_gather_apply<graph_type, item_list> 
+        sync(graph, gather_rated_items, 
+             boost::bind(&topk_recommender::store_rated_items, this, _1, _2, _3),
+             opts);
+    sync.exec();
+  }
+
+  /// Scores users[begin, end) against all the items
+  std::string recommend_block(const std::vector<lvid_type>& users, 
+                              size_t begin, size_t end, size_t k) {
+    const size_t nusers = end - begin;
+    matrix_type factors(nusers, items.cols());
+    for (size_t u = 0; u < nusers; ++u) {
+      factors.row(u) = factor_fn(graph.l_vertex(users[begin + u]).data()).template cast<float>().transpose();
+    }
+    std::vector<min_heap> heaps(nusers);
+    std::vector<size_t> next_rated(nusers, 0);
+    matrix_type scores;
+    for (size_t i0 = 0; i0 < size_t(items.rows()); i0 += ITEM_BLOCK) {
+      const size_t nitems = std::min<size_t>(ITEM_BLOCK, items.rows() - i0);
+      scores.noalias() = factors * items.middleRows(i0, nitems).transpose();
+      for (size_t u = 0; u < nusers; ++u) {
+        const std::vector<size_t>& rated = rated_items[users[begin + u]];
+        size_t& r = next_rated[u];
+        min_heap& heap = heaps[u];
+        for (size_t i = 0; i < nitems; ++i) {
+          const size_t item = i0 + i;
+          while (r < rated.size() && rated[r] < item) ++r;
+          if (r < rated.size() && rated[r] == item) continue;
+          const float score = scores(u, i);
+          if (heap.size() < k) heap.push(scored_item(score, item));
+          else if (score > heap.top().first) {
+            heap.pop();
+            heap.push(scored_item(score, item));
+          }
+        }
+      }
+    }
+    std::stringstream strm;
+    std::vector<scored_item> best;
+    for (size_t u = 0; u < nusers; ++u) {
+      best.clear();
+      while (!heaps[u].empty()) { best.push_back(heaps[u].top()); heaps[u].pop(); }
+      strm << graph.global_vid(users[begin + u]);
+      for (size_t i = best.size(); i > 0; --i) {
+        strm << ' ' << -graphlab::vertex_id_type(item_ids[best[i - 1].second]) - item_offset
+             << ':' << best[i - 1].first;
+      }
+      strm << '\n';
+    }
+    return strm.str();
+  } // end of recommend_block
+
+  graph_type& graph;
+  FactorFn factor_fn;
+  const vertex_id_type item_offset;
+  matrix_type items;
+  std::vector<vertex_id_type> item_ids;
+  std::vector<vertex_id_type> sorted_item_ids;
+  std::vector<size_t> sorted_item_index;
+  std::vector<std::vector<size_t> > rated_items;
+}; // end of topk_recommender
+
+
+/// Runs the top-K stage if --topk was given
+template <typename Graph, typename FactorFn>
+void save_topk_recommendations(Graph& graph, FactorFn factor_fn,
+                               graphlab::vertex_id_type item_offset,
+                               const graphlab::graphlab_options& opts) {
+  if (TOPK == 0) return;
+  if (TOPK_OUTPUT.empty()) {
+    logstream(LOG_FATAL) << "--topk requires --topk_output" << std::endl;
+  }
+  topk_recommender<Graph, FactorFn> recommender(graph, factor_fn, item_offset);
+  recommender.run(TOPK, TOPK_OUTPUT, opts);
+}
+
+#endif
@@ -40,6 +40,7 @@
 
 // This file defines the serialization code for the eigen types.
 #include "eigen_serialization.hpp"
+#include "gram_block.hpp"
 
 #include <graphlab.hpp>
 #include <graphlab/util/stl_util.hpp>
@@ -230,6 +231,12 @@ public:
     Xy = X * y * weight;
   } // end of constructor for gather type
 
+  /**
+   * \brief Takes the sums accumulated by a gather_batch
+   */
+  explicit gather_type(const gram_block& block) :
+    XtX(block.upper_XtX()), Xy(block.sum_Xy()), weight(1) { }
+
   /** \brief Save the values to a binary archive */
   void save(graphlab::oarchive& arc) const { arc << XtX << Xy << weight; }
 
@@ -317,6 +324,24 @@ public:
     } else return gather_type();
   } // end of gather function
 
+  /**
+   * Gathers all the TRAIN edges of one direction with blocked rank-k
+   * updates (see gram_block) instead of one rank-1 update per edge.
+   */
+  bool gather_batch(icontext_type& context, const vertex_type& vertex,
+                    const local_edge_span_type& edges,
+                    gather_type& accum) const {
+    gram_block block(vertex.data().factor.size());
+    for(size_t i = 0; i < edges.size(); ++i) {
+      const edge_data& edata = edges.edge_data(i);
+      if(edata.role == edge_data::TRAIN)
+        block.add(edges.neighbor_data(i).factor, edata.obs, edata.weight);
+    }
+    block.flush();
+    if(!block.empty()) accum = gather_type(block);
+    return true;
+  } // end of gather_batch
+
   /** apply collects the sum of XtX and Xy */
   void apply(icontext_type& context, vertex_type& vertex,
              const gather_type& sum) {
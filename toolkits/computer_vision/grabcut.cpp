@@ -22,6 +22,16 @@
 #include "opencv2/imgproc/imgproc.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cfloat>
+#include <cmath>
+
+#include <boost/bind.hpp>
+#include <graphlab/options/command_line_options.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/timer.hpp>
 
 using namespace std;
 using namespace cv;
@@ -32,6 +42,8 @@ void help()
     		"and then grabcut will attempt to segment it out.\n"
     		"Call:\n"
     		"./grabcut <image_name>\n"
+    		"or, to segment a list of images without interaction:\n"
+    		"./grabcut --batch <image_list> [--output <dir>] [--ncpus <n>]\n"
     	"\nSelect a rectangular area around the object you want to segment\n" <<
         "\nHot keys: \n"
         "\tESC - quit the program\n"
@@ -286,6 +298,273 @@ int GCApplication::nextIter()
     return iterCount;
 }
 
+/*
+ * Batch mode: segments every image of a list without any interaction,
+ * with one task per image on a pool of worker threads.
+ *
+ * Each line of the list is an image file name, optionally followed by
+ * the rectangle "x y width height" around the object. Without a
+ * rectangle, the object is assumed to lie within a border of
+ * batch_margin of the image size on each side.
+ */
+
+/// The number of components of the color models of OpenCV's grabCut
+const int GMM_COMPONENTS = 5;
+
+/**
+ * Evaluates the log-likelihood of whole rows of pixels under a color model
+ * produced by grabCut, which stores the weights of the components followed
+ * by their means and their covariances.
+ *
+ * The inverse covariances and the normalization of each component are
+ * computed once, and each row is evaluated one component at a time over
+ * contiguous arrays of channels, so that the inner loops vectorize.
+ */
+class GMMRowEvaluator
+{
+public:
+    void setModel( const Mat& model );
+    /// loglik[x] = log p(row[x]) up to a constant, for the cols pixels of row
+    void logLikelihood( const Vec3b* row, int cols, float* loglik );
+private:
+    int ncomp;
+    float logNorm[GMM_COMPONENTS];
+    float mean[GMM_COMPONENTS][3];
+    // the 6 distinct entries of the symmetric inverse covariances
+    float inv[GMM_COMPONENTS][6];
+    vector<float> c0, c1, c2, comp;
+};
+
+void GMMRowEvaluator::setModel( const Mat& model )
+{
+    const double* coefs = model.ptr<double>(0);
+    const double* means = coefs + GMM_COMPONENTS;
+    const double* covs = means + 3 * GMM_COMPONENTS;
+    ncomp = 0;
+    for( int ci = 0; ci < GMM_COMPONENTS; ci++ )
+    {
+        if( coefs[ci] <= 0 )
+            continue;
+        const double* c = covs + 9 * ci;
+        const double det = c[0]*(c[4]*c[8]-c[5]*c[7])
+                         - c[1]*(c[3]*c[8]-c[5]*c[6])
+                         + c[2]*(c[3]*c[7]-c[4]*c[6]);
+        if( det <= 0 )
+            continue;
+        float* iv = inv[ncomp];
+        iv[0] = (float)((c[4]*c[8] - c[5]*c[7]) / det);
+        iv[1] = (float)((c[2]*c[7] - c[1]*c[8]) / det);
+        iv[2] = (float)((c[1]*c[5] - c[2]*c[4]) / det);
+        iv[3] = (float)((c[0]*c[8] - c[2]*c[6]) / det);
+        iv[4] = (float)((c[2]*c[3] - c[0]*c[5]) / det);
+        iv[5] = (float)((c[0]*c[4] - c[1]*c[3]) / det);
+        for( int k = 0; k < 3; k++ )
+            mean[ncomp][k] = (float)means[3 * ci + k];
+        logNorm[ncomp] = (float)(log(coefs[ci]) - 0.5 * log(det));
+        ncomp++;
+    }
+}
+
+void GMMRowEvaluator::logLikelihood( const Vec3b* row, int cols, float* loglik )
+{
+    c0.resize(cols); c1.resize(cols); c2.resize(cols); comp.resize(cols);
+    float* p0 = &c0[0]; float* p1 = &c1[0]; float* p2 = &c2[0];
+    float* pc = &comp[0];
+    for( int x = 0; x < cols; x++ )
+    {
+        p0[x] = row[x][0]; p1[x] = row[x][1]; p2[x] = row[x][2];
+        loglik[x] = -FLT_MAX;
+    }
+    for( int ci = 0; ci < ncomp; ci++ )
+    {
+        const float m0 = mean[ci][0], m1 = mean[ci][1], m2 = mean[ci][2];
+        const float* iv = inv[ci];
+        const float a = iv[0], b = iv[1], c = iv[2], d = iv[3], e = iv[4], f = iv[5];
+        const float norm = logNorm[ci];
+        for( int x = 0; x < cols; x++ )
+        {
+            const float d0 = p0[x] - m0, d1 = p1[x] - m1, d2 = p2[x] - m2;
+            pc[x] = norm - 0.5f * (a*d0*d0 + d*d1*d1 + f*d2*d2
+                                   + 2.f*(b*d0*d1 + c*d0*d2 + e*d1*d2));
+        }
+        // log(exp(l) + exp(q)) = max + log(1 + exp(min - max))
+        for( int x = 0; x < cols; x++ )
+        {
+            const float hi = std::max(loglik[x], pc[x]);
+            const float lo = std::min(loglik[x], pc[x]);
+            loglik[x] = hi + log1pf(expf(lo - hi));
+        }
+    }
+}
+
+/// The buffers of a worker, reused from one image to the next
+struct BatchBuffers
+{
+    Mat image, mask, bgdModel, fgdModel, binMask, prob;
+    GMMRowEvaluator bgd, fgd;
+    vector<float> bgdLik, fgdLik;
+};
+
+struct BatchJob
+{
+    string filename;
+    Rect rect;
+    bool hasRect;
+};
+
+struct BatchOptions
+{
+    int iters;
+    double margin;
+    string outdir;
+    bool soft;
+};
+
+string batchOutputName( const BatchOptions& opts, const string& filename, const string& suffix )
+{
+    size_t slash = filename.find_last_of('/');
+    string base = slash == string::npos ? filename : filename.substr(slash + 1);
+    size_t dot = base.find_last_of('.');
+    if( dot != string::npos )
+        base = base.substr(0, dot);
+    return opts.outdir + "/" + base + suffix;
+}
+
+/**
+ * Writes the probability of the foreground color model against the
+ * background one, using the models fitted by the last grabCut iteration.
+ */
+void writeSoftMask( BatchBuffers& buf, const BatchOptions& opts, const string& filename )
+{
+    const Mat& image = buf.image;
+    buf.bgd.setModel( buf.bgdModel );
+    buf.fgd.setModel( buf.fgdModel );
+    buf.prob.create( image.size(), CV_8UC1 );
+    buf.bgdLik.resize( image.cols );
+    buf.fgdLik.resize( image.cols );
+    for( int y = 0; y < image.rows; y++ )
+    {
+        const Vec3b* row = image.ptr<Vec3b>(y);
+        buf.bgd.logLikelihood( row, image.cols, &buf.bgdLik[0] );
+        buf.fgd.logLikelihood( row, image.cols, &buf.fgdLik[0] );
+        uchar* out = buf.prob.ptr<uchar>(y);
+        for( int x = 0; x < image.cols; x++ )
+        {
+            const float p = 1.f / (1.f + expf(buf.bgdLik[x] - buf.fgdLik[x]));
+            out[x] = saturate_cast<uchar>(255.f * p);
+        }
+    }
+    imwrite( batchOutputName(opts, filename, "_prob.png"), buf.prob );
+}
+
+bool segmentImage( BatchBuffers& buf, const BatchOptions& opts, const BatchJob& job )
+{
+    buf.image = imread( job.filename, 1 );
+    if( buf.image.empty() )
+    {
+        cerr << "Couldn't read image " << job.filename << endl;
+        return false;
+    }
+    Rect rect = job.rect;
+    if( !job.hasRect )
+    {
+        const int mx = (int)(opts.margin * buf.image.cols);
+        const int my = (int)(opts.margin * buf.image.rows);
+        rect = Rect( mx, my, buf.image.cols - 2 * mx, buf.image.rows - 2 * my );
+    }
+    rect &= Rect( 0, 0, buf.image.cols, buf.image.rows );
+    if( rect.width <= 0 || rect.height <= 0 )
+    {
+        cerr << "Empty rectangle for image " << job.filename << endl;
+        return false;
+    }
+    // create() keeps the allocation when the size does not change
+    buf.mask.create( buf.image.size(), CV_8UC1 );
+    grabCut( buf.image, buf.mask, rect, buf.bgdModel, buf.fgdModel,
+             opts.iters, GC_INIT_WITH_RECT );
+    getBinMask( buf.mask, buf.binMask );
+    buf.binMask *= 255;
+    imwrite( batchOutputName(opts, job.filename, "_mask.png"), buf.binMask );
+    if( opts.soft )
+        writeSoftMask( buf, opts, job.filename );
+    return true;
+}
+
+void batchWorker( BatchBuffers* buf, const BatchOptions* opts,
+                  const vector<BatchJob>* jobs, graphlab::atomic<size_t>* next,
+                  graphlab::atomic<size_t>* failed )
+{
+    for( size_t i = next->inc_ret_last(); i < jobs->size(); i = next->inc_ret_last() )
+        if( !segmentImage( *buf, *opts, (*jobs)[i] ) )
+            failed->inc();
+}
+
+bool readBatchList( const string& listfile, vector<BatchJob>& jobs )
+{
+    ifstream fin( listfile.c_str() );
+    if( !fin.good() )
+        return false;
+    string line;
+    while( getline(fin, line) )
+    {
+        istringstream strm( line );
+        BatchJob job;
+        if( !(strm >> job.filename) )
+            continue;
+        job.hasRect = (bool)(strm >> job.rect.x >> job.rect.y >> job.rect.width >> job.rect.height);
+        jobs.push_back( job );
+    }
+    return true;
+}
+
+int batchMain( int argc, char** argv )
+{
+    graphlab::command_line_options clopts( "Batch GrabCut segmentation" );
+    string listfile;
+    BatchOptions opts;
+    opts.iters = 5;
+    opts.margin = 0.05;
+    opts.outdir = ".";
+    opts.soft = false;
+    clopts.attach_option( "batch", listfile,
+                          "File listing the images to segment, one per line, "
+                          "each optionally followed by the rectangle x y width height." );
+    clopts.attach_option( "iters", opts.iters, "The number of GrabCut iterations per image." );
+    clopts.attach_option( "margin", opts.margin,
+                          "Fraction of the image size left on each side of the "
+                          "rectangle, for images listed without one." );
+    clopts.attach_option( "output", opts.outdir, "The directory of the output masks." );
+    clopts.attach_option( "soft", opts.soft,
+                          "Also write the foreground probability of each pixel "
+                          "under the final color models." );
+    if( !clopts.parse(argc, argv) )
+        return 1;
+
+    vector<BatchJob> jobs;
+    if( !readBatchList(listfile, jobs) )
+    {
+        cerr << "Couldn't read the list " << listfile << endl;
+        return 1;
+    }
+    // the images are the unit of parallelism: keep OpenCV single threaded
+    setNumThreads( 0 );
+
+    const size_t nworkers = std::max<size_t>( 1, clopts.get_ncpus() );
+    vector<BatchBuffers> buffers( nworkers );
+    graphlab::atomic<size_t> next( 0 ), failed( 0 );
+    graphlab::timer ti;
+    graphlab::thread_pool pool( nworkers );
+    for( size_t t = 0; t < nworkers; t++ )
+        pool.launch( boost::bind(batchWorker, &buffers[t], &opts, &jobs, &next, &failed) );
+    pool.join();
+    const double runtime = ti.current_time();
+
+    cout << "Segmented " << jobs.size() - failed.value << " of " << jobs.size()
+         << " images in " << runtime << " seconds ("
+         << (jobs.size() - failed.value) / std::max(runtime, 1e-9) << " images per second)" << endl;
+    return failed.value == 0 ? 0 : 1;
+}
+
 GCApplication gcapp;
 
 void on_mouse( int event, int x, int y, int flags, void* param )
@@ -295,6 +574,8 @@ void on_mouse( int event, int x, int y, int flags, void* param )
 
 int main( int argc, char** argv )
 {
+    if( argc > 1 && string(argv[1]).compare(0, 7, "--batch") == 0 )
+        return batchMain( argc, argv );
     if( argc!=2 )
     {
     	help();
@@ -0,0 +1,252 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+/**
+ *
+ * \brief A parallel max-flow solver for 4-connected pixel grids, with the
+ * interface of GCGraph so the seam finders can use either.
+ *
+ * The solver is a synchronous push-relabel: every round, all the vertices
+ * with excess push along admissible edges at once, the pushed flow is then
+ * merged by the receiving vertices and the vertices left with excess are
+ * relabeled from a snapshot of the labels. Each vertex only writes its own
+ * state in each phase, so the phases run as parallel loops without locks.
+ * The labels are periodically reset to the exact distances to the sink by
+ * a breadth first search (the global relabel heuristic), which also gives
+ * the minimum cut once no vertex which can reach the sink has excess.
+ */
+
+
+#ifndef __GRID_GRAPHCUT_HPP__
+#define __GRID_GRAPHCUT_HPP__
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cassert>
+
+template <class TWeight> class GridGraphCut
+{
+public:
+    GridGraphCut( int width, int height );
+    int addVtx();
+    /// j must be the right (i + 1) or the lower (i + width) neighbor of i
+    void addEdges( int i, int j, TWeight w, TWeight revw );
+    void addTermWeights( int i, TWeight sourceW, TWeight sinkW );
+    TWeight maxFlow();
+    bool inSourceSegment( int i );
+
+    /// The number of rounds between two global relabels
+    enum { GLOBAL_RELABEL_INTERVAL = 32 };
+
+private:
+    // the directions of the neighbors. The opposite of d is d ^ 1.
+    enum { RIGHT = 0, LEFT = 1, DOWN = 2, UP = 3 };
+
+    int neighbor( int v, int d ) const;
+    void globalRelabel();
+
+    int width, height, nvtx;
+    // residual capacities to the 4 neighbors of each vertex
+    std::vector<TWeight> cap;
+    // flow received in the last round, from the neighbor in each direction
+    std::vector<TWeight> inflow;
+    std::vector<TWeight> excess;
+    // residual capacities to the sink
+    std::vector<TWeight> sinkCap;
+    std::vector<int> label, nextLabel;
+    TWeight flow;
+};
+
+
+template <class TWeight>
+GridGraphCut<TWeight>::GridGraphCut( int width, int height )
+    : width(width), height(height), nvtx(0),
+      cap(4 * width * height, 0), inflow(4 * width * height, 0),
+      excess(width * height, 0), sinkCap(width * height, 0),
+      label(width * height, 0), nextLabel(width * height, 0), flow(0)
+{
+}
+
+template <class TWeight>
+int GridGraphCut<TWeight>::addVtx()
+{
+    assert( nvtx < width * height );
+    return nvtx++;
+}
+
+template <class TWeight>
+int GridGraphCut<TWeight>::neighbor( int v, int d ) const
+{
+    const int x = v % width;
+    switch (d)
+    {
+    case RIGHT: return x + 1 < width ? v + 1 : -1;
+    case LEFT:  return x > 0 ? v - 1 : -1;
+    case DOWN:  return v + width < width * height ? v + width : -1;
+    default:    return v >= width ? v - width : -1;
+    }
+}
+
+template <class TWeight>
+void GridGraphCut<TWeight>::addEdges( int i, int j, TWeight w, TWeight revw )
+{
+    assert( w >= 0 && revw >= 0 );
+    if (j == i + 1 && i % width + 1 < width)
+    {
+        cap[4 * i + RIGHT] += w;
+        cap[4 * j + LEFT] += revw;
+    }
+    else
+    {
+        assert( j == i + width );
+        cap[4 * i + DOWN] += w;
+        cap[4 * j + UP] += revw;
+    }
+}
+
+template <class TWeight>
+void GridGraphCut<TWeight>::addTermWeights( int i, TWeight sourceW, TWeight sinkW )
+{
+    // as in GCGraph, the common part of the two weights is cut anyway
+    const TWeight w = excess[i] - sinkCap[i];
+    if (w > 0) sourceW += w; else sinkW -= w;
+    flow += std::min(sourceW, sinkW);
+    excess[i] = sourceW > sinkW ? sourceW - sinkW : 0;
+    sinkCap[i] = sinkW > sourceW ? sinkW - sourceW : 0;
+}
+
+/**
+ * Sets the labels to the distances to the sink in the residual graph.
+ * Vertices which cannot reach the sink get the label nvtx + 1, which is
+ * more than the length of any path.
+ */
+template <class TWeight>
+void GridGraphCut<TWeight>::globalRelabel()
+{
+    const int unreachable = nvtx + 1;
+    std::deque<int> queue;
+    for (int v = 0; v < nvtx; ++v)
+    {
+        label[v] = sinkCap[v] > 0 ? 1 : unreachable;
+        if (sinkCap[v] > 0) queue.push_back(v);
+    }
+    while (!queue.empty())
+    {
+        const int w = queue.front();
+        queue.pop_front();
+        for (int d = 0; d < 4; ++d)
+        {
+            const int u = neighbor(w, d);
+            // the edge from u to w points in the opposite direction
+            if (u >= 0 && label[u] == unreachable && cap[4 * u + (d ^ 1)] > 0)
+            {
+                label[u] = label[w] + 1;
+                queue.push_back(u);
+            }
+        }
+    }
+}
+
+template <class TWeight>
+TWeight GridGraphCut<TWeight>::maxFlow()
+{
+    const int n = nvtx;
+    const int unreachable = nvtx + 1;
+    for (size_t round = 0; ; ++round)
+    {
+        if (round % GLOBAL_RELABEL_INTERVAL == 0) globalRelabel();
+        bool active = false;
+        TWeight sinkFlow = 0;
+
+        // push
+#ifdef _OPENMP
+#pragma omp parallel for reduction(||:active) reduction(+:sinkFlow)
+#endif
+        for (int v = 0; v < n; ++v)
+        {
+            TWeight e = excess[v];
+            if (e <= 0 || label[v] >= unreachable) continue;
+            active = true;
+            if (sinkCap[v] > 0)
+            {
+                const TWeight f = std::min(e, sinkCap[v]);
+                sinkCap[v] -= f;
+                sinkFlow += f;
+                e -= f;
+            }
+            for (int d = 0; d < 4 && e > 0; ++d)
+            {
+                const int u = neighbor(v, d);
+                if (u < 0 || cap[4 * v + d] <= 0 || label[v] != label[u] + 1) continue;
+                const TWeight f = std::min(e, cap[4 * v + d]);
+                cap[4 * v + d] -= f;
+                // u pushes nowhere v could push back to this round
+                inflow[4 * u + (d ^ 1)] = f;
+                e -= f;
+            }
+            excess[v] = e;
+        }
+        flow += sinkFlow;
+        if (!active) break;
+
+        // merge the received flow and relabel from a snapshot of the labels
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (int v = 0; v < n; ++v)
+        {
+            for (int d = 0; d < 4; ++d)
+            {
+                const TWeight f = inflow[4 * v + d];
+                if (f > 0)
+                {
+                    excess[v] += f;
+                    cap[4 * v + d] += f;
+                    inflow[4 * v + d] = 0;
+                }
+            }
+            nextLabel[v] = label[v];
+            if (excess[v] <= 0 || label[v] >= unreachable || sinkCap[v] > 0) continue;
+            int lowest = unreachable;
+            bool admissible = false;
+            for (int d = 0; d < 4; ++d)
+            {
+                const int u = neighbor(v, d);
+                if (u < 0 || cap[4 * v + d] <= 0) continue;
+                if (label[v] == label[u] + 1) admissible = true;
+                lowest = std::min(lowest, label[u] + 1);
+            }
+            if (!admissible) nextLabel[v] = std::min(lowest, unreachable);
+        }
+        label.swap(nextLabel);
+    }
+    // the vertices which can reach the sink form the sink side of the cut
+    globalRelabel();
+    return flow;
+}
+
+template <class TWeight>
+bool GridGraphCut<TWeight>::inSourceSegment( int i )
+{
+    return label[i] > nvtx;
+}
+
+#endif
@@ -71,6 +71,8 @@ int main(int argc, char** argv)
                          "Resolution for image registration step. The default is 0.6 Mpx.");
     clopts.attach_option("engine", opts.exec_type,
                          "The type of engine to use {async, sync}.");
+    clopts.attach_option("seam_solver", opts.seam_solver,
+                         "The max-flow solver of the seam graph cuts {gcgraph, parallel}.");
 
     if(!clopts.parse(argc, argv))
     {
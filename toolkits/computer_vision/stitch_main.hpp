@@ -33,6 +33,7 @@
 
 #include "utils.hpp"
 #include "stitch_grlab.hpp"
+#include "grid_graphcut.hpp"
 #include "iostream"
 
 /////////////////////////////////////////////////////////////////////////
@@ -634,118 +635,14 @@ void composite_images(graph_type::vertex_type& vertex)
 }
 
 /////////////////////////////////////////////////////////////////////////
-// Function to compute feature-matches in parallel on edges
-void find_seams(graph_type::edge_type& edge)
+// Sets the weights of the seam graph of two overlapping sub images. Graph
+// is either a GCGraph or a GridGraphCut.
+template <typename Graph>
+void set_seam_weights(Graph& graph, const Mat& subimg1, const Mat& subimg2,
+                      const Mat& subdx1, const Mat& subdx2,
+                      const Mat& subdy1, const Mat& subdy2,
+                      const Mat& submask1, const Mat& submask2)
 {
-    // Get edge data
-    //edge_data &edata = edge.data(); //commented by me as it was unused
-	
-    // Get vertex ids of two vertices involved
-    vertex_data &vdata1 = edge.source().data();
-    vertex_data &vdata2 = edge.target().data();
-    
-    // Not sure why this is needed anymore?
-    //Ptr<SeamFinder> seam_finder;
-    //seam_finder = new detail::GraphCutSeamFinder(GraphCutSeamFinderBase::COST_COLOR);
-    
-    
-    // Code from PairwiseSeamFinder::Impl::findInPair()
-    //Mat img1 = images_[first], img2 = images_[second];
-    Mat &img1 = vdata1.img_warped_f; Mat &img2 = vdata2.img_warped_f;
-    vector<Mat> src; src.push_back(img1); src.push_back(img2);
-    
-    vector<Mat> dx_(2), dy_(2);  
-    Mat dx, dy;
-    for (size_t i = 0; i < src.size(); ++i)
-    {
-        CV_Assert(src[i].channels() == 3);
-        Sobel(src[i], dx, CV_32F, 1, 0);
-        Sobel(src[i], dy, CV_32F, 0, 1);
-        dx_[i].create(src[i].size(), CV_32F);
-        dy_[i].create(src[i].size(), CV_32F);
-        for (int y = 0; y < src[i].rows; ++y)
-        {
-            const Point3f* dx_row = dx.ptr<Point3f>(y);
-            const Point3f* dy_row = dy.ptr<Point3f>(y);
-            float* dx_row_ = dx_[i].ptr<float>(y);
-            float* dy_row_ = dy_[i].ptr<float>(y);
-            for (int x = 0; x < src[i].cols; ++x)
-            {
-                dx_row_[x] = normL2(dx_row[x]);
-                dy_row_[x] = normL2(dy_row[x]);
-            }
-        }
-    }
-    
-    //Mat dx1 = dx_[first], dx2 = dx_[second];
-    //Mat dy1 = dy_[first], dy2 = dy_[second];
-    Mat &dx1 = dx_[0]; Mat &dx2 = dx_[1];
-    Mat &dy1 = dy_[0]; Mat &dy2 = dy_[1];
-    
-    //Mat mask1 = masks_[first], mask2 = masks_[second];
-    Mat &mask1 = vdata1.mask_warped; Mat &mask2 = vdata2.mask_warped;
-    //Point tl1 = corners_[first], tl2 = corners_[second];
-    Point2f &tl1 = vdata1.corner; Point2f &tl2 = vdata2.corner;
-    
-    Rect roi;
-    overlapRoi(tl1, tl2, img1.size(), img2.size(), roi);
-    
-    const int gap = 10;
-    Mat subimg1(roi.height + 2 * gap, roi.width + 2 * gap, CV_32FC3);
-    Mat subimg2(roi.height + 2 * gap, roi.width + 2 * gap, CV_32FC3);
-    Mat submask1(roi.height + 2 * gap, roi.width + 2 * gap, CV_8U);
-    Mat submask2(roi.height + 2 * gap, roi.width + 2 * gap, CV_8U);
-    Mat subdx1(roi.height + 2 * gap, roi.width + 2 * gap, CV_32F);
-    Mat subdy1(roi.height + 2 * gap, roi.width + 2 * gap, CV_32F);
-    Mat subdx2(roi.height + 2 * gap, roi.width + 2 * gap, CV_32F);
-    Mat subdy2(roi.height + 2 * gap, roi.width + 2 * gap, CV_32F);
-    
-    // Cut subimages and submasks with some gap
-    for (int y = -gap; y < roi.height + gap; ++y)
-    {
-        for (int x = -gap; x < roi.width + gap; ++x)
-        {
-            int y1 = roi.y - tl1.y + y;
-            int x1 = roi.x - tl1.x + x;
-            if (y1 >= 0 && x1 >= 0 && y1 < img1.rows && x1 < img1.cols)
-            {
-                subimg1.at<Point3f>(y + gap, x + gap) = img1.at<Point3f>(y1, x1);
-                submask1.at<uchar>(y + gap, x + gap) = mask1.at<uchar>(y1, x1);
-                subdx1.at<float>(y + gap, x + gap) = dx1.at<float>(y1, x1);
-                subdy1.at<float>(y + gap, x + gap) = dy1.at<float>(y1, x1);
-            }
-            else
-            {
-                subimg1.at<Point3f>(y + gap, x + gap) = Point3f(0, 0, 0);
-                submask1.at<uchar>(y + gap, x + gap) = 0;
-                subdx1.at<float>(y + gap, x + gap) = 0.f;
-                subdy1.at<float>(y + gap, x + gap) = 0.f;
-            }
-            
-            int y2 = roi.y - tl2.y + y;
-            int x2 = roi.x - tl2.x + x;
-            if (y2 >= 0 && x2 >= 0 && y2 < img2.rows && x2 < img2.cols)
-            {
-                subimg2.at<Point3f>(y + gap, x + gap) = img2.at<Point3f>(y2, x2);
-                submask2.at<uchar>(y + gap, x + gap) = mask2.at<uchar>(y2, x2);
-                subdx2.at<float>(y + gap, x + gap) = dx2.at<float>(y2, x2);
-                subdy2.at<float>(y + gap, x + gap) = dy2.at<float>(y2, x2);
-            }
-            else
-            {
-                subimg2.at<Point3f>(y + gap, x + gap) = Point3f(0, 0, 0);
-                submask2.at<uchar>(y + gap, x + gap) = 0;
-                subdx2.at<float>(y + gap, x + gap) = 0.f;
-                subdy2.at<float>(y + gap, x + gap) = 0.f;
-            }
-        }
-    }
-    
-    const int vertex_count = (roi.height + 2 * gap) * (roi.width + 2 * gap);
-    const int edge_count = (roi.height - 1 + 2 * gap) * (roi.width + 2 * gap) + (roi.width - 1 + 2 * gap) * (roi.height + 2 * gap);
-    GCGraph<float> graph(vertex_count, edge_count);	
-    
-    
     const Size img_size = subimg1.size();
     
     if (opts.seam_find_type.compare("gc_color") ==0)
@@ -848,9 +745,14 @@ void find_seams(graph_type::edge_type& edge)
     
     else
         CV_Error(CV_StsBadArg, "unsupported pixel similarity measure");
-    
-    graph.maxFlow();
-    
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Removes from each mask the part of the overlap on the other side of the cut
+template <typename Graph>
+void cut_masks(Graph& graph, Mat& mask1, Mat& mask2,
+               const Point2f& tl1, const Point2f& tl2, const Rect& roi, int gap)
+{
     for (int y = 0; y < roi.height; ++y)
     {
         for (int x = 0; x < roi.width; ++x)
@@ -869,6 +771,134 @@ void find_seams(graph_type::edge_type& edge)
     }
 }
 
+/////////////////////////////////////////////////////////////////////////
+// Function to compute feature-matches in parallel on edges
+void find_seams(graph_type::edge_type& edge)
+{
+    // Get edge data
+    //edge_data &edata = edge.data(); //commented by me as it was unused
+	
+    // Get vertex ids of two vertices involved
+    vertex_data &vdata1 = edge.source().data();
+    vertex_data &vdata2 = edge.target().data();
+    
+    // Not sure why this is needed anymore?
+    //Ptr<SeamFinder> seam_finder;
+    //seam_finder = new detail::GraphCutSeamFinder(GraphCutSeamFinderBase::COST_COLOR);
+    
+    
+    // Code from PairwiseSeamFinder::Impl::findInPair()
+    //Mat img1 = images_[first], img2 = images_[second];
+    Mat &img1 = vdata1.img_warped_f; Mat &img2 = vdata2.img_warped_f;
+    vector<Mat> src; src.push_back(img1); src.push_back(img2);
+    
+    vector<Mat> dx_(2), dy_(2);  
+    Mat dx, dy;
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        CV_Assert(src[i].channels() == 3);
+        Sobel(src[i], dx, CV_32F, 1, 0);
+        Sobel(src[i], dy, CV_32F, 0, 1);
+        dx_[i].create(src[i].size(), CV_32F);
+        dy_[i].create(src[i].size(), CV_32F);
+        for (int y = 0; y < src[i].rows; ++y)
+        {
+            const Point3f* dx_row = dx.ptr<Point3f>(y);
+            const Point3f* dy_row = dy.ptr<Point3f>(y);
+            float* dx_row_ = dx_[i].ptr<float>(y);
+            float* dy_row_ = dy_[i].ptr<float>(y);
+            for (int x = 0; x < src[i].cols; ++x)
+            {
+                dx_row_[x] = normL2(dx_row[x]);
+                dy_row_[x] = normL2(dy_row[x]);
+            }
+        }
+    }
+    
+    //Mat dx1 = dx_[first], dx2 = dx_[second];
+    //Mat dy1 = dy_[first], dy2 = dy_[second];
+    Mat &dx1 = dx_[0]; Mat &dx2 = dx_[1];
+    Mat &dy1 = dy_[0]; Mat &dy2 = dy_[1];
+    
+    //Mat mask1 = masks_[first], mask2 = masks_[second];
+    Mat &mask1 = vdata1.mask_warped; Mat &mask2 = vdata2.mask_warped;
+    //Point tl1 = corners_[first], tl2 = corners_[second];
+    Point2f &tl1 = vdata1.corner; Point2f &tl2 = vdata2.corner;
+    
+    Rect roi;
+    overlapRoi(tl1, tl2, img1.size(), img2.size(), roi);
+    
+    const int gap = 10;
+    Mat subimg1(roi.height + 2 * gap, roi.width + 2 * gap, CV_32FC3);
+    Mat subimg2(roi.height + 2 * gap, roi.width + 2 * gap, CV_32FC3);
+    Mat submask1(roi.height + 2 * gap, roi.width + 2 * gap, CV_8U);
+    Mat submask2(roi.height + 2 * gap, roi.width + 2 * gap, CV_8U);
+    Mat subdx1(roi.height + 2 * gap, roi.width + 2 * gap, CV_32F);
+    Mat subdy1(roi.height + 2 * gap, roi.width + 2 * gap, CV_32F);
+    Mat subdx2(roi.height + 2 * gap, roi.width + 2 * gap, CV_32F);
+    Mat subdy2(roi.height + 2 * gap, roi.width + 2 * gap, CV_32F);
+    
+    // Cut subimages and submasks with some gap
+    for (int y = -gap; y < roi.height + gap; ++y)
+    {
+        for (int x = -gap; x < roi.width + gap; ++x)
+        {
+            int y1 = roi.y - tl1.y + y;
+            int x1 = roi.x - tl1.x + x;
+            if (y1 >= 0 && x1 >= 0 && y1 < img1.rows && x1 < img1.cols)
+            {
+                subimg1.at<Point3f>(y + gap, x + gap) = img1.at<Point3f>(y1, x1);
+                submask1.at<uchar>(y + gap, x + gap) = mask1.at<uchar>(y1, x1);
+                subdx1.at<float>(y + gap, x + gap) = dx1.at<float>(y1, x1);
+                subdy1.at<float>(y + gap, x + gap) = dy1.at<float>(y1, x1);
+            }
+            else
+            {
+                subimg1.at<Point3f>(y + gap, x + gap) = Point3f(0, 0, 0);
+                submask1.at<uchar>(y + gap, x + gap) = 0;
+                subdx1.at<float>(y + gap, x + gap) = 0.f;
+                subdy1.at<float>(y + gap, x + gap) = 0.f;
+            }
+            
+            int y2 = roi.y - tl2.y + y;
+            int x2 = roi.x - tl2.x + x;
+            if (y2 >= 0 && x2 >= 0 && y2 < img2.rows && x2 < img2.cols)
+            {
+                subimg2.at<Point3f>(y + gap, x + gap) = img2.at<Point3f>(y2, x2);
+                submask2.at<uchar>(y + gap, x + gap) = mask2.at<uchar>(y2, x2);
+                subdx2.at<float>(y + gap, x + gap) = dx2.at<float>(y2, x2);
+                subdy2.at<float>(y + gap, x + gap) = dy2.at<float>(y2, x2);
+            }
+            else
+            {
+                subimg2.at<Point3f>(y + gap, x + gap) = Point3f(0, 0, 0);
+                submask2.at<uchar>(y + gap, x + gap) = 0;
+                subdx2.at<float>(y + gap, x + gap) = 0.f;
+                subdy2.at<float>(y + gap, x + gap) = 0.f;
+            }
+        }
+    }
+    
+    if (opts.seam_solver.compare("parallel") == 0)
+    {
+        GridGraphCut<float> graph(roi.width + 2 * gap, roi.height + 2 * gap);
+        set_seam_weights(graph, subimg1, subimg2, subdx1, subdx2, subdy1, subdy2,
+                         submask1, submask2);
+        graph.maxFlow();
+        cut_masks(graph, mask1, mask2, tl1, tl2, roi, gap);
+    }
+    else
+    {
+        const int vertex_count = (roi.height + 2 * gap) * (roi.width + 2 * gap);
+        const int edge_count = (roi.height - 1 + 2 * gap) * (roi.width + 2 * gap) + (roi.width - 1 + 2 * gap) * (roi.height + 2 * gap);
+        GCGraph<float> graph(vertex_count, edge_count);
+        set_seam_weights(graph, subimg1, subimg2, subdx1, subdx2, subdy1, subdy2,
+                         submask1, submask2);
+        graph.maxFlow();
+        cut_masks(graph, mask1, mask2, tl1, tl2, roi, gap);
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////
 // Map Function to compile a list of features
 //vector<vertex_data> compile_features(const graph_type::vertex_type& vertex)
@@ -85,6 +85,8 @@ struct Options
 
     // seam options
     std::string seam_find_type;
+    // max-flow solver of the graph cut: "gcgraph" or "parallel"
+    std::string seam_solver;
     float terminal_cost;
     float bad_region_penalty; 
 
@@ -119,7 +121,7 @@ struct Options
     seam_work_aspect(1/6), compose_seam_aspect(1), compose_work_aspect(1),
     warped_image_scale(-1), warp_type("spherical"),
     conf_thresh(1.f), match_conf(0.3f),
-    seam_find_type("gc_color"), terminal_cost(10000.f), bad_region_penalty(1000.f),
+    seam_find_type("gc_color"), seam_solver("gcgraph"), terminal_cost(10000.f), bad_region_penalty(1000.f),
     wave_correct_type("horiz"),
     ba_cost_func("ray"),
     ba_refine_mask("xxxxx"),
@@ -2,6 +2,8 @@
 #define GRAPHLAB_EXTENSION_GAS_HPP
 
 #include <vector>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/lockfree_push_back.hpp>
 #include <graphlab/vertex_program/ivertex_program.hpp>
 #include "extension_data.hpp"
 #include "extension_gas_base_types.hpp"
@@ -171,6 +173,131 @@ public:
 
 
 
+/*
+ * Compiled GAS ------------------------------------------------------------
+ *
+ * When the types of the user ops are known at compile time, the engine can
+ * run a vertex program instantiated for them instead of the descriptor
+ * based extension_update_functor above: the ops are called directly, no
+ * descriptor is looked up per edge and signals carry no message. 
+ * The ops are closures which vertex programs cannot hold, so they are kept
+ * in a static pointer of each instantiation, set for the duration of the 
+ * engine run by compiled_gas_ops::scope.
+ */
+
+/// The gather_edges and scatter_edges op used when none is given
+struct all_edges_select {
+  edge_dir_type operator()(const vars&) const { return ALL_EDGES; }
+};
+
+template <typename GatherSelectType,
+          typename GatherType,
+          typename CombinerType,
+          typename ApplyType,
+          typename ScatterSelectType,
+          typename ScatterType>
+struct compiled_gas_ops {
+  GatherSelectType* gather_select_op;
+  GatherType* gather_op;
+  CombinerType* combiner_op;
+  ApplyType* apply_op;
+  ScatterSelectType* scatter_select_op;
+  ScatterType* scatter_op;
+
+  /// The ops of the running engine
+  static compiled_gas_ops* current;
+
+  /// Makes ops the current ops for the lifetime of the scope
+  struct scope {
+    scope(compiled_gas_ops& ops) { current = &ops; }
+    ~scope() { current = NULL; }
+  };
+};
+
+template <typename GatherSelectType, typename GatherType, typename CombinerType,
+          typename ApplyType, typename ScatterSelectType, typename ScatterType>
+compiled_gas_ops<GatherSelectType, GatherType, CombinerType,
+                 ApplyType, ScatterSelectType, ScatterType>* 
+compiled_gas_ops<GatherSelectType, GatherType, CombinerType,
+                 ApplyType, ScatterSelectType, ScatterType>::current = NULL;
+
+
+/// The gather result of a compiled GAS, combined with a direct call
+template <typename OpsType>
+struct compiled_gather_var {
+  var v;
+
+  compiled_gather_var& operator+=(const compiled_gather_var& other) {
+    (*OpsType::current->combiner_op)(v, other.v);
+    return *this;
+  }
+
+  inline void save(graphlab::oarchive& oarc) const {
+    oarc << v;
+  }
+
+  inline void load(graphlab::iarchive& iarc) {
+    iarc >> v;
+  }
+};
+
+
+template <typename OpsType>
+struct compiled_update_functor: 
+    public graphlab::ivertex_program<internal_graph_type, 
+                                     compiled_gather_var<OpsType> >,
+    public graphlab::IS_POD_TYPE {
+  typedef graphlab::ivertex_program<internal_graph_type,
+                                    compiled_gather_var<OpsType> > parent_type;
+  typedef typename parent_type::icontext_type icontext_type;
+  typedef typename parent_type::vertex_type vertex_type;
+  typedef typename parent_type::edge_type edge_type;
+  typedef typename parent_type::gather_type gather_type;
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return (*OpsType::current->gather_select_op)(vertex.data());
+  }
+
+  inline gather_type gather(icontext_type& context, 
+                            const vertex_type& vertex,
+                            edge_type& edge) const {
+    const bool is_out = edge.source().id() == vertex.id();
+    vertex_type other_vertex = is_out ? edge.target() : edge.source();
+    gather_type ret;
+    ret.v = (*OpsType::current->gather_op)(vertex.data(), 
+                                           edge.data(), 
+                                           other_vertex.data(),
+                                           is_out ? OUT_EDGE : IN_EDGE);
+    return ret;
+  }
+
+  inline void apply(icontext_type& context, vertex_type& vertex,
+                    const gather_type& total) {
+    if ((*OpsType::current->apply_op)(vertex.data(), total.v)) {
+      context.signal(vertex);
+    }
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return (*OpsType::current->scatter_select_op)(vertex.data());
+  }
+
+  inline void scatter(icontext_type& context, const vertex_type& vertex,
+                      edge_type& edge) const {
+    const bool is_out = edge.source().id() == vertex.id();
+    vertex_type other_vertex = is_out ? edge.target() : edge.source();
+    if ((*OpsType::current->scatter_op)(vertex.data(), 
+                                        edge.data(), 
+                                        other_vertex.data(),
+                                        is_out ? OUT_EDGE : IN_EDGE)) {
+      context.signal(other_vertex);
+    }
+  }
+};
+
+
 } // namespace extension
 } // namespace graphlab
 
@@ -1,6 +1,7 @@
 #ifndef GRAPHLAB_EXTENSION_GRAPH_HPP
 #define GRAPHLAB_EXTENSION_GRAPH_HPP
 
+#include <graphlab/engine/synchronous_engine.hpp>
 #include "extension_data.hpp"
 #include "extension_gas.hpp"
 #include "extension_gas_lambda_wrapper.hpp"
@@ -34,15 +35,20 @@ class extension_graph {
   internal_graph_type internal_graph;
   mutex lock;
   bool finalized;
+  /// If set, GAS runs the ops through the descriptor table instead of
+  /// instantiating a vertex program for them
+  bool dynamic_dispatch;
 
   extension_graph()
      :rmi(*dc_impl::get_last_dc(), this), 
-     internal_graph(*dc_impl::get_last_dc(), __glopts),finalized(false) { }
+     internal_graph(*dc_impl::get_last_dc(), __glopts),finalized(false),
+     dynamic_dispatch(false) { }
 
 
   extension_graph(distributed_control& dc, 
                   const graphlab_options& opts = graphlab_options() ) 
-     :rmi(dc, this), internal_graph(dc, opts),finalized(false) { }
+     :rmi(dc, this), internal_graph(dc, opts),finalized(false),
+     dynamic_dispatch(false) { }
 
   template <typename FieldType, typename TransformType>
   void transform_field(FieldType field,
@@ -98,6 +104,38 @@ class extension_graph {
 
   void synchronous_dispatch_new_engine(size_t desc_id);
 
+  /// Runs the ops with a vertex program compiled for their types
+  template <typename GatherSelectType,
+           typename GatherType,
+           typename CombinerType,
+           typename ApplyType,
+           typename ScatterSelectType,
+           typename ScatterType>
+    void compiled_GAS(GatherSelectType& gatherselect,
+                      GatherType& gather,
+                      CombinerType& combiner,
+                      ApplyType& apply,
+                      ScatterSelectType& scatterselect,
+                      ScatterType& scatter) {
+      typedef compiled_gas_ops<GatherSelectType, GatherType, CombinerType,
+                               ApplyType, ScatterSelectType, ScatterType> ops_type;
+      ops_type ops;
+      ops.gather_select_op = &gatherselect;
+      ops.gather_op = &gather;
+      ops.combiner_op = &combiner;
+      ops.apply_op = &apply;
+      ops.scatter_select_op = &scatterselect;
+      ops.scatter_op = &scatter;
+
+      lock.lock();
+      typename ops_type::scope current(ops);
+      synchronous_engine<compiled_update_functor<ops_type> > 
+          sync_engine(rmi.dc(), internal_graph, __glopts);
+      sync_engine.signal_all();
+      sync_engine.start();
+      lock.unlock();
+    }
+
   /// GAS which defaults to all out and all in edges
   template <typename GatherType,
            typename CombinerType,
@@ -109,6 +147,11 @@ class extension_graph {
              ScatterType scatter,
              size_t iterations = 0) {
       finalize();
+      if (!dynamic_dispatch) {
+        all_edges_select gatherselect, scatterselect;
+        compiled_GAS(gatherselect, gather, combiner, apply, scatterselect, scatter);
+        return;
+      }
       generic_gather<GatherType> g;
       g.gt = &gather;
 
@@ -151,6 +194,10 @@ class extension_graph {
              ScatterType scatter,
              size_t iterations = 0) {
       finalize();
+      if (!dynamic_dispatch) {
+        compiled_GAS(gatherselect, gather, combiner, apply, scatterselect, scatter);
+        return;
+      }
       generic_gather_select<GatherSelectType> gs;
       gs.gt = &gatherselect;
 
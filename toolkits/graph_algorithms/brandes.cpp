@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * Betweenness centrality of unweighted graphs by Brandes' algorithm,
+ * running the breadth first searches of 64 sources at once.
+ *
+ * The sources of a batch are the bits of a 64 bit word: each vertex
+ * keeps the set of sources which reached it and the set which reached
+ * it in the last level, so a level of all 64 searches is a single
+ * gather over the edges. Distances, path counts (sigma) and
+ * dependencies (delta) are fixed arrays indexed by the bit.
+ *
+ * With --samplesize=k only k sources, chosen by a seeded hash of the
+ * vertex ids, are searched and the scores are scaled by n/k, which is
+ * an unbiased estimate of the exact betweenness.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <boost/unordered_map.hpp>
+
+#include <graphlab.hpp>
+#include <graphlab/util/integer_mix.hpp>
+#include <graphlab/macros_def.hpp>
+
+// The number of sources searched together, one per bit of a word
+const size_t BATCH = 64;
+
+size_t SAMPLE_SIZE = 0;
+size_t SEED = 0;
+
+struct vertex_data : public graphlab::IS_POD_TYPE {
+  // the sources which reached this vertex
+  uint64_t visited;
+  // the sources which reached this vertex at frontier_level
+  uint64_t frontier;
+  uint32_t frontier_level;
+  uint32_t dist[BATCH];
+  double sigma[BATCH];
+  double delta[BATCH];
+  double centrality;
+  vertex_data() : visited(0), frontier(0), frontier_level(0), centrality(0) { }
+}; // end of vertex_data
+
+typedef graphlab::distributed_graph<vertex_data, graphlab::empty> graph_type;
+
+// Removes the lowest set bit of bits and returns its position
+inline size_t pop_bit(uint64_t& bits) {
+  const size_t bit = __builtin_ctzll(bits);
+  bits &= bits - 1;
+  return bit;
+}
+
+/*
+ * Per source sums of the 64 searches. Only the entries whose bit is
+ * set in mask are defined.
+ */
+struct batch_sum : public graphlab::IS_POD_TYPE {
+  uint64_t mask;
+  double value[BATCH];
+  batch_sum() : mask(0) { }
+  void add(size_t bit, double val) {
+    const uint64_t b = uint64_t(1) << bit;
+    if (mask & b) value[bit] += val;
+    else { value[bit] = val; mask |= b; }
+  }
+  batch_sum& operator+=(const batch_sum& other) {
+    uint64_t bits = other.mask;
+    while (bits) {
+      const size_t bit = pop_bit(bits);
+      add(bit, other.value[bit]);
+    }
+    return *this;
+  }
+}; // end of batch_sum
+
+
+// The bit of each source of the current batch
+boost::unordered_map<graphlab::vertex_id_type, size_t> batch_bits;
+
+// The BFS level being computed
+uint32_t bfs_level = 0;
+
+void init_batch(graph_type::vertex_type& vertex) {
+  vertex_data& vdata = vertex.data();
+  vdata.visited = vdata.frontier = 0;
+  vdata.frontier_level = 0;
+  std::fill(vdata.delta, vdata.delta + BATCH, 0.0);
+  boost::unordered_map<graphlab::vertex_id_type, size_t>::const_iterator it =
+      batch_bits.find(vertex.id());
+  if (it != batch_bits.end()) {
+    vdata.visited = vdata.frontier = uint64_t(1) << it->second;
+    vdata.dist[it->second] = 0;
+    vdata.sigma[it->second] = 1;
+  }
+}
+
+/*
+ * Forward phase: sigma(v)[s] is the sum of sigma(u)[s] over the in
+ * neighbors u which s reached in the previous level, for the sources
+ * s which have not reached v yet.
+ */
+batch_sum gather_sigma(graphlab::lvid_type lvid, graph_type& graph) {
+  batch_sum sum;
+  graph_type::local_vertex_type vtx = graph.l_vertex(lvid);
+  const uint64_t unvisited = ~vtx.data().visited;
+  foreach(graph_type::local_edge_type edge, vtx.in_edges()) {
+    const vertex_data& src = edge.source().data();
+    if (src.frontier_level + 1 != bfs_level) continue;
+    uint64_t bits = src.frontier & unvisited;
+    while (bits) {
+      const size_t bit = pop_bit(bits);
+      sum.add(bit, src.sigma[bit]);
+    }
+  }
+  return sum;
+}
+
+void apply_sigma(graphlab::lvid_type lvid, const batch_sum& sum,
+                 graph_type& graph) {
+  vertex_data& vdata = graph.l_vertex(lvid).data();
+  const uint64_t reached = sum.mask & ~vdata.visited;
+  uint64_t bits = reached;
+  while (bits) {
+    const size_t bit = pop_bit(bits);
+    vdata.dist[bit] = bfs_level;
+    vdata.sigma[bit] = sum.value[bit];
+  }
+  vdata.visited |= reached;
+  vdata.frontier = reached;
+  vdata.frontier_level = bfs_level;
+}
+
+bool on_frontier(const graph_type::vertex_type& vertex) {
+  return vertex.data().frontier != 0 &&
+      vertex.data().frontier_level == bfs_level;
+}
+
+// The sources which reached vdata at the given level
+inline uint64_t level_mask(const vertex_data& vdata, uint32_t level) {
+  uint64_t mask = 0;
+  uint64_t bits = vdata.visited;
+  while (bits) {
+    const size_t bit = pop_bit(bits);
+    if (vdata.dist[bit] == level) mask |= uint64_t(1) << bit;
+  }
+  return mask;
+}
+
+bool at_level(const graph_type::vertex_type& vertex) {
+  return level_mask(vertex.data(), bfs_level) != 0;
+}
+
+/*
+ * Backward phase: delta(v)[s] is the sum of
+ * sigma(v)[s] / sigma(w)[s] * (1 + delta(w)[s]) over the out
+ * neighbors w one level further from s.
+ */
+batch_sum gather_delta(graphlab::lvid_type lvid, graph_type& graph) {
+  batch_sum sum;
+  graph_type::local_vertex_type vtx = graph.l_vertex(lvid);
+  const vertex_data& vdata = vtx.data();
+  const uint64_t mask = level_mask(vdata, bfs_level);
+  if (mask == 0) return sum;
+  foreach(graph_type::local_edge_type edge, vtx.out_edges()) {
+    const vertex_data& dst = edge.target().data();
+    uint64_t bits = mask & dst.visited;
+    while (bits) {
+      const size_t bit = pop_bit(bits);
+      if (dst.dist[bit] != bfs_level + 1) continue;
+      sum.add(bit, vdata.sigma[bit] / dst.sigma[bit] * (1 + dst.delta[bit]));
+    }
+  }
+  return sum;
+}
+
+void apply_delta(graphlab::lvid_type lvid, const batch_sum& sum,
+                 graph_type& graph) {
+  vertex_data& vdata = graph.l_vertex(lvid).data();
+  uint64_t bits = sum.mask;
+  while (bits) {
+    const size_t bit = pop_bit(bits);
+    vdata.delta[bit] = sum.value[bit];
+  }
+}
+
+// Adds the dependencies of the batch, except on the sources themselves
+void accumulate_batch(graph_type::vertex_type& vertex) {
+  vertex_data& vdata = vertex.data();
+  uint64_t bits = vdata.visited;
+  while (bits) {
+    const size_t bit = pop_bit(bits);
+    if (vdata.dist[bit] != 0) vdata.centrality += vdata.delta[bit];
+  }
+}
+
+/*
+ * Runs the searches of the sources in batch_bits and adds their
+ * dependencies to the centrality of every vertex.
+ */
+void run_batch(graph_type& graph) {
+  graph.transform_vertices(init_batch);
+  graphlab::graph_gather_apply<graph_type, batch_sum>
+    forward(graph, gather_sigma, apply_sigma);
+  graphlab::graph_gather_apply<graph_type, batch_sum>
+    backward(graph, gather_delta, apply_delta);
+
+  bfs_level = 0;
+  graphlab::vertex_set frontier = graph.select(on_frontier);
+  while (graph.vertex_set_size(frontier) > 0) {
+    ++bfs_level;
+    forward.exec(graph.neighbors(frontier, graphlab::OUT_EDGES));
+    frontier = graph.select(on_frontier);
+  }
+  // bfs_level is now one past the deepest level, whose vertices have
+  // no dependencies
+  const uint32_t deepest = bfs_level - 1;
+  for (uint32_t level = deepest; level-- > 0; ) {
+    bfs_level = level;
+    backward.exec(graph.select(at_level));
+  }
+  graph.transform_vertices(accumulate_batch);
+}
+
+/*
+ * Chooses the sources: the SAMPLE_SIZE vertices with the smallest
+ * seeded hash of their id, or all the vertices if SAMPLE_SIZE is 0.
+ * The result is sorted and is the same on every machine.
+ */
+std::vector<graphlab::vertex_id_type> select_sources(graph_type& graph) {
+  typedef std::pair<uint32_t, graphlab::vertex_id_type> keyed_vid;
+  const size_t nsources = (SAMPLE_SIZE == 0) ? graph.num_vertices() :
+      std::min(SAMPLE_SIZE, graph.num_vertices());
+  std::vector<std::vector<keyed_vid> > candidates(graph.dc().numprocs());
+  std::vector<keyed_vid>& local = candidates[graph.dc().procid()];
+  for (size_t lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+    if (!graph.l_is_master(lvid)) continue;
+    const graphlab::vertex_id_type vid = graph.global_vid(lvid);
+    local.push_back(keyed_vid(graphlab::integer_mix(uint32_t(vid ^ SEED)), vid));
+  }
+  // no machine contributes more than nsources candidates
+  if (local.size() > nsources) {
+    std::nth_element(local.begin(), local.begin() + nsources, local.end());
+    local.resize(nsources);
+  }
+  graph.dc().all_gather(candidates);
+  std::vector<keyed_vid> all;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    all.insert(all.end(), candidates[i].begin(), candidates[i].end());
+  }
+  std::sort(all.begin(), all.end());
+  all.resize(std::min(all.size(), nsources));
+  std::vector<graphlab::vertex_id_type> sources;
+  for (size_t i = 0; i < all.size(); ++i) sources.push_back(all[i].second);
+  std::sort(sources.begin(), sources.end());
+  return sources;
+}
+
+double centrality_scale = 1.0;
+
+struct betweenness_writer {
+  std::string save_vertex(graph_type::vertex_type v) {
+    std::stringstream strm;
+    strm << v.id() << "\t" << v.data().centrality * centrality_scale << "\n";
+    return strm.str();
+  }
+  std::string save_edge(graph_type::edge_type e) { return ""; }
+}; // end of betweenness_writer
+
+int main(int argc, char** argv) {
+  // Initialize control plain using mpi
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_INFO);
+
+  // Parse command line options -----------------------------------------------
+  graphlab::command_line_options clopts("Betweenness centrality by "
+                                        "bit-parallel Brandes.");
+  std::string graph_dir;
+  std::string format = "snap";
+  std::string saveprefix;
+  clopts.attach_option("graph", graph_dir, "The graph file. Required ");
+  clopts.add_positional("graph");
+  clopts.attach_option("format", format, "The graph file format");
+  clopts.attach_option("samplesize", SAMPLE_SIZE,
+                       "The number of sampled sources. 0 (the default) "
+                       "computes the exact betweenness from every vertex.");
+  clopts.attach_option("seed", SEED, "The seed of the source sampling");
+  clopts.attach_option("saveprefix", saveprefix,
+                       "If set, will save the resultant betweenness score to a "
+                       "sequence of files with prefix saveprefix");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (graph_dir == "") {
+    dc.cout() << "Graph not specified. Cannot continue" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Build the graph ----------------------------------------------------------
+  graph_type graph(dc, clopts);
+  dc.cout() << "Loading graph in format: "<< format << std::endl;
+  graph.load_format(graph_dir, format);
+  graph.finalize();
+  dc.cout() << "#vertices: " << graph.num_vertices()
+            << " #edges:" << graph.num_edges() << std::endl;
+
+  // Run the searches ---------------------------------------------------------
+  graphlab::timer timer;
+  const std::vector<graphlab::vertex_id_type> sources = select_sources(graph);
+  for (size_t begin = 0; begin < sources.size(); begin += BATCH) {
+    batch_bits.clear();
+    const size_t end = std::min(begin + BATCH, sources.size());
+    for (size_t i = begin; i < end; ++i) batch_bits[sources[i]] = i - begin;
+    run_batch(graph);
+    dc.cout() << "Searched " << end << " of " << sources.size()
+              << " sources" << std::endl;
+  }
+  if (sources.size() > 0) {
+    centrality_scale = double(graph.num_vertices()) / sources.size();
+  }
+  dc.cout() << "Finished in " << timer.current_time() << " seconds."
+            << std::endl;
+
+  if (saveprefix != "") {
+    graph.save(saveprefix, betweenness_writer(),
+               false,  // do not gzip
+               true,   // save vertices
+               false); // do not save edges
+  }
+
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+} // End of main
@@ -27,9 +27,12 @@
 #include <algorithm>
 #include <vector>
 #include <map>
+#include <cmath>
 #include <time.h>
 
 #include <graphlab.hpp>
+#include <graphlab/util/fm_sketch.hpp>
+#include <graphlab/macros_def.hpp>
 
 //helper function
 float myrand() {
@@ -47,10 +50,39 @@ size_t hash_value() {
 
 const size_t DUPULICATION_OF_BITMASKS = 10;
 
+typedef graphlab::fm_sketch<DUPULICATION_OF_BITMASKS> sketch_type;
+
+//the vertices reached by a vertex: either exactly, as a bitmask
+//packed in words with one bit per vertex id, or approximately as
+//a Flajolet & Martin sketch
+struct reach_set {
+  std::vector<uint64_t> exact;
+  sketch_type sketch;
+
+  //bitwise-or, word by word
+  reach_set& operator+=(const reach_set& other) {
+    if (exact.size() < other.exact.size()) {
+      exact.resize(other.exact.size(), 0);
+    }
+    for (size_t i = 0; i < other.exact.size(); ++i) {
+      exact[i] |= other.exact[i];
+    }
+    sketch |= other.sketch;
+    return *this;
+  }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << exact << sketch;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> exact >> sketch;
+  }
+};
+
 struct vdata {
   //use two bitmasks for consistency
-  std::vector<std::vector<bool> > bitmask1;
-  std::vector<std::vector<bool> > bitmask2;
+  reach_set bitmask1;
+  reach_set bitmask2;
   //indicate which is the bitmask for reading (or writing)
   bool odd_iteration;
   vdata() :
@@ -58,63 +90,23 @@ struct vdata {
   }
   //for exact counting (but needs large memory)
   void create_bitmask(size_t id) {
-    std::vector<bool> mask1(id + 2, 0);
-    mask1[id] = 1;
-    bitmask1.push_back(mask1);
-    std::vector<bool> mask2(id + 2, 0);
-    mask2[id] = 1;
-    bitmask2.push_back(mask2);
+    bitmask1.exact.assign(id / 64 + 1, 0);
+    bitmask1.exact[id / 64] |= uint64_t(1) << (id % 64);
+    bitmask2 = bitmask1;
   }
   //for approximate Flajolet & Martin counting
   void create_hashed_bitmask(size_t id) {
     for (size_t i = 0; i < DUPULICATION_OF_BITMASKS; ++i) {
-      size_t hash_val = hash_value();
-      std::vector<bool> mask1(hash_val + 2, 0);
-      mask1[hash_val] = 1;
-      bitmask1.push_back(mask1);
-      std::vector<bool> mask2(hash_val + 2, 0);
-      mask2[hash_val] = 1;
-      bitmask2.push_back(mask2);
+      bitmask1.sketch.set(i, hash_value());
     }
+    bitmask2 = bitmask1;
   }
 
   void save(graphlab::oarchive& oarc) const {
-    size_t num = bitmask1.size();
-    oarc << num;
-    for (size_t a = 0; a < num; ++a) {
-      size_t size = bitmask1[a].size();
-      oarc << size;
-      for (size_t i = 0; i < size; ++i)
-        oarc << (bool)bitmask1[a][i];
-      for (size_t i = 0; i < size; ++i)
-        oarc << (bool)bitmask2[a][i];
-    }
-    oarc << odd_iteration;
+    oarc << bitmask1 << bitmask2 << odd_iteration;
   }
   void load(graphlab::iarchive& iarc) {
-    bitmask1.clear();
-    bitmask2.clear();
-    size_t num = 0;
-    iarc >> num;
-    for (size_t a = 0; a < num; ++a) {
-      size_t size = 0;
-      iarc >> size;
-      std::vector<bool> mask1;
-      for (size_t i = 0; i < size; ++i) {
-        bool element = true;
-        iarc >> element;
-        mask1.push_back(element);
-      }
-      bitmask1.push_back(mask1);
-      std::vector<bool> mask2;
-      for (size_t i = 0; i < size; ++i) {
-        bool element = true;
-        iarc >> element;
-        mask2.push_back(element);
-      }
-      bitmask2.push_back(mask2);
-    }
-    iarc >> odd_iteration;
+    iarc >> bitmask1 >> bitmask2 >> odd_iteration;
   }
 };
 
@@ -129,63 +121,27 @@ void initialize_vertex_with_hash(graph_type::vertex_type& v) {
   v.data().create_hashed_bitmask(v.id());
 }
 
-//helper function to compute bitwise-or
-void bitwise_or(std::vector<std::vector<bool> >& v1,
-    const std::vector<std::vector<bool> >& v2) {
-  for (size_t a = 0; a < v1.size(); ++a) {
-    while (v1[a].size() < v2[a].size()) {
-      v1[a].push_back(false);
-    }
-    for (size_t i = 0; i < v2[a].size(); ++i) {
-      v1[a][i] = v1[a][i] || v2[a][i];
-    }
-  }
-}
-
 struct bitmask_gatherer {
-  std::vector<std::vector<bool> > bitmask;
+  reach_set bitmask;
 
   bitmask_gatherer() :
     bitmask() {
   }
-  explicit bitmask_gatherer(const std::vector<std::vector<bool> > & in_b) :
-    bitmask(){
-    for(size_t i=0;i<in_b.size();++i){
-      bitmask.push_back(in_b[i]);
-    }
+  explicit bitmask_gatherer(const reach_set& in_b) :
+    bitmask(in_b){
   }
 
   //bitwise-or
   bitmask_gatherer& operator+=(const bitmask_gatherer& other) {
-    bitwise_or(bitmask, other.bitmask);
+    bitmask += other.bitmask;
     return *this;
   }
 
   void save(graphlab::oarchive& oarc) const {
-    size_t num = bitmask.size();
-    oarc << num;
-    for (size_t a = 0; a < num; ++a) {
-      size_t size = bitmask[a].size();
-      oarc << size;
-      for (size_t i = 0; i < size; ++i)
-        oarc << (bool)bitmask[a][i];
-    }
+    oarc << bitmask;
   }
   void load(graphlab::iarchive& iarc) {
-    bitmask.clear();
-    size_t num = 0;
-    iarc >> num;
-    for (size_t a = 0; a < num; ++a) {
-      size_t size = 0;
-      iarc >> size;
-      std::vector<bool> mask1;
-      for (size_t i = 0; i < size; ++i) {
-        bool element = true;
-        iarc >> element;
-        mask1.push_back(element);
-      }
-      bitmask.push_back(mask1);
-    }
+    iarc >> bitmask;
   }
 };
 
@@ -214,12 +170,10 @@ public:
   void apply(icontext_type& context, vertex_type& vertex,
       const gather_type& total) {
     if (vertex.data().odd_iteration) {
-      if (total.bitmask.size() > 0)
-        bitwise_or(vertex.data().bitmask1, total.bitmask);
+      vertex.data().bitmask1 += total.bitmask;
       vertex.data().odd_iteration = false;
     } else {
-      if (total.bitmask.size() > 0)
-        bitwise_or(vertex.data().bitmask2, total.bitmask);
+      vertex.data().bitmask2 += total.bitmask;
       vertex.data().odd_iteration = true;
     }
   }
@@ -244,31 +198,17 @@ void copy_bitmasks(graph_type::vertex_type& vdata) {
 
 //count the number of vertices reached in the current hop
 size_t absolute_vertex_data(const graph_type::vertex_type& vertex) {
-    size_t count = 0;
-    for (size_t i = 0; i < vertex.data().bitmask1[0].size(); ++i)
-      if (vertex.data().bitmask1[0][i])
-        count++;
-    return count;
-}
-
-//count the number of vertices reached in the current hop with Flajolet & Martin counting method
-size_t approximate_pair_number(std::vector<std::vector<bool> > bitmask) {
-  float sum = 0.0;
-  for (size_t a = 0; a < bitmask.size(); ++a) {
-    for (size_t i = 0; i < bitmask[a].size(); ++i) {
-      if (bitmask[a][i] == 0) {
-        sum += (float) i;
-        break;
-      }
-    }
+  size_t count = 0;
+  foreach(uint64_t word, vertex.data().bitmask1.exact) {
+    count += __builtin_popcountll(word);
   }
-  return (size_t) (pow(2.0, sum / (float) (bitmask.size())) / 0.77351);
+  return count;
 }
-//count the number of notes reached in the current hop
+
+//count the number of notes reached in the current hop with Flajolet & Martin counting method
 size_t absolute_vertex_data_with_hash(
     const graph_type::vertex_type& vertex) {
-    size_t count = approximate_pair_number(vertex.data().bitmask1);
-    return count;
+  return (size_t) vertex.data().bitmask1.sketch.estimate();
 }
 
 int main(int argc, char** argv) {
@@ -353,6 +293,28 @@ int main(int argc, char** argv) {
   dc.cout() << "graph calculation time is " << (end - start) << " sec\n";
   dc.cout() << "The approximate diameter is " << diameter << "\n";
 
+  // With the edge_sample_rate graph option each edge is kept with
+  // probability p, which divides the mean degree by 1 / p. The distances
+  // of a random graph with mean degree d grow as log(n) / log(d), so the
+  // diameter of the full graph is estimated by scaling by
+  // log(p d) / log(d). Below a mean degree of 1 the sampled graph falls
+  // apart and the estimate means little.
+  const double sample_rate = graph.get_edge_sample_rate();
+  if (sample_rate < 1 && graph.num_vertices() > 0) {
+    const double sampled_degree =
+        double(graph.num_edges()) / graph.num_vertices();
+    if (sampled_degree > 1) {
+      const double estimate = diameter * std::log(sampled_degree)
+          / std::log(sampled_degree / sample_rate);
+      dc.cout() << "Corrected for the edge sample rate " << sample_rate
+                << ", the estimated diameter is " << estimate << "\n";
+    } else {
+      dc.cout() << "The mean degree of the sampled graph is "
+                << sampled_degree << ", too low to correct the diameter "
+                << "for the edge sample rate " << sample_rate << "\n";
+    }
+  }
+
   graphlab::mpi_tools::finalize();
 
   return EXIT_SUCCESS;
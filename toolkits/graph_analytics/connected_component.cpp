@@ -30,6 +30,8 @@
 
 #include <graphlab.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
+#include <graphlab/util/union_find.hpp>
+#include <graphlab/macros_def.hpp>
 
 struct vdata {
   uint64_t labelid;
@@ -134,6 +136,237 @@ public:
   }
 };
 
+/*
+ * Connected components by union-find, in a number of rounds which
+ * does not depend on the diameter of the graph.
+ *
+ * 1. Each machine merges the endpoints of its local edges in a
+ *    union_find over its local vertices, and labels each local set with
+ *    its smallest vertex id.
+ * 2. The copies of a replicated vertex may be in different local sets
+ *    on different machines. Its master collects their labels, which
+ *    gives edges (label, smallest label) of a graph over the local
+ *    sets. This graph is much smaller than the input graph: it only has
+ *    an edge per mirror.
+ * 3. That graph is solved by hooking and pointer jumping over a table
+ *    of parent labels, partitioned among the machines by label. Hooks
+ *    always point to a smaller label and every jumping round halves the
+ *    paths, so the roots are the smallest vertex ids of the components.
+ * 4. Every copy takes the root of its local set label.
+ *
+ * The labels are the same as those found by label_propagation.
+ */
+class union_find_components {
+ public:
+  typedef uint64_t label_type;
+  typedef std::pair<label_type, label_type> label_edge;
+
+  /// The labels of the copies of a vertex
+  struct label_list {
+    std::vector<label_type> labels;
+    label_list& operator+=(const label_list& other) {
+      labels.insert(labels.end(), other.labels.begin(), other.labels.end());
+      return *this;
+    }
+    void save(graphlab::oarchive& oarc) const { oarc << labels; }
+    void load(graphlab::iarchive& iarc) { iarc >> labels; }
+  };
+
+  union_find_components(graph_type& graph) : 
+      graph(graph), rmi(graph.dc(), this) { }
+
+  /// Sets the labelid of every vertex to its component id
+  void run() {
+    label_local_sets();
+    collect_label_edges();
+    size_t rounds = 0;
+    while (hook()) {
+      ++rounds;
+      while (jump()) ++rounds;
+    }
+    relabel();
+    if (rmi.procid() == 0) {
+      logstream(LOG_EMPH) << "Union-find resolved " << num_label_edges
+                          << " label edges in " << rounds 
+                          << " rounds" << std::endl;
+    }
+  }
+
+ private:
+  graph_type& graph;
+  graphlab::dc_dist_object<union_find_components> rmi;
+  // the parent of the labels homed on this machine. Missing labels are
+  // their own parent
+  boost::unordered_map<label_type, label_type> parent;
+  // the label edges whose endpoints are not yet known to be connected
+  std::vector<label_edge> label_edges;
+  graphlab::mutex label_edges_lock;
+  size_t num_label_edges;
+
+  graphlab::procid_t home(label_type label) const {
+    return label % rmi.numprocs();
+  }
+
+  label_type parent_of(label_type label) const {
+    boost::unordered_map<label_type, label_type>::const_iterator it = 
+        parent.find(label);
+    return it == parent.end() ? label : it->second;
+  }
+
+  void label_local_sets() {
+    const int nverts = graph.num_local_vertices();
+    graphlab::concurrent_union_find sets;
+    sets.init(nverts);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int lvid = 0; lvid < nverts; ++lvid) {
+      foreach(graph_type::local_edge_type edge, 
+              graph.l_vertex(lvid).out_edges()) {
+        sets.merge(lvid, edge.target().id());
+      }
+    }
+    std::vector<label_type> set_label(nverts, 
+                                      std::numeric_limits<label_type>::max());
+    for (int lvid = 0; lvid < nverts; ++lvid) {
+      label_type& label = set_label[sets.find(lvid)];
+      label = std::min<label_type>(label, graph.global_vid(lvid));
+    }
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int lvid = 0; lvid < nverts; ++lvid) {
+      graph.l_vertex(lvid).data().labelid = set_label[sets.find(lvid)];
+    }
+  }
+
+  static label_list gather_label(graphlab::lvid_type lvid, graph_type& graph) {
+    label_list ret;
+    ret.labels.push_back(graph.l_vertex(lvid).data().labelid);
+    return ret;
+  }
+
+  void apply_labels(graphlab::lvid_type lvid, const label_list& copies, 
+                    graph_type& graph) {
+    if (!graph.l_is_master(lvid) || copies.labels.size() < 2) return;
+    const label_type root = *std::min_element(copies.labels.begin(), 
+                                              copies.labels.end());
+    label_edges_lock.lock();
+    for (size_t i = 0; i < copies.labels.size(); ++i) {
+      if (copies.labels[i] != root) 
+        label_edges.push_back(label_edge(copies.labels[i], root));
+    }
+    label_edges_lock.unlock();
+  }
+
+  void collect_label_edges() {
+    graphlab::graph_gather_apply<graph_type, label_list> 
+      collect(graph, gather_label, 
+              boost::bind(&union_find_components::apply_labels, 
+                          this, _1, _2, _3));
+    collect.exec();
+    std::sort(label_edges.begin(), label_edges.end());
+    label_edges.erase(std::unique(label_edges.begin(), label_edges.end()), 
+                      label_edges.end());
+    num_label_edges = label_edges.size();
+    rmi.all_reduce(num_label_edges);
+  }
+
+  /// Replaces every label by its parent, looked up on its home machine
+  void lookup(std::vector<label_type>& labels) {
+    std::vector<std::vector<label_type> > queries(rmi.numprocs());
+    for (size_t i = 0; i < labels.size(); ++i) 
+      queries[home(labels[i])].push_back(labels[i]);
+    rmi.all_to_all(queries);
+    for (size_t i = 0; i < queries.size(); ++i) {
+      for (size_t j = 0; j < queries[i].size(); ++j) 
+        queries[i][j] = parent_of(queries[i][j]);
+    }
+    rmi.all_to_all(queries);
+    std::vector<size_t> next(rmi.numprocs(), 0);
+    for (size_t i = 0; i < labels.size(); ++i) {
+      const graphlab::procid_t p = home(labels[i]);
+      labels[i] = queries[p][next[p]++];
+    }
+  }
+
+  /**
+   * Hooks the larger root of every label edge whose endpoints are in
+   * different trees to the smaller one. The trees are stars, so one
+   * lookup finds the roots. Returns false once no edge is left.
+   */
+  bool hook() {
+    std::vector<label_type> roots(2 * label_edges.size());
+    for (size_t i = 0; i < label_edges.size(); ++i) {
+      roots[2 * i] = label_edges[i].first;
+      roots[2 * i + 1] = label_edges[i].second;
+    }
+    lookup(roots);
+    std::vector<std::vector<label_edge> > hooks(rmi.numprocs());
+    size_t nremaining = 0;
+    for (size_t i = 0; i < label_edges.size(); ++i) {
+      const label_type a = roots[2 * i], b = roots[2 * i + 1];
+      if (a == b) continue;
+      label_edges[nremaining++] = label_edge(a, b);
+      const label_edge h(std::max(a, b), std::min(a, b));
+      hooks[home(h.first)].push_back(h);
+    }
+    label_edges.resize(nremaining);
+    rmi.all_reduce(nremaining);
+    if (nremaining == 0) return false;
+    rmi.all_to_all(hooks);
+    for (size_t i = 0; i < hooks.size(); ++i) {
+      for (size_t j = 0; j < hooks[i].size(); ++j) {
+        const label_edge& h = hooks[i][j];
+        parent[h.first] = std::min(parent_of(h.first), h.second);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Points every homed label to its grandparent. Returns false once
+   * all the trees are stars.
+   */
+  bool jump() {
+    std::vector<label_type> labels, parents;
+    boost::unordered_map<label_type, label_type>::const_iterator it;
+    for (it = parent.begin(); it != parent.end(); ++it) {
+      if (it->first == it->second) continue;
+      labels.push_back(it->first);
+      parents.push_back(it->second);
+    }
+    std::vector<label_type> grandparents = parents;
+    lookup(grandparents);
+    size_t nchanged = 0;
+    for (size_t i = 0; i < labels.size(); ++i) {
+      if (grandparents[i] != parents[i]) {
+        parent[labels[i]] = grandparents[i];
+        ++nchanged;
+      }
+    }
+    rmi.all_reduce(nchanged);
+    return nchanged > 0;
+  }
+
+  void relabel() {
+    std::vector<label_type> labels;
+    const size_t nverts = graph.num_local_vertices();
+    for (size_t lvid = 0; lvid < nverts; ++lvid) 
+      labels.push_back(graph.l_vertex(lvid).data().labelid);
+    std::sort(labels.begin(), labels.end());
+    labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+    std::vector<label_type> roots = labels;
+    lookup(roots);
+    boost::unordered_map<label_type, label_type> root_of;
+    for (size_t i = 0; i < labels.size(); ++i) root_of[labels[i]] = roots[i];
+    for (size_t lvid = 0; lvid < nverts; ++lvid) {
+      uint64_t& label = graph.l_vertex(lvid).data().labelid;
+      label = root_of[label];
+    }
+  }
+}; // end of union_find_components
+
 class graph_writer {
 public:
   std::string save_vertex(graph_type::vertex_type v) {
@@ -158,11 +391,15 @@ int main(int argc, char** argv) {
   std::string saveprefix;
   std::string format = "adj";
   std::string exec_type = "synchronous";
+  std::string algorithm = "label_propagation";
   clopts.attach_option("graph", graph_dir,
                        "The graph file. This is not optional");
   clopts.add_positional("graph");
   clopts.attach_option("format", format,
                        "The graph file format");
+  clopts.attach_option("algorithm", algorithm,
+                       "label_propagation, or union_find which needs a few "
+                       "rounds regardless of the diameter of the graph");
   clopts.attach_option("saveprefix", saveprefix,
                        "If set, will save the pairs of a vertex id and "
                        "a component id to a sequence of files with prefix "
@@ -175,6 +412,10 @@ int main(int argc, char** argv) {
     std::cout << "--graph is not optional\n";
     return EXIT_FAILURE;
   }
+  if (algorithm != "label_propagation" && algorithm != "union_find") {
+    std::cout << "Unknown algorithm: " << algorithm << "\n";
+    return EXIT_FAILURE;
+  }
 
   graph_type graph(dc, clopts);
 
@@ -184,14 +425,20 @@ int main(int argc, char** argv) {
   graphlab::timer ti;
   graph.finalize();
   dc.cout() << "Finalization in " << ti.current_time() << std::endl;
-  graph.transform_vertices(initialize_vertex);
-
-  //running the engine
-  time_t start, end;
-  graphlab::omni_engine<label_propagation> engine(dc, graph, exec_type, clopts);
-  engine.signal_all();
-  time(&start);
-  engine.start();
+
+  ti.start();
+  if (algorithm == "union_find") {
+    union_find_components components(graph);
+    components.run();
+  } else {
+    graph.transform_vertices(initialize_vertex);
+
+    //running the engine
+    graphlab::omni_engine<label_propagation> engine(dc, graph, exec_type, clopts);
+    engine.signal_all();
+    engine.start();
+  }
+  dc.cout() << "Components found in " << ti.current_time() << std::endl;
 
   //write results
   if (saveprefix.size() > 0) {
@@ -23,6 +23,7 @@
 
 #include <boost/unordered_set.hpp>
 #include <graphlab.hpp>
+#include <graphlab/graph/sorted_intersection.hpp>
 #include <graphlab/ui/metrics_server.hpp>
 #include <graphlab/util/cuckoo_set_pow2.hpp>
 #include <graphlab/macros_def.hpp>
@@ -212,35 +213,6 @@ struct vid_vector{
   }
 };
 
-/*
-  A simple counting iterator which can be used as an insert iterator.
-  but only counts the number of elements inserted. Useful for
-  use with counting the size of an intersection using std::set_intersection
-*/
-template <typename T>
-struct counting_inserter {
-  size_t* i;
-  counting_inserter(size_t* i):i(i) { }
-  counting_inserter& operator++() {
-    ++(*i);
-    return *this;
-  }
-  void operator++(int) {
-    ++(*i);
-  }
-
-  struct empty_val {
-    empty_val operator=(const T&) { return empty_val(); }
-  };
-
-  empty_val operator*() {
-    return empty_val();
-  }
-
-  typedef empty_val reference;
-};
-
-
 /*
  * Computes the size of the intersection of two vid_vector's
  */
@@ -251,12 +223,8 @@ static uint32_t count_set_intersect(
     return count_set_intersect(larger_set, smaller_set);
   }
   if (smaller_set.cset == NULL && larger_set.cset == NULL) {
-    size_t i = 0;
-    counting_inserter<graphlab::vertex_id_type> iter(&i);
-    std::set_intersection(smaller_set.vid_vec.begin(), smaller_set.vid_vec.end(),
-                          larger_set.vid_vec.begin(), larger_set.vid_vec.end(),
-                          iter);
-    return i;
+    return graphlab::graph_ops::sorted_intersection_size(smaller_set.vid_vec,
+                                                         larger_set.vid_vec);
   }
   else if (smaller_set.cset == NULL && larger_set.cset != NULL) {
     size_t i = 0;
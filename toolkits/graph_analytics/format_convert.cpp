@@ -19,8 +19,339 @@
  *      http://www.graphlab.ml.cmu.edu
  *
  */
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
 #include <graphlab.hpp>
 
+typedef graphlab::distributed_graph<graphlab::empty, graphlab::empty> graph_type;
+typedef graphlab::vertex_id_type vertex_id_type;
+
+/*
+ * Streaming conversion -------------------------------------------------------
+ *
+ * Structure only conversions do not need the graph: each input file is read
+ * in blocks, every block is cut into one piece per thread at line (or edge)
+ * boundaries, and each thread parses its piece with the span parsers used to
+ * load graphs and formats it into the output. The pieces are then written in
+ * order, so the output file follows the input file. Input file i of n is
+ * converted by machine i % #machines into [outgraph]_[i+1]_of_[n].
+ */
+
+/// Marks a vertex without edges in edge_sink::dst
+const vertex_id_type NO_TARGET = vertex_id_type(-1);
+
+/// Collects the edges of a piece. Stands in for the graph in the span parsers.
+struct edge_sink {
+  std::vector<vertex_id_type> src, dst;
+  void add_edge(vertex_id_type source, vertex_id_type target) {
+    src.push_back(source);
+    dst.push_back(target);
+  }
+  void add_vertex(vertex_id_type vid) {
+    add_edge(vid, NO_TARGET);
+  }
+  void clear() { src.clear(); dst.clear(); }
+};
+
+typedef bool (*sink_parser_type)(edge_sink&, const std::string&,
+                                 const char*, const char*);
+
+/// Returns the span parser of a text format, or NULL
+sink_parser_type text_parser(const std::string& format) {
+  using namespace graphlab::builtin_parsers;
+  if (format == "tsv") return tsv_span_parser<edge_sink>;
+  if (format == "snap") return snap_span_parser<edge_sink>;
+  if (format == "adj") return adj_span_parser<edge_sink>;
+  if (format == "csv") return csv_span_parser<edge_sink>;
+  return NULL;
+}
+
+bool can_stream(const std::string& informat, const std::string& outformat) {
+  return (text_parser(informat) != NULL || 
+          informat == "bintsv4" || informat == "binedge") &&
+    (outformat == "tsv" || outformat == "snap" || outformat == "adj" ||
+     outformat == "bintsv4" || outformat == "binedge");
+}
+
+template <typename T>
+void append_raw(std::string& out, const T* values, size_t n) {
+  out.append(reinterpret_cast<const char*>(values), n * sizeof(T));
+}
+
+/// Appends the edges [begin, end) of the sink to out in the output format
+void format_edges(const std::string& format, const edge_sink& edges,
+                  size_t begin, size_t end, std::string& out) {
+  using graphlab::builtin_parsers::append_uint;
+  if (format == "tsv" || format == "snap") {
+    for (size_t i = begin; i < end; ++i) {
+      if (edges.dst[i] == NO_TARGET) continue;
+      append_uint(out, edges.src[i]);
+      out += '\t';
+      append_uint(out, edges.dst[i]);
+      out += '\n';
+    }
+  } else if (format == "adj") {
+    // one line for each run of edges with the same source
+    size_t i = begin;
+    while (i < end) {
+      size_t j = i;
+      size_t n = 0;
+      while (j < end && edges.src[j] == edges.src[i]) {
+        if (edges.dst[j] != NO_TARGET) ++n;
+        ++j;
+      }
+      append_uint(out, edges.src[i]);
+      out += ' ';
+      append_uint(out, n);
+      for (; i < j; ++i) {
+        if (edges.dst[i] == NO_TARGET) continue;
+        out += ' ';
+        append_uint(out, edges.dst[i]);
+      }
+      out += '\n';
+    }
+  } else if (format == "bintsv4") {
+    for (size_t i = begin; i < end; ++i) {
+      const uint32_t pair[2] = { uint32_t(edges.src[i]), uint32_t(edges.dst[i]) };
+      append_raw(out, pair, 2);
+    }
+  } else if (format == "binedge") {
+    for (size_t i = begin; i < end; i += graph_type::BINEDGE_BLOCK_SIZE) {
+      const uint64_t n = std::min<size_t>(end - i, graph_type::BINEDGE_BLOCK_SIZE);
+      append_raw(out, &n, 1);
+      append_raw(out, &edges.src[i], n);
+      append_raw(out, &edges.dst[i], n);
+    }
+  }
+}
+
+/// Formats the sink with one piece per thread and writes the pieces in order
+template <typename Fstream>
+void write_edges(const std::string& format, const edge_sink& edges,
+                 std::vector<std::string>& outs, Fstream& fout) {
+  const size_t npieces = outs.size();
+  const size_t n = edges.src.size();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int t = 0; t < int(npieces); ++t) {
+    outs[t].clear();
+    format_edges(format, edges, n * t / npieces, n * (t + 1) / npieces, outs[t]);
+  }
+  for (size_t t = 0; t < npieces; ++t) fout.write(outs[t].data(), outs[t].size());
+}
+
+/// The size of the blocks in which input files are read
+const size_t STREAM_BLOCK_SIZE = 16 * 1024 * 1024;
+
+/// Streams a text file. Returns false on a parse error.
+template <typename Fstream, typename Ostream>
+bool stream_text(const std::string& fname, sink_parser_type parser, 
+                 const std::string& outformat, size_t nthreads,
+                 Fstream& fin, Ostream& fout, size_t& nedges) {
+  std::vector<char> buffer(STREAM_BLOCK_SIZE);
+  std::vector<edge_sink> sinks(nthreads);
+  std::vector<std::string> outs(nthreads);
+  size_t valid = 0;
+  bool eof = false;
+  while (!eof) {
+    fin.read(&buffer[valid], buffer.size() - valid);
+    const size_t nread = fin.gcount();
+    valid += nread;
+    if (nread == 0 || !fin.good()) eof = true;
+    // the block ends after its last newline, or at the end of the file
+    size_t block_end = valid;
+    if (!eof) {
+      while (block_end > 0 && buffer[block_end - 1] != '\n') --block_end;
+      if (block_end == 0) {
+        // a single line does not fit
+        buffer.resize(2 * buffer.size());
+        continue;
+      }
+    }
+    // cut the block into one piece per thread at line boundaries
+    std::vector<size_t> cuts(nthreads + 1, block_end);
+    cuts[0] = 0;
+    for (size_t t = 1; t < nthreads; ++t) {
+      size_t c = std::max(cuts[t - 1], block_end * t / nthreads);
+      const char* nl = c < block_end ? 
+        (const char*)memchr(&buffer[c], '\n', block_end - c) : NULL;
+      cuts[t] = nl ? (nl - &buffer[0]) + 1 : block_end;
+    }
+    bool success = true;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int t = 0; t < int(nthreads); ++t) {
+      sinks[t].clear();
+      outs[t].clear();
+      const char* ptr = &buffer[0] + cuts[t];
+      const char* end = &buffer[0] + cuts[t + 1];
+      while (ptr != end) {
+        const char* line_end = (const char*)memchr(ptr, '\n', end - ptr);
+        if (line_end == NULL) line_end = end;
+        if (line_end != ptr && !parser(sinks[t], fname, ptr, line_end)) {
+          logstream(LOG_WARNING) << "Error parsing line in " << fname << ": " 
+                                 << std::endl << "\t\"" 
+                                 << std::string(ptr, line_end) << "\"" << std::endl;
+          success = false;
+          break;
+        }
+        ptr = line_end == end ? end : line_end + 1;
+      }
+      format_edges(outformat, sinks[t], 0, sinks[t].src.size(), outs[t]);
+    }
+    if (!success) return false;
+    for (size_t t = 0; t < nthreads; ++t) {
+      nedges += sinks[t].src.size();
+      fout.write(outs[t].data(), outs[t].size());
+    }
+    valid -= block_end;
+    memmove(&buffer[0], &buffer[block_end], valid);
+  }
+  return true;
+}
+
+/*
+ * Reads n ids of id_bytes bytes each. Ids of -1 of either width mark a
+ * vertex without edges, as in the binedge format.
+ */
+template <typename Fstream>
+bool read_ids(Fstream& fin, uint32_t id_bytes, size_t n, 
+              std::vector<char>& raw, std::vector<vertex_id_type>& ids) {
+  raw.resize(n * id_bytes);
+  ids.resize(n);
+  if (n == 0) return true;
+  fin.read(&raw[0], raw.size());
+  if (size_t(fin.gcount()) != raw.size()) return false;
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t id;
+    if (id_bytes == 4) {
+      const uint32_t id4 = reinterpret_cast<const uint32_t*>(&raw[0])[i];
+      id = id4 == uint32_t(-1) ? uint64_t(-1) : id4;
+    } else {
+      id = reinterpret_cast<const uint64_t*>(&raw[0])[i];
+    }
+    if (id == uint64_t(-1)) {
+      ids[i] = NO_TARGET;
+    } else if (id >= uint64_t(NO_TARGET)) {
+      logstream(LOG_ERROR) << "Vertex id " << id << " does not fit in "
+                           << sizeof(vertex_id_type) << " bytes" << std::endl;
+      return false;
+    } else {
+      ids[i] = vertex_id_type(id);
+    }
+  }
+  return true;
+}
+
+/// Streams a bintsv4 or binedge file. Returns false if it is malformed.
+template <typename Fstream, typename Ostream>
+bool stream_binary(const std::string& informat, const std::string& outformat, 
+                   size_t nthreads, Fstream& fin, Ostream& fout, size_t& nedges) {
+  std::vector<std::string> outs(nthreads);
+  std::vector<char> raw;
+  edge_sink edges;
+  if (informat == "bintsv4") {
+    const size_t block = STREAM_BLOCK_SIZE / 8;
+    std::vector<uint32_t> pairs(2 * block);
+    while (fin.good()) {
+      fin.read(reinterpret_cast<char*>(&pairs[0]), pairs.size() * 4);
+      const size_t n = fin.gcount() / 8;
+      edges.clear();
+      for (size_t i = 0; i < n; ++i) {
+        if (pairs[2 * i + 1] == uint32_t(-1)) edges.add_vertex(pairs[2 * i]);
+        else edges.add_edge(pairs[2 * i], pairs[2 * i + 1]);
+      }
+      nedges += n;
+      write_edges(outformat, edges, outs, fout);
+    }
+    return true;
+  }
+  graph_type::binedge_header header;
+  fin.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (size_t(fin.gcount()) != sizeof(header) ||
+      memcmp(header.magic, graph_type::binedge_header::expected_magic(), 8) != 0 ||
+      (header.id_bytes != 4 && header.id_bytes != 8)) {
+    logstream(LOG_ERROR) << "Not a binedge file" << std::endl;
+    return false;
+  }
+  uint64_t n;
+  while (fin.read(reinterpret_cast<char*>(&n), sizeof(n))) {
+    if (!read_ids(fin, header.id_bytes, n, raw, edges.src) ||
+        !read_ids(fin, header.id_bytes, n, raw, edges.dst)) return false;
+    // the edge data is dropped
+    fin.ignore(n * header.edata_bytes);
+    nedges += n;
+    write_edges(outformat, edges, outs, fout);
+  }
+  return true;
+}
+
+/// Converts every input file assigned to this machine without loading the graph
+bool stream_convert(graphlab::distributed_control& dc,
+                    const std::string& ingraph, const std::string& informat,
+                    const std::string& outgraph, const std::string& outformat,
+                    bool gzip, size_t nthreads) {
+  boost::filesystem::path path(ingraph);
+  std::string directory_name, search_prefix;
+  if (boost::filesystem::is_directory(path)) {
+    directory_name = path.native();
+  } else {
+    directory_name = path.parent_path().native();
+    search_prefix = path.filename().native();
+    directory_name = (directory_name.empty() ? "." : directory_name);
+  }
+  std::vector<std::string> files;
+  graphlab::fs_util::list_files_with_prefix(directory_name, search_prefix, files);
+  if (files.empty()) {
+    logstream(LOG_WARNING) << "No files found matching " << ingraph << std::endl;
+  }
+  bool success = true;
+  size_t nedges = 0;
+  graphlab::timer ti;
+  for (size_t i = dc.procid(); i < files.size() && success; i += dc.numprocs()) {
+    std::string outname = outgraph + "_" + graphlab::tostr(i + 1) + "_of_" + 
+      graphlab::tostr(files.size());
+    if (gzip) outname += ".gz";
+    logstream(LOG_EMPH) << "Converting " << files[i] << " to " << outname << std::endl;
+    std::ifstream in_file(files[i].c_str(), std::ios_base::in | std::ios_base::binary);
+    std::ofstream out_file(outname.c_str(), std::ios_base::out | std::ios_base::binary);
+    if (!in_file.good() || !out_file.good()) {
+      logstream(LOG_ERROR) << "Unable to open " << files[i] << " or " 
+                           << outname << std::endl;
+      success = false;
+      break;
+    }
+    boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+    if (boost::ends_with(files[i], ".gz")) fin.push(boost::iostreams::gzip_decompressor());
+    fin.push(in_file);
+    boost::iostreams::filtering_stream<boost::iostreams::output> fout;
+    if (gzip) fout.push(boost::iostreams::gzip_compressor());
+    fout.push(out_file);
+    if (outformat == "binedge") {
+      graph_type::binedge_header header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, graph_type::binedge_header::expected_magic(), 8);
+      header.version = 1;
+      header.id_bytes = sizeof(vertex_id_type);
+      fout.write(reinterpret_cast<char*>(&header), sizeof(header));
+    }
+    sink_parser_type parser = text_parser(informat);
+    if (parser != NULL) {
+      success = stream_text(files[i], parser, outformat, nthreads, fin, fout, nedges);
+    } else {
+      success = stream_binary(informat, outformat, nthreads, fin, fout, nedges);
+    }
+    fin.pop();
+    fout.pop();
+  }
+  logstream(LOG_INFO) << "Converted " << nedges << " edges and vertices in " 
+                      << ti.current_time() << " secs" << std::endl;
+  dc.barrier();
+  return success;
+}
+
 int main(int argc, char** argv) {
   // Initialize control plain using mpi
   graphlab::mpi_tools::init(argc, argv);
@@ -32,6 +363,7 @@ int main(int argc, char** argv) {
   std::string outgraph, outformat;
 
   bool gzip = true;
+  bool streaming = true;
   // Parse command line options -----------------------------------------------
   graphlab::command_line_options clopts("Graph Format Conversion.", true);
 
@@ -48,6 +380,11 @@ int main(int argc, char** argv) {
                        "The output graph file format");
   clopts.attach_option("outgzip", gzip,
                        "If output is to be gzip compressed");
+  clopts.attach_option("streaming", streaming,
+                       "If set, conversions between the tsv, snap, adj, csv "
+                       "(input only), bintsv4 and binedge formats stream the "
+                       "input files to one output file each, without loading "
+                       "the graph");
 
   if(!clopts.parse(argc, argv)) {
     dc.cout() << "Error in parsing command line arguments." << std::endl;
@@ -57,7 +394,15 @@ int main(int argc, char** argv) {
     clopts.print_description();
     return EXIT_FAILURE;
   }
-  typedef graphlab::distributed_graph<graphlab::empty, graphlab::empty> graph_type;
+  if (streaming && powerlaw == 0 && !boost::starts_with(ingraph, "hdfs://") &&
+      !boost::starts_with(outgraph, "hdfs://") && can_stream(informat, outformat)) {
+    dc.cout() << "Streaming graph in format: " << informat << std::endl;
+    const bool success = stream_convert(dc, ingraph, informat, outgraph, outformat,
+                                        gzip, clopts.get_ncpus());
+    graphlab::mpi_tools::finalize();
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   graph_type graph(dc, clopts);
 
   dc.cout() << "Loading graph in format: "<< ingraph << std::endl;
@@ -0,0 +1,558 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * A long running server which loads and partitions a graph once and
+ * then runs analytics jobs on it, so that the jobs do not pay for the
+ * load and the graph stays warm in memory between them.
+ *
+ * Each vertex holds a row of named double columns. A job writes its
+ * result into a column: into an existing column in place, or into a
+ * new overlay column which leaves the other results untouched. Jobs
+ * are query strings such as
+ *
+ *   program=pagerank&column=pr&tol=0.001&engine=async
+ *
+ * and are submitted through http://[machine 0]:8090/submit?[query],
+ * or read one per line from the --jobs file at startup. The jobs run
+ * one at a time in submission order, and http://[machine 0]:8090/jobs
+ * lists them with the columns.
+ */
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <cmath>
+
+#include <graphlab.hpp>
+#include <graphlab/ui/metrics_server.hpp>
+#include <graphlab/macros_def.hpp>
+
+/// A row of named columns. See COLUMNS
+struct vertex_columns {
+  std::vector<double> values;
+  void save(graphlab::oarchive& oarc) const { oarc << values; }
+  void load(graphlab::iarchive& iarc) { iarc >> values; }
+};
+
+typedef graphlab::distributed_graph<vertex_columns, graphlab::empty> graph_type;
+
+/// The names of the vertex columns. The same on all machines.
+std::vector<std::string> COLUMNS;
+
+// The parameters of the running job
+size_t OUT_COLUMN = 0;
+double TOLERANCE = 1.0E-3;
+double RESET_PROB = 0.15;
+
+const double INFINITE_DISTANCE = std::numeric_limits<double>::max();
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                           Vertex programs                              */
+/*                                                                        */
+/**************************************************************************/
+
+inline double& value(graph_type::vertex_type vertex) {
+  return vertex.data().values[OUT_COLUMN];
+}
+
+inline graph_type::vertex_type get_other_vertex(graph_type::edge_type& edge,
+                                                const graph_type::vertex_type& vertex) {
+  return vertex.id() == edge.source().id() ? edge.target() : edge.source();
+}
+
+class pagerank :
+  public graphlab::ivertex_program<graph_type, double>,
+  public graphlab::IS_POD_TYPE {
+  double last_change;
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::IN_EDGES;
+  }
+
+  double gather(icontext_type& context, const vertex_type& vertex,
+                edge_type& edge) const {
+    return value(edge.source()) / edge.source().num_out_edges();
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex, const double& total) {
+    const double newval = RESET_PROB + (1 - RESET_PROB) * total;
+    last_change = std::fabs(newval - value(vertex));
+    value(vertex) = newval;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return last_change > TOLERANCE ? graphlab::OUT_EDGES : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    context.signal(edge.target());
+  }
+}; // end of pagerank
+
+/// The smallest of the values added together
+struct min_value : public graphlab::IS_POD_TYPE {
+  double value;
+  min_value(double value = INFINITE_DISTANCE) : value(value) { }
+  min_value& operator+=(const min_value& other) {
+    value = std::min(value, other.value);
+    return *this;
+  }
+};
+
+/// Labels every vertex with the smallest vertex id of its component
+class connected_components :
+  public graphlab::ivertex_program<graph_type, min_value>,
+  public graphlab::IS_POD_TYPE {
+  bool changed;
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+
+  min_value gather(icontext_type& context, const vertex_type& vertex,
+                   edge_type& edge) const {
+    return min_value(value(get_other_vertex(edge, vertex)));
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const min_value& total) {
+    changed = total.value < value(vertex);
+    if (changed) value(vertex) = total.value;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return changed ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = get_other_vertex(edge, vertex);
+    if (value(other) > value(vertex)) context.signal(other);
+  }
+}; // end of connected_components
+
+/// The number of out edges on a shortest path from the source
+class sssp :
+  public graphlab::ivertex_program<graph_type, graphlab::empty, min_value>,
+  public graphlab::IS_POD_TYPE {
+  double distance;
+  bool changed;
+public:
+  void init(icontext_type& context, const vertex_type& vertex,
+            const min_value& msg) {
+    distance = msg.value;
+  }
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const graphlab::empty& empty) {
+    changed = distance < value(vertex);
+    if (changed) value(vertex) = distance;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return changed ? graphlab::OUT_EDGES : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const double newdist = value(vertex) + 1;
+    if (value(edge.target()) > newdist) {
+      context.signal(edge.target(), min_value(newdist));
+    }
+  }
+}; // end of sssp
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                               Columns                                  */
+/*                                                                        */
+/**************************************************************************/
+
+void resize_columns(graph_type::vertex_type& vertex, size_t ncolumns) {
+  vertex.data().values.resize(ncolumns, 0);
+}
+
+void erase_column(graph_type::vertex_type& vertex, size_t column) {
+  vertex.data().values.erase(vertex.data().values.begin() + column);
+}
+
+void set_value(graph_type::vertex_type& vertex, double initial) {
+  value(vertex) = initial;
+}
+
+void set_vertex_id(graph_type::vertex_type& vertex) {
+  value(vertex) = vertex.id();
+}
+
+void set_degree(graph_type::vertex_type& vertex) {
+  value(vertex) = vertex.num_in_edges() + vertex.num_out_edges();
+}
+
+/// Returns the index of a column, or COLUMNS.size()
+size_t find_column(const std::string& name) {
+  return std::find(COLUMNS.begin(), COLUMNS.end(), name) - COLUMNS.begin();
+}
+
+/// Returns the index of a column, adding it to every vertex if new
+size_t get_or_add_column(graph_type& graph, const std::string& name) {
+  const size_t column = find_column(name);
+  if (column == COLUMNS.size()) {
+    COLUMNS.push_back(name);
+    graph.transform_vertices(boost::bind(resize_columns, _1, COLUMNS.size()));
+  }
+  return column;
+}
+
+struct column_writer {
+  size_t column;
+  column_writer(size_t column) : column(column) { }
+  std::string save_vertex(graph_type::vertex_type v) {
+    std::stringstream strm;
+    strm << v.id() << "\t" << v.data().values[column] << "\n";
+    return strm.str();
+  }
+  std::string save_edge(graph_type::edge_type e) { return ""; }
+}; // end of column writer
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                                 Jobs                                   */
+/*                                                                        */
+/**************************************************************************/
+
+typedef std::map<std::string, std::string> job_args;
+
+/// Parses a query string of key=value pairs separated by '&'
+job_args parse_query(const std::string& query) {
+  job_args args;
+  std::vector<std::string> pairs = graphlab::strsplit(query, "&");
+  foreach(const std::string& pair, pairs) {
+    const size_t eq = pair.find('=');
+    if (eq == std::string::npos) args[pair] = "";
+    else args[pair.substr(0, eq)] = pair.substr(eq + 1);
+  }
+  return args;
+}
+
+std::string get_arg(const job_args& args, const std::string& key,
+                    const std::string& default_value) {
+  job_args::const_iterator iter = args.find(key);
+  return iter == args.end() ? default_value : iter->second;
+}
+
+/**
+ * Runs a vertex program on the graph, returning the number of updates.
+ * Signals the sources with source_message, or all the vertices.
+ */
+template <typename VertexProgram>
+size_t run_engine(graphlab::distributed_control& dc, graph_type& graph,
+                  const graphlab::command_line_options& clopts,
+                  const std::string& engine_type, 
+                  const std::vector<graphlab::vertex_id_type>& sources =
+                      std::vector<graphlab::vertex_id_type>(),
+                  const typename VertexProgram::message_type& source_message =
+                      typename VertexProgram::message_type()) {
+  graphlab::omni_engine<VertexProgram> engine(dc, graph, engine_type, clopts);
+  if (sources.empty()) {
+    engine.signal_all();
+  } else {
+    foreach(graphlab::vertex_id_type vid, sources) {
+      engine.signal(vid, source_message);
+    }
+  }
+  engine.start();
+  return engine.num_updates();
+}
+
+/**
+ * Runs a job on all the machines. Returns "done", or the reason the
+ * job failed. Must be called by all the machines with the same
+ * arguments.
+ */
+std::string run_job(graphlab::distributed_control& dc, graph_type& graph,
+                    const graphlab::command_line_options& clopts,
+                    const job_args& args, size_t& updates) {
+  updates = 0;
+  const std::string program = get_arg(args, "program", "");
+  const std::string column = get_arg(args, "column", program);
+  if (program == "drop") {
+    const size_t index = find_column(column);
+    if (index == COLUMNS.size()) return "failed: no column " + column;
+    graph.transform_vertices(boost::bind(erase_column, _1, index));
+    COLUMNS.erase(COLUMNS.begin() + index);
+    return "done";
+  } else if (program == "save") {
+    const size_t index = find_column(column);
+    const std::string prefix = get_arg(args, "prefix", "");
+    if (index == COLUMNS.size()) return "failed: no column " + column;
+    if (prefix.empty()) return "failed: no prefix";
+    graph.save(prefix, column_writer(index),
+               false,    // do not gzip
+               true,     // save vertices
+               false);   // do not save edges
+    return "done";
+  }
+
+  const std::string engine_type = get_arg(args, "engine", "synchronous");
+  if (engine_type != "sync" && engine_type != "synchronous" &&
+      engine_type != "async" && engine_type != "asynchronous" &&
+      engine_type != "auto") {
+    return "failed: unknown engine " + engine_type;
+  }
+  if (program != "pagerank" && program != "cc" && program != "sssp" &&
+      program != "degree") {
+    return "failed: unknown program " + program;
+  }
+  TOLERANCE = atof(get_arg(args, "tol", "1.0E-3").c_str());
+  RESET_PROB = atof(get_arg(args, "reset", "0.15").c_str());
+  OUT_COLUMN = get_or_add_column(graph, column);
+  if (program == "pagerank") {
+    graph.transform_vertices(boost::bind(set_value, _1, 1.0));
+    updates = run_engine<pagerank>(dc, graph, clopts, engine_type);
+  } else if (program == "cc") {
+    graph.transform_vertices(set_vertex_id);
+    updates = run_engine<connected_components>(dc, graph, clopts, engine_type);
+  } else if (program == "sssp") {
+    std::vector<graphlab::vertex_id_type> sources;
+    std::stringstream strm(get_arg(args, "source", "0"));
+    graphlab::vertex_id_type vid;
+    while (strm >> vid) {
+      sources.push_back(vid);
+      if (strm.peek() == ',') strm.ignore();
+    }
+    graph.transform_vertices(boost::bind(set_value, _1, INFINITE_DISTANCE));
+    updates = run_engine<sssp>(dc, graph, clopts, engine_type, sources,
+                               min_value(0));
+  } else {
+    graph.transform_vertices(set_degree);
+    updates = graph.num_vertices();
+  }
+  return "done";
+} // end of run_job
+
+
+/**
+ * The jobs submitted to machine 0, and the history of the jobs run.
+ * The http callbacks submit jobs concurrently with the main loop.
+ */
+class job_queue {
+public:
+  struct job {
+    size_t id;
+    std::string query;
+    std::string status;
+    double seconds;
+    size_t updates;
+  };
+
+  job_queue() : nqueued(0) { }
+
+  size_t submit(const std::string& query) {
+    lock.lock();
+    job j;
+    j.id = history.size();
+    j.query = query;
+    j.status = "queued";
+    j.seconds = 0;
+    j.updates = 0;
+    history.push_back(j);
+    ++nqueued;
+    cond.signal();
+    lock.unlock();
+    return j.id;
+  }
+
+  /// Waits for the next job and marks it as running
+  std::string next() {
+    lock.lock();
+    while (nqueued == 0) cond.wait(lock);
+    job& j = history[history.size() - nqueued];
+    --nqueued;
+    j.status = "running";
+    const std::string query = j.query;
+    lock.unlock();
+    return query;
+  }
+
+  /// Returns true if no job is queued
+  bool empty() {
+    lock.lock();
+    const bool ret = nqueued == 0;
+    lock.unlock();
+    return ret;
+  }
+
+  /// Records the end of the job returned by the last call to next()
+  void finish(const std::string& status, double seconds, size_t updates) {
+    lock.lock();
+    job& j = history[history.size() - nqueued - 1];
+    j.status = status;
+    j.seconds = seconds;
+    j.updates = updates;
+    lock.unlock();
+  }
+
+  std::string report() {
+    std::stringstream strm;
+    lock.lock();
+    strm << "id\tstatus\tseconds\tupdates\tquery\n";
+    foreach(const job& j, history) {
+      strm << j.id << "\t" << j.status << "\t" << j.seconds << "\t"
+           << j.updates << "\t" << j.query << "\n";
+    }
+    strm << "\ncolumns:";
+    foreach(const std::string& name, COLUMNS) strm << " " << name;
+    strm << "\n";
+    lock.unlock();
+    return strm.str();
+  }
+
+private:
+  graphlab::mutex lock;
+  graphlab::conditional cond;
+  std::vector<job> history;
+  /// The jobs at the end of history which have not started
+  size_t nqueued;
+};
+
+job_queue JOBS;
+
+std::pair<std::string, std::string> 
+submit_callback(std::map<std::string, std::string>& varmap) {
+  std::string query;
+  for (std::map<std::string, std::string>::const_iterator iter = varmap.begin();
+       iter != varmap.end(); ++iter) {
+    if (!query.empty()) query += "&";
+    query += iter->first + "=" + iter->second;
+  }
+  const size_t id = JOBS.submit(query);
+  return std::make_pair(std::string("text/plain"),
+                        "job " + graphlab::tostr(id) + " queued\n");
+}
+
+std::pair<std::string, std::string> 
+jobs_callback(std::map<std::string, std::string>& varmap) {
+  return std::make_pair(std::string("text/plain"), JOBS.report());
+}
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_INFO);
+
+  // Parse command line options -----------------------------------------------
+  graphlab::command_line_options clopts("Graph analytics server.");
+  std::string graph_dir;
+  std::string format = "adj";
+  std::string jobs_file;
+  bool exit_when_done = false;
+  clopts.attach_option("graph", graph_dir,
+                       "The graph file. Required ");
+  clopts.add_positional("graph");
+  clopts.attach_option("format", format,
+                       "The graph file format");
+  clopts.attach_option("jobs", jobs_file,
+                       "A file of jobs to submit at startup, one query per line");
+  clopts.attach_option("exit_when_done", exit_when_done,
+                       "Exit after the jobs of --jobs instead of waiting "
+                       "for more jobs");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (graph_dir == "") {
+    dc.cout() << "Graph not specified. Cannot continue";
+    return EXIT_FAILURE;
+  }
+
+  // Build the graph ----------------------------------------------------------
+  graphlab::timer ti;
+  graph_type graph(dc, clopts);
+  dc.cout() << "Loading graph in format: "<< format << std::endl;
+  graph.load_format(graph_dir, format);
+  graph.finalize();
+  dc.cout() << "#vertices: " << graph.num_vertices()
+            << " #edges:" << graph.num_edges() 
+            << " loaded in " << ti.current_time() << " seconds" << std::endl;
+
+  // Accept jobs --------------------------------------------------------------
+  if (dc.procid() == 0) {
+    if (!jobs_file.empty()) {
+      std::ifstream fin(jobs_file.c_str());
+      std::string line;
+      while (std::getline(fin, line)) {
+        if (!line.empty() && line[0] != '#') JOBS.submit(line);
+      }
+    }
+    if (exit_when_done) JOBS.submit("program=shutdown");
+  }
+  graphlab::launch_metric_server();
+  graphlab::add_metric_server_callback("submit", submit_callback);
+  graphlab::add_metric_server_callback("jobs", jobs_callback);
+  if (!exit_when_done) {
+    dc.cout() << "Waiting for jobs. Submit program=shutdown to stop" << std::endl;
+  }
+
+  while (true) {
+    std::string query;
+    if (dc.procid() == 0) query = JOBS.next();
+    dc.broadcast(query, dc.procid() == 0);
+    const job_args args = parse_query(query);
+    if (get_arg(args, "program", "") == "shutdown") {
+      if (dc.procid() == 0) JOBS.finish("done", 0, 0);
+      break;
+    }
+    dc.cout() << "Running job: " << query << std::endl;
+    ti.start();
+    size_t updates = 0;
+    const std::string status = run_job(dc, graph, clopts, args, updates);
+    const double seconds = ti.current_time();
+    dc.cout() << "Job " << status << " in " << seconds << " seconds"
+              << std::endl;
+    if (dc.procid() == 0) JOBS.finish(status, seconds, updates);
+  }
+
+  graphlab::stop_metric_server();
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+} // End of main
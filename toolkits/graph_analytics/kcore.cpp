@@ -200,6 +200,190 @@ struct save_core_at_k {
   }
 };
     
+/*
+ * The coreness of every vertex in a single pass, by bucketed peeling
+ * in the style of Julienne (Dhulipala, Blelloch and Shun, 2017).
+ *
+ * Each machine keeps its master vertices in buckets by their current
+ * degree. A round peels every vertex of the lowest nonempty bucket in
+ * the whole graph, which all get coreness k, and the degrees of their
+ * remaining neighbors are decremented by the number of peeled
+ * neighbors: these decrements are summed on each machine and then
+ * at the master by one gather, so a round is a single pass over the
+ * edges of the peeled vertices. A neighbor which falls below k stays
+ * in the bucket of k and is peeled with k in the next round.
+ *
+ * With epsilon > 0 the buckets span degrees [(1+epsilon)^i,
+ * (1+epsilon)^(i+1)) and a vertex gets the lower end of the range
+ * it is peeled in. This takes far fewer rounds, at the cost of an
+ * approximate coreness.
+ *
+ * The vertex data holds the current degree on every copy, and the
+ * coreness and peeling round are kept per local vertex.
+ */
+class bucket_peeling {
+ public:
+  bucket_peeling(graph_type& graph, double epsilon) : 
+      graph(graph), epsilon(epsilon), round(0), kkey(0), kvalue(0) { }
+
+  /// Runs the peeling and returns the number of rounds
+  size_t run() {
+    graph.transform_vertices(initialize_vertex_values);
+    core.assign(graph.num_local_vertices(), 0);
+    peeled_round.assign(graph.num_local_vertices(), NOT_PEELED);
+    for (size_t lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+      if (graph.l_is_master(lvid)) insert(lvid);
+    }
+    graphlab::graph_gather_apply<graph_type, size_t> 
+      peel(graph, no_gather, 
+           boost::bind(&bucket_peeling::apply_peel, this, _1, _2, _3));
+    graphlab::graph_gather_apply<graph_type, size_t> 
+      decrement(graph, 
+                boost::bind(&bucket_peeling::gather_peeled, this, _1, _2),
+                boost::bind(&bucket_peeling::apply_decrement, this, _1, _2, _3));
+    while (true) {
+      min_key next(lowest_key());
+      graph.dc().all_reduce(next);
+      if (next.value == NO_KEY) break;
+      if (next.value != kkey) {
+        kkey = next.value;
+        kvalue = key_value(kkey);
+      }
+      // the lowest bucket holds only valid entries now
+      graphlab::vertex_set peeled(false);
+      peeled.make_explicit(graph);
+      if (!buckets.empty() && buckets.begin()->first == kkey) {
+        const std::vector<graphlab::lvid_type>& bucket = buckets.begin()->second;
+        for (size_t i = 0; i < bucket.size(); ++i) {
+          if (peeled_round[bucket[i]] == NOT_PEELED) 
+            peeled.set_lvid_unsync(bucket[i]);
+        }
+        buckets.erase(buckets.begin());
+      }
+      graph.sync_vertex_set_master_to_mirrors(peeled);
+      peel.exec(peeled);
+      decrement.exec(graph.neighbors(peeled, graphlab::ALL_EDGES));
+      ++round;
+    }
+    return round;
+  }
+
+  /// The coreness of a vertex on this machine
+  int coreness(const graph_type::vertex_type& vertex) const {
+    return core[vertex.local_id()];
+  }
+
+ private:
+  static const size_t NOT_PEELED = size_t(-1);
+  static const size_t NO_KEY = size_t(-1);
+
+  // the smallest key of the machines, combined by all_reduce
+  struct min_key : public graphlab::IS_POD_TYPE {
+    size_t value;
+    explicit min_key(size_t value = NO_KEY) : value(value) { }
+    min_key& operator+=(const min_key& other) {
+      value = std::min(value, other.value);
+      return *this;
+    }
+  };
+
+  graph_type& graph;
+  double epsilon;
+  // buckets of master lvids by key. Entries of peeled vertices or of
+  // vertices which have moved to a lower bucket are stale.
+  std::map<size_t, std::vector<graphlab::lvid_type> > buckets;
+  graphlab::mutex buckets_lock;
+  std::vector<int> core;
+  std::vector<size_t> peeled_round;
+  size_t round;
+  // the key being peeled and its coreness
+  size_t kkey;
+  int kvalue;
+
+  size_t key(int degree) const {
+    if (epsilon <= 0 || degree <= 0) return degree;
+    return 1 + size_t(std::log(double(degree)) / std::log(1 + epsilon));
+  }
+
+  int key_value(size_t key) const {
+    if (epsilon <= 0 || key == 0) return key;
+    return int(std::ceil(std::pow(1 + epsilon, double(key - 1)) - 1e-9));
+  }
+
+  /// The bucket of a vertex: no lower than the one being peeled
+  size_t bucket_of(graphlab::lvid_type lvid) const {
+    return std::max(key(graph.l_vertex(lvid).data()), kkey);
+  }
+
+  void insert(graphlab::lvid_type lvid) {
+    buckets[bucket_of(lvid)].push_back(lvid);
+  }
+
+  bool is_valid(size_t bucket, graphlab::lvid_type lvid) const {
+    return peeled_round[lvid] == NOT_PEELED && bucket_of(lvid) == bucket;
+  }
+
+  /// Drops the stale entries of the lowest buckets and returns their key
+  size_t lowest_key() {
+    while (!buckets.empty()) {
+      std::vector<graphlab::lvid_type>& bucket = buckets.begin()->second;
+      size_t nvalid = 0;
+      for (size_t i = 0; i < bucket.size(); ++i) {
+        if (is_valid(buckets.begin()->first, bucket[i])) 
+          bucket[nvalid++] = bucket[i];
+      }
+      bucket.resize(nvalid);
+      if (nvalid > 0) return buckets.begin()->first;
+      buckets.erase(buckets.begin());
+    }
+    return NO_KEY;
+  }
+
+  static size_t no_gather(graphlab::lvid_type lvid, graph_type& graph) {
+    return 0;
+  }
+
+  void apply_peel(graphlab::lvid_type lvid, const size_t& unused, 
+                  graph_type& graph) {
+    core[lvid] = kvalue;
+    peeled_round[lvid] = round;
+  }
+
+  /// The number of neighbors of this copy peeled in this round
+  size_t gather_peeled(graphlab::lvid_type lvid, graph_type& graph) {
+    if (peeled_round[lvid] != NOT_PEELED) return 0;
+    size_t count = 0;
+    graph_type::local_vertex_type vtx = graph.l_vertex(lvid);
+    foreach(graph_type::local_edge_type edge, vtx.in_edges()) 
+      count += (peeled_round[edge.source().id()] == round);
+    foreach(graph_type::local_edge_type edge, vtx.out_edges()) 
+      count += (peeled_round[edge.target().id()] == round);
+    return count;
+  }
+
+  void apply_decrement(graphlab::lvid_type lvid, const size_t& count,
+                       graph_type& graph) {
+    if (peeled_round[lvid] != NOT_PEELED || count == 0) return;
+    int& degree = graph.l_vertex(lvid).data();
+    degree = std::max(degree - int(count), 0);
+    if (graph.l_is_master(lvid)) {
+      buckets_lock.lock();
+      insert(lvid);
+      buckets_lock.unlock();
+    }
+  }
+}; // end of bucket_peeling
+
+struct save_coreness {
+  const bucket_peeling& peeling;
+  save_coreness(const bucket_peeling& peeling) : peeling(peeling) { }
+  std::string save_vertex(graph_type::vertex_type v) {
+    return graphlab::tostr(v.id()) + "\t" + 
+        graphlab::tostr(peeling.coreness(v)) + "\n";
+  }
+  std::string save_edge(graph_type::edge_type e) { return ""; }
+};
+    
 int main(int argc, char** argv) {
   std::cout << "Computes a k-core decomposition of a graph.\n\n";
 
@@ -223,6 +407,19 @@ int main(int argc, char** argv) {
                        "Compute the k-Core for k the range [kmin,kmax]");
   clopts.attach_option("savecores", savecores,
                        "If non-empty, will save tsv of each core with prefix [savecores].K.");
+  bool bucketed = false;
+  double epsilon = 0;
+  std::string savecoreness;
+  clopts.attach_option("bucketed", bucketed,
+                       "If set, computes the coreness of every vertex in a "
+                       "single bucketed peeling pass instead of one engine "
+                       "run per K. kmin, kmax and savecores are ignored.");
+  clopts.attach_option("epsilon", epsilon,
+                       "With bucketed, peels degrees in buckets of ratio "
+                       "(1+epsilon) for an approximate coreness in fewer rounds.");
+  clopts.attach_option("savecoreness", savecoreness,
+                       "With bucketed, if non-empty, will save the coreness of "
+                       "each vertex with prefix [savecoreness].");
 
   if(!clopts.parse(argc, argv)) return EXIT_FAILURE;
   if (prefix == "") {
@@ -252,6 +449,22 @@ int main(int argc, char** argv) {
 
   graphlab::timer ti;
 
+  if (bucketed) {
+    bucket_peeling peeling(graph, epsilon);
+    const size_t rounds = peeling.run();
+    dc.cout() << "Peeled in " << rounds << " rounds and " 
+              << ti.current_time() << " seconds" << std::endl;
+    if (savecoreness != "") {
+      graph.save(savecoreness, save_coreness(peeling),
+                 false, /* no compression */ 
+                 true, /* save vertex */
+                 false, /* do not save edge */ 
+                 clopts.get_ncpus()); /* one file per machine */
+    }
+    graphlab::mpi_tools::finalize();
+    return EXIT_SUCCESS;
+  }
+
   graphlab::synchronous_engine<k_core> engine(dc, graph, clopts);
 
   // initialize the vertex data with the degree
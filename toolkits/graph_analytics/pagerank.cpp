@@ -51,6 +51,54 @@ typedef graphlab::distributed_graph<vertex_data_type, edge_data_type> graph_type
  */
 void init_vertex(graph_type::vertex_type& vertex) { vertex.data() = 1; }
 
+/*
+ * Ranks are at least RESET_PROB, so a zero rank marks a vertex which
+ * was not seeded from --initial_ranks or was added by --new_edges.
+ */
+void init_unranked_vertex(graph_type::vertex_type& vertex) {
+  if (vertex.data() == 0) vertex.data() = 1;
+}
+
+/*
+ * Parses the "id<tab>rank" lines written by pagerank_writer.
+ */
+bool rank_parser(graph_type& graph, const std::string& filename,
+                 const std::string& line) {
+  if (line.empty()) return true;
+  std::stringstream strm(line);
+  graphlab::vertex_id_type vid;
+  double rank;
+  strm >> vid >> rank;
+  if (strm.fail()) return false;
+  graph.add_vertex(vid, rank);
+  return true;
+}
+
+/*
+ * The out degree of each local vertex before the new edges were
+ * added. Existing vertices keep their local ids across
+ * load_incremental() so this is indexed by local id.
+ */
+std::vector<size_t> prev_out_degree;
+
+void record_out_degrees(graph_type& graph) {
+  prev_out_degree.resize(graph.num_local_vertices());
+  for (size_t lvid = 0; lvid < prev_out_degree.size(); ++lvid) {
+    prev_out_degree[lvid] = 
+        graph_type::vertex_type(graph.l_vertex(lvid)).num_out_edges();
+  }
+}
+
+/*
+ * The vertices whose contribution to their out neighbors changed:
+ * new vertices and vertices which gained out edges.
+ */
+bool out_degree_changed(const graph_type::vertex_type& vertex) {
+  const size_t lvid = vertex.local_id();
+  return lvid >= prev_out_degree.size() || 
+      prev_out_degree[lvid] != vertex.num_out_edges();
+}
+
 
 
 /*
@@ -94,6 +142,26 @@ public:
     return (edge.source().data() / edge.source().num_out_edges());
   }
 
+  /* Gather all the in edges at once. Four partial sums keep the
+   * reduction free of loop carried dependencies. */
+  bool gather_batch(icontext_type& context, const vertex_type& vertex,
+                    const local_edge_span_type& edges, double& total) const {
+    double sum[4] = {0, 0, 0, 0};
+    const size_t n = edges.size();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      for (size_t j = 0; j < 4; ++j) {
+        sum[j] += edges.neighbor_data(i + j) /
+            edges.neighbor(i + j).num_out_edges();
+      }
+    }
+    for (; i < n; ++i) {
+      sum[0] += edges.neighbor_data(i) / edges.neighbor(i).num_out_edges();
+    }
+    total = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    return true;
+  }
+
   /* Use the total rank of adjacent pages to update this page */
   void apply(icontext_type& context, vertex_type& vertex,
              const gather_type& total) {
@@ -104,6 +172,12 @@ public:
     if (ITERATIONS) context.signal(vertex);
   }
 
+  /* Lets the sync_tolerance engine option skip the small rank changes */
+  double vertex_data_distance(const vertex_data_type& old_data,
+                              const vertex_data_type& new_data) const {
+    return std::fabs(new_data - old_data);
+  }
+
   /* The scatter edges depend on whether the pagerank has converged */
   edge_dir_type scatter_edges(icontext_type& context,
                               const vertex_type& vertex) const {
@@ -122,7 +196,9 @@ public:
   void scatter(icontext_type& context, const vertex_type& vertex,
                edge_type& edge) const {
     if(USE_DELTA_CACHE) {
-      context.post_delta(edge.target(), last_change);
+      // the cached gather sums rank / out degree
+      context.post_delta(edge.target(), 
+                         last_change / vertex.num_out_edges());
     }
 
     if(last_change > TOLERANCE || last_change < -TOLERANCE) {
@@ -145,6 +221,16 @@ public:
 
 }; // end of factorized_pagerank update functor
 
+// pagerank always gathers on its in edges
+namespace graphlab {
+  template<> struct static_edge_directions<pagerank> {
+    static const bool gather_is_static = true;
+    static const edge_dir_type gather = IN_EDGES;
+    static const bool scatter_is_static = false;
+    static const edge_dir_type scatter = ALL_EDGES;
+  };
+}
+
 
 /*
  * We want to save the final graph so we define a write which will be
@@ -160,6 +246,25 @@ struct pagerank_writer {
 }; // end of pagerank writer
 
 
+/*
+ * Writes the ranks as an id column and a rank column with
+ * graph.save_columns(), without formatting any text.
+ */
+struct pagerank_column_writer {
+  void vertex_columns(graphlab::column_schema& schema) const {
+    schema.add<graphlab::vertex_id_type>("id");
+    schema.add<double>("rank");
+  }
+  void save_vertex(const graph_type::vertex_type& v,
+                   graphlab::column_row& row) const {
+    row << v.id() << v.data();
+  }
+  void edge_columns(graphlab::column_schema& schema) const { }
+  void save_edge(const graph_type::edge_type& e,
+                 graphlab::column_row& row) const { }
+}; // end of pagerank column writer
+
+
 double map_rank(const graph_type::vertex_type& v) { return v.data(); }
 
 
@@ -203,11 +308,31 @@ int main(int argc, char** argv) {
   clopts.attach_option("saveprefix", saveprefix,
                        "If set, will save the resultant pagerank to a "
                        "sequence of files with prefix saveprefix");
+  bool save_columnar = false;
+  clopts.attach_option("save_columnar", save_columnar,
+                       "If set, --saveprefix writes id and rank columns "
+                       "as columnar files instead of text.");
+  std::string initial_ranks;
+  clopts.attach_option("initial_ranks", initial_ranks,
+                       "If set, seeds the ranks from the files written by "
+                       "a previous run with --saveprefix=initial_ranks. "
+                       "Vertices without a rank start from 1.");
+  std::string new_edges;
+  clopts.attach_option("new_edges", new_edges,
+                       "If set, once the ranks have converged the edges in "
+                       "these files (in --format) are added to the graph and "
+                       "only the vertices whose in-contributions changed are "
+                       "rescheduled. Requires the dynamic local graph.");
 
   if(!clopts.parse(argc, argv)) {
     dc.cout() << "Error in parsing command line arguments." << std::endl;
     return EXIT_FAILURE;
   }
+  if (new_edges != "" && ITERATIONS) {
+    dc.cout() << "--new_edges requires the dynamic computation and cannot "
+              << "be combined with --iterations." << std::endl;
+    return EXIT_FAILURE;
+  }
 
 
   // Enable gather caching in the engine
@@ -237,13 +362,18 @@ int main(int argc, char** argv) {
     clopts.print_description();
     return 0;
   }
+  if (initial_ranks != "") {
+    dc.cout() << "Loading initial ranks." << std::endl;
+    graph.load(initial_ranks, rank_parser);
+  }
   // must call finalize before querying the graph
   graph.finalize();
   dc.cout() << "#vertices: " << graph.num_vertices()
             << " #edges:" << graph.num_edges() << std::endl;
 
   // Initialize the vertex data
-  graph.transform_vertices(init_vertex);
+  if (initial_ranks != "") graph.transform_vertices(init_unranked_vertex);
+  else graph.transform_vertices(init_vertex);
 
   // Running The Engine -------------------------------------------------------
   graphlab::omni_engine<pagerank> engine(dc, graph, exec_type, clopts);
@@ -253,12 +383,35 @@ int main(int argc, char** argv) {
   dc.cout() << "Finished Running engine in " << runtime
             << " seconds." << std::endl;
 
+  if (new_edges != "") {
+    // Only the targets of the vertices whose out degree changed see a
+    // different gather. They resume from the converged ranks and the
+    // dynamic scatter carries the changes on from there.
+    record_out_degrees(graph);
+    graph.load_incremental(new_edges, format);
+    graph.transform_vertices(init_unranked_vertex);
+    graphlab::vertex_set changed = graph.select(out_degree_changed);
+    graphlab::vertex_set frontier = graph.neighbors(changed, 
+                                                    graphlab::OUT_EDGES);
+    frontier |= changed;
+    const size_t nscheduled = graph.vertex_set_size(frontier);
+    engine.signal_vset(frontier);
+    engine.start();
+    dc.cout() << "Incremental update scheduled " << nscheduled << " of " 
+              << graph.num_vertices() << " vertices and finished in " 
+              << engine.elapsed_seconds() << " seconds." << std::endl;
+  }
+
 
   const double total_rank = graph.map_reduce_vertices<double>(map_rank);
   std::cout << "Total rank: " << total_rank << std::endl;
 
   // Save the final graph -----------------------------------------------------
-  if (saveprefix != "") {
+  if (saveprefix != "" && save_columnar) {
+    graph.save_columns(saveprefix, pagerank_column_writer(),
+                       true,     // save vertices
+                       false);   // do not save edges
+  } else if (saveprefix != "") {
     graph.save(saveprefix, pagerank_writer(),
                false,    // do not gzip
                true,     // save vertices
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#include <graphlab.hpp>
+
+/**
+ * Partitions a graph once and writes one binedge shard per machine.
+ *
+ * Run this with the same number of machines as the jobs which will use
+ * the shards. Those jobs load them with
+ *   --graph_opts="ingress=precomputed"
+ *   graph.load_format([saveprefix], "binedge")
+ * which puts every shard on the machine which wrote it, so the edges
+ * are never exchanged again.
+ */
+int main(int argc, char** argv) {
+  // Initialize control plain using mpi
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_INFO);
+
+  std::string ingraph, informat = "adj";
+  std::string saveprefix;
+  bool gzip = false;
+  // Parse command line options -----------------------------------------------
+  graphlab::command_line_options clopts("Precompute a graph partition.", true);
+  clopts.attach_option("graph", ingraph,
+                       "The input graph file. Required ");
+  clopts.attach_option("format", informat,
+                       "The input graph file format");
+  clopts.attach_option("saveprefix", saveprefix,
+                       "The prefix of the shards. Machine k of N writes "
+                       "[saveprefix]_k_of_N. Required ");
+  clopts.attach_option("outgzip", gzip,
+                       "If the shards are to be gzip compressed");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (ingraph.length() == 0 || saveprefix.length() == 0) {
+    clopts.print_description();
+    return EXIT_FAILURE;
+  }
+  // partition quality matters more than ingress speed here
+  std::string ingress;
+  if (!clopts.get_graph_args().get_option("ingress", ingress)) {
+    clopts.get_graph_args().set_option("ingress", "hdrf");
+  }
+
+  typedef graphlab::distributed_graph<graphlab::empty, graphlab::empty> graph_type;
+  graph_type graph(dc, clopts);
+
+  graphlab::timer timer;
+  timer.start();
+  dc.cout() << "Loading graph in format: "<< informat << std::endl;
+  graph.load_format(ingraph, informat);
+  graph.finalize();
+  dc.cout() << "#vertices: " << graph.num_vertices()
+            << " #edges:" << graph.num_edges()
+            << " replication factor: "
+            << double(graph.num_replicas()) / graph.num_vertices()
+            << std::endl
+            << "Partitioned in " << timer.current_time() << " seconds"
+            << std::endl;
+
+  graph.save_format(saveprefix, "binedge", gzip);
+
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+} // End of main
@@ -0,0 +1,129 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <string>
+#include <sstream>
+
+#include <graphlab.hpp>
+#include <graphlab/engine/random_walk_engine.hpp>
+
+/**
+ * \brief The weight of the edge. Only used with --weighted.
+ */
+typedef graphlab::distributed_graph<graphlab::empty, float> graph_type;
+
+typedef graphlab::random_walk_engine<graph_type> engine_type;
+
+
+// [source] [target] [weight]
+bool weighted_parser(graph_type& graph, const std::string& filename,
+                     const std::string& textline) {
+  if (textline.empty() || textline[0] == '#') return true;
+  std::stringstream strm(textline);
+  graphlab::vertex_id_type source = 0, target = 0;
+  float weight = 1;
+  strm >> source >> target;
+  if (strm.fail()) return false;
+  strm >> weight;
+  if (source != target) graph.add_edge(source, target, weight);
+  return true;
+}
+
+double edge_weight(const graph_type::edge_type& edge) {
+  return edge.data();
+}
+
+
+int main(int argc, char** argv) {
+  // Initialize control plain using mpi
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_INFO);
+
+  // Parse command line options -----------------------------------------------
+  graphlab::command_line_options
+    clopts("Runs random walks (uniform, weighted, with restart or node2vec) "
+           "from every vertex and saves them.");
+  std::string graph_dir;
+  std::string format = "snap";
+  bool weighted = false;
+  size_t walk_length = 80;
+  size_t walks_per_vertex = 10;
+  double p = 1, q = 1, restart = 0;
+  bool directed = false;
+  std::string saveprefix;
+  clopts.attach_option("graph", graph_dir,
+                       "The graph file. Required ");
+  clopts.add_positional("graph");
+  clopts.attach_option("format", format,
+                       "The graph file format");
+  clopts.attach_option("weighted", weighted,
+                       "Read the graph as [source] [target] [weight] lines "
+                       "and draw the steps proportionally to the weights. "
+                       "The format option is then ignored.");
+  clopts.attach_option("walk_length", walk_length,
+                       "The maximum number of vertices of a walk");
+  clopts.attach_option("walks_per_vertex", walks_per_vertex,
+                       "The number of walks starting from every vertex");
+  clopts.attach_option("p", p, "The node2vec return parameter");
+  clopts.attach_option("q", q, "The node2vec in-out parameter");
+  clopts.attach_option("restart", restart,
+                       "The probability to end a walk before each step");
+  clopts.attach_option("directed", directed,
+                       "Walk along the edge directions only");
+  clopts.attach_option("saveprefix", saveprefix,
+                       "The walks are saved to files with this prefix. Required");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (graph_dir.empty() || saveprefix.empty()) {
+    dc.cout() << "graph and saveprefix must be specified" << std::endl;
+    clopts.print_description();
+    return EXIT_FAILURE;
+  }
+  clopts.get_engine_args().set_option("walk_length", walk_length);
+  clopts.get_engine_args().set_option("walks_per_vertex", walks_per_vertex);
+  clopts.get_engine_args().set_option("p", p);
+  clopts.get_engine_args().set_option("q", q);
+  clopts.get_engine_args().set_option("restart", restart);
+  clopts.get_engine_args().set_option("directed", directed);
+
+  // Build the graph ----------------------------------------------------------
+  graph_type graph(dc, clopts);
+  dc.cout() << "Loading graph." << std::endl;
+  if (weighted) graph.load(graph_dir, weighted_parser);
+  else graph.load_format(graph_dir, format);
+  graph.finalize();
+  dc.cout() << "#vertices: " << graph.num_vertices()
+            << " #edges:" << graph.num_edges() << std::endl;
+
+  // Running The Engine -------------------------------------------------------
+  engine_type engine(dc, graph, clopts);
+  if (weighted) engine.build_tables(edge_weight);
+  else engine.build_tables();
+  const size_t visits = engine.run(saveprefix);
+  dc.cout() << "Visits written: " << visits << std::endl;
+
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+} // End of main
@@ -23,12 +23,16 @@
 
 #include <boost/unordered_set.hpp>
 #include <graphlab.hpp>
+#include <graphlab/util/integer_mix.hpp>
 #include <graphlab/ui/metrics_server.hpp>
 #include <graphlab/macros_def.hpp>
 
 
 typedef graphlab::vertex_id_type color_type;
 
+/// The color of a vertex not colored yet by the speculative coloring
+const color_type UNCOLORED = color_type(-1);
+
 /*
  * no edge data
  */
@@ -37,37 +41,55 @@ bool EDGE_CONSISTENT = false;
 
 std::set<int> used_colors;
 /*
- * This is the gathering type which accumulates an (unordered) set of
- * all neighboring colors 
- * It is a simple wrapper around a boost::unordered_set with
- * an operator+= which simply performs a set union.
+ * This is the gathering type which accumulates the set of all
+ * neighboring colors: the forbidden colors of the vertex.
  *
- * This struct can be significantly accelerated for small sets.
- * Small collections of vertex IDs should not require the overhead
- * of the unordered_set.
+ * Since a greedy coloring keeps the colors small, the set is a bitset
+ * of words which grows to the largest color seen, and operator+= is
+ * a word-wise OR. This avoids the hashing and allocation of a set
+ * insert per edge.
  */
-struct set_union_gather {
-  boost::unordered_set<color_type> colors;
+struct forbidden_colors_gather {
+  std::vector<size_t> words;
+
+  static const size_t WORD_BITS = 8 * sizeof(size_t);
+
+  void insert(color_type color) {
+    if (color == UNCOLORED) return;
+    const size_t word = color / WORD_BITS;
+    if (word >= words.size()) words.resize(word + 1, 0);
+    words[word] |= size_t(1) << (color % WORD_BITS);
+  }
+
+  /// Returns the smallest color not in the set
+  color_type first_free() const {
+    for (size_t i = 0; i < words.size(); ++i) {
+      if (~words[i] == 0) continue;
+      size_t bit = 0;
+      while (words[i] & (size_t(1) << bit)) ++bit;
+      return color_type(i * WORD_BITS + bit);
+    }
+    return color_type(words.size() * WORD_BITS);
+  }
 
   /*
-   * Combining with another collection of vertices.
+   * Combining with another collection of colors.
    * Union it into the current set.
    */
-  set_union_gather& operator+=(const set_union_gather& other) {
-    foreach(graphlab::vertex_id_type othervid, other.colors) {
-      colors.insert(othervid);
-    }
+  forbidden_colors_gather& operator+=(const forbidden_colors_gather& other) {
+    if (other.words.size() > words.size()) words.resize(other.words.size(), 0);
+    for (size_t i = 0; i < other.words.size(); ++i) words[i] |= other.words[i];
     return *this;
   }
   
   // serialize
   void save(graphlab::oarchive& oarc) const {
-    oarc << colors;
+    oarc << words;
   }
 
   // deserialize
   void load(graphlab::iarchive& iarc) {
-    iarc >> colors;
+    iarc >> words;
   }
 };
 
@@ -83,7 +105,7 @@ typedef graphlab::distributed_graph<color_type,
  */
 class graph_coloring:
       public graphlab::ivertex_program<graph_type,
-                                      set_union_gather>,
+                                      forbidden_colors_gather>,
       /* I have no data. Just force it to POD */
       public graphlab::IS_POD_TYPE  {
 public:
@@ -100,12 +122,12 @@ public:
   gather_type gather(icontext_type& context,
                      const vertex_type& vertex,
                      edge_type& edge) const {
-    set_union_gather gather;
+    forbidden_colors_gather gather;
     color_type other_color = edge.source().id() == vertex.id() ?
                                  edge.target().data(): edge.source().data();
     // vertex_id_type otherid= edge.source().id() == vertex.id() ?
     //                              edge.target().id(): edge.source().id();
-     gather.colors.insert(other_color);
+    gather.insert(other_color);
     return gather;
   }
 
@@ -116,14 +138,9 @@ public:
   void apply(icontext_type& context, vertex_type& vertex,
              const gather_type& neighborhood) {
     // find the smallest color not described in the neighborhood
-    size_t neighborhoodsize = neighborhood.colors.size();
-    for (color_type curcolor = 0; curcolor < neighborhoodsize + 1; ++curcolor) {
-      if (neighborhood.colors.count(curcolor) == 0) {
-        used_colors.insert(curcolor);
-        vertex.data() = curcolor;
-        break;
-      }
-    }
+    color_type curcolor = neighborhood.first_free();
+    used_colors.insert(curcolor);
+    vertex.data() = curcolor;
   }
 
 
@@ -153,6 +170,88 @@ public:
 
 
 
+/*
+ * Speculative coloring on the synchronous engine, after Gebremedhin and
+ * Manne and Jones and Plassmann: no locks are taken, every signaled
+ * vertex takes the smallest color not used by its neighbors at the
+ * start of the superstep, and neighbors which picked the same color in
+ * the same superstep are detected in the scatter. Of each conflicting
+ * pair only the vertex of lower priority is recolored in the next
+ * superstep, so the vertex of highest priority in a conflict always
+ * keeps its color and the coloring converges.
+ *
+ * The vertex data must be initialized to UNCOLORED.
+ */
+class speculative_coloring:
+      public graphlab::ivertex_program<graph_type,
+                                      forbidden_colors_gather>,
+      public graphlab::IS_POD_TYPE  {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  } 
+
+  gather_type gather(icontext_type& context,
+                     const vertex_type& vertex,
+                     edge_type& edge) const {
+    forbidden_colors_gather gather;
+    gather.insert(edge.source().id() == vertex.id() ?
+                      edge.target().data(): edge.source().data());
+    return gather;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& neighborhood) {
+    vertex.data() = neighborhood.first_free();
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  } 
+
+  /*
+   * Only neighbors which were also recolored in this superstep can
+   * conflict. Signal the loser of the conflict.
+   */
+  void scatter(icontext_type& context,
+              const vertex_type& vertex,
+              edge_type& edge) const {
+    if (edge.source().data() == edge.target().data()) {
+      context.signal(has_priority(edge.source().id(), edge.target().id()) ?
+                     edge.target() : edge.source());
+    }
+  }
+
+  /// A random but fixed order on the vertices, so hubs do not always win
+  static bool has_priority(graphlab::vertex_id_type a, 
+                           graphlab::vertex_id_type b) {
+    const uint32_t ha = graphlab::integer_mix(a), hb = graphlab::integer_mix(b);
+    return ha > hb || (ha == hb && a > b);
+  }
+};
+
+void set_uncolored(graph_type::vertex_type& vertex) {
+  vertex.data() = UNCOLORED;
+}
+
+/*
+ * The largest color of the graph, combined by map_reduce_vertices
+ */
+struct max_color : public graphlab::IS_POD_TYPE {
+  color_type value;
+  max_color(color_type value = 0) : value(value) { }
+  max_color& operator+=(const max_color& other) {
+    value = std::max(value, other.value);
+    return *this;
+  }
+};
+
+max_color get_color(const graph_type::vertex_type& vertex) {
+  return max_color(vertex.data());
+}
+
 /*
  * A saver which saves a file where each line is a vid / color pair
  */
@@ -208,6 +307,10 @@ int main(int argc, char** argv) {
                        "Alpha in powerlaw distrubution");
   clopts.attach_option("edgescope", EDGE_CONSISTENT,
                        "Use Locking. ");
+  bool speculative = false;
+  clopts.attach_option("speculative", speculative,
+                       "Color speculatively without locks on the synchronous "
+                       "engine, recoloring only the losers of conflicts.");
     
   if(!clopts.parse(argc, argv)) return EXIT_FAILURE;
   if (prefix.length() == 0 && powerlaw == 0) {
@@ -246,18 +349,29 @@ int main(int argc, char** argv) {
   
   // create engine to count the number of triangles
   dc.cout() << "Coloring..." << std::endl;
-  if (EDGE_CONSISTENT) {
-    clopts.get_engine_args().set_option("factorized", false);
+  if (speculative) {
+    graph.transform_vertices(set_uncolored);
+    graphlab::synchronous_engine<speculative_coloring> engine(dc, graph, clopts);
+    engine.signal_all();
+    engine.start();
+    dc.cout() << "Colored in " << ti.current_time() << " seconds and " 
+              << engine.num_updates() << " updates" << std::endl;
+    dc.cout() << "Colored using " 
+              << graph.map_reduce_vertices<max_color>(get_color).value + 1 
+              << " colors" << std::endl;
   } else {
-    clopts.get_engine_args().set_option("factorized", true);
-  } 
-  graphlab::async_consistent_engine<graph_coloring> engine(dc, graph, clopts);
-  engine.signal_all();
-  engine.start();
-
-
-  dc.cout() << "Colored in " << ti.current_time() << " seconds" << std::endl;
-  dc.cout() << "Colored using " << used_colors.size() << " colors" << std::endl;
+    if (EDGE_CONSISTENT) {
+      clopts.get_engine_args().set_option("factorized", false);
+    } else {
+      clopts.get_engine_args().set_option("factorized", true);
+    } 
+    graphlab::async_consistent_engine<graph_coloring> engine(dc, graph, clopts);
+    engine.signal_all();
+    engine.start();
+
+    dc.cout() << "Colored in " << ti.current_time() << " seconds" << std::endl;
+    dc.cout() << "Colored using " << used_colors.size() << " colors" << std::endl;
+  }
 		  
   size_t conflict_count = graph.map_reduce_edges<size_t>(validate_conflict);
   dc.cout() << "Num conflicts = " << conflict_count << "\n";
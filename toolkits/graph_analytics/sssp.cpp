@@ -87,6 +87,8 @@ struct min_distance_type : graphlab::IS_POD_TYPE {
     dist = std::min(dist, other.dist);
     return *this;
   }
+  /// nearer vertices first, for the priority and delta_bucket schedulers
+  double priority() const { return -double(dist); }
 };
 
 
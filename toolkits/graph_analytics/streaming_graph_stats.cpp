@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include <graphlab.hpp>
+#include <graphlab/graph/sorted_intersection.hpp>
+#include <graphlab/util/stl_util.hpp>
+#include <graphlab/macros_def.hpp>
+
+/**
+ * Maintains the degree, the local triangle count and the connected
+ * component of every vertex of an undirected graph while batches of
+ * edges are inserted, and reports the global statistics after every
+ * batch.
+ *
+ * Each vertex keeps its sorted neighbor set and the degree it had when
+ * the set was built, and each edge keeps the number of triangles it is
+ * in, as in undirected_triangle_count. After load_incremental() adds a
+ * batch, only the delta is recomputed:
+ *   - the vertices whose degree changed (the touched vertices) rebuild
+ *     their neighbor sets;
+ *   - the edges with a touched endpoint recount their triangles, by
+ *     intersecting the neighbor sets of their endpoints. The count of
+ *     any other edge cannot change, since its endpoints kept their
+ *     neighbors;
+ *   - the touched vertices and their neighbors sum the counts of their
+ *     edges again, every triangle of a vertex being counted by two of
+ *     its edges;
+ *   - the touched vertices push their component label to their
+ *     neighbors and the smallest labels spread from there. Inserting
+ *     edges only merges components, so no other label changes.
+ *
+ * Like undirected_triangle_count, every undirected edge must appear
+ * once in the input.
+ */
+
+/*
+ * The statistics of a vertex and its neighbor set.
+ */
+struct vertex_data_type {
+  // the sorted ids of the neighbors
+  std::vector<graphlab::vertex_id_type> nbrs;
+  // the degree when nbrs was built
+  uint32_t degree;
+  // the number of triangles the vertex is in
+  uint32_t num_triangles;
+  // the smallest vertex id of the component
+  uint64_t component;
+  // the last batch in which the degree changed
+  uint32_t touched_batch;
+  vertex_data_type() : degree(0), num_triangles(0),
+      component(std::numeric_limits<uint64_t>::max()), touched_batch(0) { }
+  void save(graphlab::oarchive& oarc) const {
+    oarc << nbrs << degree << num_triangles << component << touched_batch;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> nbrs >> degree >> num_triangles >> component >> touched_batch;
+  }
+};
+
+/*
+ * Each edge is the number of triangles it is in
+ */
+typedef uint32_t edge_data_type;
+
+typedef graphlab::distributed_graph<vertex_data_type,
+                                    edge_data_type> graph_type;
+
+// The batch being processed. The initial graph is batch 1.
+uint32_t BATCH = 0;
+
+/*
+ * New vertices, and vertices whose degree changed in this batch.
+ */
+bool degree_changed(const graph_type::vertex_type& vertex) {
+  return vertex.data().degree != vertex.num_in_edges() + vertex.num_out_edges()
+      || vertex.data().component == std::numeric_limits<uint64_t>::max();
+}
+
+bool is_touched(const graph_type::vertex_type& vertex) {
+  return vertex.data().touched_batch == BATCH;
+}
+
+/*
+ * Accumulates the ids of the neighbors of a vertex.
+ */
+struct vid_list {
+  std::vector<graphlab::vertex_id_type> vids;
+  vid_list& operator+=(const vid_list& other) {
+    vids.insert(vids.end(), other.vids.begin(), other.vids.end());
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << vids; }
+  void load(graphlab::iarchive& iarc) { iarc >> vids; }
+};
+
+/*
+ * Rebuilds the neighbor set of a touched vertex.
+ */
+class neighborhood_update :
+      public graphlab::ivertex_program<graph_type, vid_list>,
+      public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+
+  gather_type gather(icontext_type& context, const vertex_type& vertex,
+                     edge_type& edge) const {
+    vid_list ret;
+    ret.vids.push_back(edge.source().id() == vertex.id() ?
+                       edge.target().id() : edge.source().id());
+    return ret;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& neighbors) {
+    vertex_data_type& vdata = vertex.data();
+    vdata.nbrs = neighbors.vids;
+    std::sort(vdata.nbrs.begin(), vdata.nbrs.end());
+    vdata.nbrs.erase(std::unique(vdata.nbrs.begin(), vdata.nbrs.end()),
+                     vdata.nbrs.end());
+    vdata.degree = vertex.num_in_edges() + vertex.num_out_edges();
+    vdata.touched_batch = BATCH;
+    if (vdata.component == std::numeric_limits<uint64_t>::max()) {
+      vdata.component = vertex.id();
+    }
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+};
+
+/*
+ * Recounts the triangles of the edges of a touched vertex. An edge
+ * between two touched vertices is recounted by its source only.
+ */
+class edge_recount :
+      public graphlab::ivertex_program<graph_type, graphlab::empty>,
+      public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) { }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const bool is_source = edge.source().id() == vertex.id();
+    const vertex_type other = is_source ? edge.target() : edge.source();
+    if (!is_source && is_touched(other)) return;
+    edge.data() = graphlab::graph_ops::sorted_intersection_size(
+        edge.source().data().nbrs, edge.target().data().nbrs);
+  }
+};
+
+/*
+ * Sums the triangle counts of the edges of a vertex. Every triangle of
+ * the vertex is counted by two of its edges.
+ */
+class vertex_recount :
+      public graphlab::ivertex_program<graph_type, size_t>,
+      public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+
+  size_t gather(icontext_type& context, const vertex_type& vertex,
+                edge_type& edge) const {
+    return edge.data();
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    vertex.data().num_triangles = total / 2;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+};
+
+// message where summation means minimum
+struct min_message {
+  uint64_t value;
+  explicit min_message(uint64_t v) : value(v) { }
+  min_message() : value(std::numeric_limits<uint64_t>::max()) { }
+  min_message& operator+=(const min_message& other) {
+    value = std::min<uint64_t>(value, other.value);
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << value; }
+  void load(graphlab::iarchive& iarc) { iarc >> value; }
+};
+
+/*
+ * Spreads the smallest component labels from the touched vertices, as
+ * in the label propagation of connected_component. A vertex signaled
+ * without a message pushes its label to its neighbors.
+ */
+class component_update :
+      public graphlab::ivertex_program<graph_type, graphlab::empty, min_message>,
+      public graphlab::IS_POD_TYPE {
+  uint64_t received_label;
+  bool perform_scatter;
+public:
+  component_update() :
+      received_label(std::numeric_limits<uint64_t>::max()),
+      perform_scatter(false) { }
+
+  void init(icontext_type& context, const vertex_type& vertex,
+            const message_type& msg) {
+    received_label = msg.value;
+  }
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    if (received_label == std::numeric_limits<uint64_t>::max()) {
+      perform_scatter = true;
+    } else if (vertex.data().component > received_label) {
+      perform_scatter = true;
+      vertex.data().component = received_label;
+    } else {
+      perform_scatter = false;
+    }
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return perform_scatter ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = edge.source().id() == vertex.id() ?
+        edge.target() : edge.source();
+    if (other.data().component > vertex.data().component) {
+      context.signal(other, min_message(vertex.data().component));
+    }
+  }
+};
+
+/*
+ * The global statistics, summed over the vertices.
+ */
+struct graph_stats {
+  size_t num_triangles, num_components, max_degree, num_touched;
+  graph_stats() :
+      num_triangles(0), num_components(0), max_degree(0), num_touched(0) { }
+  graph_stats& operator+=(const graph_stats& other) {
+    num_triangles += other.num_triangles;
+    num_components += other.num_components;
+    max_degree = std::max(max_degree, other.max_degree);
+    num_touched += other.num_touched;
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const {
+    oarc << num_triangles << num_components << max_degree << num_touched;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> num_triangles >> num_components >> max_degree >> num_touched;
+  }
+};
+
+graph_stats vertex_stats(const graph_type::vertex_type& vertex) {
+  graph_stats stats;
+  stats.num_triangles = vertex.data().num_triangles;
+  stats.num_components = vertex.data().component == vertex.id();
+  stats.max_degree = vertex.data().degree;
+  stats.num_touched = is_touched(vertex);
+  return stats;
+}
+
+/*
+ * Writes "id<tab>degree<tab>triangles<tab>component" lines.
+ */
+struct stats_writer {
+  std::string save_vertex(graph_type::vertex_type v) {
+    std::stringstream strm;
+    strm << v.id() << "\t" << v.data().degree << "\t"
+         << v.data().num_triangles << "\t" << v.data().component << "\n";
+    return strm.str();
+  }
+  std::string save_edge(graph_type::edge_type e) { return ""; }
+};
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_INFO);
+
+  // Parse command line options -----------------------------------------------
+  graphlab::command_line_options clopts(
+      "Maintains degrees, triangle counts and connected components while "
+      "batches of edges are inserted.");
+  std::string graph_dir;
+  std::string format = "adj";
+  std::string batches;
+  std::string saveprefix;
+  clopts.attach_option("graph", graph_dir,
+                       "The initial graph. Required.");
+  clopts.add_positional("graph");
+  clopts.attach_option("format", format,
+                       "The graph file format of the graph and the batches");
+  clopts.attach_option("batches", batches,
+                       "A comma separated list of paths, each holding a batch "
+                       "of edges which is inserted after the previous one. "
+                       "Requires the dynamic local graph.");
+  clopts.attach_option("saveprefix", saveprefix,
+                       "If set, the statistics of every vertex after the "
+                       "last batch are saved to files with this prefix.");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (graph_dir == "") {
+    dc.cout() << "--graph is not optional" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::vector<std::string> batch_paths =
+      graphlab::strsplit(batches, ",", true);
+
+  graph_type graph(dc, clopts);
+  if (!batch_paths.empty() && !graph.is_dynamic()) {
+    dc.cout() << "--batches requires GraphLab to be built with the dynamic "
+              << "local graph (USE_DYNAMIC_LOCAL_GRAPH)." << std::endl;
+    return EXIT_FAILURE;
+  }
+  dc.cout() << "Loading graph in format: "<< format << std::endl;
+  graph.load_format(graph_dir, format);
+  graph.finalize();
+
+  clopts.get_engine_args().set_option("type", "synchronous");
+  graphlab::synchronous_engine<neighborhood_update> nbr_engine(dc, graph, clopts);
+  graphlab::synchronous_engine<edge_recount> edge_engine(dc, graph, clopts);
+  graphlab::synchronous_engine<vertex_recount> vertex_engine(dc, graph, clopts);
+  graphlab::synchronous_engine<component_update> cc_engine(dc, graph, clopts);
+
+  // the initial graph is the first batch, where every vertex is new
+  for (size_t b = 0; b <= batch_paths.size(); ++b) {
+    graphlab::timer ti;
+    const size_t old_nverts = graph.num_vertices();
+    const size_t old_nedges = graph.num_edges();
+    if (b > 0) graph.load_incremental(batch_paths[b - 1], format);
+    ++BATCH;
+    const double load_time = ti.current_time();
+    ti.start();
+
+    graphlab::vertex_set touched = graph.select(degree_changed);
+    nbr_engine.signal_vset(touched);
+    nbr_engine.start();
+    edge_engine.signal_vset(touched);
+    edge_engine.start();
+    graphlab::vertex_set recount = graph.neighbors(touched, graphlab::ALL_EDGES);
+    recount |= touched;
+    vertex_engine.signal_vset(recount);
+    vertex_engine.start();
+    cc_engine.signal_vset(touched);
+    cc_engine.start();
+
+    const graph_stats stats = graph.map_reduce_vertices<graph_stats>(vertex_stats);
+    dc.cout() << "Batch " << b << ": +" << graph.num_vertices() - old_nverts
+              << " vertices, +" << graph.num_edges() - old_nedges << " edges"
+              << " (loaded in " << load_time << " s), "
+              << stats.num_touched << " touched and "
+              << graph.vertex_set_size(recount) << " recounted vertices, "
+              << "updated in " << ti.current_time() << " s\n"
+              << "  vertices: " << graph.num_vertices()
+              << " edges: " << graph.num_edges()
+              << " max degree: " << stats.max_degree
+              << " triangles: " << stats.num_triangles / 3
+              << " components: " << stats.num_components << std::endl;
+  }
+
+  if (saveprefix != "") {
+    graph.save(saveprefix, stats_writer(),
+               false,    // do not gzip
+               true,     // save vertices
+               false);   // do not save edges
+  }
+
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+} // End of main
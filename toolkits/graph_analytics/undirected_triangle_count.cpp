@@ -23,6 +23,7 @@
 
 #include <boost/unordered_set.hpp>
 #include <graphlab.hpp>
+#include <graphlab/graph/graph_ops.hpp>
 #include <graphlab/ui/metrics_server.hpp>
 #include <graphlab/util/hopscotch_set.hpp>
 #include <graphlab/macros_def.hpp>
@@ -66,6 +67,11 @@
  * \endverbatim
  * Must be counted only once. (Only when processing edge AB, can one
  * observe that A and B have intersecting out-neighbor sets).
+ *
+ * For quick estimates on large graphs, the graph option edge_sample_rate
+ * keeps each edge with probability p. A triangle then survives with
+ * probability p^3, so the counts are divided by p^3, which gives unbiased
+ * estimates of the counts on the full graph.
  */
  
 
@@ -246,35 +252,6 @@ struct vid_vector{
   }
 };
 
-/*
-  A simple counting iterator which can be used as an insert iterator.
-  but only counts the number of elements inserted. Useful for
-  use with counting the size of an intersection using std::set_intersection
-*/
-template <typename T>
-struct counting_inserter {
-  size_t* i;
-  counting_inserter(size_t* i):i(i) { }
-  counting_inserter& operator++() {
-    ++(*i);
-    return *this;
-  }
-  void operator++(int) {
-    ++(*i);
-  }
-
-  struct empty_val {
-    empty_val operator=(const T&) { return empty_val(); }
-  };
-
-  empty_val operator*() {
-    return empty_val();
-  }
-
-  typedef empty_val reference;
-};
-
-
 /*
  * Computes the size of the intersection of two vid_vector's
  */
@@ -283,12 +260,8 @@ static uint32_t count_set_intersect(
              const vid_vector& larger_set) {
 
   if (smaller_set.cset == NULL && larger_set.cset == NULL) {
-    size_t i = 0;
-    counting_inserter<graphlab::vertex_id_type> iter(&i);
-    std::set_intersection(smaller_set.vid_vec.begin(), smaller_set.vid_vec.end(),
-                          larger_set.vid_vec.begin(), larger_set.vid_vec.end(),
-                          iter);
-    return i;
+    return graphlab::graph_ops::sorted_intersection_size(smaller_set.vid_vec,
+                                                         larger_set.vid_vec);
   }
   else if (smaller_set.cset == NULL && larger_set.cset != NULL) {
     size_t i = 0;
@@ -349,6 +322,9 @@ typedef uint32_t edge_data_type;
 
 bool PER_VERTEX_COUNT = false;
 
+// The fraction of the edges kept by the ingress (see edge_sample_rate)
+double EDGE_SAMPLE_RATE = 1.0;
+
 
 /*
  * This is the gathering type which accumulates an array of
@@ -564,22 +540,16 @@ public:
 
 typedef graphlab::synchronous_engine<triangle_count> engine_type;
 
-/* Used to sum over all the edges in the graph in a
- * map_reduce_edges call
- * to get the total number of triangles
- */
-size_t get_edge_data(const graph_type::edge_type& e) {
-  return e.data();
-}
-
 /*
  * A saver which saves a file where each line is a vid / # triangles pair
  */
 struct save_triangle_count{
   std::string save_vertex(graph_type::vertex_type v) { 
-    double nt = v.data().num_triangles;
-    double n_followed = v.num_out_edges();
-    double n_following = v.num_in_edges();
+    // with edge sampling these are estimates for the full graph
+    const double p = EDGE_SAMPLE_RATE;
+    double nt = v.data().num_triangles / (p * p * p);
+    double n_followed = v.num_out_edges() / p;
+    double n_following = v.num_in_edges() / p;
 
     return graphlab::tostr(v.id()) + "\t" +
            graphlab::tostr(nt) + "\t" +
@@ -642,25 +612,54 @@ int main(int argc, char** argv) {
   graph.finalize();
   dc.cout() << "Number of vertices: " << graph.num_vertices() << std::endl
             << "Number of edges:    " << graph.num_edges() << std::endl;
+  EDGE_SAMPLE_RATE = graph.get_edge_sample_rate();
+  const double triangle_scale =
+      1.0 / (EDGE_SAMPLE_RATE * EDGE_SAMPLE_RATE * EDGE_SAMPLE_RATE);
+  if (EDGE_SAMPLE_RATE < 1) {
+    dc.cout() << "Edge sample rate:   " << EDGE_SAMPLE_RATE
+              << ". The counts are scaled by " << triangle_scale << std::endl;
+  }
 
   graphlab::timer ti;
   
-  // create engine to count the number of triangles
   dc.cout() << "Counting Triangles..." << std::endl;
-  engine_type engine(dc, graph, clopts);
-  engine.signal_all();
-  engine.start();
-
-  dc.cout() << "Counted in " << ti.current_time() << " seconds" << std::endl;
-
   if (PER_VERTEX_COUNT == false) {
-    size_t count = graph.map_reduce_edges<size_t>(get_edge_data);
-    dc.cout() << count << " Triangles"  << std::endl;
+    // orient the graph once and intersect the oriented lists of the
+    // ends of each local edge, without moving any list again.
+    graphlab::graph_ops::oriented_adjacency adjacency;
+    graphlab::graph_ops::orient_by_degree(graph, adjacency, clopts);
+    dc.cout() << "Oriented in " << ti.current_time() << " seconds" << std::endl;
+    size_t local_count = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+ : local_count)
+#endif
+    for (int i = 0; i < (int)graph.num_local_vertices(); ++i) {
+      foreach(graph_type::local_edge_type e, graph.l_vertex(i).out_edges()) {
+        local_count += adjacency.intersection_size(e.source().id(),
+                                                   e.target().id());
+      }
+    }
+    size_t count = local_count;
+    dc.all_reduce(count);
+    dc.cout() << "Counted in " << ti.current_time() << " seconds" << std::endl;
+    if (EDGE_SAMPLE_RATE < 1) {
+      dc.cout() << count << " Triangles in the sampled graph" << std::endl;
+      dc.cout() << "Estimated " << size_t(count * triangle_scale + 0.5)
+                << " Triangles"  << std::endl;
+    } else {
+      dc.cout() << count << " Triangles"  << std::endl;
+    }
   }
   else {
-    graphlab::synchronous_engine<get_per_vertex_count> engine(dc, graph, clopts);
+    // create engine to count the number of triangles
+    engine_type engine(dc, graph, clopts);
     engine.signal_all();
     engine.start();
+    dc.cout() << "Counted in " << ti.current_time() << " seconds" << std::endl;
+
+    graphlab::synchronous_engine<get_per_vertex_count> count_engine(dc, graph, clopts);
+    count_engine.signal_all();
+    count_engine.start();
     graph.save(per_vertex,
             save_triangle_count(),
             false, /* no compression */
@@ -81,7 +81,7 @@ template<size_t MAX_DIM>
 class bp_vertex_program : 
     public graphlab::ivertex_program< typename graph_type<MAX_DIM>::type, 
                                       factor_product<MAX_DIM>,
-                                      graphlab::messages::sum_priority >
+                                      graphlab::messages::max_priority >
 {
   // unfortunately this is necessary...from C++ Standard 14.6.2/3:
   // "In the definition of a class template or a member of a class template, if a
@@ -91,7 +91,7 @@ class bp_vertex_program :
   // of the class template or member.
   typedef graphlab::ivertex_program< typename graph_type<MAX_DIM>::type, 
                                      factor_product<MAX_DIM>,
-                                     graphlab::messages::sum_priority > ivertex_program_t;
+                                     graphlab::messages::max_priority > ivertex_program_t;
   // NOTE there is a bug in GCC < 4.7 which prevents these using declarations from 
   // compiling (http://gcc.gnu.org/bugzilla/show_bug.cgi?id=14258)
   //using typename ivertex_program_t::edge_dir_type;
@@ -45,6 +45,9 @@
 #include <limits>
 #include <vector>
 #include <set>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 // Random number generation
@@ -314,28 +317,31 @@ namespace graphlab {
     //! ensure that sum_x this(x) = 1 
     void normalize() {
       //ASSERT_TRUE(is_finite());
-      // Compute the max value
-      double max_value = logP(0);
-      for(size_t i = 0; i < size(); ++i) {
-        max_value = std::max(max_value, logP(i) );
-      }
-      // scale and compute normalizing constant
-      double Z = 0.0;
-      for(size_t i = 0; i < size(); ++i) {
-        double val = logP(i) - max_value;
-        set_logP(i, val);
-        Z += exp(val);
-      }
-      // assert( !std::isinf(Z) );
-      // assert( !std::isnan(Z) );
-      // assert( Z > 0.0);
-      const double logZ(log(Z));
+      const double logZ(log_sum_exp(&_data[0], size()));
       DASSERT_FALSE( std::isinf(logZ) );
       DASSERT_FALSE( std::isnan(logZ) );
       // Normalize
-      for(size_t i = 0; i < size(); ++i) { set_logP( i, logP(i) - logZ ); }
+      const double zero(APPROX_LOG_ZERO());
+      double* data = &_data[0];
+      for(size_t i = 0; i < size(); ++i) { 
+        data[i] = std::max(data[i] - logZ, zero); 
+      }
       //ASSERT_TRUE(is_finite());
     } // End of normalize
+
+    /**
+     * log(sum_i exp(x[i])) over a contiguous array, shifted by the
+     * max so that the sum neither overflows nor underflows. The sum 
+     * loop is branch free so that the compiler can vectorize it (it 
+     * needs -ffast-math to be reordered).
+     */
+    static double log_sum_exp(const double* x, const size_t n) {
+      DCHECK_GT(n, 0);
+      const double max_value = max_of(x + 1, n - 1, x[0]);
+      double Z = 0.0;
+      for(size_t i = 0; i < n; ++i) { Z += exp(x[i] - max_value); }
+      return max_value + log(Z);
+    }
     
     /** 
      * Ensure that the largest value in log form is zero.  This
@@ -416,17 +422,89 @@ namespace graphlab {
       }
     };
 
+    /**
+     * Returns true if the variables of sub are a contiguous run of the
+     * variables of this table, e.g., {v1} or {v1,v2} in {v0,v1,v2}. The
+     * stride is then the product of the sizes of the variables which 
+     * precede the run, and the linear index of sub is 
+     * (i / stride) % sub.size() for every linear index i of this table.
+     */
+    bool contiguous_stride(const domain_type& sub, size_t& stride) const {
+      if(sub.num_vars() == 0) return false;
+      stride = 1;
+      size_t loc = 0;
+      for( ; loc < num_vars() && args().var(loc) != sub.var(0); ++loc) {
+        stride *= args().var(loc).size();
+      }
+      if(loc + sub.num_vars() > num_vars()) return false;
+      for(size_t i = 1; i < sub.num_vars(); ++i) {
+        if(args().var(loc + i) != sub.var(i)) return false;
+      }
+      return true;
+    }
+
+    //! max(init, x[0], ..., x[n-1]), two entries at a time with SSE2
+    static double max_of(const double* x, const size_t n, double init) {
+      size_t i = 0;
+#ifdef __SSE2__
+      if(n >= 2) {
+        __m128d m = _mm_set1_pd(init);
+        for(; i + 2 <= n; i += 2) { m = _mm_max_pd(m, _mm_loadu_pd(x + i)); }
+        double pair[2];
+        _mm_storeu_pd(pair, m);
+        init = std::max(pair[0], pair[1]);
+      }
+#endif
+      for(; i < n; ++i) { init = std::max(init, x[i]); }
+      return init;
+    }
+
+    //! out[j] = max over the entries of this table at index j of a run
+    //! of length len = out.size() and the given stride
+    void strided_max(const size_t stride, std::vector<double>& out) const {
+      const size_t len = out.size();
+      const double* data = &_data[0];
+      std::fill(out.begin(), out.end(), APPROX_LOG_ZERO());
+      for(size_t base = 0; base < size(); base += len * stride) {
+        if(stride == 1) {
+          for(size_t j = 0; j < len; ++j) { 
+            out[j] = std::max(out[j], data[base + j]); 
+          }
+        } else {
+          for(size_t j = 0; j < len; ++j) {
+            out[j] = max_of(data + base + j * stride, stride, out[j]);
+          }
+        }
+      }
+    }
+
     template<class Func>
     inline dense_table_impl& for_each_assignment(const dense_table_impl& other, 
         const Func& f) {
       //ASSERT_TRUE(is_finite());
+      const double zero(APPROX_LOG_ZERO());
+      double* data = &_data[0];
+      size_t stride = 0;
       if(args() == other.args()) {
         DCHECK_EQ(size(), other.size());
         // More verctorizable version
+        const double* odata = &other._data[0];
         for(size_t i = 0; i < size(); ++i) {
-          double val = f(logP(i), other.logP(i));
-          set_logP( i, val );
-          //logP(i) -= other.logP(i);
+          data[i] = std::max(f(data[i], odata[i]), zero);
+        }
+      } else if(contiguous_stride(other.args(), stride)) {
+        // the other table is broadcast in runs of stride entries, so
+        // the inner loop walks contiguous memory
+        const size_t len = other.size();
+        const double* odata = &other._data[0];
+        for(size_t base = 0; base < size(); base += len * stride) {
+          for(size_t j = 0; j < len; ++j) {
+            const double b = odata[j];
+            double* row = data + base + j * stride;
+            for(size_t s = 0; s < stride; ++s) {
+              row[s] = std::max(f(row[s], b), zero);
+            }
+          }
         }
       } else { 
         // other domain must be a subset of this domain
@@ -532,6 +610,34 @@ namespace graphlab {
         msg = *this;
         return;
       }
+      size_t stride = 0;
+      if(contiguous_stride(msg.args(), stride)) {
+        // shift each sum by its max, as in log_sum_exp()
+        const size_t len = msg.size();
+        const double* data = &_data[0];
+        std::vector<double> max_value(len), sum(len, 0.0);
+        strided_max(stride, max_value);
+        for(size_t base = 0; base < size(); base += len * stride) {
+          if(stride == 1) {
+            for(size_t j = 0; j < len; ++j) { 
+              sum[j] += exp(data[base + j] - max_value[j]); 
+            }
+          } else {
+            for(size_t j = 0; j < len; ++j) {
+              const double* row = data + base + j * stride;
+              double acc = 0.0;
+              for(size_t s = 0; s < stride; ++s) { 
+                acc += exp(row[s] - max_value[j]); 
+              }
+              sum[j] += acc;
+            }
+          }
+        }
+        for(size_t j = 0; j < len; ++j) {
+          msg.set_logP( j, max_value[j] + log(sum[j]) );
+        }
+        return;
+      }
       // Compute the domain to remove
       domain_type ydom = args() - msg.args();
       DCHECK_GT(ydom.num_vars(), 0);
@@ -543,19 +649,17 @@ namespace graphlab {
       // Loop over x
       typename domain_type::const_iterator xasg = msg.args().begin(); 
       typename domain_type::const_iterator end = msg.args().end();
+      // gather the strided entries so they can be summed contiguously
+      std::vector<double> ys(numel);
       for( ; xasg != end; ++xasg) {
-        double sum = 0;
         for(size_t i = 0;i < numel; ++i) {
-          sum += exp(logP(fastyasg.linear_index()));
+          ys[i] = logP(fastyasg.linear_index());
           ++fastyasg;
         }
+        const double sum(log_sum_exp(&ys[0], numel));
         DASSERT_FALSE( std::isinf(sum) );
         DASSERT_FALSE( std::isnan(sum) );
-        DCHECK_GE(sum, 0.0);
-        if(sum == 0) 
-          msg.set_logP( xasg->linear_index(), APPROX_LOG_ZERO() );
-        else 
-          msg.set_logP( xasg->linear_index(), log(sum) );
+        msg.set_logP( xasg->linear_index(), sum );
       }
     }
       
@@ -570,6 +674,15 @@ namespace graphlab {
         msg = *this;
         return;
       }
+      size_t stride = 0;
+      if(contiguous_stride(msg.args(), stride)) {
+        std::vector<double> max_value(msg.size());
+        strided_max(stride, max_value);
+        for(size_t j = 0; j < max_value.size(); ++j) {
+          msg.set_logP( j, max_value[j] );
+        }
+        return;
+      }
       // Compute the domain to remove
       domain_type ydom = args() - msg.args();
       DCHECK_GT(ydom.num_vars(), 0);
@@ -202,6 +202,44 @@ void multiplyTest(unsigned v0_id, unsigned v1_id, unsigned v2_id)
   }
 }
 
+void marginalizeTest(unsigned v0_id, unsigned v1_id, unsigned v2_id) 
+{
+  dense_table_t dt = create_dense_table(v0_id, v1_id, v2_id);
+
+  // messages over every single variable and pair of variables, which
+  // covers contiguous runs of the table's variables as well as the
+  // non-contiguous pair {var(0), var(2)}
+  std::vector<domain_t> msg_doms;
+  for(size_t i=0; i < dt.domain().num_vars(); ++i) {
+    msg_doms.push_back(domain_t(dt.domain().var(i)));
+    for(size_t j=i+1; j < dt.domain().num_vars(); ++j) 
+      msg_doms.push_back(domain_t(dt.domain().var(i), dt.domain().var(j)));
+  }
+
+  for(size_t m=0; m < msg_doms.size(); ++m) {
+    dense_table_t sum_msg(msg_doms[m]);
+    dense_table_t max_msg(msg_doms[m]);
+    dt.marginalize(sum_msg);
+    dt.MAP(max_msg);
+
+    domain_t::const_iterator xasg = msg_doms[m].begin();
+    domain_t::const_iterator xend = msg_doms[m].end();
+    for( ; xasg != xend; ++xasg) {
+      std::vector<double> vals;
+      for(size_t i=0; i < dt.size(); ++i) {
+        assignment_t dt_asg(dt.domain(), i);
+        if(dt_asg.restrict(msg_doms[m]) == *xasg) 
+          vals.push_back(dt.logP(dt_asg));
+      }
+      double maxval = *std::max_element(vals.begin(), vals.end());
+      double sum = 0;
+      for(size_t i=0; i < vals.size(); ++i) sum += exp(vals[i] - maxval);
+      ASSERT_LT(std::fabs(sum_msg.logP(*xasg) - (maxval + log(sum))), 1e-8);
+      ASSERT_EQ(max_msg.logP(*xasg), maxval);
+    }
+  }
+}
+
 int main() {
   // create a table 
   dense_table_t dt_gm = create_dense_table(2, 0, 1);
@@ -239,5 +277,10 @@ int main() {
   multiplyTest(4, 2, 3);
   multiplyTest(4, 3, 2);
 
+  // marginalize and MAP test - compare against brute force sums
+  marginalizeTest(2, 3, 4);
+  marginalizeTest(3, 4, 2);
+  marginalizeTest(4, 2, 3);
+
   std::cout << "All tests passed" << std::endl;
 }
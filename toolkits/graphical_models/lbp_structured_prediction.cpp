@@ -154,6 +154,16 @@ double DAMPING = 0.1;
  */
 double TOLERANCE = 0.01;
 
+/**
+ * \brief If set, run residual belief propagation: the asynchronous
+ * engine with the priority scheduler always updates next the vertex
+ * which received the message with the largest residual, and vertices
+ * whose largest incoming residual is below TOLERANCE are never run.
+ *
+ * The parameter is set as a command line argument
+ */
+bool RESIDUAL = false;
+
 
 /**
  * \brief The vertex data contains the vertex potential as well as the
@@ -277,7 +287,7 @@ typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
  */
 struct bp_vertex_program : 
   public graphlab::ivertex_program< graph_type, factor_type,
-                                    graphlab::messages::sum_priority >,
+                                    graphlab::messages::max_priority >,
   public graphlab::IS_POD_TYPE {
 
   /**
@@ -580,6 +590,17 @@ struct map_prediction_saver {
 
 
 
+/**
+ * \brief Sets the options of residual BP: the priority scheduler,
+ * which drops the vertices whose priority (largest message residual)
+ * is below the convergence threshold.
+ */
+void set_residual_options(graphlab::graphlab_options& opts) {
+  opts.set_scheduler_type("priority");
+  opts.get_scheduler_args().set_option("min_priority", TOLERANCE);
+} // end of set_residual_options
+
+
 int main(int argc, char** argv) {
   global_logger().set_log_level(LOG_INFO);
   global_logger().set_log_to_console(true);
@@ -614,6 +635,8 @@ int main(int argc, char** argv) {
                        "Return maximizing assignment instead of the posterior distribution.");
   clopts.attach_option("engine", exec_type,
                        "The type of engine to use {async, sync}.");
+  clopts.attach_option("residual", RESIDUAL,
+                       "Run residual BP (the async engine with the priority scheduler).");
   if(!clopts.parse(argc, argv)) {
     graphlab::mpi_tools::finalize();
     return clopts.is_set("help")? EXIT_SUCCESS : EXIT_FAILURE;
@@ -645,8 +668,13 @@ int main(int argc, char** argv) {
   graph.transform_edges(edge_initializer);
 
   typedef graphlab::omni_engine<bp_vertex_program> engine_type;
+  if(RESIDUAL) {
+    exec_type = "async";
+    set_residual_options(clopts);
+  }
   engine_type engine(dc, graph, exec_type, clopts);
-  engine.signal_all();
+  // In residual BP every vertex runs first: it has no messages yet
+  engine.signal_all(RESIDUAL? std::numeric_limits<double>::max() : 0);
   graphlab::timer timer;
   engine.start();  
   const double runtime = timer.current_time();
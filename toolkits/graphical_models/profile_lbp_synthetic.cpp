@@ -114,6 +114,16 @@ double DAMPING = 0.1;
  */
 double TOLERANCE = 0.01;
 
+/**
+ * \brief If set, run residual belief propagation: the asynchronous
+ * engine with the priority scheduler always updates next the vertex
+ * which received the message with the largest residual, and vertices
+ * whose largest incoming residual is below TOLERANCE are never run.
+ *
+ * The parameter is set as a command line argument
+ */
+bool RESIDUAL = false;
+
 
 
 bool USE_CACHE = false;
@@ -259,7 +269,7 @@ typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
  */
 struct bp_vertex_program : 
   public graphlab::ivertex_program< graph_type, factor_type,
-                                    graphlab::messages::sum_priority >,
+                                    graphlab::messages::max_priority >,
   public graphlab::IS_POD_TYPE {
 
   /**
@@ -502,6 +512,51 @@ struct map_prediction_saver {
 
 
 
+/**
+ * \brief Sets the options of residual BP: the priority scheduler,
+ * which drops the vertices whose priority (largest message residual)
+ * is below the convergence threshold.
+ */
+void set_residual_options(graphlab::graphlab_options& opts) {
+  opts.set_scheduler_type("priority");
+  opts.get_scheduler_args().set_option("min_priority", TOLERANCE);
+} // end of set_residual_options
+
+
+typedef graphlab::omni_engine<bp_vertex_program> engine_type;
+
+/** \brief The result of one run of the engine */
+struct bp_run {
+  double runtime;
+  size_t updates;
+  /** \brief The MAP state of every local vertex, once converged */
+  std::vector<size_t> map;
+};
+
+/**
+ * \brief Runs BP from fresh messages, with the residual schedule if
+ * residual is set.
+ */
+bp_run run_bp(graphlab::distributed_control& dc, graph_type& graph,
+              const std::string& exec_type, bool residual,
+              const graphlab::command_line_options& clopts) {
+  graph.transform_edges(edge_initializer);
+  graphlab::graphlab_options opts = clopts;
+  if(residual) set_residual_options(opts);
+  engine_type engine(dc, graph, residual? "async" : exec_type, opts);
+  engine.signal_all(residual? std::numeric_limits<double>::max() : 0);
+  graphlab::timer timer;
+  engine.start();
+  bp_run ret;
+  ret.runtime = timer.current_time();
+  ret.updates = engine.num_updates();
+  ret.map.resize(graph.num_local_vertices());
+  for(size_t i = 0; i < ret.map.size(); ++i) 
+    graph.l_vertex(i).data().belief.maxCoeff(&ret.map[i]);
+  return ret;
+} // end of run_bp
+
+
 int main(int argc, char** argv) {
   global_logger().set_log_level(LOG_INFO);
   global_logger().set_log_to_console(true);
@@ -518,6 +573,7 @@ int main(int argc, char** argv) {
   std::string exec_type = "async";
   std::string format = "tsv";
   bool map = false;
+  bool compare = false;
   clopts.attach_option("graph", graph_dir,
                        "The directory containing the adjacency graph");
   clopts.add_positional("graph"); 
@@ -540,6 +596,10 @@ int main(int argc, char** argv) {
                        "Return maximizing assignment instead of the posterior distribution.");
   clopts.attach_option("engine", exec_type,
                        "The type of engine to use {async, sync}.");
+  clopts.attach_option("residual", RESIDUAL,
+                       "Run residual BP (the async engine with the priority scheduler).");
+  clopts.attach_option("compare", compare,
+                       "Benchmark residual BP against synchronous BP.");
   if(!clopts.parse(argc, argv)) {
     graphlab::mpi_tools::finalize();
     return clopts.is_set("help")? EXIT_SUCCESS : EXIT_FAILURE;
@@ -562,23 +622,40 @@ int main(int argc, char** argv) {
   ///! load the graph
   graph.load_format(graph_dir, format);
   graph.finalize();
-  dc.cout() << "Initializing edge data" << std::endl;
-  graph.transform_edges(edge_initializer);
 
-  typedef graphlab::omni_engine<bp_vertex_program> engine_type;
-  engine_type engine(dc, graph, exec_type, clopts);
-  engine.signal_all();
-  graphlab::timer timer;
-  dc.cout() << "Running engine" << std::endl;
-  engine.start();  
-  const double runtime = timer.current_time();
+  if(compare) {
+    dc.cout() << "Running synchronous BP" << std::endl;
+    const bp_run sync_run = run_bp(dc, graph, "sync", false, clopts);
+    dc.cout() << "Running residual BP" << std::endl;
+    const bp_run residual_run = run_bp(dc, graph, "async", true, clopts);
+    size_t agree = 0, nvertices = 0;
+    for(size_t i = 0; i < sync_run.map.size(); ++i) {
+      if(!graph.l_is_master(i)) continue;
+      agree += (sync_run.map[i] == residual_run.map[i]);
+      ++nvertices;
+    }
+    dc.all_reduce(agree);
+    dc.all_reduce(nvertices);
     dc.cout() 
-    << "----------------------------------------------------------" << std::endl
-    << "Final Runtime (seconds):   " << runtime 
-    << std::endl
-    << "Updates executed: " << engine.num_updates() << std::endl
-    << "Update Rate (updates/second): " 
-    << engine.num_updates() / runtime << std::endl;
+      << "----------------------------------------------------------" << std::endl
+      << "            Runtime (s)   Updates" << std::endl
+      << "Synchronous " << std::setw(11) << sync_run.runtime 
+      << "   " << sync_run.updates << std::endl
+      << "Residual    " << std::setw(11) << residual_run.runtime 
+      << "   " << residual_run.updates << std::endl
+      << "Speedup: " << sync_run.runtime / residual_run.runtime 
+      << ", MAP agreement: " << double(agree) / nvertices << std::endl;
+  } else {
+    dc.cout() << "Running engine" << std::endl;
+    const bp_run run = run_bp(dc, graph, exec_type, RESIDUAL, clopts);
+    dc.cout() 
+      << "----------------------------------------------------------" << std::endl
+      << "Final Runtime (seconds):   " << run.runtime 
+      << std::endl
+      << "Updates executed: " << run.updates << std::endl
+      << "Update Rate (updates/second): " 
+      << run.updates / run.runtime << std::endl;
+  }
     
     
   std::cout << "Saving predictions" << std::endl;
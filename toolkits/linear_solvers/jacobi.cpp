@@ -24,12 +24,17 @@
  * A assumed to be full column rank.  Algorithm is described
  * http://en.wikipedia.org/wiki/Jacobi_method
  * Written by Danny Bickson 
+ *
+ * --solver=gauss_seidel runs an asynchronous Gauss-Seidel / SOR
+ * relaxation with residual priorities and --solver=cg runs the
+ * conjugate gradient method (A symmetric positive definite).
  */
 #include "../collaborative_filtering/eigen_wrapper.hpp"
 #include "../collaborative_filtering/types.hpp"
 #include "../collaborative_filtering/eigen_serialization.hpp"
 #include <graphlab/util/stl_util.hpp>
 #include <graphlab.hpp>
+#include <graphlab/macros_def.hpp>
 
 
 
@@ -38,11 +43,16 @@ enum jacobi_fields{
   JACOBI_REAL_X = 1,
   JACOBI_Y = 2,
   JACOBI_PREV_X = 3,
-  JACOBI_PREC = 4
+  JACOBI_PREC = 4,
+  // conjugate gradient residual, direction, A*direction and A*residual
+  JACOBI_R = 5,
+  JACOBI_P = 6,
+  JACOBI_S = 7,
+  JACOBI_W = 8
 };
 
-int actual_vector_len = 5;
-int data_size = 5;
+int actual_vector_len = 9;
+int data_size = 9;
 bool final_residual = true;
 bool zero = false;  //allow for zero entries in sparse matrix market format
 bool update_function = false;
@@ -53,6 +63,8 @@ int max_iter = 10;
 double tol = 1e-5;
 int quiet = 0;
 int unittest = 0;
+std::string solver = "jacobi";
+double omega = 1.0; // SOR relaxation, 1 is Gauss-Seidel
 
 struct vertex_data {
   vec pvec;
@@ -206,6 +218,164 @@ void start_engine(){
   pengine->start();
 }
 
+
+/**
+ * \brief Asynchronous Gauss-Seidel / SOR relaxation.
+ *
+ * Row i is relaxed with the latest values of its neighbors:
+ * x_i = (1-omega) x_i + omega (b_i - sum_{j!=i} A_ij x_j) / A_ii.
+ * The change of x_i changes the residual of every row j with
+ * A_ji != 0 by A_ji * change, so these rows are signaled with the
+ * change of their own update as priority and the priority scheduler
+ * relaxes the rows with the largest residual first. Rows whose
+ * residual is below tol are not signaled.
+ */
+class gauss_seidel :
+  public graphlab::ivertex_program<graph_type, double, 
+                                   graphlab::messages::max_priority>,
+  public graphlab::IS_POD_TYPE {
+  double change;
+public:
+  gauss_seidel() : change(0) { }
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::OUT_EDGES;
+  }
+  
+  double gather(icontext_type& context, const vertex_type& vertex,
+                edge_type& edge) const {
+    return edge.data().obs * edge.target().data().pvec[JACOBI_X];
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const double& total) {
+    vertex_data& vdata = vertex.data();
+    const double x = vdata.pvec[JACOBI_X];
+    const double x_gs = (vdata.pvec[JACOBI_Y] - total) / vdata.A_ii;
+    vdata.pvec[JACOBI_X] = (1 - omega) * x + omega * x_gs;
+    change = vdata.pvec[JACOBI_X] - x;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return change == 0 ? graphlab::NO_EDGES : graphlab::IN_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const double residual = 
+      std::fabs(edge.data().obs * change / edge.source().data().A_ii);
+    if (residual > tol)
+      context.signal(edge.source(), 
+                     graphlab::messages::max_priority(residual));
+  }
+}; // end of gauss_seidel
+
+typedef graphlab::omni_engine<gauss_seidel> gs_engine_type;
+
+
+/**
+ * \brief The two dot products of a conjugate gradient iteration.
+ *
+ * This is the Chronopoulos/Gear formulation of CG: r.r and (Ar).r are
+ * reduced together after the single matrix vector product of an 
+ * iteration, and the direction p, its product s = Ap, x and r are all 
+ * updated by recurrences. An iteration therefore costs one gather
+ * over the edges, one map_reduce_vertices and a local pass, instead 
+ * of a separate pass for Ap, p.Ap and r.r.
+ */
+struct cg_dots : public graphlab::IS_POD_TYPE {
+  double rr, wr;
+  cg_dots(double rr = 0, double wr = 0) : rr(rr), wr(wr) { }
+  cg_dots& operator+=(const cg_dots& other) {
+    rr += other.rr;
+    wr += other.wr;
+    return *this;
+  }
+}; // end of cg_dots
+
+cg_dots cg_dot_products(const graph_type::vertex_type& vertex) {
+  const vec& pvec = vertex.data().pvec;
+  return cg_dots(pvec[JACOBI_R] * pvec[JACOBI_R], 
+                 pvec[JACOBI_W] * pvec[JACOBI_R]);
+}
+
+// the fields read and written by cg_matvec()
+int cg_in = JACOBI_X, cg_out = JACOBI_W;
+
+double cg_gather(graphlab::lvid_type lvid, graph_type& graph) {
+  double sum = 0;
+  foreach(graph_type::local_edge_type edge, graph.l_vertex(lvid).out_edges())
+    sum += edge.data().obs * edge.target().data().pvec[cg_in];
+  return sum;
+}
+
+void cg_apply(graphlab::lvid_type lvid, const double& sum, graph_type& graph) {
+  vertex_data& vdata = graph.l_vertex(lvid).data();
+  vdata.pvec[cg_out] = sum + vdata.A_ii * vdata.pvec[cg_in];
+}
+
+/** pvec[out] = A * pvec[in], on masters and mirrors alike */
+void cg_matvec(graph_type& graph, int in, int out, 
+               const graphlab::graphlab_options& opts) {
+  cg_in = in;
+  cg_out = out;
+  graphlab::graph_gather_apply<graph_type, double> 
+    matvec(graph, cg_gather, cg_apply, opts);
+  matvec.exec();
+}
+
+/**
+ * Applies the recurrences of an iteration to every local copy of
+ * every vertex. All copies hold the same values, so no communication
+ * is needed for the mirrors to see the new residual.
+ */
+void cg_update(graph_type& graph, double alpha, double beta) {
+  const int nverts = graph.num_local_vertices();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int lvid = 0; lvid < nverts; ++lvid) {
+    vec& pvec = graph.l_vertex(lvid).data().pvec;
+    pvec[JACOBI_P] = pvec[JACOBI_R] + beta * pvec[JACOBI_P];
+    pvec[JACOBI_S] = pvec[JACOBI_W] + beta * pvec[JACOBI_S];
+    pvec[JACOBI_X] += alpha * pvec[JACOBI_P];
+    pvec[JACOBI_R] -= alpha * pvec[JACOBI_S];
+  }
+}
+
+/** Runs at most max_iter CG iterations and returns how many ran */
+int run_cg(graph_type& graph, const graphlab::graphlab_options& opts) {
+  // r = b - A x
+  cg_matvec(graph, JACOBI_X, JACOBI_W, opts);
+  const int nverts = graph.num_local_vertices();
+  for (int lvid = 0; lvid < nverts; ++lvid) {
+    vec& pvec = graph.l_vertex(lvid).data().pvec;
+    pvec[JACOBI_R] = pvec[JACOBI_Y] - pvec[JACOBI_W];
+  }
+
+  double alpha = 0, rr_prev = 0;
+  for (int i = 0; i < max_iter; i++) {
+    cg_matvec(graph, JACOBI_R, JACOBI_W, opts);
+    const cg_dots dots = graph.map_reduce_vertices<cg_dots>(cg_dot_products);
+    if (debug)
+      graph.dc().cout() << "CG iteration " << i << " residual " 
+                        << sqrt(dots.rr) << std::endl;
+    if (sqrt(dots.rr) < tol)
+      return i;
+    const double beta = (i == 0) ? 0 : dots.rr / rr_prev;
+    const double denom = (i == 0) ? dots.wr : dots.wr - beta * dots.rr / alpha;
+    if (denom <= 0)
+      logstream(LOG_FATAL) << "CG requires a symmetric positive definite matrix" 
+                           << std::endl;
+    alpha = dots.rr / denom;
+    rr_prev = dots.rr;
+    cg_update(graph, alpha, beta);
+  }
+  return max_iter;
+}
+
 int main(int argc, char** argv) {
   global_logger().set_log_to_console(true);
 
@@ -228,6 +398,10 @@ int main(int argc, char** argv) {
   clopts.attach_option("rows", rows, "number of rows");
   clopts.attach_option("cols", cols, "number of cols");
   clopts.attach_option("quiet", quiet, "quiet mode (less verbose)");
+  clopts.attach_option("solver", solver, 
+      "jacobi, gauss_seidel (asynchronous, residual scheduled) or cg");
+  clopts.attach_option("omega", omega, 
+      "gauss_seidel relaxation factor (1 = Gauss-Seidel, (1,2) = SOR)");
   if(!clopts.parse(argc, argv) || input_dir == "") {
     std::cout << "Error in parsing command line arguments." << std::endl;
     clopts.print_description();
@@ -240,6 +414,8 @@ int main(int argc, char** argv) {
 
   if (rows <= 0 || cols <= 0 || rows != cols)
     logstream(LOG_FATAL)<<"Please specify number of rows/cols of the input matrix" << std::endl;
+  if (solver != "jacobi" && solver != "gauss_seidel" && solver != "cg")
+    logstream(LOG_FATAL)<<"Unknown solver: " << solver << std::endl;
     
  
   info.rows = rows;
@@ -305,7 +481,7 @@ int main(int argc, char** argv) {
     v0 = input;
   }  
 
-  dc.cout() << "Running Jacobi" << std::endl;
+  dc.cout() << "Running " << solver << std::endl;
   dc.cout() << "(C) Code by Danny Bickson, CMU " << std::endl;
   dc.cout() << "Please send bug reports to danny.bickson@gmail.com" << std::endl;
   timer.start();
@@ -318,14 +494,34 @@ int main(int argc, char** argv) {
   PRINT_VEC(b);
   PRINT_VEC(x);
   PRINT_VEC(A_ii);
-  for (int i=0; i < max_iter; i++){
-    mi.use_diag = false;
-    x = (b - A*x)/A_ii;
-    PRINT_VEC(x);
+  size_t num_updates = 0;
+  if (solver == "gauss_seidel"){
+    graphlab::graphlab_options gs_opts = clopts;
+    gs_opts.set_scheduler_type("priority");
+    gs_opts.get_scheduler_args().set_option("min_priority", tol);
+    gs_engine_type gs_engine(dc, graph, "asynchronous", gs_opts);
+    gs_engine.signal_all(graphlab::messages::max_priority(
+                           std::numeric_limits<double>::max()));
+    gs_engine.start();
+    num_updates = gs_engine.num_updates();
+  }
+  else if (solver == "cg"){
+    const int iterations = run_cg(graph, clopts);
+    dc.cout() << "CG iterations: " << iterations << std::endl;
+    num_updates = size_t(iterations) * graph.num_vertices();
   }
+  else {
+    for (int i=0; i < max_iter; i++){
+      mi.use_diag = false;
+      x = (b - A*x)/A_ii;
+      PRINT_VEC(x);
+    }
+    num_updates = engine.num_updates();
+  }
+  PRINT_VEC(x);
  
-  dc.cout() << "Jacobi finished in " << runtime << std::endl;
-  dc.cout() << "\t Updates: " << engine.num_updates() << std::endl;
+  dc.cout() << solver << " finished in " << timer.current_time() << std::endl;
+  dc.cout() << "\t Updates: " << num_updates << std::endl;
 
     DistVec p(info, JACOBI_PREV_X, true, "p");
     mi.use_diag = true;
@@ -341,9 +537,9 @@ int main(int argc, char** argv) {
     << std::endl
     << "Final Runtime (seconds):   " << runtime 
                                         << std::endl
-                                        << "Updates executed: " << engine.num_updates() << std::endl
+                                        << "Updates executed: " << num_updates << std::endl
                                         << "Update Rate (updates/second): " 
-                                          << engine.num_updates() / runtime << std::endl;
+                                          << num_updates / runtime << std::endl;
 
   graph.save("x.out", linear_model_saver(JACOBI_X), false, true, false, 1);
   graphlab::mpi_tools::finalize();
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+#ifndef ALIAS_TABLE_HPP
+#define ALIAS_TABLE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <graphlab/util/random.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+
+/**
+ * \brief A Walker alias table which draws from a fixed discrete
+ * distribution in constant time.
+ *
+ * The distribution is over the given topics (sorted, so that the
+ * weight of a topic can be found by a binary search) or, if no topics
+ * are given, over 0 .. weights.size() - 1. The weights need not be
+ * normalized: the table keeps them so that a Metropolis-Hastings
+ * sampler can evaluate the proposal it drew from.
+ *
+ * The table is immutable once built. stale() tells the owner when the
+ * table has served as many draws as it was budgeted for and should be
+ * rebuilt, which amortizes the construction over the draws.
+ */
+template <typename TopicType>
+class alias_table {
+public:
+  alias_table() : sum(0), budget(0) { }
+
+  /**
+   * \brief Builds the table in O(n) (Vose's method).
+   *
+   * \param budget the number of draws after which the table is stale
+   */
+  void build(const std::vector<double>& weights_in,
+             const std::vector<TopicType>& topics_in, size_t budget_in) {
+    ASSERT_TRUE(topics_in.empty() || topics_in.size() == weights_in.size());
+    weights = weights_in; topics = topics_in; budget = budget_in;
+    const size_t n = weights.size();
+    prob.resize(n); alias.resize(n);
+    sum = 0;
+    for(size_t i = 0; i < n; ++i) sum += weights[i];
+    if(n == 0 || sum <= 0) { sum = 0; return; }
+    std::vector<uint32_t> small, large;
+    std::vector<double> scaled(n);
+    for(size_t i = 0; i < n; ++i) {
+      scaled[i] = weights[i] * n / sum;
+      (scaled[i] < 1 ? small : large).push_back(i);
+    }
+    while(!small.empty() && !large.empty()) {
+      const uint32_t s = small.back(); small.pop_back();
+      const uint32_t l = large.back();
+      prob[s] = scaled[s]; alias[s] = l;
+      scaled[l] -= 1 - scaled[s];
+      if(scaled[l] < 1) { large.pop_back(); small.push_back(l); }
+    }
+    // the rest have probability 1 up to rounding errors
+    for(size_t i = 0; i < small.size(); ++i) {
+      prob[small[i]] = 1; alias[small[i]] = small[i];
+    }
+    for(size_t i = 0; i < large.size(); ++i) {
+      prob[large[i]] = 1; alias[large[i]] = large[i];
+    }
+  } // end of build
+
+  /// Returns true if no topic has a positive weight
+  bool empty() const { return sum <= 0; }
+
+  /// The sum of the weights
+  double total() const { return sum; }
+
+  /// Draws a topic with probability weight / total(). Not empty().
+  TopicType sample() const {
+    ++draws;
+    const double u = graphlab::random::rand01() * prob.size();
+    size_t i = std::min(size_t(u), prob.size() - 1);
+    if(u - i >= prob[i]) i = alias[i];
+    return topics.empty() ? TopicType(i) : topics[i];
+  } // end of sample
+
+  /// The weight of a topic, 0 if it is not in the table
+  double weight(TopicType topic) const {
+    if(topics.empty()) return topic < weights.size() ? weights[topic] : 0;
+    typename std::vector<TopicType>::const_iterator iter =
+      std::lower_bound(topics.begin(), topics.end(), topic);
+    return (iter != topics.end() && *iter == topic) ?
+      weights[iter - topics.begin()] : 0;
+  } // end of weight
+
+  /// Returns true once the table served its budget of draws
+  bool stale() const { return draws >= budget; }
+
+private:
+  std::vector<double> weights;
+  std::vector<TopicType> topics;
+  std::vector<float> prob;
+  std::vector<uint32_t> alias;
+  double sum;
+  size_t budget;
+  mutable graphlab::atomic<size_t> draws;
+}; // end of alias_table
+
+#endif
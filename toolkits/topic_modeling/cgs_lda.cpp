@@ -43,6 +43,7 @@
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/spirit/include/phoenix_stl.hpp>
 #include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/bounded_topk.hpp>
 
 
 
@@ -82,6 +83,9 @@ inline factor_type& operator+=(factor_type& lvalue,
 // We include the rest of GraphLab after we define the operator+= for
 // vector.
 #include <graphlab.hpp>
+#include <boost/shared_ptr.hpp>
+#include "alias_table.hpp"
+#include "packed_assignment.hpp"
 #include <graphlab/macros_def.hpp>
 
 
@@ -102,10 +106,10 @@ typedef uint16_t topic_id_type;
 /**
  * \brief The assignment type is used on each edge to store the
  * assignments of each token.  There can be several occurrences of the
- * same word in a given document and so a vector is used to store the
- * assignments of each occurrence.
+ * same word in a given document and so a packed array is used to
+ * store the assignments of each occurrence (see packed_assignment).
  */
-typedef std::vector< topic_id_type > assignment_type;
+typedef packed_assignment assignment_type;
 
 
 // Global Variables
@@ -161,11 +165,120 @@ size_t INTERVAL = 10;
  */
 size_t LIK_INTERVAL = 5;
 
+/**
+ * \brief The number of token changes a thread buffers before adding
+ * them to the shared global topic counts.
+ */
+size_t COUNT_SYNC = 1000;
+
+/**
+ * \brief The time in seconds between the recomputations of the global
+ * topic counts from the vertex counts of all machines.
+ */
+float COUNT_INTERVAL = 5;
+
+
+/**
+ * \brief The number of tokens in each topic across all machines.
+ *
+ * Incrementing one shared counter per token from every thread makes
+ * the counts a cache line hotspot, so each thread buffers its changes
+ * (see view) and adds them to the shared counts every COUNT_SYNC
+ * changes. A thread sees its own changes immediately and the changes
+ * of the other threads of the machine within COUNT_SYNC tokens.
+ *
+ * The counts of the other machines are only seen when the global
+ * counts aggregator sets the counts from the vertex counts, every
+ * COUNT_INTERVAL seconds. This also discards the pending changes of
+ * all the threads, which the vertex counts already include.
+ */
+class global_topic_counts {
+private:
+  /// The changes buffered by a thread
+  struct thread_delta {
+    size_t epoch;
+    size_t changes;
+    std::vector<count_type> delta;
+    std::vector<topic_id_type> touched;
+    thread_delta() : epoch(-1), changes(0) { }
+  };
+
+public:
+  /// The view of the counts from a thread. Not thread safe.
+  class view {
+  public:
+    /// The count of topic t, possibly negative while changes are pending
+    count_type operator[](size_t t) const {
+      return owner.counts[t] + buf.delta[t];
+    }
+
+    /// Adds change to the count of topic t
+    void add(size_t t, count_type change) {
+      if(buf.delta[t] == 0) buf.touched.push_back(t);
+      buf.delta[t] += change;
+      if(++buf.changes >= COUNT_SYNC) flush();
+    }
+
+    /// Adds the buffered changes to the shared counts
+    void flush() {
+      foreach(topic_id_type t, buf.touched) {
+        if(buf.delta[t] != 0) owner.counts[t] += buf.delta[t];
+        buf.delta[t] = 0;
+      }
+      buf.touched.clear();
+      buf.changes = 0;
+    }
+
+  private:
+    friend class global_topic_counts;
+    view(global_topic_counts& owner, thread_delta& buf) :
+      owner(owner), buf(buf) { }
+    global_topic_counts& owner;
+    thread_delta& buf;
+  }; // end of view
+
+  global_topic_counts() : epoch(0) { }
+
+  void resize(size_t ntopics) { counts.resize(ntopics); epoch.inc(); }
+
+  size_t size() const { return counts.size(); }
+
+  /// The shared count of topic t, without the pending changes
+  count_type operator[](size_t t) const { return counts[t]; }
+
+  /// Replaces the counts and discards the pending changes
+  void set(size_t t, count_type count) { counts[t] = count; }
+
+  /// Discards the pending changes of all the threads. See set().
+  void discard_changes() { epoch.inc(); }
+
+  /// The view of the calling thread
+  view local_view() {
+    graphlab::any& local = graphlab::thread::get_local(TLS_KEY);
+    if(local.empty()) local = graphlab::any(thread_delta());
+    thread_delta& buf = local.as<thread_delta>();
+    if(buf.epoch != epoch.value || buf.delta.size() != counts.size()) {
+      buf.delta.assign(counts.size(), 0);
+      buf.touched.clear();
+      buf.changes = 0;
+      buf.epoch = epoch.value;
+    }
+    return view(*this, buf);
+  } // end of local_view
+
+private:
+  /// The key of the thread_delta in the thread local data
+  enum { TLS_KEY = 0x1da7c0 };
+  factor_type counts;
+  graphlab::atomic<size_t> epoch;
+}; // end of global_topic_counts
+
+
 /**
  * \brief The global variable storing the global topic count across
  * all machines.  This is maintained periodically using aggregation.
  */
-factor_type GLOBAL_TOPIC_COUNT;
+global_topic_counts GLOBAL_TOPIC_COUNT;
 
 /**
  * \brief A dictionary of words used to print the top words during
@@ -186,6 +299,18 @@ size_t MAX_COUNT = 100;
  */
 float BURNIN = -1;
 
+/**
+ * \brief If true tokens are drawn by the Metropolis-Hastings alias
+ * sampler (see alias_sample()) instead of the full Gibbs conditional.
+ */
+bool ALIAS_SAMPLER = false;
+
+/**
+ * \brief The number of Metropolis-Hastings steps of the alias sampler
+ * per token. Each step draws from the word and then the doc proposal.
+ */
+size_t MH_STEPS = 2;
+
 /**
  * \brief The json top word struct contains the current set of top
  * words for each topic encoded in the form of a json string.
@@ -255,6 +380,25 @@ struct vertex_data {
 }; // end of vertex_data
 
 
+/**
+ * \brief The change of the vertex data made by an apply.  Only the
+ * topics whose count changed are sent to the mirrors.
+ */
+struct vertex_delta {
+  uint32_t nupdates;
+  uint32_t nchanges;
+  ///! The new count of each changed topic
+  std::vector< std::pair<topic_id_type, count_type> > changes;
+  vertex_delta() : nupdates(0), nchanges(0) { }
+  void save(graphlab::oarchive& arc) const {
+    arc << nupdates << nchanges << changes;
+  }
+  void load(graphlab::iarchive& arc) {
+    arc >> nupdates >> nchanges >> changes;
+  }
+}; // end of vertex_delta
+
+
 /**
  * \brief The edge data represents the individual tokens (word,doc)
  * pairs and their assignment to topics.
@@ -432,6 +576,174 @@ struct gather_type {
 
 
 
+// ========================================================
+// The Metropolis-Hastings alias sampler
+
+typedef alias_table<topic_id_type> topic_alias_table;
+typedef boost::shared_ptr<const topic_alias_table> topic_alias_ptr;
+
+/**
+ * \brief The alias tables of the proposals of the alias sampler.
+ *
+ * The word proposal (n_wt + beta) / (n_t + V beta) is the mixture of a
+ * sparse part n_wt / (n_t + V beta) over the topics of the word and of
+ * a dense part beta / (n_t + V beta) common to all words. The doc
+ * proposal n_dt + alpha is the mixture of a sparse part over the
+ * topics of the doc and of a uniform part. Each sparse part has a
+ * table per local vertex, so the tables take O(tokens) memory, and
+ * the dense part has a single table.
+ *
+ * Tables are built from the current counts the first time they are
+ * needed and rebuilt once they served as many draws as the vertex
+ * has tokens (K draws for the dense table), which amortizes their
+ * O(K) construction. The counts change in the meanwhile but the
+ * Metropolis-Hastings acceptance corrects for the stale proposals.
+ */
+class alias_table_cache {
+public:
+  void resize(size_t nvertices) {
+    tables.clear();
+    tables.resize(nvertices);
+    dense.reset();
+  }
+
+  /// The sparse table of a doc (is_word is false) or of a word
+  topic_alias_ptr vertex_table(graphlab::lvid_type lvid,
+                               const factor_type& counts, bool is_word) {
+    graphlab::simple_spinlock& lock = locks[lvid % NUM_LOCKS];
+    lock.lock();
+    topic_alias_ptr ret = tables[lvid];
+    if(ret == NULL || ret->stale()) {
+      ret = build_vertex_table(counts, is_word);
+      tables[lvid] = ret;
+    }
+    lock.unlock();
+    return ret;
+  } // end of vertex_table
+
+  /// The table of beta / (n_t + V beta)
+  topic_alias_ptr dense_table() {
+    dense_lock.lock();
+    topic_alias_ptr ret = dense;
+    if(ret == NULL || ret->stale()) {
+      std::vector<double> weights(NTOPICS);
+      for(size_t t = 0; t < NTOPICS; ++t) weights[t] = BETA / word_norm(t);
+      topic_alias_table* table = new topic_alias_table();
+      table->build(weights, std::vector<topic_id_type>(), NTOPICS);
+      ret = dense = topic_alias_ptr(table);
+    }
+    dense_lock.unlock();
+    return ret;
+  } // end of dense_table
+
+private:
+  enum { NUM_LOCKS = 1024 };
+  std::vector<topic_alias_ptr> tables;
+  graphlab::simple_spinlock locks[NUM_LOCKS];
+  topic_alias_ptr dense;
+  graphlab::simple_spinlock dense_lock;
+
+  static double word_norm(size_t t) {
+    return BETA * NWORDS +
+      std::max(GLOBAL_TOPIC_COUNT[t], count_type(0));
+  }
+
+  static topic_alias_ptr build_vertex_table(const factor_type& counts,
+                                            bool is_word) {
+    std::vector<double> weights;
+    std::vector<topic_id_type> topics;
+    size_t ntokens = 0;
+    for(size_t t = 0; t < counts.size(); ++t) {
+      const count_type count = counts[t];
+      if(count <= 0) continue;
+      ntokens += count;
+      topics.push_back(t);
+      weights.push_back(is_word ? count / word_norm(t) : double(count));
+    }
+    topic_alias_table* table = new topic_alias_table();
+    table->build(weights, topics, std::max(ntokens, size_t(1)));
+    return topic_alias_ptr(table);
+  } // end of build_vertex_table
+}; // end of alias_table_cache
+
+/**
+ * \brief The alias tables of the local vertices.
+ */
+alias_table_cache ALIAS_TABLES;
+
+
+/**
+ * \brief The unnormalized probability of topic t for a token of the
+ * doc and word with the given counts (excluding the token).
+ */
+inline double lda_target(size_t t, const factor_type& doc_topic_count,
+                         const factor_type& word_topic_count,
+                         const global_topic_counts::view& topic_count) {
+  const double n_dt = std::max(count_type(doc_topic_count[t]), count_type(0));
+  const double n_wt = std::max(count_type(word_topic_count[t]), count_type(0));
+  const double n_t = std::max(topic_count[t], count_type(0));
+  return (ALPHA + n_dt) * (BETA + n_wt) / (BETA * NWORDS + n_t);
+} // end of lda_target
+
+
+/**
+ * \brief Draws the topic of a token in O(MH_STEPS) with the cycle
+ * Metropolis-Hastings proposals of LightLDA.
+ *
+ * Each step draws a candidate from the word proposal and accepts it
+ * with probability min(1, p(t) q(s) / (p(s) q(t))), then does the same
+ * with the doc proposal. Starting from the current topic s, the chain
+ * keeps the exact conditional p invariant whatever the staleness of
+ * the proposals.
+ *
+ * \param s the current topic of the token, NULL_TOPIC if it has none
+ */
+topic_id_type alias_sample(topic_id_type s,
+                           const factor_type& doc_topic_count,
+                           const factor_type& word_topic_count,
+                           const global_topic_counts::view& topic_count,
+                           const topic_alias_table& doc_table,
+                           const topic_alias_table& word_table,
+                           const topic_alias_table& dense_table) {
+  const double word_total = word_table.total() + dense_table.total();
+  const double doc_total = doc_table.total() + NTOPICS * ALPHA;
+  if(s == NULL_TOPIC) {
+    s = (graphlab::random::rand01() * word_total < word_table.total()) ?
+      word_table.sample() : dense_table.sample();
+  }
+  double p_s = lda_target(s, doc_topic_count, word_topic_count, topic_count);
+  for(size_t step = 0; step < MH_STEPS; ++step) {
+    // Word proposal
+    topic_id_type t =
+      (graphlab::random::rand01() * word_total < word_table.total()) ?
+      word_table.sample() : dense_table.sample();
+    if(t != s) {
+      const double p_t = lda_target(t, doc_topic_count, word_topic_count, topic_count);
+      const double q_s = word_table.weight(s) + dense_table.weight(s);
+      const double q_t = word_table.weight(t) + dense_table.weight(t);
+      if(graphlab::random::rand01() * p_s * q_t < p_t * q_s) {
+        s = t; p_s = p_t;
+      }
+    }
+    // Doc proposal
+    t = (graphlab::random::rand01() * doc_total < doc_table.total()) ?
+      doc_table.sample() :
+      topic_id_type(graphlab::random::fast_uniform<size_t>(0, NTOPICS - 1));
+    if(t != s) {
+      const double p_t = lda_target(t, doc_topic_count, word_topic_count, topic_count);
+      const double q_s = doc_table.weight(s) + ALPHA;
+      const double q_t = doc_table.weight(t) + ALPHA;
+      if(graphlab::random::rand01() * p_s * q_t < p_t * q_s) {
+        s = t; p_s = p_t;
+      }
+    }
+  }
+  return s;
+} // end of alias_sample
+
+
+
+
 /**
  * \brief The collapsed Gibbs sampler vertex program updates the topic
  * counts for the center vertex and then draws new topic assignments
@@ -462,7 +774,8 @@ public:
                      edge_type& edge) const {
     gather_type ret(edge.data().nchanges);
     const assignment_type& assignment = edge.data().assignment;
-    foreach(topic_id_type asg, assignment) {
+    for(size_t i = 0; i < assignment.size(); ++i) {
+      const topic_id_type asg = assignment.get(i);
       if(asg != NULL_TOPIC) ++ret.factor[asg];
     }
     return ret;
@@ -488,6 +801,35 @@ public:
   } // end of apply
 
 
+  typedef vertex_delta vertex_delta_type;
+
+  /**
+   * \brief Record the topics whose count changed in apply.  The full
+   * vertex data is sent if most of the topics changed.
+   */
+  bool make_vertex_delta(const vertex_data& old_data,
+                         const vertex_data& new_data,
+                         vertex_delta& delta) const {
+    delta.nupdates = new_data.nupdates;
+    delta.nchanges = new_data.nchanges;
+    for(size_t t = 0; t < new_data.factor.size(); ++t) {
+      const count_type count = new_data.factor[t];
+      if(count != count_type(old_data.factor[t]))
+        delta.changes.push_back(std::make_pair(topic_id_type(t), count));
+      if(2 * delta.changes.size() > NTOPICS) return false;
+    }
+    return true;
+  } // end of make_vertex_delta
+
+  void apply_vertex_delta(vertex_data& data, const vertex_delta& delta) const {
+    data.nupdates = delta.nupdates;
+    data.nchanges = delta.nchanges;
+    typedef std::pair<topic_id_type, count_type> topic_count_pair;
+    foreach(const topic_count_pair& change, delta.changes)
+      data.factor[change.first] = change.second;
+  } // end of apply_vertex_delta
+
+
   /**
    * \brief Scatter on all edges if the computation is on-going.
    * Computation stops after bunrin or when disable sampling is set to
@@ -516,38 +858,49 @@ public:
    */
   void scatter(icontext_type& context, const vertex_type& vertex,
                edge_type& edge) const {
-    factor_type& doc_topic_count =  is_doc(edge.source()) ?
-      edge.source().data().factor : edge.target().data().factor;
-    factor_type& word_topic_count = is_word(edge.source()) ?
-      edge.source().data().factor : edge.target().data().factor;
+    vertex_type doc = is_doc(edge.source()) ? edge.source() : edge.target();
+    vertex_type word = is_word(edge.source()) ? edge.source() : edge.target();
+    factor_type& doc_topic_count = doc.data().factor;
+    factor_type& word_topic_count = word.data().factor;
     ASSERT_EQ(doc_topic_count.size(), NTOPICS);
     ASSERT_EQ(word_topic_count.size(), NTOPICS);
+    // the proposals of the alias sampler
+    topic_alias_ptr doc_table, word_table, dense_table;
+    if(ALIAS_SAMPLER) {
+      doc_table = ALIAS_TABLES.vertex_table(doc.local_id(),
+                                            doc_topic_count, false);
+      word_table = ALIAS_TABLES.vertex_table(word.local_id(),
+                                             word_topic_count, true);
+      dense_table = ALIAS_TABLES.dense_table();
+    }
+    global_topic_counts::view topic_count = GLOBAL_TOPIC_COUNT.local_view();
     // run the actual gibbs sampling
-    std::vector<double> prob(NTOPICS);
+    std::vector<double> prob(ALIAS_SAMPLER ? 0 : NTOPICS);
     assignment_type& assignment = edge.data().assignment;
     edge.data().nchanges = 0;
-    foreach(topic_id_type& asg, assignment) {
-      const topic_id_type old_asg = asg;
+    for(size_t i = 0; i < assignment.size(); ++i) {
+      const topic_id_type old_asg = assignment.get(i);
+      topic_id_type asg = old_asg;
       if(asg != NULL_TOPIC) { // construct the cavity
         --doc_topic_count[asg];
         --word_topic_count[asg];
-        --GLOBAL_TOPIC_COUNT[asg];
+        topic_count.add(asg, -1);
       }
-      for(size_t t = 0; t < NTOPICS; ++t) {
-        const double n_dt =
-          std::max(count_type(doc_topic_count[t]), count_type(0));
-        const double n_wt =
-          std::max(count_type(word_topic_count[t]), count_type(0));
-        const double n_t  =
-          std::max(count_type(GLOBAL_TOPIC_COUNT[t]), count_type(0));
-        prob[t] = (ALPHA + n_dt) * (BETA + n_wt) / (BETA * NWORDS + n_t);
+      if(ALIAS_SAMPLER) {
+        asg = alias_sample(old_asg, doc_topic_count, word_topic_count,
+                           topic_count, *doc_table, *word_table,
+                           *dense_table);
+      } else {
+        for(size_t t = 0; t < NTOPICS; ++t)
+          prob[t] = lda_target(t, doc_topic_count, word_topic_count, topic_count);
+        asg = graphlab::random::multinomial(prob);
       }
-      asg = graphlab::random::multinomial(prob);
       // asg = std::max_element(prob.begin(), prob.end()) - prob.begin();
       ++doc_topic_count[asg];
       ++word_topic_count[asg];
-      ++GLOBAL_TOPIC_COUNT[asg];
+      topic_count.add(asg, 1);
       if(asg != old_asg) {
+        assignment.set(i, asg);
         ++edge.data().nchanges;
         INCREMENT_EVENT(TOKEN_CHANGES,1);
       }
@@ -583,8 +936,9 @@ typedef cgs_lda_vertex_program::icontext_type icontext_type;
  */
 class topk_aggregator {
   typedef std::pair<float, graphlab::vertex_id_type> cw_pair_type;
+  typedef graphlab::bounded_topk<cw_pair_type> topk_type;
 private:
-  std::vector< std::set<cw_pair_type> > top_words;
+  std::vector<topk_type> top_words;
   size_t nchanges, nupdates;
 public:
   topk_aggregator(size_t nchanges = 0, size_t nupdates = 0) :
@@ -598,15 +952,9 @@ public:
     nchanges += other.nchanges;
     nupdates += other.nupdates;
     if(other.top_words.empty()) return *this;
-    if(top_words.empty()) top_words.resize(NTOPICS);
-    for(size_t i = 0; i < top_words.size(); ++i) {
-      // Merge the topk
-      top_words[i].insert(other.top_words[i].begin(),
-                          other.top_words[i].end());
-      // Remove excess elements
-      while(top_words[i].size() > TOPK)
-        top_words[i].erase(top_words[i].begin());
-    }
+    if(top_words.empty()) top_words.resize(NTOPICS, topk_type(TOPK));
+    for(size_t i = 0; i < top_words.size(); ++i)
+      top_words[i] += other.top_words[i];
     return *this;
   } // end of operator +=
 
@@ -618,7 +966,7 @@ public:
     ret_value.nupdates = vdata.nupdates;
     if(is_word(vertex)) {
       const graphlab::vertex_id_type wordid = vertex.id();
-      ret_value.top_words.resize(vdata.factor.size());
+      ret_value.top_words.resize(vdata.factor.size(), topk_type(TOPK));
       for(size_t i = 0; i < vdata.factor.size(); ++i) {
         const cw_pair_type pair(vdata.factor[i], wordid);
         ret_value.top_words[i].insert(pair);
@@ -637,7 +985,7 @@ public:
       std::cout << "Topic " << i << ": ";
       json += "\t[\n";
       size_t counter = 0;
-      rev_foreach(cw_pair_type pair, total.top_words[i])  {
+      foreach(cw_pair_type pair, total.top_words[i].sorted())  {
       ASSERT_LT(pair.second, DICTIONARY.size());
         json += "\t\t[\"" + DICTIONARY[pair.second] + "\", " +
           graphlab::tostr(pair.first) + "]";
@@ -680,10 +1028,10 @@ struct global_counts_aggregator {
   static void finalize(icontext_type& context, const factor_type& total) {
     size_t sum = 0;
     for(size_t t = 0; t < total.size(); ++t) {
-      GLOBAL_TOPIC_COUNT[t] =
-        std::max(count_type(total[t]/2), count_type(0));
+      GLOBAL_TOPIC_COUNT.set(t, std::max(count_type(total[t]/2), count_type(0)));
       sum += GLOBAL_TOPIC_COUNT[t];
     }
+    GLOBAL_TOPIC_COUNT.discard_changes();
     context.cout() << "Total Tokens: " << sum << std::endl;
   } // end of finalize
 }; // end of global_counts_aggregator struct
@@ -792,8 +1140,7 @@ public:
     // Address the global sum terms
     double denominator = 0;
     for(size_t t = 0; t < NTOPICS; ++t) {
-      const count_type value = 
-        std::max(count_type(GLOBAL_TOPIC_COUNT[t]), count_type(0));
+      const count_type value = std::max(GLOBAL_TOPIC_COUNT[t], count_type(0));
       denominator += lgamma(value + NWORDS * BETA);
     } // end of for loop
 
@@ -1093,6 +1440,7 @@ int main(int argc, char** argv) {
   std::string word_dir;
   std::string exec_type = "asynchronous";
   std::string format = "matrix";
+  std::string sampler = "gibbs";
   
   clopts.attach_option("dictionary", dictionary_fname,
                        "The file containing the list of unique words");
@@ -1124,6 +1472,20 @@ int main(int argc, char** argv) {
                        "The output directory to save the final document counts.");
   clopts.attach_option("word_dir", word_dir,
                        "The output directory to save the final words counts.");
+  clopts.attach_option("sampler", sampler,
+                       "The token sampler: gibbs draws from the full "
+                       "conditional in O(ntopics), alias uses "
+                       "Metropolis-Hastings with alias table proposals "
+                       "in O(1) amortized per token.");
+  clopts.attach_option("count_sync", COUNT_SYNC,
+                       "The number of token changes each thread buffers "
+                       "before adding them to the global topic counts.");
+  clopts.attach_option("count_interval", COUNT_INTERVAL,
+                       "The time in seconds between the recomputations of "
+                       "the global topic counts across machines.");
+  clopts.attach_option("mh_steps", MH_STEPS,
+                       "The number of Metropolis-Hastings steps per token "
+                       "of the alias sampler.");
 
 
   if(!clopts.parse(argc, argv)) {
@@ -1146,8 +1508,17 @@ int main(int argc, char** argv) {
   graphlab::add_metric_server_callback("wordclouds", word_cloud_callback);
 
 
+  if(NTOPICS == 0 || NTOPICS >= size_t(NULL_TOPIC)) {
+    logstream(LOG_ERROR)
+      << "The number of topics must be in [1, " << NULL_TOPIC << ")!"
+      << std::endl;
+    return EXIT_FAILURE;
+  }
+
   ///! Initialize global variables
   GLOBAL_TOPIC_COUNT.resize(NTOPICS);
+  // the assignments are packed with the bits needed for NTOPICS
+  assignment_type::set_num_topics(NTOPICS);
   if(!dictionary_fname.empty()) {
     const bool success = load_dictionary(dictionary_fname);
     if(!success) {
@@ -1167,6 +1538,14 @@ int main(int argc, char** argv) {
       << "Beta must be positive (beta=" << BETA << ")!"  << std::endl;
     return EXIT_FAILURE;
   }
+
+  if(sampler != "gibbs" && sampler != "alias") {
+    logstream(LOG_ERROR)
+      << "The sampler must be gibbs or alias (sampler=" << sampler << ")!"
+      << std::endl;
+    return EXIT_FAILURE;
+  }
+  ALIAS_SAMPLER = (sampler == "alias");
    
   /// Initialize the log_gamma precached calculations.
   ALPHA_LGAMMA.init(ALPHA, 100000);
@@ -1185,6 +1564,7 @@ int main(int argc, char** argv) {
   }
 
 
+  if(ALIAS_SAMPLER) ALIAS_TABLES.resize(graph.num_local_vertices());
   const size_t ntokens = graph.map_reduce_edges<size_t>(count_tokens);
   dc.cout() << "Total tokens: " << ntokens << std::endl;
 
@@ -1206,7 +1586,7 @@ int main(int argc, char** argv) {
       ("global_counts", 
        global_counts_aggregator::map, 
        global_counts_aggregator::finalize) &&
-      engine.aggregate_periodic("global_counts", 5);
+      engine.aggregate_periodic("global_counts", COUNT_INTERVAL);
     ASSERT_TRUE(success);
   }
   
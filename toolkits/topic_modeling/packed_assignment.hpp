@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ *
+ */
+
+
+#ifndef PACKED_ASSIGNMENT_HPP
+#define PACKED_ASSIGNMENT_HPP
+
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+
+/**
+ * \brief The topic assignments of the tokens of an edge, bit packed.
+ *
+ * Each topic takes only the bits needed for ntopics + 1 values (the
+ * largest value of the bits is the null topic, uint16_t(-1)), and the
+ * topics are packed in 64 bit words, 64 / bits per word. The edges
+ * whose topics fit in one word, which are most of them, store it
+ * inline and need no allocation. Larger edges allocate exactly the
+ * words they need. The whole object is 16 bytes, instead of the 24
+ * bytes of a std::vector header, a heap block and its capacity slack.
+ *
+ * set_num_topics() must be called before any assignment is created
+ * and must get the same value on every machine.
+ */
+class packed_assignment {
+public:
+  typedef uint16_t topic_type;
+  static const topic_type NULL_VALUE = topic_type(-1);
+
+  /// Sets the number of bits per topic for ntopics topics
+  static void set_num_topics(size_t ntopics) {
+    ASSERT_LT(ntopics, size_t(NULL_VALUE));
+    size_t b = 1;
+    while((size_t(1) << b) < ntopics + 1) ++b;
+    bits() = b;
+  } // end of set_num_topics
+
+  packed_assignment(size_t n = 0, topic_type value = NULL_VALUE) :
+    n(0) {
+    word = 0;
+    resize(n, value);
+  }
+
+  packed_assignment(const packed_assignment& other) : n(0) {
+    word = 0;
+    *this = other;
+  }
+
+  ~packed_assignment() { clear(); }
+
+  packed_assignment& operator=(const packed_assignment& other) {
+    if(this == &other) return *this;
+    clear();
+    n = other.n;
+    if(is_inline()) word = other.word;
+    else {
+      words = (uint64_t*)malloc(num_words(n) * sizeof(uint64_t));
+      memcpy(words, other.words, num_words(n) * sizeof(uint64_t));
+    }
+    return *this;
+  }
+
+  /// The number of tokens
+  size_t size() const { return n; }
+
+  bool empty() const { return n == 0; }
+
+  /// Sets the number of tokens, all with topic value
+  void resize(size_t new_n, topic_type value = NULL_VALUE) {
+    clear();
+    n = new_n;
+    if(!is_inline()) {
+      words = (uint64_t*)malloc(num_words(n) * sizeof(uint64_t));
+    }
+    for(size_t i = 0; i < n; ++i) set(i, value);
+  } // end of resize
+
+  /// The topic of token i
+  topic_type get(size_t i) const {
+    const size_t b = bits();
+    const size_t per_word = 64 / b;
+    const uint64_t mask = (uint64_t(1) << b) - 1;
+    const uint64_t w = is_inline() ? word : words[i / per_word];
+    const uint64_t value = (w >> ((i % per_word) * b)) & mask;
+    return value == mask ? NULL_VALUE : topic_type(value);
+  } // end of get
+
+  /// Sets the topic of token i
+  void set(size_t i, topic_type topic) {
+    const size_t b = bits();
+    const size_t per_word = 64 / b;
+    const uint64_t mask = (uint64_t(1) << b) - 1;
+    const uint64_t value = topic == NULL_VALUE ? mask : uint64_t(topic);
+    const size_t shift = (i % per_word) * b;
+    uint64_t& w = is_inline() ? word : words[i / per_word];
+    w = (w & ~(mask << shift)) | (value << shift);
+  } // end of set
+
+  /// Saves the packed words, so the wire format is packed too
+  void save(graphlab::oarchive& arc) const {
+    const uint32_t b = bits();
+    arc << n << b;
+    if(is_inline()) arc << word;
+    else graphlab::serialize(arc, words, num_words(n) * sizeof(uint64_t));
+  } // end of save
+
+  /// Loads a saved assignment, repacking it if it used other bits
+  void load(graphlab::iarchive& arc) {
+    uint32_t new_n = 0, b = 0;
+    arc >> new_n >> b;
+    if(b == bits()) {
+      clear();
+      n = new_n;
+      if(is_inline()) arc >> word;
+      else {
+        words = (uint64_t*)malloc(num_words(n) * sizeof(uint64_t));
+        graphlab::deserialize(arc, words, num_words(n) * sizeof(uint64_t));
+      }
+    } else {
+      const size_t per_word = 64 / b;
+      const uint64_t mask = (uint64_t(1) << b) - 1;
+      std::vector<uint64_t> saved((new_n + per_word - 1) / per_word);
+      if(saved.size() <= 1) {
+        uint64_t w = 0;
+        arc >> w;
+        saved.assign(1, w);
+      } else {
+        graphlab::deserialize(arc, &saved[0], saved.size() * sizeof(uint64_t));
+      }
+      resize(new_n);
+      for(size_t i = 0; i < n; ++i) {
+        const uint64_t value = (saved[i / per_word] >> ((i % per_word) * b)) & mask;
+        set(i, value == mask ? NULL_VALUE : topic_type(value));
+      }
+    }
+  } // end of load
+
+private:
+  uint32_t n;
+  union {
+    uint64_t word;
+    uint64_t* words;
+  };
+
+  static size_t& bits() {
+    static size_t b = 16;
+    return b;
+  }
+
+  static size_t num_words(size_t n) {
+    const size_t per_word = 64 / bits();
+    return (n + per_word - 1) / per_word;
+  }
+
+  bool is_inline() const { return num_words(n) <= 1; }
+
+  void clear() {
+    if(!is_inline()) free(words);
+    n = 0;
+    word = 0;
+  }
+}; // end of packed_assignment
+
+#endif